@@ -283,7 +283,7 @@ polyscope::warning("Some problems come in groups", "detail = " + std::to_string(
     bool isTriangle = true;
     psMesh->ensureHaveFaceTangentSpaces();
     for (size_t iF = 0; iF < nFaces; iF++) {
-      std::vector<size_t>& face = psMesh->faces[iF];
+      auto face = psMesh->face(iF);
 
       if (face.size() != 3) {
         isTriangle = false;
@@ -296,7 +296,7 @@ polyscope::warning("Some problems come in groups", "detail = " + std::to_string(
 
         size_t vA = face[j];
         size_t vB = face[(j + 1) % face.size()];
-        size_t iE = psMesh->edgeIndices[iF][j];
+        size_t iE = psMesh->faceEdges(iF)[j];
 
         glm::vec3 v = spatialFunc(pos);
         glm::vec3 edgeVec = psMesh->vertices[vB] - psMesh->vertices[vA];
@@ -0,0 +1,326 @@
+#include "polyscope/polyscope.h"
+
+#include "polyscope/camera_path.h"
+#include "polyscope/point_cloud.h"
+#include "polyscope/render/engine.h"
+#include "polyscope/slice_plane.h"
+#include "polyscope/surface_mesh.h"
+
+#include "glm/gtc/constants.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "args/args.hxx"
+#include "json/json.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+// A synthetic scene, drawn along a fixed orbit of the camera for a number of frames. Frame times are measured on the CPU
+// (each main loop iteration) and on the GPU (the timed passes of each frame), and reported with the memory use as JSON.
+
+struct SceneParams {
+  int nStructures = 1;
+  size_t nTriangles = 1000000;
+  size_t nPoints = 100000;
+  int nQuantities = 1;
+  int nSlicePlanes = 0;
+  polyscope::TransparencyMode transparency = polyscope::TransparencyMode::None;
+  polyscope::GroundPlaneMode ground = polyscope::GroundPlaneMode::TileReflection;
+  int ssaa = 1;
+};
+
+// A wavy grid of about nTriangles triangles
+void addGridMesh(string name, size_t nTriangles, glm::vec3 offset, int nQuantities) {
+  size_t k = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(nTriangles / 2.))));
+  std::vector<glm::vec3> vertices;
+  vertices.reserve((k + 1) * (k + 1));
+  for (size_t j = 0; j <= k; j++) {
+    for (size_t i = 0; i <= k; i++) {
+      float x = static_cast<float>(i) / k;
+      float y = static_cast<float>(j) / k;
+      vertices.push_back(offset + glm::vec3{x, 0.1f * std::sin(12.f * x) * std::cos(12.f * y), y});
+    }
+  }
+  std::vector<std::array<size_t, 3>> faces;
+  faces.reserve(2 * k * k);
+  for (size_t j = 0; j < k; j++) {
+    for (size_t i = 0; i < k; i++) {
+      size_t v = j * (k + 1) + i;
+      faces.push_back({v, v + 1, v + k + 1});
+      faces.push_back({v + 1, v + k + 2, v + k + 1});
+    }
+  }
+
+  polyscope::SurfaceMesh* psMesh = polyscope::registerSurfaceMesh(name, vertices, faces);
+  for (int iQ = 0; iQ < nQuantities; iQ++) {
+    std::vector<double> values(vertices.size());
+    for (size_t iV = 0; iV < vertices.size(); iV++) {
+      values[iV] = std::sin((iQ + 1) * vertices[iV].x) + vertices[iV].y;
+    }
+    psMesh->addVertexScalarQuantity("scalar " + std::to_string(iQ), values)->setEnabled(iQ + 1 == nQuantities);
+  }
+}
+
+void addRandomPointCloud(string name, size_t nPoints, glm::vec3 offset, int nQuantities, std::mt19937& rng) {
+  std::uniform_real_distribution<float> unif(0.f, 1.f);
+  std::vector<glm::vec3> points(nPoints);
+  for (glm::vec3& p : points) {
+    p = offset + glm::vec3{unif(rng), 0.2f + 0.5f * unif(rng), unif(rng)};
+  }
+
+  polyscope::PointCloud* psCloud = polyscope::registerPointCloud(name, points);
+  psCloud->setPointRadius(0.002);
+  for (int iQ = 0; iQ < nQuantities; iQ++) {
+    std::vector<double> values(nPoints);
+    for (size_t iP = 0; iP < nPoints; iP++) {
+      values[iP] = points[iP].y + iQ;
+    }
+    psCloud->addScalarQuantity("scalar " + std::to_string(iQ), values)->setEnabled(iQ + 1 == nQuantities);
+  }
+}
+
+void buildScene(const SceneParams& params) {
+  polyscope::options::transparencyMode = params.transparency;
+  polyscope::options::groundPlaneMode = params.ground;
+  polyscope::options::ssaaFactor = params.ssaa;
+
+  std::mt19937 rng(0);
+  int nStructures = std::max(params.nStructures, 1);
+  for (int iS = 0; iS < nStructures; iS++) {
+    glm::vec3 offset{1.2f * iS, 0.f, 0.f};
+    if (params.nTriangles > 0) {
+      addGridMesh("mesh " + std::to_string(iS), params.nTriangles / nStructures, offset, params.nQuantities);
+      if (params.transparency != polyscope::TransparencyMode::None) {
+        polyscope::getSurfaceMesh("mesh " + std::to_string(iS))->setTransparency(0.6);
+      }
+    }
+    if (params.nPoints > 0) {
+      addRandomPointCloud("points " + std::to_string(iS), params.nPoints / nStructures, offset, params.nQuantities,
+                          rng);
+    }
+  }
+
+  for (int iP = 0; iP < params.nSlicePlanes; iP++) {
+    polyscope::SlicePlane* plane = polyscope::addSceneSlicePlane();
+    plane->setPose(polyscope::state::center() + glm::vec3{0.1f * iP, 0.f, 0.f}, glm::vec3{-1.f, 0.f, 0.f});
+  }
+}
+
+// One orbit around the scene, looking at its center
+polyscope::CameraPath orbitPath(double duration) {
+  polyscope::CameraPath path;
+  glm::vec3 center = polyscope::state::center();
+  float radius = 1.5f * polyscope::state::lengthScale;
+  const int nKeyframes = 8;
+  for (int i = 0; i <= nKeyframes; i++) {
+    float angle = 2.f * glm::pi<float>() * i / nKeyframes;
+    glm::vec3 position = center + radius * glm::vec3{std::cos(angle), 0.5f, std::sin(angle)};
+    polyscope::view::lookAt(position, center);
+    path.addCurrentViewAsKeyframe(duration * i / nKeyframes);
+  }
+  return path;
+}
+
+nlohmann::json percentiles(std::vector<double> values) {
+  nlohmann::json j;
+  j["n"] = values.size();
+  if (values.empty()) return j;
+  std::sort(values.begin(), values.end());
+  auto at = [&](double q) { return values[static_cast<size_t>(std::round(q * (values.size() - 1)))]; };
+  j["p50_ms"] = at(0.5);
+  j["p95_ms"] = at(0.95);
+  j["p99_ms"] = at(0.99);
+  j["max_ms"] = values.back();
+  return j;
+}
+
+nlohmann::json toJson(const polyscope::TimingStats& t) {
+  nlohmann::json j;
+  j["name"] = t.name;
+  j["n"] = t.nFrames;
+  j["p50_ms"] = t.p50Ms;
+  j["p95_ms"] = t.p95Ms;
+  j["p99_ms"] = t.p99Ms;
+  j["max_ms"] = t.maxMs;
+  return j;
+}
+
+int main(int argc, char** argv) {
+  // Configure the argument parser
+  args::ArgumentParser parser("Render a synthetic scene along a fixed camera path, and report frame times as JSON.", "");
+  args::ValueFlag<int> structures(parser, "n", "Number of meshes, and of point clouds (default 1)", {"structures"});
+  args::ValueFlag<size_t> triangles(parser, "n", "Total triangles over the meshes (default 1000000)", {"triangles"});
+  args::ValueFlag<size_t> points(parser, "n", "Total points over the point clouds (default 100000)", {"points"});
+  args::ValueFlag<int> quantities(parser, "n", "Scalar quantities per structure, the last enabled (default 1)",
+                                  {"quantities"});
+  args::ValueFlag<int> slicePlanes(parser, "n", "Number of slice planes (default 0)", {"slice-planes"});
+  args::ValueFlag<string> transparency(parser, "mode", "none, simple, pretty or weighted (default none)",
+                                       {"transparency"});
+  args::ValueFlag<string> ground(parser, "mode", "none, tile, tile_reflection or shadow_only (default tile_reflection)",
+                                 {"ground"});
+  args::ValueFlag<int> ssaa(parser, "factor", "SSAA factor (default 1)", {"ssaa"});
+  args::ValueFlag<int> width(parser, "px", "Width of the rendered image (default 1280)", {"width"});
+  args::ValueFlag<int> height(parser, "px", "Height of the rendered image (default 720)", {"height"});
+  args::ValueFlag<size_t> frames(parser, "n", "Number of frames to time (default 600)", {'n', "frames"});
+  args::ValueFlag<size_t> warmup(parser, "n", "Frames drawn before timing (default 30)", {"warmup"});
+  args::ValueFlag<string> backend(parser, "backend", "The rendering backend to use (default openGL3_egl)",
+                                  {'b', "backend"});
+  args::ValueFlag<string> output(parser, "file", "Write the JSON report here rather than to stdout", {'o', "output"});
+
+  // Parse args
+  try {
+    parser.ParseCLI(argc, argv);
+  } catch (const args::Help&) {
+    std::cout << parser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+
+    std::cerr << parser;
+    return 1;
+  }
+
+  SceneParams params;
+  if (structures) params.nStructures = args::get(structures);
+  if (triangles) params.nTriangles = args::get(triangles);
+  if (points) params.nPoints = args::get(points);
+  if (quantities) params.nQuantities = args::get(quantities);
+  if (slicePlanes) params.nSlicePlanes = args::get(slicePlanes);
+  if (ssaa) params.ssaa = args::get(ssaa);
+  if (transparency) {
+    string mode = args::get(transparency);
+    if (mode == "none") {
+      params.transparency = polyscope::TransparencyMode::None;
+    } else if (mode == "simple") {
+      params.transparency = polyscope::TransparencyMode::Simple;
+    } else if (mode == "pretty") {
+      params.transparency = polyscope::TransparencyMode::Pretty;
+    } else if (mode == "weighted") {
+      params.transparency = polyscope::TransparencyMode::WeightedBlended;
+    } else {
+      cerr << "unrecognized transparency mode " << mode << endl;
+      return 1;
+    }
+  }
+  if (ground) {
+    string mode = args::get(ground);
+    if (mode == "none") {
+      params.ground = polyscope::GroundPlaneMode::None;
+    } else if (mode == "tile") {
+      params.ground = polyscope::GroundPlaneMode::Tile;
+    } else if (mode == "tile_reflection") {
+      params.ground = polyscope::GroundPlaneMode::TileReflection;
+    } else if (mode == "shadow_only") {
+      params.ground = polyscope::GroundPlaneMode::ShadowOnly;
+    } else {
+      cerr << "unrecognized ground mode " << mode << endl;
+      return 1;
+    }
+  }
+  size_t nFrames = frames ? args::get(frames) : 600;
+  size_t nWarmup = warmup ? args::get(warmup) : 30;
+
+  // Draw frames as fast as possible, and time them
+  polyscope::options::maxFPS = -1;
+  polyscope::options::enableIdleMode = false;
+  polyscope::options::usePrefsFile = false;
+  polyscope::options::enableCPUProfiling = true;
+  polyscope::options::enableGPUProfiling = true;
+  polyscope::options::buildGui = false;
+  polyscope::view::windowWidth = width ? args::get(width) : 1280;
+  polyscope::view::windowHeight = height ? args::get(height) : 720;
+
+  polyscope::init(backend ? args::get(backend) : "openGL3_egl");
+
+  buildScene(params);
+  for (size_t i = 0; i < nWarmup; i++) {
+    polyscope::requestRedraw();
+    polyscope::show(1);
+  }
+  size_t gpuMemoryAfterSetup = polyscope::render::engine->gpuMemoryUsage;
+
+  // Each step of the path is one frame
+  const double fps = 60.;
+  polyscope::playCameraPath(orbitPath(nFrames / fps), polyscope::CameraPathPlayback::FixedStep, fps);
+
+  std::vector<double> cpuFrameMs;
+  std::vector<double> gpuFrameMs;
+  size_t gpuMemoryPeak = gpuMemoryAfterSetup;
+  size_t lastGPUFrame = polyscope::render::engine->getGPUTimingFrameCount();
+  auto collectGPUTimings = [&]() {
+    size_t gpuFrame = polyscope::render::engine->getGPUTimingFrameCount();
+    if (gpuFrame == lastGPUFrame) return;
+    lastGPUFrame = gpuFrame;
+    double frameMs = 0.;
+    for (const polyscope::render::GPUTiming& t : polyscope::render::engine->getGPUTimings()) {
+      if (t.depth == 0) frameMs += t.durationMs;
+    }
+    gpuFrameMs.push_back(frameMs);
+  };
+
+  for (size_t i = 0; i < nFrames; i++) {
+    auto start = std::chrono::steady_clock::now();
+    polyscope::requestRedraw();
+    polyscope::show(1);
+    auto end = std::chrono::steady_clock::now();
+    cpuFrameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    gpuMemoryPeak = std::max(gpuMemoryPeak, polyscope::render::engine->gpuMemoryUsage);
+    collectGPUTimings();
+  }
+  polyscope::FrameStats frameStats = polyscope::getFrameStats();
+  polyscope::stopCameraPath();
+
+  // The GPU timings arrive a few frames late; draw a few more to pick up those of the last timed frames
+  for (int i = 0; i < 8 && gpuFrameMs.size() < nFrames; i++) {
+    polyscope::requestRedraw();
+    polyscope::show(1);
+    collectGPUTimings();
+  }
+
+  // Report
+  nlohmann::json report;
+  report["backend"] = polyscope::state::backend;
+  report["scene"] = {{"structures", params.nStructures},
+                     {"triangles", params.nTriangles},
+                     {"points", params.nPoints},
+                     {"quantities", params.nQuantities},
+                     {"slice_planes", params.nSlicePlanes},
+                     {"transparency", transparency ? args::get(transparency) : "none"},
+                     {"ground", ground ? args::get(ground) : "tile_reflection"},
+                     {"ssaa", params.ssaa},
+                     {"width", polyscope::view::bufferWidth},
+                     {"height", polyscope::view::bufferHeight}};
+  report["frames"] = nFrames;
+  report["cpu_frame"] = percentiles(cpuFrameMs);
+  report["gpu_frame"] = percentiles(gpuFrameMs);
+  nlohmann::json regions = nlohmann::json::array();
+  for (const polyscope::TimingStats& t : frameStats.regions) {
+    regions.push_back(toJson(t));
+  }
+  report["cpu_regions"] = regions;
+  report["gpu_memory_bytes"] = {{"after_setup", gpuMemoryAfterSetup}, {"peak", gpuMemoryPeak}};
+
+  if (output) {
+    std::ofstream outFile(args::get(output));
+    if (!outFile) {
+      cerr << "could not open " << args::get(output) << " for writing" << endl;
+      return 1;
+    }
+    outFile << report.dump(2) << endl;
+  } else {
+    cout << report.dump(2) << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include "polyscope/polyscope.h"
+
+#include "polyscope/session_capture.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "args/args.hxx"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+void printTiming(const polyscope::TimingStats& t) {
+  cout << "  " << t.name << ": p50 " << t.p50Ms << " ms, p95 " << t.p95Ms << " ms, p99 " << t.p99Ms << " ms, max "
+       << t.maxMs << " ms" << endl;
+}
+
+int main(int argc, char** argv) {
+  // Configure the argument parser
+  args::ArgumentParser parser("Replay a session captured with polyscope::startSessionCapture(), timing the work.", "");
+  args::Positional<string> file(parser, "file", "The session file to replay");
+  args::Flag realTime(parser, "realtime", "Wait between records as long as the captured session did",
+                      {'r', "realtime"});
+  args::Flag keepOpen(parser, "keep-open", "Show the scene after the replay ends", {'k', "keep-open"});
+  args::ValueFlag<string> backend(parser, "backend", "The rendering backend to use", {'b', "backend"});
+
+  // Parse args
+  try {
+    parser.ParseCLI(argc, argv);
+  } catch (const args::Help&) {
+    std::cout << parser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+
+    std::cerr << parser;
+    return 1;
+  }
+  if (!file) {
+    std::cerr << parser;
+    return 1;
+  }
+
+  // Draw frames as fast as possible, and time them
+  polyscope::options::maxFPS = -1;
+  polyscope::options::enableIdleMode = false;
+  polyscope::options::usePrefsFile = false;
+  polyscope::options::enableCPUProfiling = true;
+
+  polyscope::init(backend ? args::get(backend) : "");
+
+  polyscope::SessionReplayStats stats;
+  try {
+    stats = polyscope::replaySession(args::get(file), args::get(realTime));
+  } catch (const std::runtime_error& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  cout << "replayed " << stats.capturedSeconds << " s of captured session" << endl;
+  cout << "  " << stats.nCalls << " calls in " << stats.callSeconds << " s" << endl;
+  cout << "  " << stats.nFrames << " frames in " << stats.frameSeconds << " s" << endl;
+  if (stats.frameStats.frame.nFrames > 0) {
+    cout << "frame timings:" << endl;
+    printTiming(stats.frameStats.frame);
+    for (const polyscope::TimingStats& t : stats.frameStats.regions) {
+      printTiming(t);
+    }
+  }
+
+  if (keepOpen) {
+    polyscope::show();
+  }
+
+  return 0;
+}
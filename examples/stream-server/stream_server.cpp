@@ -0,0 +1,709 @@
+// Stream the view of a headless polyscope session to a web browser, e.g. from a GPU server in a data center, and take
+// the mouse input back to drive the camera and picking.
+//
+// Open http://<host>:<port>/ in a browser. The page opens a WebSocket back to the same port, on which the server sends
+// each changed frame as a JPEG, and the page sends mouse events and the size of its canvas. Frames are read back and
+// encoded on a worker thread (see polyscope::startRecording()). The JPEG quality and the resolution adapt to how fast
+// the viewer acknowledges frames, at most a couple are in flight at once, and once the view stops changing the last
+// frame is sent again at full quality.
+//
+// Only the scene is streamed, not the ImGui panels.
+//
+// Whoever holds the WebSocket drives the viewer, and there is no authentication. So the server only listens on the
+// loopback interface unless --bind names another one (reach a remote server through an SSH tunnel, e.g.
+// `ssh -L 8080:localhost:8080 server`). Upgrades are only accepted from the page the server itself serves, so other web
+// pages open in the browser can not connect.
+
+#include "polyscope/point_cloud.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/screenshot.h"
+#include "polyscope/surface_mesh.h"
+#include "polyscope/surface_mesh_io.h"
+
+#include "args/args.hxx"
+#include "json/json.hpp"
+#include "stb_image_write.h"
+
+#ifdef _WIN32
+#error "the stream server uses POSIX sockets"
+#endif
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// == SHA-1 and base64, for the WebSocket handshake
+
+std::array<uint8_t, 20> sha1(const string& message) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+  std::vector<uint8_t> data(message.begin(), message.end());
+  uint64_t bitLength = static_cast<uint64_t>(data.size()) * 8;
+  data.push_back(0x80);
+  while (data.size() % 64 != 56) data.push_back(0);
+  for (int i = 7; i >= 0; i--) data.push_back(static_cast<uint8_t>(bitLength >> (8 * i)));
+
+  for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      w[i] = (uint32_t(data[chunk + 4 * i]) << 24) | (uint32_t(data[chunk + 4 * i + 1]) << 16) |
+             (uint32_t(data[chunk + 4 * i + 2]) << 8) | uint32_t(data[chunk + 4 * i + 3]);
+    }
+    for (int i = 16; i < 80; i++) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotl(b, 30);
+      b = a;
+      a = temp;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  std::array<uint8_t, 20> digest;
+  for (int i = 0; i < 20; i++) digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - 8 * (i % 4)));
+  return digest;
+}
+
+string base64(const uint8_t* data, size_t n) {
+  const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  string out;
+  for (size_t i = 0; i < n; i += 3) {
+    uint32_t v = uint32_t(data[i]) << 16;
+    if (i + 1 < n) v |= uint32_t(data[i + 1]) << 8;
+    if (i + 2 < n) v |= uint32_t(data[i + 2]);
+    out += alphabet[(v >> 18) & 63];
+    out += alphabet[(v >> 12) & 63];
+    out += i + 1 < n ? alphabet[(v >> 6) & 63] : '=';
+    out += i + 2 < n ? alphabet[v & 63] : '=';
+  }
+  return out;
+}
+
+// == The web page
+
+const char* clientPage = R"HTML(<!DOCTYPE html>
+<html>
+<head>
+<meta charset="utf-8">
+<title>polyscope</title>
+<style>html, body { margin: 0; height: 100%; overflow: hidden; background: #000; } canvas { width: 100%; height: 100%; display: block; }</style>
+</head>
+<body>
+<canvas id="view"></canvas>
+<script>
+const canvas = document.getElementById("view");
+const ctx = canvas.getContext("2d");
+const socket = new WebSocket("ws://" + location.host + "/stream");
+socket.binaryType = "arraybuffer";
+
+function send(msg) { if (socket.readyState === 1) socket.send(JSON.stringify(msg)); }
+function sendSize() {
+  canvas.width = canvas.clientWidth * devicePixelRatio;
+  canvas.height = canvas.clientHeight * devicePixelRatio;
+  send({ resize: [canvas.width, canvas.height] });
+}
+socket.onopen = sendSize;
+window.onresize = sendSize;
+
+socket.onmessage = (msg) => {
+  const id = new DataView(msg.data).getUint32(0, true);
+  createImageBitmap(new Blob([msg.data.slice(4)], { type: "image/jpeg" })).then((img) => {
+    ctx.drawImage(img, 0, 0, canvas.width, canvas.height);
+    send({ ack: id });
+  });
+};
+
+function mouse(e, extra) {
+  const r = canvas.getBoundingClientRect();
+  const msg = { x: (e.clientX - r.left) / r.width, y: (e.clientY - r.top) / r.height, shift: e.shiftKey, ctrl: e.ctrlKey };
+  send(Object.assign(msg, extra));
+}
+const buttons = { 0: 0, 2: 1, 1: 2 };
+canvas.onmousemove = (e) => mouse(e, {});
+canvas.onmousedown = (e) => mouse(e, { button: buttons[e.button], pressed: true });
+canvas.onmouseup = (e) => mouse(e, { button: buttons[e.button], pressed: false });
+canvas.oncontextmenu = (e) => e.preventDefault();
+canvas.onwheel = (e) => { e.preventDefault(); mouse(e, { wheel: [-e.deltaX / 100, -e.deltaY / 100] }); };
+</script>
+</body>
+</html>
+)HTML";
+
+// == A minimal server for the page and a single WebSocket viewer. A new viewer replaces the previous one.
+
+class StreamServer {
+public:
+  ~StreamServer() {
+    closeViewer();
+    if (listenFd >= 0) close(listenFd);
+  }
+
+  // Listen on the IPv4 address given, e.g. "127.0.0.1" or "0.0.0.0" for every interface
+  bool listen(const string& address, int port) {
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) return false;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) return false;
+    int yes = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listenFd, 8) != 0) {
+      return false;
+    }
+    fcntl(listenFd, F_SETFL, O_NONBLOCK);
+    return true;
+  }
+
+  // Accept connections, answer requests, and pass the viewer's messages to onMessage. Called each frame, never blocks.
+  void poll(const std::function<void(const string&)>& onMessage) {
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd >= 0) {
+      if (requestFd >= 0) close(requestFd); // (one request at a time is plenty for a single viewer)
+      requestFd = fd;
+      requestBuffer.clear();
+      fcntl(requestFd, F_SETFL, O_NONBLOCK);
+    }
+    if (requestFd >= 0) readRequest();
+    if (viewerFd >= 0) readFrames(onMessage);
+  }
+
+  bool haveViewer() { return viewerFd >= 0; }
+
+  // Send a binary message to the viewer, from any thread. Returns false if there is no viewer or it went away.
+  bool sendBinary(const std::vector<uint8_t>& payload) {
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (viewerFd < 0) return false;
+    std::vector<uint8_t> frame{0x82}; // FIN, binary
+    size_t n = payload.size();
+    if (n < 126) {
+      frame.push_back(static_cast<uint8_t>(n));
+    } else if (n < 65536) {
+      frame.push_back(126);
+      frame.push_back(static_cast<uint8_t>(n >> 8));
+      frame.push_back(static_cast<uint8_t>(n));
+    } else {
+      frame.push_back(127);
+      for (int i = 7; i >= 0; i--) frame.push_back(static_cast<uint8_t>(static_cast<uint64_t>(n) >> (8 * i)));
+    }
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return sendAll(viewerFd, frame.data(), frame.size());
+  }
+
+  int viewerGeneration() { return generation; } // changes with each new viewer
+
+private:
+  // The browser only sends small requests and mouse events, anything larger is not from the page
+  static const size_t maxRequestBytes = 64 * 1024;
+  static const size_t maxFrameBytes = 64 * 1024;
+
+  int listenFd = -1;
+  int requestFd = -1; // a connection whose HTTP request is still being read
+  string requestBuffer;
+  std::atomic<int> viewerFd{-1};
+  std::atomic<int> generation{0};
+  std::vector<uint8_t> frameBuffer;
+  std::mutex sendMutex;
+
+  static bool sendAll(int fd, const uint8_t* data, size_t n) {
+    // (the viewer's socket is blocking, so this waits for a slow link rather than dropping part of a message)
+    while (n > 0) {
+      ssize_t sent = send(fd, data, n, MSG_NOSIGNAL);
+      if (sent <= 0) return false;
+      data += sent;
+      n -= sent;
+    }
+    return true;
+  }
+
+  void closeViewer() {
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (viewerFd >= 0) close(viewerFd);
+    viewerFd = -1;
+    frameBuffer.clear();
+  }
+
+  void readRequest() {
+    char buff[4096];
+    ssize_t n = recv(requestFd, buff, sizeof(buff), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      close(requestFd);
+      requestFd = -1;
+      return;
+    }
+    if (n > 0) requestBuffer.append(buff, n);
+    if (requestBuffer.find("\r\n\r\n") == string::npos) {
+      if (requestBuffer.size() > maxRequestBytes) {
+        close(requestFd);
+        requestFd = -1;
+      }
+      return;
+    }
+
+    // A WebSocket upgrade becomes the viewer, anything else gets the page
+    string key = headerValue("Sec-WebSocket-Key");
+    int fd = requestFd;
+    requestFd = -1;
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+    if (key.empty()) {
+      string body = clientPage;
+      string response = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: " + std::to_string(body.size()) +
+                        "\r\nConnection: close\r\n\r\n" + body;
+      sendAll(fd, reinterpret_cast<const uint8_t*>(response.data()), response.size());
+      close(fd);
+      return;
+    }
+
+    // Only the page served above may connect: browsers send the origin of the page opening a WebSocket, which must be
+    // this server as the browser reached it
+    string host = headerValue("Host");
+    if (host.empty() || headerValue("Origin") != "http://" + host) {
+      string response = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+      sendAll(fd, reinterpret_cast<const uint8_t*>(response.data()), response.size());
+      close(fd);
+      cerr << "refused a viewer from origin [" << headerValue("Origin") << "]" << endl;
+      return;
+    }
+
+    std::array<uint8_t, 20> digest = sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+    string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                      "Sec-WebSocket-Accept: " +
+                      base64(digest.data(), digest.size()) + "\r\n\r\n";
+    if (!sendAll(fd, reinterpret_cast<const uint8_t*>(response.data()), response.size())) {
+      close(fd);
+      return;
+    }
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    closeViewer();
+    viewerFd = fd;
+    generation++;
+    cout << "viewer connected" << endl;
+  }
+
+  string headerValue(const string& name) {
+    // (at the start of a line, so that e.g. Host does not match X-Forwarded-Host)
+    size_t pos = requestBuffer.find("\r\n" + name + ":");
+    if (pos == string::npos) return "";
+    pos += name.size() + 3;
+    size_t end = requestBuffer.find("\r\n", pos);
+    string value = requestBuffer.substr(pos, end - pos);
+    value.erase(0, value.find_first_not_of(' '));
+    value.erase(value.find_last_not_of(' ') + 1);
+    return value;
+  }
+
+  void readFrames(const std::function<void(const string&)>& onMessage) {
+    uint8_t buff[4096];
+    while (true) {
+      ssize_t n = recv(viewerFd, buff, sizeof(buff), MSG_DONTWAIT);
+      if (n > 0) {
+        // (handled as they arrive, so the buffer never holds more than one partial frame)
+        frameBuffer.insert(frameBuffer.end(), buff, buff + n);
+        if (!handleFrames(onMessage)) return;
+        continue;
+      }
+      if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        cout << "viewer disconnected" << endl;
+        closeViewer();
+        return;
+      }
+      break;
+    }
+  }
+
+  // Handle the complete frames in frameBuffer. Returns false if the viewer was closed.
+  bool handleFrames(const std::function<void(const string&)>& onMessage) {
+    // Messages from the browser are small, single frames, and always masked
+    while (frameBuffer.size() >= 2) {
+      int opcode = frameBuffer[0] & 0x0F;
+      uint64_t len = frameBuffer[1] & 0x7F; // (64 bits as sent, checked against the cap before it is used)
+      size_t header = 2;
+      if (len == 126) {
+        if (frameBuffer.size() < 4) return true;
+        len = (uint64_t(frameBuffer[2]) << 8) | frameBuffer[3];
+        header = 4;
+      } else if (len == 127) {
+        if (frameBuffer.size() < 10) return true;
+        len = 0;
+        for (int i = 0; i < 8; i++) len = (len << 8) | frameBuffer[2 + i];
+        header = 10;
+      }
+      if (len > maxFrameBytes || (opcode >= 0x8 && len > 125)) {
+        cout << "viewer sent an oversized message, disconnecting" << endl;
+        closeViewer();
+        return false;
+      }
+      bool masked = frameBuffer[1] & 0x80;
+      size_t maskStart = header;
+      if (masked) header += 4;
+      if (frameBuffer.size() < header || len > frameBuffer.size() - header) return true;
+
+      size_t end = header + static_cast<size_t>(len);
+      string payload(frameBuffer.begin() + header, frameBuffer.begin() + end);
+      if (masked) {
+        for (size_t i = 0; i < payload.size(); i++) payload[i] ^= frameBuffer[maskStart + i % 4];
+      }
+      frameBuffer.erase(frameBuffer.begin(), frameBuffer.begin() + end);
+
+      if (opcode == 0x1) {
+        onMessage(payload);
+      } else if (opcode == 0x8) {
+        cout << "viewer disconnected" << endl;
+        closeViewer();
+        return false;
+      } else if (opcode == 0x9) {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        std::vector<uint8_t> pong{0x8A, static_cast<uint8_t>(payload.size())};
+        pong.insert(pong.end(), payload.begin(), payload.end());
+        sendAll(viewerFd, pong.data(), pong.size());
+      }
+    }
+    return true;
+  }
+};
+
+// == Encoding, and adapting the quality to the link
+
+struct StreamSettings {
+  int maxQuality = 85;
+  int minQuality = 30;
+  float minScale = 0.25;
+  int maxFramesInFlight = 2;
+  double targetFrameSeconds = 1. / 30.;
+};
+
+class FrameEncoder {
+public:
+  FrameEncoder(StreamServer& server_, StreamSettings settings_)
+      : server(server_), settings(settings_), quality(settings_.maxQuality) {}
+
+  // The recording sink: runs on the recording thread, for each frame in which the scene was redrawn
+  void encode(const std::vector<unsigned char>& rgba, int w, int h) {
+    if (!server.haveViewer()) return;
+    if (framesInFlight >= settings.maxFramesInFlight) {
+      frameSkipped = true; // (sent once the viewer catches up, see onAck())
+      return;
+    }
+
+    // Once the view settles, the last frame is sent again at full quality
+    bool refine = refineRequested.exchange(false);
+    int q = refine ? settings.maxQuality : quality.load();
+    float s = refine ? 1.f : scale.load();
+
+    // Skip frames which look the same as the last one sent
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+      hash = (hash ^ (uint64_t(rgba[i]) | uint64_t(rgba[i + 1]) << 8 | uint64_t(rgba[i + 2]) << 16)) * 1099511628211ull;
+    }
+    int generation = server.viewerGeneration();
+    if (hash == lastHash && q == lastQuality && s == lastScale && generation == lastGeneration) return;
+    if (hash != lastHash) lastChange = Clock::now();
+
+    // Scale down with a box filter, flip to top-to-bottom rows, and drop alpha
+    int step = std::max(1, static_cast<int>(std::lround(1. / s)));
+    int outW = std::max(1, w / step);
+    int outH = std::max(1, h / step);
+    rgb.resize(3 * static_cast<size_t>(outW) * outH);
+    for (int y = 0; y < outH; y++) {
+      for (int x = 0; x < outW; x++) {
+        unsigned int sum[3] = {0, 0, 0};
+        for (int dy = 0; dy < step; dy++) {
+          const unsigned char* row = &rgba[4 * (static_cast<size_t>(h - 1 - (y * step + dy)) * w + x * step)];
+          for (int dx = 0; dx < step; dx++) {
+            for (int c = 0; c < 3; c++) sum[c] += row[4 * dx + c];
+          }
+        }
+        for (int c = 0; c < 3; c++) {
+          rgb[3 * (static_cast<size_t>(y) * outW + x) + c] = static_cast<unsigned char>(sum[c] / (step * step));
+        }
+      }
+    }
+
+    // The message is the frame id, then the JPEG
+    uint32_t id = nextId++;
+    std::vector<uint8_t> message(4);
+    for (int i = 0; i < 4; i++) message[i] = static_cast<uint8_t>(id >> (8 * i));
+    stbi_write_jpg_to_func(
+        [](void* context, void* data, int size) {
+          std::vector<uint8_t>& out = *static_cast<std::vector<uint8_t>*>(context);
+          out.insert(out.end(), static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + size);
+        },
+        &message, outW, outH, 3, rgb.data(), q);
+
+    {
+      std::lock_guard<std::mutex> lock(timesMutex);
+      sendTimes[id] = Clock::now();
+    }
+    framesInFlight++;
+    if (!server.sendBinary(message)) {
+      framesInFlight = 0;
+      return;
+    }
+    lastHash = hash;
+    lastQuality = q;
+    lastScale = s;
+    lastGeneration = generation;
+    lastSentDegraded = q < settings.maxQuality || s < 1.f;
+  }
+
+  // The viewer has shown frame id. Called from the main thread.
+  void onAck(uint32_t id) {
+    Clock::time_point sent;
+    {
+      std::lock_guard<std::mutex> lock(timesMutex);
+      auto it = sendTimes.find(id);
+      if (it == sendTimes.end()) return;
+      sent = it->second;
+      sendTimes.erase(sendTimes.begin(), std::next(it));
+    }
+    framesInFlight = std::max(0, framesInFlight - 1);
+    double seconds = std::chrono::duration<double>(Clock::now() - sent).count();
+
+    // Back off quickly when frames take much longer than the frame rate allows, recover slowly when they are quick.
+    // Quality goes first, then resolution.
+    if (seconds > 3. * settings.targetFrameSeconds) {
+      quickFrames = 0;
+      if (quality > settings.minQuality) {
+        quality = std::max(settings.minQuality, quality - 10);
+      } else {
+        scale = std::max(settings.minScale, scale * 0.75f);
+      }
+    } else if (seconds < settings.targetFrameSeconds && ++quickFrames >= 10) {
+      quickFrames = 0;
+      if (scale < 1.f) {
+        scale = std::min(1.f, scale / 0.75f);
+      } else {
+        quality = std::min(settings.maxQuality, quality + 5);
+      }
+    }
+
+    if (frameSkipped.exchange(false)) {
+      polyscope::requestRedraw();
+    }
+  }
+
+  // Called each frame from the main thread: once the view has not changed for a moment, send it at full quality
+  void update() {
+    if (framesInFlight > 0 || !lastSentDegraded) return;
+    if (std::chrono::duration<double>(Clock::now() - lastChange.load()).count() < 0.3) return;
+    lastSentDegraded = false;
+    refineRequested = true;
+    polyscope::requestRedraw();
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> lock(timesMutex);
+    sendTimes.clear();
+    framesInFlight = 0;
+  }
+
+private:
+  StreamServer& server;
+  const StreamSettings settings;
+
+  std::atomic<int> quality;
+  std::atomic<float> scale{1.f};
+  int quickFrames = 0;
+  std::atomic<int> framesInFlight{0};
+  std::atomic<bool> frameSkipped{false};
+  std::atomic<bool> refineRequested{false};
+  std::atomic<bool> lastSentDegraded{false};
+  std::atomic<Clock::time_point> lastChange{Clock::now()};
+
+  // (only touched by the recording thread)
+  uint32_t nextId = 0;
+  uint64_t lastHash = 0;
+  int lastQuality = -1;
+  float lastScale = -1.;
+  int lastGeneration = -1;
+  std::vector<unsigned char> rgb;
+
+  std::mutex timesMutex;
+  std::map<uint32_t, Clock::time_point> sendTimes;
+};
+
+// Apply a message from the viewer
+void handleMessage(const string& text, FrameEncoder& encoder) {
+  nlohmann::json msg;
+  try {
+    msg = nlohmann::json::parse(text);
+  } catch (const std::exception&) {
+    return;
+  }
+  if (!msg.is_object()) return;
+
+  if (msg.count("ack")) {
+    encoder.onAck(msg["ack"].get<uint32_t>());
+    return;
+  }
+
+  if (msg.count("resize")) {
+    int w = msg["resize"][0].get<int>();
+    int h = msg["resize"][1].get<int>();
+    if (w > 0 && h > 0 && w <= 8192 && h <= 8192) {
+      polyscope::view::windowWidth = w; // (the headless backend resizes its buffers to match at the next frame)
+      polyscope::view::windowHeight = h;
+      polyscope::requestRedraw();
+    }
+    return;
+  }
+
+  // Mouse events, with positions relative to the viewer's canvas
+  polyscope::render::InputEvent e;
+  if (msg.count("x") && msg.count("y")) {
+    e.mousePos = glm::vec2{msg["x"].get<float>() * polyscope::view::windowWidth,
+                           msg["y"].get<float>() * polyscope::view::windowHeight};
+  }
+  if (msg.count("button")) {
+    e.button = msg["button"].get<int>();
+    e.pressed = msg.value("pressed", false);
+  }
+  if (msg.count("wheel")) {
+    e.wheel = glm::vec2{msg["wheel"][0].get<float>(), msg["wheel"][1].get<float>()};
+  }
+  e.shift = msg.value("shift", false);
+  e.ctrl = msg.value("ctrl", false);
+  polyscope::render::engine->queueInputEvent(e);
+}
+
+void addDemoScene() {
+  std::vector<glm::vec3> points;
+  for (int i = 0; i < 20000; i++) {
+    float t = 0.01f * i;
+    points.push_back(glm::vec3{std::cos(t) * (1.f + 0.3f * std::cos(7.f * t)), 0.3f * std::sin(7.f * t),
+                               std::sin(t) * (1.f + 0.3f * std::cos(7.f * t))});
+  }
+  polyscope::registerPointCloud("torus knot", points)->setPointRadius(0.002);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  args::ArgumentParser parser("Stream the view of a headless polyscope session to a web browser.", "");
+  args::PositionalList<string> files(parser, "files", "Meshes to show (a demo scene if none)");
+  args::ValueFlag<int> port(parser, "port", "The port to serve on (default 8080)", {'p', "port"});
+  args::ValueFlag<string> bindAddress(parser, "address",
+                                      "The IPv4 address to listen on (default 127.0.0.1). Anyone who can reach it "
+                                      "drives the viewer, so only use 0.0.0.0 on a trusted network",
+                                      {"bind"});
+  args::ValueFlag<int> fps(parser, "fps", "The frame rate to aim for (default 30)", {"fps"});
+  args::ValueFlag<int> maxQuality(parser, "q", "The JPEG quality on a fast link, 1-100 (default 85)", {"max-quality"});
+  args::ValueFlag<string> backend(parser, "backend", "The rendering backend to use (default openGL3_egl)",
+                                  {'b', "backend"});
+
+  try {
+    parser.ParseCLI(argc, argv);
+  } catch (const args::Help&) {
+    cout << parser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    cerr << e.what() << endl;
+    cerr << parser;
+    return 1;
+  }
+
+  StreamSettings settings;
+  int targetFPS = fps ? std::max(1, args::get(fps)) : 30;
+  settings.targetFrameSeconds = 1. / targetFPS;
+  if (maxQuality) settings.maxQuality = std::min(100, std::max(settings.minQuality, args::get(maxQuality)));
+
+  StreamServer server;
+  int portNum = port ? args::get(port) : 8080;
+  string address = bindAddress ? args::get(bindAddress) : "127.0.0.1";
+  if (!server.listen(address, portNum)) {
+    cerr << "could not listen on " << address << " port " << portNum << endl;
+    return 1;
+  }
+
+  // The panels are not streamed, so they should not take the viewer's mouse either
+  polyscope::options::buildGui = false;
+  polyscope::options::maxFPS = targetFPS;
+  polyscope::options::usePrefsFile = false;
+  polyscope::init(backend ? args::get(backend) : "openGL3_egl");
+
+  if (files) {
+    for (const string& f : args::get(files)) {
+      std::vector<std::array<double, 3>> vertices;
+      std::vector<std::vector<size_t>> faces;
+      polyscope::loadPolygonSoup(f, vertices, faces);
+      polyscope::registerSurfaceMesh(f, vertices, faces);
+    }
+  } else {
+    addDemoScene();
+  }
+
+  FrameEncoder encoder(server, settings);
+  int viewerGeneration = -1;
+  polyscope::startRecording(
+      [&](const std::vector<unsigned char>& rgba, int w, int h) { encoder.encode(rgba, w, h); });
+
+  polyscope::state::userCallback = [&]() {
+    server.poll([&](const string& msg) { handleMessage(msg, encoder); });
+    if (server.viewerGeneration() != viewerGeneration) {
+      viewerGeneration = server.viewerGeneration();
+      encoder.reset();
+      polyscope::requestRedraw(); // (send the new viewer the current view)
+    }
+    encoder.update();
+  };
+
+  cout << "serving on http://" << (address == "127.0.0.1" ? string("localhost") : address) << ":" << portNum << "/"
+       << endl;
+  polyscope::show();
+
+  polyscope::stopRecording();
+  return 0;
+}
@@ -36,6 +36,10 @@ struct FIELD_MAG {
   typedef double type;
 };
 template <>
+struct FIELD_MAG<float> {
+  typedef float type;
+};
+template <>
 struct FIELD_MAG<glm::vec3> {
   typedef float type;
 };
@@ -45,6 +49,19 @@ template <typename T>
 std::pair<typename FIELD_MAG<T>::type, typename FIELD_MAG<T>::type>
 robustMinMax(const std::vector<T>& data, typename FIELD_MAG<T>::type rangeEPS = 1e-12);
 
+// The same for plain scalars, as a branch-free (vectorizable) reduction spread over the worker threads
+std::pair<float, float> robustMinMax(const std::vector<float>& data, float rangeEPS = 1e-12);
+std::pair<double, double> robustMinMax(const std::vector<double>& data, double rangeEPS = 1e-12);
+
+// Approximate values at the given percentiles (in [0, 100]) of the finite data, e.g. 1 and 99 for a range which ignores
+// outliers. Computed in one pass without sorting: values are counted in 2^16 bins by the high bits of their float
+// representation, so each bin spans under 1% of the magnitude of its values, and the result is interpolated within the
+// bin. Returns (-1, 1) if there is no finite data, like robustMinMax().
+std::pair<double, double> approximatePercentileRange(const std::vector<float>& data, double lowPercentile,
+                                                     double highPercentile);
+std::pair<double, double> approximatePercentileRange(const std::vector<double>& data, double lowPercentile,
+                                                     double highPercentile);
+
 
 // Map data in to the range [0,1]
 template <typename T>
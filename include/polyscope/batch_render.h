@@ -0,0 +1,43 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// Rendering many images of a few scenes in one process, e.g. for nightly image sets, rather than starting a process
+// (and paying for init() and the uploads) per image. Consecutive jobs of the same scene file keep the scene loaded, so
+// its buffers stay on the GPU and each image only renders. Images are read back and written asynchronously, as with
+// options::asyncScreenshots.
+//
+// To use several GPUs, start one process per GPU with the headless openGL3_egl backend and its own
+// options::eglDeviceIndex, and have each call renderJobs() with the same job list and its own worker index. The jobs
+// are split between the workers the same way in every process, keeping the jobs of a scene together where the split
+// allows.
+struct RenderJob {
+  std::string sceneFile;       // written by saveScene(); empty renders the structures already registered
+  std::string cameraJson;      // as for view::setCameraFromJson(), or empty to keep the camera
+  std::function<void()> setup; // e.g. enabling the quantities to show; settings carry over to the next job
+  std::string outputFile;      // the image to write, as for screenshot()
+  bool transparentBG = false;
+};
+
+struct RenderJobTiming {
+  size_t jobIndex = 0;  // in the list passed to renderJobs()
+  double loadMs = 0.;   // loading the scene, 0 when the previous job had loaded it already
+  double setupMs = 0.;  // the camera and the setup function
+  double renderMs = 0.; // rendering and starting the readback
+  std::string error;    // why the job was skipped, if it was
+};
+
+// The jobs worker workerIndex of nWorkers renders, in the order it renders them
+std::vector<size_t> assignRenderJobs(const std::vector<RenderJob>& jobs, int workerIndex, int nWorkers);
+
+// Render this worker's jobs, and return their timings once all of the images are written. Jobs whose scene can not be
+// loaded are skipped, with the reason in their timing.
+std::vector<RenderJobTiming> renderJobs(const std::vector<RenderJob>& jobs, int workerIndex = 0, int nWorkers = 1);
+
+} // namespace polyscope
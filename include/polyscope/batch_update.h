@@ -0,0 +1,50 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <functional>
+
+namespace polyscope {
+
+// Batches the registration of many quantities, e.g. the hundreds of fields a loader reads for one mesh. Between
+// beginBatch() and endBatch(), add*Quantity() stores the data, but the preprocessing of each quantity (the robust data
+// range, percentile clipping, default isoline width) is queued; endBatch() then runs all of it at once, in parallel
+// over the quantities. Batches may be nested, the queue runs when the outermost one ends.
+//
+// Quantities added in a batch can be used as usual: asking one of them for its map range runs its own preprocessing
+// first, and drawing a frame runs everything queued so far.
+//
+// Likewise, registering or removing structures in a batch defers the recomputation of the scene extents
+// (state::lengthScale, state::boundingBox) to its end, so loading or clearing many structures stays linear in their
+// number. Until then the extents are those from before the batch.
+void beginBatch();
+void endBatch();
+bool isInBatch();
+
+// A scope which batches everything registered while it is alive, as beginBatch() / endBatch()
+//   { polyscope::BatchUpdate batch; for (...) mesh->addVertexScalarQuantity(...); }
+class BatchUpdate {
+public:
+  BatchUpdate() { beginBatch(); }
+  ~BatchUpdate() { endBatch(); }
+  BatchUpdate(const BatchUpdate&) = delete;
+  BatchUpdate& operator=(const BatchUpdate&) = delete;
+};
+
+namespace batch {
+
+// Used by quantities for their preprocessing. work must only touch the owner's own members, so that the work of several
+// owners can run concurrently; finish runs afterwards on the calling thread (persistent values, redraws). Outside of a
+// batch both run immediately.
+void runOrDefer(const void* owner, std::function<void()> work, std::function<void()> finish);
+
+// Run the queued preprocessing of one owner now, if it has any (before reading its results)
+void runDeferred(const void* owner);
+
+// Drop the queued preprocessing of one owner, if any (it is being deleted)
+void cancelDeferred(const void* owner);
+
+// Run everything queued so far, even inside of a batch. Called at the end of a batch, and before drawing.
+void runAllDeferred();
+
+} // namespace batch
+} // namespace polyscope
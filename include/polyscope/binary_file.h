@@ -0,0 +1,146 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace polyscope {
+namespace internal {
+
+// The reading and writing of Polyscope's binary files (scene files and session files). Every value is written in the
+// byte order of the machine, and strings and arrays are prefixed with their length as a uint64. With alignArrays, the
+// contents of every array start at a multiple of 8 bytes from the start of the output, so the arrays of a loaded file
+// can be used in place. fileKind names the file in errors, e.g. "scene file".
+
+class BinaryWriter {
+public:
+  // Keep the output in data
+  BinaryWriter(bool alignArrays_ = false) : alignArrays(alignArrays_) {}
+
+  // Write the output to a file
+  BinaryWriter(const std::string& filename, const std::string& fileKind_, bool alignArrays_ = false)
+      : out(filename, std::ios::binary), toFile(true), alignArrays(alignArrays_), fileKind(fileKind_) {
+    if (!out) throw std::runtime_error("Could not open " + fileKind + " " + filename + " for writing");
+  }
+
+  template <typename T>
+  void value(const T& v) {
+    bytes(&v, sizeof(T));
+  }
+
+  void string(const std::string& s) {
+    value<uint64_t>(s.size());
+    bytes(s.data(), s.size());
+  }
+
+  template <typename T>
+  void array(const std::vector<T>& v) {
+    value<uint64_t>(v.size());
+    if (alignArrays) {
+      static const char zeros[8] = {};
+      bytes(zeros, (8 - offset % 8) % 8);
+    }
+    bytes(v.data(), v.size() * sizeof(T));
+  }
+
+  // The output of another writer, which must be unaligned or aligned the same
+  void append(const BinaryWriter& other) { bytes(other.data.data(), other.data.size()); }
+
+  // Check that all of the output made it to the file
+  void finish() {
+    out.flush();
+    if (!out) throw std::runtime_error("Could not write " + fileKind);
+  }
+
+  std::vector<char> data; // the output, for a writer which is not writing to a file (may be cleared once used)
+
+private:
+  void bytes(const void* src, size_t n) {
+    const char* c = static_cast<const char*>(src);
+    if (toFile) {
+      out.write(c, n);
+    } else {
+      data.insert(data.end(), c, c + n);
+    }
+    offset += n;
+  }
+
+  std::ofstream out;
+  bool toFile = false;
+  bool alignArrays;
+  std::string fileKind;
+  size_t offset = 0; // bytes written so far
+};
+
+class BinaryReader {
+public:
+  BinaryReader(const std::string& filename, const std::string& fileKind_, bool alignArrays_ = false)
+      : alignArrays(alignArrays_), fileKind(fileKind_) {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in) throw std::runtime_error("Could not open " + fileKind + " " + filename);
+    data.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(data.data(), data.size());
+    if (!in) throw std::runtime_error("Could not read " + fileKind + " " + filename);
+  }
+
+  // Read the output of a BinaryWriter, or an array of one
+  BinaryReader(std::vector<char> data_, const std::string& fileKind_, bool alignArrays_ = false)
+      : data(std::move(data_)), alignArrays(alignArrays_), fileKind(fileKind_) {}
+
+  bool atEnd() const { return offset == data.size(); }
+
+  template <typename T>
+  T value() {
+    T v;
+    bytes(&v, sizeof(T));
+    return v;
+  }
+
+  std::string string() {
+    size_t n = value<uint64_t>();
+    check(n);
+    std::string s(data.data() + offset, n);
+    offset += n;
+    return s;
+  }
+
+  template <typename T>
+  std::vector<T> array() {
+    size_t n = value<uint64_t>();
+    if (alignArrays) {
+      check((8 - offset % 8) % 8);
+      offset += (8 - offset % 8) % 8;
+    }
+    if (n > (data.size() - offset) / std::max<size_t>(sizeof(T), 1)) truncated();
+    std::vector<T> v(n);
+    bytes(v.data(), n * sizeof(T));
+    return v;
+  }
+
+private:
+  void check(size_t n) {
+    if (n > data.size() - offset) truncated();
+  }
+  void truncated() { throw std::runtime_error("The " + fileKind + " is truncated"); }
+  void bytes(void* target, size_t n) {
+    check(n);
+    std::memcpy(target, data.data() + offset, n);
+    offset += n;
+  }
+
+  std::vector<char> data;
+  size_t offset = 0;
+  bool alignArrays;
+  std::string fileKind;
+};
+
+} // namespace internal
+} // namespace polyscope
@@ -0,0 +1,55 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/camera_parameters.h"
+#include "polyscope/frame_stats.h"
+
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// A camera moving smoothly through keyframes, e.g. for a scripted walkthrough of a scene. Positions and fields of view
+// follow Catmull-Rom splines through the keyframes, and orientations a spherical spline, so the camera passes each
+// keyframe without stopping.
+class CameraPath {
+public:
+  struct Keyframe {
+    CameraParameters camera;
+    double time; // seconds from the start of the path
+  };
+
+  // Keyframes are kept sorted by time; one at the time of an existing keyframe replaces it
+  void addKeyframe(const CameraParameters& camera, double time);
+  void addCurrentViewAsKeyframe(double time);
+  const std::vector<Keyframe>& getKeyframes() const { return keyframes; }
+  void clear() { keyframes.clear(); }
+
+  double getDuration() const; // time of the last keyframe
+  CameraParameters evaluate(double time) const; // (clamped to the path, and the identity if there are no keyframes)
+
+private:
+  std::vector<Keyframe> keyframes;
+};
+
+enum class CameraPathPlayback {
+  RealTime, // follow the wall clock, skipping ahead when frames are slow
+  FixedStep // advance exactly 1/fps seconds of the path per main loop iteration, for repeatable runs
+};
+
+// Move the main view's camera along the path, starting now. With recordTo set, the playback is recorded as by
+// startRecording(recordTo, fps), stopping at the end of the path; in FixedStep mode the video has exactly one frame per
+// step. The frame statistics (see getFrameStats()) are reset at the start, so that getCameraPathFrameStats() covers
+// just the playback if options::enableCPUProfiling is set.
+void playCameraPath(const CameraPath& path, CameraPathPlayback mode = CameraPathPlayback::RealTime, double fps = 30.,
+                    std::string recordTo = "");
+void stopCameraPath();
+bool isPlayingCameraPath();
+double getCameraPathTime();           // of the frame being drawn
+size_t getCameraPathFrame();          // frames of the playback so far, counting the one being drawn
+FrameStats getCameraPathFrameStats(); // the frame statistics of the last playback, as of its end
+
+// Set the camera for this frame of the playback, if any (called by the main loop each iteration)
+void updateCameraPath();
+
+} // namespace polyscope
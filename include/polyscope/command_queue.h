@@ -0,0 +1,36 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace polyscope {
+
+// Hands work to the main thread from other threads, e.g. a simulation thread publishing its state every step. The rest
+// of the API may only be called from the main thread; these functions may be called from any thread, and never block.
+//
+// Queued commands run on the main thread at the start of the next frame, in the order they were queued. A command
+// with a coalescing key supersedes the commands with the same key still waiting, so a producer faster than the frame
+// rate only has its latest update applied.
+void queueCommand(std::function<void()> command, std::string coalesceKey = "");
+
+// Like queueCommand(), but moves `data` in to the queue and calls apply(data) with it on the main thread, so large
+// arrays are not copied on the way:
+//   polyscope::queueUpdate(std::move(positions), [](std::vector<glm::vec3>& p) {
+//     polyscope::getSurfaceMesh("sim")->updateVertexPositions(p);
+//   }, "sim positions");
+template <typename T, typename F>
+void queueUpdate(T&& data, F apply, std::string coalesceKey = "") {
+  typedef typename std::decay<T>::type DataT;
+  std::shared_ptr<DataT> held = std::make_shared<DataT>(std::forward<T>(data));
+  queueCommand([held, apply]() { apply(*held); }, std::move(coalesceKey));
+}
+
+// Run the queued commands now. Called each frame by polyscope; only programs which never draw need to call it.
+// (main thread only)
+void runQueuedCommands();
+
+} // namespace polyscope
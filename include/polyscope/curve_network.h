@@ -3,7 +3,10 @@
 
 #include "polyscope/affine_remapper.h"
 #include "polyscope/color_management.h"
+#include "polyscope/curve_network_lod.h"
 #include "polyscope/curve_network_quantity.h"
+#include "polyscope/dirty_ranges.h"
+#include "polyscope/element_bvh.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/render/engine.h"
 #include "polyscope/standardize_data_array.h"
@@ -56,6 +59,7 @@ public:
 
   virtual void updateObjectSpaceBounds() override;
   virtual std::string typeName() override;
+  virtual size_t hostMemoryUsage() override;
 
   virtual void refresh() override;
 
@@ -107,8 +111,19 @@ public:
   // Small utilities
   void setCurveNetworkNodeUniforms(render::ShaderProgram& p);
   void setCurveNetworkEdgeUniforms(render::ShaderProgram& p);
-  void fillEdgeGeometryBuffers(render::ShaderProgram& program);
-  void fillNodeGeometryBuffers(render::ShaderProgram& program);
+  // (withRoom pads the buffers to the capacity reserved for appends, it is only for the network's own programs)
+  void fillEdgeGeometryBuffers(render::ShaderProgram& program, bool withRoom = false);
+  void fillNodeGeometryBuffers(render::ShaderProgram& program, bool withRoom = false);
+  void fillStripGeometryBuffers(render::ShaderProgram& program); // node positions once, and edges as index pairs
+  // (rewrite the positions of just some edges/nodes, in a program filled by the above)
+  void updateEdgeGeometryBuffers(render::ShaderProgram& program,
+                                 const std::vector<std::pair<size_t, size_t>>& edgeRanges);
+  void updateNodeGeometryBuffers(render::ShaderProgram& program,
+                                 const std::vector<std::pair<size_t, size_t>>& nodeRanges);
+  // The drawn node positions (resp. edge end positions), as buffers shared by the programs of all quantities, which
+  // only add buffers of their own values. Filled on first use; the network keeps them current as nodes move.
+  void setNodeGeometryAttributes(render::ShaderProgram& program);
+  void setEdgeGeometryAttributes(render::ShaderProgram& program);
   std::vector<std::string> addCurveNetworkNodeRules(std::vector<std::string> initRules);
   std::vector<std::string> addCurveNetworkEdgeRules(std::vector<std::string> initRules);
 
@@ -118,6 +133,20 @@ public:
   template <class V>
   void updateNodePositions2D(const V& newPositions);
 
+  // Move only some nodes, newPositions[i] is the new position of node indices[i]. Only the affected spans of the node
+  // and edge buffers are uploaded, once per frame.
+  template <class V>
+  void updateNodePositions(const std::vector<size_t>& indices, const V& newPositions);
+
+  // === Streaming
+  // Grow the network as data arrives. Appended nodes take the next indices, and appended edges may refer to any node
+  // added so far. The buffers of the network's own programs are allocated with room to grow, so most appends only
+  // upload the new elements; quantities can not follow and are removed.
+  template <class V>
+  CurveNetwork* appendNodes(const V& newNodes);
+  template <class E>
+  CurveNetwork* appendEdges(const E& newEdges);
+
   // === Get/set visualization parameters
 
   // set the base color of the points
@@ -128,16 +157,40 @@ public:
   CurveNetwork* setRadius(float newVal, bool isRelative = true);
   float getRadius();
 
+  // How the network is drawn in its own color. Cylinders draws a cylinder per edge and a sphere per node. Tubes and
+  // Lines instead upload each node once and draw the edges from index pairs, either as cylinders with rounded ends
+  // (which close the joints without node spheres) or as one-pixel lines. Quantities and picking always draw cylinders.
+  CurveNetwork* setCurveRenderMode(CurveRenderMode newVal);
+  CurveRenderMode getCurveRenderMode();
+
   // Material
   CurveNetwork* setMaterial(std::string name);
   std::string getMaterial();
 
+  // Level of detail: draw each chain of the network (a run of edges through nodes of degree two) simplified for the
+  // view, from Douglas-Peucker errors computed on the first draw (see CurveNetworkLOD). Branching and end nodes are
+  // always drawn. Quantities on nodes and edges are drawn on the same simplification; vector quantities and picking use
+  // the full network.
+  CurveNetwork* setLODEnabled(bool newVal);
+  bool getLODEnabled();
+  CurveNetwork* setLODMaxPixelError(float newVal); // how far a dropped node may be from the drawn curve, on screen
+  float getLODMaxPixelError();
+  size_t nDrawnNodes(); // the number of nodes (resp. edges) in the buffers: all of them, or the current simplification
+  size_t nDrawnEdges();
+  const std::vector<uint32_t>* drawnNodeIndices(); // the nodes in the buffers, or nullptr for all of them in order
+  const std::vector<uint32_t>* drawnEdgeIndices(); // for each drawn edge, one of the edges it stands in for, or nullptr
+  std::array<size_t, 2> drawnEdge(size_t iDrawn);  // the end nodes of a drawn edge
+
+  virtual std::string drawBatchKey() override;
+  virtual bool drawsInDepthPrepass() override;
+
 
 private:
   // === Visualization parameters
   PersistentValue<glm::vec3> color;
   PersistentValue<ScaledValue<float>> radius;
   PersistentValue<std::string> material;
+  PersistentValue<std::string> curveRenderMode;
 
 
   // Drawing related things
@@ -146,14 +199,58 @@ private:
   std::shared_ptr<render::ShaderProgram> nodeProgram;
   std::shared_ptr<render::ShaderProgram> edgePickProgram;
   std::shared_ptr<render::ShaderProgram> nodePickProgram;
+  std::shared_ptr<render::ShaderProgram> stripProgram; // edges and nodes together, for the Tubes and Lines modes
+  render::ShaderUniformHandle edgeBaseColorHandle, nodeBaseColorHandle,
+      stripBaseColorHandle; // resolved when the programs are created
+
+  // Nodes which moved since the buffers were last uploaded; draw() and drawPick() flush them, along with their edges
+  DirtyRanges dirtyNodes;     // for the node & edge programs, and the quantities
+  DirtyRanges pickDirtyNodes; // for the pick programs
+  void flushGeometryUpdates();
+  std::vector<std::pair<size_t, size_t>> edgeRangesForNodes(const std::vector<std::pair<size_t, size_t>>& nodeRanges);
+
+  // Level of detail
+  PersistentValue<bool> lodEnabled;
+  float lodMaxPixelError = 1.;
+  std::unique_ptr<CurveNetworkLOD> lodHierarchy; // built on the first draw with LOD enabled, dropped when nodes move
+  CurveNetworkLOD::Selection lodSelection;
+  bool lodActive = false; // is lodSelection what the buffers hold, rather than the full network?
+  bool lodSelectionValid = false;
+  size_t lodSelectionSceneRender = 0; // state::sceneRenderCount when last checked
+  void updateLODSelection();          // (at most once per frame)
+  void lodSelectionChanged();         // drop every buffer which was filled for the old selection
+  void dropLOD();                     // back to the full network, until the next draw rebuilds the hierarchy
+
+  // CPU picking, with the nodes as spheres followed by the edges as cylinders, so that elements have their pick index
+  std::unique_ptr<ElementBVH> pickBVH; // built on the first query, dropped when nodes move
+  virtual bool rayCastElementObjectSpace(glm::vec3 rayStart, glm::vec3 rayDir, float objectScale, float& tHit,
+                                         size_t& localPickInd) override;
+  virtual bool closestElementObjectSpace(glm::vec3 point, float objectScale, float& dist,
+                                         size_t& localPickInd) override;
+  void ensurePickBVH();
 
   // === Helpers
 
   // Do setup work related to drawing, including allocating openGL data
   void prepare();
+  void prepareStrip();
   void preparePick();
 
   void geometryChanged();
+  void updateNodePositionsImpl(const std::vector<size_t>& indices, const std::vector<glm::vec3>& newPositions);
+
+  // Streaming. Once something was appended, the buffers of the network's own programs hold this many elements, of
+  // which the first nNodes() (resp. nEdges()) are drawn.
+  size_t nodeCapacity = 0;
+  size_t edgeCapacity = 0;
+  void appendNodesImpl(const std::vector<glm::vec3>& newNodes);
+  void appendEdgesImpl(const std::vector<std::array<size_t, 2>>& newEdges);
+  void appendedElements(size_t oldNNodes, size_t oldNEdges); // drops what is stale, and uploads or reallocates
+  void setStripIndex(render::ShaderProgram& program);
+  void setNodePositions(render::ShaderProgram& program, bool withRoom); // all of the nodes, in order
+  void edgeEndPositions(size_t start, size_t end, std::vector<glm::vec3>& tails, std::vector<glm::vec3>& tips);
+  std::shared_ptr<render::AttributeBuffer> nodePositionBuffer, edgeTailBuffer,
+      edgeTipBuffer; // see setNodeGeometryAttributes(), dropped when the drawn elements change
 
   // Pick helpers
   void buildNodePickUI(size_t nodeInd);
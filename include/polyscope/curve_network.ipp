@@ -117,10 +117,28 @@ CurveNetwork* registerCurveNetworkLoop2D(std::string name, const P& nodes) {
 
 template <class V>
 void CurveNetwork::updateNodePositions(const V& newPositions) {
+  validateSize(newPositions, nNodes(), "curve network updated node positions " + name);
   nodes = standardizeVectorArray<glm::vec3, 3>(newPositions);
   geometryChanged();
 }
 
+template <class V>
+void CurveNetwork::updateNodePositions(const std::vector<size_t>& indices, const V& newPositions) {
+  validateSize(newPositions, indices.size(), "curve network updated node positions " + name);
+  updateNodePositionsImpl(indices, standardizeVectorArray<glm::vec3, 3>(newPositions));
+}
+
+template <class V>
+CurveNetwork* CurveNetwork::appendNodes(const V& newNodes) {
+  appendNodesImpl(standardizeVectorArray<glm::vec3, 3>(newNodes));
+  return this;
+}
+
+template <class E>
+CurveNetwork* CurveNetwork::appendEdges(const E& newEdges) {
+  appendEdgesImpl(standardizeVectorArray<std::array<size_t, 2>, 2>(newEdges));
+  return this;
+}
 
 template <class V>
 void CurveNetwork::updateNodePositions2D(const V& newPositions2D) {
@@ -18,6 +18,9 @@ public:
   virtual std::string niceName() override;
 
   virtual void refresh() override;
+  virtual void dataUpdated() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& nodeRanges,
+                               const std::vector<std::pair<size_t, size_t>>& edgeRanges) override;
 
 protected:
   // UI internals
@@ -27,6 +30,7 @@ protected:
 
   // Helpers
   virtual void createProgram() = 0;
+  virtual void fillColorBuffers(bool update) = 0; // the color buffers of both programs
 };
 
 // ========================================================
@@ -38,6 +42,12 @@ public:
   CurveNetworkNodeColorQuantity(std::string name, std::vector<glm::vec3> values_, CurveNetwork& network_);
 
   virtual void createProgram() override;
+  virtual void fillColorBuffers(bool update) override;
+  virtual size_t hostMemoryUsage() override;
+
+  // Replace the colors, which must be as many as before. The programs are kept and their color buffers rewritten.
+  template <class T>
+  CurveNetworkNodeColorQuantity* updateData(const T& newColors);
 
   void buildNodeInfoGUI(size_t vInd) override;
 
@@ -54,6 +64,12 @@ public:
   CurveNetworkEdgeColorQuantity(std::string name, std::vector<glm::vec3> values_, CurveNetwork& network_);
 
   virtual void createProgram() override;
+  virtual void fillColorBuffers(bool update) override;
+  virtual size_t hostMemoryUsage() override;
+
+  // Replace the colors, which must be as many as before. The programs are kept and their color buffers rewritten.
+  template <class T>
+  CurveNetworkEdgeColorQuantity* updateData(const T& newColors);
 
   void buildEdgeInfoGUI(size_t eInd) override;
 
@@ -61,4 +77,22 @@ public:
   std::vector<glm::vec3> values;
 };
 
+template <class T>
+CurveNetworkNodeColorQuantity* CurveNetworkNodeColorQuantity::updateData(const T& newColors) {
+  validateSize(newColors, values.size(), "curve network node color quantity " + name);
+  values = standardizeVectorArray<glm::vec3, 3>(newColors);
+  dataUpdated();
+  requestRedraw();
+  return this;
+}
+
+template <class T>
+CurveNetworkEdgeColorQuantity* CurveNetworkEdgeColorQuantity::updateData(const T& newColors) {
+  validateSize(newColors, values.size(), "curve network edge color quantity " + name);
+  values = standardizeVectorArray<glm::vec3, 3>(newColors);
+  dataUpdated();
+  requestRedraw();
+  return this;
+}
+
 } // namespace polyscope
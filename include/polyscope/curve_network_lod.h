@@ -0,0 +1,56 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace polyscope {
+
+class CurveNetwork;
+
+// Douglas-Peucker simplifications of the chains of a curve network, used by CurveNetwork::setLODEnabled().
+//
+// A chain is a maximal path of edges through nodes of degree two; a closed loop of such nodes is one chain which starts
+// and ends at the same node. Each interior node of a chain gets an error: its distance to the segment which replaces it
+// in the Douglas-Peucker subdivision of the chain, lowered where needed so that no node has a larger error than the
+// node whose split introduced it. Keeping the nodes whose error exceeds a tolerance then gives the simplification of
+// the chain for that tolerance, and the end nodes of chains (so the topology of the network) are always kept. The kept
+// nodes are nodes of the network and each drawn edge stands in for a run of original edges, so any per-node or per-edge
+// data of the network can be drawn without resampling it.
+class CurveNetworkLOD {
+public:
+  CurveNetworkLOD(const CurveNetwork& network);
+
+  // What to draw for some view
+  struct Selection {
+    std::vector<uint32_t> nodes;                   // the nodes kept, as indices in to the network's nodes
+    std::vector<std::array<uint32_t, 2>> edgeEnds; // the end nodes of each drawn edge
+    std::vector<uint32_t> edgeSources;             // for each drawn edge, the middle one of the edges it replaces
+    std::vector<int8_t> chainLevels;               // the tolerance used for each chain, as a power of two
+  };
+
+  // Simplify each chain so that its nodes move by at most maxPixelError pixels on screen, judged at the point of its
+  // bounding box nearest to the camera. Tolerances are rounded down to powers of two, so that small camera motions
+  // usually leave the selection as it is; returns false if it is unchanged.
+  bool select(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight, float maxPixelError,
+              Selection& selection) const;
+
+  size_t nChains() const { return chainBoxMin.size(); }
+  size_t allocatedBytes() const;
+
+private:
+  // Chain c has the nodes chainNodes[chainNodeStart[c]] ... chainNodes[chainNodeStart[c+1]-1] (both ends included),
+  // and the edges between them, in order, starting at chainEdges[chainNodeStart[c] - c]
+  std::vector<uint32_t> chainNodeStart;
+  std::vector<uint32_t> chainNodes;
+  std::vector<uint32_t> chainEdges;
+  std::vector<float> nodeError; // for each entry of chainNodes, infinite at the ends
+  std::vector<glm::vec3> chainBoxMin, chainBoxMax;
+  std::vector<uint32_t> fixedNodes; // the nodes which are always kept: ends of chains, and nodes on no edge
+};
+
+} // namespace polyscope
@@ -4,6 +4,9 @@
 #include "polyscope/quantity.h"
 #include "polyscope/structure.h"
 
+#include <utility>
+#include <vector>
+
 namespace polyscope {
 
 // Forward declare
@@ -18,6 +21,11 @@ public:
   // Build GUI info an element
   virtual void buildNodeInfoGUI(size_t vInd);
   virtual void buildEdgeInfoGUI(size_t fInd);
+
+  // Called when some of the parent's nodes have moved, with the ranges of nodes and of edges whose positions changed.
+  // By default the quantity is refreshed.
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& nodeRanges,
+                               const std::vector<std::pair<size_t, size_t>>& edgeRanges);
 };
 
 
@@ -15,9 +15,13 @@ public:
                              const std::vector<double>& values, DataType dataType);
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
   virtual std::string niceName() override;
   virtual void refresh() override;
+  virtual void dataUpdated() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& nodeRanges,
+                               const std::vector<std::pair<size_t, size_t>>& edgeRanges) override;
 
 protected:
   // UI internals
@@ -27,6 +31,7 @@ protected:
 
   // Helpers
   virtual void createProgram() = 0;
+  virtual void fillColorBuffers(bool update) = 0; // the value buffers of both programs
 };
 
 // ========================================================
@@ -39,6 +44,7 @@ public:
                                  DataType dataType_ = DataType::STANDARD);
 
   virtual void createProgram() override;
+  virtual void fillColorBuffers(bool update) override;
 
   void buildNodeInfoGUI(size_t nInd) override;
 };
@@ -54,6 +60,7 @@ public:
                                  DataType dataType_ = DataType::STANDARD);
 
   virtual void createProgram() override;
+  virtual void fillColorBuffers(bool update) override;
 
   void buildEdgeInfoGUI(size_t edgeInd) override;
 };
@@ -17,7 +17,9 @@ public:
 
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
+  virtual void dataUpdated() override;
 
   // Allow children to append to the UI
   virtual void drawSubUI();
@@ -62,6 +64,11 @@ public:
   virtual std::string niceName() override;
   virtual void buildNodeInfoGUI(size_t vInd) override;
   virtual void refresh() override;
+
+  // Replace the vectors, one per node as before. The programs and options are kept; the vector buffers are rewritten
+  // and the vectors scaled by their new longest length.
+  template <class T>
+  CurveNetworkNodeVectorQuantity* updateData(const T& newVectors);
 };
 
 
@@ -75,7 +82,28 @@ public:
   virtual std::string niceName() override;
   virtual void buildEdgeInfoGUI(size_t fInd) override;
   virtual void refresh() override;
+
+  // Replace the vectors, one per edge as before. The programs and options are kept; the vector buffers are rewritten
+  // and the vectors scaled by their new longest length.
+  template <class T>
+  CurveNetworkEdgeVectorQuantity* updateData(const T& newVectors);
 };
 
+template <class T>
+CurveNetworkNodeVectorQuantity* CurveNetworkNodeVectorQuantity::updateData(const T& newVectors) {
+  validateSize(newVectors, vectors.size(), "curve network node vector quantity " + name);
+  vectors = standardizeVectorArray<glm::vec3, 3>(newVectors);
+  dataUpdated();
+  return this;
+}
+
+template <class T>
+CurveNetworkEdgeVectorQuantity* CurveNetworkEdgeVectorQuantity::updateData(const T& newVectors) {
+  validateSize(newVectors, vectors.size(), "curve network edge vector quantity " + name);
+  vectors = standardizeVectorArray<glm::vec3, 3>(newVectors);
+  dataUpdated();
+  return this;
+}
+
 
 } // namespace polyscope
@@ -0,0 +1,31 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace polyscope {
+
+// Tracks which entries of an array have changed since its buffers were last uploaded, as a set of index ranges
+// [start, end). Ranges may be marked in any order and may overlap; they are only sorted and merged when read back, so
+// that several updates within a frame result in one upload per contiguous span.
+class DirtyRanges {
+public:
+  void mark(size_t start, size_t end);
+  void mark(size_t ind) { mark(ind, ind + 1); }
+  void mark(const DirtyRanges& other);
+  void markAll(size_t size) { mark(0, size); }
+
+  bool empty() const { return marked.empty(); }
+  void clear() { marked.clear(); }
+
+  // The marked ranges in increasing order, merging ranges which overlap or are separated by at most maxGap unmarked
+  // entries (re-uploading a few unchanged entries is cheaper than issuing another upload).
+  std::vector<std::pair<size_t, size_t>> coalesced(size_t maxGap = 64) const;
+
+private:
+  std::vector<std::pair<size_t, size_t>> marked;
+};
+
+} // namespace polyscope
@@ -0,0 +1,50 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+namespace distributed {
+
+// Sort-last rendering of a dataset partitioned across processes ("ranks"), e.g. the nodes of a cluster running MPI. Each
+// rank registers only its own partition and renders it with the same camera (broadcast view::getCameraJson() from one
+// rank and apply it with view::setCameraFromJson() before each frame). The images are then composited by depth between
+// the ranks, with binary swap, so each rank merges only a shrinking part of the image. The result is gathered on rank
+// 0, which can save it (saveImage()) or stream it.
+//
+// Polyscope does not depend on a particular transport: the application passes an ExchangeFunction which sends bytes to
+// another rank and returns what that rank sent back, e.g. with MPI_Sendrecv. Compositing assumes opaque structures.
+
+// A rendered image with its depth, rows top to bottom
+struct DepthImage {
+  int width = 0;
+  int height = 0;
+  std::vector<unsigned char> color; // RGBA8
+  std::vector<float> depth;         // window-space depth, 1 where nothing was drawn
+  std::vector<int> owner;           // the rank which drew each pixel, or -1 for the background
+
+  // The rank which drew a pixel of the composited image, in buffer pixels from the top left as for
+  // pick::evaluatePickQuery(). Picks at that pixel should be evaluated on that rank.
+  int ownerAt(int x, int y) const;
+};
+
+// Render the current view of this rank's structures. Requires an SSAA factor of 1, so that the color and the depth
+// have the same size; otherwise reports an error and returns an empty image.
+DepthImage renderDepthImage(int rank);
+
+// Merge rows [rowBegin, rowEnd) of other in to target, keeping the nearer of each pair of pixels
+void compositeByDepth(DepthImage& target, const DepthImage& other, int rowBegin, int rowEnd);
+
+// Send data to rank partner, and return what it sent in exchange. Called in the same order on both ranks.
+typedef std::function<std::vector<unsigned char>(int partner, const std::vector<unsigned char>& data)>
+    ExchangeFunction;
+
+// Composite the images of all ranks, each calling this with its own image. Returns the complete image on rank 0; on the
+// other ranks the result is unspecified. Any number of ranks works; beyond a power of two, the extra ranks first merge
+// their whole image in to a partner.
+DepthImage binarySwapComposite(DepthImage image, int rank, int nRanks, const ExchangeFunction& exchange);
+
+} // namespace distributed
+} // namespace polyscope
@@ -0,0 +1,70 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace polyscope {
+
+// A bounding volume hierarchy over the elements of a structure (triangles, points, edges...), used to pick elements on
+// the CPU without rendering the pick buffer (see options::cpuPicking).
+//
+// Elements are only known by their bounding boxes and their index, which must be less than 2^32; the queries call back
+// to test the elements themselves. Elements drawn with a radius which may change (points, edges) can be given their
+// bare bounds, with the radius passed to the queries as a margin around every box. Elements are ordered along a Morton
+// curve through their box centers (see mortonOrder()) and grouped in to leaves of consecutive elements, which makes the
+// build a sort plus a linear pass.
+class ElementBVH {
+public:
+  ElementBVH(const std::vector<glm::vec3>& elementMin, const std::vector<glm::vec3>& elementMax,
+             size_t elementsPerLeaf = defaultElementsPerLeaf);
+
+  // The first element hit by the ray rayStart + t * rayDir, for t >= 0. elementHit(i) returns the t at which the ray
+  // hits element i, or infinity if it misses. Returns false if no element is hit.
+  bool rayCast(glm::vec3 rayStart, glm::vec3 rayDir, float boxMargin, const std::function<float(uint32_t)>& elementHit,
+               float& tHit, uint32_t& hitElement) const;
+
+  // The element closest to a point, where elementDist(i) returns the distance from the point to element i. Returns
+  // false if there are no elements.
+  bool closest(glm::vec3 point, float boxMargin, const std::function<float(uint32_t)>& elementDist, float& dist,
+               uint32_t& closestElement) const;
+
+  // Call visit(i) for each element i of the leaves which come within planeMargin of the plane {x : dot(normal, x) =
+  // offset}, measured along the normal. visit() does its own test of the element.
+  void forEachNearPlane(glm::vec3 normal, float offset, float planeMargin,
+                        const std::function<void(uint32_t)>& visit) const;
+
+  size_t nNodes() const { return nodes.size(); }
+  size_t allocatedBytes() const;
+
+  static const size_t defaultElementsPerLeaf = 4;
+
+private:
+  struct Node {
+    glm::vec3 bboxMin, bboxMax;
+    uint32_t start, count; // this node's elements are order[start, start + count)
+    int32_t right;         // the second child (the first is the next node), or -1 for leaves
+  };
+
+  std::vector<Node> nodes; // nodes[0] is the root
+  std::vector<uint32_t> order;
+
+  // Build the node for leaves [leafStart, leafEnd), returning its index
+  int32_t buildNode(const std::vector<Node>& leaves, size_t leafStart, size_t leafEnd);
+};
+
+// == Element tests for use with the BVH, all with any non-zero ray direction, returning infinity for a miss
+
+float rayTriangleHit(glm::vec3 rayStart, glm::vec3 rayDir, glm::vec3 pA, glm::vec3 pB, glm::vec3 pC);
+float raySphereHit(glm::vec3 rayStart, glm::vec3 rayDir, glm::vec3 center, float radius);
+float rayCylinderHit(glm::vec3 rayStart, glm::vec3 rayDir, glm::vec3 tail, glm::vec3 tip, float radius); // uncapped
+
+// Closest points, with the barycentric coordinates of the closest point on the triangle
+glm::vec3 closestPointOnTriangle(glm::vec3 p, glm::vec3 pA, glm::vec3 pB, glm::vec3 pC, glm::vec3& bary);
+float pointSegmentDistance(glm::vec3 p, glm::vec3 tail, glm::vec3 tip);
+
+} // namespace polyscope
@@ -0,0 +1,54 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+enum class ExpressionValueType { Scalar, Vector };
+
+// A small arithmetic expression over the values of named per-element fields (scalars and 3-vectors), such as
+// "|velocity|", "pressure - {initial pressure}" or "log(density)". It is parsed once, then translated to GLSL to be
+// evaluated on the GPU (see e.g. PointCloudExpressionQuantity), or evaluated on the CPU for single elements.
+//
+// Syntax:
+//  - numbers, the constant pi, and fields: identifiers like `density`, or any name in braces like `{my field}`
+//  - + - * / and ^ (power), unary -, parentheses; scalars combine with vectors componentwise
+//  - |x|: the length of a vector, or the absolute value of a scalar; v.x, v.y, v.z: components of a vector
+//  - functions: abs sqrt exp log log2 log10 sin cos tan floor ceil sign (componentwise), min max pow (two arguments),
+//    clamp (three), length normalize, dot cross (two vectors)
+class Expression {
+public:
+  // Parse source, resolving the type of each field it names with fieldType(), which returns false for unknown names.
+  // Throws std::invalid_argument, with a message saying what is wrong where, if it does not parse.
+  Expression(std::string source, const std::function<bool(const std::string&, ExpressionValueType&)>& fieldType);
+
+  const std::string& getSource() const { return source; }
+  ExpressionValueType getType() const; // of the result
+
+  // Each distinct field named, in order of first use
+  const std::vector<std::string>& getFieldNames() const { return fieldNames; }
+  ExpressionValueType getFieldType(size_t iField) const { return fieldTypes[iField]; }
+
+  // A GLSL expression for the value (a float or a vec3), in which field i is the variable fieldVariablePrefix + i
+  std::string toGLSL(const std::string& fieldVariablePrefix) const;
+
+  // The value for one element, given the value of each field (scalars in all three components). A scalar result is
+  // likewise in all three components.
+  glm::vec3 evaluate(const std::vector<glm::vec3>& fieldValues) const;
+
+  struct Node;
+
+private:
+  std::string source;
+  std::vector<std::string> fieldNames;
+  std::vector<ExpressionValueType> fieldTypes;
+  std::shared_ptr<const Node> root;
+};
+
+} // namespace polyscope
@@ -0,0 +1,97 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// A region of a frame which was timed on the CPU, see ScopedCPUTimer
+struct CPUTiming {
+  std::string name;
+  int depth;      // nesting depth of the region, 0 if outermost
+  double startMs; // since the profiler started, only meaningful relative to other timings
+  double durationMs;
+};
+
+// Distribution of the time spent in one region per frame, over the recent frames in which it ran
+struct TimingStats {
+  std::string name;
+  size_t nFrames = 0;
+  double p50Ms = 0.;
+  double p95Ms = 0.;
+  double p99Ms = 0.;
+  double maxMs = 0.;
+};
+
+struct FrameStats {
+  TimingStats frame;                // whole main loop iterations
+  std::vector<TimingStats> regions; // in order of first appearance
+};
+
+// Times the CPU work done during its lifetime, if options::enableCPUProfiling is set. Regions with the same name are
+// summed within a frame.
+class ScopedCPUTimer {
+
+public:
+  ScopedCPUTimer(const std::string& name);
+  ScopedCPUTimer(const std::string& name, const char* detail); // named "<name> <detail>", formatted only when timing
+  ScopedCPUTimer(const std::string& name, const std::string& detail, const char* detail2); // likewise, with both
+  ~ScopedCPUTimer();
+
+private:
+  bool active;
+  void open(std::string fullName);
+};
+
+// Statistics over the last few hundred frames (empty unless options::enableCPUProfiling is set)
+FrameStats getFrameStats();
+void resetFrameStats();
+
+// Chrome trace (chrome://tracing) JSON of the regions timed in recent frames
+void writeCPUTimingTrace(std::string filename);
+
+// The time spent in each phase of startup, from the start of init() to the end of the first frame drawn after it,
+// whether or not options::enableCPUProfiling is set. The time of a phase excludes the phases nested in it, so the
+// phases add up to the total; e.g. "window and context" is what remains of creating the render engine once its shaders,
+// buffers, materials and colormaps are counted separately. Logged once complete at options::verbosity >= 2.
+struct StartupPhase {
+  std::string name;
+  double ms;
+};
+struct StartupStats {
+  std::vector<StartupPhase> phases; // in the order they finished
+  double totalMs = 0.;
+  bool complete = false; // has the first frame been drawn?
+};
+StartupStats getStartupStats();
+
+// Times a phase of startup, see getStartupStats(). Does nothing outside of startup. The phase marked endsStartup is the
+// first frame, and completes the stats.
+class ScopedStartupPhase {
+
+public:
+  ScopedStartupPhase(const std::string& name, bool endsStartup = false);
+  ~ScopedStartupPhase();
+
+private:
+  bool active;
+  bool endsStartup;
+};
+
+namespace profiling {
+
+// Called by the main loop around each iteration
+void beginFrame();
+void endFrame();
+
+// Called by init() as it starts, see getStartupStats()
+void beginStartup();
+
+// The "CPU Timings" section of the Polyscope panel, and the overlay window (options::showFrameStatsOverlay)
+void buildFrameStatsGui();
+void buildFrameStatsOverlay();
+
+} // namespace profiling
+} // namespace polyscope
@@ -0,0 +1,128 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// forward declarations
+class Structure;
+namespace render {
+class OcclusionQuery;
+}
+
+// A named set of structures and other groups, to handle the parts of a large scene together, e.g. the assemblies of a
+// model. Groups nest in a forest: each structure and each group is in at most one group.
+//
+// A structure is drawn and picked only while it and every group containing it are enabled. Disabling a group leaves the
+// structures' own enabled state alone, so it is a single call however many structures the group holds. While drawing,
+// the bounding box of everything in a group, which is cached, is tested against the view (and, with
+// options::enableOcclusionCulling, the depth of the scene) once for the whole group.
+class Group {
+
+public:
+  Group(std::string name);
+  ~Group(); // the members are not removed, they just leave the group
+
+  // No copy constructor/assignment
+  Group(const Group&) = delete;
+  Group& operator=(const Group&) = delete;
+
+  const std::string name;
+
+  // == Members
+  // Adding a member takes it out of any group it was in. A group can not be added to itself or to a group inside it.
+  Group* addChildGroup(Group& child);
+  Group* addChildStructure(Structure& child);
+  void removeChildGroup(Group& child);
+  void removeChildStructure(Structure& child);
+  Group* getParentGroup() { return parentGroup; }
+  const std::vector<Group*>& getChildGroups() { return childGroups; }
+  const std::vector<Structure*>& getChildStructures() { return childStructures; }
+  size_t nDescendantStructures(); // in the group and the groups inside it
+
+  // == Visibility
+  Group* setEnabled(bool newEnabled);
+  bool isEnabled() { return enabled; }
+  bool isVisible(); // enabled, as is every group containing it
+
+  // Set the transparency of every structure in the group and the groups inside it (see Structure::setTransparency())
+  Group* setTransparency(float newVal);
+
+  // == Bounds and culling
+  // The union of the world-space culling boxes of the structures in the group and the groups inside it. False if some
+  // structure's bounds are not known yet, or the group holds no structures.
+  bool getCullingBoundingBox(glm::vec3& bboxMin, glm::vec3& bboxMax);
+  void boundsChanged(); // a member moved or changed shape; the box is recomputed when next needed
+
+  bool isInViewFrustum(const glm::mat4& clipRegion = glm::mat4(1.));
+  bool isOccluded(); // as found by the last finished occlusion test of the group or of a group containing it
+  void testOcclusion();
+  void collectOcclusionTest(); // as for structures, see Structure::collectOcclusionTest()
+  bool hasOutstandingOcclusionTest();
+  void resetOcclusion();
+
+  // Whether the structures of the group are skipped in the current pass over the structures, since the group or one
+  // containing it is disabled or outside the view frustum. Evaluated once per group and pass, see
+  // beginGroupCullingPass().
+  bool isHiddenInPass();
+  bool isCulledInPass();
+
+  // == UI
+  void buildUI(); // a tree node with the child groups and structures
+  bool uiTreeOpen = false;
+
+private:
+  bool enabled = true;
+  float transparency = 1.;
+  Group* parentGroup = nullptr;
+  std::vector<Group*> childGroups;
+  std::vector<Structure*> childStructures;
+
+  // Cached bounds
+  bool boundsValid = false;
+  bool boundsKnown = false; // every structure's bounds are known
+  bool boundsEmpty = true;  // no structures inside
+  float boundsLengthScale = -1.; // the scene length scale the box was computed with, which pads it
+  glm::vec3 boundsMin, boundsMax;
+
+  // Culling state
+  size_t passEvaluated = 0;
+  bool passHidden = false;
+  bool passCulled = false;
+  void evaluatePass();
+  bool occluded = false;
+  bool occlusionTestPending = false;
+  std::shared_ptr<render::OcclusionQuery> occlusionQuery;
+
+  bool containsGroup(Group& other); // other is this group, or inside it
+};
+
+// == Manage groups
+
+// Create a new group. The name must not be taken by another group.
+Group* createGroup(std::string name);
+Group* getGroup(std::string name);
+bool hasGroup(std::string name);
+void removeGroup(std::string name, bool errorIfAbsent = true);
+void removeAllGroups();
+std::vector<Group*> getRootGroups(); // the groups which are not inside another, in order of name
+
+// Called by the render loop: start a pass over the structures, in which groups are tested against the current view
+void beginGroupCullingPass();
+// Test / forget the occlusion of all groups, as for the structures
+void testGroupOcclusion();
+void collectGroupOcclusion();
+bool haveOutstandingGroupOcclusionTests();
+void resetGroupOcclusion();
+
+// The "Groups" section of the structures window
+void buildGroupsGui();
+
+} // namespace polyscope
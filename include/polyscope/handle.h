@@ -0,0 +1,59 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace polyscope {
+
+namespace internal {
+
+// A slot in the table of live structures and quantities, and the generation of the object which held it when the id
+// was taken. Slots are reused once their object is deleted, with the next generation, so old ids no longer resolve.
+struct HandleID {
+  uint32_t slot = UINT32_MAX;
+  uint32_t generation = 0;
+};
+
+// Taken by the Structure and Quantity constructors, and released by their destructors
+HandleID acquireHandle(void* object);
+void releaseHandle(HandleID id);
+void* resolveHandle(HandleID id); // the object, or nullptr if it has been deleted since
+
+} // namespace internal
+
+// A reference to a structure or quantity which can be kept across frames, and which resolves to the object in constant
+// time, without the name lookups of getSurfaceMesh() / getQuantity(). Once the object is removed the handle resolves to
+// nullptr, rather than to freed memory as a kept pointer would.
+//
+//   polyscope::Handle<polyscope::SurfaceMesh> mesh = polyscope::registerSurfaceMesh("mesh", verts, faces);
+//   polyscope::Handle<polyscope::SurfaceScalarQuantity> q = mesh->addVertexScalarQuantity("values", values);
+//   ...
+//   if (q) q->updateData(newValues); // every frame
+template <typename T>
+class Handle {
+public:
+  Handle() {}
+  Handle(T* object) {
+    if (object != nullptr) id = object->handleID;
+  }
+
+  T* get() const { return static_cast<T*>(static_cast<typename T::HandleBase*>(internal::resolveHandle(id))); }
+  T* operator->() const {
+    T* object = get();
+    if (object == nullptr) {
+      throw std::runtime_error("polyscope: used a handle to a structure or quantity which has been removed");
+    }
+    return object;
+  }
+  T& operator*() const { return *operator->(); }
+  explicit operator bool() const { return get() != nullptr; }
+
+  bool operator==(const Handle& other) const { return id.slot == other.id.slot && id.generation == other.id.generation; }
+  bool operator!=(const Handle& other) const { return !(*this == other); }
+
+private:
+  internal::HandleID id;
+};
+
+} // namespace polyscope
@@ -4,6 +4,7 @@
 #include "polyscope/render/color_maps.h"
 #include "polyscope/render/engine.h"
 
+#include <functional>
 #include <vector>
 
 
@@ -13,12 +14,17 @@ namespace polyscope {
 class Histogram {
 public:
   Histogram();
-  Histogram(std::vector<double>& values);
-  Histogram(std::vector<double>& values, const std::vector<double>& weights);
+  Histogram(const std::vector<double>& values);
+  Histogram(const std::vector<double>& values, const std::vector<double>& weights);
 
   ~Histogram();
 
-  void buildHistogram(std::vector<double>& values, const std::vector<double>& weights = {});
+  void buildHistogram(const std::vector<double>& values, const std::vector<double>& weights = {});
+  void buildHistogram(const std::vector<float>& values, const std::vector<double>& weights = {});
+
+  // Defer building until the histogram is first drawn, when buildFunc is called (it should call buildHistogram()).
+  // Quantities whose UI is never opened then never bin their values. Replaced by any later call to buildHistogram().
+  void buildHistogramLazily(std::function<void()> buildFunc);
   void updateColormap(const std::string& newColormap);
 
   // Width = -1 means set automatically
@@ -30,13 +36,17 @@ private:
   // = Helpers
 
   // Manage the actual histogram
+  template <typename T>
+  void buildHistogramImpl(const std::vector<T>& values, const std::vector<double>& weights);
   void fillBuffers();
+  void ensureBuilt(); // run the pending build, if any
+  std::function<void()> pendingBuild;
   void smoothCurve(std::vector<std::array<double, 2>>& xVals, std::vector<double>& yVals);
   size_t smoothedHistBinCount = 201;
   size_t rawHistBinCount = 51;
 
   // There are 4 combinations of {weighted/unweighed}, {smoothed/raw} histograms that might be displaced.
-  // We just generate them all initially
+  // They are all generated when the histogram is built
   std::vector<double> weightedRawHistCurveY;
   std::vector<double> unweightedRawHistCurveY;
   std::vector<double> weightedSmoothedHistCurveY;
@@ -51,10 +61,13 @@ private:
   bool currBufferSmoothed = false;
 
 
-  // Render to texture
+  // Render to texture. The texture is kept between frames, and only rendered again once the data, the colormap, the
+  // colormap range or the displayed variant change.
   void renderToTexture();
   void prepare();
   bool prepared = false;
+  bool textureValid = false;
+  std::pair<double, double> textureColormapRange; // colormapRange when the texture was rendered
 
   unsigned int texDim = 600;
   std::shared_ptr<render::TextureBuffer> texturebuffer = nullptr;
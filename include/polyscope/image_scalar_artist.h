@@ -7,11 +7,28 @@
 #include "polyscope/render/engine.h"
 #include "polyscope/scaled_value.h"
 
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
 #include <vector>
 
 
 namespace polyscope {
 
+class BackgroundTask;
+
+// Supplies the pixels of a tiled image (see the tiled ImageScalarArtist constructor). Fills out, row-major, with the
+// w x h region starting at (x0, y0) of the given pyramid level, of which each pixel covers 2^level x 2^level pixels of
+// the full image. Called from background threads, possibly concurrently.
+using ImageTileSource = std::function<void(size_t level, size_t x0, size_t y0, size_t w, size_t h, float* out)>;
+
+// Build the coarser levels of a tile source which can only read the full-resolution image, by averaging blocks of it.
+// The blocks are read a strip at a time, so the whole image is never held in memory.
+ImageTileSource tileSourceFromFullResolution(
+    std::function<void(size_t x0, size_t y0, size_t w, size_t h, float* out)> readFullResolution, size_t dimX,
+    size_t dimY);
+
 class ImageScalarArtist {
 
 public:
@@ -24,6 +41,14 @@ public:
   ImageScalarArtist(std::string name, std::shared_ptr<render::TextureBuffer>& texturebuffer, size_t dimX, size_t dimY,
                     DataType dataType = DataType::STANDARD);
 
+  // A tiled image, for images too large to hold in memory or in a single texture. Only the tiles of the pyramid level
+  // matching the current zoom which cover the view region (see setViewRegion()) are requested from the source, in the
+  // background, and drawn over the coarser levels until they arrive. The coarsest level is read when the artist is
+  // created, and sets the data range.
+  ImageScalarArtist(std::string name, ImageTileSource tileSource, size_t dimX, size_t dimY,
+                    DataType dataType = DataType::STANDARD, size_t tileSize = 256);
+  ~ImageScalarArtist();
+
   void draw(); // (re-)render the data to the internal texture
 
   void buildImGUIWindow(); // build a floating imgui window showing the texture
@@ -33,6 +58,7 @@ public:
   const size_t dimX, dimY;
   const DataType dataType;
   const bool readFromTex = false; // hack to also support pulling directly from a texture
+  const bool tiled = false;
 
 
   // === Get/set visualization parameters
@@ -46,6 +72,18 @@ public:
   std::pair<double, double> getMapRange();
   ImageScalarArtist* resetMapRange(); // reset to full range
 
+  // === Tiled images only
+
+  // The rectangle of the image which is drawn, in full-resolution pixels (default: the whole image)
+  ImageScalarArtist* setViewRegion(glm::vec2 lower, glm::vec2 upper);
+  std::pair<glm::vec2, glm::vec2> getViewRegion();
+
+  // The most tiles kept in textures at once; the least recently drawn are dropped first, but the tiles in view and the
+  // coarsest level are always kept (default: 256)
+  ImageScalarArtist* setTileCacheSize(size_t nTiles);
+  size_t getTileCacheSize();
+  size_t nResidentTiles();
+
 private:
   // Affine data maps and limits
   std::pair<float, float> vizRange;
@@ -59,6 +97,32 @@ private:
 
   void prepare();
   void prepareSource();
+
+  // == Tiled images
+  struct Tile {
+    std::shared_ptr<std::vector<float>> pixels; // filled in the background, released once uploaded
+    std::unique_ptr<BackgroundTask> fillTask;   // null once the pixels arrived
+    std::shared_ptr<render::TextureBuffer> texture;
+    size_t sizeX, sizeY;
+    uint64_t lastDrawnFrame = 0;
+  };
+  ImageTileSource tileSource;
+  const size_t tileSize = 0;
+  size_t nLevels = 0;
+  size_t tileCacheSize = 256;
+  size_t maxPendingTiles = 8; // requests in flight at once, so panning doesn't queue up stale tiles
+  size_t nPendingTiles = 0;
+  glm::vec2 viewLower, viewUpper;
+  std::unordered_map<uint64_t, Tile> tiles; // by tileKey()
+  uint64_t frameCount = 0;
+
+  uint64_t tileKey(size_t level, size_t tileX, size_t tileY) const;
+  size_t levelDim(size_t dim, size_t level) const;
+  std::array<size_t, 4> visibleTileRange(size_t level) const; // {xStart, xEnd, yStart, yEnd}
+  void requestTile(size_t level, size_t tileX, size_t tileY);
+  void uploadArrivedTiles();
+  void evictTiles();
+  void drawTiles();
 };
 
 } // namespace polyscope
@@ -0,0 +1,118 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/instanced_surface_mesh_quantity.h"
+#include "polyscope/persistent_value.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/render/engine.h"
+#include "polyscope/structure.h"
+#include "polyscope/surface_mesh.h"
+
+#include "polyscope/instanced_surface_mesh_color_quantity.h"
+#include "polyscope/instanced_surface_mesh_scalar_quantity.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// Forward declare quantity types
+class InstancedSurfaceMeshColorQuantity;
+class InstancedSurfaceMeshScalarQuantity;
+
+template <> // Specialize the quantity type
+struct QuantityTypeHelper<InstancedSurfaceMesh> {
+  typedef InstancedSurfaceMeshQuantity type;
+};
+
+// Many copies of one surface mesh, each with its own transform, e.g. the parts of an assembly or particles with a mesh
+// shape. The geometry is held and uploaded once, and all the copies are drawn with a single instanced draw call.
+// Quantities hold one value per instance. Picking reports the instance and the face within it. The mesh is flat shaded
+// and drawn without a wireframe.
+class InstancedSurfaceMesh : public QuantityStructure<InstancedSurfaceMesh> {
+public:
+  // Construct from flat face arrays, like SurfaceMesh; faceIndsStart may be empty for a triangle mesh
+  InstancedSurfaceMesh(std::string name, std::vector<glm::vec3> vertexPositions, std::vector<uint32_t> faceIndsEntries,
+                       std::vector<size_t> faceIndsStart, std::vector<glm::mat4> instanceTransforms);
+
+  // === Overrides
+  virtual void buildCustomUI() override;
+  virtual void buildCustomOptionsUI() override;
+  virtual void buildPickUI(size_t localPickID) override;
+  virtual void draw() override;
+  virtual void drawPick() override;
+  virtual void updateObjectSpaceBounds() override;
+  virtual std::string typeName() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual void refresh() override;
+
+  // === Quantities, with one value per instance
+  InstancedSurfaceMeshColorQuantity* addInstanceColorQuantity(std::string name, const std::vector<glm::vec3>& colors);
+  InstancedSurfaceMeshScalarQuantity* addInstanceScalarQuantity(std::string name, const std::vector<double>& values,
+                                                                DataType type = DataType::STANDARD);
+
+  // === Mutate
+  // Move the instances. With the same number of instances only the transforms are uploaded; otherwise the quantities
+  // are removed, since they no longer match.
+  void updateInstanceTransforms(const std::vector<glm::mat4>& newTransforms);
+
+  // === Geometry (of one instance)
+  std::vector<glm::vec3> vertices;
+  std::vector<uint32_t> faceIndsEntries;
+  std::vector<size_t> faceIndsStart; // empty for a triangle mesh, see SurfaceMesh
+  std::vector<glm::mat4> instanceTransforms;
+  size_t nVertices() const { return vertices.size(); }
+  size_t nFaces() const { return faceIndsStart.empty() ? faceIndsEntries.size() / 3 : faceIndsStart.size() - 1; }
+  size_t nInstances() const { return instanceTransforms.size(); }
+
+  static const std::string structureTypeName;
+
+  // === Get/set visualization parameters
+  InstancedSurfaceMesh* setSurfaceColor(glm::vec3 val);
+  glm::vec3 getSurfaceColor();
+  InstancedSurfaceMesh* setMaterial(std::string name);
+  std::string getMaterial();
+
+  // Rendering helpers used by quantities
+  void fillGeometryBuffers(render::ShaderProgram& p); // binds the shared geometry and transform buffers
+  std::vector<std::string> addInstancedSurfaceMeshRules(std::vector<std::string> initRules);
+
+private:
+  // === Visualization parameters
+  PersistentValue<glm::vec3> surfaceColor;
+  PersistentValue<std::string> material;
+
+  // Drawing related things
+  // if nullptr, prepare() (resp. preparePick()) needs to be called
+  std::shared_ptr<render::ShaderProgram> program;
+  std::shared_ptr<render::ShaderProgram> pickProgram;
+  render::ShaderUniformHandle baseColorHandle; // in `program`, resolved when it is created
+
+  // Per-corner geometry of one instance, and the per-instance transforms, shared by every program
+  std::shared_ptr<render::AttributeBuffer> cornerPositions;
+  std::shared_ptr<render::AttributeBuffer> cornerNormals;
+  std::shared_ptr<render::AttributeBuffer> cornerCullPos;
+  std::shared_ptr<render::AttributeBuffer> transformBuffer;
+
+  // === Helpers
+  void prepare();
+  void preparePick();
+  void ensureGeometryBuffers();
+  std::vector<glm::vec4> transformColumns(); // the columns of each transform, in order, as the shaders read them
+  template <typename F>
+  void forEachTriangle(F&& f); // f(iF, vertexInds) for the fan triangulation of each face
+};
+
+// Register many copies of the geometry of a surface mesh, one per transform. The geometry is copied, so the base mesh
+// can be removed (or disabled, to only see the copies).
+InstancedSurfaceMesh* registerInstancedSurfaceMesh(std::string name, SurfaceMesh* baseMesh,
+                                                   const std::vector<glm::mat4>& instanceTransforms);
+
+// Shorthand to get an instanced mesh from polyscope
+inline InstancedSurfaceMesh* getInstancedSurfaceMesh(std::string name = "") {
+  return dynamic_cast<InstancedSurfaceMesh*>(getStructure(InstancedSurfaceMesh::structureTypeName, name));
+}
+
+} // namespace polyscope
@@ -0,0 +1,36 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/instanced_surface_mesh.h"
+#include "polyscope/instanced_surface_mesh_quantity.h"
+
+#include <vector>
+
+namespace polyscope {
+
+class InstancedSurfaceMeshColorQuantity : public InstancedSurfaceMeshQuantity {
+public:
+  InstancedSurfaceMeshColorQuantity(std::string name, const std::vector<glm::vec3>& values,
+                                    InstancedSurfaceMesh& mesh_);
+
+  virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
+
+  virtual void buildPickUI(size_t iInstance) override;
+  virtual void refresh() override;
+  virtual void dataUpdated() override;
+
+  virtual std::string niceName() override;
+
+  // Replace the colors, one per instance as before. The program is kept and its color buffer rewritten.
+  InstancedSurfaceMeshColorQuantity* updateData(const std::vector<glm::vec3>& newColors);
+
+  // === Members
+  std::vector<glm::vec3> values;
+
+protected:
+  void createProgram();
+  std::shared_ptr<render::ShaderProgram> program;
+};
+
+} // namespace polyscope
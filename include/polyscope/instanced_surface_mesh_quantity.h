@@ -0,0 +1,19 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/quantity.h"
+#include "polyscope/structure.h"
+
+namespace polyscope {
+
+// Forward declare the instanced mesh
+class InstancedSurfaceMesh;
+
+// Extend Quantity<InstancedSurfaceMesh>; the quantities of an instanced mesh hold one value per instance
+class InstancedSurfaceMeshQuantity : public Quantity<InstancedSurfaceMesh> {
+public:
+  InstancedSurfaceMeshQuantity(std::string name, InstancedSurfaceMesh& parentStructure, bool dominates = false);
+  virtual ~InstancedSurfaceMeshQuantity() {};
+};
+
+} // namespace polyscope
@@ -0,0 +1,33 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/instanced_surface_mesh.h"
+#include "polyscope/instanced_surface_mesh_quantity.h"
+#include "polyscope/render/color_maps.h"
+#include "polyscope/scalar_quantity.h"
+
+#include <vector>
+
+namespace polyscope {
+
+class InstancedSurfaceMeshScalarQuantity : public InstancedSurfaceMeshQuantity,
+                                           public ScalarQuantity<InstancedSurfaceMeshScalarQuantity> {
+public:
+  InstancedSurfaceMeshScalarQuantity(std::string name, const std::vector<double>& values,
+                                     InstancedSurfaceMesh& mesh_, DataType dataType);
+
+  virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual void buildCustomUI() override;
+
+  virtual void buildPickUI(size_t iInstance) override;
+  virtual void refresh() override;
+
+  virtual std::string niceName() override;
+
+protected:
+  void createProgram();
+  std::shared_ptr<render::ShaderProgram> program;
+};
+
+} // namespace polyscope
@@ -1,9 +1,14 @@
 // Copyright 2017-2021, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <string>
 
 namespace polyscope {
+
+class JobQueue;
+
 namespace internal {
 
 
@@ -11,6 +16,18 @@ namespace internal {
 
 extern bool pointCloudEfficiencyWarningReported;
 
+// The threads which fill the draw buffers of large structures (see options::backgroundPrepareMinTriangles) and trace
+// ribbons (see options::backgroundFieldTracing), and whether their draws should wait for the work instead (while
+// rendering screenshots). Shader programs linking in the background wait too.
+JobQueue& getBufferPreparationQueue();
+extern bool finishBackgroundFills;
+
+// Build a list of nRows ImGui tree nodes, calling buildRow(i) for row i. Rows whose node is closed (isOpen(i) false, as
+// of the last frame) are a single line, so long runs of them are clipped with ImGuiListClipper and only the rows in
+// view are built. Open rows are always built, since their height is not known.
+void buildTreeNodeRows(size_t nRows, const std::function<bool(size_t)>& isOpen,
+                       const std::function<void(size_t)>& buildRow);
+
 
 } // namespace internal
 } // namespace polyscope
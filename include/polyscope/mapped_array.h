@@ -0,0 +1,126 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/parallel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// Element types of a MappedArray
+enum class MappedArrayDType { Int8 = 0, UInt8, Int16, UInt16, Int32, UInt32, Int64, UInt64, Float32, Float64 };
+
+size_t mappedArrayDTypeSize(MappedArrayDType dtype);
+
+// A read-only view of a 1D or 2D numeric array in a file, which is memory-mapped rather than read. It can be passed
+// anywhere polyscope takes array data (e.g. addVertexScalarQuantity(), or the positions and faces of a structure);
+// the values are converted straight from the mapped pages in to the quantity's own storage, without first loading the
+// file in to memory. Pages are only read as they are touched, and remain reclaimable page cache afterwards.
+//
+// Copies are cheap and share the mapping, which stays open until the last copy is destroyed.
+class MappedArray {
+public:
+  MappedArray(); // empty
+
+  // Map a numpy .npy file (format 1.0-3.0, little-endian integer or float dtypes, 1D or 2D, C or Fortran order)
+  static MappedArray fromNpy(std::string filename);
+
+  // Map a headerless file holding rows x cols values of one dtype, row-major, starting at byteOffset
+  static MappedArray fromRawFile(std::string filename, MappedArrayDType dtype, size_t rows, size_t cols = 1,
+                                 size_t byteOffset = 0);
+
+  // Shape and layout
+  size_t rows() const { return nRows; }
+  size_t cols() const { return nCols; }
+  size_t size() const { return nRows; }
+  MappedArrayDType dtype() const { return dataType; }
+  size_t rowStride() const { return rowStrideBytes; } // in bytes
+  size_t colStride() const { return colStrideBytes; } // in bytes
+
+  // Element access, as a double (for convenience only, the bulk conversions below are much faster)
+  double operator()(size_t i) const { return (*this)(i, 0); }
+  double operator()(size_t i, size_t j) const;
+
+  // Convert all rows() x cols() values to S, row-major, in to out
+  template <class S>
+  void copyTo(S* out) const;
+
+private:
+  class Mapping;
+  std::shared_ptr<Mapping> mapping;
+  const unsigned char* base = nullptr;
+  MappedArrayDType dataType = MappedArrayDType::Float64;
+  size_t nRows = 0;
+  size_t nCols = 0;
+  size_t rowStrideBytes = 0;
+  size_t colStrideBytes = 0;
+
+  template <class S, class E>
+  void copyAs(S* out) const;
+
+  static MappedArray mapFile(std::shared_ptr<Mapping> mapping, std::string filename, size_t dataOffset,
+                             MappedArrayDType dtype, size_t rows, size_t cols, bool fortranOrder);
+};
+
+// === Implementation details
+
+template <class S, class E>
+void MappedArray::copyAs(S* out) const {
+  const unsigned char* arrBase = base;
+  size_t nC = nCols;
+  size_t rStride = rowStrideBytes;
+  size_t cStride = colStrideBytes;
+  auto copyRow = [=](size_t i) {
+    const unsigned char* row = arrBase + i * rStride;
+    for (size_t j = 0; j < nC; j++) {
+      E val;
+      std::memcpy(&val, row + j * cStride, sizeof(E)); // (no alignment guarantee from the file)
+      out[i * nC + j] = static_cast<S>(val);
+    }
+  };
+  parallelFor(0, nRows, copyRow);
+}
+
+template <class S>
+void MappedArray::copyTo(S* out) const {
+  switch (dataType) {
+  case MappedArrayDType::Int8:
+    copyAs<S, int8_t>(out);
+    break;
+  case MappedArrayDType::UInt8:
+    copyAs<S, uint8_t>(out);
+    break;
+  case MappedArrayDType::Int16:
+    copyAs<S, int16_t>(out);
+    break;
+  case MappedArrayDType::UInt16:
+    copyAs<S, uint16_t>(out);
+    break;
+  case MappedArrayDType::Int32:
+    copyAs<S, int32_t>(out);
+    break;
+  case MappedArrayDType::UInt32:
+    copyAs<S, uint32_t>(out);
+    break;
+  case MappedArrayDType::Int64:
+    copyAs<S, int64_t>(out);
+    break;
+  case MappedArrayDType::UInt64:
+    copyAs<S, uint64_t>(out);
+    break;
+  case MappedArrayDType::Float32:
+    copyAs<S, float>(out);
+    break;
+  case MappedArrayDType::Float64:
+    copyAs<S, double>(out);
+    break;
+  }
+}
+
+} // namespace polyscope
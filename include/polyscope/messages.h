@@ -11,8 +11,14 @@ namespace polyscope {
 void info(std::string message);
 
 // Non-fatal warnings. Warnings with the same base message are batched together, so the UI doesn't get completely
-// overwhelmed if you call this in a dense loop.
-void warning(std::string baseMessage, std::string detailMessage = "");
+// overwhelmed if you call this in a dense loop: while one is waiting to be shown, more with its base message only count
+// as repeats of it, and their detail messages are dropped. Past a few dozen distinct waiting warnings, new ones are only
+// counted, and summarized in one final warning.
+void warning(const std::string& baseMessage, const std::string& detailMessage = "");
+
+// True if a warning with this base message is waiting to be shown, so another would only count as a repeat. Loops which
+// may warn for many elements can check this to skip formatting detail messages which would be dropped.
+bool warningPending(const std::string& baseMessage);
 
 // Errors which are certainly big problems, and we may or may not be able to recover from. Blocks the UI
 void error(std::string message);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+
+namespace polyscope {
+
+// Holds one of the global options whose change requires follow-up work (e.g. re-configuring the render engine). It
+// reads and assigns like a plain variable, so `options::ssaaFactor = 2;` keeps working, but each assignment which
+// changes the value increments `options::changeCount`. processLazyProperties() compares that single counter to skip
+// checking the individual options when none were assigned.
+//
+// Code which writes through the raw pointer (e.g. imgui widgets) must call markChanged() afterwards.
+
+// forward declare
+namespace options {
+extern size_t changeCount;
+}
+
+template <typename T>
+class OptionValue {
+
+public:
+  explicit OptionValue(const T& value_) : value(value_) {}
+
+  // Assign a new value, recording the change
+  OptionValue& operator=(const T& newValue) {
+    if (!(value == newValue)) {
+      value = newValue;
+      markChanged();
+    }
+    return *this;
+  }
+  OptionValue& operator=(const OptionValue& other) { return operator=(other.value); }
+
+  // Implicit and explicit getters
+  operator const T&() const { return value; }
+  const T& get() const { return value; }
+
+  // Get a raw pointer to the underlying value (useful for e.g. imgui), call markChanged() after writing through it
+  T* getValuePtr() { return &value; }
+  void markChanged() { options::changeCount++; }
+
+private:
+  T value;
+};
+
+} // namespace polyscope
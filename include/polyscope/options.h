@@ -7,6 +7,7 @@
 
 #include "imgui.h"
 
+#include "polyscope/option_value.h"
 #include "polyscope/scaled_value.h"
 #include "polyscope/types.h"
 
@@ -30,6 +31,23 @@ extern bool errorsThrowExceptions;
 // Don't let the main loop run at more than this speed. (-1 disables) (default: 60)
 extern int maxFPS;
 
+// How frames are shown in the window (default: VSync)
+//   - VSync: swap on the display's refresh
+//   - AdaptiveVSync: like VSync, but a frame which misses its refresh is shown right away (with tearing), where the
+//     driver supports it
+//   - Immediate: swap right away, without waiting for the display
+//   - LowLatency: like VSync, but before reading the input for a frame, wait until the GPU has finished the previous
+//     one. Frames do not queue up behind each other, so the scene shown is at most a frame behind the input.
+extern OptionValue<PresentMode> presentMode;
+
+// When nothing is changing, block waiting for input rather than drawing frames, so that idle windows use almost no
+// CPU. The user callback only runs on frames which are drawn; a callback which animates something should call
+// requestRedraw() each frame to keep them coming. (default: false)
+extern bool enableIdleMode;
+
+// While idling, still draw a frame at least this often, in seconds (default: 0.5)
+extern double idleModeTimeoutSeconds;
+
 // Read preferences (window size, etc) from startup file, write to same file on exit (default: true)
 extern bool usePrefsFile;
 
@@ -52,28 +70,233 @@ extern bool invokeUserCallbackForNestedShow;
 // If true, focus the Polyscope window when shown (default: false)
 extern bool giveFocusOnShow;
 
+// Incremented whenever one of the options below held in an OptionValue<> is assigned a new value
+extern size_t changeCount;
+
 // === Scene options
 
 // Behavior of the ground plane
-extern GroundPlaneMode groundPlaneMode;
-extern bool groundPlaneEnabled; // deprecated, but kept and respected for compatability. use groundPlaneMode.
+extern OptionValue<GroundPlaneMode> groundPlaneMode;
+extern OptionValue<bool> groundPlaneEnabled; // deprecated, but kept and respected for compatability. use groundPlaneMode.
 extern ScaledValue<float> groundPlaneHeightFactor;
-extern int shadowBlurIters;
-extern float shadowDarkness;
+extern OptionValue<int> shadowBlurIters;
+extern OptionValue<float> shadowDarkness;
 
 extern bool screenshotTransparency;     // controls whether screenshots taken by clicking the GUI button have a
                                         // transparent background
 extern std::string screenshotExtension; // sets the extension used for automatically-numbered screenshots (e.g. by
                                         // clicking the GUI button)
 
+// If true, screenshot() returns as soon as the frame is rendered: the image is read back asynchronously, then encoded
+// and written by background threads. Use flushScreenshots() to wait for pending writes. (default: false)
+extern bool asyncScreenshots;
+extern int screenshotWriterThreads; // number of background threads writing async screenshots (default: 2)
+extern std::string ffmpegPath;       // the ffmpeg executable startRecording() pipes videos to (default: "ffmpeg")
+extern int recordingMaxQueuedFrames; // recorded frames waiting to be written before more are dropped (default: 8)
+extern int streamReadThreads;       // number of background threads reading each PointCloudStream (default: 2)
+extern int meshLoadThreads;         // number of background threads reading files for loadPolygonSoups() (default: 4)
+extern size_t meshLoadMemoryBudget; // bytes of those files read but not yet handed to the main thread (default: 1 GB)
+
 // === Rendering parameters
 
 // SSAA scaling in pixel multiples
-extern int ssaaFactor;
+extern OptionValue<int> ssaaFactor;
+
+// Samples per pixel for multisampled anti-aliasing (MSAA), one of 1, 2, 4, 8. Much cheaper than SSAA, but only applies
+// with TransparencyMode::None, and structures with a static hint are then drawn every frame. (default: 1)
+extern OptionValue<int> msaaSamples;
+
+// If true, a post-process FXAA pass smooths high-contrast edges as the scene is put on the display. Only applies without
+// SSAA. (default: false)
+extern bool enableFXAA;
+
+// If true, a screen-space eye-dome lighting pass darkens each pixel by how far its neighbors in the depth buffer lie in
+// front of it, which outlines silhouettes and creases using the depth alone. Meant for point clouds drawn with
+// PointRenderMode::Splat, which are otherwise flat. Does not apply with MSAA. (default: false)
+extern bool eyeDomeLighting;
+extern float eyeDomeLightingStrength; // (default: 1.)
+extern float eyeDomeLightingRadius;   // in pixels of the display (default: 1.5)
+
+// While nothing in the scene changes, render this many frames in total, each with the projection shifted by a
+// different sub-pixel offset, and show their running average. The image converges to a supersampled one over a few
+// idle frames. 1 disables it. (default: 1)
+extern OptionValue<int> temporalAntiAliasingFrames;
+
+// If true, frames drawn while the camera or the scene is changing use cheap settings: no SSAA, one transparency pass and
+// no shadow blur (point cloud LOD already draws a coarse subset while the camera moves). Once nothing has changed for
+// progressiveRenderingDelay seconds, the scene is drawn again with the full settings, and then refined by
+// temporalAntiAliasingFrames, if set. (default: false)
+extern bool progressiveRendering;
+extern double progressiveRenderingDelay; // (default: 0.25)
+
+// While the window is being resized, e.g. by dragging its border, the scene buffers are not reallocated for every new
+// size: the scene is drawn at the old size and stretched to the window until the size has not changed for this many
+// seconds. Screenshots always use the current size. (default: 0.15, 0 to resize right away)
+extern double screenBufferResizeDelay;
+
+// If true, the scene is drawn to 8-bit sRGB color buffers instead of 16-bit float ones whenever the tone mapping
+// saturates at or below 1 (render::engine whiteLevel <= exposure, as by default), except with simple transparency or
+// MSAA. This halves the memory bandwidth of every blend, copy and resolve of the scene. (default: true)
+extern bool compactSceneBuffers;
+
+// If positive, the resolution of the scene is adjusted continuously to keep the GPU time of a frame near this many
+// milliseconds: it is drawn at renderScale times the display resolution (on top of ssaaFactor) and resampled to it.
+// Frame times come from the GPU timers, which run for this even without enableGPUProfiling. Screenshots are always
+// taken at full resolution. (default: -1, off)
+extern double targetFrameTimeMs;
+extern float renderScaleMin; // (default: 0.5)
+extern float renderScaleMax; // above 1 supersamples when there is time to spare (default: 1.)
 
 // Transparency settings for the renderer
-extern TransparencyMode transparencyMode;
-extern int transparencyRenderPasses;
+extern OptionValue<TransparencyMode> transparencyMode;
+extern OptionValue<int> transparencyRenderPasses;
+
+// If true, depth peeling stops one pass past the last which drew anything in an earlier frame, so
+// transparencyRenderPasses only acts as a cap. Each pass is tested without waiting on the GPU, and the scene is drawn
+// again with more passes if the last one still drew, so a change which adds layers may take a frame to show. The number
+// of passes actually used is in render::engine->transparencyPassesUsed. (default: true)
+extern bool transparencyAdaptivePasses;
+
+// If true, with TransparencyMode::Simple the triangles of translucent smooth-shaded surface meshes are sorted back to
+// front whenever the view changes, so that blending in draw order mostly looks right in a single pass. Sorting is by
+// triangle center, so intersecting or very uneven triangles can still be out of order. Only the surface itself is
+// sorted: quantities drawn on the mesh keep their triangles in face order. (default: false)
+extern bool transparencySortTriangles;
+
+// If true, point clouds and curve networks are first drawn writing only depth, then shaded only where they are the
+// nearest surface. The ray-cast spheres, cylinders, and glyphs then pay for shading and lighting once per pixel rather
+// than once per overlapping fragment, which pays off for dense clouds and networks. Only used without transparency.
+// (default: false)
+extern OptionValue<bool> impostorDepthPrepass;
+
+// If true, structures write their unlit color and normal to a G-buffer, and the matcap lighting is done once per pixel
+// in a full-screen pass for each material, rather than for every fragment drawn. Helps scenes with heavy overdraw. Only
+// used without transparency and MSAA; in this mode structures are not drawn through the static layer or occlusion
+// culled. (default: false)
+extern OptionValue<bool> deferredShading;
+
+// If nonempty, linked shader programs are saved as driver-specific binaries in this (already existing) directory and
+// loaded from it on later runs, skipping shader compilation. Binaries from a different driver or for different shader
+// source are ignored and overwritten. Only supported by backends with program binaries. (default: "", disabled)
+extern std::string shaderCacheDirectory;
+
+// If nonempty, a file recording which shader programs (with their rules) were requested in a session. It is read by
+// init(), which queues those programs to be compiled during idle frames ahead of their first use (see
+// Engine::queueShaderWarmup()), and rewritten by shutdown(). Pairs well with shaderCacheDirectory. (default: "",
+// disabled)
+extern std::string shaderWarmupProfile;
+
+// Where the driver supports it (KHR_parallel_shader_compile), structures' shader programs are compiled and linked on the
+// driver's threads, and each structure is drawn once its programs are ready instead of the frame waiting for them.
+// Screenshots always wait. (default: true)
+extern bool parallelShaderCompilation;
+
+// Which GPU the headless openGL3_egl backend renders on, as an index in to the EGL device list. Run one process per
+// device to spread batch rendering over a multi-GPU node. Must be set before init(). (default: 0)
+extern int eglDeviceIndex;
+
+// Point clouds and vectors with at least this many elements are drawn as instanced billboards, expanded in the vertex
+// shader, rather than by expanding points in a geometry shader, which is slow on many GPUs for large counts. Set to 0 to
+// always draw instanced, or -1 to never do so. (default: 100000)
+extern long long int instancedDrawingThreshold;
+
+// Input arrays with at least this many elements which need converting element-by-element (e.g. a
+// std::vector<Eigen::Vector3d>) are converted on parallel threads, so any custom adaptor functions must be safe to call
+// concurrently. Set to -1 to always convert on the calling thread. (default: 100000)
+extern long long int parallelConversionThreshold;
+
+// Precision in which scalar quantities store their values. Single precision halves the host memory used and is uploaded
+// to the GPU without conversion; the GPU renders at single precision either way. The quantized precisions store 16 or 8
+// bit steps across the range of the values, for a quarter or an eighth of the memory, and are lossy (see
+// ScalarArray::quantizationError()). Applies to quantities added after it is set; see also
+// ScalarQuantity::setStoragePrecision(). (default: ScalarPrecision::Double)
+extern ScalarPrecision scalarPrecision;
+
+// Clip the initial colormap range of scalar quantities to the values between this percentile and 100 minus it, so that
+// a few outliers do not wash out the colormap (e.g. 1 for the 1st to 99th percentiles). The percentiles are estimated
+// in one pass, see approximatePercentileRange(). Applies to quantities added after it is set. (default: 0, the full
+// range)
+extern double scalarRangeClipPercentile;
+
+// Device memory budget, in bytes, for attribute and index buffers. While over budget, the render data of disabled
+// quantities is released, least recently drawn first; it is rebuilt if they are enabled again. -1 means no budget.
+// (default: -1)
+extern long long int gpuMemoryBudget;
+
+// Release the render data of quantities which have not been drawn for this many seconds. -1 means never.
+// (default: -1)
+extern double gpuReleaseIdleSeconds;
+
+// Store the matcap textures of materials and the ground plane tile compressed in GPU memory (BC6H and BC7, a byte per
+// texel), where the driver supports it. They are compressed by the driver as they are uploaded. Read when the render
+// engine is created. (default: true)
+extern bool compressMaterialTextures;
+
+// Host memory, in bytes, kept in pools for reuse by the temporary arrays of buffer fills (see ScratchVector), over all
+// threads. Larger reuse saves re-allocating big arrays on each refresh, at the cost of holding on to them. -1 means no
+// limit. (default: 1073741824, 1GB)
+extern long long int scratchMemoryBudget;
+
+// Skip drawing (and picking) structures whose bounding box is entirely outside the view frustum. The boxes are padded by
+// a tenth of the scene length scale, to cover glyphs such as points and vectors which extend past them.
+// (default: true)
+extern bool enableFrustumCulling;
+
+// Skip drawing (and picking) structures whose bounding box was entirely hidden behind the rest of the scene, tested with
+// GPU occlusion queries which are read a frame late. Structures can appear a frame after the view uncovers them. Only
+// applies to the normal single-pass rendering in a single view, and never to structures with the static hint.
+// (default: false)
+extern bool enableOcclusionCulling;
+
+// Surface meshes with at least this many triangles are split in to clusters of a few hundred consecutively drawn
+// triangles, and only the clusters which may be visible are drawn: those inside the view frustum, and with
+// BackFacePolicy::Cull, those not entirely facing away. Clusters are only as compact as the drawing order, so combine
+// with reorderForLocality for meshes whose faces come in an arbitrary order. -1 disables. (default: 1000000)
+extern long long int meshClusterCullingMinTriangles;
+
+// Answer pick queries by casting rays against the structures on the CPU, rather than rendering and reading back the
+// pick buffer; useful for headless or remote sessions, where the read back is slow. See pick::rayCast(). Region
+// queries always render. (default: false)
+extern bool cpuPicking;
+
+// Number of threads used for parallel geometry processing (e.g. computing mesh normals), including the calling thread.
+// 0 means one per hardware thread. (default: 0)
+extern int numThreads;
+
+// Surface and volume meshes drawing at least this many triangles fill the CPU side of their draw buffers on background
+// threads, so that the viewer stays responsive while they load; they are not drawn until the buffers are uploaded.
+// Screenshots wait for them. (default: 1000000)
+extern size_t backgroundPrepareMinTriangles;
+extern int bufferPreparationThreads; // number of background threads filling draw buffers (default: 2)
+
+// Point clouds and surface meshes registered while this is set draw their points / faces along a Morton curve through
+// space rather than in the order they were given, which helps vertex cache reuse and early depth rejection when that
+// order is spatially incoherent (e.g. merged scans). Only the drawing order changes: indices, quantities and picks all
+// stay in the given order. (default: false)
+extern bool reorderForLocality;
+
+// Trace the ribbons of surface vector quantities on those background threads, showing the lines as they are completed,
+// rather than stalling the frame which first draws them. Screenshots wait for the tracing. (default: false)
+extern bool backgroundFieldTracing;
+
+// Animation frames (e.g. PointCloud::addPositionFrame()) are kept on the GPU, up to this many per quantity; adding more
+// drops the oldest. (default: 256)
+extern size_t timeSeriesMaxFrames;
+
+// Animation frames streamed from a loader (e.g. PointCloud::setPositionFrameLoader()) are read ahead of the playhead,
+// in the direction of playback, on this many threads, keeping at most timeSeriesPrefetchFrames frames read but not yet
+// uploaded. timeSeriesStreamedGPUFrames of them (at least 2) are held on the GPU per quantity. (defaults: 2, 16, 8)
+extern int timeSeriesPrefetchThreads;
+extern size_t timeSeriesPrefetchFrames;
+extern size_t timeSeriesStreamedGPUFrames;
+
+// Volume mesh level sets draw only the tets which straddle the isovalue. The selections for this many recently shown
+// isovalues are kept on the GPU, so scrubbing back over them uploads nothing. (default: 8)
+extern size_t levelSetSelectionCacheSize;
+
+// Volume grid scalar quantities are stored on the GPU as 16-bit floats (R16F) rather than 32-bit (R32F), halving their
+// texture memory at the cost of about 3 significant digits. Applies to quantities added after it is set. (default: false)
+extern bool volumeGridHalfPrecision;
 
 // === Advanced ImGui configuration
 
@@ -90,10 +313,11 @@ extern bool openImGuiWindowForUserCallback;
 // may assign your own function to create custom styles. If this callback is null, the default ImGui style will be used.
 extern std::function<void()> configureImGuiStyleCallback;
 
-// A callback function which will be invoked exactly once during initialization to construct a font atlas for ImGui to
-// use. The callback should return a tuple of three pointers: a newly created global shared font atlas, a regular font,
-// and a mono font. By default, this is set to invoke prepareImGuiFonts() from Polyscope's imgui_config.cpp, but you may
-// assign your own function to create custom styles. If this callback is null, default fonts will be used.
+// A callback function which will be invoked once, before the first frame which draws ImGui, to construct a font atlas
+// for ImGui to use (the default builds ImGui's built-in font only, if buildGui is false). The callback should return a
+// tuple of three pointers: a newly created global shared font atlas, a regular font, and a mono font. By default, this
+// is set to invoke prepareImGuiFonts() from Polyscope's imgui_config.cpp, but you may assign your own function to
+// create custom styles. If this callback is null, default fonts will be used.
 extern std::function<std::tuple<ImFontAtlas*, ImFont*, ImFont*>()> prepareImGuiFontsCallback;
 
 
@@ -105,5 +329,18 @@ extern bool enableRenderErrorChecks;
 // Render the pick buffer to screen rather than the regular scene
 extern bool debugDrawPickBuffer;
 
+// Time each structure and render pass on the GPU, see render::Engine::getGPUTimings() (default: false)
+extern bool enableGPUProfiling;
+
+// Count the vertices, primitives, and shader invocations of each structure's draws on the GPU, where the driver supports
+// it (GL 4.6 or ARB_pipeline_statistics_query), see render::Engine::getPipelineStatistics() (default: false)
+extern bool enablePipelineStatistics;
+
+// Time the main loop and structure setup on the CPU, see polyscope::getFrameStats() (default: false)
+extern bool enableCPUProfiling;
+
+// Show percentiles of the CPU timings in a window over the scene, when profiling is enabled (default: false)
+extern bool showFrameStatsOverlay;
+
 } // namespace options
 } // namespace polyscope
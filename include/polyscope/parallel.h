@@ -0,0 +1,109 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace polyscope {
+
+// Calls blockFunc(blockStart, blockEnd) on contiguous blocks which together cover [start, end), spread over polyscope's
+// worker threads (see options::numThreads); returns once all blocks are done. Exceptions thrown by blockFunc are
+// rethrown here. Small ranges, nested calls, and builds with POLYSCOPE_NO_THREADS run on the calling thread instead.
+void parallelForBlocks(size_t start, size_t end, const std::function<void(size_t, size_t)>& blockFunc,
+                       size_t minBlockSize = 4096);
+
+// Calls func(i) for each i in [start, end), in parallel as above. func must be safe to call concurrently.
+template <typename F>
+void parallelFor(size_t start, size_t end, F&& func, size_t minBlockSize = 4096) {
+  parallelForBlocks(
+      start, end,
+      [&func](size_t blockStart, size_t blockEnd) {
+        for (size_t i = blockStart; i < blockEnd; i++) {
+          func(i);
+        }
+      },
+      minBlockSize);
+}
+
+// Reduces over [start, end): blockFunc(blockStart, blockEnd) returns the value of one block, and the values of the
+// blocks are folded with combine(accumulated, blockValue), in order of the blocks, starting from identity. So the result
+// does not depend on which thread ran which block, even for combinations which are not associative (floating point sums).
+template <typename T, typename BlockF, typename CombineF>
+T parallelReduce(size_t start, size_t end, T identity, BlockF&& blockFunc, CombineF&& combine,
+                 size_t minBlockSize = 4096) {
+  std::vector<std::pair<size_t, T>> blockValues;
+  std::mutex blockValuesMutex;
+  parallelForBlocks(
+      start, end,
+      [&](size_t blockStart, size_t blockEnd) {
+        T value = blockFunc(blockStart, blockEnd);
+        std::lock_guard<std::mutex> lock(blockValuesMutex);
+        blockValues.emplace_back(blockStart, std::move(value));
+      },
+      minBlockSize);
+
+  std::sort(blockValues.begin(), blockValues.end(),
+            [](const std::pair<size_t, T>& a, const std::pair<size_t, T>& b) { return a.first < b.first; });
+  T result = std::move(identity);
+  for (std::pair<size_t, T>& blockValue : blockValues) {
+    result = combine(std::move(result), std::move(blockValue.second));
+  }
+  return result;
+}
+
+// The number of threads parallelFor() runs on, including the calling thread
+size_t parallelThreadCount();
+
+// Runs task(0), ..., task(nTasks - 1), possibly concurrently, and returns once all of them have finished
+typedef std::function<void(size_t nTasks, const std::function<void(size_t)>& task)> ParallelExecutor;
+
+// Run the blocks of parallelFor() and friends on the application's own threads (e.g. with tbb::parallel_for, or on an
+// application thread pool) rather than on polyscope's pool, which is then shut down, so that the two do not compete for
+// cores. options::numThreads still sets how many blocks a loop is split in to. Loops started inside a task run inline.
+// An empty executor returns to polyscope's own pool. Has no effect in builds with POLYSCOPE_NO_THREADS.
+void setParallelExecutor(ParallelExecutor executor);
+
+// Sorts keys, and values along with them, with a parallel LSD radix sort. The sort is stable. Only the low keyBits bits
+// of the keys are considered, so passing a tighter bound on the keys saves passes.
+void parallelSortByKey(std::vector<uint64_t>& keys, std::vector<size_t>& values, unsigned int keyBits = 64);
+
+// A queue of jobs which run in order on a few threads of its own, for slow work which should not hold up frames
+// (writing or reading files). Destroying the queue finishes the jobs already pushed. Builds with POLYSCOPE_NO_THREADS
+// run each job inside push() instead.
+class JobQueue {
+public:
+  JobQueue(int nThreads);
+  ~JobQueue();
+
+  void push(std::function<void()> job);
+  void wait(); // block until every pushed job has finished
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
+
+// Work pushed to a JobQueue whose completion the main thread polls for, e.g. once per frame, for CPU work which would
+// otherwise stall frames (filling the draw buffers of a large structure). Destroying the task waits for the work.
+class BackgroundTask {
+public:
+  BackgroundTask(JobQueue& queue, std::function<void()> work);
+  ~BackgroundTask();
+  BackgroundTask(const BackgroundTask&) = delete;
+  BackgroundTask& operator=(const BackgroundTask&) = delete;
+
+  bool isDone() const;
+  void finish(); // block until the work has run; rethrows anything it threw
+
+private:
+  struct State;
+  std::shared_ptr<State> state;
+};
+
+} // namespace polyscope
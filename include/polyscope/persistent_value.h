@@ -9,9 +9,11 @@
 #include "polyscope/render/materials.h"
 #include "polyscope/surface_parameterization_enums.h"
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace polyscope {
 
@@ -27,11 +29,55 @@ namespace polyscope {
 
 
 namespace detail {
-// Simple wrapper class holding the cache for persistent values
+// Holds the cache for persistent values of one type. Each name is interned once to a compact integer id, and the
+// values are stored in a flat array indexed by id, so that a PersistentValue hashes its name only on construction.
 template <typename T>
 class PersistentCache {
 public:
-  std::unordered_map<std::string, T> cache;
+  // Get the id of a name, adding it (without a value) on first use
+  size_t intern(const std::string& name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+    size_t id = entries.size();
+    ids.emplace(name, id);
+    entries.push_back(Entry{name, T(), false});
+    return id;
+  }
+
+  bool has(size_t id) const { return entries[id].stored; }
+  const T& get(size_t id) const { return entries[id].value; }
+  void store(size_t id, const T& value) {
+    entries[id].value = value;
+    entries[id].stored = true;
+  }
+
+  // Forget all values (the ids stay valid)
+  void clear() {
+    for (Entry& e : entries) e.stored = false;
+  }
+
+  // Number of names which hold a value
+  size_t size() const {
+    return std::count_if(entries.begin(), entries.end(), [](const Entry& e) { return e.stored; });
+  }
+
+  // Invoke f(name, value) for each name which holds a value
+  template <typename F>
+  void forEach(F&& f) const {
+    for (const Entry& e : entries) {
+      if (e.stored) f(e.name, e.value);
+    }
+  }
+
+private:
+  // (a struct rather than parallel arrays, so that entries of bools are not packed in to a std::vector<bool>)
+  struct Entry {
+    std::string name;
+    T value;
+    bool stored;
+  };
+  std::unordered_map<std::string, size_t> ids;
+  std::vector<Entry> entries;
 };
 // Helper to get the global cache for a particular type of persistent value
 template <typename T>
@@ -42,13 +88,15 @@ template <typename T>
 class PersistentValue {
 public:
   // Basic constructor, used on initial creation
-  PersistentValue(const std::string& name_, T value_) : name(name_), value(value_) {
-    if (detail::getPersistentCacheRef<T>().cache.find(name) != detail::getPersistentCacheRef<T>().cache.end()) {
-      value = detail::getPersistentCacheRef<T>().cache[name];
+  PersistentValue(const std::string& name_, T value_)
+      : id(detail::getPersistentCacheRef<T>().intern(name_)), value(value_) {
+    detail::PersistentCache<T>& cache = detail::getPersistentCacheRef<T>();
+    if (cache.has(id)) {
+      value = cache.get(id);
       holdsDefaultValue = false;
     } else {
       // Update cache value
-      detail::getPersistentCacheRef<T>().cache[name] = value;
+      cache.store(id, value);
     }
   }
 
@@ -89,8 +137,12 @@ public:
   // Explicit setter, which takes care of storing in cache
   void set(T value_) {
     value = value_;
-    detail::getPersistentCacheRef<T>().cache[name] = value;
     holdsDefaultValue = false;
+
+    // skip the cache write (which may copy e.g. a string) when it already holds the value
+    detail::PersistentCache<T>& cache = detail::getPersistentCacheRef<T>();
+    if (cache.has(id) && cache.get(id) == value) return;
+    cache.store(id, value);
   }
 
   // Passive setter, will change value without marking in cache; does nothing if some value has already been directly
@@ -98,7 +150,7 @@ public:
   void setPassive(T value_) {
     if (holdsDefaultValue) {
       value = value_;
-      detail::getPersistentCacheRef<T>().cache[name] = value;
+      detail::getPersistentCacheRef<T>().store(id, value);
     }
   }
 
@@ -107,7 +159,7 @@ public:
   friend class PersistentValue;
 
 private:
-  const std::string name;
+  const size_t id; // of the name in the cache
   T value;
   bool holdsDefaultValue = true; // True if the value was set on construction and never changed. False if it was pulled
                                  // from cache or has ever been explicitly set
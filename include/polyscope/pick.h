@@ -4,7 +4,11 @@
 #include "polyscope/structure.h"
 
 #include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
 #include <utility>
+#include <vector>
 
 namespace polyscope {
 namespace pick {
@@ -15,12 +19,62 @@ namespace pick {
 // Request 'count' contiguous indices for drawing a pick buffer. The return value is the start of the range.
 size_t requestPickBufferRange(Structure* requestingStructure, size_t count);
 
+// Give back every range held by a structure, so later requests can reuse the indices. Structures release their ranges
+// before requesting new ones when they rebuild their pick buffers, and when they are destroyed.
+void releasePickBufferRanges(Structure* releasingStructure);
+
 
 // == Main query
 // Get the structure which was clicked on (nullptr if none), and the pick ID in local indices for that structure (such
 // that 0 is the first index as returned from requestPickBufferRange())
 std::pair<Structure*, size_t> evaluatePickQuery(int xPos, int yPos);
 
+// The same for many pixels at once, with a result for each. The pick buffer is rendered once, for the bounding box of
+// the pixels (once per viewport, while viewports are shown), and read back in one go.
+std::vector<std::pair<Structure*, size_t>> evaluatePickQueries(const std::vector<glm::ivec2>& pixels);
+
+// Queries only render the pick buffer if the scene, the view or the buffer size changed since it was last rendered
+// (tracked by state::redrawRequestCount and state::sceneRenderCount), or if they need pixels it does not hold yet, so
+// repeated queries on an unchanged frame just read it back.
+
+
+// == Asynchronous query
+// Like evaluatePickQuery(), but renders only a small region around the cursor and reads it back without stalling the
+// pipeline. The query is resolved a frame or two later by processAsyncPickQueries(), which the main loop calls once per
+// frame; poll the returned query, or pass a callback to be invoked with the result when it is resolved.
+struct AsyncPickQuery {
+  bool isResolved = false;
+  std::pair<Structure*, size_t> result{nullptr, 0}; // valid once isResolved is true
+  std::function<void(std::pair<Structure*, size_t>)> callback;
+  std::shared_ptr<render::PendingFloat4Read> pendingRead;
+};
+std::shared_ptr<AsyncPickQuery>
+evaluatePickQueryAsync(int xPos, int yPos, std::function<void(std::pair<Structure*, size_t>)> callback = nullptr);
+void processAsyncPickQueries(); // resolve any queries whose read has finished
+bool haveAsyncPickQueries();     // true while any query is unresolved
+
+
+// == Region query
+// Get every element drawn in a region of the screen, in the same pixel coordinates as evaluatePickQuery(): either the
+// polygon through the given points (e.g. a lasso, with any winding), or the rectangle with the given corners. The pick
+// buffer is rendered once, for just the region's bounding box. The result holds the local pick indices drawn in the
+// region for each structure which has any, sorted and without repeats.
+std::map<Structure*, std::vector<size_t>> queryRegion(const std::vector<glm::vec2>& polygon);
+std::map<Structure*, std::vector<size_t>> queryRegion(glm::vec2 cornerA, glm::vec2 cornerB);
+
+
+// == CPU queries
+// Pick without rendering, from hierarchies over the elements which each structure builds on its first query (see
+// Structure::rayCastElement()). Only surface meshes (their vertices and faces), point clouds and curve networks are
+// found, and slice planes are ignored. With options::cpuPicking set, evaluatePickQuery() and evaluatePickQueryAsync()
+// answer this way too.
+
+// The element first hit by the ray rayStart + t * rayDir for t >= 0, with tHit set to its t; {nullptr, 0} for none
+std::pair<Structure*, size_t> rayCast(glm::vec3 rayStart, glm::vec3 rayDir, float* tHit = nullptr);
+
+// The element closest to a world space point (e.g. for hover tooltips), with dist set to its distance
+std::pair<Structure*, size_t> closestElement(glm::vec3 worldPos, float* dist = nullptr);
+
 
 // == Stateful picking: track and update a current selection
 
@@ -3,17 +3,26 @@
 
 #include "polyscope/affine_remapper.h"
 #include "polyscope/color_management.h"
+#include "polyscope/dirty_ranges.h"
+#include "polyscope/element_bvh.h"
 #include "polyscope/persistent_value.h"
+#include "polyscope/point_cloud_octree.h"
 #include "polyscope/point_cloud_quantity.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/render/engine.h"
+#include "polyscope/scalar_array.h"
 #include "polyscope/scaled_value.h"
+#include "polyscope/shared_vertex_positions.h"
 #include "polyscope/standardize_data_array.h"
 #include "polyscope/structure.h"
+#include "polyscope/time_frames.h"
 
+#include "polyscope/point_cloud_channels_quantity.h"
 #include "polyscope/point_cloud_color_quantity.h"
+#include "polyscope/point_cloud_expression_quantity.h"
 #include "polyscope/point_cloud_parameterization_quantity.h"
 #include "polyscope/point_cloud_scalar_quantity.h"
+#include "polyscope/point_cloud_sparse_scalar_quantity.h"
 #include "polyscope/point_cloud_vector_quantity.h"
 
 #include <vector>
@@ -24,8 +33,11 @@ namespace polyscope {
 class PointCloud;
 
 // Forward declare quantity types
+class PointCloudChannelsQuantity;
 class PointCloudColorQuantity;
+class PointCloudExpressionQuantity;
 class PointCloudScalarQuantity;
+class PointCloudSparseScalarQuantity;
 class PointCloudParameterizationQuantity;
 class PointCloudVectorQuantity;
 
@@ -41,6 +53,8 @@ public:
 
   // Construct a new point cloud structure
   PointCloud(std::string name, std::vector<glm::vec3> points);
+  PointCloud(std::string name, std::shared_ptr<SharedVertexPositions> sharedPoints); // see SharedVertexPositions
+  ~PointCloud();
 
   // === Overrides
 
@@ -54,6 +68,7 @@ public:
   virtual void drawPick() override;
   virtual void updateObjectSpaceBounds() override;
   virtual std::string typeName() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void refresh() override;
 
   // === Quantities
@@ -62,6 +77,13 @@ public:
   template <class T>
   PointCloudScalarQuantity* addScalarQuantity(std::string name, const T& values, DataType type = DataType::STANDARD);
 
+  // A scalar on only some of the points, as (point index, value) pairs, stored with memory proportional to the number of
+  // values (see PointCloudSparseScalarQuantity). Raises an error() and returns nullptr for clouds of more than 2^24
+  // points.
+  PointCloudSparseScalarQuantity* addSparseScalarQuantity(std::string name,
+                                                          const std::vector<std::pair<size_t, double>>& values,
+                                                          DataType type = DataType::STANDARD);
+
   // Parameterization
   template <class T>
   PointCloudParameterizationQuantity* addParameterizationQuantity(std::string name, const T& values,
@@ -82,12 +104,91 @@ public:
   PointCloudVectorQuantity* addVectorQuantity2D(std::string name, const T& vectors,
                                                 VectorType vectorType = VectorType::STANDARD);
 
+  // Many scalar channels at once, stored and uploaded together (see PointCloudChannelsQuantity). channels[c] holds the
+  // value of channel c at each point. The interleaved version takes all channels of the first point, then all channels
+  // of the second point, ...
+  template <class T>
+  PointCloudChannelsQuantity* addChannelsQuantity(std::string name, const std::vector<std::string>& channelNames,
+                                                  const std::vector<T>& channels);
+  template <class T>
+  PointCloudChannelsQuantity* addInterleavedChannelsQuantity(std::string name,
+                                                             const std::vector<std::string>& channelNames,
+                                                             const T& values);
+
+  // A scalar computed on the GPU from the scalar and vector quantities of the cloud, like "|velocity| * {rest density}"
+  // (see Expression for the syntax, and PointCloudExpressionQuantity). Raises an error() and returns nullptr if the
+  // expression does not parse, or does not evaluate to a scalar.
+  PointCloudExpressionQuantity* addExpressionQuantity(std::string name, std::string expression);
+
   // === Mutate
   template <class V>
   void updatePointPositions(const V& newPositions);
   template <class V>
   void updatePointPositions2D(const V& newPositions);
 
+  // Move only some points, newPositions[i] is the new position of point indices[i]. Only the affected spans of the
+  // buffers are uploaded, once per frame.
+  template <class V>
+  void updatePointPositions(const std::vector<size_t>& indices, const V& newPositions);
+
+  // For positions computed on the GPU, e.g. by a CUDA simulation, with no copy through the host: register the buffer of
+  // getPositionRenderBuffer()->getNativeHandle() with the compute API (cudaGraphicsGLRegisterBuffer()), write it in
+  // place, then call this. Pass a fence (a GLsync) if the writes may still be running; the draws wait for it on the
+  // GPU. The bounds and length scale are then reduced from the buffer on the GPU, and follow a few frames later.
+  // `points` keeps the positions last set from the host, which the pick UI and picking still use.
+  void devicePositionsWritten(void* fence = nullptr);
+
+  // === Streaming
+  // For points which arrive over time. appendPoints() adds points at the end of `points` and uploads just those: once
+  // points are appended, the per-point buffers are allocated with room to spare, and reallocated at twice the size when
+  // they fill up. Scalar and color quantities hold zeros for the new points until their appendValues() is called, and
+  // vector quantities zero vectors; the other quantities are removed. Clouds which share their positions or have time
+  // frames can not be appended to, and a cloud with a point radius quantity is uploaded again at each append.
+  //
+  // With setMaxPoints(n), only the n most recent points are kept, for rolling displays: once the cloud holds n points,
+  // each new point replaces the oldest one, in its place in `points` (see pointSlot()).
+  template <class V>
+  PointCloud* appendPoints(const V& newPoints);
+  PointCloud* setMaxPoints(size_t newVal); // 0 for no limit (the default); not once a point has been replaced
+  size_t getMaxPoints();
+  size_t nPointsAdded();           // points registered or appended so far, including those which were replaced
+  size_t pointSlot(size_t iAdded); // the index in `points` of the iAdded'th point added, if it is still kept
+
+  // === Animation
+  // Frames of positions for playback, each uploaded once and kept on the GPU (up to options::timeSeriesMaxFrames);
+  // the registered points are frame 0. setTime() picks the frame to draw, t = 2.5 draws frame 2, or halfway between
+  // frames 2 and 3 with interpolation enabled. Changing the time uploads nothing. The pick UI and vector quantities
+  // use the registered points, and animated clouds are drawn without level of detail.
+  template <class V>
+  PointCloud* addPositionFrame(const V& framePositions);
+
+  // For series too long to hold on the GPU: frames of positions (3 floats per point) read from a loader while playing,
+  // e.g. rawFileFrameLoader() for a file per frame. Frames ahead of the playhead are read on background threads and
+  // uploaded to a few GPU buffers before they are drawn (see options::timeSeriesPrefetchFrames), so playing or scrubbing
+  // in either direction only waits for a read after a jump. Replaces any added frames, frame 0 included. The scene
+  // extent covers the registered points only.
+  PointCloud* setPositionFrameLoader(size_t nFrames, TimeFrameLoader loader);
+  PointCloud* setTime(double newTime);
+  double getTime();
+  size_t nTimeFrames(); // frames of the positions or of any quantity (see PointCloudScalarQuantity::addValueFrame())
+  PointCloud* setTimeInterpolation(bool newVal);
+  bool getTimeInterpolation();
+
+  // The positions this cloud shares with other structures, or nullptr. Moving the points of such a cloud moves them for
+  // all of those structures.
+  std::shared_ptr<SharedVertexPositions> getSharedPositions() { return sharedPositions; }
+
+  // === Level of detail
+  // For clouds too large to draw in full. The points are organized in an octree when first drawn, and only a subset is
+  // uploaded and drawn: the parts of the cloud which are in view and large on screen, up to a point budget. A quarter
+  // of the budget is used while the camera moves, and the subset is refined once it stops. Quantities are drawn on the
+  // same subset. Moving the points rebuilds the octree. At most 2^32 - 1 points.
+  PointCloud* setLODEnabled(bool newVal);
+  bool getLODEnabled();
+  PointCloud* setLODPointBudget(size_t newVal);
+  size_t getLODPointBudget();
+  size_t nDrawnPoints(); // the number of points in the buffers: all of them, or the current LOD subset
+
   // === Set point size from a scalar quantity
   // effect is multiplicative with pointRadius
   // negative values are always clamped to 0
@@ -120,15 +221,53 @@ public:
   PointCloud* setPointRadius(double newVal, bool isRelative = true);
   double getPointRadius();
 
+  // the size of the points in pixels, with PointRenderMode::Splat (which ignores the radius). A variable radius
+  // quantity scales it, relative to its largest value.
+  PointCloud* setPointSplatSize(double newVal);
+  double getPointSplatSize();
+
   // Material
   PointCloud* setMaterial(std::string name);
   std::string getMaterial();
+  virtual std::string drawBatchKey() override;
+  virtual bool drawsInDepthPrepass() override;
 
   // Rendering helpers used by quantities
   void setPointCloudUniforms(render::ShaderProgram& p);
   void fillGeometryBuffers(render::ShaderProgram& p);
+  void updateGeometryBuffers(render::ShaderProgram& p, // rewrite positions of these points in a program filled above
+                             const std::vector<std::pair<size_t, size_t>>& pointRanges);
   std::vector<std::string> addPointCloudRules(std::vector<std::string> initRules, bool withPointCloud = true);
   std::string getShaderNameForRenderMode();
+  bool useInstancedDrawing(); // if true, the program names and rules above select the *_INSTANCED variants
+
+  void timeFramesAdded(size_t nFrames); // called by quantities adding frames
+
+  // Per-point attributes go through these, which upload the points in the order they are drawn: just the entries of
+  // the LOD subset when there is one, or all of them in the draw order of options::reorderForLocality.
+  bool drawsLODSubset();
+  const std::vector<uint32_t>* drawnPointIndices(); // the points in the buffers, or nullptr for all of them in order
+  // (with update = true, the existing buffer of the attribute is rewritten)
+  template <class T>
+  void setPointAttribute(render::ShaderProgram& p, std::string attributeName, const std::vector<T>& data,
+                         bool update = false);
+  void setPointAttribute(render::ShaderProgram& p, std::string attributeName, const ScalarArray& data,
+                         bool update = false);
+  template <class T>
+  std::vector<T> lodSubsetValues(const std::vector<T>& data); // data[i] for each point i of the LOD subset
+  // (rewrite the entries of some ranges of points, in an attribute set by the above)
+  template <class T>
+  void updatePointAttributeRanges(render::ShaderProgram& p, std::string attributeName, const std::vector<T>& data,
+                                  const std::vector<std::pair<size_t, size_t>>& pointRanges);
+  void updatePointAttributeRanges(render::ShaderProgram& p, std::string attributeName, const ScalarArray& data,
+                                  const std::vector<std::pair<size_t, size_t>>& pointRanges);
+
+  // The positions of all of the points on the GPU, bound by the programs drawing the points (unless they are drawn in
+  // another order) and by the vector quantities, so they are uploaded once. nullptr while a level of detail or animated
+  // frames are drawn, and once points are appended. Moving points updates it in place.
+  std::shared_ptr<render::AttributeBuffer> getPositionRenderBuffer();
+  bool drawsAllPointsInOrder(); // do the buffers hold exactly `points`, so that per-point buffers can be bound?
+  void scalarValuesUpdated(PointCloudScalarQuantity& q); // called by scalar quantities, in case q sets the radius
 
 
 private:
@@ -137,12 +276,69 @@ private:
   PersistentValue<std::string> pointRenderMode;
   PersistentValue<glm::vec3> pointColor;
   PersistentValue<ScaledValue<float>> pointRadius;
+  PersistentValue<float> pointSplatSize;
   PersistentValue<std::string> material;
 
   // Drawing related things
   // if nullptr, prepare() (resp. preparePick()) needs to be called
   std::shared_ptr<render::ShaderProgram> program;
   std::shared_ptr<render::ShaderProgram> pickProgram;
+  render::ShaderUniformHandle baseColorHandle; // in `program`, resolved when it is created
+
+  // Points which moved since the buffers were last uploaded; draw() and drawPick() flush them
+  DirtyRanges dirtyPoints;     // for `program` and the quantities
+  DirtyRanges pickDirtyPoints; // for `pickProgram`
+  void flushGeometryUpdates();
+
+  // Level of detail
+  PersistentValue<bool> lodEnabled;
+  size_t lodPointBudget = 3000000;
+  std::unique_ptr<PointCloudOctree> lodOctree; // built on the first draw with LOD enabled, dropped when points move
+  std::vector<uint32_t> lodPoints;             // the subset being drawn, as indices in to `points`
+  bool lodSelectionValid = false;
+  bool lodSelectionRefined = false;      // chosen with the full budget
+  size_t lodSelectionSceneRender = 0;    // state::sceneRenderCount when last checked
+  glm::mat4 lodModelView, lodProjection; // camera the subset was chosen for
+  bool lodPickRangeRequested = false;    // every subset reuses one pick range covering all points
+  size_t lodPickStart = 0;
+  void updateLODSelection(); // (at most once per frame)
+
+  // The points along a Morton curve, when options::reorderForLocality was set at registration; empty when they are drawn
+  // in order. Dropped when frames are added, since those are uploaded in order.
+  std::vector<uint32_t> drawOrder;
+
+  // CPU picking, over every point regardless of the LOD subset, as spheres of the drawn radius
+  std::unique_ptr<ElementBVH> pickBVH;     // built on the first query, dropped when points move
+  std::vector<double> pickBVHRadiusScales; // the resolved point radius quantity when the BVH was built, if any
+  double pickBVHMaxRadiusScale = 1.;
+  virtual bool rayCastElementObjectSpace(glm::vec3 rayStart, glm::vec3 rayDir, float objectScale, float& tHit,
+                                         size_t& localPickInd) override;
+  virtual bool closestElementObjectSpace(glm::vec3 point, float objectScale, float& dist,
+                                         size_t& localPickInd) override;
+  void ensurePickBVH();
+  double pickPointRadius(size_t iP); // the drawn radius of a point
+  double pickMaxPointRadius();
+
+  // Streaming
+  size_t maxPoints = 0;
+  size_t nPointsAddedCount = 0;
+  size_t bufferCapacity = 0;   // points the per-point buffers have room for once points are appended, 0 before
+  size_t bufferedPointCount(); // the entries of the per-point buffers, at least nDrawnPoints()
+  void appendPointsImpl(const std::vector<glm::vec3>& newPoints);
+
+  // Animation
+  std::unique_ptr<TimeFrameBuffers> positionFrames; // null if the positions are not animated
+  size_t timeFrameCount = 0;
+  double time = 0.;
+  bool timeInterpolation = false;
+  void addPositionFrameImpl(const std::vector<glm::vec3>& framePositions);
+  void bindPositionFrames(render::ShaderProgram& p); // the frames at the current time
+  glm::vec3 frameBoundsMin, frameBoundsMax;         // of the frames after the first
+
+  // Bounds of positions written on the GPU, reduced there in two passes: the box, then the distance from its center for
+  // the length scale. Updating the bounds from the host discards results still in flight.
+  size_t boundsGeneration = 0;
+  void reduceDeviceBounds();
 
   // === Helpers
   // Do setup work related to drawing, including allocating openGL data
@@ -150,6 +346,14 @@ private:
   void preparePick();
   void geometryChanged();
 
+  // Shared positions, if any; `points` is kept as a copy of them
+  std::shared_ptr<SharedVertexPositions> sharedPositions;
+  bool drawsSharedPositions(); // do the programs bind the shared buffer, rather than their own copy of the positions?
+  std::shared_ptr<render::AttributeBuffer> positionBuffer; // the cloud's own, when not sharing positions
+  void sharedPositionsMoved(const std::vector<size_t>* movedIndices);
+  void pointsMoved(const std::vector<size_t>& indices);
+  void updatePointPositionsImpl(const std::vector<size_t>& indices, const std::vector<glm::vec3>& newPositions);
+
   // === Quantity adder implementations
   PointCloudScalarQuantity* addScalarQuantityImpl(std::string name, const std::vector<double>& data, DataType type);
   PointCloudParameterizationQuantity*
@@ -159,18 +363,24 @@ private:
   PointCloudColorQuantity* addColorQuantityImpl(std::string name, const std::vector<glm::vec3>& colors);
   PointCloudVectorQuantity* addVectorQuantityImpl(std::string name, const std::vector<glm::vec3>& vectors,
                                                   VectorType vectorType);
+  PointCloudChannelsQuantity* addChannelsQuantityImpl(std::string name, const std::vector<std::string>& channelNames,
+                                                      std::vector<float> channelValues);
 
   // Manage varying point size
   // which (scalar) quantity to set point size from
   std::string pointRadiusQuantityName = ""; // empty string means none
   bool pointRadiusQuantityAutoscale = true;
-  std::vector<double> resolvePointRadiusQuantity(); // helper
+  PointCloudScalarQuantity* resolvePointRadiusQuantity(); // raises an error() and returns nullptr if it is not one
+  // The radius quantity is bound as is, and the shaders clamp it to nonnegative and multiply it by this
+  double pointRadiusValueScale(PointCloudScalarQuantity& q);
 };
 
 
 // Shorthand to add a point cloud to polyscope
 template <class T>
 PointCloud* registerPointCloud(std::string name, const T& points);
+inline PointCloud* registerPointCloud(std::string name, std::vector<glm::vec3>&& points); // takes the points, no copy
+inline PointCloud* registerPointCloud(std::string name, const std::shared_ptr<SharedVertexPositions>& sharedPoints);
 template <class T>
 PointCloud* registerPointCloud2D(std::string name, const T& points);
 
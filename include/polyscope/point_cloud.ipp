@@ -16,6 +16,26 @@ PointCloud* registerPointCloud(std::string name, const T& points) {
   }
   return s;
 }
+inline PointCloud* registerPointCloud(std::string name, std::vector<glm::vec3>&& points) {
+  checkInitialized();
+
+  PointCloud* s = new PointCloud(name, std::move(points));
+  bool success = registerStructure(s);
+  if (!success) {
+    safeDelete(s);
+  }
+  return s;
+}
+inline PointCloud* registerPointCloud(std::string name, const std::shared_ptr<SharedVertexPositions>& sharedPoints) {
+  checkInitialized();
+
+  PointCloud* s = new PointCloud(name, sharedPoints);
+  bool success = registerStructure(s);
+  if (!success) {
+    safeDelete(s);
+  }
+  return s;
+}
 template <class T>
 PointCloud* registerPointCloud2D(std::string name, const T& points) {
   checkInitialized();
@@ -24,7 +44,7 @@ PointCloud* registerPointCloud2D(std::string name, const T& points) {
   for (auto& v : points3D) {
     v.z = 0.;
   }
-  PointCloud* s = new PointCloud(name, points3D);
+  PointCloud* s = new PointCloud(name, std::move(points3D));
   bool success = registerStructure(s);
   if (!success) {
     safeDelete(s);
@@ -34,10 +54,34 @@ PointCloud* registerPointCloud2D(std::string name, const T& points) {
 
 template <class V>
 void PointCloud::updatePointPositions(const V& newPositions) {
+  validateSize(newPositions, nPoints(), "point cloud updated positions " + name);
+  if (sharedPositions) {
+    sharedPositions->updateVertexPositions(newPositions); // calls back to update this cloud too
+    return;
+  }
   points = standardizeVectorArray<glm::vec3, 3>(newPositions);
   geometryChanged();
 }
 
+template <class V>
+void PointCloud::updatePointPositions(const std::vector<size_t>& indices, const V& newPositions) {
+  validateSize(newPositions, indices.size(), "point cloud updated positions " + name);
+  updatePointPositionsImpl(indices, standardizeVectorArray<glm::vec3, 3>(newPositions));
+}
+
+template <class V>
+PointCloud* PointCloud::appendPoints(const V& newPoints) {
+  appendPointsImpl(standardizeVectorArray<glm::vec3, 3>(newPoints));
+  return this;
+}
+
+template <class V>
+PointCloud* PointCloud::addPositionFrame(const V& framePositions) {
+  validateSize(framePositions, nPoints(), "point cloud position frame " + name);
+  addPositionFrameImpl(standardizeVectorArray<glm::vec3, 3>(framePositions));
+  return this;
+}
+
 template <class V>
 void PointCloud::updatePointPositions2D(const V& newPositions2D) {
   std::vector<glm::vec3> positions3D = standardizeVectorArray<glm::vec3, 2>(newPositions2D);
@@ -49,6 +93,48 @@ void PointCloud::updatePointPositions2D(const V& newPositions2D) {
   updatePointPositions(positions3D);
 }
 
+template <class T>
+void PointCloud::setPointAttribute(render::ShaderProgram& p, std::string attributeName, const std::vector<T>& data,
+                                   bool update) {
+  const std::vector<uint32_t>* drawnInds = drawnPointIndices();
+  if (drawnInds == nullptr && bufferCapacity > data.size()) {
+    std::vector<T> padded(data);
+    padded.resize(bufferCapacity, T());
+    p.setAttribute(attributeName, padded, update);
+    return;
+  }
+  if (drawnInds == nullptr) {
+    p.setAttribute(attributeName, data, update);
+    return;
+  }
+  std::vector<T> drawnData(drawnInds->size());
+  for (size_t i = 0; i < drawnInds->size(); i++) {
+    drawnData[i] = data[(*drawnInds)[i]];
+  }
+  p.setAttribute(attributeName, drawnData, update);
+}
+
+template <class T>
+std::vector<T> PointCloud::lodSubsetValues(const std::vector<T>& data) {
+  std::vector<T> subset(lodPoints.size());
+  for (size_t i = 0; i < lodPoints.size(); i++) {
+    subset[i] = data[lodPoints[i]];
+  }
+  return subset;
+}
+
+
+template <class T>
+void PointCloud::updatePointAttributeRanges(render::ShaderProgram& p, std::string attributeName,
+                                            const std::vector<T>& data,
+                                            const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (drawnPointIndices()) {
+    setPointAttribute(p, attributeName, data, true); // the points of the ranges are spread through the buffer
+    return;
+  }
+  p.updateAttributeRanges(attributeName, data, pointRanges);
+}
+
 
 // Shorthand to get a point cloud from polyscope
 inline PointCloud* getPointCloud(std::string name) {
@@ -78,6 +164,41 @@ PointCloudScalarQuantity* PointCloud::addScalarQuantity(std::string name, const
   return addScalarQuantityImpl(name, standardizeArray<double, T>(data), type);
 }
 
+template <class T>
+PointCloudChannelsQuantity* PointCloud::addChannelsQuantity(std::string name,
+                                                            const std::vector<std::string>& channelNames,
+                                                            const std::vector<T>& channels) {
+  if (channels.size() != channelNames.size()) {
+    error("point cloud channels quantity " + name + " has " + std::to_string(channelNames.size()) +
+          " channel names but " + std::to_string(channels.size()) + " channels");
+  }
+  std::vector<float> channelValues;
+  channelValues.reserve(channelNames.size() * nPoints());
+  for (const T& channel : channels) {
+    validateSize(channel, nPoints(), "point cloud channels quantity " + name);
+    std::vector<float> values = standardizeArray<float, T>(channel);
+    channelValues.insert(channelValues.end(), values.begin(), values.end());
+  }
+  return addChannelsQuantityImpl(name, channelNames, std::move(channelValues));
+}
+
+template <class T>
+PointCloudChannelsQuantity* PointCloud::addInterleavedChannelsQuantity(std::string name,
+                                                                       const std::vector<std::string>& channelNames,
+                                                                       const T& values) {
+  size_t nChannels = channelNames.size();
+  validateSize(values, nChannels * nPoints(), "point cloud channels quantity " + name);
+  std::vector<float> interleaved = standardizeArray<float, T>(values);
+  interleaved.resize(nChannels * nPoints());
+  std::vector<float> channelValues(interleaved.size());
+  for (size_t iP = 0; iP < nPoints(); iP++) {
+    for (size_t iC = 0; iC < nChannels; iC++) {
+      channelValues[iC * nPoints() + iP] = interleaved[iP * nChannels + iC];
+    }
+  }
+  return addChannelsQuantityImpl(name, channelNames, std::move(channelValues));
+}
+
 
 template <class T>
 PointCloudParameterizationQuantity* PointCloud::addParameterizationQuantity(std::string name, const T& param,
@@ -0,0 +1,79 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/persistent_value.h"
+#include "polyscope/point_cloud.h"
+#include "polyscope/point_cloud_quantity.h"
+
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// Many scalar channels per point, such as the measurements of a sensor, kept together: the values are stored once on
+// the host, channel after channel, and uploaded once to a single texture. One channel, or a weighted sum of two, is
+// drawn with a colormap. Choosing what to draw only sets uniforms; nothing is uploaded again.
+class PointCloudChannelsQuantity : public PointCloudQuantity {
+public:
+  // channelValues holds the nPoints() values of the first channel, then those of the second, ...
+  PointCloudChannelsQuantity(std::string name, std::vector<std::string> channelNames, std::vector<float> channelValues,
+                             PointCloud& pointCloud_);
+
+  virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual void buildCustomUI() override;
+
+  virtual void buildPickUI(size_t ind) override;
+  virtual void refresh() override;
+  virtual void releaseRenderData() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) override;
+
+  virtual std::string niceName() override;
+
+  // === Channels
+  size_t nChannels() const { return channelNames.size(); }
+  const std::vector<std::string>& getChannelNames() const { return channelNames; }
+  float getChannelValue(size_t iChannel, size_t iPoint) const { return channelValues[iChannel * nPoints + iPoint]; }
+  std::pair<double, double> getChannelRange(size_t iChannel) const; // smallest and largest finite value
+
+  // Draw a single channel
+  PointCloudChannelsQuantity* setDisplayedChannel(size_t iChannel);
+  PointCloudChannelsQuantity* setDisplayedChannel(std::string channelName);
+  // Draw weightA * (channel iChannelA) + weightB * (channel iChannelB), eg a difference with weights 1 and -1
+  PointCloudChannelsQuantity* setDisplayedCombination(size_t iChannelA, double weightA, size_t iChannelB,
+                                                      double weightB);
+  size_t getDisplayedChannel(); // channel A
+  bool getDisplaysCombination();
+  double displayedValue(size_t iPoint); // the value drawn at a point
+
+  // === Visualization parameters
+  // Both of these refer to what is displayed; the range is reset to its extent whenever that changes.
+  PointCloudChannelsQuantity* setColorMap(std::string val);
+  std::string getColorMap();
+  PointCloudChannelsQuantity* setMapRange(std::pair<double, double> val);
+  std::pair<double, double> getMapRange();
+  PointCloudChannelsQuantity* resetMapRange();
+
+private:
+  const std::vector<std::string> channelNames;
+  const size_t nPoints;
+  std::vector<float> channelValues;
+  std::vector<std::pair<float, float>> channelRanges;
+
+  // What is displayed
+  size_t channelA = 0;
+  size_t channelB = 0;
+  float weightA = 1.f;
+  float weightB = 0.f;
+  std::pair<float, float> vizRange;
+  PersistentValue<std::string> cMap;
+
+  // All channels, each on its own rows (see Engine::generateElementTexture()). It does not depend on the level of
+  // detail, so it is kept when the program is rebuilt.
+  std::shared_ptr<render::TextureBuffer> channelTexture;
+  std::shared_ptr<render::ShaderProgram> pointProgram;
+  void createPointProgram();
+  bool checkChannelIndex(size_t iChannel); // raises an error() if out of range
+};
+
+} // namespace polyscope
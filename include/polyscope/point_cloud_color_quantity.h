@@ -15,19 +15,48 @@ public:
   PointCloudColorQuantity(std::string name, const std::vector<glm::vec3>& values, PointCloud& pointCloud_);
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
 
   virtual void buildPickUI(size_t ind) override;
   virtual void refresh() override;
+  virtual void dataUpdated() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) override;
+  virtual bool extendToAppendedPoints() override;
 
   virtual std::string niceName() override;
 
+  // Replace the colors, which must be as many as before. The program is kept and its color buffer rewritten.
+  template <class T>
+  PointCloudColorQuantity* updateData(const T& newColors);
+
+  // The colors of the points appended to the cloud since the last colors were appended, in the order the points were
+  // appended (see PointCloud::appendPoints()). Only those entries are uploaded.
+  template <class T>
+  PointCloudColorQuantity* appendValues(const T& newColors);
+
   // === Members
   std::vector<glm::vec3> values;
 
 protected:
   void createPointProgram();
+  void appendValuesImpl(const std::vector<glm::vec3>& newColors);
   std::shared_ptr<render::ShaderProgram> pointProgram;
 };
 
+template <class T>
+PointCloudColorQuantity* PointCloudColorQuantity::updateData(const T& newColors) {
+  validateSize(newColors, values.size(), "point cloud color quantity " + name);
+  values = standardizeVectorArray<glm::vec3, 3>(newColors);
+  dataUpdated();
+  requestRedraw();
+  return this;
+}
+
+template <class T>
+PointCloudColorQuantity* PointCloudColorQuantity::appendValues(const T& newColors) {
+  appendValuesImpl(standardizeVectorArray<glm::vec3, 3>(newColors));
+  return this;
+}
+
 
 } // namespace polyscope
@@ -0,0 +1,69 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/expression.h"
+#include "polyscope/persistent_value.h"
+#include "polyscope/point_cloud.h"
+#include "polyscope/point_cloud_quantity.h"
+
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+class PointCloudScalarQuantity;
+class PointCloudVectorQuantity;
+
+// A scalar derived from other quantities of the cloud by an Expression, like "|velocity|" or "pressure - p0", which is
+// drawn with a colormap. The expression is compiled in to the shaders and evaluated on the GPU, from the buffers the
+// scalar and vector quantities it names already hold there; no values are computed or stored on the host. Its range is
+// likewise reduced on the GPU (see Engine::reduceMinMax()).
+//
+// While the cloud draws all of its points in order (see PointCloud::drawsAllPointsInOrder()), updating the data of
+// those quantities updates this one too. Otherwise, call refresh() (or resetMapRange() for the range).
+class PointCloudExpressionQuantity : public PointCloudQuantity {
+public:
+  PointCloudExpressionQuantity(std::string name, Expression expression, PointCloud& pointCloud_);
+  ~PointCloudExpressionQuantity(); // unregisters its rules
+
+  virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual void buildCustomUI() override;
+
+  virtual void buildPickUI(size_t ind) override;
+  virtual void refresh() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) override;
+  virtual bool extendToAppendedPoints() override; // (the quantities it uses extend themselves)
+
+  virtual std::string niceName() override;
+
+  const Expression& getExpression() const { return expression; }
+  double getValue(size_t iPoint); // evaluated on the host, from the values of the quantities
+
+  // === Visualization parameters
+  PointCloudExpressionQuantity* setColorMap(std::string val);
+  std::string getColorMap();
+  PointCloudExpressionQuantity* setMapRange(std::pair<double, double> val);
+  std::pair<double, double> getMapRange();
+  PointCloudExpressionQuantity* resetMapRange(); // to the extent of the finite values, computed again
+  std::pair<double, double> getDataRange();      // as of the last reset
+
+private:
+  const Expression expression;
+  const std::string ruleName; // of the generated rule, see registerExpressionRules()
+
+  std::pair<float, float> vizRange;
+  std::pair<double, double> dataRange{0., 0.};
+  PersistentValue<std::string> cMap;
+
+  std::shared_ptr<render::ShaderProgram> pointProgram;
+  void createPointProgram();
+  void registerExpressionRules();
+
+  // The quantities named by the expression, in order, or false (with an error()) if some are missing. Exactly one of
+  // the pointers is set for each field.
+  bool resolveFields(std::vector<PointCloudScalarQuantity*>& scalars, std::vector<PointCloudVectorQuantity*>& vectors);
+  bool setFieldAttributes(render::ShaderProgram& p, bool fullBuffers);
+};
+
+} // namespace polyscope
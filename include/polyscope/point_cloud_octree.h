@@ -0,0 +1,48 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace polyscope {
+
+// A level-of-detail hierarchy over the points of a point cloud, used by PointCloud::setLODEnabled().
+//
+// Each node of the octree holds a random subset of the points in its box which were not already taken by its
+// ancestors, so a node drawn together with all of its ancestors is a uniform sample of its box. Points are referred to
+// by their index in the original array, which must have fewer than 2^32 entries.
+class PointCloudOctree {
+public:
+  PointCloudOctree(const std::vector<glm::vec3>& points);
+
+  // Indices of the points to draw, node by node. Nodes are taken coarsest on screen first, skipping those outside the
+  // view, and refined until their points are at most maxPixelSpacing apart or the next node would exceed pointBudget.
+  std::vector<uint32_t> selectPoints(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight,
+                                     size_t pointBudget, float maxPixelSpacing) const;
+
+  size_t nNodes() const { return nodes.size(); }
+  size_t allocatedBytes() const;
+
+  static const size_t pointsPerNode = 4096;
+  static const int maxDepth = 24; // deeper nodes keep all of their points, so duplicates do not recurse forever
+
+private:
+  struct Node {
+    glm::vec3 bboxMin, bboxMax;
+    uint32_t start, count;           // this node's points are order[start, start + count)
+    std::array<int32_t, 8> children; // -1 for empty octants
+  };
+
+  std::vector<Node> nodes; // nodes[0] is the root
+  std::vector<uint32_t> order;
+
+  // Build the node for order[start, end), which covers the given box, returning its index
+  int32_t buildNode(const std::vector<glm::vec3>& points, glm::vec3 bboxMin, glm::vec3 bboxMax, size_t start,
+                    size_t end, int depth);
+};
+
+} // namespace polyscope
@@ -18,10 +18,12 @@ public:
                                      ParamVizStyle style_, PointCloud& cloud_);
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
 
   virtual void buildPickUI(size_t ind) override;
   virtual void refresh() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) override;
 
   virtual std::string niceName() override;
 
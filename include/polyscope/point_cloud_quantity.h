@@ -4,6 +4,9 @@
 #include "polyscope/quantity.h"
 #include "polyscope/structure.h"
 
+#include <utility>
+#include <vector>
+
 namespace polyscope {
 
 // Forward delcare point cloud
@@ -17,6 +20,21 @@ public:
 
   // Build GUI info about a point
   virtual void buildInfoGUI(size_t pointInd);
+
+  // Called when some of the parent's points have moved. By default the quantity is refreshed.
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges);
+
+  // Called when points were appended to the parent (see PointCloud::appendPoints()), which already holds them. Grows the
+  // values to one per point, with zeros for the new points, or returns false if the quantity can not be appended to
+  // (the default), and the parent then removes it.
+  virtual bool extendToAppendedPoints();
+
+protected:
+  // The quantity has values for the first nValuesAdded points added to the parent. Returns the indices in the parent of
+  // the next `count` points to get values, and counts them as having values. Points which the parent has since
+  // replaced get INVALID_IND. Raises an error() and returns nothing if fewer points are waiting for values.
+  size_t nValuesAdded;
+  std::vector<size_t> appendedValueSlots(size_t count);
 };
 
 
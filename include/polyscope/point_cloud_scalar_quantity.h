@@ -6,6 +6,7 @@
 #include "polyscope/point_cloud.h"
 #include "polyscope/render/color_maps.h"
 #include "polyscope/scalar_quantity.h"
+#include "polyscope/time_frames.h"
 
 #include <vector>
 
@@ -18,20 +19,73 @@ public:
                            DataType dataType);
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
 
   virtual void buildPickUI(size_t ind) override;
   virtual void refresh() override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) override;
+  virtual bool extendToAppendedPoints() override;
 
   virtual std::string niceName() override;
 
+  // Frames of values for playback, drawn at the time of the point cloud (see PointCloud::setTime()). The values of the
+  // quantity are frame 0; each frame widens the data range, resetMapRange() maps the values of all frames.
+  template <class T>
+  PointCloudScalarQuantity* addValueFrame(const T& frameValues);
+
+  // Frames of values streamed from a loader rather than added, nPoints() floats per frame, replacing any added frames
+  // (see PointCloud::setPositionFrameLoader()). The data range is that of the quantity's own values, as the frames are
+  // only read while playing; set the map range to cover them.
+  PointCloudScalarQuantity* setValueFrameLoader(size_t nFrames, TimeFrameLoader loader);
+
+  // The values of the points appended to the cloud since the last values were appended, in the order the points were
+  // appended (see PointCloud::appendPoints()). Only those entries are uploaded; the data range is widened to include
+  // them, and the map range is left as it is.
+  template <class T>
+  PointCloudScalarQuantity* appendValues(const T& newValues);
+
+  // The values of all of the points on the GPU, uploaded once and bound by the programs which draw them, including
+  // those of the point cloud when this quantity sets the point radius. Only valid while the cloud draws all of its
+  // points in order (see PointCloud::drawsAllPointsInOrder()); updating the values rewrites it in place.
+  std::shared_ptr<render::AttributeBuffer> getValueRenderBuffer();
+  double getMaxPositiveValue(); // cached, for the radius autoscale
+
+  // Call after writing the value buffer on the GPU, as for PointCloud::devicePositionsWritten(). The data range is
+  // reduced from the buffer on the GPU, and the map range reset to it a few frames later; the histogram and the radius
+  // autoscale still follow the values last set from the host.
+  void deviceValuesWritten(void* fence = nullptr);
+
 
 protected:
   // === Visualization parameters
 
   void createPointProgram();
   std::shared_ptr<render::ShaderProgram> pointProgram;
+
+  std::shared_ptr<render::AttributeBuffer> valueBuffer; // see getValueRenderBuffer()
+  double maxPositiveValue = -1.;                          // < 0 until computed
+
+  std::unique_ptr<TimeFrameBuffers> valueFrames; // null if the values are not animated
+  void addValueFrameImpl(const std::vector<double>& frameValues);
+  void appendValuesImpl(const std::vector<double>& newValues);
+  void bindValueFrames();
 };
 
+template <class T>
+PointCloudScalarQuantity* PointCloudScalarQuantity::addValueFrame(const T& frameValues) {
+  validateSize(frameValues, values.size(), "point cloud scalar quantity value frame " + name);
+  addValueFrameImpl(standardizeArray<double, T>(frameValues));
+  return this;
+}
+
+template <class T>
+PointCloudScalarQuantity* PointCloudScalarQuantity::appendValues(const T& newValues) {
+  appendValuesImpl(standardizeArray<double, T>(newValues));
+  return this;
+}
+
 
 } // namespace polyscope
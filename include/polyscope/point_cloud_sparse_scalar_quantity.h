@@ -0,0 +1,51 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/point_cloud.h"
+#include "polyscope/point_cloud_quantity.h"
+#include "polyscope/scalar_quantity.h"
+#include "polyscope/sparse_element_set.h"
+
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// A scalar with values on only some of the points of a cloud (see SparseElementSet), drawn with a colormap like a
+// dense scalar; the other points take the cloud's point color. `values` holds one value per point of the set, so the
+// histogram, the ranges and updateData() all refer to those.
+class PointCloudSparseScalarQuantity : public PointCloudQuantity,
+                                       public ScalarQuantity<PointCloudSparseScalarQuantity> {
+public:
+  PointCloudSparseScalarQuantity(std::string name, SparseElementSet elements_, const std::vector<double>& values,
+                                 PointCloud& pointCloud_, DataType dataType);
+
+  virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual void buildCustomUI() override;
+
+  virtual void buildPickUI(size_t ind) override;
+  virtual void refresh() override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) override;
+
+  virtual std::string niceName() override;
+
+  const SparseElementSet& getElements() const { return elements; }
+  bool hasValue(size_t ind) const { return elements.contains(ind); }
+  double getValue(size_t ind) const; // NaN if the point has none
+
+private:
+  const SparseElementSet elements;
+
+  // The presence bitmask and values, read with a_pointInd (see sparseLookup() in the shaders). They do not depend on the
+  // level of detail, so they are kept when the program is rebuilt.
+  std::shared_ptr<render::TextureBuffer> presenceTexture;
+  std::shared_ptr<render::TextureBuffer> valueTexture;
+  std::shared_ptr<render::ShaderProgram> pointProgram;
+  void createPointProgram();
+  void setSparseTextures(render::ShaderProgram& p);
+};
+
+} // namespace polyscope
@@ -0,0 +1,147 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/parallel.h"
+#include "polyscope/persistent_value.h"
+#include "polyscope/point_cloud.h"
+#include "polyscope/scaled_value.h"
+#include "polyscope/structure.h"
+#include "polyscope/types.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace polyscope {
+
+// A point cloud which is read from disk in chunks as they come in to view, for data too large to hold in memory.
+//
+// The positions are a raw file of float32 x,y,z triples, and each attribute file holds one float32 (scalars) or three
+// (colors) per point in the same order. Each run of chunkSize consecutive points is a chunk, so the file should be
+// ordered spatially (e.g. tile by tile) for the chunks to cull well. Registering the stream reads the positions through
+// once, a chunk at a time, to find the bounds of each chunk.
+//
+// Each frame, the visible chunks nearest to the camera are read on background threads, then drawn as ordinary point
+// clouds with ordinary quantities, up to a budget of resident points. Chunks which have left the view are dropped to
+// make room. Chunks which were read but are not drawn are kept up to a second budget. The points can not be picked.
+class PointCloudStream : public Structure {
+public:
+  PointCloudStream(std::string name, std::string positionsFilename, size_t chunkSize);
+  ~PointCloudStream();
+
+  virtual void draw() override;
+  virtual void drawPick() override;
+  virtual void buildCustomUI() override;
+  virtual void buildPickUI(size_t localPickID) override;
+  virtual void updateObjectSpaceBounds() override;
+  virtual std::string typeName() override;
+  virtual void refresh() override;
+  virtual size_t getGPUMemoryUsage() override;
+  virtual MemoryUsage memoryUsage() override;
+  virtual size_t hostMemoryUsage() override;
+
+  // Per-point attributes, drawn as a scalar or color quantity of each chunk. One at a time is shown.
+  PointCloudStream* addScalarFile(std::string name, std::string filename, DataType type = DataType::STANDARD);
+  PointCloudStream* addColorFile(std::string name, std::string filename);
+  PointCloudStream* setDisplayedAttribute(std::string name); // "" to draw with the point color
+  std::string getDisplayedAttribute();
+
+  // Budgets, in points
+  PointCloudStream* setResidentPointBudget(size_t newVal); // chunks which are drawn (default: 20000000)
+  size_t getResidentPointBudget();
+  PointCloudStream* setCachedPointBudget(size_t newVal); // chunks which were read but are not drawn (default: 10000000)
+  size_t getCachedPointBudget();
+
+  // Appearance, shared by every chunk
+  PointCloudStream* setPointColor(glm::vec3 newVal);
+  glm::vec3 getPointColor();
+  PointCloudStream* setPointRadius(double newVal, bool isRelative = true);
+  double getPointRadius();
+  PointCloudStream* setMaterial(std::string name);
+  std::string getMaterial();
+
+  size_t nPoints() { return nPointsCount; }
+  size_t nChunks() { return chunks.size(); }
+  size_t nResidentPoints();
+  bool isReading() { return nReadsInFlight > 0; }
+  void waitForReads(); // block until the reads in flight are done; they are drawn from the next frame
+
+  static const std::string structureTypeName;
+  static const size_t maxUploadsPerFrame = 4; // chunks turned in to point clouds per frame, so frames stay short
+
+private:
+  struct Attribute {
+    std::string name;
+    std::string filename;
+    bool isColor;
+    DataType type;
+    std::pair<double, double> range; // of a scalar over all points, so every chunk is colored alike
+  };
+
+  struct ChunkData {
+    std::vector<glm::vec3> points;
+    std::vector<std::vector<double>> scalars;   // per attribute, empty for colors
+    std::vector<std::vector<glm::vec3>> colors; // per attribute, empty for scalars
+    std::string error;                          // set if reading failed
+  };
+
+  struct Chunk {
+    size_t start, count;
+    glm::vec3 bboxMin, bboxMax;
+    bool reading = false;
+    bool failed = false;               // reading it failed, so it is skipped
+    std::unique_ptr<ChunkData> cached; // read, but not drawn
+    std::unique_ptr<PointCloud> cloud; // drawn
+    size_t lastVisibleFrame = 0;
+    size_t lastWantedFrame = 0; // visible and within the budget; the chunks wanted least recently are dropped first
+  };
+
+  const std::string positionsFilename;
+  const size_t chunkSize;
+  size_t nPointsCount = 0;
+  std::vector<Attribute> attributes;
+  std::vector<Chunk> chunks;
+
+  PersistentValue<glm::vec3> pointColor;
+  PersistentValue<ScaledValue<float>> pointRadius;
+  PersistentValue<std::string> material;
+  PersistentValue<std::string> displayedAttribute;
+  size_t residentPointBudget = 20000000;
+  size_t cachedPointBudget = 10000000;
+
+  size_t streamFrame = 0;           // counts calls to updateStreaming() which did something
+  size_t lastUpdateSceneRender = 0; // state::sceneRenderCount when last updated
+  glm::mat4 chunkTransform{1.};     // the transform last given to the chunks
+  size_t attributeGeneration = 0;   // reads started before an attribute was added are thrown away
+  size_t nReadsInFlight = 0;        // (main thread only)
+
+  // Reads finished on the background threads, waiting for the main thread: (chunk, generation, data)
+  std::mutex finishedMutex;
+  std::vector<std::tuple<size_t, size_t, std::unique_ptr<ChunkData>>> finishedReads;
+
+  void updateStreaming(); // (at most once per frame)
+  void collectFinishedReads();
+  void startRead(size_t iChunk);
+  void makeResident(size_t iChunk);
+  void applyAppearance(PointCloud& cloud);
+  void dropChunkData(); // everything read so far, e.g. when the attributes change
+  static std::unique_ptr<ChunkData> readChunk(std::string positionsFilename, std::vector<Attribute> attributes,
+                                              size_t start, size_t count);
+
+  // Declared last, so it is destroyed first, finishing the reads which write to the members above
+  JobQueue reads;
+};
+
+// Register a streamed point cloud; see PointCloudStream
+PointCloudStream* registerPointCloudStream(std::string name, std::string positionsFilename,
+                                           size_t chunkSize = 1 << 18);
+
+// Shorthand to get a streamed point cloud from polyscope
+inline PointCloudStream* getPointCloudStream(std::string name = "") {
+  return dynamic_cast<PointCloudStream*>(getStructure(PointCloudStream::structureTypeName, name));
+}
+
+} // namespace polyscope
@@ -16,10 +16,15 @@ public:
   std::vector<glm::vec3> vectors;
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
   virtual void buildPickUI(size_t ind) override;
   virtual std::string niceName() override;
   virtual void refresh() override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) override;
+  virtual bool extendToAppendedPoints() override;
 
   // === Members
   // Note: these vectors are not the raw vectors passed in by the user, but have been rescaled such that the longest has
@@ -28,6 +33,16 @@ public:
 
   // Note: all of the actual work is done by the vector artist
 
+  // Replace the vectors, one per point as before. The programs and options are kept; the vector buffers are rewritten
+  // and the vectors scaled by their new longest length.
+  template <class T>
+  PointCloudVectorQuantity* updateData(const T& newVectors);
+
+  // The vectors of the points appended to the cloud since the last vectors were appended, in the order the points were
+  // appended (see PointCloud::appendPoints()). The vectors are drawn again from scratch.
+  template <class T>
+  PointCloudVectorQuantity* appendValues(const T& newVectors);
+
   // === Option accessors
 
   //  The vectors will be scaled such that the longest vector is this long
@@ -46,10 +61,41 @@ public:
   PointCloudVectorQuantity* setMaterial(std::string name);
   std::string getMaterial();
 
+  // Decimation: draw only about one vector per this many pixels across the cloud on the screen
+  PointCloudVectorQuantity* setDecimationEnabled(bool newVal);
+  bool getDecimationEnabled();
+  PointCloudVectorQuantity* setDecimationSpacing(double pixels);
+  double getDecimationSpacing();
+  size_t getNumVectorsDrawn(); // in the last frame
+
+  // The vectors of all of the points on the GPU, for other programs to bind (e.g. PointCloudExpressionQuantity). It is
+  // uploaded when first requested, and rewritten in place when the vectors are updated.
+  std::shared_ptr<render::AttributeBuffer> getVectorRenderBuffer();
+
 private:
+  // When the parent draws an LOD subset, the artist draws these copies of its part of the data
+  std::vector<glm::vec3> lodBases, lodVectors;
+  double fullMaxLength = -1.; // of all the vectors, so that the subset is scaled the same way
+  std::shared_ptr<render::AttributeBuffer> vectorBuffer; // see getVectorRenderBuffer()
 
   // Manages _actually_ drawing the vectors, generating gui.
   std::unique_ptr<VectorArtist> vectorArtist;
+  VectorArtist* createVectorArtist();
+  void appendValuesImpl(const std::vector<glm::vec3>& newVectors);
 };
 
+template <class T>
+PointCloudVectorQuantity* PointCloudVectorQuantity::updateData(const T& newVectors) {
+  validateSize(newVectors, vectors.size(), "point cloud vector quantity " + name);
+  vectors = standardizeVectorArray<glm::vec3, 3>(newVectors);
+  dataUpdated();
+  return this;
+}
+
+template <class T>
+PointCloudVectorQuantity* PointCloudVectorQuantity::appendValues(const T& newVectors) {
+  appendValuesImpl(standardizeVectorArray<glm::vec3, 3>(newVectors));
+  return this;
+}
+
 } // namespace polyscope
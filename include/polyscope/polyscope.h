@@ -1,6 +1,11 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #pragma once
 
+#include "polyscope/batch_update.h"
+#include "polyscope/camera_path.h"
+#include "polyscope/command_queue.h"
+#include "polyscope/frame_stats.h"
+#include "polyscope/group.h"
 #include "polyscope/internal.h"
 #include "polyscope/messages.h"
 #include "polyscope/options.h"
@@ -8,6 +13,7 @@
 #include "polyscope/slice_plane.h"
 #include "polyscope/structure.h"
 #include "polyscope/utilities.h"
+#include "polyscope/viewport.h"
 #include "polyscope/widget.h"
 #include "polyscope/transformation_gizmo.h"
 #include "imgui.h"
@@ -70,6 +76,19 @@ extern bool doDefaultMouseInteraction;
 // a callback function used to render a "user" gui
 extern std::function<void()> userCallback;
 
+// Like userCallback, but run on a thread of its own, for a slow step of the application (e.g. of a solver) which should
+// not freeze the window: frames keep being drawn and the camera keeps moving while it runs. It must not call the rest of
+// the API, nor ImGui; it hands its results to the main thread with queueCommand() or queueUpdate(), which apply them at
+// the start of a frame. It is run again as soon as the previous run finishes, from the next frame on, and show()
+// returns only once the run in progress has finished. Builds with POLYSCOPE_NO_THREADS run it inside the frame.
+extern std::function<void()> backgroundCallback;
+
+// incremented each time renderScene() starts, so that structures can tell passes of the same frame apart from new ones
+extern size_t sceneRenderCount;
+
+// incremented by each requestRedraw(), so that results cached across frames can tell whether anything may have changed
+extern size_t redrawRequestCount;
+
 
 
 
@@ -97,11 +116,23 @@ void removeStructure(Structure* structure, bool errorIfAbsent = true);
 void removeStructure(std::string type, std::string name, bool errorIfAbsent = true);
 void removeStructure(std::string name, bool errorIfAbsent = true);
 
+// Register / de-register many structures at once. The scene extents are recomputed once for all of them, rather than
+// for each, see BatchUpdate. Registration returns false if any structure was rejected.
+bool registerStructures(const std::vector<Structure*>& structures, bool replaceIfPresent = true);
+void removeStructures(const std::vector<Structure*>& structures, bool errorIfAbsent = true);
+
 // De-register all structures, of any type. Also removes any quantities associated with the structure
 void removeAllStructures();
 
-// Recompute the global state::lengthScale, boundingBox, and center by looping over registered structures
+// Recompute the global state::lengthScale, boundingBox, and center by looping over registered structures. Inside of a
+// batch (see BatchUpdate), this happens once when the batch ends.
 void updateStructureExtents();
+// Update them for a structure which was just registered, which only grows the extents and so is cheaper
+void updateStructureExtents(Structure* addedStructure);
+// Mark them stale after a structure moved, to be recomputed once before the next frame is drawn, however many times this
+// is called until then. Structure transforms (including transformation gizmo drags) use this, so moving a structure
+// only changes its model matrix right away.
+void requestStructureExtentsUpdate();
 
 // Essentially regenerates all state and programs within Polyscope, calling refresh() recurisvely on all structures and
 // quantities
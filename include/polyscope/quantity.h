@@ -1,12 +1,27 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #pragma once
 
+#include "polyscope/handle.h"
 #include "polyscope/persistent_value.h"
+#include "polyscope/render/engine.h"
 
+#include <memory>
 #include <string>
 
 namespace polyscope {
 
+// Memory held by a structure or quantity, see Structure::memoryUsage()
+struct MemoryUsage {
+  size_t hostBytes = 0;   // CPU-side arrays: geometry, derived data and quantity values
+  size_t deviceBytes = 0; // buffers and textures allocated by the render engine
+
+  MemoryUsage& operator+=(const MemoryUsage& other) {
+    hostBytes += other.hostBytes;
+    deviceBytes += other.deviceBytes;
+    return *this;
+  }
+};
+
 // A 'quantity' (in Polyscope terminology) is data which is associated with a structure; any structure might have many
 // quantities. For instance a mesh structure might have a scalar quantity associated with it, or a point cloud might
 // have a vector field quantity associated with it.
@@ -25,6 +40,7 @@ public:
                                 // drawCustomUI() below. Can still be overidden in case something else is wanted.
   virtual void buildCustomUI(); // overridden by children to add custom data to UI
   virtual void buildPickUI(size_t localPickInd); // overridden by children to add custom fields to pick menu
+  bool uiTreeOpen = false; // whether buildUI() last showed the quantity's tree node open
 
   // Enable and disable the quantity
   bool isEnabled();
@@ -35,6 +51,28 @@ public:
   // Re-perform any setup work for the quantity, including regenerating shader programs.
   virtual void refresh();
 
+  // Called after the quantity's data is replaced in place (see the updateData() functions). Quantities which can
+  // rewrite the buffers of their existing programs do so; by default this is a refresh(), which rebuilds them.
+  virtual void dataUpdated();
+
+  // Redraw after the quantity's appearance changes (this also goes through the parent, see Structure::requestRedraw())
+  void requestRedraw();
+
+  // = GPU residency
+
+  // Draw, charging any buffers created along the way to this quantity. Structures draw their quantities through this.
+  void drawTracked();
+
+  // Free the quantity's render data, which is rebuilt the next time it is drawn. By default this is a refresh(), which
+  // drops the shader programs of most quantities.
+  virtual void releaseRenderData();
+
+  size_t getGPUMemoryUsage(); // device bytes held by the quantity's render data
+
+  // = Memory accounting
+  MemoryUsage memoryUsage();        // host bytes from hostMemoryUsage(), device bytes from getGPUMemoryUsage()
+  virtual size_t hostMemoryUsage(); // bytes of the data arrays held by the quantity
+
   // A decorated name for the quantity that will be used in headers. For instance, for surface scalar named "value" we
   // return "value (scalar)"
   virtual std::string niceName();
@@ -44,9 +82,15 @@ public:
   S& parent;              // the parent structure with which this quantity is associated
   const std::string name; // a name for this quantity, which must be unique amongst quantities on `parent`
 
+  typedef Quantity<S> HandleBase;   // (see Handle)
+  const internal::HandleID handleID;
+
   // Is this quantity currently being displayed?
   PersistentValue<bool> enabled; // should be set by setEnabled()
   bool dominates = false;
+
+  std::shared_ptr<render::GPUMemoryAccount> gpuMemory;
+  double disabledSince = -1.; // when the residency policy first saw this quantity disabled, see releaseIdleRenderData()
 };
 
 
@@ -2,13 +2,15 @@
 #include "imgui.h"
 
 #include "polyscope/messages.h"
+#include "polyscope/utilities.h"
 
 namespace polyscope {
 
 template <typename S>
 Quantity<S>::Quantity(std::string name_, S& parentStructure_, bool dominates_)
-    : parent(parentStructure_), name(name_), enabled(parent.typeName() + "#" + parent.name + "#" + name, false),
-      dominates(dominates_) {
+    : parent(parentStructure_), name(name_), handleID(internal::acquireHandle(this)),
+      enabled(parent.typeName() + "#" + parent.name + "#" + name, false), dominates(dominates_),
+      gpuMemory(std::make_shared<render::GPUMemoryAccount>()) {
   validateName(name);
 
   // Hack: if the quantity pulls enabled=true from the cache, need to make sure the logic from setEnabled(true) happens,
@@ -20,7 +22,9 @@ Quantity<S>::Quantity(std::string name_, S& parentStructure_, bool dominates_)
 }
 
 template <typename S>
-Quantity<S>::~Quantity(){};
+Quantity<S>::~Quantity() {
+  internal::releaseHandle(handleID);
+};
 
 template <typename S>
 void Quantity<S>::draw() {}
@@ -28,7 +32,8 @@ void Quantity<S>::draw() {}
 template <typename S>
 void Quantity<S>::buildUI() {
 
-  if (ImGui::TreeNode(niceName().c_str())) {
+  uiTreeOpen = ImGui::TreeNode(niceName().c_str());
+  if (uiTreeOpen) {
 
     // Enabled checkbox
     bool enabledLocal = enabled.get();
@@ -38,6 +43,10 @@ void Quantity<S>::buildUI() {
     // Call custom UI
     this->buildCustomUI();
 
+    if (getGPUMemoryUsage() > 0) {
+      ImGui::Text("GPU memory: %s", prettyPrintBytes(getGPUMemoryUsage()).c_str());
+    }
+
     ImGui::TreePop();
   }
 }
@@ -53,14 +62,12 @@ bool Quantity<S>::isEnabled() {
   return enabled.get();
 }
 
-// forward declaration
-void requestRedraw();
-
 template <typename S>
 Quantity<S>* Quantity<S>::setEnabled(bool newEnabled) {
   if (newEnabled == enabled.get()) return this;
 
   enabled = newEnabled;
+  parent.enabledQuantitiesChanged();
 
   // Dominating quantities need to update themselves as their parent's dominating quantity
   if (dominates) {
@@ -73,6 +80,9 @@ Quantity<S>* Quantity<S>::setEnabled(bool newEnabled) {
 
   if (isEnabled()) {
     requestRedraw();
+  } else {
+    // nothing else will be drawn differently, but a cached static layer of the parent is now wrong
+    parent.invalidateStaticLayer();
   }
 
   return this;
@@ -83,6 +93,45 @@ void Quantity<S>::refresh() {
   requestRedraw();
 }
 
+template <typename S>
+void Quantity<S>::dataUpdated() {
+  refresh();
+}
+
+template <typename S>
+void Quantity<S>::requestRedraw() {
+  parent.requestRedraw();
+}
+
+template <typename S>
+void Quantity<S>::drawTracked() {
+  render::ScopedGPUMemoryAccount account(gpuMemory);
+  draw();
+}
+
+template <typename S>
+void Quantity<S>::releaseRenderData() {
+  refresh();
+}
+
+template <typename S>
+size_t Quantity<S>::getGPUMemoryUsage() {
+  return gpuMemory->bytes;
+}
+
+template <typename S>
+MemoryUsage Quantity<S>::memoryUsage() {
+  MemoryUsage usage;
+  usage.hostBytes = hostMemoryUsage();
+  usage.deviceBytes = getGPUMemoryUsage();
+  return usage;
+}
+
+template <typename S>
+size_t Quantity<S>::hostMemoryUsage() {
+  return 0;
+}
+
 
 template <typename S>
 std::string Quantity<S>::niceName() {
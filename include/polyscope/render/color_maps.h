@@ -1,6 +1,7 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "polyscope/color_management.h"
@@ -10,8 +11,15 @@ namespace polyscope {
 // Load a new colormap from a (horizontally oriented) image file
 void loadColorMap(std::string cmapName, std::string filename);
 
+// Replace the values of a colormap, or add a new one if there is none with this name. Everything drawn with the colormap
+// shows the new values from the next frame, without being rebuilt.
+void updateColorMap(std::string cmapName, const std::vector<glm::vec3>& values);
+
 namespace render {
 
+// forward declare
+class TextureBuffer;
+
 // Helper to build a ImGUI dropdown to select color maps. Returns true if changed.
 bool buildColormapSelector(std::string& cm, std::string fieldname = "##colormap_picker");
 
@@ -59,6 +67,8 @@ struct ValueColorMap {
   std::string name;
 
   std::vector<glm::vec3> values;
+  bool loaded = true; // bundled colormaps only fill their values when first used, see Engine::getColorMap()
+  std::shared_ptr<TextureBuffer> texture; // the values, shared by every program using the colormap once one does
 
   // Samples "val" from the colormap, where val is clamped to [0,1].
   // Returns a vector3 of rgb values, each from [0,1]
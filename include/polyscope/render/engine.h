@@ -2,13 +2,21 @@
 #pragma once
 
 #include <array>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <string>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "polyscope/render/color_maps.h"
 #include "polyscope/render/ground_plane.h"
 #include "polyscope/render/materials.h"
+#include "polyscope/scratch_vector.h"
 #include "polyscope/types.h"
 #include "polyscope/view.h"
 
@@ -30,24 +38,77 @@ enum class DrawMode {
   IndexedLines,
   IndexedLineStrip,
   IndexedLinesAdjacency,
-  IndexedLineStripAdjacency
+  IndexedLineStripAdjacency,
+  InstancedQuads, // a 4-vertex triangle strip per element, with per-element attributes
+  InstancedBoxes, // a 14-vertex triangle strip (the faces of a box) per element, with per-element attributes
+  InstancedTriangles // all the triangles once per instance; only attributes named a_instance* advance per instance
 };
 
 enum class FilterMode { Nearest = 0, Linear };
-enum class TextureFormat { RGB8 = 0, RGBA8, RG16F, RGB16F, RGBA16F, RGBA32F, RGB32F, R32F, R16F, DEPTH24 };
+enum class TextureFormat {
+  RGB8 = 0,
+  RGBA8,
+  RG16F,
+  RGB16F,
+  RGBA16F,
+  RGBA32F,
+  RGB32F,
+  R32F,
+  R16F,
+  DEPTH24,
+  R11F_G11F_B10F, // packed float color without alpha, half the size of RGBA16F
+  SRGB8_ALPHA8,   // 8-bit color stored with the sRGB curve; written and sampled as linear values in [0,1]
+  BC6H_RGB16F,    // compressed HDR color, uploaded from float RGB data; RGB16F where the backend cannot compress
+  BC7_RGB8        // compressed 8-bit color, uploaded from byte RGB data; RGB8 where the backend cannot compress
+};
 enum class RenderBufferType { Color, ColorAlpha, Depth, Float4 };
 enum class DepthMode { Less, LEqual, LEqualReadOnly, Greater, Disable };
-enum class BlendMode { Over, AlphaOver, OverNoWrite, Under, Zero, WeightedAdd, Source, Disable };
+enum class BlendMode { Over, AlphaOver, OverNoWrite, Under, Zero, WeightedAdd, Source, Max, Disable };
 
 int dimension(const TextureFormat& x);
 std::string modeName(const TransparencyMode& m);
 
 namespace render {
 
+// Device memory charged to one owner, such as a structure or a quantity
+struct GPUMemoryAccount {
+  size_t bytes = 0;
+};
+
+// Buffers created during its lifetime are charged to the given account, see Engine::activeGPUMemoryAccount
+class ScopedGPUMemoryAccount {
+
+public:
+  ScopedGPUMemoryAccount(std::shared_ptr<GPUMemoryAccount> account);
+  ~ScopedGPUMemoryAccount();
+
+private:
+  std::shared_ptr<GPUMemoryAccount> previous;
+};
+
+// The size of one device allocation made by a backend. It counts towards Engine::gpuMemoryUsage and stays charged to
+// whichever account was active when it was created, however long the buffer lives.
+class GPUAllocation {
+
+public:
+  GPUAllocation();
+  ~GPUAllocation();
+  GPUAllocation(const GPUAllocation&) = delete;
+  GPUAllocation& operator=(const GPUAllocation&) = delete;
+
+  void setSize(size_t nBytes);
+  size_t getSize() const { return bytes; }
+
+private:
+  std::shared_ptr<GPUMemoryAccount> account;
+  size_t bytes = 0;
+};
+
 class TextureBuffer {
 public:
   // abstract class: use the factory methods from the Engine class
-  TextureBuffer(int dim_, TextureFormat format_, unsigned int sizeX_, unsigned int sizeY_ = -1);
+  TextureBuffer(int dim_, TextureFormat format_, unsigned int sizeX_, unsigned int sizeY_ = -1,
+                unsigned int sizeZ_ = -1);
 
   virtual ~TextureBuffer();
 
@@ -55,10 +116,16 @@ public:
   virtual void resize(unsigned int newLen);
   virtual void resize(unsigned int newX, unsigned int newY);
 
+  // Reallocate the underlying buffer with a different format, keeping the size (contents are lost). Framebuffers and
+  // programs using the texture keep using it.
+  virtual void setFormat(TextureFormat newFormat);
+
   unsigned int getSizeX() const { return sizeX; }
   unsigned int getSizeY() const { return sizeY; }
+  unsigned int getSizeZ() const { return sizeZ; }
   int getDimension() const { return dim; }
-  unsigned int getTotalSize() const; // product of dimensions
+  TextureFormat getFormat() const { return format; }
+  size_t getTotalSize() const; // product of dimensions
 
   virtual void setFilterMode(FilterMode newMode);
 
@@ -69,6 +136,13 @@ public:
   virtual std::vector<glm::vec2> getDataVector2() = 0;
   virtual std::vector<glm::vec3> getDataVector3() = 0;
 
+  // Overwrite rows [rowStart, rowStart + nRows) of a 2D texture with float data (sizeX texels per row, in the
+  // texture's format), leaving the other rows; e.g. to update a few elements of an element texture.
+  virtual void setDataRows(unsigned int rowStart, unsigned int nRows, const float* data) = 0;
+
+  // Overwrite texels [start, start + count) of a 1D texture with float data, in the texture's format
+  virtual void setData1D(unsigned int start, unsigned int count, const float* data) = 0;
+
   // Set texture data
   // void fillTextureData1D(std::string name, unsigned char* texData, unsigned int length);
   // void fillTextureData2D(std::string name, unsigned char* texData, unsigned int width, unsigned int height,
@@ -79,13 +153,14 @@ public:
 protected:
   int dim;
   TextureFormat format;
-  unsigned int sizeX, sizeY;
+  unsigned int sizeX, sizeY, sizeZ;
+  GPUAllocation allocation; // kept in sync with the dimensions by the constructor and resize()
 };
 
 class RenderBuffer {
 public:
   // abstract class: use the factory methods from the Engine class
-  RenderBuffer(RenderBufferType type_, unsigned int sizeX_, unsigned int sizeY_);
+  RenderBuffer(RenderBufferType type_, unsigned int sizeX_, unsigned int sizeY_, unsigned int samples_ = 1);
   virtual ~RenderBuffer(){};
 
   virtual void resize(unsigned int newX, unsigned int newY);
@@ -93,12 +168,126 @@ public:
   RenderBufferType getType() const { return type; }
   unsigned int getSizeX() const { return sizeX; }
   unsigned int getSizeY() const { return sizeY; }
+  unsigned int getSamples() const { return samples; } // more than one for multisampled buffers
 
 protected:
   RenderBufferType type;
-  unsigned int sizeX, sizeY;
+  unsigned int sizeX, sizeY, sizeZ;
+  unsigned int samples;
+  GPUAllocation allocation;
+};
+
+
+// A region of a frame which was timed on the GPU, see Engine::pushGPUTimer()
+struct GPUTiming {
+  std::string name;
+  int depth;         // nesting depth of the region, 0 if outermost
+  double startMs;    // on the GPU clock, only meaningful relative to other timings
+  double durationMs;
+};
+
+// Work done on the GPU by the draws of a region of a frame, see Engine::beginPipelineStatistics(). Regions of a frame
+// with the same name (such as a structure drawn in several passes) are summed.
+struct GPUPipelineStatistics {
+  std::string name;
+  uint64_t verticesSubmitted = 0;
+  uint64_t primitivesSubmitted = 0;
+  uint64_t geometryShaderInvocations = 0;
+  uint64_t fragmentShaderInvocations = 0; // relative to the pixels of the scene buffer, this is the overdraw
+};
+
+// Counts of the work submitted to the render backend. Only some backends keep track (currently just the mock backend),
+// for the others these stay zero.
+struct RenderStats {
+  size_t drawCalls = 0;
+  size_t programBinds = 0;
+  size_t textureBinds = 0;
+  size_t stateChanges = 0;            // depth, blend, color mask, and culling modes actually changed
+  size_t redundantChangesSkipped = 0; // program/texture binds and mode changes skipped since they were already current
+  size_t uniformSets = 0;
+  size_t uploadBytes = 0; // attribute, index, and texture data sent to the GPU
+  size_t shaderCompilations = 0;
+  size_t structuresCulled = 0; // draws of a structure skipped by frustum culling, per render pass
+  size_t clustersCulled = 0;   // triangle clusters of large meshes skipped, each time the visible ones are selected
+  size_t sliceCaptures = 0;    // volume mesh slices cut again, since their plane moved or they were made anew
+};
+
+// Mouse input from somewhere other than the window, e.g. a remote viewer of a headless session. Positions are in window
+// pixels, from the top left.
+struct InputEvent {
+  glm::vec2 mousePos{-1., -1.};
+  int button = -1;      // 0 left, 1 right, 2 middle, or -1 if no button changed
+  bool pressed = false; // the new state of the button
+  glm::vec2 wheel{0., 0.};
+  bool shift = false;
+  bool ctrl = false;
+};
+
+// Times the GPU work issued during its lifetime, if options::enableGPUProfiling is set
+class ScopedGPUTimer {
+
+public:
+  ScopedGPUTimer(const std::string& name);
+  ScopedGPUTimer(const char* name, int index); // named "<name> <index>", formatted only when timing
+  ~ScopedGPUTimer();
+
+private:
+  bool active;
+};
+
+// Counts the GPU work of the draws issued during its lifetime, if options::enablePipelineStatistics is set
+class ScopedPipelineStatistics {
+
+public:
+  ScopedPipelineStatistics(const std::string& name);
+  ~ScopedPipelineStatistics();
+
+private:
+  bool active;
 };
 
+// A pixel value being read back from a FrameBuffer without stalling the pipeline, see FrameBuffer::readFloat4Async()
+class PendingFloat4Read {
+
+public:
+  virtual ~PendingFloat4Read(){};
+
+  virtual bool isReady() = 0;                  // true once getValue() can return without waiting on the GPU
+  virtual std::array<float, 4> getValue() = 0; // waits for the read to finish, if it has not already
+};
+
+// The contents of a FrameBuffer being read back without stalling the pipeline, see FrameBuffer::readBufferAsync()
+class PendingBufferRead {
+
+public:
+  virtual ~PendingBufferRead(){};
+
+  virtual bool isReady() = 0;                        // true once getValue() can return without waiting on the GPU
+  virtual std::vector<unsigned char> getValue() = 0; // waits for the read to finish, if it has not already
+};
+
+// Whether any fragments were written by the draws between begin() and end(), read back without stalling the pipeline,
+// see Engine::generateOcclusionQuery()
+class OcclusionQuery {
+
+public:
+  virtual ~OcclusionQuery(){};
+
+  virtual void begin() = 0;
+  virtual void end() = 0;
+  virtual bool isReady() = 0;          // true once anySamplesPassed() can return without waiting on the GPU
+  virtual bool anySamplesPassed() = 0; // waits for the result, if it has not arrived yet
+};
+
+// The number of vertices a ShaderProgram::capture() emitted, arriving once the GPU has run it
+class PendingCapture {
+
+public:
+  virtual ~PendingCapture(){};
+
+  virtual bool isReady() = 0;          // true once getVertexCount() can return without waiting on the GPU
+  virtual size_t getVertexCount() = 0; // waits for the count, if it has not arrived yet
+};
 
 class FrameBuffer {
 
@@ -140,8 +329,14 @@ public:
 
   // Query pixel
   virtual std::array<float, 4> readFloat4(int xPos, int yPos) = 0;
+  virtual std::shared_ptr<PendingFloat4Read> readFloat4Async(int xPos, int yPos) = 0; // like readFloat4(), no stall
+  // The four floats of each pixel in a rectangle, rows from the bottom
+  virtual std::vector<float> readFloat4Region(int xPos, int yPos, int regionSizeX, int regionSizeY) = 0;
   virtual void blitTo(FrameBuffer* other) = 0;
+  virtual void blitColorAndDepthTo(FrameBuffer* other) = 0; // exact copy, buffers must be the same size
   virtual std::vector<unsigned char> readBuffer() = 0;
+  virtual std::vector<float> readDepthBuffer() = 0; // window-space depth of each pixel, rows from the bottom
+  virtual std::shared_ptr<PendingBufferRead> readBufferAsync() = 0; // like readBuffer(), no stall
 
 protected:
   unsigned int sizeX, sizeY;
@@ -214,6 +409,78 @@ enum class ShaderReplacementDefaults {
   None         // no defaults applied
 };
 
+// Handles to a uniform or attribute of a program, resolved once by name so that repeated sets can skip searching by
+// name. A handle is only meaningful for the program which created it. Default-constructed handles are invalid, as are
+// the handles returned when a program has no uniform/attribute with the requested name.
+struct ShaderUniformHandle {
+  ShaderUniformHandle() {}
+  explicit ShaderUniformHandle(int index_) : index(index_) {}
+  bool isValid() const { return index >= 0; }
+  int index = -1;
+};
+struct ShaderAttributeHandle {
+  ShaderAttributeHandle() {}
+  explicit ShaderAttributeHandle(int index_) : index(index_) {}
+  bool isValid() const { return index >= 0; }
+  int index = -1;
+};
+
+// Slice planes are passed to shaders as a fixed-size uniform array, so only this many can exist at once. Adding another
+// is an error (see addSceneSlicePlane()); raising the cap costs every program with SLICE_PLANE_CULL a larger array.
+const int MAX_SLICE_PLANES = 8;
+
+// A GPU array holding the data for a vertex attribute. Each program normally allocates its own, but one buffer can be
+// bound by several programs at once (see ShaderProgram::setAttribute(name, buffer)), so that data they all draw is
+// uploaded and stored only once. Changes to the data are seen by every program using the buffer.
+class AttributeBuffer {
+public:
+  // abstract class: use the factory methods from the Engine class
+  AttributeBuffer(DataType dataType_, int arrayCount_);
+  virtual ~AttributeBuffer();
+
+  // If update is set to "true", data is updated rather than allocated (must be allocated first). offset and size count
+  // entries, and data holds just the entries being updated.
+  // clang-format off
+  virtual void setData(const std::vector<glm::vec2>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setData(const std::vector<glm::vec3>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setData(const std::vector<glm::vec4>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setData(const std::vector<float>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setData(const std::vector<int>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setData(const std::vector<uint32_t>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  // clang-format on
+
+  // Allocate storage for nEntries entries without setting them, e.g. for ShaderProgram::capture() to write
+  virtual void allocate(long int nEntries) = 0;
+
+  // The buffer of the backend (a GL buffer name in the OpenGL backends), to write it from outside polyscope, e.g. after
+  // registering it with cudaGraphicsGLRegisterBuffer(). Writing it from the host may give it new storage (see
+  // isStreaming()), after which it must be registered again.
+  virtual void* getNativeHandle() = 0;
+
+  // A buffer which is updated before each of several scene renders in a row, eg for an animation, is streamed: the
+  // backend gives each full update fresh storage, rather than writing the storage that the draws of the previous frame
+  // may still be reading, which stalls on many drivers. Partial updates are written in place all the same.
+  bool isStreaming() const { return streaming; }
+
+  DataType getType() const { return dataType; }
+  int getArrayCount() const { return arrayCount; }
+  long int getDataSize() const { return dataSize; } // number of entries stored (-1 if nothing)
+  bool isSet() const { return dataSize != -1; }
+
+protected:
+  DataType dataType;
+  int arrayCount;
+  long int dataSize = -1;
+  GPUAllocation allocation; // backends resize it whenever they (re)allocate the data
+
+  // Backends call this on each setData(), to decide whether the buffer is streaming
+  void trackUpdate();
+  size_t entryBytes() const; // storage used by one entry
+  bool streaming = false;
+  size_t updateStreak = 0;          // consecutive scene renders which were preceded by an update
+  size_t lastUpdateSceneRender = 0; // state::sceneRenderCount at the last update
+};
+
 // Encapsulate a shader program
 class ShaderProgram {
 
@@ -238,6 +505,25 @@ public:
   virtual void setUniform(std::string name, std::array<float, 3> val) = 0;
   virtual void setUniform(std::string name, float x, float y, float z, float w) = 0;
 
+  // Uniforms, via handles (see ShaderUniformHandle). Setting an invalid handle throws, like setting a nonexistent name.
+  virtual ShaderUniformHandle getUniformHandle(std::string name) = 0;
+  virtual void setUniform(ShaderUniformHandle h, int val) = 0;
+  virtual void setUniform(ShaderUniformHandle h, unsigned int val) = 0;
+  virtual void setUniform(ShaderUniformHandle h, float val) = 0;
+  virtual void setUniform(ShaderUniformHandle h, double val) = 0; // WARNING casts down to float
+  virtual void setUniform(ShaderUniformHandle h, float* val) = 0;
+  virtual void setUniform(ShaderUniformHandle h, glm::vec2 val) = 0;
+  virtual void setUniform(ShaderUniformHandle h, glm::vec3 val) = 0;
+  virtual void setUniform(ShaderUniformHandle h, glm::vec4 val) = 0;
+  virtual void setUniform(ShaderUniformHandle h, std::array<float, 3> val) = 0;
+  virtual void setUniform(ShaderUniformHandle h, float x, float y, float z, float w) = 0;
+
+  // Data which users of the program keep with it, one T per program, made as T(*this) on the first call. Structures
+  // keep the handles of the uniforms they set every frame this way (see Structure::setStructureUniforms()), so that
+  // each program looks their names up only once.
+  template <typename T>
+  T& userData();
+
   // = Attributes
   // clang-format off
   virtual bool hasAttribute(std::string name) = 0;
@@ -246,16 +532,37 @@ public:
   virtual void setAttribute(std::string name, const std::vector<glm::vec3>& data, bool update = false, int offset = 0, int size = -1) = 0;
   virtual void setAttribute(std::string name, const std::vector<glm::vec4>& data, bool update = false, int offset = 0, int size = -1) = 0;
   virtual void setAttribute(std::string name, const std::vector<double>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setAttribute(std::string name, const std::vector<float>& data, bool update = false, int offset = 0, int size = -1) = 0;
   virtual void setAttribute(std::string name, const std::vector<int>& data, bool update = false, int offset = 0, int size = -1) = 0;
   virtual void setAttribute(std::string name, const std::vector<uint32_t>& data, bool update = false, int offset = 0, int size = -1) = 0;
+
+  // Attributes, via handles (see ShaderAttributeHandle)
+  virtual ShaderAttributeHandle getAttributeHandle(std::string name) = 0;
+  virtual void setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec2>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec3>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec4>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setAttribute(ShaderAttributeHandle h, const std::vector<double>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setAttribute(ShaderAttributeHandle h, const std::vector<float>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setAttribute(ShaderAttributeHandle h, const std::vector<int>& data, bool update = false, int offset = 0, int size = -1) = 0;
+  virtual void setAttribute(ShaderAttributeHandle h, const std::vector<uint32_t>& data, bool update = false, int offset = 0, int size = -1) = 0;
   // clang-format on
 
+  // Use a buffer, which other programs may also be using, to hold an attribute. It must have the attribute's type and
+  // array count. Setting data for the attribute afterwards writes in to this buffer.
+  virtual void setAttribute(std::string name, std::shared_ptr<AttributeBuffer> buffer) = 0;
+
   // Convenience method to set an array-valued attrbute, such as 'in vec3 vertexVal[3]'. Applies interleaving then
   // forwards to the usual setAttribute
   template <typename T, unsigned int C>
   void setAttribute(std::string name, const std::vector<std::array<T, C>>& data, bool update = false, int offset = 0,
                     int size = -1);
 
+  // Convenience method to update just some spans [start, end) of an attribute which was already set with all of `data`,
+  // for instance those returned by DirtyRanges::coalesced(). Each span is a separate buffer update.
+  template <typename T>
+  void updateAttributeRanges(std::string name, const std::vector<T>& data,
+                             const std::vector<std::pair<size_t, size_t>>& ranges);
+
 
   // Textures
   virtual bool hasTexture(std::string name) = 0;
@@ -278,6 +585,33 @@ public:
   // Draw!
   virtual void draw() = 0;
 
+  // Run the vertex and geometry stages over the data without drawing anything, recording the triangles which the
+  // geometry stage emits instead. The stage outputs which the program was registered to record are written to the
+  // matching buffers of `outputs`, in order, one entry per vertex and three per triangle. Triangles which do not fit in
+  // the buffers are dropped, so buffers with no storage only count. The returned count is the number of vertices
+  // emitted, recorded or not; nothing waits for the GPU unless it is read before it is ready.
+  virtual std::shared_ptr<PendingCapture> capture(const std::vector<std::shared_ptr<AttributeBuffer>>& outputs) = 0;
+
+  // Whether the program can draw yet. Programs may be compiled in the background (see
+  // options::parallelShaderCompilation), and until then draw() does nothing and requests another frame.
+  virtual bool isReady() { return true; }
+
+  // Draw only the first n elements of the data (vertices, indices, or instances, as the draw mode counts them), or all
+  // of them if n is negative. A limit past the end of the data draws all of it.
+  void setDrawLimit(long int n) { drawLimit = n; }
+  long int getDrawLimit() const { return drawLimit; }
+
+  // Draw only the ranges [start, end) of the elements, counted as above, in a single multi-draw call. An empty list
+  // draws nothing. Has no effect on the instanced draw modes.
+  void setDrawRanges(const std::vector<std::pair<size_t, size_t>>& ranges) {
+    drawRanges = ranges;
+    useDrawRanges = true;
+  }
+  void clearDrawRanges() { // draw everything again
+    drawRanges.clear();
+    useDrawRanges = false;
+  }
+
   virtual void validateData() = 0;
 
 protected:
@@ -286,15 +620,50 @@ protected:
 
   // How much data is there to draw
   unsigned int drawDataLength;
+  long int drawLimit = -1;
+  bool useDrawRanges = false;
+  std::vector<std::pair<size_t, size_t>> drawRanges;
+  unsigned int limitedDrawLength() const {
+    if (drawLimit < 0 || drawLimit >= static_cast<long int>(drawDataLength)) return drawDataLength;
+    return static_cast<unsigned int>(drawLimit);
+  }
 
   // Does this program use indexed drawing?
   bool useIndex = false;
   long int indexSize = -1;
+  GPUAllocation indexAllocation;
   bool usePrimitiveRestart = false;
+
+  // Does this program draw instances, with all attributes advancing once per instance?
+  bool useInstancing = false;
+
+  // For DrawMode::InstancedTriangles, the number of instances, which is the size of the a_instance* attributes
+  unsigned int instanceCount = 0;
+  unsigned int limitedInstanceCount() const {
+    if (drawLimit < 0 || drawLimit >= static_cast<long int>(instanceCount)) return instanceCount;
+    return static_cast<unsigned int>(drawLimit);
+  }
+  bool attributeIsPerInstance(const std::string& name) const;
   bool primitiveRestartIndexSet = false;
   unsigned int restartIndex = -1;
+
+  // The data of userData(), with a slot for each type T used
+  std::vector<std::shared_ptr<void>> userDataSlots;
+  static size_t nextUserDataSlot();
+  template <typename T>
+  static size_t userDataSlot() {
+    static const size_t slot = nextUserDataSlot();
+    return slot;
+  }
 };
 
+template <typename T>
+T& ShaderProgram::userData() {
+  size_t slot = userDataSlot<T>();
+  if (slot >= userDataSlots.size()) userDataSlots.resize(slot + 1);
+  if (!userDataSlots[slot]) userDataSlots[slot] = std::make_shared<T>(*this);
+  return *static_cast<T*>(userDataSlots[slot].get());
+}
 
 class Engine {
 
@@ -314,9 +683,32 @@ public:
   virtual bool bindSceneBuffer();
   virtual void resizeScreenBuffers(); // applies to all buffers tied to display size
   virtual void setScreenBufferViewports();
+  // Called by the window when its size changes. The display buffers follow the window right away, the scene buffers
+  // only once the size has settled for options::screenBufferResizeDelay seconds, unless immediate.
+  void scheduleScreenBufferResize(bool immediate);
+  void applyScheduledScreenBufferResize(bool force); // call before drawing a frame; force for screenshots
+  bool screenBufferResizePending() const { return screenBufferResizeScheduled; }
   virtual void
   applyLightingTransform(std::shared_ptr<TextureBuffer>& texture); // tonemap and gamma correct, render to active buffer
+  // Put the resolved scene on the display. The result of the lighting transform is cached, so frames where the scene
+  // was not re-rendered (and no lighting setting changed) only copy the cached image.
+  void resolveSceneToDisplay(bool sceneWasRendered);
+  void resolveSceneBuffer(); // copy the scene buffer in to the final scene buffer, resolving multisampling if used
+                             // (and applying options::eyeDomeLighting)
   void updateMinDepthTexture();
+  // The smallest and largest value output by a program drawing one point per value, whose fragments write
+  // (value, -value, 0, 1), e.g. discarding non-finite values. The points are all blended in to one pixel with
+  // BlendMode::Max, so the values never leave the GPU. Returns (0, 0) if nothing was drawn.
+  std::pair<double, double> reduceMinMax(ShaderProgram& program);
+  // For data written directly in to buffers on the GPU (see PointCloud::devicePositionsWritten()): the smallest and
+  // largest value of each component of the vec3 computed per point by a POINT_REDUCE_BOUNDS program (with one of the
+  // REDUCE_* rules), drawn in to two pixels with BlendMode::Max. The pixels are read back without stalling the
+  // pipeline, and onResult(low, high) is called from a later frame (see processPendingReductions()), unless no value
+  // was finite.
+  void reduceBoundsAsync(ShaderProgram& program, std::function<void(glm::vec3, glm::vec3)> onResult);
+  void processPendingReductions(); // called at the start of each frame
+  bool bindWeightedTransparencyBuffer(); // structures accumulate here in TransparencyMode::WeightedBlended
+  void resolveWeightedTransparency();    // composite the accumulated layer over the active buffer
   void renderBackground(); // respects background setting
 
   // Manage render state
@@ -324,6 +716,12 @@ public:
   virtual void setBlendMode(BlendMode newMode = BlendMode::Over) = 0;
   virtual void setColorMask(std::array<bool, 4> mask = {true, true, true, true}) = 0;
   virtual void setBackfaceCull(bool newVal = false) = 0;
+  virtual void setScissor(int startX, int startY, unsigned int sizeX, unsigned int sizeY) = 0; // only draw in region
+  virtual void disableScissor() = 0;
+
+  // Make the GPU wait, before any later command, for a fence signaled once writes made outside polyscope are done (a
+  // GLsync in the OpenGL backends). The CPU does not wait.
+  virtual void waitForExternalFence(void* fence) = 0;
 
   void setCurrentViewport(glm::vec4 viewport);
   glm::vec4 getCurrentViewport();
@@ -352,6 +750,9 @@ public:
   virtual std::tuple<int, int> getWindowPos() = 0;
   virtual bool windowRequestsClose() = 0;
   virtual void pollEvents() = 0;
+  virtual void waitEvents(double timeoutSeconds); // like pollEvents(), but blocks until an event arrives or timeout
+  virtual void setPresentMode(PresentMode newMode); // see options::presentMode
+  virtual void waitForPresentedFrame(); // with PresentMode::LowLatency, block until the GPU finished the last frame
   virtual bool isKeyPressed(char c) = 0; // for lowercase a-z and 0-9 only
   virtual std::string getClipboardText() = 0;
   virtual void setClipboardText(std::string text) = 0;
@@ -363,6 +764,11 @@ public:
   ImFontAtlas* getImGuiGlobalFontAtlas();
   virtual void ImGuiNewFrame() = 0;
   virtual void ImGuiRender() = 0;
+
+  // Queue input to be seen by the next frames as if it came from the window. The headless backends apply it when they
+  // start an ImGui frame; events are spread over frames so that each frame sees at most one button change.
+  void queueInputEvent(const InputEvent& e);
+  bool haveQueuedInput() { return !queuedInput.empty(); }
   virtual void showTextureInImGuiWindow(std::string windowName, TextureBuffer* buffer);
 
 
@@ -379,17 +785,52 @@ public:
   virtual std::shared_ptr<TextureBuffer> generateTextureBuffer(TextureFormat format, unsigned int sizeX_,
                                                                unsigned int sizeY_,
                                                                float* data) = 0; // 2d
+  virtual std::shared_ptr<TextureBuffer> generateTextureBuffer(TextureFormat format, unsigned int sizeX_,
+                                                               unsigned int sizeY_, unsigned int sizeZ_,
+                                                               float* data) = 0; // 3d
+
+  // create a 2d texture holding one value per element (vertex, face, ...), filled row by row; shaders fetch element i
+  // from texel (i % width, i / width)
+  std::shared_ptr<TextureBuffer> generateElementTexture(const std::vector<float>& data);     // R32F
+  std::shared_ptr<TextureBuffer> generateElementTexture(const std::vector<glm::vec3>& data); // RGB32F
+  // as above, for nBlocks equal blocks of elements which each start on a new row, so that element i of block b is at
+  // texel (i % width, b * (height / nBlocks) + i / width)
+  std::shared_ptr<TextureBuffer> generateElementTexture(const std::vector<float>& data, size_t nBlocks); // R32F
 
   // create render buffers
   virtual std::shared_ptr<RenderBuffer> generateRenderBuffer(RenderBufferType type, unsigned int sizeX_,
-                                                             unsigned int sizeY_) = 0;
+                                                             unsigned int sizeY_, unsigned int samples = 1) = 0;
   // create frame buffers
   virtual std::shared_ptr<FrameBuffer> generateFrameBuffer(unsigned int sizeX_, unsigned int sizeY_) = 0;
+  virtual std::shared_ptr<AttributeBuffer> generateAttributeBuffer(DataType dataType, int arrayCount = 1) = 0;
 
   // == create shader programs
   virtual std::shared_ptr<ShaderProgram>
   requestShader(const std::string& programName, const std::vector<std::string>& customRules,
                 ShaderReplacementDefaults defaults = ShaderReplacementDefaults::SceneObject) = 0;
+  // Add a rule which can then be named in requestShader(), e.g. one generated at runtime. Registering a rule again
+  // under the same name replaces it: programs requested afterwards use the new contents, while existing programs keep
+  // the old.
+  virtual void registerShaderRule(const std::string& name, const ShaderReplacementRule& rule) = 0;
+  // Remove a rule added with registerShaderRule(), e.g. by the owner of a generated rule once it is done with it.
+  // Programs already built with it are unaffected.
+  virtual void unregisterShaderRule(const std::string& name) = 0;
+  // Free the cached linked programs which no shader program uses any more (called once per frame, after drawing, so
+  // that programs dropped and requested again within a frame stay cached)
+  virtual void releaseUnusedShaderPrograms() {}
+
+  // == Shader warm-up
+  // Programs queued here are requested ahead of their first use, one per frame while the main loop is idle (see
+  // processShaderWarmup()), so that they are already in the program cache when a structure first asks for them.
+  // Entries naming programs or rules which are not registered are skipped.
+  void queueShaderWarmup(const std::string& programName, const std::vector<std::string>& customRules,
+                         ShaderReplacementDefaults defaults = ShaderReplacementDefaults::SceneObject);
+  bool processShaderWarmup(); // request the next queued program, if any; returns true if there was one
+  size_t shaderWarmupPending() const { return shaderWarmupQueue.size(); }
+  // A profile lists every distinct program requested in a session, see options::shaderWarmupProfile. Loading one queues
+  // its programs for warm-up. Both return false (with a warning) if the file cannot be used.
+  bool saveShaderWarmupProfile(const std::string& filename);
+  bool loadShaderWarmupProfile(const std::string& filename);
 
   // === The frame buffers used in the rendering pipeline
   // The size of these buffers is always kept in sync with the screen size
@@ -397,30 +838,86 @@ public:
   std::shared_ptr<FrameBuffer> sceneBuffer, sceneBufferFinal;
   std::shared_ptr<FrameBuffer> pickFramebuffer;
   std::shared_ptr<FrameBuffer> sceneDepthMinFrame;
+  std::shared_ptr<FrameBuffer> sceneBufferWeighted;
+  std::shared_ptr<FrameBuffer> sceneBufferDeferred; // G-buffer for deferred shading, sharing sceneDepth
+  std::shared_ptr<FrameBuffer> displayCache; // the display as of the last lighting transform
+  std::shared_ptr<FrameBuffer> staticLayerBuffer; // color and depth of the structures with a static hint
+  std::shared_ptr<FrameBuffer> sceneBufferMultisample; // stands in for sceneBuffer while multisampleActive()
+  std::shared_ptr<FrameBuffer> temporalBuffer;         // running average of jittered frames, see temporalSamples
+  std::shared_ptr<FrameBuffer> reductionBuffer;        // a single float pixel, see reduceMinMax()
+  std::shared_ptr<FrameBuffer> boundsReductionBuffer;  // two float pixels, see reduceBoundsAsync()
 
   // Main buffers for rendering
   // sceneDepthMin is an optional texture copy of the depth buffe used for some effects
   std::shared_ptr<TextureBuffer> sceneColor, sceneColorFinal, sceneDepth, sceneDepthMin;
+  // weighted-blended transparency accumulates weighted color and (log) revealage, sharing sceneDepth
+  std::shared_ptr<TextureBuffer> sceneWeightedColor, sceneWeightedRevealage;
+  // deferred shading writes unlit color and (octahedral view normal, material index + 1), see resolveDeferredShading()
+  std::shared_ptr<TextureBuffer> sceneDeferredAlbedo, sceneDeferredGBuffer;
+  std::shared_ptr<TextureBuffer> staticLayerColor, staticLayerDepth;
+  std::shared_ptr<TextureBuffer> temporalColor;
   std::shared_ptr<RenderBuffer> pickColorBuffer, pickDepthBuffer;
 
   // General-use programs used by the engine
   std::shared_ptr<ShaderProgram> renderTexturePlain, renderTextureDot3, renderTextureMap3, renderTextureSphereBG;
-  std::shared_ptr<ShaderProgram> compositePeel, mapLight, copyDepth;
+  std::shared_ptr<ShaderProgram> compositePeel, compositeWeighted, mapLight, copyDepth, temporalAccumulate;
+  std::shared_ptr<ShaderProgram> deferredLighting, eyeDomeLighting;
+  std::shared_ptr<ShaderProgram> occlusionBoxProgram; // see testBoxVisibility()
 
   // Manage transparency and culling
   void setTransparencyMode(TransparencyMode newMode);
   TransparencyMode getTransparencyMode();
   bool transparencyEnabled();
   virtual void applyTransparencySettings() = 0;
-  void addSlicePlane(std::string uniquePostfix);
-  void removeSlicePlane(std::string uniquePostfix);
+  void addSlicePlane();
+  void removeSlicePlane();
   bool slicePlanesEnabled();                     // true if there is at least one slice plane in the scene
   virtual void setFrontFaceCCW(bool newVal) = 0; // true if CCW triangles are considered front-facing; false otherwise
   bool getFrontFaceCCW();
+  bool useInstancedDrawing(size_t nElements); // true if glyphs for this many elements should use *_INSTANCED programs
+
+  // Depth prepass of the ray-cast impostors (options::impostorDepthPrepass). Scene programs get a rule driven by the
+  // stage, which setStructureUniforms() passes on: depth only while the prepass draws, then shading only the fragments
+  // which were not hidden in it. Outside of the main scene pass the stage is None, and programs draw as usual.
+  enum class DepthPrepassStage { None = 0, DepthOnly = 1, Shade = 2 };
+  void setImpostorDepthPrepass(bool newVal);
+  bool impostorDepthPrepassEnabled();
+  DepthPrepassStage depthPrepassStage = DepthPrepassStage::None;
+
+  // Deferred shading (options::deferredShading). Scene programs get a lighting rule which, while deferredShadingPass is
+  // set, writes the unlit color and a G-buffer in to sceneBufferDeferred instead of lighting the fragment.
+  // resolveDeferredShading() then lights each pixel once, with a full-screen pass for each material. Outside of the
+  // main scene pass (reflections etc) programs light their fragments as usual.
+  void setDeferredShading(bool newVal);
+  bool deferredShadingActive(); // enabled, and usable with the current transparency and anti-aliasing settings
+  bool deferredShadingPass = false;
+  bool bindDeferredBuffer();
+  void resolveDeferredShading(); // in to the scene buffer, whose depth already holds that of the structures
+
+  // Format of the scene color buffers (sceneColor, staticLayerColor, sceneColorFinal): RGBA16F, or 8-bit sRGB with
+  // options::compactSceneBuffers when the tone mapping saturates by 1 anyway. updateSceneColorFormat() reallocates them
+  // when that changes, and is called before each scene render.
+  TextureFormat sceneColorFormat();
+  void updateSceneColorFormat();
 
   // == Options
   BackgroundView background = BackgroundView::None;
 
+  // == Anti-aliasing
+  // Besides SSAA (setSSAAFactor()), which renders the scene at a multiple of the display size:
+  //   - MSAA renders opaque scenes to multisampled buffers (setMSAASamples(), options::msaaSamples). Other transparency
+  //     modes and the static layer, which need the scene depth as a texture, render single-sampled.
+  //   - FXAA smooths high-contrast edges when the scene is resolved to the display (options::enableFXAA).
+  //   - Temporal accumulation renders sub-pixel jittered copies of the scene while nothing changes, and displays their
+  //     running average (options::temporalAntiAliasingFrames).
+  void setMSAASamples(int newVal); // one of 1, 2, 4, 8
+  int getMSAASamples();
+  bool multisampleActive(); // whether the scene is drawn to sceneBufferMultisample this frame
+  int temporalSamples = 0;  // frames averaged in temporalBuffer since the scene last changed
+  bool temporalAccumulationPending(); // true if more jittered frames are to be rendered
+  glm::vec2 temporalJitter();         // sub-pixel offset for the next jittered frame, in pixels
+  void accumulateTemporalSample();    // average the final scene buffer in to temporalBuffer
+
   float exposure = 1.0;
   float whiteLevel = 0.75;
   float gamma = 2.2;
@@ -428,6 +925,20 @@ public:
   void setSSAAFactor(int newVal);
   int getSSAAFactor();
 
+  // Dynamic resolution: the scene buffers are ssaaFactor * renderScale times the size of the display, and are resampled
+  // when resolved to it. With options::targetFrameTimeMs set, updateRenderScale() adjusts the scale every frame;
+  // otherwise it stays at 1.
+  void setRenderScale(float newVal);
+  float getRenderScale();
+  float getSceneScale();                                 // scene buffer pixels per display pixel
+  unsigned int sceneBufferSize(unsigned int displaySize); // the scene buffer extent for a display extent
+  void updateRenderScale();
+
+  // Whether frames are drawn with the cheap settings of options::progressiveRendering. Switching back re-renders
+  // nothing by itself, but the cached display is dropped, so the next resolve shows the current scene buffer.
+  void setInteractiveQuality(bool newVal);
+  bool interactiveQuality = false;
+
 
   // == Cached data
 
@@ -442,6 +953,11 @@ public:
   std::vector<std::unique_ptr<ValueColorMap>> colorMaps;
   const ValueColorMap& getColorMap(const std::string& name);
   void loadColorMap(std::string cmapName, std::string filename);
+  void updateColorMap(std::string cmapName, const std::vector<glm::vec3>& values);
+
+  // The colormap's values as a 1D RGB texture, created on first use and shared by all programs which draw with it, so
+  // that updateColorMap() changes them all at once
+  std::shared_ptr<TextureBuffer> getColorMapTexture(const std::string& name);
 
   // Helpers
   std::vector<glm::vec3> screenTrianglesCoords(); // two triangles which cover the screen
@@ -454,36 +970,158 @@ public:
 
   bool useAltDisplayBuffer = false; // if true, push final render results offscreen to the alt buffer instead
 
+  // Statistics for the shader program cache used by requestShader() (if the backend has one)
+  size_t shaderCacheHits = 0;
+  size_t shaderCacheMisses = 0;
+
+  // == GPU profiling
+  // Regions between pushGPUTimer() and popGPUTimer() (usually via ScopedGPUTimer) are timed on the GPU. Results arrive a
+  // few frames late, since the GPU runs behind; getGPUTimings() returns those of the latest frame which has finished.
+  virtual void startGPUTimerFrame() = 0; // called at the start of each frame
+  virtual void pushGPUTimer(const std::string& name) = 0;
+  virtual void popGPUTimer() = 0;
+  std::vector<GPUTiming> getGPUTimings();
+  size_t getGPUTimingFrameCount() const { return gpuTimingFramesRecorded; } // frames whose timings have arrived so far
+  void writeGPUTimingTrace(std::string filename); // Chrome trace (chrome://tracing) JSON of recent frames
+
+  // == Pipeline statistics
+  // Draws between beginPipelineStatistics() and endPipelineStatistics() (usually via ScopedPipelineStatistics) are
+  // counted on the GPU, on backends which support it. Regions do not nest; inside another region, the calls do nothing.
+  // As with the timings, results arrive a few frames late, and getPipelineStatistics() returns those of the latest frame
+  // which has finished.
+  virtual bool supportsPipelineStatistics() { return false; }
+  virtual void startPipelineStatisticsFrame() {} // called at the start of each frame
+  virtual void beginPipelineStatistics(const std::string& name) {}
+  virtual void endPipelineStatistics() {}
+  std::vector<GPUPipelineStatistics> getPipelineStatistics() { return lastPipelineStatistics; }
+
+  // == Occlusion queries
+  int transparencyPassesUsed = 0; // depth peeling passes actually rendered in the last frame
+
+  // With options::transparencyAdaptivePasses, each depth peeling pass is tested for whether it drew anything. The tests
+  // are read once they have arrived rather than waited on, and limit the passes of later frames to one past the last
+  // pass which drew (transparencyPassLimit, -1 for none). The first transparencyPassesTested are still to be read.
+  std::vector<std::shared_ptr<OcclusionQuery>> transparencyPassQueries;
+  int transparencyPassesTested = 0;
+  int transparencyPassLimit = -1;
+
+  // Queries whose results are picked up later, for occlusion culling (options::enableOcclusionCulling).
+  // testBoxVisibility() draws a world-space box against the depth of the bound scene buffer, writing nothing, inside
+  // the query. It returns false without drawing if the box reaches in front of the near plane, where it is always
+  // considered visible.
+  virtual std::shared_ptr<OcclusionQuery> generateOcclusionQuery() = 0;
+  bool testBoxVisibility(glm::vec3 boxMin, glm::vec3 boxMax, OcclusionQuery& query);
+
+  // == Render statistics
+  // renderStats accumulates from startup or the last resetRenderStats(). lastFrameRenderStats is the work done since the
+  // end of the previous frame up to the end of the most recent one, which includes any lazy refreshes in between.
+  RenderStats renderStats;
+  RenderStats lastFrameRenderStats;
+  void resetRenderStats();
+  void finishRenderStatsFrame(); // called at the end of each frame
+
+  // == Static layer
+  // Whether staticLayerBuffer holds the static structures as they currently look. Changes to the view and the set of
+  // static structures are detected when rendering; everything else goes through invalidateStaticLayer().
+  bool staticLayerValid = false;
+  void invalidateStaticLayer() { staticLayerValid = false; }
+
+  // == GPU memory
+  // Bytes currently allocated for attribute and index buffers. Buffers created while an account is active are also
+  // charged to it (see ScopedGPUMemoryAccount), which is how structures and quantities know what they are holding.
+  size_t gpuMemoryUsage = 0;
+  std::shared_ptr<GPUMemoryAccount> activeGPUMemoryAccount;
+
   // Internal windowing and engine details
   ImFontAtlas* globalFontAtlas = nullptr;
   ImFont* regularFont = nullptr;
   ImFont* monoFont = nullptr;
 
 protected:
-  // TODO Manage a cache of compiled shaders?
-
   // Render state
   int ssaaFactor = 1;
-  bool enableFXAA = true;
+  int msaaSamples = 1;
   glm::vec4 currViewport; // TODO remove global viewport size. There is no reason for this, and stops us from doing
                           // screenshot renders while minimized.
   float currPixelScale;
   TransparencyMode transparencyMode = TransparencyMode::None;
+  bool impostorDepthPrepass = false;
+  bool deferredShading = false;
+  PresentMode presentMode = PresentMode::VSync;
   int slicePlaneCount = 0;
+
+  // A resize of the scene buffers waiting for the window size to settle
+  bool screenBufferResizeScheduled = false;
+  std::chrono::steady_clock::time_point screenBufferResizeTime;
+  void resizeDisplayBuffers();
   bool frontFaceCCW = true;
 
+  // Timings of recently finished frames, oldest first
+  std::deque<std::vector<GPUTiming>> gpuTimingHistory;
+  void recordGPUTimingFrame(std::vector<GPUTiming> timings);
+  size_t gpuTimingFramesRecorded = 0;
+
+  // Reductions whose results have not been read back yet, see reduceBoundsAsync()
+  struct PendingReduction {
+    std::shared_ptr<PendingFloat4Read> high, negatedLow;
+    std::function<void(glm::vec3, glm::vec3)> onResult;
+  };
+  std::vector<PendingReduction> pendingReductions;
+
+  // Pipeline statistics of the latest finished frame
+  std::vector<GPUPipelineStatistics> lastPipelineStatistics;
+  void recordPipelineStatisticsFrame(const std::vector<GPUPipelineStatistics>& regions); // sums regions by name
+
+  // Dynamic resolution state
+  float renderScale = 1.;
+  size_t renderScaleTimingFrame = 0; // gpuTimingFramesRecorded when the scale last looked at the timings
+  int renderScaleCooldown = 0;       // timed frames to skip after a change, which were mostly drawn at the old scale
+
+  RenderStats renderStatsAtFrameEnd; // snapshot of renderStats when the last frame finished
+
+  // Input queued by queueInputEvent(), which backends without a window apply with applyQueuedInput() in ImGuiNewFrame()
+  std::deque<InputEvent> queuedInput;
+  void applyQueuedInput();
+
   // Cached lazy seettings for the resolve and relight program
   int currLightingSampleLevel = -1;
   TransparencyMode currLightingTransparencyMode = TransparencyMode::None;
+  bool currLightingFXAA = false;
+
+  // Everything other than the scene itself which affects the contents of displayCache
+  typedef std::tuple<float, float, float, bool, TransparencyMode, glm::vec4, int, int, bool> DisplayCacheKey;
+  DisplayCacheKey currentDisplayCacheKey();
+  bool displayCacheValid = false;
+  DisplayCacheKey displayCacheKey;
+
+  // Shader warm-up, and the programs requested so far for the profile (keyed as in the backends' program caches)
+  struct ShaderWarmupEntry {
+    std::string programName;
+    std::vector<std::string> customRules;
+    ShaderReplacementDefaults defaults;
+  };
+  std::deque<ShaderWarmupEntry> shaderWarmupQueue;
+  std::vector<std::shared_ptr<ShaderProgram>> warmedShaderPrograms; // held so that the program cache keeps them
+  std::vector<ShaderWarmupEntry> requestedShaders;
+  std::unordered_set<std::string> requestedShaderKeys;
+  // Called by backends from requestShader(), at least for each program they have not seen before
+  void recordShaderRequest(const std::string& programName, const std::vector<std::string>& customRules,
+                           ShaderReplacementDefaults defaults);
 
   // Helpers
   void configureImGui();
+  // The fonts are only rasterized before the first frame which draws ImGui, so runs which never show a window (e.g.
+  // scripts taking screenshots) skip it. Called by the ImGuiNewFrame() implementations.
+  void ensureImGuiFonts();
+  bool imguiFontsPrepared = false;
+  // The bundled materials and colormaps are registered by name at startup, and only loaded once they are used
   void loadDefaultMaterials();
-  void loadDefaultMaterial(std::string name);
+  void registerDefaultMaterial(std::string name, bool supportsRGB);
+  void loadDefaultMaterialTextures(Material& material);
   std::shared_ptr<TextureBuffer> loadMaterialTexture(float* data, int width, int height);
-  void loadDefaultColorMap(std::string name);
   void loadDefaultColorMaps();
-  virtual void createSlicePlaneFliterRule(std::string name) = 0;
+  void registerDefaultColorMap(std::string name);
+  void loadDefaultColorMapValues(ValueColorMap& colorMap);
 
   // low-level interface for creating shader programs
   virtual std::shared_ptr<ShaderProgram> generateShaderProgram(const std::vector<ShaderStageSpecification>& stages,
@@ -502,14 +1140,24 @@ inline void ShaderProgram::setAttribute(std::string name, const std::vector<std:
                                         int offset, int size) {
 
   // Unpack and forward
-  std::vector<T> entryData;
-  entryData.reserve(C * data.size());
+  ScratchVector<T> entryData;
+  entryData->reserve(C * data.size());
   for (auto& x : data) {
     for (size_t i = 0; i < C; i++) {
-      entryData.push_back(x[i]);
+      entryData->push_back(x[i]);
     }
   }
-  setAttribute(name, entryData, update, offset, size);
+  setAttribute(name, *entryData, update, offset, size);
+}
+
+template <typename T>
+inline void ShaderProgram::updateAttributeRanges(std::string name, const std::vector<T>& data,
+                                                 const std::vector<std::pair<size_t, size_t>>& ranges) {
+  for (const std::pair<size_t, size_t>& r : ranges) {
+    ScratchVector<T> rangeData;
+    rangeData->assign(data.begin() + r.first, data.begin() + r.second);
+    setAttribute(name, *rangeData, true, static_cast<int>(r.first), static_cast<int>(r.second - r.first));
+  }
 }
 
 // === Public API
@@ -5,6 +5,7 @@
 #include "polyscope/view.h"
 
 #include <memory>
+#include <tuple>
 
 namespace polyscope {
 namespace render {
@@ -31,6 +32,14 @@ public:
   void buildGui();
   void prepare(); // does any and all setup work / allocations / etc. Should be called whenever the mode is changed.
 
+  // Times the shadow of GroundPlaneMode::ShadowOnly was rendered and blurred. It is reused by frames which re-render
+  // the scene without any redraw having been requested in between (e.g. temporal anti-aliasing).
+  size_t shadowRenderCount = 0;
+
+  // Times the mirrored scene of GroundPlaneMode::TileReflection was rendered, which is likewise reused between redraw
+  // requests.
+  size_t reflectionRenderCount = 0;
+
 
   // == Appearance Parameters
 
@@ -57,6 +66,18 @@ private:
   std::array<std::shared_ptr<render::FrameBuffer>, 2> blurFrameBuffers;
   std::shared_ptr<render::ShaderProgram> blurProgram, copyTexProgram;
 
+  // what the blurred shadow was rendered for: state::redrawRequestCount, the view, the part of the buffer it fills (for
+  // screenshot tiles and viewports), the display size and the blur iterations
+  typedef std::tuple<size_t, glm::mat4, glm::vec4, int, int, int> ShadowKey;
+  ShadowKey shadowKey;
+  bool shadowValid = false;
+
+  // what the mirrored scene was rendered for: state::redrawRequestCount, the view, the part of the buffer it fills (for
+  // screenshot tiles and viewports), the display size and the pixel scaling of the reflection buffer
+  typedef std::tuple<size_t, glm::mat4, glm::vec4, int, int, float> ReflectionKey;
+  ReflectionKey reflectionKey;
+  bool reflectionValid = false;
+
   void populateGroundPlaneGeometry();
   bool groundPlanePrepared = false;
   // which direction the ground plane faces
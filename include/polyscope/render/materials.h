@@ -30,6 +30,7 @@ struct Material {
   std::string name;
   bool supportsRGB = false;
   std::array<std::shared_ptr<TextureBuffer>, 4> textureBuffers;
+  bool loaded = true; // bundled materials are only decoded and uploaded when first used, see Engine::getMaterial()
 };
 
 // Build an ImGui option picker in a dropdown ui
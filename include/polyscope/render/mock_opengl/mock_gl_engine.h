@@ -3,6 +3,7 @@
 
 #include "polyscope/options.h"
 #include "polyscope/render/engine.h"
+#include "polyscope/render/shader_builder.h"
 #include "polyscope/utilities.h"
 
 #include <unordered_map>
@@ -23,6 +24,9 @@ public:
   GLTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_, unsigned char* data = nullptr);
   GLTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_, float* data);
 
+  // create a 3D texture from data
+  GLTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_, unsigned int sizeZ_, float* data);
+
   ~GLTextureBuffer() override;
 
 
@@ -36,6 +40,8 @@ public:
   std::vector<float> getDataScalar() override;
   std::vector<glm::vec2> getDataVector2() override;
   std::vector<glm::vec3> getDataVector3() override;
+  void setDataRows(unsigned int rowStart, unsigned int nRows, const float* data) override;
+  void setData1D(unsigned int start, unsigned int count, const float* data) override;
 
   void bind();
 
@@ -44,7 +50,7 @@ protected:
 
 class GLRenderBuffer : public RenderBuffer {
 public:
-  GLRenderBuffer(RenderBufferType type, unsigned int sizeX_, unsigned int sizeY_);
+  GLRenderBuffer(RenderBufferType type, unsigned int sizeX_, unsigned int sizeY_, unsigned int samples_ = 1);
   ~GLRenderBuffer() override;
 
   void resize(unsigned int newX, unsigned int newY) override;
@@ -55,6 +61,49 @@ protected:
 };
 
 
+// The mock backend has nothing to wait on, so reads are ready immediately
+class GLPendingFloat4Read : public PendingFloat4Read {
+
+public:
+  GLPendingFloat4Read(std::array<float, 4> value_) : value(value_) {}
+
+  bool isReady() override { return true; }
+  std::array<float, 4> getValue() override { return value; }
+
+private:
+  std::array<float, 4> value;
+};
+
+class GLPendingBufferRead : public PendingBufferRead {
+
+public:
+  GLPendingBufferRead(std::vector<unsigned char> value_) : value(std::move(value_)) {}
+
+  bool isReady() override { return true; }
+  std::vector<unsigned char> getValue() override { return value; }
+
+private:
+  std::vector<unsigned char> value;
+};
+
+// Every query passes, so nothing is ever culled as occluded
+class GLOcclusionQuery : public OcclusionQuery {
+
+public:
+  void begin() override {}
+  void end() override {}
+  bool isReady() override { return true; }
+  bool anySamplesPassed() override { return true; }
+};
+
+// No shaders run, so captures emit nothing
+class GLPendingCapture : public PendingCapture {
+
+public:
+  bool isReady() override { return true; }
+  size_t getVertexCount() override { return 0; }
+};
+
 class GLFrameBuffer : public FrameBuffer {
 
 public:
@@ -78,8 +127,13 @@ public:
 
   // Query pixels
   std::vector<unsigned char> readBuffer() override;
+  std::vector<float> readDepthBuffer() override;
   std::array<float, 4> readFloat4(int xPos, int yPos) override;
+  std::shared_ptr<PendingFloat4Read> readFloat4Async(int xPos, int yPos) override;
+  std::vector<float> readFloat4Region(int xPos, int yPos, int regionSizeX, int regionSizeY) override;
+  std::shared_ptr<PendingBufferRead> readBufferAsync() override;
   void blitTo(FrameBuffer* other) override;
+  void blitColorAndDepthTo(FrameBuffer* other) override;
 
   // Getters
 
@@ -87,6 +141,28 @@ protected:
   void bind() override;
 };
 
+class GLAttributeBuffer : public AttributeBuffer {
+public:
+  GLAttributeBuffer(DataType dataType_, int arrayCount_);
+  ~GLAttributeBuffer() override;
+
+  // clang-format off
+  void setData(const std::vector<glm::vec2>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<glm::vec3>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<glm::vec4>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<float>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<int>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<uint32_t>& data, bool update = false, int offset = 0, int size = -1) override;
+  // clang-format on
+  void allocate(long int nEntries) override;
+
+  void* getNativeHandle() override;
+
+protected:
+  void checkType(DataType type);
+  void upload(size_t nEntries, size_t entryBytes, bool update, int offset, int size);
+};
+
 
 class GLShaderProgram : public ShaderProgram {
 
@@ -109,6 +185,17 @@ public:
   void setUniform(std::string name, glm::vec4 val) override;
   void setUniform(std::string name, std::array<float, 3> val) override;
   void setUniform(std::string name, float x, float y, float z, float w) override;
+  ShaderUniformHandle getUniformHandle(std::string name) override;
+  void setUniform(ShaderUniformHandle h, int val) override;
+  void setUniform(ShaderUniformHandle h, unsigned int val) override;
+  void setUniform(ShaderUniformHandle h, float val) override;
+  void setUniform(ShaderUniformHandle h, double val) override; // WARNING casts down to float
+  void setUniform(ShaderUniformHandle h, float* val) override;
+  void setUniform(ShaderUniformHandle h, glm::vec2 val) override;
+  void setUniform(ShaderUniformHandle h, glm::vec3 val) override;
+  void setUniform(ShaderUniformHandle h, glm::vec4 val) override;
+  void setUniform(ShaderUniformHandle h, std::array<float, 3> val) override;
+  void setUniform(ShaderUniformHandle h, float x, float y, float z, float w) override;
 
   // = Attributes
   // clang-format off
@@ -118,9 +205,19 @@ public:
   void setAttribute(std::string name, const std::vector<glm::vec3>& data, bool update = false, int offset = 0, int size = -1) override;
   void setAttribute(std::string name, const std::vector<glm::vec4>& data, bool update = false, int offset = 0, int size = -1) override;
   void setAttribute(std::string name, const std::vector<double>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(std::string name, const std::vector<float>& data, bool update = false, int offset = 0, int size = -1) override;
   void setAttribute(std::string name, const std::vector<int>& data, bool update = false, int offset = 0, int size = -1) override; 
   void setAttribute(std::string name, const std::vector<uint32_t>& data, bool update = false, int offset = 0, int size = -1) override;
+  ShaderAttributeHandle getAttributeHandle(std::string name) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec2>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec3>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec4>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<double>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<float>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<int>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<uint32_t>& data, bool update = false, int offset = 0, int size = -1) override;
   // clang-format on
+  void setAttribute(std::string name, std::shared_ptr<AttributeBuffer> buffer) override;
 
   // Convenience method to set an array-valued attrbute, such as 'in vec3 vertexVal[3]'. Applies interleaving then
   // forwards to the usual setAttribute
@@ -145,6 +242,7 @@ public:
 
   // Draw!
   void draw() override;
+  std::shared_ptr<PendingCapture> capture(const std::vector<std::shared_ptr<AttributeBuffer>>& outputs) override;
   void validateData() override;
 
 protected:
@@ -160,9 +258,8 @@ protected:
     std::string name;
     DataType type;
     int arrayCount;
-    long int dataSize; // the size of the data currently stored in this attribute (-1 if nothing)
     int location;
-    int VBOLoc;
+    std::shared_ptr<GLAttributeBuffer> buff; // may be shared with other programs
   };
 
   struct GLShaderTexture {
@@ -179,19 +276,25 @@ protected:
   std::vector<GLShaderUniform> uniforms;
   std::vector<GLShaderAttribute> attributes;
   std::vector<GLShaderTexture> textures;
+  std::vector<unsigned int> indexData; // as set, kept for MockGLEngine::recordIndexedDraws
 
   void addUniqueAttribute(ShaderSpecAttribute attribute);
   void addUniqueUniform(ShaderSpecUniform uniform);
   void addUniqueTexture(ShaderSpecTexture texture);
 
+  // Resolve handles (or names, for the string-based setters) to entries of the lists above, throwing if invalid
+  GLShaderUniform& getUniformForHandle(ShaderUniformHandle h, DataType type);
+  GLShaderAttribute& getAttributeForHandle(ShaderAttributeHandle h);
+  ShaderUniformHandle requireUniformHandle(const std::string& name);
+  ShaderAttributeHandle requireAttributeHandle(const std::string& name);
+  void checkAttributeType(const GLShaderAttribute& a, DataType type);
+
 private:
   // Setup routines
   void compileGLProgram(const std::vector<ShaderStageSpecification>& stages);
   void setDataLocations();
   void createBuffers();
 
-  void deleteAttributeBuffer(GLShaderAttribute& attribute);
-
   // Drawing related
   void activateTextures();
 };
@@ -215,6 +318,9 @@ public:
   void setBlendMode(BlendMode newMode = BlendMode::Over) override;
   void setColorMask(std::array<bool, 4> mask = {true, true, true, true}) override;
   void setBackfaceCull(bool newVal) override;
+  void setScissor(int startX, int startY, unsigned int sizeX, unsigned int sizeY) override;
+  void disableScissor() override;
+  void waitForExternalFence(void* fence) override;
 
   // === Windowing and framework things
   void makeContextCurrent() override;
@@ -246,32 +352,74 @@ public:
                                                        unsigned char* data = nullptr) override; // 2d
   std::shared_ptr<TextureBuffer> generateTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_,
                                                        float* data) override; // 2d
+  std::shared_ptr<TextureBuffer> generateTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_,
+                                                       unsigned int sizeZ_, float* data) override; // 3d
 
   // create render buffers
   std::shared_ptr<RenderBuffer> generateRenderBuffer(RenderBufferType type, unsigned int sizeX_,
-                                                     unsigned int sizeY_) override;
+                                                     unsigned int sizeY_, unsigned int samples = 1) override;
   // create frame buffers
   std::shared_ptr<FrameBuffer> generateFrameBuffer(unsigned int sizeX_, unsigned int sizeY_) override;
+  std::shared_ptr<AttributeBuffer> generateAttributeBuffer(DataType dataType, int arrayCount = 1) override;
 
   // create shader programs
   std::shared_ptr<ShaderProgram>
   requestShader(const std::string& programName, const std::vector<std::string>& customRules,
                 ShaderReplacementDefaults defaults = ShaderReplacementDefaults::SceneObject) override;
+  void registerShaderRule(const std::string& name, const ShaderReplacementRule& rule) override;
+  void unregisterShaderRule(const std::string& name) override;
 
   // Transparency
   virtual void applyTransparencySettings() override;
 
   virtual void setFrontFaceCCW(bool newVal) override;
 
-protected:
-  // Helpers
-  virtual void createSlicePlaneFliterRule(std::string name) override;
+  // GPU profiling
+  void startGPUTimerFrame() override;
+  void pushGPUTimer(const std::string& name) override;
+  void popGPUTimer() override;
+
+  // Pipeline statistics
+  bool supportsPipelineStatistics() override { return true; }
+  void startPipelineStatisticsFrame() override;
+  void beginPipelineStatistics(const std::string& name) override;
+  void endPipelineStatistics() override;
+
+  // Occlusion queries
+  std::shared_ptr<OcclusionQuery> generateOcclusionQuery() override;
+
+  // For tests: while recordIndexedDraws is set, each draw of an indexed triangle program appends its index buffer
+  bool recordIndexedDraws = false;
+  std::vector<std::vector<unsigned int>> indexedDraws;
 
+protected:
   // Shader program & rule caches
-  std::unordered_map<std::string, std::pair<std::vector<ShaderStageSpecification>, DrawMode>> registeredShaderPrograms;
-  std::unordered_map<std::string, ShaderReplacementRule> registeredShaderRules;
+  // The built-in programs and rules are the static definitions of the shader sources (see shaders/*.h), referred to
+  // rather than copied; rules registered at runtime are held in userShaderRules.
+  std::unordered_map<std::string, std::pair<std::vector<const ShaderStageSpecification*>, DrawMode>>
+      registeredShaderPrograms;
+  std::unordered_map<std::string, const ShaderReplacementRule*> registeredShaderRules;
+  std::unordered_map<std::string, ShaderReplacementRule> userShaderRules;
   void populateDefaultShadersAndRules();
 
+  // The registered programs' stage sources, split at their tags once so that each request only concatenates
+  std::unordered_map<std::string, std::vector<ShaderSourceTemplate>> registeredShaderTemplates;
+
+  // GPU timer regions; the mock engine reports zero for all of them
+  std::vector<GPUTiming> currentTimerFrame;
+  int openTimerRegionCount = 0;
+
+  // Pipeline statistics regions; as with the timers, all counts are zero
+  std::vector<GPUPipelineStatistics> currentPipelineStatisticsFrame;
+  int openPipelineStatisticsRegions = 0;
+
+  // The last depth/blend/cull modes and color mask set, -1 before any, counted into renderStats like the GL backend
+  int currDepthMode = -1;
+  int currBlendMode = -1;
+  int currColorMask = -1;
+  int currBackfaceCull = -1;
+  bool stateChangeNeeded(int& current, int newVal);
+
   std::shared_ptr<ShaderProgram> generateShaderProgram(const std::vector<ShaderStageSpecification>& stages,
                                                        DrawMode dm) override;
 };
@@ -3,27 +3,17 @@
 
 #include "polyscope/options.h"
 #include "polyscope/render/engine.h"
+#include "polyscope/render/shader_builder.h"
 #include "polyscope/utilities.h"
 
 #ifdef __APPLE__
-#define GLFW_INCLUDE_GLCOREARB
-#include "GLFW/glfw3.h"
+#include <OpenGL/gl3.h>
 #else
 #include "glad/glad.h"
-// glad must come first
-#include "GLFW/glfw3.h"
-#endif
-
-#ifdef _WIN32
-#undef APIENTRY
-#define GLFW_EXPOSE_NATIVE_WIN32
-#define GLFW_EXPOSE_NATIVE_WGL
-#include <GLFW/glfw3native.h>
 #endif
 
 #include "imgui.h"
 #define IMGUI_IMPL_OPENGL_LOADER_GLAD
-#include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
 
 #include <unordered_map>
@@ -44,6 +34,7 @@ typedef GLuint ShaderHandle;
 typedef GLuint ProgramHandle;
 typedef GLuint AttributeHandle;
 typedef GLuint VertexBufferHandle;
+typedef GLuint QueryHandle;
 
 typedef GLint UniformLocation;
 typedef GLint AttributeLocation;
@@ -59,12 +50,16 @@ public:
   GLTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_, unsigned char* data = nullptr);
   GLTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_, float* data);
 
+  // create a 3D texture from data
+  GLTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_, unsigned int sizeZ_, float* data);
+
   ~GLTextureBuffer() override;
 
 
   // Resize the underlying buffer (contents are lost)
   void resize(unsigned int newLen) override;
   void resize(unsigned int newX, unsigned int newY) override;
+  void setFormat(TextureFormat newFormat) override;
 
   void setFilterMode(FilterMode newMode) override;
   void* getNativeHandle() override;
@@ -72,6 +67,8 @@ public:
   std::vector<float> getDataScalar() override;
   std::vector<glm::vec2> getDataVector2() override;
   std::vector<glm::vec3> getDataVector3() override;
+  void setDataRows(unsigned int rowStart, unsigned int nRows, const float* data) override;
+  void setData1D(unsigned int start, unsigned int count, const float* data) override;
 
   void bind();
   GLenum textureType();
@@ -84,7 +81,7 @@ protected:
 
 class GLRenderBuffer : public RenderBuffer {
 public:
-  GLRenderBuffer(RenderBufferType type, unsigned int sizeX_, unsigned int sizeY_);
+  GLRenderBuffer(RenderBufferType type, unsigned int sizeX_, unsigned int sizeY_, unsigned int samples_ = 1);
   ~GLRenderBuffer() override;
 
   void resize(unsigned int newX, unsigned int newY) override;
@@ -96,6 +93,87 @@ public:
 };
 
 
+// Reads a region of the currently bound framebuffer in to a pixel buffer object, fenced so the data can be fetched
+// once the GPU is done with it
+class GLPixelReadback {
+
+public:
+  GLPixelReadback(int xPos, int yPos, int sizeX, int sizeY, GLenum format, GLenum type, size_t byteSize);
+  GLPixelReadback(const GLPixelReadback&) = delete;
+  GLPixelReadback& operator=(const GLPixelReadback&) = delete;
+  ~GLPixelReadback();
+
+  bool isReady();
+  void fetch(void* dst); // waits if not ready, and releases the GL objects; call at most once
+
+private:
+  void release();
+
+  VertexBufferHandle pixelBuffer = 0;
+  GLsync fence = nullptr;
+  size_t byteSize;
+};
+
+class GLPendingFloat4Read : public PendingFloat4Read {
+
+public:
+  GLPendingFloat4Read(int xPos, int yPos);
+
+  bool isReady() override;
+  std::array<float, 4> getValue() override;
+
+private:
+  GLPixelReadback readback;
+  bool haveValue = false;
+  std::array<float, 4> value;
+};
+
+class GLPendingBufferRead : public PendingBufferRead {
+
+public:
+  GLPendingBufferRead(int sizeX, int sizeY);
+
+  bool isReady() override;
+  std::vector<unsigned char> getValue() override;
+
+private:
+  GLPixelReadback readback;
+  bool haveValue = false;
+  std::vector<unsigned char> value;
+};
+
+class GLOcclusionQuery : public OcclusionQuery {
+
+public:
+  GLOcclusionQuery();
+  ~GLOcclusionQuery() override;
+
+  void begin() override;
+  void end() override;
+  bool isReady() override;
+  bool anySamplesPassed() override;
+
+private:
+  QueryHandle handle;
+  bool pending = false; // ended, and its result not read yet
+  bool result = true;
+};
+
+class GLPendingCapture : public PendingCapture {
+
+public:
+  GLPendingCapture(QueryHandle handle_) : handle(handle_) {}
+  ~GLPendingCapture() override;
+
+  bool isReady() override;
+  size_t getVertexCount() override;
+
+private:
+  QueryHandle handle; // counts the triangles, owned
+  bool haveValue = false;
+  size_t value = 0;
+};
+
 class GLFrameBuffer : public FrameBuffer {
 
 public:
@@ -121,20 +199,84 @@ public:
 
   // Query pixels
   std::vector<unsigned char> readBuffer() override;
+  std::vector<float> readDepthBuffer() override;
   std::array<float, 4> readFloat4(int xPos, int yPos) override;
+  std::shared_ptr<PendingFloat4Read> readFloat4Async(int xPos, int yPos) override;
+  std::vector<float> readFloat4Region(int xPos, int yPos, int regionSizeX, int regionSizeY) override;
+  std::shared_ptr<PendingBufferRead> readBufferAsync() override;
   void blitTo(FrameBuffer* other) override;
+  void blitColorAndDepthTo(FrameBuffer* other) override;
 
   // Getters
   FrameBufferHandle getHandle() const { return handle; }
 
   FrameBufferHandle handle;
+
+protected:
+  // Colors written to sRGB attachments are converted from linear; call after binding for drawing
+  void setSRGBWrites() const;
 };
 
+class GLAttributeBuffer : public AttributeBuffer {
+public:
+  GLAttributeBuffer(DataType dataType_, int arrayCount_);
+  ~GLAttributeBuffer() override;
+
+  // clang-format off
+  void setData(const std::vector<glm::vec2>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<glm::vec3>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<glm::vec4>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<float>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<int>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setData(const std::vector<uint32_t>& data, bool update = false, int offset = 0, int size = -1) override;
+  // clang-format on
+  void allocate(long int nEntries) override;
+
+  void bind();
+  VertexBufferHandle getHandle() const { return handle; }
+  void* getNativeHandle() override;
+
+protected:
+  VertexBufferHandle handle;
+
+  void checkType(DataType type);
+  // offset and size count entries, the same as the setData() arguments
+  void upload(const void* data, size_t nEntries, size_t entryBytes, bool update, int offset, int size);
+};
+
+
+// A compiled and linked GL program. These may be shared between many GLShaderPrograms which were requested with the
+// same program name and rules; each GLShaderProgram keeps its own attribute buffers and uniform values, and loads those
+// values in to the shared program at draw time.
+struct GLCompiledProgram {
+  ~GLCompiledProgram();
+  ProgramHandle handle = 0;
+  const void* lastUser = nullptr; // the GLShaderProgram whose uniform values are currently loaded in the program
+
+  // A program may be linked on the driver's threads (see options::parallelShaderCompilation). Until it is done, this
+  // holds its shaders to check and free, and where to save its binary, if caching. Its attribute locations were chosen
+  // before it linked, so that they are known while it does.
+  bool linkPending = false;
+  std::vector<ShaderHandle> pendingShaders;
+  std::vector<std::string> pendingShaderSources; // (to print with compile errors)
+  std::string binaryFilename;
+  uint64_t sourceHash = 0;
+  std::vector<std::pair<std::string, int>> boundAttributeLocations;
+
+  // The stage outputs recorded by GLShaderProgram::capture(), which must be named before the program links
+  std::vector<std::string> capturedOutputs;
+
+  long cacheReferences = 0; // entries of the engine's program caches holding this program
+};
 
 class GLShaderProgram : public ShaderProgram {
 
 public:
-  GLShaderProgram(const std::vector<ShaderStageSpecification>& stages, DrawMode dm);
+  GLShaderProgram(const std::vector<ShaderStageSpecification>& stages, DrawMode dm, bool linkInBackground = false,
+                  const std::vector<std::string>& capturedOutputs = std::vector<std::string>());
+  GLShaderProgram(const std::vector<ShaderStageSpecification>& stages, DrawMode dm,
+                  std::shared_ptr<GLCompiledProgram> compiledProgram, bool linkInBackground = false,
+                  const std::vector<std::string>& capturedOutputs = std::vector<std::string>());
   ~GLShaderProgram() override;
 
   // === Store data
@@ -152,6 +294,17 @@ public:
   void setUniform(std::string name, glm::vec4 val) override;
   void setUniform(std::string name, std::array<float, 3> val) override;
   void setUniform(std::string name, float x, float y, float z, float w) override;
+  ShaderUniformHandle getUniformHandle(std::string name) override;
+  void setUniform(ShaderUniformHandle h, int val) override;
+  void setUniform(ShaderUniformHandle h, unsigned int val) override;
+  void setUniform(ShaderUniformHandle h, float val) override;
+  void setUniform(ShaderUniformHandle h, double val) override; // WARNING casts down to float
+  void setUniform(ShaderUniformHandle h, float* val) override;
+  void setUniform(ShaderUniformHandle h, glm::vec2 val) override;
+  void setUniform(ShaderUniformHandle h, glm::vec3 val) override;
+  void setUniform(ShaderUniformHandle h, glm::vec4 val) override;
+  void setUniform(ShaderUniformHandle h, std::array<float, 3> val) override;
+  void setUniform(ShaderUniformHandle h, float x, float y, float z, float w) override;
 
   // = Attributes
   // clang-format off
@@ -161,9 +314,19 @@ public:
   void setAttribute(std::string name, const std::vector<glm::vec3>& data, bool update = false, int offset = 0, int size = -1) override;
   void setAttribute(std::string name, const std::vector<glm::vec4>& data, bool update = false, int offset = 0, int size = -1) override;
   void setAttribute(std::string name, const std::vector<double>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(std::string name, const std::vector<float>& data, bool update = false, int offset = 0, int size = -1) override;
   void setAttribute(std::string name, const std::vector<int>& data, bool update = false, int offset = 0, int size = -1) override; 
   void setAttribute(std::string name, const std::vector<uint32_t>& data, bool update = false, int offset = 0, int size = -1) override;
+  ShaderAttributeHandle getAttributeHandle(std::string name) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec2>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec3>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec4>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<double>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<float>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<int>& data, bool update = false, int offset = 0, int size = -1) override;
+  void setAttribute(ShaderAttributeHandle h, const std::vector<uint32_t>& data, bool update = false, int offset = 0, int size = -1) override;
   // clang-format on
+  void setAttribute(std::string name, std::shared_ptr<AttributeBuffer> buffer) override;
 
   // Convenience method to set an array-valued attrbute, such as 'in vec3 vertexVal[3]'. Applies interleaving then
   // forwards to the usual setAttribute
@@ -188,8 +351,12 @@ public:
 
   // Draw!
   void draw() override;
+  std::shared_ptr<PendingCapture> capture(const std::vector<std::shared_ptr<AttributeBuffer>>& outputs) override;
+  bool isReady() override;
   void validateData() override;
 
+  std::shared_ptr<GLCompiledProgram> getCompiledProgram() { return compiledProgram; }
+
 protected:
   // Classes to keep track of attributes and uniforms
   struct GLShaderUniform {
@@ -197,15 +364,18 @@ protected:
     DataType type;
     bool isSet;               // has a value been assigned to this uniform?
     UniformLocation location; // -1 means "no location", usually because it was optimized out
+    bool isDirty;             // has the value changed since it was last loaded in to the GL program?
+    std::array<float, 16> floatValue; // value storage, used according to the type
+    int intValue;
+    unsigned int uintValue;
   };
 
   struct GLShaderAttribute {
     std::string name;
     DataType type;
     int arrayCount;
-    long int dataSize;          // the size of the data currently stored in this attribute (-1 if nothing)
-    AttributeLocation location; // -1 means "no location", usually because it was optimized out
-    VertexBufferHandle VBOLoc;
+    AttributeLocation location;              // -1 means "no location", usually because it was optimized out
+    std::shared_ptr<GLAttributeBuffer> buff; // may be shared with other programs
   };
 
   struct GLShaderTexture {
@@ -227,33 +397,59 @@ protected:
   void addUniqueUniform(ShaderSpecUniform uniform);
   void addUniqueTexture(ShaderSpecTexture texture);
 
+  // Resolve handles (or names, for the string-based setters) to entries of the lists above, throwing if invalid
+  GLShaderUniform& getUniformForHandle(ShaderUniformHandle h, DataType type);
+  GLShaderAttribute& getAttributeForHandle(ShaderAttributeHandle h);
+  ShaderUniformHandle requireUniformHandle(const std::string& name);
+  ShaderAttributeHandle requireAttributeHandle(const std::string& name);
+  void checkAttributeType(const GLShaderAttribute& a, DataType type);
+
 private:
   // Setup routines
-  void compileGLProgram(const std::vector<ShaderStageSpecification>& stages);
+  void compileGLProgram(const std::vector<ShaderStageSpecification>& stages, bool linkInBackground);
   void setDataLocations();
+  void assumeDataLocations();  // while linking in the background
+  void finishBackgroundLink(); // (waits for the link, if it is still going)
+  bool locationsPending = false;
   void createBuffers();
-
-  void deleteAttributeBuffer(GLShaderAttribute& attribute);
+  void bindAttributeBuffer(GLShaderAttribute& a); // point the VAO at a's buffer, using its location and layout
 
   // Drawing related
   void activateTextures();
+  void uploadUniforms();
+
+  // For setDrawRanges(): the primitive drawn, and whether it is indexed; false for the instanced modes
+  bool rangeDrawPrimitive(GLenum& primitive, bool& indexed);
+  void drawSubRanges(GLenum primitive, bool indexed, unsigned int drawLength);
+  void markUniformSet(GLShaderUniform& u);
 
   // GL pointers for various useful things
-  ProgramHandle programHandle = 0;
+  std::shared_ptr<GLCompiledProgram> compiledProgram;
+  ProgramHandle programHandle = 0; // (same as compiledProgram->handle)
   AttributeHandle vaoHandle;
   AttributeHandle indexVBO;
 };
 
 
+// The openGL3 engine, shared by all of the openGL backends. It does not own a window or a context; subclasses provide
+// those, along with the windowing and event methods (GLEngineGLFW for a window, GLEngineEGL for headless rendering).
 class GLEngine : public Engine {
 public:
   GLEngine();
 
+  // Looks up an openGL function by name in the current context (glfwGetProcAddress, eglGetProcAddress, ...)
+  typedef void* (*ProcAddressFunc)(const char* name);
+
   // High-level control
-  void initialize();
+  virtual void initialize() = 0; // create the context and the display buffer, then load shaders
   void checkError(bool fatal = false) override;
 
-  void swapDisplayBuffers() override;
+  // Ask for a GL 4.5 context, and edit buffers and textures with direct state access rather than binding them first
+  // (the openGL4_* backends). Contexts without 4.5 fall back to 3.3 and binding. Set before initialize().
+  bool requestDirectStateAccess = false;
+  bool usesDirectStateAccess() const;
+
+  void waitForPresentedFrame() override;
   std::vector<unsigned char> readDisplayBuffer() override;
   // void blitFinalSceneToScreen() override;
 
@@ -262,24 +458,16 @@ public:
   void setBlendMode(BlendMode newMode = BlendMode::Over) override;
   void setColorMask(std::array<bool, 4> mask = {true, true, true, true}) override;
   void setBackfaceCull(bool newVal) override;
+  void setScissor(int startX, int startY, unsigned int sizeX, unsigned int sizeY) override;
+  void disableScissor() override;
+  void waitForExternalFence(void* fence) override;
 
   // === Windowing and framework things
-  void makeContextCurrent() override;
-  void focusWindow() override;
-  void showWindow() override;
-  void hideWindow() override;
-  void updateWindowSize(bool force = false) override;
-  std::tuple<int, int> getWindowPos() override;
-  bool windowRequestsClose() override;
-  void pollEvents() override;
-  bool isKeyPressed(char c) override; // for lowercase a-z and 0-9 only
+  void makeContextCurrent() override; // subclasses make their context current, then call this
   std::string getClipboardText() override;
   void setClipboardText(std::string text) override;
 
   // ImGui
-  void initializeImGui() override;
-  void shutdownImGui() override;
-  void ImGuiNewFrame() override;
   void ImGuiRender() override;
 
   // === Factory methods
@@ -293,12 +481,15 @@ public:
                                                        unsigned char* data = nullptr) override; // 2d
   std::shared_ptr<TextureBuffer> generateTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_,
                                                        float* data) override; // 2d
+  std::shared_ptr<TextureBuffer> generateTextureBuffer(TextureFormat format, unsigned int sizeX_, unsigned int sizeY_,
+                                                       unsigned int sizeZ_, float* data) override; // 3d
 
   // create render buffers
   std::shared_ptr<RenderBuffer> generateRenderBuffer(RenderBufferType type, unsigned int sizeX_,
-                                                     unsigned int sizeY_) override;
+                                                     unsigned int sizeY_, unsigned int samples = 1) override;
   // create frame buffers
   std::shared_ptr<FrameBuffer> generateFrameBuffer(unsigned int sizeX_, unsigned int sizeY_) override;
+  std::shared_ptr<AttributeBuffer> generateAttributeBuffer(DataType dataType, int arrayCount = 1) override;
 
   // general flexible interface
   std::shared_ptr<ShaderProgram>
@@ -307,28 +498,95 @@ public:
 
   // === Implementation details
 
-  // Add a shader programs/rules so that they can be requested above
+  void registerShaderRule(const std::string& name, const ShaderReplacementRule& rule) override;
+  void unregisterShaderRule(const std::string& name) override;
+  void releaseUnusedShaderPrograms() override;
+
+  // Add a shader program so that it can be requested above
   void registerShaderProgram(const std::string& name, const std::vector<ShaderStageSpecification>& stages);
-  void registerShaderRule(const std::string& name, const ShaderReplacementRule& rule);
 
   // Transparency
   virtual void applyTransparencySettings() override;
 
   virtual void setFrontFaceCCW(bool newVal) override;
 
+  // GPU profiling
+  void startGPUTimerFrame() override;
+  void pushGPUTimer(const std::string& name) override;
+  void popGPUTimer() override;
+
+  // Pipeline statistics
+  bool supportsPipelineStatistics() override;
+  void startPipelineStatisticsFrame() override;
+  void beginPipelineStatistics(const std::string& name) override;
+  void endPipelineStatistics() override;
+
+  // Occlusion queries
+  std::shared_ptr<OcclusionQuery> generateOcclusionQuery() override;
+
 protected:
-  // Helpers
-  virtual void createSlicePlaneFliterRule(std::string name) override;
+  // Load openGL functions and optional extensions, once a context is current
+  void loadGLFunctions(ProcAddressFunc getProcAddress);
 
-  // Internal windowing and engine details
-  GLFWwindow* mainWindow = nullptr;
+  // With PresentMode::LowLatency, a fence after the commands of the last presented frame
+  GLsync presentFence = nullptr;
+  void fencePresentedFrame(); // call after presenting
 
   // Shader program & rule caches
-  // TODO oneday make these caches of precompiled programs which are shared, rather than caches of the sources
-  std::unordered_map<std::string, std::pair<std::vector<ShaderStageSpecification>, DrawMode>> registeredShaderPrograms;
-  std::unordered_map<std::string, ShaderReplacementRule> registeredShaderRules;
+  // The built-in programs and rules are the static definitions of the shader sources (see shaders/*.h), referred to
+  // rather than copied; rules registered at runtime are held in userShaderRules.
+  std::unordered_map<std::string, std::pair<std::vector<const ShaderStageSpecification*>, DrawMode>>
+      registeredShaderPrograms;
+  std::unordered_map<std::string, const ShaderReplacementRule*> registeredShaderRules;
+  std::unordered_map<std::string, ShaderReplacementRule> userShaderRules;
   void populateDefaultShadersAndRules();
 
+  // The outputs recorded by ShaderProgram::capture() for the registered programs which are run that way, by name
+  std::unordered_map<std::string, std::vector<std::string>> registeredCapturedOutputs;
+
+  // The registered programs' stage sources, split at their tags once so that each request only concatenates
+  std::unordered_map<std::string, std::vector<ShaderSourceTemplate>> registeredShaderTemplates;
+
+  // Linked programs from previous requestShader() calls, keyed by the program name and the ordered list of rules.
+  // Entries are dropped when a rule they use is registered again, or once no shader program uses them (see
+  // releaseUnusedShaderPrograms()).
+  struct CompiledProgramCacheEntry {
+    std::vector<ShaderStageSpecification> stages; // after applying replacement rules
+    std::shared_ptr<GLCompiledProgram> compiledProgram;
+  };
+  std::unordered_map<std::string, CompiledProgramCacheEntry> compiledProgramCache;
+
+  // The same linked programs, keyed by a hash of their expanded sources, since different programs and rule lists can
+  // expand to identical sources (e.g. programs differing only in draw mode, or rules which touch none of the tags)
+  std::unordered_map<uint64_t, CompiledProgramCacheEntry> compiledProgramsBySource;
+  void insertCompiledProgram(const std::string& cacheKey, const CompiledProgramCacheEntry& entry, uint64_t sourceHash,
+                             bool bySource);
+  void dropCachedProgramsUsingRule(const std::string& ruleName);
+
+  // GPU timer regions, each timed by a pair of GL_TIMESTAMP queries
+  struct GLTimerRegion {
+    std::string name;
+    int depth;
+    QueryHandle startQuery, endQuery;
+  };
+  std::vector<GLTimerRegion> currentTimerFrame;
+  std::deque<std::vector<GLTimerRegion>> pendingTimerFrames; // issued, but not yet known to be finished on the GPU
+  std::vector<size_t> openTimerRegions;                      // indices in to currentTimerFrame
+  std::vector<QueryHandle> freeTimerQueries;
+  QueryHandle acquireTimerQuery();
+
+  // Pipeline statistics regions, each counted by one query per statistic (vertices, primitives, geometry and fragment
+  // shader invocations). A query object is tied to the target it was first used with, so each has its own free list.
+  struct GLPipelineStatisticsRegion {
+    std::string name;
+    std::array<QueryHandle, 4> queries;
+  };
+  std::vector<GLPipelineStatisticsRegion> currentPipelineStatisticsFrame;
+  std::deque<std::vector<GLPipelineStatisticsRegion>> pendingPipelineStatisticsFrames;
+  int openPipelineStatisticsRegions = 0; // only the outermost is counted
+  std::array<std::vector<QueryHandle>, 4> freePipelineStatisticsQueries;
+
+
   std::shared_ptr<ShaderProgram> generateShaderProgram(const std::vector<ShaderStageSpecification>& stages,
                                                        DrawMode dm) override;
 };
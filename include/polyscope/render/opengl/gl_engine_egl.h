@@ -0,0 +1,55 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/render/opengl/gl_engine.h"
+
+#include <EGL/egl.h>
+
+// Note: DO NOT include this header throughout polyscope, and do not directly make openGL calls. This header should only
+// be used to construct an instance of Engine. engine.h gives the render API, all render calls should pass through that.
+
+
+namespace polyscope {
+namespace render {
+namespace backend_openGL3_egl {
+
+// A headless variant of the openGL3 engine, which gets its context from EGL rather than from a GLFW window. There is no
+// window or display server; the "screen" is an offscreen framebuffer, so screenshots and renderToBuffer() work as usual
+// but nothing is ever shown. All of the rendering code is shared with the GLFW engine.
+class GLEngineEGL : public backend_openGL3_glfw::GLEngine {
+public:
+  GLEngineEGL();
+
+  // High-level control
+  void initialize() override;
+  void swapDisplayBuffers() override;
+
+  // === Windowing and framework things
+  // (there is no window, so most of these do nothing)
+  void makeContextCurrent() override;
+  void focusWindow() override;
+  void showWindow() override;
+  void hideWindow() override;
+  void updateWindowSize(bool force = false) override; // the "window" is sized by view::windowWidth/windowHeight
+  std::tuple<int, int> getWindowPos() override;
+  bool windowRequestsClose() override;
+  void pollEvents() override;
+  void waitEvents(double timeoutSeconds) override; // nothing can arrive without a window, so this does not block
+  bool isKeyPressed(char c) override;
+
+  // ImGui
+  void initializeImGui() override;
+  void shutdownImGui() override;
+  void ImGuiNewFrame() override;
+
+protected:
+  EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+  EGLContext eglContext = EGL_NO_CONTEXT;
+
+  // Pick a display: a GPU device if possible (options::eglDeviceIndex), otherwise Mesa's software surfaceless platform
+  EGLDisplay getHeadlessDisplay();
+};
+
+} // namespace backend_openGL3_egl
+} // namespace render
+} // namespace polyscope
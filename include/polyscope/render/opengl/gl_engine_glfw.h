@@ -0,0 +1,60 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/render/opengl/gl_engine.h"
+
+// glad (via gl_engine.h) must come first
+#include "GLFW/glfw3.h"
+
+#ifdef _WIN32
+#undef APIENTRY
+#define GLFW_EXPOSE_NATIVE_WIN32
+#define GLFW_EXPOSE_NATIVE_WGL
+#include <GLFW/glfw3native.h>
+#endif
+
+#include "backends/imgui_impl_glfw.h"
+
+// Note: DO NOT include this header throughout polyscope, and do not directly make openGL calls. This header should only
+// be used to construct an instance of Engine. engine.h gives the render API, all render calls should pass through that.
+
+
+namespace polyscope {
+namespace render {
+namespace backend_openGL3_glfw {
+
+// The openGL3 engine in a GLFW window. This is the only part of polyscope which depends on GLFW; it is built in to the
+// `polyscope` library, but not in to `polyscope_core`.
+class GLEngineGLFW : public GLEngine {
+public:
+  GLEngineGLFW();
+
+  // High-level control
+  void initialize() override;
+  void swapDisplayBuffers() override;
+  void setPresentMode(PresentMode newMode) override;
+
+  // === Windowing and framework things
+  void makeContextCurrent() override;
+  void focusWindow() override;
+  void showWindow() override;
+  void hideWindow() override;
+  void updateWindowSize(bool force = false) override;
+  std::tuple<int, int> getWindowPos() override;
+  bool windowRequestsClose() override;
+  void pollEvents() override;
+  void waitEvents(double timeoutSeconds) override;
+  bool isKeyPressed(char c) override; // for lowercase a-z and 0-9 only
+
+  // ImGui
+  void initializeImGui() override;
+  void shutdownImGui() override;
+  void ImGuiNewFrame() override;
+
+protected:
+  GLFWwindow* mainWindow = nullptr;
+};
+
+} // namespace backend_openGL3_glfw
+} // namespace render
+} // namespace polyscope
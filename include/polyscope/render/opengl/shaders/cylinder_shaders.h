@@ -11,12 +11,20 @@ extern const ShaderStageSpecification FLEX_CYLINDER_VERT_SHADER;
 extern const ShaderStageSpecification FLEX_CYLINDER_GEOM_SHADER;
 extern const ShaderStageSpecification FLEX_CYLINDER_FRAG_SHADER;
 
+// Indexed polyline strips
+extern const ShaderStageSpecification FLEX_CYLINDER_STRIP_VERT_SHADER;
+extern const ShaderStageSpecification FLEX_CAPSULE_GEOM_SHADER;
+extern const ShaderStageSpecification FLEX_CAPSULE_FRAG_SHADER;
+extern const ShaderStageSpecification FLEX_LINE_STRIP_GEOM_SHADER;
+extern const ShaderStageSpecification FLEX_LINE_STRIP_FRAG_SHADER;
+
 // Rules specific to cylinders
 extern const ShaderReplacementRule CYLINDER_PROPAGATE_VALUE;
 extern const ShaderReplacementRule CYLINDER_PROPAGATE_BLEND_VALUE;
 extern const ShaderReplacementRule CYLINDER_PROPAGATE_COLOR;
 extern const ShaderReplacementRule CYLINDER_PROPAGATE_BLEND_COLOR;
 extern const ShaderReplacementRule CYLINDER_PROPAGATE_PICK;
+extern const ShaderReplacementRule CYLINDER_PROPAGATE_PICK_ID;
 extern const ShaderReplacementRule CYLINDER_CULLPOS_FROM_MID;
 
 
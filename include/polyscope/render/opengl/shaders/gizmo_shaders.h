@@ -11,6 +11,8 @@ extern const ShaderStageSpecification TRANSFORMATION_GIZMO_ROT_VERT;
 extern const ShaderStageSpecification TRANSFORMATION_GIZMO_ROT_FRAG;
 extern const ShaderStageSpecification SLICE_PLANE_VERT_SHADER;
 extern const ShaderStageSpecification SLICE_PLANE_FRAG_SHADER;
+extern const ShaderStageSpecification OCCLUSION_BOX_VERT_SHADER;
+extern const ShaderStageSpecification OCCLUSION_BOX_FRAG_SHADER;
 
 // Rules 
 extern const ShaderReplacementRule TRANSFORMATION_GIZMO_VEC;
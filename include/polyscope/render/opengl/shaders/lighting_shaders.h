@@ -14,12 +14,17 @@ extern const ShaderReplacementRule DOWNSAMPLE_RESOLVE_1;
 extern const ShaderReplacementRule DOWNSAMPLE_RESOLVE_2;
 extern const ShaderReplacementRule DOWNSAMPLE_RESOLVE_3;
 extern const ShaderReplacementRule DOWNSAMPLE_RESOLVE_4;
+extern const ShaderReplacementRule DOWNSAMPLE_RESOLVE_SCALED;
+extern const ShaderReplacementRule DOWNSAMPLE_RESOLVE_FXAA;
 
 extern const ShaderReplacementRule TRANSPARENCY_RESOLVE_SIMPLE;
 extern const ShaderReplacementRule TRANSPARENCY_STRUCTURE;
+extern const ShaderReplacementRule TRANSPARENCY_WEIGHTED_STRUCTURE;
 extern const ShaderReplacementRule TRANSPARENCY_PEEL_STRUCTURE;
 extern const ShaderReplacementRule TRANSPARENCY_PEEL_GROUND;
 
+extern const ShaderReplacementRule IMPOSTOR_DEPTH_PREPASS;
+
 } // namespace backend_openGL3_glfw
 } // namespace render
 } // namespace polyscope
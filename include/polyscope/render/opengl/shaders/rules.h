@@ -12,6 +12,7 @@ extern const ShaderReplacementRule GLSL_VERSION;
 extern const ShaderReplacementRule GLOBAL_FRAGMENT_FILTER;
 extern const ShaderReplacementRule LIGHT_MATCAP;
 extern const ShaderReplacementRule LIGHT_PASSTHRU;
+extern const ShaderReplacementRule LIGHT_DEFERRED;
 
 
 // Shading color generation policies (colormapping, etc)
@@ -25,12 +26,13 @@ extern const ShaderReplacementRule SHADE_CHECKER_VALUE2;        // generate a tw
 extern const ShaderReplacementRule SHADEVALUE_MAG_VALUE2;       // generate a shadeValue from the magnitude of shadeValue2
 extern const ShaderReplacementRule ISOLINE_STRIPE_VALUECOLOR;   // modulate albedoColor based on shadeValue
 extern const ShaderReplacementRule CHECKER_VALUE2COLOR;         // modulate albedoColor based on shadeValue2
+extern const ShaderReplacementRule SHADE_SPARSE_ABSENT_COLOR;   // u_absentColor where shadePresence is below 1/2
 
 // Positions, culling, etc
 extern const ShaderReplacementRule GENERATE_VIEW_POS;          // computes viewPos, position in viewspace for fragment
 extern const ShaderReplacementRule CULL_POS_FROM_VIEW;
 
-ShaderReplacementRule generateSlicePlaneRule(std::string uniquePostfix);
+ShaderReplacementRule generateSlicePlaneRule();
 
 // clang-format on
 
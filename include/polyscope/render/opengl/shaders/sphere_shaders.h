@@ -15,13 +15,44 @@ extern const ShaderStageSpecification FLEX_POINTQUAD_VERT_SHADER;
 extern const ShaderStageSpecification FLEX_POINTQUAD_GEOM_SHADER;
 extern const ShaderStageSpecification FLEX_POINTQUAD_FRAG_SHADER;
 
+// Instanced variants, with no geometry stage
+extern const ShaderStageSpecification FLEX_SPHERE_INSTANCED_VERT_SHADER;
+extern const ShaderStageSpecification FLEX_POINTQUAD_INSTANCED_VERT_SHADER;
+extern const ShaderStageSpecification FLEX_POINTSPLAT_VERT_SHADER;
+extern const ShaderStageSpecification POINT_REDUCE_VERT_SHADER;
+extern const ShaderStageSpecification REDUCE_MINMAX_FRAG_SHADER;
+extern const ShaderStageSpecification POINT_REDUCE_BOUNDS_VERT_SHADER;
+extern const ShaderStageSpecification REDUCE_BOUNDS_FRAG_SHADER;
+
+// Values for POINT_REDUCE_BOUNDS
+extern const ShaderReplacementRule REDUCE_POSITION;
+extern const ShaderReplacementRule REDUCE_POSITION_DISTANCE;
+extern const ShaderReplacementRule REDUCE_SCALAR_VALUE;
+
 // Rules specific to spheres
 extern const ShaderReplacementRule SPHERE_PROPAGATE_VALUE;
 extern const ShaderReplacementRule SPHERE_PROPAGATE_VALUE2;
 extern const ShaderReplacementRule SPHERE_PROPAGATE_COLOR;
+extern const ShaderReplacementRule SPHERE_PROPAGATE_PICK_ID;
+extern const ShaderReplacementRule SPHERE_PICK_ID_FROM_INDEX;
 extern const ShaderReplacementRule SPHERE_VARIABLE_SIZE;
 extern const ShaderReplacementRule SPHERE_CULLPOS_FROM_CENTER;
 extern const ShaderReplacementRule SPHERE_CULLPOS_FROM_CENTER_QUAD;
+extern const ShaderReplacementRule SPHERE_PROPAGATE_VALUE_INSTANCED;
+extern const ShaderReplacementRule SPHERE_PROPAGATE_VALUE2_INSTANCED;
+extern const ShaderReplacementRule SPHERE_PROPAGATE_COLOR_INSTANCED;
+extern const ShaderReplacementRule SPHERE_PROPAGATE_PICK_ID_INSTANCED;
+extern const ShaderReplacementRule SPHERE_PICK_ID_FROM_INDEX_INSTANCED;
+extern const ShaderReplacementRule SPHERE_VARIABLE_SIZE_INSTANCED;
+extern const ShaderReplacementRule SPHERE_CULLPOS_FROM_CENTER_QUAD_INSTANCED;
+extern const ShaderReplacementRule SPHERE_POSITION_LERP;
+extern const ShaderReplacementRule SPHERE_POSITION_LERP_INSTANCED;
+extern const ShaderReplacementRule SPHERE_VALUE_LERP;
+extern const ShaderReplacementRule SPHERE_VALUE_LERP_INSTANCED;
+extern const ShaderReplacementRule SPHERE_PROPAGATE_CHANNEL_VALUE;
+extern const ShaderReplacementRule SPHERE_PROPAGATE_CHANNEL_VALUE_INSTANCED;
+extern const ShaderReplacementRule SPHERE_PROPAGATE_SPARSE_VALUE;
+extern const ShaderReplacementRule SPHERE_PROPAGATE_SPARSE_VALUE_INSTANCED;
 
 
 } // namespace backend_openGL3_glfw
@@ -8,6 +8,7 @@ namespace backend_openGL3_glfw {
 
 // High level pipeline
 extern const ShaderStageSpecification FLEX_MESH_VERT_SHADER;
+extern const ShaderStageSpecification FLEX_MESH_INSTANCED_VERT_SHADER;
 extern const ShaderStageSpecification FLEX_MESH_FRAG_SHADER;
 
 // Rules specific to meshes 
@@ -15,13 +16,26 @@ extern const ShaderReplacementRule MESH_WIREFRAME;
 extern const ShaderReplacementRule MESH_BACKFACE_NORMAL_FLIP;
 extern const ShaderReplacementRule MESH_BACKFACE_DIFFERENT;
 extern const ShaderReplacementRule MESH_BACKFACE_DARKEN;
+extern const ShaderReplacementRule MESH_COMPUTE_NORMAL_FROM_POSITION;
 extern const ShaderReplacementRule MESH_PROPAGATE_VALUE;
+extern const ShaderReplacementRule MESH_PROPAGATE_FACE_VALUE_TEXTURE;
+extern const ShaderReplacementRule MESH_PROPAGATE_VERTEX_VALUE_TEXTURE;
+extern const ShaderReplacementRule MESH_PROPAGATE_SPARSE_VALUE;
+extern const ShaderReplacementRule MESH_PROPAGATE_SPARSE_VERTEX_VALUE;
+extern const ShaderReplacementRule MESH_PROPAGATE_SPARSE_FACE_VALUE;
 extern const ShaderReplacementRule MESH_PROPAGATE_VALUE2;
 extern const ShaderReplacementRule MESH_PROPAGATE_COLOR;
+extern const ShaderReplacementRule MESH_PROPAGATE_FACE_COLOR_TEXTURE;
+extern const ShaderReplacementRule MESH_PROPAGATE_CELL_VALUE_TEXTURE;
+extern const ShaderReplacementRule MESH_PROPAGATE_CELL_COLOR_TEXTURE;
 extern const ShaderReplacementRule MESH_PROPAGATE_HALFEDGE_VALUE;
 extern const ShaderReplacementRule MESH_PROPAGATE_CULLPOS;
 extern const ShaderReplacementRule MESH_PROPAGATE_PICK;
+extern const ShaderReplacementRule MESH_PROPAGATE_PICK_TEXTURE;
 extern const ShaderReplacementRule MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE;
+extern const ShaderReplacementRule MESH_INSTANCE_PROPAGATE_VALUE;
+extern const ShaderReplacementRule MESH_INSTANCE_PROPAGATE_COLOR;
+extern const ShaderReplacementRule MESH_INSTANCE_PROPAGATE_PICK;
 
 
 } // namespace backend_openGL3_glfw
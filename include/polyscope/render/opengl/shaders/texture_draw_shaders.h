@@ -7,15 +7,20 @@ namespace render {
 namespace backend_openGL3_glfw {
 
 extern const ShaderStageSpecification TEXTURE_DRAW_VERT_SHADER;
+extern const ShaderStageSpecification TEXTURE_TILE_DRAW_VERT_SHADER;
 extern const ShaderStageSpecification SPHEREBG_DRAW_VERT_SHADER;
 extern const ShaderStageSpecification SPHEREBG_DRAW_FRAG_SHADER;
 extern const ShaderStageSpecification PLAIN_TEXTURE_DRAW_FRAG_SHADER;
 extern const ShaderStageSpecification DOT3_TEXTURE_DRAW_FRAG_SHADER;
 extern const ShaderStageSpecification MAP3_TEXTURE_DRAW_FRAG_SHADER;
 extern const ShaderStageSpecification COMPOSITE_PEEL;
+extern const ShaderStageSpecification COMPOSITE_WEIGHTED;
+extern const ShaderStageSpecification DEFERRED_LIGHTING;
 extern const ShaderStageSpecification DEPTH_COPY;
 extern const ShaderStageSpecification DEPTH_TO_MASK;
+extern const ShaderStageSpecification EYE_DOME_LIGHTING;
 extern const ShaderStageSpecification BLUR_RGB;
+extern const ShaderStageSpecification TEMPORAL_ACCUMULATE;
 
 extern const ShaderStageSpecification SCALAR_TEXTURE_COLORMAP;
 
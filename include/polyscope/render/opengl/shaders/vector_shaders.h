@@ -11,8 +11,12 @@ extern const ShaderStageSpecification FLEX_VECTOR_VERT_SHADER;
 extern const ShaderStageSpecification FLEX_VECTOR_GEOM_SHADER;
 extern const ShaderStageSpecification FLEX_VECTOR_FRAG_SHADER;
 
+// Instanced variant, with no geometry stage
+extern const ShaderStageSpecification FLEX_VECTOR_INSTANCED_VERT_SHADER;
+
 // Rules specific to cylinders
 extern const ShaderReplacementRule VECTOR_PROPAGATE_COLOR;
+extern const ShaderReplacementRule VECTOR_PROPAGATE_COLOR_INSTANCED;
 extern const ShaderReplacementRule VECTOR_CULLPOS_FROM_TAIL;
 
 } // namespace backend_openGL3_glfw
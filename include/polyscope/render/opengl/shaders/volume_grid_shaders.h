@@ -0,0 +1,21 @@
+#pragma once
+
+#include "polyscope/render/opengl/gl_shaders.h"
+
+namespace polyscope {
+namespace render {
+namespace backend_openGL3_glfw {
+
+// High level pipeline
+extern const ShaderStageSpecification VOLUME_GRID_RAYMARCH_VERT_SHADER;
+extern const ShaderStageSpecification VOLUME_GRID_RAYMARCH_FRAG_SHADER;
+
+// Rules
+extern const ShaderReplacementRule VOLUME_GRID_SAMPLE_DENSE;
+extern const ShaderReplacementRule VOLUME_GRID_SAMPLE_BRICKED;
+ShaderReplacementRule generateVolumeGridSlicePlaneRule();
+
+
+} // namespace backend_openGL3_glfw
+} // namespace render
+} // namespace polyscope
@@ -15,6 +15,18 @@ extern const ShaderReplacementRule SLICE_TETS_MESH_WIREFRAME;
 extern const ShaderReplacementRule SLICE_TETS_PROPAGATE_VALUE;
 extern const ShaderReplacementRule SLICE_TETS_PROPAGATE_VECTOR;
 extern const ShaderReplacementRule SLICE_TETS_VECTOR_COLOR;
+extern const ShaderReplacementRule SLICE_TETS_PROPAGATE_CELL_VALUE;
+extern const ShaderReplacementRule SLICE_TETS_PROPAGATE_CELL_VECTOR;
+extern const ShaderReplacementRule SLICE_TETS_SLICE_BY_VALUE;
+
+// Slices cut once and drawn from captured triangles
+extern const ShaderStageSpecification SLICE_TETS_CAPTURE_FRAG_SHADER;
+extern const ShaderStageSpecification SLICE_TETS_CACHED_VERT_SHADER;
+extern const ShaderReplacementRule SLICE_TETS_CAPTURE_POSITION;
+extern const ShaderReplacementRule SLICE_TETS_CAPTURE_VALUE;
+extern const ShaderReplacementRule SLICE_TETS_CAPTURE_VECTOR;
+extern const ShaderReplacementRule SLICE_TETS_CACHED_VALUE;
+extern const ShaderReplacementRule SLICE_TETS_CACHED_VECTOR;
 
 
 } // namespace backend_openGL3_glfw
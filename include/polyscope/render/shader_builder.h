@@ -5,9 +5,27 @@
 namespace polyscope {
 namespace render {
 
+// A shader stage's source, split once at its ${ TAG }$ tags so that applying replacement rules to it is a single
+// concatenation. The source is literals[0], tags[0], literals[1], ..., tags[n-1], literals[n].
+struct ShaderSourceTemplate {
+  std::vector<std::string> literals;
+  std::vector<std::string> tags;
+  size_t literalLength = 0; // of all the literals together
+};
+ShaderSourceTemplate tokenizeShaderSource(const std::string& src);
+std::vector<ShaderSourceTemplate> tokenizeShaderSources(const std::vector<ShaderStageSpecification>& stages);
+std::vector<ShaderSourceTemplate> tokenizeShaderSources(const std::vector<const ShaderStageSpecification*>& stages);
+
+// Insert the text of the rules at the tags in the stages' sources, and union the rules' inputs in to the stages'
 std::vector<ShaderStageSpecification>
 applyShaderReplacements(const std::vector<ShaderStageSpecification>& stages,
                         const std::vector<ShaderReplacementRule>& replacementRules);
 
+// The same, for stages whose sources have already been tokenized as `templates` (one per stage)
+std::vector<ShaderStageSpecification>
+applyShaderReplacements(const std::vector<const ShaderStageSpecification*>& stages,
+                        const std::vector<ShaderSourceTemplate>& templates,
+                        const std::vector<const ShaderReplacementRule*>& replacementRules);
+
 }
 } // namespace polyscope
@@ -19,6 +19,10 @@ public:
   void draw();
   void buildParametersGUI();
 
+  // Append more lines, e.g. as they are traced (see FieldTraceTask). The buffers are refilled on the next draw.
+  void addRibbons(const std::vector<std::vector<std::array<glm::vec3, 2>>>& newRibbons);
+  size_t nRibbons() const { return ribbons.size(); }
+
   Structure& parentStructure;
   const std::string uniqueName;
 
@@ -34,6 +38,7 @@ public:
 private:
   // Data
   std::vector<std::vector<std::array<glm::vec3, 2>>> ribbons;
+  std::vector<float> ribbonColorSamples; // where each line samples the colormap, fixed so that refills keep the colors
   double normalOffsetFraction;
 
   PersistentValue<bool> enabled;
@@ -0,0 +1,97 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace polyscope {
+
+class Histogram;
+namespace render {
+class AttributeBuffer;
+class ShaderProgram;
+}
+
+// The values of a scalar quantity, held in double or single precision, or quantized (see options::scalarPrecision).
+// Single precision values take half the memory, and are uploaded to the GPU without any conversion. Quantized values
+// take 16 or 8 bits each, as evenly spaced steps across the (finite) range of the values they were made from; values
+// set later are clamped to that range. Element access always returns doubles, so code which only reads values does not
+// need to care which is used.
+class ScalarArray {
+public:
+  ScalarArray(const std::vector<double>& values, ScalarPrecision precision);
+
+  size_t size() const;
+  bool empty() const { return size() == 0; }
+  double operator[](size_t i) const {
+    switch (precision) {
+    case ScalarPrecision::Double:
+      return doubleValues[i];
+    case ScalarPrecision::Float:
+      return floatValues[i];
+    case ScalarPrecision::Quantized16:
+      return dequantize(shortValues[i]);
+    case ScalarPrecision::Quantized8:
+      return dequantize(byteValues[i]);
+    }
+    return 0.;
+  }
+  ScalarPrecision getPrecision() const { return precision; }
+  size_t allocatedBytes() const {
+    return doubleValues.capacity() * sizeof(double) + floatValues.capacity() * sizeof(float) +
+           shortValues.capacity() * sizeof(uint16_t) + byteValues.capacity() * sizeof(uint8_t);
+  }
+  bool isQuantized() const {
+    return precision == ScalarPrecision::Quantized16 || precision == ScalarPrecision::Quantized8;
+  }
+  double quantizationError() const; // the most any value in range is off by, 0 unless quantized
+
+  // Grow or shrink to n values (new values are zero), and set a value
+  void resize(size_t n);
+  void set(size_t i, double val);
+
+  // The values, converted to doubles if needed
+  std::vector<double> toDoubles() const;
+  double maxPositive() const; // the largest value, or 0 if none is positive
+
+
+  // Same as robustMinMax(), computed in the stored type
+  std::pair<double, double> robustMinMax(double rangeEPS) const;
+  std::pair<double, double> approximatePercentileRange(double lowPercentile, double highPercentile) const;
+
+  void buildHistogram(Histogram& hist, const std::vector<double>& weights = {}) const;
+  void setAttribute(render::ShaderProgram& p, std::string name, bool update = false) const;
+  void setAttribute(render::ShaderProgram& p, std::string name, const std::vector<uint32_t>& indices, // a subset
+                    bool update = false) const;
+  void setPaddedAttribute(render::ShaderProgram& p, std::string name, size_t bufferSize, // zeros past the values
+                          bool update = false) const;
+  void updateAttributeRanges(render::ShaderProgram& p, std::string name,
+                             const std::vector<std::pair<size_t, size_t>>& ranges) const;
+  void setBufferData(render::AttributeBuffer& buffer, bool update = false) const; // as floats
+
+private:
+  ScalarPrecision precision;
+  std::vector<double> doubleValues; // only one of these is populated, according to precision
+  std::vector<float> floatValues;
+  std::vector<uint16_t> shortValues;
+  std::vector<uint8_t> byteValues;
+
+  // Quantized value q stands for quantLow + q * quantStep, except for the largest q, which stands for NaN (and any
+  // other non-finite value)
+  double quantLow = 0.;
+  double quantStep = 0.;
+  uint32_t quantMax() const { return precision == ScalarPrecision::Quantized16 ? 0xFFFF : 0xFF; }
+  uint32_t quantize(double val) const;
+  double dequantize(uint32_t q) const {
+    return q == quantMax() ? std::numeric_limits<double>::quiet_NaN() : quantLow + q * quantStep;
+  }
+  std::vector<float> toFloats() const; // (quantized values only, dequantized for the GPU)
+};
+
+} // namespace polyscope
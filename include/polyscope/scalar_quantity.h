@@ -1,9 +1,15 @@
 #pragma once
 
+#include "polyscope/batch_update.h"
 #include "polyscope/persistent_value.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/render/engine.h"
+#include "polyscope/scalar_array.h"
 #include "polyscope/scaled_value.h"
+#include "polyscope/standardize_data_array.h"
+
+#include <algorithm>
+#include <vector>
 
 namespace polyscope {
 
@@ -13,6 +19,7 @@ template <typename QuantityT>
 class ScalarQuantity {
 public:
   ScalarQuantity(QuantityT& parent, const std::vector<double>& values, DataType dataType);
+  ~ScalarQuantity();
 
   // Build the ImGUI UIs for scalars
   void buildScalarUI();
@@ -21,12 +28,24 @@ public:
   // Add rules to rendering programs for scalars
   std::vector<std::string> addScalarRules(std::vector<std::string> rules);
 
-  // Set uniforms in rendering programs for scalars
+  // Set uniforms in rendering programs for scalars. This also rebinds the colormap texture after setColorMap(), which
+  // changes nothing else, so programs are not rebuilt for it.
   void setScalarUniforms(render::ShaderProgram& p);
+  void setColorMapTexture(render::ShaderProgram& p); // just the colormap part, for programs without the other uniforms
+
+  // Replace the values, which must be as many as before. The shader programs, colormap, map range and other options are
+  // kept; only the value buffers are written again.
+  template <class T>
+  QuantityT* updateData(const T& newValues);
+
+  // Store the values at another precision (see options::scalarPrecision). Quantizing is lossy, and going back to a
+  // higher precision does not restore what was lost.
+  QuantityT* setStoragePrecision(ScalarPrecision precision);
+  ScalarPrecision getStoragePrecision();
 
   // === Members
   QuantityT& quantity;
-  std::vector<double> values;
+  ScalarArray values; // stored at options::scalarPrecision
   const DataType dataType;
 
   // === Get/set visualization parameters
@@ -38,7 +57,7 @@ public:
   // Data limits mapped in to colormap
   QuantityT* setMapRange(std::pair<double, double> val);
   std::pair<double, double> getMapRange();
-  QuantityT* resetMapRange(); // reset to full range
+  QuantityT* resetMapRange(); // reset to the full range (clipped as set by options::scalarRangeClipPercentile)
 
   // Isolines
   QuantityT* setIsolinesEnabled(bool newEnabled);
@@ -55,13 +74,17 @@ protected:
   // Affine data maps and limits
   std::pair<float, float> vizRange; // TODO make these persistent
   std::pair<double, double> dataRange;
+  std::pair<double, double> defaultRange; // dataRange, or the percentiles of options::scalarRangeClipPercentile
   Histogram hist;
+  void computeRanges(double clipPercentile); // dataRange and defaultRange, from the values
 
   // Parameters
   PersistentValue<std::string> cMap;
   PersistentValue<bool> isolinesEnabled;
   PersistentValue<ScaledValue<float>> isolineWidth;
   PersistentValue<float> isolineDarkness;
+
+  std::vector<const render::ShaderProgram*> programsWithColorMap; // bound to the current colormap
 };
 
 } // namespace polyscope
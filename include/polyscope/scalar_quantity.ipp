@@ -2,24 +2,81 @@ namespace polyscope {
 
 template <typename QuantityT>
 ScalarQuantity<QuantityT>::ScalarQuantity(QuantityT& quantity_, const std::vector<double>& values_, DataType dataType_)
-    : quantity(quantity_), values(values_), dataType(dataType_), dataRange(robustMinMax(values, 1e-5)),
+    : quantity(quantity_), values(values_, options::scalarPrecision), dataType(dataType_),
       cMap(quantity.name + "#cmap", defaultColorMap(dataType)),
       isolinesEnabled(quantity.name + "#isolinesEnabled", false),
-      isolineWidth(quantity.name + "#isolineWidth", absoluteValue((dataRange.second - dataRange.first) * 0.02)),
+      isolineWidth(quantity.name + "#isolineWidth", absoluteValue(0.)), // set from the data range below
       isolineDarkness(quantity.name + "#isolineDarkness", 0.7)
 
 {
   hist.updateColormap(cMap.get());
-  hist.buildHistogram(values);
-  resetMapRange();
+  hist.buildHistogramLazily([this]() { values.buildHistogram(hist); });
+
+  // The passes over the data are deferred when registering in a batch (see batch_update.h)
+  double clipPercentile = options::scalarRangeClipPercentile;
+  batch::runOrDefer(
+      this,
+      [this, clipPercentile]() { computeRanges(clipPercentile); },
+      [this]() {
+        isolineWidth.setPassive(absoluteValue((dataRange.second - dataRange.first) * 0.02));
+        resetMapRange();
+      });
+}
+
+template <typename QuantityT>
+ScalarQuantity<QuantityT>::~ScalarQuantity() {
+  batch::cancelDeferred(this);
+}
+
+template <typename QuantityT>
+void ScalarQuantity<QuantityT>::computeRanges(double clipPercentile) {
+  dataRange = values.robustMinMax(1e-5);
+  defaultRange = dataRange;
+  if (clipPercentile > 0.) {
+    defaultRange = values.approximatePercentileRange(clipPercentile, 100. - clipPercentile);
+  }
+}
+
+template <typename QuantityT>
+template <class T>
+QuantityT* ScalarQuantity<QuantityT>::updateData(const T& newValues) {
+  validateSize(newValues, values.size(), "scalar quantity " + quantity.name);
+  batch::runDeferred(this); // (a pending setup would otherwise reset the map range afterwards)
+
+  values = ScalarArray(standardizeArray<double, T>(newValues), values.getPrecision());
+
+  // The data statistics follow the new values, but the map range is left as the user set it. The histogram is binned
+  // again only when it is next drawn.
+  computeRanges(options::scalarRangeClipPercentile);
+  hist.buildHistogramLazily([this]() { values.buildHistogram(hist); });
+
+  quantity.dataUpdated();
+  quantity.requestRedraw();
+  return &quantity;
+}
+
+template <typename QuantityT>
+QuantityT* ScalarQuantity<QuantityT>::setStoragePrecision(ScalarPrecision precision) {
+  if (precision == values.getPrecision()) return &quantity;
+  batch::runDeferred(this);
+
+  values = ScalarArray(values.toDoubles(), precision);
+  hist.buildHistogramLazily([this]() { values.buildHistogram(hist); });
+
+  quantity.dataUpdated();
+  quantity.requestRedraw();
+  return &quantity;
+}
+
+template <typename QuantityT>
+ScalarPrecision ScalarQuantity<QuantityT>::getStoragePrecision() {
+  return values.getPrecision();
 }
 
 template <typename QuantityT>
 void ScalarQuantity<QuantityT>::buildScalarUI() {
 
   if (render::buildColormapSelector(cMap.get())) {
-    quantity.refresh();
-    hist.updateColormap(cMap.get());
     setColorMap(getColorMap());
   }
 
@@ -32,6 +89,10 @@ void ScalarQuantity<QuantityT>::buildScalarUI() {
   // Draw the histogram of values
   hist.colormapRange = vizRange;
   hist.buildUI();
+  if (values.isQuantized()) {
+    ImGui::Text("%d-bit values, off by up to %.3e", values.getPrecision() == ScalarPrecision::Quantized16 ? 16 : 8,
+                values.quantizationError());
+  }
 
   // Data range
   // Note: %g specifiers are generally nicer than %e, but here we don't acutally have a choice. ImGui (for somewhat
@@ -67,14 +128,14 @@ void ScalarQuantity<QuantityT>::buildScalarUI() {
       if (ImGui::DragFloat("##Isoline width relative", isolineWidth.get().getValuePtr(), .001, 0.0001, 1.0, "%.4f",
                            ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_NoRoundToFormat)) {
         isolineWidth.manuallyChanged();
-        requestRedraw();
+        quantity.requestRedraw();
       }
     } else {
       float scaleWidth = dataRange.second - dataRange.first;
       if (ImGui::DragFloat("##Isoline width absolute", isolineWidth.get().getValuePtr(), scaleWidth / 1000, 0.,
                            scaleWidth, "%.4f", ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_NoRoundToFormat)) {
         isolineWidth.manuallyChanged();
-        requestRedraw();
+        quantity.requestRedraw();
       }
     }
 
@@ -83,7 +144,7 @@ void ScalarQuantity<QuantityT>::buildScalarUI() {
     ImGui::SameLine();
     if (ImGui::DragFloat("##Isoline darkness", &isolineDarkness.get(), 0.01, 0.)) {
       isolineDarkness.manuallyChanged();
-      requestRedraw();
+      quantity.requestRedraw();
     }
 
     ImGui::PopItemWidth();
@@ -108,6 +169,7 @@ std::vector<std::string> ScalarQuantity<QuantityT>::addScalarRules(std::vector<s
 
 template <typename QuantityT>
 void ScalarQuantity<QuantityT>::setScalarUniforms(render::ShaderProgram& p) {
+  setColorMapTexture(p);
   p.setUniform("u_rangeLow", vizRange.first);
   p.setUniform("u_rangeHigh", vizRange.second);
 
@@ -117,22 +179,35 @@ void ScalarQuantity<QuantityT>::setScalarUniforms(render::ShaderProgram& p) {
   }
 }
 
+template <typename QuantityT>
+void ScalarQuantity<QuantityT>::setColorMapTexture(render::ShaderProgram& p) {
+  // Programs made since the last change of colormap already have it; the others are rebound once. (A program made after
+  // another was freed may be at its address, and is then taken to be current, which it is.)
+  if (std::find(programsWithColorMap.begin(), programsWithColorMap.end(), &p) != programsWithColorMap.end()) return;
+  if (programsWithColorMap.size() >= 16) programsWithColorMap.clear(); // (stale addresses of rebuilt programs)
+  if (p.hasTexture("t_colormap")) {
+    p.setTextureFromColormap("t_colormap", cMap.get(), true);
+  }
+  programsWithColorMap.push_back(&p);
+}
+
 template <typename QuantityT>
 QuantityT* ScalarQuantity<QuantityT>::resetMapRange() {
+  batch::runDeferred(this);
   switch (dataType) {
   case DataType::STANDARD:
-    vizRange = dataRange;
+    vizRange = defaultRange;
     break;
   case DataType::SYMMETRIC: {
-    double absRange = std::max(std::abs(dataRange.first), std::abs(dataRange.second));
+    double absRange = std::max(std::abs(defaultRange.first), std::abs(defaultRange.second));
     vizRange = std::make_pair(-absRange, absRange);
   } break;
   case DataType::MAGNITUDE:
-    vizRange = std::make_pair(0., dataRange.second);
+    vizRange = std::make_pair(0., defaultRange.second);
     break;
   }
 
-  requestRedraw();
+  quantity.requestRedraw();
   return &quantity;
 }
 
@@ -141,8 +216,8 @@ template <typename QuantityT>
 QuantityT* ScalarQuantity<QuantityT>::setColorMap(std::string val) {
   cMap = val;
   hist.updateColormap(cMap.get());
-  quantity.refresh();
-  requestRedraw();
+  programsWithColorMap.clear(); // the programs are rebound as they are next drawn, see setColorMapTexture()
+  quantity.requestRedraw();
   return &quantity;
 }
 template <typename QuantityT>
@@ -152,26 +227,30 @@ std::string ScalarQuantity<QuantityT>::getColorMap() {
 
 template <typename QuantityT>
 QuantityT* ScalarQuantity<QuantityT>::setMapRange(std::pair<double, double> val) {
+  batch::runDeferred(this);
   vizRange = val;
-  requestRedraw();
+  quantity.requestRedraw();
   return &quantity;
 }
 template <typename QuantityT>
 std::pair<double, double> ScalarQuantity<QuantityT>::getMapRange() {
+  batch::runDeferred(this);
   return vizRange;
 }
 
 template <typename QuantityT>
 QuantityT* ScalarQuantity<QuantityT>::setIsolineWidth(double size, bool isRelative) {
+  batch::runDeferred(this);
   isolineWidth = ScaledValue<float>(size, isRelative);
   if (!isolinesEnabled.get()) {
     setIsolinesEnabled(true);
   }
-  requestRedraw();
+  quantity.requestRedraw();
   return &quantity;
 }
 template <typename QuantityT>
 double ScalarQuantity<QuantityT>::getIsolineWidth() {
+  batch::runDeferred(this);
   return isolineWidth.get().asAbsolute();
 }
 
@@ -181,7 +260,7 @@ QuantityT* ScalarQuantity<QuantityT>::setIsolineDarkness(double val) {
   if (!isolinesEnabled.get()) {
     setIsolinesEnabled(true);
   }
-  requestRedraw();
+  quantity.requestRedraw();
   return &quantity;
 }
 template <typename QuantityT>
@@ -191,9 +270,12 @@ double ScalarQuantity<QuantityT>::getIsolineDarkness() {
 
 template <typename QuantityT>
 QuantityT* ScalarQuantity<QuantityT>::setIsolinesEnabled(bool newEnabled) {
+  bool changed = newEnabled != isolinesEnabled.get();
   isolinesEnabled = newEnabled;
-  quantity.refresh();
-  requestRedraw();
+  if (changed) {
+    quantity.refresh(); // (a different shader)
+  }
+  quantity.requestRedraw();
   return &quantity;
 }
 template <typename QuantityT>
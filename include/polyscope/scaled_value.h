@@ -43,6 +43,11 @@ public:
   // implicit conversion from scalar creates relative by default
   ScaledValue(const T& relativeValue) : relativeFlag(true), value(relativeValue) {}
 
+  bool operator==(const ScaledValue<T>& other) const {
+    return relativeFlag == other.relativeFlag && value == other.value;
+  }
+  bool operator!=(const ScaledValue<T>& other) const { return !(*this == other); }
+
   // Make all template variants friends, so conversion can access private members
   template <typename>
   friend class ScaledValue;
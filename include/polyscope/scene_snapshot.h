@@ -0,0 +1,25 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace polyscope {
+
+// Save the scene to a binary file, which loadScene() reads back much faster than the scene can usually be rebuilt.
+//
+// The file holds the point clouds, surface meshes, curve networks and volume meshes, with their transforms and their
+// scalar, color and (extrinsic) vector quantities; the persistent settings of every structure and quantity (colors,
+// materials, enabled flags, ...); and the camera. Surface meshes also keep the connectivity and geometry derived from
+// their faces, so loading skips computing it. Other structures and quantities are skipped with a warning.
+//
+// Files are only read back by builds with the same version of the format, byte order and size_t.
+void saveScene(std::string filename);
+
+// Add the structures of a file written by saveScene(), replacing any with the same names, and restore its settings and
+// camera. Throws std::runtime_error if the file can not be read.
+void loadScene(std::string filename);
+
+extern const uint32_t sceneFileVersion; // bumped whenever the layout of scene files changes
+
+} // namespace polyscope
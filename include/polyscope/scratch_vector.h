@@ -0,0 +1,109 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace polyscope {
+
+// A temporary array for filling draw buffers, such as the per-corner positions of a mesh before they are uploaded.
+// When it goes out of scope its storage is not freed, but kept in a pool on the current thread, and the next
+// ScratchVector of the same element type starts out empty with that capacity. Repeated refreshes then reuse the same
+// memory rather than allocating (and paging in) large arrays each time. The pools hold at most
+// options::scratchMemoryBudget bytes in total; storage beyond that is freed as usual.
+//
+//   ScratchVector<glm::vec3> positions;
+//   positions->reserve(n);
+//   ...
+//   program.setAttribute("a_position", *positions);
+template <typename T>
+class ScratchVector {
+public:
+  ScratchVector();
+  ~ScratchVector();
+  ScratchVector(const ScratchVector&) = delete;
+  ScratchVector& operator=(const ScratchVector&) = delete;
+
+  std::vector<T>& operator*() { return vec; }
+  const std::vector<T>& operator*() const { return vec; }
+  std::vector<T>* operator->() { return &vec; }
+  const std::vector<T>* operator->() const { return &vec; }
+
+private:
+  std::vector<T> vec;
+  size_t initialBytes; // the capacity it started with
+};
+
+// The host memory taken by scratch storage, both pooled and in use, over all threads
+struct ScratchMemoryStats {
+  size_t currentBytes = 0;
+  size_t peakBytes = 0; // since startup
+};
+ScratchMemoryStats getScratchMemoryStats();
+
+// Free the storage pooled on the calling thread
+void releaseScratchMemory();
+
+namespace detail {
+
+// Accounting shared by the pools of all element types and threads
+void scratchGrew(long long int deltaBytes);         // the storage held by scratch vectors changed
+bool scratchTryPool(size_t bytes);                  // false if pooling this much more would exceed the budget
+void scratchUnpooled(size_t bytes);                 // storage left a pool, to be used again or freed
+void registerScratchPoolRelease(void (*release)()); // (by the pools of each element type)
+
+// The calling thread's pool for one element type
+template <typename T>
+struct ScratchPool {
+  ScratchPool();
+  ~ScratchPool() { release(); }
+  void release() {
+    for (std::vector<T>& v : vectors) {
+      scratchUnpooled(v.capacity() * sizeof(T));
+      scratchGrew(-static_cast<long long int>(v.capacity() * sizeof(T)));
+    }
+    vectors.clear();
+  }
+  std::vector<std::vector<T>> vectors;
+};
+
+template <typename T>
+ScratchPool<T>& scratchPool() {
+  thread_local ScratchPool<T> pool;
+  return pool;
+}
+
+template <typename T>
+ScratchPool<T>::ScratchPool() {
+  registerScratchPoolRelease([]() { scratchPool<T>().release(); });
+}
+
+} // namespace detail
+
+template <typename T>
+ScratchVector<T>::ScratchVector() {
+  detail::ScratchPool<T>& pool = detail::scratchPool<T>();
+  if (!pool.vectors.empty()) {
+    vec.swap(pool.vectors.back());
+    pool.vectors.pop_back();
+    detail::scratchUnpooled(vec.capacity() * sizeof(T));
+  }
+  initialBytes = vec.capacity() * sizeof(T);
+}
+
+template <typename T>
+ScratchVector<T>::~ScratchVector() {
+  size_t bytes = vec.capacity() * sizeof(T);
+  detail::scratchGrew(static_cast<long long int>(bytes) - static_cast<long long int>(initialBytes));
+  if (bytes == 0) return;
+  if (!detail::scratchTryPool(bytes)) {
+    detail::scratchGrew(-static_cast<long long int>(bytes)); // (freed along with vec)
+    return;
+  }
+  vec.clear();
+  detail::ScratchPool<T>& pool = detail::scratchPool<T>();
+  pool.vectors.emplace_back();
+  pool.vectors.back().swap(vec);
+}
+
+} // namespace polyscope
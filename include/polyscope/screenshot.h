@@ -3,6 +3,9 @@
 
 #include "polyscope/polyscope.h"
 
+#include <functional>
+#include <vector>
+
 namespace polyscope {
 
 
@@ -10,8 +13,44 @@ namespace polyscope {
 void screenshot(std::string filename, bool transparentBG = true);
 void screenshot(bool transparentBG = true);
 void saveImage(std::string name, unsigned char* buffer, int w, int h, int channels);
+
+// Render the current view and return it rather than writing a file, as RGBA8 pixels of size view::bufferWidth x
+// view::bufferHeight with rows ordered top to bottom. Works the same with the headless openGL3_egl backend.
+std::vector<unsigned char> renderToBuffer(bool transparentBG = true);
 void resetScreenshotIndex();
 
+// Render the current view at a size larger than the framebuffer and write it to a file, e.g. for posters. The image is
+// rendered in tiles the size of the framebuffer, each with the part of the projection it covers, and pngs are written a
+// row of tiles at a time; other formats are assembled in memory first. The aspect ratio is that of width x height.
+void renderTiledScreenshot(std::string filename, int width, int height, bool transparentBG = true);
+
+// Block until all screenshots queued with options::asyncScreenshots have been written to disk
+void flushScreenshots();
+
+// Hand any async screenshots whose readback has finished to the writer threads (called by the main loop each frame)
+void processQueuedScreenshots();
+bool haveQueuedScreenshots();
+
+// Record every frame drawn by the main loop, without the GUI. A path ending in .png or .jpg writes an image sequence,
+// numbered like "path_000000.png", on background threads; any other path is a video, encoded with the given ffmpeg
+// codec by piping raw frames to options::ffmpegPath. Frames are read back asynchronously, so the render loop only waits
+// for a readback when several are in flight. If the writers fall behind by options::recordingMaxQueuedFrames, or the
+// window is resized, frames are dropped, and stopRecording() warns how many.
+void startRecording(std::string path, double fps = 30., std::string codec = "libx264");
+// Or hand each recorded frame to sink rather than writing it, e.g. to stream the view of a headless session: RGBA8
+// pixels, w x h, with rows bottom to top as openGL reads them. Only frames in which the scene was redrawn are passed on,
+// and the size follows the window. sink runs on a worker thread, one frame at a time in order, and frames are dropped
+// while it falls behind as above.
+void startRecording(std::function<void(const std::vector<unsigned char>& rgba, int w, int h)> sink);
+void stopRecording(); // waits for the frames still being written
+bool isRecording();
+
+// Start reading back the frame in the display buffer if recording (called by draw() before the GUI is drawn)
+void captureRecordingFrame(bool sceneWasRendered = true);
+
+// Hand any recorded frames whose readback has finished to the writers (called by the main loop each frame)
+void processRecordingFrames();
+
 
 namespace state {
 
@@ -0,0 +1,61 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/frame_stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// forward declarations
+class Structure;
+
+// Record the scene-building calls made to Polyscope, with their data, to a binary file which replaySession() executes
+// again, so that a slow session can be reproduced (and bisected) without the program which built it.
+//
+// The file starts with the structures and quantities already registered, then logs as they happen: point clouds,
+// surface meshes, curve networks and volume meshes being registered or removed, their scalar, color and vector
+// quantities being added or removed, and their positions being updated. Before each frame drawn by the main loop it also
+// logs whatever changed among the camera, the structures' enabled flags and transforms, the quantities' enabled flags,
+// and the options which reconfigure the renderer (options::ssaaFactor, options::transparencyMode, ...). Every record
+// carries the seconds since the capture started. Other structures, quantities and settings are not captured, and
+// stopSessionCapture() warns which were skipped.
+//
+// Files are only read back by builds with the same version of the format, byte order and size_t.
+void startSessionCapture(std::string filename);
+void stopSessionCapture(); // writes out the remaining records and closes the file
+bool isCapturingSession();
+
+struct SessionReplayStats {
+  size_t nCalls = 0;           // records executed, other than frames
+  size_t nFrames = 0;          // frames drawn
+  double callSeconds = 0.;     // spent executing the records
+  double frameSeconds = 0.;    // spent drawing the frames
+  double capturedSeconds = 0.; // length of the captured session
+  FrameStats frameStats;       // of the frames drawn, if options::enableCPUProfiling is set
+};
+
+// Execute the records of a file written by a session capture, drawing a frame wherever the captured session drew one.
+// By default records run back to back, timing the work itself; with realTime set each waits until it is as far from the
+// start of the replay as it was from the start of the capture. Throws std::runtime_error if the file can not be read,
+// or refers to a structure which is not registered.
+SessionReplayStats replaySession(std::string filename, bool realTime = false);
+
+extern const uint32_t sessionFileVersion; // bumped whenever the layout of session files changes
+
+namespace detail {
+
+// Hooks through which the API reports the calls to capture, each only called while sessionCaptureActive is set
+extern bool sessionCaptureActive;
+void captureRegisteredStructure(Structure& s);
+void captureRemovedStructure(const std::string& typeName, const std::string& name);
+void captureAddedQuantity(Structure& s, const std::string& quantityName);
+void captureRemovedQuantity(Structure& s, const std::string& quantityName);
+void captureMovedPositions(Structure& s, const std::vector<size_t>* movedIndices); // nullptr if all moved
+void captureFrame(); // (called by the main loop before drawing each frame)
+
+} // namespace detail
+} // namespace polyscope
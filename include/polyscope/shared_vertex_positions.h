@@ -0,0 +1,75 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/render/engine.h"
+#include "polyscope/standardize_data_array.h"
+
+#include "glm/glm.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace polyscope {
+
+// One array of vertex positions referenced by several structures, e.g. surface meshes of the parts of a segmentation
+// and a point cloud of all the vertices. Create it with createSharedVertexPositions() and pass it to
+// registerSurfaceMesh() / registerPointCloud(); each structure keeps a reference, so it lives as long as any of them.
+//
+// The positions are uploaded once, to a buffer which every program drawing them directly binds: point clouds (unless
+// drawing a level of detail), and surface meshes drawn with shared vertices (smooth shading, no wireframe). Moving the
+// vertices here, or through any of the structures, updates that buffer once and then every structure.
+class SharedVertexPositions {
+public:
+  SharedVertexPositions(std::vector<glm::vec3> positions);
+  SharedVertexPositions(const SharedVertexPositions&) = delete;
+  SharedVertexPositions& operator=(const SharedVertexPositions&) = delete;
+
+  const std::vector<glm::vec3>& getPositions() const { return positions; }
+  size_t size() const { return positions.size(); }
+
+  // Move all of the vertices, or only some of them (newPositions[i] is the new position of vertex indices[i])
+  template <class V>
+  void updateVertexPositions(const V& newPositions);
+  template <class V>
+  void updateVertexPositions(const std::vector<size_t>& indices, const V& newPositions);
+
+  // The positions on the GPU, uploaded when first requested
+  std::shared_ptr<render::AttributeBuffer> getRenderBuffer();
+
+  // Structures referencing the positions are told when they move, with the indices which moved (nullptr if all of them
+  // did). Managed by the structures themselves.
+  typedef std::function<void(const std::vector<size_t>* movedIndices)> MovedCallback;
+  void addUser(const void* user, MovedCallback callback);
+  void removeUser(const void* user);
+  size_t nUsers() const { return users.size(); }
+
+private:
+  std::vector<glm::vec3> positions;
+  std::shared_ptr<render::AttributeBuffer> renderBuffer;
+  std::vector<std::pair<const void*, MovedCallback>> users;
+
+  void updateVertexPositionsImpl(std::vector<glm::vec3> newPositions);
+  void updateVertexPositionsImpl(const std::vector<size_t>& indices, const std::vector<glm::vec3>& newPositions);
+};
+
+template <class V>
+std::shared_ptr<SharedVertexPositions> createSharedVertexPositions(const V& positions) {
+  return std::make_shared<SharedVertexPositions>(standardizeVectorArray<glm::vec3, 3>(positions));
+}
+
+template <class V>
+void SharedVertexPositions::updateVertexPositions(const V& newPositions) {
+  validateSize(newPositions, size(), "shared vertex positions");
+  updateVertexPositionsImpl(standardizeVectorArray<glm::vec3, 3>(newPositions));
+}
+
+template <class V>
+void SharedVertexPositions::updateVertexPositions(const std::vector<size_t>& indices, const V& newPositions) {
+  validateSize(newPositions, indices.size(), "shared vertex positions");
+  updateVertexPositionsImpl(indices, standardizeVectorArray<glm::vec3, 3>(newPositions));
+}
+
+} // namespace polyscope
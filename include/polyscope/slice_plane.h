@@ -6,8 +6,11 @@
 #include "polyscope/utilities.h"
 #include "polyscope/widget.h"
 
+#include <memory>
+
 namespace polyscope {
 
+class VolumeMeshSlice;
 
 class SlicePlane {
 
@@ -33,6 +36,13 @@ public:
                                                         // nothing (regardless of this plane's active setting)
   void setSliceGeomUniforms(render::ShaderProgram& p);
 
+  // The plane in view coordinates, as passed to u_slicePlanes (or one which culls nothing, if alwaysPass)
+  glm::vec4 viewSpacePlane(bool alwaysPass = false);
+
+  // The plane which slices inspected volume meshes (far outside the scene while inactive)
+  glm::vec3 getCenter();
+  glm::vec3 getNormal();
+
   const std::string name;
   const std::string postfix;
 
@@ -83,7 +93,7 @@ protected:
   bool shouldInspectMesh;
   std::string inspectedMeshName;
 
-  std::shared_ptr<render::ShaderProgram> volumeInspectProgram;
+  std::unique_ptr<VolumeMeshSlice> volumeInspectSlice; // the inspected mesh in its base color
 
   // Widget that wraps the transform
   TransformationGizmo transformGizmo;
@@ -91,14 +101,17 @@ protected:
   std::shared_ptr<render::ShaderProgram> planeProgram;
 
   // Helpers
-  void setSliceAttributes(render::ShaderProgram& p);
-  void createVolumeSliceProgram();
+  void createVolumeSlice();
   void prepare();
-  glm::vec3 getCenter();
-  glm::vec3 getNormal();
   void updateWidgetEnabled();
 };
 
+// Set the slice plane uniforms of a scene object program for all planes in the scene. Bit i of ignoreMask disables
+// culling against state::slicePlanes[i].
+void setSlicePlaneUniforms(render::ShaderProgram& p, uint32_t ignoreMask = 0);
+
+// Add a plane owned by the scene. At most render::MAX_SLICE_PLANES planes can exist at once; past that, this is an
+// error and returns nullptr.
 SlicePlane* addSceneSlicePlane(bool initiallyVisible = false);
 void removeLastSceneSlicePlane();
 void buildSlicePlaneGUI();
@@ -0,0 +1,49 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace polyscope {
+
+namespace render {
+class TextureBuffer;
+}
+
+// The elements of a structure which a sparse quantity has values for, such as the vertices of a mesh where a contact
+// force was measured. The quantity keeps one value per element of the set, in increasing order of element, so its
+// memory is proportional to the number of values rather than to the size of the structure.
+//
+// On the GPU the set is a presence bitmask, read by sparseLookup() in the shaders: one texel for each block of 32
+// elements, holding the bits of the block's elements in .r (the first 16) and .g (the last 16), and in .b the number of
+// elements of the set before the block. An element's value is then found in the texture of values from the bits before
+// it in its block. All of these are floats, so the structure may have up to 2^24 elements.
+class SparseElementSet {
+public:
+  SparseElementSet(size_t nElements, std::vector<uint32_t> indices); // indices increasing, all less than nElements
+
+  // Sort (element, value) pairs by element, keeping the last value given for each element, and split them in to a set
+  // and its values. With permInverse, the pairs are of data indices, mapped to elements through it (see
+  // SurfaceMesh::getVertexPermInverse()). Pairs which name no element are dropped.
+  static SparseElementSet fromEntries(size_t nElements, std::vector<std::pair<size_t, double>> entries,
+                                      std::vector<double>& values, const std::vector<size_t>* permInverse = nullptr);
+
+  size_t size() const { return indices.size(); }      // the number of elements in the set
+  size_t nElements() const { return nElementsTotal; } // of the structure
+  const std::vector<uint32_t>& getIndices() const { return indices; }
+  size_t find(size_t iElement) const; // where the element's value is, or INVALID_IND if it is not in the set
+  bool contains(size_t iElement) const;
+
+  bool fitsTextures() const; // few enough elements for sparseLookup()
+  std::shared_ptr<render::TextureBuffer> generatePresenceTexture() const;
+  size_t allocatedBytes() const;
+
+private:
+  size_t nElementsTotal;
+  std::vector<uint32_t> indices;
+};
+
+} // namespace polyscope
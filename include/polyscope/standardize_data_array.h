@@ -1,9 +1,13 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #pragma once
 
+#include "polyscope/mapped_array.h"
 #include "polyscope/messages.h"
+#include "polyscope/options.h"
+#include "polyscope/parallel.h"
 #include "polyscope/utilities.h"
 
+#include <cstring>
 #include <type_traits>
 #include <vector>
 
@@ -133,6 +137,20 @@ struct PreferenceT : PreferenceT<N - 1> {};
 template <>
 struct PreferenceT<0> {};
 
+// Calls func(i) for each i in [0, n); spread over worker threads when n reaches options::parallelConversionThreshold.
+// Used for element-by-element conversions of random-access inputs.
+template <typename F>
+void adaptorF_forEachElement(size_t n, F&& func) {
+  if (options::parallelConversionThreshold >= 0 &&
+      n >= static_cast<size_t>(options::parallelConversionThreshold)) {
+    parallelFor(0, n, func);
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      func(i);
+    }
+  }
+}
+
 // Used to make static asserts give nice errors
 template <typename T>
 struct WillBeFalseT : std::false_type {};
@@ -228,6 +246,7 @@ size_t adaptorF_size(const T& inputData) {
 // non-random-accessible input types like iterables.
 //
 // The following hierarchy of strategies will be attempted, with decreasing precedence:
+// - memory-mapped files (MappedArray)
 // - user-defined adaptorF_custom_convertToStdVector()
 // - bracket access
 // - callable (parenthesis) access
@@ -240,7 +259,25 @@ inline void adaptorF_custom_convertToStdVector(void* dont_use) {
   // dummy function
 }
 
-// Highest priority: user-specified function
+// Highest priority: memory-mapped files, converted straight from the mapped pages
+template <class T, class S,
+  /* condition: input is a MappedArray */
+  typename C1 = typename std::enable_if<std::is_same<T, MappedArray>::value>::type>
+
+std::vector<S> adaptorF_convertToStdVectorImpl(PreferenceT<5>, const T& inputData) {
+  if (inputData.cols() != 1) {
+    error("mapped array has " + std::to_string(inputData.cols()) + " columns, but a scalar array was expected");
+    return std::vector<S>();
+  }
+  std::vector<S> dataOut(inputData.rows());
+  if (!dataOut.empty()) {
+    inputData.copyTo(&dataOut[0]);
+  }
+  return dataOut;
+}
+
+
+// Next: user-specified function
 template <class T, class S,
   /* condition: user defined function exists and returns something that can be bracket-indexed to get an S */
   typename C1 = typename std::enable_if< std::is_same<decltype((S)adaptorF_custom_convertToStdVector(*(T*)nullptr)[0]), S>::value>::type>
@@ -324,7 +361,7 @@ std::vector<S> adaptorF_convertToStdVectorImpl(PreferenceT<0>, const T& inputDat
 // General version, which will attempt to substitute in to the variants above
 template <class S, class T>
 std::vector<S> adaptorF_convertToStdVector(const T& inputData) {
-  return adaptorF_convertToStdVectorImpl<T, S>(PreferenceT<4>{}, inputData);
+  return adaptorF_convertToStdVectorImpl<T, S>(PreferenceT<5>{}, inputData);
 }
 
 
@@ -552,8 +589,10 @@ S adaptorF_accessVector3Value(const T& inVal) {
 //
 //
 // The following hierarchy of strategies will be attempted, with decreasing precedence:
+//   - memory-mapped files (MappedArray), with one column per vector component
 //   - any user defined function
 //          std::vector<std::array<F, D>> adaptorF_custom_convertArrayOfVectorToStdVector(const YOUR_TYPE& inputData);
+//   - contiguous storage of elements laid out exactly like the output type (like std::vector<glm::vec3>)
 //   - dense callable (parenthesis) access (like T(i,j))
 //   - double bracket access (like T[i][j])
 //   - outer type bracket accessbile, inner anything convertible to Vector2/3
@@ -561,7 +600,40 @@ S adaptorF_accessVector3Value(const T& inVal) {
 //   - iterable bracket (like for(T val : inputData) { val[0] })
 
 
-// Highest priority: user-specified function
+// Highest priority: memory-mapped files, converted straight from the mapped pages
+template <class O, unsigned int D, class T,
+    /* helper type: inner type of output O */
+    typename C_RES = typename InnerType<O>::type,
+    /* condition: input is a MappedArray */
+    typename C1 = typename std::enable_if<std::is_same<T, MappedArray>::value>::type>
+std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<10>, const T& inputData) {
+  if (inputData.cols() != D) {
+    error("mapped array has " + std::to_string(inputData.cols()) + " columns, but vectors of dimension " +
+          std::to_string(D) + " were expected");
+    return std::vector<O>();
+  }
+
+  size_t dataSize = inputData.rows();
+  std::vector<O> dataOut(dataSize);
+  if (dataSize == 0) return dataOut;
+
+  if (std::is_trivially_copyable<O>::value && sizeof(O) == D * sizeof(C_RES)) {
+    // packed output like glm::vec3, convert directly in to it
+    inputData.copyTo(reinterpret_cast<C_RES*>(&dataOut[0]));
+  } else {
+    std::vector<C_RES> flat(dataSize * D);
+    inputData.copyTo(&flat[0]);
+    for (size_t i = 0; i < dataSize; i++) {
+      for (size_t j = 0; j < D; j++) {
+        dataOut[i][j] = flat[i * D + j];
+      }
+    }
+  }
+  return dataOut;
+}
+
+
+// Next: user-specified function
 
 // Note: this dummy function is defined so the non-dependent user function name will always resolve to something; 
 // some compilers will throw an error if the name doesn't resolve.
@@ -575,7 +647,7 @@ template <
     typename C1 = typename std::enable_if<std::is_same< 
                                           decltype((typename InnerType<O>::type)(adaptorF_custom_convertArrayOfVectorToStdVector(*(T*)nullptr))[0][0]), 
                                           typename InnerType<O>::type>::value>::type>
-std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<8>, const T& inputData) {
+std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<9>, const T& inputData) {
 
   // should be std::vector<std::array<SCALAR,D>>
   auto userArr = adaptorF_custom_convertArrayOfVectorToStdVector(inputData);
@@ -584,10 +656,38 @@ std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<8>, cons
 
   size_t dataSize = userArr.size();
   std::vector<O> dataOut(dataSize);
-  for (size_t i = 0; i < dataSize; i++) {
+  adaptorF_forEachElement(dataSize, [&](size_t i) {
     for (size_t j = 0; j < D; j++) {
       dataOut[i][j] = userArr[i][j];
     }
+  });
+  return dataOut;
+}
+
+
+// Next: contiguous storage (.data() and .size()) of elements with exactly the same memory layout as O, like
+// std::vector<glm::vec3> or std::vector<std::array<float, 3>>. The whole array is copied in one block, rather than
+// element-by-element.
+template <class O, unsigned int D, class T,
+    /* helper type: element type pointed to by data() */
+    typename C_ELEM = typename std::remove_cv<typename std::remove_pointer<decltype((*(T*)nullptr).data())>::type>::type,
+    /* helper type: inner type of output O */
+    typename C_RES = typename InnerType<O>::type,
+    /* helper type: scalar type that results from bracket-indexing an element */
+    typename C_ELEM_SCALAR = typename std::remove_cv<typename std::remove_reference<decltype((*(C_ELEM*)nullptr)[0])>::type>::type,
+    /* condition: elements hold D packed scalars of the inner type of O, and so does O */
+    typename C1 = typename std::enable_if<std::is_same<C_ELEM_SCALAR, C_RES>::value && 
+                                          std::is_trivially_copyable<C_ELEM>::value &&
+                                          std::is_trivially_copyable<O>::value &&
+                                          sizeof(C_ELEM) == D * sizeof(C_RES) && sizeof(O) == D * sizeof(C_RES)>::type,
+    /* condition: size() gives the number of elements */
+    typename C2 = decltype(static_cast<size_t>((*(T*)nullptr).size()))>
+
+std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<8>, const T& inputData) {
+  size_t dataSize = inputData.size();
+  std::vector<O> dataOut(dataSize);
+  if (dataSize > 0) {
+    std::memcpy(&dataOut[0], inputData.data(), dataSize * sizeof(O));
   }
   return dataOut;
 }
@@ -603,11 +703,11 @@ template <class O, unsigned int D, class T,
 std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<7>, const T& inputData) {
   size_t dataSize = adaptorF_size(inputData);
   std::vector<O> dataOut(dataSize);
-  for (size_t i = 0; i < dataSize; i++) {
+  adaptorF_forEachElement(dataSize, [&](size_t i) {
     for (size_t j = 0; j < D; j++) {
       dataOut[i][j] = inputData(i, j);
     }
-  }
+  });
   return dataOut;
 }
 
@@ -622,11 +722,11 @@ template <class O, unsigned int D, class T,
 std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<6>, const T& inputData) {
   size_t dataSize = adaptorF_size(inputData);
   std::vector<O> dataOut(dataSize);
-  for (size_t i = 0; i < dataSize; i++) {
+  adaptorF_forEachElement(dataSize, [&](size_t i) {
     for (size_t j = 0; j < D; j++) {
       dataOut[i][j] = inputData[i][j];
     }
-  }
+  });
   return dataOut;
 }
 
@@ -647,11 +747,11 @@ template <class O, unsigned int D, class T,
 std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<5>, const T& inputData) {
   size_t dataSize = adaptorF_size(inputData);
   std::vector<O> dataOut(dataSize);
-  for (size_t i = 0; i < dataSize; i++) {
+  adaptorF_forEachElement(dataSize, [&](size_t i) {
     dataOut[i][0] = adaptorF_accessVector3Value<C_RES, 0>(inputData[i]);
     dataOut[i][1] = adaptorF_accessVector3Value<C_RES, 1>(inputData[i]);
     dataOut[i][2] = adaptorF_accessVector3Value<C_RES, 2>(inputData[i]);
-  }
+  });
   return dataOut;
 }
 
@@ -671,10 +771,10 @@ template <class O, unsigned int D, class T,
 std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<4>, const T& inputData) {
   size_t dataSize = adaptorF_size(inputData);
   std::vector<O> dataOut(dataSize);
-  for (size_t i = 0; i < dataSize; i++) {
+  adaptorF_forEachElement(dataSize, [&](size_t i) {
     dataOut[i][0] = adaptorF_accessVector2Value<C_RES, 0>(inputData[i]);
     dataOut[i][1] = adaptorF_accessVector2Value<C_RES, 1>(inputData[i]);
-  }
+  });
   return dataOut;
 }
 
@@ -775,7 +875,7 @@ std::vector<O> adaptorF_convertArrayOfVectorToStdVectorImpl(PreferenceT<0>, cons
 // General version, which will attempt to substitute in to the variants above
 template <class O, unsigned int D, class T>
 std::vector<O> adaptorF_convertArrayOfVectorToStdVector(const T& inputData) {
-  return adaptorF_convertArrayOfVectorToStdVectorImpl<O, D, T>(PreferenceT<8>{}, inputData);
+  return adaptorF_convertArrayOfVectorToStdVectorImpl<O, D, T>(PreferenceT<10>{}, inputData);
 }
 
 
@@ -795,6 +895,7 @@ std::vector<O> adaptorF_convertArrayOfVectorToStdVector(const T& inputData) {
 //
 //
 // The following hierarchy of strategies will be attempted, with decreasing precedence:
+//   - memory-mapped files (MappedArray), one inner array per row
 //   - any user defined function
 //          std::vector<std::vector<S>> adaptorF_custom_convertNestedArrayToStdVector(const YOUR_TYPE& inputData);
 //   - dense callable (parenthesis) access (like T(i,j)), on a type that supports .rows() and .cols()
@@ -809,7 +910,30 @@ inline void adaptorF_custom_convertNestedArrayToStdVector(void* dont_use) {
   // dummy function
 }
 
-// Highest priority: user-specified function
+// Highest priority: memory-mapped files, converted straight from the mapped pages
+template <class S, class T,
+    /* condition: input is a MappedArray */
+    typename C1 = typename std::enable_if<std::is_same<T, MappedArray>::value>::type>
+
+std::vector<std::vector<S>> adaptorF_convertNestedArrayToStdVectorImpl(PreferenceT<6>, const T& inputData) {
+
+  size_t outerSize = inputData.rows();
+  size_t innerSize = inputData.cols();
+  std::vector<S> flat(outerSize * innerSize);
+  if (!flat.empty()) {
+    inputData.copyTo(&flat[0]);
+  }
+
+  std::vector<std::vector<S>> dataOut(outerSize);
+  for (size_t i = 0; i < outerSize; i++) {
+    dataOut[i].assign(flat.begin() + i * innerSize, flat.begin() + (i + 1) * innerSize);
+  }
+
+  return dataOut;
+}
+
+
+// Next: user-specified function
 template <class S, class T,
     /* condition: user function must be return a nested std::vector of S */
     typename C1 = typename std::enable_if<std::is_same<
@@ -953,7 +1077,7 @@ std::vector<std::vector<S>> adaptorF_convertNestedArrayToStdVector(PreferenceT<0
 // General version, which will attempt to substitute in to the variants above
 template <class S, class T>
 std::vector<std::vector<S>> adaptorF_convertNestedArrayToStdVector(const T& inputData) {
-  return adaptorF_convertNestedArrayToStdVectorImpl<S, T>(PreferenceT<5>{}, inputData);
+  return adaptorF_convertNestedArrayToStdVectorImpl<S, T>(PreferenceT<6>{}, inputData);
 }
 
 // clang-format on
@@ -1,21 +1,26 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #pragma once
 
+#include "polyscope/handle.h"
 #include "polyscope/persistent_value.h"
 #include "polyscope/quantity.h"
 #include "polyscope/render/engine.h"
+#include "polyscope/session_capture.h"
 #include "polyscope/transformation_gizmo.h"
 
 #include "glm/glm.hpp"
 
+#include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 
 namespace polyscope {
 
+class Group;
 
 // A 'structure' in Polyscope terms, is an object with which we can associate data in the UI, such as a point cloud,
 // or a mesh. This in contrast to 'quantities', which we associate with the structures. For instance, a surface mesh
@@ -27,6 +32,13 @@ namespace polyscope {
 // user to utilize and access custom structures with little code.
 
 
+// A disabled quantity which still holds render data, as seen by the GPU residency policy in polyscope.cpp
+struct IdleQuantity {
+  size_t gpuBytes;
+  double disabledSince;          // seconds, on the same clock as the `now` passed to collectIdleQuantities()
+  std::function<void()> release; // frees the render data
+};
+
 class Structure {
 
 public:
@@ -48,10 +60,16 @@ public:
   virtual void buildQuantitiesUI();       // build quantities, if they exist. Overridden by QuantityStructure.
   virtual void buildSharedStructureUI();  // Draw any UI elements shared between all instances of the structure
   virtual void buildPickUI(size_t localPickID) = 0; // Draw pick UI elements when index localPickID is selected
+  bool uiTreeOpen = false; // whether buildUI() last showed the structure's tree node open
 
   // = Identifying data
   const std::string name; // should be unique amongst registered structures with this type
   std::string uniquePrefix();
+  const std::string& profilingName(); // "<type> <name>", the name of its timed regions (built once)
+
+  // = Handles (see Handle)
+  typedef Structure HandleBase;
+  const internal::HandleID handleID;
 
   // = Length and bounding box
   // (returned in world coordinates, after the object transform is applied)
@@ -75,9 +93,63 @@ public:
   void setStructureUniforms(render::ShaderProgram& p);
   bool wantsCullPosition();
 
+  // Structures of a type are drawn sorted by this key, so that those drawing with the same programs, textures (e.g. the
+  // same material), and depth/blend/cull state come one after another and skip re-binding them
+  virtual std::string drawBatchKey();
+
+  // Whether the structure draws in the depth prepass of options::impostorDepthPrepass, i.e. it is made of ray-cast
+  // impostors whose shading is worth skipping where they are hidden
+  virtual bool drawsInDepthPrepass();
+
+  // False if the structure is certainly outside the current view frustum (see options::enableFrustumCulling), in which
+  // case drawing it is skipped. clipRegion maps a part of clip space to all of it, to test against only a part of the
+  // screen instead, such as the few pixels rendered for a pick query.
+  bool isInViewFrustum(const glm::mat4& clipRegion = glm::mat4(1.));
+
+  // True if the last finished occlusion test found the structure entirely hidden behind others (see
+  // options::enableOcclusionCulling), in which case drawing it is skipped.
+  bool isOccluded();
+  // Draw the structure's bounding box against the current depth buffer in an occlusion query. The result is read back
+  // by a later call, once available, so isOccluded() lags the view by a frame or so.
+  void testOcclusion();
+  // Read back the last test if it has finished, without starting another. Called every iteration of the main loop, so
+  // that a structure which comes in to view is drawn even when nothing else asks for a redraw.
+  void collectOcclusionTest();
+  bool hasOutstandingOcclusionTest(); // while hidden by an earlier test, with a newer one still in flight
+  void resetOcclusion(); // forget any test, and draw the structure again
+
+  // == Groups
+  Group* getParentGroup() { return parentGroup; } // the group containing the structure, if any (see Group)
+  bool isVisibleInGroups(); // not inside a disabled group
+  void boundsChanged();     // the world-space bounds changed, which the containing groups cache
+
+  // Pick on the CPU, without rendering the pick buffer (see options::cpuPicking): the element first hit by the world
+  // space ray rayStart + t * rayDir, or the element closest to a world space point, as the local pick index drawPick()
+  // would give it. Returns false for structures which do not support it, or when nothing is hit.
+  bool rayCastElement(glm::vec3 rayStart, glm::vec3 rayDir, float& tHit, size_t& localPickInd);
+  bool closestElement(glm::vec3 point, float& dist, size_t& localPickInd);
+
   // Re-perform any setup work, including refreshing all quantities
   virtual void refresh();
 
+  // Redraw after the structure's appearance changes. Unlike polyscope::requestRedraw(), this also re-renders the cached
+  // static layer if the structure is in it.
+  void requestRedraw();
+  void invalidateStaticLayer(); // just the static layer part of requestRedraw(), if the structure is in it
+
+  // = GPU residency
+  virtual size_t getGPUMemoryUsage(); // device bytes held by the structure, including its quantities
+
+  // = Memory accounting
+  virtual MemoryUsage memoryUsage(); // everything held by the structure, including its quantities
+  virtual size_t hostMemoryUsage();  // CPU-side arrays of the structure itself (not its quantities)
+
+  // Append disabled quantities holding render data to `idle`, and note when each was first seen disabled
+  virtual void collectIdleQuantities(double now, std::vector<IdleQuantity>& idle);
+
+  // Buffers allocated while drawing the structure are charged here (quantities have their own accounts)
+  std::shared_ptr<render::GPUMemoryAccount> gpuMemory;
+
   // Get rid of it (invalidates the object and all pointers, etc!)
   void remove();
 
@@ -97,6 +169,12 @@ public:
   Structure* setIgnoreSlicePlane(std::string name, bool newValue);
   bool getIgnoreSlicePlane(std::string name);
 
+  // Structures with the static hint are rendered once in to a cached layer of color and depth, which is reused until
+  // the camera, their transforms or the structures themselves change. Other structures are drawn on top each frame.
+  // Use it for large structures which stay fixed while others are animated. Only has effect without transparency.
+  Structure* setStaticHint(bool newVal);
+  bool getStaticHint();
+
 protected:
   // = State
   PersistentValue<bool> enabled;
@@ -112,6 +190,8 @@ protected:
 
   PersistentValue<std::vector<std::string>> ignoredSlicePlaneNames;
 
+  PersistentValue<bool> staticHint;
+
   // Manage the bounding box & length scale
   // (this is defined _before_ the object transform is applied. To get the scale/bounding box after transforms, use the
   // boundingBox() and lengthScale() member function)
@@ -119,6 +199,26 @@ protected:
   std::tuple<glm::vec3, glm::vec3> objectSpaceBoundingBox;
   float objectSpaceLengthScale;
   virtual void updateObjectSpaceBounds() = 0;
+
+  // The world-space bounding box, padded to cover glyphs which extend past it, which culling tests against
+  std::tuple<glm::vec3, glm::vec3> cullingBoundingBox();
+
+  // Occlusion culling state
+  bool occluded = false;
+  bool occlusionTestPending = false;
+  std::shared_ptr<render::OcclusionQuery> occlusionQuery;
+
+  std::string profilingNameCache; // see profilingName()
+
+  // The group containing the structure, managed by the group
+  Group* parentGroup = nullptr;
+  friend class Group;
+
+  // The CPU picking queries, in object space. Radii drawn in world units are divided by objectScale, and distances
+  // are returned in object units. Scaling is taken to be uniform.
+  virtual bool rayCastElementObjectSpace(glm::vec3 rayStart, glm::vec3 rayDir, float objectScale, float& tHit,
+                                         size_t& localPickInd);
+  virtual bool closestElementObjectSpace(glm::vec3 point, float objectScale, float& dist, size_t& localPickInd);
 };
 
 
@@ -148,6 +248,10 @@ public:
   // Re-perform any setup work, including refreshing all quantities
   virtual void refresh() override;
 
+  virtual size_t getGPUMemoryUsage() override;
+  virtual MemoryUsage memoryUsage() override;
+  virtual void collectIdleQuantities(double now, std::vector<IdleQuantity>& idle) override;
+
   // = Manage quantities
 
   // Note: takes ownership of pointer after it is passed in
@@ -162,11 +266,21 @@ public:
 
   void setAllQuantitiesEnabled(bool newEnabled);
 
+  // The enabled quantities, in the order of `quantities`, which is the order they are drawn in. Drawing walks just
+  // these rather than every quantity; the list is rebuilt after Quantity::setEnabled() or adding or removing quantities.
+  const std::vector<QuantityType*>& getEnabledQuantities();
+  void enabledQuantitiesChanged() { enabledQuantitiesValid = false; }
+
   // = Quantities
   std::map<std::string, std::unique_ptr<QuantityType>> quantities;
   Quantity<S>* dominantQuantity = nullptr; // If non-null, a special quantity of which only one can be drawn for
                                            // the structure. Handles common case of a surface color, e.g. color of
                                            // a mesh or point cloud. The dominant quantity must always be enabled.
+
+private:
+  std::vector<QuantityType*> rowQuantities; // scratch for buildQuantitiesUI(), kept to save allocating each frame
+  std::vector<QuantityType*> enabledQuantities;
+  bool enabledQuantitiesValid = false;
 };
 
 
@@ -1,4 +1,5 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/internal.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/structure.h"
 
@@ -34,11 +35,14 @@ void QuantityStructure<S>::addQuantity(QuantityType* q, bool allowReplacement) {
 
   // Add the new quantity
   quantities[q->name] = std::unique_ptr<QuantityType>(q);
+  enabledQuantitiesChanged();
 
   // Re-enable the quantity if we're replacing an enabled quantity
   if (existingQuantityWasEnabled) {
     q->setEnabled(true);
   }
+
+  if (detail::sessionCaptureActive) detail::captureAddedQuantity(*this, q->name);
 }
 
 
@@ -58,6 +62,42 @@ void QuantityStructure<S>::refresh() {
   requestRedraw();
 }
 
+template <typename S>
+size_t QuantityStructure<S>::getGPUMemoryUsage() {
+  size_t bytes = Structure::getGPUMemoryUsage();
+  for (auto& qp : quantities) {
+    bytes += qp.second->getGPUMemoryUsage();
+  }
+  return bytes;
+}
+
+template <typename S>
+MemoryUsage QuantityStructure<S>::memoryUsage() {
+  MemoryUsage usage = Structure::memoryUsage();
+  for (auto& qp : quantities) {
+    usage += qp.second->memoryUsage();
+  }
+  return usage;
+}
+
+template <typename S>
+void QuantityStructure<S>::collectIdleQuantities(double now, std::vector<IdleQuantity>& idle) {
+  for (auto& qp : quantities) {
+    QuantityType* q = qp.second.get();
+    if (q->isEnabled() && isEnabled()) {
+      q->disabledSince = -1.;
+      continue;
+    }
+    if (q->disabledSince < 0.) {
+      q->disabledSince = now;
+    }
+    size_t bytes = q->getGPUMemoryUsage();
+    if (bytes > 0) {
+      idle.push_back(IdleQuantity{bytes, q->disabledSince, [q]() { q->releaseRenderData(); }});
+    }
+  }
+}
+
 template <typename S>
 void QuantityStructure<S>::removeQuantity(std::string name) {
   if (quantities.find(name) == quantities.end()) {
@@ -72,6 +112,9 @@ void QuantityStructure<S>::removeQuantity(std::string name) {
 
   // Delete the quantity
   quantities.erase(name);
+  enabledQuantitiesChanged();
+
+  if (detail::sessionCaptureActive) detail::captureRemovedQuantity(*this, name);
 }
 
 template <typename S>
@@ -115,12 +158,28 @@ void QuantityStructure<S>::setAllQuantitiesEnabled(bool newEnabled) {
 }
 
 
+template <typename S>
+const std::vector<typename QuantityStructure<S>::QuantityType*>& QuantityStructure<S>::getEnabledQuantities() {
+  if (!enabledQuantitiesValid) {
+    enabledQuantities.clear();
+    for (auto& x : quantities) {
+      if (x.second->isEnabled()) enabledQuantities.push_back(x.second.get());
+    }
+    enabledQuantitiesValid = true;
+  }
+  return enabledQuantities;
+}
+
 template <typename S>
 void QuantityStructure<S>::buildQuantitiesUI() {
-  // Build the quantities
+  // Build the quantities, only those in view when there are many
+  rowQuantities.clear();
   for (auto& x : quantities) {
-    x.second->buildUI();
+    rowQuantities.push_back(x.second.get());
   }
+  internal::buildTreeNodeRows(
+      rowQuantities.size(), [&](size_t i) { return rowQuantities[i]->uiTreeOpen; },
+      [&](size_t i) { rowQuantities[i]->buildUI(); });
 }
 
 template <typename S>
@@ -19,6 +19,8 @@ public:
   virtual std::string niceName() override;
 
   virtual void refresh() override;
+  virtual void dataUpdated() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) override;
 
 protected:
   // UI internals
@@ -27,6 +29,7 @@ protected:
 
   // Helpers
   virtual void createProgram() = 0;
+  virtual void fillColorBuffers(render::ShaderProgram& p) = 0; // the color buffers, also rewritten by dataUpdated()
 };
 
 // ========================================================
@@ -38,10 +41,16 @@ public:
   SurfaceVertexColorQuantity(std::string name, std::vector<glm::vec3> values_, SurfaceMesh& mesh_);
 
   virtual void createProgram() override;
-  void fillColorBuffers(render::ShaderProgram& p);
+  virtual bool topologyChanged() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual void fillColorBuffers(render::ShaderProgram& p) override;
 
   void buildVertexInfoGUI(size_t vInd) override;
 
+  // Replace the colors, which must be as many as before. The program is kept and its color buffer rewritten.
+  template <class T>
+  SurfaceVertexColorQuantity* updateData(const T& newColors);
+
   // === Members
   std::vector<glm::vec3> values;
 };
@@ -55,12 +64,41 @@ public:
   SurfaceFaceColorQuantity(std::string name, std::vector<glm::vec3> values_, SurfaceMesh& mesh_);
 
   virtual void createProgram() override;
-  void fillColorBuffers(render::ShaderProgram& p);
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+  virtual bool topologyChanged() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual void fillColorBuffers(render::ShaderProgram& p) override;
 
   void buildFaceInfoGUI(size_t fInd) override;
 
+  // Replace the colors, which must be as many as before. The program is kept and its colors written again.
+  template <class T>
+  SurfaceFaceColorQuantity* updateData(const T& newColors);
+
   // === Members
   std::vector<glm::vec3> values;
+
+private:
+  std::shared_ptr<render::TextureBuffer> faceColorTexture; // see SurfaceMesh::setFaceTextureUniforms()
 };
 
+template <class T>
+SurfaceVertexColorQuantity* SurfaceVertexColorQuantity::updateData(const T& newColors) {
+  validateSize(newColors, values.size(), "surface vertex color quantity " + name);
+  values = standardizeVectorArray<glm::vec3, 3>(newColors);
+  dataUpdated();
+  requestRedraw();
+  return this;
+}
+
+template <class T>
+SurfaceFaceColorQuantity* SurfaceFaceColorQuantity::updateData(const T& newColors) {
+  validateSize(newColors, values.size(), "surface face color quantity " + name);
+  values = standardizeVectorArray<glm::vec3, 3>(newColors);
+  dataUpdated();
+  requestRedraw();
+  return this;
+}
+
 } // namespace polyscope
@@ -4,7 +4,8 @@
 #include "polyscope/affine_remapper.h"
 #include "polyscope/surface_mesh.h"
 
-#include <map>
+#include <utility>
+#include <vector>
 
 namespace polyscope {
 
@@ -13,6 +14,7 @@ public:
   SurfaceCountQuantity(std::string name, SurfaceMesh& mesh_, std::string descriptiveType_);
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
   virtual std::string niceName() override;
   virtual void refresh() override;
@@ -60,7 +62,7 @@ public:
   void buildVertexInfoGUI(size_t vInd) override;
 
   // === Members
-  std::map<size_t, int> values;
+  std::vector<std::pair<size_t, int>> values; // sorted by index
 };
 
 
@@ -76,7 +78,7 @@ public:
   void buildVertexInfoGUI(size_t vInd) override;
 
   // === Members
-  std::map<size_t, double> values;
+  std::vector<std::pair<size_t, double>> values; // sorted by index
 };
 
 // ========================================================
@@ -90,7 +92,7 @@ public:
   void buildFaceInfoGUI(size_t f) override;
 
   // === Members
-  std::map<size_t, int> values;
+  std::vector<std::pair<size_t, int>> values; // sorted by index
 };
 
 } // namespace polyscope
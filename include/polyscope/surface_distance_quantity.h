@@ -13,9 +13,11 @@ public:
 
   void draw() override;
   virtual void buildCustomUI() override;
+  virtual size_t hostMemoryUsage() override;
 
   virtual std::string niceName() override;
   virtual void refresh() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) override;
 
   void buildVertexInfoGUI(size_t v) override;
 
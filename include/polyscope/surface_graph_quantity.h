@@ -13,9 +13,11 @@ public:
                        SurfaceMesh& mesh_);
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
   virtual std::string niceName() override;
   virtual void refresh() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) override;
 
   std::vector<glm::vec3> nodes;
   std::vector<std::array<size_t, 2>> edges;
@@ -32,7 +34,10 @@ private:
   PersistentValue<ScaledValue<float>> radius;
   PersistentValue<glm::vec3> color;
 
-  std::shared_ptr<render::ShaderProgram> pointProgram;
+  // The edges are drawn as capsules (cylinders with rounded ends, which cover the nodes) indexing in to one buffer of
+  // node positions; spheres are only drawn, from the same buffer, if some nodes are on no edge
+  std::shared_ptr<render::AttributeBuffer> nodeBuffer;
+  std::shared_ptr<render::ShaderProgram> pointProgram; // (null if every node is on an edge)
   std::shared_ptr<render::ShaderProgram> lineProgram;
 
   void createPrograms();
@@ -1,15 +1,23 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
 
 #include "polyscope/affine_remapper.h"
 #include "polyscope/color_management.h"
+#include "polyscope/dirty_ranges.h"
+#include "polyscope/element_bvh.h"
+#include "polyscope/parallel.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/render/engine.h"
+#include "polyscope/shared_vertex_positions.h"
 #include "polyscope/standardize_data_array.h"
 #include "polyscope/structure.h"
+#include "polyscope/surface_mesh_lod.h"
 #include "polyscope/surface_mesh_quantity.h"
 #include "polyscope/types.h"
 
@@ -22,7 +30,7 @@
 #include "polyscope/surface_parameterization_quantity.h"
 #include "polyscope/surface_scalar_quantity.h"
 #include "polyscope/surface_vector_quantity.h"
-//#include "polyscope/surface_selection_quantity.h"
+#include "polyscope/surface_selection_quantity.h"
 //#include "polyscope/surface_subset_quantity.h"
 
 
@@ -46,7 +54,11 @@ class SurfaceOneFormIntrinsicVectorQuantity;
 class SurfaceVertexCountQuantity;
 class SurfaceVertexIsolatedScalarQuantity;
 class SurfaceFaceCountQuantity;
+class SurfaceVertexSparseScalarQuantity;
+class SurfaceFaceSparseScalarQuantity;
 class SurfaceGraphQuantity;
+class SurfaceVertexSelectionQuantity;
+class SurfaceFaceSelectionQuantity;
 
 
 template <> // Specialize the quantity type
@@ -67,6 +79,33 @@ public:
   SurfaceMesh(std::string name, const std::vector<glm::vec3>& vertexPositions,
               const std::vector<std::vector<size_t>>& faceIndices);
 
+  // Construct from flat face arrays (see faceIndsEntries below); faceIndsStart may be empty for a triangle mesh
+  SurfaceMesh(std::string name, const std::vector<glm::vec3>& vertexPositions, std::vector<uint32_t> faceIndsEntries,
+              std::vector<size_t> faceIndsStart);
+
+  // Construct on positions shared with other structures (see SharedVertexPositions). Vertices which no face uses are
+  // fine, so that each mesh can be a subset of the faces over the same array.
+  SurfaceMesh(std::string name, std::shared_ptr<SharedVertexPositions> sharedPositions,
+              const std::vector<std::vector<size_t>>& faceIndices);
+  ~SurfaceMesh();
+
+  // The arrays computeCounts() and computeGeometryData() derive from the mesh. A mesh can be constructed with a saved
+  // copy of them (as saveScene() does), which skips computing them again; they are only checked for size.
+  struct DerivedData {
+    std::vector<uint32_t> halfedgeEdgeIndices;
+    std::vector<char> halfedgeDefinesEdge;
+    std::vector<size_t> vertexFaceStart;
+    std::vector<uint32_t> vertexFaces;
+    std::vector<glm::vec3> faceNormals;
+    std::vector<glm::vec3> vertexNormals;
+    std::vector<double> faceAreas;
+    std::vector<double> vertexAreas;
+    std::vector<double> edgeLengths;
+  };
+  SurfaceMesh(std::string name, const std::vector<glm::vec3>& vertexPositions, std::vector<uint32_t> faceIndsEntries,
+              std::vector<size_t> faceIndsStart, DerivedData derived);
+  DerivedData getDerivedData() const; // (a copy)
+
   // Build the imgui display
   virtual void buildCustomUI() override;
   virtual void buildCustomOptionsUI() override;
@@ -80,6 +119,7 @@ public:
 
   virtual void updateObjectSpaceBounds() override;
   virtual std::string typeName() override;
+  virtual size_t hostMemoryUsage() override;
 
   virtual void refresh() override;
 
@@ -122,6 +162,11 @@ public:
   values); 
 	SurfaceVertexIsolatedScalarQuantity* addVertexIsolatedScalarQuantity(std::string name, const std::vector<std::pair<size_t, double>>& values);
 
+  // = Scalars on only some of the vertices or faces (expect index/value pairs), drawn on the surface like dense scalars
+  // but stored with memory proportional to the number of values (see SurfaceSparseScalarQuantity)
+  SurfaceVertexSparseScalarQuantity* addVertexSparseScalarQuantity(std::string name, const std::vector<std::pair<size_t, double>>& values, DataType type = DataType::STANDARD);
+  SurfaceFaceSparseScalarQuantity* addFaceSparseScalarQuantity(std::string name, const std::vector<std::pair<size_t, double>>& values, DataType type = DataType::STANDARD);
+
   // = Subsets (expect char array)
   // template <class T>
   // void addEdgeSubsetQuantity(std::string name, const T& subset);
@@ -138,9 +183,11 @@ public:
   template <class P>
   SurfaceGraphQuantity* addSurfaceGraphQuantity2D(std::string name, const std::vector<P>& paths);
 
-  // = I/O Selections
+  // = I/O Selections (expect char array, nonzero if selected)
+  template <class T>
+  SurfaceVertexSelectionQuantity* addVertexSelectionQuantity(std::string name, const T& initialMembership);
   template <class T>
-  void addVertexSelectionQuantity(std::string name, const T& initialMembership);
+  SurfaceFaceSelectionQuantity* addFaceSelectionQuantity(std::string name, const T& initialMembership);
   // void addInputCurveQuantity(std::string name);
 
   // clang-format on
@@ -150,12 +197,34 @@ public:
   long long int selectVertex();
   // size_t selectFace();
 
+  // The element (and its index) which a local pick index of this mesh refers to
+  std::pair<MeshElement, size_t> pickIndexToElement(size_t localPickInd);
+
   // === Mutate
   template <class V>
   void updateVertexPositions(const V& newPositions);
   template <class V>
   void updateVertexPositions2D(const V& newPositions2D);
 
+  // Move only some vertices, newPositions[i] is the new position of vertex indices[i]. Only the geometry near those
+  // vertices is recomputed, and only the affected spans of the buffers are uploaded (once per frame, however many
+  // updates there were).
+  template <class V>
+  void updateVertexPositions(const std::vector<size_t>& indices, const V& newPositions);
+
+  // Replace the connectivity (and the vertices, which may be more or fewer than before), e.g. after remeshing, keeping
+  // the mesh's options, its pick range and the quantities which can follow. Counts and derived data are recomputed in
+  // place; the buffers are refilled on the next draw, from the programs cached by the engine. Vertex and face scalar
+  // and color quantities are kept, holding zeros until their updateData() is called with values for the new elements,
+  // and the other quantities are removed. Permutations and tangent spaces are cleared. Not possible for meshes which
+  // share their positions.
+  template <class V, class F>
+  void updateTopology(const V& newVertexPositions, const F& newFaceIndices);
+
+  // The positions this mesh shares with other structures, or nullptr. Moving the vertices of such a mesh moves them
+  // for all of those structures.
+  std::shared_ptr<SharedVertexPositions> getSharedPositions() { return sharedPositions; }
+
 
   // === Indexing conventions
 
@@ -187,6 +256,16 @@ public:
   size_t halfedgeDataSize;
   size_t cornerDataSize;
 
+  // Inverses of the permutations (see invertPermutation()), translating user indices to mesh elements, e.g. for the
+  // quantities which take sparse (index, value) data. Built on first use; the setters above reset them, call
+  // resetPermutationInverses() after assigning the arrays directly.
+  const std::vector<size_t>& getVertexPermInverse();
+  const std::vector<size_t>& getFacePermInverse();
+  const std::vector<size_t>& getEdgePermInverse();
+  const std::vector<size_t>& getHalfedgePermInverse();
+  const std::vector<size_t>& getCornerPermInverse();
+  void resetPermutationInverses();
+
 
   // === Helpers
   void setShadeStyle(ShadeStyle newShadeStyle);
@@ -194,20 +273,80 @@ public:
 
   // === Manage the mesh itself
 
+  // A read-only view of the indices around one face, as returned by face() and faceEdges()
+  struct IndexView {
+    const uint32_t* data;
+    size_t count;
+    size_t size() const { return count; }
+    size_t operator[](size_t i) const { return data[i]; }
+    size_t back() const { return data[count - 1]; }
+    const uint32_t* begin() const { return data; }
+    const uint32_t* end() const { return data + count; }
+  };
+
   // Core data
   std::vector<glm::vec3> vertices;
-  std::vector<std::vector<size_t>> faces;
+
+  // Faces, stored flat: the vertices of face i are faceIndsEntries[faceIndsStart[i]] ... [faceIndsStart[i+1]-1]. When
+  // every face is a triangle faceIndsStart is left empty, and face i simply starts at 3*i. Corners and halfedges are
+  // numbered by their position in faceIndsEntries. Prefer the accessors to indexing these directly.
+  // Vertex, face and edge indices are 32 bits, while positions in the per-corner arrays are size_t, so that a mesh may
+  // have any number of corners as long as it has fewer than 2^32 of each element.
+  std::vector<uint32_t> faceIndsEntries;
+  std::vector<size_t> faceIndsStart;
+  bool isTriangleMesh() const { return faceIndsStart.empty(); }
+  size_t faceStart(size_t iF) const { return faceIndsStart.empty() ? 3 * iF : faceIndsStart[iF]; }
+  size_t faceDegree(size_t iF) const { return faceIndsStart.empty() ? 3 : faceIndsStart[iF + 1] - faceIndsStart[iF]; }
+  IndexView face(size_t iF) const { return IndexView{faceIndsEntries.data() + faceStart(iF), faceDegree(iF)}; }
 
   // Derived indices
-  std::vector<std::vector<size_t>> edgeIndices;
-  std::vector<std::vector<size_t>> halfedgeIndices;
+  std::vector<uint32_t> halfedgeEdgeIndices; // the edge of each halfedge, laid out like faceIndsEntries
+  std::vector<char> halfedgeDefinesEdge;     // true for the first halfedge seen on each edge
+  IndexView faceEdges(size_t iF) const { return IndexView{halfedgeEdgeIndices.data() + faceStart(iF), faceDegree(iF)}; }
+  size_t halfedgeIndex(size_t iF, size_t j) const { return faceStart(iF) + j; }
+
+  // Faces incident on each vertex, in compressed (CSR) form: the faces around vertex i are
+  // vertexFaces[vertexFaceStart[i]] ... vertexFaces[vertexFaceStart[i+1]-1], in order, one entry per corner.
+  std::vector<size_t> vertexFaceStart;
+  std::vector<uint32_t> vertexFaces;
+
+  // Deprecated, kept for compatibility: read-only lists per face, indexed like the nested vectors which held the faces
+  // before the flat arrays, faces[iF][j], edgeIndices[iF][j] and halfedgeIndices[iF][j], with size() == nFaces(). Use
+  // face(), faceEdges() and halfedgeIndex() instead.
+  struct HalfedgeIndexView {
+    size_t start;
+    size_t count;
+    size_t size() const { return count; }
+    size_t operator[](size_t j) const { return start + j; }
+  };
+  struct FaceList {
+    const SurfaceMesh* mesh;
+    size_t size() const { return mesh->nFaces(); }
+    IndexView operator[](size_t iF) const { return mesh->face(iF); }
+  };
+  struct FaceEdgeList {
+    const SurfaceMesh* mesh;
+    size_t size() const { return mesh->nFaces(); }
+    IndexView operator[](size_t iF) const { return mesh->faceEdges(iF); }
+  };
+  struct FaceHalfedgeList {
+    const SurfaceMesh* mesh;
+    size_t size() const { return mesh->nFaces(); }
+    HalfedgeIndexView operator[](size_t iF) const {
+      return HalfedgeIndexView{mesh->faceStart(iF), mesh->faceDegree(iF)};
+    }
+  };
+  FaceList faces{this};
+  FaceEdgeList edgeIndices{this};
+  FaceHalfedgeList halfedgeIndices{this};
 
   // Counts
   size_t nVertices() const { return vertices.size(); }
-  size_t nFaces() const { return faces.size(); }
+  size_t nFacesCount = 0;
+  size_t nFaces() const { return nFacesCount; }
 
   size_t nFacesTriangulationCount = 0;
-  size_t nFacesTriangulation() const { return faces.size(); }
+  size_t nFacesTriangulation() const { return nFacesCount; }
 
   size_t nEdgesCount = 0;
   size_t nEdges() const { return nEdgesCount; }
@@ -237,6 +376,9 @@ public:
   // = Mesh helpers
   void computeCounts();       // call to populate counts and indices
   void computeGeometryData(); // call to populate normals/areas/lengths
+  void ensureHaveGeometryData(); // recompute them if they are stale, see setGPUNormals()
+  void computeFaceGeometry(size_t iF);   // normal & area of one face, and lengths of the edges it defines
+  void computeVertexGeometry(size_t iV); // normal & area of one vertex, from its faces
   void ensureHaveManifoldConnectivity();
   glm::vec3 faceCenter(size_t iF);
 
@@ -288,6 +430,7 @@ public:
   // Material
   SurfaceMesh* setMaterial(std::string name);
   std::string getMaterial();
+  virtual std::string drawBatchKey() override;
 
   // Backface color
   SurfaceMesh* setBackFaceColor(glm::vec3 val);
@@ -302,12 +445,73 @@ public:
   SurfaceMesh* setBackFacePolicy(BackFacePolicy newPolicy);
   BackFacePolicy getBackFacePolicy();
 
+  // Level of detail: draw a simplified version of the mesh, chosen for the view from a cascade which is built on the
+  // first draw (see SurfaceMeshLOD). Quantities are drawn on the same simplified faces; picking uses the full mesh.
+  SurfaceMesh* setLODEnabled(bool newVal);
+  bool getLODEnabled();
+  SurfaceMesh* setLODMaxPixelError(float newVal); // how far a simplified vertex may be drawn from its true position
+  float getLODMaxPixelError();
+  size_t nDrawnFaces(); // the number of faces in the buffers: all of them, or those of the current level
+
+  // Shade with normals computed on the GPU, per triangle from the drawn positions, so that moving the vertices uploads
+  // only the new positions. The normals, areas and edge lengths above are then left stale when vertices move, and are
+  // recomputed by the first reader on the CPU (ensureHaveGeometryData()). Shading is always flat in this mode.
+  SurfaceMesh* setGPUNormals(bool newVal);
+  bool getGPUNormals();
+
+  // Keep the derived geometry (the normals, areas and edge lengths above), the CPU picking BVH and the cached permutation
+  // inverses in host memory once the mesh has been drawn. When off, they are freed after each draw and recomputed from
+  // the vertices by the next reader (ensureHaveGeometryData()), e.g. a quantity which needs them, or moving vertices.
+  // Meant for meshes which are only viewed; the vertices, faces and quantity values are always kept. (default: true)
+  SurfaceMesh* setRetainHostData(bool newVal);
+  bool getRetainHostData();
+
   // Rendering helpers used by quantities
   void setSurfaceMeshUniforms(render::ShaderProgram& p);
-  void fillGeometryBuffers(render::ShaderProgram& p);
+  void fillGeometryBuffers(render::ShaderProgram& p); // binds the shared per-corner buffers, see below
+
+  // Calls func(iF, face) for each face which is drawn, in the order of the per-corner buffers. At a simplified level of
+  // detail some faces are skipped and the rest are drawn between other vertices, which `face` lists. Per-corner data
+  // filled through this lines up with fillGeometryBuffers() at any level.
+  template <class F>
+  void forEachDrawnFace(F&& func);
+
+  // Indexed drawing (MESH_INDEXED programs) shares each vertex between its triangles, the fans of forEachDrawnFace().
+  // It is possible while nothing needs values which vary per corner of the mesh itself (see canUseIndexedDrawing()).
+  // Quantities whose values differ between the corners of some vertices (e.g. across UV seams) split those vertices:
+  // drawn vertex i is then mesh vertex splitVertices[i], and `triangles` index the drawn vertices.
+  bool canUseIndexedDrawing();
+  void fillGeometryBuffersIndexed(render::ShaderProgram& p);
+  void fillGeometryBuffersIndexed(render::ShaderProgram& p, const std::vector<uint32_t>& splitVertices,
+                                  std::vector<std::array<unsigned int, 3>>& triangles);
+
+  // With options::transparencySortTriangles, indexed programs draw their triangles back to front (when
+  // wantsDepthSortedTriangles()). The order is worked out once per view for the fans of forEachDrawnFace(), and holds
+  // for any program whose triangles are listed in that order: the mesh's own, and those of its quantities, split
+  // vertices or not. programSortCount records which order p was given (0 for none, as after filling it). fillTriangles
+  // lists the triangles p was filled with, and is only called when p needs reordering; leave it empty for the mesh's
+  // own triangles.
+  bool wantsDepthSortedTriangles();
+  void sortTrianglesByDepth(render::ShaderProgram& p, size_t& programSortCount,
+                            const std::function<void(std::vector<std::array<unsigned int, 3>>&)>& fillTriangles);
+
+  // Face-valued quantities can read their values from a texture per fragment (MESH_PROPAGATE_FACE_*_TEXTURE) instead
+  // of copying them to three corners of every triangle. The texture of each drawn triangle's face is shared by all of
+  // them; indices are stored as floats, so this is only possible up to 2^24 triangles.
+  bool canUseFaceTextures();
+  void setFaceTextureUniforms(render::ShaderProgram& p); // binds t_triangleFace
+  std::shared_ptr<render::TextureBuffer> generateFaceTexture(const std::vector<float>& faceData);
+  std::shared_ptr<render::TextureBuffer> generateFaceTexture(const std::vector<glm::vec3>& faceData);
+
   std::vector<std::string> addSurfaceMeshRules(std::vector<std::string> initRules, bool withMesh = true,
                                                bool withSurfaceShade = true);
 
+  // The vertex positions and face centers on the GPU, for quantities which draw a glyph at each vertex or face (e.g.
+  // vectors), so that all of them bind one copy. Each is created when first requested, and updated in place when the
+  // vertices move.
+  std::shared_ptr<render::AttributeBuffer> getVertexPositionBuffer();
+  std::shared_ptr<render::AttributeBuffer> getFaceCenterBuffer();
+
 private:
   // Visualization settings
   PersistentValue<bool> shadeSmooth;
@@ -317,11 +521,57 @@ private:
   PersistentValue<float> edgeWidth;
   PersistentValue<BackFacePolicy> backFacePolicy;
   PersistentValue<glm::vec3> backFaceColor;
+  PersistentValue<bool> lodEnabled;
+  float lodMaxPixelError = 1.;
+  PersistentValue<bool> gpuNormals;
+  bool geometryDataStale = false; // vertices moved with GPU normals on, and the derived geometry was not recomputed
+  bool retainHostData = true;
+  bool geometryDataReleased = false; // the derived geometry was freed, see setRetainHostData()
+  void releaseHostData();
+  void restoreGeometryData(); // for readers which are fine with stale values, but not with freed ones
+
+  // Cached permutation inverses, empty until requested
+  std::vector<size_t> vertexPermInverse;
+  std::vector<size_t> facePermInverse;
+  std::vector<size_t> edgePermInverse;
+  std::vector<size_t> halfedgePermInverse;
+  std::vector<size_t> cornerPermInverse;
+
+  // Level of detail
+  std::unique_ptr<SurfaceMeshLOD> lodHierarchy; // built on the first draw with LOD enabled, dropped when vertices move
+  size_t lodLevel = 0;                          // the level being drawn, 0 for the full mesh
+  bool lodSelectionValid = false;
+  size_t lodSelectionSceneRender = 0; // state::sceneRenderCount when last checked
+  void updateLODSelection();          // (at most once per frame)
+  void lodLevelChanged();             // drop every buffer which was filled for the old level
+
+  // Cluster culling (see options::meshClusterCullingMinTriangles). Each cluster is a run of whole faces in draw order,
+  // with an object-space box and a cone around the normals of its triangles.
+  struct TriangleCluster {
+    size_t posStart, posEnd; // draw positions of its faces
+    size_t triStart, triEnd; // its triangles in the per-corner buffers
+    glm::vec3 boxMin, boxMax;
+    glm::vec3 coneAxis;
+    float coneSin; // sine of the cone's half angle, > 1 if the normals do not fit in a cone narrower than a half space
+  };
+  std::vector<TriangleCluster> triangleClusters; // built on the first culled draw, dropped when vertices move
+  std::vector<std::pair<size_t, size_t>> visibleClusterElements; // corner ranges of the runs of visible clusters
+  glm::mat4 clusterSelectionMatrix;  // the object-to-clip transform of the selection
+  bool clusterSelectionCullsBack = false;
+  bool clusterSelectionValid = false;
+  bool usesClusterCulling();
+  void buildTriangleClusters();
+  void updateClusterSelection(); // (only when the view changed)
+  void invalidateTriangleClusters();
 
   // Do setup work related to drawing, including allocating openGL data
   void prepare();
   void preparePick();
-  void geometryChanged(); // call whenever geometry changed
+  void geometryChanged(); // call whenever vertex positions changed; the connectivity must be unchanged
+
+  // Shared positions, if any; `vertices` is kept as a copy of them
+  std::shared_ptr<SharedVertexPositions> sharedPositions;
+  void sharedPositionsMoved(const std::vector<size_t>* movedIndices);
 
   // Picking-related
   // Order of indexing: vertices, faces, edges, halfedges
@@ -338,6 +588,51 @@ private:
   // Drawing related things
   std::shared_ptr<render::ShaderProgram> program;
   std::shared_ptr<render::ShaderProgram> pickProgram;
+  render::ShaderUniformHandle baseColorHandle; // in `program`, resolved when it is created
+  bool usingIndexedDrawing = false;            // does `program` draw shared vertices through an index buffer?
+
+  // Per-corner geometry of the triangulation, uploaded once and shared by `program`, `pickProgram`, and the programs
+  // of quantities which draw the surface. Each is created when the first program which needs it is filled. (Barycentric
+  // coordinates need no buffer, the shaders derive them from the corner index.)
+  std::shared_ptr<render::AttributeBuffer> cornerPositions;
+  std::shared_ptr<render::AttributeBuffer> cornerVertexNormals; // for smooth shading
+  std::shared_ptr<render::AttributeBuffer> cornerFaceNormals;   // for flat shading and picking
+  std::shared_ptr<render::AttributeBuffer> cornerEdgeIsReal;
+  std::shared_ptr<render::AttributeBuffer> cornerCullPos;
+  std::shared_ptr<render::TextureBuffer> triangleFaceTexture; // for setFaceTextureUniforms()
+  // Element indices of each triangle, for picking (see preparePick())
+  std::shared_ptr<render::TextureBuffer> pickTriangleVertices, pickTriangleEdges, pickTriangleHalfedges;
+  std::shared_ptr<render::AttributeBuffer> vertexPositionBuffer, faceCenterBuffer; // see getVertexPositionBuffer()
+  std::vector<glm::vec3> faceCenters(size_t faceStart, size_t faceEnd);
+
+  // Large meshes fill the corner buffers on a background thread (see options::backgroundPrepareMinTriangles), and are
+  // not drawn until they are uploaded. The fill reads the geometry, so anything changing it cancels the fill first.
+  struct CornerData;
+  std::unique_ptr<CornerData> cornerFillData;
+  std::unique_ptr<BackgroundTask> cornerFillTask;
+  bool cornerFillPending(); // starts the fill if the mesh is large, uploads it once done; true while it runs
+  void cancelCornerFill();  // wait for a running fill and drop it
+  void fillCornerData(CornerData& data);
+  void uploadCornerData(const CornerData& data);
+
+  // Elements whose geometry changed since the buffers were last uploaded; draw() and drawPick() flush them
+  // The constructors all delegate to this one, which computes the derived data only if asked
+  SurfaceMesh(std::string name, const std::vector<glm::vec3>& vertexPositions, std::vector<uint32_t> faceIndsEntries,
+              std::vector<size_t> faceIndsStart, bool computeDerived);
+
+  DirtyRanges dirtyFaces;    // for the corner buffers
+  DirtyRanges dirtyVertices; // for `program`, when usingIndexedDrawing
+  void flushGeometryUpdates();
+
+  // CPU picking, over the faces fanned in to triangles of (vertex, vertex, vertex, face)
+  std::unique_ptr<ElementBVH> pickBVH; // built on the first query, dropped when vertices move
+  std::vector<std::array<uint32_t, 4>> pickTriangles;
+  virtual bool rayCastElementObjectSpace(glm::vec3 rayStart, glm::vec3 rayDir, float objectScale, float& tHit,
+                                         size_t& localPickInd) override;
+  virtual bool closestElementObjectSpace(glm::vec3 point, float objectScale, float& dist,
+                                         size_t& localPickInd) override;
+  void ensurePickBVH();
+  size_t pickIndexAt(const std::array<uint32_t, 4>& tri, glm::vec3 bary); // a vertex or face, as the pick shader has it
 
 
   // === Helper functions
@@ -347,6 +642,31 @@ private:
 
   void fillGeometryBuffersSmooth(render::ShaderProgram& p);
   void fillGeometryBuffersFlat(render::ShaderProgram& p);
+  void drawnTriangles(std::vector<std::array<unsigned int, 3>>& triangles); // the fans of forEachDrawnFace()
+
+  // The drawn triangles back to front as seen with depthSortModelView (see sortTrianglesByDepth()), as indices in to
+  // drawnTriangles(). Cleared whenever the drawn triangles change or the vertices move; depthSortCount counts the
+  // orders worked out, so programs can tell whether theirs is current.
+  bool depthSortValid = false;
+  glm::mat4 depthSortModelView;
+  std::vector<size_t> depthSortOrder;
+  size_t depthSortCount = 0;
+  size_t programDepthSortCount = 0; // of `program`
+  void ensureCornerBuffers(bool withVertexNormals, bool withFaceNormals, bool withEdgeIsReal, bool withCullPos);
+  void releaseCornerBuffers();
+  void updateCornerBuffers(const std::vector<std::pair<size_t, size_t>>& faceRanges); // rewrite positions & normals
+
+  // With options::reorderForLocality, the full mesh is drawn with its faces along a Morton curve of their centers
+  // rather than in order; the faces and their indices are unchanged. All empty when the faces are drawn in order.
+  std::vector<uint32_t> faceDrawOrder;      // the face drawn at each position
+  std::vector<uint32_t> faceDrawPosition;   // the inverse
+  std::vector<uint32_t> drawnTriangleStart; // the first triangle of the face at each position, and the total
+  void computeFaceDrawOrder();
+  size_t faceInDrawOrder(size_t i) const { return faceDrawOrder.empty() ? i : faceDrawOrder[i]; }
+  void updateVertexPositionsImpl(const std::vector<size_t>& indices, const std::vector<glm::vec3>& newPositions);
+  void updateTopologyImpl(const std::vector<glm::vec3>& newVertexPositions,
+                          const std::vector<std::vector<size_t>>& newFaceIndices);
+  void verticesMoved(const std::vector<size_t>& indices); // recompute and mark the geometry around moved vertices
   glm::vec2 projectToScreenSpace(glm::vec3 coord);
   // bool screenSpaceTriangleTest(size_t fInd, glm::vec2 testCoords, glm::vec3& bCoordOut);
 
@@ -373,7 +693,11 @@ private:
   SurfaceOneFormIntrinsicVectorQuantity* addOneFormIntrinsicVectorQuantityImpl(std::string name, const std::vector<double>& data, const std::vector<char>& orientations);
   SurfaceVertexCountQuantity* addVertexCountQuantityImpl(std::string name, const std::vector<std::pair<size_t, int>>& values);
   SurfaceVertexIsolatedScalarQuantity* addVertexIsolatedScalarQuantityImpl(std::string name, const std::vector<std::pair<size_t, double>>& values);
+  SurfaceVertexSparseScalarQuantity* addVertexSparseScalarQuantityImpl(std::string name, const std::vector<std::pair<size_t, double>>& values, DataType type);
+  SurfaceFaceSparseScalarQuantity* addFaceSparseScalarQuantityImpl(std::string name, const std::vector<std::pair<size_t, double>>& values, DataType type);
   SurfaceFaceCountQuantity* addFaceCountQuantityImpl(std::string name, const std::vector<std::pair<size_t, int>>& values);
+  SurfaceVertexSelectionQuantity* addVertexSelectionQuantityImpl(std::string name, const std::vector<char>& initialMembership);
+  SurfaceFaceSelectionQuantity* addFaceSelectionQuantityImpl(std::string name, const std::vector<char>& initialMembership);
 	SurfaceGraphQuantity* addSurfaceGraphQuantityImpl(std::string name, const std::vector<glm::vec3>& nodes, const std::vector<std::array<size_t, 2>>& edges);
 
   // === Helper implementations
@@ -391,6 +715,9 @@ SurfaceMesh* registerSurfaceMesh2D(std::string name, const V& vertexPositions, c
 template <class V, class F, class P>
 SurfaceMesh* registerSurfaceMesh(std::string name, const V& vertexPositions, const F& faceIndices,
                                  const std::array<std::pair<P, size_t>, 5>& perms);
+template <class F> // on positions shared with other structures, see SharedVertexPositions
+SurfaceMesh* registerSurfaceMesh(std::string name, const std::shared_ptr<SharedVertexPositions>& sharedPositions,
+                                 const F& faceIndices);
 
 
 // Shorthand to get a mesh from polyscope
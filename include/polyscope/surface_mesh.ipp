@@ -48,8 +48,28 @@ SurfaceMesh* registerSurfaceMesh(std::string name, const V& vertexPositions, con
   return s;
 }
 
+template <class F>
+SurfaceMesh* registerSurfaceMesh(std::string name, const std::shared_ptr<SharedVertexPositions>& sharedPositions,
+                                 const F& faceIndices) {
+  checkInitialized();
+
+  SurfaceMesh* s = new SurfaceMesh(name, sharedPositions, standardizeNestedList<size_t, F>(faceIndices));
+  bool success = registerStructure(s);
+  if (!success) {
+    safeDelete(s);
+  }
+
+  return s;
+}
+
 template <class V>
 void SurfaceMesh::updateVertexPositions(const V& newPositions) {
+  validateSize(newPositions, nVertices(), "surface mesh updated vertex positions " + name);
+  if (sharedPositions) {
+    sharedPositions->updateVertexPositions(newPositions); // calls back to update this mesh too
+    return;
+  }
+  cancelCornerFill();
   vertices = standardizeVectorArray<glm::vec3, 3>(newPositions);
 
 
@@ -58,6 +78,19 @@ void SurfaceMesh::updateVertexPositions(const V& newPositions) {
 }
 
 
+template <class V>
+void SurfaceMesh::updateVertexPositions(const std::vector<size_t>& indices, const V& newPositions) {
+  validateSize(newPositions, indices.size(), "surface mesh updated vertex positions " + name);
+
+  updateVertexPositionsImpl(indices, standardizeVectorArray<glm::vec3, 3>(newPositions));
+}
+
+template <class V, class F>
+void SurfaceMesh::updateTopology(const V& newVertexPositions, const F& newFaceIndices) {
+  updateTopologyImpl(standardizeVectorArray<glm::vec3, 3>(newVertexPositions),
+                     standardizeNestedList<size_t, F>(newFaceIndices));
+}
+
 template <class V>
 void SurfaceMesh::updateVertexPositions2D(const V& newPositions2D) {
   std::vector<glm::vec3> positions3D = standardizeVectorArray<glm::vec3, 2>(newPositions2D);
@@ -71,7 +104,7 @@ void SurfaceMesh::updateVertexPositions2D(const V& newPositions2D) {
 
 inline glm::vec3 SurfaceMesh::faceCenter(size_t iF) {
   glm::vec3 faceCenter = glm::vec3{0., 0., 0.};
-  const auto& face = faces[iF];
+  IndexView face = this->face(iF);
   size_t D = face.size();
   for (size_t j = 0; j < D; j++) {
     faceCenter += vertices[face[j]];
@@ -80,6 +113,23 @@ inline glm::vec3 SurfaceMesh::faceCenter(size_t iF) {
   return faceCenter;
 }
 
+template <class F>
+void SurfaceMesh::forEachDrawnFace(F&& func) {
+  if (lodLevel == 0) {
+    for (size_t i = 0; i < nFaces(); i++) {
+      size_t iF = faceInDrawOrder(i);
+      func(iF, face(iF));
+    }
+    return;
+  }
+
+  const SurfaceMeshLOD::Level& level = lodHierarchy->level(lodLevel);
+  for (size_t i = 0; i < level.faces.size(); i++) {
+    size_t start = level.entryStart[i];
+    func(static_cast<size_t>(level.faces[i]), IndexView{level.entries.data() + start, level.entryStart[i + 1] - start});
+  }
+}
+
 // Shorthand to get a mesh from polyscope
 inline SurfaceMesh* getSurfaceMesh(std::string name) {
   return dynamic_cast<SurfaceMesh*>(getStructure(SurfaceMesh::structureTypeName, name));
@@ -116,6 +166,7 @@ void SurfaceMesh::setVertexPermutation(const T& perm, size_t expectedSize) {
 
   validateSize(perm, vertexDataSize, "vertex permutation for " + name);
   vertexPerm = standardizeArray<size_t, T>(perm);
+  vertexPermInverse.clear();
 
   vertexDataSize = expectedSize;
   if (vertexDataSize == 0) {
@@ -131,6 +182,7 @@ void SurfaceMesh::setFacePermutation(const T& perm, size_t expectedSize) {
 
   validateSize(perm, faceDataSize, "face permutation for " + name);
   facePerm = standardizeArray<size_t, T>(perm);
+  facePermInverse.clear();
 
   faceDataSize = expectedSize;
   if (faceDataSize == 0) {
@@ -146,6 +198,7 @@ void SurfaceMesh::setEdgePermutation(const T& perm, size_t expectedSize) {
 
   validateSize(perm, edgeDataSize, "edge permutation for " + name);
   edgePerm = standardizeArray<size_t, T>(perm);
+  edgePermInverse.clear();
 
   edgeDataSize = expectedSize;
   if (edgeDataSize == 0) {
@@ -161,6 +214,7 @@ void SurfaceMesh::setHalfedgePermutation(const T& perm, size_t expectedSize) {
 
   validateSize(perm, halfedgeDataSize, "halfedge permutation for " + name);
   halfedgePerm = standardizeArray<size_t, T>(perm);
+  halfedgePermInverse.clear();
 
   halfedgeDataSize = expectedSize;
   if (halfedgeDataSize == 0) {
@@ -176,6 +230,7 @@ void SurfaceMesh::setCornerPermutation(const T& perm, size_t expectedSize) {
 
   validateSize(perm, cornerDataSize, "corner permutation for " + name);
   cornerPerm = standardizeArray<size_t, T>(perm);
+  cornerPermInverse.clear();
 
   cornerDataSize = expectedSize;
   if (cornerDataSize == 0) {
@@ -284,6 +339,30 @@ SurfaceMesh::addVertexIsolatedScalarQuantity(std::string name, const std::vector
   return addVertexIsolatedScalarQuantityImpl(name, values);
 }
 
+inline SurfaceVertexSparseScalarQuantity*
+SurfaceMesh::addVertexSparseScalarQuantity(std::string name, const std::vector<std::pair<size_t, double>>& values,
+                                           DataType type) {
+  for (auto p : values) {
+    if (p.first >= vertexDataSize) {
+      error("passed index " + std::to_string(p.first) + " to addVertexSparseScalarQuantity [" + name +
+            "] which is greater than the number of vertices");
+    }
+  }
+  return addVertexSparseScalarQuantityImpl(name, values, type);
+}
+
+inline SurfaceFaceSparseScalarQuantity*
+SurfaceMesh::addFaceSparseScalarQuantity(std::string name, const std::vector<std::pair<size_t, double>>& values,
+                                         DataType type) {
+  for (auto p : values) {
+    if (p.first >= faceDataSize) {
+      error("passed index " + std::to_string(p.first) + " to addFaceSparseScalarQuantity [" + name +
+            "] which is greater than the number of faces");
+    }
+  }
+  return addFaceSparseScalarQuantityImpl(name, values, type);
+}
+
 
 inline SurfaceFaceCountQuantity* SurfaceMesh::addFaceCountQuantity(std::string name,
                                                                    const std::vector<std::pair<size_t, int>>& values) {
@@ -357,6 +436,18 @@ SurfaceGraphQuantity* SurfaceMesh::addSurfaceGraphQuantity2D(std::string name, c
 }
 
 
+template <class T>
+SurfaceVertexSelectionQuantity* SurfaceMesh::addVertexSelectionQuantity(std::string name, const T& initialMembership) {
+  validateSize(initialMembership, vertexDataSize, "vertex selection quantity " + name);
+  return addVertexSelectionQuantityImpl(name, standardizeArray<char, T>(initialMembership));
+}
+
+template <class T>
+SurfaceFaceSelectionQuantity* SurfaceMesh::addFaceSelectionQuantity(std::string name, const T& initialMembership) {
+  validateSize(initialMembership, faceDataSize, "face selection quantity " + name);
+  return addFaceSelectionQuantityImpl(name, standardizeArray<char, T>(initialMembership));
+}
+
 template <class T>
 SurfaceVertexScalarQuantity* SurfaceMesh::addVertexScalarQuantity(std::string name, const T& data, DataType type) {
   validateSize(data, vertexDataSize, "vertex scalar quantity " + name);
@@ -3,15 +3,62 @@
 
 #include "polyscope/utilities.h"
 
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
 namespace polyscope {
 
+class SurfaceMesh;
+
 void loadPolygonSoup_OBJ(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
                          std::vector<std::vector<size_t>>& faceIndicesOut);
 
+// As above, but output in the flat face layout of SurfaceMesh (see SurfaceMesh::faceIndsEntries), which skips an
+// allocation per face. faceIndsStartOut always has an entry per face plus one. The file is parsed in parallel.
+void loadPolygonSoup_OBJ(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
+                         std::vector<uint32_t>& faceIndsEntriesOut, std::vector<size_t>& faceIndsStartOut);
+
 void loadPolygonSoup_PLY(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
                          std::vector<std::vector<size_t>>& faceIndicesOut);
 
+// As above, in the flat face layout, and also returning every other scalar vertex property by name (e.g. "red",
+// "green", "blue", "nx", "quality"), ready to add as quantities. Values keep their stored scale, so uchar colors come
+// out in [0, 255]. Binary files are read in place, in parallel for vertices and for triangle-only faces.
+void loadPolygonSoup_PLY(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
+                         std::vector<uint32_t>& faceIndsEntriesOut, std::vector<size_t>& faceIndsStartOut,
+                         std::map<std::string, std::vector<double>>& vertexPropertiesOut);
+
 // Load a mesh from a general file, detecting type from filename
 void loadPolygonSoup(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
                      std::vector<std::vector<size_t>>& faceIndicesOut);
+
+// === Loading many files at once
+
+// A file read by loadPolygonSoups(), in the flat face layout
+struct LoadedPolygonSoup {
+  std::string filename;
+  std::vector<std::array<double, 3>> vertexPositions;
+  std::vector<uint32_t> faceIndsEntries;
+  std::vector<size_t> faceIndsStart;
+  std::string error; // why the file could not be read (the arrays are then empty), or ""
+};
+
+// Read many OBJ and PLY files, for scenes made of many parts. The files are read and parsed on
+// options::meshLoadThreads background threads, so that reading some overlaps parsing others, and each one is passed
+// to onLoaded() on the main thread at the start of the next frame (see queueCommand()), in the order they finish. A
+// file is only started while the files which were read but not yet passed on total at most
+// options::meshLoadMemoryBudget bytes. Returns immediately.
+void loadPolygonSoups(const std::vector<std::string>& filenames, std::function<void(LoadedPolygonSoup&)> onLoaded);
+
+// As above, registering each file as a surface mesh named after the file (without its directory or extension), then
+// calling onRegistered(mesh) if given. Files which fail to load are reported with error().
+void registerSurfaceMeshesFromFiles(const std::vector<std::string>& filenames,
+                                    std::function<void(SurfaceMesh*)> onRegistered = nullptr);
+
+size_t nPolygonSoupsLoading();     // files given to the above which were not yet passed on
+void finishLoadingPolygonSoups(); // block until every file was read and passed on (main thread only)
 } // namespace polyscope
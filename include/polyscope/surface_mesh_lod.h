@@ -0,0 +1,55 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace polyscope {
+
+class SurfaceMesh;
+
+// A cascade of simplified versions of a surface mesh, used by SurfaceMesh::setLODEnabled().
+//
+// Level l + 1 clusters the vertices of level l on a grid whose cells are twice the size of the cells of level l, and
+// moves each of them to one representative vertex of its cluster. The grids are aligned, so every cluster is a union
+// of clusters of the level before. The faces of a level are the faces of the level before which do not collapse, with
+// their corners remapped. The representatives are vertices of the original mesh and every face keeps its original
+// index, so any per-element data of the mesh can be drawn on a level without resampling it in to new arrays.
+class SurfaceMeshLOD {
+public:
+  SurfaceMeshLOD(const SurfaceMesh& mesh);
+
+  struct Level {
+    float cellSize;                   // the size of its grid cells, which bounds how far any vertex moved
+    std::vector<uint32_t> faces;      // the surviving faces, by their index in the original mesh
+    std::vector<uint32_t> entryStart; // the corners of faces[i] are entries[entryStart[i]] ... [entryStart[i+1]-1]
+    std::vector<uint32_t> entries;    // vertex indices, in the original mesh
+    size_t nTriangles = 0;
+  };
+
+  size_t nLevels() const { return levels.size(); } // not counting the original mesh, which is level 0
+  const Level& level(size_t iLevel) const { return levels[iLevel - 1]; }
+
+  // The coarsest level whose vertices move by at most maxPixelError pixels on screen, or 0 for the original mesh.
+  // Chosen for the whole mesh by the part of its bounding box nearest to the camera.
+  size_t selectLevel(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight,
+                     float maxPixelError) const;
+
+  size_t allocatedBytes() const;
+
+  static const size_t minTriangles = 1024; // no level is built past the first with fewer triangles than this
+  static const size_t maxLevels = 16;
+
+private:
+  std::vector<Level> levels;
+  glm::vec3 bboxMin, bboxMax; // of the original vertices
+
+  // Cluster the vertices of `prev` (or of the mesh itself, if null) on a grid of the given cell size. `rep` is scratch
+  // space with an entry per vertex of the mesh.
+  Level buildLevel(const SurfaceMesh& mesh, const Level* prev, float cellSize, std::vector<uint32_t>& rep) const;
+};
+
+} // namespace polyscope
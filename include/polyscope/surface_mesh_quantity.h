@@ -4,6 +4,9 @@
 #include "polyscope/quantity.h"
 #include "polyscope/structure.h"
 
+#include <utility>
+#include <vector>
+
 
 namespace polyscope {
 
@@ -22,6 +25,17 @@ public:
   virtual void buildFaceInfoGUI(size_t fInd);
   virtual void buildEdgeInfoGUI(size_t eInd);
   virtual void buildHalfedgeInfoGUI(size_t heInd);
+
+  // Called when the parent's vertex positions change but its connectivity does not, with the ranges of faces whose
+  // geometry changed. By default the quantity is refreshed. Quantities whose programs were filled with
+  // SurfaceMesh::fillGeometryBuffers() draw from the parent's shared buffers, which are already up to date, and those
+  // which do not depend on positions at all override this.
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges);
+
+  // Called when the parent's connectivity was replaced (see SurfaceMesh::updateTopology()), which already holds the new
+  // elements. Resizes the values to the new element counts, with zeros, or returns false if the quantity can not
+  // follow (the default), and the parent then removes it.
+  virtual bool topologyChanged();
 };
 
 } // namespace polyscope
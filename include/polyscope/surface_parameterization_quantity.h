@@ -26,6 +26,7 @@ public:
   virtual void buildCustomUI() override;
 
   virtual void refresh() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) override;
 
 
   // === Members
@@ -73,11 +74,17 @@ protected:
   PersistentValue<std::string> cMap;
   float localRot = 0.; // for LOCAL (angular shift, in radians)
   std::shared_ptr<render::ShaderProgram> program;
+  bool usingIndexedDrawing = false; // see SurfaceMesh::canUseIndexedDrawing(); the program then has its own positions
+  size_t programDepthSortCount = 0; // see SurfaceMesh::sortTrianglesByDepth()
 
   // Helpers
   void createProgram();
   void setProgramUniforms(render::ShaderProgram& program);
-  virtual void fillColorBuffers(render::ShaderProgram& p) = 0;
+  virtual void fillColorBuffers(render::ShaderProgram& p) = 0;   // per corner of the triangulation
+  virtual void fillIndexedBuffers(render::ShaderProgram& p) = 0; // geometry and coordinates, for MESH_INDEXED
+  // Lists the triangles fillIndexedBuffers() gave the program, for sorting them by depth; empty when they are the
+  // mesh's own (see SurfaceMesh::sortTrianglesByDepth())
+  virtual std::function<void(std::vector<std::array<unsigned int, 3>>&)> indexedTriangleLister() { return nullptr; }
 };
 
 
@@ -92,6 +99,7 @@ public:
                                         ParamVizStyle style, SurfaceMesh& mesh_);
 
   virtual void buildHalfedgeInfoGUI(size_t heInd) override;
+  virtual size_t hostMemoryUsage() override;
   virtual std::string niceName() override;
 
   // === Members
@@ -99,6 +107,10 @@ public:
 
 protected:
   virtual void fillColorBuffers(render::ShaderProgram& p) override;
+  virtual void fillIndexedBuffers(render::ShaderProgram& p) override; // splits vertices along seams
+  virtual std::function<void(std::vector<std::array<unsigned int, 3>>&)> indexedTriangleLister() override;
+  void splitSeamVertices(std::vector<uint32_t>& splitVertices, std::vector<glm::vec2>& splitCoords,
+                         std::vector<std::array<unsigned int, 3>>& triangles);
 };
 
 
@@ -112,6 +124,7 @@ public:
                                         ParamVizStyle style, SurfaceMesh& mesh_);
 
   virtual void buildVertexInfoGUI(size_t vInd) override;
+  virtual size_t hostMemoryUsage() override;
   virtual std::string niceName() override;
 
   // === Members
@@ -119,6 +132,7 @@ public:
 
 protected:
   virtual void fillColorBuffers(render::ShaderProgram& p) override;
+  virtual void fillIndexedBuffers(render::ShaderProgram& p) override;
 };
 
 } // namespace polyscope
@@ -16,9 +16,12 @@ public:
                         DataType dataType);
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
   virtual std::string niceName() override;
   virtual void refresh() override;
+  virtual void dataUpdated() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) override;
 
 protected:
   const std::string definedOn;
@@ -26,6 +29,7 @@ protected:
 
   // Helpers
   virtual void createProgram() = 0;
+  virtual void fillColorBuffers(render::ShaderProgram& p) = 0; // the value buffers, also rewritten by dataUpdated()
 };
 
 // ========================================================
@@ -38,10 +42,57 @@ public:
                               DataType dataType_ = DataType::STANDARD);
 
   virtual void createProgram() override;
+  virtual void draw() override;
+  virtual void buildCustomUI() override;
+  virtual void refresh() override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) override;
+  virtual bool topologyChanged() override;
+  virtual size_t hostMemoryUsage() override;
 
-  void fillColorBuffers(render::ShaderProgram& p);
+  virtual void fillColorBuffers(render::ShaderProgram& p) override;
 
   void buildVertexInfoGUI(size_t vInd) override;
+
+  // === Contours
+  // Isolines of the piecewise-linear scalar function, extracted as actual polylines (unlike the isoline stripes, which
+  // are only shaded in). They are computed on demand, in parallel across the faces, and cached per level: changing the
+  // levels only recomputes those whose value is new.
+
+  // The values to extract contours at
+  SurfaceVertexScalarQuantity* setContourLevels(const std::vector<double>& levels);
+  std::vector<double> getContourLevels();
+  // n evenly spaced levels strictly inside the current map range
+  SurfaceVertexScalarQuantity* setContourLevelCount(size_t n);
+
+  // Draw the contours as lines over the mesh
+  SurfaceVertexScalarQuantity* setContoursEnabled(bool newVal);
+  bool getContoursEnabled();
+  SurfaceVertexScalarQuantity* setContourColor(glm::vec3 newVal);
+  glm::vec3 getContourColor();
+
+  // The contour at the iLevel'th level, in the mesh's object space. getContourSegments() gives pairs of endpoints, one
+  // segment for each face it crosses; getContourPolylines() chains them in to polylines, which are closed (first point
+  // repeated at the end) for loops.
+  std::vector<glm::vec3> getContourSegments(size_t iLevel);
+  std::vector<std::vector<glm::vec3>> getContourPolylines(size_t iLevel);
+
+private:
+  struct ContourLevel {
+    double value;
+    bool valid;                                        // false until extracted, or after the geometry changes
+    std::vector<glm::vec3> segmentPoints;              // two per segment
+    std::vector<std::array<uint32_t, 2>> segmentEdges; // the mesh edge each endpoint lies on
+  };
+
+  std::vector<ContourLevel> contourLevels;
+  PersistentValue<bool> contoursEnabled;
+  PersistentValue<glm::vec3> contourColor;
+  std::shared_ptr<render::ShaderProgram> contourProgram;
+
+  void ensureContoursExtracted();
+  void createContourProgram();
 };
 
 
@@ -55,10 +106,18 @@ public:
                             DataType dataType_ = DataType::STANDARD);
 
   virtual void createProgram() override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+  virtual bool topologyChanged() override;
 
-  void fillColorBuffers(render::ShaderProgram& p);
+  virtual void fillColorBuffers(render::ShaderProgram& p) override;
 
   void buildFaceInfoGUI(size_t fInd) override;
+
+private:
+  // One value per face, read through SurfaceMesh::setFaceTextureUniforms(). It does not depend on the level of detail,
+  // so it is kept when the program is rebuilt.
+  std::shared_ptr<render::TextureBuffer> faceValueTexture;
 };
 
 
@@ -74,7 +133,7 @@ public:
 
   virtual void createProgram() override;
 
-  void fillColorBuffers(render::ShaderProgram& p);
+  virtual void fillColorBuffers(render::ShaderProgram& p) override;
 
   void buildEdgeInfoGUI(size_t edgeInd) override;
 };
@@ -91,7 +150,7 @@ public:
 
   virtual void createProgram() override;
 
-  void fillColorBuffers(render::ShaderProgram& p);
+  virtual void fillColorBuffers(render::ShaderProgram& p) override;
 
   void buildHalfedgeInfoGUI(size_t heInd) override;
 };
@@ -1,127 +1,117 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #pragma once
 
-#include "polyscope/affine_remapper.h"
-#include "polyscope/gl/colormap_sets.h"
-#include "polyscope/histogram.h"
+#include "polyscope/render/engine.h"
 #include "polyscope/surface_mesh.h"
 
+#include <vector>
+
 namespace polyscope {
 
-class SurfaceSelectionQuantity : public SurfaceQuantityThatDrawsFaces {
+// A set of mesh elements, shaded on the surface and edited by painting over the mesh with a screen-space brush.
+// Membership is drawn from an element texture, so an edit uploads only the texture rows holding the changed elements,
+// instead of refilling the per-corner buffers. The brush finds the elements under it through the pick buffer (see
+// pick::queryRegion()), so the CPU copy of the membership is always current and reading it never waits for the GPU.
+class SurfaceSelectionQuantity : public SurfaceMeshQuantity {
 public:
-  SurfaceSelectionQuantity(std::string name, SurfaceMesh* mesh_, std::string definedOn);
+  SurfaceSelectionQuantity(std::string name, SurfaceMesh& mesh_, std::string definedOn,
+                           const std::vector<char>& initialMembership);
 
   virtual void draw() override;
-  virtual void drawUI() override;
-  virtual void userEdit() = 0;
-
-  // === Members
+  virtual void buildCustomUI() override;
+  virtual void refresh() override;
+  virtual std::string niceName() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) override;
+
+  // == Membership, in the mesh's element order (nonzero if selected)
+  const std::vector<char>& getMembership() const { return membership; }
+  bool isSelected(size_t ind) const { return membership[ind] != 0; }
+  void setSelected(size_t ind, bool selected);
+  void setMembership(const std::vector<char>& newMembership);
+  void selectAll();
+  void selectNone();
+
+  // Membership in the user's element order, i.e. with the mesh's permutation (if any) undone
+  std::vector<char> getMembershipData();
+
+  // Paint with the brush at a point on the screen, in the pixel coordinates of pick::evaluatePickQuery(), selecting
+  // (or deselecting) the elements under it. Returns the number of elements which changed.
+  size_t applyBrush(glm::vec2 screenCoords, bool select = true);
+
+  // == Options
+
+  // Editing from the quantity's UI: while painting, ctrl-drag over the mesh applies the brush
   bool allowEditingFromDefaultUI = true;
 
-protected:
-  // UI internals
-  int iColorMap = 0;
-  const std::string definedOn;
-};
+  SurfaceSelectionQuantity* setBrushRadius(float pixels);
+  float getBrushRadius();
 
-// ========================================================
-// ==========           Vertex Selection         ==========
-// ========================================================
+  SurfaceSelectionQuantity* setColorMap(std::string val);
+  std::string getColorMap();
 
-class SurfaceSelectionVertexQuantity : public SurfaceSelectionQuantity {
-public:
-  SurfaceSelectionVertexQuantity(std::string name, SurfaceMesh* mesh_);
-  SurfaceSelectionVertexQuantity(std::string name, std::vector<char>& initialMembership_, SurfaceMesh* mesh_);
-  //   ~SurfaceSelectionVertexQuantity();
-
-  virtual gl::GLProgram* createProgram() override;
-
-  void fillColorBuffers(gl::GLProgram* p);
+protected:
+  const std::string definedOn;
+  std::vector<char> membership;
 
-  void buildVertexInfoGUI(size_t vInd) override;
+  // The elements which the given local pick indices of the mesh select
+  virtual void elementsFromPick(const std::vector<size_t>& pickInds, std::vector<size_t>& elements) = 0;
+  virtual void createProgram() = 0;
 
-  void userEdit() override;
-  virtual void setProgramValues(gl::GLProgram* program) override;
+  // Fill the program's membership texture, or, when element textures cannot be used, its per-corner values
+  virtual void fillMembershipBuffers(render::ShaderProgram& p) = 0;
+  virtual void fillMembershipCornerValues(render::ShaderProgram& p, bool update) = 0;
+  render::TextureBuffer& generateMembershipTexture();
+  void uploadChangedMembership(); // (only what changed since the buffers were filled)
 
-  // === Members
-  std::vector<char> membership; // 1 if in, 0 otherwise
+  std::shared_ptr<render::ShaderProgram> program;
+  std::shared_ptr<render::TextureBuffer> membershipTexture; // one R32F texel per element, filled row by row
+  size_t changedBegin, changedEnd;                           // elements changed since the last upload
+  void markChanged(size_t begin, size_t end);
+  void clearChanged();
 
 private:
-  // User membership editing
-  void userEditCallback();
-  bool membershipStale = false;
-  int mouseMemberAction = 0;
-};
+  PersistentValue<float> brushRadius;
+  PersistentValue<std::string> cMap;
 
-template <class T>
-void SurfaceMesh::addVertexSelectionQuantity(std::string name, const T& initialMembership) {
-  std::shared_ptr<SurfaceSelectionVertexQuantity> q = std::make_shared<SurfaceSelectionVertexQuantity>(
-      name, standardizeArray<char, T>(initialMembership, nVertices(), "vertex selection quantity " + name), this);
-  addSurfaceQuantity(q);
-}
-
-
-/*
-// ========================================================
-// ==========            Face Selection          ==========
-// ========================================================
-
-class SurfaceSelectionFaceQuantity : public SurfaceSelectionQuantity {
-public:
-  SurfaceSelectionFaceQuantity(std::string name, FaceData<double>& values_, SurfaceMesh* mesh_,
-                            DataType dataType_ = DataType::STANDARD);
-  //   ~SurfaceSelectionVertexQuantity();
-
-  virtual gl::GLProgram* createProgram() override;
-
-  void fillColorBuffers(gl::GLProgram* p);
-
-  void buildInfoGUI(FacePtr f) override;
-
-  // === Members
-  FaceData<double> values;
+  // UI internals
+  bool painting = false;
+  int mouseMemberAction = 0; // 0 to select, 1 to deselect
+  void processBrushInput();
 };
 
 // ========================================================
-// ==========            Edge Selection          ==========
+// ==========           Vertex Selection         ==========
 // ========================================================
 
-class SurfaceSelectionEdgeQuantity : public SurfaceSelectionQuantity {
+class SurfaceVertexSelectionQuantity : public SurfaceSelectionQuantity {
 public:
-  SurfaceSelectionEdgeQuantity(std::string name, EdgeData<double>& values_, SurfaceMesh* mesh_,
-                            DataType dataType_ = DataType::STANDARD);
-  //   ~SurfaceSelectionVertexQuantity();
+  SurfaceVertexSelectionQuantity(std::string name, const std::vector<char>& initialMembership, SurfaceMesh& mesh_);
 
-  virtual gl::GLProgram* createProgram() override;
+  virtual void buildVertexInfoGUI(size_t vInd) override;
 
-  void fillColorBuffers(gl::GLProgram* p);
-
-  void buildInfoGUI(EdgePtr e) override;
-
-
-  // === Members
-  EdgeData<double> values;
+protected:
+  virtual void elementsFromPick(const std::vector<size_t>& pickInds, std::vector<size_t>& elements) override;
+  virtual void createProgram() override;
+  virtual void fillMembershipBuffers(render::ShaderProgram& p) override;
+  virtual void fillMembershipCornerValues(render::ShaderProgram& p, bool update) override;
 };
 
 // ========================================================
-// ==========          Halfedge Selection        ==========
+// ==========            Face Selection          ==========
 // ========================================================
 
-class SurfaceSelectionHalfedgeQuantity : public SurfaceSelectionQuantity {
+class SurfaceFaceSelectionQuantity : public SurfaceSelectionQuantity {
 public:
-  SurfaceSelectionHalfedgeQuantity(std::string name, HalfedgeData<double>& values_, SurfaceMesh* mesh_,
-                                DataType dataType_ = DataType::STANDARD);
-  //   ~SurfaceSelectionVertexQuantity();
+  SurfaceFaceSelectionQuantity(std::string name, const std::vector<char>& initialMembership, SurfaceMesh& mesh_);
 
-  virtual gl::GLProgram* createProgram() override;
+  virtual void buildFaceInfoGUI(size_t fInd) override;
 
-  void fillColorBuffers(gl::GLProgram* p);
-
-  void buildInfoGUI(HalfedgePtr he) override;
-
-  // === Members
-  HalfedgeData<double> values;
+protected:
+  virtual void elementsFromPick(const std::vector<size_t>& pickInds, std::vector<size_t>& elements) override;
+  virtual void createProgram() override;
+  virtual void fillMembershipBuffers(render::ShaderProgram& p) override;
+  virtual void fillMembershipCornerValues(render::ShaderProgram& p, bool update) override;
 };
-*/
+
 } // namespace polyscope
@@ -0,0 +1,72 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/sparse_element_set.h"
+#include "polyscope/surface_scalar_quantity.h"
+
+namespace polyscope {
+
+// A scalar with values on only some of the vertices or faces of a mesh (see SparseElementSet), drawn on the surface
+// like a dense scalar; the other elements take the mesh's surface color. `values` holds one value per element of the
+// set, so the histogram, the ranges and updateData() all refer to those.
+class SurfaceSparseScalarQuantity : public SurfaceScalarQuantity {
+public:
+  SurfaceSparseScalarQuantity(std::string name, SurfaceMesh& mesh_, std::string definedOn, SparseElementSet elements_,
+                              const std::vector<double>& values_, DataType dataType);
+
+  virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual std::string niceName() override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+
+  const SparseElementSet& getElements() const { return elements; }
+  bool hasValue(size_t ind) const { return elements.contains(ind); }
+  double getValue(size_t ind) const; // NaN if the element has none
+
+protected:
+  const SparseElementSet elements;
+
+  // The presence bitmask and values, for the programs which look values up (see sparseLookup() in the shaders). They do
+  // not depend on the level of detail, so they are kept when the program is rebuilt.
+  std::shared_ptr<render::TextureBuffer> presenceTexture;
+  std::shared_ptr<render::TextureBuffer> valueTexture;
+  void setSparseTextures(render::ShaderProgram& p);
+
+  // Per-corner values and presence, for the programs which can not look values up
+  void fillSparseCornerValues(render::ShaderProgram& p, const std::vector<size_t>& cornerElements);
+
+  void buildValueInfoGUI(size_t ind);
+};
+
+// ========================================================
+// ==========         Sparse Vertex Scalar       ==========
+// ========================================================
+
+class SurfaceVertexSparseScalarQuantity : public SurfaceSparseScalarQuantity {
+public:
+  SurfaceVertexSparseScalarQuantity(std::string name, SparseElementSet elements_, const std::vector<double>& values_,
+                                    SurfaceMesh& mesh_, DataType dataType_ = DataType::STANDARD);
+
+  virtual void createProgram() override;
+  virtual void fillColorBuffers(render::ShaderProgram& p) override;
+
+  void buildVertexInfoGUI(size_t vInd) override;
+};
+
+// ========================================================
+// ==========          Sparse Face Scalar        ==========
+// ========================================================
+
+class SurfaceFaceSparseScalarQuantity : public SurfaceSparseScalarQuantity {
+public:
+  SurfaceFaceSparseScalarQuantity(std::string name, SparseElementSet elements_, const std::vector<double>& values_,
+                                  SurfaceMesh& mesh_, DataType dataType_ = DataType::STANDARD);
+
+  virtual void createProgram() override;
+  virtual void fillColorBuffers(render::ShaderProgram& p) override;
+
+  void buildFaceInfoGUI(size_t fInd) override;
+};
+
+} // namespace polyscope
@@ -10,6 +10,8 @@
 
 namespace polyscope {
 
+class FieldTraceTask;
+
 // ==== Common base class
 
 // Represents a general vector field associated with a surface mesh, including
@@ -18,9 +20,12 @@ class SurfaceVectorQuantity : public SurfaceMeshQuantity {
 public:
   SurfaceVectorQuantity(std::string name, SurfaceMesh& mesh_, MeshElement definedOn_,
                         VectorType vectorType_ = VectorType::STANDARD);
+  virtual ~SurfaceVectorQuantity();
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
+  virtual void dataUpdated() override;
 
   // Allow children to append to the UI
   virtual void drawSubUI();
@@ -53,6 +58,13 @@ public:
   SurfaceVectorQuantity* setMaterial(std::string name);
   std::string getMaterial();
 
+  // Decimation: draw only about one vector per this many pixels across the mesh on the screen
+  SurfaceVectorQuantity* setDecimationEnabled(bool newVal);
+  bool getDecimationEnabled();
+  SurfaceVectorQuantity* setDecimationSpacing(double pixels);
+  double getDecimationSpacing();
+  size_t getNumVectorsDrawn(); // in the last frame
+
   // Enable the ribbon visualization
   SurfaceVectorQuantity* setRibbonEnabled(bool newVal);
   bool isRibbonEnabled();
@@ -68,13 +80,23 @@ public:
 protected:
   // Manages _actually_ drawing the vectors, generating gui.
   std::unique_ptr<VectorArtist> vectorArtist;
-  void prepareVectorArtist();
+  // If the roots are one per vertex or face, pass the mesh's buffer of their positions to draw from that instead of
+  // vectorRoots, which is then left empty. Decimating also needs the roots on the host, if the mesh has them.
+  void prepareVectorArtist(std::shared_ptr<render::AttributeBuffer> rootBuffer = nullptr,
+                           const std::vector<glm::vec3>* hostRoots = nullptr);
 
   MeshElement definedOn;
 
   // A ribbon viz that is appropriate for some fields
   std::unique_ptr<RibbonArtist> ribbonArtist;
   PersistentValue<bool> ribbonEnabled;
+
+  // Create the ribbon artist for lines traced through a (per-face, identified) field, see traceField(). With
+  // options::backgroundFieldTracing, it starts out empty and ribbonTraceTask fills it in as drawRibbons() is called.
+  void traceRibbons(const std::vector<glm::vec2>& field, int nSym);
+  void drawRibbons();
+  void clearRibbons();
+  std::unique_ptr<FieldTraceTask> ribbonTraceTask;
 };
 
 
@@ -86,8 +108,14 @@ public:
                               VectorType vectorType_ = VectorType::STANDARD);
 
   virtual void refresh() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) override;
   virtual std::string niceName() override;
   virtual void buildVertexInfoGUI(size_t vInd) override;
+
+  // Replace the vectors, one per vertex as before. The programs and options are kept; the vector buffers are rewritten
+  // and the vectors scaled by their new longest length.
+  template <class T>
+  SurfaceVertexVectorQuantity* updateData(const T& newVectors);
 };
 
 
@@ -99,8 +127,14 @@ public:
                             VectorType vectorType_ = VectorType::STANDARD);
 
   virtual void refresh() override;
+  virtual void geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) override;
   virtual std::string niceName() override;
   virtual void buildFaceInfoGUI(size_t fInd) override;
+
+  // Replace the vectors, one per face as before. The programs and options are kept; the vector buffers are rewritten
+  // and the vectors scaled by their new longest length.
+  template <class T>
+  SurfaceFaceVectorQuantity* updateData(const T& newVectors);
 };
 
 
@@ -115,6 +149,7 @@ public:
   std::vector<glm::vec2> vectorField;
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
 
   void drawSubUI() override;
 
@@ -135,6 +170,7 @@ public:
   std::vector<glm::vec2> vectorField;
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
 
   void drawSubUI() override;
 
@@ -156,6 +192,7 @@ public:
   std::vector<char> canonicalOrientation;
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
 
   void drawSubUI() override;
 
@@ -165,4 +202,20 @@ public:
   void buildFaceInfoGUI(size_t fInd) override;
 };
 
+template <class T>
+SurfaceVertexVectorQuantity* SurfaceVertexVectorQuantity::updateData(const T& newVectors) {
+  validateSize(newVectors, vectors.size(), "surface vertex vector quantity " + name);
+  vectors = standardizeVectorArray<glm::vec3, 3>(newVectors);
+  dataUpdated();
+  return this;
+}
+
+template <class T>
+SurfaceFaceVectorQuantity* SurfaceFaceVectorQuantity::updateData(const T& newVectors) {
+  validateSize(newVectors, vectors.size(), "surface face vector quantity " + name);
+  vectors = standardizeVectorArray<glm::vec3, 3>(newVectors);
+  dataUpdated();
+  return this;
+}
+
 } // namespace polyscope
@@ -0,0 +1,68 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/render/engine.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+// Fills `data` with frame iFrame of a streamed attribute, as packed floats (3 per point for positions). Runs on a
+// background thread, so it must not call in to polyscope; `data` may hold an earlier frame, whose storage it can reuse.
+// Leaving `data` with the wrong size (or throwing) marks the frame as unreadable, and zeros are drawn in its place.
+typedef std::function<void(size_t iFrame, std::vector<float>& data)> TimeFrameLoader;
+
+// A loader which reads frame i from filenames[i], a file holding the frame as raw native-endian float32 values
+TimeFrameLoader rawFileFrameLoader(std::vector<std::string> filenames);
+
+// The frames of an animated attribute (positions, scalar values, ...), each uploaded once to its own GPU buffer. Moving
+// to another time only rebinds buffers and sets a blend uniform, so playback uploads nothing.
+//
+// Times count frames since the first one added, t = 2.5 is halfway between frames 2 and 3. At most maxHeld frames are
+// kept, adding more drops the oldest; times are clamped to the frames still held.
+//
+// Frames which do not all fit on the GPU can instead be streamed from a loader, for nFrames frames of frameSize floats
+// each. Then only a few GPU buffers are held, and the frames just ahead of the playhead in the direction it last moved
+// are read on background threads and uploaded before they are drawn (see options::timeSeriesPrefetchFrames). Binding a
+// frame which was not read ahead, after a jump, reads it on the spot. Streamed frames can not be added to.
+class TimeFrameBuffers {
+public:
+  TimeFrameBuffers(render::DataType type, size_t maxHeld);
+  TimeFrameBuffers(render::DataType type, size_t nFrames, size_t frameSize, TimeFrameLoader loader);
+  ~TimeFrameBuffers();
+
+  void addFrame(const std::vector<glm::vec3>& data);
+  void addFrame(const std::vector<float>& data);
+
+  size_t nFrames() const; // frames ever added, or the frames of the loader
+  size_t nHeld() const;   // on the GPU
+  bool empty() const { return nFrames() == 0; }
+  bool isStreamed() const { return stream != nullptr; }
+
+  // Bind the frame at time t (rounded down) to an attribute
+  void bind(render::ShaderProgram& p, const std::string& attributeName, double t);
+
+  // Bind the frames on either side of t, and set the blend uniform to the fraction between them
+  void bind(render::ShaderProgram& p, const std::string& attributeName, const std::string& nextAttributeName,
+            const std::string& blendUniformName, double t);
+
+private:
+  render::DataType type;
+  size_t maxHeld;
+  size_t nDropped = 0;
+  std::deque<std::shared_ptr<render::AttributeBuffer>> frames;
+
+  void pushFrame(std::shared_ptr<render::AttributeBuffer> buffer);
+  void locate(double t, size_t& frameInd, float& blend) const; // held frame index and fraction past it
+
+  // Streaming
+  struct Stream;
+  std::unique_ptr<Stream> stream; // null unless streamed
+  std::shared_ptr<render::AttributeBuffer> frameBuffer(size_t frameInd); // the buffer of a located frame
+};
+
+} // namespace polyscope
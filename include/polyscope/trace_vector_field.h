@@ -3,14 +3,40 @@
 
 #include "polyscope/surface_mesh.h"
 
+#include <cstdint>
+#include <memory>
+
 namespace polyscope {
 
 // Trace lines through a vector field on a mesh.
 // Return is a list of lines, each entry is (position, normal)
 // Input field should be identified (raised to power), not disambiguated
 // Settings 0 for nLines results in an automatically computed value
+// The lines are traced in parallel. Their random starting points come from the seed and the line's index alone, so the
+// result is the same for a given seed, however many threads trace it.
 std::vector<std::vector<std::array<glm::vec3, 2>>> traceField(SurfaceMesh& mesh, const std::vector<glm::vec2>& field,
-                                                              int nSym = 1, size_t nLines = 0);
+                                                              int nSym = 1, size_t nLines = 0, uint64_t seed = 0);
+
+// Traces the same lines as traceField() on a background thread, a batch at a time, so they can be shown as they are
+// completed. The mesh must not change until the task is done or destroyed; destroying it stops the tracing.
+class FieldTraceTask {
+public:
+  FieldTraceTask(SurfaceMesh& mesh, const std::vector<glm::vec2>& field, int nSym = 1, size_t nLines = 0,
+                 uint64_t seed = 0);
+  ~FieldTraceTask();
+  FieldTraceTask(const FieldTraceTask&) = delete;
+  FieldTraceTask& operator=(const FieldTraceTask&) = delete;
+
+  bool isDone() const;
+  void finish(); // block until all lines are traced
+
+  // The lines completed since the last call, in order
+  std::vector<std::vector<std::array<glm::vec3, 2>>> takeCompletedLines();
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
 
 // Rotate in to a new basis in R3. Vector is rotated in to new tangent plane, then a change of basis is performed to
 // the new basis. Basis vectors MUST be unit and orthogonal -- this function doesn't check.
@@ -5,6 +5,8 @@
 #include "polyscope/utilities.h"
 #include "polyscope/widget.h"
 
+#include <functional>
+
 namespace polyscope {
 
 // A visual widget with handles for translations/rotations
@@ -29,6 +31,7 @@ public:
   // note that this is a reference set on construction; the gizmo wraps a transform defined somewhere else
   glm::mat4& T;
   PersistentValue<glm::mat4>* Tpers; // optional, a persistent value defined elsewhere that goes with T
+  std::function<void()> onUpdate;    // optional, called after a drag changes T
 
   // == Member functions
 
@@ -9,12 +9,15 @@ enum class NavigateStyle { Turntable = 0, Free, Planar, Arcball };
 enum class UpDir { XUp = 0, YUp, ZUp, NegXUp, NegYUp, NegZUp};
 enum class BackgroundView { None = 0 };
 enum class ProjectionMode { Perspective = 0, Orthographic };
-enum class TransparencyMode { None = 0, Simple, Pretty };
+enum class TransparencyMode { None = 0, Simple, Pretty, WeightedBlended };
 enum class GroundPlaneMode { None, Tile, TileReflection, ShadowOnly };
+enum class PresentMode { VSync = 0, AdaptiveVSync, Immediate, LowLatency };
 enum class BackFacePolicy { Identical, Different, Custom, Cull };
 enum class ShadeStyle { FLAT = 0, SMOOTH };
+enum class ScalarPrecision { Double = 0, Float, Quantized16, Quantized8 };
 
-enum class PointRenderMode { Sphere = 0, Quad};
+enum class PointRenderMode { Sphere = 0, Quad, Splat };
+enum class CurveRenderMode { Cylinders = 0, Tubes, Lines };
 enum class MeshElement { VERTEX = 0, FACE, EDGE, HALFEDGE, CORNER };
 enum class VolumeMeshElement { VERTEX = 0, EDGE, FACE, CELL };
 enum class VolumeCellType { TET = 0, HEX };
@@ -11,10 +11,13 @@
 #include <sstream>
 #include <string>
 #include <tuple>
+#include <vector>
 
 
 #include <glm/glm.hpp>
 
+#include "polyscope/parallel.h"
+
 
 namespace polyscope {
 
@@ -48,6 +51,15 @@ void validateName(const std::string& name);
 // Print large integers in a user-friendly way (like "37.5B")
 std::string prettyPrintCount(size_t count);
 
+// Print sizes in memory in a user-friendly way (like "12.5 MB")
+std::string prettyPrintBytes(size_t nBytes);
+
+// Bytes allocated by a vector (its capacity, not its size), for memory accounting
+template <typename T>
+size_t allocatedBytes(const std::vector<T>& vec) {
+  return vec.capacity() * sizeof(T);
+}
+
 // Printf to a std::string
 template <typename... Args>
 std::string str_printf(const std::string& format, Args... args) {
@@ -69,6 +81,13 @@ inline glm::vec3 componentwiseMax(const glm::vec3& vA, const glm::vec3& vB) {
   return glm::vec3{std::max(vA.x, vB.x), std::max(vA.y, vB.y), std::max(vA.z, vB.z)};
 }
 
+// The axis-aligned bounding box of a point set, and the length scale structures use for it: twice the largest distance
+// from a point (or one of extraPoints) to the center of the box. Runs in parallel. The distances are only measured in
+// blocks of points whose bounds could reach farther from the center than the extreme points found while bounding, so
+// spatially coherent inputs are mostly read once. Empty inputs give an inverted infinite box and a length scale of 0.
+void computePointSetExtents(const std::vector<glm::vec3>& points, glm::vec3& bboxMin, glm::vec3& bboxMax,
+                            float& lengthScale, const std::vector<glm::vec3>& extraPoints = {});
+
 
 // Transformation utilities
 void splitTransform(const glm::mat4& trans, glm::mat3x4& R, glm::vec3& T);
@@ -103,17 +122,46 @@ const size_t INVALID_IND = std::numeric_limits<size_t>::max();
 
 template <typename T>
 std::vector<T> applyPermutation(const std::vector<T>& input, const std::vector<size_t>& perm) {
-  // TODO figure out if there's a copy to be avoided here
   if (perm.size() == 0) {
     return input;
   }
+  // a single gather, split across threads for large data
   std::vector<T> result(perm.size());
-  for (size_t i = 0; i < perm.size(); i++) {
-    result[i] = input[perm[i]];
-  }
+  parallelFor(0, perm.size(), [&](size_t i) { result[i] = input[perm[i]]; });
   return result;
 }
 
+// (as above, but moves rather than copies the input when there is no permutation)
+template <typename T>
+std::vector<T> applyPermutation(std::vector<T>&& input, const std::vector<size_t>& perm) {
+  if (perm.size() == 0) {
+    return std::move(input);
+  }
+  return applyPermutation(static_cast<const std::vector<T>&>(input), perm);
+}
+
+// The inverse of a permutation as above: the position of each data index in perm, or INVALID_IND for indices which
+// perm does not take. The result has at least dataSize entries.
+std::vector<size_t> invertPermutation(const std::vector<size_t>& perm, size_t dataSize = 0);
+
+// The inverse of perm held in cache, computed first if the cache is empty (and there is a permutation). Used for the
+// lazily-built inverses which the mesh structures keep next to their permutation arrays.
+const std::vector<size_t>& cachedPermutationInverse(const std::vector<size_t>& perm, size_t dataSize,
+                                                     std::vector<size_t>& cache);
+
+// The indices of the points in the order they are met along a Morton curve through their bounding box (with 16 bits
+// per axis), so that points near each other in the order are near each other in space. Non-finite points are ordered
+// with the lowest corner.
+std::vector<uint32_t> mortonOrder(const std::vector<glm::vec3>& points);
+
+// Spread the low 21 bits of x out to every third bit, to interleave cell coordinates in to a Morton code
+uint64_t spreadBits3(uint64_t x);
+
+// An order-preserving map from floats to integers: the bits of positive values get the sign bit set, those of negative
+// values are flipped, so that comparing keys compares the values (for sorting or binning floats by their bits)
+uint32_t floatOrderKey(float x);
+float floatFromOrderKey(uint32_t key);
+
 
 // === Random number generation
 extern std::random_device util_random_device;
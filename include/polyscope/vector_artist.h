@@ -11,17 +11,30 @@ namespace polyscope {
 
 // A utility class for drawing vectors.
 // Note: Does not actually take ownership of memory buffers for vectors; just keeps a reference to the buffer, which
-// must stay valid.
+// must stay valid. Bases which the parent already has on the GPU can be passed as a render buffer instead, so that all
+// of its vector quantities bind the one copy.
+//
+// With decimation enabled, the artist draws a spatially stratified subset of the vectors, sized so that there is about
+// one per `spacing` pixels across the parent on the screen. The vectors are put in a priority order once, a coarse to
+// fine traversal of an octree over the bases with the vectors of each octree level shuffled, and each frame draws
+// just a prefix of that order. This needs the bases on the host.
 
 class VectorArtist {
 
 public:
   VectorArtist(Structure& parentStructure_, std::string uniqueName_, const std::vector<glm::vec3>& bases_,
                const std::vector<glm::vec3>& vectors_, const VectorType& vectorType_);
+  VectorArtist(Structure& parentStructure_, std::string uniqueName_,
+               std::shared_ptr<render::AttributeBuffer> baseBuffer_, const std::vector<glm::vec3>& vectors_,
+               const VectorType& vectorType_, const std::vector<glm::vec3>* hostBases_ = nullptr);
 
   void draw();
   void buildParametersUI();
 
+  // Call after the referenced vectors change in place (keeping their count): the longest length is measured again and
+  // the vector buffers of the existing programs are rewritten.
+  void vectorsChanged();
+
 
   // === Option accessors
 
@@ -41,13 +54,28 @@ public:
   void setMaterial(std::string name);
   std::string getMaterial();
 
+  // Scale as if this were the length of the longest vector, for artists which draw a subset of a larger set
+  void setMaxLength(double newVal);
+  static double computeMaxLength(const std::vector<glm::vec3>& vectors);
+
+  // Decimation, see above (only possible if the artist has the bases on the host)
+  void setDecimationEnabled(bool newVal);
+  bool getDecimationEnabled();
+  void setDecimationSpacing(double pixels);
+  double getDecimationSpacing();
+  bool supportsDecimation() const { return bases != nullptr; }
+
+  // The number of vectors the last draw() drew, which is fewer than all of them when decimating
+  size_t getNumVectorsDrawn() const { return nDrawn; }
+
 private:
   // Data
   Structure& parentStructure;
   const std::string uniqueName;
   const std::string uniquePrefix;
   const VectorType vectorType;
-  const std::vector<glm::vec3>& bases;
+  const std::vector<glm::vec3>* bases;                 // (null if only on the GPU, in baseBuffer)
+  std::shared_ptr<render::AttributeBuffer> baseBuffer; // (null if drawing from bases)
   const std::vector<glm::vec3>& vectors;
   double maxLength = -1;
 
@@ -56,11 +84,28 @@ private:
   PersistentValue<ScaledValue<float>> vectorRadius;
   PersistentValue<glm::vec3> vectorColor;
   PersistentValue<std::string> material;
+  PersistentValue<bool> decimationEnabled;
+  PersistentValue<float> decimationSpacing;
 
   std::shared_ptr<render::ShaderProgram> program;
 
+  // Decimation: this program draws the vectors in priority order, in which octree level l (with one vector per occupied
+  // cell of depth l) spans [levelEnd[l-1], levelEnd[l]). Vectors whose bases coincide at the finest depth come last.
+  std::shared_ptr<render::ShaderProgram> decimatedProgram;
+  std::vector<size_t> levelEnd;
+  std::vector<size_t> decimatedOrder; // the vector drawn at each position of the order
+  glm::vec3 basesMin, basesMax;
+  size_t nDrawn = 0;
+
+  VectorArtist(Structure& parentStructure_, std::string uniqueName_, const std::vector<glm::vec3>* bases_,
+               std::shared_ptr<render::AttributeBuffer> baseBuffer_, const std::vector<glm::vec3>& vectors_,
+               const VectorType& vectorType_);
+
   // helpers
   void createProgram();
+  void createDecimatedProgram();
+  std::shared_ptr<render::ShaderProgram> requestProgram();
+  size_t decimatedDrawCount(); // for the current view
   void updateMaxLength();
 };
 
@@ -48,6 +48,32 @@ extern glm::mat4x4 viewMat;
 extern double fov; // in the y direction
 extern ProjectionMode projectionMode;
 
+// While active, the projection shows only one tile of a larger image, so an image bigger than the framebuffer can be
+// rendered a tile at a time (see renderTiledScreenshot()). The tile is the size of the framebuffer, at pixel (x,y) from
+// the top left of an image of imageWidth x imageHeight, which sets the aspect ratio in place of the framebuffer.
+struct ProjectionTile {
+  bool active = false;
+  int imageWidth = 0;
+  int imageHeight = 0;
+  int x = 0;
+  int y = 0;
+};
+extern ProjectionTile projectionTile;
+
+// While active, the camera's image fills only part of the whole image (the framebuffer, unless a projection tile is
+// active), given as its lower left corner and size {x, y, width, height} in fractions of the image, which sets the
+// aspect ratio. Framebuffers bound for rendering are scissored to it, so several views can be drawn side by side in
+// one framebuffer (see viewport.h).
+struct ViewRegion {
+  bool active = false;
+  glm::vec4 rect{0., 0., 1., 1.};
+};
+extern ViewRegion viewRegion;
+
+// Shift of the projection, in pixels of the framebuffer, while rendering the jittered frames for temporal anti-aliasing
+// (see options::temporalAntiAliasingFrames)
+extern glm::vec2 projectionJitter;
+
 // "Flying" view
 extern bool midflight;
 extern float flightStartTime;
@@ -92,10 +118,15 @@ void lookAt(glm::vec3 cameraLocation, glm::vec3 target, glm::vec3 upDir, bool fl
 // Get various camera matrices and data
 glm::mat4 getCameraViewMatrix();
 glm::mat4 getCameraPerspectiveMatrix();
+glm::vec4 getViewRegionInBuffer(); // viewRegion in fractions of the framebuffer, through the projection tile
 glm::vec3 getCameraWorldPosition();
 void getCameraFrame(glm::vec3& lookDir, glm::vec3& upDir, glm::vec3& rightDir);
 glm::vec3 screenCoordsToWorldRay(glm::vec2 screenCoords);
 
+// False if the box is certainly outside the view once mapped to clip space by `toClip` (such as the projection times
+// the view matrix). Conservative for any matrix, including the flattened ones used to draw shadows.
+bool boxMayBeInView(glm::vec3 bboxMin, glm::vec3 bboxMax, const glm::mat4& toClip);
+
 // Flight-related
 void startFlightTo(const CameraParameters& p, float flightLengthInSeconds = .4);
 void startFlightTo(const glm::mat4& T, float targetFov, float flightLengthInSeconds = .4);
@@ -0,0 +1,90 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/camera_parameters.h"
+#include "polyscope/types.h"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include <functional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace polyscope {
+
+// forward declarations
+class Structure;
+
+// One of several views of the scene shown side by side in the window, each with its own camera and a choice of which
+// structures it shows. While any viewport exists, the window shows only the viewports. They are drawn one after another
+// in to their part of the same scene buffers, from the same structure data, and the screen-space passes (lighting,
+// anti-aliasing) run once for all of them.
+class Viewport {
+
+public:
+  Viewport(std::string name, glm::vec4 region);
+
+  // No copy constructor/assignment
+  Viewport(const Viewport&) = delete;
+  Viewport& operator=(const Viewport&) = delete;
+
+  const std::string name;
+
+  // The part of the window the view fills, as its lower left corner and size {x, y, width, height} in fractions of the
+  // window
+  void setRegion(glm::vec4 newRegion);
+  glm::vec4 getRegion();
+
+  // The camera. Until one is set, the viewport starts from the main view's camera the first time it is drawn. Mouse
+  // navigation over the viewport moves its camera.
+  void setViewToCamera(const CameraParameters& p);
+  void lookAt(glm::vec3 cameraLocation, glm::vec3 target);
+  glm::mat4 getViewMatrix();
+  void setProjectionMode(ProjectionMode newMode);
+  ProjectionMode getProjectionMode();
+
+  // Enabled structures are shown in every viewport, unless hidden in it
+  void setStructureVisible(Structure* s, bool visible);
+  bool isStructureVisible(Structure* s);
+
+  // Make this the view being drawn: its camera and region replace the main view's until deactivate()
+  void activate();
+  void deactivate();
+
+private:
+  glm::vec4 region;
+  glm::mat4 viewMat;
+  double fov;
+  ProjectionMode projectionMode;
+  std::set<std::pair<std::string, std::string>> hiddenStructures; // by type name and name
+
+  // The main view's camera while this one is active
+  glm::mat4 mainViewMat;
+  double mainFov;
+  ProjectionMode mainProjectionMode;
+};
+
+// Add a viewport filling the given region of the window (see Viewport::setRegion()), replacing any of the same name
+Viewport* addViewport(std::string name, glm::vec4 region);
+Viewport* getViewport(std::string name);
+bool hasViewport(std::string name);
+void removeViewport(std::string name);
+void removeAllViewports();
+bool haveViewports();
+
+// The viewport being drawn, or nullptr while drawing the main view
+Viewport* getActiveViewport();
+
+// The viewport containing a point of the window, given as fractions of the window from its top left (like mouse
+// positions); nullptr if none does
+Viewport* getViewportAt(glm::vec2 screenCoords);
+
+// Run f with each viewport active in turn, or once for the main view if there are none
+void forEachViewport(const std::function<void()>& f);
+
+} // namespace polyscope
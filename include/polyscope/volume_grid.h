@@ -0,0 +1,111 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/persistent_value.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/render/engine.h"
+#include "polyscope/standardize_data_array.h"
+#include "polyscope/structure.h"
+#include "polyscope/volume_grid_quantity.h"
+
+#include "polyscope/volume_grid_scalar_quantity.h"
+
+#include <vector>
+
+namespace polyscope {
+
+// Forward declare volume grid
+class VolumeGrid;
+
+// Forward declare quantity types
+class VolumeGridScalarQuantity;
+
+
+template <> // Specialize the quantity type
+struct QuantityTypeHelper<VolumeGrid> {
+  typedef VolumeGridQuantity type;
+};
+
+// A regular grid of nodes filling an axis-aligned box, with values at the nodes. Node (i, j, k) sits at boundMin + (i,
+// j, k) / (gridNodeDim - 1) * (boundMax - boundMin), and its values are at index i + gridNodeDim.x * (j + gridNodeDim.y
+// * k) of quantity arrays (x varies fastest).
+//
+// Quantities are drawn by marching rays through the box on the GPU; the grid itself has no surface to draw.
+class VolumeGrid : public QuantityStructure<VolumeGrid> {
+public:
+  // === Member functions ===
+
+  // Construct a new volume grid structure
+  VolumeGrid(std::string name, glm::uvec3 gridNodeDim, glm::vec3 boundMin, glm::vec3 boundMax);
+
+  // === Overloads
+
+  // Build the imgui display
+  virtual void buildCustomUI() override;
+  virtual void buildPickUI(size_t localPickID) override;
+
+  // Render the the structure on screen
+  virtual void draw() override;
+
+  // Render for picking
+  virtual void drawPick() override;
+
+  virtual void updateObjectSpaceBounds() override;
+  virtual std::string typeName() override;
+
+  virtual void refresh() override;
+
+  // === Quantities
+
+  template <class T>
+  VolumeGridScalarQuantity* addScalarQuantity(std::string name, const T& values, DataType type = DataType::STANDARD);
+
+  // === Members and utilities
+
+  glm::uvec3 getGridNodeDim() const { return gridNodeDim; }
+  size_t nNodes() const { return static_cast<size_t>(gridNodeDim.x) * gridNodeDim.y * gridNodeDim.z; }
+  size_t flattenNodeIndex(glm::uvec3 ind) const {
+    return ind.x + static_cast<size_t>(gridNodeDim.x) * (ind.y + static_cast<size_t>(gridNodeDim.y) * ind.z);
+  }
+  glm::vec3 getBoundMin() const { return boundMin; }
+  glm::vec3 getBoundMax() const { return boundMax; }
+
+  // Misc data
+  static const std::string structureTypeName;
+
+  // Small utilities
+  void setVolumeGridUniforms(render::ShaderProgram& p);
+  void fillGeometryBuffers(render::ShaderProgram& p);
+  std::vector<std::string> addVolumeGridRules(std::vector<std::string> initRules);
+
+  // === Get/set visualization parameters
+
+  // Number of samples taken along rays per grid cell they cross. More samples resolve finer detail, at the cost of
+  // time per frame.
+  VolumeGrid* setStepsPerCell(float newVal);
+  float getStepsPerCell();
+
+private:
+  const glm::uvec3 gridNodeDim;
+  const glm::vec3 boundMin, boundMax;
+
+  // === Visualization parameters
+  PersistentValue<float> stepsPerCell;
+
+  // === Quantity adder implementations
+  VolumeGridScalarQuantity* addScalarQuantityImpl(std::string name, const std::vector<double>& data, DataType type);
+};
+
+
+// Shorthand to add a volume grid to polyscope
+VolumeGrid* registerVolumeGrid(std::string name, glm::uvec3 gridNodeDim, glm::vec3 boundMin, glm::vec3 boundMax);
+
+// Shorthand to get a volume grid from polyscope
+inline VolumeGrid* getVolumeGrid(std::string name = "");
+inline bool hasVolumeGrid(std::string name = "");
+inline void removeVolumeGrid(std::string name = "", bool errorIfAbsent = true);
+
+
+} // namespace polyscope
+
+#include "polyscope/volume_grid.ipp"
@@ -0,0 +1,20 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+namespace polyscope {
+
+template <class T>
+VolumeGridScalarQuantity* VolumeGrid::addScalarQuantity(std::string name, const T& data, DataType type) {
+  validateSize(data, nNodes(), "volume grid scalar quantity " + name);
+  return addScalarQuantityImpl(name, standardizeArray<double, T>(data), type);
+}
+
+inline VolumeGrid* getVolumeGrid(std::string name) {
+  return dynamic_cast<VolumeGrid*>(getStructure(VolumeGrid::structureTypeName, name));
+}
+inline bool hasVolumeGrid(std::string name) { return hasStructure(VolumeGrid::structureTypeName, name); }
+inline void removeVolumeGrid(std::string name, bool errorIfAbsent) {
+  removeStructure(VolumeGrid::structureTypeName, name, errorIfAbsent);
+}
+
+} // namespace polyscope
@@ -0,0 +1,19 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/quantity.h"
+#include "polyscope/structure.h"
+
+namespace polyscope {
+
+// Forward declare volume grid
+class VolumeGrid;
+
+// Extend Quantity<VolumeGrid>
+class VolumeGridQuantity : public Quantity<VolumeGrid> {
+public:
+  VolumeGridQuantity(std::string name, VolumeGrid& parentStructure, bool dominates = false);
+  virtual ~VolumeGridQuantity() {};
+};
+
+} // namespace polyscope
@@ -0,0 +1,66 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/affine_remapper.h"
+#include "polyscope/histogram.h"
+#include "polyscope/render/color_maps.h"
+#include "polyscope/render/engine.h"
+#include "polyscope/scalar_quantity.h"
+#include "polyscope/volume_grid.h"
+
+namespace polyscope {
+
+// Scalar values at the nodes of a volume grid, drawn as an emissive, absorbing volume: values are colored by the
+// colormap, and are transparent at the bottom of the colormap range and most opaque at the top.
+//
+// The values are held on the GPU in a 3D texture, either densely or as an atlas of only the bricks in which they vary.
+// Rays skip over whole bricks whose values are all below the colormap range, and stop once they are nearly opaque.
+class VolumeGridScalarQuantity : public VolumeGridQuantity, public ScalarQuantity<VolumeGridScalarQuantity> {
+public:
+  VolumeGridScalarQuantity(std::string name, VolumeGrid& grid_, const std::vector<double>& values_,
+                           DataType dataType_ = DataType::STANDARD);
+
+  virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual void buildCustomUI() override;
+  virtual std::string niceName() override;
+  virtual void refresh() override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+
+  // === Get/set visualization parameters
+
+  // Opacity gathered by a ray crossing one grid cell of values at the top of the colormap range
+  VolumeGridScalarQuantity* setOpacity(float newVal);
+  float getOpacity();
+
+  // Store only the bricks of nodes whose values are not all equal. Saves GPU memory for sparse data, such as a field
+  // which is constant away from a surface, at the cost of an indirection for each sample.
+  VolumeGridScalarQuantity* setSparseBricks(bool newVal);
+  bool getSparseBricks();
+
+  // Nodes along each side of the bricks used for storage and for skipping empty space
+  static const unsigned int brickSize = 8;
+
+  glm::uvec3 brickCount() const;
+
+private:
+  // === Visualization parameters
+  PersistentValue<float> opacity;
+  PersistentValue<bool> sparseBricks;
+
+  const TextureFormat valueFormat; // R16F or R32F, following options::volumeGridHalfPrecision at creation
+  std::shared_ptr<render::ShaderProgram> program;
+
+  // The textures the program reads (which only holds raw pointers to them)
+  std::shared_ptr<render::TextureBuffer> valueTexture;      // one texel per node, for dense storage
+  std::shared_ptr<render::TextureBuffer> brickAtlasTexture; // the stored bricks, for sparse storage
+  std::shared_ptr<render::TextureBuffer> brickIndexTexture; // where each brick is in the atlas, for sparse storage
+  std::shared_ptr<render::TextureBuffer> brickMaxTexture;   // largest value in each brick
+
+  void createProgram();
+  void fillDenseTextures();
+  void fillBrickedTextures();
+};
+
+} // namespace polyscope
@@ -1,15 +1,19 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #pragma once
 
+#include <array>
+#include <map>
 #include <memory>
 #include <vector>
 
 #include "polyscope/affine_remapper.h"
 #include "polyscope/color_management.h"
+#include "polyscope/parallel.h"
 #include "polyscope/render/engine.h"
 #include "polyscope/standardize_data_array.h"
 #include "polyscope/structure.h"
 #include "polyscope/volume_mesh_quantity.h"
+#include "polyscope/volume_mesh_tet_bvh.h"
 
 // Alllll the quantities
 #include "polyscope/volume_mesh_color_quantity.h"
@@ -41,10 +45,16 @@ public:
 
   // === Member functions ===
 
-  // Construct a new volume mesh structure
+  // Construct a new volume mesh structure, from cells of 8 indices where tets pad the last 4 with a negative value
   VolumeMesh(std::string name, const std::vector<glm::vec3>& vertexPositions,
              const std::vector<std::array<int64_t, 8>>& cellIndices);
 
+  // Construct from flat cell arrays (see cellIndsEntries below); cellIndsStart may be empty if every cell has
+  // uniformCellDegree vertices (4 for tets, 8 for hexes)
+  VolumeMesh(std::string name, const std::vector<glm::vec3>& vertexPositions, std::vector<uint32_t> cellIndsEntries,
+             std::vector<uint32_t> cellIndsStart, size_t uniformCellDegree = 4);
+  ~VolumeMesh();
+
   // Build the imgui display
   virtual void buildCustomUI() override;
   virtual void buildCustomOptionsUI() override;
@@ -58,6 +68,7 @@ public:
 
   virtual void updateObjectSpaceBounds() override;
   virtual std::string typeName() override;
+  virtual size_t hostMemoryUsage() override;
 
   virtual void refresh() override;
 
@@ -83,6 +94,11 @@ public:
   template <class V>
   void updateVertexPositions(const V& newPositions);
 
+  // Move only some vertices, newPositions[i] is the new position of vertex indices[i]. (For now this still re-uploads
+  // all of the geometry: faces are drawn exterior-first, so a vertex's cells are scattered across the buffers.)
+  template <class V>
+  void updateVertexPositions(const std::vector<size_t>& indices, const V& newPositions);
+
 
   // === Indexing conventions
 
@@ -98,18 +114,48 @@ public:
   size_t faceDataSize;
   size_t cellDataSize;
 
+  // Inverses of the permutations (see invertPermutation()), translating user indices to mesh elements. Built on first
+  // use; call resetPermutationInverses() after assigning the arrays.
+  const std::vector<size_t>& getVertexPermInverse();
+  const std::vector<size_t>& getEdgePermInverse();
+  const std::vector<size_t>& getFacePermInverse();
+  const std::vector<size_t>& getCellPermInverse();
+  void resetPermutationInverses();
+
   // === Manage the mesh itself
 
+  // A view of the vertex indices of a cell, in the flat arrays below
+  struct IndexView {
+    const uint32_t* data;
+    size_t count;
+    size_t size() const { return count; }
+    size_t operator[](size_t i) const { return data[i]; }
+    const uint32_t* begin() const { return data; }
+    const uint32_t* end() const { return data + count; }
+  };
+
   // Core data
   std::vector<glm::vec3> vertices;
-  std::vector<std::array<int64_t, 8>> cells; // holds unused indices hold INVALID_IND
+
+  // Cells, stored flat: the vertices of cell i are cellIndsEntries[cellIndsStart[i]] ... [cellIndsStart[i+1]-1], 4 for
+  // a tet and 8 for a hex. When every cell has the same type cellIndsStart is left empty, and cell i simply starts at
+  // uniformCellDegree * i. Prefer the accessors to indexing these directly.
+  std::vector<uint32_t> cellIndsEntries;
+  std::vector<uint32_t> cellIndsStart;
+  size_t uniformCellDegree = 4;
+  size_t cellStart(size_t iC) const { return cellIndsStart.empty() ? uniformCellDegree * iC : cellIndsStart[iC]; }
+  size_t cellDegree(size_t iC) const {
+    return cellIndsStart.empty() ? uniformCellDegree : cellIndsStart[iC + 1] - cellIndsStart[iC];
+  }
+  IndexView cell(size_t iC) const { return IndexView{cellIndsEntries.data() + cellStart(iC), cellDegree(iC)}; }
 
   // Counts
   size_t nVertices() const { return vertices.size(); }
-  size_t nCells() const { return cells.size(); }
+  size_t nCells() const { return nCellsCount; }
 
   size_t nFacesTriangulation() const { return nFacesTriangulationCount; }
   size_t nFaces() const { return nFacesCount; }
+  size_t nExteriorFacesTriangulation() const { return nExteriorFacesTriangulationCount; }
 
   // Derived geometric quantities
   std::vector<double> cellAreas;
@@ -125,10 +171,18 @@ public:
                                               bool isSlice = false);
   glm::vec3 cellCenter(size_t iC);
 
+  // The vertex positions and cell centers on the GPU, for quantities which draw a glyph at each vertex or cell (e.g.
+  // vectors), so that all of them bind one copy. Each is created when first requested, and dropped when the mesh
+  // moves.
+  std::shared_ptr<render::AttributeBuffer> getVertexPositionBuffer();
+  std::shared_ptr<render::AttributeBuffer> getCellCenterBuffer();
+
   // Manage a separate tetrahedral representation used for volumetric visualizations
   // (for a pure-tet mesh this will be the same as the cells array)
-  std::vector<std::array<int64_t, 4>> tets;
+  std::vector<std::array<uint32_t, 4>> tets;
+  std::vector<uint32_t> cellTetStart; // the tets of cell i are cellTetStart[i] ... cellTetStart[i+1]-1
   size_t nTets();
+  size_t tetCell(size_t iT) const; // the cell tet iT was cut from
   void computeTets();    // fills tet buffer
   void ensureHaveTets(); //  ensure the tet buffer is filled (but don't rebuild if already done)
 
@@ -152,6 +206,7 @@ public:
   // Material
   VolumeMesh* setMaterial(std::string name);
   std::string getMaterial();
+  virtual std::string drawBatchKey() override;
 
   // Width of the edges. Scaled such that 1 is a reasonable weight for visible edges, but values  1 can be used for
   // bigger edges. Use 0. to disable.
@@ -165,8 +220,36 @@ public:
   void setVolumeMeshUniforms(render::ShaderProgram& p);
   void fillGeometryBuffers(render::ShaderProgram& p);
   void fillSliceGeometryBuffers(render::ShaderProgram& p);
+  size_t setSliceTetBuffers(render::ShaderProgram& p, polyscope::SlicePlane* sp); // the tets sp passes through, counted
+
+  // The four vertex indices of each tet drawn by a slice program, one buffer per corner
+  typedef std::array<std::shared_ptr<render::AttributeBuffer>, 4> TetVertexBuffers;
+  void fillTetVertexBuffers(TetVertexBuffers& buffers, const std::vector<uint32_t>& tetInds); // creates them if needed
+  static void setTetVertexBuffers(render::ShaderProgram& p, const TetVertexBuffers& buffers);
+  void fillTetCellBuffer(std::shared_ptr<render::AttributeBuffer>& buffer, const std::vector<uint32_t>& tetInds);
   static const std::vector<std::vector<std::array<size_t, 3>>>& cellStencil(VolumeCellType type);
 
+  // The position in the per-corner draw buffers of each triangle of the faces, visited in mesh order: exterior faces
+  // fill the buffers from the front and interior faces from the back (see fillGeometryData()). Interior faces are
+  // only drawn while they can be seen, through a slice plane or transparency; otherwise next() skips them.
+  class TriangleSlots {
+  public:
+    TriangleSlots(size_t nExteriorTriangles, size_t nInteriorTriangles, bool withInterior);
+    size_t size() const { return bufferSize; } // entries in each per-corner buffer
+    bool next(bool isInterior, size_t& iData); // the first of the triangle's three entries, or false if not drawn
+
+  private:
+    bool withInterior;
+    size_t bufferSize, iFront = 0, iBack;
+  };
+  TriangleSlots drawnTriangleSlots();
+
+  // Cell data can be uploaded once, one texel per cell, and read per fragment through the cell of each drawn triangle
+  // rather than copied to every corner. This needs the indices to be exact as floats.
+  bool canUseCellTextures();
+  void setCellTextureUniforms(render::ShaderProgram& p); // binds t_triangleCell
+  bool drawsInteriorFaces() const { return interiorFacesDrawn; }
+
   // Slice plane listeners
   std::vector<polyscope::SlicePlane*> volumeSlicePlaneListeners;
   void addSlicePlaneListener(polyscope::SlicePlane* sp);
@@ -175,6 +258,10 @@ public:
 
 
 private:
+  // The shared body of the constructors; computeDerived = false leaves the cells to be filled and validated
+  VolumeMesh(std::string name, const std::vector<glm::vec3>& vertexPositions, std::vector<uint32_t> cellIndsEntries,
+             std::vector<uint32_t> cellIndsStart, size_t uniformCellDegree, bool computeDerived);
+
   // Visualization settings
   PersistentValue<glm::vec3> color;
   PersistentValue<glm::vec3> interiorColor;
@@ -182,6 +269,12 @@ private:
   PersistentValue<std::string> material;
   PersistentValue<float> edgeWidth;
 
+  // Cached permutation inverses, empty until requested
+  std::vector<size_t> vertexPermInverse;
+  std::vector<size_t> edgePermInverse;
+  std::vector<size_t> facePermInverse;
+  std::vector<size_t> cellPermInverse;
+
   // Level sets
   // TODO: not currently really supported
   float activeLevelSetValue;
@@ -205,10 +298,52 @@ private:
   // Drawing related things
   std::shared_ptr<render::ShaderProgram> program;
   std::shared_ptr<render::ShaderProgram> pickProgram;
+  render::ShaderUniformHandle baseColor1Handle, baseColor2Handle; // in `program`, resolved when it is created
+
+  // Large meshes fill the buffers of `program` on a background thread (see options::backgroundPrepareMinTriangles),
+  // and are not drawn until they are uploaded; picking is then prepared on the first pick
+  struct GeometryData;
+  std::shared_ptr<render::ShaderProgram> pendingProgram; // (created first, since the fill depends on its attributes)
+  std::unique_ptr<GeometryData> fillData;
+  std::unique_ptr<BackgroundTask> fillTask;
+  std::shared_ptr<render::ShaderProgram> requestProgram();
+  bool geometryFillPending(); // starts the fill, creates `program` once it is done; true while it runs
+  void cancelGeometryFill();  // wait for a running fill and drop it; called before the geometry changes
+  void fillGeometryData(GeometryData& data);
+  void setGeometryData(render::ShaderProgram& p, const GeometryData& data);
 
   // Internal members
+  void validateCells(); // checks the flat cell arrays, sets nCellsCount, and drops a cellIndsStart that is not needed
+  size_t nCellsCount = 0;
   size_t nFacesTriangulationCount = 0;
   size_t nFacesCount = 0;
+  size_t nExteriorFacesTriangulationCount = 0;
+
+  // Shared by all slice programs: the four vertices of each tet, and the vertex positions they index
+  TetVertexBuffers sliceTetVertexBuffers;
+  std::shared_ptr<render::TextureBuffer> sliceVertexPositionTexture; // (dropped only once no program samples it)
+
+  std::shared_ptr<render::AttributeBuffer> vertexPositionBuffer, cellCenterBuffer; // see getVertexPositionBuffer()
+  std::shared_ptr<render::AttributeBuffer> sliceTetCellBuffer;                      // the cell of every tet
+  std::shared_ptr<render::TextureBuffer> triangleCellTexture; // for setCellTextureUniforms(), in draw order
+
+  // Each inspecting slice plane draws only the tets it crosses, found with a hierarchy built on the first slice. The
+  // selection is uploaded again whenever the plane moves.
+  struct SliceTetSelection {
+    glm::vec3 normal;
+    float offset;
+    std::vector<uint32_t> tetInds;
+    TetVertexBuffers tetVertexBuffers;
+    std::shared_ptr<render::AttributeBuffer> tetCellBuffer; // filled once a program drawing cell data asks for it
+    bool tetCellsFilled = false;
+  };
+  std::unique_ptr<VolumeMeshTetBVH> sliceTetBVH;
+  std::map<const polyscope::SlicePlane*, SliceTetSelection> sliceTetSelections;
+  void ensureSliceTetBuffers();
+
+  // Whether the draw buffers hold interior faces, see TriangleSlots. Changing it refreshes the buffers.
+  bool interiorFacesDrawn = false;
+  void updateInteriorFaceVisibility();
 
   // === Helper functions
 
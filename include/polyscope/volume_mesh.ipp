@@ -7,15 +7,16 @@ template <class V, class F>
 VolumeMesh* registerTetMesh(std::string name, const V& vertexPositions, const F& tetIndices) {
   checkInitialized();
 
-  // Standardize the array, and pad out extra indices with -1 for our representation
-  std::vector<std::array<int64_t, 8>> tetIndsArr = standardizeVectorArray<std::array<int64_t, 8>, 4>(tetIndices);
-  for (size_t iC = 0; iC < tetIndsArr.size(); iC++) {
-    for (size_t j = 4; j < 8; j++) {
-      tetIndsArr[iC][j] = -1;
-    }
+  // Every cell has 4 vertices, so the flat array needs no starts
+  std::vector<std::array<uint32_t, 4>> tetIndsArr = standardizeVectorArray<std::array<uint32_t, 4>, 4>(tetIndices);
+  std::vector<uint32_t> cellIndsEntries;
+  cellIndsEntries.reserve(4 * tetIndsArr.size());
+  for (const std::array<uint32_t, 4>& tet : tetIndsArr) {
+    cellIndsEntries.insert(cellIndsEntries.end(), tet.begin(), tet.end());
   }
 
-  VolumeMesh* s = new VolumeMesh(name, standardizeVectorArray<glm::vec3, 3>(vertexPositions), tetIndsArr);
+  VolumeMesh* s = new VolumeMesh(name, standardizeVectorArray<glm::vec3, 3>(vertexPositions),
+                                 std::move(cellIndsEntries), {}, 4);
 
   bool success = registerStructure(s);
   if (!success) {
@@ -29,9 +30,17 @@ VolumeMesh* registerTetMesh(std::string name, const V& vertexPositions, const F&
 template <class V, class F>
 VolumeMesh* registerHexMesh(std::string name, const V& vertexPositions, const F& faceIndices) {
   checkInitialized();
-  
+
+  // Every cell has 8 vertices, so the flat array needs no starts
+  std::vector<std::array<uint32_t, 8>> hexIndsArr = standardizeVectorArray<std::array<uint32_t, 8>, 8>(faceIndices);
+  std::vector<uint32_t> cellIndsEntries;
+  cellIndsEntries.reserve(8 * hexIndsArr.size());
+  for (const std::array<uint32_t, 8>& hex : hexIndsArr) {
+    cellIndsEntries.insert(cellIndsEntries.end(), hex.begin(), hex.end());
+  }
+
   VolumeMesh* s = new VolumeMesh(name, standardizeVectorArray<glm::vec3, 3>(vertexPositions),
-                                 standardizeVectorArray<std::array<int64_t, 8>, 8>(faceIndices));
+                                 std::move(cellIndsEntries), {}, 8);
 
   bool success = registerStructure(s);
   if (!success) {
@@ -60,19 +69,24 @@ template <class V, class Ft, class Fh>
 VolumeMesh* registerTetHexMesh(std::string name, const V& vertexPositions, const Ft& tetIndices, const Fh& hexIndices) {
   checkInitialized();
 
-  // Standardize the array, and pad out extra indices with -1 for our representation
-  std::vector<std::array<int64_t, 8>> tetIndsArr = standardizeVectorArray<std::array<int64_t, 8>, 4>(tetIndices);
-  for (size_t iC = 0; iC < tetIndsArr.size(); iC++) {
-    for (size_t j = 4; j < 8; j++) {
-      tetIndsArr[iC][j] = -1;
-    }
+  // Tets first, then hexes, with a start for each cell
+  std::vector<std::array<uint32_t, 4>> tetIndsArr = standardizeVectorArray<std::array<uint32_t, 4>, 4>(tetIndices);
+  std::vector<std::array<uint32_t, 8>> hexIndsArr = standardizeVectorArray<std::array<uint32_t, 8>, 8>(hexIndices);
+  std::vector<uint32_t> cellIndsEntries;
+  std::vector<uint32_t> cellIndsStart{0};
+  cellIndsEntries.reserve(4 * tetIndsArr.size() + 8 * hexIndsArr.size());
+  cellIndsStart.reserve(tetIndsArr.size() + hexIndsArr.size() + 1);
+  for (const std::array<uint32_t, 4>& tet : tetIndsArr) {
+    cellIndsEntries.insert(cellIndsEntries.end(), tet.begin(), tet.end());
+    cellIndsStart.push_back(static_cast<uint32_t>(cellIndsEntries.size()));
+  }
+  for (const std::array<uint32_t, 8>& hex : hexIndsArr) {
+    cellIndsEntries.insert(cellIndsEntries.end(), hex.begin(), hex.end());
+    cellIndsStart.push_back(static_cast<uint32_t>(cellIndsEntries.size()));
   }
-  std::vector<std::array<int64_t, 8>> hexIndsArr = standardizeVectorArray<std::array<int64_t, 8>, 8>(hexIndices);
-
-  // combine the arrays
-  tetIndsArr.insert(tetIndsArr.end(), hexIndsArr.begin(), hexIndsArr.end());
 
-  VolumeMesh* s = new VolumeMesh(name, standardizeVectorArray<glm::vec3, 3>(vertexPositions), tetIndsArr);
+  VolumeMesh* s = new VolumeMesh(name, standardizeVectorArray<glm::vec3, 3>(vertexPositions),
+                                 std::move(cellIndsEntries), std::move(cellIndsStart));
 
   bool success = registerStructure(s);
   if (!success) {
@@ -85,12 +99,32 @@ VolumeMesh* registerTetHexMesh(std::string name, const V& vertexPositions, const
 
 template <class V>
 void VolumeMesh::updateVertexPositions(const V& newPositions) {
+  validateSize(newPositions, nVertices(), "volume mesh updated vertex positions " + name);
+  cancelGeometryFill();
   vertices = standardizeVectorArray<glm::vec3, 3>(newPositions);
 
   // Rebuild any necessary quantities
   geometryChanged();
 }
 
+template <class V>
+void VolumeMesh::updateVertexPositions(const std::vector<size_t>& indices, const V& newPositions) {
+  validateSize(newPositions, indices.size(), "volume mesh updated vertex positions " + name);
+  std::vector<glm::vec3> positions = standardizeVectorArray<glm::vec3, 3>(newPositions);
+  for (size_t i = 0; i < indices.size(); i++) {
+    if (indices[i] >= nVertices()) {
+      error("updateVertexPositions() on [" + name + "] was passed vertex index " + std::to_string(indices[i]) +
+            ", but there are only " + std::to_string(nVertices()) + " vertices");
+      return;
+    }
+  }
+  for (size_t i = 0; i < indices.size(); i++) {
+    vertices[indices[i]] = positions[i];
+  }
+
+  geometryChanged();
+}
+
 
 // Shorthand to get a mesh from polyscope
 inline VolumeMesh* getVolumeMesh(std::string name) {
@@ -16,6 +16,8 @@ public:
   VolumeMeshColorQuantity(std::string name, VolumeMesh& mesh_, std::string definedOn);
 
   virtual void draw() override;
+  virtual void drawSlice(polyscope::SlicePlane* sp) override;
+  virtual void removeSlicePlane(polyscope::SlicePlane* sp) override;
   virtual std::string niceName() override;
 
   virtual void refresh() override;
@@ -24,7 +26,7 @@ protected:
   // UI internals
   const std::string definedOn;
   std::shared_ptr<render::ShaderProgram> program;
-  std::shared_ptr<render::ShaderProgram> sliceProgram;
+  std::unique_ptr<VolumeMeshSlice> slice;
 
   // Helpers
   virtual void createProgram() = 0;
@@ -39,16 +41,24 @@ public:
   VolumeMeshVertexColorQuantity(std::string name, std::vector<glm::vec3> values_, VolumeMesh& mesh_);
 
   virtual void createProgram() override;
-  virtual std::shared_ptr<render::ShaderProgram> createSliceProgram() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual std::unique_ptr<VolumeMeshSlice> createSlice() override;
   void fillSliceColorBuffers(render::ShaderProgram& p);
   void fillColorBuffers(render::ShaderProgram& p);
-
-  virtual void drawSlice(polyscope::SlicePlane *sp) override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
 
   void buildVertexInfoGUI(size_t vInd) override;
 
+  // Replace the colors, which must be as many as before. The programs are made again with the new colors.
+  template <class T>
+  VolumeMeshVertexColorQuantity* updateData(const T& newColors);
+
   // === Members
   std::vector<glm::vec3> values;
+
+private:
+  std::shared_ptr<render::TextureBuffer> vertexColorTexture; // one texel per vertex, for the slice program
 };
 
 // ========================================================
@@ -60,12 +70,42 @@ public:
   VolumeMeshCellColorQuantity(std::string name, std::vector<glm::vec3> values_, VolumeMesh& mesh_);
 
   virtual void createProgram() override;
+  virtual size_t hostMemoryUsage() override;
+  virtual std::unique_ptr<VolumeMeshSlice> createSlice() override;
   void fillColorBuffers(render::ShaderProgram& p);
+  std::shared_ptr<render::TextureBuffer> getCellColorTexture(); // one texel per cell, for both programs
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
 
   void buildCellInfoGUI(size_t cInd) override;
 
+  // Replace the colors, which must be as many as before. The programs are made again with the new colors.
+  template <class T>
+  VolumeMeshCellColorQuantity* updateData(const T& newColors);
+
   // === Members
   std::vector<glm::vec3> values;
+
+private:
+  std::shared_ptr<render::TextureBuffer> cellColorTexture;
 };
 
+template <class T>
+VolumeMeshVertexColorQuantity* VolumeMeshVertexColorQuantity::updateData(const T& newColors) {
+  validateSize(newColors, values.size(), "volume mesh vertex color quantity " + name);
+  values = standardizeVectorArray<glm::vec3, 3>(newColors);
+  dataUpdated();
+  requestRedraw();
+  return this;
+}
+
+template <class T>
+VolumeMeshCellColorQuantity* VolumeMeshCellColorQuantity::updateData(const T& newColors) {
+  validateSize(newColors, values.size(), "volume mesh cell color quantity " + name);
+  values = standardizeVectorArray<glm::vec3, 3>(newColors);
+  dataUpdated();
+  requestRedraw();
+  return this;
+}
+
 } // namespace polyscope
@@ -3,6 +3,9 @@
 
 #include "polyscope/quantity.h"
 #include "polyscope/structure.h"
+#include "polyscope/volume_mesh_slice.h"
+
+#include <memory>
 
 
 namespace polyscope {
@@ -15,9 +18,9 @@ class VolumeMeshQuantity : public Quantity<VolumeMesh> {
 public:
   VolumeMeshQuantity(std::string name, VolumeMesh& parentStructure, bool dominates = false);
   ~VolumeMeshQuantity() {};
-  // virtual std::shared_ptr<render::ShaderProgram> tryCreateSliceProgram(){ return nullptr; }; 
-  virtual std::shared_ptr<render::ShaderProgram> createSliceProgram(){ return nullptr; };
+  virtual std::unique_ptr<VolumeMeshSlice> createSlice() { return nullptr; };
   virtual void drawSlice(polyscope::SlicePlane *sp){};
+  virtual void removeSlicePlane(polyscope::SlicePlane* sp){}; // sp no longer inspects the mesh
 
 public:
   // Build GUI info about this element
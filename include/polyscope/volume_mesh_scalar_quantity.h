@@ -7,6 +7,9 @@
 #include "polyscope/render/engine.h"
 #include "polyscope/scalar_quantity.h"
 #include "polyscope/volume_mesh.h"
+#include "polyscope/volume_mesh_tet_bvh.h"
+
+#include <deque>
 
 namespace polyscope {
 
@@ -16,6 +19,9 @@ public:
                         DataType dataType);
 
   virtual void draw() override;
+  virtual void drawSlice(polyscope::SlicePlane* sp) override;
+  virtual void removeSlicePlane(polyscope::SlicePlane* sp) override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
   virtual std::string niceName() override;
   virtual void refresh() override;
@@ -23,7 +29,7 @@ public:
 protected:
   const std::string definedOn;
   std::shared_ptr<render::ShaderProgram> program;
-  std::shared_ptr<render::ShaderProgram> sliceProgram;
+  std::unique_ptr<VolumeMeshSlice> slice;
 
   // Helpers
   virtual void createProgram() = 0;
@@ -39,9 +45,8 @@ public:
                               DataType dataType_ = DataType::STANDARD);
 
   virtual void createProgram() override;
-  virtual std::shared_ptr<render::ShaderProgram> createSliceProgram() override;
+  virtual std::unique_ptr<VolumeMeshSlice> createSlice() override;
   virtual void draw() override;
-  virtual void drawSlice(polyscope::SlicePlane *sp) override;
 
 
   void setLevelSetValue(float f);
@@ -54,15 +59,36 @@ public:
   void fillColorBuffers(render::ShaderProgram& p);
 
   void fillSliceColorBuffers(render::ShaderProgram& p);
+  std::shared_ptr<render::TextureBuffer> getVertexValueTexture(); // one texel per vertex, for slice programs
 
   virtual void buildCustomUI() override;
   void buildVertexInfoGUI(size_t vInd) override;
   virtual void refresh() override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+  virtual size_t hostMemoryUsage() override;
 
   float levelSetValue;
   bool isDrawingLevelSet;
   VolumeMeshVertexScalarQuantity* showQuantity;
 
+private:
+  std::shared_ptr<render::TextureBuffer> vertexValueTexture;
+  std::shared_ptr<render::TextureBuffer> levelSetShownTexture; // values of showQuantity, held while levelSetProgram
+                                                               // samples them
+  std::shared_ptr<render::ShaderProgram> createLevelSetProgram(VolumeMeshVertexScalarQuantity& shown);
+
+  // Level sets draw only the tets which straddle levelSetValue, found with a hierarchy over the values as points
+  // (value, 0, 0), the way the shader slices them. Selections for recent values are kept, most recent first (see
+  // options::levelSetSelectionCacheSize).
+  struct LevelSetSelection {
+    float value;
+    std::array<std::shared_ptr<render::AttributeBuffer>, 4> tetVertexBuffers;
+  };
+  std::vector<glm::vec3> levelSetValuePoints;
+  std::unique_ptr<VolumeMeshTetBVH> levelSetBVH;
+  std::deque<LevelSetSelection> levelSetSelections;
+  void setLevelSetTetBuffers(render::ShaderProgram& p);
 
 };
 
@@ -77,10 +103,17 @@ public:
                             DataType dataType_ = DataType::STANDARD);
 
   virtual void createProgram() override;
+  virtual std::unique_ptr<VolumeMeshSlice> createSlice() override;
 
   void fillColorBuffers(render::ShaderProgram& p);
+  std::shared_ptr<render::TextureBuffer> getCellValueTexture(); // one texel per cell, for both programs
 
   void buildCellInfoGUI(size_t fInd) override;
+  virtual void releaseRenderData() override;
+  virtual void dataUpdated() override;
+
+private:
+  std::shared_ptr<render::TextureBuffer> cellValueTexture;
 };
 
 
@@ -0,0 +1,68 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/render/engine.h"
+
+#include "glm/glm.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace polyscope {
+
+class SlicePlane;
+class VolumeMesh;
+
+// The cross-section of a volume mesh with the slice planes which inspect it, cut once for each pose of a plane and
+// drawn from then on as plain triangles. The capture program runs the SLICE_TETS stages over the tets the plane crosses
+// and records the triangles they emit (see ShaderProgram::capture()); the draw program draws those, so moving the camera
+// alone never cuts the tets again.
+//
+// A slice shows one thing (the base color, or a quantity), so its owner makes it with the rules for that: captureRules
+// propagate a value to record with SLICE_TETS_CAPTURE_VALUE or SLICE_TETS_CAPTURE_VECTOR, or are empty to record only
+// positions; drawRules shade the recorded value. The owner sets the textures and uniforms of both programs, and drops
+// the slice whenever the mesh or its data change, as it would an uncached slice program.
+class VolumeMeshSlice {
+public:
+  VolumeMeshSlice(VolumeMesh& mesh, const std::vector<std::string>& captureRules,
+                  const std::vector<std::string>& drawRules, std::shared_ptr<render::GPUMemoryAccount> account);
+
+  render::ShaderProgram& getCaptureProgram() { return *captureProgram; }
+  render::ShaderProgram& getDrawProgram() { return *drawProgram; }
+
+  // Draw the slice by sp, cutting it again first if sp has moved since the last time
+  void draw(SlicePlane* sp);
+
+  // Drop the triangles for sp, which no longer inspects the mesh
+  void removePlane(const SlicePlane* sp);
+
+private:
+  VolumeMesh& mesh;
+  std::shared_ptr<render::ShaderProgram> captureProgram;
+  std::shared_ptr<render::ShaderProgram> drawProgram;
+  std::shared_ptr<render::GPUMemoryAccount> account;
+  bool capturesValue;
+
+  // The triangles for each plane, with the pose they were cut at. The number of triangles in a cut arrives from the
+  // GPU a frame or so later, so each plane cuts in to a second set of buffers and keeps drawing the last finished cut
+  // until then. Buffers grow to fit the most triangles the tets crossing the plane could emit.
+  struct CaptureBuffers {
+    glm::vec3 normal;
+    float offset;
+    std::shared_ptr<render::AttributeBuffer> positions;
+    std::shared_ptr<render::AttributeBuffer> values;
+  };
+  struct Capture {
+    CaptureBuffers drawn;
+    long int nVertices = -1; // in drawn, not captured yet
+    CaptureBuffers cutting;
+    std::shared_ptr<render::PendingCapture> pending; // the count for cutting, while a cut is in flight
+  };
+  std::map<const SlicePlane*, Capture> captures;
+  CaptureBuffers generateBuffers();
+  void recapture(SlicePlane* sp, Capture& capture);
+};
+
+} // namespace polyscope
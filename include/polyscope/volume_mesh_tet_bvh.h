@@ -0,0 +1,45 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#pragma once
+
+#include "polyscope/element_bvh.h"
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace polyscope {
+
+// A bounding volume hierarchy over the tets of a volume mesh, used to slice it: a slice plane only passes through the
+// tets of the leaves it crosses, so finding them costs about the size of the cross-section rather than the volume.
+//
+// The vertex points need not be positions: level sets slice by points (value, 0, 0), as the slice shader does.
+//
+// This is an ElementBVH over the bounding boxes of the tets, with larger leaves since a plane crosses many tets at once.
+// Tets are referred to by their index in the original array, which must have fewer than 2^32 entries.
+class VolumeMeshTetBVH {
+public:
+  VolumeMeshTetBVH(const std::vector<glm::vec3>& vertices, const std::vector<std::array<uint32_t, 4>>& tets);
+
+  // Indices of the tets which have vertices on both sides of (or on) the plane {x : dot(normal, x) = offset}. May
+  // include a few which only come within rounding error of it. The mesh must be the one the hierarchy was built from.
+  std::vector<uint32_t> tetsCrossingPlane(const std::vector<glm::vec3>& vertices,
+                                          const std::vector<std::array<uint32_t, 4>>& tets, glm::vec3 normal,
+                                          float offset) const;
+
+  size_t nNodes() const { return bvh.nNodes(); }
+  size_t allocatedBytes() const { return bvh.allocatedBytes(); }
+
+  static const size_t tetsPerLeaf = 32;
+
+private:
+  ElementBVH bvh;
+  float slack = 0.; // distance from the plane within which tets are kept, to cover rounding on the GPU
+
+  static ElementBVH buildHierarchy(const std::vector<glm::vec3>& vertices,
+                                   const std::vector<std::array<uint32_t, 4>>& tets);
+};
+
+} // namespace polyscope
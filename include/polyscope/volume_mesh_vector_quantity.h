@@ -19,7 +19,9 @@ public:
                            VectorType vectorType_ = VectorType::STANDARD);
 
   virtual void draw() override;
+  virtual size_t hostMemoryUsage() override;
   virtual void buildCustomUI() override;
+  virtual void dataUpdated() override;
 
   // Allow children to append to the UI
   virtual void drawSubUI();
@@ -31,8 +33,7 @@ public:
   const VectorType vectorType;
 
   // The actual data
-  std::vector<glm::vec3> vectors;
-  std::vector<glm::vec3> vectorRoots;
+  std::vector<glm::vec3> vectors; // (drawn from the mesh's buffer of element positions)
 
   // === Option accessors
 
@@ -55,7 +56,8 @@ public:
 protected:
   // Manages _actually_ drawing the vectors, generating gui.
   std::unique_ptr<VectorArtist> vectorArtist;
-  void prepareVectorArtist();
+  // Draw from the mesh's buffer of element positions, see VolumeMesh::getVertexPositionBuffer()
+  void prepareVectorArtist(std::shared_ptr<render::AttributeBuffer> rootBuffer);
 
   VolumeMeshElement definedOn;
 };
@@ -71,6 +73,11 @@ public:
   virtual void refresh() override;
   virtual std::string niceName() override;
   virtual void buildVertexInfoGUI(size_t vInd) override;
+
+  // Replace the vectors, one per vertex as before. The programs and options are kept; the vector buffers are rewritten
+  // and the vectors scaled by their new longest length.
+  template <class T>
+  VolumeMeshVertexVectorQuantity* updateData(const T& newVectors);
 };
 
 
@@ -84,7 +91,28 @@ public:
   virtual void refresh() override;
   virtual std::string niceName() override;
   virtual void buildCellInfoGUI(size_t cInd) override;
+
+  // Replace the vectors, one per cell as before. The programs and options are kept; the vector buffers are rewritten
+  // and the vectors scaled by their new longest length.
+  template <class T>
+  VolumeMeshCellVectorQuantity* updateData(const T& newVectors);
 };
 
+template <class T>
+VolumeMeshVertexVectorQuantity* VolumeMeshVertexVectorQuantity::updateData(const T& newVectors) {
+  validateSize(newVectors, vectors.size(), "volume mesh vertex vector quantity " + name);
+  vectors = standardizeVectorArray<glm::vec3, 3>(newVectors);
+  dataUpdated();
+  return this;
+}
+
+template <class T>
+VolumeMeshCellVectorQuantity* VolumeMeshCellVectorQuantity::updateData(const T& newVectors) {
+  validateSize(newVectors, vectors.size(), "volume mesh cell vector quantity " + name);
+  vectors = standardizeVectorArray<glm::vec3, 3>(newVectors);
+  dataUpdated();
+  return this;
+}
+
 
 } // namespace polyscope
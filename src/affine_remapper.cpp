@@ -0,0 +1,134 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/affine_remapper.h"
+
+#include "polyscope/parallel.h"
+#include "polyscope/utilities.h"
+
+#include <cstdint>
+#include <limits>
+#include <mutex>
+
+namespace polyscope {
+
+namespace {
+
+// Large enough blocks amortize the per-block bookkeeping below
+const size_t reductionBlockSize = 1 << 16;
+
+template <typename T>
+std::pair<T, T> robustMinMaxScalar(const std::vector<T>& data, T rangeEPS) {
+  const T inf = std::numeric_limits<T>::infinity();
+  std::pair<T, T> minMax = parallelReduce(
+      0, data.size(), std::make_pair(inf, -inf),
+      [&](size_t blockStart, size_t blockEnd) {
+        // No branches, so that the loop vectorizes: non-finite values are swapped for the identity of each reduction
+        // (x - x is 0 exactly when x is finite)
+        T blockMin = inf;
+        T blockMax = -inf;
+        for (size_t i = blockStart; i < blockEnd; i++) {
+          T x = data[i];
+          bool finite = (x - x) == 0;
+          blockMin = std::min(blockMin, finite ? x : inf);
+          blockMax = std::max(blockMax, finite ? x : -inf);
+        }
+        return std::make_pair(blockMin, blockMax);
+      },
+      [](std::pair<T, T> a, std::pair<T, T> b) {
+        return std::make_pair(std::min(a.first, b.first), std::max(a.second, b.second));
+      },
+      reductionBlockSize);
+  T minVal = minMax.first;
+  T maxVal = minMax.second;
+
+  if (!(minVal <= maxVal)) { // empty, or nothing finite
+    return std::pair<T, T>(-1, 1);
+  }
+  T maxMag = std::max(std::abs(minVal), std::abs(maxVal));
+
+  // Hack to do less ugly things when constants (or near-constant) are passed in
+  if (maxMag < rangeEPS) {
+    maxVal = rangeEPS;
+    minVal = -rangeEPS;
+  } else if ((maxVal - minVal) / maxMag < rangeEPS) {
+    T mid = (minVal + maxVal) / 2;
+    maxVal = mid + maxMag * rangeEPS;
+    minVal = mid - maxMag * rangeEPS;
+  }
+
+  return std::make_pair(minVal, maxVal);
+}
+
+const size_t nPercentileBins = 1 << 16; // the high 16 bits of each key
+
+template <typename T>
+std::pair<double, double> approximatePercentileRangeImpl(const std::vector<T>& data, double lowPercentile,
+                                                         double highPercentile) {
+  const float floatMax = std::numeric_limits<float>::max();
+  std::vector<uint64_t> counts(nPercentileBins, 0);
+  std::mutex countsMutex;
+  parallelForBlocks(
+      0, data.size(),
+      [&](size_t blockStart, size_t blockEnd) {
+        std::vector<uint32_t> blockCounts(nPercentileBins, 0);
+        for (size_t i = blockStart; i < blockEnd; i++) {
+          T x = data[i];
+          if (!((x - x) == 0)) continue; // not finite
+          float xf = static_cast<float>(std::max<T>(-floatMax, std::min<T>(floatMax, x)));
+          blockCounts[floatOrderKey(xf) >> 16]++;
+        }
+        std::lock_guard<std::mutex> lock(countsMutex);
+        for (size_t b = 0; b < nPercentileBins; b++) {
+          counts[b] += blockCounts[b];
+        }
+      },
+      reductionBlockSize);
+
+  uint64_t total = 0;
+  for (uint64_t c : counts) total += c;
+  if (total == 0) {
+    return std::make_pair(-1., 1.);
+  }
+
+  // The value below which the given fraction of the data lies, interpolating linearly within its bin
+  auto valueAtFraction = [&](double fraction) {
+    double target = std::max(0., std::min(1., fraction)) * total;
+    double cumulative = 0.;
+    size_t lastOccupied = 0;
+    for (size_t b = 0; b < nPercentileBins; b++) {
+      if (counts[b] == 0) continue;
+      lastOccupied = b;
+      if (cumulative + counts[b] >= target) {
+        double t = (target - cumulative) / counts[b];
+        double binLow = floatFromOrderKey(static_cast<uint32_t>(b << 16));
+        double binHigh = floatFromOrderKey(static_cast<uint32_t>((b << 16) | 0xFFFFu));
+        return binLow + t * (binHigh - binLow);
+      }
+      cumulative += counts[b];
+    }
+    return static_cast<double>(floatFromOrderKey(static_cast<uint32_t>((lastOccupied << 16) | 0xFFFFu)));
+  };
+
+  return std::make_pair(valueAtFraction(lowPercentile / 100.), valueAtFraction(highPercentile / 100.));
+}
+
+} // namespace
+
+std::pair<float, float> robustMinMax(const std::vector<float>& data, float rangeEPS) {
+  return robustMinMaxScalar(data, rangeEPS);
+}
+
+std::pair<double, double> robustMinMax(const std::vector<double>& data, double rangeEPS) {
+  return robustMinMaxScalar(data, rangeEPS);
+}
+
+std::pair<double, double> approximatePercentileRange(const std::vector<float>& data, double lowPercentile,
+                                                     double highPercentile) {
+  return approximatePercentileRangeImpl(data, lowPercentile, highPercentile);
+}
+
+std::pair<double, double> approximatePercentileRange(const std::vector<double>& data, double lowPercentile,
+                                                     double highPercentile) {
+  return approximatePercentileRangeImpl(data, lowPercentile, highPercentile);
+}
+
+} // namespace polyscope
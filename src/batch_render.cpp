@@ -0,0 +1,108 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/batch_render.h"
+
+#include "polyscope/options.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/scene_snapshot.h"
+#include "polyscope/screenshot.h"
+#include "polyscope/view.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <stdexcept>
+
+namespace polyscope {
+
+namespace {
+
+double msSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+std::vector<size_t> assignRenderJobs(const std::vector<RenderJob>& jobs, int workerIndex, int nWorkers) {
+  if (nWorkers < 1 || workerIndex < 0 || workerIndex >= nWorkers) {
+    throw std::invalid_argument("render worker index " + std::to_string(workerIndex) + " is not in [0, " +
+                                std::to_string(nWorkers) + ")");
+  }
+
+  // The jobs of each scene, in order of first appearance, cut in to pieces of at most a worker's share
+  std::map<std::string, size_t> sceneGroup;
+  std::vector<std::vector<size_t>> groups;
+  for (size_t iJ = 0; iJ < jobs.size(); iJ++) {
+    std::map<std::string, size_t>::iterator it = sceneGroup.find(jobs[iJ].sceneFile);
+    if (it == sceneGroup.end()) {
+      it = sceneGroup.emplace(jobs[iJ].sceneFile, groups.size()).first;
+      groups.emplace_back();
+    }
+    groups[it->second].push_back(iJ);
+  }
+  size_t share = (jobs.size() + nWorkers - 1) / nWorkers;
+  std::vector<std::vector<size_t>> pieces;
+  for (const std::vector<size_t>& group : groups) {
+    for (size_t start = 0; start < group.size(); start += share) {
+      size_t end = std::min(start + share, group.size());
+      pieces.emplace_back(group.begin() + start, group.begin() + end);
+    }
+  }
+
+  // Largest pieces first, each to the worker with the fewest jobs so far (the first such worker on ties)
+  std::stable_sort(pieces.begin(), pieces.end(),
+                   [](const std::vector<size_t>& a, const std::vector<size_t>& b) { return a.size() > b.size(); });
+  std::vector<size_t> load(nWorkers, 0);
+  std::vector<size_t> assigned;
+  for (const std::vector<size_t>& piece : pieces) {
+    size_t w = std::min_element(load.begin(), load.end()) - load.begin();
+    load[w] += piece.size();
+    if (static_cast<int>(w) == workerIndex) assigned.insert(assigned.end(), piece.begin(), piece.end());
+  }
+  return assigned;
+}
+
+std::vector<RenderJobTiming> renderJobs(const std::vector<RenderJob>& jobs, int workerIndex, int nWorkers) {
+  std::vector<size_t> assigned = assignRenderJobs(jobs, workerIndex, nWorkers);
+
+  bool wasAsync = options::asyncScreenshots;
+  options::asyncScreenshots = true;
+
+  std::vector<RenderJobTiming> timings;
+  std::string loadedScene;
+  for (size_t iJ : assigned) {
+    const RenderJob& job = jobs[iJ];
+    RenderJobTiming timing;
+    timing.jobIndex = iJ;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!job.sceneFile.empty() && job.sceneFile != loadedScene) {
+      removeAllStructures();
+      loadedScene = "";
+      try {
+        loadScene(job.sceneFile);
+      } catch (const std::runtime_error& e) {
+        timing.error = e.what();
+        timings.push_back(timing);
+        continue;
+      }
+      loadedScene = job.sceneFile;
+      timing.loadMs = msSince(start);
+    }
+
+    start = std::chrono::steady_clock::now();
+    if (!job.cameraJson.empty()) view::setCameraFromJson(job.cameraJson, false);
+    if (job.setup) job.setup();
+    timing.setupMs = msSince(start);
+
+    start = std::chrono::steady_clock::now();
+    screenshot(job.outputFile, job.transparentBG);
+    timing.renderMs = msSince(start);
+    timings.push_back(timing);
+  }
+
+  flushScreenshots();
+  options::asyncScreenshots = wasAsync;
+  return timings;
+}
+
+} // namespace polyscope
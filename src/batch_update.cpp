@@ -0,0 +1,90 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/batch_update.h"
+
+#include "polyscope/parallel.h"
+#include "polyscope/polyscope.h"
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace polyscope {
+
+namespace {
+
+struct DeferredPreprocessing {
+  const void* owner;
+  std::function<void()> work;
+  std::function<void()> finish;
+};
+
+int batchDepth = 0;
+std::vector<DeferredPreprocessing> deferred;
+
+} // namespace
+
+void beginBatch() { batchDepth++; }
+
+void endBatch() {
+  if (batchDepth == 0) {
+    throw std::logic_error("endBatch() called without a matching beginBatch()");
+  }
+  batchDepth--;
+  if (batchDepth == 0) {
+    batch::runAllDeferred();
+  }
+}
+
+bool isInBatch() { return batchDepth > 0; }
+
+namespace batch {
+
+void runOrDefer(const void* owner, std::function<void()> work, std::function<void()> finish) {
+  if (batchDepth == 0) {
+    work();
+    finish();
+    return;
+  }
+  deferred.push_back(DeferredPreprocessing{owner, std::move(work), std::move(finish)});
+}
+
+void runDeferred(const void* owner) {
+  for (size_t i = 0; i < deferred.size(); i++) {
+    if (deferred[i].owner == owner) {
+      DeferredPreprocessing job = std::move(deferred[i]);
+      deferred.erase(deferred.begin() + i);
+      job.work();
+      job.finish();
+      return;
+    }
+  }
+}
+
+void cancelDeferred(const void* owner) {
+  for (size_t i = 0; i < deferred.size(); i++) {
+    if (deferred[i].owner == owner) {
+      deferred.erase(deferred.begin() + i);
+      return;
+    }
+  }
+}
+
+void runAllDeferred() {
+  if (deferred.empty()) return;
+
+  // Take the queue first, finish() may register more (which then runs immediately or is queued anew)
+  std::vector<DeferredPreprocessing> jobs;
+  std::swap(jobs, deferred);
+
+  // Each job is large (a pass over one quantity's data), so hand them out one at a time; the parallel loops inside a
+  // job run inline on the thread it landed on.
+  parallelFor(0, jobs.size(), [&](size_t i) { jobs[i].work(); }, 1);
+  for (DeferredPreprocessing& job : jobs) {
+    job.finish();
+  }
+
+  requestRedraw();
+}
+
+} // namespace batch
+} // namespace polyscope
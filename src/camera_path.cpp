@@ -0,0 +1,193 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/camera_path.h"
+
+#include "polyscope/polyscope.h"
+#include "polyscope/screenshot.h"
+#include "polyscope/view.h"
+
+#include "glm/gtc/quaternion.hpp"
+#define GLM_ENABLE_EXPERIMENTAL
+#include "glm/gtx/quaternion.hpp"
+#undef GLM_ENABLE_EXPERIMENTAL
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+namespace polyscope {
+
+namespace {
+
+// Cubic Hermite interpolation on [t0, t1] with tangents m0, m1 (per unit time)
+template <typename T>
+T hermite(const T& p0, const T& m0, const T& p1, const T& m1, double t0, double t1, double t) {
+  float h = static_cast<float>(t1 - t0);
+  float s = static_cast<float>((t - t0) / (t1 - t0));
+  float s2 = s * s;
+  float s3 = s2 * s;
+  return (2.f * s3 - 3.f * s2 + 1.f) * p0 + (s3 - 2.f * s2 + s) * h * m0 + (-2.f * s3 + 3.f * s2) * p1 +
+         (s3 - s2) * h * m1;
+}
+
+// Catmull-Rom tangent at keyframe i, from the differences to its neighbors (one-sided at the ends)
+template <typename T>
+T splineTangent(const std::vector<T>& p, const std::vector<double>& t, size_t i) {
+  size_t iPrev = i == 0 ? 0 : i - 1;
+  size_t iNext = std::min(i + 1, p.size() - 1);
+  return (p[iNext] - p[iPrev]) / static_cast<float>(t[iNext] - t[iPrev]);
+}
+
+} // namespace
+
+void CameraPath::addKeyframe(const CameraParameters& camera, double time) {
+  auto it = std::lower_bound(keyframes.begin(), keyframes.end(), time,
+                             [](const Keyframe& k, double t) { return k.time < t; });
+  if (it != keyframes.end() && it->time == time) {
+    it->camera = camera;
+  } else {
+    keyframes.insert(it, Keyframe{camera, time});
+  }
+}
+
+void CameraPath::addCurrentViewAsKeyframe(double time) {
+  CameraParameters camera;
+  camera.E = view::viewMat;
+  camera.fov = view::fov;
+  addKeyframe(camera, time);
+}
+
+double CameraPath::getDuration() const { return keyframes.empty() ? 0. : keyframes.back().time; }
+
+CameraParameters CameraPath::evaluate(double time) const {
+  if (keyframes.empty()) return CameraParameters();
+  if (keyframes.size() == 1 || time <= keyframes.front().time) return keyframes.front().camera;
+  if (time >= keyframes.back().time) return keyframes.back().camera;
+
+  // The keyframe splines. Orientations are flipped to the same hemisphere as the previous ones, so that each segment
+  // turns the short way.
+  size_t n = keyframes.size();
+  std::vector<double> times(n);
+  std::vector<glm::vec3> positions(n);
+  std::vector<float> fovs(n);
+  std::vector<glm::quat> rotations(n);
+  for (size_t i = 0; i < n; i++) {
+    times[i] = keyframes[i].time;
+    positions[i] = keyframes[i].camera.getPosition();
+    fovs[i] = keyframes[i].camera.fov;
+    rotations[i] = glm::quat_cast(keyframes[i].camera.getR());
+    if (i > 0 && glm::dot(rotations[i], rotations[i - 1]) < 0.f) rotations[i] = -rotations[i];
+  }
+
+  // The segment holding the time
+  size_t i = std::upper_bound(times.begin(), times.end(), time) - times.begin() - 1;
+  double t0 = times[i];
+  double t1 = times[i + 1];
+
+  glm::vec3 position = hermite(positions[i], splineTangent(positions, times, i), positions[i + 1],
+                               splineTangent(positions, times, i + 1), t0, t1, time);
+  float fov = hermite(fovs[i], splineTangent(fovs, times, i), fovs[i + 1], splineTangent(fovs, times, i + 1), t0, t1,
+                      time);
+
+  glm::quat q0 = rotations[i];
+  glm::quat q1 = rotations[i + 1];
+  glm::quat a0 = glm::intermediate(rotations[i == 0 ? 0 : i - 1], q0, q1);
+  glm::quat a1 = glm::intermediate(q0, q1, rotations[std::min(i + 2, n - 1)]);
+  glm::quat rotation = glm::normalize(glm::squad(q0, q1, a0, a1, static_cast<float>((time - t0) / (t1 - t0))));
+
+  CameraParameters result;
+  glm::mat3 R = glm::mat3_cast(rotation);
+  result.E = glm::mat4(R);
+  glm::vec3 T = -R * position;
+  result.E[3] = glm::vec4(T, 1.);
+  result.fov = fov;
+  return result;
+}
+
+// === Playback
+
+namespace {
+
+struct CameraPathPlaybackState {
+  CameraPath path;
+  CameraPathPlayback mode;
+  double fps;
+  bool recording;
+  std::chrono::steady_clock::time_point startTime;
+  size_t frame = 0;
+  double time = 0.;
+  bool reachedEnd = false;
+};
+std::unique_ptr<CameraPathPlaybackState> playback;
+FrameStats lastPlaybackStats;
+
+} // namespace
+
+void playCameraPath(const CameraPath& path, CameraPathPlayback mode, double fps, std::string recordTo) {
+  if (fps <= 0.) {
+    error("camera path playback fps must be positive");
+    return;
+  }
+  stopCameraPath();
+
+  view::immediatelyEndFlight();
+  resetFrameStats();
+  if (!recordTo.empty()) startRecording(recordTo, fps);
+
+  playback.reset(new CameraPathPlaybackState());
+  playback->path = path;
+  playback->mode = mode;
+  playback->fps = fps;
+  playback->recording = !recordTo.empty();
+  playback->startTime = std::chrono::steady_clock::now();
+  requestRedraw();
+}
+
+void stopCameraPath() {
+  if (!playback) return;
+  lastPlaybackStats = getFrameStats();
+  bool wasRecording = playback->recording;
+  playback.reset();
+  if (wasRecording) stopRecording();
+}
+
+bool isPlayingCameraPath() { return playback != nullptr; }
+
+double getCameraPathTime() { return playback ? playback->time : 0.; }
+
+size_t getCameraPathFrame() { return playback ? playback->frame : 0; }
+
+FrameStats getCameraPathFrameStats() { return lastPlaybackStats; }
+
+void updateCameraPath() {
+  if (!playback) return;
+  CameraPathPlaybackState& p = *playback;
+
+  // (the last frame has been drawn)
+  if (p.reachedEnd) {
+    stopCameraPath();
+    return;
+  }
+
+  double duration = p.path.getDuration();
+  double t;
+  if (p.mode == CameraPathPlayback::FixedStep) {
+    t = p.frame / p.fps;
+    if (t > duration + 1e-9) {
+      stopCameraPath();
+      return;
+    }
+  } else {
+    t = std::chrono::duration<double>(std::chrono::steady_clock::now() - p.startTime).count();
+    if (t >= duration) {
+      t = duration; // end exactly at the last keyframe
+      p.reachedEnd = true;
+    }
+  }
+
+  view::setViewToCamera(p.path.evaluate(t));
+  p.time = t;
+  p.frame++;
+  requestRedraw();
+}
+
+} // namespace polyscope
@@ -0,0 +1,55 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/command_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
+#include <vector>
+
+namespace polyscope {
+
+namespace {
+
+struct QueuedCommand {
+  std::function<void()> command;
+  std::string coalesceKey;
+  QueuedCommand* next;
+};
+
+// The queue is a lock-free stack which producers push on to, and which the main thread takes whole and reverses
+std::atomic<QueuedCommand*> queueHead{nullptr};
+
+} // namespace
+
+void queueCommand(std::function<void()> command, std::string coalesceKey) {
+  QueuedCommand* node = new QueuedCommand{std::move(command), std::move(coalesceKey), nullptr};
+  node->next = queueHead.load(std::memory_order_relaxed);
+  while (!queueHead.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+}
+
+void runQueuedCommands() {
+  QueuedCommand* head = queueHead.exchange(nullptr, std::memory_order_acquire);
+  if (head == nullptr) return;
+
+  // Newest first, as taken
+  std::vector<std::unique_ptr<QueuedCommand>> commands;
+  for (QueuedCommand* node = head; node != nullptr; node = node->next) {
+    commands.emplace_back(node);
+  }
+
+  // Keep the newest command of each key
+  std::unordered_set<std::string> seenKeys;
+  for (std::unique_ptr<QueuedCommand>& c : commands) {
+    if (!c->coalesceKey.empty() && !seenKeys.insert(c->coalesceKey).second) {
+      c->command = nullptr;
+    }
+  }
+
+  std::reverse(commands.begin(), commands.end());
+  for (std::unique_ptr<QueuedCommand>& c : commands) {
+    if (c->command) c->command();
+  }
+}
+
+} // namespace polyscope
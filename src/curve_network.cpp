@@ -7,6 +7,7 @@
 
 #include "imgui.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -22,7 +23,8 @@ const std::string CurveNetwork::structureTypeName = "Curve Network";
 CurveNetwork::CurveNetwork(std::string name, std::vector<glm::vec3> nodes_, std::vector<std::array<size_t, 2>> edges_)
     : QuantityStructure<CurveNetwork>(name, typeName()), nodes(std::move(nodes_)), edges(std::move(edges_)),
       color(uniquePrefix() + "#color", getNextUniqueColor()), radius(uniquePrefix() + "#radius", relativeValue(0.005)),
-      material(uniquePrefix() + "#material", "clay")
+      material(uniquePrefix() + "#material", "clay"), curveRenderMode(uniquePrefix() + "#curveRenderMode", "cylinders"),
+      lodEnabled(uniquePrefix() + "lodEnabled", false)
 
 {
 
@@ -50,21 +52,37 @@ CurveNetwork::CurveNetwork(std::string name, std::vector<glm::vec3> nodes_, std:
 }
 
 
+namespace {
+
+// The uniforms the node and edge programs are given every frame, looked up once for each program (see
+// ShaderProgram::userData()). Those a program does not have are invalid.
+struct CurveNetworkUniformHandles {
+  CurveNetworkUniformHandles(render::ShaderProgram& p)
+      : invProjMatrix(p.getUniformHandle("u_invProjMatrix")), viewport(p.getUniformHandle("u_viewport")),
+        pointRadius(p.getUniformHandle("u_pointRadius")), radius(p.getUniformHandle("u_radius")) {}
+
+  render::ShaderUniformHandle invProjMatrix, viewport, pointRadius, radius;
+};
+
+} // namespace
+
 // Helper to set uniforms
 void CurveNetwork::setCurveNetworkNodeUniforms(render::ShaderProgram& p) {
+  const CurveNetworkUniformHandles& h = p.userData<CurveNetworkUniformHandles>();
   glm::mat4 P = view::getCameraPerspectiveMatrix();
   glm::mat4 Pinv = glm::inverse(P);
-  p.setUniform("u_invProjMatrix", glm::value_ptr(Pinv));
-  p.setUniform("u_viewport", render::engine->getCurrentViewport());
-  p.setUniform("u_pointRadius", getRadius());
+  p.setUniform(h.invProjMatrix, glm::value_ptr(Pinv));
+  p.setUniform(h.viewport, render::engine->getCurrentViewport());
+  p.setUniform(h.pointRadius, getRadius());
 }
 
 void CurveNetwork::setCurveNetworkEdgeUniforms(render::ShaderProgram& p) {
+  const CurveNetworkUniformHandles& h = p.userData<CurveNetworkUniformHandles>();
   glm::mat4 P = view::getCameraPerspectiveMatrix();
   glm::mat4 Pinv = glm::inverse(P);
-  p.setUniform("u_invProjMatrix", glm::value_ptr(Pinv));
-  p.setUniform("u_viewport", render::engine->getCurrentViewport());
-  p.setUniform("u_radius", getRadius());
+  p.setUniform(h.invProjMatrix, glm::value_ptr(Pinv));
+  p.setUniform(h.viewport, render::engine->getCurrentViewport());
+  p.setUniform(h.radius, getRadius());
 }
 
 void CurveNetwork::draw() {
@@ -72,8 +90,25 @@ void CurveNetwork::draw() {
     return;
   }
 
+  flushGeometryUpdates();
+  updateLODSelection();
+
   // If there is no dominant quantity, then this class is responsible for drawing points
-  if (dominantQuantity == nullptr) {
+  if (dominantQuantity == nullptr && getCurveRenderMode() != CurveRenderMode::Cylinders) {
+
+    if (stripProgram == nullptr) {
+      prepareStrip();
+    }
+
+    setStructureUniforms(*stripProgram);
+    if (getCurveRenderMode() == CurveRenderMode::Tubes) {
+      setCurveNetworkEdgeUniforms(*stripProgram);
+    }
+    stripProgram->setUniform(stripBaseColorHandle, getColor());
+
+    stripProgram->draw();
+
+  } else if (dominantQuantity == nullptr) {
 
     // Ensure we have prepared buffers
     if (edgeProgram == nullptr || nodeProgram == nullptr) {
@@ -87,17 +122,19 @@ void CurveNetwork::draw() {
     setCurveNetworkEdgeUniforms(*edgeProgram);
     setCurveNetworkNodeUniforms(*nodeProgram);
 
-    edgeProgram->setUniform("u_baseColor", getColor());
-    nodeProgram->setUniform("u_baseColor", getColor());
+    edgeProgram->setUniform(edgeBaseColorHandle, getColor());
+    nodeProgram->setUniform(nodeBaseColorHandle, getColor());
 
-    // Draw the actual curve network
+    // Draw the actual curve network (the buffers may have room for appends past the end)
+    edgeProgram->setDrawLimit(static_cast<long int>(nDrawnEdges()));
+    nodeProgram->setDrawLimit(static_cast<long int>(nDrawnNodes()));
     edgeProgram->draw();
     nodeProgram->draw();
   }
 
   // Draw the quantities
-  for (auto& x : quantities) {
-    x.second->draw();
+  for (QuantityType* q : getEnabledQuantities()) {
+    q->drawTracked();
   }
 }
 
@@ -109,6 +146,11 @@ void CurveNetwork::drawPick() {
   // Ensure we have prepared buffers
   if (edgePickProgram == nullptr || nodePickProgram == nullptr) {
     preparePick();
+  } else if (!pickDirtyNodes.empty()) {
+    std::vector<std::pair<size_t, size_t>> nodeRanges = pickDirtyNodes.coalesced();
+    updateNodeGeometryBuffers(*nodePickProgram, nodeRanges);
+    updateEdgeGeometryBuffers(*edgePickProgram, edgeRangesForNodes(nodeRanges));
+    pickDirtyNodes.clear();
   }
 
   // Set uniforms
@@ -138,6 +180,7 @@ std::vector<std::string> CurveNetwork::addCurveNetworkEdgeRules(std::vector<std:
 }
 
 void CurveNetwork::prepare() {
+  ScopedCPUTimer timer(profilingName(), "prepare");
   if (dominantQuantity != nullptr) {
     return;
   }
@@ -146,17 +189,33 @@ void CurveNetwork::prepare() {
 
   {
     nodeProgram = render::engine->requestShader("RAYCAST_SPHERE", addCurveNetworkNodeRules({"SHADE_BASECOLOR"}));
+    nodeBaseColorHandle = nodeProgram->getUniformHandle("u_baseColor");
     render::engine->setMaterial(*nodeProgram, getMaterial());
   }
 
   {
     edgeProgram = render::engine->requestShader("RAYCAST_CYLINDER", addCurveNetworkEdgeRules({"SHADE_BASECOLOR"}));
+    edgeBaseColorHandle = edgeProgram->getUniformHandle("u_baseColor");
     render::engine->setMaterial(*edgeProgram, getMaterial());
   }
 
   // Fill out the geometry data for the programs
-  fillNodeGeometryBuffers(*nodeProgram);
-  fillEdgeGeometryBuffers(*edgeProgram);
+  fillNodeGeometryBuffers(*nodeProgram, true);
+  fillEdgeGeometryBuffers(*edgeProgram, true);
+}
+
+void CurveNetwork::prepareStrip() {
+  ScopedCPUTimer timer(profilingName(), "prepare");
+
+  if (getCurveRenderMode() == CurveRenderMode::Tubes) {
+    stripProgram = render::engine->requestShader("RAYCAST_CAPSULE", addCurveNetworkEdgeRules({"SHADE_BASECOLOR"}));
+  } else {
+    stripProgram = render::engine->requestShader("CURVE_LINES", addCurveNetworkEdgeRules({"SHADE_BASECOLOR"}));
+  }
+  stripBaseColorHandle = stripProgram->getUniformHandle("u_baseColor");
+  render::engine->setMaterial(*stripProgram, getMaterial());
+
+  fillStripGeometryBuffers(*stripProgram);
 }
 
 void CurveNetwork::preparePick() {
@@ -168,104 +227,378 @@ void CurveNetwork::preparePick() {
 
   // Request pick indices
   size_t totalPickElements = nNodes() + nEdges();
+  pick::releasePickBufferRanges(this); // (the range from the last time the pick program was built)
   size_t pickStart = pick::requestPickBufferRange(this, totalPickElements);
+  pickDirtyNodes.clear();
+
+  // (the pick colors are computed in the shaders from the element indices, so only the geometry and the end nodes of
+  // the edges are stored)
 
   { // Set up node picking program
     nodePickProgram =
-        render::engine->requestShader("RAYCAST_SPHERE", addCurveNetworkNodeRules({"SPHERE_PROPAGATE_COLOR"}),
+        render::engine->requestShader("RAYCAST_SPHERE", addCurveNetworkNodeRules({"SPHERE_PROPAGATE_PICK_ID"}),
                                       render::ShaderReplacementDefaults::Pick);
 
-    // Fill color buffer with packed point indices
-    std::vector<glm::vec3> pickColors;
-    pickColors.reserve(nNodes());
-    for (size_t i = pickStart; i < pickStart + nNodes(); i++) {
-      glm::vec3 val = pick::indToVec(i);
-      pickColors.push_back(pick::indToVec(i));
-    }
-
-
     // Store data in buffers
-    nodePickProgram->setAttribute("a_color", pickColors);
-
     fillNodeGeometryBuffers(*nodePickProgram);
+    nodePickProgram->setUniform("u_pickStart", pick::indToVec(pickStart));
   }
 
   { // Set up edge picking program
     edgePickProgram =
-        render::engine->requestShader("RAYCAST_CYLINDER", addCurveNetworkEdgeRules({"CYLINDER_PROPAGATE_PICK"}),
+        render::engine->requestShader("RAYCAST_CYLINDER", addCurveNetworkEdgeRules({"CYLINDER_PROPAGATE_PICK_ID"}),
                                       render::ShaderReplacementDefaults::Pick);
 
-    // Fill color buffer with packed node/edge indices
-    std::vector<glm::vec3> edgePickTail(nEdges());
-    std::vector<glm::vec3> edgePickTip(nEdges());
-    std::vector<glm::vec3> edgePickEdge(nEdges());
-
-    // Fill posiiton and pick index buffers
+    // Fill node index buffers
+    std::vector<uint32_t> tailInds(nEdges());
+    std::vector<uint32_t> tipInds(nEdges());
     for (size_t iE = 0; iE < nEdges(); iE++) {
-      auto& edge = edges[iE];
-      size_t eTail = std::get<0>(edge);
-      size_t eTip = std::get<1>(edge);
-
-      glm::vec3 colorValTail = pick::indToVec(pickStart + eTail);
-      glm::vec3 colorValTip = pick::indToVec(pickStart + eTip);
-      glm::vec3 colorValEdge = pick::indToVec(pickStart + nNodes() + iE);
-      edgePickTail[iE] = colorValTail;
-      edgePickTip[iE] = colorValTip;
-      edgePickEdge[iE] = colorValEdge;
+      tailInds[iE] = static_cast<uint32_t>(edges[iE][0]);
+      tipInds[iE] = static_cast<uint32_t>(edges[iE][1]);
     }
-    edgePickProgram->setAttribute("a_color_tail", edgePickTail);
-    edgePickProgram->setAttribute("a_color_tip", edgePickTip);
-    edgePickProgram->setAttribute("a_color_edge", edgePickEdge);
+    edgePickProgram->setAttribute("a_tailInd", tailInds);
+    edgePickProgram->setAttribute("a_tipInd", tipInds);
+    edgePickProgram->setUniform("u_pickStart", pick::indToVec(pickStart));
+    edgePickProgram->setUniform("u_edgePickStart", pick::indToVec(pickStart + nNodes()));
 
     fillEdgeGeometryBuffers(*edgePickProgram);
   }
 }
 
-void CurveNetwork::fillNodeGeometryBuffers(render::ShaderProgram& program) {
-  program.setAttribute("a_position", nodes);
+void CurveNetwork::fillNodeGeometryBuffers(render::ShaderProgram& program, bool withRoom) {
+  ScopedCPUTimer timer(profilingName(), "fillGeometryBuffers");
+  if (lodActive) {
+    std::vector<glm::vec3> drawnNodes(lodSelection.nodes.size());
+    for (size_t i = 0; i < drawnNodes.size(); i++) drawnNodes[i] = nodes[lodSelection.nodes[i]];
+    program.setAttribute("a_position", drawnNodes);
+    return;
+  }
+  setNodePositions(program, withRoom);
+}
+
+void CurveNetwork::setNodePositions(render::ShaderProgram& program, bool withRoom) {
+  if (withRoom && nodeCapacity > nNodes()) {
+    std::vector<glm::vec3> paddedNodes(nodes);
+    paddedNodes.resize(nodeCapacity, glm::vec3(0.));
+    program.setAttribute("a_position", paddedNodes);
+  } else {
+    program.setAttribute("a_position", nodes);
+  }
 }
 
-void CurveNetwork::fillEdgeGeometryBuffers(render::ShaderProgram& program) {
+void CurveNetwork::fillEdgeGeometryBuffers(render::ShaderProgram& program, bool withRoom) {
+  ScopedCPUTimer timer(profilingName(), "fillGeometryBuffers");
 
   // Positions at either end of edges
-  std::vector<glm::vec3> posTail(nEdges());
-  std::vector<glm::vec3> posTip(nEdges());
-  for (size_t iE = 0; iE < nEdges(); iE++) {
-    auto& edge = edges[iE];
-    size_t eTail = std::get<0>(edge);
-    size_t eTip = std::get<1>(edge);
-    posTail[iE] = nodes[eTail];
-    posTip[iE] = nodes[eTip];
-  }
+  size_t bufferSize = (withRoom && !lodActive && edgeCapacity > nEdges()) ? edgeCapacity : nDrawnEdges();
+  std::vector<glm::vec3> posTail, posTip;
+  edgeEndPositions(0, nDrawnEdges(), posTail, posTip);
+  posTail.resize(bufferSize, glm::vec3(0.));
+  posTip.resize(bufferSize, glm::vec3(0.));
   program.setAttribute("a_position_tail", posTail);
   program.setAttribute("a_position_tip", posTip);
 }
 
+void CurveNetwork::fillStripGeometryBuffers(render::ShaderProgram& program) {
+  ScopedCPUTimer timer(profilingName(), "fillGeometryBuffers");
+  setNodePositions(program, true); // (only the indexed nodes are drawn, so a simplification only changes the index)
+  setStripIndex(program);
+}
+
+void CurveNetwork::setStripIndex(render::ShaderProgram& program) {
+  std::vector<unsigned int> edgeInds(2 * nDrawnEdges());
+  for (size_t iE = 0; iE < nDrawnEdges(); iE++) {
+    std::array<size_t, 2> edge = drawnEdge(iE);
+    edgeInds[2 * iE + 0] = static_cast<unsigned int>(edge[0]);
+    edgeInds[2 * iE + 1] = static_cast<unsigned int>(edge[1]);
+  }
+  program.setIndex(edgeInds);
+}
+
+void CurveNetwork::updateNodeGeometryBuffers(render::ShaderProgram& program,
+                                             const std::vector<std::pair<size_t, size_t>>& nodeRanges) {
+  program.updateAttributeRanges("a_position", nodes, nodeRanges);
+}
+
+void CurveNetwork::edgeEndPositions(size_t start, size_t end, std::vector<glm::vec3>& tails,
+                                    std::vector<glm::vec3>& tips) {
+  tails.resize(end - start);
+  tips.resize(end - start);
+  for (size_t iE = start; iE < end; iE++) {
+    std::array<size_t, 2> edge = drawnEdge(iE);
+    tails[iE - start] = nodes[edge[0]];
+    tips[iE - start] = nodes[edge[1]];
+  }
+}
+
+void CurveNetwork::setNodeGeometryAttributes(render::ShaderProgram& program) {
+  if (!nodePositionBuffer) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    nodePositionBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    if (lodActive) {
+      std::vector<glm::vec3> drawnNodes(lodSelection.nodes.size());
+      for (size_t i = 0; i < drawnNodes.size(); i++) drawnNodes[i] = nodes[lodSelection.nodes[i]];
+      nodePositionBuffer->setData(drawnNodes);
+    } else {
+      nodePositionBuffer->setData(nodes);
+    }
+  }
+  program.setAttribute("a_position", nodePositionBuffer);
+}
+
+void CurveNetwork::setEdgeGeometryAttributes(render::ShaderProgram& program) {
+  if (!edgeTailBuffer || !edgeTipBuffer) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    std::vector<glm::vec3> posTail, posTip;
+    edgeEndPositions(0, nDrawnEdges(), posTail, posTip);
+    edgeTailBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    edgeTailBuffer->setData(posTail);
+    edgeTipBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    edgeTipBuffer->setData(posTip);
+  }
+  program.setAttribute("a_position_tail", edgeTailBuffer);
+  program.setAttribute("a_position_tip", edgeTipBuffer);
+}
+
+void CurveNetwork::updateEdgeGeometryBuffers(render::ShaderProgram& program,
+                                             const std::vector<std::pair<size_t, size_t>>& edgeRanges) {
+  for (const std::pair<size_t, size_t>& range : edgeRanges) {
+    size_t count = range.second - range.first;
+    std::vector<glm::vec3> posTail, posTip;
+    edgeEndPositions(range.first, range.second, posTail, posTip);
+    program.setAttribute("a_position_tail", posTail, true, static_cast<int>(range.first), static_cast<int>(count));
+    program.setAttribute("a_position_tip", posTip, true, static_cast<int>(range.first), static_cast<int>(count));
+  }
+}
+
+std::vector<std::pair<size_t, size_t>>
+CurveNetwork::edgeRangesForNodes(const std::vector<std::pair<size_t, size_t>>& nodeRanges) {
+  if (nodeRanges.size() == 1 && nodeRanges[0].first == 0 && nodeRanges[0].second >= nNodes()) {
+    return {{0, nEdges()}};
+  }
+
+  std::vector<char> nodeMoved(nNodes(), false);
+  for (const std::pair<size_t, size_t>& range : nodeRanges) {
+    std::fill(nodeMoved.begin() + range.first, nodeMoved.begin() + range.second, true);
+  }
+  DirtyRanges movedEdges;
+  for (size_t iE = 0; iE < nEdges(); iE++) {
+    if (nodeMoved[std::get<0>(edges[iE])] || nodeMoved[std::get<1>(edges[iE])]) {
+      movedEdges.mark(iE);
+    }
+  }
+  return movedEdges.coalesced();
+}
+
 void CurveNetwork::refresh() {
   nodeProgram.reset();
   edgeProgram.reset();
   nodePickProgram.reset();
   edgePickProgram.reset();
+  stripProgram.reset();
+  nodePositionBuffer.reset();
+  edgeTailBuffer.reset();
+  edgeTipBuffer.reset();
+  dirtyNodes.clear();
+  pickDirtyNodes.clear();
   requestRedraw();
   QuantityStructure<CurveNetwork>::refresh(); // call base class version, which refreshes quantities
 }
 
 void CurveNetwork::geometryChanged() {
+  pickBVH.reset();
+  dirtyNodes.markAll(nNodes());
+  pickDirtyNodes.markAll(nNodes());
+  requestRedraw();
+  if (detail::sessionCaptureActive) detail::captureMovedPositions(*this, nullptr);
+}
 
+void CurveNetwork::updateNodePositionsImpl(const std::vector<size_t>& indices,
+                                           const std::vector<glm::vec3>& newPositions) {
+  for (size_t iN : indices) {
+    if (iN >= nNodes()) {
+      error("updateNodePositions() on [" + name + "] was passed node index " + std::to_string(iN) +
+            ", but there are only " + std::to_string(nNodes()) + " nodes");
+      return;
+    }
+  }
+  pickBVH.reset();
+  for (size_t i = 0; i < indices.size(); i++) {
+    nodes[indices[i]] = newPositions[i];
+    dirtyNodes.mark(indices[i]);
+    pickDirtyNodes.mark(indices[i]);
+  }
+  requestRedraw();
+  if (detail::sessionCaptureActive) detail::captureMovedPositions(*this, &indices);
+}
+
+void CurveNetwork::appendNodesImpl(const std::vector<glm::vec3>& newNodes) {
+  if (newNodes.empty()) return;
+
+  size_t oldNNodes = nNodes();
+  glm::vec3 bboxMin, bboxMax;
+  std::tie(bboxMin, bboxMax) = objectSpaceBoundingBox;
+  for (const glm::vec3& p : newNodes) {
+    nodes.push_back(p);
+    bboxMin = glm::min(bboxMin, p);
+    bboxMax = glm::max(bboxMax, p);
+  }
+  objectSpaceBoundingBox = std::make_tuple(bboxMin, bboxMax);
+  boundsChanged();
+  nodeDegrees.resize(nNodes(), 0);
+
+  appendedElements(oldNNodes, nEdges());
+}
+
+void CurveNetwork::appendEdgesImpl(const std::vector<std::array<size_t, 2>>& newEdges) {
+  for (size_t i = 0; i < newEdges.size(); i++) {
+    if (newEdges[i][0] >= nNodes() || newEdges[i][1] >= nNodes()) {
+      error("appendEdges() on [" + name + "] was passed edge { " + std::to_string(newEdges[i][0]) + " , " +
+            std::to_string(newEdges[i][1]) + " }, but there are only " + std::to_string(nNodes()) + " nodes");
+      return;
+    }
+  }
+  if (newEdges.empty()) return;
+
+  size_t oldNEdges = nEdges();
+  for (const std::array<size_t, 2>& e : newEdges) {
+    edges.push_back(e);
+    nodeDegrees[e[0]]++;
+    nodeDegrees[e[1]]++;
+  }
+
+  appendedElements(nNodes(), oldNEdges);
+}
+
+void CurveNetwork::appendedElements(size_t oldNNodes, size_t oldNEdges) {
+  dropLOD(); // (the chains change)
+  nodePositionBuffer.reset();
+  edgeTailBuffer.reset();
+  edgeTipBuffer.reset();
+
+  if (!quantities.empty()) {
+    warning("Curve network [" + name + "] quantities can not be appended to, and were removed");
+    removeAllQuantities();
+  }
+
+  // Picking is rebuilt, as the edges follow the nodes in the pick indices
+  pickBVH.reset();
+  nodePickProgram.reset();
+  edgePickProgram.reset();
+  pickDirtyNodes.clear();
+
+  if (nNodes() > nodeCapacity || nEdges() > edgeCapacity) {
+    // Reallocate the buffers with room to grow. This is also where the length scale follows the new nodes, so that
+    // the relative radius only changes when everything is uploaded anyway.
+    nodeCapacity = std::max<size_t>(nodeCapacity, 1024);
+    while (nodeCapacity < nNodes()) nodeCapacity *= 2;
+    edgeCapacity = std::max<size_t>(edgeCapacity, 1024);
+    while (edgeCapacity < nEdges()) edgeCapacity *= 2;
+    updateObjectSpaceBounds();
+    refresh();
+    return;
+  }
+
+  std::vector<std::pair<size_t, size_t>> nodeRange{{oldNNodes, nNodes()}};
+  std::vector<std::pair<size_t, size_t>> edgeRange{{oldNEdges, nEdges()}};
+  if (nodeProgram && oldNNodes < nNodes()) updateNodeGeometryBuffers(*nodeProgram, nodeRange);
+  if (edgeProgram && oldNEdges < nEdges()) updateEdgeGeometryBuffers(*edgeProgram, edgeRange);
+  if (stripProgram) {
+    if (oldNNodes < nNodes()) updateNodeGeometryBuffers(*stripProgram, nodeRange);
+    if (oldNEdges < nEdges()) setStripIndex(*stripProgram);
+  }
+  requestRedraw();
+}
+
+void CurveNetwork::flushGeometryUpdates() {
+  if (dirtyNodes.empty()) {
+    return;
+  }
+
+  if (lodHierarchy) {
+    // the errors were computed from the old positions, so they are computed again by the next draw
+    bool wasActive = lodActive;
+    dropLOD();
+    if (wasActive) return;
+  }
+
+  std::vector<std::pair<size_t, size_t>> nodeRanges = dirtyNodes.coalesced();
+  std::vector<std::pair<size_t, size_t>> edgeRanges = edgeRangesForNodes(nodeRanges);
   if (nodeProgram) {
-    fillNodeGeometryBuffers(*nodeProgram);
+    updateNodeGeometryBuffers(*nodeProgram, nodeRanges);
   }
   if (edgeProgram) {
-    fillEdgeGeometryBuffers(*edgeProgram);
+    updateEdgeGeometryBuffers(*edgeProgram, edgeRanges);
   }
-  if (nodePickProgram) {
-    fillNodeGeometryBuffers(*nodePickProgram);
+  if (stripProgram) {
+    updateNodeGeometryBuffers(*stripProgram, nodeRanges); // (the edge indices do not change)
   }
-  if (edgePickProgram) {
-    fillEdgeGeometryBuffers(*edgePickProgram);
+  if (nodePositionBuffer) {
+    for (const std::pair<size_t, size_t>& r : nodeRanges) {
+      std::vector<glm::vec3> rangeData(nodes.begin() + r.first, nodes.begin() + r.second);
+      nodePositionBuffer->setData(rangeData, true, static_cast<int>(r.first), static_cast<int>(r.second - r.first));
+    }
   }
-  requestRedraw();
-  QuantityStructure<CurveNetwork>::refresh();
+  if (edgeTailBuffer && edgeTipBuffer) {
+    for (const std::pair<size_t, size_t>& r : edgeRanges) {
+      std::vector<glm::vec3> posTail, posTip;
+      edgeEndPositions(r.first, r.second, posTail, posTip);
+      edgeTailBuffer->setData(posTail, true, static_cast<int>(r.first), static_cast<int>(r.second - r.first));
+      edgeTipBuffer->setData(posTip, true, static_cast<int>(r.first), static_cast<int>(r.second - r.first));
+    }
+  }
+  for (auto& q : quantities) {
+    q.second->geometryChanged(nodeRanges, edgeRanges);
+  }
+  dirtyNodes.clear();
+}
+
+void CurveNetwork::ensurePickBVH() {
+  if (pickBVH) return;
+
+  // Bare bounds, with the radius added as a margin by the queries
+  std::vector<glm::vec3> elementMin(nNodes() + nEdges());
+  std::vector<glm::vec3> elementMax(nNodes() + nEdges());
+  for (size_t iN = 0; iN < nNodes(); iN++) {
+    elementMin[iN] = nodes[iN];
+    elementMax[iN] = nodes[iN];
+  }
+  for (size_t iE = 0; iE < nEdges(); iE++) {
+    glm::vec3 pTail = nodes[edges[iE][0]];
+    glm::vec3 pTip = nodes[edges[iE][1]];
+    elementMin[nNodes() + iE] = glm::min(pTail, pTip);
+    elementMax[nNodes() + iE] = glm::max(pTail, pTip);
+  }
+  pickBVH.reset(new ElementBVH(elementMin, elementMax));
+}
+
+bool CurveNetwork::rayCastElementObjectSpace(glm::vec3 rayStart, glm::vec3 rayDir, float objectScale, float& tHit,
+                                             size_t& localPickInd) {
+  ensurePickBVH();
+  float rad = getRadius() / objectScale;
+  auto hit = [&](uint32_t i) {
+    if (i < nNodes()) return raySphereHit(rayStart, rayDir, nodes[i], rad);
+    const std::array<size_t, 2>& e = edges[i - nNodes()];
+    return rayCylinderHit(rayStart, rayDir, nodes[e[0]], nodes[e[1]], rad);
+  };
+  uint32_t iHit;
+  if (!pickBVH->rayCast(rayStart, rayDir, rad, hit, tHit, iHit)) return false;
+  localPickInd = iHit;
+  return true;
+}
+
+bool CurveNetwork::closestElementObjectSpace(glm::vec3 point, float objectScale, float& dist, size_t& localPickInd) {
+  ensurePickBVH();
+  float rad = getRadius() / objectScale;
+  auto elementDist = [&](uint32_t i) {
+    if (i < nNodes()) return std::max(glm::length(point - nodes[i]) - rad, 0.f);
+    const std::array<size_t, 2>& e = edges[i - nNodes()];
+    return std::max(pointSegmentDistance(point, nodes[e[0]], nodes[e[1]]) - rad, 0.f);
+  };
+  uint32_t iClosest;
+  if (!pickBVH->closest(point, rad, elementDist, dist, iClosest)) return false;
+  localPickInd = iClosest;
+  return true;
 }
 
 void CurveNetwork::buildPickUI(size_t localPickID) {
@@ -339,6 +672,30 @@ void CurveNetwork::buildCustomUI() {
 }
 
 void CurveNetwork::buildCustomOptionsUI() {
+  if (ImGui::BeginMenu("Curve Render Mode")) {
+    for (const CurveRenderMode& m : {CurveRenderMode::Cylinders, CurveRenderMode::Tubes, CurveRenderMode::Lines}) {
+      bool selected = (m == getCurveRenderMode());
+      std::string fancyName;
+      switch (m) {
+      case CurveRenderMode::Cylinders:
+        fancyName = "cylinders (pretty)";
+        break;
+      case CurveRenderMode::Tubes:
+        fancyName = "tubes (shared nodes)";
+        break;
+      case CurveRenderMode::Lines:
+        fancyName = "lines (fast)";
+        break;
+      }
+      if (ImGui::MenuItem(fancyName.c_str(), NULL, selected)) {
+        setCurveRenderMode(m);
+      }
+    }
+    ImGui::EndMenu();
+  }
+
+  if (ImGui::MenuItem("Level of Detail", nullptr, getLODEnabled())) setLODEnabled(!getLODEnabled());
+
   if (render::buildMaterialOptionsGui(material.get())) {
     material.manuallyChanged();
     setMaterial(material.get()); // trigger the other updates that happen on set()
@@ -346,34 +703,23 @@ void CurveNetwork::buildCustomOptionsUI() {
 }
 
 void CurveNetwork::updateObjectSpaceBounds() {
-  // bounding box
-  glm::vec3 min = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
-  glm::vec3 max = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
-  for (const glm::vec3& p : nodes) {
-    min = componentwiseMin(min, p);
-    max = componentwiseMax(max, p);
-  }
+  // bounding box, and length scale as twice the radius from the center of the bounding box
+  glm::vec3 min, max;
+  computePointSetExtents(nodes, min, max, objectSpaceLengthScale);
   objectSpaceBoundingBox = std::make_tuple(min, max);
-
-  // length scale, as twice the radius from the center of the bounding box
-  glm::vec3 center = 0.5f * (min + max);
-  float lengthScale = 0.0;
-  for (const glm::vec3& p : nodes) {
-    lengthScale = std::max(lengthScale, glm::length2(p - center));
-  }
-  objectSpaceLengthScale = 2 * std::sqrt(lengthScale);
+  boundsChanged();
 }
 
 CurveNetwork* CurveNetwork::setColor(glm::vec3 newVal) {
   color = newVal;
-  polyscope::requestRedraw();
+  requestRedraw();
   return this;
 }
 glm::vec3 CurveNetwork::getColor() { return color.get(); }
 
 CurveNetwork* CurveNetwork::setRadius(float newVal, bool isRelative) {
   radius = ScaledValue<float>(newVal, isRelative);
-  polyscope::requestRedraw();
+  requestRedraw();
   return this;
 }
 float CurveNetwork::getRadius() { return radius.get().asAbsolute(); }
@@ -384,10 +730,125 @@ CurveNetwork* CurveNetwork::setMaterial(std::string m) {
   requestRedraw();
   return this;
 }
+CurveNetwork* CurveNetwork::setCurveRenderMode(CurveRenderMode newVal) {
+  switch (newVal) {
+  case CurveRenderMode::Cylinders:
+    curveRenderMode = "cylinders";
+    break;
+  case CurveRenderMode::Tubes:
+    curveRenderMode = "tubes";
+    break;
+  case CurveRenderMode::Lines:
+    curveRenderMode = "lines";
+    break;
+  }
+  // (only the programs for the new mode are rebuilt, so big networks do not hold both sets of buffers)
+  nodeProgram.reset();
+  edgeProgram.reset();
+  stripProgram.reset();
+  requestRedraw();
+  return this;
+}
+CurveRenderMode CurveNetwork::getCurveRenderMode() {
+  // Stored as a string, like the point render mode of point clouds
+  if (curveRenderMode.get() == "tubes")
+    return CurveRenderMode::Tubes;
+  else if (curveRenderMode.get() == "lines")
+    return CurveRenderMode::Lines;
+  return CurveRenderMode::Cylinders;
+}
+
 std::string CurveNetwork::getMaterial() { return material.get(); }
+std::string CurveNetwork::drawBatchKey() { return material.get(); }
+
+bool CurveNetwork::drawsInDepthPrepass() { return true; }
 
 std::string CurveNetwork::typeName() { return structureTypeName; }
 
+size_t CurveNetwork::hostMemoryUsage() {
+  size_t bytes = allocatedBytes(nodes) + allocatedBytes(nodeDegrees) + allocatedBytes(edges);
+  if (lodHierarchy) bytes += lodHierarchy->allocatedBytes();
+  bytes += allocatedBytes(lodSelection.nodes) + allocatedBytes(lodSelection.edgeEnds) +
+           allocatedBytes(lodSelection.edgeSources) + allocatedBytes(lodSelection.chainLevels);
+  return bytes;
+}
+
+// === Level of detail
+
+CurveNetwork* CurveNetwork::setLODEnabled(bool newVal) {
+  lodEnabled = newVal;
+  if (!newVal) dropLOD();
+  lodSelectionValid = false;
+  requestRedraw();
+  return this;
+}
+bool CurveNetwork::getLODEnabled() { return lodEnabled.get(); }
+
+CurveNetwork* CurveNetwork::setLODMaxPixelError(float newVal) {
+  lodMaxPixelError = newVal;
+  lodSelectionValid = false;
+  requestRedraw();
+  return this;
+}
+float CurveNetwork::getLODMaxPixelError() { return lodMaxPixelError; }
+
+size_t CurveNetwork::nDrawnNodes() { return lodActive ? lodSelection.nodes.size() : nNodes(); }
+size_t CurveNetwork::nDrawnEdges() { return lodActive ? lodSelection.edgeEnds.size() : nEdges(); }
+const std::vector<uint32_t>* CurveNetwork::drawnNodeIndices() { return lodActive ? &lodSelection.nodes : nullptr; }
+const std::vector<uint32_t>* CurveNetwork::drawnEdgeIndices() {
+  return lodActive ? &lodSelection.edgeSources : nullptr;
+}
+std::array<size_t, 2> CurveNetwork::drawnEdge(size_t iDrawn) {
+  if (!lodActive) return edges[iDrawn];
+  return {{lodSelection.edgeEnds[iDrawn][0], lodSelection.edgeEnds[iDrawn][1]}};
+}
+
+void CurveNetwork::updateLODSelection() {
+  if (!lodEnabled.get()) return;
+
+  if (!lodHierarchy) {
+    ScopedCPUTimer timer(profilingName(), "build LOD");
+    lodHierarchy.reset(new CurveNetworkLOD(*this));
+    lodSelectionValid = false;
+  }
+
+  // Reflections and shadows draw with other view matrices; the selection follows the camera of the first pass
+  if (lodSelectionValid && lodSelectionSceneRender == state::sceneRenderCount) return;
+  lodSelectionSceneRender = state::sceneRenderCount;
+  lodSelectionValid = true;
+
+  if (!lodHierarchy->select(getModelView(), view::getCameraPerspectiveMatrix(), view::bufferHeight, lodMaxPixelError,
+                            lodSelection)) {
+    return;
+  }
+  bool nowActive = lodSelection.edgeEnds.size() < nEdges(); // (otherwise the full buffers are as good)
+  if (!nowActive && !lodActive) return;
+  lodActive = nowActive;
+  lodSelectionChanged();
+}
+
+void CurveNetwork::lodSelectionChanged() {
+  nodeProgram.reset();
+  edgeProgram.reset();
+  stripProgram.reset();
+  nodePositionBuffer.reset();
+  edgeTailBuffer.reset();
+  edgeTipBuffer.reset();
+  dirtyNodes.clear();
+  requestRedraw();
+  QuantityStructure<CurveNetwork>::refresh(); // the quantities fill their buffers through drawnNodeIndices() & co
+}
+
+void CurveNetwork::dropLOD() {
+  lodHierarchy.reset();
+  lodSelection = CurveNetworkLOD::Selection();
+  lodSelectionValid = false;
+  if (lodActive) {
+    lodActive = false;
+    lodSelectionChanged();
+  }
+}
+
 // === Quantities
 
 CurveNetworkQuantity::CurveNetworkQuantity(std::string name_, CurveNetwork& curveNetwork_, bool dominates_)
@@ -396,6 +857,10 @@ CurveNetworkQuantity::CurveNetworkQuantity(std::string name_, CurveNetwork& curv
 
 void CurveNetworkQuantity::buildNodeInfoGUI(size_t nodeInd) {}
 void CurveNetworkQuantity::buildEdgeInfoGUI(size_t edgeInd) {}
+void CurveNetworkQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& nodeRanges,
+                                           const std::vector<std::pair<size_t, size_t>>& edgeRanges) {
+  refresh();
+}
 
 // === Quantity adders
 
@@ -46,31 +46,39 @@ void CurveNetworkNodeColorQuantity::createProgram() {
   edgeProgram = render::engine->requestShader(
       "RAYCAST_CYLINDER", parent.addCurveNetworkEdgeRules({"CYLINDER_PROPAGATE_BLEND_COLOR", "SHADE_COLOR"}));
 
-  // Fill geometry buffers
-  parent.fillEdgeGeometryBuffers(*edgeProgram);
-  parent.fillNodeGeometryBuffers(*nodeProgram);
+  // The network's geometry buffers, and buffers of our own values
+  parent.setEdgeGeometryAttributes(*edgeProgram);
+  parent.setNodeGeometryAttributes(*nodeProgram);
+  fillColorBuffers(false);
 
+  render::engine->setMaterial(*nodeProgram, parent.getMaterial());
+  render::engine->setMaterial(*edgeProgram, parent.getMaterial());
+}
+
+void CurveNetworkNodeColorQuantity::fillColorBuffers(bool update) {
   { // Fill node color buffers
-    nodeProgram->setAttribute("a_color", values);
+    const std::vector<uint32_t>* drawnNodes = parent.drawnNodeIndices();
+    if (drawnNodes) {
+      std::vector<glm::vec3> drawnColors(drawnNodes->size());
+      for (size_t i = 0; i < drawnColors.size(); i++) drawnColors[i] = values[(*drawnNodes)[i]];
+      nodeProgram->setAttribute("a_color", drawnColors, update);
+    } else {
+      nodeProgram->setAttribute("a_color", values, update);
+    }
   }
 
   { // Fill edge color buffers
-    std::vector<glm::vec3> colorTail(parent.nEdges());
-    std::vector<glm::vec3> colorTip(parent.nEdges());
-    for (size_t iE = 0; iE < parent.nEdges(); iE++) {
-      auto& edge = parent.edges[iE];
-      size_t eTail = std::get<0>(edge);
-      size_t eTip = std::get<1>(edge);
-      colorTail[iE] = values[eTail];
-      colorTip[iE] = values[eTip];
+    std::vector<glm::vec3> colorTail(parent.nDrawnEdges());
+    std::vector<glm::vec3> colorTip(parent.nDrawnEdges());
+    for (size_t iE = 0; iE < parent.nDrawnEdges(); iE++) {
+      std::array<size_t, 2> edge = parent.drawnEdge(iE);
+      colorTail[iE] = values[edge[0]];
+      colorTip[iE] = values[edge[1]];
     }
 
-    edgeProgram->setAttribute("a_color_tail", colorTail);
-    edgeProgram->setAttribute("a_color_tip", colorTip);
+    edgeProgram->setAttribute("a_color_tail", colorTail, update);
+    edgeProgram->setAttribute("a_color_tip", colorTip, update);
   }
-
-  render::engine->setMaterial(*nodeProgram, parent.getMaterial());
-  render::engine->setMaterial(*edgeProgram, parent.getMaterial());
 }
 
 
@@ -94,6 +102,17 @@ void CurveNetworkColorQuantity::refresh() {
   Quantity::refresh();
 }
 
+void CurveNetworkColorQuantity::dataUpdated() {
+  if (nodeProgram && edgeProgram) {
+    fillColorBuffers(true);
+  }
+}
+
+void CurveNetworkColorQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& nodeRanges,
+                                                const std::vector<std::pair<size_t, size_t>>& edgeRanges) {
+  requestRedraw(); // (the geometry buffers are the network's, which updates them)
+}
+
 // ========================================================
 // ==========            Edge Color              ==========
 // ========================================================
@@ -110,10 +129,16 @@ void CurveNetworkEdgeColorQuantity::createProgram() {
   edgeProgram = render::engine->requestShader(
       "RAYCAST_CYLINDER", parent.addCurveNetworkEdgeRules({"CYLINDER_PROPAGATE_COLOR", "SHADE_COLOR"}));
 
-  // Fill geometry buffers
-  parent.fillEdgeGeometryBuffers(*edgeProgram);
-  parent.fillNodeGeometryBuffers(*nodeProgram);
+  // The network's geometry buffers, and buffers of our own values
+  parent.setEdgeGeometryAttributes(*edgeProgram);
+  parent.setNodeGeometryAttributes(*nodeProgram);
+  fillColorBuffers(false);
 
+  render::engine->setMaterial(*nodeProgram, parent.getMaterial());
+  render::engine->setMaterial(*edgeProgram, parent.getMaterial());
+}
+
+void CurveNetworkEdgeColorQuantity::fillColorBuffers(bool update) {
   { // Fill node color buffers
 
     // Compute an average color at each node
@@ -130,15 +155,26 @@ void CurveNetworkEdgeColorQuantity::createProgram() {
       averageColorNode[iN] /= parent.nodeDegrees[iN];
     }
 
-    nodeProgram->setAttribute("a_color", averageColorNode);
+    const std::vector<uint32_t>* drawnNodes = parent.drawnNodeIndices();
+    if (drawnNodes) {
+      std::vector<glm::vec3> drawnColors(drawnNodes->size());
+      for (size_t i = 0; i < drawnColors.size(); i++) drawnColors[i] = averageColorNode[(*drawnNodes)[i]];
+      averageColorNode = std::move(drawnColors);
+    }
+
+    nodeProgram->setAttribute("a_color", averageColorNode, update);
   }
 
   { // Fill edge color buffers
-    edgeProgram->setAttribute("a_color", values);
+    const std::vector<uint32_t>* drawnEdges = parent.drawnEdgeIndices();
+    if (drawnEdges) {
+      std::vector<glm::vec3> drawnColors(drawnEdges->size());
+      for (size_t i = 0; i < drawnColors.size(); i++) drawnColors[i] = values[(*drawnEdges)[i]];
+      edgeProgram->setAttribute("a_color", drawnColors, update);
+    } else {
+      edgeProgram->setAttribute("a_color", values, update);
+    }
   }
-
-  render::engine->setMaterial(*nodeProgram, parent.getMaterial());
-  render::engine->setMaterial(*edgeProgram, parent.getMaterial());
 }
 
 
@@ -155,4 +191,8 @@ void CurveNetworkEdgeColorQuantity::buildEdgeInfoGUI(size_t eInd) {
   ImGui::NextColumn();
 }
 
+size_t CurveNetworkNodeColorQuantity::hostMemoryUsage() { return allocatedBytes(values); }
+
+size_t CurveNetworkEdgeColorQuantity::hostMemoryUsage() { return allocatedBytes(values); }
+
 } // namespace polyscope
@@ -0,0 +1,223 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/curve_network_lod.h"
+
+#include "polyscope/curve_network.h"
+#include "polyscope/parallel.h"
+#include "polyscope/utilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace polyscope {
+
+namespace {
+
+const int8_t keepAllLevel = std::numeric_limits<int8_t>::min(); // for chains the camera is inside of
+
+float levelTolerance(int8_t level) {
+  if (level == keepAllLevel) return -1.f; // below every error
+  return std::ldexp(1.f, level);
+}
+
+float distanceToSegment(glm::vec3 p, glm::vec3 a, glm::vec3 b) {
+  glm::vec3 ab = b - a;
+  float len2 = glm::dot(ab, ab);
+  float t = len2 > 0.f ? glm::clamp(glm::dot(p - a, ab) / len2, 0.f, 1.f) : 0.f;
+  return glm::length(p - (a + t * ab));
+}
+
+} // namespace
+
+CurveNetworkLOD::CurveNetworkLOD(const CurveNetwork& network) {
+  const std::vector<glm::vec3>& nodes = network.nodes;
+  const std::vector<std::array<size_t, 2>>& edges = network.edges;
+  size_t nNodes = nodes.size();
+  size_t nEdges = edges.size();
+
+  // The edges at each node (a self-loop appears twice, matching nodeDegrees)
+  std::vector<uint32_t> incidentStart(nNodes + 1, 0);
+  for (const std::array<size_t, 2>& e : edges) {
+    incidentStart[e[0] + 1]++;
+    incidentStart[e[1] + 1]++;
+  }
+  std::partial_sum(incidentStart.begin(), incidentStart.end(), incidentStart.begin());
+  std::vector<uint32_t> incident(2 * nEdges);
+  std::vector<uint32_t> fill(incidentStart.begin(), incidentStart.end() - 1);
+  for (size_t iE = 0; iE < nEdges; iE++) {
+    incident[fill[edges[iE][0]]++] = iE;
+    incident[fill[edges[iE][1]]++] = iE;
+  }
+  auto degree = [&](size_t iN) { return incidentStart[iN + 1] - incidentStart[iN]; };
+
+  // Follow edges from a node until reaching a node which does not continue the chain
+  std::vector<char> edgeVisited(nEdges, false);
+  chainNodeStart.push_back(0);
+  auto walkChain = [&](uint32_t start, uint32_t firstEdge) {
+    uint32_t node = start;
+    uint32_t iE = firstEdge;
+    chainNodes.push_back(start);
+    while (true) {
+      edgeVisited[iE] = true;
+      chainEdges.push_back(iE);
+      uint32_t next = edges[iE][0] == node ? edges[iE][1] : edges[iE][0];
+      chainNodes.push_back(next);
+      if (next == start || degree(next) != 2) break;
+      uint32_t a = incident[incidentStart[next]];
+      uint32_t b = incident[incidentStart[next] + 1];
+      uint32_t nextEdge = a == iE ? b : a;
+      if (edgeVisited[nextEdge]) break;
+      node = next;
+      iE = nextEdge;
+    }
+    chainNodeStart.push_back(chainNodes.size());
+  };
+
+  for (size_t iN = 0; iN < nNodes; iN++) {
+    if (degree(iN) == 2) continue;
+    fixedNodes.push_back(iN);
+    for (uint32_t i = incidentStart[iN]; i < incidentStart[iN + 1]; i++) {
+      if (!edgeVisited[incident[i]]) walkChain(iN, incident[i]);
+    }
+  }
+  // What remains are closed loops of degree two nodes
+  for (size_t iE = 0; iE < nEdges; iE++) {
+    if (edgeVisited[iE]) continue;
+    fixedNodes.push_back(edges[iE][0]);
+    walkChain(edges[iE][0], iE);
+  }
+
+  // Douglas-Peucker errors and bounding box of each chain
+  size_t nC = chainNodeStart.size() - 1;
+  nodeError.assign(chainNodes.size(), std::numeric_limits<float>::infinity());
+  chainBoxMin.resize(nC);
+  chainBoxMax.resize(nC);
+  parallelFor(
+      0, nC,
+      [&](size_t c) {
+        size_t first = chainNodeStart[c];
+        size_t last = chainNodeStart[c + 1] - 1;
+
+        glm::vec3 boxMin{std::numeric_limits<float>::infinity()};
+        glm::vec3 boxMax{-std::numeric_limits<float>::infinity()};
+        for (size_t i = first; i <= last; i++) {
+          boxMin = glm::min(boxMin, nodes[chainNodes[i]]);
+          boxMax = glm::max(boxMax, nodes[chainNodes[i]]);
+        }
+        chainBoxMin[c] = boxMin;
+        chainBoxMax[c] = boxMax;
+
+        struct Span {
+          size_t a, b;
+          float limit; // the error of the node which split off this span
+        };
+        std::vector<Span> stack{{first, last, std::numeric_limits<float>::infinity()}};
+        while (!stack.empty()) {
+          Span s = stack.back();
+          stack.pop_back();
+          if (s.b <= s.a + 1) continue;
+          glm::vec3 pA = nodes[chainNodes[s.a]];
+          glm::vec3 pB = nodes[chainNodes[s.b]];
+          float maxDist = -1.f;
+          size_t split = s.a + 1;
+          for (size_t i = s.a + 1; i < s.b; i++) {
+            float d = distanceToSegment(nodes[chainNodes[i]], pA, pB);
+            if (d > maxDist) {
+              maxDist = d;
+              split = i;
+            }
+          }
+          float err = std::min(maxDist, s.limit);
+          if (s.a == first && s.b == last && chainNodes[first] == chainNodes[last]) {
+            err = std::numeric_limits<float>::infinity(); // a loop keeps at least its farthest node
+          }
+          nodeError[split] = err;
+          stack.push_back({s.a, split, err});
+          stack.push_back({split, s.b, err});
+        }
+      },
+      64);
+}
+
+bool CurveNetworkLOD::select(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight,
+                             float maxPixelError, Selection& selection) const {
+  glm::mat4 toClip = projection * modelView;
+  float viewScale = std::cbrt(std::abs(glm::determinant(glm::mat3(modelView)))); // object units to view units
+  float pixelsPerUnit = projection[1][1] * viewportHeight / 2.;
+  size_t nC = nChains();
+
+  // Each chain is judged at the nearest corner of its box, as in SurfaceMeshLOD::selectLevel()
+  std::vector<int8_t> levels(nC);
+  parallelFor(
+      0, nC,
+      [&](size_t c) {
+        float wNear = std::numeric_limits<float>::infinity();
+        for (int k = 0; k < 8; k++) {
+          glm::vec3 corner{(k & 4) ? chainBoxMax[c].x : chainBoxMin[c].x, (k & 2) ? chainBoxMax[c].y : chainBoxMin[c].y,
+                           (k & 1) ? chainBoxMax[c].z : chainBoxMin[c].z};
+          wNear = std::min(wNear, (toClip * glm::vec4(corner, 1.)).w);
+        }
+        int8_t level = keepAllLevel;
+        float tol = maxPixelError * wNear / (viewScale * pixelsPerUnit);
+        if (wNear > 0. && tol > 0. && std::isfinite(tol)) {
+          float l = std::floor(std::log2(tol));
+          level = static_cast<int8_t>(glm::clamp(l, -127.f, 127.f));
+        }
+        levels[c] = level;
+      },
+      1024);
+  if (levels == selection.chainLevels) return false;
+  selection.chainLevels = levels;
+
+  // Count the interior nodes each chain keeps, to place the chains in the output
+  std::vector<size_t> keptBefore(nC + 1, 0);
+  parallelFor(
+      0, nC,
+      [&](size_t c) {
+        float tol = levelTolerance(levels[c]);
+        size_t count = 0;
+        for (size_t i = chainNodeStart[c] + 1; i + 1 < chainNodeStart[c + 1]; i++) {
+          if (nodeError[i] > tol) count++;
+        }
+        keptBefore[c + 1] = count;
+      },
+      256);
+  std::partial_sum(keptBefore.begin(), keptBefore.end(), keptBefore.begin());
+  size_t nKept = keptBefore[nC];
+
+  selection.nodes.resize(fixedNodes.size() + nKept);
+  std::copy(fixedNodes.begin(), fixedNodes.end(), selection.nodes.begin());
+  selection.edgeEnds.resize(nKept + nC); // one more edge than interior nodes per chain
+  selection.edgeSources.resize(nKept + nC);
+  parallelFor(
+      0, nC,
+      [&](size_t c) {
+        float tol = levelTolerance(levels[c]);
+        size_t first = chainNodeStart[c];
+        size_t last = chainNodeStart[c + 1] - 1;
+        size_t edgeStart = first - c;
+        size_t outNode = fixedNodes.size() + keptBefore[c];
+        size_t outEdge = keptBefore[c] + c;
+        size_t prev = first;
+        for (size_t i = first + 1; i <= last; i++) {
+          if (i != last && !(nodeError[i] > tol)) continue;
+          if (i != last) selection.nodes[outNode++] = chainNodes[i];
+          selection.edgeEnds[outEdge] = {{chainNodes[prev], chainNodes[i]}};
+          selection.edgeSources[outEdge] = chainEdges[edgeStart + (prev - first + i - first - 1) / 2];
+          outEdge++;
+          prev = i;
+        }
+      },
+      256);
+  return true;
+}
+
+size_t CurveNetworkLOD::allocatedBytes() const {
+  return polyscope::allocatedBytes(chainNodeStart) + polyscope::allocatedBytes(chainNodes) +
+         polyscope::allocatedBytes(chainEdges) + polyscope::allocatedBytes(nodeError) +
+         polyscope::allocatedBytes(chainBoxMin) + polyscope::allocatedBytes(chainBoxMax) +
+         polyscope::allocatedBytes(fixedNodes);
+}
+
+} // namespace polyscope
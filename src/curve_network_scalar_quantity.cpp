@@ -59,6 +59,17 @@ void CurveNetworkScalarQuantity::refresh() {
   Quantity::refresh();
 }
 
+void CurveNetworkScalarQuantity::dataUpdated() {
+  if (nodeProgram && edgeProgram) {
+    fillColorBuffers(true);
+  }
+}
+
+void CurveNetworkScalarQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& nodeRanges,
+                                                 const std::vector<std::pair<size_t, size_t>>& edgeRanges) {
+  requestRedraw(); // (the geometry buffers are the network's, which updates them)
+}
+
 std::string CurveNetworkScalarQuantity::niceName() { return name + " (" + definedOn + " scalar)"; }
 
 // ========================================================
@@ -78,36 +89,42 @@ void CurveNetworkNodeScalarQuantity::createProgram() {
   edgeProgram = render::engine->requestShader(
       "RAYCAST_CYLINDER", addScalarRules(parent.addCurveNetworkEdgeRules({"CYLINDER_PROPAGATE_BLEND_VALUE"})));
 
-  // Fill geometry buffers
-  parent.fillEdgeGeometryBuffers(*edgeProgram);
-  parent.fillNodeGeometryBuffers(*nodeProgram);
+  // The network's geometry buffers, and buffers of our own values
+  parent.setEdgeGeometryAttributes(*edgeProgram);
+  parent.setNodeGeometryAttributes(*nodeProgram);
+  fillColorBuffers(false);
 
+  edgeProgram->setTextureFromColormap("t_colormap", cMap.get());
+  nodeProgram->setTextureFromColormap("t_colormap", cMap.get());
+  render::engine->setMaterial(*nodeProgram, parent.getMaterial());
+  render::engine->setMaterial(*edgeProgram, parent.getMaterial());
+}
+
+
+void CurveNetworkNodeScalarQuantity::fillColorBuffers(bool update) {
   { // Fill node color buffers
-    nodeProgram->setAttribute("a_value", values);
+    const std::vector<uint32_t>* drawnNodes = parent.drawnNodeIndices();
+    if (drawnNodes) {
+      values.setAttribute(*nodeProgram, "a_value", *drawnNodes, update);
+    } else {
+      values.setAttribute(*nodeProgram, "a_value", update);
+    }
   }
 
   { // Fill edge color buffers
-    std::vector<double> valueTail(parent.nEdges());
-    std::vector<double> valueTip(parent.nEdges());
-    for (size_t iE = 0; iE < parent.nEdges(); iE++) {
-      auto& edge = parent.edges[iE];
-      size_t eTail = std::get<0>(edge);
-      size_t eTip = std::get<1>(edge);
-      valueTail[iE] = values[eTail];
-      valueTip[iE] = values[eTip];
+    std::vector<double> valueTail(parent.nDrawnEdges());
+    std::vector<double> valueTip(parent.nDrawnEdges());
+    for (size_t iE = 0; iE < parent.nDrawnEdges(); iE++) {
+      std::array<size_t, 2> edge = parent.drawnEdge(iE);
+      valueTail[iE] = values[edge[0]];
+      valueTip[iE] = values[edge[1]];
     }
 
-    edgeProgram->setAttribute("a_value_tail", valueTail);
-    edgeProgram->setAttribute("a_value_tip", valueTip);
+    edgeProgram->setAttribute("a_value_tail", valueTail, update);
+    edgeProgram->setAttribute("a_value_tip", valueTip, update);
   }
-
-  edgeProgram->setTextureFromColormap("t_colormap", cMap.get());
-  nodeProgram->setTextureFromColormap("t_colormap", cMap.get());
-  render::engine->setMaterial(*nodeProgram, parent.getMaterial());
-  render::engine->setMaterial(*edgeProgram, parent.getMaterial());
 }
 
-
 void CurveNetworkNodeScalarQuantity::buildNodeInfoGUI(size_t nInd) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
@@ -133,10 +150,18 @@ void CurveNetworkEdgeScalarQuantity::createProgram() {
   edgeProgram = render::engine->requestShader(
       "RAYCAST_CYLINDER", addScalarRules(parent.addCurveNetworkEdgeRules({"CYLINDER_PROPAGATE_VALUE"})));
 
-  // Fill geometry buffers
-  parent.fillEdgeGeometryBuffers(*edgeProgram);
-  parent.fillNodeGeometryBuffers(*nodeProgram);
+  // The network's geometry buffers, and buffers of our own values
+  parent.setEdgeGeometryAttributes(*edgeProgram);
+  parent.setNodeGeometryAttributes(*nodeProgram);
+  fillColorBuffers(false);
+
+  edgeProgram->setTextureFromColormap("t_colormap", cMap.get());
+  nodeProgram->setTextureFromColormap("t_colormap", cMap.get());
+  render::engine->setMaterial(*nodeProgram, parent.getMaterial());
+  render::engine->setMaterial(*edgeProgram, parent.getMaterial());
+}
 
+void CurveNetworkEdgeScalarQuantity::fillColorBuffers(bool update) {
   { // Fill node color buffers
     // Compute an average color at each node
     std::vector<double> averageValueNode(parent.nNodes(), 0.);
@@ -152,17 +177,24 @@ void CurveNetworkEdgeScalarQuantity::createProgram() {
       averageValueNode[iN] /= parent.nodeDegrees[iN];
     }
 
-    nodeProgram->setAttribute("a_value", averageValueNode);
+    const std::vector<uint32_t>* drawnNodes = parent.drawnNodeIndices();
+    if (drawnNodes) {
+      std::vector<double> drawnValues(drawnNodes->size());
+      for (size_t i = 0; i < drawnValues.size(); i++) drawnValues[i] = averageValueNode[(*drawnNodes)[i]];
+      averageValueNode = std::move(drawnValues);
+    }
+
+    nodeProgram->setAttribute("a_value", averageValueNode, update);
   }
 
   { // Fill edge color buffers
-    edgeProgram->setAttribute("a_value", values);
+    const std::vector<uint32_t>* drawnEdges = parent.drawnEdgeIndices();
+    if (drawnEdges) {
+      values.setAttribute(*edgeProgram, "a_value", *drawnEdges, update);
+    } else {
+      values.setAttribute(*edgeProgram, "a_value", update);
+    }
   }
-
-  edgeProgram->setTextureFromColormap("t_colormap", cMap.get());
-  nodeProgram->setTextureFromColormap("t_colormap", cMap.get());
-  render::engine->setMaterial(*nodeProgram, parent.getMaterial());
-  render::engine->setMaterial(*edgeProgram, parent.getMaterial());
 }
 
 
@@ -173,5 +205,6 @@ void CurveNetworkEdgeScalarQuantity::buildEdgeInfoGUI(size_t eInd) {
   ImGui::NextColumn();
 }
 
+size_t CurveNetworkScalarQuantity::hostMemoryUsage() { return values.allocatedBytes(); }
 
 } // namespace polyscope
@@ -35,6 +35,8 @@ void CurveNetworkVectorQuantity::buildCustomUI() {
 
 void CurveNetworkVectorQuantity::drawSubUI() {}
 
+void CurveNetworkVectorQuantity::dataUpdated() { vectorArtist->vectorsChanged(); }
+
 CurveNetworkVectorQuantity* CurveNetworkVectorQuantity::setVectorLengthScale(double newLength, bool isRelative) {
   vectorArtist->setVectorLengthScale(newLength, isRelative);
   return this;
@@ -137,4 +139,6 @@ void CurveNetworkEdgeVectorQuantity::buildEdgeInfoGUI(size_t iF) {
   ImGui::NextColumn();
 }
 
+size_t CurveNetworkVectorQuantity::hostMemoryUsage() { return allocatedBytes(vectors) + allocatedBytes(vectorRoots); }
+
 } // namespace polyscope
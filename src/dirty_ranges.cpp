@@ -0,0 +1,41 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/dirty_ranges.h"
+
+#include <algorithm>
+
+namespace polyscope {
+
+void DirtyRanges::mark(size_t start, size_t end) {
+  if (start >= end) return;
+
+  // Sequential updates (the common case) just extend the last range
+  if (!marked.empty() && start <= marked.back().second && end >= marked.back().first) {
+    marked.back().first = std::min(marked.back().first, start);
+    marked.back().second = std::max(marked.back().second, end);
+    return;
+  }
+  marked.emplace_back(start, end);
+}
+
+void DirtyRanges::mark(const DirtyRanges& other) {
+  for (const std::pair<size_t, size_t>& r : other.marked) {
+    mark(r.first, r.second);
+  }
+}
+
+std::vector<std::pair<size_t, size_t>> DirtyRanges::coalesced(size_t maxGap) const {
+  std::vector<std::pair<size_t, size_t>> sorted = marked;
+  std::sort(sorted.begin(), sorted.end());
+
+  std::vector<std::pair<size_t, size_t>> result;
+  for (const std::pair<size_t, size_t>& r : sorted) {
+    if (!result.empty() && r.first <= result.back().second + maxGap) {
+      result.back().second = std::max(result.back().second, r.second);
+    } else {
+      result.push_back(r);
+    }
+  }
+  return result;
+}
+
+} // namespace polyscope
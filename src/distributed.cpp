@@ -0,0 +1,169 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/distributed.h"
+
+#include "polyscope/messages.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/screenshot.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace polyscope {
+namespace distributed {
+
+namespace {
+
+// Rows [rowBegin, rowEnd) of an image, as sent between ranks: the row range, then the color, depth and owner of the
+// pixels
+std::vector<unsigned char> packRows(const DepthImage& image, int rowBegin, int rowEnd) {
+  size_t first = static_cast<size_t>(rowBegin) * image.width;
+  size_t n = static_cast<size_t>(rowEnd - rowBegin) * image.width;
+  std::vector<unsigned char> data(2 * sizeof(int32_t) + n * (4 + sizeof(float) + sizeof(int32_t)));
+  unsigned char* out = data.data();
+  int32_t range[2] = {rowBegin, rowEnd};
+  std::memcpy(out, range, sizeof(range));
+  out += sizeof(range);
+  std::memcpy(out, &image.color[4 * first], 4 * n);
+  out += 4 * n;
+  std::memcpy(out, &image.depth[first], n * sizeof(float));
+  out += n * sizeof(float);
+  for (size_t i = 0; i < n; i++) {
+    int32_t o = image.owner[first + i];
+    std::memcpy(out + i * sizeof(int32_t), &o, sizeof(int32_t));
+  }
+  return data;
+}
+
+// The inverse of packRows(), in to rows of an image of the same size as the sender's. Returns the row range.
+std::pair<int, int> unpackRows(const std::vector<unsigned char>& data, DepthImage& image) {
+  if (data.size() < 2 * sizeof(int32_t)) {
+    throw std::runtime_error("distributed compositing received a malformed message");
+  }
+  int32_t range[2];
+  std::memcpy(range, data.data(), sizeof(range));
+  size_t first = static_cast<size_t>(range[0]) * image.width;
+  size_t n = static_cast<size_t>(range[1] - range[0]) * image.width;
+  if (range[0] < 0 || range[1] > image.height || range[1] < range[0] ||
+      data.size() != 2 * sizeof(int32_t) + n * (4 + sizeof(float) + sizeof(int32_t))) {
+    throw std::runtime_error("distributed compositing received rows which do not match the image size");
+  }
+  const unsigned char* in = data.data() + sizeof(range);
+  std::memcpy(&image.color[4 * first], in, 4 * n);
+  in += 4 * n;
+  std::memcpy(&image.depth[first], in, n * sizeof(float));
+  in += n * sizeof(float);
+  for (size_t i = 0; i < n; i++) {
+    int32_t o;
+    std::memcpy(&o, in + i * sizeof(int32_t), sizeof(int32_t));
+    image.owner[first + i] = o;
+  }
+  return {range[0], range[1]};
+}
+
+} // namespace
+
+int DepthImage::ownerAt(int x, int y) const {
+  if (x < 0 || y < 0 || x >= width || y >= height) return -1;
+  return owner[static_cast<size_t>(y) * width + x];
+}
+
+DepthImage renderDepthImage(int rank) {
+  if (render::engine->getSSAAFactor() != 1) {
+    error("distributed rendering requires an SSAA factor of 1");
+    return DepthImage();
+  }
+
+  DepthImage image;
+  image.color = renderToBuffer(false);
+  image.width = view::bufferWidth;
+  image.height = view::bufferHeight;
+
+  // The depth of the scene just drawn, flipped to rows top to bottom like the color
+  std::vector<float> depth = render::engine->sceneBuffer->readDepthBuffer();
+  if (depth.size() != static_cast<size_t>(image.width) * image.height) {
+    error("distributed rendering: the scene depth does not match the image size");
+    return DepthImage();
+  }
+  image.depth.resize(depth.size());
+  for (int j = 0; j < image.height; j++) {
+    std::copy(depth.begin() + static_cast<size_t>(image.height - 1 - j) * image.width,
+              depth.begin() + static_cast<size_t>(image.height - j) * image.width,
+              image.depth.begin() + static_cast<size_t>(j) * image.width);
+  }
+
+  image.owner.resize(image.depth.size());
+  for (size_t i = 0; i < image.depth.size(); i++) {
+    image.owner[i] = image.depth[i] < 1.f ? rank : -1;
+  }
+  return image;
+}
+
+void compositeByDepth(DepthImage& target, const DepthImage& other, int rowBegin, int rowEnd) {
+  if (target.width != other.width || target.height != other.height) {
+    error("distributed compositing: images of different sizes");
+    return;
+  }
+  size_t end = static_cast<size_t>(rowEnd) * target.width;
+  for (size_t i = static_cast<size_t>(rowBegin) * target.width; i < end; i++) {
+    // (ties go to the lower rank, so that every rank agrees on the result)
+    bool nearer = other.depth[i] < target.depth[i] ||
+                  (other.depth[i] == target.depth[i] && other.owner[i] >= 0 &&
+                   (target.owner[i] < 0 || other.owner[i] < target.owner[i]));
+    if (!nearer) continue;
+    target.depth[i] = other.depth[i];
+    target.owner[i] = other.owner[i];
+    std::memcpy(&target.color[4 * i], &other.color[4 * i], 4);
+  }
+}
+
+DepthImage binarySwapComposite(DepthImage image, int rank, int nRanks, const ExchangeFunction& exchange) {
+  if (nRanks <= 1) return image;
+
+  int nSwap = 1; // the largest power of two no more than nRanks
+  while (2 * nSwap <= nRanks) nSwap *= 2;
+
+  // Ranks past the power of two hand their whole image to a partner below it, and are then done
+  DepthImage received = image;
+  if (rank >= nSwap) {
+    exchange(rank - nSwap, packRows(image, 0, image.height));
+    return image;
+  }
+  if (rank + nSwap < nRanks) {
+    std::pair<int, int> rows = unpackRows(exchange(rank + nSwap, {}), received);
+    compositeByDepth(image, received, rows.first, rows.second);
+  }
+
+  // Binary swap: in each round, split the rows this rank is responsible for with a partner, each keeping one half and
+  // merging in the partner's image of it
+  int rowBegin = 0;
+  int rowEnd = image.height;
+  for (int bit = 1; bit < nSwap; bit *= 2) {
+    int partner = rank ^ bit;
+    int rowMid = rowBegin + (rowEnd - rowBegin) / 2;
+    bool keepLower = rank < partner;
+    int sendBegin = keepLower ? rowMid : rowBegin;
+    int sendEnd = keepLower ? rowEnd : rowMid;
+    std::pair<int, int> rows = unpackRows(exchange(partner, packRows(image, sendBegin, sendEnd)), received);
+    compositeByDepth(image, received, rows.first, rows.second);
+    if (keepLower) {
+      rowEnd = rowMid;
+    } else {
+      rowBegin = rowMid;
+    }
+  }
+
+  // Gather the finished rows on rank 0
+  if (rank == 0) {
+    for (int other = 1; other < nSwap; other++) {
+      unpackRows(exchange(other, {}), image);
+    }
+  } else {
+    exchange(0, packRows(image, rowBegin, rowEnd));
+  }
+  return image;
+}
+
+} // namespace distributed
+} // namespace polyscope
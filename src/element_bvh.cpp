@@ -0,0 +1,356 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/element_bvh.h"
+
+#include "polyscope/parallel.h"
+#include "polyscope/utilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace polyscope {
+
+const size_t ElementBVH::defaultElementsPerLeaf;
+
+namespace {
+
+// The range of t for which the ray is inside the box, which is empty (tEnter > tExit) if it misses
+void rayBoxRange(glm::vec3 rayStart, glm::vec3 invDir, glm::vec3 bboxMin, glm::vec3 bboxMax, float& tEnter,
+                 float& tExit) {
+  tEnter = 0.;
+  tExit = std::numeric_limits<float>::infinity();
+  for (int i = 0; i < 3; i++) {
+    float t0 = (bboxMin[i] - rayStart[i]) * invDir[i];
+    float t1 = (bboxMax[i] - rayStart[i]) * invDir[i];
+    if (t0 > t1) std::swap(t0, t1);
+    // (written so that the NaN from a ray lying in the plane of a face, 0 * inf, leaves the range alone)
+    tEnter = t0 > tEnter ? t0 : tEnter;
+    tExit = t1 < tExit ? t1 : tExit;
+  }
+}
+
+float pointBoxDistance(glm::vec3 p, glm::vec3 bboxMin, glm::vec3 bboxMax) {
+  glm::vec3 outside = glm::max(glm::max(bboxMin - p, p - bboxMax), glm::vec3{0.});
+  return glm::length(outside);
+}
+
+} // namespace
+
+ElementBVH::ElementBVH(const std::vector<glm::vec3>& elementMin, const std::vector<glm::vec3>& elementMax,
+                       size_t elementsPerLeaf) {
+  if (elementMin.size() >= std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("element hierarchy can hold at most 2^32 - 1 elements");
+  }
+  if (elementMin.size() != elementMax.size()) {
+    throw std::invalid_argument("element hierarchy needs as many box minimums as maximums");
+  }
+  if (elementsPerLeaf == 0) {
+    throw std::invalid_argument("element hierarchy needs at least one element per leaf");
+  }
+  size_t nElements = elementMin.size();
+  if (nElements == 0) return;
+
+  // Sort the elements along a Morton curve through their box centers
+  std::vector<glm::vec3> centers(nElements);
+  parallelFor(0, nElements, [&](size_t i) { centers[i] = 0.5f * (elementMin[i] + elementMax[i]); });
+  order = mortonOrder(centers);
+
+  std::vector<Node> leaves((nElements + elementsPerLeaf - 1) / elementsPerLeaf);
+  parallelFor(
+      0, leaves.size(),
+      [&](size_t iL) {
+        Node& leaf = leaves[iL];
+        leaf.start = static_cast<uint32_t>(iL * elementsPerLeaf);
+        leaf.count = static_cast<uint32_t>(std::min(elementsPerLeaf, nElements - leaf.start));
+        leaf.right = -1;
+        leaf.bboxMin = glm::vec3{std::numeric_limits<float>::infinity()};
+        leaf.bboxMax = glm::vec3{-std::numeric_limits<float>::infinity()};
+        for (size_t i = leaf.start; i < leaf.start + leaf.count; i++) {
+          leaf.bboxMin = glm::min(leaf.bboxMin, elementMin[order[i]]);
+          leaf.bboxMax = glm::max(leaf.bboxMax, elementMax[order[i]]);
+        }
+      },
+      256);
+
+  nodes.reserve(2 * leaves.size() - 1);
+  buildNode(leaves, 0, leaves.size());
+}
+
+int32_t ElementBVH::buildNode(const std::vector<Node>& leaves, size_t leafStart, size_t leafEnd) {
+  int32_t ind = static_cast<int32_t>(nodes.size());
+  if (leafEnd - leafStart == 1) {
+    nodes.push_back(leaves[leafStart]);
+    return ind;
+  }
+
+  nodes.emplace_back();
+  size_t leafMid = leafStart + (leafEnd - leafStart) / 2;
+  buildNode(leaves, leafStart, leafMid);
+  int32_t right = buildNode(leaves, leafMid, leafEnd);
+
+  const Node& a = nodes[ind + 1];
+  const Node& b = nodes[right];
+  Node& n = nodes[ind];
+  n.bboxMin = glm::min(a.bboxMin, b.bboxMin);
+  n.bboxMax = glm::max(a.bboxMax, b.bboxMax);
+  n.start = a.start;
+  n.count = a.count + b.count;
+  n.right = right;
+  return ind;
+}
+
+bool ElementBVH::rayCast(glm::vec3 rayStart, glm::vec3 rayDir, float boxMargin,
+                         const std::function<float(uint32_t)>& elementHit, float& tHit, uint32_t& hitElement) const {
+  if (nodes.empty()) return false;
+
+  glm::vec3 invDir = 1.f / rayDir;
+  glm::vec3 margin{boxMargin};
+  float tBest = std::numeric_limits<float>::infinity();
+  uint32_t best = 0;
+
+  // Nodes on the stack with the t at which the ray enters them, visiting the nearer child first
+  std::vector<std::pair<int32_t, float>> stack;
+  float tEnter, tExit;
+  rayBoxRange(rayStart, invDir, nodes[0].bboxMin - margin, nodes[0].bboxMax + margin, tEnter, tExit);
+  if (tEnter <= tExit) stack.emplace_back(0, tEnter);
+
+  while (!stack.empty()) {
+    int32_t ind = stack.back().first;
+    float tNode = stack.back().second;
+    stack.pop_back();
+    if (!(tNode < tBest)) continue;
+    const Node& n = nodes[ind];
+
+    if (n.right >= 0) {
+      float tEnterA, tExitA, tEnterB, tExitB;
+      rayBoxRange(rayStart, invDir, nodes[ind + 1].bboxMin - margin, nodes[ind + 1].bboxMax + margin, tEnterA, tExitA);
+      rayBoxRange(rayStart, invDir, nodes[n.right].bboxMin - margin, nodes[n.right].bboxMax + margin, tEnterB, tExitB);
+      bool hitA = tEnterA <= tExitA && tEnterA < tBest;
+      bool hitB = tEnterB <= tExitB && tEnterB < tBest;
+      if (hitA && hitB && tEnterA > tEnterB) {
+        stack.emplace_back(ind + 1, tEnterA);
+        stack.emplace_back(n.right, tEnterB);
+      } else {
+        if (hitB) stack.emplace_back(n.right, tEnterB);
+        if (hitA) stack.emplace_back(ind + 1, tEnterA);
+      }
+      continue;
+    }
+
+    for (size_t i = n.start; i < n.start + n.count; i++) {
+      float t = elementHit(order[i]);
+      if (t >= 0. && t < tBest) {
+        tBest = t;
+        best = order[i];
+      }
+    }
+  }
+
+  if (tBest == std::numeric_limits<float>::infinity()) return false;
+  tHit = tBest;
+  hitElement = best;
+  return true;
+}
+
+bool ElementBVH::closest(glm::vec3 point, float boxMargin, const std::function<float(uint32_t)>& elementDist,
+                         float& dist, uint32_t& closestElement) const {
+  if (nodes.empty()) return false;
+
+  glm::vec3 margin{boxMargin};
+  float distBest = std::numeric_limits<float>::infinity();
+  uint32_t best = 0;
+  bool found = false;
+
+  std::vector<std::pair<int32_t, float>> stack{{0, 0.f}};
+  while (!stack.empty()) {
+    int32_t ind = stack.back().first;
+    float distNode = stack.back().second;
+    stack.pop_back();
+    if (found && !(distNode < distBest)) continue;
+    const Node& n = nodes[ind];
+
+    if (n.right >= 0) {
+      float distA = pointBoxDistance(point, nodes[ind + 1].bboxMin - margin, nodes[ind + 1].bboxMax + margin);
+      float distB = pointBoxDistance(point, nodes[n.right].bboxMin - margin, nodes[n.right].bboxMax + margin);
+      if (distA > distB) {
+        stack.emplace_back(ind + 1, distA);
+        stack.emplace_back(n.right, distB);
+      } else {
+        stack.emplace_back(n.right, distB);
+        stack.emplace_back(ind + 1, distA);
+      }
+      continue;
+    }
+
+    for (size_t i = n.start; i < n.start + n.count; i++) {
+      float d = elementDist(order[i]);
+      if (!found || d < distBest) {
+        distBest = d;
+        best = order[i];
+        found = true;
+      }
+    }
+  }
+
+  dist = distBest;
+  closestElement = best;
+  return found;
+}
+
+void ElementBVH::forEachNearPlane(glm::vec3 normal, float offset, float planeMargin,
+                                  const std::function<void(uint32_t)>& visit) const {
+  if (nodes.empty()) return;
+
+  glm::vec3 absNormal = glm::abs(normal);
+  std::vector<int32_t> stack{0};
+  while (!stack.empty()) {
+    int32_t ind = stack.back();
+    stack.pop_back();
+    const Node& n = nodes[ind];
+
+    // the box spans dot(normal, center) +- dot(halfExtent, |normal|) along the normal
+    float centerDist = glm::dot(normal, 0.5f * (n.bboxMin + n.bboxMax)) - offset;
+    float radius = glm::dot(0.5f * (n.bboxMax - n.bboxMin), absNormal);
+    if (!(std::abs(centerDist) <= radius + planeMargin)) continue; // (also skips NaN and infinite offsets)
+
+    if (n.right >= 0) {
+      stack.push_back(n.right);
+      stack.push_back(ind + 1);
+      continue;
+    }
+
+    for (size_t i = n.start; i < n.start + n.count; i++) {
+      visit(order[i]);
+    }
+  }
+}
+
+size_t ElementBVH::allocatedBytes() const {
+  return polyscope::allocatedBytes(nodes) + polyscope::allocatedBytes(order);
+}
+
+// == Element tests
+
+float rayTriangleHit(glm::vec3 rayStart, glm::vec3 rayDir, glm::vec3 pA, glm::vec3 pB, glm::vec3 pC) {
+  // Moller-Trumbore, which gives t in units of rayDir
+  const float miss = std::numeric_limits<float>::infinity();
+  glm::vec3 eB = pB - pA;
+  glm::vec3 eC = pC - pA;
+  glm::vec3 p = glm::cross(rayDir, eC);
+  float det = glm::dot(eB, p);
+  if (det == 0.) return miss;
+  float invDet = 1.f / det;
+  glm::vec3 s = rayStart - pA;
+  float u = glm::dot(s, p) * invDet;
+  if (u < 0. || u > 1.) return miss;
+  glm::vec3 q = glm::cross(s, eB);
+  float v = glm::dot(rayDir, q) * invDet;
+  if (v < 0. || u + v > 1.) return miss;
+  float t = glm::dot(eC, q) * invDet;
+  return t >= 0. ? t : miss;
+}
+
+float raySphereHit(glm::vec3 rayStart, glm::vec3 rayDir, glm::vec3 center, float radius) {
+  const float miss = std::numeric_limits<float>::infinity();
+  glm::vec3 o = rayStart - center;
+  float a = glm::dot(rayDir, rayDir);
+  float b = glm::dot(o, rayDir);
+  float c = glm::dot(o, o) - radius * radius;
+  float disc = b * b - a * c;
+  if (disc < 0.) return miss;
+  float sq = std::sqrt(disc);
+  float t = (-b - sq) / a;
+  if (t < 0.) t = (-b + sq) / a; // starting inside of the sphere
+  return t >= 0. ? t : miss;
+}
+
+float rayCylinderHit(glm::vec3 rayStart, glm::vec3 rayDir, glm::vec3 tail, glm::vec3 tip, float radius) {
+  const float miss = std::numeric_limits<float>::infinity();
+  glm::vec3 axis = tip - tail;
+  float axisLen2 = glm::dot(axis, axis);
+  if (axisLen2 == 0.) return miss;
+
+  // Solve for the ray leaving the axis by the radius, in the plane perpendicular to the axis
+  glm::vec3 o = rayStart - tail;
+  glm::vec3 dPerp = rayDir - axis * (glm::dot(rayDir, axis) / axisLen2);
+  glm::vec3 oPerp = o - axis * (glm::dot(o, axis) / axisLen2);
+  float a = glm::dot(dPerp, dPerp);
+  if (a == 0.) return miss; // parallel to the axis, only the (absent) caps could be hit
+  float b = glm::dot(oPerp, dPerp);
+  float c = glm::dot(oPerp, oPerp) - radius * radius;
+  float disc = b * b - a * c;
+  if (disc < 0.) return miss;
+  float sq = std::sqrt(disc);
+  for (float t : {(-b - sq) / a, (-b + sq) / a}) {
+    if (t < 0.) continue;
+    float along = glm::dot(o + t * rayDir, axis) / axisLen2;
+    if (along >= 0. && along <= 1.) return t;
+  }
+  return miss;
+}
+
+glm::vec3 closestPointOnTriangle(glm::vec3 p, glm::vec3 pA, glm::vec3 pB, glm::vec3 pC, glm::vec3& bary) {
+  // Ericson, Real-Time Collision Detection, 5.1.5: find the Voronoi region of the triangle p is in
+  glm::vec3 ab = pB - pA;
+  glm::vec3 ac = pC - pA;
+  glm::vec3 ap = p - pA;
+  float d1 = glm::dot(ab, ap);
+  float d2 = glm::dot(ac, ap);
+  if (d1 <= 0. && d2 <= 0.) {
+    bary = glm::vec3{1., 0., 0.};
+    return pA;
+  }
+
+  glm::vec3 bp = p - pB;
+  float d3 = glm::dot(ab, bp);
+  float d4 = glm::dot(ac, bp);
+  if (d3 >= 0. && d4 <= d3) {
+    bary = glm::vec3{0., 1., 0.};
+    return pB;
+  }
+
+  float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0. && d1 >= 0. && d3 <= 0.) {
+    float v = d1 / (d1 - d3);
+    bary = glm::vec3{1.f - v, v, 0.};
+    return pA + v * ab;
+  }
+
+  glm::vec3 cp = p - pC;
+  float d5 = glm::dot(ab, cp);
+  float d6 = glm::dot(ac, cp);
+  if (d6 >= 0. && d5 <= d6) {
+    bary = glm::vec3{0., 0., 1.};
+    return pC;
+  }
+
+  float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0. && d2 >= 0. && d6 <= 0.) {
+    float w = d2 / (d2 - d6);
+    bary = glm::vec3{1.f - w, 0., w};
+    return pA + w * ac;
+  }
+
+  float va = d3 * d6 - d5 * d4;
+  if (va <= 0. && (d4 - d3) >= 0. && (d5 - d6) >= 0.) {
+    float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    bary = glm::vec3{0., 1.f - w, w};
+    return pB + w * (pC - pB);
+  }
+
+  float denom = 1.f / (va + vb + vc);
+  float v = vb * denom;
+  float w = vc * denom;
+  bary = glm::vec3{1.f - v - w, v, w};
+  return pA + v * ab + w * ac;
+}
+
+float pointSegmentDistance(glm::vec3 p, glm::vec3 tail, glm::vec3 tip) {
+  glm::vec3 axis = tip - tail;
+  float axisLen2 = glm::dot(axis, axis);
+  float along = axisLen2 > 0. ? glm::clamp(glm::dot(p - tail, axis) / axisLen2, 0.f, 1.f) : 0.f;
+  return glm::length(p - (tail + along * axis));
+}
+
+} // namespace polyscope
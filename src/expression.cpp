@@ -0,0 +1,454 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/expression.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace polyscope {
+
+struct Expression::Node {
+  enum class Kind { Number, Field, Negate, Binary, Call, Component };
+
+  Kind kind;
+  ExpressionValueType type;
+  double number = 0.;
+  size_t field = 0;
+  char op = ' ';         // for Binary: one of + - * / ^
+  std::string function;  // for Call
+  int component = 0;     // for Component
+  std::vector<std::shared_ptr<const Node>> args;
+};
+
+namespace {
+
+typedef Expression::Node Node;
+typedef std::shared_ptr<const Node> NodePtr;
+
+struct FunctionSpec {
+  const char* name;
+  size_t nArgs;
+  enum class Result { Componentwise, Scalar, Vector } result;
+  bool vectorArgs; // all arguments must be vectors
+};
+
+const FunctionSpec functionSpecs[] = {
+    {"abs", 1, FunctionSpec::Result::Componentwise, false},
+    {"sqrt", 1, FunctionSpec::Result::Componentwise, false},
+    {"exp", 1, FunctionSpec::Result::Componentwise, false},
+    {"log", 1, FunctionSpec::Result::Componentwise, false},
+    {"log2", 1, FunctionSpec::Result::Componentwise, false},
+    {"log10", 1, FunctionSpec::Result::Componentwise, false},
+    {"sin", 1, FunctionSpec::Result::Componentwise, false},
+    {"cos", 1, FunctionSpec::Result::Componentwise, false},
+    {"tan", 1, FunctionSpec::Result::Componentwise, false},
+    {"floor", 1, FunctionSpec::Result::Componentwise, false},
+    {"ceil", 1, FunctionSpec::Result::Componentwise, false},
+    {"sign", 1, FunctionSpec::Result::Componentwise, false},
+    {"min", 2, FunctionSpec::Result::Componentwise, false},
+    {"max", 2, FunctionSpec::Result::Componentwise, false},
+    {"pow", 2, FunctionSpec::Result::Componentwise, false},
+    {"clamp", 3, FunctionSpec::Result::Componentwise, false},
+    {"length", 1, FunctionSpec::Result::Scalar, false},
+    {"normalize", 1, FunctionSpec::Result::Vector, true},
+    {"dot", 2, FunctionSpec::Result::Scalar, true},
+    {"cross", 2, FunctionSpec::Result::Vector, true},
+};
+
+const FunctionSpec* findFunction(const std::string& name) {
+  for (const FunctionSpec& f : functionSpecs) {
+    if (name == f.name) return &f;
+  }
+  return nullptr;
+}
+
+// Recursive descent over the grammar
+//   sum     := product (('+' | '-') product)*
+//   product := unary (('*' | '/') unary)*
+//   unary   := '-' unary | power
+//   power   := postfix ('^' unary)?
+//   postfix := primary ('.' ('x' | 'y' | 'z'))*
+//   primary := number | name | '{' name '}' | name '(' sum (',' sum)* ')' | '(' sum ')' | '|' sum '|'
+class Parser {
+public:
+  Parser(const std::string& source_, const std::function<bool(const std::string&, ExpressionValueType&)>& fieldType_,
+         std::vector<std::string>& fieldNames_, std::vector<ExpressionValueType>& fieldTypes_)
+      : source(source_), fieldType(fieldType_), fieldNames(fieldNames_), fieldTypes(fieldTypes_) {}
+
+  NodePtr parse() {
+    NodePtr result = parseSum();
+    skipSpace();
+    if (pos < source.size()) fail("unexpected '" + std::string(1, source[pos]) + "'");
+    return result;
+  }
+
+private:
+  const std::string& source;
+  const std::function<bool(const std::string&, ExpressionValueType&)>& fieldType;
+  std::vector<std::string>& fieldNames;
+  std::vector<ExpressionValueType>& fieldTypes;
+  size_t pos = 0;
+
+  [[noreturn]] void fail(const std::string& message) {
+    throw std::invalid_argument("could not parse expression \"" + source + "\" at character " +
+                                std::to_string(pos + 1) + ": " + message);
+  }
+
+  void skipSpace() {
+    while (pos < source.size() && std::isspace(static_cast<unsigned char>(source[pos]))) pos++;
+  }
+
+  bool accept(char c) {
+    skipSpace();
+    if (pos < source.size() && source[pos] == c) {
+      pos++;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c) {
+    if (!accept(c)) fail("expected '" + std::string(1, c) + "'");
+  }
+
+  static NodePtr makeBinary(char op, NodePtr a, NodePtr b) {
+    std::shared_ptr<Node> n = std::make_shared<Node>();
+    n->kind = Node::Kind::Binary;
+    n->op = op;
+    bool anyVector = a->type == ExpressionValueType::Vector || b->type == ExpressionValueType::Vector;
+    n->type = anyVector ? ExpressionValueType::Vector : ExpressionValueType::Scalar;
+    n->args = {a, b};
+    return n;
+  }
+
+  NodePtr makeCall(const std::string& function, std::vector<NodePtr> args) {
+    const FunctionSpec* spec = findFunction(function);
+    if (args.size() != spec->nArgs) {
+      fail(function + "() takes " + std::to_string(spec->nArgs) + " argument" + (spec->nArgs == 1 ? "" : "s"));
+    }
+    bool anyVector = false;
+    for (const NodePtr& a : args) {
+      if (spec->vectorArgs && a->type != ExpressionValueType::Vector) fail(function + "() takes vectors");
+      anyVector = anyVector || a->type == ExpressionValueType::Vector;
+    }
+    std::shared_ptr<Node> n = std::make_shared<Node>();
+    n->kind = Node::Kind::Call;
+    n->function = function;
+    n->args = std::move(args);
+    switch (spec->result) {
+    case FunctionSpec::Result::Componentwise:
+      n->type = anyVector ? ExpressionValueType::Vector : ExpressionValueType::Scalar;
+      break;
+    case FunctionSpec::Result::Scalar:
+      n->type = ExpressionValueType::Scalar;
+      break;
+    case FunctionSpec::Result::Vector:
+      n->type = ExpressionValueType::Vector;
+      break;
+    }
+    return n;
+  }
+
+  NodePtr makeField(const std::string& name) {
+    ExpressionValueType type;
+    if (!fieldType(name, type)) fail("no field named [" + name + "]");
+    size_t iField = 0;
+    while (iField < fieldNames.size() && fieldNames[iField] != name) iField++;
+    if (iField == fieldNames.size()) {
+      fieldNames.push_back(name);
+      fieldTypes.push_back(type);
+    }
+    std::shared_ptr<Node> n = std::make_shared<Node>();
+    n->kind = Node::Kind::Field;
+    n->type = type;
+    n->field = iField;
+    return n;
+  }
+
+  static NodePtr makeNumber(double value) {
+    std::shared_ptr<Node> n = std::make_shared<Node>();
+    n->kind = Node::Kind::Number;
+    n->type = ExpressionValueType::Scalar;
+    n->number = value;
+    return n;
+  }
+
+  NodePtr parseSum() {
+    NodePtr result = parseProduct();
+    while (true) {
+      if (accept('+')) {
+        result = makeBinary('+', result, parseProduct());
+      } else if (accept('-')) {
+        result = makeBinary('-', result, parseProduct());
+      } else {
+        return result;
+      }
+    }
+  }
+
+  NodePtr parseProduct() {
+    NodePtr result = parseUnary();
+    while (true) {
+      if (accept('*')) {
+        result = makeBinary('*', result, parseUnary());
+      } else if (accept('/')) {
+        result = makeBinary('/', result, parseUnary());
+      } else {
+        return result;
+      }
+    }
+  }
+
+  NodePtr parseUnary() {
+    if (accept('-')) {
+      NodePtr arg = parseUnary();
+      std::shared_ptr<Node> n = std::make_shared<Node>();
+      n->kind = Node::Kind::Negate;
+      n->type = arg->type;
+      n->args = {arg};
+      return n;
+    }
+    return parsePower();
+  }
+
+  NodePtr parsePower() {
+    NodePtr base = parsePostfix();
+    if (accept('^')) {
+      NodePtr exponent = parseUnary();
+      return makeBinary('^', base, exponent);
+    }
+    return base;
+  }
+
+  NodePtr parsePostfix() {
+    NodePtr result = parsePrimary();
+    while (accept('.')) {
+      if (result->type != ExpressionValueType::Vector) fail("only vectors have components");
+      int component;
+      if (accept('x')) {
+        component = 0;
+      } else if (accept('y')) {
+        component = 1;
+      } else if (accept('z')) {
+        component = 2;
+      } else {
+        fail("expected a component x, y or z");
+      }
+      std::shared_ptr<Node> n = std::make_shared<Node>();
+      n->kind = Node::Kind::Component;
+      n->type = ExpressionValueType::Scalar;
+      n->component = component;
+      n->args = {result};
+      result = n;
+    }
+    return result;
+  }
+
+  NodePtr parsePrimary() {
+    skipSpace();
+    if (pos == source.size()) fail("unexpected end of expression");
+    char c = source[pos];
+
+    if (accept('(')) {
+      NodePtr inner = parseSum();
+      expect(')');
+      return inner;
+    }
+
+    if (accept('|')) {
+      NodePtr inner = parseSum();
+      expect('|');
+      if (inner->type == ExpressionValueType::Vector) return makeCall("length", {inner});
+      return makeCall("abs", {inner});
+    }
+
+    if (accept('{')) {
+      size_t end = source.find('}', pos);
+      if (end == std::string::npos) fail("expected '}'");
+      std::string name = source.substr(pos, end - pos);
+      NodePtr field = makeField(name);
+      pos = end + 1;
+      return field;
+    }
+
+    if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+      const char* start = source.c_str() + pos;
+      char* end;
+      double value = std::strtod(start, &end);
+      if (end == start) fail("expected a number");
+      pos += end - start;
+      return makeNumber(value);
+    }
+
+    if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+      size_t start = pos;
+      while (pos < source.size() && (std::isalnum(static_cast<unsigned char>(source[pos])) || source[pos] == '_')) {
+        pos++;
+      }
+      std::string name = source.substr(start, pos - start);
+
+      // A function call
+      size_t afterName = pos;
+      if (accept('(')) {
+        if (findFunction(name) == nullptr) {
+          pos = start;
+          fail("no function named " + name);
+        }
+        std::vector<NodePtr> args;
+        if (!accept(')')) {
+          do {
+            args.push_back(parseSum());
+          } while (accept(','));
+          expect(')');
+        }
+        return makeCall(name, std::move(args));
+      }
+      pos = afterName;
+
+      if (name == "pi") return makeNumber(3.14159265358979323846);
+      size_t namePos = pos;
+      pos = start; // (for the error message)
+      NodePtr field = makeField(name);
+      pos = namePos;
+      return field;
+    }
+
+    fail("unexpected '" + std::string(1, c) + "'");
+  }
+};
+
+// GLSL for a node, as a vec3 if toVector is set (broadcasting scalars)
+std::string nodeGLSL(const Node& n, const std::string& prefix, bool toVector = false) {
+  bool broadcast = toVector && n.type == ExpressionValueType::Scalar;
+  std::string result;
+  switch (n.kind) {
+  case Node::Kind::Number: {
+    std::ostringstream out;
+    out << std::setprecision(9) << n.number;
+    result = out.str();
+    if (result.find_first_of(".eEn") == std::string::npos) result += "."; // (a float literal)
+    break;
+  }
+  case Node::Kind::Field:
+    result = prefix + std::to_string(n.field);
+    break;
+  case Node::Kind::Negate:
+    result = "(-" + nodeGLSL(*n.args[0], prefix) + ")";
+    break;
+  case Node::Kind::Binary: {
+    bool vec = n.type == ExpressionValueType::Vector;
+    std::string a = nodeGLSL(*n.args[0], prefix, vec);
+    std::string b = nodeGLSL(*n.args[1], prefix, vec);
+    if (n.op == '^') {
+      result = "pow(" + a + ", " + b + ")";
+    } else {
+      result = "(" + a + " " + n.op + " " + b + ")";
+    }
+    break;
+  }
+  case Node::Kind::Call: {
+    const std::string& f = n.function;
+    bool vec = n.type == ExpressionValueType::Vector && findFunction(f)->result == FunctionSpec::Result::Componentwise;
+    std::vector<std::string> args;
+    for (const NodePtr& a : n.args) args.push_back(nodeGLSL(*a, prefix, vec));
+    if (f == "log10") {
+      result = "(log(" + args[0] + ") * 0.434294482)";
+    } else if (f == "length" && n.args[0]->type == ExpressionValueType::Scalar) {
+      result = "abs(" + args[0] + ")";
+    } else {
+      result = f + "(";
+      for (size_t i = 0; i < args.size(); i++) result += (i > 0 ? ", " : "") + args[i];
+      result += ")";
+    }
+    break;
+  }
+  case Node::Kind::Component:
+    result = nodeGLSL(*n.args[0], prefix) + "." + std::string(1, "xyz"[n.component]);
+    break;
+  }
+  if (broadcast) return "vec3(" + result + ")";
+  return result;
+}
+
+glm::vec3 nodeValue(const Node& n, const std::vector<glm::vec3>& fieldValues) {
+  // (scalars are held in all three components, so that they combine with vectors componentwise)
+  switch (n.kind) {
+  case Node::Kind::Number:
+    return glm::vec3(static_cast<float>(n.number));
+  case Node::Kind::Field:
+    return fieldValues[n.field];
+  case Node::Kind::Negate:
+    return -nodeValue(*n.args[0], fieldValues);
+  case Node::Kind::Binary: {
+    glm::vec3 a = nodeValue(*n.args[0], fieldValues);
+    glm::vec3 b = nodeValue(*n.args[1], fieldValues);
+    switch (n.op) {
+    case '+':
+      return a + b;
+    case '-':
+      return a - b;
+    case '*':
+      return a * b;
+    case '/':
+      return a / b;
+    default:
+      return glm::pow(a, b);
+    }
+  }
+  case Node::Kind::Call: {
+    std::vector<glm::vec3> a;
+    for (const NodePtr& arg : n.args) a.push_back(nodeValue(*arg, fieldValues));
+    const std::string& f = n.function;
+    if (f == "abs") return glm::abs(a[0]);
+    if (f == "sqrt") return glm::sqrt(a[0]);
+    if (f == "exp") return glm::exp(a[0]);
+    if (f == "log") return glm::log(a[0]);
+    if (f == "log2") return glm::log2(a[0]);
+    if (f == "log10") return glm::log(a[0]) * 0.434294482f;
+    if (f == "sin") return glm::sin(a[0]);
+    if (f == "cos") return glm::cos(a[0]);
+    if (f == "tan") return glm::tan(a[0]);
+    if (f == "floor") return glm::floor(a[0]);
+    if (f == "ceil") return glm::ceil(a[0]);
+    if (f == "sign") return glm::sign(a[0]);
+    if (f == "min") return glm::min(a[0], a[1]);
+    if (f == "max") return glm::max(a[0], a[1]);
+    if (f == "pow") return glm::pow(a[0], a[1]);
+    if (f == "clamp") return glm::clamp(a[0], a[1], a[2]);
+    if (f == "length") {
+      if (n.args[0]->type == ExpressionValueType::Scalar) return glm::abs(a[0]);
+      return glm::vec3(glm::length(a[0]));
+    }
+    if (f == "normalize") return glm::normalize(a[0]);
+    if (f == "dot") return glm::vec3(glm::dot(a[0], a[1]));
+    if (f == "cross") return glm::cross(a[0], a[1]);
+    return glm::vec3(0.);
+  }
+  case Node::Kind::Component:
+    return glm::vec3(nodeValue(*n.args[0], fieldValues)[n.component]);
+  }
+  return glm::vec3(0.);
+}
+
+} // namespace
+
+Expression::Expression(std::string source_,
+                       const std::function<bool(const std::string&, ExpressionValueType&)>& fieldType)
+    : source(std::move(source_)) {
+  root = Parser(source, fieldType, fieldNames, fieldTypes).parse();
+}
+
+ExpressionValueType Expression::getType() const { return root->type; }
+
+std::string Expression::toGLSL(const std::string& fieldVariablePrefix) const {
+  return nodeGLSL(*root, fieldVariablePrefix);
+}
+
+glm::vec3 Expression::evaluate(const std::vector<glm::vec3>& fieldValues) const {
+  return nodeValue(*root, fieldValues);
+}
+
+} // namespace polyscope
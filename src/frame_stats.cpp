@@ -0,0 +1,259 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/frame_stats.h"
+
+#include "polyscope/options.h"
+#include "polyscope/view.h"
+
+#include "imgui.h"
+#include "json/json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace polyscope {
+
+namespace {
+
+const size_t maxHistoryFrames = 300;
+
+const std::chrono::steady_clock::time_point profilerEpoch = std::chrono::steady_clock::now();
+
+double nowMs() {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - profilerEpoch).count();
+}
+
+// The frame being timed
+std::vector<CPUTiming> currentFrame;
+std::vector<size_t> openRegions; // indices in currentFrame of the regions which have not finished yet
+double frameStartMs = -1.;
+
+// Recent frames
+std::deque<std::vector<CPUTiming>> traceHistory;
+std::deque<double> frameHistory;
+std::vector<std::string> regionOrder;
+std::map<std::string, std::deque<double>> regionHistory; // per-frame total of each region, for frames where it ran
+
+template <typename T>
+void pushBounded(std::deque<T>& history, T entry) {
+  history.push_back(std::move(entry));
+  while (history.size() > maxHistoryFrames) {
+    history.pop_front();
+  }
+}
+
+TimingStats computeStats(std::string name, const std::deque<double>& durations) {
+  TimingStats stats;
+  stats.name = name;
+  stats.nFrames = durations.size();
+  if (durations.empty()) return stats;
+
+  std::vector<double> sorted(durations.begin(), durations.end());
+  std::sort(sorted.begin(), sorted.end());
+  auto percentile = [&](double p) {
+    size_t ind = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(std::max<size_t>(ind, 1), sorted.size()) - 1];
+  };
+  stats.p50Ms = percentile(0.50);
+  stats.p95Ms = percentile(0.95);
+  stats.p99Ms = percentile(0.99);
+  stats.maxMs = sorted.back();
+  return stats;
+}
+
+void buildStatsText(const TimingStats& s) {
+  ImGui::Text("%s: %.2f / %.2f / %.2f ms", s.name.c_str(), s.p50Ms, s.p95Ms, s.p99Ms);
+}
+
+// Startup
+struct OpenStartupPhase {
+  std::string name;
+  double startMs;
+  double nestedMs; // of the phases which finished inside this one
+};
+bool startupActive = false;
+double startupStartMs = 0.;
+StartupStats startupStats;
+std::vector<OpenStartupPhase> openStartupPhases;
+
+} // namespace
+
+ScopedCPUTimer::ScopedCPUTimer(const std::string& name) : active(options::enableCPUProfiling) {
+  if (active) open(name);
+}
+
+ScopedCPUTimer::ScopedCPUTimer(const std::string& name, const char* detail) : active(options::enableCPUProfiling) {
+  if (active) open(name + " " + detail);
+}
+
+ScopedCPUTimer::ScopedCPUTimer(const std::string& name, const std::string& detail, const char* detail2)
+    : active(options::enableCPUProfiling) {
+  if (active) open(name + " " + detail + " " + detail2);
+}
+
+void ScopedCPUTimer::open(std::string fullName) {
+  int depth = static_cast<int>(openRegions.size());
+  openRegions.push_back(currentFrame.size());
+  currentFrame.push_back(CPUTiming{std::move(fullName), depth, nowMs(), 0.});
+}
+
+ScopedCPUTimer::~ScopedCPUTimer() {
+  if (!active) return;
+  CPUTiming& t = currentFrame[openRegions.back()];
+  t.durationMs = nowMs() - t.startMs;
+  openRegions.pop_back();
+}
+
+ScopedStartupPhase::ScopedStartupPhase(const std::string& name, bool endsStartup_)
+    : active(startupActive), endsStartup(endsStartup_) {
+  if (!active) return;
+  openStartupPhases.push_back(OpenStartupPhase{name, nowMs(), 0.});
+}
+
+ScopedStartupPhase::~ScopedStartupPhase() {
+  if (!active) return;
+  double now = nowMs();
+  OpenStartupPhase open = openStartupPhases.back();
+  openStartupPhases.pop_back();
+  double durationMs = now - open.startMs;
+  if (!openStartupPhases.empty()) openStartupPhases.back().nestedMs += durationMs;
+  startupStats.phases.push_back(StartupPhase{open.name, durationMs - open.nestedMs});
+
+  if (endsStartup && openStartupPhases.empty()) {
+    startupActive = false;
+    startupStats.totalMs = now - startupStartMs;
+    startupStats.complete = true;
+    if (options::verbosity >= 2) {
+      std::cout << options::printPrefix << "startup took " << startupStats.totalMs << " ms:" << std::endl;
+      for (const StartupPhase& p : startupStats.phases) {
+        std::cout << options::printPrefix << "  " << p.name << ": " << p.ms << " ms" << std::endl;
+      }
+    }
+  }
+}
+
+StartupStats getStartupStats() { return startupStats; }
+
+FrameStats getFrameStats() {
+  FrameStats stats;
+  stats.frame = computeStats("frame", frameHistory);
+  for (const std::string& name : regionOrder) {
+    stats.regions.push_back(computeStats(name, regionHistory[name]));
+  }
+  return stats;
+}
+
+void resetFrameStats() {
+  traceHistory.clear();
+  frameHistory.clear();
+  regionOrder.clear();
+  regionHistory.clear();
+}
+
+void writeCPUTimingTrace(std::string filename) {
+  using json = nlohmann::json;
+
+  json events = json::array();
+  for (const std::vector<CPUTiming>& frame : traceHistory) {
+    for (const CPUTiming& t : frame) {
+      // complete events, with times in microseconds
+      events.push_back({{"name", t.name},
+                        {"ph", "X"},
+                        {"ts", 1000. * t.startMs},
+                        {"dur", 1000. * t.durationMs},
+                        {"pid", 0},
+                        {"tid", 0}});
+    }
+  }
+
+  std::ofstream outFile(filename);
+  if (!outFile) {
+    throw std::runtime_error("failed to open CPU timing trace file " + filename);
+  }
+  outFile << json{{"traceEvents", events}}.dump() << std::endl;
+}
+
+namespace profiling {
+
+void beginStartup() {
+  startupActive = true;
+  startupStartMs = nowMs();
+  startupStats = StartupStats();
+  openStartupPhases.clear();
+}
+
+void beginFrame() {
+  if (!openRegions.empty()) return; // nested inside another frame
+  frameStartMs = options::enableCPUProfiling ? nowMs() : -1.;
+}
+
+void endFrame() {
+  // regions still open belong to an enclosing scope (such as a nested show()), they are recorded with a later frame
+  if (!openRegions.empty()) return;
+
+  if (frameStartMs >= 0. && options::enableCPUProfiling) {
+    pushBounded(frameHistory, nowMs() - frameStartMs);
+  }
+  frameStartMs = -1.;
+  if (currentFrame.empty()) return;
+
+  std::map<std::string, double> frameTotals;
+  for (const CPUTiming& t : currentFrame) {
+    if (frameTotals.find(t.name) == frameTotals.end() && regionHistory.find(t.name) == regionHistory.end()) {
+      regionOrder.push_back(t.name);
+    }
+    frameTotals[t.name] += t.durationMs;
+  }
+  for (auto& entry : frameTotals) {
+    pushBounded(regionHistory[entry.first], entry.second);
+  }
+
+  pushBounded(traceHistory, std::move(currentFrame));
+  currentFrame.clear();
+}
+
+void buildFrameStatsGui() {
+  ImGui::SetNextTreeNodeOpen(false, ImGuiCond_FirstUseEver);
+  if (ImGui::TreeNode("CPU Timings")) {
+    ImGui::Checkbox("Enable", &options::enableCPUProfiling);
+    if (options::enableCPUProfiling) {
+      ImGui::Checkbox("Show overlay", &options::showFrameStatsOverlay);
+      FrameStats stats = getFrameStats();
+      ImGui::TextUnformatted("p50 / p95 / p99");
+      buildStatsText(stats.frame);
+      for (const TimingStats& s : stats.regions) {
+        buildStatsText(s);
+      }
+      if (ImGui::Button("Write trace")) {
+        writeCPUTimingTrace("polyscope_cpu_trace.json");
+      }
+      if (ImGui::Button("Reset")) {
+        resetFrameStats();
+      }
+    }
+    ImGui::TreePop();
+  }
+}
+
+void buildFrameStatsOverlay() {
+  if (!options::enableCPUProfiling || !options::showFrameStatsOverlay) return;
+
+  FrameStats stats = getFrameStats();
+  ImGui::SetNextWindowPos(ImVec2(view::windowWidth / 2., 10.), ImGuiCond_FirstUseEver);
+  ImGui::Begin("Frame stats", &options::showFrameStatsOverlay, ImGuiWindowFlags_AlwaysAutoResize);
+  ImGui::TextUnformatted("p50 / p95 / p99");
+  buildStatsText(stats.frame);
+  for (const TimingStats& s : stats.regions) {
+    buildStatsText(s);
+  }
+  ImGui::End();
+}
+
+} // namespace profiling
+} // namespace polyscope
@@ -0,0 +1,374 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/group.h"
+
+#include "polyscope/internal.h"
+#include "polyscope/messages.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/structure.h"
+#include "polyscope/view.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <tuple>
+
+namespace polyscope {
+
+namespace {
+
+std::map<std::string, std::unique_ptr<Group>> groups;
+
+// Incremented by beginGroupCullingPass(); each group evaluates its culling at most once per value
+size_t currentCullingPass = 1;
+
+template <typename T>
+void eraseFirst(std::vector<T*>& vec, T* val) {
+  auto it = std::find(vec.begin(), vec.end(), val);
+  if (it != vec.end()) vec.erase(it);
+}
+
+} // namespace
+
+Group::Group(std::string name_) : name(name_) {}
+
+Group::~Group() {
+  if (parentGroup != nullptr) {
+    parentGroup->removeChildGroup(*this);
+  }
+  for (Group* g : childGroups) {
+    g->parentGroup = nullptr;
+  }
+  for (Structure* s : childStructures) {
+    s->parentGroup = nullptr;
+  }
+  requestRedraw();
+}
+
+bool Group::containsGroup(Group& other) {
+  for (Group* g = &other; g != nullptr; g = g->parentGroup) {
+    if (g == this) return true;
+  }
+  return false;
+}
+
+Group* Group::addChildGroup(Group& child) {
+  if (child.containsGroup(*this)) {
+    error("Can not add group " + child.name + " to group " + name + ", which it contains");
+    return this;
+  }
+  if (child.parentGroup == this) return this;
+  if (child.parentGroup != nullptr) {
+    child.parentGroup->removeChildGroup(child);
+  }
+  childGroups.push_back(&child);
+  child.parentGroup = this;
+  boundsChanged();
+  requestRedraw();
+  return this;
+}
+
+Group* Group::addChildStructure(Structure& child) {
+  if (child.parentGroup == this) return this;
+  if (child.parentGroup != nullptr) {
+    child.parentGroup->removeChildStructure(child);
+  }
+  childStructures.push_back(&child);
+  child.parentGroup = this;
+  boundsChanged();
+  requestRedraw();
+  return this;
+}
+
+void Group::removeChildGroup(Group& child) {
+  if (child.parentGroup != this) return;
+  eraseFirst(childGroups, &child);
+  child.parentGroup = nullptr;
+  boundsChanged();
+  requestRedraw();
+}
+
+void Group::removeChildStructure(Structure& child) {
+  if (child.parentGroup != this) return;
+  eraseFirst(childStructures, &child);
+  child.parentGroup = nullptr;
+  boundsChanged();
+  requestRedraw();
+}
+
+size_t Group::nDescendantStructures() {
+  size_t n = childStructures.size();
+  for (Group* g : childGroups) {
+    n += g->nDescendantStructures();
+  }
+  return n;
+}
+
+Group* Group::setEnabled(bool newEnabled) {
+  if (newEnabled == enabled) return this;
+  enabled = newEnabled;
+  requestRedraw();
+  return this;
+}
+
+bool Group::isVisible() {
+  for (Group* g = this; g != nullptr; g = g->parentGroup) {
+    if (!g->enabled) return false;
+  }
+  return true;
+}
+
+Group* Group::setTransparency(float newVal) {
+  transparency = newVal;
+  for (Structure* s : childStructures) {
+    s->setTransparency(newVal);
+  }
+  for (Group* g : childGroups) {
+    g->setTransparency(newVal);
+  }
+  return this;
+}
+
+void Group::boundsChanged() {
+  for (Group* g = this; g != nullptr; g = g->parentGroup) {
+    g->boundsValid = false;
+  }
+}
+
+bool Group::getCullingBoundingBox(glm::vec3& bboxMin, glm::vec3& bboxMax) {
+
+  // (the structures' boxes are padded by a fraction of the scene length scale, so they move with it)
+  if (!boundsValid || boundsLengthScale != state::lengthScale) {
+    boundsMin = glm::vec3{std::numeric_limits<float>::infinity()};
+    boundsMax = glm::vec3{-std::numeric_limits<float>::infinity()};
+    boundsKnown = true;
+    bool any = false;
+    for (Structure* s : childStructures) {
+      if (s->objectSpaceLengthScale < 0.) {
+        boundsKnown = false;
+        continue;
+      }
+      glm::vec3 sMin, sMax;
+      std::tie(sMin, sMax) = s->cullingBoundingBox();
+      boundsMin = glm::min(boundsMin, sMin);
+      boundsMax = glm::max(boundsMax, sMax);
+      any = true;
+    }
+    for (Group* g : childGroups) {
+      glm::vec3 gMin, gMax;
+      if (g->getCullingBoundingBox(gMin, gMax)) {
+        boundsMin = glm::min(boundsMin, gMin);
+        boundsMax = glm::max(boundsMax, gMax);
+        any = true;
+      } else if (!g->boundsKnown) {
+        boundsKnown = false;
+      }
+    }
+    boundsEmpty = !any;
+    boundsValid = true;
+    boundsLengthScale = state::lengthScale;
+  }
+
+  if (!boundsKnown || boundsEmpty) return false;
+  bboxMin = boundsMin;
+  bboxMax = boundsMax;
+  return true;
+}
+
+bool Group::isInViewFrustum(const glm::mat4& clipRegion) {
+  if (!options::enableFrustumCulling) return true;
+
+  glm::vec3 worldMin, worldMax;
+  if (!getCullingBoundingBox(worldMin, worldMax)) return true;
+  return view::boxMayBeInView(worldMin, worldMax, clipRegion * view::getCameraPerspectiveMatrix() * view::viewMat);
+}
+
+bool Group::isOccluded() {
+  if (!options::enableOcclusionCulling) return false;
+  for (Group* g = this; g != nullptr; g = g->parentGroup) {
+    if (g->occluded) return true;
+  }
+  return false;
+}
+
+void Group::testOcclusion() {
+  glm::vec3 worldMin, worldMax;
+  if (!isVisible() || !getCullingBoundingBox(worldMin, worldMax) || !isInViewFrustum()) {
+    resetOcclusion();
+    return;
+  }
+
+  if (!occlusionQuery) {
+    occlusionQuery = render::engine->generateOcclusionQuery();
+  }
+
+  // Collect the previous test, as in Structure::testOcclusion()
+  collectOcclusionTest();
+  if (occlusionTestPending) return;
+
+  occlusionTestPending = render::engine->testBoxVisibility(worldMin, worldMax, *occlusionQuery);
+  if (!occlusionTestPending) {
+    occluded = false;
+  }
+}
+
+void Group::collectOcclusionTest() {
+  if (!occlusionTestPending || !occlusionQuery->isReady()) return;
+  bool wasOccluded = occluded;
+  occluded = !occlusionQuery->anySamplesPassed();
+  occlusionTestPending = false;
+  if (wasOccluded && !occluded) {
+    polyscope::requestRedraw();
+  }
+}
+
+bool Group::hasOutstandingOcclusionTest() { return options::enableOcclusionCulling && occluded && occlusionTestPending; }
+
+void Group::resetOcclusion() {
+  occluded = false;
+  occlusionTestPending = false;
+}
+
+void Group::evaluatePass() {
+  if (passEvaluated == currentCullingPass) return;
+  passEvaluated = currentCullingPass;
+
+  passHidden = !enabled;
+  passCulled = false;
+  if (parentGroup != nullptr) {
+    passHidden = passHidden || parentGroup->isHiddenInPass();
+    passCulled = parentGroup->isCulledInPass();
+  }
+  if (!passHidden && !passCulled) {
+    passCulled = !isInViewFrustum();
+  }
+}
+
+bool Group::isHiddenInPass() {
+  evaluatePass();
+  return passHidden;
+}
+
+bool Group::isCulledInPass() {
+  evaluatePass();
+  return passCulled;
+}
+
+void Group::buildUI() {
+  ImGui::PushID(name.c_str());
+
+  bool currEnabled = enabled;
+  if (ImGui::Checkbox("##enabled", &currEnabled)) {
+    setEnabled(currEnabled);
+  }
+  ImGui::SameLine();
+
+  std::string label = name + " (" + std::to_string(nDescendantStructures()) + ")###group";
+  uiTreeOpen = ImGui::TreeNode(label.c_str());
+  if (uiTreeOpen) {
+    if (ImGui::SliderFloat("Alpha", &transparency, 0., 1., "%.3f")) {
+      setTransparency(transparency);
+    }
+
+    // (copies, since a member's UI may remove it)
+    std::vector<Group*> groupRows = childGroups;
+    for (Group* g : groupRows) {
+      g->buildUI();
+    }
+    std::vector<Structure*> rows = childStructures;
+    internal::buildTreeNodeRows(
+        rows.size(), [&](size_t i) { return rows[i]->uiTreeOpen; },
+        [&](size_t i) {
+          ImGui::PushID(rows[i]->typeName().c_str()); // (names are only unique within a type)
+          rows[i]->buildUI();
+          ImGui::PopID();
+        });
+
+    ImGui::TreePop();
+  }
+
+  ImGui::PopID();
+}
+
+Group* createGroup(std::string name) {
+  if (groups.find(name) != groups.end()) {
+    error("Attempted to create group with name " + name + ", but a group with that name already exists");
+    return groups[name].get();
+  }
+  Group* g = new Group(name);
+  groups[name] = std::unique_ptr<Group>(g);
+  return g;
+}
+
+Group* getGroup(std::string name) {
+  auto it = groups.find(name);
+  if (it == groups.end()) {
+    error("No group with name " + name);
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+bool hasGroup(std::string name) { return groups.find(name) != groups.end(); }
+
+void removeGroup(std::string name, bool errorIfAbsent) {
+  auto it = groups.find(name);
+  if (it == groups.end()) {
+    if (errorIfAbsent) {
+      error("No group with name " + name);
+    }
+    return;
+  }
+  groups.erase(it);
+}
+
+void removeAllGroups() { groups.clear(); }
+
+std::vector<Group*> getRootGroups() {
+  std::vector<Group*> roots;
+  for (auto& g : groups) {
+    if (g.second->getParentGroup() == nullptr) roots.push_back(g.second.get());
+  }
+  return roots;
+}
+
+void beginGroupCullingPass() { currentCullingPass++; }
+
+void testGroupOcclusion() {
+  for (auto& g : groups) {
+    g.second->testOcclusion();
+  }
+}
+
+void collectGroupOcclusion() {
+  for (auto& g : groups) {
+    g.second->collectOcclusionTest();
+  }
+}
+
+bool haveOutstandingGroupOcclusionTests() {
+  for (auto& g : groups) {
+    if (g.second->hasOutstandingOcclusionTest()) return true;
+  }
+  return false;
+}
+
+void resetGroupOcclusion() {
+  for (auto& g : groups) {
+    g.second->resetOcclusion();
+  }
+}
+
+void buildGroupsGui() {
+  if (groups.empty()) return;
+
+  std::string header = "Groups (" + std::to_string(groups.size()) + ")###groups";
+  if (ImGui::CollapsingHeader(header.c_str())) {
+    for (Group* g : getRootGroups()) {
+      g->buildUI();
+    }
+  }
+}
+
+} // namespace polyscope
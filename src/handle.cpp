@@ -0,0 +1,50 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/handle.h"
+
+#include <vector>
+
+namespace polyscope {
+namespace internal {
+
+namespace {
+
+struct HandleSlot {
+  void* object; // nullptr while free
+  uint32_t generation;
+};
+
+std::vector<HandleSlot> handleSlots;
+std::vector<uint32_t> freeHandleSlots;
+
+} // namespace
+
+HandleID acquireHandle(void* object) {
+  HandleID id;
+  if (freeHandleSlots.empty()) {
+    id.slot = static_cast<uint32_t>(handleSlots.size());
+    handleSlots.push_back(HandleSlot{object, 0});
+  } else {
+    id.slot = freeHandleSlots.back();
+    freeHandleSlots.pop_back();
+    handleSlots[id.slot].object = object;
+  }
+  id.generation = handleSlots[id.slot].generation;
+  return id;
+}
+
+void releaseHandle(HandleID id) {
+  if (resolveHandle(id) == nullptr) return;
+  HandleSlot& s = handleSlots[id.slot];
+  s.object = nullptr;
+  s.generation++;
+  freeHandleSlots.push_back(id.slot);
+}
+
+void* resolveHandle(HandleID id) {
+  if (id.slot >= handleSlots.size()) return nullptr;
+  const HandleSlot& s = handleSlots[id.slot];
+  return s.generation == id.generation ? s.object : nullptr;
+}
+
+} // namespace internal
+} // namespace polyscope
@@ -2,38 +2,56 @@
 #include "polyscope/histogram.h"
 
 #include "polyscope/affine_remapper.h"
+#include "polyscope/parallel.h"
 #include "polyscope/polyscope.h"
 
 #include "imgui.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
+#include <mutex>
 
 using std::cout;
 using std::endl;
 
 namespace polyscope {
 
-// TODO make histograms lazy. There's no need to prepare here rather than on first draw.
+Histogram::Histogram() {}
 
-Histogram::Histogram() {
-  prepare();
-  fillBuffers();
+Histogram::Histogram(const std::vector<double>& values) { buildHistogram(values); }
+
+Histogram::Histogram(const std::vector<double>& values, const std::vector<double>& weights) {
+  buildHistogram(values, weights);
 }
 
-Histogram::Histogram(std::vector<double>& values) {
-  prepare();
-  buildHistogram(values);
+Histogram::~Histogram() {}
+
+void Histogram::buildHistogram(const std::vector<double>& values, const std::vector<double>& weights) {
+  buildHistogramImpl(values, weights);
 }
 
-Histogram::Histogram(std::vector<double>& values, const std::vector<double>& weights) {
-  prepare();
-  buildHistogram(values, weights);
+void Histogram::buildHistogram(const std::vector<float>& values, const std::vector<double>& weights) {
+  buildHistogramImpl(values, weights);
 }
 
-Histogram::~Histogram() {}
+void Histogram::buildHistogramLazily(std::function<void()> buildFunc) { pendingBuild = std::move(buildFunc); }
+
+void Histogram::ensureBuilt() {
+  if (!pendingBuild) return;
 
-void Histogram::buildHistogram(std::vector<double>& values, const std::vector<double>& weights) {
+  // (the caller may have set the colormap range already)
+  std::pair<double, double> range = colormapRange;
+  std::function<void()> buildFunc = std::move(pendingBuild);
+  pendingBuild = nullptr;
+  buildFunc();
+  colormapRange = range;
+}
+
+template <typename T>
+void Histogram::buildHistogramImpl(const std::vector<T>& values, const std::vector<double>& weights) {
+  pendingBuild = nullptr;
+  textureValid = false;
 
   hasWeighted = weights.size() > 0;
   useWeighted = hasWeighted;
@@ -47,38 +65,51 @@ void Histogram::buildHistogram(std::vector<double>& values, const std::vector<do
   // == Build histogram
   dataRange = robustMinMax(values);
   colormapRange = dataRange;
-
-  // Helper to build the four histogram variants
-  auto buildCurve = [&](size_t binCount, bool weighted, bool smooth, std::vector<std::array<double, 2>>& curveX,
-                        std::vector<double>& curveY) {
-    // linspace coords
-    double range = dataRange.second - dataRange.first;
-    double inc = range / binCount;
-    std::vector<double> sumBin(binCount, 0.0);
-
-    // count values in buckets
-    for (size_t iData = 0; iData < N; iData++) {
-
-      double iBinf = binCount * (values[iData] - dataRange.first) / range;
-      size_t iBin = std::floor(glm::clamp(iBinf, 0.0, (double)binCount - 1));
-
-      // NaN values and finite values near the bottom of float range lead to craziness, so only increment bins if we got
-      // something reasonable
-      if (iBin < binCount) {
-        if (weighted) {
-          sumBin[iBin] += weights[iData];
-        } else {
-          sumBin[iBin] += 1.0;
-        }
+  double range = dataRange.second - dataRange.first;
+
+  // Count values in the bins of all four variants in a single pass. Each block of values counts in to bins of its own,
+  // which are summed afterwards. Layout: raw, then smoothed, then the same again for the weighted variants.
+  size_t nBins = rawHistBinCount + smoothedHistBinCount;
+  size_t nSums = hasWeighted ? 2 * nBins : nBins;
+  std::vector<double> sumBins(nSums, 0.0);
+  std::mutex sumMutex;
+  auto binIndex = [&](double t, size_t binCount) {
+    double iBinf = binCount * t;
+    // NaN values and finite values near the bottom of float range lead to craziness, so only count values for which
+    // we got something reasonable (binCount means none)
+    if (std::isnan(iBinf)) return binCount;
+    return static_cast<size_t>(std::floor(glm::clamp(iBinf, 0.0, (double)binCount - 1)));
+  };
+  parallelForBlocks(0, N, [&](size_t blockStart, size_t blockEnd) {
+    std::vector<double> blockBins(nSums, 0.0);
+    for (size_t iData = blockStart; iData < blockEnd; iData++) {
+      double t = (values[iData] - dataRange.first) / range;
+      size_t iRaw = binIndex(t, rawHistBinCount);
+      size_t iSmoothed = binIndex(t, smoothedHistBinCount);
+      if (iRaw < rawHistBinCount) {
+        blockBins[iRaw] += 1.0;
+        if (hasWeighted) blockBins[nBins + iRaw] += weights[iData];
       }
+      if (iSmoothed < smoothedHistBinCount) {
+        blockBins[rawHistBinCount + iSmoothed] += 1.0;
+        if (hasWeighted) blockBins[nBins + rawHistBinCount + iSmoothed] += weights[iData];
+      }
+    }
+    std::lock_guard<std::mutex> lock(sumMutex);
+    for (size_t i = 0; i < nSums; i++) {
+      sumBins[i] += blockBins[i];
     }
+  });
 
+  // Helper to build the four histogram variants from the counts
+  auto buildCurve = [&](size_t binCount, const double* sumBin, bool smooth,
+                        std::vector<std::array<double, 2>>& curveX, std::vector<double>& curveY) {
+    // linspace coords
+    double inc = range / binCount;
 
     // build histogram coords
     curveX = std::vector<std::array<double, 2>>(binCount);
     curveY = std::vector<double>(binCount);
-    double prevSumU = 0.0;
-    double prevSumW = 0.0;
     double prevXEnd = dataRange.first;
     for (size_t iBin = 0; iBin < binCount; iBin++) {
       // y value
@@ -90,65 +121,67 @@ void Histogram::buildHistogram(std::vector<double>& values, const std::vector<do
       prevXEnd = xEnd;
     }
 
-    { // Rescale curves to [0,1] in both dimensions
+    auto rescaleHeight = [&]() {
       double maxHeight = *std::max_element(curveY.begin(), curveY.end());
+      if (maxHeight <= 0.) return; // no values
       for (size_t i = 0; i < binCount; i++) {
-        curveX[i][0] = (curveX[i][0] - dataRange.first) / range;
-        curveX[i][1] = (curveX[i][1] - dataRange.first) / range;
         curveY[i] /= maxHeight;
       }
+    };
+
+    // Rescale curves to [0,1] in both dimensions
+    for (size_t i = 0; i < binCount; i++) {
+      curveX[i][0] = (curveX[i][0] - dataRange.first) / range;
+      curveX[i][1] = (curveX[i][1] - dataRange.first) / range;
     }
+    rescaleHeight();
 
     if (smooth) {
       smoothCurve(curveX, curveY);
-
-      { // Rescale again after smoothing
-        double maxHeight = *std::max_element(curveY.begin(), curveY.end());
-        for (size_t i = 0; i < binCount; i++) {
-          curveY[i] /= maxHeight;
-        }
-      }
+      rescaleHeight(); // again after smoothing
     }
   };
 
   // Build the four variants of the curve
-  buildCurve(rawHistBinCount, false, false, rawHistCurveX, unweightedRawHistCurveY);
-  buildCurve(smoothedHistBinCount, false, true, smoothedHistCurveX, unweightedSmoothedHistCurveY);
+  buildCurve(rawHistBinCount, &sumBins[0], false, rawHistCurveX, unweightedRawHistCurveY);
+  buildCurve(smoothedHistBinCount, &sumBins[rawHistBinCount], true, smoothedHistCurveX, unweightedSmoothedHistCurveY);
   if (hasWeighted) {
-    buildCurve(rawHistBinCount, true, false, rawHistCurveX, weightedRawHistCurveY);
-    buildCurve(smoothedHistBinCount, true, true, smoothedHistCurveX, weightedSmoothedHistCurveY);
+    buildCurve(rawHistBinCount, &sumBins[nBins], false, rawHistCurveX, weightedRawHistCurveY);
+    buildCurve(smoothedHistBinCount, &sumBins[nBins + rawHistBinCount], true, smoothedHistCurveX,
+               weightedSmoothedHistCurveY);
   }
 
-
-  fillBuffers();
+  if (prepared) {
+    fillBuffers();
+  }
 }
 
 void Histogram::smoothCurve(std::vector<std::array<double, 2>>& xVals, std::vector<double>& yVals) {
+  if (yVals.empty()) return;
+
+  // Gaussian in the [0,1] coordinates of the bucket centers. The buckets are evenly spaced, so the weight only depends
+  // on how many buckets apart two are; the kernel is tabulated once and cut off where the weights become negligible.
+  const double widthFactor = 1000;
+  const double cutoffExponent = 14.; // weights below e^-14 ~ 1e-6 are dropped
+  double spacing = xVals[0][1] - xVals[0][0];
+  size_t radius = yVals.size() - 1;
+  if (spacing > 0.) {
+    radius = std::min(radius, static_cast<size_t>(std::ceil(std::sqrt(cutoffExponent / widthFactor) / spacing)));
+  }
+  std::vector<double> kernel(radius + 1);
+  for (size_t k = 0; k <= radius; k++) {
+    double dist = k * spacing;
+    kernel[k] = std::exp(-dist * dist * widthFactor);
+  }
 
-  auto smoothFunc = [&](double x1, double x2) {
-    // Tent
-    // double radius = 0.1;
-    // double val = (radius - std::abs(x1 - x2)) / radius;
-    // return std::max(val, 0.0);
-
-    // Gaussian
-    double widthFactor = 1000;
-    double dist = (x1 - x2);
-    return std::exp(-dist * dist * widthFactor);
-
-    // None
-    // if(x1 == x2) return 1.0;
-    // return 0.0;
-  };
-
-  std::vector<double> smoothedVals(yVals.size());
-  for (size_t i = 0; i < yVals.size(); i++) {
-    double bucketCi = 0.5 * (xVals[i][0] + xVals[i][1]);
+  size_t n = yVals.size();
+  std::vector<double> smoothedVals(n);
+  for (size_t i = 0; i < n; i++) {
+    size_t jStart = i >= radius ? i - radius : 0;
+    size_t jEnd = std::min(n, i + radius + 1);
     double sum = 0.0;
-    for (size_t j = 0; j < yVals.size(); j++) {
-      double bucketCj = 0.5 * (xVals[j][0] + xVals[j][1]);
-      double weight = smoothFunc(bucketCi, bucketCj);
-      sum += weight * yVals[j];
+    for (size_t j = jStart; j < jEnd; j++) {
+      sum += kernel[j > i ? j - i : i - j] * yVals[j];
     }
     smoothedVals[i] = sum;
   }
@@ -158,7 +191,9 @@ void Histogram::smoothCurve(std::vector<std::array<double, 2>>& xVals, std::vect
 
 void Histogram::updateColormap(const std::string& newColormap) {
   colormap = newColormap;
-  fillBuffers();
+  if (prepared) {
+    fillBuffers();
+  }
 }
 
 void Histogram::fillBuffers() {
@@ -190,6 +225,7 @@ void Histogram::fillBuffers() {
 
   if (histCurveY.size() == 0) {
     program->setAttribute("a_coord", coords);
+    textureValid = false;
     return;
   }
 
@@ -223,6 +259,7 @@ void Histogram::fillBuffers() {
 
   program->setAttribute("a_coord", coords);
   program->setTextureFromColormap("t_colormap", colormap, true);
+  textureValid = false;
 
   // Update current buffer settings
   currBufferWeighted = useWeighted;
@@ -243,12 +280,23 @@ void Histogram::prepare() {
 
 
 void Histogram::renderToTexture() {
+  ensureBuilt();
+
+  // The render target is only created once the histogram is first shown
+  if (!prepared) {
+    prepare();
+    fillBuffers();
+  }
 
   // Refill buffer if needed
   if (currBufferWeighted != useWeighted || currBufferSmoothed != useSmoothed) {
     fillBuffers();
   }
 
+  if (textureValid && colormapRange == textureColormapRange) {
+    return;
+  }
+
   framebuffer->clearColor = {0.0, 0.0, 0.0};
   framebuffer->clearAlpha = 0.2;
   framebuffer->setViewport(0, 0, texDim, texDim);
@@ -264,6 +312,9 @@ void Histogram::renderToTexture() {
 
   // Draw
   program->draw();
+
+  textureValid = true;
+  textureColormapRange = colormapRange;
 }
 
 
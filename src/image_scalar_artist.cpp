@@ -1,12 +1,62 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/image_scalar_artist.h"
 
+#include "polyscope/internal.h"
+#include "polyscope/parallel.h"
 #include "polyscope/polyscope.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <vector>
 
 namespace polyscope {
 
+namespace {
+// the longest side of the texture a tiled image is rendered in to
+const size_t maxTiledRenderSize = 1024;
+} // namespace
+
+ImageTileSource tileSourceFromFullResolution(
+    std::function<void(size_t x0, size_t y0, size_t w, size_t h, float* out)> readFullResolution, size_t dimX,
+    size_t dimY) {
+  return [readFullResolution, dimX, dimY](size_t level, size_t x0, size_t y0, size_t w, size_t h, float* out) {
+    if (level == 0) {
+      readFullResolution(x0, y0, w, h, out);
+      return;
+    }
+
+    // Average each scale x scale block, reading one row of blocks at a time
+    size_t scale = static_cast<size_t>(1) << level;
+    size_t fullX0 = x0 * scale;
+    size_t fullW = std::min(w * scale, dimX - fullX0);
+    std::vector<float> strip;
+    std::vector<double> sums(w);
+    std::vector<size_t> counts(w);
+    for (size_t j = 0; j < h; j++) {
+      size_t fullY0 = (y0 + j) * scale;
+      size_t fullH = std::min(scale, dimY - fullY0);
+      strip.resize(fullW * fullH);
+      readFullResolution(fullX0, fullY0, fullW, fullH, strip.data());
+
+      std::fill(sums.begin(), sums.end(), 0.);
+      std::fill(counts.begin(), counts.end(), 0);
+      for (size_t r = 0; r < fullH; r++) {
+        for (size_t c = 0; c < fullW; c++) {
+          float val = strip[r * fullW + c];
+          if (!std::isfinite(val)) continue;
+          sums[c / scale] += val;
+          counts[c / scale]++;
+        }
+      }
+      for (size_t i = 0; i < w; i++) {
+        out[j * w + i] =
+            counts[i] > 0 ? static_cast<float>(sums[i] / counts[i]) : std::numeric_limits<float>::quiet_NaN();
+      }
+    }
+  };
+}
+
 ImageScalarArtist::ImageScalarArtist(std::string name_, const std::vector<float>& data_, size_t dimX_, size_t dimY_,
                                      DataType dataType_)
     : name(name_), data(data_), dimX(dimX_), dimY(dimY_), dataType(dataType_),
@@ -31,6 +81,35 @@ ImageScalarArtist::ImageScalarArtist(std::string name_, std::shared_ptr<render::
   prepareSource();
 }
 
+ImageScalarArtist::ImageScalarArtist(std::string name_, ImageTileSource tileSource_, size_t dimX_, size_t dimY_,
+                                     DataType dataType_, size_t tileSize_)
+    : name(name_), dimX(dimX_), dimY(dimY_), dataType(dataType_), tiled(true),
+      cMap(name + "#cmap", defaultColorMap(dataType)), tileSource(tileSource_),
+      tileSize(std::max<size_t>(tileSize_, 1)), viewLower(0., 0.), viewUpper(dimX_, dimY_) {
+
+  // Halve until the coarsest level fits in a single tile
+  size_t maxDim = std::max(dimX, dimY);
+  while (levelDim(maxDim, nLevels) > tileSize) {
+    nLevels++;
+  }
+  nLevels++;
+
+  // Read the coarsest level now, it is always shown under the finer tiles and gives the data range
+  size_t coarsest = nLevels - 1;
+  Tile& root = tiles[tileKey(coarsest, 0, 0)];
+  root.sizeX = levelDim(dimX, coarsest);
+  root.sizeY = levelDim(dimY, coarsest);
+  root.pixels = std::make_shared<std::vector<float>>(root.sizeX * root.sizeY);
+  tileSource(coarsest, 0, 0, root.sizeX, root.sizeY, root.pixels->data());
+
+  dataRange = robustMinMax(*root.pixels, 1e-5);
+  resetMapRange();
+}
+
+ImageScalarArtist::~ImageScalarArtist() {
+  tiles.clear(); // waits for the tiles still being read
+}
+
 ImageScalarArtist* ImageScalarArtist::resetMapRange() {
   switch (dataType) {
   case DataType::STANDARD:
@@ -51,29 +130,40 @@ ImageScalarArtist* ImageScalarArtist::resetMapRange() {
 
 void ImageScalarArtist::prepareSource() {
   // Fill a texture with the raw data
-  if (!readFromTex) {
+  if (!readFromTex && !tiled) {
     // common case
     textureRaw = render::engine->generateTextureBuffer(TextureFormat::R32F, dimX, dimY, &data.front());
   }
 
   // Texture and program for rendering in
-  framebuffer = render::engine->generateFrameBuffer(dimX, dimY);
-  textureRendered = render::engine->generateTextureBuffer(TextureFormat::RGB16F, dimX, dimY);
+  size_t renderX = dimX;
+  size_t renderY = dimY;
+  if (tiled && std::max(dimX, dimY) > maxTiledRenderSize) {
+    double shrink = static_cast<double>(maxTiledRenderSize) / std::max(dimX, dimY);
+    renderX = std::max<size_t>(1, std::round(dimX * shrink));
+    renderY = std::max<size_t>(1, std::round(dimY * shrink));
+  }
+  framebuffer = render::engine->generateFrameBuffer(renderX, renderY);
+  textureRendered = render::engine->generateTextureBuffer(TextureFormat::RGB16F, renderX, renderY);
   framebuffer->addColorBuffer(textureRendered);
-  framebuffer->setViewport(0, 0, dimX, dimY);
+  framebuffer->setViewport(0, 0, renderX, renderY);
+  framebuffer->clearColor = glm::vec3{0., 0., 0.};
+  framebuffer->clearAlpha = 1.;
 }
 
 void ImageScalarArtist::prepare() {
-  if (textureRaw == nullptr) {
+  if (framebuffer == nullptr) {
     // the first time, we need to also allocate the buffers for the raw source data
     prepareSource();
   }
 
   // Create the program
-  program = render::engine->requestShader("SCALAR_TEXTURE_COLORMAP", {"SHADE_COLORMAP_VALUE"},
-                                          render::ShaderReplacementDefaults::Process);
+  program = render::engine->requestShader(tiled ? "SCALAR_TEXTURE_TILE_COLORMAP" : "SCALAR_TEXTURE_COLORMAP",
+                                          {"SHADE_COLORMAP_VALUE"}, render::ShaderReplacementDefaults::Process);
   program->setAttribute("a_position", render::engine->screenTrianglesCoords());
-  program->setTextureFromBuffer("t_scalar", textureRaw.get());
+  if (!tiled) {
+    program->setTextureFromBuffer("t_scalar", textureRaw.get());
+  }
   program->setTextureFromColormap("t_colormap", cMap.get());
 }
 
@@ -88,7 +178,177 @@ void ImageScalarArtist::draw() {
   program->setUniform("u_rangeHigh", vizRange.second);
 
   framebuffer->bindForRendering();
-  program->draw();
+  if (tiled) {
+    drawTiles();
+  } else {
+    program->draw();
+  }
+}
+
+// ========================================================
+// ==========             Tiled Images           ==========
+// ========================================================
+
+uint64_t ImageScalarArtist::tileKey(size_t level, size_t tileX, size_t tileY) const {
+  return (static_cast<uint64_t>(level) << 56) | (static_cast<uint64_t>(tileX) << 28) | static_cast<uint64_t>(tileY);
+}
+
+size_t ImageScalarArtist::levelDim(size_t dim, size_t level) const {
+  size_t scale = static_cast<size_t>(1) << level;
+  return (dim + scale - 1) / scale;
+}
+
+std::array<size_t, 4> ImageScalarArtist::visibleTileRange(size_t level) const {
+  double tileSpan = static_cast<double>(tileSize << level); // in full-resolution pixels
+  double nTilesX = std::ceil(levelDim(dimX, level) / static_cast<double>(tileSize));
+  double nTilesY = std::ceil(levelDim(dimY, level) / static_cast<double>(tileSize));
+  auto clampTiles = [](double val, double nTiles) { return static_cast<size_t>(std::min(std::max(val, 0.), nTiles)); };
+  return {clampTiles(std::floor(viewLower.x / tileSpan), nTilesX),
+          clampTiles(std::ceil(viewUpper.x / tileSpan), nTilesX),
+          clampTiles(std::floor(viewLower.y / tileSpan), nTilesY),
+          clampTiles(std::ceil(viewUpper.y / tileSpan), nTilesY)};
+}
+
+void ImageScalarArtist::requestTile(size_t level, size_t tileX, size_t tileY) {
+  if (nPendingTiles >= maxPendingTiles && !internal::finishBackgroundFills) return;
+
+  Tile& tile = tiles[tileKey(level, tileX, tileY)];
+  size_t x0 = tileX * tileSize;
+  size_t y0 = tileY * tileSize;
+  tile.sizeX = std::min(tileSize, levelDim(dimX, level) - x0);
+  tile.sizeY = std::min(tileSize, levelDim(dimY, level) - y0);
+  tile.lastDrawnFrame = frameCount;
+  tile.pixels = std::make_shared<std::vector<float>>(tile.sizeX * tile.sizeY);
+
+  std::shared_ptr<std::vector<float>> pixels = tile.pixels;
+  ImageTileSource source = tileSource;
+  size_t sizeX = tile.sizeX;
+  size_t sizeY = tile.sizeY;
+  tile.fillTask.reset(new BackgroundTask(internal::getBufferPreparationQueue(), [=]() {
+    source(level, x0, y0, sizeX, sizeY, pixels->data());
+  }));
+  nPendingTiles++;
+}
+
+void ImageScalarArtist::uploadArrivedTiles() {
+  for (std::pair<const uint64_t, Tile>& entry : tiles) {
+    Tile& tile = entry.second;
+
+    if (tile.fillTask) {
+      if (!tile.fillTask->isDone() && !internal::finishBackgroundFills) continue;
+      std::unique_ptr<BackgroundTask> fillTask = std::move(tile.fillTask);
+      nPendingTiles--;
+      try {
+        fillTask->finish();
+      } catch (const std::exception& e) {
+        // leave the tile empty, so it is not requested again and the coarser levels show through
+        tile.pixels.reset();
+        warning("could not read a tile of image " + name, e.what());
+        continue;
+      }
+    }
+
+    if (!tile.texture && tile.pixels) {
+      tile.texture =
+          render::engine->generateTextureBuffer(TextureFormat::R32F, tile.sizeX, tile.sizeY, tile.pixels->data());
+      tile.pixels.reset();
+    }
+  }
+}
+
+void ImageScalarArtist::evictTiles() {
+  size_t nResident = nResidentTiles();
+  if (nResident <= tileCacheSize) return;
+
+  // Drop the least recently drawn, except those drawn this frame and the coarsest level
+  uint64_t rootKey = tileKey(nLevels - 1, 0, 0);
+  std::vector<std::pair<uint64_t, uint64_t>> candidates; // (last drawn frame, key)
+  for (std::pair<const uint64_t, Tile>& entry : tiles) {
+    const Tile& tile = entry.second;
+    if (tile.texture && entry.first != rootKey && tile.lastDrawnFrame != frameCount) {
+      candidates.emplace_back(tile.lastDrawnFrame, entry.first);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+  for (size_t i = 0; i < candidates.size() && nResident > tileCacheSize; i++) {
+    tiles.erase(candidates[i].second);
+    nResident--;
+  }
+}
+
+void ImageScalarArtist::drawTiles() {
+  frameCount++;
+
+  // The level whose pixels are closest to (but no smaller than) the pixels they are drawn in to
+  glm::vec2 viewSize = viewUpper - viewLower;
+  double imagePerRenderPixel = std::max(viewSize.x / framebuffer->getSizeX(), viewSize.y / framebuffer->getSizeY());
+  size_t targetLevel = 0;
+  while (targetLevel + 1 < nLevels &&
+         static_cast<double>(static_cast<size_t>(2) << targetLevel) <= imagePerRenderPixel) {
+    targetLevel++;
+  }
+
+  // Request the missing tiles of that level, then upload whatever has arrived
+  std::array<size_t, 4> range = visibleTileRange(targetLevel);
+  for (size_t tileY = range[2]; tileY < range[3]; tileY++) {
+    for (size_t tileX = range[0]; tileX < range[1]; tileX++) {
+      if (tiles.find(tileKey(targetLevel, tileX, tileY)) == tiles.end()) {
+        requestTile(targetLevel, tileX, tileY);
+      }
+    }
+  }
+  uploadArrivedTiles();
+
+  // Draw each level over the coarser ones, so gaps show the best tiles present
+  framebuffer->clear();
+  for (size_t level = nLevels; level-- > targetLevel;) {
+    size_t scale = static_cast<size_t>(1) << level;
+    range = visibleTileRange(level);
+    for (size_t tileY = range[2]; tileY < range[3]; tileY++) {
+      for (size_t tileX = range[0]; tileX < range[1]; tileX++) {
+        auto it = tiles.find(tileKey(level, tileX, tileY));
+        if (it == tiles.end() || !it->second.texture) continue;
+        Tile& tile = it->second;
+        tile.lastDrawnFrame = frameCount;
+
+        // The tile's rectangle, from full-resolution pixels to the [-1,1] range of the render target
+        glm::vec2 lower(tileX * tileSize * scale, tileY * tileSize * scale);
+        glm::vec2 upper = lower + glm::vec2(tile.sizeX * scale, tile.sizeY * scale);
+        program->setUniform("u_tileLower", 2.f * (lower - viewLower) / viewSize - 1.f);
+        program->setUniform("u_tileUpper", 2.f * (upper - viewLower) / viewSize - 1.f);
+        program->setTextureFromBuffer("t_scalar", tile.texture.get());
+        program->draw();
+      }
+    }
+  }
+
+  evictTiles();
+  if (nPendingTiles > 0) {
+    requestRedraw(); // keep drawing until the tiles arrive
+  }
+}
+
+ImageScalarArtist* ImageScalarArtist::setViewRegion(glm::vec2 lower, glm::vec2 upper) {
+  viewLower = lower;
+  viewUpper = upper;
+  requestRedraw();
+  return this;
+}
+std::pair<glm::vec2, glm::vec2> ImageScalarArtist::getViewRegion() { return {viewLower, viewUpper}; }
+
+ImageScalarArtist* ImageScalarArtist::setTileCacheSize(size_t nTiles) {
+  tileCacheSize = nTiles;
+  evictTiles();
+  return this;
+}
+size_t ImageScalarArtist::getTileCacheSize() { return tileCacheSize; }
+
+size_t ImageScalarArtist::nResidentTiles() {
+  size_t count = 0;
+  for (std::pair<const uint64_t, Tile>& entry : tiles) {
+    if (entry.second.texture) count++;
+  }
+  return count;
 }
 
 void ImageScalarArtist::buildImGUIWindow() {
@@ -98,8 +358,15 @@ void ImageScalarArtist::buildImGUIWindow() {
 
   float w = ImGui::GetWindowWidth();
   float h = w * dimY / dimX;
+  if (tiled) {
+    glm::vec2 viewSize = viewUpper - viewLower;
+    h = w * viewSize.y / viewSize.x;
+  }
 
   ImGui::Text("Dimensions: %zux%zu", dimX, dimY);
+  if (tiled) {
+    ImGui::Text("Tiles: %zu resident, %zu loading", nResidentTiles(), nPendingTiles);
+  }
   ImGui::Image(textureRendered->getNativeHandle(), ImVec2(w, h), ImVec2(0, 1), ImVec2(1, 0));
 
   // Data range
@@ -132,7 +399,7 @@ void ImageScalarArtist::buildImGUIWindow() {
 
 ImageScalarArtist* ImageScalarArtist::setColorMap(std::string val) {
   cMap = val;
-  program.reset();
+  if (program) program->setTextureFromColormap("t_colormap", cMap.get(), true);
   requestRedraw();
   return this;
 }
@@ -1,6 +1,9 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/imgui_config.h"
 
+#include "polyscope/frame_stats.h"
+#include "polyscope/options.h"
+
 namespace polyscope {
 
 
@@ -72,6 +75,7 @@ void configureImGuiStyle() {
 
 
 std::tuple<ImFontAtlas*, ImFont*, ImFont*> prepareImGuiFonts() {
+  ScopedStartupPhase startupTimer("prepareImGuiFonts");
 
   ImGuiIO& io = ImGui::GetIO();
 
@@ -80,6 +84,14 @@ std::tuple<ImFontAtlas*, ImFont*, ImFont*> prepareImGuiFonts() {
   ImFont* regularFont;
   ImFont* monoFont;
 
+  // Without Polyscope's UI, only custom UIs use the fonts; ImGui's small built-in font saves rasterizing ours
+  if (!options::buildGui) {
+    regularFont = io.Fonts->AddFontDefault();
+    monoFont = regularFont;
+    io.Fonts->Build();
+    return std::tuple<ImFontAtlas*, ImFont*, ImFont*>{io.Fonts, regularFont, monoFont};
+  }
+
   { // add regular font
     ImFontConfig config;
     regularFont = io.Fonts->AddFontFromMemoryCompressedTTF(render::getLatoRegularCompressedData(),
@@ -0,0 +1,338 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/instanced_surface_mesh.h"
+
+#include "polyscope/pick.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/render/engine.h"
+
+#include "polyscope/instanced_surface_mesh_color_quantity.h"
+#include "polyscope/instanced_surface_mesh_scalar_quantity.h"
+
+#include "imgui.h"
+
+#include <array>
+#include <limits>
+
+namespace polyscope {
+
+// Initialize statics
+const std::string InstancedSurfaceMesh::structureTypeName = "Instanced Surface Mesh";
+
+InstancedSurfaceMesh::InstancedSurfaceMesh(std::string name, std::vector<glm::vec3> vertexPositions,
+                                           std::vector<uint32_t> faceIndsEntries_,
+                                           std::vector<size_t> faceIndsStart_,
+                                           std::vector<glm::mat4> instanceTransforms_)
+    : QuantityStructure<InstancedSurfaceMesh>(name, structureTypeName), vertices(std::move(vertexPositions)),
+      faceIndsEntries(std::move(faceIndsEntries_)), faceIndsStart(std::move(faceIndsStart_)),
+      instanceTransforms(std::move(instanceTransforms_)),
+      surfaceColor(uniquePrefix() + "#surfaceColor", getNextUniqueColor()),
+      material(uniquePrefix() + "#material", "clay") {
+
+  // the pick shader adds face indices as floats
+  if (nFaces() >= (static_cast<size_t>(1) << 24)) {
+    error("instanced surface mesh " + name + " has too many faces per instance (" + std::to_string(nFaces()) +
+          "), at most 2^24 - 1 can be picked");
+  }
+
+  updateObjectSpaceBounds();
+}
+
+template <typename F>
+void InstancedSurfaceMesh::forEachTriangle(F&& f) {
+  for (size_t iF = 0; iF < nFaces(); iF++) {
+    size_t start = faceIndsStart.empty() ? 3 * iF : faceIndsStart[iF];
+    size_t D = faceIndsStart.empty() ? 3 : faceIndsStart[iF + 1] - start;
+
+    // implicitly triangulate from root
+    for (size_t j = 1; (j + 1) < D; j++) {
+      std::array<size_t, 3> vertexInds = {faceIndsEntries[start], faceIndsEntries[start + j],
+                                          faceIndsEntries[start + j + 1]};
+      f(iF, vertexInds);
+    }
+  }
+}
+
+void InstancedSurfaceMesh::draw() {
+  if (!isEnabled() || nInstances() == 0) {
+    return;
+  }
+
+  // If no quantity is coloring the instances, we should draw them
+  if (dominantQuantity == nullptr) {
+    if (program == nullptr) {
+      prepare();
+    }
+
+    setStructureUniforms(*program);
+    program->setUniform(baseColorHandle, getSurfaceColor());
+
+    program->draw();
+  }
+
+  // Draw the quantities
+  for (QuantityType* q : getEnabledQuantities()) {
+    q->drawTracked();
+  }
+}
+
+void InstancedSurfaceMesh::drawPick() {
+  if (!isEnabled() || nInstances() == 0) {
+    return;
+  }
+
+  if (pickProgram == nullptr) {
+    preparePick();
+  }
+
+  setStructureUniforms(*pickProgram);
+  pickProgram->draw();
+}
+
+void InstancedSurfaceMesh::prepare() {
+  ScopedCPUTimer timer(profilingName(), "prepare");
+  program = render::engine->requestShader("MESH_INSTANCED", addInstancedSurfaceMeshRules({"SHADE_BASECOLOR"}));
+  baseColorHandle = program->getUniformHandle("u_baseColor");
+
+  fillGeometryBuffers(*program);
+  render::engine->setMaterial(*program, getMaterial());
+}
+
+void InstancedSurfaceMesh::preparePick() {
+  pickProgram =
+      render::engine->requestShader("MESH_INSTANCED", addInstancedSurfaceMeshRules({"MESH_INSTANCE_PROPAGATE_PICK"}),
+                                    render::ShaderReplacementDefaults::Pick);
+
+  // Instance i picks as the range [i * nFaces, (i+1) * nFaces) of local indices
+  pick::releasePickBufferRanges(this); // (the range from the last time the pick program was built)
+  size_t pickStart = pick::requestPickBufferRange(this, nInstances() * nFaces());
+
+  std::vector<glm::vec3> instancePickStart(nInstances());
+  for (size_t i = 0; i < nInstances(); i++) {
+    instancePickStart[i] = pick::indToVec(pickStart + i * nFaces());
+  }
+  std::vector<float> faceIndex;
+  forEachTriangle([&](size_t iF, const std::array<size_t, 3>&) {
+    faceIndex.insert(faceIndex.end(), 3, static_cast<float>(iF));
+  });
+
+  fillGeometryBuffers(*pickProgram);
+  pickProgram->setAttribute("a_instancePickStart", instancePickStart);
+  pickProgram->setAttribute("a_faceIndex", faceIndex);
+}
+
+std::vector<std::string> InstancedSurfaceMesh::addInstancedSurfaceMeshRules(std::vector<std::string> initRules) {
+  initRules = addStructureRules(initRules);
+  if (wantsCullPosition()) {
+    initRules.push_back("MESH_PROPAGATE_CULLPOS");
+  }
+  return initRules;
+}
+
+std::vector<glm::vec4> InstancedSurfaceMesh::transformColumns() {
+  std::vector<glm::vec4> columns;
+  columns.reserve(4 * nInstances());
+  for (const glm::mat4& T : instanceTransforms) {
+    columns.insert(columns.end(), {T[0], T[1], T[2], T[3]});
+  }
+  return columns;
+}
+
+void InstancedSurfaceMesh::ensureGeometryBuffers() {
+  bool wantsCorners = !cornerPositions;
+  bool wantsCullPos = wantsCullPosition() && !cornerCullPos;
+  bool wantsTransforms = !transformBuffer;
+  if (!(wantsCorners || wantsCullPos || wantsTransforms)) {
+    return;
+  }
+
+  render::ScopedGPUMemoryAccount account(gpuMemory);
+
+  if (wantsCorners || wantsCullPos) {
+    std::vector<glm::vec3> positions, normals, cullPos;
+    forEachTriangle([&](size_t iF, const std::array<size_t, 3>& vertexInds) {
+      glm::vec3 pA = vertices[vertexInds[0]];
+      glm::vec3 pB = vertices[vertexInds[1]];
+      glm::vec3 pC = vertices[vertexInds[2]];
+
+      if (wantsCorners) {
+        glm::vec3 N = glm::cross(pB - pA, pC - pA);
+        float len = glm::length(N);
+        N = len > 0 ? N / len : glm::vec3{0., 0., 0.};
+        positions.insert(positions.end(), {pA, pB, pC});
+        normals.insert(normals.end(), 3, N);
+      }
+      if (wantsCullPos) {
+        cullPos.insert(cullPos.end(), 3, (pA + pB + pC) / 3.f);
+      }
+    });
+
+    auto upload = [](std::shared_ptr<render::AttributeBuffer>& buffer, const std::vector<glm::vec3>& data) {
+      buffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+      buffer->setData(data);
+    };
+    if (wantsCorners) {
+      upload(cornerPositions, positions);
+      upload(cornerNormals, normals);
+    }
+    if (wantsCullPos) {
+      upload(cornerCullPos, cullPos);
+    }
+  }
+
+  if (wantsTransforms) {
+    transformBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector4Float, 4);
+    transformBuffer->setData(transformColumns());
+  }
+}
+
+void InstancedSurfaceMesh::fillGeometryBuffers(render::ShaderProgram& p) {
+  ensureGeometryBuffers();
+  p.setAttribute("a_position", cornerPositions);
+  p.setAttribute("a_normal", cornerNormals);
+  p.setAttribute("a_instanceTransform", transformBuffer);
+  if (wantsCullPosition()) {
+    p.setAttribute("a_cullPos", cornerCullPos);
+  }
+}
+
+void InstancedSurfaceMesh::updateInstanceTransforms(const std::vector<glm::mat4>& newTransforms) {
+  if (newTransforms.size() == nInstances()) {
+    instanceTransforms = newTransforms;
+    if (transformBuffer) {
+      transformBuffer->setData(transformColumns(), true);
+    }
+  } else {
+    instanceTransforms = newTransforms;
+    removeAllQuantities();
+    transformBuffer.reset();
+    refresh();
+  }
+  updateObjectSpaceBounds();
+  requestRedraw();
+}
+
+void InstancedSurfaceMesh::buildPickUI(size_t localPickID) {
+  size_t iInstance = localPickID / nFaces();
+  size_t iFace = localPickID % nFaces();
+
+  ImGui::TextUnformatted(("Instance #" + std::to_string(iInstance) + "  face #" + std::to_string(iFace)).c_str());
+
+  ImGui::Spacing();
+  ImGui::Spacing();
+  ImGui::Spacing();
+  ImGui::Indent(20.);
+
+  // Build GUI to show the quantities
+  ImGui::Columns(2);
+  ImGui::SetColumnWidth(0, ImGui::GetWindowWidth() / 3);
+  for (auto& x : quantities) {
+    x.second->buildPickUI(iInstance);
+  }
+
+  ImGui::Indent(-20.);
+}
+
+void InstancedSurfaceMesh::buildCustomUI() {
+  ImGui::Text("#instances: %lld  #faces: %lld", static_cast<long long int>(nInstances()),
+              static_cast<long long int>(nFaces()));
+  if (ImGui::ColorEdit3("Color", &surfaceColor.get()[0], ImGuiColorEditFlags_NoInputs)) {
+    setSurfaceColor(surfaceColor.get());
+  }
+}
+
+void InstancedSurfaceMesh::buildCustomOptionsUI() {
+  if (render::buildMaterialOptionsGui(material.get())) {
+    material.manuallyChanged();
+    setMaterial(material.get()); // trigger the other updates that happen on set()
+  }
+}
+
+void InstancedSurfaceMesh::updateObjectSpaceBounds() {
+
+  // bounds of one instance
+  glm::vec3 baseMin = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  glm::vec3 baseMax = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  for (const glm::vec3& p : vertices) {
+    baseMin = componentwiseMin(baseMin, p);
+    baseMax = componentwiseMax(baseMax, p);
+  }
+
+  // the union of the transformed corners of the bounds of each instance
+  glm::vec3 min = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  glm::vec3 max = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  if (!vertices.empty()) {
+    for (const glm::mat4& T : instanceTransforms) {
+      for (int iCorner = 0; iCorner < 8; iCorner++) {
+        glm::vec3 corner{(iCorner & 1) ? baseMax.x : baseMin.x, (iCorner & 2) ? baseMax.y : baseMin.y,
+                         (iCorner & 4) ? baseMax.z : baseMin.z};
+        glm::vec3 p = glm::vec3(T * glm::vec4(corner, 1.));
+        min = componentwiseMin(min, p);
+        max = componentwiseMax(max, p);
+      }
+    }
+  }
+  objectSpaceBoundingBox = std::make_tuple(min, max);
+  objectSpaceLengthScale = nInstances() > 0 && !vertices.empty() ? glm::length(max - min) : 0.;
+  boundsChanged();
+}
+
+std::string InstancedSurfaceMesh::typeName() { return structureTypeName; }
+
+size_t InstancedSurfaceMesh::hostMemoryUsage() {
+  return allocatedBytes(vertices) + allocatedBytes(faceIndsEntries) + allocatedBytes(faceIndsStart) +
+         allocatedBytes(instanceTransforms);
+}
+
+void InstancedSurfaceMesh::refresh() {
+  program.reset();
+  pickProgram.reset();
+  QuantityStructure<InstancedSurfaceMesh>::refresh(); // call base class version, which refreshes quantities
+}
+
+InstancedSurfaceMesh* InstancedSurfaceMesh::setSurfaceColor(glm::vec3 val) {
+  surfaceColor = val;
+  requestRedraw();
+  return this;
+}
+glm::vec3 InstancedSurfaceMesh::getSurfaceColor() { return surfaceColor.get(); }
+
+InstancedSurfaceMesh* InstancedSurfaceMesh::setMaterial(std::string m) {
+  material = m;
+  refresh();
+  requestRedraw();
+  return this;
+}
+std::string InstancedSurfaceMesh::getMaterial() { return material.get(); }
+
+InstancedSurfaceMeshColorQuantity* InstancedSurfaceMesh::addInstanceColorQuantity(std::string name,
+                                                                                  const std::vector<glm::vec3>& colors) {
+  InstancedSurfaceMeshColorQuantity* q = new InstancedSurfaceMeshColorQuantity(name, colors, *this);
+  addQuantity(q);
+  return q;
+}
+
+InstancedSurfaceMeshScalarQuantity*
+InstancedSurfaceMesh::addInstanceScalarQuantity(std::string name, const std::vector<double>& values, DataType type) {
+  InstancedSurfaceMeshScalarQuantity* q = new InstancedSurfaceMeshScalarQuantity(name, values, *this, type);
+  addQuantity(q);
+  return q;
+}
+
+InstancedSurfaceMeshQuantity::InstancedSurfaceMeshQuantity(std::string name_, InstancedSurfaceMesh& mesh_,
+                                                           bool dominates_)
+    : Quantity<InstancedSurfaceMesh>(name_, mesh_, dominates_) {}
+
+InstancedSurfaceMesh* registerInstancedSurfaceMesh(std::string name, SurfaceMesh* baseMesh,
+                                                   const std::vector<glm::mat4>& instanceTransforms) {
+  checkInitialized();
+
+  InstancedSurfaceMesh* s = new InstancedSurfaceMesh(name, baseMesh->vertices, baseMesh->faceIndsEntries,
+                                                     baseMesh->faceIndsStart, instanceTransforms);
+  bool success = registerStructure(s);
+  if (!success) {
+    safeDelete(s);
+  }
+  return s;
+}
+
+} // namespace polyscope
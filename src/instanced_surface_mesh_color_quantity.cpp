@@ -0,0 +1,84 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/instanced_surface_mesh_color_quantity.h"
+
+#include "polyscope/polyscope.h"
+
+#include "imgui.h"
+
+namespace polyscope {
+
+InstancedSurfaceMeshColorQuantity::InstancedSurfaceMeshColorQuantity(std::string name,
+                                                                     const std::vector<glm::vec3>& values_,
+                                                                     InstancedSurfaceMesh& mesh_)
+    : InstancedSurfaceMeshQuantity(name, mesh_, true), values(values_) {
+  if (values.size() != parent.nInstances()) {
+    polyscope::error("Instanced surface mesh color quantity " + name + " does not have same number of values (" +
+                     std::to_string(values.size()) + ") as instances (" + std::to_string(parent.nInstances()) + ")");
+  }
+}
+
+void InstancedSurfaceMeshColorQuantity::draw() {
+  if (!isEnabled() || parent.nInstances() == 0) return;
+
+  // Make the program if we don't have one already
+  if (program == nullptr) {
+    createProgram();
+  }
+
+  parent.setStructureUniforms(*program);
+
+  program->draw();
+}
+
+std::string InstancedSurfaceMeshColorQuantity::niceName() { return name + " (instance color)"; }
+
+void InstancedSurfaceMeshColorQuantity::createProgram() {
+  program = render::engine->requestShader(
+      "MESH_INSTANCED", parent.addInstancedSurfaceMeshRules({"MESH_INSTANCE_PROPAGATE_COLOR", "SHADE_COLOR"}));
+
+  parent.fillGeometryBuffers(*program);
+  program->setAttribute("a_instanceColor", values);
+
+  render::engine->setMaterial(*program, parent.getMaterial());
+}
+
+void InstancedSurfaceMeshColorQuantity::refresh() {
+  program.reset();
+  Quantity::refresh();
+}
+
+void InstancedSurfaceMeshColorQuantity::dataUpdated() {
+  if (program) {
+    program->setAttribute("a_instanceColor", values, true);
+  }
+}
+
+InstancedSurfaceMeshColorQuantity*
+InstancedSurfaceMeshColorQuantity::updateData(const std::vector<glm::vec3>& newColors) {
+  if (newColors.size() != parent.nInstances()) {
+    polyscope::error("Instanced surface mesh color quantity " + name + " update has " +
+                     std::to_string(newColors.size()) + " colors for " + std::to_string(parent.nInstances()) +
+                     " instances");
+    return this;
+  }
+  values = newColors;
+  dataUpdated();
+  requestRedraw();
+  return this;
+}
+
+void InstancedSurfaceMeshColorQuantity::buildPickUI(size_t iInstance) {
+  ImGui::TextUnformatted(name.c_str());
+  ImGui::NextColumn();
+
+  glm::vec3 tempColor = values[iInstance];
+  ImGui::ColorEdit3("", &tempColor[0], ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_NoPicker);
+  ImGui::SameLine();
+  std::string colorStr = to_string_short(tempColor);
+  ImGui::TextUnformatted(colorStr.c_str());
+  ImGui::NextColumn();
+}
+
+size_t InstancedSurfaceMeshColorQuantity::hostMemoryUsage() { return allocatedBytes(values); }
+
+} // namespace polyscope
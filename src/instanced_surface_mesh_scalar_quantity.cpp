@@ -0,0 +1,79 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/instanced_surface_mesh_scalar_quantity.h"
+
+#include "polyscope/polyscope.h"
+
+#include "imgui.h"
+
+namespace polyscope {
+
+InstancedSurfaceMeshScalarQuantity::InstancedSurfaceMeshScalarQuantity(std::string name,
+                                                                       const std::vector<double>& values_,
+                                                                       InstancedSurfaceMesh& mesh_, DataType dataType_)
+    : InstancedSurfaceMeshQuantity(name, mesh_, true), ScalarQuantity(*this, values_, dataType_) {
+  if (values_.size() != parent.nInstances()) {
+    polyscope::error("Instanced surface mesh scalar quantity " + name + " does not have same number of values (" +
+                     std::to_string(values_.size()) + ") as instances (" + std::to_string(parent.nInstances()) +
+                     ")");
+  }
+}
+
+void InstancedSurfaceMeshScalarQuantity::draw() {
+  if (!isEnabled() || parent.nInstances() == 0) return;
+
+  // Make the program if we don't have one already
+  if (program == nullptr) {
+    createProgram();
+  }
+
+  parent.setStructureUniforms(*program);
+  setScalarUniforms(*program);
+
+  program->draw();
+}
+
+void InstancedSurfaceMeshScalarQuantity::buildCustomUI() {
+  ImGui::SameLine();
+
+  // == Options popup
+  if (ImGui::Button("Options")) {
+    ImGui::OpenPopup("OptionsPopup");
+  }
+  if (ImGui::BeginPopup("OptionsPopup")) {
+
+    buildScalarOptionsUI();
+
+    ImGui::EndPopup();
+  }
+
+  buildScalarUI();
+}
+
+void InstancedSurfaceMeshScalarQuantity::createProgram() {
+  program = render::engine->requestShader(
+      "MESH_INSTANCED", parent.addInstancedSurfaceMeshRules(addScalarRules({"MESH_INSTANCE_PROPAGATE_VALUE"})));
+
+  parent.fillGeometryBuffers(*program);
+  values.setAttribute(*program, "a_instanceValue");
+  program->setTextureFromColormap("t_colormap", cMap.get());
+
+  render::engine->setMaterial(*program, parent.getMaterial());
+}
+
+void InstancedSurfaceMeshScalarQuantity::refresh() {
+  program.reset();
+  Quantity::refresh();
+}
+
+void InstancedSurfaceMeshScalarQuantity::buildPickUI(size_t iInstance) {
+  ImGui::TextUnformatted(name.c_str());
+  ImGui::NextColumn();
+  ImGui::Text("%g", values[iInstance]);
+  ImGui::NextColumn();
+}
+
+std::string InstancedSurfaceMeshScalarQuantity::niceName() { return name + " (instance scalar)"; }
+
+size_t InstancedSurfaceMeshScalarQuantity::hostMemoryUsage() { return values.allocatedBytes(); }
+
+} // namespace polyscope
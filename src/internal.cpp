@@ -1,10 +1,55 @@
 // Copyright 2017-2021, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/internal.h"
 
+#include "polyscope/options.h"
+#include "polyscope/parallel.h"
+
+#include "imgui.h"
+
+#include <memory>
+
 namespace polyscope {
 namespace internal {
 
 bool pointCloudEfficiencyWarningReported = false;
+bool finishBackgroundFills = false;
+
+JobQueue& getBufferPreparationQueue() {
+  static std::unique_ptr<JobQueue> queue(new JobQueue(options::bufferPreparationThreads));
+  return *queue;
+}
+
+void buildTreeNodeRows(size_t nRows, const std::function<bool(size_t)>& isOpen,
+                       const std::function<void(size_t)>& buildRow) {
+  const size_t minClippedRun = 8; // (shorter runs cost less to build than to clip)
+
+  size_t iRow = 0;
+  while (iRow < nRows) {
+    if (isOpen(iRow)) {
+      buildRow(iRow);
+      iRow++;
+      continue;
+    }
+
+    size_t runEnd = iRow + 1;
+    while (runEnd < nRows && !isOpen(runEnd)) runEnd++;
+    if (runEnd - iRow < minClippedRun) {
+      for (; iRow < runEnd; iRow++) buildRow(iRow);
+      continue;
+    }
+
+    // (the clipper measures the height of the first row)
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(runEnd - iRow));
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+        buildRow(iRow + i);
+      }
+    }
+    clipper.End();
+    iRow = runEnd;
+  }
+}
 
 } // namespace internal
 } // namespace polyscope
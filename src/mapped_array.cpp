@@ -0,0 +1,266 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/mapped_array.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace polyscope {
+
+size_t mappedArrayDTypeSize(MappedArrayDType dtype) {
+  switch (dtype) {
+  case MappedArrayDType::Int8:
+  case MappedArrayDType::UInt8:
+    return 1;
+  case MappedArrayDType::Int16:
+  case MappedArrayDType::UInt16:
+    return 2;
+  case MappedArrayDType::Int32:
+  case MappedArrayDType::UInt32:
+  case MappedArrayDType::Float32:
+    return 4;
+  case MappedArrayDType::Int64:
+  case MappedArrayDType::UInt64:
+  case MappedArrayDType::Float64:
+    return 8;
+  }
+  return 0;
+}
+
+// A read-only mapping of a whole file, unmapped on destruction
+class MappedArray::Mapping {
+public:
+  Mapping(std::string filename) {
+#ifdef _WIN32
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) throw std::invalid_argument("Could not open array file " + filename);
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+      CloseHandle(fileHandle);
+      throw std::runtime_error("Could not read array file " + filename);
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+    if (size > 0) {
+      mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (mappingHandle != NULL) {
+        data = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+      }
+      if (data == nullptr) {
+        if (mappingHandle != NULL) CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        throw std::runtime_error("Could not map array file " + filename);
+      }
+    }
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw std::invalid_argument("Could not open array file " + filename);
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+      close(fd);
+      throw std::runtime_error("Could not read array file " + filename);
+    }
+    size = static_cast<size_t>(fileStat.st_size);
+    if (size > 0) {
+      void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Could not map array file " + filename);
+      }
+      data = static_cast<const unsigned char*>(ptr);
+    }
+    close(fd); // (the mapping keeps the file alive)
+#endif
+  }
+
+  ~Mapping() {
+#ifdef _WIN32
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mappingHandle != NULL) CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+#else
+    if (data != nullptr) munmap(const_cast<unsigned char*>(data), size);
+#endif
+  }
+
+  Mapping(const Mapping&) = delete;
+  Mapping& operator=(const Mapping&) = delete;
+
+  const unsigned char* data = nullptr;
+  size_t size = 0;
+
+private:
+#ifdef _WIN32
+  HANDLE fileHandle = INVALID_HANDLE_VALUE;
+  HANDLE mappingHandle = NULL;
+#endif
+};
+
+namespace {
+
+// Pulls the value which follows 'key': out of a .npy header dictionary, like "{'descr': '<f4', 'shape': (10, 3), }"
+std::string npyHeaderValue(const std::string& header, const std::string& key, const std::string& filename) {
+  size_t keyPos = header.find("'" + key + "'");
+  if (keyPos == std::string::npos) throw std::runtime_error("npy header has no " + key + ": " + filename);
+  size_t start = header.find(':', keyPos);
+  if (start == std::string::npos) throw std::runtime_error("npy header is malformed: " + filename);
+  start = header.find_first_not_of(' ', start + 1);
+  if (start == std::string::npos) throw std::runtime_error("npy header is malformed: " + filename);
+  size_t end;
+  if (header[start] == '(') {
+    end = header.find(')', start) + 1;
+  } else if (header[start] == '\'') {
+    end = header.find('\'', start + 1) + 1;
+  } else {
+    end = header.find_first_of(",}", start);
+  }
+  if (end == std::string::npos || end == 0) {
+    throw std::runtime_error("npy header is malformed: " + filename);
+  }
+  return header.substr(start, end - start);
+}
+
+MappedArrayDType npyDType(std::string descr, const std::string& filename) {
+  // descr looks like '<f4': byte order, kind, size in bytes
+  if (descr.size() < 5) throw std::runtime_error("npy file has unsupported dtype " + descr + ": " + filename);
+  char order = descr[1];
+  char kind = descr[2];
+  std::string bytes = descr.substr(3, descr.size() - 4);
+  if (order == '>' && bytes != "1") {
+    throw std::runtime_error("npy file is big-endian, which is not supported: " + filename);
+  }
+  if (kind == 'f' && bytes == "4") return MappedArrayDType::Float32;
+  if (kind == 'f' && bytes == "8") return MappedArrayDType::Float64;
+  if (kind == 'i' && bytes == "1") return MappedArrayDType::Int8;
+  if (kind == 'i' && bytes == "2") return MappedArrayDType::Int16;
+  if (kind == 'i' && bytes == "4") return MappedArrayDType::Int32;
+  if (kind == 'i' && bytes == "8") return MappedArrayDType::Int64;
+  if ((kind == 'u' || kind == 'b') && bytes == "1") return MappedArrayDType::UInt8;
+  if (kind == 'u' && bytes == "2") return MappedArrayDType::UInt16;
+  if (kind == 'u' && bytes == "4") return MappedArrayDType::UInt32;
+  if (kind == 'u' && bytes == "8") return MappedArrayDType::UInt64;
+  throw std::runtime_error("npy file has unsupported dtype " + descr + ": " + filename);
+}
+
+template <class E>
+double readValue(const unsigned char* ptr) {
+  E val;
+  std::memcpy(&val, ptr, sizeof(E));
+  return static_cast<double>(val);
+}
+
+} // namespace
+
+MappedArray::MappedArray() {}
+
+MappedArray MappedArray::mapFile(std::shared_ptr<Mapping> mapping, std::string filename, size_t dataOffset,
+                                 MappedArrayDType dtype, size_t rows, size_t cols, bool fortranOrder) {
+  MappedArray arr;
+  arr.mapping = mapping;
+  size_t elemSize = mappedArrayDTypeSize(dtype);
+  size_t dataSize = rows * cols * elemSize;
+  if (dataOffset > arr.mapping->size || arr.mapping->size - dataOffset < dataSize) {
+    throw std::runtime_error("Array file " + filename + " is too small for " + std::to_string(rows) + " x " +
+                             std::to_string(cols) + " values");
+  }
+  arr.base = arr.mapping->data + dataOffset;
+  arr.dataType = dtype;
+  arr.nRows = rows;
+  arr.nCols = cols;
+  arr.rowStrideBytes = fortranOrder ? elemSize : cols * elemSize;
+  arr.colStrideBytes = fortranOrder ? rows * elemSize : elemSize;
+  return arr;
+}
+
+MappedArray MappedArray::fromRawFile(std::string filename, MappedArrayDType dtype, size_t rows, size_t cols,
+                                     size_t byteOffset) {
+  return mapFile(std::make_shared<Mapping>(filename), filename, byteOffset, dtype, rows, cols, false);
+}
+
+MappedArray MappedArray::fromNpy(std::string filename) {
+
+  // (the header is read from the mapping too)
+  std::shared_ptr<Mapping> mapping = std::make_shared<Mapping>(filename);
+  const unsigned char* p = mapping->data;
+  size_t fileSize = mapping->size;
+  if (fileSize < 10 || std::memcmp(p, "\x93NUMPY", 6) != 0) {
+    throw std::runtime_error("not a npy file: " + filename);
+  }
+  unsigned int majorVersion = p[6];
+  size_t headerLen, headerStart;
+  if (majorVersion == 1) {
+    headerLen = p[8] | (p[9] << 8);
+    headerStart = 10;
+  } else {
+    if (fileSize < 12) throw std::runtime_error("not a npy file: " + filename);
+    headerLen = p[8] | (p[9] << 8) | (p[10] << 16) | (static_cast<size_t>(p[11]) << 24);
+    headerStart = 12;
+  }
+  if (headerStart + headerLen > fileSize) throw std::runtime_error("npy header is truncated: " + filename);
+  std::string header(reinterpret_cast<const char*>(p + headerStart), headerLen);
+
+  MappedArrayDType dtype = npyDType(npyHeaderValue(header, "descr", filename), filename);
+  bool fortranOrder = npyHeaderValue(header, "fortran_order", filename) == "True";
+
+  // Shape, like "(10, 3)", "(10,)" or "()"
+  std::string shapeStr = npyHeaderValue(header, "shape", filename);
+  std::vector<size_t> shape;
+  size_t pos = 1;
+  while (pos < shapeStr.size()) {
+    size_t next = shapeStr.find_first_of(",)", pos);
+    std::string dim = shapeStr.substr(pos, next - pos);
+    if (dim.find_first_of("0123456789") != std::string::npos) shape.push_back(std::stoull(dim));
+    if (next == std::string::npos) break;
+    pos = next + 1;
+  }
+  if (shape.size() > 2) {
+    throw std::runtime_error("npy file has " + std::to_string(shape.size()) + " dimensions, only 1D and 2D arrays " +
+                             "can be mapped: " + filename);
+  }
+  size_t rows = shape.size() > 0 ? shape[0] : 1;
+  size_t cols = shape.size() > 1 ? shape[1] : 1;
+
+  return mapFile(mapping, filename, headerStart + headerLen, dtype, rows, cols, fortranOrder);
+}
+
+double MappedArray::operator()(size_t i, size_t j) const {
+  const unsigned char* ptr = base + i * rowStrideBytes + j * colStrideBytes;
+  switch (dataType) {
+  case MappedArrayDType::Int8:
+    return readValue<int8_t>(ptr);
+  case MappedArrayDType::UInt8:
+    return readValue<uint8_t>(ptr);
+  case MappedArrayDType::Int16:
+    return readValue<int16_t>(ptr);
+  case MappedArrayDType::UInt16:
+    return readValue<uint16_t>(ptr);
+  case MappedArrayDType::Int32:
+    return readValue<int32_t>(ptr);
+  case MappedArrayDType::UInt32:
+    return readValue<uint32_t>(ptr);
+  case MappedArrayDType::Int64:
+    return readValue<int64_t>(ptr);
+  case MappedArrayDType::UInt64:
+    return readValue<uint64_t>(ptr);
+  case MappedArrayDType::Float32:
+    return readValue<float>(ptr);
+  case MappedArrayDType::Float64:
+    return readValue<double>(ptr);
+  }
+  return 0.;
+}
+
+} // namespace polyscope
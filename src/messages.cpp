@@ -5,6 +5,7 @@
 #include "polyscope/polyscope.h"
 
 #include <deque>
+#include <unordered_map>
 
 namespace polyscope {
 
@@ -16,13 +17,22 @@ namespace {
 struct WarningMessage {
   std::string baseMessage;
   std::string detailMessage;
-  int repeatCount;
+  size_t repeatCount;
 };
 bool showingWarning = false;
 
 // A queue of warning messages to show
 std::deque<WarningMessage> warningMessages;
 
+// The position of each queued base message, counting the messages already shown, so warning() finds repeats with one
+// hash lookup
+std::unordered_map<std::string, size_t> queuedWarningPositions;
+size_t shownWarningCount = 0;
+
+// Distinct warnings beyond this many in the queue are only counted
+const size_t maxQueuedWarnings = 50;
+size_t droppedWarningCount = 0;
+
 void buildErrorUI(std::string message, bool fatal) {
 
   ImGui::PushStyleVar(ImGuiStyleVar_WindowTitleAlign, ImVec2(0.5, 0.5));
@@ -82,7 +92,7 @@ void buildErrorUI(std::string message, bool fatal) {
   ImGui::PopStyleVar();
 }
 
-void buildWarningUI(std::string warningBaseString, std::string warningDetailString, int nRepeats) {
+void buildWarningUI(std::string warningBaseString, std::string warningDetailString, size_t nRepeats) {
 
   // Center modal window titles
   ImGui::PushStyleVar(ImGuiStyleVar_WindowTitleAlign, ImVec2(0.5, 0.5));
@@ -232,21 +242,27 @@ void terminatingError(std::string message) {
   std::exit(-1);
 }
 
-void warning(std::string baseMessage, std::string detailMessage) {
+void warning(const std::string& baseMessage, const std::string& detailMessage) {
 
-  // Look for a message with the same name
-  bool found = false;
-  for (WarningMessage& w : warningMessages) {
-    if (w.baseMessage == baseMessage) {
-      found = true;
-      w.repeatCount++;
-    }
+  // Look for a queued message with the same name
+  auto it = queuedWarningPositions.find(baseMessage);
+  if (it != queuedWarningPositions.end()) {
+    warningMessages[it->second - shownWarningCount].repeatCount++;
+    return;
   }
 
-  // Create a new message
-  if (!found) {
-    warningMessages.push_back(WarningMessage{baseMessage, detailMessage, 0});
+  if (warningMessages.size() >= maxQueuedWarnings) {
+    droppedWarningCount++;
+    return;
   }
+
+  // Create a new message
+  queuedWarningPositions.emplace(baseMessage, shownWarningCount + warningMessages.size());
+  warningMessages.push_back(WarningMessage{baseMessage, detailMessage, 0});
+}
+
+bool warningPending(const std::string& baseMessage) {
+  return queuedWarningPositions.find(baseMessage) != queuedWarningPositions.end();
 }
 
 void showDelayedWarnings() {
@@ -255,9 +271,21 @@ void showDelayedWarnings() {
     return;
   }
 
+  // (after the queue, past its limit)
+  if (droppedWarningCount > 0) {
+    warningMessages.push_back(WarningMessage{
+        "too many distinct warnings, " + std::to_string(droppedWarningCount) + " more were not shown", "", 0});
+    droppedWarningCount = 0;
+  }
+
   while (warningMessages.size() > 0) {
     showingWarning = true;
-    WarningMessage& currMessage = warningMessages.front();
+
+    // (taken off the queue before it is shown, so repeats raised meanwhile start a new message)
+    WarningMessage currMessage = std::move(warningMessages.front());
+    warningMessages.pop_front();
+    queuedWarningPositions.erase(currMessage.baseMessage);
+    shownWarningCount++;
 
     if (options::verbosity > 0) {
       std::cout << options::printPrefix << "[WARNING] " << currMessage.baseMessage;
@@ -269,7 +297,6 @@ void showDelayedWarnings() {
     auto func = std::bind(buildWarningUI, currMessage.baseMessage, currMessage.detailMessage, currMessage.repeatCount);
     pushContext(func, false);
 
-    warningMessages.pop_front();
     showingWarning = false;
   }
 }
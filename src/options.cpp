@@ -10,7 +10,14 @@ int verbosity = 2;
 std::string printPrefix = "[polyscope] ";
 bool errorsThrowExceptions = false;
 bool debugDrawPickBuffer = false;
+bool enableGPUProfiling = false;
+bool enablePipelineStatistics = false;
+bool enableCPUProfiling = false;
+bool showFrameStatsOverlay = false;
 int maxFPS = 60;
+OptionValue<PresentMode> presentMode(PresentMode::VSync);
+bool enableIdleMode = false;
+double idleModeTimeoutSeconds = 0.5;
 bool usePrefsFile = true;
 bool initializeWithDefaultStructures = true;
 bool alwaysRedraw = false;
@@ -22,23 +29,78 @@ bool giveFocusOnShow = false;
 
 bool screenshotTransparency = true;
 std::string screenshotExtension = ".png";
+bool asyncScreenshots = false;
+int screenshotWriterThreads = 2;
+std::string ffmpegPath = "ffmpeg";
+int recordingMaxQueuedFrames = 8;
+int streamReadThreads = 2;
+int meshLoadThreads = 4;
+size_t meshLoadMemoryBudget = size_t(1) << 30;
 
 // == Scene options
 
+// starts out ahead of the copy in processLazyProperties(), so the options are synced on the first frame
+size_t changeCount = 1;
+
 // Ground plane / shadows
-bool groundPlaneEnabled = true;
-GroundPlaneMode groundPlaneMode = GroundPlaneMode::TileReflection;
+OptionValue<bool> groundPlaneEnabled(true);
+OptionValue<GroundPlaneMode> groundPlaneMode(GroundPlaneMode::TileReflection);
 ScaledValue<float> groundPlaneHeightFactor = 0;
-int shadowBlurIters = 2;
-float shadowDarkness = 0.25;
+OptionValue<int> shadowBlurIters(2);
+OptionValue<float> shadowDarkness(0.25);
 
 // Rendering options
 
-int ssaaFactor = 1;
+OptionValue<int> ssaaFactor(1);
+OptionValue<int> msaaSamples(1);
+bool enableFXAA = false;
+bool eyeDomeLighting = false;
+float eyeDomeLightingStrength = 1.;
+float eyeDomeLightingRadius = 1.5;
+OptionValue<int> temporalAntiAliasingFrames(1);
+bool progressiveRendering = false;
+double progressiveRenderingDelay = 0.25;
+double screenBufferResizeDelay = 0.15;
+bool compactSceneBuffers = true;
+double targetFrameTimeMs = -1.;
+float renderScaleMin = 0.5;
+float renderScaleMax = 1.;
 
 // Transparency
-TransparencyMode transparencyMode = TransparencyMode::None;
-int transparencyRenderPasses = 8;
+OptionValue<TransparencyMode> transparencyMode(TransparencyMode::None);
+OptionValue<int> transparencyRenderPasses(8);
+bool transparencyAdaptivePasses = true;
+bool transparencySortTriangles = false;
+OptionValue<bool> impostorDepthPrepass(false);
+OptionValue<bool> deferredShading(false);
+
+std::string shaderCacheDirectory = "";
+std::string shaderWarmupProfile = "";
+bool parallelShaderCompilation = true;
+int eglDeviceIndex = 0;
+long long int instancedDrawingThreshold = 100000;
+int numThreads = 0;
+size_t backgroundPrepareMinTriangles = 1000000;
+int bufferPreparationThreads = 2;
+bool reorderForLocality = false;
+bool backgroundFieldTracing = false;
+size_t timeSeriesMaxFrames = 256;
+int timeSeriesPrefetchThreads = 2;
+size_t timeSeriesPrefetchFrames = 16;
+size_t timeSeriesStreamedGPUFrames = 8;
+size_t levelSetSelectionCacheSize = 8;
+bool volumeGridHalfPrecision = false;
+long long int parallelConversionThreshold = 100000;
+ScalarPrecision scalarPrecision = ScalarPrecision::Double;
+double scalarRangeClipPercentile = 0.;
+long long int gpuMemoryBudget = -1;
+double gpuReleaseIdleSeconds = -1.;
+bool compressMaterialTextures = true;
+long long int scratchMemoryBudget = 1073741824;
+bool enableFrustumCulling = true;
+bool enableOcclusionCulling = false;
+long long int meshClusterCullingMinTriangles = 1000000;
+bool cpuPicking = false;
 
 // === Advanced ImGui configuration
 
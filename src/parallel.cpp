@@ -0,0 +1,421 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/parallel.h"
+
+#include "polyscope/options.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace polyscope {
+
+#ifndef POLYSCOPE_NO_THREADS
+
+namespace {
+
+// One parallelForBlocks() call. Workers keep a reference, so one which wakes up late just finds no blocks left.
+struct ParallelJob {
+  size_t start, end, blockSize, nBlocks;
+  const std::function<void(size_t, size_t)>* blockFunc;
+  std::atomic<size_t> nextBlock{0};
+  std::atomic<size_t> blocksDone{0};
+  std::exception_ptr error;
+  std::mutex errorMutex;
+};
+
+// Set on pool threads, and on the calling thread while it helps, so nested calls run inline rather than deadlock
+thread_local bool inParallelFor = false;
+
+class ThreadPool {
+public:
+  ThreadPool(size_t nWorkers) {
+    for (size_t i = 0; i < nWorkers; i++) {
+      workers.emplace_back([this]() { workerLoop(); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      shuttingDown = true;
+    }
+    wakeWorkers.notify_all();
+    for (std::thread& t : workers) {
+      t.join();
+    }
+  }
+
+  size_t nWorkers() const { return workers.size(); }
+
+  void run(std::shared_ptr<ParallelJob> job) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      currentJob = job;
+      jobGeneration++;
+    }
+    wakeWorkers.notify_all();
+
+    // The calling thread does its share too
+    inParallelFor = true;
+    runBlocks(*job);
+    inParallelFor = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobFinished.wait(lock, [&]() { return job->blocksDone == job->nBlocks; });
+    currentJob.reset();
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wakeWorkers, jobFinished;
+  std::shared_ptr<ParallelJob> currentJob;
+  size_t jobGeneration = 0;
+  bool shuttingDown = false;
+
+  void workerLoop() {
+    inParallelFor = true;
+    size_t seenGeneration = 0;
+    while (true) {
+      std::shared_ptr<ParallelJob> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeWorkers.wait(lock, [&]() { return shuttingDown || jobGeneration != seenGeneration; });
+        if (shuttingDown) return;
+        seenGeneration = jobGeneration;
+        job = currentJob;
+      }
+      if (job) runBlocks(*job);
+    }
+  }
+
+  void runBlocks(ParallelJob& job) {
+    while (true) {
+      size_t iBlock = job.nextBlock++;
+      if (iBlock >= job.nBlocks) return;
+
+      size_t blockStart = job.start + iBlock * job.blockSize;
+      size_t blockEnd = std::min(job.end, blockStart + job.blockSize);
+      try {
+        (*job.blockFunc)(blockStart, blockEnd);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(job.errorMutex);
+        if (!job.error) job.error = std::current_exception();
+      }
+
+      if (++job.blocksDone == job.nBlocks) {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobFinished.notify_all();
+      }
+    }
+  }
+};
+
+std::mutex poolMutex; // held for the duration of each parallel call, so there is one job at a time
+std::unique_ptr<ThreadPool> pool;
+
+std::mutex executorMutex;
+ParallelExecutor executor; // set by the application, replaces the pool
+
+size_t requestedThreadCount() {
+  if (options::numThreads > 0) return options::numThreads;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Hand the blocks of a job to the application's executor, one task per block
+void runWithExecutor(const ParallelExecutor& exec, ParallelJob& job) {
+  exec(job.nBlocks, [&job](size_t iBlock) {
+    size_t blockStart = job.start + iBlock * job.blockSize;
+    size_t blockEnd = std::min(job.end, blockStart + job.blockSize);
+    bool wasInParallelFor = inParallelFor;
+    inParallelFor = true;
+    try {
+      (*job.blockFunc)(blockStart, blockEnd);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(job.errorMutex);
+      if (!job.error) job.error = std::current_exception();
+    }
+    inParallelFor = wasInParallelFor;
+    job.blocksDone++;
+  });
+}
+
+} // namespace
+
+void parallelForBlocks(size_t start, size_t end, const std::function<void(size_t, size_t)>& blockFunc,
+                       size_t minBlockSize) {
+  if (end <= start) return;
+  size_t nThreads = requestedThreadCount();
+  size_t n = end - start;
+  minBlockSize = std::max<size_t>(minBlockSize, 1);
+
+  if (nThreads == 1 || n <= minBlockSize || inParallelFor) {
+    blockFunc(start, end);
+    return;
+  }
+
+  // A few blocks per thread, so uneven blocks balance out
+  std::shared_ptr<ParallelJob> job = std::make_shared<ParallelJob>();
+  job->start = start;
+  job->end = end;
+  job->blockSize = std::max(minBlockSize, (n + 4 * nThreads - 1) / (4 * nThreads));
+  job->nBlocks = (n + job->blockSize - 1) / job->blockSize;
+  job->blockFunc = &blockFunc;
+
+  ParallelExecutor exec;
+  {
+    std::lock_guard<std::mutex> lock(executorMutex);
+    exec = executor;
+  }
+  if (exec) {
+    runWithExecutor(exec, *job);
+    if (job->blocksDone != job->nBlocks) {
+      throw std::logic_error("parallel executor returned before running all of its tasks");
+    }
+  } else {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (!pool || pool->nWorkers() != nThreads - 1) {
+      pool.reset(); // join the old threads first
+      pool.reset(new ThreadPool(nThreads - 1));
+    }
+    pool->run(job);
+  }
+
+  if (job->error) std::rethrow_exception(job->error);
+}
+
+size_t parallelThreadCount() { return requestedThreadCount(); }
+
+void setParallelExecutor(ParallelExecutor newExecutor) {
+  bool external = static_cast<bool>(newExecutor);
+  {
+    std::lock_guard<std::mutex> lock(executorMutex);
+    executor = std::move(newExecutor);
+  }
+  if (external) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    pool.reset(); // (started again if the executor is removed)
+  }
+}
+
+struct JobQueue::Impl {
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable jobAvailable, allFinished;
+  std::deque<std::function<void()>> jobs;
+  size_t nUnfinished = 0;
+  bool stopping = false;
+
+  void workerLoop() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (jobs.empty()) return; // only when stopping
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+
+      job();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        nUnfinished--;
+      }
+      allFinished.notify_all();
+    }
+  }
+};
+
+JobQueue::JobQueue(int nThreads) : impl(new Impl()) {
+  for (int i = 0; i < std::max(nThreads, 1); i++) {
+    impl->threads.emplace_back([this]() { impl->workerLoop(); });
+  }
+}
+
+JobQueue::~JobQueue() {
+  {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->stopping = true;
+  }
+  impl->jobAvailable.notify_all();
+  for (std::thread& t : impl->threads) {
+    t.join();
+  }
+}
+
+void JobQueue::push(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->jobs.push_back(std::move(job));
+    impl->nUnfinished++;
+  }
+  impl->jobAvailable.notify_one();
+}
+
+void JobQueue::wait() {
+  std::unique_lock<std::mutex> lock(impl->mutex);
+  impl->allFinished.wait(lock, [this]() { return impl->nUnfinished == 0; });
+}
+
+struct BackgroundTask::State {
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::atomic<bool> done{false};
+  std::exception_ptr error;
+};
+
+BackgroundTask::BackgroundTask(JobQueue& queue, std::function<void()> work) : state(std::make_shared<State>()) {
+  std::shared_ptr<State> s = state; // the job keeps its own reference, in case the task is destroyed first
+  queue.push([s, work]() {
+    try {
+      work();
+    } catch (...) {
+      s->error = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(s->mutex);
+      s->done = true;
+    }
+    s->finished.notify_all();
+  });
+}
+
+BackgroundTask::~BackgroundTask() {
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock, [this]() { return state->done.load(); });
+}
+
+bool BackgroundTask::isDone() const { return state->done; }
+
+void BackgroundTask::finish() {
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [this]() { return state->done.load(); });
+  }
+  if (state->error) {
+    std::exception_ptr error = state->error;
+    state->error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+#else
+
+// Single-threaded builds run everything in place
+
+void parallelForBlocks(size_t start, size_t end, const std::function<void(size_t, size_t)>& blockFunc,
+                       size_t minBlockSize) {
+  if (end <= start) return;
+  blockFunc(start, end);
+}
+
+size_t parallelThreadCount() { return 1; }
+
+void setParallelExecutor(ParallelExecutor newExecutor) {}
+
+struct JobQueue::Impl {};
+
+JobQueue::JobQueue(int nThreads) {}
+
+JobQueue::~JobQueue() {}
+
+void JobQueue::push(std::function<void()> job) { job(); }
+
+void JobQueue::wait() {}
+
+struct BackgroundTask::State {
+  std::exception_ptr error;
+};
+
+BackgroundTask::BackgroundTask(JobQueue& queue, std::function<void()> work) : state(std::make_shared<State>()) {
+  try {
+    work();
+  } catch (...) {
+    state->error = std::current_exception();
+  }
+}
+
+BackgroundTask::~BackgroundTask() {}
+
+bool BackgroundTask::isDone() const { return true; }
+
+void BackgroundTask::finish() {
+  if (state->error) {
+    std::exception_ptr error = state->error;
+    state->error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+#endif
+
+void parallelSortByKey(std::vector<uint64_t>& keys, std::vector<size_t>& values, unsigned int keyBits) {
+  if (keys.size() != values.size()) {
+    throw std::invalid_argument("parallelSortByKey() keys and values have different sizes");
+  }
+
+  const unsigned int digitBits = 8;
+  const size_t nBuckets = 1 << digitBits;
+  size_t n = keys.size();
+
+  // Each block histograms and scatters its own range, so the blocks are fixed up front
+  const size_t minBlockSize = 1 << 16;
+  size_t nBlocks = std::max<size_t>(1, std::min(n / minBlockSize, 4 * parallelThreadCount()));
+  size_t blockSize = (n + nBlocks - 1) / std::max<size_t>(nBlocks, 1);
+
+  std::vector<uint64_t> keysTmp(n);
+  std::vector<size_t> valuesTmp(n);
+  std::vector<size_t> offsets(nBlocks * nBuckets);
+
+  for (unsigned int shift = 0; shift < keyBits && shift < 64; shift += digitBits) {
+
+    // Count digits per block
+    std::fill(offsets.begin(), offsets.end(), 0);
+    parallelFor(
+        0, nBlocks,
+        [&](size_t iB) {
+          size_t* counts = &offsets[iB * nBuckets];
+          for (size_t i = iB * blockSize; i < std::min(n, (iB + 1) * blockSize); i++) {
+            counts[(keys[i] >> shift) & (nBuckets - 1)]++;
+          }
+        },
+        1);
+
+    // Output positions, ordered by digit and then by block, which keeps the sort stable
+    size_t sum = 0;
+    for (size_t d = 0; d < nBuckets; d++) {
+      for (size_t iB = 0; iB < nBlocks; iB++) {
+        size_t count = offsets[iB * nBuckets + d];
+        offsets[iB * nBuckets + d] = sum;
+        sum += count;
+      }
+    }
+
+    // Scatter
+    parallelFor(
+        0, nBlocks,
+        [&](size_t iB) {
+          size_t* pos = &offsets[iB * nBuckets];
+          for (size_t i = iB * blockSize; i < std::min(n, (iB + 1) * blockSize); i++) {
+            size_t p = pos[(keys[i] >> shift) & (nBuckets - 1)]++;
+            keysTmp[p] = keys[i];
+            valuesTmp[p] = values[i];
+          }
+        },
+        1);
+
+    keys.swap(keysTmp);
+    values.swap(valuesTmp);
+  }
+}
+
+} // namespace polyscope
@@ -1,10 +1,16 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/pick.h"
 
+#include "polyscope/parallel.h"
 #include "polyscope/polyscope.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <limits>
+#include <map>
 #include <tuple>
+#include <unordered_map>
 
 using std::cout;
 using std::endl;
@@ -16,17 +22,66 @@ size_t currLocalPickInd = 0;
 Structure* currPickStructure = nullptr;
 bool haveSelectionVal = false;
 
-// The next pick index that a structure can use to identify its elements
-// (get it by calling request pickBufferRange())
+// The first pick index past every range handed out so far
+// (get ranges by calling requestPickBufferRange())
 size_t nextPickBufferInd = 1; // 0 reserved for "none"
-// Track which ranges have been allocated to which structures
-std::vector<std::tuple<size_t, size_t, Structure*>> structureRanges;
+
+// The ranges allocated to structures, keyed by the start of the range, so indices can be looked up by bisection
+struct PickRange {
+  size_t end;
+  Structure* structure;
+};
+std::map<size_t, PickRange> structureRanges;
+
+// The starts of the ranges of each structure, so releasing them does not scan the ranges of all structures
+std::unordered_map<Structure*, std::vector<size_t>> structureRangeStarts;
+
+// Released ranges below nextPickBufferInd which can be handed out again, as start --> end. Neighbors are merged, so no
+// two of these touch.
+std::map<size_t, size_t> freeRanges;
+
+// Asynchronous queries which have not been resolved yet
+std::vector<std::shared_ptr<AsyncPickQuery>> pendingAsyncQueries;
+
+// Ranges released while asynchronous queries were in flight, as start --> end. The pixels those queries read were
+// rendered with the old owners, so the indices are only handed out again once the queries are resolved.
+std::vector<std::pair<size_t, size_t>> rangesReleasedDuringQueries;
+
+// Queries only render this many pixels in each direction around the queried pixel
+const int pickRegionRadius = 2;
+
+// What the pick buffer was last rendered for: state::redrawRequestCount, state::sceneRenderCount, the view, the active
+// viewport and the buffer size. While these are unchanged, queries whose pixels lie in the part of the buffer which was
+// rendered (lower left pixel and size, as in renderPickBuffer()) just read it again.
+typedef std::tuple<size_t, size_t, glm::mat4, Viewport*, int, int> PickBufferKey;
+PickBufferKey pickBufferKey;
+glm::ivec4 pickBufferRegion{0, 0, 0, 0};
+bool pickBufferValid = false; // (cleared when pick ranges change hands, which changes what the indices mean)
 
 
 // == Set up picking
 size_t requestPickBufferRange(Structure* requestingStructure, size_t count) {
+  if (count == 0) return nextPickBufferInd; // (nothing will be drawn with the range, so it need not be tracked)
 
-  // Check if we can satisfy the request
+  // Reuse the first released range which is big enough
+  std::map<size_t, size_t>::iterator freeIt = freeRanges.begin();
+  while (freeIt != freeRanges.end() && freeIt->second - freeIt->first < count) {
+    freeIt++;
+  }
+  if (freeIt != freeRanges.end()) {
+    size_t ret = freeIt->first;
+    size_t freeEnd = freeIt->second;
+    freeRanges.erase(freeIt);
+    if (ret + count < freeEnd) {
+      freeRanges[ret + count] = freeEnd;
+    }
+    structureRanges[ret] = PickRange{ret + count, requestingStructure};
+    structureRangeStarts[requestingStructure].push_back(ret);
+    pickBufferValid = false;
+    return ret;
+  }
+
+  // Otherwise append, if we can satisfy the request
   size_t maxPickInd = std::numeric_limits<size_t>::max();
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wshift-count-overflow"
@@ -45,10 +100,58 @@ size_t requestPickBufferRange(Structure* requestingStructure, size_t count) {
 
   size_t ret = nextPickBufferInd;
   nextPickBufferInd += count;
-  structureRanges.push_back(std::make_tuple(ret, nextPickBufferInd, requestingStructure));
+  structureRanges[ret] = PickRange{nextPickBufferInd, requestingStructure};
+  structureRangeStarts[requestingStructure].push_back(ret);
+  pickBufferValid = false;
   return ret;
 }
 
+// Hand a range back to be reused
+void freePickBufferRange(size_t start, size_t end) {
+
+  // Merge with the free ranges on either side
+  std::map<size_t, size_t>::iterator after = freeRanges.lower_bound(start);
+  if (after != freeRanges.end() && after->first == end) {
+    end = after->second;
+    after = freeRanges.erase(after);
+  }
+  if (after != freeRanges.begin()) {
+    std::map<size_t, size_t>::iterator before = std::prev(after);
+    if (before->second == start) {
+      start = before->first;
+      freeRanges.erase(before);
+    }
+  }
+
+  // A range at the end gives its indices back entirely
+  if (end == nextPickBufferInd) {
+    nextPickBufferInd = start;
+  } else {
+    freeRanges[start] = end;
+  }
+}
+
+void releasePickBufferRanges(Structure* releasingStructure) {
+  std::unordered_map<Structure*, std::vector<size_t>>::iterator startsIt = structureRangeStarts.find(releasingStructure);
+  if (startsIt == structureRangeStarts.end()) return;
+  std::vector<size_t> starts = std::move(startsIt->second);
+  structureRangeStarts.erase(startsIt);
+  pickBufferValid = false;
+
+  for (size_t rangeStart : starts) {
+    std::map<size_t, PickRange>::iterator it = structureRanges.find(rangeStart);
+    size_t start = it->first;
+    size_t end = it->second.end;
+    structureRanges.erase(it);
+
+    if (pendingAsyncQueries.empty()) {
+      freePickBufferRange(start, end);
+    } else {
+      rangesReleasedDuringQueries.emplace_back(start, end);
+    }
+  }
+}
+
 // == Manage stateful picking
 
 void resetSelection() {
@@ -86,32 +189,23 @@ void setSelection(std::pair<Structure*, size_t> newPick) {
 // == Helpers
 
 std::pair<Structure*, size_t> globalIndexToLocal(size_t globalInd) {
-  // Loop through the ranges that we have allocated to find the one correpsonding to this structure.
-  for (const auto& x : structureRanges) {
+  // The only range which could hold the index is the last one starting at or before it
+  std::map<size_t, PickRange>::const_iterator it = structureRanges.upper_bound(globalInd);
+  if (it == structureRanges.begin()) return {nullptr, 0};
+  it--;
 
-    size_t rangeStart = std::get<0>(x);
-    size_t rangeEnd = std::get<1>(x);
-    Structure* structure = std::get<2>(x);
-
-    if (globalInd >= rangeStart && globalInd < rangeEnd) {
-      return {structure, globalInd - rangeStart};
-    }
+  if (globalInd < it->second.end) {
+    return {it->second.structure, globalInd - it->first};
   }
-
   return {nullptr, 0};
 }
 
 size_t localIndexToGlobal(std::pair<Structure*, size_t> localPick) {
   if (localPick.first == nullptr) return 0;
 
-  for (const auto& x : structureRanges) {
-    size_t rangeStart = std::get<0>(x);
-    size_t rangeEnd = std::get<1>(x);
-    Structure* structure = std::get<2>(x);
-
-    if (structure == localPick.first) {
-      return rangeStart + localPick.second;
-    }
+  std::unordered_map<Structure*, std::vector<size_t>>::const_iterator startsIt = structureRangeStarts.find(localPick.first);
+  if (startsIt != structureRangeStarts.end() && !startsIt->second.empty()) {
+    return *std::min_element(startsIt->second.begin(), startsIt->second.end()) + localPick.second;
   }
 
   throw std::runtime_error("structure does not match any allocated pick range");
@@ -119,16 +213,37 @@ size_t localIndexToGlobal(std::pair<Structure*, size_t> localPick) {
 }
 
 
-std::pair<Structure*, size_t> evaluatePickQuery(int xPos, int yPos) {
+namespace {
 
-  // NOTE: hack used for debugging: if xPos == yPos == 1 we do a pick render but do not query the value.
+PickBufferKey currentPickBufferKey() {
+  return PickBufferKey{state::redrawRequestCount, state::sceneRenderCount, view::viewMat,
+                       getActiveViewport(),       view::bufferWidth,       view::bufferHeight};
+}
 
-  // Be sure not to pick outside of buffer
-  if (xPos < -1 || xPos >= view::bufferWidth || yPos < -1 || yPos >= view::bufferHeight) {
-    return {nullptr, 0};
-  }
+// Whether the pick buffer already holds the pixels of a region which lie inside of the buffer
+bool pickBufferHolds(int regionX, int regionY, int regionSizeX, int regionSizeY) {
+  if (!pickBufferValid || currentPickBufferKey() != pickBufferKey) return false;
+  int xMin = std::max(regionX, 0);
+  int yMin = std::max(regionY, 0);
+  int xEnd = std::min(regionX + regionSizeX, view::bufferWidth);
+  int yEnd = std::min(regionY + regionSizeY, view::bufferHeight);
+  return xMin >= pickBufferRegion[0] && yMin >= pickBufferRegion[1] &&
+         xEnd <= pickBufferRegion[0] + pickBufferRegion[2] && yEnd <= pickBufferRegion[1] + pickBufferRegion[3];
+}
 
+// Render the pick buffer, leaving it bound. With a region given (as its lower left pixel and size, in buffer pixels
+// from the bottom left), only the pixels in it are rendered, and structures which cannot reach them are skipped.
+// Nothing is rendered if the buffer still holds the region from an earlier call (see pickBufferKey).
+// Returns false if the buffer could not be bound.
+bool renderPickBuffer(bool useRegion = false, int regionX = 0, int regionY = 0, int regionSizeX = 1,
+                      int regionSizeY = 1) {
   render::FrameBuffer* pickFramebuffer = render::engine->pickFramebuffer.get();
+  if (!useRegion) {
+    regionX = 0;
+    regionY = 0;
+    regionSizeX = view::bufferWidth;
+    regionSizeY = view::bufferHeight;
+  }
 
   render::engine->setDepthMode();
   render::engine->setBlendMode(BlendMode::Disable);
@@ -136,27 +251,396 @@ std::pair<Structure*, size_t> evaluatePickQuery(int xPos, int yPos) {
   pickFramebuffer->resize(view::bufferWidth, view::bufferHeight);
   pickFramebuffer->setViewport(0, 0, view::bufferWidth, view::bufferHeight);
   pickFramebuffer->clearColor = glm::vec3{0., 0., 0.};
-  if (!pickFramebuffer->bindForRendering()) return {nullptr, 0};
-  pickFramebuffer->clear();
+  if (!pickFramebuffer->bindForRendering()) return false;
+  if (pickBufferHolds(regionX, regionY, regionSizeX, regionSizeY)) return true;
+
+  // Scales the region up to fill clip space, so frustum culling against it skips structures away from the query
+  glm::mat4 clipRegion(1.);
+  if (useRegion) {
+    render::engine->setScissor(regionX, regionY, regionSizeX, regionSizeY);
+    glm::vec2 bufferSize{view::bufferWidth, view::bufferHeight};
+    glm::vec2 regionSize{regionSizeX, regionSizeY};
+    glm::vec2 centerNDC = 2.f * (glm::vec2{regionX, regionY} + 0.5f * regionSize) / bufferSize - 1.f;
+    glm::vec2 halfSizeNDC = regionSize / bufferSize;
+    clipRegion[0][0] = 1. / halfSizeNDC.x;
+    clipRegion[1][1] = 1. / halfSizeNDC.y;
+    clipRegion[3][0] = -centerNDC.x / halfSizeNDC.x;
+    clipRegion[3][1] = -centerNDC.y / halfSizeNDC.y;
+  }
+  pickFramebuffer->clear(); // (like drawing, clearing only touches the scissored region)
 
   // Render pick buffer
+  Viewport* viewport = getActiveViewport();
   for (auto cat : state::structures) {
     for (auto x : cat.second) {
+      if (viewport != nullptr && !viewport->isStructureVisible(x.second)) continue;
+      if (!x.second->isVisibleInGroups()) continue;
+      if (x.second->isEnabled() && (!x.second->isInViewFrustum(clipRegion) || x.second->isOccluded())) {
+        render::engine->renderStats.structuresCulled++;
+        continue;
+      }
+      render::ScopedGPUMemoryAccount account(x.second->gpuMemory);
       x.second->drawPick();
     }
   }
 
+  if (useRegion) {
+    render::engine->disableScissor();
+  }
+
+  // (taken after drawing, so redraws requested by structures as they prepare their pick programs do not count)
+  pickBufferKey = currentPickBufferKey();
+  pickBufferRegion = glm::ivec4{regionX, regionY, regionSizeX, regionSizeY};
+  pickBufferValid = true;
+  return true;
+}
+
+// Render only the pixels near a queried one
+bool renderPickBufferNear(int bufferX, int bufferY) {
+  return renderPickBuffer(true, bufferX - pickRegionRadius, bufferY - pickRegionRadius, 2 * pickRegionRadius + 1,
+                          2 * pickRegionRadius + 1);
+}
+
+// While viewports are shown, queries at a pixel see the scene through the one showing it
+class PickViewportScope {
+public:
+  // (pixel in buffer coordinates from the top left)
+  PickViewportScope(int xPos, int yPos) {
+    if (!haveViewports() || getActiveViewport() != nullptr) return;
+    glm::vec2 screenCoords{(xPos + 0.5f) / view::bufferWidth, (yPos + 0.5f) / view::bufferHeight};
+    viewport = getViewportAt(screenCoords);
+    if (viewport == nullptr) {
+      covered = false;
+      return;
+    }
+    viewport->activate();
+  }
+  ~PickViewportScope() {
+    if (viewport) viewport->deactivate();
+  }
+
+  bool covered = true; // false if there are viewports but none shows the pixel, so there is nothing to pick
+  Viewport* viewport = nullptr;
+};
+
+bool structureIsRegistered(Structure* s) {
+  for (auto cat : state::structures) {
+    for (auto x : cat.second) {
+      if (x.second == s) return true;
+    }
+  }
+  return false;
+}
+
+// Ray cast through the center of a pixel on the CPU, for options::cpuPicking
+std::pair<Structure*, size_t> cpuPickQuery(int xPos, int yPos) {
+  // (unprojecting the near and far planes, which also covers orthographic views)
+  glm::vec4 viewport{0., 0., view::bufferWidth, view::bufferHeight};
+  glm::vec3 bufferPos{xPos + 0.5, view::bufferHeight - yPos + 0.5, 0.};
+  glm::mat4 proj = view::getCameraPerspectiveMatrix();
+  glm::vec3 nearPos = glm::unProject(bufferPos, view::viewMat, proj, viewport);
+  bufferPos.z = 1.;
+  glm::vec3 farPos = glm::unProject(bufferPos, view::viewMat, proj, viewport);
+  return rayCast(nearPos, farPos - nearPos);
+}
+
+} // namespace
+
+std::pair<Structure*, size_t> rayCast(glm::vec3 rayStart, glm::vec3 rayDir, float* tHit) {
+  std::pair<Structure*, size_t> result{nullptr, 0};
+  float tBest = std::numeric_limits<float>::infinity();
+  Viewport* viewport = getActiveViewport();
+  for (auto cat : state::structures) {
+    for (auto x : cat.second) {
+      if (!x.second->isEnabled() || !x.second->isVisibleInGroups()) continue;
+      if (viewport != nullptr && !viewport->isStructureVisible(x.second)) continue;
+      float t;
+      size_t localInd;
+      if (x.second->rayCastElement(rayStart, rayDir, t, localInd) && t < tBest) {
+        tBest = t;
+        result = {x.second, localInd};
+      }
+    }
+  }
+  if (tHit != nullptr) *tHit = tBest;
+  return result;
+}
+
+std::pair<Structure*, size_t> closestElement(glm::vec3 worldPos, float* dist) {
+  std::pair<Structure*, size_t> result{nullptr, 0};
+  float distBest = std::numeric_limits<float>::infinity();
+  for (auto cat : state::structures) {
+    for (auto x : cat.second) {
+      if (!x.second->isEnabled() || !x.second->isVisibleInGroups()) continue;
+      float d;
+      size_t localInd;
+      if (x.second->closestElement(worldPos, d, localInd) && d < distBest) {
+        distBest = d;
+        result = {x.second, localInd};
+      }
+    }
+  }
+  if (dist != nullptr) *dist = distBest;
+  return result;
+}
+
+std::pair<Structure*, size_t> evaluatePickQuery(int xPos, int yPos) {
+
+  // NOTE: hack used for debugging: if xPos == yPos == 1 we do a pick render but do not query the value.
+
+  // Be sure not to pick outside of buffer
+  if (xPos < -1 || xPos >= view::bufferWidth || yPos < -1 || yPos >= view::bufferHeight) {
+    return {nullptr, 0};
+  }
+
   if (xPos == -1 || yPos == -1) {
+    renderPickBuffer(); // the whole buffer, so it can be viewed
     return {nullptr, 0};
   }
 
+  PickViewportScope viewportScope(xPos, yPos);
+  if (!viewportScope.covered) return {nullptr, 0};
+
+  if (options::cpuPicking) return cpuPickQuery(xPos, yPos);
+
+  // Only the pixels near the query need to be rendered
+  int bufferY = view::bufferHeight - yPos;
+  if (!renderPickBufferNear(xPos, bufferY)) return {nullptr, 0};
+
   // Read from the pick buffer
-  std::array<float, 4> result = pickFramebuffer->readFloat4(xPos, view::bufferHeight - yPos);
+  std::array<float, 4> result = render::engine->pickFramebuffer->readFloat4(xPos, bufferY);
   size_t globalInd = pick::vecToInd(glm::vec3{result[0], result[1], result[2]});
 
   return pick::globalIndexToLocal(globalInd);
 }
 
+std::vector<std::pair<Structure*, size_t>> evaluatePickQueries(const std::vector<glm::ivec2>& pixels) {
+  std::vector<std::pair<Structure*, size_t>> results(pixels.size(), std::pair<Structure*, size_t>{nullptr, 0});
+
+  // Group the pixels by the viewport showing them, if any, since each group sees the scene through its own view
+  bool splitByViewport = haveViewports() && getActiveViewport() == nullptr;
+  std::map<Viewport*, std::vector<size_t>> groups;
+  for (size_t i = 0; i < pixels.size(); i++) {
+    glm::ivec2 p = pixels[i];
+    if (p.x < 0 || p.x >= view::bufferWidth || p.y < 0 || p.y >= view::bufferHeight) continue;
+    Viewport* viewport = nullptr;
+    if (splitByViewport) {
+      viewport = getViewportAt(glm::vec2{(p.x + 0.5f) / view::bufferWidth, (p.y + 0.5f) / view::bufferHeight});
+      if (viewport == nullptr) continue;
+    }
+    groups[viewport].push_back(i);
+  }
+
+  for (const std::pair<Viewport* const, std::vector<size_t>>& group : groups) {
+    const std::vector<size_t>& inds = group.second;
+    PickViewportScope viewportScope(pixels[inds.front()].x, pixels[inds.front()].y);
+
+    if (options::cpuPicking) {
+      for (size_t i : inds) {
+        results[i] = cpuPickQuery(pixels[i].x, pixels[i].y);
+      }
+      continue;
+    }
+
+    // Render the bounding box of the pixels once, and read it back in one go (rows as in evaluatePickQuery())
+    int xMin = view::bufferWidth, xMax = 0, yMin = view::bufferHeight, yMax = 0;
+    for (size_t i : inds) {
+      int bufferY = std::min(view::bufferHeight - pixels[i].y, view::bufferHeight - 1);
+      xMin = std::min(xMin, pixels[i].x);
+      xMax = std::max(xMax, pixels[i].x);
+      yMin = std::min(yMin, bufferY);
+      yMax = std::max(yMax, bufferY);
+    }
+    int sizeX = xMax - xMin + 1;
+    int sizeY = yMax - yMin + 1;
+    if (!renderPickBuffer(true, xMin, yMin, sizeX, sizeY)) continue;
+    std::vector<float> region = render::engine->pickFramebuffer->readFloat4Region(xMin, yMin, sizeX, sizeY);
+
+    for (size_t i : inds) {
+      int bufferY = std::min(view::bufferHeight - pixels[i].y, view::bufferHeight - 1);
+      const float* px = &region[4 * ((bufferY - yMin) * sizeX + (pixels[i].x - xMin))];
+      results[i] = globalIndexToLocal(vecToInd(glm::vec3{px[0], px[1], px[2]}));
+    }
+  }
+
+  return results;
+}
+
+std::shared_ptr<AsyncPickQuery> evaluatePickQueryAsync(int xPos, int yPos,
+                                                       std::function<void(std::pair<Structure*, size_t>)> callback) {
+
+  std::shared_ptr<AsyncPickQuery> query = std::make_shared<AsyncPickQuery>();
+  query->callback = callback;
+
+  // Be sure not to pick outside of buffer
+  if (xPos < 0 || xPos >= view::bufferWidth || yPos < 0 || yPos >= view::bufferHeight) {
+    query->isResolved = true;
+    if (query->callback) query->callback(query->result);
+    return query;
+  }
+
+  PickViewportScope viewportScope(xPos, yPos);
+  if (!viewportScope.covered) {
+    query->isResolved = true;
+    if (query->callback) query->callback(query->result);
+    return query;
+  }
+
+  if (options::cpuPicking) {
+    query->result = cpuPickQuery(xPos, yPos);
+    query->isResolved = true;
+    if (query->callback) query->callback(query->result);
+    return query;
+  }
+
+  int bufferY = view::bufferHeight - yPos;
+  if (!renderPickBufferNear(xPos, bufferY)) {
+    query->isResolved = true;
+    if (query->callback) query->callback(query->result);
+    return query;
+  }
+
+  query->pendingRead = render::engine->pickFramebuffer->readFloat4Async(xPos, bufferY);
+  pendingAsyncQueries.push_back(query);
+  return query;
+}
+
+std::map<Structure*, std::vector<size_t>> queryRegion(const std::vector<glm::vec2>& polygon) {
+  std::map<Structure*, std::vector<size_t>> result;
+  if (polygon.size() < 3) return result;
+
+  // Pixels of the bounding box, in buffer coordinates from the bottom left (pixel row bufferY is row
+  // bufferHeight - bufferY from the top, as in evaluatePickQuery())
+  glm::vec2 polyMin{std::numeric_limits<float>::infinity()};
+  glm::vec2 polyMax{-std::numeric_limits<float>::infinity()};
+  for (const glm::vec2& p : polygon) {
+    polyMin = glm::min(polyMin, p);
+    polyMax = glm::max(polyMax, p);
+  }
+  int xMin = std::max(0, static_cast<int>(std::floor(polyMin.x)));
+  int xMax = std::min(view::bufferWidth - 1, static_cast<int>(std::ceil(polyMax.x)));
+  int yMin = std::max(0, view::bufferHeight - static_cast<int>(std::ceil(polyMax.y)));
+  int yMax = std::min(view::bufferHeight - 1, view::bufferHeight - static_cast<int>(std::floor(polyMin.y)));
+
+  // With viewports, only the part of the one the polygon starts in
+  PickViewportScope viewportScope(static_cast<int>(polygon[0].x), static_cast<int>(polygon[0].y));
+  if (!viewportScope.covered) return result;
+  if (viewportScope.viewport != nullptr) {
+    glm::vec4 r = view::getViewRegionInBuffer();
+    xMin = std::max(xMin, static_cast<int>(std::lround(r[0] * view::bufferWidth)));
+    xMax = std::min(xMax, static_cast<int>(std::lround((r[0] + r[2]) * view::bufferWidth)) - 1);
+    yMin = std::max(yMin, static_cast<int>(std::lround(r[1] * view::bufferHeight)));
+    yMax = std::min(yMax, static_cast<int>(std::lround((r[1] + r[3]) * view::bufferHeight)) - 1);
+  }
+
+  if (xMin > xMax || yMin > yMax) return result;
+  int sizeX = xMax - xMin + 1;
+  int sizeY = yMax - yMin + 1;
+
+  if (!renderPickBuffer(true, xMin, yMin, sizeX, sizeY)) return result;
+  std::vector<float> pixels = render::engine->pickFramebuffer->readFloat4Region(xMin, yMin, sizeX, sizeY);
+
+  // Decode the pixels inside of the polygon (by the even-odd rule at their centers), skipping runs of the same index
+  // along rows, which are common since elements usually cover many pixels
+  std::vector<std::vector<uint64_t>> rowInds(sizeY);
+  parallelFor(
+      0, sizeY,
+      [&](size_t iRow) {
+        float rowCenterY = static_cast<float>(view::bufferHeight - (yMin + static_cast<int>(iRow))) + 0.5f;
+
+        // The polygon's crossings of this row, sorted, so pixels between the 2k'th and 2k+1'th are inside
+        std::vector<float> crossings;
+        for (size_t iP = 0; iP < polygon.size(); iP++) {
+          glm::vec2 a = polygon[iP];
+          glm::vec2 b = polygon[(iP + 1) % polygon.size()];
+          if ((a.y <= rowCenterY) != (b.y <= rowCenterY)) {
+            crossings.push_back(a.x + (rowCenterY - a.y) / (b.y - a.y) * (b.x - a.x));
+          }
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        uint64_t prevInd = 0;
+        for (size_t iC = 0; iC + 1 < crossings.size(); iC += 2) {
+          int colStart = std::max(xMin, static_cast<int>(std::ceil(crossings[iC] - 0.5f)));
+          int colEnd = std::min(xMax + 1, static_cast<int>(std::ceil(crossings[iC + 1] - 0.5f)));
+          for (int col = colStart; col < colEnd; col++) {
+            const float* px = &pixels[4 * (iRow * sizeX + (col - xMin))];
+            uint64_t ind = vecToInd(glm::vec3{px[0], px[1], px[2]});
+            if (ind != 0 && ind != prevInd) rowInds[iRow].push_back(ind);
+            prevInd = ind;
+          }
+        }
+      },
+      16);
+
+  // Deduplicate
+  std::vector<uint64_t> inds;
+  for (const std::vector<uint64_t>& row : rowInds) {
+    inds.insert(inds.end(), row.begin(), row.end());
+  }
+  std::sort(inds.begin(), inds.end());
+  inds.erase(std::unique(inds.begin(), inds.end()), inds.end());
+
+  // Sort in to structures, walking the ranges alongside the sorted indices
+  std::map<size_t, PickRange>::const_iterator range = structureRanges.begin();
+  for (uint64_t ind : inds) {
+    while (range != structureRanges.end() && range->second.end <= ind) {
+      range++;
+    }
+    if (range == structureRanges.end()) break;
+    if (ind < range->first) continue; // (stale data, or a released range)
+    result[range->second.structure].push_back(ind - range->first);
+  }
+
+  return result;
+}
+
+std::map<Structure*, std::vector<size_t>> queryRegion(glm::vec2 cornerA, glm::vec2 cornerB) {
+  glm::vec2 lo = glm::min(cornerA, cornerB);
+  glm::vec2 hi = glm::max(cornerA, cornerB);
+  return queryRegion(std::vector<glm::vec2>{lo, {hi.x, lo.y}, hi, {lo.x, hi.y}});
+}
+
+bool haveAsyncPickQueries() { return !pendingAsyncQueries.empty(); }
+
+void processAsyncPickQueries() {
+  if (pendingAsyncQueries.empty()) return;
+
+  // Reads finish in the order they were issued, so stop at the first one which is still in flight. This also means
+  // callbacks are invoked in the order the queries were made.
+  std::vector<std::shared_ptr<AsyncPickQuery>> resolvedQueries;
+  for (const std::shared_ptr<AsyncPickQuery>& query : pendingAsyncQueries) {
+    if (!query->pendingRead->isReady()) break;
+    resolvedQueries.push_back(query);
+  }
+  pendingAsyncQueries.erase(pendingAsyncQueries.begin(), pendingAsyncQueries.begin() + resolvedQueries.size());
+
+  for (const std::shared_ptr<AsyncPickQuery>& query : resolvedQueries) {
+    std::array<float, 4> result = query->pendingRead->getValue();
+    query->pendingRead.reset();
+
+    size_t globalInd = pick::vecToInd(glm::vec3{result[0], result[1], result[2]});
+    std::pair<Structure*, size_t> pickResult = pick::globalIndexToLocal(globalInd);
+
+    // The structure may have been removed while the read was in flight
+    if (pickResult.first != nullptr && !structureIsRegistered(pickResult.first)) {
+      pickResult = {nullptr, 0};
+    }
+
+    query->result = pickResult;
+    query->isResolved = true;
+    if (query->callback) query->callback(query->result);
+  }
+
+  // (after all of the results are looked up, since callbacks may add structures)
+  if (pendingAsyncQueries.empty()) {
+    for (const std::pair<size_t, size_t>& range : rangesReleasedDuringQueries) {
+      freePickBufferRange(range.first, range.second);
+    }
+    rangesReleasedDuringQueries.clear();
+  }
+}
+
 } // namespace pick
 
 
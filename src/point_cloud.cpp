@@ -12,8 +12,11 @@
 
 #include "imgui.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 namespace polyscope {
 
@@ -26,28 +29,77 @@ PointCloud::PointCloud(std::string name, std::vector<glm::vec3> points_)
       pointRenderMode(uniquePrefix() + "#pointRenderMode", "sphere"),
       pointColor(uniquePrefix() + "#pointColor", getNextUniqueColor()),
       pointRadius(uniquePrefix() + "#pointRadius", relativeValue(0.005)),
-      material(uniquePrefix() + "#material", "clay") {
+      pointSplatSize(uniquePrefix() + "#pointSplatSize", 2.),
+      material(uniquePrefix() + "#material", "clay"), lodEnabled(uniquePrefix() + "#lodEnabled", false) {
   cullWholeElements.setPassive(true);
+  nPointsAddedCount = points.size();
   updateObjectSpaceBounds();
+  if (options::reorderForLocality && points.size() > 1) {
+    drawOrder = mortonOrder(points);
+  }
+}
+
+PointCloud::PointCloud(std::string name, std::shared_ptr<SharedVertexPositions> sharedPoints)
+    : PointCloud(name, sharedPoints->getPositions()) {
+  sharedPositions = std::move(sharedPoints);
+  sharedPositions->addUser(this,
+                           [this](const std::vector<size_t>* movedIndices) { sharedPositionsMoved(movedIndices); });
+}
+
+PointCloud::~PointCloud() {
+  if (sharedPositions) {
+    sharedPositions->removeUser(this);
+  }
 }
 
+namespace {
+
+// The uniforms setPointCloudUniforms() sets every frame, looked up once for each program (see
+// ShaderProgram::userData()). Those a program does not have are invalid.
+struct PointCloudUniformHandles {
+  PointCloudUniformHandles(render::ShaderProgram& p)
+      : invProjMatrix(p.getUniformHandle("u_invProjMatrix")), viewport(p.getUniformHandle("u_viewport")),
+        pointRadius(p.getUniformHandle("u_pointRadius")),
+        pointRadiusValueScale(p.getUniformHandle("u_pointRadiusValueScale")),
+        pointSplatSize(p.getUniformHandle("u_pointSplatSize")) {}
+
+  render::ShaderUniformHandle invProjMatrix, viewport, pointRadius, pointRadiusValueScale, pointSplatSize;
+};
+
+} // namespace
+
 // Helper to set uniforms
 void PointCloud::setPointCloudUniforms(render::ShaderProgram& p) {
+  const PointCloudUniformHandles& h = p.userData<PointCloudUniformHandles>();
   glm::mat4 P = view::getCameraPerspectiveMatrix();
   glm::mat4 Pinv = glm::inverse(P);
 
   if (getPointRenderMode() == PointRenderMode::Sphere) {
-    p.setUniform("u_invProjMatrix", glm::value_ptr(Pinv));
-    p.setUniform("u_viewport", render::engine->getCurrentViewport());
+    p.setUniform(h.invProjMatrix, glm::value_ptr(Pinv));
+    p.setUniform(h.viewport, render::engine->getCurrentViewport());
+  }
+  if (getPointRenderMode() == PointRenderMode::Splat) {
+    p.setUniform(h.pointSplatSize, pointSplatSize.get() * render::engine->getCurrentPixelScaling());
   }
 
   if (pointRadiusQuantityName != "" && !pointRadiusQuantityAutoscale) {
     // special case: ignore radius uniform
-    p.setUniform("u_pointRadius", 1.);
+    p.setUniform(h.pointRadius, 1.);
   } else {
     // common case
-    p.setUniform("u_pointRadius", pointRadius.get().asAbsolute());
+    p.setUniform(h.pointRadius, pointRadius.get().asAbsolute());
+  }
+  if (pointRadiusQuantityName != "" && h.pointRadiusValueScale.isValid()) {
+    PointCloudScalarQuantity* radiusQ = dynamic_cast<PointCloudScalarQuantity*>(getQuantity(pointRadiusQuantityName));
+    p.setUniform(h.pointRadiusValueScale, radiusQ ? pointRadiusValueScale(*radiusQ) : 1.);
   }
+
+  if (positionFrames) {
+    bindPositionFrames(p);
+  }
+
+  // (the buffers may have room past the points, see appendPoints())
+  p.setDrawLimit(static_cast<long int>(nDrawnPoints()));
 }
 
 void PointCloud::draw() {
@@ -64,6 +116,8 @@ void PointCloud::draw() {
     internal::pointCloudEfficiencyWarningReported = true;
   }
 
+  flushGeometryUpdates();
+  updateLODSelection();
 
   // If there is no dominant quantity, then this class is responsible for drawing points
   if (dominantQuantity == nullptr) {
@@ -76,15 +130,15 @@ void PointCloud::draw() {
     // Set program uniforms
     setStructureUniforms(*program);
     setPointCloudUniforms(*program);
-    program->setUniform("u_baseColor", pointColor.get());
+    program->setUniform(baseColorHandle, pointColor.get());
 
     // Draw the actual point cloud
     program->draw();
   }
 
   // Draw the quantities
-  for (auto& x : quantities) {
-    x.second->draw();
+  for (QuantityType* q : getEnabledQuantities()) {
+    q->drawTracked();
   }
 }
 
@@ -93,9 +147,18 @@ void PointCloud::drawPick() {
     return;
   }
 
+  if (lodEnabled.get()) {
+    // position updates go through a new octree rather than the pick buffers, see flushGeometryUpdates()
+    flushGeometryUpdates();
+    updateLODSelection();
+  }
+
   // Ensure we have prepared buffers
   if (pickProgram == nullptr) {
     preparePick();
+  } else if (!pickDirtyPoints.empty()) {
+    updateGeometryBuffers(*pickProgram, pickDirtyPoints.coalesced());
+    pickDirtyPoints.clear();
   }
 
   // Set uniforms
@@ -106,12 +169,14 @@ void PointCloud::drawPick() {
 }
 
 void PointCloud::prepare() {
+  ScopedCPUTimer timer(profilingName(), "prepare");
   // It not quantity is coloring the points, draw with a default color
   if (dominantQuantity != nullptr) {
     return;
   }
 
   program = render::engine->requestShader(getShaderNameForRenderMode(), addPointCloudRules({"SHADE_BASECOLOR"}));
+  baseColorHandle = program->getUniformHandle("u_baseColor");
   render::engine->setMaterial(*program, material.get());
 
   // Fill out the geometry data for the program
@@ -122,33 +187,53 @@ void PointCloud::preparePick() {
 
   // Request pick indices
   size_t pickCount = points.size();
-  size_t pickStart = pick::requestPickBufferRange(this, pickCount);
-
-  // Create a new pick program
-  pickProgram =
-      render::engine->requestShader(getShaderNameForRenderMode(), addPointCloudRules({"SPHERE_PROPAGATE_COLOR"}, true),
-                                    render::ShaderReplacementDefaults::Pick);
+  size_t pickStart;
+  if (drawsLODSubset()) {
+    if (!lodPickRangeRequested) {
+      pick::releasePickBufferRanges(this);
+      lodPickStart = pick::requestPickBufferRange(this, pickCount);
+      lodPickRangeRequested = true;
+    }
+    pickStart = lodPickStart;
+  } else {
+    pick::releasePickBufferRanges(this); // (including the subsets' range, which is requested again when next needed)
+    lodPickRangeRequested = false;
+    pickStart = pick::requestPickBufferRange(this, bufferedPointCount()); // (appended points fit in the range)
+  }
 
-  // Fill color buffer with packed point indices
-  std::vector<glm::vec3> pickColors;
-  for (size_t i = pickStart; i < pickStart + pickCount; i++) {
-    glm::vec3 val = pick::indToVec(i);
-    pickColors.push_back(pick::indToVec(i));
+  // Create a new pick program. The pick color of each point is computed from its index in the shader, so only the
+  // geometry is stored; a subset, or points drawn out of order, additionally hold the index of each point.
+  const std::vector<uint32_t>* drawnInds = drawnPointIndices();
+  std::vector<std::string> pickRules = {"SPHERE_PROPAGATE_PICK_ID"};
+  if (drawnInds) {
+    pickRules.push_back("SPHERE_PICK_ID_FROM_INDEX");
   }
+  pickProgram = render::engine->requestShader(getShaderNameForRenderMode(), addPointCloudRules(pickRules, true),
+                                              render::ShaderReplacementDefaults::Pick);
+  pickDirtyPoints.clear();
 
   // Store data in buffers
   fillGeometryBuffers(*pickProgram);
-  pickProgram->setAttribute("a_color", pickColors);
+  if (drawnInds) {
+    // (the ids of the original points, so picks resolve the same way)
+    pickProgram->setAttribute("a_pickInd", *drawnInds);
+  }
+  pickProgram->setUniform("u_pickStart", pick::indToVec(pickStart));
 }
 
 std::string PointCloud::getShaderNameForRenderMode() {
+  std::string suffix = useInstancedDrawing() ? "_INSTANCED" : "";
   if (getPointRenderMode() == PointRenderMode::Sphere)
-    return "RAYCAST_SPHERE";
+    return "RAYCAST_SPHERE" + suffix;
   else if (getPointRenderMode() == PointRenderMode::Quad)
-    return "POINT_QUAD";
+    return "POINT_QUAD" + suffix;
+  else if (getPointRenderMode() == PointRenderMode::Splat)
+    return "POINT_SPLAT"; // (one vertex per point, always)
   return "ERROR";
 }
 
+bool PointCloud::useInstancedDrawing() { return render::engine->useInstancedDrawing(nDrawnPoints()); }
+
 
 std::vector<std::string> PointCloud::addPointCloudRules(std::vector<std::string> initRules, bool withPointCloud) {
   initRules = addStructureRules(initRules);
@@ -159,72 +244,340 @@ std::vector<std::string> PointCloud::addPointCloudRules(std::vector<std::string>
     if (wantsCullPosition()) {
       if (getPointRenderMode() == PointRenderMode::Sphere)
         initRules.push_back("SPHERE_CULLPOS_FROM_CENTER");
-      else if (getPointRenderMode() == PointRenderMode::Quad)
+      else // quads and splats
         initRules.push_back("SPHERE_CULLPOS_FROM_CENTER_QUAD");
     }
   }
+
+  if (positionFrames && timeInterpolation) {
+    initRules.push_back("SPHERE_POSITION_LERP");
+  }
+
+  // The instanced programs and splats have no geometry stage, so use the matching variant of each sphere rule
+  if (useInstancedDrawing() || getPointRenderMode() == PointRenderMode::Splat) {
+    for (std::string& rule : initRules) {
+      if (rule.rfind("SPHERE_", 0) == 0) {
+        rule += "_INSTANCED";
+      }
+    }
+  }
   return initRules;
 }
 
 // helper
-std::vector<double> PointCloud::resolvePointRadiusQuantity() {
-  PointCloudScalarQuantity* sizeScalarQ = nullptr;
+PointCloudScalarQuantity* PointCloud::resolvePointRadiusQuantity() {
   PointCloudQuantity* sizeQ = getQuantity(pointRadiusQuantityName);
-  if (sizeQ != nullptr) {
-    sizeScalarQ = dynamic_cast<PointCloudScalarQuantity*>(sizeQ);
-    if (sizeScalarQ == nullptr) {
-      polyscope::error("Cannot populate point size from quantity [" + name + "], it is not a scalar quantity");
-    }
-  } else {
+  if (sizeQ == nullptr) {
     polyscope::error("Cannot populate point size from quantity [" + name + "], it does not exist");
+    return nullptr;
   }
-
-  std::vector<double> sizes;
+  PointCloudScalarQuantity* sizeScalarQ = dynamic_cast<PointCloudScalarQuantity*>(sizeQ);
   if (sizeScalarQ == nullptr) {
-    // we failed to resolve above; populate with dummy data so we can continue processing
-    std::vector<double> ones(nPoints(), 1.);
-    sizes = ones;
-  } else {
-    sizes = sizeScalarQ->values;
+    polyscope::error("Cannot populate point size from quantity [" + name + "], it is not a scalar quantity");
   }
+  return sizeScalarQ;
+}
 
-  // clamp to nonnegative and autoscale (if requested)
-  double max = 0;
-  for (double& x : sizes) {
-    if (!(x > 0)) x = 0; // ensure all nonnegative
-    max = std::fmax(max, x);
-  }
+double PointCloud::pointRadiusValueScale(PointCloudScalarQuantity& q) {
+  if (!pointRadiusQuantityAutoscale) return 1.;
+  double max = q.getMaxPositiveValue();
   if (max == 0) max = 1e-6;
-  if (pointRadiusQuantityAutoscale) {
-    for (double& x : sizes) {
-      x /= max;
+  return 1. / max;
+}
+
+void PointCloud::fillGeometryBuffers(render::ShaderProgram& p) {
+  ScopedCPUTimer timer(profilingName(), "fillGeometryBuffers");
+  if (positionFrames) {
+    bindPositionFrames(p);
+  } else if (std::shared_ptr<render::AttributeBuffer> positions =
+                 drawnPointIndices() ? nullptr : getPositionRenderBuffer()) {
+    p.setAttribute("a_position", positions);
+  } else {
+    setPointAttribute(p, "a_position", points);
+  }
+
+  if (pointRadiusQuantityName != "") {
+    // The values of the quantity as they are, normalized in the shaders (see setPointCloudUniforms())
+    PointCloudScalarQuantity* radiusQ = resolvePointRadiusQuantity();
+    if (radiusQ == nullptr) {
+      // we failed to resolve above; populate with dummy data so we can continue processing
+      setPointAttribute(p, "a_pointRadius", std::vector<float>(nPoints(), 1.f));
+    } else if (drawsAllPointsInOrder()) {
+      p.setAttribute("a_pointRadius", radiusQ->getValueRenderBuffer());
+    } else {
+      setPointAttribute(p, "a_pointRadius", radiusQ->values);
     }
   }
+}
+
+void PointCloud::setPointAttribute(render::ShaderProgram& p, std::string attributeName, const ScalarArray& data,
+                                   bool update) {
+  if (const std::vector<uint32_t>* drawnInds = drawnPointIndices()) {
+    data.setAttribute(p, attributeName, *drawnInds, update);
+  } else if (bufferCapacity > data.size()) {
+    data.setPaddedAttribute(p, attributeName, bufferCapacity, update);
+  } else {
+    data.setAttribute(p, attributeName, update);
+  }
+}
 
-  return sizes;
+void PointCloud::updatePointAttributeRanges(render::ShaderProgram& p, std::string attributeName,
+                                            const ScalarArray& data,
+                                            const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (drawnPointIndices()) {
+    setPointAttribute(p, attributeName, data, true);
+    return;
+  }
+  data.updateAttributeRanges(p, attributeName, pointRanges);
 }
 
-void PointCloud::fillGeometryBuffers(render::ShaderProgram& p) {
-  p.setAttribute("a_position", points);
+void PointCloud::updateGeometryBuffers(render::ShaderProgram& p,
+                                       const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (positionFrames) {
+    return; // frames never change
+  }
+  if (!drawOrder.empty()) {
+    // the points of the ranges are spread through the buffer, so gather all of them again
+    setPointAttribute(p, "a_position", points, true);
+    return;
+  }
+  if (getPositionRenderBuffer()) {
+    return; // the position buffer is updated when the points move
+  }
+  p.updateAttributeRanges("a_position", points, pointRanges);
+}
 
-  if (pointRadiusQuantityName != "") {
-    // Resolve the quantity
-    std::vector<double> pointRadiusQuantityVals = resolvePointRadiusQuantity();
-    p.setAttribute("a_pointRadius", pointRadiusQuantityVals);
+bool PointCloud::drawsSharedPositions() { return sharedPositions != nullptr && drawnPointIndices() == nullptr; }
+
+bool PointCloud::drawsAllPointsInOrder() { return drawnPointIndices() == nullptr && bufferCapacity == 0; }
+
+void PointCloud::scalarValuesUpdated(PointCloudScalarQuantity& q) {
+  if (q.name != pointRadiusQuantityName) return;
+  pickBVH.reset();
+  if (!drawsAllPointsInOrder()) {
+    refresh(); // (the programs hold their own copy of the radii)
+  }
+  requestRedraw();
+}
+
+std::shared_ptr<render::AttributeBuffer> PointCloud::getPositionRenderBuffer() {
+  if (positionFrames || drawsLODSubset() || bufferCapacity != 0) {
+    return nullptr;
+  }
+  if (sharedPositions) {
+    return sharedPositions->getRenderBuffer();
   }
+  if (!positionBuffer) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    positionBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    positionBuffer->setData(points);
+  }
+  return positionBuffer;
+}
+
+void PointCloud::sharedPositionsMoved(const std::vector<size_t>* movedIndices) {
+  if (movedIndices == nullptr) {
+    points = sharedPositions->getPositions();
+    geometryChanged();
+    return;
+  }
+  for (size_t iP : *movedIndices) {
+    points[iP] = sharedPositions->getPositions()[iP];
+  }
+  pointsMoved(*movedIndices);
 }
 
 void PointCloud::geometryChanged() {
-  if (program) 
-  {
-    fillGeometryBuffers(*program);
+  pickBVH.reset();
+  dirtyPoints.markAll(nPoints());
+  pickDirtyPoints.markAll(nPoints());
+  requestRedraw();
+  if (detail::sessionCaptureActive) detail::captureMovedPositions(*this, nullptr);
+}
+
+void PointCloud::updatePointPositionsImpl(const std::vector<size_t>& indices,
+                                          const std::vector<glm::vec3>& newPositions) {
+  for (size_t iP : indices) {
+    if (iP >= nPoints()) {
+      error("updatePointPositions() on [" + name + "] was passed point index " + std::to_string(iP) +
+            ", but there are only " + std::to_string(nPoints()) + " points");
+      return;
+    }
+  }
+  if (sharedPositions) {
+    sharedPositions->updateVertexPositions(indices, newPositions); // calls back to update this cloud too
+    return;
+  }
+  for (size_t i = 0; i < indices.size(); i++) {
+    points[indices[i]] = newPositions[i];
+  }
+  pointsMoved(indices);
+}
+
+void PointCloud::devicePositionsWritten(void* fence) {
+  if (!getPositionRenderBuffer()) {
+    warning("devicePositionsWritten() on [" + name + "], which does not draw its points from the position buffer");
+    return;
+  }
+  if (fence != nullptr) {
+    render::engine->waitForExternalFence(fence);
+  }
+  reduceDeviceBounds();
+  requestRedraw();
+}
+
+void PointCloud::reduceDeviceBounds() {
+  std::shared_ptr<render::ShaderProgram> boxProgram = render::engine->requestShader(
+      "POINT_REDUCE_BOUNDS", {"REDUCE_POSITION"}, render::ShaderReplacementDefaults::Process);
+  boxProgram->setAttribute("a_position", getPositionRenderBuffer());
+  boxProgram->setDrawLimit(nPoints()); // (appended clouds have room to spare in the buffer)
+
+  Handle<PointCloud> self(this);
+  size_t generation = boundsGeneration;
+  render::engine->reduceBoundsAsync(*boxProgram, [self, generation](glm::vec3 low, glm::vec3 high) {
+    PointCloud* cloud = self.get();
+    if (cloud == nullptr || cloud->boundsGeneration != generation) return;
+    cloud->objectSpaceBoundingBox = std::make_tuple(low, high);
+    cloud->boundsChanged();
+    requestStructureExtentsUpdate();
+
+    std::shared_ptr<render::ShaderProgram> distanceProgram = render::engine->requestShader(
+        "POINT_REDUCE_BOUNDS", {"REDUCE_POSITION_DISTANCE"}, render::ShaderReplacementDefaults::Process);
+    distanceProgram->setAttribute("a_position", cloud->getPositionRenderBuffer());
+    distanceProgram->setUniform("u_reduceCenter", 0.5f * (low + high));
+    distanceProgram->setDrawLimit(cloud->nPoints());
+    render::engine->reduceBoundsAsync(*distanceProgram, [self, generation](glm::vec3, glm::vec3 maxDistance) {
+      PointCloud* cloud = self.get();
+      if (cloud == nullptr || cloud->boundsGeneration != generation) return;
+      cloud->objectSpaceLengthScale = 2. * maxDistance.x;
+      cloud->boundsChanged();
+      requestStructureExtentsUpdate();
+    });
+  });
+}
+
+void PointCloud::pointsMoved(const std::vector<size_t>& indices) {
+  pickBVH.reset();
+  for (size_t iP : indices) {
+    dirtyPoints.mark(iP);
+    pickDirtyPoints.mark(iP);
+  }
+  requestRedraw();
+  if (detail::sessionCaptureActive) detail::captureMovedPositions(*this, &indices);
+}
+
+void PointCloud::appendPointsImpl(const std::vector<glm::vec3>& newPoints) {
+  if (sharedPositions) {
+    error("appendPoints() on [" + name + "], which shares its positions with other structures");
+    return;
+  }
+  if (timeFrameCount > 0) {
+    error("appendPoints() on [" + name + "], which has time frames");
+    return;
+  }
+  if (newPoints.empty()) return;
+
+  // Each point goes at the end, or in place of the oldest point once the cloud is full. (With a limit, only the last
+  // maxPoints new points would be kept, so the ones before are skipped.)
+  size_t oldSize = nPoints();
+  DirtyRanges replaced;
+  size_t iFirst = (maxPoints != 0 && newPoints.size() > maxPoints) ? newPoints.size() - maxPoints : 0;
+  nPointsAddedCount += iFirst;
+  glm::vec3 bboxMin, bboxMax;
+  std::tie(bboxMin, bboxMax) = objectSpaceBoundingBox;
+  for (size_t i = iFirst; i < newPoints.size(); i++) {
+    size_t iP = pointSlot(nPointsAddedCount++);
+    if (iP == points.size()) {
+      points.push_back(newPoints[i]);
+    } else {
+      points[iP] = newPoints[i];
+      replaced.mark(iP);
+    }
+    bboxMin = glm::min(bboxMin, newPoints[i]);
+    bboxMax = glm::max(bboxMax, newPoints[i]);
+  }
+  objectSpaceBoundingBox = std::make_tuple(bboxMin, bboxMax);
+  boundsChanged();
+  pickBVH.reset();
+  lodPickRangeRequested = false; // (the range of the subsets covers the old points)
+
+  // Quantities follow with values for the new points
+  std::vector<std::string> dropped;
+  for (auto& q : quantities) {
+    if (!q.second->extendToAppendedPoints()) dropped.push_back(q.first);
   }
-  if (pickProgram) 
-  {
-    fillGeometryBuffers(*pickProgram);
+  for (const std::string& qName : dropped) {
+    warning("Point cloud [" + name + "] quantity " + qName + " can not be appended to, and was removed");
+    removeQuantity(qName);
+  }
+
+  if (nPoints() > bufferCapacity || !drawOrder.empty() || pointRadiusQuantityName != "") {
+    // Reallocate the buffers with room to grow. This is also where the length scale follows the new points, so that
+    // the relative sizes only change when everything is uploaded anyway.
+    size_t newCapacity = maxPoints != 0 ? maxPoints : std::max<size_t>(bufferCapacity, 1024);
+    while (newCapacity < nPoints()) newCapacity *= 2;
+    bufferCapacity = newCapacity;
+    drawOrder = std::vector<uint32_t>(); // (appended points would land off the curve)
+    updateObjectSpaceBounds();
+    refresh();
+  } else {
+    dirtyPoints.mark(oldSize, nPoints());
+    dirtyPoints.mark(replaced);
+    pickDirtyPoints.mark(dirtyPoints);
   }
   requestRedraw();
-  QuantityStructure<PointCloud>::refresh();
+}
+
+PointCloud* PointCloud::setMaxPoints(size_t newVal) {
+  if (nPointsAddedCount > nPoints()) {
+    error("setMaxPoints() on [" + name + "], which has already replaced some of its points");
+    return this;
+  }
+  if (newVal != 0 && newVal < nPoints()) {
+    error("setMaxPoints() on [" + name + "] with a limit of " + std::to_string(newVal) + ", but it already holds " +
+          std::to_string(nPoints()) + " points");
+    return this;
+  }
+  maxPoints = newVal;
+  if (bufferCapacity != 0 && maxPoints > bufferCapacity) {
+    bufferCapacity = maxPoints; // (allocate the whole ring at once)
+    refresh();
+  }
+  return this;
+}
+
+size_t PointCloud::getMaxPoints() { return maxPoints; }
+
+size_t PointCloud::nPointsAdded() { return nPointsAddedCount; }
+
+size_t PointCloud::pointSlot(size_t iAdded) { return maxPoints == 0 ? iAdded : iAdded % maxPoints; }
+
+void PointCloud::flushGeometryUpdates() {
+  if (dirtyPoints.empty()) {
+    return;
+  }
+
+  if (lodOctree) {
+    // the buffers only hold a subset chosen from the old octree, so there is nothing to patch
+    lodOctree.reset();
+    refresh();
+    return;
+  }
+
+  std::vector<std::pair<size_t, size_t>> pointRanges = dirtyPoints.coalesced();
+  if (positionBuffer) {
+    for (const std::pair<size_t, size_t>& r : pointRanges) {
+      std::vector<glm::vec3> rangeData(points.begin() + r.first, points.begin() + r.second);
+      positionBuffer->setData(rangeData, true, static_cast<int>(r.first), static_cast<int>(r.second - r.first));
+    }
+  }
+  if (program) {
+    updateGeometryBuffers(*program, pointRanges);
+  }
+  for (auto& q : quantities) {
+    q.second->geometryChanged(pointRanges);
+  }
+  dirtyPoints.clear();
 }
 
 void PointCloud::buildPickUI(size_t localPickID) {
@@ -249,7 +602,12 @@ void PointCloud::buildPickUI(size_t localPickID) {
 }
 
 void PointCloud::buildCustomUI() {
-  ImGui::Text("# points: %lld", static_cast<long long int>(points.size()));
+  if (drawsLODSubset()) {
+    ImGui::Text("# points: %lld (drawing %lld)", static_cast<long long int>(points.size()),
+                static_cast<long long int>(lodPoints.size()));
+  } else {
+    ImGui::Text("# points: %lld", static_cast<long long int>(points.size()));
+  }
   if (ImGui::ColorEdit3("Point color", &pointColor.get()[0], ImGuiColorEditFlags_NoInputs)) {
     setPointColor(getPointColor());
   }
@@ -260,7 +618,27 @@ void PointCloud::buildCustomUI() {
     pointRadius.manuallyChanged();
     requestRedraw();
   }
+  if (getPointRenderMode() == PointRenderMode::Splat) {
+    ImGui::SameLine();
+    if (ImGui::SliderFloat("Splat px", &pointSplatSize.get(), 1.0, 16.0, "%.1f")) {
+      pointSplatSize.manuallyChanged();
+      requestRedraw();
+    }
+  }
   ImGui::PopItemWidth();
+
+  if (timeFrameCount > 1) {
+    float t = static_cast<float>(time);
+    ImGui::PushItemWidth(150);
+    if (ImGui::SliderFloat("Time", &t, 0., static_cast<float>(timeFrameCount - 1), "%.2f")) {
+      setTime(t);
+    }
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (ImGui::Checkbox("Interpolate", &timeInterpolation)) {
+      setTimeInterpolation(timeInterpolation);
+    }
+  }
 }
 
 void PointCloud::buildCustomOptionsUI() {
@@ -268,7 +646,7 @@ void PointCloud::buildCustomOptionsUI() {
 
   if (ImGui::BeginMenu("Point Render Mode")) {
 
-    for (const PointRenderMode& m : {PointRenderMode::Sphere, PointRenderMode::Quad}) {
+    for (const PointRenderMode& m : {PointRenderMode::Sphere, PointRenderMode::Quad, PointRenderMode::Splat}) {
       bool selected = (m == getPointRenderMode());
       std::string fancyName;
       switch (m) {
@@ -278,6 +656,9 @@ void PointCloud::buildCustomOptionsUI() {
       case PointRenderMode::Quad:
         fancyName = "quad (fast)";
         break;
+      case PointRenderMode::Splat:
+        fancyName = "splat (fastest)";
+        break;
       }
       if (ImGui::MenuItem(fancyName.c_str(), NULL, selected)) {
         setPointRenderMode(m);
@@ -307,39 +688,105 @@ void PointCloud::buildCustomOptionsUI() {
     material.manuallyChanged();
     setMaterial(material.get()); // trigger the other updates that happen on set()
   }
+
+  if (ImGui::MenuItem("Level of Detail", nullptr, getLODEnabled())) setLODEnabled(!getLODEnabled());
 }
 
 void PointCloud::updateObjectSpaceBounds() {
-
-  // bounding box
-  glm::vec3 min = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
-  glm::vec3 max = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
-  for (const glm::vec3& p : points) {
-    min = componentwiseMin(min, p);
-    max = componentwiseMax(max, p);
-  }
+  boundsGeneration++;
+
+  // bounding box, and length scale as twice the radius from the center of the bounding box
+  // (the frames are only on the GPU, the corners of their box cover them)
+  std::vector<glm::vec3> frameCorners;
+  if (positionFrames) frameCorners = {frameBoundsMin, frameBoundsMax};
+  glm::vec3 min, max;
+  computePointSetExtents(points, min, max, objectSpaceLengthScale, frameCorners);
   objectSpaceBoundingBox = std::make_tuple(min, max);
-
-  // length scale, as twice the radius from the center of the bounding box
-  glm::vec3 center = 0.5f * (min + max);
-  float lengthScale = 0.0;
-  for (const glm::vec3& p : points) {
-    lengthScale = std::max(lengthScale, glm::length2(p - center));
-  }
-  objectSpaceLengthScale = 2 * std::sqrt(lengthScale);
+  boundsChanged();
 }
 
 
 std::string PointCloud::typeName() { return structureTypeName; }
 
+size_t PointCloud::hostMemoryUsage() {
+  size_t bytes = allocatedBytes(points) + allocatedBytes(lodPoints) + allocatedBytes(drawOrder);
+  if (lodOctree) bytes += lodOctree->allocatedBytes();
+  return bytes;
+}
+
 
 void PointCloud::refresh() {
   program.reset();
   pickProgram.reset();
+  positionBuffer.reset();
+  dirtyPoints.clear();
+  pickDirtyPoints.clear();
   QuantityStructure<PointCloud>::refresh(); // call base class version, which refreshes quantities
 }
 
 
+// === CPU picking
+
+void PointCloud::ensurePickBVH() {
+  if (pickBVH) return;
+
+  // Points are boxes of no size, with the largest radius added as a margin by the queries. This way the radius can
+  // change without a rebuild.
+  pickBVH.reset(new ElementBVH(points, points));
+  pickBVHRadiusScales.clear();
+  pickBVHMaxRadiusScale = 1.;
+  PointCloudScalarQuantity* radiusQ = pointRadiusQuantityName != "" ? resolvePointRadiusQuantity() : nullptr;
+  if (radiusQ != nullptr) {
+    // as in the shaders, clamped to nonnegative and scaled
+    double valueScale = pointRadiusValueScale(*radiusQ);
+    pickBVHRadiusScales = radiusQ->values.toDoubles();
+    pickBVHMaxRadiusScale = 0.;
+    for (double& x : pickBVHRadiusScales) {
+      x = x > 0 ? x * valueScale : 0.;
+      pickBVHMaxRadiusScale = std::fmax(pickBVHMaxRadiusScale, x);
+    }
+  }
+}
+
+double PointCloud::pickPointRadius(size_t iP) {
+  if (pickBVHRadiusScales.empty()) return getPointRadius();
+  // as in setPointCloudUniforms(), unscaled quantity values are the radius itself
+  double scale = pointRadiusQuantityAutoscale ? getPointRadius() : 1.;
+  return scale * pickBVHRadiusScales[iP];
+}
+
+double PointCloud::pickMaxPointRadius() {
+  if (pickBVHRadiusScales.empty()) return getPointRadius();
+  double scale = pointRadiusQuantityAutoscale ? getPointRadius() : 1.;
+  return scale * pickBVHMaxRadiusScale;
+}
+
+bool PointCloud::rayCastElementObjectSpace(glm::vec3 rayStart, glm::vec3 rayDir, float objectScale, float& tHit,
+                                           size_t& localPickInd) {
+  ensurePickBVH();
+  float margin = static_cast<float>(pickMaxPointRadius()) / objectScale;
+  auto hit = [&](uint32_t iP) {
+    return raySphereHit(rayStart, rayDir, points[iP], static_cast<float>(pickPointRadius(iP)) / objectScale);
+  };
+  uint32_t iHit;
+  if (!pickBVH->rayCast(rayStart, rayDir, margin, hit, tHit, iHit)) return false;
+  localPickInd = iHit;
+  return true;
+}
+
+bool PointCloud::closestElementObjectSpace(glm::vec3 point, float objectScale, float& dist, size_t& localPickInd) {
+  ensurePickBVH();
+  auto pointDist = [&](uint32_t iP) {
+    float radius = static_cast<float>(pickPointRadius(iP)) / objectScale;
+    return std::max(glm::length(point - points[iP]) - radius, 0.f);
+  };
+  float margin = static_cast<float>(pickMaxPointRadius()) / objectScale;
+  uint32_t iClosest;
+  if (!pickBVH->closest(point, margin, pointDist, dist, iClosest)) return false;
+  localPickInd = iClosest;
+  return true;
+}
+
 // === Set point size from a scalar quantity
 void PointCloud::setPointRadiusQuantity(PointCloudScalarQuantity* quantity, bool autoScale) {
   setPointRadiusQuantity(quantity->name, autoScale);
@@ -350,12 +797,14 @@ void PointCloud::setPointRadiusQuantity(std::string name, bool autoScale) {
   pointRadiusQuantityAutoscale = autoScale;
 
   resolvePointRadiusQuantity(); // do it once, just so we fail fast if it doesn't exist
+  pickBVH.reset();
 
-  refresh(); // TODO this is a bit overkill
+  refresh(); // (the programs bind the buffers the quantities already hold, so nothing is uploaded again)
 }
 
 void PointCloud::clearPointRadiusQuantity() {
   pointRadiusQuantityName = "";
+  pickBVH.reset();
   refresh();
 }
 
@@ -363,10 +812,29 @@ void PointCloud::clearPointRadiusQuantity() {
 
 // Quantity default methods
 PointCloudQuantity::PointCloudQuantity(std::string name_, PointCloud& pointCloud_, bool dominates_)
-    : Quantity<PointCloud>(name_, pointCloud_, dominates_) {}
+    : Quantity<PointCloud>(name_, pointCloud_, dominates_), nValuesAdded(pointCloud_.nPointsAdded()) {}
 
 
 void PointCloudQuantity::buildInfoGUI(size_t pointInd) {}
+bool PointCloudQuantity::extendToAppendedPoints() { return false; }
+
+std::vector<size_t> PointCloudQuantity::appendedValueSlots(size_t count) {
+  size_t nAdded = parent.nPointsAdded();
+  if (nValuesAdded + count > nAdded) {
+    error("Point cloud quantity " + name + " was given " + std::to_string(count) + " values to append, but only " +
+          std::to_string(nAdded - nValuesAdded) + " points are waiting for values");
+    return {};
+  }
+  size_t firstKept = nAdded - parent.nPoints();
+  std::vector<size_t> slots(count, INVALID_IND);
+  for (size_t i = 0; i < count; i++) {
+    size_t iAdded = nValuesAdded + i;
+    if (iAdded >= firstKept) slots[i] = parent.pointSlot(iAdded);
+  }
+  nValuesAdded += count;
+  return slots;
+}
+void PointCloudQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) { refresh(); }
 
 // === Quantity adders
 
@@ -409,6 +877,67 @@ PointCloudVectorQuantity* PointCloud::addVectorQuantityImpl(std::string name, co
   return q;
 }
 
+PointCloudChannelsQuantity* PointCloud::addChannelsQuantityImpl(std::string name,
+                                                                const std::vector<std::string>& channelNames,
+                                                                std::vector<float> channelValues) {
+  PointCloudChannelsQuantity* q = new PointCloudChannelsQuantity(name, channelNames, std::move(channelValues), *this);
+  addQuantity(q);
+  return q;
+}
+
+PointCloudSparseScalarQuantity*
+PointCloud::addSparseScalarQuantity(std::string name, const std::vector<std::pair<size_t, double>>& values,
+                                    DataType type) {
+  for (const std::pair<size_t, double>& p : values) {
+    if (p.first >= nPoints()) {
+      error("passed index " + std::to_string(p.first) + " to addSparseScalarQuantity [" + name +
+            "] which is greater than the number of points");
+    }
+  }
+  std::vector<double> setValues;
+  SparseElementSet elements = SparseElementSet::fromEntries(nPoints(), values, setValues);
+  if (!elements.fitsTextures()) {
+    error("point cloud sparse scalar quantity " + name + " needs at most 2^24 points, " + this->name + " has " +
+          std::to_string(nPoints()));
+    return nullptr;
+  }
+  PointCloudSparseScalarQuantity* q = new PointCloudSparseScalarQuantity(name, std::move(elements), setValues, *this, type);
+  addQuantity(q);
+  return q;
+}
+
+PointCloudExpressionQuantity* PointCloud::addExpressionQuantity(std::string name, std::string expressionSource) {
+  // The fields of the expression are the scalar and vector quantities of the cloud
+  auto fieldType = [&](const std::string& fieldName, ExpressionValueType& type) {
+    PointCloudQuantity* q = getQuantity(fieldName);
+    if (dynamic_cast<PointCloudScalarQuantity*>(q) != nullptr) {
+      type = ExpressionValueType::Scalar;
+      return true;
+    }
+    if (dynamic_cast<PointCloudVectorQuantity*>(q) != nullptr) {
+      type = ExpressionValueType::Vector;
+      return true;
+    }
+    return false;
+  };
+
+  try {
+    Expression expression(expressionSource, fieldType);
+    if (expression.getType() != ExpressionValueType::Scalar) {
+      throw std::invalid_argument("the value is a vector, take its length with |...| or a component with .x");
+    }
+    if (expression.getFieldNames().empty()) {
+      throw std::invalid_argument("it uses no quantities of the point cloud");
+    }
+    PointCloudExpressionQuantity* q = new PointCloudExpressionQuantity(name, std::move(expression), *this);
+    addQuantity(q);
+    return q;
+  } catch (const std::invalid_argument& e) {
+    polyscope::error("Point cloud expression quantity " + name + " \"" + expressionSource + "\": " + e.what());
+    return nullptr;
+  }
+}
+
 PointCloud* PointCloud::setPointRenderMode(PointRenderMode newVal) {
   switch (newVal) {
   case PointRenderMode::Sphere:
@@ -417,9 +946,12 @@ PointCloud* PointCloud::setPointRenderMode(PointRenderMode newVal) {
   case PointRenderMode::Quad:
     pointRenderMode = "quad";
     break;
+  case PointRenderMode::Splat:
+    pointRenderMode = "splat";
+    break;
   }
   refresh();
-  polyscope::requestRedraw();
+  requestRedraw();
   return this;
 }
 PointRenderMode PointCloud::getPointRenderMode() {
@@ -428,12 +960,14 @@ PointRenderMode PointCloud::getPointRenderMode() {
     return PointRenderMode::Sphere;
   else if (pointRenderMode.get() == "quad")
     return PointRenderMode::Quad;
+  else if (pointRenderMode.get() == "splat")
+    return PointRenderMode::Splat;
   return PointRenderMode::Sphere; // should never happen
 }
 
 PointCloud* PointCloud::setPointColor(glm::vec3 newVal) {
   pointColor = newVal;
-  polyscope::requestRedraw();
+  requestRedraw();
   return this;
 }
 glm::vec3 PointCloud::getPointColor() { return pointColor.get(); }
@@ -445,12 +979,162 @@ PointCloud* PointCloud::setMaterial(std::string m) {
   return this;
 }
 std::string PointCloud::getMaterial() { return material.get(); }
+std::string PointCloud::drawBatchKey() { return material.get(); }
+
+bool PointCloud::drawsInDepthPrepass() { return getPointRenderMode() == PointRenderMode::Sphere; }
 
 PointCloud* PointCloud::setPointRadius(double newVal, bool isRelative) {
   pointRadius = ScaledValue<float>(newVal, isRelative);
-  polyscope::requestRedraw();
+  requestRedraw();
   return this;
 }
 double PointCloud::getPointRadius() { return pointRadius.get().asAbsolute(); }
 
+PointCloud* PointCloud::setPointSplatSize(double newVal) {
+  pointSplatSize = static_cast<float>(newVal);
+  requestRedraw();
+  return this;
+}
+double PointCloud::getPointSplatSize() { return pointSplatSize.get(); }
+
+// === Animation
+
+void PointCloud::addPositionFrameImpl(const std::vector<glm::vec3>& framePositions) {
+  if (!positionFrames) {
+    positionFrames.reset(new TimeFrameBuffers(render::DataType::Vector3Float, options::timeSeriesMaxFrames));
+    positionFrames->addFrame(points);
+    frameBoundsMin = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+    frameBoundsMax = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  }
+  positionFrames->addFrame(framePositions);
+  for (const glm::vec3& p : framePositions) {
+    frameBoundsMin = componentwiseMin(frameBoundsMin, p);
+    frameBoundsMax = componentwiseMax(frameBoundsMax, p);
+  }
+  updateObjectSpaceBounds();
+  timeFramesAdded(positionFrames->nFrames());
+}
+
+PointCloud* PointCloud::setPositionFrameLoader(size_t nFrames, TimeFrameLoader loader) {
+  if (nFrames == 0) {
+    error("setPositionFrameLoader() on [" + name + "] with no frames");
+    return this;
+  }
+  positionFrames.reset(new TimeFrameBuffers(render::DataType::Vector3Float, nFrames, 3 * nPoints(), std::move(loader)));
+  frameBoundsMin = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  frameBoundsMax = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  for (const glm::vec3& p : points) {
+    frameBoundsMin = componentwiseMin(frameBoundsMin, p);
+    frameBoundsMax = componentwiseMax(frameBoundsMax, p);
+  }
+  updateObjectSpaceBounds();
+  timeFramesAdded(nFrames);
+  refresh(); // (the programs may hold buffers of the frames replaced)
+  return this;
+}
+
+void PointCloud::timeFramesAdded(size_t nFrames) {
+  if (timeFrameCount == 0) {
+    // the buffers were filled with the registered points, or with an LOD subset which does not apply any more
+    lodOctree.reset();
+    lodPoints = std::vector<uint32_t>();
+    drawOrder = std::vector<uint32_t>();
+    refresh();
+  }
+  timeFrameCount = std::max(timeFrameCount, nFrames);
+  requestRedraw();
+}
+
+void PointCloud::bindPositionFrames(render::ShaderProgram& p) {
+  if (timeInterpolation && p.hasAttribute("a_positionNext")) {
+    positionFrames->bind(p, "a_position", "a_positionNext", "u_positionBlend", time);
+  } else {
+    positionFrames->bind(p, "a_position", time);
+  }
+}
+
+PointCloud* PointCloud::setTime(double newTime) {
+  time = newTime;
+  requestRedraw();
+  return this;
+}
+double PointCloud::getTime() { return time; }
+
+size_t PointCloud::nTimeFrames() { return timeFrameCount; }
+
+PointCloud* PointCloud::setTimeInterpolation(bool newVal) {
+  timeInterpolation = newVal;
+  refresh();
+  requestRedraw();
+  return this;
+}
+bool PointCloud::getTimeInterpolation() { return timeInterpolation; }
+
+// === Level of detail
+
+PointCloud* PointCloud::setLODEnabled(bool newVal) {
+  lodEnabled = newVal;
+  if (!newVal) {
+    lodOctree.reset();
+    lodPoints = std::vector<uint32_t>();
+  }
+  lodSelectionValid = false;
+  refresh();
+  return this;
+}
+bool PointCloud::getLODEnabled() { return lodEnabled.get(); }
+
+PointCloud* PointCloud::setLODPointBudget(size_t newVal) {
+  lodPointBudget = newVal;
+  lodSelectionValid = false;
+  requestRedraw();
+  return this;
+}
+size_t PointCloud::getLODPointBudget() { return lodPointBudget; }
+
+bool PointCloud::drawsLODSubset() { return lodOctree != nullptr; }
+
+size_t PointCloud::bufferedPointCount() {
+  if (const std::vector<uint32_t>* drawnInds = drawnPointIndices()) return drawnInds->size();
+  return std::max(nPoints(), bufferCapacity);
+}
+
+const std::vector<uint32_t>* PointCloud::drawnPointIndices() {
+  if (drawsLODSubset()) return &lodPoints;
+  if (!drawOrder.empty()) return &drawOrder;
+  return nullptr;
+}
+
+size_t PointCloud::nDrawnPoints() { return drawsLODSubset() ? lodPoints.size() : points.size(); }
+
+void PointCloud::updateLODSelection() {
+  if (!lodEnabled.get() || timeFrameCount > 0) return;
+
+  if (!lodOctree) {
+    ScopedCPUTimer timer(profilingName(), "build octree");
+    lodOctree.reset(new PointCloudOctree(points));
+    lodSelectionValid = false;
+  }
+
+  // Reflections and shadows draw with other view matrices; the subset follows the camera of the first pass of a frame
+  if (lodSelectionValid && lodSelectionSceneRender == state::sceneRenderCount) return;
+  lodSelectionSceneRender = state::sceneRenderCount;
+
+  glm::mat4 modelView = getModelView();
+  glm::mat4 projection = view::getCameraPerspectiveMatrix();
+  bool moved = !lodSelectionValid || modelView != lodModelView || projection != lodProjection;
+  if (!moved && lodSelectionRefined) return;
+
+  size_t budget = moved ? lodPointBudget / 4 : lodPointBudget;
+  lodPoints = lodOctree->selectPoints(modelView, projection, view::bufferHeight, budget, 2.);
+  lodModelView = modelView;
+  lodProjection = projection;
+  lodSelectionValid = true;
+  lodSelectionRefined = !moved;
+
+  // Everything uploaded for the old subset is stale. This also requests another frame, which refines the subset if the
+  // camera has stopped.
+  refresh();
+}
+
 } // namespace polyscope
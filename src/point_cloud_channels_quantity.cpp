@@ -0,0 +1,258 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/point_cloud_channels_quantity.h"
+
+#include "polyscope/parallel.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/render/color_maps.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace polyscope {
+
+PointCloudChannelsQuantity::PointCloudChannelsQuantity(std::string name, std::vector<std::string> channelNames_,
+                                                       std::vector<float> channelValues_, PointCloud& pointCloud_)
+    : PointCloudQuantity(name, pointCloud_, true), channelNames(std::move(channelNames_)), nPoints(parent.nPoints()),
+      channelValues(std::move(channelValues_)), cMap(uniquePrefix() + "#cmap", defaultColorMap(DataType::STANDARD)) {
+
+  if (channelValues.size() != nChannels() * nPoints) {
+    polyscope::error("Point cloud channels quantity " + name + " does not have one value per point for each of its " +
+                     std::to_string(nChannels()) + " channels (" + std::to_string(channelValues.size()) +
+                     " values for " + std::to_string(nPoints) + " points)");
+    channelValues.resize(nChannels() * nPoints, 0.f);
+  }
+
+  // The range of each channel, to map the colors
+  channelRanges.resize(nChannels());
+  parallelFor(
+      0, nChannels(),
+      [&](size_t iC) {
+        float low = std::numeric_limits<float>::infinity();
+        float high = -std::numeric_limits<float>::infinity();
+        for (size_t iP = 0; iP < nPoints; iP++) {
+          float val = channelValues[iC * nPoints + iP];
+          if (!std::isfinite(val)) continue;
+          low = std::min(low, val);
+          high = std::max(high, val);
+        }
+        if (low > high) low = high = 0.f; // no finite values
+        channelRanges[iC] = std::make_pair(low, high);
+      },
+      1);
+
+  resetMapRange();
+}
+
+void PointCloudChannelsQuantity::draw() {
+  if (!isEnabled() || nChannels() == 0) return;
+
+  // Make the program if we don't have one already
+  if (pointProgram == nullptr) {
+    createPointProgram();
+  }
+
+  // Set uniforms
+  parent.setStructureUniforms(*pointProgram);
+  parent.setPointCloudUniforms(*pointProgram);
+  int channelRows = static_cast<int>(channelTexture->getSizeY() / nChannels());
+  pointProgram->setUniform("u_channelRowA", static_cast<int>(channelA) * channelRows);
+  pointProgram->setUniform("u_channelRowB", static_cast<int>(channelB) * channelRows);
+  pointProgram->setUniform("u_channelWeightA", weightA);
+  pointProgram->setUniform("u_channelWeightB", weightB);
+  pointProgram->setUniform("u_rangeLow", vizRange.first);
+  pointProgram->setUniform("u_rangeHigh", vizRange.second);
+
+  pointProgram->draw();
+}
+
+void PointCloudChannelsQuantity::createPointProgram() {
+  pointProgram = render::engine->requestShader(
+      parent.getShaderNameForRenderMode(),
+      parent.addPointCloudRules({"SPHERE_PROPAGATE_CHANNEL_VALUE", "SHADE_COLORMAP_VALUE"}));
+
+  // Fill buffers. Each point only carries its own index, its values are read from the texture.
+  parent.fillGeometryBuffers(*pointProgram);
+  std::vector<float> pointInds(nPoints);
+  for (size_t iP = 0; iP < nPoints; iP++) {
+    pointInds[iP] = static_cast<float>(iP);
+  }
+  parent.setPointAttribute(*pointProgram, "a_pointInd", pointInds);
+  if (!channelTexture) {
+    channelTexture = render::engine->generateElementTexture(channelValues, nChannels());
+  }
+  pointProgram->setTextureFromBuffer("t_channelValues", channelTexture.get());
+  pointProgram->setTextureFromColormap("t_colormap", cMap.get());
+
+  render::engine->setMaterial(*pointProgram, parent.getMaterial());
+}
+
+void PointCloudChannelsQuantity::buildCustomUI() {
+  if (nChannels() == 0) return;
+  ImGui::SameLine();
+
+  if (render::buildColormapSelector(cMap.get())) {
+    setColorMap(getColorMap());
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Reset")) {
+    resetMapRange();
+  }
+
+  // Channel selection
+  ImGui::PushItemWidth(150);
+  auto channelCombo = [&](const char* label, size_t& iChannel) {
+    bool changed = false;
+    if (ImGui::BeginCombo(label, channelNames[iChannel].c_str())) {
+      for (size_t iC = 0; iC < nChannels(); iC++) {
+        if (ImGui::Selectable(channelNames[iC].c_str(), iC == iChannel)) {
+          iChannel = iC;
+          changed = true;
+        }
+      }
+      ImGui::EndCombo();
+    }
+    return changed;
+  };
+  size_t newA = channelA;
+  size_t newB = channelB;
+  float newWeightA = weightA;
+  float newWeightB = weightB;
+  bool combine = getDisplaysCombination();
+  bool changed = channelCombo("Channel", newA);
+  if (ImGui::Checkbox("Combine", &combine)) {
+    changed = true;
+    newWeightA = 1.f;
+    newWeightB = combine ? -1.f : 0.f;
+    newB = newA;
+  }
+  if (combine) {
+    changed |= ImGui::InputFloat("Weight A", &newWeightA);
+    changed |= channelCombo("Channel B", newB);
+    changed |= ImGui::InputFloat("Weight B", &newWeightB);
+  }
+  ImGui::PopItemWidth();
+  if (changed) {
+    setDisplayedCombination(newA, newWeightA, newB, newWeightB);
+  }
+
+  ImGui::DragFloatRange2("##range", &vizRange.first, &vizRange.second, (vizRange.second - vizRange.first) / 100.,
+                         -std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), "Min: %.3e",
+                         "Max: %.3e");
+}
+
+void PointCloudChannelsQuantity::buildPickUI(size_t ind) {
+  ImGui::TextUnformatted(name.c_str());
+  ImGui::NextColumn();
+  ImGui::Text("%g", displayedValue(ind));
+  ImGui::NextColumn();
+}
+
+void PointCloudChannelsQuantity::refresh() {
+  pointProgram.reset();
+  Quantity::refresh();
+}
+
+void PointCloudChannelsQuantity::releaseRenderData() {
+  channelTexture.reset();
+  PointCloudQuantity::releaseRenderData();
+}
+
+void PointCloudChannelsQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (pointProgram) {
+    parent.updateGeometryBuffers(*pointProgram, pointRanges);
+  }
+  requestRedraw();
+}
+
+std::string PointCloudChannelsQuantity::niceName() { return name + " (channels)"; }
+
+size_t PointCloudChannelsQuantity::hostMemoryUsage() {
+  size_t bytes = allocatedBytes(channelValues) + allocatedBytes(channelRanges);
+  for (const std::string& n : channelNames) {
+    bytes += n.capacity();
+  }
+  return bytes;
+}
+
+std::pair<double, double> PointCloudChannelsQuantity::getChannelRange(size_t iChannel) const {
+  return channelRanges[iChannel];
+}
+
+bool PointCloudChannelsQuantity::checkChannelIndex(size_t iChannel) {
+  if (iChannel >= nChannels()) {
+    polyscope::error("Point cloud channels quantity " + name + " has no channel " + std::to_string(iChannel));
+    return false;
+  }
+  return true;
+}
+
+PointCloudChannelsQuantity* PointCloudChannelsQuantity::setDisplayedChannel(size_t iChannel) {
+  return setDisplayedCombination(iChannel, 1., iChannel, 0.);
+}
+
+PointCloudChannelsQuantity* PointCloudChannelsQuantity::setDisplayedChannel(std::string channelName) {
+  auto it = std::find(channelNames.begin(), channelNames.end(), channelName);
+  if (it == channelNames.end()) {
+    polyscope::error("Point cloud channels quantity " + name + " has no channel " + channelName);
+    return this;
+  }
+  return setDisplayedChannel(static_cast<size_t>(it - channelNames.begin()));
+}
+
+PointCloudChannelsQuantity* PointCloudChannelsQuantity::setDisplayedCombination(size_t iChannelA, double weightA_,
+                                                                                size_t iChannelB, double weightB_) {
+  if (!checkChannelIndex(iChannelA) || !checkChannelIndex(iChannelB)) return this;
+  channelA = iChannelA;
+  channelB = iChannelB;
+  weightA = static_cast<float>(weightA_);
+  weightB = static_cast<float>(weightB_);
+  resetMapRange();
+  return this;
+}
+
+size_t PointCloudChannelsQuantity::getDisplayedChannel() { return channelA; }
+
+bool PointCloudChannelsQuantity::getDisplaysCombination() { return weightB != 0.f; }
+
+double PointCloudChannelsQuantity::displayedValue(size_t iPoint) {
+  return weightA * getChannelValue(channelA, iPoint) + weightB * getChannelValue(channelB, iPoint);
+}
+
+PointCloudChannelsQuantity* PointCloudChannelsQuantity::setColorMap(std::string val) {
+  cMap = val;
+  refresh();
+  requestRedraw();
+  return this;
+}
+
+std::string PointCloudChannelsQuantity::getColorMap() { return cMap.get(); }
+
+PointCloudChannelsQuantity* PointCloudChannelsQuantity::setMapRange(std::pair<double, double> val) {
+  vizRange = val;
+  requestRedraw();
+  return this;
+}
+
+std::pair<double, double> PointCloudChannelsQuantity::getMapRange() { return vizRange; }
+
+PointCloudChannelsQuantity* PointCloudChannelsQuantity::resetMapRange() {
+  if (nChannels() == 0) return this;
+
+  // The extent of the weighted sum, from the ranges of its terms
+  auto termRange = [&](size_t iChannel, float weight) {
+    float a = weight * channelRanges[iChannel].first;
+    float b = weight * channelRanges[iChannel].second;
+    return std::make_pair(std::min(a, b), std::max(a, b));
+  };
+  std::pair<float, float> rangeA = termRange(channelA, weightA);
+  std::pair<float, float> rangeB = termRange(channelB, weightB);
+  vizRange = std::make_pair(rangeA.first + rangeB.first, rangeA.second + rangeB.second);
+
+  requestRedraw();
+  return this;
+}
+
+} // namespace polyscope
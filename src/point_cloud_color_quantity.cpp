@@ -46,7 +46,7 @@ void PointCloudColorQuantity::createPointProgram() {
 
   // Fill buffers
   parent.fillGeometryBuffers(*pointProgram);
-  pointProgram->setAttribute("a_color", values);
+  parent.setPointAttribute(*pointProgram, "a_color", values);
 
   render::engine->setMaterial(*pointProgram, parent.getMaterial());
 }
@@ -56,6 +56,40 @@ void PointCloudColorQuantity::refresh() {
   Quantity::refresh();
 }
 
+void PointCloudColorQuantity::dataUpdated() {
+  if (pointProgram) {
+    parent.setPointAttribute(*pointProgram, "a_color", values, true);
+  }
+}
+
+void PointCloudColorQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (pointProgram) {
+    parent.updateGeometryBuffers(*pointProgram, pointRanges);
+  }
+  requestRedraw();
+}
+
+
+bool PointCloudColorQuantity::extendToAppendedPoints() {
+  values.resize(parent.nPoints(), glm::vec3{0., 0., 0.});
+  return true;
+}
+
+void PointCloudColorQuantity::appendValuesImpl(const std::vector<glm::vec3>& newColors) {
+  std::vector<size_t> slots = appendedValueSlots(newColors.size());
+  DirtyRanges changed;
+  for (size_t i = 0; i < slots.size(); i++) {
+    if (slots[i] == INVALID_IND) continue;
+    values[slots[i]] = newColors[i];
+    changed.mark(slots[i]);
+  }
+  if (changed.empty()) return;
+
+  if (pointProgram) {
+    parent.updatePointAttributeRanges(*pointProgram, "a_color", values, changed.coalesced());
+  }
+  requestRedraw();
+}
 
 void PointCloudColorQuantity::buildPickUI(size_t ind) {
   ImGui::TextUnformatted(name.c_str());
@@ -69,4 +103,6 @@ void PointCloudColorQuantity::buildPickUI(size_t ind) {
   ImGui::NextColumn();
 }
 
+size_t PointCloudColorQuantity::hostMemoryUsage() { return allocatedBytes(values); }
+
 } // namespace polyscope
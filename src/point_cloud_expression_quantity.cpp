@@ -0,0 +1,235 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/point_cloud_expression_quantity.h"
+
+#include "polyscope/point_cloud_scalar_quantity.h"
+#include "polyscope/point_cloud_vector_quantity.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/render/color_maps.h"
+
+#include "imgui.h"
+
+#include <limits>
+
+namespace polyscope {
+
+namespace {
+size_t expressionRuleCount = 0; // each quantity registers its own rules
+}
+
+PointCloudExpressionQuantity::PointCloudExpressionQuantity(std::string name, Expression expression_,
+                                                           PointCloud& pointCloud_)
+    : PointCloudQuantity(name, pointCloud_, true), expression(std::move(expression_)),
+      ruleName("SPHERE_EXPRESSION_" + std::to_string(expressionRuleCount++)),
+      cMap(uniquePrefix() + "#cmap", defaultColorMap(DataType::STANDARD)) {
+  registerExpressionRules();
+  resetMapRange();
+}
+
+PointCloudExpressionQuantity::~PointCloudExpressionQuantity() {
+  if (render::engine == nullptr) return; // (at exit)
+  render::engine->unregisterShaderRule(ruleName);
+  render::engine->unregisterShaderRule(ruleName + "_INSTANCED");
+}
+
+void PointCloudExpressionQuantity::registerExpressionRules() {
+
+  std::string vertDeclarations;
+  std::vector<render::ShaderSpecAttribute> attributes;
+  for (size_t iF = 0; iF < expression.getFieldNames().size(); iF++) {
+    std::string attr = "a_exprField" + std::to_string(iF);
+    bool isVector = expression.getFieldType(iF) == ExpressionValueType::Vector;
+    vertDeclarations += std::string("in ") + (isVector ? "vec3 " : "float ") + attr + ";\n";
+    attributes.push_back({attr, isVector ? render::DataType::Vector3Float : render::DataType::Float});
+  }
+  std::string value = expression.toGLSL("a_exprField");
+
+  // As SPHERE_PROPAGATE_VALUE, with the value computed in the vertex shader
+  render::engine->registerShaderRule(
+      ruleName, render::ShaderReplacementRule(ruleName,
+                                              {
+                                                  {"VERT_DECLARATIONS", vertDeclarations + "out float a_valueToGeom;\n"},
+                                                  {"VERT_ASSIGNMENTS", "a_valueToGeom = " + value + ";\n"},
+                                                  {"GEOM_DECLARATIONS", "in float a_valueToGeom[];\n"
+                                                                        "out float a_valueToFrag;\n"},
+                                                  {"GEOM_PER_EMIT", "a_valueToFrag = a_valueToGeom[0];\n"},
+                                                  {"FRAG_DECLARATIONS", "in float a_valueToFrag;\n"},
+                                                  {"GENERATE_SHADE_VALUE", "float shadeValue = a_valueToFrag;\n"},
+                                              },
+                                              {}, attributes, {}));
+
+  // (also used by the range reduction, see resetMapRange())
+  render::engine->registerShaderRule(
+      ruleName + "_INSTANCED",
+      render::ShaderReplacementRule(ruleName + "_INSTANCED",
+                                    {
+                                        {"VERT_DECLARATIONS", vertDeclarations + "out float a_valueToFrag;\n"},
+                                        {"VERT_ASSIGNMENTS", "a_valueToFrag = " + value + ";\n"},
+                                        {"FRAG_DECLARATIONS", "in float a_valueToFrag;\n"},
+                                        {"GENERATE_SHADE_VALUE", "float shadeValue = a_valueToFrag;\n"},
+                                    },
+                                    {}, attributes, {}));
+}
+
+bool PointCloudExpressionQuantity::resolveFields(std::vector<PointCloudScalarQuantity*>& scalars,
+                                                 std::vector<PointCloudVectorQuantity*>& vectors) {
+  scalars.clear();
+  vectors.clear();
+  for (const std::string& fieldName : expression.getFieldNames()) {
+    PointCloudQuantity* q = parent.getQuantity(fieldName);
+    PointCloudScalarQuantity* scalarQ = dynamic_cast<PointCloudScalarQuantity*>(q);
+    PointCloudVectorQuantity* vectorQ = dynamic_cast<PointCloudVectorQuantity*>(q);
+    if (scalarQ == nullptr && vectorQ == nullptr) {
+      polyscope::error("Point cloud expression quantity " + name + " uses " + fieldName +
+                       ", which is no longer a scalar or vector quantity of " + parent.name);
+      return false;
+    }
+    scalars.push_back(scalarQ);
+    vectors.push_back(vectorQ);
+  }
+  return true;
+}
+
+bool PointCloudExpressionQuantity::setFieldAttributes(render::ShaderProgram& p, bool fullBuffers) {
+  std::vector<PointCloudScalarQuantity*> scalars;
+  std::vector<PointCloudVectorQuantity*> vectors;
+  if (!resolveFields(scalars, vectors)) return false;
+
+  for (size_t iF = 0; iF < scalars.size(); iF++) {
+    std::string attr = "a_exprField" + std::to_string(iF);
+    if (fullBuffers) {
+      // The buffers the quantities keep on the GPU anyway, shared rather than uploaded again
+      p.setAttribute(attr, scalars[iF] ? scalars[iF]->getValueRenderBuffer() : vectors[iF]->getVectorRenderBuffer());
+    } else if (scalars[iF]) {
+      parent.setPointAttribute(p, attr, scalars[iF]->values);
+    } else {
+      parent.setPointAttribute(p, attr, vectors[iF]->vectors);
+    }
+  }
+  return true;
+}
+
+void PointCloudExpressionQuantity::draw() {
+  if (!isEnabled()) return;
+
+  // Make the program if we don't have one already
+  if (pointProgram == nullptr) {
+    createPointProgram();
+    if (pointProgram == nullptr) return;
+  }
+
+  // Set uniforms
+  parent.setStructureUniforms(*pointProgram);
+  parent.setPointCloudUniforms(*pointProgram);
+  pointProgram->setUniform("u_rangeLow", vizRange.first);
+  pointProgram->setUniform("u_rangeHigh", vizRange.second);
+
+  pointProgram->draw();
+}
+
+void PointCloudExpressionQuantity::createPointProgram() {
+  std::shared_ptr<render::ShaderProgram> program =
+      render::engine->requestShader(parent.getShaderNameForRenderMode(),
+                                    parent.addPointCloudRules({ruleName, "SHADE_COLORMAP_VALUE"}));
+
+  // Fill buffers
+  parent.fillGeometryBuffers(*program);
+  if (!setFieldAttributes(*program, parent.drawsAllPointsInOrder())) return;
+  program->setTextureFromColormap("t_colormap", cMap.get());
+
+  render::engine->setMaterial(*program, parent.getMaterial());
+  pointProgram = program;
+}
+
+void PointCloudExpressionQuantity::buildCustomUI() {
+  ImGui::SameLine();
+
+  if (render::buildColormapSelector(cMap.get())) {
+    setColorMap(getColorMap());
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Reset")) {
+    resetMapRange();
+  }
+
+  ImGui::TextUnformatted(expression.getSource().c_str());
+  ImGui::DragFloatRange2("##range", &vizRange.first, &vizRange.second, (vizRange.second - vizRange.first) / 100.,
+                         -std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), "Min: %.3e",
+                         "Max: %.3e");
+}
+
+void PointCloudExpressionQuantity::buildPickUI(size_t ind) {
+  ImGui::TextUnformatted(name.c_str());
+  ImGui::NextColumn();
+  ImGui::Text("%g", getValue(ind));
+  ImGui::NextColumn();
+}
+
+void PointCloudExpressionQuantity::refresh() {
+  pointProgram.reset();
+  Quantity::refresh();
+}
+
+void PointCloudExpressionQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (pointProgram) {
+    parent.updateGeometryBuffers(*pointProgram, pointRanges);
+  }
+  requestRedraw();
+}
+
+bool PointCloudExpressionQuantity::extendToAppendedPoints() {
+  refresh();
+  return true;
+}
+
+std::string PointCloudExpressionQuantity::niceName() { return name + " (expression)"; }
+
+size_t PointCloudExpressionQuantity::hostMemoryUsage() { return expression.getSource().capacity(); }
+
+double PointCloudExpressionQuantity::getValue(size_t iPoint) {
+  std::vector<PointCloudScalarQuantity*> scalars;
+  std::vector<PointCloudVectorQuantity*> vectors;
+  if (!resolveFields(scalars, vectors)) return 0.;
+  std::vector<glm::vec3> fieldValues;
+  for (size_t iF = 0; iF < scalars.size(); iF++) {
+    if (scalars[iF]) {
+      fieldValues.push_back(glm::vec3(static_cast<float>(scalars[iF]->values[iPoint])));
+    } else {
+      fieldValues.push_back(vectors[iF]->vectors[iPoint]);
+    }
+  }
+  return expression.evaluate(fieldValues).x;
+}
+
+PointCloudExpressionQuantity* PointCloudExpressionQuantity::setColorMap(std::string val) {
+  cMap = val;
+  refresh();
+  requestRedraw();
+  return this;
+}
+
+std::string PointCloudExpressionQuantity::getColorMap() { return cMap.get(); }
+
+PointCloudExpressionQuantity* PointCloudExpressionQuantity::setMapRange(std::pair<double, double> val) {
+  vizRange = val;
+  requestRedraw();
+  return this;
+}
+
+std::pair<double, double> PointCloudExpressionQuantity::getMapRange() { return vizRange; }
+
+std::pair<double, double> PointCloudExpressionQuantity::getDataRange() { return dataRange; }
+
+PointCloudExpressionQuantity* PointCloudExpressionQuantity::resetMapRange() {
+  // Evaluate the expression once per point in to a single pixel. The program is made each time, as the buffers of the
+  // quantities may have been replaced since.
+  std::shared_ptr<render::ShaderProgram> reduceProgram = render::engine->requestShader(
+      "POINT_REDUCE_MINMAX", {ruleName + "_INSTANCED"}, render::ShaderReplacementDefaults::Process);
+  if (setFieldAttributes(*reduceProgram, true)) {
+    dataRange = render::engine->reduceMinMax(*reduceProgram);
+  }
+  vizRange = dataRange;
+  requestRedraw();
+  return this;
+}
+
+} // namespace polyscope
@@ -0,0 +1,134 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/point_cloud_octree.h"
+
+#include "polyscope/utilities.h"
+#include "polyscope/view.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <stdexcept>
+
+namespace polyscope {
+
+const size_t PointCloudOctree::pointsPerNode;
+const int PointCloudOctree::maxDepth;
+
+PointCloudOctree::PointCloudOctree(const std::vector<glm::vec3>& points) {
+  if (points.size() >= std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("point cloud octree can hold at most 2^32 - 1 points");
+  }
+
+  // Visit the points in a random order, so that the first few points of any range are a uniform sample of it. The
+  // partitioning below keeps this property for every sub-range.
+  order.resize(points.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 gen(77);
+  std::shuffle(order.begin(), order.end(), gen);
+
+  glm::vec3 bboxMin{std::numeric_limits<float>::infinity()};
+  glm::vec3 bboxMax{-std::numeric_limits<float>::infinity()};
+  for (const glm::vec3& p : points) {
+    bboxMin = glm::min(bboxMin, p);
+    bboxMax = glm::max(bboxMax, p);
+  }
+
+  buildNode(points, bboxMin, bboxMax, 0, order.size(), 0);
+}
+
+int32_t PointCloudOctree::buildNode(const std::vector<glm::vec3>& points, glm::vec3 bboxMin, glm::vec3 bboxMax,
+                                    size_t start, size_t end, int depth) {
+
+  size_t count = (depth == maxDepth) ? end - start : std::min(end - start, pointsPerNode);
+  int32_t ind = static_cast<int32_t>(nodes.size());
+  Node node;
+  node.bboxMin = bboxMin;
+  node.bboxMax = bboxMax;
+  node.start = static_cast<uint32_t>(start);
+  node.count = static_cast<uint32_t>(count);
+  node.children.fill(-1);
+  nodes.push_back(node);
+
+  // Sort the rest in to octants: child c takes the points on the high side of the center along x if (c & 4), along y
+  // if (c & 2), and along z if (c & 1)
+  glm::vec3 center = 0.5f * (bboxMin + bboxMax);
+  auto split = [&](size_t b, size_t e, int axis) {
+    return std::partition(order.begin() + b, order.begin() + e,
+                          [&](uint32_t i) { return points[i][axis] < center[axis]; }) -
+           order.begin();
+  };
+  std::array<size_t, 9> bounds;
+  bounds[0] = start + count;
+  bounds[8] = end;
+  bounds[4] = split(bounds[0], bounds[8], 0);
+  bounds[2] = split(bounds[0], bounds[4], 1);
+  bounds[6] = split(bounds[4], bounds[8], 1);
+  for (int c = 0; c < 8; c += 2) {
+    bounds[c + 1] = split(bounds[c], bounds[c + 2], 2);
+  }
+
+  for (int c = 0; c < 8; c++) {
+    if (bounds[c] == bounds[c + 1]) continue;
+    glm::vec3 childMin = bboxMin;
+    glm::vec3 childMax = bboxMax;
+    for (int axis = 0; axis < 3; axis++) {
+      bool high = c & (4 >> axis);
+      (high ? childMin : childMax)[axis] = center[axis];
+    }
+    int32_t child = buildNode(points, childMin, childMax, bounds[c], bounds[c + 1], depth + 1);
+    nodes[ind].children[c] = child;
+  }
+
+  return ind;
+}
+
+std::vector<uint32_t> PointCloudOctree::selectPoints(const glm::mat4& modelView, const glm::mat4& projection,
+                                                     float viewportHeight, size_t pointBudget,
+                                                     float maxPixelSpacing) const {
+
+  std::vector<uint32_t> selected;
+  if (nodes.empty() || order.empty()) return selected;
+
+  glm::mat4 toClip = projection * modelView;
+  float viewScale = std::cbrt(std::abs(glm::determinant(glm::mat3(modelView)))); // object units to view units
+  float pixelsPerUnit = projection[1][1] * viewportHeight / 2.;
+
+  // Nodes in view, by how far apart their points are on screen
+  typedef std::pair<float, int32_t> Candidate;
+  std::priority_queue<Candidate> candidates;
+  auto consider = [&](int32_t ind) {
+    const Node& n = nodes[ind];
+    if (!view::boxMayBeInView(n.bboxMin, n.bboxMax, toClip)) return;
+    float spacing = glm::length(n.bboxMax - n.bboxMin) / std::cbrt(static_cast<float>(std::max<uint32_t>(n.count, 1)));
+    float w = (toClip * glm::vec4(0.5f * (n.bboxMin + n.bboxMax), 1.)).w;
+    float pixelSpacing = w > 0. ? viewScale * spacing * pixelsPerUnit / w : std::numeric_limits<float>::infinity();
+    candidates.emplace(pixelSpacing, ind);
+  };
+
+  consider(0);
+  while (!candidates.empty()) {
+    Candidate top = candidates.top();
+    candidates.pop();
+    const Node& n = nodes[top.second];
+    if (selected.size() + n.count > pointBudget) break;
+
+    selected.insert(selected.end(), order.begin() + n.start, order.begin() + n.start + n.count);
+
+    if (top.first > maxPixelSpacing) {
+      for (int32_t child : n.children) {
+        if (child >= 0) consider(child);
+      }
+    }
+  }
+
+  return selected;
+}
+
+size_t PointCloudOctree::allocatedBytes() const {
+  return polyscope::allocatedBytes(nodes) + polyscope::allocatedBytes(order);
+}
+
+} // namespace polyscope
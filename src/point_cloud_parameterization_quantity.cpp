@@ -73,7 +73,7 @@ void PointCloudParameterizationQuantity::createProgram() {
 
   // Fill buffers
   parent.fillGeometryBuffers(*program);
-  program->setAttribute("a_value2", coords);
+  parent.setPointAttribute(*program, "a_value2", coords);
 
   render::engine->setMaterial(*program, parent.getMaterial());
 }
@@ -257,6 +257,13 @@ void PointCloudParameterizationQuantity::refresh() {
   Quantity::refresh();
 }
 
+void PointCloudParameterizationQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (program) {
+    parent.updateGeometryBuffers(*program, pointRanges);
+  }
+  requestRedraw();
+}
+
 std::string PointCloudParameterizationQuantity::niceName() { return name + " (point parameterization)"; }
 
 void PointCloudParameterizationQuantity::buildPickUI(size_t ind) {
@@ -266,5 +273,6 @@ void PointCloudParameterizationQuantity::buildPickUI(size_t ind) {
   ImGui::NextColumn();
 }
 
+size_t PointCloudParameterizationQuantity::hostMemoryUsage() { return allocatedBytes(coords); }
 
 } // namespace polyscope
@@ -1,10 +1,14 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/point_cloud_scalar_quantity.h"
 
+#include "polyscope/batch_update.h"
 #include "polyscope/polyscope.h"
 
 #include "imgui.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace polyscope {
 
 
@@ -32,6 +36,9 @@ void PointCloudScalarQuantity::draw() {
   parent.setStructureUniforms(*pointProgram);
   parent.setPointCloudUniforms(*pointProgram);
   setScalarUniforms(*pointProgram);
+  if (valueFrames) {
+    bindValueFrames();
+  }
 
   pointProgram->draw();
 }
@@ -58,22 +65,173 @@ void PointCloudScalarQuantity::buildCustomUI() {
 void PointCloudScalarQuantity::createPointProgram() {
   // Create the program to draw this quantity
 
+  std::vector<std::string> rules = {"SPHERE_PROPAGATE_VALUE"};
+  if (valueFrames && parent.getTimeInterpolation()) {
+    rules.push_back("SPHERE_VALUE_LERP"); // (after SPHERE_PROPAGATE_VALUE, it overrides its assignment)
+  }
   pointProgram = render::engine->requestShader(parent.getShaderNameForRenderMode(),
-                                               parent.addPointCloudRules(addScalarRules({"SPHERE_PROPAGATE_VALUE"})));
+                                               parent.addPointCloudRules(addScalarRules(rules)));
 
   // Fill buffers
   parent.fillGeometryBuffers(*pointProgram);
-  pointProgram->setAttribute("a_value", values);
+  if (valueFrames) {
+    bindValueFrames();
+  } else if (parent.drawsAllPointsInOrder()) {
+    pointProgram->setAttribute("a_value", getValueRenderBuffer());
+  } else {
+    parent.setPointAttribute(*pointProgram, "a_value", values);
+  }
   pointProgram->setTextureFromColormap("t_colormap", cMap.get());
 
   render::engine->setMaterial(*pointProgram, parent.getMaterial());
 }
 
+void PointCloudScalarQuantity::addValueFrameImpl(const std::vector<double>& frameValues) {
+  batch::runDeferred(this); // (the data range is widened below)
+
+  if (!valueFrames) {
+    valueFrames.reset(new TimeFrameBuffers(render::DataType::Float, options::timeSeriesMaxFrames));
+    std::vector<double> firstValues = values.toDoubles();
+    valueFrames->addFrame(std::vector<float>(firstValues.begin(), firstValues.end()));
+    refresh();
+  }
+  valueFrames->addFrame(std::vector<float>(frameValues.begin(), frameValues.end()));
+
+  std::pair<double, double> frameRange = robustMinMax(frameValues, 1e-5);
+  dataRange.first = std::min(dataRange.first, frameRange.first);
+  dataRange.second = std::max(dataRange.second, frameRange.second);
+  defaultRange.first = std::min(defaultRange.first, frameRange.first);
+  defaultRange.second = std::max(defaultRange.second, frameRange.second);
+
+  parent.timeFramesAdded(valueFrames->nFrames());
+}
+
+PointCloudScalarQuantity* PointCloudScalarQuantity::setValueFrameLoader(size_t nFrames, TimeFrameLoader loader) {
+  if (nFrames == 0) {
+    polyscope::error("setValueFrameLoader() on " + name + " with no frames");
+    return this;
+  }
+  valueFrames.reset(new TimeFrameBuffers(render::DataType::Float, nFrames, values.size(), std::move(loader)));
+  refresh();
+  parent.timeFramesAdded(nFrames);
+  return this;
+}
+
+void PointCloudScalarQuantity::bindValueFrames() {
+  if (parent.getTimeInterpolation() && pointProgram->hasAttribute("a_valueNext")) {
+    valueFrames->bind(*pointProgram, "a_value", "a_valueNext", "u_valueBlend", parent.getTime());
+  } else {
+    valueFrames->bind(*pointProgram, "a_value", parent.getTime());
+  }
+}
+
 void PointCloudScalarQuantity::refresh() {
   pointProgram.reset();
   Quantity::refresh();
 }
 
+void PointCloudScalarQuantity::releaseRenderData() {
+  valueBuffer.reset();
+  PointCloudQuantity::releaseRenderData();
+}
+
+std::shared_ptr<render::AttributeBuffer> PointCloudScalarQuantity::getValueRenderBuffer() {
+  if (!valueBuffer) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    valueBuffer = render::engine->generateAttributeBuffer(render::DataType::Float);
+    values.setBufferData(*valueBuffer);
+  }
+  return valueBuffer;
+}
+
+void PointCloudScalarQuantity::deviceValuesWritten(void* fence) {
+  if (!parent.drawsAllPointsInOrder() || valueFrames) {
+    warning("deviceValuesWritten() on [" + name + "], whose points are not drawn from the value buffer");
+    return;
+  }
+  if (fence != nullptr) {
+    render::engine->waitForExternalFence(fence);
+  }
+
+  std::shared_ptr<render::ShaderProgram> rangeProgram = render::engine->requestShader(
+      "POINT_REDUCE_BOUNDS", {"REDUCE_SCALAR_VALUE"}, render::ShaderReplacementDefaults::Process);
+  rangeProgram->setAttribute("a_value", getValueRenderBuffer());
+  rangeProgram->setDrawLimit(parent.nPoints());
+  Handle<PointCloudScalarQuantity> self(this);
+  render::engine->reduceBoundsAsync(*rangeProgram, [self](glm::vec3 low, glm::vec3 high) {
+    PointCloudScalarQuantity* q = self.get();
+    if (q == nullptr) return;
+    q->dataRange = std::make_pair<double, double>(low.x, high.x);
+    q->defaultRange = q->dataRange; // (no percentiles on the GPU)
+    q->vizRange = std::make_pair(low.x, high.x);
+    q->requestRedraw();
+  });
+  requestRedraw();
+}
+
+double PointCloudScalarQuantity::getMaxPositiveValue() {
+  if (maxPositiveValue < 0.) {
+    maxPositiveValue = values.maxPositive();
+  }
+  return maxPositiveValue;
+}
+
+void PointCloudScalarQuantity::dataUpdated() {
+  maxPositiveValue = -1.;
+  if (valueBuffer) {
+    values.setBufferData(*valueBuffer, true); // (which also updates the programs binding it)
+  }
+  parent.scalarValuesUpdated(*this);
+  if (valueFrames) {
+    polyscope::warning("Point cloud scalar quantity " + name + " has value frames, which are drawn instead of its values");
+    return;
+  }
+  if (pointProgram && !parent.drawsAllPointsInOrder()) { // (otherwise it binds the buffer above)
+    parent.setPointAttribute(*pointProgram, "a_value", values, true);
+  }
+}
+
+void PointCloudScalarQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (pointProgram) {
+    parent.updateGeometryBuffers(*pointProgram, pointRanges);
+  }
+  requestRedraw();
+}
+
+bool PointCloudScalarQuantity::extendToAppendedPoints() {
+  values.resize(parent.nPoints());
+  valueBuffer.reset(); // (the cloud stops drawing its points in order, see PointCloud::drawsAllPointsInOrder())
+  maxPositiveValue = -1.;
+  hist.buildHistogramLazily([this]() { values.buildHistogram(hist); });
+  return true;
+}
+
+void PointCloudScalarQuantity::appendValuesImpl(const std::vector<double>& newValues) {
+  batch::runDeferred(this); // (the data range is widened below)
+
+  std::vector<size_t> slots = appendedValueSlots(newValues.size());
+  DirtyRanges changed;
+  for (size_t i = 0; i < slots.size(); i++) {
+    if (slots[i] == INVALID_IND) continue;
+    values.set(slots[i], newValues[i]);
+    changed.mark(slots[i]);
+    if (!std::isfinite(newValues[i])) continue;
+    dataRange.first = std::min(dataRange.first, newValues[i]);
+    dataRange.second = std::max(dataRange.second, newValues[i]);
+    defaultRange.first = std::min(defaultRange.first, newValues[i]);
+    defaultRange.second = std::max(defaultRange.second, newValues[i]);
+  }
+  if (changed.empty()) return;
+  maxPositiveValue = -1.;
+
+  hist.buildHistogramLazily([this]() { values.buildHistogram(hist); });
+  if (pointProgram && !valueFrames) {
+    parent.updatePointAttributeRanges(*pointProgram, "a_value", values, changed.coalesced());
+  }
+  parent.scalarValuesUpdated(*this);
+  requestRedraw();
+}
+
 void PointCloudScalarQuantity::buildPickUI(size_t ind) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
@@ -84,4 +242,6 @@ void PointCloudScalarQuantity::buildPickUI(size_t ind) {
 
 std::string PointCloudScalarQuantity::niceName() { return name + " (scalar)"; }
 
+size_t PointCloudScalarQuantity::hostMemoryUsage() { return values.allocatedBytes(); }
+
 } // namespace polyscope
@@ -0,0 +1,133 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/point_cloud_sparse_scalar_quantity.h"
+
+#include "polyscope/polyscope.h"
+#include "polyscope/render/engine.h"
+
+#include "imgui.h"
+
+#include <limits>
+
+namespace polyscope {
+
+PointCloudSparseScalarQuantity::PointCloudSparseScalarQuantity(std::string name, SparseElementSet elements_,
+                                                               const std::vector<double>& values_,
+                                                               PointCloud& pointCloud_, DataType dataType_)
+    : PointCloudQuantity(name, pointCloud_, true), ScalarQuantity(*this, values_, dataType_),
+      elements(std::move(elements_)) {}
+
+void PointCloudSparseScalarQuantity::draw() {
+  if (!isEnabled()) return;
+
+  // Make the program if we don't have one already
+  if (pointProgram == nullptr) {
+    createPointProgram();
+  }
+
+  // Set uniforms
+  parent.setStructureUniforms(*pointProgram);
+  parent.setPointCloudUniforms(*pointProgram);
+  setScalarUniforms(*pointProgram);
+  pointProgram->setUniform("u_absentColor", parent.getPointColor());
+
+  pointProgram->draw();
+}
+
+void PointCloudSparseScalarQuantity::createPointProgram() {
+  std::vector<std::string> rules = addScalarRules({"SPHERE_PROPAGATE_SPARSE_VALUE"});
+  rules.push_back("SHADE_SPARSE_ABSENT_COLOR");
+  pointProgram = render::engine->requestShader(parent.getShaderNameForRenderMode(), parent.addPointCloudRules(rules));
+
+  // Fill buffers. Each point only carries its own index, its value is looked up in the textures.
+  parent.fillGeometryBuffers(*pointProgram);
+  std::vector<float> pointInds(parent.nPoints());
+  for (size_t iP = 0; iP < pointInds.size(); iP++) {
+    pointInds[iP] = static_cast<float>(iP);
+  }
+  parent.setPointAttribute(*pointProgram, "a_pointInd", pointInds);
+  setSparseTextures(*pointProgram);
+  pointProgram->setTextureFromColormap("t_colormap", cMap.get());
+
+  render::engine->setMaterial(*pointProgram, parent.getMaterial());
+}
+
+void PointCloudSparseScalarQuantity::setSparseTextures(render::ShaderProgram& p) {
+  if (!presenceTexture) {
+    presenceTexture = elements.generatePresenceTexture();
+  }
+  if (!valueTexture) {
+    std::vector<float> setValues(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+      setValues[i] = static_cast<float>(values[i]);
+    }
+    valueTexture = render::engine->generateElementTexture(setValues);
+  }
+  p.setTextureFromBuffer("t_sparsePresence", presenceTexture.get());
+  p.setTextureFromBuffer("t_sparseValues", valueTexture.get());
+}
+
+void PointCloudSparseScalarQuantity::buildCustomUI() {
+  ImGui::SameLine();
+
+  // == Options popup
+  if (ImGui::Button("Options")) {
+    ImGui::OpenPopup("OptionsPopup");
+  }
+  if (ImGui::BeginPopup("OptionsPopup")) {
+
+    buildScalarOptionsUI();
+
+    ImGui::EndPopup();
+  }
+
+  buildScalarUI();
+}
+
+void PointCloudSparseScalarQuantity::buildPickUI(size_t ind) {
+  ImGui::TextUnformatted(name.c_str());
+  ImGui::NextColumn();
+  size_t i = elements.find(ind);
+  if (i == INVALID_IND) {
+    ImGui::TextUnformatted("-");
+  } else {
+    ImGui::Text("%g", values[i]);
+  }
+  ImGui::NextColumn();
+}
+
+void PointCloudSparseScalarQuantity::refresh() {
+  pointProgram.reset();
+  Quantity::refresh();
+}
+
+void PointCloudSparseScalarQuantity::releaseRenderData() {
+  presenceTexture.reset();
+  valueTexture.reset();
+  PointCloudQuantity::releaseRenderData();
+}
+
+void PointCloudSparseScalarQuantity::dataUpdated() {
+  valueTexture.reset(); // (the points are the same, so only the values are uploaded again)
+  if (pointProgram) {
+    setSparseTextures(*pointProgram);
+  }
+}
+
+void PointCloudSparseScalarQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (pointProgram) {
+    parent.updateGeometryBuffers(*pointProgram, pointRanges);
+  }
+  requestRedraw();
+}
+
+double PointCloudSparseScalarQuantity::getValue(size_t ind) const {
+  size_t i = elements.find(ind);
+  if (i == INVALID_IND) return std::numeric_limits<double>::quiet_NaN();
+  return values[i];
+}
+
+std::string PointCloudSparseScalarQuantity::niceName() { return name + " (sparse scalar)"; }
+
+size_t PointCloudSparseScalarQuantity::hostMemoryUsage() { return values.allocatedBytes() + elements.allocatedBytes(); }
+
+} // namespace polyscope
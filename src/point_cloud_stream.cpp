@@ -0,0 +1,528 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/point_cloud_stream.h"
+
+#include "polyscope/polyscope.h"
+#include "polyscope/render/engine.h"
+#include "polyscope/utilities.h"
+#include "polyscope/view.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace polyscope {
+
+// Initialize statics
+const std::string PointCloudStream::structureTypeName = "Point Cloud Stream";
+const size_t PointCloudStream::maxUploadsPerFrame;
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "positions are read straight in to glm::vec3");
+
+namespace {
+
+// The number of bytes in a file, or -1 if it cannot be opened
+long long int fileBytes(const std::string& filename) {
+  std::ifstream in(filename, std::ios::binary | std::ios::ate);
+  if (!in) return -1;
+  return static_cast<long long int>(in.tellg());
+}
+
+} // namespace
+
+PointCloudStream::PointCloudStream(std::string name, std::string positionsFilename_, size_t chunkSize_)
+    : Structure(name, structureTypeName), positionsFilename(positionsFilename_),
+      chunkSize(std::max<size_t>(chunkSize_, 1)), pointColor(uniquePrefix() + "#pointColor", getNextUniqueColor()),
+      pointRadius(uniquePrefix() + "#pointRadius", relativeValue(0.005)),
+      material(uniquePrefix() + "#material", "clay"),
+      displayedAttribute(uniquePrefix() + "#displayedAttribute", ""), reads(options::streamReadThreads) {
+
+  long long int bytes = fileBytes(positionsFilename);
+  if (bytes < 0) {
+    throw std::runtime_error(name + ": could not open " + positionsFilename);
+  }
+  if (bytes % sizeof(glm::vec3) != 0) {
+    throw std::runtime_error(name + ": " + positionsFilename + " does not hold whole float32 x,y,z triples");
+  }
+  nPointsCount = bytes / sizeof(glm::vec3);
+
+  // Find the bounds of each chunk, holding one at a time
+  std::ifstream in(positionsFilename, std::ios::binary);
+  std::vector<glm::vec3> buffer;
+  for (size_t start = 0; start < nPointsCount; start += chunkSize) {
+    Chunk chunk;
+    chunk.start = start;
+    chunk.count = std::min(chunkSize, nPointsCount - start);
+    buffer.resize(chunk.count);
+    in.read(reinterpret_cast<char*>(buffer.data()), chunk.count * sizeof(glm::vec3));
+    if (!in) {
+      throw std::runtime_error(name + ": could not read " + positionsFilename);
+    }
+
+    chunk.bboxMin = glm::vec3{std::numeric_limits<float>::infinity()};
+    chunk.bboxMax = glm::vec3{-std::numeric_limits<float>::infinity()};
+    for (const glm::vec3& p : buffer) {
+      chunk.bboxMin = glm::min(chunk.bboxMin, p);
+      chunk.bboxMax = glm::max(chunk.bboxMax, p);
+    }
+    chunks.push_back(std::move(chunk));
+  }
+
+  updateObjectSpaceBounds();
+}
+
+PointCloudStream::~PointCloudStream() {}
+
+std::string PointCloudStream::typeName() { return structureTypeName; }
+
+void PointCloudStream::updateObjectSpaceBounds() {
+  glm::vec3 min = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  glm::vec3 max = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  for (const Chunk& chunk : chunks) {
+    min = componentwiseMin(min, chunk.bboxMin);
+    max = componentwiseMax(max, chunk.bboxMax);
+  }
+  objectSpaceBoundingBox = std::make_tuple(min, max);
+  objectSpaceLengthScale = chunks.empty() ? 0. : glm::length(max - min);
+  boundsChanged();
+}
+
+void PointCloudStream::draw() {
+  if (!isEnabled()) {
+    return;
+  }
+
+  updateStreaming();
+
+  for (Chunk& chunk : chunks) {
+    if (chunk.cloud && chunk.lastVisibleFrame == streamFrame) {
+      chunk.cloud->draw();
+    }
+  }
+}
+
+void PointCloudStream::drawPick() {}
+
+void PointCloudStream::buildPickUI(size_t localPickID) {}
+
+void PointCloudStream::updateStreaming() {
+  if (streamFrame > 0 && lastUpdateSceneRender == state::sceneRenderCount) return;
+  lastUpdateSceneRender = state::sceneRenderCount;
+  streamFrame++;
+
+  collectFinishedReads();
+
+  // The chunks follow the transform of the stream
+  if (getTransform() != chunkTransform) {
+    chunkTransform = getTransform();
+    for (Chunk& chunk : chunks) {
+      if (chunk.cloud) chunk.cloud->setTransform(chunkTransform);
+    }
+  }
+
+  // Visible chunks, nearest first
+  glm::mat4 toClip = view::getCameraPerspectiveMatrix() * getModelView();
+  std::vector<std::pair<float, size_t>> visible;
+  for (size_t iChunk = 0; iChunk < chunks.size(); iChunk++) {
+    Chunk& chunk = chunks[iChunk];
+    if (chunk.failed || !view::boxMayBeInView(chunk.bboxMin, chunk.bboxMax, toClip)) continue;
+    float wNear = std::numeric_limits<float>::infinity();
+    for (int c = 0; c < 8; c++) {
+      glm::vec3 corner{(c & 4) ? chunk.bboxMax.x : chunk.bboxMin.x, (c & 2) ? chunk.bboxMax.y : chunk.bboxMin.y,
+                       (c & 1) ? chunk.bboxMax.z : chunk.bboxMin.z};
+      wNear = std::min(wNear, (toClip * glm::vec4(corner, 1.)).w);
+    }
+    chunk.lastVisibleFrame = streamFrame;
+    visible.emplace_back(wNear, iChunk);
+  }
+  std::sort(visible.begin(), visible.end());
+
+  // As many as fit in the budget are wanted
+  std::vector<size_t> wanted;
+  size_t wantedPoints = 0;
+  for (const std::pair<float, size_t>& v : visible) {
+    Chunk& chunk = chunks[v.second];
+    if (wantedPoints + chunk.count > residentPointBudget) break;
+    wantedPoints += chunk.count;
+    chunk.lastWantedFrame = streamFrame;
+    wanted.push_back(v.second);
+  }
+
+  // Drop the least recently wanted chunks until the rest fit in the given number of points. The chunks wanted this
+  // frame fit in the budget, so this never needs to drop one of them.
+  size_t residentPoints = nResidentPoints();
+  auto dropResidentUntil = [&](size_t limit) {
+    while (residentPoints > limit) {
+      Chunk* oldest = nullptr;
+      for (Chunk& chunk : chunks) {
+        if (chunk.cloud && chunk.lastWantedFrame != streamFrame &&
+            (oldest == nullptr || chunk.lastWantedFrame < oldest->lastWantedFrame)) {
+          oldest = &chunk;
+        }
+      }
+      residentPoints -= oldest->count;
+      oldest->cloud.reset();
+    }
+  };
+  dropResidentUntil(residentPointBudget);
+
+  // Draw the wanted chunks which have been read, and start reading the others
+  size_t nUploads = 0;
+  bool waiting = false;
+  for (size_t iChunk : wanted) {
+    Chunk& chunk = chunks[iChunk];
+    if (chunk.cloud) continue;
+    waiting = true;
+
+    if (!chunk.cached) {
+      if (!chunk.reading && nReadsInFlight < 2 * static_cast<size_t>(std::max(options::streamReadThreads, 1))) {
+        startRead(iChunk);
+      }
+      continue;
+    }
+
+    if (nUploads == maxUploadsPerFrame) continue;
+    dropResidentUntil(residentPointBudget - chunk.count);
+    makeResident(iChunk);
+    residentPoints += chunk.count;
+    nUploads++;
+  }
+
+  // Trim the chunks which were read ahead of being drawn
+  size_t cachedPoints = 0;
+  for (const Chunk& chunk : chunks) {
+    if (chunk.cached) cachedPoints += chunk.count;
+  }
+  while (cachedPoints > cachedPointBudget) {
+    Chunk* oldest = nullptr;
+    for (Chunk& chunk : chunks) {
+      if (chunk.cached && (oldest == nullptr || chunk.lastWantedFrame < oldest->lastWantedFrame)) {
+        oldest = &chunk;
+      }
+    }
+    cachedPoints -= oldest->count;
+    oldest->cached.reset();
+  }
+
+  // Keep drawing frames until everything in view has arrived
+  if (waiting) {
+    requestRedraw();
+  }
+}
+
+void PointCloudStream::collectFinishedReads() {
+  std::vector<std::tuple<size_t, size_t, std::unique_ptr<ChunkData>>> finished;
+  {
+    std::lock_guard<std::mutex> lock(finishedMutex);
+    finished.swap(finishedReads);
+  }
+
+  for (std::tuple<size_t, size_t, std::unique_ptr<ChunkData>>& read : finished) {
+    Chunk& chunk = chunks[std::get<0>(read)];
+    std::unique_ptr<ChunkData>& data = std::get<2>(read);
+    nReadsInFlight--;
+    chunk.reading = false;
+    if (std::get<1>(read) != attributeGeneration) continue; // an attribute was added since
+
+    if (!data->error.empty()) {
+      warning(name + ": " + data->error);
+      chunk.failed = true;
+      continue;
+    }
+    chunk.cached = std::move(data);
+  }
+}
+
+void PointCloudStream::startRead(size_t iChunk) {
+  Chunk& chunk = chunks[iChunk];
+  chunk.reading = true;
+  nReadsInFlight++;
+
+  // (the job gets copies of everything it reads, which may change on the main thread in the meantime)
+  std::string filename = positionsFilename;
+  std::vector<Attribute> readAttributes = attributes;
+  size_t start = chunk.start;
+  size_t count = chunk.count;
+  size_t generation = attributeGeneration;
+  reads.push([this, filename, readAttributes, start, count, generation, iChunk]() {
+    std::unique_ptr<ChunkData> data = readChunk(filename, readAttributes, start, count);
+    std::lock_guard<std::mutex> lock(finishedMutex);
+    finishedReads.emplace_back(iChunk, generation, std::move(data));
+  });
+}
+
+std::unique_ptr<PointCloudStream::ChunkData> PointCloudStream::readChunk(std::string positionsFilename,
+                                                                         std::vector<Attribute> attributes,
+                                                                         size_t start, size_t count) {
+  std::unique_ptr<ChunkData> data(new ChunkData());
+  auto readRange = [&](const std::string& filename, char* target, size_t elementBytes) {
+    std::ifstream in(filename, std::ios::binary);
+    in.seekg(start * elementBytes);
+    in.read(target, count * elementBytes);
+    if (!in && data->error.empty()) {
+      data->error = "could not read points " + std::to_string(start) + " to " + std::to_string(start + count) +
+                    " of " + filename;
+    }
+  };
+
+  data->points.resize(count);
+  readRange(positionsFilename, reinterpret_cast<char*>(data->points.data()), sizeof(glm::vec3));
+
+  data->scalars.resize(attributes.size());
+  data->colors.resize(attributes.size());
+  for (size_t i = 0; i < attributes.size(); i++) {
+    if (attributes[i].isColor) {
+      data->colors[i].resize(count);
+      readRange(attributes[i].filename, reinterpret_cast<char*>(data->colors[i].data()), sizeof(glm::vec3));
+    } else {
+      std::vector<float> values(count);
+      readRange(attributes[i].filename, reinterpret_cast<char*>(values.data()), sizeof(float));
+      data->scalars[i].assign(values.begin(), values.end());
+    }
+  }
+
+  return data;
+}
+
+void PointCloudStream::makeResident(size_t iChunk) {
+  Chunk& chunk = chunks[iChunk];
+  std::unique_ptr<ChunkData> data = std::move(chunk.cached);
+
+  std::unique_ptr<PointCloud> cloud(new PointCloud(name + " chunk " + std::to_string(iChunk), std::move(data->points)));
+  for (size_t i = 0; i < attributes.size(); i++) {
+    const Attribute& a = attributes[i];
+    if (a.isColor) {
+      cloud->addColorQuantity(a.name, data->colors[i]);
+    } else {
+      cloud->addScalarQuantity(a.name, data->scalars[i], a.type)->setMapRange(a.range);
+    }
+  }
+  cloud->setTransform(chunkTransform);
+  applyAppearance(*cloud);
+  chunk.cloud = std::move(cloud);
+}
+
+void PointCloudStream::applyAppearance(PointCloud& cloud) {
+  cloud.setPointColor(pointColor.get());
+  ScaledValue<float> radius = pointRadius.get();
+  cloud.setPointRadius(*radius.getValuePtr(), radius.isRelative());
+  if (cloud.getMaterial() != material.get()) {
+    cloud.setMaterial(material.get());
+  }
+  for (const Attribute& a : attributes) {
+    cloud.getQuantity(a.name)->setEnabled(a.name == displayedAttribute.get());
+  }
+}
+
+void PointCloudStream::dropChunkData() {
+  attributeGeneration++;
+  for (Chunk& chunk : chunks) {
+    chunk.cached.reset();
+    chunk.cloud.reset();
+  }
+  requestRedraw();
+}
+
+void PointCloudStream::waitForReads() { reads.wait(); }
+
+void PointCloudStream::refresh() {
+  for (Chunk& chunk : chunks) {
+    if (chunk.cloud) chunk.cloud->refresh();
+  }
+  requestRedraw();
+}
+
+size_t PointCloudStream::nResidentPoints() {
+  size_t count = 0;
+  for (const Chunk& chunk : chunks) {
+    if (chunk.cloud) count += chunk.count;
+  }
+  return count;
+}
+
+size_t PointCloudStream::getGPUMemoryUsage() {
+  size_t bytes = Structure::getGPUMemoryUsage();
+  for (Chunk& chunk : chunks) {
+    if (chunk.cloud) bytes += chunk.cloud->getGPUMemoryUsage();
+  }
+  return bytes;
+}
+
+MemoryUsage PointCloudStream::memoryUsage() {
+  MemoryUsage usage;
+  usage.hostBytes = hostMemoryUsage();
+  usage.deviceBytes = getGPUMemoryUsage();
+  return usage;
+}
+
+size_t PointCloudStream::hostMemoryUsage() {
+  size_t bytes = allocatedBytes(chunks);
+  for (Chunk& chunk : chunks) {
+    if (chunk.cached) {
+      bytes += allocatedBytes(chunk.cached->points);
+      for (const std::vector<double>& s : chunk.cached->scalars) bytes += allocatedBytes(s);
+      for (const std::vector<glm::vec3>& c : chunk.cached->colors) bytes += allocatedBytes(c);
+    }
+    if (chunk.cloud) bytes += chunk.cloud->memoryUsage().hostBytes;
+  }
+  return bytes;
+}
+
+void PointCloudStream::buildCustomUI() {
+  ImGui::Text("# points: %lld (drawing %lld)", static_cast<long long int>(nPoints()),
+              static_cast<long long int>(nResidentPoints()));
+  if (isReading()) {
+    ImGui::SameLine();
+    ImGui::TextUnformatted("reading...");
+  }
+
+  if (ImGui::ColorEdit3("Point color", &pointColor.get()[0], ImGuiColorEditFlags_NoInputs)) {
+    setPointColor(getPointColor());
+  }
+  ImGui::SameLine();
+  ImGui::PushItemWidth(70);
+  if (ImGui::SliderFloat("Radius", pointRadius.get().getValuePtr(), 0.0, .1, "%.5f",
+                         ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_NoRoundToFormat)) {
+    pointRadius.manuallyChanged();
+    setPointRadius(*pointRadius.get().getValuePtr(), pointRadius.get().isRelative());
+  }
+  ImGui::PopItemWidth();
+
+  if (!attributes.empty()) {
+    std::string current = displayedAttribute.get().empty() ? "none" : displayedAttribute.get();
+    if (ImGui::BeginCombo("Color by", current.c_str())) {
+      if (ImGui::Selectable("none", displayedAttribute.get().empty())) setDisplayedAttribute("");
+      for (const Attribute& a : attributes) {
+        if (ImGui::Selectable(a.name.c_str(), a.name == displayedAttribute.get())) setDisplayedAttribute(a.name);
+      }
+      ImGui::EndCombo();
+    }
+  }
+}
+
+PointCloudStream* PointCloudStream::addScalarFile(std::string attributeName, std::string filename, DataType type) {
+  if (fileBytes(filename) != static_cast<long long int>(nPointsCount * sizeof(float))) {
+    error(name + ": scalar file " + filename + " should hold one float32 for each of the " +
+          std::to_string(nPointsCount) + " points");
+    return this;
+  }
+
+  // Find the range of the values, holding one chunk at a time
+  std::pair<double, double> range{std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+  std::ifstream in(filename, std::ios::binary);
+  std::vector<float> buffer;
+  for (const Chunk& chunk : chunks) {
+    buffer.resize(chunk.count);
+    in.read(reinterpret_cast<char*>(buffer.data()), chunk.count * sizeof(float));
+    for (float v : buffer) {
+      range.first = std::min(range.first, static_cast<double>(v));
+      range.second = std::max(range.second, static_cast<double>(v));
+    }
+  }
+  if (type == DataType::SYMMETRIC) {
+    double absMax = std::max(std::abs(range.first), std::abs(range.second));
+    range = {-absMax, absMax};
+  } else if (type == DataType::MAGNITUDE) {
+    range.first = 0.;
+  }
+
+  attributes.erase(std::remove_if(attributes.begin(), attributes.end(),
+                                  [&](const Attribute& a) { return a.name == attributeName; }),
+                   attributes.end());
+  attributes.push_back(Attribute{attributeName, filename, false, type, range});
+  dropChunkData();
+  return this;
+}
+
+PointCloudStream* PointCloudStream::addColorFile(std::string attributeName, std::string filename) {
+  if (fileBytes(filename) != static_cast<long long int>(nPointsCount * sizeof(glm::vec3))) {
+    error(name + ": color file " + filename + " should hold three float32 for each of the " +
+          std::to_string(nPointsCount) + " points");
+    return this;
+  }
+
+  attributes.erase(std::remove_if(attributes.begin(), attributes.end(),
+                                  [&](const Attribute& a) { return a.name == attributeName; }),
+                   attributes.end());
+  attributes.push_back(Attribute{attributeName, filename, true, DataType::STANDARD, {0., 1.}});
+  dropChunkData();
+  return this;
+}
+
+PointCloudStream* PointCloudStream::setDisplayedAttribute(std::string attributeName) {
+  bool found = attributeName.empty();
+  for (const Attribute& a : attributes) {
+    found = found || a.name == attributeName;
+  }
+  if (!found) {
+    error(name + " has no attribute named " + attributeName);
+    return this;
+  }
+
+  displayedAttribute = attributeName;
+  for (Chunk& chunk : chunks) {
+    if (chunk.cloud) applyAppearance(*chunk.cloud);
+  }
+  requestRedraw();
+  return this;
+}
+std::string PointCloudStream::getDisplayedAttribute() { return displayedAttribute.get(); }
+
+PointCloudStream* PointCloudStream::setResidentPointBudget(size_t newVal) {
+  residentPointBudget = newVal;
+  requestRedraw();
+  return this;
+}
+size_t PointCloudStream::getResidentPointBudget() { return residentPointBudget; }
+
+PointCloudStream* PointCloudStream::setCachedPointBudget(size_t newVal) {
+  cachedPointBudget = newVal;
+  requestRedraw();
+  return this;
+}
+size_t PointCloudStream::getCachedPointBudget() { return cachedPointBudget; }
+
+PointCloudStream* PointCloudStream::setPointColor(glm::vec3 newVal) {
+  pointColor = newVal;
+  for (Chunk& chunk : chunks) {
+    if (chunk.cloud) applyAppearance(*chunk.cloud);
+  }
+  requestRedraw();
+  return this;
+}
+glm::vec3 PointCloudStream::getPointColor() { return pointColor.get(); }
+
+PointCloudStream* PointCloudStream::setPointRadius(double newVal, bool isRelative) {
+  pointRadius = ScaledValue<float>(newVal, isRelative);
+  for (Chunk& chunk : chunks) {
+    if (chunk.cloud) applyAppearance(*chunk.cloud);
+  }
+  requestRedraw();
+  return this;
+}
+double PointCloudStream::getPointRadius() { return pointRadius.get().asAbsolute(); }
+
+PointCloudStream* PointCloudStream::setMaterial(std::string m) {
+  material = m;
+  for (Chunk& chunk : chunks) {
+    if (chunk.cloud) applyAppearance(*chunk.cloud);
+  }
+  requestRedraw();
+  return this;
+}
+std::string PointCloudStream::getMaterial() { return material.get(); }
+
+PointCloudStream* registerPointCloudStream(std::string name, std::string positionsFilename, size_t chunkSize) {
+  checkInitialized();
+
+  PointCloudStream* s = new PointCloudStream(name, positionsFilename, chunkSize);
+  bool success = registerStructure(s);
+  if (!success) {
+    safeDelete(s);
+  }
+  return s;
+}
+
+} // namespace polyscope
@@ -15,7 +15,7 @@ PointCloudVectorQuantity::PointCloudVectorQuantity(std::string name, std::vector
                                                    PointCloud& pointCloud_, VectorType vectorType_)
 
     : PointCloudQuantity(name, pointCloud_), vectors(vectors_), vectorType(vectorType_),
-      vectorArtist(new VectorArtist(parent, name + "#vectorartist", parent.points, vectors, vectorType)) {
+      vectorArtist(createVectorArtist()) {
 
   if (vectors.size() != parent.points.size()) {
     polyscope::error("Point cloud vector quantity " + name + " does not have same number of values (" +
@@ -30,10 +30,93 @@ void PointCloudVectorQuantity::draw() {
 }
 
 void PointCloudVectorQuantity::refresh() {
-  vectorArtist.reset(new VectorArtist(parent, name + "#vectorartist", parent.points, vectors, vectorType));
+  vectorArtist.reset(createVectorArtist());
   Quantity::refresh();
 }
 
+void PointCloudVectorQuantity::releaseRenderData() {
+  vectorBuffer.reset();
+  PointCloudQuantity::releaseRenderData();
+}
+
+std::shared_ptr<render::AttributeBuffer> PointCloudVectorQuantity::getVectorRenderBuffer() {
+  if (!vectorBuffer) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    vectorBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    vectorBuffer->setData(vectors);
+  }
+  return vectorBuffer;
+}
+
+void PointCloudVectorQuantity::dataUpdated() {
+  fullMaxLength = -1.;
+  if (vectorBuffer) {
+    vectorBuffer->setData(vectors, true);
+  }
+  if (!parent.drawsLODSubset()) {
+    vectorArtist->vectorsChanged();
+    return;
+  }
+
+  // The artist draws its copy of the subset, which keeps its size unless the subset changed since
+  std::vector<glm::vec3> newLodVectors = parent.lodSubsetValues(vectors);
+  if (newLodVectors.size() != lodVectors.size()) {
+    refresh();
+    return;
+  }
+  lodVectors = std::move(newLodVectors);
+  fullMaxLength = VectorArtist::computeMaxLength(vectors);
+  vectorArtist->vectorsChanged();
+  vectorArtist->setMaxLength(fullMaxLength);
+}
+
+void PointCloudVectorQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& pointRanges) {
+  if (parent.getPositionRenderBuffer() && !vectorArtist->getDecimationEnabled()) {
+    requestRedraw(); // the bases are the cloud's position buffer, which it has already updated
+    return;
+  }
+  refresh();
+}
+
+bool PointCloudVectorQuantity::extendToAppendedPoints() {
+  vectors.resize(parent.nPoints(), glm::vec3{0., 0., 0.});
+  vectorBuffer.reset();
+  refresh();
+  return true;
+}
+
+void PointCloudVectorQuantity::appendValuesImpl(const std::vector<glm::vec3>& newVectors) {
+  std::vector<size_t> slots = appendedValueSlots(newVectors.size());
+  for (size_t i = 0; i < slots.size(); i++) {
+    if (slots[i] == INVALID_IND) continue;
+    vectors[slots[i]] = newVectors[i];
+  }
+  fullMaxLength = -1.;
+  if (vectorBuffer) {
+    vectorBuffer->setData(vectors, true);
+  }
+  refresh();
+  requestRedraw();
+}
+
+VectorArtist* PointCloudVectorQuantity::createVectorArtist() {
+  if (!parent.drawsLODSubset()) {
+    lodBases = std::vector<glm::vec3>();
+    lodVectors = std::vector<glm::vec3>();
+    if (std::shared_ptr<render::AttributeBuffer> bases = parent.getPositionRenderBuffer()) {
+      return new VectorArtist(parent, name + "#vectorartist", bases, vectors, vectorType, &parent.points);
+    }
+    return new VectorArtist(parent, name + "#vectorartist", parent.points, vectors, vectorType);
+  }
+
+  lodBases = parent.lodSubsetValues(parent.points);
+  lodVectors = parent.lodSubsetValues(vectors);
+  if (fullMaxLength < 0.) fullMaxLength = VectorArtist::computeMaxLength(vectors);
+  VectorArtist* artist = new VectorArtist(parent, name + "#vectorartist", lodBases, lodVectors, vectorType);
+  artist->setMaxLength(fullMaxLength);
+  return artist;
+}
+
 void PointCloudVectorQuantity::buildCustomUI() {
   ImGui::SameLine();
   vectorArtist->buildParametersUI();
@@ -75,6 +158,22 @@ PointCloudVectorQuantity* PointCloudVectorQuantity::setMaterial(std::string m) {
 }
 std::string PointCloudVectorQuantity::getMaterial() { return vectorArtist->getMaterial(); }
 
+PointCloudVectorQuantity* PointCloudVectorQuantity::setDecimationEnabled(bool newVal) {
+  vectorArtist->setDecimationEnabled(newVal);
+  return this;
+}
+bool PointCloudVectorQuantity::getDecimationEnabled() { return vectorArtist->getDecimationEnabled(); }
+PointCloudVectorQuantity* PointCloudVectorQuantity::setDecimationSpacing(double pixels) {
+  vectorArtist->setDecimationSpacing(pixels);
+  return this;
+}
+double PointCloudVectorQuantity::getDecimationSpacing() { return vectorArtist->getDecimationSpacing(); }
+size_t PointCloudVectorQuantity::getNumVectorsDrawn() { return vectorArtist->getNumVectorsDrawn(); }
+
 std::string PointCloudVectorQuantity::niceName() { return name + " (vector)"; }
 
+size_t PointCloudVectorQuantity::hostMemoryUsage() {
+  return allocatedBytes(vectors) + allocatedBytes(lodBases) + allocatedBytes(lodVectors);
+}
+
 } // namespace polyscope
@@ -1,15 +1,22 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/polyscope.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <chrono>
 #include <fstream>
 #include <iostream>
 #include <thread>
+#include <tuple>
 
 #include "imgui.h"
 
+#include "polyscope/internal.h"
+#include "polyscope/parallel.h"
 #include "polyscope/pick.h"
 #include "polyscope/render/engine.h"
+#include "polyscope/scratch_vector.h"
 #include "polyscope/view.h"
 
 #include "stb_image.h"
@@ -37,6 +44,7 @@ struct ContextEntry {
 std::vector<ContextEntry> contextStack;
 
 bool redrawNextFrame = true;
+bool structureExtentsRequested = false; // a recompute is queued for the next frame, see requestStructureExtentsUpdate()
 
 // Some state about imgui windows to stack them
 float imguiStackMargin = 10;
@@ -129,17 +137,30 @@ void init(std::string backend) {
   }
 
   state::backend = backend;
+  profiling::beginStartup();
+  ScopedStartupPhase startupTimer("init");
 
   if (options::usePrefsFile) {
+    ScopedStartupPhase prefsTimer("readPrefsFile");
     readPrefsFile();
   }
 
   // Initialize the rendering engine
-  render::initializeRenderEngine(backend);
+  {
+    ScopedStartupPhase engineTimer("window and context"); // (the phases inside are timed on their own)
+    render::initializeRenderEngine(backend);
+  }
+  if (!options::shaderWarmupProfile.empty() && std::ifstream(options::shaderWarmupProfile).good()) {
+    ScopedStartupPhase warmupTimer("loadShaderWarmupProfile");
+    render::engine->loadShaderWarmupProfile(options::shaderWarmupProfile);
+  }
 
   // Initialie ImGUI
   IMGUI_CHECKVERSION();
-  render::engine->initializeImGui();
+  {
+    ScopedStartupPhase imguiTimer("initializeImGui");
+    render::engine->initializeImGui();
+  }
   // push a fake context which will never be used (but dodges some invalidation issues)
   contextStack.push_back(ContextEntry{ImGui::GetCurrentContext(), nullptr, false});
 
@@ -223,33 +244,136 @@ ImGuiContext* getCurrentContext()
   return contextStack.empty() ? nullptr : contextStack.back().context;
 }
 
-void requestRedraw() { redrawNextFrame = true; }
+void requestRedraw() {
+  redrawNextFrame = true;
+  state::redrawRequestCount++;
+}
 bool redrawRequested() { return redrawNextFrame; }
 
-void drawStructures() {
+namespace {
 
-  // Draw all off the structures registered with polyscope
+// Whether structures found occluded are skipped; only set for the main opaque pass, not for reflections etc
+bool cullOccludedStructures = false;
+
+// Which structures are drawn, by transparency; depth peeling draws the opaque ones once, ahead of the peeled passes
+enum class OpacityFilter { Any, Opaque, Transparent };
+OpacityFilter drawOpacity = OpacityFilter::Any;
+
+bool passesOpacityFilter(Structure* s) {
+  switch (drawOpacity) {
+  case OpacityFilter::Any:
+    return true;
+  case OpacityFilter::Opaque:
+    return s->getTransparency() >= 1.;
+  case OpacityFilter::Transparent:
+    return s->getTransparency() < 1.;
+  }
+  return true;
+}
+
+// Draw the structures with and/or without a static hint. Slice plane geometry goes with the dynamic ones.
+void drawStructureSubset(bool drawStatic, bool drawDynamic) {
+
+  std::vector<std::pair<std::string, Structure*>> batch;
+  Viewport* viewport = getActiveViewport();
+  beginGroupCullingPass(); // (groups are tested against the view once each, for all of their structures)
+  for (auto& catMap : state::structures) {
+
+    // Group the structures of this type which share a batch key, so the engine can skip re-binding their state
+    batch.clear();
+    for (auto& s : catMap.second) {
+      if (!(s.second->getStaticHint() ? drawStatic : drawDynamic)) continue;
+      if (!passesOpacityFilter(s.second)) continue;
+      if (render::engine->depthPrepassStage == render::Engine::DepthPrepassStage::DepthOnly &&
+          !s.second->drawsInDepthPrepass()) {
+        continue;
+      }
+      if (viewport != nullptr && !viewport->isStructureVisible(s.second)) continue;
+      Group* group = s.second->getParentGroup();
+      if (group != nullptr && group->isHiddenInPass()) continue;
+      if (s.second->isEnabled() && group != nullptr &&
+          (group->isCulledInPass() ||
+           (cullOccludedStructures && !s.second->getStaticHint() && group->isOccluded()))) {
+        render::engine->renderStats.structuresCulled++;
+        continue;
+      }
+      if (s.second->isEnabled() &&
+          (!s.second->isInViewFrustum() || (cullOccludedStructures && s.second->isOccluded()))) {
+        render::engine->renderStats.structuresCulled++;
+        continue;
+      }
+      batch.emplace_back(s.second->drawBatchKey(), s.second);
+    }
+    std::stable_sort(batch.begin(), batch.end(),
+                     [](const std::pair<std::string, Structure*>& a, const std::pair<std::string, Structure*>& b) {
+                       return a.first < b.first;
+                     });
+
+    for (auto& entry : batch) {
+      Structure* s = entry.second;
 
-  for (auto catMap : state::structures) {
-    for (auto s : catMap.second) {
       // make sure the right settings are active
       // render::engine->setDepthMode();
       // render::engine->applyTransparencySettings();
 
-      s.second->draw();
+      render::ScopedGPUTimer timer(s->profilingName());
+      render::ScopedPipelineStatistics pipelineStatistics(s->profilingName());
+      render::ScopedGPUMemoryAccount account(s->gpuMemory);
+      s->draw();
     }
   }
 
   // Also render any slice plane geometry
-  for (SlicePlane* s : state::slicePlanes) {
-    s->drawGeometry();
+  // (their programs write no G-buffer, so with deferred shading they are drawn after the resolve instead)
+  if (drawDynamic && drawOpacity != OpacityFilter::Opaque &&
+      render::engine->depthPrepassStage != render::Engine::DepthPrepassStage::DepthOnly &&
+      !render::engine->deferredShadingPass) {
+    for (SlicePlane* s : state::slicePlanes) {
+      s->drawGeometry();
+    }
   }
 }
 
+} // namespace
+
+void drawStructures() {
+  // Draw all off the structures registered with polyscope
+  drawStructureSubset(true, true);
+}
+
 namespace {
 
 float dragDistSinceLastRelease = 0.0;
 
+Viewport* viewportAtWindowPos(ImVec2 pos) {
+  return getViewportAt(glm::vec2{pos.x / view::windowWidth, pos.y / view::windowHeight});
+}
+
+// Free the render data of disabled quantities, according to options::gpuReleaseIdleSeconds and
+// options::gpuMemoryBudget. The longest-disabled quantities go first; anything released is rebuilt when re-enabled.
+void releaseIdleRenderData() {
+  if (options::gpuReleaseIdleSeconds < 0. && options::gpuMemoryBudget < 0) return;
+
+  double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  std::vector<IdleQuantity> idle;
+  for (auto& cat : state::structures) {
+    for (auto& s : cat.second) {
+      s.second->collectIdleQuantities(now, idle);
+    }
+  }
+  std::sort(idle.begin(), idle.end(),
+            [](const IdleQuantity& a, const IdleQuantity& b) { return a.disabledSince < b.disabledSince; });
+
+  for (IdleQuantity& q : idle) {
+    bool expired = options::gpuReleaseIdleSeconds >= 0. && now - q.disabledSince >= options::gpuReleaseIdleSeconds;
+    bool overBudget = options::gpuMemoryBudget >= 0 &&
+                      render::engine->gpuMemoryUsage > static_cast<size_t>(options::gpuMemoryBudget);
+    if (expired || overBudget) {
+      q.release();
+    }
+  }
+}
+
 void processInputEvents() {
   ImGuiIO& io = ImGui::GetIO();
 
@@ -282,15 +406,18 @@ void processInputEvents() {
           maxScroll = yoffset;
         }
 
-        // Pass camera commands to the camera
+        // Pass camera commands to the camera (of the viewport under the mouse, if there are viewports)
         if (maxScroll != 0.0) {
           bool scrollClipPlane = io.KeyShift;
 
+          Viewport* viewport = viewportAtWindowPos(io.MousePos);
+          if (viewport) viewport->activate();
           if (scrollClipPlane) {
             view::processClipPlaneShift(maxScroll);
           } else {
             view::processZoom(maxScroll);
           }
+          if (viewport) viewport->deactivate();
         }
       }
     }
@@ -312,6 +439,9 @@ void processInputEvents() {
         bool isTranslate = (dragLeft && io.KeyShift && !io.KeyCtrl) || dragRight;
         bool isDragZoom = dragLeft && io.KeyShift && io.KeyCtrl;
 
+        // (with viewports, drags move the camera of the one under the mouse)
+        Viewport* viewport = viewportAtWindowPos(io.MousePos);
+        if (viewport) viewport->activate();
         if (isDragZoom) {
           view::processZoom(dragDelta.y * 5);
         }
@@ -326,6 +456,7 @@ void processInputEvents() {
         if (isTranslate) {
           view::processTranslate(dragDelta);
         }
+        if (viewport) viewport->deactivate();
       }
 
       // Click picks
@@ -335,9 +466,8 @@ void processInputEvents() {
         // Don't pick at the end of a long drag
         if (dragDistSinceLastRelease < dragIgnoreThreshold) {
           ImVec2 p = ImGui::GetMousePos();
-          std::pair<Structure*, size_t> pickResult =
-              pick::evaluatePickQuery(io.DisplayFramebufferScale.x * p.x, io.DisplayFramebufferScale.y * p.y);
-          pick::setSelection(pickResult);
+          pick::evaluatePickQueryAsync(io.DisplayFramebufferScale.x * p.x, io.DisplayFramebufferScale.y * p.y,
+                                       pick::setSelection);
         }
 
         // Reset the drag distance after any release
@@ -377,14 +507,187 @@ void renderSlicePlanes() {
   }
 }
 
+// Everything other than the structures themselves which affects the contents of the static layer. The buffer size
+// is not included, since resizing invalidates the layer anyway.
+typedef std::tuple<glm::mat4, glm::mat4, std::vector<std::pair<Structure*, glm::mat4>>,
+                   std::vector<std::pair<bool, glm::mat4>>>
+    StaticLayerKey;
+StaticLayerKey staticLayerKey;
+
+StaticLayerKey currentStaticLayerKey() {
+  std::vector<std::pair<Structure*, glm::mat4>> staticStructures;
+  for (auto& catMap : state::structures) {
+    for (auto& s : catMap.second) {
+      if (s.second->getStaticHint() && s.second->isEnabled() && s.second->isVisibleInGroups()) {
+        staticStructures.emplace_back(s.second, s.second->getTransform());
+      }
+    }
+  }
+  std::vector<std::pair<bool, glm::mat4>> planes;
+  for (SlicePlane* s : state::slicePlanes) {
+    planes.emplace_back(s->getActive(), s->getTransform());
+  }
+  return StaticLayerKey{view::getCameraViewMatrix(), view::getCameraPerspectiveMatrix(), staticStructures, planes};
+}
+
+// Fill the scene buffer with the static structures, from the cached layer if it is still valid. Returns false if
+// there are no static structures, in which case nothing is done.
+bool drawStaticLayer() {
+  StaticLayerKey key = currentStaticLayerKey();
+  if (std::get<2>(key).empty()) return false;
+  if (render::engine->multisampleActive()) return false; // (can't be blitted in to a multisampled buffer)
+  if (haveViewports()) return false;                      // (the layer holds a single view)
+
+  render::ScopedGPUTimer timer("static layer");
+  if (render::engine->staticLayerValid && key == staticLayerKey) {
+    render::engine->staticLayerBuffer->blitColorAndDepthTo(render::engine->sceneBuffer.get());
+  } else {
+    drawStructureSubset(true, false);
+    render::engine->sceneBuffer->blitColorAndDepthTo(render::engine->staticLayerBuffer.get());
+    staticLayerKey = key;
+    render::engine->staticLayerValid = true;
+  }
+  render::engine->bindSceneBuffer();
+  render::engine->applyTransparencySettings();
+  return true;
+}
+
+// For depth peeling, draw the opaque structures in to the static layer buffer. Returns false if there are none, or
+// nothing is transparent (then a layer saves no work), in which case every pass draws every structure as usual.
+bool drawOpaqueLayer() {
+  bool haveOpaque = false;
+  bool haveTransparent = false;
+  for (auto& catMap : state::structures) {
+    for (auto& s : catMap.second) {
+      if (!s.second->isEnabled()) continue;
+      (s.second->getTransparency() < 1. ? haveTransparent : haveOpaque) = true;
+    }
+  }
+  if (!haveOpaque || !haveTransparent) return false;
+
+  render::ScopedGPUTimer timer("opaque layer");
+  render::engine->invalidateStaticLayer();
+  render::engine->bindSceneBuffer();
+  render::engine->clearSceneBuffer();
+  drawOpacity = OpacityFilter::Opaque;
+  forEachViewport([&]() {
+    render::engine->bindSceneBuffer();
+    render::engine->applyTransparencySettings();
+    drawStructures();
+  });
+  drawOpacity = OpacityFilter::Any;
+  render::engine->sceneBuffer->blitColorAndDepthTo(render::engine->staticLayerBuffer.get());
+  return true;
+}
+
+// Draw only the depth of the structures made of impostors, and keep it for the shading pass to test against (see
+// options::impostorDepthPrepass). Returns false if the prepass is off or can't be used, in which case nothing is done.
+// The main pass then draws with DepthPrepassStage::Shade, but not the reflections etc, which see a different view.
+bool drawImpostorDepthPrepass() {
+  if (!render::engine->impostorDepthPrepassEnabled()) return false;
+  if (render::engine->getTransparencyMode() != TransparencyMode::None) return false;
+  if (render::engine->multisampleActive()) return false; // (the depth copy reads the single-sampled buffer)
+
+  render::ScopedGPUTimer timer("impostor depth prepass");
+  render::engine->depthPrepassStage = render::Engine::DepthPrepassStage::DepthOnly;
+  render::engine->setColorMask({false, false, false, false});
+  forEachViewport([&]() {
+    render::engine->bindSceneBuffer();
+    render::engine->applyTransparencySettings();
+    drawStructures();
+  });
+  render::engine->setColorMask();
+
+  // Copy the depth to the texture the programs read it from (free without transparency, which uses it for peeling),
+  // and start the shading pass from a clear buffer
+  render::engine->setDepthMode(); // (depth writes must be on for the clear)
+  render::engine->sceneDepthMinFrame->clear();
+  render::engine->updateMinDepthTexture();
+  render::engine->bindSceneBuffer();
+  render::engine->clearSceneBuffer();
+  render::engine->applyTransparencySettings();
+  render::engine->depthPrepassStage = render::Engine::DepthPrepassStage::None;
+  return true;
+}
+
+// Test each structure's bounding box against the depth of the scene drawn so far, to cull it in a later frame
+void testStructureOcclusion() {
+  render::ScopedGPUTimer timer("occlusion tests");
+  for (auto& catMap : state::structures) {
+    for (auto& s : catMap.second) {
+      s.second->testOcclusion();
+    }
+  }
+  testGroupOcclusion();
+  render::engine->applyTransparencySettings();
+}
+
+void resetStructureOcclusion() {
+  for (auto& catMap : state::structures) {
+    for (auto& s : catMap.second) {
+      s.second->resetOcclusion();
+    }
+  }
+  resetGroupOcclusion();
+}
+
+// Read back the occlusion tests which have finished. Tests are only started when the scene is drawn, so this is what
+// brings in a hidden structure after the last frame, rather than the next change of the scene.
+void collectStructureOcclusion() {
+  for (auto& catMap : state::structures) {
+    for (auto& s : catMap.second) {
+      s.second->collectOcclusionTest();
+    }
+  }
+  collectGroupOcclusion();
+}
+
+// Whether a structure or group is hidden by an occlusion test while a newer one is in flight, which could show it again
+bool haveOutstandingOcclusionTests() {
+  for (auto& catMap : state::structures) {
+    for (auto& s : catMap.second) {
+      if (s.second->hasOutstandingOcclusionTest()) return true;
+    }
+  }
+  return haveOutstandingGroupOcclusionTests();
+}
+
+// Read back the tests of the last depth peeling passes once all have arrived (see Engine::transparencyPassLimit). If
+// every pass drew, there may be more layers than were drawn, so the limit is lifted, and the scene redrawn if the limit
+// is what stopped the passes.
+void collectTransparencyPassTests() {
+  int nTested = render::engine->transparencyPassesTested;
+  std::vector<std::shared_ptr<render::OcclusionQuery>>& queries = render::engine->transparencyPassQueries;
+  if (nTested == 0) return;
+  for (int iPass = 0; iPass < nTested; iPass++) {
+    if (!queries[iPass]->isReady()) return;
+  }
+
+  int nDrew = 0;
+  while (nDrew < nTested && queries[nDrew]->anySamplesPassed()) nDrew++;
+  int& limit = render::engine->transparencyPassLimit;
+  if (nDrew == nTested) {
+    if (limit != -1 && limit <= nTested) requestRedraw();
+    limit = -1;
+  } else {
+    limit = nDrew + 1;
+  }
+  render::engine->transparencyPassesTested = 0;
+}
+
 void renderScene() {
   processLazyProperties();
+  state::sceneRenderCount++;
+
+  ScopedCPUTimer cpuTimer("renderScene");
+  render::ScopedGPUTimer timer("scene");
 
   render::engine->applyTransparencySettings();
+  render::engine->updateSceneColorFormat();
 
   render::engine->sceneBuffer->clearColor = {0., 0., 0.};
   render::engine->sceneBuffer->clearAlpha = 0.;
-  render::engine->sceneBuffer->clear();
+  render::engine->clearSceneBuffer();
 
   if (!render::engine->bindSceneBuffer()) return;
 
@@ -402,26 +705,75 @@ void renderScene() {
     render::engine->sceneBufferFinal->clearColor = glm::vec3{0., 0., 0.};
     render::engine->sceneBufferFinal->clearAlpha = 0;
     render::engine->sceneBufferFinal->clear();
+    resetStructureOcclusion();
 
     render::engine->setDepthMode(); // we need depth to be enabled for the clear below to do anything
     render::engine->sceneDepthMinFrame->clear();
 
 
-    for (int iPass = 0; iPass < options::transparencyRenderPasses; iPass++) {
+    // Opaque structures are drawn once, in to a layer which starts each peeled pass. Only the transparent structures
+    // are drawn again in every pass, depth-tested against it. An opaque pixel which shows up in several layers adds
+    // nothing after the first, since the layers are composited front to back. (The static layer buffer is not used by
+    // this mode, so it holds the opaque layer.)
+    bool haveOpaqueLayer = drawOpaqueLayer();
+    if (haveOpaqueLayer) drawOpacity = OpacityFilter::Transparent;
+
+    render::engine->transparencyPassesUsed = 0;
+    int nPasses = render::engine->interactiveQuality ? 1 : options::transparencyRenderPasses;
+
+    // In adaptive mode, stop one pass past the last which drew anything in an earlier frame, and test each pass for
+    // whether it drew anything. If nothing did, every deeper layer is empty too. (Only once the tests of earlier passes
+    // have been read back, which keeps them from waiting on the GPU.) Screenshots always draw every pass, since they
+    // have no later frame to catch up in.
+    bool testPasses = false;
+    if (options::transparencyAdaptivePasses) {
+      collectTransparencyPassTests();
+      int limit = render::engine->transparencyPassLimit;
+      if (limit != -1 && !internal::finishBackgroundFills) nPasses = std::min(nPasses, limit);
+      testPasses = render::engine->transparencyPassesTested == 0;
+    } else {
+      render::engine->transparencyPassLimit = -1;
+    }
+    for (int iPass = 0; iPass < nPasses; iPass++) {
+      render::ScopedGPUTimer passTimer("transparency pass", iPass);
 
       render::engine->bindSceneBuffer();
-      render::engine->clearSceneBuffer();
+      if (haveOpaqueLayer) {
+        render::engine->staticLayerBuffer->blitColorAndDepthTo(render::engine->sceneBuffer.get());
+      } else {
+        render::engine->clearSceneBuffer();
+      }
 
-      render::engine->applyTransparencySettings();
-      drawStructures();
+      std::vector<std::shared_ptr<render::OcclusionQuery>>& passQueries = render::engine->transparencyPassQueries;
+      if (testPasses) {
+        if (passQueries.size() <= static_cast<size_t>(iPass)) {
+          passQueries.push_back(render::engine->generateOcclusionQuery());
+        }
+        passQueries[iPass]->begin();
+      }
 
-      // Draw ground plane, slicers, etc
       bool isRedraw = iPass > 0;
-      render::engine->groundPlane.draw(isRedraw);
-      if (!isRedraw) {
-        // Only on first pass (kinda weird, but works out, and doesn't really matter)
-        renderSlicePlanes();
+      forEachViewport([&]() {
+        render::engine->bindSceneBuffer();
+        render::engine->applyTransparencySettings();
+        drawStructures();
+
+        // Draw ground plane, slicers, etc
+        {
+          render::ScopedGPUTimer groundPlaneTimer("ground plane");
+          render::engine->groundPlane.draw(isRedraw);
+        }
+        if (!isRedraw) {
+          // Only on first pass (kinda weird, but works out, and doesn't really matter)
+          renderSlicePlanes();
+        }
+      });
+
+      if (testPasses) {
+        passQueries[iPass]->end();
+        render::engine->transparencyPassesTested = iPass + 1;
       }
+      render::engine->transparencyPassesUsed++;
 
       // Composite the result of this pass in to the result buffer
       render::engine->sceneBufferFinal->bind();
@@ -432,34 +784,202 @@ void renderScene() {
       // Update the minimum depth texture
       render::engine->updateMinDepthTexture();
     }
+    drawOpacity = OpacityFilter::Any;
 
 
-  } else {
-    // Normal case: single render pass
-    render::engine->applyTransparencySettings();
+  } else if (render::engine->getTransparencyMode() == TransparencyMode::WeightedBlended) {
+    // Weighted-blended case: a single pass accumulates all structures in to a separate buffer, which is resolved over
+    // the ground plane etc in the usual scene buffer.
 
-    drawStructures();
+    render::engine->sceneBufferWeighted->clear();
+    resetStructureOcclusion();
+    if (!render::engine->bindWeightedTransparencyBuffer()) return;
+
+    forEachViewport([&]() {
+      render::engine->bindWeightedTransparencyBuffer();
+      render::engine->applyTransparencySettings();
+      drawStructures();
+    });
 
-    render::engine->groundPlane.draw();
-    renderSlicePlanes();
+    forEachViewport([&]() {
+      render::engine->bindSceneBuffer();
+      {
+        render::ScopedGPUTimer groundPlaneTimer("ground plane");
+        render::engine->groundPlane.draw();
+      }
+      renderSlicePlanes();
+    });
+
+    {
+      render::ScopedGPUTimer resolveTimer("weighted transparency resolve");
+      render::engine->resolveWeightedTransparency();
+    }
 
     render::engine->sceneBuffer->blitTo(render::engine->sceneBufferFinal.get());
+
+  } else if (render::engine->deferredShadingActive()) {
+    // Deferred case: structures write their unlit color and normal to a G-buffer which shares the scene depth, the
+    // G-buffer is lit in to the scene buffer, and then the ground plane etc are drawn over it as usual.
+
+    resetStructureOcclusion();
+    render::engine->sceneBufferDeferred->clear();
+    if (!render::engine->bindDeferredBuffer()) return;
+
+    render::engine->deferredShadingPass = true;
+    forEachViewport([&]() {
+      render::engine->bindDeferredBuffer();
+      render::engine->applyTransparencySettings();
+      drawStructures();
+    });
+    render::engine->deferredShadingPass = false;
+
+    {
+      render::ScopedGPUTimer resolveTimer("deferred shading resolve");
+      render::engine->resolveDeferredShading();
+    }
+
+    forEachViewport([&]() {
+      render::engine->bindSceneBuffer();
+      render::engine->applyTransparencySettings();
+      for (SlicePlane* s : state::slicePlanes) {
+        s->drawGeometry();
+      }
+      {
+        render::ScopedGPUTimer groundPlaneTimer("ground plane");
+        render::engine->groundPlane.draw();
+      }
+      renderSlicePlanes();
+    });
+
+    render::engine->resolveSceneBuffer();
+
+  } else {
+    // Normal case: single render pass
+    render::engine->applyTransparencySettings();
+    bool depthPrepass = drawImpostorDepthPrepass();
+    // (with simple transparency, structures in front do not hide those behind)
+    bool occlusionCulling = options::enableOcclusionCulling && !haveViewports() &&
+                            render::engine->getTransparencyMode() == TransparencyMode::None;
+
+    // Structures with a static hint come from a cached layer, and the others are depth-tested against it
+    if (drawStaticLayer()) {
+      cullOccludedStructures = occlusionCulling;
+      if (depthPrepass) render::engine->depthPrepassStage = render::Engine::DepthPrepassStage::Shade;
+      drawStructureSubset(false, true);
+      render::engine->depthPrepassStage = render::Engine::DepthPrepassStage::None;
+      cullOccludedStructures = false;
+      if (occlusionCulling) testStructureOcclusion();
+      {
+        render::ScopedGPUTimer groundPlaneTimer("ground plane");
+        render::engine->groundPlane.draw();
+      }
+      renderSlicePlanes();
+    } else {
+      forEachViewport([&]() {
+        render::engine->bindSceneBuffer();
+        render::engine->applyTransparencySettings();
+        cullOccludedStructures = occlusionCulling;
+        if (depthPrepass) render::engine->depthPrepassStage = render::Engine::DepthPrepassStage::Shade;
+        drawStructures();
+        render::engine->depthPrepassStage = render::Engine::DepthPrepassStage::None;
+        cullOccludedStructures = false;
+        if (occlusionCulling) testStructureOcclusion();
+        {
+          render::ScopedGPUTimer groundPlaneTimer("ground plane");
+          render::engine->groundPlane.draw();
+        }
+        renderSlicePlanes();
+      });
+    }
+    if (!occlusionCulling) resetStructureOcclusion();
+
+    render::engine->resolveSceneBuffer();
   }
 } // namespace
 
-void renderSceneToScreen() {
+void renderSceneToScreen(bool sceneWasRendered) {
+  ScopedCPUTimer timer("renderSceneToScreen");
   render::engine->bindDisplay();
   if (options::debugDrawPickBuffer) {
     // special debug draw
     pick::evaluatePickQuery(-1, -1); // populate the buffer
     render::engine->pickFramebuffer->blitTo(render::engine->displayBuffer.get());
   } else {
-    render::engine->applyLightingTransform(render::engine->sceneColorFinal);
+    render::ScopedGPUTimer timer("lighting and resolve");
+    render::engine->resolveSceneToDisplay(sceneWasRendered);
   }
 }
 
 auto lastMainLoopIterTime = std::chrono::steady_clock::now();
 
+// Frames left to draw before the main loop may idle again (options::enableIdleMode). Anything which changes the scene
+// or wakes the loop sets this, since ImGui takes a frame or two to settle after input.
+int framesBeforeIdle = 0;
+const int framesAfterActivity = 3;
+
+// When the scene last changed, for options::progressiveRendering
+auto lastSceneChangeTime = std::chrono::steady_clock::now();
+
+// Pick the settings for this frame's scene render (see options::progressiveRendering). Returns true if the scene should
+// be rendered even though it has not changed, because the full-quality frame is due.
+bool updateProgressiveQuality(bool sceneChanged) {
+  auto now = std::chrono::steady_clock::now();
+
+  // Screenshots are always full quality. Leaving the cheap settings for one renders the scene again (a screenshot would
+  // otherwise reuse the cheap render), and drops the cached display, so the full render is what is shown afterwards too.
+  if (!options::progressiveRendering || render::engine->useAltDisplayBuffer) {
+    bool wasInteractive = render::engine->interactiveQuality;
+    render::engine->setInteractiveQuality(false);
+    return wasInteractive;
+  }
+
+  if (sceneChanged) {
+    lastSceneChangeTime = now;
+    render::engine->setInteractiveQuality(true);
+    return false;
+  }
+  double stillFor = std::chrono::duration<double>(now - lastSceneChangeTime).count();
+  if (render::engine->interactiveQuality && stillFor >= options::progressiveRenderingDelay) {
+    render::engine->setInteractiveQuality(false);
+    return true;
+  }
+  return false;
+}
+
+// state::backgroundCallback, one run at a time
+std::unique_ptr<JobQueue> backgroundCallbackJobs;
+std::atomic<bool> backgroundCallbackRunning{false};
+
+void startBackgroundCallback() {
+  if (!state::backgroundCallback || backgroundCallbackRunning.load()) return;
+  if (!backgroundCallbackJobs) backgroundCallbackJobs.reset(new JobQueue(1));
+  backgroundCallbackRunning = true;
+  std::function<void()> callback = state::backgroundCallback;
+  backgroundCallbackJobs->push([callback]() {
+    try {
+      callback();
+    } catch (const std::exception& e) {
+      std::string message = e.what();
+      queueCommand([message]() { error("background callback threw: " + message); });
+    }
+    backgroundCallbackRunning = false;
+  });
+}
+
+void finishBackgroundCallback() {
+  if (backgroundCallbackJobs) backgroundCallbackJobs->wait();
+}
+
+bool canIdle() {
+  // (not while a background callback runs, so that what it publishes is drawn right away)
+  return options::enableIdleMode && framesBeforeIdle == 0 && !redrawNextFrame && !options::alwaysRedraw &&
+         !backgroundCallbackRunning.load() &&
+         !view::midflight && !isPlayingCameraPath() && !pick::haveAsyncPickQueries() && !haveQueuedScreenshots() &&
+         !isRecording() && !render::engine->temporalAccumulationPending() && !render::engine->interactiveQuality &&
+         render::engine->shaderWarmupPending() == 0 && !haveOutstandingOcclusionTests() &&
+         render::engine->transparencyPassesTested == 0;
+}
+
 } // namespace
 
 void buildPolyscopeGui() {
@@ -552,6 +1072,31 @@ void buildPolyscopeGui() {
     ImGui::TreePop();
   }
 
+  profiling::buildFrameStatsGui();
+
+  // Memory summary
+  ImGui::SetNextTreeNodeOpen(false, ImGuiCond_FirstUseEver);
+  if (ImGui::TreeNode("Memory")) {
+    MemoryUsage total;
+    for (auto& cat : state::structures) {
+      for (auto& x : cat.second) {
+        MemoryUsage usage = x.second->memoryUsage();
+        total += usage;
+        ImGui::Text("%s: %s host, %s GPU", x.first.c_str(), prettyPrintBytes(usage.hostBytes).c_str(),
+                    prettyPrintBytes(usage.deviceBytes).c_str());
+      }
+    }
+    ImGui::Separator();
+    ImGui::Text("Structures: %s host, %s GPU", prettyPrintBytes(total.hostBytes).c_str(),
+                prettyPrintBytes(total.deviceBytes).c_str());
+    // (the engine total also covers framebuffers and other shared render data)
+    ImGui::Text("All GPU allocations: %s", prettyPrintBytes(render::engine->gpuMemoryUsage).c_str());
+    ScratchMemoryStats scratch = getScratchMemoryStats();
+    ImGui::Text("Fill scratch: %s (peak %s)", prettyPrintBytes(scratch.currentBytes).c_str(),
+                prettyPrintBytes(scratch.peakBytes).c_str());
+    ImGui::TreePop();
+  }
+
   // fps
   ImGui::Text("%.1f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
@@ -562,6 +1107,8 @@ void buildPolyscopeGui() {
 }
 
 void buildStructureGui() {
+  ScopedCPUTimer timer("buildStructureGui");
+
   // Create window
   static bool showStructureWindow = true;
 
@@ -571,27 +1118,59 @@ void buildStructureGui() {
 
   ImGui::Begin("Structures", &showStructureWindow);
 
-  for (auto catMapEntry : state::structures) {
-    std::string catName = catMapEntry.first;
+  // With many structures, a box to show only those whose names contain some text (ignoring case)
+  static char filterBuffer[128] = "";
+  size_t nStructures = 0;
+  for (const auto& catMapEntry : state::structures) {
+    nStructures += catMapEntry.second.size();
+  }
+  std::string filter;
+  if (nStructures > 8) {
+    ImGui::InputText("Filter", filterBuffer, sizeof(filterBuffer));
+    filter = filterBuffer;
+    std::transform(filter.begin(), filter.end(), filter.begin(), ::tolower);
+  }
+
+  buildGroupsGui();
 
-    std::map<std::string, Structure*>& structureMap = catMapEntry.second;
+  static std::vector<Structure*> rows; // reused each frame
+  for (const auto& catMapEntry : state::structures) {
+    const std::string& catName = catMapEntry.first;
+    const std::map<std::string, Structure*>& structureMap = catMapEntry.second;
+
+    rows.clear();
+    for (const auto& x : structureMap) {
+      if (!filter.empty()) {
+        std::string lowerName = x.first;
+        std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
+        if (lowerName.find(filter) == std::string::npos) continue;
+      }
+      rows.push_back(x.second);
+    }
 
     ImGui::PushID(catName.c_str()); // ensure there are no conflicts with
                                     // identically-named labels
 
     // Build the structure's UI
+    std::string header = catName + " (" + std::to_string(structureMap.size()) + ")";
+    if (rows.size() != structureMap.size()) {
+      header = catName + " (" + std::to_string(rows.size()) + " of " + std::to_string(structureMap.size()) + ")";
+    }
     ImGui::SetNextTreeNodeOpen(structureMap.size() > 0, ImGuiCond_FirstUseEver);
-    if (ImGui::CollapsingHeader((catName + " (" + std::to_string(structureMap.size()) + ")").c_str())) {
+    if (ImGui::CollapsingHeader((header + "###" + catName).c_str())) {
       // Draw shared GUI elements for all instances of the structure
       if (structureMap.size() > 0) {
         structureMap.begin()->second->buildSharedStructureUI();
       }
 
-      for (auto x : structureMap) {
-        ImGui::SetNextTreeNodeOpen(structureMap.size() <= 8,
-                                   ImGuiCond_FirstUseEver); // closed by default if more than 8
-        x.second->buildUI();
-      }
+      // (only the rows in view are built, see buildTreeNodeRows())
+      bool openByDefault = structureMap.size() <= 8; // closed by default if more than 8
+      internal::buildTreeNodeRows(
+          rows.size(), [&](size_t i) { return rows[i]->uiTreeOpen; },
+          [&](size_t i) {
+            ImGui::SetNextTreeNodeOpen(openByDefault, ImGuiCond_FirstUseEver);
+            rows[i]->buildUI();
+          });
     }
 
     ImGui::PopID();
@@ -622,6 +1201,7 @@ void buildPickGui() {
 }
 
 void buildUserGuiAndInvokeCallback() {
+  ScopedCPUTimer timer("buildUserGuiAndInvokeCallback");
 
   if (!options::invokeUserCallbackForNestedShow && contextStack.size() > 2) {
     return;
@@ -654,10 +1234,15 @@ void buildUserGuiAndInvokeCallback() {
 }
 
 void draw(bool withUI, bool withContextCallback) {
+  ScopedStartupPhase startupTimer("first frame", true); // (only times the first)
   processLazyProperties();
 
   // Update buffer and context
   render::engine->makeContextCurrent();
+  render::engine->applyScheduledScreenBufferResize(!withUI);
+  render::engine->startGPUTimerFrame();
+  render::engine->startPipelineStatisticsFrame();
+  render::engine->processPendingReductions();
   render::engine->bindDisplay();
   render::engine->setBackgroundColor({view::bgColor[0], view::bgColor[1], view::bgColor[2]});
   render::engine->setBackgroundAlpha(view::bgColor[3]);
@@ -680,6 +1265,7 @@ void draw(bool withUI, bool withContextCallback) {
         buildPolyscopeGui();
         buildStructureGui();
         buildPickGui();
+        profiling::buildFrameStatsOverlay();
 
         for (Widget* w : state::widgets) {
           w->buildGUI();
@@ -695,13 +1281,32 @@ void draw(bool withUI, bool withContextCallback) {
   }
 
   processLazyProperties();
+  releaseIdleRenderData();
+  render::engine->updateRenderScale();
 
   // Draw structures in the scene
-  if (redrawNextFrame || options::alwaysRedraw) {
+  bool sceneWasRendered = redrawNextFrame || options::alwaysRedraw;
+  if (updateProgressiveQuality(sceneWasRendered)) sceneWasRendered = true;
+  if (sceneWasRendered) {
+    redrawNextFrame = false; // (first, so that redraws requested while drawing carry over to the next frame)
+    renderScene();
+    render::engine->temporalSamples = 0;
+    render::engine->accumulateTemporalSample();
+    framesBeforeIdle = framesAfterActivity;
+  } else if (render::engine->temporalAccumulationPending()) {
+    // Nothing changed: render another jittered frame for the temporal average (options::temporalAntiAliasingFrames)
+    view::projectionJitter = render::engine->temporalJitter();
     renderScene();
-    redrawNextFrame = false;
+    view::projectionJitter = glm::vec2{0., 0.};
+    render::engine->accumulateTemporalSample();
+    sceneWasRendered = true;
+  }
+  renderSceneToScreen(sceneWasRendered);
+
+  // Recorded frames are read back before the GUI is drawn over the scene
+  if (!render::engine->useAltDisplayBuffer) {
+    captureRecordingFrame(sceneWasRendered);
   }
-  renderSceneToScreen();
 
   // Draw the GUI
   if (withUI) {
@@ -712,40 +1317,67 @@ void draw(bool withUI, bool withContextCallback) {
     }
 
     render::engine->bindDisplay();
+    render::ScopedGPUTimer timer("ImGui");
     render::engine->ImGuiRender();
   }
+
+  render::engine->finishRenderStatsFrame();
 }
 
 
 void mainLoopIteration() {
 
   processLazyProperties();
+  startBackgroundCallback();
 
   // The windowing system will let this busy-loop in some situations, unfortunately. Make sure that doesn't happen.
   if (options::maxFPS != -1) {
-    auto currTime = std::chrono::steady_clock::now();
     long microsecPerLoop = 1000000 / options::maxFPS;
     microsecPerLoop = (95 * microsecPerLoop) / 100; // give a little slack so we actually hit target fps
-    while (std::chrono::duration_cast<std::chrono::microseconds>(currTime - lastMainLoopIterTime).count() <
-           microsecPerLoop) {
-      std::this_thread::yield();
-      currTime = std::chrono::steady_clock::now();
-    }
+    std::this_thread::sleep_until(lastMainLoopIterTime + std::chrono::microseconds(microsecPerLoop));
   }
   lastMainLoopIterTime = std::chrono::steady_clock::now();
+  profiling::beginFrame();
 
   render::engine->makeContextCurrent();
+  render::engine->waitForPresentedFrame(); // (low latency mode: read the input as late as possible)
   render::engine->updateWindowSize();
 
   // Process UI events
-  render::engine->pollEvents();
+  if (canIdle()) {
+    auto waitStart = std::chrono::steady_clock::now();
+    render::engine->waitEvents(options::idleModeTimeoutSeconds);
+    double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+    if (waited < options::idleModeTimeoutSeconds) {
+      framesBeforeIdle = framesAfterActivity; // woken by an event rather than the timeout
+    }
+  } else {
+    render::engine->pollEvents();
+    if (framesBeforeIdle > 0) framesBeforeIdle--;
+  }
   processInputEvents();
   view::updateFlight();
+  updateCameraPath();
+  if (detail::sessionCaptureActive) detail::captureFrame();
   showDelayedWarnings();
 
   // Rendering
   draw();
-  render::engine->swapDisplayBuffers();
+  {
+    ScopedCPUTimer timer("swapDisplayBuffers");
+    render::engine->swapDisplayBuffers();
+  }
+
+  pick::processAsyncPickQueries();
+  collectStructureOcclusion();
+  collectTransparencyPassTests();
+  render::engine->releaseUnusedShaderPrograms();
+  if (framesBeforeIdle == 0 && !redrawNextFrame) {
+    render::engine->processShaderWarmup(); // (one program per frame, once nothing else is going on)
+  }
+  processQueuedScreenshots();
+  processRecordingFrames();
+  profiling::endFrame();
 }
 
 void show(size_t forFrames) {
@@ -778,6 +1410,7 @@ void show(size_t forFrames) {
 
   // if this was the outermost show(), hide the window afterward
   if (contextStack.size() == 1) {
+    finishBackgroundCallback();
     render::engine->hideWindow();
   }
 }
@@ -785,9 +1418,15 @@ void show(size_t forFrames) {
 void shutdown() {
 
   // TODO should we make an effort to destruct everything here?
+  flushScreenshots();
+  backgroundCallbackJobs.reset(); // (finishes the run in progress)
+
   if (options::usePrefsFile) {
     writePrefsFile();
   }
+  if (!options::shaderWarmupProfile.empty()) {
+    render::engine->saveShaderWarmupProfile(options::shaderWarmupProfile);
+  }
 
   render::engine->shutdownImGui();
 }
@@ -823,9 +1462,11 @@ bool registerStructure(Structure* s, bool replaceIfPresent) {
 
   // Add the new structure
   sMap[s->name] = s;
-  updateStructureExtents();
+  updateStructureExtents(s);
   requestRedraw();
 
+  if (detail::sessionCaptureActive) detail::captureRegisteredStructure(*s);
+
   return true;
 }
 
@@ -902,6 +1543,7 @@ void removeStructure(std::string type, std::string name, bool errorIfAbsent) {
   sMap.erase(s->name);
   delete s;
   updateStructureExtents();
+  if (detail::sessionCaptureActive) detail::captureRemovedStructure(type, name);
   return;
 }
 
@@ -942,7 +1584,25 @@ void removeStructure(std::string name, bool errorIfAbsent) {
   requestRedraw();
 }
 
+bool registerStructures(const std::vector<Structure*>& structures, bool replaceIfPresent) {
+  BatchUpdate batch;
+  bool allRegistered = true;
+  for (Structure* s : structures) {
+    allRegistered = registerStructure(s, replaceIfPresent) && allRegistered;
+  }
+  return allRegistered;
+}
+
+void removeStructures(const std::vector<Structure*>& structures, bool errorIfAbsent) {
+  BatchUpdate batch;
+  for (Structure* s : structures) {
+    removeStructure(s, errorIfAbsent);
+  }
+  requestRedraw();
+}
+
 void removeAllStructures() {
+  BatchUpdate batch;
 
   for (auto typeMap : state::structures) {
 
@@ -979,9 +1639,15 @@ void refresh() {
 
 // Cached versions of lazy properties used for updates
 namespace lazy {
+size_t optionsChangeCount = 0;
 TransparencyMode transparencyMode = TransparencyMode::None;
 int transparencyRenderPasses = 8;
+bool impostorDepthPrepass = false;
+bool deferredShading = false;
+PresentMode presentMode = PresentMode::VSync;
 int ssaaFactor = 1;
+int msaaSamples = 1;
+int temporalAntiAliasingFrames = 1;
 bool groundPlaneEnabled = true;
 GroundPlaneMode groundPlaneMode = GroundPlaneMode::TileReflection;
 ScaledValue<float> groundPlaneHeightFactor = 0;
@@ -998,8 +1664,33 @@ void processLazyProperties() {
   // that ship has sailed.
   //
   // This function is a workaround which polls for changes to options settings, and performs any necessary additional
-  // work.
+  // work. Most of these options are OptionValue<>s, so the polling is skipped entirely unless one of them was assigned.
+
+  ScopedCPUTimer timer("processLazyProperties");
+
+  // updates handed over from other threads
+  runQueuedCommands();
+
+  // preprocessing of quantities registered in a batch which is still open, so that frames see them set up
+  batch::runAllDeferred();
+
+  // scene extents, once for all of the structures moved since the last frame
+  if (structureExtentsRequested) {
+    updateStructureExtents();
+  }
+
+  // ground plane height (a ScaledValue, which can be assigned through its members, so it is still polled)
+  if (lazy::groundPlaneHeightFactor.asAbsolute() != options::groundPlaneHeightFactor.asAbsolute() ||
+      lazy::groundPlaneHeightFactor.isRelative() != options::groundPlaneHeightFactor.isRelative()) {
+    lazy::groundPlaneHeightFactor = options::groundPlaneHeightFactor;
+    requestRedraw();
+  }
 
+  // the remaining options are OptionValue<>s, which count their assignments, skip them all if none were assigned
+  if (lazy::optionsChangeCount == options::changeCount) {
+    return;
+  }
+  lazy::optionsChangeCount = options::changeCount;
 
   // transparency mode
   if (lazy::transparencyMode != options::transparencyMode) {
@@ -1013,12 +1704,42 @@ void processLazyProperties() {
     requestRedraw();
   }
 
+  // impostor depth prepass
+  if (lazy::impostorDepthPrepass != options::impostorDepthPrepass) {
+    lazy::impostorDepthPrepass = options::impostorDepthPrepass;
+    render::engine->setImpostorDepthPrepass(options::impostorDepthPrepass);
+  }
+
+  // deferred shading
+  if (lazy::deferredShading != options::deferredShading) {
+    lazy::deferredShading = options::deferredShading;
+    render::engine->setDeferredShading(options::deferredShading);
+  }
+
+  // present mode
+  if (lazy::presentMode != options::presentMode) {
+    lazy::presentMode = options::presentMode;
+    render::engine->setPresentMode(options::presentMode);
+  }
+
   // ssaa
   if (lazy::ssaaFactor != options::ssaaFactor) {
     lazy::ssaaFactor = options::ssaaFactor;
     render::engine->setSSAAFactor(options::ssaaFactor);
   }
 
+  // msaa
+  if (lazy::msaaSamples != options::msaaSamples) {
+    lazy::msaaSamples = options::msaaSamples;
+    render::engine->setMSAASamples(options::msaaSamples);
+  }
+
+  // temporal anti-aliasing
+  if (lazy::temporalAntiAliasingFrames != options::temporalAntiAliasingFrames) {
+    lazy::temporalAntiAliasingFrames = options::temporalAntiAliasingFrames;
+    requestRedraw();
+  }
+
   // ground plane
   if (lazy::groundPlaneEnabled != options::groundPlaneEnabled || lazy::groundPlaneMode != options::groundPlaneMode) {
     lazy::groundPlaneEnabled = options::groundPlaneEnabled;
@@ -1030,11 +1751,6 @@ void processLazyProperties() {
     render::engine->groundPlane.prepare();
     requestRedraw();
   }
-  if (lazy::groundPlaneHeightFactor.asAbsolute() != options::groundPlaneHeightFactor.asAbsolute() ||
-      lazy::groundPlaneHeightFactor.isRelative() != options::groundPlaneHeightFactor.isRelative()) {
-    lazy::groundPlaneHeightFactor = options::groundPlaneHeightFactor;
-    requestRedraw();
-  }
   if (lazy::shadowBlurIters != options::shadowBlurIters) {
     lazy::shadowBlurIters = options::shadowBlurIters;
     requestRedraw();
@@ -1045,28 +1761,29 @@ void processLazyProperties() {
   }
 };
 
-void updateStructureExtents() {
-
-  if (!options::automaticallyComputeSceneExtents) {
-    return;
-  }
+namespace {
 
-  // Note: the cost multiple calls to this function scales only with the number of structures, not the size of the data
-  // in those structures, because structures internally cache the extents of their data.
+// The union of the extents of all registered structures, before the corrections applied to state::boundingBox below.
+// Kept so a registration only needs to grow it; anything which could shrink it recomputes it from all structures.
+glm::vec3 structureExtentsMin{std::numeric_limits<float>::infinity()};
+glm::vec3 structureExtentsMax{-std::numeric_limits<float>::infinity()};
+float structureExtentsLengthScale = 0.;
+bool structureExtentsValid = false;
+bool structureExtentsDeferred = false; // a recompute is queued for the end of the batch
+
+void includeInStructureExtents(Structure* s) {
+  structureExtentsLengthScale = std::max(structureExtentsLengthScale, s->lengthScale());
+  auto bbox = s->boundingBox();
+  structureExtentsMin = componentwiseMin(structureExtentsMin, std::get<0>(bbox));
+  structureExtentsMax = componentwiseMax(structureExtentsMax, std::get<1>(bbox));
+}
 
-  // Compute length scale and bbox as the max of all structures
-  state::lengthScale = 0.0;
-  glm::vec3 minBbox = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
-  glm::vec3 maxBbox = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+// Set the scene extents from the union of the structure extents
+void applyStructureExtents() {
 
-  for (auto cat : state::structures) {
-    for (auto x : cat.second) {
-      state::lengthScale = std::max(state::lengthScale, x.second->lengthScale());
-      auto bbox = x.second->boundingBox();
-      minBbox = componentwiseMin(minBbox, std::get<0>(bbox));
-      maxBbox = componentwiseMax(maxBbox, std::get<1>(bbox));
-    }
-  }
+  state::lengthScale = structureExtentsLengthScale;
+  glm::vec3 minBbox = structureExtentsMin;
+  glm::vec3 maxBbox = structureExtentsMax;
 
   // If we got a non-finite bounding box, fix it
   if (!isFinite(minBbox) || !isFinite(maxBbox)) {
@@ -1095,6 +1812,70 @@ void updateStructureExtents() {
   requestRedraw();
 }
 
+} // namespace
+
+void updateStructureExtents() {
+  structureExtentsRequested = false;
+
+  if (!options::automaticallyComputeSceneExtents) {
+    structureExtentsValid = false;
+    return;
+  }
+
+  // Inside a batch, recompute once at the end rather than for each structure registered or removed
+  if (isInBatch()) {
+    if (!structureExtentsDeferred) {
+      structureExtentsDeferred = true;
+      batch::runOrDefer(
+          &structureExtentsDeferred, []() {},
+          []() {
+            structureExtentsDeferred = false;
+            updateStructureExtents();
+          });
+    }
+    structureExtentsValid = false;
+    return;
+  }
+  structureExtentsDeferred = false;
+
+  // Note: the cost multiple calls to this function scales only with the number of structures, not the size of the data
+  // in those structures, because structures internally cache the extents of their data.
+
+  // Compute length scale and bbox as the max of all structures
+  structureExtentsLengthScale = 0.0;
+  structureExtentsMin = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  structureExtentsMax = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  for (const auto& cat : state::structures) {
+    for (const auto& x : cat.second) {
+      includeInStructureExtents(x.second);
+    }
+  }
+  structureExtentsValid = true;
+
+  applyStructureExtents();
+}
+
+void updateStructureExtents(Structure* addedStructure) {
+
+  if (!options::automaticallyComputeSceneExtents) {
+    structureExtentsValid = false;
+    return;
+  }
+  if (!structureExtentsValid) {
+    updateStructureExtents(); // (or defer it)
+    return;
+  }
+
+  // Adding a structure can only grow the union, so there is no need to visit the others
+  includeInStructureExtents(addedStructure);
+  applyStructureExtents();
+}
+
+void requestStructureExtentsUpdate() {
+  structureExtentsRequested = true;
+  requestRedraw();
+}
+
 namespace state {
 glm::vec3 center() { return 0.5f * (std::get<0>(state::boundingBox) + std::get<1>(state::boundingBox)); }
 } // namespace state
@@ -10,6 +10,10 @@ namespace polyscope {
 
 void loadColorMap(std::string cmapName, std::string filename) { render::engine->loadColorMap(cmapName, filename); }
 
+void updateColorMap(std::string cmapName, const std::vector<glm::vec3>& values) {
+  render::engine->updateColorMap(cmapName, values);
+}
+
 namespace render {
 
 // ImGUI helper to select a colormap. Returns true if the selection changed
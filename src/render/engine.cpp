@@ -1,6 +1,7 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/render/engine.h"
 
+#include "polyscope/parallel.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/render/colormap_defs.h"
 #include "polyscope/render/material_defs.h"
@@ -8,6 +9,15 @@
 #include "imgui.h"
 #include "stb_image.h"
 
+#include "json/json.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
 namespace polyscope {
 
 int dimension(const TextureFormat& x) {
@@ -23,6 +33,10 @@ int dimension(const TextureFormat& x) {
     case TextureFormat::RGB32F:   return 3;
     case TextureFormat::RGBA32F:  return 4;
     case TextureFormat::DEPTH24:  return 1;
+    case TextureFormat::R11F_G11F_B10F: return 3;
+    case TextureFormat::SRGB8_ALPHA8:   return 4;
+    case TextureFormat::BC6H_RGB16F:    return 3;
+    case TextureFormat::BC7_RGB8:       return 3;
   }
   // clang-format on
   throw std::runtime_error("bad enum");
@@ -36,6 +50,8 @@ std::string modeName(const TransparencyMode& m) {
     return "Simple";
   case TransparencyMode::Pretty:
     return "Pretty";
+  case TransparencyMode::WeightedBlended:
+    return "Weighted Blended";
   }
   return "";
 }
@@ -43,43 +59,151 @@ std::string modeName(const TransparencyMode& m) {
 
 namespace render {
 
-TextureBuffer::TextureBuffer(int dim_, TextureFormat format_, unsigned int sizeX_, unsigned int sizeY_)
-    : dim(dim_), format(format_), sizeX(sizeX_), sizeY(sizeY_) {
+namespace {
+
+// Storage used by one texel, as an estimate for memory accounting (drivers may pad this)
+size_t bytesPerTexel(TextureFormat f) {
+  switch (f) {
+  case TextureFormat::RGB8:
+  case TextureFormat::RGBA8:
+  case TextureFormat::RG16F:
+  case TextureFormat::R32F:
+  case TextureFormat::DEPTH24:
+  case TextureFormat::R11F_G11F_B10F:
+  case TextureFormat::SRGB8_ALPHA8:
+    return 4;
+  case TextureFormat::RGB16F:
+  case TextureFormat::RGBA16F:
+    return 8;
+  case TextureFormat::RGB32F:
+  case TextureFormat::RGBA32F:
+    return 16;
+  case TextureFormat::R16F:
+    return 2;
+  case TextureFormat::BC6H_RGB16F: // (16 byte 4x4 blocks, if compressed)
+  case TextureFormat::BC7_RGB8:
+    return 1;
+  }
+  return 4;
+}
+
+size_t bytesPerPixel(RenderBufferType t) {
+  switch (t) {
+  case RenderBufferType::Color:
+  case RenderBufferType::ColorAlpha:
+  case RenderBufferType::Depth:
+    return 4;
+  case RenderBufferType::Float4:
+    return 16;
+  }
+  return 4;
+}
+
+// Element textures are filled row by row, this many texels wide (well below the maximum texture size on any GPU)
+const size_t elementTextureWidth = 4096;
+
+template <typename T>
+std::shared_ptr<TextureBuffer> generateElementTextureOfFormat(Engine& engine, TextureFormat format,
+                                                              std::vector<T> data) {
+  size_t sizeX = std::max<size_t>(std::min(data.size(), elementTextureWidth), 1);
+  size_t sizeY = std::max<size_t>((data.size() + sizeX - 1) / sizeX, 1);
+  data.resize(sizeX * sizeY);
+  return engine.generateTextureBuffer(format, static_cast<unsigned int>(sizeX), static_cast<unsigned int>(sizeY),
+                                      reinterpret_cast<float*>(&data[0]));
+}
+
+} // namespace
+
+TextureBuffer::TextureBuffer(int dim_, TextureFormat format_, unsigned int sizeX_, unsigned int sizeY_,
+                             unsigned int sizeZ_)
+    : dim(dim_), format(format_), sizeX(sizeX_), sizeY(sizeY_), sizeZ(sizeZ_) {
   if (sizeX > (1 << 22)) throw std::runtime_error("OpenGL error: invalid texture dimensions");
   if (dim > 1 && sizeY > (1 << 22)) throw std::runtime_error("OpenGL error: invalid texture dimensions");
+  if (dim > 2 && sizeZ > (1 << 22)) throw std::runtime_error("OpenGL error: invalid texture dimensions");
+  allocation.setSize(getTotalSize() * bytesPerTexel(format));
 }
 
 TextureBuffer::~TextureBuffer() {}
 
 void TextureBuffer::setFilterMode(FilterMode newMode) {}
 
-void TextureBuffer::resize(unsigned int newLen) { sizeX = newLen; }
+void TextureBuffer::resize(unsigned int newLen) {
+  sizeX = newLen;
+  allocation.setSize(getTotalSize() * bytesPerTexel(format));
+}
 void TextureBuffer::resize(unsigned int newX, unsigned int newY) {
   sizeX = newX;
   sizeY = newY;
+  allocation.setSize(getTotalSize() * bytesPerTexel(format));
+}
+void TextureBuffer::setFormat(TextureFormat newFormat) {
+  format = newFormat;
+  allocation.setSize(getTotalSize() * bytesPerTexel(format));
 }
 
-unsigned int TextureBuffer::getTotalSize() const {
+size_t TextureBuffer::getTotalSize() const {
   switch (dim) {
   case 1:
     return getSizeX();
   case 2:
-    return getSizeX() * getSizeY();
+    return static_cast<size_t>(getSizeX()) * getSizeY();
   case 3:
-    throw std::runtime_error("not implemented");
-    return -1;
+    return static_cast<size_t>(getSizeX()) * getSizeY() * getSizeZ();
   }
   return -1;
 }
 
-RenderBuffer::RenderBuffer(RenderBufferType type_, unsigned int sizeX_, unsigned int sizeY_)
-    : type(type_), sizeX(sizeX_), sizeY(sizeY_) {
+RenderBuffer::RenderBuffer(RenderBufferType type_, unsigned int sizeX_, unsigned int sizeY_, unsigned int samples_)
+    : type(type_), sizeX(sizeX_), sizeY(sizeY_), samples(samples_) {
   if (sizeX > (1 << 22) || sizeY > (1 << 22)) throw std::runtime_error("OpenGL error: invalid renderbuffer dimensions");
+  allocation.setSize(static_cast<size_t>(sizeX) * sizeY * samples * bytesPerPixel(type));
 }
 
 void RenderBuffer::resize(unsigned int newX, unsigned int newY) {
   sizeX = newX;
   sizeY = newY;
+  allocation.setSize(static_cast<size_t>(sizeX) * sizeY * samples * bytesPerPixel(type));
+}
+
+AttributeBuffer::AttributeBuffer(DataType dataType_, int arrayCount_) : dataType(dataType_), arrayCount(arrayCount_) {}
+
+AttributeBuffer::~AttributeBuffer() {}
+
+void AttributeBuffer::trackUpdate() {
+  const size_t streamAfterUpdates = 3; // consecutive updated renders before streaming
+  const size_t maxRendersBetween = 2;  // a few passes may render between two updates, eg for several viewports
+
+  size_t rendersSince = state::sceneRenderCount - lastUpdateSceneRender;
+  lastUpdateSceneRender = state::sceneRenderCount;
+  if (rendersSince == 0) return; // another update before the same render
+  if (rendersSince > maxRendersBetween) updateStreak = 0;
+  updateStreak++;
+  streaming = updateStreak >= streamAfterUpdates;
+}
+
+size_t AttributeBuffer::entryBytes() const {
+  size_t bytes = 4;
+  switch (dataType) {
+  case DataType::Vector2Float:
+    bytes = 2 * sizeof(float);
+    break;
+  case DataType::Vector3Float:
+    bytes = 3 * sizeof(float);
+    break;
+  case DataType::Vector4Float:
+    bytes = 4 * sizeof(float);
+    break;
+  case DataType::Matrix44Float:
+    bytes = 16 * sizeof(float);
+    break;
+  case DataType::Float:
+  case DataType::Int:
+  case DataType::UInt:
+  case DataType::Index:
+    bytes = 4;
+    break;
+  }
+  return bytes * arrayCount;
 }
 
 FrameBuffer::FrameBuffer() {}
@@ -93,6 +217,16 @@ void FrameBuffer::setViewport(int startX, int startY, unsigned int sizeX, unsign
 }
 
 void FrameBuffer::resize(unsigned int newXSize, unsigned int newYSize) {
+
+  // Nothing to reallocate if every attachment already has this size (buffers shared between framebuffers, like the
+  // scene depth, are resized by the first of them)
+  bool unchanged = newXSize == sizeX && newYSize == sizeY;
+  for (auto& b : renderBuffersColor) unchanged = unchanged && b->getSizeX() == newXSize && b->getSizeY() == newYSize;
+  for (auto& b : renderBuffersDepth) unchanged = unchanged && b->getSizeX() == newXSize && b->getSizeY() == newYSize;
+  for (auto& b : textureBuffersColor) unchanged = unchanged && b->getSizeX() == newXSize && b->getSizeY() == newYSize;
+  for (auto& b : textureBuffersDepth) unchanged = unchanged && b->getSizeX() == newXSize && b->getSizeY() == newYSize;
+  if (unchanged) return;
+
   bind();
   for (auto& b : renderBuffersColor) {
     b->resize(newXSize, newYSize);
@@ -142,6 +276,40 @@ ShaderProgram::ShaderProgram(const std::vector<ShaderStageSpecification>& stages
   if (dm == DrawMode::IndexedLineStripAdjacency) {
     usePrimitiveRestart = true;
   }
+
+  if (dm == DrawMode::InstancedQuads || dm == DrawMode::InstancedBoxes) {
+    useInstancing = true;
+  }
+}
+
+size_t ShaderProgram::nextUserDataSlot() {
+  static std::atomic<size_t> nextSlot(0);
+  return nextSlot++;
+}
+
+bool ShaderProgram::attributeIsPerInstance(const std::string& name) const {
+  return useInstancing || (drawMode == DrawMode::InstancedTriangles && name.compare(0, 10, "a_instance") == 0);
+}
+
+std::shared_ptr<TextureBuffer> Engine::generateElementTexture(const std::vector<float>& data) {
+  return generateElementTextureOfFormat(*this, TextureFormat::R32F, data);
+}
+
+std::shared_ptr<TextureBuffer> Engine::generateElementTexture(const std::vector<glm::vec3>& data) {
+  return generateElementTextureOfFormat(*this, TextureFormat::RGB32F, data);
+}
+
+std::shared_ptr<TextureBuffer> Engine::generateElementTexture(const std::vector<float>& data, size_t nBlocks) {
+  if (nBlocks <= 1) return generateElementTexture(data);
+  size_t blockSize = data.size() / nBlocks;
+  size_t sizeX = std::max<size_t>(std::min(blockSize, elementTextureWidth), 1);
+  size_t blockRows = std::max<size_t>((blockSize + sizeX - 1) / sizeX, 1);
+  std::vector<float> rows(sizeX * blockRows * nBlocks, 0.f);
+  for (size_t iB = 0; iB < nBlocks; iB++) {
+    std::copy(data.begin() + iB * blockSize, data.begin() + (iB + 1) * blockSize, rows.begin() + iB * blockRows * sizeX);
+  }
+  return generateTextureBuffer(TextureFormat::R32F, static_cast<unsigned int>(sizeX),
+                               static_cast<unsigned int>(blockRows * nBlocks), &rows[0]);
 }
 
 void Engine::buildEngineGui() {
@@ -170,7 +338,8 @@ void Engine::buildEngineGui() {
     if (ImGui::TreeNode("Transparency")) {
 
       if (ImGui::BeginCombo("Mode", modeName(transparencyMode).c_str())) {
-        for (TransparencyMode m : {TransparencyMode::None, TransparencyMode::Simple, TransparencyMode::Pretty}) {
+        for (TransparencyMode m : {TransparencyMode::None, TransparencyMode::Simple, TransparencyMode::Pretty,
+                                   TransparencyMode::WeightedBlended}) {
           std::string mName = modeName(m);
           if (ImGui::Selectable(mName.c_str(), transparencyMode == m)) {
             options::transparencyMode = m;
@@ -188,14 +357,27 @@ void Engine::buildEngineGui() {
       case TransparencyMode::Simple: {
         ImGui::TextWrapped(
             "Simple transparent rendering. Efficient, but objects at different depths may not look right.");
+        if (ImGui::Checkbox("Sort surface triangles", &options::transparencySortTriangles)) {
+          requestRedraw();
+        }
         break;
       }
       case TransparencyMode::Pretty: {
         ImGui::TextWrapped("Accurate but expensive transparent rendering. Increase the number of passes to resolve "
                            "complicated scenes.");
-        if (ImGui::InputInt("Render Passes", &options::transparencyRenderPasses)) {
+        if (ImGui::InputInt("Render Passes", options::transparencyRenderPasses.getValuePtr())) {
+          options::transparencyRenderPasses.markChanged();
+          requestRedraw();
+        }
+        if (ImGui::Checkbox("Stop early when done", &options::transparencyAdaptivePasses)) {
           requestRedraw();
         }
+        ImGui::Text("passes used: %d", transparencyPassesUsed);
+        break;
+      }
+      case TransparencyMode::WeightedBlended: {
+        ImGui::TextWrapped("Single-pass order-independent transparency. Nearly as cheap as Simple, but weights "
+                           "surfaces by depth so nearer objects appear in front.");
         break;
       }
       }
@@ -227,6 +409,37 @@ void Engine::buildEngineGui() {
         options::ssaaFactor = ssaaFactor;
         requestRedraw();
       }
+      int newMSAASamples = options::msaaSamples;
+      if (ImGui::InputInt("MSAA samples", &newMSAASamples, 1)) {
+        // step through the supported counts 1, 2, 4, 8
+        if (newMSAASamples == 3) newMSAASamples = msaaSamples < 3 ? 4 : 2;
+        if (newMSAASamples > 4 && newMSAASamples < 8) newMSAASamples = msaaSamples < 5 ? 8 : 4;
+        options::msaaSamples = glm::clamp(newMSAASamples, 1, 8);
+      }
+      if (ImGui::IsItemHovered() && transparencyMode != TransparencyMode::None) {
+        ImGui::SetTooltip("MSAA only applies without transparency");
+      }
+      ImGui::Checkbox("FXAA", &options::enableFXAA);
+      ImGui::Checkbox("Eye-dome lighting", &options::eyeDomeLighting);
+      if (ImGui::IsItemHovered()) ImGui::SetTooltip("Shade by depth discontinuities, for splatted point clouds");
+      if (options::eyeDomeLighting) {
+        ImGui::SliderFloat("EDL strength", &options::eyeDomeLightingStrength, 0.1, 5.0, "%.2f",
+                           ImGuiSliderFlags_Logarithmic);
+      }
+      int newTemporalFrames = options::temporalAntiAliasingFrames;
+      if (ImGui::InputInt("Temporal frames", &newTemporalFrames, 1)) {
+        options::temporalAntiAliasingFrames = std::max(newTemporalFrames, 1);
+      }
+      ImGui::Checkbox("Progressive", &options::progressiveRendering);
+      if (ImGui::IsItemHovered()) ImGui::SetTooltip("Render with cheap settings while the scene or camera changes");
+      float targetMs = static_cast<float>(std::max(options::targetFrameTimeMs, 0.));
+      if (ImGui::InputFloat("Target frame ms", &targetMs, 1.f, 5.f, "%.1f")) {
+        options::targetFrameTimeMs = targetMs > 0.f ? targetMs : -1.;
+      }
+      if (ImGui::IsItemHovered()) ImGui::SetTooltip("Scale the resolution to hold this GPU frame time (0 for off)");
+      if (options::targetFrameTimeMs > 0.) {
+        ImGui::Text("Render scale: %.2f", renderScale);
+      }
       ImGui::TreePop();
     }
 
@@ -287,10 +500,327 @@ void Engine::buildEngineGui() {
       ImGui::TreePop();
     }
 
+    // == Shader cache
+    long long int nHits = static_cast<long long int>(shaderCacheHits);
+    long long int nMisses = static_cast<long long int>(shaderCacheMisses);
+    ImGui::Text("Shader cache: %lld hits, %lld misses", nHits, nMisses);
+
+    ImGui::TreePop();
+  }
+
+  ImGui::SetNextTreeNodeOpen(false, ImGuiCond_FirstUseEver);
+  if (ImGui::TreeNode("GPU Timings")) {
+    ImGui::Checkbox("Enable", &options::enableGPUProfiling);
+    if (options::enableGPUProfiling) {
+      for (const GPUTiming& t : getGPUTimings()) {
+        ImGui::Text("%*s%s: %.3f ms", 2 * t.depth, "", t.name.c_str(), t.durationMs);
+      }
+      if (ImGui::Button("Write trace")) {
+        writeGPUTimingTrace("polyscope_gpu_trace.json");
+      }
+    }
+
+    const RenderStats& stats = lastFrameRenderStats;
+    ImGui::Text("Last frame: %zu draws, %zu program binds, %zu texture binds", stats.drawCalls, stats.programBinds,
+                stats.textureBinds);
+    ImGui::Text("  %zu state changes, %zu redundant changes skipped", stats.stateChanges,
+                stats.redundantChangesSkipped);
+    ImGui::TreePop();
+  }
+
+  ImGui::SetNextTreeNodeOpen(false, ImGuiCond_FirstUseEver);
+  if (ImGui::TreeNode("Pipeline Statistics")) {
+    if (!supportsPipelineStatistics()) {
+      ImGui::TextUnformatted("Not supported by the driver");
+    } else {
+      ImGui::Checkbox("Enable", &options::enablePipelineStatistics);
+    }
+    if (options::enablePipelineStatistics) {
+      double nPixels = std::max(1., static_cast<double>(view::bufferWidth) * view::bufferHeight);
+      for (const GPUPipelineStatistics& s : getPipelineStatistics()) {
+        if (ImGui::TreeNode(s.name.c_str())) {
+          ImGui::Text("vertices: %llu", static_cast<unsigned long long>(s.verticesSubmitted));
+          ImGui::Text("primitives: %llu", static_cast<unsigned long long>(s.primitivesSubmitted));
+          ImGui::Text("geometry shader invocations: %llu", static_cast<unsigned long long>(s.geometryShaderInvocations));
+          ImGui::Text("fragment shader invocations: %llu (%.2f per pixel)",
+                      static_cast<unsigned long long>(s.fragmentShaderInvocations),
+                      s.fragmentShaderInvocations / nPixels);
+          ImGui::TreePop();
+        }
+      }
+    }
     ImGui::TreePop();
   }
 }
 
+void Engine::waitEvents(double timeoutSeconds) { pollEvents(); }
+
+void Engine::setPresentMode(PresentMode newMode) { presentMode = newMode; }
+
+void Engine::waitForPresentedFrame() {}
+
+void Engine::queueInputEvent(const InputEvent& e) {
+  queuedInput.push_back(e);
+  requestRedraw();
+}
+
+void Engine::applyQueuedInput() {
+  if (queuedInput.empty()) return;
+
+  ImGuiIO& io = ImGui::GetIO();
+#if IMGUI_VERSION_NUM < 18700
+  io.MouseWheel = 0.;
+  io.MouseWheelH = 0.;
+#endif
+  bool applied = false;
+  while (!queuedInput.empty()) {
+    InputEvent e = queuedInput.front();
+    bool buttonChange = e.button >= 0 && e.button < 3;
+    if (buttonChange && applied) break; // (a button change starts a frame, see below)
+    queuedInput.pop_front();
+    applied = true;
+
+#if IMGUI_VERSION_NUM >= 18700
+    if (e.mousePos.x >= 0.) io.AddMousePosEvent(e.mousePos.x, e.mousePos.y);
+    if (buttonChange) io.AddMouseButtonEvent(e.button, e.pressed);
+    if (e.wheel != glm::vec2{0., 0.}) io.AddMouseWheelEvent(e.wheel.x, e.wheel.y);
+#if IMGUI_VERSION_NUM >= 18900
+    io.AddKeyEvent(ImGuiMod_Shift, e.shift);
+    io.AddKeyEvent(ImGuiMod_Ctrl, e.ctrl);
+#else
+    io.AddKeyEvent(ImGuiKey_ModShift, e.shift);
+    io.AddKeyEvent(ImGuiKey_ModCtrl, e.ctrl);
+#endif
+#else
+    if (e.mousePos.x >= 0.) io.MousePos = ImVec2(e.mousePos.x, e.mousePos.y);
+    if (buttonChange) io.MouseDown[e.button] = e.pressed;
+    io.MouseWheel += e.wheel.y;
+    io.MouseWheelH += e.wheel.x;
+    io.KeyShift = e.shift;
+    io.KeyCtrl = e.ctrl;
+#endif
+
+    // ImGui sees the mouse at each button change, and only sees a click if the press and the release land in
+    // different frames, so each button change gets a frame of its own
+    if (buttonChange) break;
+  }
+
+  if (!queuedInput.empty()) requestRedraw(); // (the rest goes in the following frames)
+}
+
+std::vector<GPUTiming> Engine::getGPUTimings() {
+  if (gpuTimingHistory.empty()) return {};
+  return gpuTimingHistory.back();
+}
+
+void Engine::recordGPUTimingFrame(std::vector<GPUTiming> timings) {
+  const size_t maxHistoryFrames = 300;
+  gpuTimingHistory.push_back(std::move(timings));
+  gpuTimingFramesRecorded++;
+  while (gpuTimingHistory.size() > maxHistoryFrames) {
+    gpuTimingHistory.pop_front();
+  }
+}
+
+void Engine::recordPipelineStatisticsFrame(const std::vector<GPUPipelineStatistics>& regions) {
+  lastPipelineStatistics.clear();
+  std::unordered_map<std::string, size_t> indexByName;
+  for (const GPUPipelineStatistics& r : regions) {
+    auto it = indexByName.find(r.name);
+    if (it == indexByName.end()) {
+      indexByName[r.name] = lastPipelineStatistics.size();
+      lastPipelineStatistics.push_back(r);
+      continue;
+    }
+    GPUPipelineStatistics& sum = lastPipelineStatistics[it->second];
+    sum.verticesSubmitted += r.verticesSubmitted;
+    sum.primitivesSubmitted += r.primitivesSubmitted;
+    sum.geometryShaderInvocations += r.geometryShaderInvocations;
+    sum.fragmentShaderInvocations += r.fragmentShaderInvocations;
+  }
+}
+
+void Engine::resetRenderStats() {
+  renderStats = RenderStats();
+  renderStatsAtFrameEnd = RenderStats();
+}
+
+void Engine::finishRenderStatsFrame() {
+  lastFrameRenderStats.drawCalls = renderStats.drawCalls - renderStatsAtFrameEnd.drawCalls;
+  lastFrameRenderStats.programBinds = renderStats.programBinds - renderStatsAtFrameEnd.programBinds;
+  lastFrameRenderStats.textureBinds = renderStats.textureBinds - renderStatsAtFrameEnd.textureBinds;
+  lastFrameRenderStats.stateChanges = renderStats.stateChanges - renderStatsAtFrameEnd.stateChanges;
+  lastFrameRenderStats.redundantChangesSkipped =
+      renderStats.redundantChangesSkipped - renderStatsAtFrameEnd.redundantChangesSkipped;
+  lastFrameRenderStats.uniformSets = renderStats.uniformSets - renderStatsAtFrameEnd.uniformSets;
+  lastFrameRenderStats.uploadBytes = renderStats.uploadBytes - renderStatsAtFrameEnd.uploadBytes;
+  lastFrameRenderStats.shaderCompilations = renderStats.shaderCompilations - renderStatsAtFrameEnd.shaderCompilations;
+  lastFrameRenderStats.structuresCulled = renderStats.structuresCulled - renderStatsAtFrameEnd.structuresCulled;
+  lastFrameRenderStats.clustersCulled = renderStats.clustersCulled - renderStatsAtFrameEnd.clustersCulled;
+  lastFrameRenderStats.sliceCaptures = renderStats.sliceCaptures - renderStatsAtFrameEnd.sliceCaptures;
+  renderStatsAtFrameEnd = renderStats;
+}
+
+void Engine::writeGPUTimingTrace(std::string filename) {
+  using json = nlohmann::json;
+
+  json events = json::array();
+  for (const std::vector<GPUTiming>& frame : gpuTimingHistory) {
+    for (const GPUTiming& t : frame) {
+      // complete events, with times in microseconds
+      events.push_back({{"name", t.name},
+                        {"ph", "X"},
+                        {"ts", 1000. * t.startMs},
+                        {"dur", 1000. * t.durationMs},
+                        {"pid", 0},
+                        {"tid", 0}});
+    }
+  }
+
+  std::ofstream outFile(filename);
+  if (!outFile) {
+    throw std::runtime_error("failed to open GPU timing trace file " + filename);
+  }
+  outFile << json{{"traceEvents", events}}.dump() << std::endl;
+}
+
+namespace {
+// (as named in warm-up profiles)
+const std::vector<std::pair<ShaderReplacementDefaults, std::string>> shaderDefaultsNames = {
+    {ShaderReplacementDefaults::SceneObject, "SceneObject"},
+    {ShaderReplacementDefaults::Pick, "Pick"},
+    {ShaderReplacementDefaults::Process, "Process"},
+    {ShaderReplacementDefaults::None, "None"},
+};
+} // namespace
+
+void Engine::queueShaderWarmup(const std::string& programName, const std::vector<std::string>& customRules,
+                               ShaderReplacementDefaults defaults) {
+  shaderWarmupQueue.push_back(ShaderWarmupEntry{programName, customRules, defaults});
+}
+
+bool Engine::processShaderWarmup() {
+  if (shaderWarmupQueue.empty()) return false;
+  ShaderWarmupEntry entry = shaderWarmupQueue.front();
+  shaderWarmupQueue.pop_front();
+
+  // The program is held on to, so that the backend's program cache keeps what was compiled until it is asked for
+  try {
+    warmedShaderPrograms.push_back(requestShader(entry.programName, entry.customRules, entry.defaults));
+  } catch (const std::runtime_error&) {
+    // (e.g. a rule generated at runtime in the session a profile was recorded in)
+  }
+  return true;
+}
+
+void Engine::recordShaderRequest(const std::string& programName, const std::vector<std::string>& customRules,
+                                 ShaderReplacementDefaults defaults) {
+  std::string key = programName + "#" + std::to_string(static_cast<int>(defaults));
+  for (const std::string& rule : customRules) {
+    key += "#" + rule;
+  }
+  if (!requestedShaderKeys.insert(key).second) return;
+  requestedShaders.push_back(ShaderWarmupEntry{programName, customRules, defaults});
+}
+
+bool Engine::saveShaderWarmupProfile(const std::string& filename) {
+  using json = nlohmann::json;
+
+  json programs = json::array();
+  for (const ShaderWarmupEntry& entry : requestedShaders) {
+    std::string defaultsName;
+    for (const std::pair<ShaderReplacementDefaults, std::string>& d : shaderDefaultsNames) {
+      if (d.first == entry.defaults) defaultsName = d.second;
+    }
+    programs.push_back({{"program", entry.programName}, {"rules", entry.customRules}, {"defaults", defaultsName}});
+  }
+
+  std::ofstream outFile(filename);
+  if (!outFile) {
+    warning("failed to write shader warm-up profile " + filename);
+    return false;
+  }
+  outFile << json{{"programs", programs}}.dump() << std::endl;
+  return true;
+}
+
+bool Engine::loadShaderWarmupProfile(const std::string& filename) {
+  using json = nlohmann::json;
+
+  std::ifstream inFile(filename);
+  if (!inFile) {
+    warning("could not open shader warm-up profile " + filename);
+    return false;
+  }
+
+  try {
+    json profile;
+    inFile >> profile;
+    for (const json& program : profile.at("programs")) {
+      std::string defaultsName = program.at("defaults").get<std::string>();
+      bool known = false;
+      ShaderReplacementDefaults defaults = ShaderReplacementDefaults::SceneObject;
+      for (const std::pair<ShaderReplacementDefaults, std::string>& d : shaderDefaultsNames) {
+        if (d.second == defaultsName) {
+          defaults = d.first;
+          known = true;
+        }
+      }
+      if (!known) continue;
+      queueShaderWarmup(program.at("program").get<std::string>(),
+                        program.at("rules").get<std::vector<std::string>>(), defaults);
+    }
+  } catch (...) {
+    warning("could not read shader warm-up profile " + filename);
+    return false;
+  }
+  return true;
+}
+
+ScopedGPUTimer::ScopedGPUTimer(const std::string& name)
+    : active(options::enableGPUProfiling || options::targetFrameTimeMs > 0.) {
+  if (active) engine->pushGPUTimer(name);
+}
+
+ScopedGPUTimer::ScopedGPUTimer(const char* name, int index)
+    : active(options::enableGPUProfiling || options::targetFrameTimeMs > 0.) {
+  if (active) engine->pushGPUTimer(name + (" " + std::to_string(index)));
+}
+
+ScopedGPUTimer::~ScopedGPUTimer() {
+  if (active) engine->popGPUTimer();
+}
+
+ScopedPipelineStatistics::ScopedPipelineStatistics(const std::string& name)
+    : active(options::enablePipelineStatistics && engine->supportsPipelineStatistics()) {
+  if (active) engine->beginPipelineStatistics(name);
+}
+
+ScopedPipelineStatistics::~ScopedPipelineStatistics() {
+  if (active) engine->endPipelineStatistics();
+}
+
+ScopedGPUMemoryAccount::ScopedGPUMemoryAccount(std::shared_ptr<GPUMemoryAccount> account)
+    : previous(engine->activeGPUMemoryAccount) {
+  engine->activeGPUMemoryAccount = account;
+}
+
+ScopedGPUMemoryAccount::~ScopedGPUMemoryAccount() { engine->activeGPUMemoryAccount = previous; }
+
+GPUAllocation::GPUAllocation() : account(engine ? engine->activeGPUMemoryAccount : nullptr) {}
+
+GPUAllocation::~GPUAllocation() { setSize(0); }
+
+void GPUAllocation::setSize(size_t nBytes) {
+  if (engine) {
+    engine->gpuMemoryUsage = engine->gpuMemoryUsage - bytes + nBytes;
+  }
+  if (account) {
+    account->bytes = account->bytes - bytes + nBytes;
+  }
+  bytes = nBytes;
+}
+
 void Engine::setBackgroundColor(glm::vec3 c) {
   FrameBuffer& targetBuffer = useAltDisplayBuffer ? *displayBufferAlt : *displayBuffer;
   targetBuffer.clearColor = c;
@@ -301,7 +831,19 @@ void Engine::setBackgroundAlpha(float newAlpha) {
   targetBuffer.clearAlpha = newAlpha;
 }
 
-void Engine::setCurrentViewport(glm::vec4 val) { currViewport = val; }
+void Engine::setCurrentViewport(glm::vec4 val) {
+  currViewport = val;
+
+  // While drawing one view region, keep to its part of whichever framebuffer is bound (see view::ViewRegion)
+  if (view::viewRegion.active) {
+    glm::vec4 r = view::getViewRegionInBuffer();
+    long int x0 = std::lround(val[0] + glm::clamp(r[0], 0.f, 1.f) * val[2]);
+    long int y0 = std::lround(val[1] + glm::clamp(r[1], 0.f, 1.f) * val[3]);
+    long int x1 = std::lround(val[0] + glm::clamp(r[0] + r[2], 0.f, 1.f) * val[2]);
+    long int y1 = std::lround(val[1] + glm::clamp(r[1] + r[3], 0.f, 1.f) * val[3]);
+    setScissor(x0, y0, std::max(x1 - x0, 0l), std::max(y1 - y0, 0l));
+  }
+}
 glm::vec4 Engine::getCurrentViewport() { return currViewport; }
 void Engine::setCurrentPixelScaling(float val) { currPixelScale = val; }
 float Engine::getCurrentPixelScaling() { return currPixelScale; }
@@ -318,16 +860,44 @@ void Engine::clearDisplay() {
 }
 
 
-void Engine::clearSceneBuffer() { sceneBuffer->clear(); }
+void Engine::clearSceneBuffer() {
+  if (multisampleActive()) {
+    sceneBufferMultisample->clearColor = sceneBuffer->clearColor;
+    sceneBufferMultisample->clearAlpha = sceneBuffer->clearAlpha;
+    sceneBufferMultisample->clear();
+  } else {
+    sceneBuffer->clear();
+  }
+}
 
-void Engine::resizeScreenBuffers() {
+void Engine::resizeDisplayBuffers() {
   unsigned int width = view::bufferWidth;
   unsigned int height = view::bufferHeight;
   displayBuffer->resize(width, height);
   displayBufferAlt->resize(width, height);
-  sceneBuffer->resize(ssaaFactor * width, ssaaFactor * height);
-  sceneBufferFinal->resize(ssaaFactor * width, ssaaFactor * height);
-  sceneDepthMinFrame->resize(ssaaFactor * width, ssaaFactor * height);
+  displayCache->resize(width, height);
+  displayCacheValid = false;
+  displayBuffer->setViewport(0, 0, width, height);
+  displayBufferAlt->setViewport(0, 0, width, height);
+  displayCache->setViewport(0, 0, width, height);
+}
+
+void Engine::resizeScreenBuffers() {
+  unsigned int width = view::bufferWidth;
+  unsigned int height = view::bufferHeight;
+  resizeDisplayBuffers();
+  unsigned int sceneWidth = sceneBufferSize(width);
+  unsigned int sceneHeight = sceneBufferSize(height);
+  sceneBuffer->resize(sceneWidth, sceneHeight);
+  sceneBufferFinal->resize(sceneWidth, sceneHeight);
+  sceneDepthMinFrame->resize(sceneWidth, sceneHeight);
+  sceneBufferWeighted->resize(sceneWidth, sceneHeight);
+  sceneBufferDeferred->resize(sceneWidth, sceneHeight);
+  staticLayerBuffer->resize(sceneWidth, sceneHeight);
+  staticLayerValid = false;
+  if (sceneBufferMultisample) sceneBufferMultisample->resize(sceneWidth, sceneHeight);
+  if (temporalBuffer) temporalBuffer->resize(sceneWidth, sceneHeight);
+  temporalSamples = 0;
 }
 
 void Engine::setScreenBufferViewports() {
@@ -338,16 +908,77 @@ void Engine::setScreenBufferViewports() {
 
   displayBuffer->setViewport(xStart, yStart, sizeX, sizeY);
   displayBufferAlt->setViewport(xStart, yStart, sizeX, sizeY);
-  sceneBuffer->setViewport(ssaaFactor * xStart, ssaaFactor * yStart, ssaaFactor * sizeX, ssaaFactor * sizeY);
-  sceneBufferFinal->setViewport(ssaaFactor * xStart, ssaaFactor * yStart, ssaaFactor * sizeX, ssaaFactor * sizeY);
-  sceneDepthMinFrame->setViewport(ssaaFactor * xStart, ssaaFactor * yStart, ssaaFactor * sizeX, ssaaFactor * sizeY);
+  displayCache->setViewport(xStart, yStart, sizeX, sizeY);
+  unsigned int sceneSizeX = sceneBufferSize(sizeX);
+  unsigned int sceneSizeY = sceneBufferSize(sizeY);
+  sceneBuffer->setViewport(xStart, yStart, sceneSizeX, sceneSizeY);
+  sceneBufferFinal->setViewport(xStart, yStart, sceneSizeX, sceneSizeY);
+  sceneDepthMinFrame->setViewport(xStart, yStart, sceneSizeX, sceneSizeY);
+  sceneBufferWeighted->setViewport(xStart, yStart, sceneSizeX, sceneSizeY);
+  sceneBufferDeferred->setViewport(xStart, yStart, sceneSizeX, sceneSizeY);
+  staticLayerBuffer->setViewport(xStart, yStart, sceneSizeX, sceneSizeY);
+  if (sceneBufferMultisample) {
+    sceneBufferMultisample->setViewport(xStart, yStart, sceneSizeX, sceneSizeY);
+  }
+  if (temporalBuffer) {
+    temporalBuffer->setViewport(xStart, yStart, sceneSizeX, sceneSizeY);
+  }
+}
+
+void Engine::scheduleScreenBufferResize(bool immediate) {
+  if (immediate || options::screenBufferResizeDelay <= 0.) {
+    resizeScreenBuffers();
+    setScreenBufferViewports();
+    screenBufferResizeScheduled = false;
+    return;
+  }
+
+  // Until the size settles, the scene is drawn at the old size and stretched to the display
+  resizeDisplayBuffers();
+  screenBufferResizeScheduled = true;
+  screenBufferResizeTime = std::chrono::steady_clock::now();
+}
+
+void Engine::applyScheduledScreenBufferResize(bool force) {
+  if (!screenBufferResizeScheduled) return;
+
+  double settledFor = std::chrono::duration<double>(std::chrono::steady_clock::now() - screenBufferResizeTime).count();
+  if (!force && settledFor < options::screenBufferResizeDelay) {
+    requestRedraw(); // keep drawing frames until it is time to resize
+    return;
+  }
+
+  resizeScreenBuffers();
+  setScreenBufferViewports();
+  screenBufferResizeScheduled = false;
+  requestRedraw();
 }
 
 bool Engine::bindSceneBuffer() {
-  setCurrentPixelScaling(ssaaFactor);
+  setCurrentPixelScaling(getSceneScale());
+  if (multisampleActive()) return sceneBufferMultisample->bindForRendering();
   return sceneBuffer->bindForRendering();
 }
 
+void Engine::resolveSceneBuffer() {
+  if (multisampleActive()) {
+    sceneBufferMultisample->blitTo(sceneBufferFinal.get());
+  } else if (options::eyeDomeLighting) {
+    // Shade the scene color by the depth of its neighbors as it is copied
+    ScopedGPUTimer timer("eye-dome lighting");
+    if (!sceneBufferFinal->bindForRendering()) return;
+    setDepthMode(DepthMode::Disable);
+    setBlendMode(BlendMode::Disable);
+    glm::mat4 Pinv = glm::inverse(view::getCameraPerspectiveMatrix());
+    eyeDomeLighting->setUniform("u_invProjMatrix", glm::value_ptr(Pinv));
+    eyeDomeLighting->setUniform("u_strength", options::eyeDomeLightingStrength);
+    eyeDomeLighting->setUniform("u_radius", options::eyeDomeLightingRadius * getSceneScale());
+    eyeDomeLighting->draw();
+  } else {
+    sceneBuffer->blitTo(sceneBufferFinal.get());
+  }
+}
+
 void Engine::applyLightingTransform(std::shared_ptr<TextureBuffer>& texture) {
 
   glm::vec4 currV = getCurrentViewport();
@@ -360,9 +991,12 @@ void Engine::applyLightingTransform(std::shared_ptr<TextureBuffer>& texture) {
   // compute downsampling rate
   float sampleX = texture->getSizeX() / currV[2];
   float sampleY = texture->getSizeY() / currV[3];
-  if (sampleX != sampleY) throw std::runtime_error("lighting downsampling should have same aspect");
   int sampleLevel;
-  if (sampleX < 1.) {
+  if (renderScale != 1.f) {
+    sampleLevel = 0; // dynamic resolution, resampled from whatever ratio
+  } else if (sampleX != sampleY) {
+    throw std::runtime_error("lighting downsampling should have same aspect");
+  } else if (sampleX < 1.) {
     sampleLevel = 1;
   } else {
     if (sampleX != static_cast<int>(sampleX))
@@ -372,10 +1006,15 @@ void Engine::applyLightingTransform(std::shared_ptr<TextureBuffer>& texture) {
   }
 
   // == Lazily regnerate the mapper if it doesn't match the current settings
-  if (!mapLight || currLightingSampleLevel != sampleLevel || currLightingTransparencyMode != transparencyMode) {
+  // FXAA replaces the plain resolve, the supersampled ones are smooth enough already
+  bool useFXAA = options::enableFXAA && sampleLevel == 1;
+
+  if (!mapLight || currLightingSampleLevel != sampleLevel || currLightingTransparencyMode != transparencyMode ||
+      currLightingFXAA != useFXAA) {
 
     std::string sampleRuleName = "";
-    if (sampleLevel == 1) sampleRuleName = "DOWNSAMPLE_RESOLVE_1";
+    if (sampleLevel == 0) sampleRuleName = "DOWNSAMPLE_RESOLVE_SCALED";
+    if (sampleLevel == 1) sampleRuleName = useFXAA ? "DOWNSAMPLE_RESOLVE_FXAA" : "DOWNSAMPLE_RESOLVE_1";
     if (sampleLevel == 2) sampleRuleName = "DOWNSAMPLE_RESOLVE_2";
     if (sampleLevel == 3) sampleRuleName = "DOWNSAMPLE_RESOLVE_3";
     if (sampleLevel == 4) sampleRuleName = "DOWNSAMPLE_RESOLVE_4";
@@ -390,12 +1029,15 @@ void Engine::applyLightingTransform(std::shared_ptr<TextureBuffer>& texture) {
       break;
     case TransparencyMode::Pretty:
       break;
+    case TransparencyMode::WeightedBlended:
+      break;
     }
 
     mapLight = render::engine->requestShader("MAP_LIGHT", resolveRules, render::ShaderReplacementDefaults::Process);
     mapLight->setAttribute("a_position", screenTrianglesCoords());
     currLightingSampleLevel = sampleLevel;
     currLightingTransparencyMode = transparencyMode;
+    currLightingFXAA = useFXAA;
   }
 
   mapLight->setUniform("u_exposure", exposure);
@@ -405,6 +1047,9 @@ void Engine::applyLightingTransform(std::shared_ptr<TextureBuffer>& texture) {
 
   glm::vec2 texelSize{1. / texture->getSizeX(), 1. / texture->getSizeY()};
   mapLight->setUniform("u_texelSize", texelSize);
+  if (sampleLevel == 0) {
+    mapLight->setUniform("u_sampleRatio", glm::vec2{sampleX, sampleY});
+  }
 
   if (lightCopy) {
     setBlendMode(BlendMode::Disable);
@@ -415,8 +1060,44 @@ void Engine::applyLightingTransform(std::shared_ptr<TextureBuffer>& texture) {
   mapLight->draw();
 }
 
+Engine::DisplayCacheKey Engine::currentDisplayCacheKey() {
+  glm::vec4 bg{view::bgColor[0], view::bgColor[1], view::bgColor[2], view::bgColor[3]};
+  return DisplayCacheKey{exposure, whiteLevel, gamma, lightCopy, transparencyMode, bg, view::bufferWidth,
+                         view::bufferHeight, options::enableFXAA};
+}
+
+void Engine::resolveSceneToDisplay(bool sceneWasRendered) {
+
+  // Screenshots go to the alt buffer, and are always resolved from scratch (from the same image as the display, which
+  // is the rendered scene unless the screenshot reuses a temporal average)
+  if (useAltDisplayBuffer) {
+    applyLightingTransform(temporalSamples > 1 ? temporalColor : sceneColorFinal);
+    return;
+  }
+
+  DisplayCacheKey key = currentDisplayCacheKey();
+  if (sceneWasRendered || !displayCacheValid || key != displayCacheKey) {
+    applyLightingTransform(temporalSamples > 1 ? temporalColor : sceneColorFinal);
+    displayBuffer->blitTo(displayCache.get());
+    displayCacheKey = key;
+    displayCacheValid = true;
+  } else {
+    displayCache->blitTo(displayBuffer.get());
+  }
+  bindDisplay();
+}
+
 void Engine::setMaterial(ShaderProgram& program, const std::string& mat) {
   const Material& m = getMaterial(mat);
+
+  // (programs which may shade deferred record which material lights them in the resolve)
+  ShaderUniformHandle materialIndexHandle = program.getUniformHandle("u_materialIndex");
+  if (materialIndexHandle.isValid()) {
+    for (size_t i = 0; i < materials.size(); i++) {
+      if (materials[i].get() == &m) program.setUniform(materialIndexHandle, static_cast<float>(i));
+    }
+  }
+
   program.setTextureFromBuffer("t_mat_r", m.textureBuffers[0].get());
   program.setTextureFromBuffer("t_mat_g", m.textureBuffers[1].get());
   program.setTextureFromBuffer("t_mat_b", m.textureBuffers[2].get());
@@ -461,6 +1142,12 @@ void Engine::setTransparencyMode(TransparencyMode newMode) {
         defaultRules_sceneObject.end());
     break;
   }
+  case TransparencyMode::WeightedBlended: {
+    defaultRules_sceneObject.erase(std::remove(defaultRules_sceneObject.begin(), defaultRules_sceneObject.end(),
+                                               "TRANSPARENCY_WEIGHTED_STRUCTURE"),
+                                   defaultRules_sceneObject.end());
+    break;
+  }
   }
 
   transparencyMode = newMode;
@@ -478,6 +1165,10 @@ void Engine::setTransparencyMode(TransparencyMode newMode) {
     defaultRules_sceneObject.push_back("TRANSPARENCY_PEEL_STRUCTURE");
     break;
   }
+  case TransparencyMode::WeightedBlended: {
+    defaultRules_sceneObject.push_back("TRANSPARENCY_WEIGHTED_STRUCTURE");
+    break;
+  }
   }
 
   // Regenerate _all_ the things
@@ -494,6 +1185,8 @@ bool Engine::transparencyEnabled() {
     return true;
   case TransparencyMode::Pretty:
     return true;
+  case TransparencyMode::WeightedBlended:
+    return true;
   }
   return false;
 }
@@ -506,16 +1199,219 @@ void Engine::setSSAAFactor(int newVal) {
 
 bool Engine::getFrontFaceCCW() { return frontFaceCCW; }
 
+void Engine::setMSAASamples(int newVal) {
+  if (newVal != 1 && newVal != 2 && newVal != 4 && newVal != 8) {
+    throw std::runtime_error("msaaSamples must be one of 1,2,4,8");
+  }
+  msaaSamples = newVal;
+
+  sceneBufferMultisample.reset();
+  if (msaaSamples > 1) {
+    unsigned int sizeX = sceneBufferSize(view::bufferWidth);
+    unsigned int sizeY = sceneBufferSize(view::bufferHeight);
+    std::shared_ptr<RenderBuffer> color = generateRenderBuffer(RenderBufferType::Float4, sizeX, sizeY, msaaSamples);
+    std::shared_ptr<RenderBuffer> depth = generateRenderBuffer(RenderBufferType::Depth, sizeX, sizeY, msaaSamples);
+    sceneBufferMultisample = generateFrameBuffer(sizeX, sizeY);
+    sceneBufferMultisample->addColorBuffer(color);
+    sceneBufferMultisample->addDepthBuffer(depth);
+    sceneBufferMultisample->setDrawBuffers();
+    sceneBufferMultisample->setViewport(0, 0, sizeX, sizeY);
+  }
+  staticLayerValid = false;
+  requestRedraw();
+}
+
+int Engine::getMSAASamples() { return msaaSamples; }
+
+TextureFormat Engine::sceneColorFormat() {
+  // Values past the tone mapping's white point all map to white, so nothing above whiteLevel / exposure needs storing.
+  // Simple transparency sums colors beyond 1, and MSAA resolves can only blit between identical formats.
+  if (options::compactSceneBuffers && whiteLevel <= exposure && transparencyMode != TransparencyMode::Simple &&
+      sceneBufferMultisample == nullptr) {
+    return TextureFormat::SRGB8_ALPHA8;
+  }
+  return TextureFormat::RGBA16F;
+}
+
+void Engine::updateSceneColorFormat() {
+  TextureFormat format = sceneColorFormat();
+  if (sceneColor->getFormat() == format) return;
+  sceneColor->setFormat(format);
+  staticLayerColor->setFormat(format);
+  sceneColorFinal->setFormat(format);
+  staticLayerValid = false;
+  temporalSamples = 0;
+}
+
+bool Engine::multisampleActive() {
+  return sceneBufferMultisample != nullptr && transparencyMode == TransparencyMode::None;
+}
+
+bool Engine::temporalAccumulationPending() {
+  return options::temporalAntiAliasingFrames > 1 && temporalSamples > 0 &&
+         temporalSamples < options::temporalAntiAliasingFrames;
+}
+
+glm::vec2 Engine::temporalJitter() {
+  // Halton (2,3) points, which cover the pixel evenly for any number of frames
+  auto halton = [](int i, int base) {
+    float f = 1.;
+    float r = 0.;
+    for (; i > 0; i /= base) {
+      f /= base;
+      r += f * (i % base);
+    }
+    return r;
+  };
+  return glm::vec2{halton(temporalSamples, 2), halton(temporalSamples, 3)} - 0.5f;
+}
+
+void Engine::accumulateTemporalSample() {
+  if (options::temporalAntiAliasingFrames <= 1) {
+    temporalSamples = 0;
+    return;
+  }
+
+  if (!temporalBuffer) {
+    unsigned int sizeX = sceneBufferSize(view::bufferWidth);
+    unsigned int sizeY = sceneBufferSize(view::bufferHeight);
+    temporalColor = generateTextureBuffer(TextureFormat::RGBA16F, sizeX, sizeY);
+    temporalBuffer = generateFrameBuffer(sizeX, sizeY);
+    temporalBuffer->addColorBuffer(temporalColor);
+    temporalBuffer->setDrawBuffers();
+    temporalBuffer->setViewport(0, 0, sizeX, sizeY);
+
+    temporalAccumulate = requestShader("TEMPORAL_ACCUMULATE", {}, render::ShaderReplacementDefaults::Process);
+    temporalAccumulate->setAttribute("a_position", screenTrianglesCoords());
+    temporalAccumulate->setTextureFromBuffer("t_image", sceneColorFinal.get());
+    temporalAccumulate->setTextureFromBuffer("t_history", temporalColor.get());
+  }
+
+  if (temporalSamples == 0) {
+    sceneBufferFinal->blitTo(temporalBuffer.get());
+  } else {
+    // The average can't be written in place, so it is formed in the (no longer needed) scene buffer and copied back
+    if (!sceneBuffer->bindForRendering()) return;
+    setDepthMode(DepthMode::Disable);
+    setBlendMode(BlendMode::Disable);
+    temporalAccumulate->setUniform("u_weight", 1.f / (temporalSamples + 1));
+    temporalAccumulate->draw();
+    sceneBuffer->blitTo(temporalBuffer.get());
+  }
+  temporalSamples++;
+}
+
+bool Engine::testBoxVisibility(glm::vec3 boxMin, glm::vec3 boxMax, OcclusionQuery& query) {
+  glm::mat4 V = view::viewMat;
+  glm::mat4 P = view::getCameraPerspectiveMatrix();
+
+  // A box reaching in front of the near plane is clipped there, and might pass no samples while covering the view
+  glm::mat4 PV = P * V;
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 c{(i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z};
+    glm::vec4 clip = PV * glm::vec4(c, 1.);
+    if (clip.z < -clip.w) return false;
+  }
+
+  if (!occlusionBoxProgram) {
+    occlusionBoxProgram = requestShader("OCCLUSION_BOX", {}, ShaderReplacementDefaults::Process);
+    std::vector<glm::vec3> unitCube;
+    for (const glm::vec4& c : distantCubeCoords()) {
+      unitCube.push_back(0.5f * (glm::vec3(c) + 1.f));
+    }
+    occlusionBoxProgram->setAttribute("a_position", unitCube);
+  }
+  occlusionBoxProgram->setUniform("u_viewMatrix", glm::value_ptr(V));
+  occlusionBoxProgram->setUniform("u_projMatrix", glm::value_ptr(P));
+  occlusionBoxProgram->setUniform("u_boxMin", boxMin);
+  occlusionBoxProgram->setUniform("u_boxMax", boxMax);
+
+  setDepthMode(DepthMode::LEqualReadOnly);
+  setBlendMode(BlendMode::Disable);
+  setColorMask({false, false, false, false});
+  setBackfaceCull(false); // (either side will do)
+  query.begin();
+  occlusionBoxProgram->draw();
+  query.end();
+  setColorMask();
+  return true;
+}
+
 int Engine::getSSAAFactor() { return ssaaFactor; }
 
+void Engine::setRenderScale(float newVal) {
+  // the resolve filters at most 4x4 taps per display pixel
+  newVal = std::min(newVal, 4.f / ssaaFactor);
+  newVal = std::max(newVal, 0.1f);
+  if (newVal == renderScale) return;
+  renderScale = newVal;
+  currLightingSampleLevel = -1; // switch the resolve between the box filter and resampling
+  updateWindowSize(true);
+  requestRedraw();
+}
+
+float Engine::getRenderScale() { return renderScale; }
+
+float Engine::getSceneScale() { return ssaaFactor * renderScale; }
+
+unsigned int Engine::sceneBufferSize(unsigned int displaySize) {
+  if (renderScale == 1.f) return ssaaFactor * displaySize;
+  return std::max(static_cast<unsigned int>(std::lround(getSceneScale() * displaySize)), 1u);
+}
+
+void Engine::updateRenderScale() {
+  if (options::targetFrameTimeMs <= 0. || useAltDisplayBuffer) {
+    // off, or a screenshot, which is always taken at full resolution
+    setRenderScale(1.);
+    return;
+  }
+
+  // Look at each timed frame once, and only at those which rendered the scene
+  if (renderScaleTimingFrame == gpuTimingFramesRecorded) return;
+  renderScaleTimingFrame = gpuTimingFramesRecorded;
+  const std::vector<GPUTiming>& timings = gpuTimingHistory.back();
+  double frameMs = 0.;
+  bool renderedScene = false;
+  for (const GPUTiming& t : timings) {
+    if (t.depth != 0) continue;
+    frameMs += t.durationMs;
+    renderedScene |= t.name == "scene";
+  }
+  if (!renderedScene) return;
+  if (renderScaleCooldown > 0) {
+    renderScaleCooldown--;
+    return;
+  }
+
+  // Hysteresis: nothing changes while the time is in a band around the target. Outside it, aim for the target
+  // assuming the time goes with the number of pixels, in limited steps, since the time is noisy.
+  double target = options::targetFrameTimeMs;
+  if (frameMs <= 1.1 * target && frameMs >= 0.7 * target) return;
+  double step = std::sqrt(target / std::max(frameMs, 1e-3));
+  step = glm::clamp(step, 0.8, 1.25);
+  float newScale = glm::clamp(static_cast<float>(renderScale * step), options::renderScaleMin, options::renderScaleMax);
+  if (std::abs(newScale - renderScale) < 0.02f * renderScale) return; // not worth reallocating the buffers
+  setRenderScale(newScale);
+  renderScaleCooldown = 3; // (results arrive a few frames late)
+}
+
+void Engine::setInteractiveQuality(bool newVal) {
+  if (newVal == interactiveQuality) return;
+  interactiveQuality = newVal;
+  int newFactor = interactiveQuality ? 1 : options::ssaaFactor;
+  if (newFactor != ssaaFactor) setSSAAFactor(newFactor);
+  displayCacheValid = false;
+}
+
 void Engine::allocateGlobalBuffersAndPrograms() {
+  ScopedStartupPhase startupTimer("allocateGlobalBuffersAndPrograms");
 
   // Note: The display frame buffer should be manually wrapped by child classes
 
   { // Scene buffer
 
     // Note that this is basically duplicated in ground_plane.cpp, changes here should probably be reflected there
-    sceneColor = generateTextureBuffer(TextureFormat::RGBA16F, view::bufferWidth, view::bufferHeight);
+    sceneColor = generateTextureBuffer(sceneColorFormat(), view::bufferWidth, view::bufferHeight);
     // sceneDepth = generateRenderBuffer(RenderBufferType::Depth, view::bufferWidth, view::bufferHeight);
     sceneDepth = generateTextureBuffer(TextureFormat::DEPTH24, view::bufferWidth, view::bufferHeight);
 
@@ -528,6 +1424,16 @@ void Engine::allocateGlobalBuffersAndPrograms() {
     sceneBuffer->clearAlpha = 0.0;
   }
 
+  { // Cached layer of static structures, copied in to the scene buffer (same formats, for exact copies)
+    staticLayerColor = generateTextureBuffer(sceneColorFormat(), view::bufferWidth, view::bufferHeight);
+    staticLayerDepth = generateTextureBuffer(TextureFormat::DEPTH24, view::bufferWidth, view::bufferHeight);
+
+    staticLayerBuffer = generateFrameBuffer(view::bufferWidth, view::bufferHeight);
+    staticLayerBuffer->addColorBuffer(staticLayerColor);
+    staticLayerBuffer->addDepthBuffer(staticLayerDepth);
+    staticLayerBuffer->setDrawBuffers();
+  }
+
   { // Alternate depth texture used for some effects
     sceneDepthMin = generateTextureBuffer(TextureFormat::DEPTH24, view::bufferWidth, view::bufferHeight);
 
@@ -536,8 +1442,37 @@ void Engine::allocateGlobalBuffersAndPrograms() {
     sceneDepthMinFrame->clearDepth = 0.0;
   }
 
+  { // Accumulation buffer for weighted-blended transparency
+    sceneWeightedColor = generateTextureBuffer(TextureFormat::RGBA16F, view::bufferWidth, view::bufferHeight);
+    sceneWeightedRevealage = generateTextureBuffer(TextureFormat::R16F, view::bufferWidth, view::bufferHeight);
+
+    sceneBufferWeighted = generateFrameBuffer(view::bufferWidth, view::bufferHeight);
+    sceneBufferWeighted->addColorBuffer(sceneWeightedColor);
+    sceneBufferWeighted->addColorBuffer(sceneWeightedRevealage);
+    sceneBufferWeighted->addDepthBuffer(sceneDepth);
+    sceneBufferWeighted->setDrawBuffers();
+
+    sceneBufferWeighted->clearColor = glm::vec3{0., 0., 0.};
+    sceneBufferWeighted->clearAlpha = 0.0;
+  }
+
+  { // G-buffer for deferred shading, sharing the scene depth
+    // (the albedo is clamped to [0,1] before lighting, so 8 bits are enough)
+    sceneDeferredAlbedo = generateTextureBuffer(TextureFormat::SRGB8_ALPHA8, view::bufferWidth, view::bufferHeight);
+    sceneDeferredGBuffer = generateTextureBuffer(TextureFormat::RGBA16F, view::bufferWidth, view::bufferHeight);
+
+    sceneBufferDeferred = generateFrameBuffer(view::bufferWidth, view::bufferHeight);
+    sceneBufferDeferred->addColorBuffer(sceneDeferredAlbedo);
+    sceneBufferDeferred->addColorBuffer(sceneDeferredGBuffer);
+    sceneBufferDeferred->addDepthBuffer(sceneDepth);
+    sceneBufferDeferred->setDrawBuffers();
+
+    sceneBufferDeferred->clearColor = glm::vec3{0., 0., 0.};
+    sceneBufferDeferred->clearAlpha = 0.0;
+  }
+
   { // "Final" scene buffer (after resolving)
-    sceneColorFinal = generateTextureBuffer(TextureFormat::RGBA16F, view::bufferWidth, view::bufferHeight);
+    sceneColorFinal = generateTextureBuffer(sceneColorFormat(), view::bufferWidth, view::bufferHeight);
 
     sceneBufferFinal = generateFrameBuffer(view::bufferWidth, view::bufferHeight);
     sceneBufferFinal->addColorBuffer(sceneColorFinal);
@@ -562,6 +1497,15 @@ void Engine::allocateGlobalBuffersAndPrograms() {
     displayBufferAlt->clearAlpha = 0.0;
   }
 
+  { // Copy of the display, see resolveSceneToDisplay()
+    std::shared_ptr<RenderBuffer> displayCacheColor =
+        generateRenderBuffer(RenderBufferType::ColorAlpha, view::bufferWidth, view::bufferHeight);
+
+    displayCache = generateFrameBuffer(view::bufferWidth, view::bufferHeight);
+    displayCache->addColorBuffer(displayCacheColor);
+    displayCache->setDrawBuffers();
+  }
+
   { // Pick buffer
     pickColorBuffer = generateRenderBuffer(RenderBufferType::Float4, view::bufferWidth, view::bufferHeight);
     pickDepthBuffer = generateRenderBuffer(RenderBufferType::Depth, view::bufferWidth, view::bufferHeight);
@@ -593,6 +1537,21 @@ void Engine::allocateGlobalBuffersAndPrograms() {
     compositePeel->setAttribute("a_position", screenTrianglesCoords());
     compositePeel->setTextureFromBuffer("t_image", sceneColor.get());
 
+    compositeWeighted = render::engine->requestShader("COMPOSITE_WEIGHTED", {}, render::ShaderReplacementDefaults::Process);
+    compositeWeighted->setAttribute("a_position", screenTrianglesCoords());
+    compositeWeighted->setTextureFromBuffer("t_image", sceneWeightedColor.get());
+    compositeWeighted->setTextureFromBuffer("t_revealage", sceneWeightedRevealage.get());
+
+    deferredLighting = render::engine->requestShader("DEFERRED_LIGHTING", {}, render::ShaderReplacementDefaults::Process);
+    deferredLighting->setAttribute("a_position", screenTrianglesCoords());
+    deferredLighting->setTextureFromBuffer("t_albedo", sceneDeferredAlbedo.get());
+    deferredLighting->setTextureFromBuffer("t_gbuffer", sceneDeferredGBuffer.get());
+
+    eyeDomeLighting = render::engine->requestShader("EYE_DOME_LIGHTING", {}, render::ShaderReplacementDefaults::Process);
+    eyeDomeLighting->setAttribute("a_position", screenTrianglesCoords());
+    eyeDomeLighting->setTextureFromBuffer("t_image", sceneColor.get());
+    eyeDomeLighting->setTextureFromBuffer("t_depth", sceneDepth.get());
+
     copyDepth = render::engine->requestShader("DEPTH_COPY", {}, render::ShaderReplacementDefaults::Process);
     copyDepth->setAttribute("a_position", screenTrianglesCoords());
     copyDepth->setTextureFromBuffer("t_depth", sceneDepth.get());
@@ -605,48 +1564,79 @@ void Engine::allocateGlobalBuffersAndPrograms() {
   }
 }
 
-void Engine::addSlicePlane(std::string uniquePostfix) {
-
-  // NOTE: Unfortunately, the logic here and in slice_plane.cpp depends on the names constructed from the postfix being
-  // identical.
+void Engine::addSlicePlane() {
+  if (slicePlaneCount >= MAX_SLICE_PLANES) {
+    throw std::runtime_error("cannot add slice plane, at most " + std::to_string(MAX_SLICE_PLANES) +
+                             " slice planes can exist at once (render::MAX_SLICE_PLANES)");
+  }
 
-  createSlicePlaneFliterRule(uniquePostfix);
   slicePlaneCount++;
 
-  // Add rules
-  std::vector<std::string> newRules{"SLICE_PLANE_CULL_" + uniquePostfix};
-  defaultRules_sceneObject.insert(defaultRules_sceneObject.end(), newRules.begin(), newRules.end());
-  defaultRules_pick.insert(defaultRules_pick.end(), newRules.begin(), newRules.end());
-
-  // Regenerate everything
-  polyscope::refresh();
+  // All planes share a single rule driven by uniforms, so programs only need to be regenerated when the first plane
+  // shows up
+  if (slicePlaneCount == 1) {
+    defaultRules_sceneObject.push_back("SLICE_PLANE_CULL");
+    defaultRules_pick.push_back("SLICE_PLANE_CULL");
+    polyscope::refresh();
+  }
 }
 
-void Engine::removeSlicePlane(std::string uniquePostfix) {
+void Engine::removeSlicePlane() {
 
   slicePlaneCount--;
-  // Remove the (last occurence of the) rules we added
-  std::vector<std::string> newRules{"SLICE_PLANE_CULL_" + uniquePostfix};
-  auto deleteLast = [&](std::vector<std::string>& vec, std::string target) {
-    for (size_t i = vec.size(); i > 0; i--) {
-      if (vec[i - 1] == target) {
-        vec.erase(vec.begin() + (i - 1));
-        return;
+
+  // Once the last plane is gone, drop the rule so programs stop paying for the filter
+  if (slicePlaneCount == 0) {
+    auto deleteLast = [&](std::vector<std::string>& vec, std::string target) {
+      for (size_t i = vec.size(); i > 0; i--) {
+        if (vec[i - 1] == target) {
+          vec.erase(vec.begin() + (i - 1));
+          return;
+        }
       }
-    }
-  };
-  for (std::string r : newRules) {
-    deleteLast(defaultRules_sceneObject, r);
-    deleteLast(defaultRules_pick, r);
+    };
+    deleteLast(defaultRules_sceneObject, "SLICE_PLANE_CULL");
+    deleteLast(defaultRules_pick, "SLICE_PLANE_CULL");
+    polyscope::refresh();
   }
+}
 
-  // Don't bother undoing the createRule(), since it doesn't really hurt to leave it around
+bool Engine::slicePlanesEnabled() { return slicePlaneCount > 0; }
 
-  // Regenerate everything
+void Engine::setImpostorDepthPrepass(bool newVal) {
+  if (newVal == impostorDepthPrepass) return;
+  impostorDepthPrepass = newVal;
+  if (newVal) {
+    defaultRules_sceneObject.push_back("IMPOSTOR_DEPTH_PREPASS");
+  } else {
+    defaultRules_sceneObject.erase(
+        std::remove(defaultRules_sceneObject.begin(), defaultRules_sceneObject.end(), "IMPOSTOR_DEPTH_PREPASS"),
+        defaultRules_sceneObject.end());
+  }
   polyscope::refresh();
 }
 
-bool Engine::slicePlanesEnabled() { return slicePlaneCount > 0; }
+bool Engine::impostorDepthPrepassEnabled() { return impostorDepthPrepass; }
+
+void Engine::setDeferredShading(bool newVal) {
+  if (newVal == deferredShading) return;
+  deferredShading = newVal;
+
+  // The deferred lighting rule also lights forward, for the passes which are not deferred, so it replaces the usual one
+  std::replace(defaultRules_sceneObject.begin(), defaultRules_sceneObject.end(),
+               std::string(newVal ? "LIGHT_MATCAP" : "LIGHT_DEFERRED"),
+               std::string(newVal ? "LIGHT_DEFERRED" : "LIGHT_MATCAP"));
+  polyscope::refresh();
+}
+
+bool Engine::deferredShadingActive() {
+  return deferredShading && transparencyMode == TransparencyMode::None && !multisampleActive();
+}
+
+bool Engine::useInstancedDrawing(size_t nElements) {
+  if (options::instancedDrawingThreshold < 0) return false;
+  return nElements >= static_cast<size_t>(options::instancedDrawingThreshold);
+}
 
 
 std::vector<glm::vec3> Engine::screenTrianglesCoords() {
@@ -709,74 +1699,218 @@ void Engine::updateMinDepthTexture() {
   copyDepth->draw();
 }
 
+std::pair<double, double> Engine::reduceMinMax(ShaderProgram& program) {
+  if (!reductionBuffer) {
+    reductionBuffer = generateFrameBuffer(1, 1);
+    reductionBuffer->addColorBuffer(generateRenderBuffer(RenderBufferType::Float4, 1, 1));
+    reductionBuffer->setDrawBuffers();
+    reductionBuffer->setViewport(0, 0, 1, 1);
+    float lowest = std::numeric_limits<float>::lowest();
+    reductionBuffer->clearColor = glm::vec3{lowest, lowest, 0.};
+    reductionBuffer->clearAlpha = 0.;
+  }
+
+  reductionBuffer->clear();
+  if (!reductionBuffer->bindForRendering()) return std::make_pair(0., 0.);
+  setDepthMode(DepthMode::Disable);
+  setBlendMode(BlendMode::Max);
+  program.draw();
+  setBlendMode(BlendMode::Over); // (the other modes do not expect the max equation)
+  std::array<float, 4> result = reductionBuffer->readFloat4(0, 0);
+
+  double low = -result[1];
+  double high = result[0];
+  if (!(low <= high)) return std::make_pair(0., 0.); // nothing drawn
+  return std::make_pair(low, high);
+}
+
+void Engine::reduceBoundsAsync(ShaderProgram& program, std::function<void(glm::vec3, glm::vec3)> onResult) {
+  if (!boundsReductionBuffer) {
+    boundsReductionBuffer = generateFrameBuffer(2, 1);
+    boundsReductionBuffer->addColorBuffer(generateRenderBuffer(RenderBufferType::Float4, 2, 1));
+    boundsReductionBuffer->setDrawBuffers();
+    boundsReductionBuffer->setViewport(0, 0, 2, 1);
+    float lowest = std::numeric_limits<float>::lowest();
+    boundsReductionBuffer->clearColor = glm::vec3{lowest, lowest, lowest};
+    boundsReductionBuffer->clearAlpha = 0.;
+  }
 
-// Helper (TODO rework to load custom materials)
-void Engine::loadDefaultMaterial(std::string name) {
+  boundsReductionBuffer->clear();
+  if (!boundsReductionBuffer->bindForRendering()) return;
+  setDepthMode(DepthMode::Disable);
+  setBlendMode(BlendMode::Max);
+  program.setUniform("u_reduceSign", 1.f);
+  program.draw();
+  program.setUniform("u_reduceSign", -1.f);
+  program.draw();
+  setBlendMode(BlendMode::Over); // (the other modes do not expect the max equation)
+
+  PendingReduction reduction;
+  reduction.high = boundsReductionBuffer->readFloat4Async(0, 0);
+  reduction.negatedLow = boundsReductionBuffer->readFloat4Async(1, 0);
+  reduction.onResult = std::move(onResult);
+  pendingReductions.push_back(std::move(reduction));
+  polyscope::requestRedraw(); // (so that the result is picked up, see processPendingReductions())
+}
+
+void Engine::processPendingReductions() {
+  // Take out the finished ones first, since their callbacks may start others
+  std::vector<PendingReduction> finished;
+  std::vector<PendingReduction> stillPending;
+  for (PendingReduction& r : pendingReductions) {
+    if (r.high->isReady() && r.negatedLow->isReady()) {
+      finished.push_back(std::move(r));
+    } else {
+      stillPending.push_back(std::move(r));
+    }
+  }
+  pendingReductions = std::move(stillPending);
+  if (!pendingReductions.empty()) polyscope::requestRedraw();
+
+  for (PendingReduction& r : finished) {
+    std::array<float, 4> high = r.high->getValue();
+    std::array<float, 4> negatedLow = r.negatedLow->getValue();
+    glm::vec3 lowVec{-negatedLow[0], -negatedLow[1], -negatedLow[2]};
+    glm::vec3 highVec{high[0], high[1], high[2]};
+    if (!(lowVec.x <= highVec.x)) continue; // nothing drawn
+    r.onResult(lowVec, highVec);
+  }
+}
+
+bool Engine::bindWeightedTransparencyBuffer() {
+  setCurrentPixelScaling(ssaaFactor);
+  return sceneBufferWeighted->bindForRendering();
+}
+
+bool Engine::bindDeferredBuffer() {
+  setCurrentPixelScaling(getSceneScale());
+  return sceneBufferDeferred->bindForRendering();
+}
+
+void Engine::resolveDeferredShading() {
+  // One pass per material, each lighting the pixels drawn with it and discarding the others. Only materials which have
+  // been loaded can have been drawn with.
+  bindSceneBuffer();
+  setDepthMode(DepthMode::Disable);
+  setBlendMode(BlendMode::Disable);
+  for (size_t i = 0; i < materials.size(); i++) {
+    if (!materials[i]->loaded) continue;
+    deferredLighting->setUniform("u_materialIndex", static_cast<float>(i));
+    deferredLighting->setTextureFromBuffer("t_mat_r", materials[i]->textureBuffers[0].get());
+    deferredLighting->setTextureFromBuffer("t_mat_g", materials[i]->textureBuffers[1].get());
+    deferredLighting->setTextureFromBuffer("t_mat_b", materials[i]->textureBuffers[2].get());
+    deferredLighting->setTextureFromBuffer("t_mat_k", materials[i]->textureBuffers[3].get());
+    deferredLighting->draw();
+  }
+  applyTransparencySettings();
+}
+
+void Engine::resolveWeightedTransparency() {
+  // Normalize the accumulated color by the accumulated weight, and composite it over whatever is already in the
+  // scene buffer (ground plane etc) with coverage given by the product of (1 - alpha) over all layers.
+  bindSceneBuffer();
+  setDepthMode(DepthMode::Disable);
+  setBlendMode(BlendMode::AlphaOver);
+  compositeWeighted->draw();
+}
 
+
+void Engine::registerDefaultMaterial(std::string name, bool supportsRGB) {
   Material* newMaterial = new Material();
   newMaterial->name = name;
+  newMaterial->supportsRGB = supportsRGB;
+  newMaterial->loaded = false;
+  materials.emplace_back(newMaterial);
+}
 
+// Helper (TODO rework to load custom materials)
+void Engine::loadDefaultMaterialTextures(Material& material) {
+  const std::string& name = material.name;
+
+  // The bundled matcaps are Radiance (RGBE) images. Blendable materials have one for each of their _r, _g, _b, _k
+  // components, the others a single image used for all four.
   std::array<unsigned char const*, 4> buff;
   std::array<size_t, 4> buffSize;
+  size_t nImages = 4;
 
   // clang-format off
-  if(name == "clay") {
-    newMaterial->supportsRGB = true;
+  if(false) {}
+#ifdef POLYSCOPE_EMBED_MATERIAL_CLAY
+  else if(name == "clay") {
     buff[0] = &bindata_clay_r[0]; buffSize[0] = bindata_clay_r.size();
     buff[1] = &bindata_clay_g[0]; buffSize[1] = bindata_clay_g.size();
     buff[2] = &bindata_clay_b[0]; buffSize[2] = bindata_clay_b.size();
     buff[3] = &bindata_clay_k[0]; buffSize[3] = bindata_clay_k.size();
   }
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_WAX
   else if(name == "wax") {
-    newMaterial->supportsRGB = true;
     buff[0] = &bindata_wax_r[0]; buffSize[0] = bindata_wax_r.size();
     buff[1] = &bindata_wax_g[0]; buffSize[1] = bindata_wax_g.size();
     buff[2] = &bindata_wax_b[0]; buffSize[2] = bindata_wax_b.size();
     buff[3] = &bindata_wax_k[0]; buffSize[3] = bindata_wax_k.size();
   }
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_CANDY
   else if(name == "candy") {
-    newMaterial->supportsRGB = true;
     buff[0] = &bindata_candy_r[0]; buffSize[0] = bindata_candy_r.size();
     buff[1] = &bindata_candy_g[0]; buffSize[1] = bindata_candy_g.size();
     buff[2] = &bindata_candy_b[0]; buffSize[2] = bindata_candy_b.size();
     buff[3] = &bindata_candy_k[0]; buffSize[3] = bindata_candy_k.size();
   }
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_FLAT
   else if(name == "flat") {
-    newMaterial->supportsRGB = true;
     buff[0] = &bindata_flat_r[0]; buffSize[0] = bindata_flat_r.size();
     buff[1] = &bindata_flat_g[0]; buffSize[1] = bindata_flat_g.size();
     buff[2] = &bindata_flat_b[0]; buffSize[2] = bindata_flat_b.size();
     buff[3] = &bindata_flat_k[0]; buffSize[3] = bindata_flat_k.size();
   } 
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_MUD
   else if(name == "mud") {
-    newMaterial->supportsRGB = false;
-    for(int i = 0; i < 4; i++) {buff[i] = &bindata_mud[0]; buffSize[i] = bindata_mud.size();}
-	}
+    buff[0] = &bindata_mud[0]; buffSize[0] = bindata_mud.size(); nImages = 1;
+  }
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_CERAMIC
   else if(name == "ceramic") {
-    newMaterial->supportsRGB = false;
-    for(int i = 0; i < 4; i++) {buff[i] = &bindata_ceramic[0]; buffSize[i] = bindata_ceramic.size();}
-	}
+    buff[0] = &bindata_ceramic[0]; buffSize[0] = bindata_ceramic.size(); nImages = 1;
+  }
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_JADE
   else if(name == "jade") {
-    newMaterial->supportsRGB = false;
-    for(int i = 0; i < 4; i++) {buff[i] = &bindata_jade[0]; buffSize[i] = bindata_jade.size();}
-	}
+    buff[0] = &bindata_jade[0]; buffSize[0] = bindata_jade.size(); nImages = 1;
+  }
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_NORMAL
   else if(name == "normal") {
-    newMaterial->supportsRGB = false;
-    for(int i = 0; i < 4; i++) {buff[i] = &bindata_normal[0]; buffSize[i] = bindata_normal.size();}
-	} else {
+    buff[0] = &bindata_normal[0]; buffSize[0] = bindata_normal.size(); nImages = 1;
+  }
+#endif
+  else {
     throw std::runtime_error("unrecognized default material name " + name);
   }
   // clang-format on
 
-  for (int i = 0; i < 4; i++) {
-    int width, height, nComp;
-    float* data = stbi_loadf_from_memory(buff[i], buffSize[i], &width, &height, &nComp, 3);
-    if (!data) polyscope::error("failed to load material");
-    newMaterial->textureBuffers[i] = loadMaterialTexture(data, width, height);
-    stbi_image_free(data);
+  // Decode the images in parallel, then upload them here on the render thread
+  std::array<float*, 4> data;
+  std::array<int, 4> width, height;
+  parallelFor(
+      0, nImages,
+      [&](size_t i) {
+        int nComp;
+        data[i] = stbi_loadf_from_memory(buff[i], static_cast<int>(buffSize[i]), &width[i], &height[i], &nComp, 3);
+      },
+      1);
+  for (size_t i = 0; i < nImages; i++) {
+    if (!data[i]) polyscope::error("failed to load material");
+    material.textureBuffers[i] = loadMaterialTexture(data[i], width[i], height[i]);
+    stbi_image_free(data[i]);
   }
-
-  materials.emplace_back(newMaterial);
+  for (size_t i = nImages; i < 4; i++) {
+    material.textureBuffers[i] = material.textureBuffers[0]; // (sampled four times, stored once)
+  }
+  material.loaded = true;
 }
 
 void Engine::loadBlendableMaterial(std::string matName, std::array<std::string, 4> filenames) {
@@ -821,17 +1955,18 @@ void Engine::loadStaticMaterial(std::string matName, std::string filename) {
   newMaterial->supportsRGB = false;
   materials.emplace_back(newMaterial);
 
-  // Load each of the four components
-  for (int i = 0; i < 4; i++) {
-    int width, height, nComp;
-    float* data = stbi_loadf(filename.c_str(), &width, &height, &nComp, 3);
-    if (!data) {
-      polyscope::warning("failed to load material from " + filename);
-      materials.pop_back();
-      return;
-    }
-    newMaterial->textureBuffers[i] = loadMaterialTexture(data, width, height);
-    stbi_image_free(data);
+  // The one image serves as all four components
+  int width, height, nComp;
+  float* data = stbi_loadf(filename.c_str(), &width, &height, &nComp, 3);
+  if (!data) {
+    polyscope::warning("failed to load material from " + filename);
+    materials.pop_back();
+    return;
+  }
+  newMaterial->textureBuffers[0] = loadMaterialTexture(data, width, height);
+  stbi_image_free(data);
+  for (int i = 1; i < 4; i++) {
+    newMaterial->textureBuffers[i] = newMaterial->textureBuffers[0];
   }
 }
 
@@ -843,26 +1978,53 @@ void Engine::loadBlendableMaterial(std::string matName, std::string filenameBase
 }
 
 std::shared_ptr<TextureBuffer> Engine::loadMaterialTexture(float* data, int width, int height) {
-  std::shared_ptr<TextureBuffer> t = engine->generateTextureBuffer(TextureFormat::RGB16F, width, height, data);
+  std::shared_ptr<TextureBuffer> t = engine->generateTextureBuffer(TextureFormat::BC6H_RGB16F, width, height, data);
   t->setFilterMode(FilterMode::Linear);
   return t;
 }
 
 void Engine::loadDefaultMaterials() {
-  loadDefaultMaterial("clay");
-  loadDefaultMaterial("wax");
-  loadDefaultMaterial("candy");
-  loadDefaultMaterial("flat");
-  loadDefaultMaterial("mud");
-  loadDefaultMaterial("ceramic");
-  loadDefaultMaterial("jade");
-  loadDefaultMaterial("normal");
+  ScopedStartupPhase startupTimer("loadDefaultMaterials");
+  // (only those embedded in this build, see POLYSCOPE_EMBEDDED_MATERIALS)
+#ifdef POLYSCOPE_EMBED_MATERIAL_CLAY
+  registerDefaultMaterial("clay", true);
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_WAX
+  registerDefaultMaterial("wax", true);
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_CANDY
+  registerDefaultMaterial("candy", true);
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_FLAT
+  registerDefaultMaterial("flat", true);
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_MUD
+  registerDefaultMaterial("mud", false);
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_CERAMIC
+  registerDefaultMaterial("ceramic", false);
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_JADE
+  registerDefaultMaterial("jade", false);
+#endif
+#ifdef POLYSCOPE_EMBED_MATERIAL_NORMAL
+  registerDefaultMaterial("normal", false);
+#endif
 }
 
 
 Material& Engine::getMaterial(const std::string& name) {
   for (std::unique_ptr<Material>& m : materials) {
-    if (name == m->name) return *m;
+    if (name == m->name) {
+      if (!m->loaded) loadDefaultMaterialTextures(*m);
+      return *m;
+    }
+  }
+
+  // Bundled materials left out of this build stand in as the default one, so that structures and widgets which use
+  // them still draw
+  for (const char* bundled : {"wax", "candy", "flat", "mud", "ceramic", "jade", "normal"}) {
+    if (name == bundled) return getMaterial("clay");
   }
 
   throw std::runtime_error("unrecognized material name: " + name);
@@ -908,28 +2070,94 @@ void Engine::loadColorMap(std::string cmapName, std::string filename) {
 
 const ValueColorMap& Engine::getColorMap(const std::string& name) {
   for (auto& cmap : colorMaps) {
-    if (name == cmap->name) return *cmap;
+    if (name == cmap->name) {
+      if (!cmap->loaded) loadDefaultColorMapValues(*cmap);
+      return *cmap;
+    }
   }
 
   throw std::runtime_error("unrecognized colormap name: " + name);
   return *colorMaps[0];
 }
 
+void Engine::updateColorMap(std::string cmapName, const std::vector<glm::vec3>& values) {
+  if (values.empty()) {
+    polyscope::warning("colormap " + cmapName + " must have at least one value");
+    return;
+  }
 
-void Engine::configureImGui() {
+  ValueColorMap* cmap = nullptr;
+  for (auto& c : colorMaps) {
+    if (cmapName == c->name) {
+      cmap = c.get();
+      break;
+    }
+  }
+  if (cmap == nullptr) {
+    cmap = new ValueColorMap();
+    cmap->name = cmapName;
+    colorMaps.emplace_back(cmap);
+  }
+  cmap->values = values;
+  cmap->loaded = true;
 
-  if (options::prepareImGuiFontsCallback) {
-    std::tie(globalFontAtlas, regularFont, monoFont) = options::prepareImGuiFontsCallback();
+  // Update the shared texture in place, so the programs drawing from it need not change
+  if (cmap->texture) {
+    if (cmap->texture->getSizeX() != values.size()) {
+      cmap->texture->resize(values.size());
+    }
+    cmap->texture->setData1D(0, values.size(), &values[0][0]);
   }
 
+  requestRedraw();
+}
+
+std::shared_ptr<TextureBuffer> Engine::getColorMapTexture(const std::string& name) {
+  getColorMap(name); // (fills in the values of a bundled colormap, and throws for an unknown name)
+  for (auto& cmap : colorMaps) {
+    if (name != cmap->name) continue;
+    if (!cmap->texture) {
+      ScopedGPUMemoryAccount sharedAccount(nullptr); // (shared by all structures, so charged to none of them)
+      cmap->texture = generateTextureBuffer(TextureFormat::RGB32F, cmap->values.size(), &cmap->values[0][0]);
+      cmap->texture->setFilterMode(FilterMode::Linear);
+    }
+    return cmap->texture;
+  }
+  return nullptr;
+}
+
+
+void Engine::configureImGui() {
+
+  // (contexts pushed before the fonts are prepared share this atlas, which ensureImGuiFonts() fills in)
+  globalFontAtlas = ImGui::GetIO().Fonts;
+  imguiFontsPrepared = false;
+
 
   if (options::configureImGuiStyleCallback) {
     options::configureImGuiStyleCallback();
   }
 }
 
-void Engine::loadDefaultColorMap(std::string name) {
+void Engine::ensureImGuiFonts() {
+  if (imguiFontsPrepared) return;
+  imguiFontsPrepared = true;
 
+  if (options::prepareImGuiFontsCallback) {
+    std::tie(globalFontAtlas, regularFont, monoFont) = options::prepareImGuiFontsCallback();
+    ImGui::GetIO().Fonts = globalFontAtlas;
+  }
+}
+
+void Engine::registerDefaultColorMap(std::string name) {
+  ValueColorMap* newMap = new ValueColorMap();
+  newMap->name = name;
+  newMap->loaded = false;
+  colorMaps.emplace_back(newMap);
+}
+
+void Engine::loadDefaultColorMapValues(ValueColorMap& colorMap) {
+  const std::string& name = colorMap.name;
   const std::vector<glm::vec3>* buff = nullptr;
   if (name == "viridis") {
     buff = &CM_VIRIDIS;
@@ -955,23 +2183,22 @@ void Engine::loadDefaultColorMap(std::string name) {
     throw std::runtime_error("unrecognized default colormap " + name);
   }
 
-  ValueColorMap* newMap = new ValueColorMap();
-  newMap->name = name;
-  newMap->values = *buff;
-  colorMaps.emplace_back(newMap);
+  colorMap.values = *buff;
+  colorMap.loaded = true;
 }
 
 void Engine::loadDefaultColorMaps() {
-  loadDefaultColorMap("viridis");
-  loadDefaultColorMap("coolwarm");
-  loadDefaultColorMap("blues");
-  loadDefaultColorMap("reds");
-  loadDefaultColorMap("pink-green");
-  loadDefaultColorMap("phase");
-  loadDefaultColorMap("spectral");
-  loadDefaultColorMap("rainbow");
-  loadDefaultColorMap("jet");
-  loadDefaultColorMap("turbo");
+  ScopedStartupPhase startupTimer("loadDefaultColorMaps");
+  registerDefaultColorMap("viridis");
+  registerDefaultColorMap("coolwarm");
+  registerDefaultColorMap("blues");
+  registerDefaultColorMap("reds");
+  registerDefaultColorMap("pink-green");
+  registerDefaultColorMap("phase");
+  registerDefaultColorMap("spectral");
+  registerDefaultColorMap("rainbow");
+  registerDefaultColorMap("jet");
+  registerDefaultColorMap("turbo");
 }
 
 
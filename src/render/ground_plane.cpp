@@ -36,6 +36,10 @@ std::tuple<int, float> getGroundPlaneAxisAndSign() {
 
   return std::tuple<int, float>{iP, sign};
 }
+
+// the tiles of a large screenshot share a view matrix, but not a projection, and viewports (see viewport.h) fill
+// different parts of the buffer
+glm::vec4 getProjectionPlacement() { return view::getViewRegionInBuffer(); }
 }; // namespace
 
 void GroundPlane::populateGroundPlaneGeometry() {
@@ -65,6 +69,7 @@ void GroundPlane::populateGroundPlaneGeometry() {
 }
 
 void GroundPlane::prepare() {
+  ScopedStartupPhase startupTimer("ground plane prepare");
   if (options::groundPlaneMode == GroundPlaneMode::None) {
     return;
   }
@@ -129,14 +134,16 @@ void GroundPlane::prepare() {
 
   if (options::groundPlaneMode == GroundPlaneMode::TileReflection) { // Mirrored scene buffer
     groundPlaneProgram->setTextureFromBuffer("t_mirrorImage", sceneAltColorTexture.get());
+    reflectionValid = false;
   }
 
 
   if (options::groundPlaneMode == GroundPlaneMode::ShadowOnly) {
     // Blur buffers and program
     for (int i = 0; i < 2; i++) {
+      // (the blurred shadow mask has no alpha)
       blurColorTextures[i] =
-          render::engine->generateTextureBuffer(TextureFormat::RGBA16F, view::bufferWidth, view::bufferHeight);
+          render::engine->generateTextureBuffer(TextureFormat::R11F_G11F_B10F, view::bufferWidth, view::bufferHeight);
       blurColorTextures[i]->setFilterMode(FilterMode::Linear);
       blurFrameBuffers[i] = render::engine->generateFrameBuffer(view::bufferWidth, view::bufferHeight);
 
@@ -154,6 +161,7 @@ void GroundPlane::prepare() {
     copyTexProgram->setTextureFromBuffer("t_depth", sceneAltDepthTexture.get());
 
     groundPlaneProgram->setTextureFromBuffer("t_shadow", blurColorTextures[0].get());
+    shadowValid = false;
   }
 
   // Respect global effects
@@ -200,7 +208,7 @@ void GroundPlane::draw(bool isRedraw) {
   // Viewport
   glm::vec4 viewport = render::engine->getCurrentViewport();
   glm::vec2 viewportDim{viewport[2], viewport[3]};
-  int factor = render::engine->getSSAAFactor();
+  float factor = render::engine->getSceneScale();
 
   auto setUniforms = [&]() {
     glm::mat4 viewMat = view::getCameraViewMatrix();
@@ -246,8 +254,10 @@ void GroundPlane::draw(bool isRedraw) {
       options::groundPlaneMode == GroundPlaneMode::ShadowOnly) {
 
 
-    sceneAltFrameBuffer->resize(factor * view::bufferWidth / 2, factor * view::bufferHeight / 2);
-    sceneAltFrameBuffer->setViewport(0, 0, factor * view::bufferWidth / 2, factor * view::bufferHeight / 2);
+    unsigned int altX = std::max(static_cast<unsigned int>(factor * view::bufferWidth / 2), 1u);
+    unsigned int altY = std::max(static_cast<unsigned int>(factor * view::bufferHeight / 2), 1u);
+    sceneAltFrameBuffer->resize(altX, altY);
+    sceneAltFrameBuffer->setViewport(0, 0, altX, altY);
     render::engine->setCurrentPixelScaling(factor / 2.);
 
     sceneAltFrameBuffer->bindForRendering();
@@ -257,15 +267,22 @@ void GroundPlane::draw(bool isRedraw) {
   */
 
   // Render the scene to implement the mirror effect
-  if (!isRedraw && options::groundPlaneMode == GroundPlaneMode::TileReflection) {
+  // (use a texture 1/4 the area of the view buffer, it's supposed to be blurry anyway and this saves perf; while the
+  // scene is changing at interactive quality, 1/16 is good enough)
+  float reflectionScaling = factor / (render::engine->interactiveQuality ? 4.f : 2.f);
+  ReflectionKey newReflectionKey{state::redrawRequestCount, view::viewMat,      getProjectionPlacement(),
+                                 view::bufferWidth,          view::bufferHeight, reflectionScaling};
+  if (!isRedraw && options::groundPlaneMode == GroundPlaneMode::TileReflection &&
+      (!reflectionValid || newReflectionKey != reflectionKey)) {
 
     // Prepare the alternate scene buffers
-    // (use a texture 1/4 the area of the view buffer, it's supposed to be blurry anyway and this saves perf)
+    unsigned int reflectionX = std::max(static_cast<int>(reflectionScaling * view::bufferWidth), 1);
+    unsigned int reflectionY = std::max(static_cast<int>(reflectionScaling * view::bufferHeight), 1);
     render::engine->setBlendMode();
     render::engine->setDepthMode();
-    sceneAltFrameBuffer->resize(factor * view::bufferWidth / 2, factor * view::bufferHeight / 2);
-    sceneAltFrameBuffer->setViewport(0, 0, factor * view::bufferWidth / 2, factor * view::bufferHeight / 2);
-    render::engine->setCurrentPixelScaling(factor / 2.);
+    sceneAltFrameBuffer->resize(reflectionX, reflectionY);
+    sceneAltFrameBuffer->setViewport(0, 0, reflectionX, reflectionY);
+    render::engine->setCurrentPixelScaling(reflectionScaling);
 
     sceneAltFrameBuffer->bindForRendering();
     sceneAltFrameBuffer->clearColor = {view::bgColor[0], view::bgColor[1], view::bgColor[2]};
@@ -296,16 +313,29 @@ void GroundPlane::draw(bool isRedraw) {
     // Restore original values
     render::engine->setFrontFaceCCW(!render::engine->getFrontFaceCCW());
     view::viewMat = origViewMat;
+
+    reflectionKey = newReflectionKey;
+    reflectionValid = true;
+    reflectionRenderCount++;
   }
 
   // Render the scene to implement the shadow effect
-  if (!isRedraw && options::groundPlaneMode == GroundPlaneMode::ShadowOnly) {
+  int nBlur = render::engine->interactiveQuality ? 0 : options::shadowBlurIters;
+  ShadowKey newShadowKey{state::redrawRequestCount, view::viewMat, getProjectionPlacement(), view::bufferWidth,
+                         view::bufferHeight,         nBlur};
+  if (!isRedraw && options::groundPlaneMode == GroundPlaneMode::ShadowOnly &&
+      (!shadowValid || newShadowKey != shadowKey)) {
 
     // Prepare the alternate scene buffers
+    // (the shadow is rendered and blurred at half the display resolution, whatever the SSAA factor, since it is blurry
+    // anyway; the ground samples it with linear filtering)
+    unsigned int shadowX = std::max(view::bufferWidth / 2, 1);
+    unsigned int shadowY = std::max(view::bufferHeight / 2, 1);
     render::engine->setBlendMode();
     render::engine->setDepthMode();
-    sceneAltFrameBuffer->resize(factor * view::bufferWidth, factor * view::bufferHeight);
-    sceneAltFrameBuffer->setViewport(0, 0, factor * view::bufferWidth, factor * view::bufferHeight);
+    sceneAltFrameBuffer->resize(shadowX, shadowY);
+    sceneAltFrameBuffer->setViewport(0, 0, shadowX, shadowY);
+    render::engine->setCurrentPixelScaling(0.5);
 
     sceneAltFrameBuffer->bindForRendering();
     sceneAltFrameBuffer->clearColor = {view::bgColor[0], view::bgColor[1], view::bgColor[2]};
@@ -313,8 +343,8 @@ void GroundPlane::draw(bool isRedraw) {
 
     // Make sure all framebuffers are the right shape
     for (int i = 0; i < 2; i++) {
-      blurFrameBuffers[i]->resize(factor * view::bufferWidth / 2, factor * view::bufferHeight / 2);
-      blurFrameBuffers[i]->setViewport(0, 0, factor * view::bufferWidth / 2, factor * view::bufferHeight / 2);
+      blurFrameBuffers[i]->resize(shadowX, shadowY);
+      blurFrameBuffers[i]->setViewport(0, 0, shadowX, shadowY);
       blurFrameBuffers[i]->clear();
     }
 
@@ -333,7 +363,7 @@ void GroundPlane::draw(bool isRedraw) {
     render::engine->setBlendMode(BlendMode::Disable);
     drawStructures();
 
-    // Copy the depth buffer to a texture (while upsampling)
+    // Copy the depth buffer to a texture
     render::engine->setBlendMode(BlendMode::Disable);
     blurFrameBuffers[0]->bindForRendering();
     copyTexProgram->draw();
@@ -341,8 +371,6 @@ void GroundPlane::draw(bool isRedraw) {
     // == Blur
 
     // Do some blur iterations (ends in same buffer it started in)
-    int nBlur = options::shadowBlurIters * render::engine->getSSAAFactor();
-    // int nBlur = 0;
     for (int i = 0; i < nBlur; i++) {
       // horizontal blur
       blurFrameBuffers[1]->bindForRendering();
@@ -359,6 +387,10 @@ void GroundPlane::draw(bool isRedraw) {
 
     // Restore original view matrix
     view::viewMat = origViewMat;
+
+    shadowKey = newShadowKey;
+    shadowValid = true;
+    shadowRenderCount++;
   }
 
   render::engine->bindSceneBuffer();
@@ -415,8 +447,14 @@ void GroundPlane::buildGui() {
     case GroundPlaneMode::TileReflection:
       break;
     case GroundPlaneMode::ShadowOnly:
-      if (ImGui::SliderFloat("Shadow Darkness", &options::shadowDarkness, .0, 1.0)) requestRedraw();
-      if (ImGui::InputInt("Blur Iterations", &options::shadowBlurIters, 1)) requestRedraw();
+      if (ImGui::SliderFloat("Shadow Darkness", options::shadowDarkness.getValuePtr(), .0, 1.0)) {
+        options::shadowDarkness.markChanged();
+        requestRedraw();
+      }
+      if (ImGui::InputInt("Blur Iterations", options::shadowBlurIters.getValuePtr(), 1)) {
+        options::shadowBlurIters.markChanged();
+        requestRedraw();
+      }
       break;
     }
 
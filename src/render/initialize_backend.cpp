@@ -1,5 +1,11 @@
 #include "polyscope/render/engine.h"
 
+#include "polyscope/options.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
 namespace polyscope {
 namespace render {
 
@@ -8,9 +14,20 @@ Engine* engine = nullptr;
 
 // Forward-declaration of initialize routines
 // we don't want to just include the appropriate headers, because they may define conflicting symbols
+#ifdef POLYSCOPE_BACKEND_OPENGL3_GLFW_ENABLED
 namespace backend_openGL3_glfw {
 void initializeRenderEngine();
 }
+namespace backend_openGL4_glfw {
+void initializeRenderEngine();
+}
+#endif
+namespace backend_openGL3_egl {
+void initializeRenderEngine();
+}
+namespace backend_openGL4_egl {
+void initializeRenderEngine();
+}
 namespace backend_openGL_mock {
 void initializeRenderEngine();
 }
@@ -18,6 +35,15 @@ void initializeRenderEngine();
 
 void initializeRenderEngine(std::string backend) {
 
+  // There is no Vulkan implementation of the engine yet. Asking for one falls back to the default openGL backend, so
+  // that programs can request it ahead of time, with a notice so they can tell which backend they got.
+  if (backend == "vulkan") {
+    if (options::verbosity > 0) {
+      std::cout << options::printPrefix << "No vulkan backend in this build, falling back to openGL" << std::endl;
+    }
+    backend = "";
+  }
+
   // Handle default backends
   // (the string is getting overwritten, so lower on the list means higher priority)
   if (backend == "") {
@@ -27,8 +53,19 @@ void initializeRenderEngine(std::string backend) {
     // backend = "mock_openGL";
 #endif
 
+#ifdef POLYSCOPE_BACKEND_OPENGL3_EGL_ENABLED
+    backend = "openGL3_egl";
+#endif
+
 #ifdef POLYSCOPE_BACKEND_OPENGL3_GLFW_ENABLED
+    // Prefer a window, unless there is obviously no display server to show it on
+#if defined(__linux__) && defined(POLYSCOPE_BACKEND_OPENGL3_EGL_ENABLED)
+    if (std::getenv("DISPLAY") != nullptr || std::getenv("WAYLAND_DISPLAY") != nullptr) {
+      backend = "openGL3_glfw";
+    }
+#else
     backend = "openGL3_glfw";
+#endif
 #endif
 
     if (backend == "") {
@@ -36,9 +73,35 @@ void initializeRenderEngine(std::string backend) {
     }
   }
 
+  // "openGL4" is the GL 4.5 variant of whichever openGL backend would be the default
+  if (backend == "openGL4") {
+#if defined(POLYSCOPE_BACKEND_OPENGL3_GLFW_ENABLED) && defined(POLYSCOPE_BACKEND_OPENGL3_EGL_ENABLED) && defined(__linux__)
+    bool haveDisplay = std::getenv("DISPLAY") != nullptr || std::getenv("WAYLAND_DISPLAY") != nullptr;
+    backend = haveDisplay ? "openGL4_glfw" : "openGL4_egl";
+#elif defined(POLYSCOPE_BACKEND_OPENGL3_EGL_ENABLED) && !defined(POLYSCOPE_BACKEND_OPENGL3_GLFW_ENABLED)
+    backend = "openGL4_egl";
+#else
+    backend = "openGL4_glfw";
+#endif
+  }
+
   // Initialize the appropriate backend
-  if (backend == "openGL3_glfw") {
-    backend_openGL3_glfw::initializeRenderEngine();
+  if (backend == "openGL3_glfw" || backend == "openGL4_glfw") {
+#ifdef POLYSCOPE_BACKEND_OPENGL3_GLFW_ENABLED
+    if (backend == "openGL3_glfw") {
+      backend_openGL3_glfw::initializeRenderEngine();
+    } else {
+      backend_openGL4_glfw::initializeRenderEngine();
+    }
+#else
+    // (this is also where programs end up which link polyscope_core, which never has the window backend)
+    throw std::runtime_error("Polyscope was not compiled with support for backend: " + backend +
+                             " (link the polyscope library, not polyscope_core, for a window)");
+#endif
+  } else if (backend == "openGL3_egl") {
+    backend_openGL3_egl::initializeRenderEngine();
+  } else if (backend == "openGL4_egl") {
+    backend_openGL4_egl::initializeRenderEngine();
   } else if (backend == "openGL_mock") {
     backend_openGL_mock::initializeRenderEngine();
   } else {
@@ -22,6 +22,7 @@
 #include "polyscope/render/opengl/shaders/surface_mesh_shaders.h"
 #include "polyscope/render/opengl/shaders/texture_draw_shaders.h"
 #include "polyscope/render/opengl/shaders/vector_shaders.h"
+#include "polyscope/render/opengl/shaders/volume_grid_shaders.h"
 #include "polyscope/render/opengl/shaders/volume_mesh_shaders.h"
 
 
@@ -45,6 +46,20 @@ void initializeRenderEngine() {
 
 void checkGLError(bool fatal = true) {}
 
+// == Account for the work that a real backend would do, see Engine::renderStats
+
+void countUpload(size_t nBytes) {
+  if (engine) engine->renderStats.uploadBytes += nBytes;
+}
+
+void countUniformSet() {
+  if (engine) engine->renderStats.uniformSets++;
+}
+
+size_t textureDataBytes(TextureFormat format, size_t nTexels, size_t bytesPerComponent) {
+  return static_cast<size_t>(dimension(format)) * nTexels * bytesPerComponent;
+}
+
 // =============================================================
 // ==================== Texture buffer =========================
 // =============================================================
@@ -54,6 +69,7 @@ GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int size1D, uns
     : TextureBuffer(1, format_, size1D) {
 
   checkGLError();
+  if (data != nullptr) countUpload(textureDataBytes(format, size1D, 1));
 
   setFilterMode(FilterMode::Nearest);
 }
@@ -61,6 +77,7 @@ GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int size1D, flo
     : TextureBuffer(1, format_, size1D) {
 
   checkGLError();
+  if (data != nullptr) countUpload(textureDataBytes(format, size1D, sizeof(float)));
 
   setFilterMode(FilterMode::Nearest);
 }
@@ -70,6 +87,7 @@ GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int sizeX_, uns
     : TextureBuffer(2, format_, sizeX_, sizeY_) {
 
   checkGLError();
+  if (data != nullptr) countUpload(textureDataBytes(format, static_cast<size_t>(sizeX_) * sizeY_, 1));
 
   setFilterMode(FilterMode::Nearest);
 }
@@ -78,6 +96,18 @@ GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int sizeX_, uns
     : TextureBuffer(2, format_, sizeX_, sizeY_) {
 
   checkGLError();
+  if (data != nullptr) countUpload(textureDataBytes(format, static_cast<size_t>(sizeX_) * sizeY_, sizeof(float)));
+
+  setFilterMode(FilterMode::Nearest);
+}
+
+// create a 3D texture from data
+GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int sizeX_, unsigned int sizeY_, unsigned int sizeZ_,
+                                 float* data)
+    : TextureBuffer(3, format_, sizeX_, sizeY_, sizeZ_) {
+
+  checkGLError();
+  if (data != nullptr) countUpload(textureDataBytes(format, getTotalSize(), sizeof(float)));
 
   setFilterMode(FilterMode::Nearest);
 }
@@ -91,8 +121,8 @@ void GLTextureBuffer::resize(unsigned int newLen) {
   bind();
   if (dim == 1) {
   }
-  if (dim == 2) {
-    throw std::runtime_error("OpenGL error: called 1D resize on 2D texture");
+  if (dim > 1) {
+    throw std::runtime_error("OpenGL error: called 1D resize on " + std::to_string(dim) + "D texture");
   }
   checkGLError();
 }
@@ -102,10 +132,8 @@ void GLTextureBuffer::resize(unsigned int newX, unsigned int newY) {
   TextureBuffer::resize(newX, newY);
 
   bind();
-  if (dim == 1) {
-    throw std::runtime_error("OpenGL error: called 2D resize on 1D texture");
-  }
-  if (dim == 2) {
+  if (dim != 2) {
+    throw std::runtime_error("OpenGL error: called 2D resize on " + std::to_string(dim) + "D texture");
   }
   checkGLError();
 }
@@ -140,7 +168,7 @@ std::vector<float> GLTextureBuffer::getDataScalar() {
   if (dimension(format) != 1)
     throw std::runtime_error("called getDataScalar on texture which does not have a 1 dimensional format");
   std::vector<float> outData;
-  outData.resize(getSizeX() * getSizeY());
+  outData.resize(getTotalSize());
 
   return outData;
 }
@@ -150,7 +178,7 @@ std::vector<glm::vec2> GLTextureBuffer::getDataVector2() {
     throw std::runtime_error("called getDataVector2 on texture which does not have a 2 dimensional format");
 
   std::vector<glm::vec2> outData;
-  outData.resize(getSizeX() * getSizeY());
+  outData.resize(getTotalSize());
 
   return outData;
 }
@@ -161,10 +189,22 @@ std::vector<glm::vec3> GLTextureBuffer::getDataVector3() {
   throw std::runtime_error("not implemented");
 
   std::vector<glm::vec3> outData;
-  outData.resize(getSizeX() * getSizeY());
+  outData.resize(getTotalSize());
 
   return outData;
 }
+
+void GLTextureBuffer::setDataRows(unsigned int rowStart, unsigned int nRows, const float* data) {
+  if (dim != 2) throw std::runtime_error("called setDataRows on texture which is not 2 dimensional");
+  if (rowStart + nRows > sizeY) throw std::runtime_error("texture rows out of range in setDataRows");
+}
+
+void GLTextureBuffer::setData1D(unsigned int start, unsigned int count, const float* data) {
+  if (dim != 1) throw std::runtime_error("called setData1D on texture which is not 1 dimensional");
+  if (start + count > sizeX) throw std::runtime_error("texels out of range in setData1D");
+  countUpload(textureDataBytes(format, count, sizeof(float)));
+}
+
 void GLTextureBuffer::bind() {
   if (dim == 1) {
   }
@@ -177,8 +217,9 @@ void GLTextureBuffer::bind() {
 // ===================== Render buffer =========================
 // =============================================================
 
-GLRenderBuffer::GLRenderBuffer(RenderBufferType type_, unsigned int sizeX_, unsigned int sizeY_)
-    : RenderBuffer(type_, sizeX_, sizeY_) {
+GLRenderBuffer::GLRenderBuffer(RenderBufferType type_, unsigned int sizeX_, unsigned int sizeY_,
+                               unsigned int samples_)
+    : RenderBuffer(type_, sizeX_, sizeY_, samples_) {
   checkGLError();
   resize(sizeX, sizeY);
 }
@@ -302,6 +343,21 @@ std::array<float, 4> GLFrameBuffer::readFloat4(int xPos, int yPos) {
   return result;
 }
 
+std::shared_ptr<PendingFloat4Read> GLFrameBuffer::readFloat4Async(int xPos, int yPos) {
+  return std::make_shared<GLPendingFloat4Read>(readFloat4(xPos, yPos));
+}
+
+std::vector<float> GLFrameBuffer::readFloat4Region(int xPos, int yPos, int regionSizeX, int regionSizeY) {
+  // Every pixel reads as readFloat4() does
+  std::vector<float> result;
+  result.reserve(4 * static_cast<size_t>(regionSizeX) * regionSizeY);
+  for (int i = 0; i < regionSizeX * regionSizeY; i++) {
+    std::array<float, 4> pixel = readFloat4(xPos, yPos);
+    result.insert(result.end(), pixel.begin(), pixel.end());
+  }
+  return result;
+}
+
 std::vector<unsigned char> GLFrameBuffer::readBuffer() {
   bind();
 
@@ -315,6 +371,17 @@ std::vector<unsigned char> GLFrameBuffer::readBuffer() {
   return buff;
 }
 
+std::vector<float> GLFrameBuffer::readDepthBuffer() {
+  bind();
+
+  // (nothing is drawn, so every pixel is at the far plane)
+  return std::vector<float>(static_cast<size_t>(getSizeX()) * getSizeY(), 1.f);
+}
+
+std::shared_ptr<PendingBufferRead> GLFrameBuffer::readBufferAsync() {
+  return std::make_shared<GLPendingBufferRead>(readBuffer());
+}
+
 void GLFrameBuffer::blitTo(FrameBuffer* targetIn) {
 
   // it _better_ be a GL buffer
@@ -326,6 +393,85 @@ void GLFrameBuffer::blitTo(FrameBuffer* targetIn) {
   checkGLError();
 }
 
+void GLFrameBuffer::blitColorAndDepthTo(FrameBuffer* targetIn) {
+
+  GLFrameBuffer* target = dynamic_cast<GLFrameBuffer*>(targetIn);
+  if (!target) throw std::runtime_error("tried to blitColorAndDepthTo() non-GL framebuffer");
+
+  bindForRendering();
+  checkGLError();
+}
+
+// =============================================================
+// ==================== Attribute buffer =======================
+// =============================================================
+
+GLAttributeBuffer::GLAttributeBuffer(DataType dataType_, int arrayCount_) : AttributeBuffer(dataType_, arrayCount_) {
+  checkGLError();
+}
+
+GLAttributeBuffer::~GLAttributeBuffer() {}
+
+void* GLAttributeBuffer::getNativeHandle() { return nullptr; }
+
+void GLAttributeBuffer::checkType(DataType type) {
+  if (type != dataType) {
+    throw std::invalid_argument("Tried to set attribute buffer with wrong type. Actual type: " +
+                                std::to_string(static_cast<int>(dataType)) +
+                                "  Attempted type: " + std::to_string(static_cast<int>(type)));
+  }
+}
+
+void GLAttributeBuffer::upload(size_t nEntries, size_t entryBytes, bool update, int offset, int size) {
+  trackUpdate();
+  if (update) {
+    // TODO: Allow modifications to non-contiguous memory
+    if (size == -1) size = dataSize;
+    countUpload(entryBytes * size);
+  } else {
+    dataSize = nEntries;
+    allocation.setSize(entryBytes * nEntries);
+    countUpload(entryBytes * nEntries);
+  }
+  requestRedraw();
+}
+
+void GLAttributeBuffer::allocate(long int nEntries) {
+  trackUpdate();
+  dataSize = nEntries;
+  allocation.setSize(entryBytes() * static_cast<size_t>(nEntries));
+}
+
+void GLAttributeBuffer::setData(const std::vector<glm::vec2>& data, bool update, int offset, int size) {
+  checkType(DataType::Vector2Float);
+  upload(data.size(), 2 * sizeof(float), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<glm::vec3>& data, bool update, int offset, int size) {
+  checkType(DataType::Vector3Float);
+  upload(data.size(), 3 * sizeof(float), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<glm::vec4>& data, bool update, int offset, int size) {
+  checkType(DataType::Vector4Float);
+  upload(data.size(), 4 * sizeof(float), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<float>& data, bool update, int offset, int size) {
+  checkType(DataType::Float);
+  upload(data.size(), sizeof(float), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<int>& data, bool update, int offset, int size) {
+  checkType(DataType::Int);
+  upload(data.size(), sizeof(int), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<uint32_t>& data, bool update, int offset, int size) {
+  checkType(DataType::UInt);
+  upload(data.size(), sizeof(unsigned int), update, offset, size);
+}
+
 // =============================================================
 // ==================  Shader Program  =========================
 // =============================================================
@@ -367,7 +513,7 @@ void GLShaderProgram::addUniqueAttribute(ShaderSpecAttribute newAttribute) {
       return;
     }
   }
-  attributes.push_back(GLShaderAttribute{newAttribute.name, newAttribute.type, newAttribute.arrayCount, -1, 777, 777});
+  attributes.push_back(GLShaderAttribute{newAttribute.name, newAttribute.type, newAttribute.arrayCount, 777, nullptr});
 }
 
 void GLShaderProgram::addUniqueUniform(ShaderSpecUniform newUniform) {
@@ -389,9 +535,10 @@ void GLShaderProgram::addUniqueTexture(ShaderSpecTexture newTexture) {
 }
 
 
-void GLShaderProgram::deleteAttributeBuffer(GLShaderAttribute& attribute) {}
-
-void GLShaderProgram::compileGLProgram(const std::vector<ShaderStageSpecification>& stages) { checkGLError(); }
+void GLShaderProgram::compileGLProgram(const std::vector<ShaderStageSpecification>& stages) {
+  if (engine) engine->renderStats.shaderCompilations++;
+  checkGLError();
+}
 
 void GLShaderProgram::setDataLocations() {
 
@@ -420,6 +567,7 @@ void GLShaderProgram::setDataLocations() {
 void GLShaderProgram::createBuffers() {
   // Create buffers for each attributes
   for (GLShaderAttribute& a : attributes) {
+    a.buff = std::make_shared<GLAttributeBuffer>(a.type, a.arrayCount);
 
     // Choose the correct type for the buffer
     for (int iArrInd = 0; iArrInd < a.arrayCount; iArrInd++) {
@@ -455,171 +603,120 @@ void GLShaderProgram::createBuffers() {
 }
 
 bool GLShaderProgram::hasUniform(std::string name) {
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      return true;
+  ShaderUniformHandle h = getUniformHandle(name);
+  return h.isValid();
+}
+
+ShaderUniformHandle GLShaderProgram::getUniformHandle(std::string name) {
+  for (size_t i = 0; i < uniforms.size(); i++) {
+    if (uniforms[i].name == name) {
+      return ShaderUniformHandle(i);
     }
   }
-  return false;
+  return ShaderUniformHandle();
 }
 
-// Set an integer
-void GLShaderProgram::setUniform(std::string name, int val) {
+ShaderUniformHandle GLShaderProgram::requireUniformHandle(const std::string& name) {
+  ShaderUniformHandle h = getUniformHandle(name);
+  if (!h.isValid()) {
+    throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+  }
+  return h;
+}
 
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::Int) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
+GLShaderProgram::GLShaderUniform& GLShaderProgram::getUniformForHandle(ShaderUniformHandle h, DataType type) {
+  if (!h.isValid() || static_cast<size_t>(h.index) >= uniforms.size()) {
+    throw std::invalid_argument("Tried to set uniform with invalid handle");
+  }
+  GLShaderUniform& u = uniforms[h.index];
+  if (u.type != type) {
+    throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
   }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+  return u;
+}
+
+// Set an integer
+void GLShaderProgram::setUniform(std::string name, int val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, int val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Int);
+  u.isSet = true;
+  countUniformSet();
 }
 
 // Set an unsigned integer
-void GLShaderProgram::setUniform(std::string name, unsigned int val) {
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::UInt) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, unsigned int val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, unsigned int val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::UInt);
+  u.isSet = true;
+  countUniformSet();
 }
 
 // Set a float
-void GLShaderProgram::setUniform(std::string name, float val) {
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::Float) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, float val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, float val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Float);
+  u.isSet = true;
+  countUniformSet();
 }
 
 // Set a double --- WARNING casts down to float
-void GLShaderProgram::setUniform(std::string name, double val) {
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::Float) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, double val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, double val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Float);
+  u.isSet = true;
+  countUniformSet();
 }
 
 // Set a 4x4 uniform matrix
-void GLShaderProgram::setUniform(std::string name, float* val) {
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::Matrix44Float) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, float* val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, float* val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Matrix44Float);
+  u.isSet = true;
+  countUniformSet();
 }
 
 // Set a vector2 uniform
-void GLShaderProgram::setUniform(std::string name, glm::vec2 val) {
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::Vector2Float) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, glm::vec2 val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, glm::vec2 val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector2Float);
+  u.isSet = true;
+  countUniformSet();
 }
 
 // Set a vector3 uniform
-void GLShaderProgram::setUniform(std::string name, glm::vec3 val) {
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::Vector3Float) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, glm::vec3 val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, glm::vec3 val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector3Float);
+  u.isSet = true;
+  countUniformSet();
 }
 
 // Set a vector4 uniform
-void GLShaderProgram::setUniform(std::string name, glm::vec4 val) {
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::Vector4Float) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, glm::vec4 val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, glm::vec4 val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector4Float);
+  u.isSet = true;
+  countUniformSet();
 }
 
 // Set a vector3 uniform from a float array
 void GLShaderProgram::setUniform(std::string name, std::array<float, 3> val) {
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::Vector3Float) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+  setUniform(requireUniformHandle(name), val);
+}
+void GLShaderProgram::setUniform(ShaderUniformHandle h, std::array<float, 3> val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector3Float);
+  u.isSet = true;
+  countUniformSet();
 }
 
 // Set a vec4 uniform
 void GLShaderProgram::setUniform(std::string name, float x, float y, float z, float w) {
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.type == DataType::Vector4Float) {
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+  setUniform(requireUniformHandle(name), x, y, z, w);
+}
+void GLShaderProgram::setUniform(ShaderUniformHandle h, float x, float y, float z, float w) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector4Float);
+  u.isSet = true;
+  countUniformSet();
 }
 
 bool GLShaderProgram::hasAttribute(std::string name) {
@@ -634,230 +731,138 @@ bool GLShaderProgram::hasAttribute(std::string name) {
 bool GLShaderProgram::attributeIsSet(std::string name) {
   for (GLShaderAttribute& a : attributes) {
     if (a.name == name) {
-      return a.dataSize != -1;
+      return a.buff->isSet();
     }
   }
   return false;
 }
 
-void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec2>& data, bool update, int offset,
-                                   int size) {
-  // Reshape the vector
-  // Right now, the data is probably laid out in this form already... but let's
-  // not be overly clever and just reshape it.
-  std::vector<float> rawData(2 * data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    rawData[2 * i + 0] = static_cast<float>(data[i].x);
-    rawData[2 * i + 1] = static_cast<float>(data[i].y);
+ShaderAttributeHandle GLShaderProgram::getAttributeHandle(std::string name) {
+  for (size_t i = 0; i < attributes.size(); i++) {
+    if (attributes[i].name == name) {
+      return ShaderAttributeHandle(i);
+    }
   }
+  return ShaderAttributeHandle();
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Vector2Float) {
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= 2 * sizeof(float);
-          if (size == -1)
-            size = 2 * a.dataSize * sizeof(float);
-          else
-            size *= 2 * sizeof(float);
-        } else {
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::Vector2Float)));
-      }
-      return;
-    }
+ShaderAttributeHandle GLShaderProgram::requireAttributeHandle(const std::string& name) {
+  ShaderAttributeHandle h = getAttributeHandle(name);
+  if (!h.isValid()) {
+    throw std::invalid_argument("Tried to set nonexistent attribute with name " + name);
   }
+  return h;
+}
 
-  throw std::invalid_argument("Tried to set nonexistent attribute with name " + name);
+GLShaderProgram::GLShaderAttribute& GLShaderProgram::getAttributeForHandle(ShaderAttributeHandle h) {
+  if (!h.isValid() || static_cast<size_t>(h.index) >= attributes.size()) {
+    throw std::invalid_argument("Tried to set attribute with invalid handle");
+  }
+  return attributes[h.index];
 }
 
-void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec3>& data, bool update, int offset,
+void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec2>& data, bool update, int offset,
                                    int size) {
-  // Reshape the vector
-  // Right now, the data is probably laid out in this form already... but let's
-  // not be overly clever and just reshape it.
-  std::vector<float> rawData(3 * data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    rawData[3 * i + 0] = static_cast<float>(data[i].x);
-    rawData[3 * i + 1] = static_cast<float>(data[i].y);
-    rawData[3 * i + 2] = static_cast<float>(data[i].z);
-  }
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Vector3Float) {
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= 3 * sizeof(float);
-          if (size == -1)
-            size = 3 * a.dataSize * sizeof(float);
-          else
-            size *= 3 * sizeof(float);
-
-        } else {
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::Vector3Float)));
-      }
-      return;
-    }
-  }
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec2>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Vector2Float);
+  a.buff->setData(data, update, offset, size);
+}
 
-  throw std::invalid_argument("Tried to set nonexistent attribute with name " + name);
+void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec3>& data, bool update, int offset,
+                                   int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
 }
 
-void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec4>& data, bool update, int offset,
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec3>& data, bool update, int offset,
                                    int size) {
-  // Reshape the vector
-  // Right now, the data is probably laid out in this form already... but let's
-  // not be overly clever and just reshape it.
-  std::vector<float> rawData(4 * data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    rawData[4 * i + 0] = static_cast<float>(data[i].x);
-    rawData[4 * i + 1] = static_cast<float>(data[i].y);
-    rawData[4 * i + 2] = static_cast<float>(data[i].z);
-    rawData[4 * i + 3] = static_cast<float>(data[i].w);
-  }
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Vector3Float);
+  a.buff->setData(data, update, offset, size);
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Vector4Float) {
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= 4 * sizeof(float);
-          if (size == -1)
-            size = 4 * a.dataSize * sizeof(float);
-          else
-            size *= 4 * sizeof(float);
-
-        } else {
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::Vector4Float)));
-      }
-      return;
-    }
-  }
+void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec4>& data, bool update, int offset,
+                                   int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  throw std::invalid_argument("Tried to set nonexistent attribute with name " + name);
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec4>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Vector4Float);
+  a.buff->setData(data, update, offset, size);
 }
 
 void GLShaderProgram::setAttribute(std::string name, const std::vector<double>& data, bool update, int offset,
                                    int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
+
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<double>& data, bool update, int offset,
+                                   int size) {
   // Convert input data to floats
   std::vector<float> floatData(data.size());
   for (unsigned int i = 0; i < data.size(); i++) {
     floatData[i] = static_cast<float>(data[i]);
   }
-
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Float) {
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= sizeof(float);
-          if (size == -1)
-            size = a.dataSize * sizeof(float);
-          else
-            size *= sizeof(float);
-
-        } else {
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<float>(DataType::Float)));
-      }
-      return;
-    }
-  }
-
-  throw std::invalid_argument("No attribute with name " + name);
+  setAttribute(h, floatData, update, offset, size);
 }
 
-void GLShaderProgram::setAttribute(std::string name, const std::vector<int>& data, bool update, int offset, int size) {
-  // FIXME I've seen strange bugs when using int's in shaders. Need to figure
-  // out it it's my shaders or something wrong with this function
+void GLShaderProgram::setAttribute(std::string name, const std::vector<float>& data, bool update, int offset,
+                                   int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  // Convert data to GL_INT (probably does nothing)
-  std::vector<int> intData(data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    intData[i] = static_cast<int>(data[i]);
-  }
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<float>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Float);
+  a.buff->setData(data, update, offset, size);
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Int) {
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= sizeof(int);
-          if (size == -1)
-            size = a.dataSize * sizeof(int);
-          else
-            size *= sizeof(int);
-
-        } else {
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::Int)));
-      }
-      return;
-    }
-  }
+void GLShaderProgram::setAttribute(std::string name, const std::vector<int>& data, bool update, int offset,
+                                   int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  throw std::invalid_argument("No attribute with name " + name);
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<int>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Int);
+  a.buff->setData(data, update, offset, size);
 }
 
 void GLShaderProgram::setAttribute(std::string name, const std::vector<uint32_t>& data, bool update, int offset,
                                    int size) {
-  // FIXME I've seen strange bugs when using int's in shaders. Need to figure
-  // out it it's my shaders or something wrong with this function
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  // Convert data to GL_UINT (probably does nothing)
-  std::vector<unsigned int> intData(data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    intData[i] = static_cast<unsigned int>(data[i]);
-  }
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<uint32_t>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::UInt);
+  a.buff->setData(data, update, offset, size);
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::UInt) {
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= sizeof(unsigned int);
-          if (size == -1)
-            size = a.dataSize * sizeof(unsigned int);
-          else
-            size *= sizeof(unsigned int);
-
-        } else {
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::UInt)));
-      }
-      return;
-    }
+void GLShaderProgram::setAttribute(std::string name, std::shared_ptr<AttributeBuffer> buffer) {
+  GLShaderAttribute& a = getAttributeForHandle(requireAttributeHandle(name));
+  std::shared_ptr<GLAttributeBuffer> glBuffer = std::dynamic_pointer_cast<GLAttributeBuffer>(buffer);
+  if (!glBuffer || glBuffer->getType() != a.type || glBuffer->getArrayCount() != a.arrayCount) {
+    throw std::invalid_argument("Tried to set GLShaderAttribute named " + a.name + " with an incompatible buffer");
   }
+  a.buff = glBuffer;
+}
 
-  throw std::invalid_argument("No attribute with name " + name);
+void GLShaderProgram::checkAttributeType(const GLShaderAttribute& a, DataType type) {
+  if (a.type != type) {
+    throw std::invalid_argument("Tried to set GLShaderAttribute named " + a.name +
+                                " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
+                                "  Attempted type: " + std::to_string(static_cast<int>(type)));
+  }
 }
 
 bool GLShaderProgram::hasTexture(std::string name) {
@@ -929,7 +934,7 @@ void GLShaderProgram::setTexture2D(std::string name, unsigned char* texData, uns
     if (withAlpha) {
       t.textureBufferOwned.reset(new GLTextureBuffer(TextureFormat::RGBA8, width, height, texData));
     } else {
-      t.textureBufferOwned.reset(new GLTextureBuffer(TextureFormat::RGB8, width, height, texData));
+      t.textureBufferOwned.reset(new GLTextureBuffer(TextureFormat::BC7_RGB8, width, height, texData));
     }
     t.textureBuffer = t.textureBufferOwned.get();
 
@@ -974,8 +979,6 @@ void GLShaderProgram::setTextureFromBuffer(std::string name, TextureBuffer* text
 }
 
 void GLShaderProgram::setTextureFromColormap(std::string name, const std::string& colormapName, bool allowUpdate) {
-  const ValueColorMap& colormap = render::engine->getColorMap(colormapName);
-
   // Find the right texture
   for (GLShaderTexture& t : textures) {
     if (t.name != name) continue;
@@ -988,22 +991,10 @@ void GLShaderProgram::setTextureFromColormap(std::string name, const std::string
       throw std::invalid_argument("Tried to use texture with mismatched dimension " + std::to_string(t.dim));
     }
 
-    // Fill a buffer with the data
-    unsigned int dataLength = colormap.values.size() * 3;
-    std::vector<float> colorBuffer(dataLength);
-    for (unsigned int i = 0; i < colormap.values.size(); i++) {
-      colorBuffer[3 * i + 0] = static_cast<float>(colormap.values[i][0]);
-      colorBuffer[3 * i + 1] = static_cast<float>(colormap.values[i][1]);
-      colorBuffer[3 * i + 2] = static_cast<float>(colormap.values[i][2]);
-    }
-
-    // glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB, colormap.values.size(), 0, GL_RGB, GL_FLOAT, &(colorBuffer[0]));
-    t.textureBufferOwned = std::dynamic_pointer_cast<GLTextureBuffer>(
-        engine->generateTextureBuffer(TextureFormat::RGB32F, colormap.values.size(), &(colorBuffer[0])));
-    t.textureBufferOwned->setFilterMode(FilterMode::Linear);
+    // (all programs with this colormap share one texture, see Engine::getColorMapTexture())
+    t.textureBufferOwned = std::dynamic_pointer_cast<GLTextureBuffer>(engine->getColorMapTexture(colormapName));
     t.textureBuffer = t.textureBufferOwned.get();
 
-
     t.isSet = true;
     return;
   }
@@ -1022,12 +1013,15 @@ void GLShaderProgram::setIndex(std::vector<std::array<unsigned int, 3>>& indices
   // not be overly clever and just reshape it.
   unsigned int* rawData = new unsigned int[3 * indices.size()];
   indexSize = 3 * indices.size();
+  indexAllocation.setSize(indexSize * sizeof(unsigned int));
   for (unsigned int i = 0; i < indices.size(); i++) {
     rawData[3 * i + 0] = static_cast<float>(indices[i][0]);
     rawData[3 * i + 1] = static_cast<float>(indices[i][1]);
     rawData[3 * i + 2] = static_cast<float>(indices[i][2]);
   }
+  countUpload(3 * indices.size() * sizeof(unsigned int));
 
+  indexData.assign(rawData, rawData + indexSize);
   delete[] rawData;
 }
 
@@ -1051,6 +1045,8 @@ void GLShaderProgram::setIndex(std::vector<unsigned int>& indices) {
     }
   }
   indexSize = indices.size();
+  indexAllocation.setSize(indexSize * sizeof(unsigned int));
+  countUpload(indices.size() * sizeof(unsigned int));
 }
 
 // Check that uniforms and attributes are all set and of consistent size
@@ -1064,21 +1060,33 @@ void GLShaderProgram::validateData() {
 
   // Check attributes
   long int attributeSize = -1;
-  for (GLShaderAttribute a : attributes) {
-    if (a.dataSize < 0) {
+  long int instanceSize = -1;
+  for (GLShaderAttribute& a : attributes) {
+    long int dataSize = a.buff->getDataSize();
+    if (dataSize < 0) {
       throw std::invalid_argument("Attribute " + a.name + " has not been set");
     }
+    if (drawMode == DrawMode::InstancedTriangles && attributeIsPerInstance(a.name)) {
+      if (instanceSize != -1 && dataSize / a.arrayCount != instanceSize) {
+        throw std::invalid_argument("Per-instance attributes have inconsistent size. One attribute has size " +
+                                    std::to_string(instanceSize) + " and " + a.name + " has size " +
+                                    std::to_string(dataSize));
+      }
+      instanceSize = dataSize / a.arrayCount;
+      continue;
+    }
     if (attributeSize == -1) { // first one we've seen
-      attributeSize = a.dataSize / a.arrayCount;
+      attributeSize = dataSize / a.arrayCount;
     } else { // not the first one we've seen
-      if (a.dataSize / a.arrayCount != attributeSize) {
+      if (dataSize / a.arrayCount != attributeSize) {
         throw std::invalid_argument("Attributes have inconsistent size. One attribute has size " +
                                     std::to_string(attributeSize) + " and " + a.name + " has size " +
-                                    std::to_string(a.dataSize));
+                                    std::to_string(dataSize));
       }
     }
   }
   drawDataLength = static_cast<unsigned int>(attributeSize);
+  instanceCount = instanceSize == -1 ? 0 : static_cast<unsigned int>(instanceSize);
 
   // Check textures
   for (GLShaderTexture& t : textures) {
@@ -1123,6 +1131,15 @@ void GLShaderProgram::activateTextures() {
 void GLShaderProgram::draw() {
   validateData();
 
+  // (a real backend binds the program and issues one draw call)
+  if (engine) {
+    engine->renderStats.programBinds++;
+    engine->renderStats.drawCalls++;
+  }
+  if (glEngine && glEngine->recordIndexedDraws && drawMode == DrawMode::IndexedTriangles) {
+    glEngine->indexedDraws.push_back(indexData);
+  }
+
   if (usePrimitiveRestart) {
   }
 
@@ -1149,6 +1166,12 @@ void GLShaderProgram::draw() {
     break;
   case DrawMode::IndexedTriangles:
     break;
+  case DrawMode::InstancedQuads:
+    break;
+  case DrawMode::InstancedBoxes:
+    break;
+  case DrawMode::InstancedTriangles:
+    break;
   }
 
   if (usePrimitiveRestart) {
@@ -1157,6 +1180,24 @@ void GLShaderProgram::draw() {
   checkGLError();
 }
 
+std::shared_ptr<PendingCapture>
+GLShaderProgram::capture(const std::vector<std::shared_ptr<AttributeBuffer>>& outputs) {
+  if (drawMode != DrawMode::Points) {
+    throw std::runtime_error("capture() needs a program which draws points in to a geometry stage");
+  }
+  validateData();
+
+  if (engine) {
+    engine->renderStats.programBinds++;
+    engine->renderStats.drawCalls++;
+  }
+
+  activateTextures();
+
+  checkGLError();
+  return std::make_shared<GLPendingCapture>();
+}
+
 MockGLEngine::MockGLEngine() {}
 
 void MockGLEngine::initialize() {
@@ -1165,11 +1206,11 @@ void MockGLEngine::initialize() {
     std::cout << options::printPrefix << "Backend: openGL_mock" << std::endl;
   }
 
+  updateWindowSize();
+
   GLFrameBuffer* glScreenBuffer = new GLFrameBuffer(view::bufferWidth, view::bufferHeight, true);
   displayBuffer.reset(glScreenBuffer);
 
-  updateWindowSize();
-
   populateDefaultShadersAndRules();
 }
 
@@ -1243,19 +1284,88 @@ void MockGLEngine::ImGuiNewFrame() {
   ImGuiIO& io = ImGui::GetIO();
   io.DisplaySize.x = view::bufferWidth;
   io.DisplaySize.y = view::bufferHeight;
+  applyQueuedInput(); // (there is no window to take input from)
 
+  ensureImGuiFonts();
   ImGui::NewFrame();
 }
 
 void MockGLEngine::ImGuiRender() { ImGui::Render(); }
 
-void MockGLEngine::setDepthMode(DepthMode newMode) {}
+bool MockGLEngine::stateChangeNeeded(int& current, int newVal) {
+  if (current == newVal) {
+    renderStats.redundantChangesSkipped++;
+    return false;
+  }
+  current = newVal;
+  renderStats.stateChanges++;
+  return true;
+}
+
+void MockGLEngine::setDepthMode(DepthMode newMode) { stateChangeNeeded(currDepthMode, static_cast<int>(newMode)); }
 
-void MockGLEngine::setBlendMode(BlendMode newMode) {}
+void MockGLEngine::setBlendMode(BlendMode newMode) { stateChangeNeeded(currBlendMode, static_cast<int>(newMode)); }
+
+void MockGLEngine::setColorMask(std::array<bool, 4> mask) {
+  stateChangeNeeded(currColorMask, mask[0] | (mask[1] << 1) | (mask[2] << 2) | (mask[3] << 3));
+}
 
-void MockGLEngine::setColorMask(std::array<bool, 4> mask) {}
+void MockGLEngine::setBackfaceCull(bool newVal) { stateChangeNeeded(currBackfaceCull, newVal); }
 
-void MockGLEngine::setBackfaceCull(bool newVal) {}
+void MockGLEngine::startGPUTimerFrame() {
+  if (openTimerRegionCount > 0) return;
+
+  if (!currentTimerFrame.empty()) {
+    recordGPUTimingFrame(std::move(currentTimerFrame));
+    currentTimerFrame.clear();
+  }
+}
+
+void MockGLEngine::pushGPUTimer(const std::string& name) {
+  currentTimerFrame.push_back({name, openTimerRegionCount, 0., 0.});
+  openTimerRegionCount++;
+}
+
+void MockGLEngine::popGPUTimer() {
+  if (openTimerRegionCount == 0) {
+    throw std::runtime_error("popGPUTimer() called without a matching pushGPUTimer()");
+  }
+  openTimerRegionCount--;
+}
+
+void MockGLEngine::startPipelineStatisticsFrame() {
+  if (openPipelineStatisticsRegions > 0) return;
+
+  if (!currentPipelineStatisticsFrame.empty()) {
+    recordPipelineStatisticsFrame(currentPipelineStatisticsFrame);
+    currentPipelineStatisticsFrame.clear();
+  }
+}
+
+void MockGLEngine::beginPipelineStatistics(const std::string& name) {
+  openPipelineStatisticsRegions++;
+  if (openPipelineStatisticsRegions > 1) return;
+  GPUPipelineStatistics region;
+  region.name = name;
+  currentPipelineStatisticsFrame.push_back(region);
+}
+
+void MockGLEngine::endPipelineStatistics() {
+  if (openPipelineStatisticsRegions == 0) {
+    throw std::runtime_error("endPipelineStatistics() called without a matching beginPipelineStatistics()");
+  }
+  openPipelineStatisticsRegions--;
+}
+
+std::shared_ptr<OcclusionQuery> MockGLEngine::generateOcclusionQuery() {
+  return std::shared_ptr<OcclusionQuery>(new GLOcclusionQuery());
+}
+
+void MockGLEngine::setScissor(int startX, int startY, unsigned int sizeX, unsigned int sizeY) {}
+
+void MockGLEngine::disableScissor() {}
+
+void MockGLEngine::waitForExternalFence(void* fence) {}
 
 std::string MockGLEngine::getClipboardText() {
   std::string clipboardData = "";
@@ -1286,11 +1396,17 @@ std::shared_ptr<TextureBuffer> MockGLEngine::generateTextureBuffer(TextureFormat
   GLTextureBuffer* newT = new GLTextureBuffer(format, sizeX_, sizeY_, data);
   return std::shared_ptr<TextureBuffer>(newT);
 }
+std::shared_ptr<TextureBuffer> MockGLEngine::generateTextureBuffer(TextureFormat format, unsigned int sizeX_,
+                                                                   unsigned int sizeY_, unsigned int sizeZ_,
+                                                                   float* data) {
+  GLTextureBuffer* newT = new GLTextureBuffer(format, sizeX_, sizeY_, sizeZ_, data);
+  return std::shared_ptr<TextureBuffer>(newT);
+}
 
 
 std::shared_ptr<RenderBuffer> MockGLEngine::generateRenderBuffer(RenderBufferType type, unsigned int sizeX_,
-                                                                 unsigned int sizeY_) {
-  GLRenderBuffer* newR = new GLRenderBuffer(type, sizeX_, sizeY_);
+                                                                 unsigned int sizeY_, unsigned int samples) {
+  GLRenderBuffer* newR = new GLRenderBuffer(type, sizeX_, sizeY_, samples);
   return std::shared_ptr<RenderBuffer>(newR);
 }
 
@@ -1299,6 +1415,11 @@ std::shared_ptr<FrameBuffer> MockGLEngine::generateFrameBuffer(unsigned int size
   return std::shared_ptr<FrameBuffer>(newF);
 }
 
+std::shared_ptr<AttributeBuffer> MockGLEngine::generateAttributeBuffer(DataType dataType, int arrayCount) {
+  GLAttributeBuffer* newB = new GLAttributeBuffer(dataType, arrayCount);
+  return std::shared_ptr<AttributeBuffer>(newB);
+}
+
 std::shared_ptr<ShaderProgram> MockGLEngine::generateShaderProgram(const std::vector<ShaderStageSpecification>& stages,
                                                                    DrawMode dm) {
   GLShaderProgram* newP = new GLShaderProgram(stages, dm);
@@ -1313,7 +1434,8 @@ std::shared_ptr<ShaderProgram> MockGLEngine::requestShader(const std::string& pr
   if (registeredShaderPrograms.find(programName) == registeredShaderPrograms.end()) {
     throw std::runtime_error("No shader program with name [" + programName + "] registered.");
   }
-  const std::vector<ShaderStageSpecification>& stages = registeredShaderPrograms[programName].first;
+  const std::vector<const ShaderStageSpecification*>& stages = registeredShaderPrograms[programName].first;
+  const std::vector<ShaderSourceTemplate>& templates = registeredShaderTemplates[programName];
   DrawMode dm = registeredShaderPrograms[programName].second;
 
   // Add in the default rules
@@ -1337,16 +1459,16 @@ std::shared_ptr<ShaderProgram> MockGLEngine::requestShader(const std::string& pr
   }
 
   // Get the rules
-  std::vector<ShaderReplacementRule> rules;
+  std::vector<const ShaderReplacementRule*> rules;
   for (const std::string& ruleName : fullCustomRules) {
     if (registeredShaderRules.find(ruleName) == registeredShaderRules.end()) {
       throw std::runtime_error("No shader replacement rule with name [" + ruleName + "] registered.");
     }
-    ShaderReplacementRule& thisRule = registeredShaderRules[ruleName];
-    rules.push_back(thisRule);
+    rules.push_back(registeredShaderRules[ruleName]);
   }
+  recordShaderRequest(programName, customRules, defaults);
 
-  std::vector<ShaderStageSpecification> updatedStages = applyShaderReplacements(stages, rules);
+  std::vector<ShaderStageSpecification> updatedStages = applyShaderReplacements(stages, templates, rules);
   return generateShaderProgram(updatedStages, dm);
 }
 
@@ -1357,7 +1479,19 @@ void MockGLEngine::setFrontFaceCCW(bool newVal) {
   frontFaceCCW = newVal;
 }
 
+void MockGLEngine::registerShaderRule(const std::string& name, const ShaderReplacementRule& rule) {
+  userShaderRules.erase(name);
+  const ShaderReplacementRule& stored = userShaderRules.insert({name, rule}).first->second;
+  registeredShaderRules[name] = &stored; // (replacing a built-in rule of the same name, if any)
+}
+
+void MockGLEngine::unregisterShaderRule(const std::string& name) {
+  if (userShaderRules.erase(name) == 0) return;
+  registeredShaderRules.erase(name);
+}
+
 void MockGLEngine::populateDefaultShadersAndRules() {
+  ScopedStartupPhase startupTimer("populateDefaultShadersAndRules");
   using namespace backend_openGL3_glfw;
 
   // WARNING: duplicated from gl_engine.cpp
@@ -1365,115 +1499,187 @@ void MockGLEngine::populateDefaultShadersAndRules() {
   // clang-format off
 
   // == Load general base shaders
-  registeredShaderPrograms.insert({"MESH", {{FLEX_MESH_VERT_SHADER, FLEX_MESH_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"SLICE_TETS", {{SLICE_TETS_VERT_SHADER, SLICE_TETS_GEOM_SHADER, SLICE_TETS_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"RAYCAST_SPHERE", {{FLEX_SPHERE_VERT_SHADER, FLEX_SPHERE_GEOM_SHADER, FLEX_SPHERE_FRAG_SHADER}, DrawMode::Points}});
-  registeredShaderPrograms.insert({"POINT_QUAD", {{FLEX_POINTQUAD_VERT_SHADER, FLEX_POINTQUAD_GEOM_SHADER, FLEX_POINTQUAD_FRAG_SHADER}, DrawMode::Points}});
-  registeredShaderPrograms.insert({"RAYCAST_VECTOR", {{FLEX_VECTOR_VERT_SHADER, FLEX_VECTOR_GEOM_SHADER, FLEX_VECTOR_FRAG_SHADER}, DrawMode::Points}});
-  registeredShaderPrograms.insert({"RAYCAST_CYLINDER", {{FLEX_CYLINDER_VERT_SHADER, FLEX_CYLINDER_GEOM_SHADER, FLEX_CYLINDER_FRAG_SHADER}, DrawMode::Points}});
-  registeredShaderPrograms.insert({"HISTOGRAM", {{HISTOGRAM_VERT_SHADER, HISTOGRAM_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"GROUND_PLANE_TILE", {{GROUND_PLANE_VERT_SHADER, GROUND_PLANE_TILE_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"GROUND_PLANE_TILE_REFLECT", {{GROUND_PLANE_VERT_SHADER, GROUND_PLANE_TILE_REFLECT_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"GROUND_PLANE_SHADOW", {{GROUND_PLANE_VERT_SHADER, GROUND_PLANE_SHADOW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"MAP_LIGHT", {{TEXTURE_DRAW_VERT_SHADER, MAP_LIGHT_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"RIBBON", {{RIBBON_VERT_SHADER, RIBBON_GEOM_SHADER, RIBBON_FRAG_SHADER}, DrawMode::IndexedLineStripAdjacency}});
-  registeredShaderPrograms.insert({"SLICE_PLANE", {{SLICE_PLANE_VERT_SHADER, SLICE_PLANE_FRAG_SHADER}, DrawMode::Triangles}});
-
-  registeredShaderPrograms.insert({"TEXTURE_DRAW_PLAIN", {{TEXTURE_DRAW_VERT_SHADER, PLAIN_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"TEXTURE_DRAW_DOT3", {{TEXTURE_DRAW_VERT_SHADER, DOT3_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"TEXTURE_DRAW_MAP3", {{TEXTURE_DRAW_VERT_SHADER, MAP3_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"TEXTURE_DRAW_SPHEREBG", {{SPHEREBG_DRAW_VERT_SHADER, SPHEREBG_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"COMPOSITE_PEEL", {{TEXTURE_DRAW_VERT_SHADER, COMPOSITE_PEEL}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"DEPTH_COPY", {{TEXTURE_DRAW_VERT_SHADER, DEPTH_COPY}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"DEPTH_TO_MASK", {{TEXTURE_DRAW_VERT_SHADER, DEPTH_TO_MASK}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"SCALAR_TEXTURE_COLORMAP", {{TEXTURE_DRAW_VERT_SHADER, SCALAR_TEXTURE_COLORMAP}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"BLUR_RGB", {{TEXTURE_DRAW_VERT_SHADER, BLUR_RGB}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"TRANSFORMATION_GIZMO_ROT", {{TRANSFORMATION_GIZMO_ROT_VERT, TRANSFORMATION_GIZMO_ROT_FRAG}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"MESH", {{&FLEX_MESH_VERT_SHADER, &FLEX_MESH_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"MESH_INDEXED", {{&FLEX_MESH_VERT_SHADER, &FLEX_MESH_FRAG_SHADER}, DrawMode::IndexedTriangles}});
+  registeredShaderPrograms.insert({"MESH_INSTANCED", {{&FLEX_MESH_INSTANCED_VERT_SHADER, &FLEX_MESH_FRAG_SHADER}, DrawMode::InstancedTriangles}});
+  registeredShaderPrograms.insert({"SLICE_TETS", {{&SLICE_TETS_VERT_SHADER, &SLICE_TETS_GEOM_SHADER, &SLICE_TETS_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"SLICE_TETS_CAPTURE", {{&SLICE_TETS_VERT_SHADER, &SLICE_TETS_GEOM_SHADER, &SLICE_TETS_CAPTURE_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"SLICE_TETS_CAPTURE_WITH_VALUE", {{&SLICE_TETS_VERT_SHADER, &SLICE_TETS_GEOM_SHADER, &SLICE_TETS_CAPTURE_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"SLICE_TETS_CACHED", {{&SLICE_TETS_CACHED_VERT_SHADER, &SLICE_TETS_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"VOLUME_GRID_RAYMARCH", {{&VOLUME_GRID_RAYMARCH_VERT_SHADER, &VOLUME_GRID_RAYMARCH_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"RAYCAST_SPHERE", {{&FLEX_SPHERE_VERT_SHADER, &FLEX_SPHERE_GEOM_SHADER, &FLEX_SPHERE_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"POINT_QUAD", {{&FLEX_POINTQUAD_VERT_SHADER, &FLEX_POINTQUAD_GEOM_SHADER, &FLEX_POINTQUAD_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"RAYCAST_VECTOR", {{&FLEX_VECTOR_VERT_SHADER, &FLEX_VECTOR_GEOM_SHADER, &FLEX_VECTOR_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"RAYCAST_SPHERE_INSTANCED", {{&FLEX_SPHERE_INSTANCED_VERT_SHADER, &FLEX_SPHERE_FRAG_SHADER}, DrawMode::InstancedQuads}});
+  registeredShaderPrograms.insert({"POINT_QUAD_INSTANCED", {{&FLEX_POINTQUAD_INSTANCED_VERT_SHADER, &FLEX_POINTQUAD_FRAG_SHADER}, DrawMode::InstancedQuads}});
+  registeredShaderPrograms.insert({"POINT_SPLAT", {{&FLEX_POINTSPLAT_VERT_SHADER, &FLEX_POINTQUAD_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"POINT_REDUCE_MINMAX", {{&POINT_REDUCE_VERT_SHADER, &REDUCE_MINMAX_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"POINT_REDUCE_BOUNDS", {{&POINT_REDUCE_BOUNDS_VERT_SHADER, &REDUCE_BOUNDS_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"RAYCAST_VECTOR_INSTANCED", {{&FLEX_VECTOR_INSTANCED_VERT_SHADER, &FLEX_VECTOR_FRAG_SHADER}, DrawMode::InstancedBoxes}});
+  registeredShaderPrograms.insert({"RAYCAST_CYLINDER", {{&FLEX_CYLINDER_VERT_SHADER, &FLEX_CYLINDER_GEOM_SHADER, &FLEX_CYLINDER_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"RAYCAST_CAPSULE", {{&FLEX_CYLINDER_STRIP_VERT_SHADER, &FLEX_CAPSULE_GEOM_SHADER, &FLEX_CAPSULE_FRAG_SHADER}, DrawMode::IndexedLines}});
+  registeredShaderPrograms.insert({"CURVE_LINES", {{&FLEX_CYLINDER_STRIP_VERT_SHADER, &FLEX_LINE_STRIP_GEOM_SHADER, &FLEX_LINE_STRIP_FRAG_SHADER}, DrawMode::IndexedLines}});
+  registeredShaderPrograms.insert({"HISTOGRAM", {{&HISTOGRAM_VERT_SHADER, &HISTOGRAM_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"GROUND_PLANE_TILE", {{&GROUND_PLANE_VERT_SHADER, &GROUND_PLANE_TILE_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"GROUND_PLANE_TILE_REFLECT", {{&GROUND_PLANE_VERT_SHADER, &GROUND_PLANE_TILE_REFLECT_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"GROUND_PLANE_SHADOW", {{&GROUND_PLANE_VERT_SHADER, &GROUND_PLANE_SHADOW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"MAP_LIGHT", {{&TEXTURE_DRAW_VERT_SHADER, &MAP_LIGHT_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"RIBBON", {{&RIBBON_VERT_SHADER, &RIBBON_GEOM_SHADER, &RIBBON_FRAG_SHADER}, DrawMode::IndexedLineStripAdjacency}});
+  registeredShaderPrograms.insert({"SLICE_PLANE", {{&SLICE_PLANE_VERT_SHADER, &SLICE_PLANE_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"OCCLUSION_BOX", {{&OCCLUSION_BOX_VERT_SHADER, &OCCLUSION_BOX_FRAG_SHADER}, DrawMode::Triangles}});
+
+  registeredShaderPrograms.insert({"TEXTURE_DRAW_PLAIN", {{&TEXTURE_DRAW_VERT_SHADER, &PLAIN_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TEXTURE_DRAW_DOT3", {{&TEXTURE_DRAW_VERT_SHADER, &DOT3_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TEXTURE_DRAW_MAP3", {{&TEXTURE_DRAW_VERT_SHADER, &MAP3_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TEXTURE_DRAW_SPHEREBG", {{&SPHEREBG_DRAW_VERT_SHADER, &SPHEREBG_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"COMPOSITE_PEEL", {{&TEXTURE_DRAW_VERT_SHADER, &COMPOSITE_PEEL}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"COMPOSITE_WEIGHTED", {{&TEXTURE_DRAW_VERT_SHADER, &COMPOSITE_WEIGHTED}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"DEFERRED_LIGHTING", {{&TEXTURE_DRAW_VERT_SHADER, &DEFERRED_LIGHTING}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"DEPTH_COPY", {{&TEXTURE_DRAW_VERT_SHADER, &DEPTH_COPY}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"DEPTH_TO_MASK", {{&TEXTURE_DRAW_VERT_SHADER, &DEPTH_TO_MASK}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"EYE_DOME_LIGHTING", {{&TEXTURE_DRAW_VERT_SHADER, &EYE_DOME_LIGHTING}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"SCALAR_TEXTURE_COLORMAP", {{&TEXTURE_DRAW_VERT_SHADER, &SCALAR_TEXTURE_COLORMAP}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"SCALAR_TEXTURE_TILE_COLORMAP", {{&TEXTURE_TILE_DRAW_VERT_SHADER, &SCALAR_TEXTURE_COLORMAP}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"BLUR_RGB", {{&TEXTURE_DRAW_VERT_SHADER, &BLUR_RGB}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TEMPORAL_ACCUMULATE", {{&TEXTURE_DRAW_VERT_SHADER, &TEMPORAL_ACCUMULATE}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TRANSFORMATION_GIZMO_ROT", {{&TRANSFORMATION_GIZMO_ROT_VERT, &TRANSFORMATION_GIZMO_ROT_FRAG}, DrawMode::Triangles}});
+
+  for (const auto& program : registeredShaderPrograms) {
+    registeredShaderTemplates.insert({program.first, tokenizeShaderSources(program.second.first)});
+  }
 
 
   // === Load rules
 
   // Utilitiy rules
-  registeredShaderRules.insert({"GLSL_VERSION", GLSL_VERSION});
-  registeredShaderRules.insert({"GLOBAL_FRAGMENT_FILTER", GLOBAL_FRAGMENT_FILTER});
-  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_1", DOWNSAMPLE_RESOLVE_1});
-  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_2", DOWNSAMPLE_RESOLVE_2});
-  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_3", DOWNSAMPLE_RESOLVE_3});
-  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_4", DOWNSAMPLE_RESOLVE_4});
+  registeredShaderRules.insert({"GLSL_VERSION", &GLSL_VERSION});
+  registeredShaderRules.insert({"GLOBAL_FRAGMENT_FILTER", &GLOBAL_FRAGMENT_FILTER});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_1", &DOWNSAMPLE_RESOLVE_1});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_2", &DOWNSAMPLE_RESOLVE_2});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_3", &DOWNSAMPLE_RESOLVE_3});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_4", &DOWNSAMPLE_RESOLVE_4});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_SCALED", &DOWNSAMPLE_RESOLVE_SCALED});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_FXAA", &DOWNSAMPLE_RESOLVE_FXAA});
   
-  registeredShaderRules.insert({"TRANSPARENCY_STRUCTURE", TRANSPARENCY_STRUCTURE});
-  registeredShaderRules.insert({"TRANSPARENCY_RESOLVE_SIMPLE", TRANSPARENCY_RESOLVE_SIMPLE});
-  registeredShaderRules.insert({"TRANSPARENCY_PEEL_STRUCTURE", TRANSPARENCY_PEEL_STRUCTURE});
-  registeredShaderRules.insert({"TRANSPARENCY_PEEL_GROUND", TRANSPARENCY_PEEL_GROUND});
+  registeredShaderRules.insert({"TRANSPARENCY_STRUCTURE", &TRANSPARENCY_STRUCTURE});
+  registeredShaderRules.insert({"TRANSPARENCY_WEIGHTED_STRUCTURE", &TRANSPARENCY_WEIGHTED_STRUCTURE});
+  registeredShaderRules.insert({"TRANSPARENCY_RESOLVE_SIMPLE", &TRANSPARENCY_RESOLVE_SIMPLE});
+  registeredShaderRules.insert({"TRANSPARENCY_PEEL_STRUCTURE", &TRANSPARENCY_PEEL_STRUCTURE});
+  registeredShaderRules.insert({"IMPOSTOR_DEPTH_PREPASS", &IMPOSTOR_DEPTH_PREPASS});
+  registeredShaderRules.insert({"TRANSPARENCY_PEEL_GROUND", &TRANSPARENCY_PEEL_GROUND});
   
-  registeredShaderRules.insert({"GENERATE_VIEW_POS", GENERATE_VIEW_POS});
-  registeredShaderRules.insert({"CULL_POS_FROM_VIEW", CULL_POS_FROM_VIEW});
-  //registeredShaderRules.insert({"CULL_POS_FROM_ATTR", CULL_POS_FROM_ATTR});
+  registeredShaderRules.insert({"GENERATE_VIEW_POS", &GENERATE_VIEW_POS});
+  registeredShaderRules.insert({"CULL_POS_FROM_VIEW", &CULL_POS_FROM_VIEW});
+  //registeredShaderRules.insert({"CULL_POS_FROM_ATTR", &CULL_POS_FROM_ATTR});
 
   // Lighting and shading things
-  registeredShaderRules.insert({"LIGHT_MATCAP", LIGHT_MATCAP});
-  registeredShaderRules.insert({"LIGHT_PASSTHRU", LIGHT_PASSTHRU});
-  registeredShaderRules.insert({"SHADE_BASECOLOR", SHADE_BASECOLOR});
-  registeredShaderRules.insert({"SHADE_COLOR", SHADE_COLOR});
-  registeredShaderRules.insert({"SHADE_COLORMAP_VALUE", SHADE_COLORMAP_VALUE});
-  registeredShaderRules.insert({"SHADE_COLORMAP_ANGULAR2", SHADE_COLORMAP_ANGULAR2});
-  registeredShaderRules.insert({"SHADE_GRID_VALUE2", SHADE_GRID_VALUE2});
-  registeredShaderRules.insert({"SHADE_CHECKER_VALUE2", SHADE_CHECKER_VALUE2});
-  registeredShaderRules.insert({"SHADEVALUE_MAG_VALUE2", SHADEVALUE_MAG_VALUE2});
-  registeredShaderRules.insert({"ISOLINE_STRIPE_VALUECOLOR", ISOLINE_STRIPE_VALUECOLOR});
-  registeredShaderRules.insert({"CHECKER_VALUE2COLOR", CHECKER_VALUE2COLOR});
+  registeredShaderRules.insert({"LIGHT_MATCAP", &LIGHT_MATCAP});
+  registeredShaderRules.insert({"LIGHT_PASSTHRU", &LIGHT_PASSTHRU});
+  registeredShaderRules.insert({"LIGHT_DEFERRED", &LIGHT_DEFERRED});
+  registeredShaderRules.insert({"SHADE_BASECOLOR", &SHADE_BASECOLOR});
+  registeredShaderRules.insert({"SHADE_COLOR", &SHADE_COLOR});
+  registeredShaderRules.insert({"SHADE_COLORMAP_VALUE", &SHADE_COLORMAP_VALUE});
+  registeredShaderRules.insert({"SHADE_COLORMAP_ANGULAR2", &SHADE_COLORMAP_ANGULAR2});
+  registeredShaderRules.insert({"SHADE_GRID_VALUE2", &SHADE_GRID_VALUE2});
+  registeredShaderRules.insert({"SHADE_CHECKER_VALUE2", &SHADE_CHECKER_VALUE2});
+  registeredShaderRules.insert({"SHADEVALUE_MAG_VALUE2", &SHADEVALUE_MAG_VALUE2});
+  registeredShaderRules.insert({"ISOLINE_STRIPE_VALUECOLOR", &ISOLINE_STRIPE_VALUECOLOR});
+  registeredShaderRules.insert({"SHADE_SPARSE_ABSENT_COLOR", &SHADE_SPARSE_ABSENT_COLOR});
+  registeredShaderRules.insert({"CHECKER_VALUE2COLOR", &CHECKER_VALUE2COLOR});
   
   // mesh things
-  registeredShaderRules.insert({"MESH_WIREFRAME", MESH_WIREFRAME});
-  registeredShaderRules.insert({"MESH_BACKFACE_NORMAL_FLIP", MESH_BACKFACE_NORMAL_FLIP});
-  registeredShaderRules.insert({"MESH_BACKFACE_DIFFERENT", MESH_BACKFACE_DIFFERENT});
-  registeredShaderRules.insert({"MESH_BACKFACE_DARKEN", MESH_BACKFACE_DARKEN});
-  registeredShaderRules.insert({"MESH_PROPAGATE_VALUE", MESH_PROPAGATE_VALUE});
-  registeredShaderRules.insert({"MESH_PROPAGATE_VALUE2", MESH_PROPAGATE_VALUE2});
-  registeredShaderRules.insert({"MESH_PROPAGATE_COLOR", MESH_PROPAGATE_COLOR});
-  registeredShaderRules.insert({"MESH_PROPAGATE_HALFEDGE_VALUE", MESH_PROPAGATE_HALFEDGE_VALUE});
-  registeredShaderRules.insert({"MESH_PROPAGATE_CULLPOS", MESH_PROPAGATE_CULLPOS});
-  registeredShaderRules.insert({"MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE", MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE});
-  registeredShaderRules.insert({"MESH_PROPAGATE_PICK", MESH_PROPAGATE_PICK});
+  registeredShaderRules.insert({"MESH_WIREFRAME", &MESH_WIREFRAME});
+  registeredShaderRules.insert({"MESH_BACKFACE_NORMAL_FLIP", &MESH_BACKFACE_NORMAL_FLIP});
+  registeredShaderRules.insert({"MESH_BACKFACE_DIFFERENT", &MESH_BACKFACE_DIFFERENT});
+  registeredShaderRules.insert({"MESH_BACKFACE_DARKEN", &MESH_BACKFACE_DARKEN});
+  registeredShaderRules.insert({"MESH_COMPUTE_NORMAL_FROM_POSITION", &MESH_COMPUTE_NORMAL_FROM_POSITION});
+  registeredShaderRules.insert({"MESH_PROPAGATE_VALUE", &MESH_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_FACE_VALUE_TEXTURE", &MESH_PROPAGATE_FACE_VALUE_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_VERTEX_VALUE_TEXTURE", &MESH_PROPAGATE_VERTEX_VALUE_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_SPARSE_VALUE", &MESH_PROPAGATE_SPARSE_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_SPARSE_VERTEX_VALUE", &MESH_PROPAGATE_SPARSE_VERTEX_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_SPARSE_FACE_VALUE", &MESH_PROPAGATE_SPARSE_FACE_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_VALUE2", &MESH_PROPAGATE_VALUE2});
+  registeredShaderRules.insert({"MESH_PROPAGATE_COLOR", &MESH_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"MESH_PROPAGATE_FACE_COLOR_TEXTURE", &MESH_PROPAGATE_FACE_COLOR_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_CELL_VALUE_TEXTURE", &MESH_PROPAGATE_CELL_VALUE_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_CELL_COLOR_TEXTURE", &MESH_PROPAGATE_CELL_COLOR_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_HALFEDGE_VALUE", &MESH_PROPAGATE_HALFEDGE_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_CULLPOS", &MESH_PROPAGATE_CULLPOS});
+  registeredShaderRules.insert({"MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE", &MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_PICK", &MESH_PROPAGATE_PICK});
+  registeredShaderRules.insert({"MESH_PROPAGATE_PICK_TEXTURE", &MESH_PROPAGATE_PICK_TEXTURE});
+  registeredShaderRules.insert({"MESH_INSTANCE_PROPAGATE_VALUE", &MESH_INSTANCE_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"MESH_INSTANCE_PROPAGATE_COLOR", &MESH_INSTANCE_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"MESH_INSTANCE_PROPAGATE_PICK", &MESH_INSTANCE_PROPAGATE_PICK});
 
   // sphere things
-  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE", SPHERE_PROPAGATE_VALUE});
-  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE2", SPHERE_PROPAGATE_VALUE2});
-  registeredShaderRules.insert({"SPHERE_PROPAGATE_COLOR", SPHERE_PROPAGATE_COLOR});
-  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER", SPHERE_CULLPOS_FROM_CENTER});
-  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER_QUAD", SPHERE_CULLPOS_FROM_CENTER_QUAD});
-  registeredShaderRules.insert({"SPHERE_VARIABLE_SIZE", SPHERE_VARIABLE_SIZE});
+  registeredShaderRules.insert({"REDUCE_POSITION", &REDUCE_POSITION});
+  registeredShaderRules.insert({"REDUCE_POSITION_DISTANCE", &REDUCE_POSITION_DISTANCE});
+  registeredShaderRules.insert({"REDUCE_SCALAR_VALUE", &REDUCE_SCALAR_VALUE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE", &SPHERE_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE2", &SPHERE_PROPAGATE_VALUE2});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_COLOR", &SPHERE_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_PICK_ID", &SPHERE_PROPAGATE_PICK_ID});
+  registeredShaderRules.insert({"SPHERE_PICK_ID_FROM_INDEX", &SPHERE_PICK_ID_FROM_INDEX});
+  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER", &SPHERE_CULLPOS_FROM_CENTER});
+  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER_QUAD", &SPHERE_CULLPOS_FROM_CENTER_QUAD});
+  registeredShaderRules.insert({"SPHERE_VARIABLE_SIZE", &SPHERE_VARIABLE_SIZE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE_INSTANCED", &SPHERE_PROPAGATE_VALUE_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE2_INSTANCED", &SPHERE_PROPAGATE_VALUE2_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_COLOR_INSTANCED", &SPHERE_PROPAGATE_COLOR_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_PICK_ID_INSTANCED", &SPHERE_PROPAGATE_PICK_ID_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PICK_ID_FROM_INDEX_INSTANCED", &SPHERE_PICK_ID_FROM_INDEX_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER_INSTANCED", &SPHERE_CULLPOS_FROM_CENTER}); // fragment-only
+  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER_QUAD_INSTANCED", &SPHERE_CULLPOS_FROM_CENTER_QUAD_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_VARIABLE_SIZE_INSTANCED", &SPHERE_VARIABLE_SIZE_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_POSITION_LERP", &SPHERE_POSITION_LERP});
+  registeredShaderRules.insert({"SPHERE_POSITION_LERP_INSTANCED", &SPHERE_POSITION_LERP_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_VALUE_LERP", &SPHERE_VALUE_LERP});
+  registeredShaderRules.insert({"SPHERE_VALUE_LERP_INSTANCED", &SPHERE_VALUE_LERP_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_CHANNEL_VALUE", &SPHERE_PROPAGATE_CHANNEL_VALUE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_CHANNEL_VALUE_INSTANCED", &SPHERE_PROPAGATE_CHANNEL_VALUE_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_SPARSE_VALUE", &SPHERE_PROPAGATE_SPARSE_VALUE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_SPARSE_VALUE_INSTANCED", &SPHERE_PROPAGATE_SPARSE_VALUE_INSTANCED});
 
   // vector things
-  registeredShaderRules.insert({"VECTOR_PROPAGATE_COLOR", VECTOR_PROPAGATE_COLOR});
-  registeredShaderRules.insert({"VECTOR_CULLPOS_FROM_TAIL", VECTOR_CULLPOS_FROM_TAIL});
-  registeredShaderRules.insert({"TRANSFORMATION_GIZMO_VEC", TRANSFORMATION_GIZMO_VEC});
+  registeredShaderRules.insert({"VECTOR_PROPAGATE_COLOR", &VECTOR_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"VECTOR_PROPAGATE_COLOR_INSTANCED", &VECTOR_PROPAGATE_COLOR_INSTANCED});
+  registeredShaderRules.insert({"VECTOR_CULLPOS_FROM_TAIL", &VECTOR_CULLPOS_FROM_TAIL});
+  registeredShaderRules.insert({"TRANSFORMATION_GIZMO_VEC", &TRANSFORMATION_GIZMO_VEC});
 
   // cylinder things
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_VALUE", CYLINDER_PROPAGATE_VALUE});
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_BLEND_VALUE", CYLINDER_PROPAGATE_BLEND_VALUE});
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_COLOR", CYLINDER_PROPAGATE_COLOR});
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_BLEND_COLOR", CYLINDER_PROPAGATE_BLEND_COLOR});
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_PICK", CYLINDER_PROPAGATE_PICK});
-  registeredShaderRules.insert({"CYLINDER_CULLPOS_FROM_MID", CYLINDER_CULLPOS_FROM_MID});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_VALUE", &CYLINDER_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_BLEND_VALUE", &CYLINDER_PROPAGATE_BLEND_VALUE});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_COLOR", &CYLINDER_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_BLEND_COLOR", &CYLINDER_PROPAGATE_BLEND_COLOR});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_PICK", &CYLINDER_PROPAGATE_PICK});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_PICK_ID", &CYLINDER_PROPAGATE_PICK_ID});
+  registeredShaderRules.insert({"CYLINDER_CULLPOS_FROM_MID", &CYLINDER_CULLPOS_FROM_MID});
 
   // marching tets things
-  registeredShaderRules.insert({"SLICE_TETS_BASECOLOR_SHADE", SLICE_TETS_BASECOLOR_SHADE});
-  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_VALUE", SLICE_TETS_PROPAGATE_VALUE});
-  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_VECTOR", SLICE_TETS_PROPAGATE_VECTOR});
-  registeredShaderRules.insert({"SLICE_TETS_VECTOR_COLOR", SLICE_TETS_VECTOR_COLOR});
-  registeredShaderRules.insert({"SLICE_TETS_MESH_WIREFRAME", SLICE_TETS_MESH_WIREFRAME});
+  registeredShaderRules.insert({"SLICE_TETS_BASECOLOR_SHADE", &SLICE_TETS_BASECOLOR_SHADE});
+  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_VALUE", &SLICE_TETS_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_VECTOR", &SLICE_TETS_PROPAGATE_VECTOR});
+  registeredShaderRules.insert({"SLICE_TETS_VECTOR_COLOR", &SLICE_TETS_VECTOR_COLOR});
+  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_CELL_VALUE", &SLICE_TETS_PROPAGATE_CELL_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_CELL_VECTOR", &SLICE_TETS_PROPAGATE_CELL_VECTOR});
+  registeredShaderRules.insert({"SLICE_TETS_SLICE_BY_VALUE", &SLICE_TETS_SLICE_BY_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_MESH_WIREFRAME", &SLICE_TETS_MESH_WIREFRAME});
+  registeredShaderRules.insert({"SLICE_TETS_CAPTURE_POSITION", &SLICE_TETS_CAPTURE_POSITION});
+  registeredShaderRules.insert({"SLICE_TETS_CAPTURE_VALUE", &SLICE_TETS_CAPTURE_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_CAPTURE_VECTOR", &SLICE_TETS_CAPTURE_VECTOR});
+  registeredShaderRules.insert({"SLICE_TETS_CACHED_VALUE", &SLICE_TETS_CACHED_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_CACHED_VECTOR", &SLICE_TETS_CACHED_VECTOR});
+  registeredShaderRules.insert({"VOLUME_GRID_SAMPLE_DENSE", &VOLUME_GRID_SAMPLE_DENSE});
+  registeredShaderRules.insert({"VOLUME_GRID_SAMPLE_BRICKED", &VOLUME_GRID_SAMPLE_BRICKED});
+  registerShaderRule("VOLUME_GRID_SLICE_PLANE_CULL", generateVolumeGridSlicePlaneRule());
+  registerShaderRule("SLICE_PLANE_CULL", generateSlicePlaneRule());
 
 
   // clang-format on
 };
 
-
-void MockGLEngine::createSlicePlaneFliterRule(std::string uniquePostfix) {
-  using namespace backend_openGL3_glfw;
-  registeredShaderRules.insert({"SLICE_PLANE_CULL_" + uniquePostfix, generateSlicePlaneRule(uniquePostfix)});
-}
-
 } // namespace backend_openGL_mock
 } // namespace render
 } // namespace polyscope
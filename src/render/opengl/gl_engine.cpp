@@ -1,7 +1,8 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
-#ifdef POLYSCOPE_BACKEND_OPENGL3_GLFW_ENABLED
+#ifdef POLYSCOPE_BACKEND_OPENGL3_ENABLED // (any of the openGL3 backends)
 #include "polyscope/render/opengl/gl_engine.h"
 
+#include "polyscope/internal.h"
 #include "polyscope/messages.h"
 #include "polyscope/options.h"
 #include "polyscope/polyscope.h"
@@ -22,25 +23,25 @@
 #include "polyscope/render/opengl/shaders/surface_mesh_shaders.h"
 #include "polyscope/render/opengl/shaders/texture_draw_shaders.h"
 #include "polyscope/render/opengl/shaders/vector_shaders.h"
+#include "polyscope/render/opengl/shaders/volume_grid_shaders.h"
 #include "polyscope/render/opengl/shaders/volume_mesh_shaders.h"
 
 #include "stb_image.h"
 
+#include <fstream>
 #include <set>
+#include <sstream>
 
 namespace polyscope {
 namespace render {
 
 namespace backend_openGL3_glfw {
 
-GLEngine* glEngine = nullptr; // alias for global engine pointer
-
-void initializeRenderEngine() {
-  glEngine = new GLEngine();
-  glEngine->initialize();
-  engine = glEngine;
-  engine->allocateGlobalBuffersAndPrograms();
-}
+// Whether the BPTC formats (BC6H, BC7) of GL 4.2 or ARB_texture_compression_bptc can be used, see
+// options::compressMaterialTextures. Without them the compressed TextureFormats are stored uncompressed.
+bool bptcCompressionSupported = false;
+const GLenum compressedRGBBPTCUnsignedFloatEnum = 0x8E8F; // (glad is generated for GL 3.3, which lacks these)
+const GLenum compressedRGBABPTCUnormEnum = 0x8E8C;
 
 // == Map enums to native values
 
@@ -58,6 +59,10 @@ inline GLenum internalFormat(const TextureFormat& x) {
     case TextureFormat::RGB32F:     return GL_RGBA32F;
     case TextureFormat::RGBA32F:    return GL_RGBA32F;
     case TextureFormat::DEPTH24:    return GL_DEPTH_COMPONENT24;
+    case TextureFormat::R11F_G11F_B10F: return GL_R11F_G11F_B10F;
+    case TextureFormat::SRGB8_ALPHA8:   return GL_SRGB8_ALPHA8;
+    case TextureFormat::BC6H_RGB16F:    return bptcCompressionSupported ? compressedRGBBPTCUnsignedFloatEnum : GL_RGB16F;
+    case TextureFormat::BC7_RGB8:       return bptcCompressionSupported ? compressedRGBABPTCUnormEnum : GL_RGB8;
   }
   throw std::runtime_error("bad enum");
 }
@@ -74,6 +79,10 @@ inline GLenum formatF(const TextureFormat& x) {
     case TextureFormat::RGB32F:     return GL_RGB;
     case TextureFormat::RGBA32F:    return GL_RGBA;
     case TextureFormat::DEPTH24:    return GL_DEPTH_COMPONENT;
+    case TextureFormat::R11F_G11F_B10F: return GL_RGB;
+    case TextureFormat::SRGB8_ALPHA8:   return GL_RGBA;
+    case TextureFormat::BC6H_RGB16F:    return GL_RGB;
+    case TextureFormat::BC7_RGB8:       return GL_RGB;
   }
   throw std::runtime_error("bad enum");
 }
@@ -90,6 +99,10 @@ inline GLenum type(const TextureFormat& x) {
     case TextureFormat::RGB32F:     return GL_FLOAT;
     case TextureFormat::RGBA32F:    return GL_FLOAT;
     case TextureFormat::DEPTH24:    return GL_FLOAT;
+    case TextureFormat::R11F_G11F_B10F: return GL_FLOAT;
+    case TextureFormat::SRGB8_ALPHA8:   return GL_UNSIGNED_BYTE;
+    case TextureFormat::BC6H_RGB16F:    return GL_FLOAT;
+    case TextureFormat::BC7_RGB8:       return GL_UNSIGNED_BYTE;
   }
   throw std::runtime_error("bad enum");
 }
@@ -211,6 +224,395 @@ void printProgramInfoLog(GLuint handle) {
   }
 }
 
+// =============================================================
+// ================== Shader binary cache ======================
+// =============================================================
+
+// Linked programs may be saved to disk and reloaded on later runs when options::shaderCacheDirectory is set. glad is
+// generated for openGL 3.3, which does not include the program binary API (core in 4.1, or ARB_get_program_binary), so
+// we load those few functions ourselves when available.
+
+namespace {
+
+#ifdef _WIN32
+#define POLYSCOPE_GL_APIENTRY __stdcall
+#else
+#define POLYSCOPE_GL_APIENTRY
+#endif
+typedef void(POLYSCOPE_GL_APIENTRY* GetProgramBinaryFunc)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+typedef void(POLYSCOPE_GL_APIENTRY* ProgramBinaryFunc)(GLuint, GLenum, const void*, GLsizei);
+typedef void(POLYSCOPE_GL_APIENTRY* ProgramParameteriFunc)(GLuint, GLenum, GLint);
+
+GetProgramBinaryFunc getProgramBinaryFunc = nullptr;
+ProgramBinaryFunc programBinaryFunc = nullptr;
+ProgramParameteriFunc programParameteriFunc = nullptr;
+
+const GLenum programBinaryRetrievableHintEnum = 0x8257; // GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+const GLenum programBinaryLengthEnum = 0x8741;          // GL_PROGRAM_BINARY_LENGTH
+
+const char shaderBinaryMagic[4] = {'P', 'S', 'S', 'B'};
+const uint32_t shaderBinaryFormatVersion = 1;
+
+// Identifies the driver which produced a binary. Binaries are only valid for exactly the same driver.
+std::string shaderBinaryDriverString;
+
+// FNV-1a, which (unlike std::hash) is stable between runs and platforms
+uint64_t hashString(const std::string& str, uint64_t hash = 14695981039346656037ULL) {
+  for (char c : str) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool hasGLExtension(const std::string& name) {
+  GLint nExtensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &nExtensions);
+  for (GLint i = 0; i < nExtensions; i++) {
+    const char* ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+    if (ext != nullptr && name == ext) return true;
+  }
+  return false;
+}
+
+void loadShaderBinaryFunctions(GLEngine::ProcAddressFunc getProcAddress) {
+  std::string version(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+  std::string vendor(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+  std::string renderer(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+  shaderBinaryDriverString = vendor + " | " + renderer + " | " + version;
+
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  bool supported = (major > 4 || (major == 4 && minor >= 1)) || hasGLExtension("GL_ARB_get_program_binary");
+  if (!supported) return;
+
+  getProgramBinaryFunc = reinterpret_cast<GetProgramBinaryFunc>(getProcAddress("glGetProgramBinary"));
+  programBinaryFunc = reinterpret_cast<ProgramBinaryFunc>(getProcAddress("glProgramBinary"));
+  programParameteriFunc = reinterpret_cast<ProgramParameteriFunc>(getProcAddress("glProgramParameteri"));
+}
+
+void loadTextureCompressionSupport() {
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  bptcCompressionSupported = options::compressMaterialTextures &&
+                             ((major > 4 || (major == 4 && minor >= 2)) ||
+                              hasGLExtension("GL_ARB_texture_compression_bptc"));
+}
+
+// The targets of GL 4.6 or ARB_pipeline_statistics_query, in the order of GPUPipelineStatistics (glad is generated for
+// GL 3.3, which lacks these)
+bool pipelineStatisticsSupported = false;
+const std::array<GLenum, 4> pipelineStatisticsTargets{{
+    0x82EE, // GL_VERTICES_SUBMITTED
+    0x82EF, // GL_PRIMITIVES_SUBMITTED
+    0x887F, // GL_GEOMETRY_SHADER_INVOCATIONS
+    0x82F4, // GL_FRAGMENT_SHADER_INVOCATIONS
+}};
+
+void loadPipelineStatisticsSupport() {
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  pipelineStatisticsSupported =
+      (major > 4 || (major == 4 && minor >= 6)) || hasGLExtension("GL_ARB_pipeline_statistics_query");
+}
+
+bool shaderBinaryCacheEnabled() {
+  return !options::shaderCacheDirectory.empty() && getProgramBinaryFunc != nullptr && programBinaryFunc != nullptr &&
+         programParameteriFunc != nullptr;
+}
+
+uint64_t hashShaderSources(const std::vector<ShaderStageSpecification>& stages) {
+  uint64_t hash = hashString(shaderCommonSource);
+  for (const ShaderStageSpecification& s : stages) {
+    hash = hashString(std::to_string(static_cast<int>(s.stage)), hash);
+    hash = hashString(s.src, hash);
+  }
+  return hash;
+}
+
+bool sameShaderSources(const std::vector<ShaderStageSpecification>& stagesA,
+                       const std::vector<ShaderStageSpecification>& stagesB) {
+  if (stagesA.size() != stagesB.size()) return false;
+  for (size_t i = 0; i < stagesA.size(); i++) {
+    if (stagesA[i].stage != stagesB[i].stage || stagesA[i].src != stagesB[i].src) return false;
+  }
+  return true;
+}
+
+std::string shaderBinaryFilename(uint64_t sourceHash) {
+  std::ostringstream name;
+  name << options::shaderCacheDirectory << "/polyscope_shader_" << std::hex
+       << hashString(shaderBinaryDriverString, sourceHash) << ".bin";
+  return name.str();
+}
+
+// Returns a linked program, or 0 if there is no valid cached binary (missing, stale, or rejected by the driver)
+ProgramHandle loadShaderBinary(const std::string& filename, uint64_t sourceHash) {
+  std::ifstream inFile(filename, std::ios::binary);
+  if (!inFile) return 0;
+
+  char magic[4];
+  uint32_t version = 0, driverLength = 0, binaryLength = 0;
+  uint64_t fileSourceHash = 0;
+  GLenum binaryFormat = 0;
+  inFile.read(magic, 4);
+  inFile.read(reinterpret_cast<char*>(&version), sizeof(version));
+  inFile.read(reinterpret_cast<char*>(&fileSourceHash), sizeof(fileSourceHash));
+  inFile.read(reinterpret_cast<char*>(&driverLength), sizeof(driverLength));
+  if (!inFile || !std::equal(magic, magic + 4, shaderBinaryMagic) || version != shaderBinaryFormatVersion ||
+      fileSourceHash != sourceHash || driverLength != shaderBinaryDriverString.size()) {
+    return 0;
+  }
+  std::string fileDriver(driverLength, ' ');
+  inFile.read(&fileDriver[0], driverLength);
+  inFile.read(reinterpret_cast<char*>(&binaryFormat), sizeof(binaryFormat));
+  inFile.read(reinterpret_cast<char*>(&binaryLength), sizeof(binaryLength));
+  if (!inFile || fileDriver != shaderBinaryDriverString || binaryLength == 0) {
+    return 0;
+  }
+  std::vector<char> binary(binaryLength);
+  inFile.read(&binary[0], binaryLength);
+  if (!inFile) return 0;
+
+  ProgramHandle handle = glCreateProgram();
+  programBinaryFunc(handle, binaryFormat, &binary[0], binaryLength);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(handle, GL_LINK_STATUS, &linked);
+  if (linked != GL_TRUE) {
+    // The driver rejected the binary, which is allowed to happen at any time (e.g. after an update). Clear any errors
+    // raised so the program can be compiled normally instead.
+    glDeleteProgram(handle);
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    return 0;
+  }
+  return handle;
+}
+
+void saveShaderBinary(ProgramHandle handle, const std::string& filename, uint64_t sourceHash) {
+  GLint binaryLength = 0;
+  glGetProgramiv(handle, programBinaryLengthEnum, &binaryLength);
+  if (binaryLength <= 0) return;
+
+  std::vector<char> binary(binaryLength);
+  GLenum binaryFormat = 0;
+  getProgramBinaryFunc(handle, binaryLength, nullptr, &binaryFormat, &binary[0]);
+
+  std::ofstream outFile(filename, std::ios::binary | std::ios::trunc);
+  if (!outFile) {
+    if (options::verbosity > 1) {
+      info("could not write shader binary cache file " + filename);
+    }
+    return;
+  }
+  uint32_t driverLength = shaderBinaryDriverString.size();
+  uint32_t binaryLengthU = binaryLength;
+  outFile.write(shaderBinaryMagic, 4);
+  outFile.write(reinterpret_cast<const char*>(&shaderBinaryFormatVersion), sizeof(shaderBinaryFormatVersion));
+  outFile.write(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash));
+  outFile.write(reinterpret_cast<const char*>(&driverLength), sizeof(driverLength));
+  outFile.write(shaderBinaryDriverString.c_str(), driverLength);
+  outFile.write(reinterpret_cast<const char*>(&binaryFormat), sizeof(binaryFormat));
+  outFile.write(reinterpret_cast<const char*>(&binaryLengthU), sizeof(binaryLengthU));
+  outFile.write(&binary[0], binaryLength);
+}
+
+} // namespace
+
+// =============================================================
+// ============== Parallel shader compilation ==================
+// =============================================================
+
+// With KHR_parallel_shader_compile (or its ARB twin), the driver compiles and links on its own threads, and
+// GL_COMPLETION_STATUS_KHR can be polled without waiting for it. glad does not include the extension, so we load its
+// one function ourselves.
+
+namespace {
+
+typedef void(POLYSCOPE_GL_APIENTRY* MaxShaderCompilerThreadsFunc)(GLuint);
+
+const GLenum completionStatusEnum = 0x91B1; // GL_COMPLETION_STATUS_KHR, the same value for the ARB extension
+
+bool parallelShaderCompileSupported = false;
+
+void loadParallelShaderCompileFunctions(GLEngine::ProcAddressFunc getProcAddress) {
+  MaxShaderCompilerThreadsFunc maxThreadsFunc = nullptr;
+  if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+    maxThreadsFunc = reinterpret_cast<MaxShaderCompilerThreadsFunc>(getProcAddress("glMaxShaderCompilerThreadsKHR"));
+  } else if (hasGLExtension("GL_ARB_parallel_shader_compile")) {
+    maxThreadsFunc = reinterpret_cast<MaxShaderCompilerThreadsFunc>(getProcAddress("glMaxShaderCompilerThreadsARB"));
+  }
+  if (maxThreadsFunc == nullptr) return;
+
+  maxThreadsFunc(0xFFFFFFFF); // as many threads as the driver likes
+  parallelShaderCompileSupported = true;
+}
+
+bool programLinkComplete(ProgramHandle handle) {
+  GLint complete = GL_FALSE;
+  glGetProgramiv(handle, completionStatusEnum, &complete);
+  return complete == GL_TRUE;
+}
+
+// Stands in for the location of a uniform or texture while its program links in the background, when it is not yet
+// known whether the program uses it
+const int unresolvedLocation = -2;
+
+} // namespace
+
+// =============================================================
+// ================= Direct state access =======================
+// =============================================================
+
+// With GL 4.5 (or ARB_direct_state_access), buffers and textures are edited through their names, rather than bound to
+// a target first, which saves a bind per upload and leaves the bindings of the draws alone. Only the openGL4_*
+// backends ask for it. glad is generated for GL 3.3, so we load these functions ourselves.
+
+namespace {
+
+typedef void(POLYSCOPE_GL_APIENTRY* NamedBufferDataFunc)(GLuint, GLsizeiptr, const void*, GLenum);
+typedef void(POLYSCOPE_GL_APIENTRY* NamedBufferSubDataFunc)(GLuint, GLintptr, GLsizeiptr, const void*);
+typedef void(POLYSCOPE_GL_APIENTRY* TextureSubImage1DFunc)(GLuint, GLint, GLint, GLsizei, GLenum, GLenum, const void*);
+typedef void(POLYSCOPE_GL_APIENTRY* TextureSubImage2DFunc)(GLuint, GLint, GLint, GLint, GLsizei, GLsizei, GLenum,
+                                                           GLenum, const void*);
+
+NamedBufferDataFunc namedBufferDataFunc = nullptr;
+NamedBufferSubDataFunc namedBufferSubDataFunc = nullptr;
+TextureSubImage1DFunc textureSubImage1DFunc = nullptr;
+TextureSubImage2DFunc textureSubImage2DFunc = nullptr;
+bool directStateAccessSupported = false;
+
+void loadDirectStateAccessFunctions(GLEngine::ProcAddressFunc getProcAddress) {
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  bool supported = (major > 4 || (major == 4 && minor >= 5)) || hasGLExtension("GL_ARB_direct_state_access");
+  if (!supported) return;
+
+  namedBufferDataFunc = reinterpret_cast<NamedBufferDataFunc>(getProcAddress("glNamedBufferData"));
+  namedBufferSubDataFunc = reinterpret_cast<NamedBufferSubDataFunc>(getProcAddress("glNamedBufferSubData"));
+  textureSubImage1DFunc = reinterpret_cast<TextureSubImage1DFunc>(getProcAddress("glTextureSubImage1D"));
+  textureSubImage2DFunc = reinterpret_cast<TextureSubImage2DFunc>(getProcAddress("glTextureSubImage2D"));
+  directStateAccessSupported = namedBufferDataFunc != nullptr && namedBufferSubDataFunc != nullptr &&
+                               textureSubImage1DFunc != nullptr && textureSubImage2DFunc != nullptr;
+}
+
+// (Re)allocate a buffer's storage and fill it. Without direct state access the buffer is left bound to the target.
+void bufferData(GLenum target, GLuint buffer, GLsizeiptr bytes, const void* data, GLenum usage) {
+  if (directStateAccessSupported) {
+    namedBufferDataFunc(buffer, bytes, data, usage);
+  } else {
+    glBindBuffer(target, buffer);
+    glBufferData(target, bytes, data, usage);
+  }
+}
+
+void bufferSubData(GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr bytes, const void* data) {
+  if (directStateAccessSupported) {
+    namedBufferSubDataFunc(buffer, offset, bytes, data);
+  } else {
+    glBindBuffer(target, buffer);
+    glBufferSubData(target, offset, bytes, data);
+  }
+}
+
+} // namespace
+
+namespace {
+
+// The program, textures, and fixed-function state set by the last draws. Consecutive draws from programs sharing a
+// compiled program (e.g. many structures of the same kind) then skip re-binding it, textures which are already on their
+// unit (materials, colormaps) are not bound again, and depth/blend/cull modes which are already active are not set
+// again. Only valid while every bind goes through the helpers below; anything else touching this state (ImGui, user
+// code between frames) is followed by forgetGLBindings().
+struct GLBindingCache {
+  bool valid = false;
+  ProgramHandle program = 0;
+  GLuint activeUnit = 0;
+  std::vector<std::pair<GLenum, TextureBufferHandle>> unitTextures; // last target and texture bound on each unit
+
+  // -1 where unknown
+  int depthMode = -1;
+  int blendMode = -1;
+  int backfaceCull = -1;
+  int colorMask = -1; // one bit per channel
+};
+GLBindingCache bindingCache;
+
+void forgetGLBindings() { bindingCache = GLBindingCache(); }
+
+void countSkippedChange() {
+  if (engine) engine->renderStats.redundantChangesSkipped++;
+}
+
+void useProgram(ProgramHandle handle) {
+  if (bindingCache.valid && bindingCache.program == handle) {
+    countSkippedChange();
+    return;
+  }
+  glUseProgram(handle);
+  if (!bindingCache.valid) {
+    // start tracking from a known state
+    bindingCache.valid = true;
+    bindingCache.activeUnit = 0;
+    glActiveTexture(GL_TEXTURE0);
+  }
+  bindingCache.program = handle;
+  if (engine) engine->renderStats.programBinds++;
+}
+
+void setActiveTextureUnit(GLuint unit) {
+  if (bindingCache.valid && bindingCache.activeUnit == unit) return;
+  glActiveTexture(GL_TEXTURE0 + unit);
+  bindingCache.activeUnit = unit;
+}
+
+void bindTextureToActiveUnit(GLenum target, TextureBufferHandle handle) {
+  if (!bindingCache.valid) {
+    glBindTexture(target, handle);
+    if (engine) engine->renderStats.textureBinds++;
+    return;
+  }
+  if (bindingCache.unitTextures.size() <= bindingCache.activeUnit) {
+    bindingCache.unitTextures.resize(bindingCache.activeUnit + 1, {GL_NONE, 0});
+  }
+  std::pair<GLenum, TextureBufferHandle>& bound = bindingCache.unitTextures[bindingCache.activeUnit];
+  if (bound.first == target && bound.second == handle) {
+    countSkippedChange();
+    return;
+  }
+  glBindTexture(target, handle);
+  bound = {target, handle};
+  if (engine) engine->renderStats.textureBinds++;
+}
+
+// True (and records the new value) if the state must actually be changed
+bool stateChangeNeeded(int& current, int newVal) {
+  if (current == newVal) {
+    countSkippedChange();
+    return false;
+  }
+  current = newVal;
+  if (engine) engine->renderStats.stateChanges++;
+  return true;
+}
+
+void forgetTexture(TextureBufferHandle handle) {
+  // (a deleted name may be handed out again to a new texture)
+  for (std::pair<GLenum, TextureBufferHandle>& bound : bindingCache.unitTextures) {
+    if (bound.second == handle) bound = {GL_NONE, 0};
+  }
+}
+
+void forgetProgram(ProgramHandle handle) {
+  if (bindingCache.program == handle) bindingCache.valid = false;
+}
+
+} // namespace
+
 // =============================================================
 // ==================== Texture buffer =========================
 // =============================================================
@@ -220,7 +622,7 @@ GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int size1D, uns
     : TextureBuffer(1, format_, size1D) {
 
   glGenTextures(1, &handle);
-  glBindTexture(GL_TEXTURE_1D, handle);
+  bindTextureToActiveUnit(GL_TEXTURE_1D, handle);
   glTexImage1D(GL_TEXTURE_1D, 0, internalFormat(format), size1D, 0, formatF(format), GL_UNSIGNED_BYTE, data);
   checkGLError();
 
@@ -230,7 +632,7 @@ GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int size1D, flo
     : TextureBuffer(1, format_, size1D) {
 
   glGenTextures(1, &handle);
-  glBindTexture(GL_TEXTURE_1D, handle);
+  bindTextureToActiveUnit(GL_TEXTURE_1D, handle);
   glTexImage1D(GL_TEXTURE_1D, 0, internalFormat(format), size1D, 0, formatF(format), GL_FLOAT, data);
   checkGLError();
 
@@ -242,7 +644,7 @@ GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int sizeX_, uns
     : TextureBuffer(2, format_, sizeX_, sizeY_) {
 
   glGenTextures(1, &handle);
-  glBindTexture(GL_TEXTURE_2D, handle);
+  bindTextureToActiveUnit(GL_TEXTURE_2D, handle);
   glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(format), sizeX, sizeY, 0, formatF(format), GL_UNSIGNED_BYTE, data);
   checkGLError();
 
@@ -253,14 +655,30 @@ GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int sizeX_, uns
     : TextureBuffer(2, format_, sizeX_, sizeY_) {
 
   glGenTextures(1, &handle);
-  glBindTexture(GL_TEXTURE_2D, handle);
+  bindTextureToActiveUnit(GL_TEXTURE_2D, handle);
   glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(format), sizeX, sizeY, 0, formatF(format), GL_FLOAT, data);
   checkGLError();
 
   setFilterMode(FilterMode::Nearest);
 }
 
-GLTextureBuffer::~GLTextureBuffer() { glDeleteTextures(1, &handle); }
+// create a 3D texture from data
+GLTextureBuffer::GLTextureBuffer(TextureFormat format_, unsigned int sizeX_, unsigned int sizeY_, unsigned int sizeZ_,
+                                 float* data)
+    : TextureBuffer(3, format_, sizeX_, sizeY_, sizeZ_) {
+
+  glGenTextures(1, &handle);
+  bindTextureToActiveUnit(GL_TEXTURE_3D, handle);
+  glTexImage3D(GL_TEXTURE_3D, 0, internalFormat(format), sizeX, sizeY, sizeZ, 0, formatF(format), GL_FLOAT, data);
+  checkGLError();
+
+  setFilterMode(FilterMode::Nearest);
+}
+
+GLTextureBuffer::~GLTextureBuffer() {
+  forgetTexture(handle);
+  glDeleteTextures(1, &handle);
+}
 
 void GLTextureBuffer::resize(unsigned int newLen) {
 
@@ -270,8 +688,8 @@ void GLTextureBuffer::resize(unsigned int newLen) {
   if (dim == 1) {
     glTexImage1D(GL_TEXTURE_1D, 0, internalFormat(format), sizeX, 0, formatF(format), type(format), nullptr);
   }
-  if (dim == 2) {
-    throw std::runtime_error("OpenGL error: called 1D resize on 2D texture");
+  if (dim > 1) {
+    throw std::runtime_error("OpenGL error: called 1D resize on " + std::to_string(dim) + "D texture");
   }
   checkGLError();
 }
@@ -280,13 +698,31 @@ void GLTextureBuffer::resize(unsigned int newX, unsigned int newY) {
 
   TextureBuffer::resize(newX, newY);
 
+  bind();
+  if (dim != 2) {
+    throw std::runtime_error("OpenGL error: called 2D resize on " + std::to_string(dim) + "D texture");
+  }
+  if (dim == 2) {
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(format), sizeX, sizeY, 0, formatF(format), type(format), nullptr);
+  }
+  checkGLError();
+}
+
+void GLTextureBuffer::setFormat(TextureFormat newFormat) {
+
+  TextureBuffer::setFormat(newFormat);
+
   bind();
   if (dim == 1) {
-    throw std::runtime_error("OpenGL error: called 2D resize on 1D texture");
+    glTexImage1D(GL_TEXTURE_1D, 0, internalFormat(format), sizeX, 0, formatF(format), type(format), nullptr);
   }
   if (dim == 2) {
     glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(format), sizeX, sizeY, 0, formatF(format), type(format), nullptr);
   }
+  if (dim == 3) {
+    glTexImage3D(GL_TEXTURE_3D, 0, internalFormat(format), sizeX, sizeY, sizeZ, 0, formatF(format), type(format),
+                 nullptr);
+  }
   checkGLError();
 }
 
@@ -305,9 +741,12 @@ void GLTextureBuffer::setFilterMode(FilterMode newMode) {
     break;
   }
   glTexParameteri(textureType(), GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  if (dim == 2) {
+  if (dim >= 2) {
     glTexParameteri(textureType(), GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   }
+  if (dim == 3) {
+    glTexParameteri(textureType(), GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  }
 
   checkGLError();
 }
@@ -357,17 +796,47 @@ std::vector<glm::vec3> GLTextureBuffer::getDataVector3() {
   return outData;
 }
 
+void GLTextureBuffer::setDataRows(unsigned int rowStart, unsigned int nRows, const float* data) {
+  if (dim != 2) throw std::runtime_error("called setDataRows on texture which is not 2 dimensional");
+  if (rowStart + nRows > sizeY) throw std::runtime_error("texture rows out of range in setDataRows");
+  if (nRows == 0) return;
+
+  if (directStateAccessSupported) {
+    textureSubImage2DFunc(handle, 0, 0, rowStart, sizeX, nRows, formatF(format), GL_FLOAT, data);
+  } else {
+    bind();
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, rowStart, sizeX, nRows, formatF(format), GL_FLOAT, data);
+  }
+  checkGLError();
+}
+
+void GLTextureBuffer::setData1D(unsigned int start, unsigned int count, const float* data) {
+  if (dim != 1) throw std::runtime_error("called setData1D on texture which is not 1 dimensional");
+  if (start + count > sizeX) throw std::runtime_error("texels out of range in setData1D");
+  if (count == 0) return;
+
+  if (directStateAccessSupported) {
+    textureSubImage1DFunc(handle, 0, start, count, formatF(format), GL_FLOAT, data);
+  } else {
+    bind();
+    glTexSubImage1D(GL_TEXTURE_1D, 0, start, count, formatF(format), GL_FLOAT, data);
+  }
+  checkGLError();
+}
+
 GLenum GLTextureBuffer::textureType() {
   if (dim == 1) {
     return GL_TEXTURE_1D;
   } else if (dim == 2) {
     return GL_TEXTURE_2D;
+  } else if (dim == 3) {
+    return GL_TEXTURE_3D;
   }
   throw std::runtime_error("bad texture type");
 }
 
 void GLTextureBuffer::bind() {
-  glBindTexture(textureType(), handle);
+  bindTextureToActiveUnit(textureType(), handle);
   checkGLError();
 }
 
@@ -375,8 +844,9 @@ void GLTextureBuffer::bind() {
 // ===================== Render buffer =========================
 // =============================================================
 
-GLRenderBuffer::GLRenderBuffer(RenderBufferType type_, unsigned int sizeX_, unsigned int sizeY_)
-    : RenderBuffer(type_, sizeX_, sizeY_) {
+GLRenderBuffer::GLRenderBuffer(RenderBufferType type_, unsigned int sizeX_, unsigned int sizeY_,
+                               unsigned int samples_)
+    : RenderBuffer(type_, sizeX_, sizeY_, samples_) {
   glGenRenderbuffers(1, &handle);
   checkGLError();
   resize(sizeX, sizeY);
@@ -389,7 +859,11 @@ void GLRenderBuffer::resize(unsigned int newX, unsigned int newY) {
   RenderBuffer::resize(newX, newY);
   bind();
 
-  glRenderbufferStorage(GL_RENDERBUFFER, native(type), sizeX, sizeY);
+  if (samples > 1) {
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, native(type), sizeX, sizeY);
+  } else {
+    glRenderbufferStorage(GL_RENDERBUFFER, native(type), sizeX, sizeY);
+  }
   checkGLError();
 }
 
@@ -510,6 +984,7 @@ void GLFrameBuffer::setDrawBuffers() {
 bool GLFrameBuffer::bindForRendering() {
   verifyBufferSizes();
   bind();
+  setSRGBWrites();
 
   // Check if the frame buffer is okay
   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
@@ -539,10 +1014,26 @@ bool GLFrameBuffer::bindForRendering() {
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+  // (the depth mask is left as it was, so this matches none of the tracked modes)
+  bindingCache.depthMode = -1;
+  bindingCache.blendMode = -1;
+
   checkGLError();
   return true;
 }
 
+void GLFrameBuffer::setSRGBWrites() const {
+  bool anySRGB = false;
+  for (const std::shared_ptr<TextureBuffer>& b : textureBuffersColor) {
+    anySRGB = anySRGB || b->getFormat() == TextureFormat::SRGB8_ALPHA8;
+  }
+  if (anySRGB) {
+    glEnable(GL_FRAMEBUFFER_SRGB);
+  } else {
+    glDisable(GL_FRAMEBUFFER_SRGB);
+  }
+}
+
 void GLFrameBuffer::clear() {
   if (!bindForRendering()) return;
 
@@ -569,126 +1060,473 @@ std::array<float, 4> GLFrameBuffer::readFloat4(int xPos, int yPos) {
   return result;
 }
 
+std::shared_ptr<PendingFloat4Read> GLFrameBuffer::readFloat4Async(int xPos, int yPos) {
+  bind();
+  return std::make_shared<GLPendingFloat4Read>(xPos, yPos);
+}
 
-std::vector<unsigned char> GLFrameBuffer::readBuffer() {
-
+std::vector<float> GLFrameBuffer::readFloat4Region(int xPos, int yPos, int regionSizeX, int regionSizeY) {
   glFlush();
   glFinish();
 
   bind();
 
-  int w = getSizeX();
-  int h = getSizeY();
+  std::vector<float> result(4 * static_cast<size_t>(regionSizeX) * regionSizeY);
+  if (result.empty()) return result;
+  glReadPixels(xPos, yPos, regionSizeX, regionSizeY, GL_RGBA, GL_FLOAT, &result.front());
+  checkGLError();
 
-  // Read from openGL
-  size_t buffSize = w * h * 4;
-  std::vector<unsigned char> buff(buffSize);
-  glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &(buff.front()));
+  return result;
+}
 
-  return buff;
+GLPixelReadback::GLPixelReadback(int xPos, int yPos, int sizeX, int sizeY, GLenum format, GLenum type,
+                                 size_t byteSize_)
+    : byteSize(byteSize_) {
+  // Read in to a pixel buffer object, so glReadPixels() returns immediately rather than waiting for rendering
+  glGenBuffers(1, &pixelBuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+  glBufferData(GL_PIXEL_PACK_BUFFER, byteSize, nullptr, GL_STREAM_READ);
+  glReadPixels(xPos, yPos, sizeX, sizeY, format, type, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  // Flush so the fence is guaranteed to eventually signal, even if nothing else is submitted
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush();
+
+  checkGLError();
 }
 
-void GLFrameBuffer::blitTo(FrameBuffer* targetIn) {
+GLPixelReadback::~GLPixelReadback() { release(); }
 
-  // it _better_ be a GL buffer
-  GLFrameBuffer* target = dynamic_cast<GLFrameBuffer*>(targetIn);
-  if (!target) throw std::runtime_error("tried to blitTo() non-GL framebuffer");
+void GLPixelReadback::release() {
+  if (fence != nullptr) {
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  if (pixelBuffer != 0) {
+    glDeleteBuffers(1, &pixelBuffer);
+    pixelBuffer = 0;
+  }
+}
 
-  // target->bindForRendering();
-  bindForRendering();
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->getHandle());
+bool GLPixelReadback::isReady() {
+  GLenum status = glClientWaitSync(fence, 0, 0);
+  return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
 
-  glBlitFramebuffer(0, 0, getSizeX(), getSizeY(), 0, 0, target->getSizeX(), target->getSizeY(), GL_COLOR_BUFFER_BIT,
-                    GL_LINEAR);
+void GLPixelReadback::fetch(void* dst) {
+  GLenum status;
+  do {
+    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms, in nanoseconds
+  } while (status == GL_TIMEOUT_EXPIRED);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+  glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, byteSize, dst);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
   checkGLError();
+
+  release();
 }
 
-// =============================================================
-// ==================  Shader Program  =========================
-// =============================================================
+GLPendingFloat4Read::GLPendingFloat4Read(int xPos, int yPos)
+    : readback(xPos, yPos, 1, 1, GL_RGBA, GL_FLOAT, sizeof(value)) {}
 
-GLShaderProgram::GLShaderProgram(const std::vector<ShaderStageSpecification>& stages, DrawMode dm)
-    : ShaderProgram(stages, dm) {
+bool GLPendingFloat4Read::isReady() { return haveValue || readback.isReady(); }
 
-  // Collect attributes and uniforms from all of the shaders
-  for (const ShaderStageSpecification& s : stages) {
-    for (ShaderSpecUniform u : s.uniforms) {
-      addUniqueUniform(u);
-    }
-    for (ShaderSpecAttribute a : s.attributes) {
-      addUniqueAttribute(a);
-    }
-    for (ShaderSpecTexture t : s.textures) {
-      addUniqueTexture(t);
-    }
+std::array<float, 4> GLPendingFloat4Read::getValue() {
+  if (!haveValue) {
+    readback.fetch(&value[0]);
+    haveValue = true;
   }
+  return value;
+}
 
-  if (attributes.size() == 0) {
-    throw std::invalid_argument("Uh oh... GLProgram has no attributes");
+GLPendingBufferRead::GLPendingBufferRead(int sizeX, int sizeY)
+    : readback(0, 0, sizeX, sizeY, GL_RGBA, GL_UNSIGNED_BYTE, 4 * sizeX * sizeY), value(4 * sizeX * sizeY) {}
+
+bool GLPendingBufferRead::isReady() { return haveValue || readback.isReady(); }
+
+std::vector<unsigned char> GLPendingBufferRead::getValue() {
+  if (!haveValue) {
+    readback.fetch(&value.front());
+    haveValue = true;
   }
+  return value;
+}
 
+GLOcclusionQuery::GLOcclusionQuery() {
+  glGenQueries(1, &handle);
+  checkGLError();
+}
 
-  // Perform setup tasks
-  compileGLProgram(stages);
-  setDataLocations();
-  createBuffers();
+GLOcclusionQuery::~GLOcclusionQuery() { glDeleteQueries(1, &handle); }
+
+void GLOcclusionQuery::begin() {
+  glBeginQuery(GL_ANY_SAMPLES_PASSED, handle);
   checkGLError();
 }
 
-GLShaderProgram::~GLShaderProgram() {
-  // Make sure that we free the buffers for all attributes
-  for (GLShaderAttribute& a : attributes) {
-    deleteAttributeBuffer(a);
-  }
+void GLOcclusionQuery::end() {
+  glEndQuery(GL_ANY_SAMPLES_PASSED);
+  pending = true;
+}
 
-  // Free the program
-  glDeleteProgram(programHandle);
+bool GLOcclusionQuery::isReady() {
+  if (!pending) return true;
+  GLuint available = GL_FALSE;
+  glGetQueryObjectuiv(handle, GL_QUERY_RESULT_AVAILABLE, &available);
+  return available == GL_TRUE;
 }
 
-void GLShaderProgram::addUniqueAttribute(ShaderSpecAttribute newAttribute) {
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == newAttribute.name && a.type == newAttribute.type) {
-      return;
-    }
+bool GLOcclusionQuery::anySamplesPassed() {
+  if (pending) {
+    GLuint anyPassed = 0;
+    glGetQueryObjectuiv(handle, GL_QUERY_RESULT, &anyPassed);
+    result = anyPassed != 0;
+    pending = false;
   }
-  attributes.push_back(GLShaderAttribute{newAttribute.name, newAttribute.type, newAttribute.arrayCount, -1, 777, 777});
+  return result;
 }
 
-void GLShaderProgram::addUniqueUniform(ShaderSpecUniform newUniform) {
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == newUniform.name && u.type == newUniform.type) {
-      return;
-    }
-  }
-  uniforms.push_back(GLShaderUniform{newUniform.name, newUniform.type, false, 777});
+GLPendingCapture::~GLPendingCapture() { glDeleteQueries(1, &handle); }
+
+bool GLPendingCapture::isReady() {
+  if (haveValue) return true;
+  GLuint available = GL_FALSE;
+  glGetQueryObjectuiv(handle, GL_QUERY_RESULT_AVAILABLE, &available);
+  return available == GL_TRUE;
 }
 
-void GLShaderProgram::addUniqueTexture(ShaderSpecTexture newTexture) {
-  for (GLShaderTexture& t : textures) {
-    if (t.name == newTexture.name && t.dim == newTexture.dim) {
-      return;
-    }
+size_t GLPendingCapture::getVertexCount() {
+  if (!haveValue) {
+    GLuint nTriangles = 0;
+    glGetQueryObjectuiv(handle, GL_QUERY_RESULT, &nTriangles);
+    value = 3 * static_cast<size_t>(nTriangles);
+    haveValue = true;
   }
-  textures.push_back(GLShaderTexture{newTexture.name, newTexture.dim, 777, false, nullptr, nullptr, 777});
+  return value;
 }
 
+std::vector<unsigned char> GLFrameBuffer::readBuffer() {
 
-void GLShaderProgram::deleteAttributeBuffer(GLShaderAttribute& attribute) {
-  glUseProgram(programHandle);
-  glBindVertexArray(vaoHandle);
-  glDeleteBuffers(1, &attribute.VBOLoc);
-}
+  glFlush();
+  glFinish();
 
-void GLShaderProgram::compileGLProgram(const std::vector<ShaderStageSpecification>& stages) {
+  bind();
 
+  int w = getSizeX();
+  int h = getSizeY();
 
-  // Compile all of the shaders
-  std::vector<ShaderHandle> handles;
-  for (const ShaderStageSpecification& s : stages) {
-    ShaderHandle h = glCreateShader(native(s.stage));
-    std::array<const char*, 2> srcs = {s.src.c_str(), shaderCommonSource};
-    glShaderSource(h, 2, &(srcs[0]), nullptr);
-    glCompileShader(h);
+  // Read from openGL
+  size_t buffSize = w * h * 4;
+  std::vector<unsigned char> buff(buffSize);
+  glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, &(buff.front()));
+
+  return buff;
+}
+
+std::vector<float> GLFrameBuffer::readDepthBuffer() {
+
+  glFlush();
+  glFinish();
+
+  bind();
+
+  int w = getSizeX();
+  int h = getSizeY();
+
+  std::vector<float> buff(static_cast<size_t>(w) * h);
+  glReadPixels(0, 0, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, &(buff.front()));
+  checkGLError();
+
+  return buff;
+}
+
+std::shared_ptr<PendingBufferRead> GLFrameBuffer::readBufferAsync() {
+  bind();
+  return std::make_shared<GLPendingBufferRead>(getSizeX(), getSizeY());
+}
+
+void GLFrameBuffer::blitTo(FrameBuffer* targetIn) {
+
+  // it _better_ be a GL buffer
+  GLFrameBuffer* target = dynamic_cast<GLFrameBuffer*>(targetIn);
+  if (!target) throw std::runtime_error("tried to blitTo() non-GL framebuffer");
+
+  // target->bindForRendering();
+  bindForRendering();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->getHandle());
+  target->setSRGBWrites();
+
+  glBlitFramebuffer(0, 0, getSizeX(), getSizeY(), 0, 0, target->getSizeX(), target->getSizeY(), GL_COLOR_BUFFER_BIT,
+                    GL_LINEAR);
+  checkGLError();
+}
+
+void GLFrameBuffer::blitColorAndDepthTo(FrameBuffer* targetIn) {
+
+  GLFrameBuffer* target = dynamic_cast<GLFrameBuffer*>(targetIn);
+  if (!target) throw std::runtime_error("tried to blitColorAndDepthTo() non-GL framebuffer");
+
+  bindForRendering();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->getHandle());
+  target->setSRGBWrites();
+
+  // depth can only be blitted with nearest filtering, which is also what we want for an exact copy
+  glBlitFramebuffer(0, 0, getSizeX(), getSizeY(), 0, 0, target->getSizeX(), target->getSizeY(),
+                    GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+  checkGLError();
+}
+
+// =============================================================
+// ==================== Attribute buffer =======================
+// =============================================================
+
+GLAttributeBuffer::GLAttributeBuffer(DataType dataType_, int arrayCount_) : AttributeBuffer(dataType_, arrayCount_) {
+  glGenBuffers(1, &handle);
+  bind(); // creates the buffer object, which direct state access needs
+  checkGLError();
+}
+
+GLAttributeBuffer::~GLAttributeBuffer() { glDeleteBuffers(1, &handle); }
+
+void GLAttributeBuffer::bind() { glBindBuffer(GL_ARRAY_BUFFER, handle); }
+
+void* GLAttributeBuffer::getNativeHandle() { return reinterpret_cast<void*>(static_cast<uintptr_t>(handle)); }
+
+void GLAttributeBuffer::checkType(DataType type) {
+  if (type != dataType) {
+    throw std::invalid_argument("Tried to set attribute buffer with wrong type. Actual type: " +
+                                std::to_string(static_cast<int>(dataType)) +
+                                "  Attempted type: " + std::to_string(static_cast<int>(type)));
+  }
+}
+
+void GLAttributeBuffer::upload(const void* data, size_t nEntries, size_t entryBytes, bool update, int offset,
+                               int size) {
+  trackUpdate();
+  GLenum usage = streaming ? GL_STREAM_DRAW : GL_STATIC_DRAW;
+
+  if (update) {
+    // TODO: Allow modifications to non-contiguous memory
+    if (size == -1) size = dataSize;
+    if (streaming && offset == 0 && size == dataSize) {
+      // Orphan the storage: the driver allocates new storage for the data, and frees the old one once the draws which
+      // read it are done, instead of waiting for them. (GL 3.3 has no persistently mapped buffers to cycle through.)
+      bufferData(GL_ARRAY_BUFFER, handle, entryBytes * size, data, usage);
+    } else {
+      bufferSubData(GL_ARRAY_BUFFER, handle, entryBytes * offset, entryBytes * size, data);
+    }
+  } else {
+    bufferData(GL_ARRAY_BUFFER, handle, entryBytes * nEntries, data, usage);
+    dataSize = nEntries;
+    allocation.setSize(entryBytes * nEntries);
+  }
+  checkGLError();
+
+  // the cached scene is stale now (this is a no-op for uploads made while rendering the scene)
+  requestRedraw();
+}
+
+void GLAttributeBuffer::allocate(long int nEntries) {
+  trackUpdate();
+  size_t bytes = entryBytes() * static_cast<size_t>(nEntries);
+  bufferData(GL_ARRAY_BUFFER, handle, bytes, nullptr, GL_DYNAMIC_COPY); // (written by the GPU, then read by it)
+  dataSize = nEntries;
+  allocation.setSize(bytes);
+  checkGLError();
+}
+
+void GLAttributeBuffer::setData(const std::vector<glm::vec2>& data, bool update, int offset, int size) {
+  static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "glm::vec2 must be tightly packed");
+  checkType(DataType::Vector2Float);
+  upload(data.empty() ? nullptr : &data[0][0], data.size(), sizeof(glm::vec2), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<glm::vec3>& data, bool update, int offset, int size) {
+  static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be tightly packed");
+  checkType(DataType::Vector3Float);
+  upload(data.empty() ? nullptr : &data[0][0], data.size(), sizeof(glm::vec3), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<glm::vec4>& data, bool update, int offset, int size) {
+  static_assert(sizeof(glm::vec4) == 4 * sizeof(float), "glm::vec4 must be tightly packed");
+  checkType(DataType::Vector4Float);
+  upload(data.empty() ? nullptr : &data[0][0], data.size(), sizeof(glm::vec4), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<float>& data, bool update, int offset, int size) {
+  checkType(DataType::Float);
+  upload(data.data(), data.size(), sizeof(float), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<int>& data, bool update, int offset, int size) {
+  checkType(DataType::Int);
+
+  // TODO I've seen strange bugs when using int's in shaders. Need to figure
+  // out it it's my shaders or something wrong with this function
+
+  // Convert data to GL_INT (probably does nothing)
+  std::vector<GLint> intData(data.size());
+  for (unsigned int i = 0; i < data.size(); i++) {
+    intData[i] = static_cast<GLint>(data[i]);
+  }
+  upload(intData.data(), intData.size(), sizeof(GLint), update, offset, size);
+}
+
+void GLAttributeBuffer::setData(const std::vector<uint32_t>& data, bool update, int offset, int size) {
+  checkType(DataType::UInt);
+
+  // TODO I've seen strange bugs when using int's in shaders. Need to figure
+  // out it it's my shaders or something wrong with this function
+
+  // Convert data to GL_UINT (probably does nothing)
+  std::vector<GLuint> intData(data.size());
+  for (unsigned int i = 0; i < data.size(); i++) {
+    intData[i] = static_cast<GLuint>(data[i]);
+  }
+  upload(intData.data(), intData.size(), sizeof(GLuint), update, offset, size);
+}
+
+// =============================================================
+// ==================  Shader Program  =========================
+// =============================================================
+
+GLCompiledProgram::~GLCompiledProgram() {
+  forgetProgram(handle);
+  glDeleteProgram(handle);
+}
+
+GLShaderProgram::GLShaderProgram(const std::vector<ShaderStageSpecification>& stages, DrawMode dm,
+                                 bool linkInBackground, const std::vector<std::string>& capturedOutputs)
+    : GLShaderProgram(stages, dm, nullptr, linkInBackground, capturedOutputs) {}
+
+GLShaderProgram::GLShaderProgram(const std::vector<ShaderStageSpecification>& stages, DrawMode dm,
+                                 std::shared_ptr<GLCompiledProgram> compiledProgram_, bool linkInBackground,
+                                 const std::vector<std::string>& capturedOutputs)
+    : ShaderProgram(stages, dm), compiledProgram(compiledProgram_) {
+
+  // Collect attributes and uniforms from all of the shaders
+  for (const ShaderStageSpecification& s : stages) {
+    for (ShaderSpecUniform u : s.uniforms) {
+      addUniqueUniform(u);
+    }
+    for (ShaderSpecAttribute a : s.attributes) {
+      addUniqueAttribute(a);
+    }
+    for (ShaderSpecTexture t : s.textures) {
+      addUniqueTexture(t);
+    }
+  }
+
+  if (attributes.size() == 0) {
+    throw std::invalid_argument("Uh oh... GLProgram has no attributes");
+  }
+
+
+  // Perform setup tasks
+  // (compilation is skipped if we are sharing an already-linked program)
+  if (!compiledProgram) {
+    compiledProgram = std::make_shared<GLCompiledProgram>();
+    compiledProgram->capturedOutputs = capturedOutputs;
+    compileGLProgram(stages, linkInBackground);
+    compiledProgram->handle = programHandle;
+  }
+  programHandle = compiledProgram->handle;
+  if (compiledProgram->linkPending) {
+    assumeDataLocations();
+  } else {
+    setDataLocations();
+  }
+  createBuffers();
+  checkGLError();
+}
+
+GLShaderProgram::~GLShaderProgram() {
+  // (attribute buffers free themselves when their last user lets go of them)
+
+  // The program itself is freed when the last user of the compiled program is done with it
+  if (compiledProgram->lastUser == this) {
+    compiledProgram->lastUser = nullptr;
+  }
+}
+
+void GLShaderProgram::addUniqueAttribute(ShaderSpecAttribute newAttribute) {
+  for (GLShaderAttribute& a : attributes) {
+    if (a.name == newAttribute.name && a.type == newAttribute.type) {
+      return;
+    }
+  }
+  attributes.push_back(GLShaderAttribute{newAttribute.name, newAttribute.type, newAttribute.arrayCount, 777, nullptr});
+}
+
+void GLShaderProgram::addUniqueUniform(ShaderSpecUniform newUniform) {
+  for (GLShaderUniform& u : uniforms) {
+    if (u.name == newUniform.name && u.type == newUniform.type) {
+      return;
+    }
+  }
+  uniforms.push_back(GLShaderUniform{newUniform.name, newUniform.type, false, 777, false, {}, 0, 0});
+}
+
+void GLShaderProgram::addUniqueTexture(ShaderSpecTexture newTexture) {
+  for (GLShaderTexture& t : textures) {
+    if (t.name == newTexture.name && t.dim == newTexture.dim) {
+      return;
+    }
+  }
+  textures.push_back(GLShaderTexture{newTexture.name, newTexture.dim, 777, false, nullptr, nullptr, 777});
+}
+
+
+void GLShaderProgram::compileGLProgram(const std::vector<ShaderStageSpecification>& stages, bool linkInBackground) {
+
+  // Use a previously-linked binary from the on-disk cache, if there is one
+  bool useBinaryCache = shaderBinaryCacheEnabled();
+  uint64_t sourceHash = 0;
+  std::string binaryFilename;
+  if (useBinaryCache) {
+    sourceHash = hashShaderSources(stages);
+    binaryFilename = shaderBinaryFilename(sourceHash);
+    programHandle = loadShaderBinary(binaryFilename, sourceHash);
+    if (programHandle != 0) {
+      checkGLError();
+      return;
+    }
+  }
+
+  // Attribute locations must be known before the link finishes to set up buffers for a background link, so we choose
+  // them, one slot per array entry. (Too many for the hardware, and we link in the foreground and ask instead.)
+  if (linkInBackground) {
+    GLint maxAttributes = 0;
+    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttributes);
+    int nSlots = 0;
+    for (const GLShaderAttribute& a : attributes) {
+      compiledProgram->boundAttributeLocations.emplace_back(a.name, nSlots);
+      nSlots += a.arrayCount;
+    }
+    if (nSlots > maxAttributes) {
+      linkInBackground = false;
+      compiledProgram->boundAttributeLocations.clear();
+    }
+  }
+
+  // Compile all of the shaders
+  std::vector<ShaderHandle> handles;
+  for (const ShaderStageSpecification& s : stages) {
+    ShaderHandle h = glCreateShader(native(s.stage));
+    std::array<const char*, 2> srcs = {s.src.c_str(), shaderCommonSource};
+    glShaderSource(h, 2, &(srcs[0]), nullptr);
+    glCompileShader(h);
+
+    handles.push_back(h);
+
+    // (checking the compile waits for it, so a background link checks once it is done)
+    if (linkInBackground) {
+      compiledProgram->pendingShaders.push_back(h);
+      compiledProgram->pendingShaderSources.push_back(s.src);
+      continue;
+    }
 
     // Catch the error here, so we can print shader source before re-throwing
     try {
@@ -699,8 +1537,6 @@ void GLShaderProgram::compileGLProgram(const std::vector<ShaderStageSpecificatio
       std::cout << s.src.c_str() << std::endl;
       throw;
     }
-
-    handles.push_back(h);
   }
 
   // Create the program and attach the shaders
@@ -710,9 +1546,35 @@ void GLShaderProgram::compileGLProgram(const std::vector<ShaderStageSpecificatio
   }
 
   // Link the program
+  if (useBinaryCache) {
+    programParameteriFunc(programHandle, programBinaryRetrievableHintEnum, GL_TRUE);
+  }
+  for (const std::pair<std::string, int>& loc : compiledProgram->boundAttributeLocations) {
+    glBindAttribLocation(programHandle, loc.second, loc.first.c_str());
+  }
+  if (!compiledProgram->capturedOutputs.empty()) {
+    std::vector<const char*> names;
+    for (const std::string& name : compiledProgram->capturedOutputs) names.push_back(name.c_str());
+    glTransformFeedbackVaryings(programHandle, static_cast<GLsizei>(names.size()), &names[0], GL_SEPARATE_ATTRIBS);
+  }
   glLinkProgram(programHandle);
+
+  if (linkInBackground) {
+    compiledProgram->linkPending = true;
+    if (useBinaryCache) {
+      compiledProgram->binaryFilename = binaryFilename;
+      compiledProgram->sourceHash = sourceHash;
+    }
+    checkGLError();
+    return;
+  }
+
   printProgramInfoLog(programHandle);
 
+  if (useBinaryCache) {
+    saveShaderBinary(programHandle, binaryFilename, sourceHash);
+  }
+
 
   // Delete the shaders we just compiled, they aren't used after link
   for (ShaderHandle h : handles) {
@@ -722,8 +1584,68 @@ void GLShaderProgram::compileGLProgram(const std::vector<ShaderStageSpecificatio
   checkGLError();
 } // namespace backend_openGL3_glfw
 
+void GLShaderProgram::assumeDataLocations() {
+  for (GLShaderUniform& u : uniforms) {
+    u.location = unresolvedLocation;
+  }
+  for (GLShaderAttribute& a : attributes) {
+    a.location = -1;
+    for (const std::pair<std::string, int>& loc : compiledProgram->boundAttributeLocations) {
+      if (loc.first == a.name) a.location = loc.second;
+    }
+  }
+  for (GLShaderTexture& t : textures) {
+    t.location = unresolvedLocation;
+  }
+  locationsPending = true;
+}
+
+void GLShaderProgram::finishBackgroundLink() {
+  GLCompiledProgram& c = *compiledProgram;
+
+  for (size_t i = 0; i < c.pendingShaders.size(); i++) {
+    try {
+      printShaderInfoLog(c.pendingShaders[i]);
+      checkGLError();
+    } catch (...) {
+      std::cout << "GLError() after shader compilation! Program text:" << std::endl;
+      std::cout << c.pendingShaderSources[i].c_str() << std::endl;
+      throw;
+    }
+  }
+  printProgramInfoLog(programHandle);
+
+  if (!c.binaryFilename.empty()) {
+    saveShaderBinary(programHandle, c.binaryFilename, c.sourceHash);
+  }
+
+  for (ShaderHandle h : c.pendingShaders) {
+    glDeleteShader(h);
+  }
+  c.pendingShaders.clear();
+  c.pendingShaderSources.clear();
+  c.linkPending = false;
+  checkGLError();
+}
+
+bool GLShaderProgram::isReady() {
+  if (!locationsPending) return true;
+
+  // (screenshots show every structure, so they wait for the link)
+  if (compiledProgram->linkPending) {
+    if (!internal::finishBackgroundFills && !programLinkComplete(programHandle)) return false;
+    finishBackgroundLink();
+  }
+
+  // The uniforms and textures the program actually uses are known now. Attributes keep the locations they were bound
+  // to, or are dropped if unused.
+  setDataLocations();
+  locationsPending = false;
+  return true;
+}
+
 void GLShaderProgram::setDataLocations() {
-  glUseProgram(programHandle);
+  useProgram(programHandle);
 
   // Uniforms
   for (GLShaderUniform& u : uniforms) {
@@ -765,44 +1687,8 @@ void GLShaderProgram::createBuffers() {
   // Create buffers for each attributes
   for (GLShaderAttribute& a : attributes) {
     if (a.location == -1) continue;
-    glGenBuffers(1, &a.VBOLoc);
-    glBindBuffer(GL_ARRAY_BUFFER, a.VBOLoc);
-
-    // Choose the correct type for the buffer
-    for (int iArrInd = 0; iArrInd < a.arrayCount; iArrInd++) {
-
-      glEnableVertexAttribArray(a.location + iArrInd);
-
-      switch (a.type) {
-      case DataType::Float:
-        glVertexAttribPointer(a.location + iArrInd, 1, GL_FLOAT, GL_FALSE, sizeof(float) * 1 * a.arrayCount,
-                              reinterpret_cast<void*>(sizeof(float) * 1 * iArrInd));
-        break;
-      case DataType::Int:
-        glVertexAttribPointer(a.location + iArrInd, 1, GL_INT, GL_FALSE, sizeof(int) * 1 * a.arrayCount,
-                              reinterpret_cast<void*>(sizeof(int) * 1 * iArrInd));
-        break;
-      case DataType::UInt:
-        glVertexAttribPointer(a.location + iArrInd, 1, GL_UNSIGNED_INT, GL_FALSE, sizeof(uint32_t) * 1 * a.arrayCount,
-                              reinterpret_cast<void*>(sizeof(uint32_t) * 1 * iArrInd));
-        break;
-      case DataType::Vector2Float:
-        glVertexAttribPointer(a.location + iArrInd, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2 * a.arrayCount,
-                              reinterpret_cast<void*>(sizeof(float) * 2 * iArrInd));
-        break;
-      case DataType::Vector3Float:
-        glVertexAttribPointer(a.location + iArrInd, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3 * a.arrayCount,
-                              reinterpret_cast<void*>(sizeof(float) * 3 * iArrInd));
-        break;
-      case DataType::Vector4Float:
-        glVertexAttribPointer(a.location + iArrInd, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 4 * a.arrayCount,
-                              reinterpret_cast<void*>(sizeof(float) * 4 * iArrInd));
-        break;
-      default:
-        throw std::invalid_argument("Unrecognized GLShaderAttribute type");
-        break;
-      }
-    }
+    a.buff = std::make_shared<GLAttributeBuffer>(a.type, a.arrayCount);
+    bindAttributeBuffer(a);
   }
 
   // Create an index buffer, if we're using one
@@ -831,204 +1717,186 @@ void GLShaderProgram::createBuffers() {
   checkGLError();
 }
 
-bool GLShaderProgram::hasUniform(std::string name) {
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name && u.location != -1) {
-      return true;
+void GLShaderProgram::bindAttributeBuffer(GLShaderAttribute& a) {
+  a.buff->bind();
+
+  // Choose the correct type for the buffer
+  for (int iArrInd = 0; iArrInd < a.arrayCount; iArrInd++) {
+
+    glEnableVertexAttribArray(a.location + iArrInd);
+
+    switch (a.type) {
+    case DataType::Float:
+      glVertexAttribPointer(a.location + iArrInd, 1, GL_FLOAT, GL_FALSE, sizeof(float) * 1 * a.arrayCount,
+                            reinterpret_cast<void*>(sizeof(float) * 1 * iArrInd));
+      break;
+    // (integer attributes must use the I variant, otherwise they arrive in the shader converted to float)
+    case DataType::Int:
+      glVertexAttribIPointer(a.location + iArrInd, 1, GL_INT, sizeof(int) * 1 * a.arrayCount,
+                             reinterpret_cast<void*>(sizeof(int) * 1 * iArrInd));
+      break;
+    case DataType::UInt:
+      glVertexAttribIPointer(a.location + iArrInd, 1, GL_UNSIGNED_INT, sizeof(uint32_t) * 1 * a.arrayCount,
+                             reinterpret_cast<void*>(sizeof(uint32_t) * 1 * iArrInd));
+      break;
+    case DataType::Vector2Float:
+      glVertexAttribPointer(a.location + iArrInd, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2 * a.arrayCount,
+                            reinterpret_cast<void*>(sizeof(float) * 2 * iArrInd));
+      break;
+    case DataType::Vector3Float:
+      glVertexAttribPointer(a.location + iArrInd, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3 * a.arrayCount,
+                            reinterpret_cast<void*>(sizeof(float) * 3 * iArrInd));
+      break;
+    case DataType::Vector4Float:
+      glVertexAttribPointer(a.location + iArrInd, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 4 * a.arrayCount,
+                            reinterpret_cast<void*>(sizeof(float) * 4 * iArrInd));
+      break;
+    default:
+      throw std::invalid_argument("Unrecognized GLShaderAttribute type");
+      break;
+    }
+
+    if (attributeIsPerInstance(a.name)) {
+      glVertexAttribDivisor(a.location + iArrInd, 1);
     }
   }
-  return false;
 }
 
-// Set an integer
-void GLShaderProgram::setUniform(std::string name, int val) {
-  glUseProgram(programHandle);
+bool GLShaderProgram::hasUniform(std::string name) {
+  ShaderUniformHandle h = getUniformHandle(name);
+  return h.isValid() && uniforms[h.index].location != -1;
+}
 
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::Int) {
-        glUniform1i(u.location, val);
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
+ShaderUniformHandle GLShaderProgram::getUniformHandle(std::string name) {
+  for (size_t i = 0; i < uniforms.size(); i++) {
+    if (uniforms[i].name == name) {
+      return ShaderUniformHandle(i);
     }
   }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+  return ShaderUniformHandle();
 }
 
-// Set an unsigned integer
-void GLShaderProgram::setUniform(std::string name, unsigned int val) {
-  glUseProgram(programHandle);
+ShaderUniformHandle GLShaderProgram::requireUniformHandle(const std::string& name) {
+  ShaderUniformHandle h = getUniformHandle(name);
+  if (!h.isValid()) {
+    throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+  }
+  return h;
+}
 
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::UInt) {
-        glUniform1ui(u.location, val);
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
+GLShaderProgram::GLShaderUniform& GLShaderProgram::getUniformForHandle(ShaderUniformHandle h, DataType type) {
+  if (!h.isValid() || static_cast<size_t>(h.index) >= uniforms.size()) {
+    throw std::invalid_argument("Tried to set uniform with invalid handle");
+  }
+  GLShaderUniform& u = uniforms[h.index];
+  if (u.type != type) {
+    throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
   }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+  return u;
 }
 
-// Set a float
-void GLShaderProgram::setUniform(std::string name, float val) {
-  glUseProgram(programHandle);
+// Set an integer
+void GLShaderProgram::setUniform(std::string name, int val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, int val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Int);
+  if (u.location == -1) return;
+  u.intValue = val;
+  markUniformSet(u);
+}
 
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::Float) {
-        glUniform1f(u.location, val);
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+// Set an unsigned integer
+void GLShaderProgram::setUniform(std::string name, unsigned int val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, unsigned int val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::UInt);
+  if (u.location == -1) return;
+  u.uintValue = val;
+  markUniformSet(u);
 }
 
-// Set a double --- WARNING casts down to float
-void GLShaderProgram::setUniform(std::string name, double val) {
-  glUseProgram(programHandle);
+// Set a float
+void GLShaderProgram::setUniform(std::string name, float val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, float val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Float);
+  if (u.location == -1) return;
+  u.floatValue[0] = val;
+  markUniformSet(u);
+}
 
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::Float) {
-        glUniform1f(u.location, static_cast<float>(val));
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+// Set a double --- WARNING casts down to float
+void GLShaderProgram::setUniform(std::string name, double val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, double val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Float);
+  if (u.location == -1) return;
+  u.floatValue[0] = static_cast<float>(val);
+  markUniformSet(u);
 }
 
 // Set a 4x4 uniform matrix
 // TODO why do we use a pointer here... makes no sense
-void GLShaderProgram::setUniform(std::string name, float* val) {
-  glUseProgram(programHandle);
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::Matrix44Float) {
-        glUniformMatrix4fv(u.location, 1, false, val);
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, float* val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, float* val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Matrix44Float);
+  if (u.location == -1) return;
+  std::copy(val, val + 16, u.floatValue.begin());
+  markUniformSet(u);
 }
 
 // Set a vector2 uniform
-void GLShaderProgram::setUniform(std::string name, glm::vec2 val) {
-  glUseProgram(programHandle);
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::Vector2Float) {
-        glUniform2f(u.location, val.x, val.y);
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, glm::vec2 val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, glm::vec2 val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector2Float);
+  if (u.location == -1) return;
+  u.floatValue[0] = val.x;
+  u.floatValue[1] = val.y;
+  markUniformSet(u);
 }
 
 // Set a vector3 uniform
-void GLShaderProgram::setUniform(std::string name, glm::vec3 val) {
-  glUseProgram(programHandle);
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::Vector3Float) {
-        glUniform3f(u.location, val.x, val.y, val.z);
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, glm::vec3 val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, glm::vec3 val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector3Float);
+  if (u.location == -1) return;
+  u.floatValue[0] = val.x;
+  u.floatValue[1] = val.y;
+  u.floatValue[2] = val.z;
+  markUniformSet(u);
 }
 
 // Set a vector4 uniform
-void GLShaderProgram::setUniform(std::string name, glm::vec4 val) {
-  glUseProgram(programHandle);
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::Vector4Float) {
-        glUniform4f(u.location, val.x, val.y, val.z, val.w);
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+void GLShaderProgram::setUniform(std::string name, glm::vec4 val) { setUniform(requireUniformHandle(name), val); }
+void GLShaderProgram::setUniform(ShaderUniformHandle h, glm::vec4 val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector4Float);
+  if (u.location == -1) return;
+  u.floatValue[0] = val.x;
+  u.floatValue[1] = val.y;
+  u.floatValue[2] = val.z;
+  u.floatValue[3] = val.w;
+  markUniformSet(u);
 }
 
 // Set a vector3 uniform from a float array
 void GLShaderProgram::setUniform(std::string name, std::array<float, 3> val) {
-  glUseProgram(programHandle);
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::Vector3Float) {
-        glUniform3f(u.location, val[0], val[1], val[2]);
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+  setUniform(requireUniformHandle(name), val);
+}
+void GLShaderProgram::setUniform(ShaderUniformHandle h, std::array<float, 3> val) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector3Float);
+  if (u.location == -1) return;
+  std::copy(val.begin(), val.end(), u.floatValue.begin());
+  markUniformSet(u);
 }
 
 // Set a vec4 uniform
 void GLShaderProgram::setUniform(std::string name, float x, float y, float z, float w) {
-  glUseProgram(programHandle);
-
-  for (GLShaderUniform& u : uniforms) {
-    if (u.name == name) {
-      if (u.location == -1) return;
-      if (u.type == DataType::Vector4Float) {
-        glUniform4f(u.location, x, y, z, w);
-        u.isSet = true;
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderUniform with wrong type");
-      }
-      return;
-    }
-  }
-  throw std::invalid_argument("Tried to set nonexistent uniform with name " + name);
+  setUniform(requireUniformHandle(name), x, y, z, w);
+}
+void GLShaderProgram::setUniform(ShaderUniformHandle h, float x, float y, float z, float w) {
+  GLShaderUniform& u = getUniformForHandle(h, DataType::Vector4Float);
+  if (u.location == -1) return;
+  u.floatValue[0] = x;
+  u.floatValue[1] = y;
+  u.floatValue[2] = z;
+  u.floatValue[3] = w;
+  markUniformSet(u);
 }
 
 bool GLShaderProgram::hasAttribute(std::string name) {
@@ -1043,267 +1911,148 @@ bool GLShaderProgram::hasAttribute(std::string name) {
 bool GLShaderProgram::attributeIsSet(std::string name) {
   for (GLShaderAttribute& a : attributes) {
     if (a.name == name && a.location != -1) {
-      return a.dataSize != -1;
+      return a.buff->isSet();
     }
   }
   return false;
 }
 
-void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec2>& data, bool update, int offset,
-                                   int size) {
-  // Reshape the vector
-  // Right now, the data is probably laid out in this form already... but let's
-  // not be overly clever and just reshape it.
-  std::vector<float> rawData(2 * data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    rawData[2 * i + 0] = static_cast<float>(data[i].x);
-    rawData[2 * i + 1] = static_cast<float>(data[i].y);
+ShaderAttributeHandle GLShaderProgram::getAttributeHandle(std::string name) {
+  for (size_t i = 0; i < attributes.size(); i++) {
+    if (attributes[i].name == name) {
+      return ShaderAttributeHandle(i);
+    }
   }
+  return ShaderAttributeHandle();
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Vector2Float) {
-        if (a.location == -1) return;
-        glBindVertexArray(vaoHandle);
-        glBindBuffer(GL_ARRAY_BUFFER, a.VBOLoc);
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= 2 * sizeof(float);
-          if (size == -1)
-            size = 2 * a.dataSize * sizeof(float);
-          else
-            size *= 2 * sizeof(float);
-
-          glBufferSubData(GL_ARRAY_BUFFER, offset, size, rawData.empty() ? nullptr : &rawData[0]);
-        } else {
-          glBufferData(GL_ARRAY_BUFFER, 2 * data.size() * sizeof(float), rawData.empty() ? nullptr : &rawData[0],
-                       GL_STATIC_DRAW);
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::Vector2Float)));
-      }
-      return;
-    }
+ShaderAttributeHandle GLShaderProgram::requireAttributeHandle(const std::string& name) {
+  ShaderAttributeHandle h = getAttributeHandle(name);
+  if (!h.isValid()) {
+    throw std::invalid_argument("Tried to set nonexistent attribute with name " + name);
   }
+  return h;
+}
 
-  throw std::invalid_argument("Tried to set nonexistent attribute with name " + name);
+GLShaderProgram::GLShaderAttribute& GLShaderProgram::getAttributeForHandle(ShaderAttributeHandle h) {
+  if (!h.isValid() || static_cast<size_t>(h.index) >= attributes.size()) {
+    throw std::invalid_argument("Tried to set attribute with invalid handle");
+  }
+  return attributes[h.index];
 }
 
-void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec3>& data, bool update, int offset,
+void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec2>& data, bool update, int offset,
                                    int size) {
-  // Reshape the vector
-  // Right now, the data is probably laid out in this form already... but let's
-  // not be overly clever and just reshape it.
-  std::vector<float> rawData(3 * data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    rawData[3 * i + 0] = static_cast<float>(data[i].x);
-    rawData[3 * i + 1] = static_cast<float>(data[i].y);
-    rawData[3 * i + 2] = static_cast<float>(data[i].z);
-  }
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Vector3Float) {
-        if (a.location == -1) return;
-        glBindVertexArray(vaoHandle);
-        glBindBuffer(GL_ARRAY_BUFFER, a.VBOLoc);
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= 3 * sizeof(float);
-          if (size == -1)
-            size = 3 * a.dataSize * sizeof(float);
-          else
-            size *= 3 * sizeof(float);
-
-          glBufferSubData(GL_ARRAY_BUFFER, offset, size, rawData.empty() ? nullptr : &rawData[0]);
-        } else {
-          glBufferData(GL_ARRAY_BUFFER, 3 * data.size() * sizeof(float), rawData.empty() ? nullptr : &rawData[0],
-                       GL_STATIC_DRAW);
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::Vector3Float)));
-      }
-      return;
-    }
-  }
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec2>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Vector2Float);
+  if (a.location == -1) return;
+  a.buff->setData(data, update, offset, size);
+}
 
-  throw std::invalid_argument("Tried to set nonexistent attribute with name " + name);
+void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec3>& data, bool update, int offset,
+                                   int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
 }
 
-void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec4>& data, bool update, int offset,
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec3>& data, bool update, int offset,
                                    int size) {
-  // Reshape the vector
-  // Right now, the data is probably laid out in this form already... but let's
-  // not be overly clever and just reshape it.
-  std::vector<float> rawData(4 * data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    rawData[4 * i + 0] = static_cast<float>(data[i].x);
-    rawData[4 * i + 1] = static_cast<float>(data[i].y);
-    rawData[4 * i + 2] = static_cast<float>(data[i].z);
-    rawData[4 * i + 3] = static_cast<float>(data[i].w);
-  }
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Vector3Float);
+  if (a.location == -1) return;
+  a.buff->setData(data, update, offset, size);
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Vector4Float) {
-        if (a.location == -1) return;
-        glBindVertexArray(vaoHandle);
-        glBindBuffer(GL_ARRAY_BUFFER, a.VBOLoc);
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= 4 * sizeof(float);
-          if (size == -1)
-            size = 4 * a.dataSize * sizeof(float);
-          else
-            size *= 4 * sizeof(float);
-
-          glBufferSubData(GL_ARRAY_BUFFER, offset, size, rawData.empty() ? nullptr : &rawData[0]);
-        } else {
-          glBufferData(GL_ARRAY_BUFFER, 4 * data.size() * sizeof(float), rawData.empty() ? nullptr : &rawData[0],
-                       GL_STATIC_DRAW);
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::Vector4Float)));
-      }
-      return;
-    }
-  }
+void GLShaderProgram::setAttribute(std::string name, const std::vector<glm::vec4>& data, bool update, int offset,
+                                   int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  throw std::invalid_argument("Tried to set nonexistent attribute with name " + name);
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<glm::vec4>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Vector4Float);
+  if (a.location == -1) return;
+  a.buff->setData(data, update, offset, size);
 }
 
 void GLShaderProgram::setAttribute(std::string name, const std::vector<double>& data, bool update, int offset,
                                    int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
+
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<double>& data, bool update, int offset,
+                                   int size) {
   // Convert input data to floats
   std::vector<float> floatData(data.size());
   for (unsigned int i = 0; i < data.size(); i++) {
     floatData[i] = static_cast<float>(data[i]);
   }
-
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Float) {
-        if (a.location == -1) return;
-        glBindVertexArray(vaoHandle);
-        glBindBuffer(GL_ARRAY_BUFFER, a.VBOLoc);
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= sizeof(float);
-          if (size == -1)
-            size = a.dataSize * sizeof(float);
-          else
-            size *= sizeof(float);
-
-          glBufferSubData(GL_ARRAY_BUFFER, offset, size, floatData.empty() ? nullptr : &floatData[0]);
-        } else {
-          glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), floatData.empty() ? nullptr : &floatData[0],
-                       GL_STATIC_DRAW);
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<float>(DataType::Float)));
-      }
-      return;
-    }
-  }
-
-  throw std::invalid_argument("No attribute with name " + name);
+  setAttribute(h, floatData, update, offset, size);
 }
 
-void GLShaderProgram::setAttribute(std::string name, const std::vector<int>& data, bool update, int offset, int size) {
-  // TODO I've seen strange bugs when using int's in shaders. Need to figure
-  // out it it's my shaders or something wrong with this function
+void GLShaderProgram::setAttribute(std::string name, const std::vector<float>& data, bool update, int offset,
+                                   int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  // Convert data to GL_INT (probably does nothing)
-  std::vector<GLint> intData(data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    intData[i] = static_cast<GLint>(data[i]);
-  }
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<float>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Float);
+  if (a.location == -1) return;
+  a.buff->setData(data, update, offset, size);
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::Int) {
-        if (a.location == -1) return;
-        glBindVertexArray(vaoHandle);
-        glBindBuffer(GL_ARRAY_BUFFER, a.VBOLoc);
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= sizeof(GLint);
-          if (size == -1)
-            size = a.dataSize * sizeof(GLint);
-          else
-            size *= sizeof(GLint);
-
-          glBufferSubData(GL_ARRAY_BUFFER, offset, size, intData.empty() ? nullptr : &intData[0]);
-        } else {
-          glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(GLint), intData.empty() ? nullptr : &intData[0],
-                       GL_STATIC_DRAW);
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::Int)));
-      }
-      return;
-    }
-  }
+void GLShaderProgram::setAttribute(std::string name, const std::vector<int>& data, bool update, int offset,
+                                   int size) {
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  throw std::invalid_argument("No attribute with name " + name);
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<int>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::Int);
+  if (a.location == -1) return;
+  a.buff->setData(data, update, offset, size);
 }
 
 void GLShaderProgram::setAttribute(std::string name, const std::vector<uint32_t>& data, bool update, int offset,
                                    int size) {
-  // TODO I've seen strange bugs when using int's in shaders. Need to figure
-  // out it it's my shaders or something wrong with this function
+  setAttribute(requireAttributeHandle(name), data, update, offset, size);
+}
 
-  // Convert data to GL_UINT (probably does nothing)
-  std::vector<GLuint> intData(data.size());
-  for (unsigned int i = 0; i < data.size(); i++) {
-    intData[i] = static_cast<GLuint>(data[i]);
-  }
+void GLShaderProgram::setAttribute(ShaderAttributeHandle h, const std::vector<uint32_t>& data, bool update, int offset,
+                                   int size) {
+  GLShaderAttribute& a = getAttributeForHandle(h);
+  checkAttributeType(a, DataType::UInt);
+  if (a.location == -1) return;
+  a.buff->setData(data, update, offset, size);
+}
 
-  for (GLShaderAttribute& a : attributes) {
-    if (a.name == name) {
-      if (a.type == DataType::UInt) {
-        if (a.location == -1) return;
-        glBindVertexArray(vaoHandle);
-        glBindBuffer(GL_ARRAY_BUFFER, a.VBOLoc);
-        if (update) {
-          // TODO: Allow modifications to non-contiguous memory
-          offset *= sizeof(GLuint);
-          if (size == -1)
-            size = a.dataSize * sizeof(GLuint);
-          else
-            size *= sizeof(GLuint);
-
-          glBufferSubData(GL_ARRAY_BUFFER, offset, size, intData.empty() ? nullptr : &intData[0]);
-        } else {
-          glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(GLuint), intData.empty() ? nullptr : &intData[0],
-                       GL_STATIC_DRAW);
-          a.dataSize = data.size();
-        }
-      } else {
-        throw std::invalid_argument("Tried to set GLShaderAttribute named " + name +
-                                    " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
-                                    "  Attempted type: " + std::to_string(static_cast<int>(DataType::UInt)));
-      }
-      return;
-    }
+void GLShaderProgram::setAttribute(std::string name, std::shared_ptr<AttributeBuffer> buffer) {
+  GLShaderAttribute& a = getAttributeForHandle(requireAttributeHandle(name));
+  std::shared_ptr<GLAttributeBuffer> glBuffer = std::dynamic_pointer_cast<GLAttributeBuffer>(buffer);
+  if (!glBuffer || glBuffer->getType() != a.type || glBuffer->getArrayCount() != a.arrayCount) {
+    throw std::invalid_argument("Tried to set GLShaderAttribute named " + a.name + " with an incompatible buffer");
   }
+  if (a.location == -1) return;
+
+  a.buff = glBuffer;
+  glBindVertexArray(vaoHandle);
+  bindAttributeBuffer(a);
+}
 
-  throw std::invalid_argument("No attribute with name " + name);
+void GLShaderProgram::checkAttributeType(const GLShaderAttribute& a, DataType type) {
+  if (a.type != type) {
+    throw std::invalid_argument("Tried to set GLShaderAttribute named " + a.name +
+                                " with wrong type. Actual type: " + std::to_string(static_cast<int>(a.type)) +
+                                "  Attempted type: " + std::to_string(static_cast<int>(type)));
+  }
 }
 
 bool GLShaderProgram::hasTexture(std::string name) {
@@ -1375,7 +2124,7 @@ void GLShaderProgram::setTexture2D(std::string name, unsigned char* texData, uns
     if (withAlpha) {
       t.textureBufferOwned.reset(new GLTextureBuffer(TextureFormat::RGBA8, width, height, texData));
     } else {
-      t.textureBufferOwned.reset(new GLTextureBuffer(TextureFormat::RGB8, width, height, texData));
+      t.textureBufferOwned.reset(new GLTextureBuffer(TextureFormat::BC7_RGB8, width, height, texData));
     }
     t.textureBuffer = t.textureBufferOwned.get();
 
@@ -1406,8 +2155,6 @@ void GLShaderProgram::setTexture2D(std::string name, unsigned char* texData, uns
 }
 
 void GLShaderProgram::setTextureFromBuffer(std::string name, TextureBuffer* textureBuffer) {
-  glUseProgram(programHandle);
-
   // Find the right texture
   for (GLShaderTexture& t : textures) {
     if (t.name != name || t.location == -1) continue;
@@ -1429,10 +2176,6 @@ void GLShaderProgram::setTextureFromBuffer(std::string name, TextureBuffer* text
 }
 
 void GLShaderProgram::setTextureFromColormap(std::string name, const std::string& colormapName, bool allowUpdate) {
-  const ValueColorMap& colormap = render::engine->getColorMap(colormapName);
-
-  // TODO switch to global shared buffers from colormap
-
   // Find the right texture
   for (GLShaderTexture& t : textures) {
     if (t.name != name || t.location == -1) continue;
@@ -1445,22 +2188,10 @@ void GLShaderProgram::setTextureFromColormap(std::string name, const std::string
       throw std::invalid_argument("Tried to use texture with mismatched dimension " + std::to_string(t.dim));
     }
 
-    // Fill a buffer with the data
-    unsigned int dataLength = colormap.values.size() * 3;
-    std::vector<float> colorBuffer(dataLength);
-    for (unsigned int i = 0; i < colormap.values.size(); i++) {
-      colorBuffer[3 * i + 0] = static_cast<float>(colormap.values[i][0]);
-      colorBuffer[3 * i + 1] = static_cast<float>(colormap.values[i][1]);
-      colorBuffer[3 * i + 2] = static_cast<float>(colormap.values[i][2]);
-    }
-
-    // glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB, colormap.values.size(), 0, GL_RGB, GL_FLOAT, &(colorBuffer[0]));
-    t.textureBufferOwned = std::dynamic_pointer_cast<GLTextureBuffer>(
-        engine->generateTextureBuffer(TextureFormat::RGB32F, colormap.values.size(), &(colorBuffer[0])));
-    t.textureBufferOwned->setFilterMode(FilterMode::Linear);
+    // (all programs with this colormap share one texture, see Engine::getColorMapTexture())
+    t.textureBufferOwned = std::dynamic_pointer_cast<GLTextureBuffer>(engine->getColorMapTexture(colormapName));
     t.textureBuffer = t.textureBufferOwned.get();
 
-
     t.isSet = true;
     return;
   }
@@ -1479,14 +2210,14 @@ void GLShaderProgram::setIndex(std::vector<std::array<unsigned int, 3>>& indices
   // not be overly clever and just reshape it.
   unsigned int* rawData = new unsigned int[3 * indices.size()];
   indexSize = 3 * indices.size();
+  indexAllocation.setSize(indexSize * sizeof(unsigned int));
   for (unsigned int i = 0; i < indices.size(); i++) {
     rawData[3 * i + 0] = static_cast<float>(indices[i][0]);
     rawData[3 * i + 1] = static_cast<float>(indices[i][1]);
     rawData[3 * i + 2] = static_cast<float>(indices[i][2]);
   }
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3 * indices.size() * sizeof(unsigned int), rawData, GL_STATIC_DRAW);
+  bufferData(GL_ELEMENT_ARRAY_BUFFER, indexVBO, 3 * indices.size() * sizeof(unsigned int), rawData, GL_STATIC_DRAW);
 
   delete[] rawData;
 }
@@ -1511,9 +2242,9 @@ void GLShaderProgram::setIndex(std::vector<unsigned int>& indices) {
     }
   }
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+  bufferData(GL_ELEMENT_ARRAY_BUFFER, indexVBO, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
   indexSize = indices.size();
+  indexAllocation.setSize(indexSize * sizeof(unsigned int));
 }
 
 // Check that uniforms and attributes are all set and of consistent size
@@ -1528,22 +2259,34 @@ void GLShaderProgram::validateData() {
 
   // Check attributes
   long int attributeSize = -1;
-  for (GLShaderAttribute a : attributes) {
+  long int instanceSize = -1;
+  for (GLShaderAttribute& a : attributes) {
     if (a.location == -1) continue;
-    if (a.dataSize < 0) {
+    long int dataSize = a.buff->getDataSize();
+    if (dataSize < 0) {
       throw std::invalid_argument("Attribute " + a.name + " has not been set");
     }
+    if (drawMode == DrawMode::InstancedTriangles && attributeIsPerInstance(a.name)) {
+      if (instanceSize != -1 && dataSize / a.arrayCount != instanceSize) {
+        throw std::invalid_argument("Per-instance attributes have inconsistent size. One attribute has size " +
+                                    std::to_string(instanceSize) + " and " + a.name + " has size " +
+                                    std::to_string(dataSize));
+      }
+      instanceSize = dataSize / a.arrayCount;
+      continue;
+    }
     if (attributeSize == -1) { // first one we've seen
-      attributeSize = a.dataSize / a.arrayCount;
+      attributeSize = dataSize / a.arrayCount;
     } else { // not the first one we've seen
-      if (a.dataSize / a.arrayCount != attributeSize) {
+      if (dataSize / a.arrayCount != attributeSize) {
         throw std::invalid_argument("Attributes have inconsistent size. One attribute has size " +
                                     std::to_string(attributeSize) + " and " + a.name + " has size " +
-                                    std::to_string(a.dataSize));
+                                    std::to_string(dataSize));
       }
     }
   }
   drawDataLength = static_cast<unsigned int>(attributeSize);
+  instanceCount = instanceSize == -1 ? 0 : static_cast<unsigned int>(instanceSize);
 
   // Check textures
   for (GLShaderTexture& t : textures) {
@@ -1584,63 +2327,196 @@ void GLShaderProgram::activateTextures() {
     case 2:
       targetType = GL_TEXTURE_2D;
       break;
+    case 3:
+      targetType = GL_TEXTURE_3D;
+      break;
     }
 
-    glActiveTexture(GL_TEXTURE0 + t.index);
+    setActiveTextureUnit(t.index);
     t.textureBuffer->bind();
     glUniform1i(t.location, t.index);
   }
 }
 
-void GLShaderProgram::draw() {
-  validateData();
+void GLShaderProgram::markUniformSet(GLShaderUniform& u) {
+  u.isSet = true;
+  u.isDirty = true;
+}
 
-  glUseProgram(programHandle);
-  glBindVertexArray(vaoHandle);
+void GLShaderProgram::uploadUniforms() {
+  // If another GLShaderProgram sharing our compiled program drew since we did, all of our values must be reloaded
+  bool reloadAll = compiledProgram->lastUser != this;
+  compiledProgram->lastUser = this;
 
-  if (usePrimitiveRestart) {
-    glEnable(GL_PRIMITIVE_RESTART);
-    glPrimitiveRestartIndex(restartIndex);
-  }
+  for (GLShaderUniform& u : uniforms) {
+    if (u.location == -1 || !u.isSet) continue;
+    if (!reloadAll && !u.isDirty) continue;
 
-  activateTextures();
+    switch (u.type) {
+    case DataType::Int:
+      glUniform1i(u.location, u.intValue);
+      break;
+    case DataType::UInt:
+      glUniform1ui(u.location, u.uintValue);
+      break;
+    case DataType::Float:
+      glUniform1f(u.location, u.floatValue[0]);
+      break;
+    case DataType::Vector2Float:
+      glUniform2f(u.location, u.floatValue[0], u.floatValue[1]);
+      break;
+    case DataType::Vector3Float:
+      glUniform3f(u.location, u.floatValue[0], u.floatValue[1], u.floatValue[2]);
+      break;
+    case DataType::Vector4Float:
+      glUniform4f(u.location, u.floatValue[0], u.floatValue[1], u.floatValue[2], u.floatValue[3]);
+      break;
+    case DataType::Matrix44Float:
+      glUniformMatrix4fv(u.location, 1, false, &u.floatValue[0]);
+      break;
+    default:
+      throw std::invalid_argument("Unrecognized GLShaderUniform type");
+      break;
+    }
+    u.isDirty = false;
+  }
+}
 
+bool GLShaderProgram::rangeDrawPrimitive(GLenum& primitive, bool& indexed) {
+  indexed = false;
   switch (drawMode) {
   case DrawMode::Points:
-    glDrawArrays(GL_POINTS, 0, drawDataLength);
-    break;
+    primitive = GL_POINTS;
+    return true;
   case DrawMode::Triangles:
-    glDrawArrays(GL_TRIANGLES, 0, drawDataLength);
-    break;
+    primitive = GL_TRIANGLES;
+    return true;
   case DrawMode::Lines:
-    glDrawArrays(GL_LINES, 0, drawDataLength);
-    break;
+    primitive = GL_LINES;
+    return true;
   case DrawMode::TrianglesAdjacency:
-    glDrawArrays(GL_TRIANGLES_ADJACENCY, 0, drawDataLength);
-    break;
+    primitive = GL_TRIANGLES_ADJACENCY;
+    return true;
   case DrawMode::LinesAdjacency:
-    glDrawArrays(GL_LINES_ADJACENCY, 0, drawDataLength);
-    break;
+    primitive = GL_LINES_ADJACENCY;
+    return true;
   case DrawMode::IndexedLines:
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
-    glDrawElements(GL_LINES, drawDataLength, GL_UNSIGNED_INT, 0);
+    primitive = GL_LINES;
     break;
   case DrawMode::IndexedLineStrip:
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
-    glDrawElements(GL_LINE_STRIP, drawDataLength, GL_UNSIGNED_INT, 0);
+    primitive = GL_LINE_STRIP;
     break;
   case DrawMode::IndexedLinesAdjacency:
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
-    glDrawElements(GL_LINES_ADJACENCY, drawDataLength, GL_UNSIGNED_INT, 0);
+    primitive = GL_LINES_ADJACENCY;
     break;
   case DrawMode::IndexedLineStripAdjacency:
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
-    glDrawElements(GL_LINE_STRIP_ADJACENCY, drawDataLength, GL_UNSIGNED_INT, 0);
+    primitive = GL_LINE_STRIP_ADJACENCY;
     break;
   case DrawMode::IndexedTriangles:
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
-    glDrawElements(GL_TRIANGLES, drawDataLength, GL_UNSIGNED_INT, 0);
+    primitive = GL_TRIANGLES;
     break;
+  case DrawMode::InstancedQuads:
+  case DrawMode::InstancedBoxes:
+  case DrawMode::InstancedTriangles:
+    return false;
+  }
+  indexed = true;
+  return true;
+}
+
+void GLShaderProgram::drawSubRanges(GLenum primitive, bool indexed, unsigned int drawLength) {
+  std::vector<GLint> starts;
+  std::vector<GLsizei> counts;
+  std::vector<const void*> offsets;
+  for (const std::pair<size_t, size_t>& range : drawRanges) {
+    size_t end = std::min(range.second, static_cast<size_t>(drawLength));
+    if (range.first >= end) continue;
+    starts.push_back(static_cast<GLint>(range.first));
+    counts.push_back(static_cast<GLsizei>(end - range.first));
+    offsets.push_back(reinterpret_cast<const void*>(range.first * sizeof(unsigned int)));
+  }
+  if (counts.empty()) return;
+
+  GLsizei nRanges = static_cast<GLsizei>(counts.size());
+  if (indexed) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
+    glMultiDrawElements(primitive, counts.data(), GL_UNSIGNED_INT, offsets.data(), nRanges);
+  } else {
+    glMultiDrawArrays(primitive, starts.data(), counts.data(), nRanges);
+  }
+}
+
+void GLShaderProgram::draw() {
+  if (!isReady()) {
+    requestRedraw(); // try again next frame
+    return;
+  }
+  validateData();
+
+  if (engine) engine->renderStats.drawCalls++;
+  useProgram(programHandle);
+  glBindVertexArray(vaoHandle);
+  uploadUniforms();
+
+  if (usePrimitiveRestart) {
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(restartIndex);
+  }
+
+  activateTextures();
+
+  unsigned int drawLength = limitedDrawLength();
+  GLenum rangePrimitive;
+  bool rangeIndexed;
+  if (useDrawRanges && rangeDrawPrimitive(rangePrimitive, rangeIndexed)) {
+    drawSubRanges(rangePrimitive, rangeIndexed, drawLength);
+  } else {
+    switch (drawMode) {
+    case DrawMode::Points:
+      glDrawArrays(GL_POINTS, 0, drawLength);
+      break;
+    case DrawMode::Triangles:
+      glDrawArrays(GL_TRIANGLES, 0, drawLength);
+      break;
+    case DrawMode::Lines:
+      glDrawArrays(GL_LINES, 0, drawLength);
+      break;
+    case DrawMode::TrianglesAdjacency:
+      glDrawArrays(GL_TRIANGLES_ADJACENCY, 0, drawLength);
+      break;
+    case DrawMode::LinesAdjacency:
+      glDrawArrays(GL_LINES_ADJACENCY, 0, drawLength);
+      break;
+    case DrawMode::IndexedLines:
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
+      glDrawElements(GL_LINES, drawLength, GL_UNSIGNED_INT, 0);
+      break;
+    case DrawMode::IndexedLineStrip:
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
+      glDrawElements(GL_LINE_STRIP, drawLength, GL_UNSIGNED_INT, 0);
+      break;
+    case DrawMode::IndexedLinesAdjacency:
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
+      glDrawElements(GL_LINES_ADJACENCY, drawLength, GL_UNSIGNED_INT, 0);
+      break;
+    case DrawMode::IndexedLineStripAdjacency:
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
+      glDrawElements(GL_LINE_STRIP_ADJACENCY, drawLength, GL_UNSIGNED_INT, 0);
+      break;
+    case DrawMode::IndexedTriangles:
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVBO);
+      glDrawElements(GL_TRIANGLES, drawLength, GL_UNSIGNED_INT, 0);
+      break;
+    case DrawMode::InstancedQuads:
+      glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, drawLength);
+      break;
+    case DrawMode::InstancedBoxes:
+      glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, drawLength);
+      break;
+    case DrawMode::InstancedTriangles:
+      glDrawArraysInstanced(GL_TRIANGLES, 0, drawDataLength, limitedInstanceCount());
+      break;
+    }
   }
 
   if (usePrimitiveRestart) {
@@ -1650,99 +2526,103 @@ void GLShaderProgram::draw() {
   checkGLError();
 }
 
-GLEngine::GLEngine() {}
+std::shared_ptr<PendingCapture>
+GLShaderProgram::capture(const std::vector<std::shared_ptr<AttributeBuffer>>& outputs) {
+  if (drawMode != DrawMode::Points) {
+    throw std::runtime_error("capture() needs a program which draws points in to a geometry stage");
+  }
+  if (outputs.size() != compiledProgram->capturedOutputs.size()) {
+    throw std::invalid_argument("capture() needs one buffer for each recorded output");
+  }
+  if (!isReady()) {
+    finishBackgroundLink(); // (capture programs are needed right away, and do not usually link in the background)
+    setDataLocations();
+    locationsPending = false;
+  }
+  validateData();
 
-void GLEngine::initialize() {
+  // Buffers with no storage leave nothing to record to, and then the primitives are only counted
+  bool record = true;
+  std::vector<GLAttributeBuffer*> glOutputs;
+  for (const std::shared_ptr<AttributeBuffer>& out : outputs) {
+    GLAttributeBuffer* glOut = dynamic_cast<GLAttributeBuffer*>(out.get());
+    if (glOut == nullptr) {
+      throw std::invalid_argument("capture() needs attribute buffers from the same engine");
+    }
+    if (glOut->getDataSize() <= 0) record = false;
+    glOutputs.push_back(glOut);
+  }
 
-  // Small callback function for GLFW errors
-  auto error_print_callback = [](int error, const char* description) {
-    std::cerr << "GLFW emitted error: " << description << std::endl;
-  };
+  if (engine) engine->renderStats.drawCalls++;
+  useProgram(programHandle);
+  glBindVertexArray(vaoHandle);
+  uploadUniforms();
+  activateTextures();
 
-  // === Initialize glfw
-  glfwSetErrorCallback(error_print_callback);
-  if (!glfwInit()) {
-    throw std::runtime_error(options::printPrefix + "ERROR: Failed to initialize glfw");
+  GLuint query;
+  glGenQueries(1, &query);
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+  if (record) {
+    for (size_t i = 0; i < glOutputs.size(); i++) {
+      glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, static_cast<GLuint>(i), glOutputs[i]->getHandle());
+    }
+    glBeginTransformFeedback(GL_TRIANGLES);
+  }
+  glDrawArrays(GL_POINTS, 0, limitedDrawLength());
+  if (record) {
+    glEndTransformFeedback();
+    for (size_t i = 0; i < glOutputs.size(); i++) {
+      glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, static_cast<GLuint>(i), 0);
+    }
   }
+  glEndQuery(GL_PRIMITIVES_GENERATED);
+  glDisable(GL_RASTERIZER_DISCARD);
 
-  // OpenGL version things
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#if __APPLE__
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
+  checkGLError();
+
+  return std::make_shared<GLPendingCapture>(query);
+}
+
+GLEngine::GLEngine() {}
 
-  // Create the window with context
-  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-  glfwWindowHint(GLFW_FOCUS_ON_SHOW, GLFW_FALSE);
-  mainWindow = glfwCreateWindow(view::windowWidth, view::windowHeight, options::programName.c_str(), NULL, NULL);
-  glfwMakeContextCurrent(mainWindow);
-  glfwSwapInterval(1); // Enable vsync
-  glfwSetWindowPos(mainWindow, view::initWindowPosX, view::initWindowPosY);
-
-  // Set initial window size
-  int newBufferWidth, newBufferHeight, newWindowWidth, newWindowHeight;
-  glfwGetFramebufferSize(mainWindow, &newBufferWidth, &newBufferHeight);
-  glfwGetWindowSize(mainWindow, &newWindowWidth, &newWindowHeight);
-  view::bufferWidth = newBufferWidth;
-  view::bufferHeight = newBufferHeight;
-  view::windowWidth = newWindowWidth;
-  view::windowHeight = newWindowHeight;
-
-// === Initialize openGL
+void GLEngine::loadGLFunctions(ProcAddressFunc getProcAddress) {
 // Load openGL functions (using GLAD)
 #ifndef __APPLE__
-  if (!gladLoadGL()) {
+  if (!gladLoadGLLoader(getProcAddress)) {
     throw std::runtime_error(options::printPrefix + "ERROR: Failed to load openGL using GLAD");
   }
 #endif
-  if (options::verbosity > 0) {
-    std::cout << options::printPrefix << "Backend: openGL3_glfw -- "
-              << "Loaded openGL version: " << glGetString(GL_VERSION) << std::endl;
-  }
-
-#ifdef __APPLE__
-  // Hack to classify the process as interactive
-  glfwPollEvents();
-#endif
-
-  { // Manually create the screen frame buffer
-    GLFrameBuffer* glScreenBuffer = new GLFrameBuffer(view::bufferWidth, view::bufferHeight, true);
-    displayBuffer.reset(glScreenBuffer);
-    glScreenBuffer->bind();
-    glClearColor(1., 1., 1., 0.);
-    // glClearColor(0., 0., 0., 0.);
-    // glClearDepth(1.);
+  loadShaderBinaryFunctions(getProcAddress);
+  loadTextureCompressionSupport();
+  loadPipelineStatisticsSupport();
+  loadParallelShaderCompileFunctions(getProcAddress);
+  if (requestDirectStateAccess) {
+    loadDirectStateAccessFunctions(getProcAddress);
   }
 
-  populateDefaultShadersAndRules();
+  // Point splats set their size with gl_PointSize (the other point programs expand points in a geometry shader)
+  glEnable(GL_PROGRAM_POINT_SIZE);
 }
 
+bool GLEngine::usesDirectStateAccess() const { return directStateAccessSupported; }
 
-void GLEngine::initializeImGui() {
-  bindDisplay();
-
-  ImGui::CreateContext(); // must call once at start
-
-  // Set up ImGUI glfw bindings
-  ImGui_ImplGlfw_InitForOpenGL(mainWindow, true);
-  const char* glsl_version = "#version 150";
-  ImGui_ImplOpenGL3_Init(glsl_version);
-
-  configureImGui();
-}
-
-void GLEngine::shutdownImGui() {
-  // ImGui shutdown things
-  ImGui_ImplOpenGL3_Shutdown();
-  ImGui_ImplGlfw_Shutdown();
-  ImGui::DestroyContext();
+void GLEngine::fencePresentedFrame() {
+  if (presentFence != nullptr) {
+    glDeleteSync(presentFence);
+    presentFence = nullptr;
+  }
+  if (presentMode == PresentMode::LowLatency) {
+    presentFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
 }
 
-void GLEngine::swapDisplayBuffers() {
-  bindDisplay();
-  glfwSwapBuffers(mainWindow);
+void GLEngine::waitForPresentedFrame() {
+  if (presentFence == nullptr) return;
+  // (bounded, so that a lost context or a stuck driver cannot hang the main loop)
+  glClientWaitSync(presentFence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000); // 100ms, in nanoseconds
+  glDeleteSync(presentFence);
+  presentFence = nullptr;
 }
 
 std::vector<unsigned char> GLEngine::readDisplayBuffer() {
@@ -1770,79 +2650,16 @@ std::vector<unsigned char> GLEngine::readDisplayBuffer() {
 void GLEngine::checkError(bool fatal) { checkGLError(fatal); }
 
 
-void GLEngine::makeContextCurrent() { glfwMakeContextCurrent(mainWindow); }
-
-void GLEngine::focusWindow() { glfwFocusWindow(mainWindow); }
-
-void GLEngine::showWindow() { glfwShowWindow(mainWindow); }
-
-void GLEngine::hideWindow() {
-  glfwHideWindow(mainWindow);
-  glfwPollEvents(); // this shouldn't be necessary, but seems to be needed at least on macOS. Perhaps realted to a glfw
-                    // bug? e.g. https://github.com/glfw/glfw/issues/1300 and related bugs
-}
-
-void GLEngine::updateWindowSize(bool force) {
-  int newBufferWidth, newBufferHeight, newWindowWidth, newWindowHeight;
-  glfwGetFramebufferSize(mainWindow, &newBufferWidth, &newBufferHeight);
-  glfwGetWindowSize(mainWindow, &newWindowWidth, &newWindowHeight);
-  if (force || newBufferWidth != view::bufferWidth || newBufferHeight != view::bufferHeight ||
-      newWindowHeight != view::windowHeight || newWindowWidth != view::windowWidth) {
-    // Basically a resize callback
-    requestRedraw();
-
-    // prevent any division by zero for e.g. aspect ratio calcs
-    if (newBufferHeight == 0) newBufferHeight = 1;
-
-    if (newWindowHeight == 0) newWindowHeight = 1;
-
-    view::bufferWidth = newBufferWidth;
-    view::bufferHeight = newBufferHeight;
-    view::windowWidth = newWindowWidth;
-    view::windowHeight = newWindowHeight;
-
-    render::engine->resizeScreenBuffers();
-    render::engine->setScreenBufferViewports();
-  }
-}
-
-std::tuple<int, int> GLEngine::getWindowPos() {
-  int x, y;
-  glfwGetWindowPos(mainWindow, &x, &y);
-  return std::tuple<int, int>{x, y};
-}
-
-bool GLEngine::windowRequestsClose() {
-  bool shouldClose = glfwWindowShouldClose(mainWindow);
-  if (shouldClose) {
-    glfwSetWindowShouldClose(mainWindow, false); // un-set the state bit so we can close again
-    return true;
-  }
-  return false;
-}
-
-void GLEngine::pollEvents() { glfwPollEvents(); }
-
-bool GLEngine::isKeyPressed(char c) {
-  if (c >= '0' && c <= '9') return ImGui::IsKeyPressed(GLFW_KEY_0 + (c - '0'));
-  if (c >= 'a' && c <= 'z') return ImGui::IsKeyPressed(GLFW_KEY_A + (c - 'a'));
-  throw std::runtime_error("keyPressed only supports 0-9, a-z");
-}
-
-void GLEngine::ImGuiNewFrame() {
-  ImGui_ImplOpenGL3_NewFrame();
-  ImGui_ImplGlfw_NewFrame();
-  ImGui::NewFrame();
-
-  // ImGui::ShowDemoWindow();
-}
+void GLEngine::makeContextCurrent() { forgetGLBindings(); }
 
 void GLEngine::ImGuiRender() {
   ImGui::Render();
   ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  forgetGLBindings();
 }
 
 void GLEngine::setDepthMode(DepthMode newMode) {
+  if (!stateChangeNeeded(bindingCache.depthMode, static_cast<int>(newMode))) return;
   switch (newMode) {
   case DepthMode::Less:
     glEnable(GL_DEPTH_TEST);
@@ -1872,6 +2689,8 @@ void GLEngine::setDepthMode(DepthMode newMode) {
 }
 
 void GLEngine::setBlendMode(BlendMode newMode) {
+  if (!stateChangeNeeded(bindingCache.blendMode, static_cast<int>(newMode))) return;
+  glBlendEquation(newMode == BlendMode::Max ? GL_MAX : GL_FUNC_ADD);
   switch (newMode) {
   case BlendMode::Over:
     glEnable(GL_BLEND);
@@ -1901,6 +2720,10 @@ void GLEngine::setBlendMode(BlendMode newMode) {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ZERO);
     break;
+  case BlendMode::Max:
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE); // (ignored by GL_MAX)
+    break;
   case BlendMode::Disable:
     glDisable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // doesn't actually matter
@@ -1908,9 +2731,14 @@ void GLEngine::setBlendMode(BlendMode newMode) {
   }
 }
 
-void GLEngine::setColorMask(std::array<bool, 4> mask) { glColorMask(mask[0], mask[1], mask[2], mask[3]); }
+void GLEngine::setColorMask(std::array<bool, 4> mask) {
+  int maskBits = mask[0] | (mask[1] << 1) | (mask[2] << 2) | (mask[3] << 3);
+  if (!stateChangeNeeded(bindingCache.colorMask, maskBits)) return;
+  glColorMask(mask[0], mask[1], mask[2], mask[3]);
+}
 
 void GLEngine::setBackfaceCull(bool newVal) {
+  if (!stateChangeNeeded(bindingCache.backfaceCull, newVal)) return;
   if (newVal) {
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
@@ -1919,6 +2747,151 @@ void GLEngine::setBackfaceCull(bool newVal) {
   }
 }
 
+void GLEngine::startGPUTimerFrame() {
+  // Nested show() calls start frames from within a frame; just fold those in to the outer frame
+  if (!openTimerRegions.empty()) return;
+
+  if (!currentTimerFrame.empty()) {
+    pendingTimerFrames.push_back(std::move(currentTimerFrame));
+    currentTimerFrame.clear();
+  }
+
+  // Collect the results of any frames which the GPU has finished, in order
+  while (!pendingTimerFrames.empty()) {
+    std::vector<GLTimerRegion>& frame = pendingTimerFrames.front();
+
+    for (GLTimerRegion& r : frame) {
+      GLint available = 0;
+      glGetQueryObjectiv(r.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) return;
+    }
+
+    std::vector<GPUTiming> timings;
+    for (GLTimerRegion& r : frame) {
+      GLuint64 startTime, endTime;
+      glGetQueryObjectui64v(r.startQuery, GL_QUERY_RESULT, &startTime);
+      glGetQueryObjectui64v(r.endQuery, GL_QUERY_RESULT, &endTime);
+      timings.push_back({r.name, r.depth, 1e-6 * startTime, 1e-6 * (endTime - startTime)}); // from nanoseconds
+      freeTimerQueries.push_back(r.startQuery);
+      freeTimerQueries.push_back(r.endQuery);
+    }
+    recordGPUTimingFrame(std::move(timings));
+    pendingTimerFrames.pop_front();
+  }
+}
+
+QueryHandle GLEngine::acquireTimerQuery() {
+  if (freeTimerQueries.empty()) {
+    QueryHandle query;
+    glGenQueries(1, &query);
+    return query;
+  }
+  QueryHandle query = freeTimerQueries.back();
+  freeTimerQueries.pop_back();
+  return query;
+}
+
+void GLEngine::pushGPUTimer(const std::string& name) {
+  GLTimerRegion region{name, static_cast<int>(openTimerRegions.size()), acquireTimerQuery(), acquireTimerQuery()};
+  glQueryCounter(region.startQuery, GL_TIMESTAMP);
+  openTimerRegions.push_back(currentTimerFrame.size());
+  currentTimerFrame.push_back(region);
+}
+
+void GLEngine::popGPUTimer() {
+  if (openTimerRegions.empty()) {
+    throw std::runtime_error("popGPUTimer() called without a matching pushGPUTimer()");
+  }
+  glQueryCounter(currentTimerFrame[openTimerRegions.back()].endQuery, GL_TIMESTAMP);
+  openTimerRegions.pop_back();
+}
+
+bool GLEngine::supportsPipelineStatistics() { return pipelineStatisticsSupported; }
+
+void GLEngine::startPipelineStatisticsFrame() {
+  if (openPipelineStatisticsRegions > 0) return; // (a nested show(), as for the timers)
+
+  if (!currentPipelineStatisticsFrame.empty()) {
+    pendingPipelineStatisticsFrames.push_back(std::move(currentPipelineStatisticsFrame));
+    currentPipelineStatisticsFrame.clear();
+  }
+
+  // Collect the results of the latest frame which the GPU has finished
+  while (!pendingPipelineStatisticsFrames.empty()) {
+    std::vector<GLPipelineStatisticsRegion>& frame = pendingPipelineStatisticsFrames.front();
+
+    for (GLPipelineStatisticsRegion& r : frame) {
+      GLint available = 0;
+      glGetQueryObjectiv(r.queries.back(), GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) return;
+    }
+
+    std::vector<GPUPipelineStatistics> regions;
+    for (GLPipelineStatisticsRegion& r : frame) {
+      std::array<GLuint64, 4> counts;
+      for (size_t i = 0; i < 4; i++) {
+        glGetQueryObjectui64v(r.queries[i], GL_QUERY_RESULT, &counts[i]);
+        freePipelineStatisticsQueries[i].push_back(r.queries[i]);
+      }
+      GPUPipelineStatistics s;
+      s.name = r.name;
+      s.verticesSubmitted = counts[0];
+      s.primitivesSubmitted = counts[1];
+      s.geometryShaderInvocations = counts[2];
+      s.fragmentShaderInvocations = counts[3];
+      regions.push_back(s);
+    }
+    recordPipelineStatisticsFrame(regions);
+    pendingPipelineStatisticsFrames.pop_front();
+  }
+}
+
+void GLEngine::beginPipelineStatistics(const std::string& name) {
+  openPipelineStatisticsRegions++;
+  if (openPipelineStatisticsRegions > 1) return;
+
+  GLPipelineStatisticsRegion region;
+  region.name = name;
+  for (size_t i = 0; i < 4; i++) {
+    std::vector<QueryHandle>& freeQueries = freePipelineStatisticsQueries[i];
+    if (freeQueries.empty()) {
+      glGenQueries(1, &region.queries[i]);
+    } else {
+      region.queries[i] = freeQueries.back();
+      freeQueries.pop_back();
+    }
+    glBeginQuery(pipelineStatisticsTargets[i], region.queries[i]);
+  }
+  currentPipelineStatisticsFrame.push_back(region);
+}
+
+void GLEngine::endPipelineStatistics() {
+  if (openPipelineStatisticsRegions == 0) {
+    throw std::runtime_error("endPipelineStatistics() called without a matching beginPipelineStatistics()");
+  }
+  openPipelineStatisticsRegions--;
+  if (openPipelineStatisticsRegions > 0) return;
+  for (GLenum target : pipelineStatisticsTargets) {
+    glEndQuery(target);
+  }
+}
+
+std::shared_ptr<OcclusionQuery> GLEngine::generateOcclusionQuery() {
+  return std::shared_ptr<OcclusionQuery>(new GLOcclusionQuery());
+}
+
+void GLEngine::setScissor(int startX, int startY, unsigned int sizeX, unsigned int sizeY) {
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(startX, startY, sizeX, sizeY);
+}
+
+void GLEngine::disableScissor() { glDisable(GL_SCISSOR_TEST); }
+
+void GLEngine::waitForExternalFence(void* fence) {
+  glWaitSync(static_cast<GLsync>(fence), 0, GL_TIMEOUT_IGNORED);
+  checkGLError();
+}
+
 std::string GLEngine::getClipboardText() {
   std::string clipboardData = ImGui::GetClipboardText();
   return clipboardData;
@@ -1944,6 +2917,11 @@ void GLEngine::applyTransparencySettings() {
     setDepthMode();
     break;
   }
+  case TransparencyMode::WeightedBlended: {
+    setBlendMode(BlendMode::WeightedAdd);
+    setDepthMode(DepthMode::Disable);
+    break;
+  }
   }
 }
 
@@ -1978,10 +2956,15 @@ std::shared_ptr<TextureBuffer> GLEngine::generateTextureBuffer(TextureFormat for
   GLTextureBuffer* newT = new GLTextureBuffer(format, sizeX_, sizeY_, data);
   return std::shared_ptr<TextureBuffer>(newT);
 }
+std::shared_ptr<TextureBuffer> GLEngine::generateTextureBuffer(TextureFormat format, unsigned int sizeX_,
+                                                               unsigned int sizeY_, unsigned int sizeZ_, float* data) {
+  GLTextureBuffer* newT = new GLTextureBuffer(format, sizeX_, sizeY_, sizeZ_, data);
+  return std::shared_ptr<TextureBuffer>(newT);
+}
 
 std::shared_ptr<RenderBuffer> GLEngine::generateRenderBuffer(RenderBufferType type, unsigned int sizeX_,
-                                                             unsigned int sizeY_) {
-  GLRenderBuffer* newR = new GLRenderBuffer(type, sizeX_, sizeY_);
+                                                             unsigned int sizeY_, unsigned int samples) {
+  GLRenderBuffer* newR = new GLRenderBuffer(type, sizeX_, sizeY_, samples);
   return std::shared_ptr<RenderBuffer>(newR);
 }
 
@@ -1990,6 +2973,11 @@ std::shared_ptr<FrameBuffer> GLEngine::generateFrameBuffer(unsigned int sizeX_,
   return std::shared_ptr<FrameBuffer>(newF);
 }
 
+std::shared_ptr<AttributeBuffer> GLEngine::generateAttributeBuffer(DataType dataType, int arrayCount) {
+  GLAttributeBuffer* newB = new GLAttributeBuffer(dataType, arrayCount);
+  return std::shared_ptr<AttributeBuffer>(newB);
+}
+
 std::shared_ptr<ShaderProgram> GLEngine::generateShaderProgram(const std::vector<ShaderStageSpecification>& stages,
                                                                DrawMode dm) {
   GLShaderProgram* newP = new GLShaderProgram(stages, dm);
@@ -2004,7 +2992,8 @@ std::shared_ptr<ShaderProgram> GLEngine::requestShader(const std::string& progra
   if (registeredShaderPrograms.find(programName) == registeredShaderPrograms.end()) {
     throw std::runtime_error("No shader program with name [" + programName + "] registered.");
   }
-  const std::vector<ShaderStageSpecification>& stages = registeredShaderPrograms[programName].first;
+  const std::vector<const ShaderStageSpecification*>& stages = registeredShaderPrograms[programName].first;
+  const std::vector<ShaderSourceTemplate>& templates = registeredShaderTemplates[programName];
   DrawMode dm = registeredShaderPrograms[programName].second;
 
   // Add in the default rules
@@ -2028,7 +3017,8 @@ std::shared_ptr<ShaderProgram> GLEngine::requestShader(const std::string& progra
   }
 
   // Get the rules
-  std::vector<ShaderReplacementRule> rules;
+  std::vector<const ShaderReplacementRule*> rules;
+  std::string cacheKey = programName;
   for (auto it = fullCustomRules.begin(); it < fullCustomRules.end(); it++) {
     std::string& ruleName = *it;
 
@@ -2040,140 +3030,310 @@ std::shared_ptr<ShaderProgram> GLEngine::requestShader(const std::string& progra
     if (registeredShaderRules.find(ruleName) == registeredShaderRules.end()) {
       throw std::runtime_error("No shader replacement rule with name [" + ruleName + "] registered.");
     }
-    ShaderReplacementRule& thisRule = registeredShaderRules[ruleName];
-    rules.push_back(thisRule);
+    rules.push_back(registeredShaderRules[ruleName]);
+    cacheKey += "#" + ruleName;
+  }
+
+  // If an identical program has been requested before, share its linked program rather than compiling a new one
+  auto cacheIt = compiledProgramCache.find(cacheKey);
+  if (cacheIt != compiledProgramCache.end()) {
+    shaderCacheHits++;
+    CompiledProgramCacheEntry& entry = cacheIt->second;
+    return std::shared_ptr<ShaderProgram>(new GLShaderProgram(entry.stages, dm, entry.compiledProgram));
+  }
+
+  recordShaderRequest(programName, customRules, defaults);
+  std::vector<ShaderStageSpecification> updatedStages = applyShaderReplacements(stages, templates, rules);
+
+  // Outputs recorded by capture() are part of the linked program, see registeredCapturedOutputs
+  std::vector<std::string> capturedOutputs;
+  auto capturedIt = registeredCapturedOutputs.find(programName);
+  if (capturedIt != registeredCapturedOutputs.end()) {
+    capturedOutputs = capturedIt->second;
+  }
+
+  // Otherwise, an identical source may still have been linked for another program or list of rules
+  uint64_t sourceHash = hashShaderSources(updatedStages);
+  auto sourceIt = compiledProgramsBySource.find(sourceHash);
+  if (sourceIt != compiledProgramsBySource.end() && sameShaderSources(sourceIt->second.stages, updatedStages) &&
+      sourceIt->second.compiledProgram->capturedOutputs == capturedOutputs) {
+    shaderCacheHits++;
+    std::shared_ptr<GLCompiledProgram> compiled = sourceIt->second.compiledProgram;
+    insertCompiledProgram(cacheKey, CompiledProgramCacheEntry{updatedStages, compiled}, sourceHash, false);
+    return std::shared_ptr<ShaderProgram>(new GLShaderProgram(updatedStages, dm, compiled));
+  }
+  shaderCacheMisses++;
+
+  // Scene objects may link in the background, and skip drawing until they are done. Anything else is drawn to produce
+  // something immediately (a pick buffer, a postprocessing pass), so it links now.
+  bool linkInBackground = options::parallelShaderCompilation && parallelShaderCompileSupported &&
+                          defaults == ShaderReplacementDefaults::SceneObject;
+  GLShaderProgram* newP = new GLShaderProgram(updatedStages, dm, linkInBackground, capturedOutputs);
+  CompiledProgramCacheEntry entry{updatedStages, newP->getCompiledProgram()};
+  insertCompiledProgram(cacheKey, entry, sourceHash, true);
+  return std::shared_ptr<ShaderProgram>(newP);
+}
+
+void GLEngine::insertCompiledProgram(const std::string& cacheKey, const CompiledProgramCacheEntry& entry,
+                                     uint64_t sourceHash, bool bySource) {
+  if (compiledProgramCache.insert({cacheKey, entry}).second) entry.compiledProgram->cacheReferences++;
+  if (bySource && compiledProgramsBySource.insert({sourceHash, entry}).second) {
+    entry.compiledProgram->cacheReferences++;
+  }
+}
+
+void GLEngine::registerShaderRule(const std::string& name, const ShaderReplacementRule& rule) {
+  userShaderRules.erase(name);
+  const ShaderReplacementRule& stored = userShaderRules.insert({name, rule}).first->second;
+  bool replacing = registeredShaderRules.find(name) != registeredShaderRules.end();
+  registeredShaderRules[name] = &stored; // (replacing a built-in rule of the same name, if any)
+  if (replacing) dropCachedProgramsUsingRule(name);
+}
+
+void GLEngine::unregisterShaderRule(const std::string& name) {
+  if (userShaderRules.erase(name) == 0) return;
+  registeredShaderRules.erase(name);
+  dropCachedProgramsUsingRule(name);
+}
+
+void GLEngine::dropCachedProgramsUsingRule(const std::string& ruleName) {
+  // Cache keys are "<program>#<rule>#<rule>..."
+  std::vector<const GLCompiledProgram*> dropped;
+  for (auto it = compiledProgramCache.begin(); it != compiledProgramCache.end();) {
+    const std::string& key = it->first;
+    bool usesRule = false;
+    for (size_t pos = key.find('#'); pos != std::string::npos && !usesRule; pos = key.find('#', pos + 1)) {
+      size_t end = pos + 1 + ruleName.size();
+      usesRule = key.compare(pos + 1, ruleName.size(), ruleName) == 0 && (end == key.size() || key[end] == '#');
+    }
+    if (usesRule) {
+      it->second.compiledProgram->cacheReferences--;
+      dropped.push_back(it->second.compiledProgram.get());
+      it = compiledProgramCache.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto it = compiledProgramsBySource.begin(); it != compiledProgramsBySource.end();) {
+    if (std::find(dropped.begin(), dropped.end(), it->second.compiledProgram.get()) != dropped.end()) {
+      it->second.compiledProgram->cacheReferences--;
+      it = compiledProgramsBySource.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+namespace {
+// Drop the entries of a program cache whose program is used by no shader program, only by cache entries
+template <typename Cache>
+void releaseUnusedCacheEntries(Cache& cache) {
+  for (auto it = cache.begin(); it != cache.end();) {
+    GLCompiledProgram& compiled = *it->second.compiledProgram;
+    if (it->second.compiledProgram.use_count() == compiled.cacheReferences) {
+      compiled.cacheReferences--;
+      it = cache.erase(it);
+    } else {
+      ++it;
+    }
   }
+}
+} // namespace
 
-  std::vector<ShaderStageSpecification> updatedStages = applyShaderReplacements(stages, rules);
-  return generateShaderProgram(updatedStages, dm);
+void GLEngine::releaseUnusedShaderPrograms() {
+  releaseUnusedCacheEntries(compiledProgramCache);
+  releaseUnusedCacheEntries(compiledProgramsBySource);
 }
 
 void GLEngine::populateDefaultShadersAndRules() {
+  ScopedStartupPhase startupTimer("populateDefaultShadersAndRules");
   // Note: we use .insert({key, value}) rather than map[key] = value to support const members in the value.
 
   // clang-format off
 
   // == Load general base shaders
-  registeredShaderPrograms.insert({"MESH", {{FLEX_MESH_VERT_SHADER, FLEX_MESH_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"SLICE_TETS", {{SLICE_TETS_VERT_SHADER, SLICE_TETS_GEOM_SHADER, SLICE_TETS_FRAG_SHADER}, DrawMode::Points}});
-  registeredShaderPrograms.insert({"RAYCAST_SPHERE", {{FLEX_SPHERE_VERT_SHADER, FLEX_SPHERE_GEOM_SHADER, FLEX_SPHERE_FRAG_SHADER}, DrawMode::Points}});
-  registeredShaderPrograms.insert({"POINT_QUAD", {{FLEX_POINTQUAD_VERT_SHADER, FLEX_POINTQUAD_GEOM_SHADER, FLEX_POINTQUAD_FRAG_SHADER}, DrawMode::Points}});
-  registeredShaderPrograms.insert({"RAYCAST_VECTOR", {{FLEX_VECTOR_VERT_SHADER, FLEX_VECTOR_GEOM_SHADER, FLEX_VECTOR_FRAG_SHADER}, DrawMode::Points}});
-  registeredShaderPrograms.insert({"RAYCAST_CYLINDER", {{FLEX_CYLINDER_VERT_SHADER, FLEX_CYLINDER_GEOM_SHADER, FLEX_CYLINDER_FRAG_SHADER}, DrawMode::Points}});
-  registeredShaderPrograms.insert({"HISTOGRAM", {{HISTOGRAM_VERT_SHADER, HISTOGRAM_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"GROUND_PLANE_TILE", {{GROUND_PLANE_VERT_SHADER, GROUND_PLANE_TILE_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"GROUND_PLANE_TILE_REFLECT", {{GROUND_PLANE_VERT_SHADER, GROUND_PLANE_TILE_REFLECT_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"GROUND_PLANE_SHADOW", {{GROUND_PLANE_VERT_SHADER, GROUND_PLANE_SHADOW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"MAP_LIGHT", {{TEXTURE_DRAW_VERT_SHADER, MAP_LIGHT_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"RIBBON", {{RIBBON_VERT_SHADER, RIBBON_GEOM_SHADER, RIBBON_FRAG_SHADER}, DrawMode::IndexedLineStripAdjacency}});
-  registeredShaderPrograms.insert({"SLICE_PLANE", {{SLICE_PLANE_VERT_SHADER, SLICE_PLANE_FRAG_SHADER}, DrawMode::Triangles}});
-
-  registeredShaderPrograms.insert({"TEXTURE_DRAW_PLAIN", {{TEXTURE_DRAW_VERT_SHADER, PLAIN_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"TEXTURE_DRAW_DOT3", {{TEXTURE_DRAW_VERT_SHADER, DOT3_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"TEXTURE_DRAW_MAP3", {{TEXTURE_DRAW_VERT_SHADER, MAP3_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"TEXTURE_DRAW_SPHEREBG", {{SPHEREBG_DRAW_VERT_SHADER, SPHEREBG_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"COMPOSITE_PEEL", {{TEXTURE_DRAW_VERT_SHADER, COMPOSITE_PEEL}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"DEPTH_COPY", {{TEXTURE_DRAW_VERT_SHADER, DEPTH_COPY}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"DEPTH_TO_MASK", {{TEXTURE_DRAW_VERT_SHADER, DEPTH_TO_MASK}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"SCALAR_TEXTURE_COLORMAP", {{TEXTURE_DRAW_VERT_SHADER, SCALAR_TEXTURE_COLORMAP}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"BLUR_RGB", {{TEXTURE_DRAW_VERT_SHADER, BLUR_RGB}, DrawMode::Triangles}});
-  registeredShaderPrograms.insert({"TRANSFORMATION_GIZMO_ROT", {{TRANSFORMATION_GIZMO_ROT_VERT, TRANSFORMATION_GIZMO_ROT_FRAG}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"MESH", {{&FLEX_MESH_VERT_SHADER, &FLEX_MESH_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"MESH_INDEXED", {{&FLEX_MESH_VERT_SHADER, &FLEX_MESH_FRAG_SHADER}, DrawMode::IndexedTriangles}});
+  registeredShaderPrograms.insert({"MESH_INSTANCED", {{&FLEX_MESH_INSTANCED_VERT_SHADER, &FLEX_MESH_FRAG_SHADER}, DrawMode::InstancedTriangles}});
+  registeredShaderPrograms.insert({"SLICE_TETS", {{&SLICE_TETS_VERT_SHADER, &SLICE_TETS_GEOM_SHADER, &SLICE_TETS_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"SLICE_TETS_CAPTURE", {{&SLICE_TETS_VERT_SHADER, &SLICE_TETS_GEOM_SHADER, &SLICE_TETS_CAPTURE_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"SLICE_TETS_CAPTURE_WITH_VALUE", {{&SLICE_TETS_VERT_SHADER, &SLICE_TETS_GEOM_SHADER, &SLICE_TETS_CAPTURE_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"SLICE_TETS_CACHED", {{&SLICE_TETS_CACHED_VERT_SHADER, &SLICE_TETS_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredCapturedOutputs.insert({"SLICE_TETS_CAPTURE", {"a_slicePosition"}});
+  registeredCapturedOutputs.insert({"SLICE_TETS_CAPTURE_WITH_VALUE", {"a_slicePosition", "a_sliceValue"}});
+  registeredShaderPrograms.insert({"VOLUME_GRID_RAYMARCH", {{&VOLUME_GRID_RAYMARCH_VERT_SHADER, &VOLUME_GRID_RAYMARCH_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"RAYCAST_SPHERE", {{&FLEX_SPHERE_VERT_SHADER, &FLEX_SPHERE_GEOM_SHADER, &FLEX_SPHERE_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"POINT_QUAD", {{&FLEX_POINTQUAD_VERT_SHADER, &FLEX_POINTQUAD_GEOM_SHADER, &FLEX_POINTQUAD_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"RAYCAST_VECTOR", {{&FLEX_VECTOR_VERT_SHADER, &FLEX_VECTOR_GEOM_SHADER, &FLEX_VECTOR_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"RAYCAST_SPHERE_INSTANCED", {{&FLEX_SPHERE_INSTANCED_VERT_SHADER, &FLEX_SPHERE_FRAG_SHADER}, DrawMode::InstancedQuads}});
+  registeredShaderPrograms.insert({"POINT_QUAD_INSTANCED", {{&FLEX_POINTQUAD_INSTANCED_VERT_SHADER, &FLEX_POINTQUAD_FRAG_SHADER}, DrawMode::InstancedQuads}});
+  registeredShaderPrograms.insert({"POINT_SPLAT", {{&FLEX_POINTSPLAT_VERT_SHADER, &FLEX_POINTQUAD_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"POINT_REDUCE_MINMAX", {{&POINT_REDUCE_VERT_SHADER, &REDUCE_MINMAX_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"POINT_REDUCE_BOUNDS", {{&POINT_REDUCE_BOUNDS_VERT_SHADER, &REDUCE_BOUNDS_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"RAYCAST_VECTOR_INSTANCED", {{&FLEX_VECTOR_INSTANCED_VERT_SHADER, &FLEX_VECTOR_FRAG_SHADER}, DrawMode::InstancedBoxes}});
+  registeredShaderPrograms.insert({"RAYCAST_CYLINDER", {{&FLEX_CYLINDER_VERT_SHADER, &FLEX_CYLINDER_GEOM_SHADER, &FLEX_CYLINDER_FRAG_SHADER}, DrawMode::Points}});
+  registeredShaderPrograms.insert({"RAYCAST_CAPSULE", {{&FLEX_CYLINDER_STRIP_VERT_SHADER, &FLEX_CAPSULE_GEOM_SHADER, &FLEX_CAPSULE_FRAG_SHADER}, DrawMode::IndexedLines}});
+  registeredShaderPrograms.insert({"CURVE_LINES", {{&FLEX_CYLINDER_STRIP_VERT_SHADER, &FLEX_LINE_STRIP_GEOM_SHADER, &FLEX_LINE_STRIP_FRAG_SHADER}, DrawMode::IndexedLines}});
+  registeredShaderPrograms.insert({"HISTOGRAM", {{&HISTOGRAM_VERT_SHADER, &HISTOGRAM_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"GROUND_PLANE_TILE", {{&GROUND_PLANE_VERT_SHADER, &GROUND_PLANE_TILE_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"GROUND_PLANE_TILE_REFLECT", {{&GROUND_PLANE_VERT_SHADER, &GROUND_PLANE_TILE_REFLECT_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"GROUND_PLANE_SHADOW", {{&GROUND_PLANE_VERT_SHADER, &GROUND_PLANE_SHADOW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"MAP_LIGHT", {{&TEXTURE_DRAW_VERT_SHADER, &MAP_LIGHT_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"RIBBON", {{&RIBBON_VERT_SHADER, &RIBBON_GEOM_SHADER, &RIBBON_FRAG_SHADER}, DrawMode::IndexedLineStripAdjacency}});
+  registeredShaderPrograms.insert({"SLICE_PLANE", {{&SLICE_PLANE_VERT_SHADER, &SLICE_PLANE_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"OCCLUSION_BOX", {{&OCCLUSION_BOX_VERT_SHADER, &OCCLUSION_BOX_FRAG_SHADER}, DrawMode::Triangles}});
+
+  registeredShaderPrograms.insert({"TEXTURE_DRAW_PLAIN", {{&TEXTURE_DRAW_VERT_SHADER, &PLAIN_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TEXTURE_DRAW_DOT3", {{&TEXTURE_DRAW_VERT_SHADER, &DOT3_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TEXTURE_DRAW_MAP3", {{&TEXTURE_DRAW_VERT_SHADER, &MAP3_TEXTURE_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TEXTURE_DRAW_SPHEREBG", {{&SPHEREBG_DRAW_VERT_SHADER, &SPHEREBG_DRAW_FRAG_SHADER}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"COMPOSITE_PEEL", {{&TEXTURE_DRAW_VERT_SHADER, &COMPOSITE_PEEL}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"COMPOSITE_WEIGHTED", {{&TEXTURE_DRAW_VERT_SHADER, &COMPOSITE_WEIGHTED}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"DEFERRED_LIGHTING", {{&TEXTURE_DRAW_VERT_SHADER, &DEFERRED_LIGHTING}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"DEPTH_COPY", {{&TEXTURE_DRAW_VERT_SHADER, &DEPTH_COPY}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"DEPTH_TO_MASK", {{&TEXTURE_DRAW_VERT_SHADER, &DEPTH_TO_MASK}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"EYE_DOME_LIGHTING", {{&TEXTURE_DRAW_VERT_SHADER, &EYE_DOME_LIGHTING}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"SCALAR_TEXTURE_COLORMAP", {{&TEXTURE_DRAW_VERT_SHADER, &SCALAR_TEXTURE_COLORMAP}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"SCALAR_TEXTURE_TILE_COLORMAP", {{&TEXTURE_TILE_DRAW_VERT_SHADER, &SCALAR_TEXTURE_COLORMAP}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"BLUR_RGB", {{&TEXTURE_DRAW_VERT_SHADER, &BLUR_RGB}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TEMPORAL_ACCUMULATE", {{&TEXTURE_DRAW_VERT_SHADER, &TEMPORAL_ACCUMULATE}, DrawMode::Triangles}});
+  registeredShaderPrograms.insert({"TRANSFORMATION_GIZMO_ROT", {{&TRANSFORMATION_GIZMO_ROT_VERT, &TRANSFORMATION_GIZMO_ROT_FRAG}, DrawMode::Triangles}});
+
+  for (const auto& program : registeredShaderPrograms) {
+    registeredShaderTemplates.insert({program.first, tokenizeShaderSources(program.second.first)});
+  }
 
   // === Load rules
 
   // Utility rules
-  registeredShaderRules.insert({"GLSL_VERSION", GLSL_VERSION});
-  registeredShaderRules.insert({"GLOBAL_FRAGMENT_FILTER", GLOBAL_FRAGMENT_FILTER});
-  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_1", DOWNSAMPLE_RESOLVE_1});
-  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_2", DOWNSAMPLE_RESOLVE_2});
-  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_3", DOWNSAMPLE_RESOLVE_3});
-  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_4", DOWNSAMPLE_RESOLVE_4});
+  registeredShaderRules.insert({"GLSL_VERSION", &GLSL_VERSION});
+  registeredShaderRules.insert({"GLOBAL_FRAGMENT_FILTER", &GLOBAL_FRAGMENT_FILTER});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_1", &DOWNSAMPLE_RESOLVE_1});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_2", &DOWNSAMPLE_RESOLVE_2});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_3", &DOWNSAMPLE_RESOLVE_3});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_4", &DOWNSAMPLE_RESOLVE_4});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_SCALED", &DOWNSAMPLE_RESOLVE_SCALED});
+  registeredShaderRules.insert({"DOWNSAMPLE_RESOLVE_FXAA", &DOWNSAMPLE_RESOLVE_FXAA});
   
-  registeredShaderRules.insert({"TRANSPARENCY_STRUCTURE", TRANSPARENCY_STRUCTURE});
-  registeredShaderRules.insert({"TRANSPARENCY_RESOLVE_SIMPLE", TRANSPARENCY_RESOLVE_SIMPLE});
-  registeredShaderRules.insert({"TRANSPARENCY_PEEL_STRUCTURE", TRANSPARENCY_PEEL_STRUCTURE});
-  registeredShaderRules.insert({"TRANSPARENCY_PEEL_GROUND", TRANSPARENCY_PEEL_GROUND});
+  registeredShaderRules.insert({"TRANSPARENCY_STRUCTURE", &TRANSPARENCY_STRUCTURE});
+  registeredShaderRules.insert({"TRANSPARENCY_WEIGHTED_STRUCTURE", &TRANSPARENCY_WEIGHTED_STRUCTURE});
+  registeredShaderRules.insert({"TRANSPARENCY_RESOLVE_SIMPLE", &TRANSPARENCY_RESOLVE_SIMPLE});
+  registeredShaderRules.insert({"TRANSPARENCY_PEEL_STRUCTURE", &TRANSPARENCY_PEEL_STRUCTURE});
+  registeredShaderRules.insert({"IMPOSTOR_DEPTH_PREPASS", &IMPOSTOR_DEPTH_PREPASS});
+  registeredShaderRules.insert({"TRANSPARENCY_PEEL_GROUND", &TRANSPARENCY_PEEL_GROUND});
   
-  registeredShaderRules.insert({"GENERATE_VIEW_POS", GENERATE_VIEW_POS});
-  registeredShaderRules.insert({"CULL_POS_FROM_VIEW", CULL_POS_FROM_VIEW});
-  //registeredShaderRules.insert({"CULL_POS_FROM_ATTR", CULL_POS_FROM_ATTR});
+  registeredShaderRules.insert({"GENERATE_VIEW_POS", &GENERATE_VIEW_POS});
+  registeredShaderRules.insert({"CULL_POS_FROM_VIEW", &CULL_POS_FROM_VIEW});
+  //registeredShaderRules.insert({"CULL_POS_FROM_ATTR", &CULL_POS_FROM_ATTR});
 
   // Lighting and shading things
-  registeredShaderRules.insert({"LIGHT_MATCAP", LIGHT_MATCAP});
-  registeredShaderRules.insert({"LIGHT_PASSTHRU", LIGHT_PASSTHRU});
-  registeredShaderRules.insert({"SHADE_BASECOLOR", SHADE_BASECOLOR});
-  registeredShaderRules.insert({"SHADE_COLOR", SHADE_COLOR});
-  registeredShaderRules.insert({"SHADE_COLORMAP_VALUE", SHADE_COLORMAP_VALUE});
-  registeredShaderRules.insert({"SHADE_COLORMAP_ANGULAR2", SHADE_COLORMAP_ANGULAR2});
-  registeredShaderRules.insert({"SHADE_GRID_VALUE2", SHADE_GRID_VALUE2});
-  registeredShaderRules.insert({"SHADE_CHECKER_VALUE2", SHADE_CHECKER_VALUE2});
-  registeredShaderRules.insert({"SHADEVALUE_MAG_VALUE2", SHADEVALUE_MAG_VALUE2});
-  registeredShaderRules.insert({"ISOLINE_STRIPE_VALUECOLOR", ISOLINE_STRIPE_VALUECOLOR});
-  registeredShaderRules.insert({"CHECKER_VALUE2COLOR", CHECKER_VALUE2COLOR});
+  registeredShaderRules.insert({"LIGHT_MATCAP", &LIGHT_MATCAP});
+  registeredShaderRules.insert({"LIGHT_PASSTHRU", &LIGHT_PASSTHRU});
+  registeredShaderRules.insert({"LIGHT_DEFERRED", &LIGHT_DEFERRED});
+  registeredShaderRules.insert({"SHADE_BASECOLOR", &SHADE_BASECOLOR});
+  registeredShaderRules.insert({"SHADE_COLOR", &SHADE_COLOR});
+  registeredShaderRules.insert({"SHADE_COLORMAP_VALUE", &SHADE_COLORMAP_VALUE});
+  registeredShaderRules.insert({"SHADE_COLORMAP_ANGULAR2", &SHADE_COLORMAP_ANGULAR2});
+  registeredShaderRules.insert({"SHADE_GRID_VALUE2", &SHADE_GRID_VALUE2});
+  registeredShaderRules.insert({"SHADE_CHECKER_VALUE2", &SHADE_CHECKER_VALUE2});
+  registeredShaderRules.insert({"SHADEVALUE_MAG_VALUE2", &SHADEVALUE_MAG_VALUE2});
+  registeredShaderRules.insert({"ISOLINE_STRIPE_VALUECOLOR", &ISOLINE_STRIPE_VALUECOLOR});
+  registeredShaderRules.insert({"SHADE_SPARSE_ABSENT_COLOR", &SHADE_SPARSE_ABSENT_COLOR});
+  registeredShaderRules.insert({"CHECKER_VALUE2COLOR", &CHECKER_VALUE2COLOR});
 
   // mesh things
-  registeredShaderRules.insert({"MESH_WIREFRAME", MESH_WIREFRAME});
-  registeredShaderRules.insert({"MESH_BACKFACE_NORMAL_FLIP", MESH_BACKFACE_NORMAL_FLIP});
-  registeredShaderRules.insert({"MESH_BACKFACE_DIFFERENT", MESH_BACKFACE_DIFFERENT});
-  registeredShaderRules.insert({"MESH_BACKFACE_DARKEN", MESH_BACKFACE_DARKEN});
-  registeredShaderRules.insert({"MESH_PROPAGATE_VALUE", MESH_PROPAGATE_VALUE});
-  registeredShaderRules.insert({"MESH_PROPAGATE_VALUE2", MESH_PROPAGATE_VALUE2});
-  registeredShaderRules.insert({"MESH_PROPAGATE_COLOR", MESH_PROPAGATE_COLOR});
-  registeredShaderRules.insert({"MESH_PROPAGATE_HALFEDGE_VALUE", MESH_PROPAGATE_HALFEDGE_VALUE});
-  registeredShaderRules.insert({"MESH_PROPAGATE_CULLPOS", MESH_PROPAGATE_CULLPOS});
-  registeredShaderRules.insert({"MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE", MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE});
-  registeredShaderRules.insert({"MESH_PROPAGATE_PICK", MESH_PROPAGATE_PICK});
+  registeredShaderRules.insert({"MESH_WIREFRAME", &MESH_WIREFRAME});
+  registeredShaderRules.insert({"MESH_BACKFACE_NORMAL_FLIP", &MESH_BACKFACE_NORMAL_FLIP});
+  registeredShaderRules.insert({"MESH_BACKFACE_DIFFERENT", &MESH_BACKFACE_DIFFERENT});
+  registeredShaderRules.insert({"MESH_BACKFACE_DARKEN", &MESH_BACKFACE_DARKEN});
+  registeredShaderRules.insert({"MESH_COMPUTE_NORMAL_FROM_POSITION", &MESH_COMPUTE_NORMAL_FROM_POSITION});
+  registeredShaderRules.insert({"MESH_PROPAGATE_VALUE", &MESH_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_FACE_VALUE_TEXTURE", &MESH_PROPAGATE_FACE_VALUE_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_VERTEX_VALUE_TEXTURE", &MESH_PROPAGATE_VERTEX_VALUE_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_SPARSE_VALUE", &MESH_PROPAGATE_SPARSE_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_SPARSE_VERTEX_VALUE", &MESH_PROPAGATE_SPARSE_VERTEX_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_SPARSE_FACE_VALUE", &MESH_PROPAGATE_SPARSE_FACE_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_VALUE2", &MESH_PROPAGATE_VALUE2});
+  registeredShaderRules.insert({"MESH_PROPAGATE_COLOR", &MESH_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"MESH_PROPAGATE_FACE_COLOR_TEXTURE", &MESH_PROPAGATE_FACE_COLOR_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_CELL_VALUE_TEXTURE", &MESH_PROPAGATE_CELL_VALUE_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_CELL_COLOR_TEXTURE", &MESH_PROPAGATE_CELL_COLOR_TEXTURE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_HALFEDGE_VALUE", &MESH_PROPAGATE_HALFEDGE_VALUE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_CULLPOS", &MESH_PROPAGATE_CULLPOS});
+  registeredShaderRules.insert({"MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE", &MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE});
+  registeredShaderRules.insert({"MESH_PROPAGATE_PICK", &MESH_PROPAGATE_PICK});
+  registeredShaderRules.insert({"MESH_PROPAGATE_PICK_TEXTURE", &MESH_PROPAGATE_PICK_TEXTURE});
+  registeredShaderRules.insert({"MESH_INSTANCE_PROPAGATE_VALUE", &MESH_INSTANCE_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"MESH_INSTANCE_PROPAGATE_COLOR", &MESH_INSTANCE_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"MESH_INSTANCE_PROPAGATE_PICK", &MESH_INSTANCE_PROPAGATE_PICK});
 
   // sphere things
-  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE", SPHERE_PROPAGATE_VALUE});
-  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE2", SPHERE_PROPAGATE_VALUE2});
-  registeredShaderRules.insert({"SPHERE_PROPAGATE_COLOR", SPHERE_PROPAGATE_COLOR});
-  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER", SPHERE_CULLPOS_FROM_CENTER});
-  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER_QUAD", SPHERE_CULLPOS_FROM_CENTER_QUAD});
-  registeredShaderRules.insert({"SPHERE_VARIABLE_SIZE", SPHERE_VARIABLE_SIZE});
+  registeredShaderRules.insert({"REDUCE_POSITION", &REDUCE_POSITION});
+  registeredShaderRules.insert({"REDUCE_POSITION_DISTANCE", &REDUCE_POSITION_DISTANCE});
+  registeredShaderRules.insert({"REDUCE_SCALAR_VALUE", &REDUCE_SCALAR_VALUE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE", &SPHERE_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE2", &SPHERE_PROPAGATE_VALUE2});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_COLOR", &SPHERE_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_PICK_ID", &SPHERE_PROPAGATE_PICK_ID});
+  registeredShaderRules.insert({"SPHERE_PICK_ID_FROM_INDEX", &SPHERE_PICK_ID_FROM_INDEX});
+  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER", &SPHERE_CULLPOS_FROM_CENTER});
+  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER_QUAD", &SPHERE_CULLPOS_FROM_CENTER_QUAD});
+  registeredShaderRules.insert({"SPHERE_VARIABLE_SIZE", &SPHERE_VARIABLE_SIZE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE_INSTANCED", &SPHERE_PROPAGATE_VALUE_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_VALUE2_INSTANCED", &SPHERE_PROPAGATE_VALUE2_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_COLOR_INSTANCED", &SPHERE_PROPAGATE_COLOR_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_PICK_ID_INSTANCED", &SPHERE_PROPAGATE_PICK_ID_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PICK_ID_FROM_INDEX_INSTANCED", &SPHERE_PICK_ID_FROM_INDEX_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER_INSTANCED", &SPHERE_CULLPOS_FROM_CENTER}); // fragment-only
+  registeredShaderRules.insert({"SPHERE_CULLPOS_FROM_CENTER_QUAD_INSTANCED", &SPHERE_CULLPOS_FROM_CENTER_QUAD_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_VARIABLE_SIZE_INSTANCED", &SPHERE_VARIABLE_SIZE_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_POSITION_LERP", &SPHERE_POSITION_LERP});
+  registeredShaderRules.insert({"SPHERE_POSITION_LERP_INSTANCED", &SPHERE_POSITION_LERP_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_VALUE_LERP", &SPHERE_VALUE_LERP});
+  registeredShaderRules.insert({"SPHERE_VALUE_LERP_INSTANCED", &SPHERE_VALUE_LERP_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_CHANNEL_VALUE", &SPHERE_PROPAGATE_CHANNEL_VALUE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_CHANNEL_VALUE_INSTANCED", &SPHERE_PROPAGATE_CHANNEL_VALUE_INSTANCED});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_SPARSE_VALUE", &SPHERE_PROPAGATE_SPARSE_VALUE});
+  registeredShaderRules.insert({"SPHERE_PROPAGATE_SPARSE_VALUE_INSTANCED", &SPHERE_PROPAGATE_SPARSE_VALUE_INSTANCED});
 
   // vector things
-  registeredShaderRules.insert({"VECTOR_PROPAGATE_COLOR", VECTOR_PROPAGATE_COLOR});
-  registeredShaderRules.insert({"VECTOR_CULLPOS_FROM_TAIL", VECTOR_CULLPOS_FROM_TAIL});
-  registeredShaderRules.insert({"TRANSFORMATION_GIZMO_VEC", TRANSFORMATION_GIZMO_VEC});
+  registeredShaderRules.insert({"VECTOR_PROPAGATE_COLOR", &VECTOR_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"VECTOR_PROPAGATE_COLOR_INSTANCED", &VECTOR_PROPAGATE_COLOR_INSTANCED});
+  registeredShaderRules.insert({"VECTOR_CULLPOS_FROM_TAIL", &VECTOR_CULLPOS_FROM_TAIL});
+  registeredShaderRules.insert({"TRANSFORMATION_GIZMO_VEC", &TRANSFORMATION_GIZMO_VEC});
 
   // cylinder things
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_VALUE", CYLINDER_PROPAGATE_VALUE});
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_BLEND_VALUE", CYLINDER_PROPAGATE_BLEND_VALUE});
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_COLOR", CYLINDER_PROPAGATE_COLOR});
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_BLEND_COLOR", CYLINDER_PROPAGATE_BLEND_COLOR});
-  registeredShaderRules.insert({"CYLINDER_PROPAGATE_PICK", CYLINDER_PROPAGATE_PICK});
-  registeredShaderRules.insert({"CYLINDER_CULLPOS_FROM_MID", CYLINDER_CULLPOS_FROM_MID});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_VALUE", &CYLINDER_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_BLEND_VALUE", &CYLINDER_PROPAGATE_BLEND_VALUE});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_COLOR", &CYLINDER_PROPAGATE_COLOR});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_BLEND_COLOR", &CYLINDER_PROPAGATE_BLEND_COLOR});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_PICK", &CYLINDER_PROPAGATE_PICK});
+  registeredShaderRules.insert({"CYLINDER_PROPAGATE_PICK_ID", &CYLINDER_PROPAGATE_PICK_ID});
+  registeredShaderRules.insert({"CYLINDER_CULLPOS_FROM_MID", &CYLINDER_CULLPOS_FROM_MID});
 
   // marching tets things
-  registeredShaderRules.insert({"SLICE_TETS_BASECOLOR_SHADE", SLICE_TETS_BASECOLOR_SHADE});
-  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_VALUE", SLICE_TETS_PROPAGATE_VALUE});
-  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_VECTOR", SLICE_TETS_PROPAGATE_VECTOR});
-  registeredShaderRules.insert({"SLICE_TETS_VECTOR_COLOR", SLICE_TETS_VECTOR_COLOR});
-  registeredShaderRules.insert({"SLICE_TETS_MESH_WIREFRAME", SLICE_TETS_MESH_WIREFRAME});
+  registeredShaderRules.insert({"SLICE_TETS_BASECOLOR_SHADE", &SLICE_TETS_BASECOLOR_SHADE});
+  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_VALUE", &SLICE_TETS_PROPAGATE_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_VECTOR", &SLICE_TETS_PROPAGATE_VECTOR});
+  registeredShaderRules.insert({"SLICE_TETS_VECTOR_COLOR", &SLICE_TETS_VECTOR_COLOR});
+  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_CELL_VALUE", &SLICE_TETS_PROPAGATE_CELL_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_PROPAGATE_CELL_VECTOR", &SLICE_TETS_PROPAGATE_CELL_VECTOR});
+  registeredShaderRules.insert({"SLICE_TETS_SLICE_BY_VALUE", &SLICE_TETS_SLICE_BY_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_MESH_WIREFRAME", &SLICE_TETS_MESH_WIREFRAME});
+  registeredShaderRules.insert({"SLICE_TETS_CAPTURE_POSITION", &SLICE_TETS_CAPTURE_POSITION});
+  registeredShaderRules.insert({"SLICE_TETS_CAPTURE_VALUE", &SLICE_TETS_CAPTURE_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_CAPTURE_VECTOR", &SLICE_TETS_CAPTURE_VECTOR});
+  registeredShaderRules.insert({"SLICE_TETS_CACHED_VALUE", &SLICE_TETS_CACHED_VALUE});
+  registeredShaderRules.insert({"SLICE_TETS_CACHED_VECTOR", &SLICE_TETS_CACHED_VECTOR});
+  registeredShaderRules.insert({"VOLUME_GRID_SAMPLE_DENSE", &VOLUME_GRID_SAMPLE_DENSE});
+  registeredShaderRules.insert({"VOLUME_GRID_SAMPLE_BRICKED", &VOLUME_GRID_SAMPLE_BRICKED});
+  registerShaderRule("VOLUME_GRID_SLICE_PLANE_CULL", generateVolumeGridSlicePlaneRule());
+  registerShaderRule("SLICE_PLANE_CULL", generateSlicePlaneRule());
 
   // clang-format on
 };
 
-void GLEngine::createSlicePlaneFliterRule(std::string uniquePostfix) {
-  registeredShaderRules.insert({"SLICE_PLANE_CULL_" + uniquePostfix, generateSlicePlaneRule(uniquePostfix)});
-}
-
-
-} // namespace backend_openGL3_glfw
-} // namespace render
-} // namespace polyscope
-
-#else
-
-#include <stdexcept>
 
-namespace polyscope {
-namespace render {
-namespace backend_openGL3_glfw {
-void initializeRenderEngine() {
-  throw std::runtime_error("Polyscope was not compiled with support for backend: openGL3_glfw");
-}
 } // namespace backend_openGL3_glfw
 } // namespace render
 } // namespace polyscope
@@ -0,0 +1,261 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#ifdef POLYSCOPE_BACKEND_OPENGL3_EGL_ENABLED
+#include "polyscope/render/opengl/gl_engine_egl.h"
+
+#include "polyscope/messages.h"
+#include "polyscope/options.h"
+#include "polyscope/polyscope.h"
+
+#include <EGL/eglext.h>
+
+#include <algorithm>
+
+namespace polyscope {
+namespace render {
+
+namespace backend_openGL3_egl {
+
+GLEngineEGL* eglEngine = nullptr; // alias for global engine pointer
+
+void initializeRenderEngine() {
+  eglEngine = new GLEngineEGL();
+  eglEngine->initialize();
+  engine = eglEngine;
+  engine->allocateGlobalBuffersAndPrograms();
+}
+
+} // namespace backend_openGL3_egl
+
+namespace backend_openGL4_egl {
+
+void initializeRenderEngine() {
+  using backend_openGL3_egl::eglEngine;
+  eglEngine = new backend_openGL3_egl::GLEngineEGL();
+  eglEngine->requestDirectStateAccess = true;
+  eglEngine->initialize();
+  engine = eglEngine;
+  engine->allocateGlobalBuffersAndPrograms();
+}
+
+} // namespace backend_openGL4_egl
+
+namespace backend_openGL3_egl {
+
+namespace {
+
+void* getEGLProcAddress(const char* name) { return reinterpret_cast<void*>(eglGetProcAddress(name)); }
+
+} // namespace
+
+GLEngineEGL::GLEngineEGL() {}
+
+EGLDisplay GLEngineEGL::getHeadlessDisplay() {
+
+  auto getPlatformDisplay =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  auto queryDevices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglGetProcAddress("eglQueryDevicesEXT"));
+
+  // Prefer an actual device. It is picked by index, so parallel jobs can be spread over the GPUs of a node.
+  if (getPlatformDisplay != nullptr && queryDevices != nullptr) {
+    const EGLint maxDevices = 32;
+    EGLDeviceEXT devices[maxDevices];
+    EGLint nDevices = 0;
+    if (queryDevices(maxDevices, devices, &nDevices) && nDevices > 0) {
+      if (options::eglDeviceIndex < 0 || options::eglDeviceIndex >= nDevices) {
+        throw std::runtime_error(options::printPrefix + "ERROR: options::eglDeviceIndex is " +
+                                 std::to_string(options::eglDeviceIndex) + ", but there are only " +
+                                 std::to_string(nDevices) + " EGL devices");
+      }
+      EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[options::eglDeviceIndex], nullptr);
+      if (display != EGL_NO_DISPLAY) return display;
+    }
+  }
+
+  // Otherwise, Mesa's surfaceless platform, which renders in software when there is no GPU at all
+  if (getPlatformDisplay != nullptr) {
+    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display != EGL_NO_DISPLAY) return display;
+  }
+
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+void GLEngineEGL::initialize() {
+
+  // === Initialize EGL
+  eglDisplay = getHeadlessDisplay();
+  EGLint eglMajor = 0, eglMinor = 0;
+  if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &eglMajor, &eglMinor)) {
+    throw std::runtime_error(options::printPrefix + "ERROR: Failed to initialize EGL");
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    throw std::runtime_error(options::printPrefix + "ERROR: EGL does not support openGL");
+  }
+
+  // Nothing is ever drawn to an EGL surface, but a config is still needed to create the context
+  // clang-format off
+  const EGLint configAttribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_NONE
+  };
+  // clang-format on
+  EGLConfig config;
+  EGLint nConfigs = 0;
+  if (!eglChooseConfig(eglDisplay, configAttribs, &config, 1, &nConfigs) || nConfigs == 0) {
+    throw std::runtime_error(options::printPrefix + "ERROR: Failed to find a suitable EGL config");
+  }
+
+  // OpenGL version things
+  // clang-format off
+  EGLint contextAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, requestDirectStateAccess ? 4 : 3,
+    EGL_CONTEXT_MINOR_VERSION, requestDirectStateAccess ? 5 : 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  // clang-format on
+  eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+  if (eglContext == EGL_NO_CONTEXT && requestDirectStateAccess) {
+    // no GL 4.5 here, settle for 3.3
+    contextAttribs[1] = 3;
+    contextAttribs[3] = 3;
+    eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+  }
+  if (eglContext == EGL_NO_CONTEXT) {
+    throw std::runtime_error(options::printPrefix + "ERROR: Failed to create EGL context");
+  }
+
+  // No surface at all (EGL_KHR_surfaceless_context), all rendering goes to framebuffer objects
+  if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+    throw std::runtime_error(options::printPrefix + "ERROR: Failed to make EGL context current");
+  }
+
+  // Set initial window size; there is no DPI scaling without a window
+  view::windowWidth = std::max(view::windowWidth, 1);
+  view::windowHeight = std::max(view::windowHeight, 1);
+  view::bufferWidth = view::windowWidth;
+  view::bufferHeight = view::windowHeight;
+
+  // === Initialize openGL
+  loadGLFunctions(getEGLProcAddress);
+  if (options::verbosity > 0) {
+    std::cout << options::printPrefix << "Backend: " << (requestDirectStateAccess ? "openGL4_egl" : "openGL3_egl")
+              << " -- Loaded openGL version: " << glGetString(GL_VERSION) << " (" << glGetString(GL_RENDERER) << ")"
+              << (usesDirectStateAccess() ? " (direct state access)" : "") << std::endl;
+  }
+
+  { // Create the "screen" frame buffer, which is offscreen like everything else
+    displayBuffer = generateFrameBuffer(view::bufferWidth, view::bufferHeight);
+    displayBuffer->addColorBuffer(
+        generateRenderBuffer(RenderBufferType::ColorAlpha, view::bufferWidth, view::bufferHeight));
+    displayBuffer->addDepthBuffer(generateRenderBuffer(RenderBufferType::Depth, view::bufferWidth, view::bufferHeight));
+    displayBuffer->setDrawBuffers();
+    displayBuffer->bind();
+    glClearColor(1., 1., 1., 0.);
+  }
+
+  populateDefaultShadersAndRules();
+}
+
+void GLEngineEGL::initializeImGui() {
+  bindDisplay();
+
+  ImGui::CreateContext(); // must call once at start
+
+  // Only the renderer half of the ImGui bindings, since there is no platform window to take input from
+  const char* glsl_version = "#version 150";
+  ImGui_ImplOpenGL3_Init(glsl_version);
+
+  configureImGui();
+}
+
+void GLEngineEGL::shutdownImGui() {
+  ImGui_ImplOpenGL3_Shutdown();
+  ImGui::DestroyContext();
+}
+
+void GLEngineEGL::swapDisplayBuffers() {
+  // nothing to present, but keep frames from piling up in the command queue
+  bindDisplay();
+  glFlush();
+  fencePresentedFrame();
+}
+
+void GLEngineEGL::makeContextCurrent() { eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext); }
+
+void GLEngineEGL::focusWindow() {}
+
+void GLEngineEGL::showWindow() {}
+
+void GLEngineEGL::hideWindow() {}
+
+void GLEngineEGL::updateWindowSize(bool force) {
+  int newWidth = std::max(view::windowWidth, 1);
+  int newHeight = std::max(view::windowHeight, 1);
+  if (force || newWidth != view::bufferWidth || newHeight != view::bufferHeight) {
+    // Basically a resize callback
+    requestRedraw();
+
+    view::bufferWidth = newWidth;
+    view::bufferHeight = newHeight;
+    view::windowWidth = newWidth;
+    view::windowHeight = newHeight;
+
+    render::engine->scheduleScreenBufferResize(force);
+  }
+}
+
+std::tuple<int, int> GLEngineEGL::getWindowPos() { return std::tuple<int, int>{0, 0}; }
+
+bool GLEngineEGL::windowRequestsClose() { return false; }
+
+void GLEngineEGL::pollEvents() {}
+
+void GLEngineEGL::waitEvents(double timeoutSeconds) {}
+
+bool GLEngineEGL::isKeyPressed(char c) { return false; }
+
+void GLEngineEGL::ImGuiNewFrame() {
+
+  // Normally the platform bindings would fill these in
+  ImGuiIO& io = ImGui::GetIO();
+  io.DisplaySize.x = view::bufferWidth;
+  io.DisplaySize.y = view::bufferHeight;
+  io.DeltaTime = 1.f / 60.f;
+  applyQueuedInput(); // (e.g. from a remote viewer, there is no window to take input from)
+
+  ensureImGuiFonts();
+  ImGui_ImplOpenGL3_NewFrame();
+  ImGui::NewFrame();
+}
+
+} // namespace backend_openGL3_egl
+} // namespace render
+} // namespace polyscope
+
+#else
+
+#include <stdexcept>
+
+namespace polyscope {
+namespace render {
+namespace backend_openGL3_egl {
+void initializeRenderEngine() {
+  throw std::runtime_error("Polyscope was not compiled with support for backend: openGL3_egl");
+}
+} // namespace backend_openGL3_egl
+namespace backend_openGL4_egl {
+void initializeRenderEngine() {
+  throw std::runtime_error("Polyscope was not compiled with support for backend: openGL4_egl");
+}
+} // namespace backend_openGL4_egl
+} // namespace render
+} // namespace polyscope
+
+#endif
@@ -0,0 +1,238 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#ifdef POLYSCOPE_BACKEND_OPENGL3_GLFW_ENABLED
+#include "polyscope/render/opengl/gl_engine_glfw.h"
+
+#include "polyscope/messages.h"
+#include "polyscope/options.h"
+#include "polyscope/polyscope.h"
+
+namespace polyscope {
+namespace render {
+
+namespace backend_openGL3_glfw {
+
+GLEngineGLFW* glEngine = nullptr; // alias for global engine pointer
+
+void initializeRenderEngine() {
+  glEngine = new GLEngineGLFW();
+  glEngine->initialize();
+  engine = glEngine;
+  engine->allocateGlobalBuffersAndPrograms();
+}
+
+} // namespace backend_openGL3_glfw
+
+namespace backend_openGL4_glfw {
+
+void initializeRenderEngine() {
+  using backend_openGL3_glfw::glEngine;
+  glEngine = new backend_openGL3_glfw::GLEngineGLFW();
+  glEngine->requestDirectStateAccess = true;
+  glEngine->initialize();
+  engine = glEngine;
+  engine->allocateGlobalBuffersAndPrograms();
+}
+
+} // namespace backend_openGL4_glfw
+
+namespace backend_openGL3_glfw {
+
+GLEngineGLFW::GLEngineGLFW() {}
+
+void GLEngineGLFW::initialize() {
+
+  // Small callback function for GLFW errors
+  auto error_print_callback = [](int error, const char* description) {
+    std::cerr << "GLFW emitted error: " << description << std::endl;
+  };
+
+  // === Initialize glfw
+  glfwSetErrorCallback(error_print_callback);
+  if (!glfwInit()) {
+    throw std::runtime_error(options::printPrefix + "ERROR: Failed to initialize glfw");
+  }
+
+  // OpenGL version things
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, requestDirectStateAccess ? 4 : 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, requestDirectStateAccess ? 5 : 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+  // Create the window with context
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  glfwWindowHint(GLFW_FOCUS_ON_SHOW, GLFW_FALSE);
+  mainWindow = glfwCreateWindow(view::windowWidth, view::windowHeight, options::programName.c_str(), NULL, NULL);
+  if (mainWindow == nullptr && requestDirectStateAccess) {
+    // no GL 4.5 here (e.g. macOS stops at 4.1), settle for 3.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    mainWindow = glfwCreateWindow(view::windowWidth, view::windowHeight, options::programName.c_str(), NULL, NULL);
+  }
+  glfwMakeContextCurrent(mainWindow);
+  glfwSwapInterval(1); // Enable vsync
+  glfwSetWindowPos(mainWindow, view::initWindowPosX, view::initWindowPosY);
+
+  // Set initial window size
+  int newBufferWidth, newBufferHeight, newWindowWidth, newWindowHeight;
+  glfwGetFramebufferSize(mainWindow, &newBufferWidth, &newBufferHeight);
+  glfwGetWindowSize(mainWindow, &newWindowWidth, &newWindowHeight);
+  view::bufferWidth = newBufferWidth;
+  view::bufferHeight = newBufferHeight;
+  view::windowWidth = newWindowWidth;
+  view::windowHeight = newWindowHeight;
+
+  // === Initialize openGL
+  loadGLFunctions([](const char* name) -> void* { return reinterpret_cast<void*>(glfwGetProcAddress(name)); });
+  if (options::verbosity > 0) {
+    std::cout << options::printPrefix << "Backend: " << (requestDirectStateAccess ? "openGL4_glfw" : "openGL3_glfw")
+              << " -- Loaded openGL version: " << glGetString(GL_VERSION)
+              << (usesDirectStateAccess() ? " (direct state access)" : "") << std::endl;
+  }
+
+#ifdef __APPLE__
+  // Hack to classify the process as interactive
+  glfwPollEvents();
+#endif
+
+  { // Manually create the screen frame buffer
+    GLFrameBuffer* glScreenBuffer = new GLFrameBuffer(view::bufferWidth, view::bufferHeight, true);
+    displayBuffer.reset(glScreenBuffer);
+    glScreenBuffer->bind();
+    glClearColor(1., 1., 1., 0.);
+    // glClearColor(0., 0., 0., 0.);
+    // glClearDepth(1.);
+  }
+
+  populateDefaultShadersAndRules();
+}
+
+void GLEngineGLFW::initializeImGui() {
+  bindDisplay();
+
+  ImGui::CreateContext(); // must call once at start
+
+  // Set up ImGUI glfw bindings
+  ImGui_ImplGlfw_InitForOpenGL(mainWindow, true);
+  const char* glsl_version = "#version 150";
+  ImGui_ImplOpenGL3_Init(glsl_version);
+
+  configureImGui();
+}
+
+void GLEngineGLFW::shutdownImGui() {
+  // ImGui shutdown things
+  ImGui_ImplOpenGL3_Shutdown();
+  ImGui_ImplGlfw_Shutdown();
+  ImGui::DestroyContext();
+}
+
+void GLEngineGLFW::swapDisplayBuffers() {
+  bindDisplay();
+  glfwSwapBuffers(mainWindow);
+  fencePresentedFrame();
+}
+
+void GLEngineGLFW::setPresentMode(PresentMode newMode) {
+  Engine::setPresentMode(newMode);
+  if (mainWindow == nullptr) return;
+
+  makeContextCurrent();
+  switch (newMode) {
+  case PresentMode::VSync:
+  case PresentMode::LowLatency:
+    glfwSwapInterval(1);
+    break;
+  case PresentMode::AdaptiveVSync:
+    // (a negative interval needs the swap_control_tear extensions, otherwise the driver would ignore it)
+    if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+      glfwSwapInterval(-1);
+    } else {
+      info("adaptive vsync is not supported by this driver, using vsync");
+      glfwSwapInterval(1);
+    }
+    break;
+  case PresentMode::Immediate:
+    glfwSwapInterval(0);
+    break;
+  }
+}
+
+void GLEngineGLFW::makeContextCurrent() {
+  glfwMakeContextCurrent(mainWindow);
+  GLEngine::makeContextCurrent();
+}
+
+void GLEngineGLFW::focusWindow() { glfwFocusWindow(mainWindow); }
+
+void GLEngineGLFW::showWindow() { glfwShowWindow(mainWindow); }
+
+void GLEngineGLFW::hideWindow() {
+  glfwHideWindow(mainWindow);
+  glfwPollEvents(); // this shouldn't be necessary, but seems to be needed at least on macOS. Perhaps realted to a glfw
+                    // bug? e.g. https://github.com/glfw/glfw/issues/1300 and related bugs
+}
+
+void GLEngineGLFW::updateWindowSize(bool force) {
+  int newBufferWidth, newBufferHeight, newWindowWidth, newWindowHeight;
+  glfwGetFramebufferSize(mainWindow, &newBufferWidth, &newBufferHeight);
+  glfwGetWindowSize(mainWindow, &newWindowWidth, &newWindowHeight);
+  if (force || newBufferWidth != view::bufferWidth || newBufferHeight != view::bufferHeight ||
+      newWindowHeight != view::windowHeight || newWindowWidth != view::windowWidth) {
+    // Basically a resize callback
+    requestRedraw();
+
+    // prevent any division by zero for e.g. aspect ratio calcs
+    if (newBufferHeight == 0) newBufferHeight = 1;
+
+    if (newWindowHeight == 0) newWindowHeight = 1;
+
+    view::bufferWidth = newBufferWidth;
+    view::bufferHeight = newBufferHeight;
+    view::windowWidth = newWindowWidth;
+    view::windowHeight = newWindowHeight;
+
+    render::engine->scheduleScreenBufferResize(force);
+  }
+}
+
+std::tuple<int, int> GLEngineGLFW::getWindowPos() {
+  int x, y;
+  glfwGetWindowPos(mainWindow, &x, &y);
+  return std::tuple<int, int>{x, y};
+}
+
+bool GLEngineGLFW::windowRequestsClose() {
+  bool shouldClose = glfwWindowShouldClose(mainWindow);
+  if (shouldClose) {
+    glfwSetWindowShouldClose(mainWindow, false); // un-set the state bit so we can close again
+    return true;
+  }
+  return false;
+}
+
+void GLEngineGLFW::pollEvents() { glfwPollEvents(); }
+
+void GLEngineGLFW::waitEvents(double timeoutSeconds) { glfwWaitEventsTimeout(timeoutSeconds); }
+
+bool GLEngineGLFW::isKeyPressed(char c) {
+  if (c >= '0' && c <= '9') return ImGui::IsKeyPressed(GLFW_KEY_0 + (c - '0'));
+  if (c >= 'a' && c <= 'z') return ImGui::IsKeyPressed(GLFW_KEY_A + (c - 'a'));
+  throw std::runtime_error("keyPressed only supports 0-9, a-z");
+}
+
+void GLEngineGLFW::ImGuiNewFrame() {
+  ensureImGuiFonts();
+  ImGui_ImplOpenGL3_NewFrame();
+  ImGui_ImplGlfw_NewFrame();
+  ImGui::NewFrame();
+
+  // ImGui::ShowDemoWindow();
+}
+
+} // namespace backend_openGL3_glfw
+} // namespace render
+} // namespace polyscope
+
+#endif
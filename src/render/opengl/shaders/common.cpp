@@ -22,6 +22,43 @@ const vec3 RGB_DARKRED  = vec3( .2, .0, .0 );
 float LARGE_FLOAT() { return 1e25; }
 float length2(vec3 a) { return dot(a,a); }
 
+// The pick color of the element `offset` places after the one whose color is `start` (see pick::indToVec(), which
+// packs an index in 22 bit chunks)
+vec3 pickIndexColor(vec3 start, uint offset) {
+  uvec3 ind = uvec3(start * 4194304.);
+  ind.x += offset;
+  ind.y += ind.x >> 22u;
+  ind.x &= 4194303u;
+  ind.z += ind.y >> 22u;
+  ind.y &= 4194303u;
+  return vec3(ind) / 4194304.;
+}
+
+// The number of set bits among the low 16 bits of `bits`
+int sparseBitCount16(int bits) {
+  bits = bits - ((bits >> 1) & 0x5555);
+  bits = (bits & 0x3333) + ((bits >> 2) & 0x3333);
+  bits = (bits + (bits >> 4)) & 0x0F0F;
+  return (bits + (bits >> 8)) & 0x1F;
+}
+
+// The value of element iElement of a sparse quantity, if it has one (see SparseElementSet): `presence` holds a bitmask of
+// the elements with values, 32 per texel, and `values` the values, both filled row by row
+bool sparseLookup(sampler2D presence, sampler2D values, int iElement, out float value) {
+  value = 0.;
+  int presenceRowWidth = textureSize(presence, 0).x;
+  int iBlock = iElement / 32;
+  vec3 block = texelFetch(presence, ivec2(iBlock % presenceRowWidth, iBlock / presenceRowWidth), 0).rgb;
+  int lowBits = int(block.r);
+  int bit = iElement % 32;
+  int bits = bit < 16 ? lowBits : int(block.g);
+  if (((bits >> (bit % 16)) & 1) == 0) return false;
+  int iValue = int(block.b) + sparseBitCount16(bits & ((1 << (bit % 16)) - 1)) + (bit < 16 ? 0 : sparseBitCount16(lowBits));
+  int valueRowWidth = textureSize(values, 0).x;
+  value = texelFetch(values, ivec2(iValue % valueRowWidth, iValue / valueRowWidth), 0).r;
+  return true;
+}
+
 void buildTangentBasis(vec3 unitNormal, out vec3 basisX, out vec3 basisY) {
     basisX = vec3(1., 0., 0.);
     basisX -= dot(basisX, unitNormal) * unitNormal;
@@ -104,6 +141,23 @@ vec3 lightSurfaceMat(vec3 normal, vec3 color, sampler2D t_mat_r, sampler2D t_mat
   return colorCombined;
 }
 
+// Unit vectors in two components, by folding the octahedron of |x| + |y| + |z| = 1 flat (for deferred shading)
+vec2 octahedralEncode(vec3 n) {
+  n /= (abs(n.x) + abs(n.y) + abs(n.z));
+  if(n.z < 0.) {
+    n.xy = (1. - abs(n.yx)) * vec2(n.x >= 0. ? 1. : -1., n.y >= 0. ? 1. : -1.);
+  }
+  return n.xy;
+}
+
+vec3 octahedralDecode(vec2 e) {
+  vec3 n = vec3(e, 1. - abs(e.x) - abs(e.y));
+  if(n.z < 0.) {
+    n.xy = (1. - abs(n.yx)) * vec2(n.x >= 0. ? 1. : -1., n.y >= 0. ? 1. : -1.);
+  }
+  return normalize(n);
+}
+
 vec2 sphericalTexCoords(vec3 v) {
   const vec2 invMap = vec2(0.1591, 0.3183);
   vec2 uv = vec2(atan(v.z, v.x), asin(v.y));
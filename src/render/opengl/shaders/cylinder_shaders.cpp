@@ -203,6 +203,298 @@ R"(
 )"
 };
 
+// Cylinders along the indexed edges of a polyline strip, from node positions which are uploaded once and shared by
+// all of the edges at a node. Each cylinder has rounded ends, so the joints at bends are closed without drawing a
+// sphere at the node.
+const ShaderStageSpecification FLEX_CYLINDER_STRIP_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    // uniforms
+    {
+        {"u_modelView", DataType::Matrix44Float},
+    }, 
+
+    // attributes
+    {
+        {"a_position", DataType::Vector3Float},
+    },
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        in vec3 a_position;
+        uniform mat4 u_modelView;
+        
+        ${ VERT_DECLARATIONS }$
+        
+        void main()
+        {
+            gl_Position = u_modelView * vec4(a_position, 1.0);
+
+            ${ VERT_ASSIGNMENTS }$
+        }
+)"
+};
+
+const ShaderStageSpecification FLEX_CAPSULE_GEOM_SHADER = {
+    
+    ShaderStageType::Geometry,
+    
+    // uniforms
+    {
+        {"u_projMatrix", DataType::Matrix44Float},
+        {"u_radius", DataType::Float},
+    }, 
+
+    // attributes
+    {
+    },
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        layout(lines) in;
+        layout(triangle_strip, max_vertices=14) out;
+        uniform mat4 u_projMatrix;
+        uniform float u_radius;
+        out vec3 tipView;
+        out vec3 tailView;
+
+        ${ GEOM_DECLARATIONS }$
+
+        void buildTangentBasis(vec3 unitNormal, out vec3 basisX, out vec3 basisY);
+
+        void main() {
+
+            // Build an orthogonal basis
+            vec3 tailViewVal = gl_in[0].gl_Position.xyz / gl_in[0].gl_Position.w;
+            vec3 tipViewVal = gl_in[1].gl_Position.xyz / gl_in[1].gl_Position.w;
+            vec3 cylDir = normalize(tipViewVal - tailViewVal);
+            vec3 basisX; vec3 basisY; buildTangentBasis(cylDir, basisX, basisY);
+  
+            // Compute corners of cube, which reaches past the ends by the radius to hold the rounded ends
+            vec4 tailProj = u_projMatrix * vec4(tailViewVal - cylDir * u_radius, 1.);
+            vec4 tipProj = u_projMatrix * vec4(tipViewVal + cylDir * u_radius, 1.);
+            vec4 dx = u_projMatrix * vec4(basisX * u_radius, 0.);
+            vec4 dy = u_projMatrix * vec4(basisY * u_radius, 0.);
+
+            vec4 p1 = tailProj - dx - dy;
+            vec4 p2 = tailProj + dx - dy;
+            vec4 p3 = tailProj - dx + dy;
+            vec4 p4 = tailProj + dx + dy;
+            vec4 p5 = tipProj - dx - dy;
+            vec4 p6 = tipProj + dx - dy;
+            vec4 p7 = tipProj - dx + dy;
+            vec4 p8 = tipProj + dx + dy;
+    
+            // Emit the vertices as a triangle strip
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p7; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p8; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p5; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p6; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p2; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p8; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p4; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p7; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p3; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p5; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p1; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p2; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p3; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = p4; EmitVertex();
+    
+            EndPrimitive();
+
+        }
+
+)"
+};
+
+const ShaderStageSpecification FLEX_CAPSULE_FRAG_SHADER = {
+    
+    ShaderStageType::Fragment,
+    
+    // uniforms
+    {
+        {"u_projMatrix", DataType::Matrix44Float},
+        {"u_invProjMatrix", DataType::Matrix44Float},
+        {"u_viewport", DataType::Vector4Float},
+        {"u_radius", DataType::Float},
+    }, 
+
+    { }, // attributes
+    
+    // textures 
+    {
+    },
+ 
+    // source
+R"(
+        ${ GLSL_VERSION }$
+        uniform mat4 u_projMatrix; 
+        uniform mat4 u_invProjMatrix;
+        uniform vec4 u_viewport;
+        uniform float u_radius;
+        in vec3 tailView;
+        in vec3 tipView;
+        layout(location = 0) out vec4 outputF;
+
+        float LARGE_FLOAT();
+        vec3 fragmentViewPosition(vec4 viewport, vec2 depthRange, mat4 invProjMat, vec4 fragCoord);
+        bool rayCylinderIntersection(vec3 rayStart, vec3 rayDir, vec3 cylTail, vec3 cylTip, float cylRad, out float tHit, out vec3 pHit, out vec3 nHit);
+        bool raySphereIntersection(vec3 rayStart, vec3 rayDir, vec3 sphereCenter, float sphereRad, out float tHit, out vec3 pHit, out vec3 nHit);
+        float fragDepthFromView(mat4 projMat, vec2 depthRange, vec3 viewPoint);
+        
+        ${ FRAG_DECLARATIONS }$
+
+        void main()
+        {
+           // Build a ray corresponding to this fragment
+           vec2 depthRange = vec2(gl_DepthRange.near, gl_DepthRange.far);
+           vec3 viewRay = fragmentViewPosition(u_viewport, depthRange, u_invProjMatrix, gl_FragCoord);
+
+           // Raycast to the cylinder, and to the spheres which round off either end
+           float tHit;
+           vec3 pHit;
+           vec3 nHit;
+           rayCylinderIntersection(vec3(0., 0., 0), viewRay, tailView, tipView, u_radius, tHit, pHit, nHit);
+           for(int iEnd = 0; iEnd < 2; iEnd++) {
+             float tEnd;
+             vec3 pEnd;
+             vec3 nEnd;
+             raySphereIntersection(vec3(0., 0., 0), viewRay, iEnd == 0 ? tailView : tipView, u_radius, tEnd, pEnd, nEnd);
+             if(tEnd < tHit) {
+               tHit = tEnd;
+               pHit = pEnd;
+               nHit = nEnd;
+             }
+           }
+           if(tHit >= LARGE_FLOAT()) {
+              discard;
+           }
+           float depth = fragDepthFromView(u_projMatrix, depthRange, pHit);
+
+           ${ GLOBAL_FRAGMENT_FILTER_PREP }$
+           ${ GLOBAL_FRAGMENT_FILTER }$
+           
+           // Set depth (expensive!)
+           gl_FragDepth = depth;
+          
+           // Shading
+           ${ GENERATE_SHADE_VALUE }$
+           ${ GENERATE_SHADE_COLOR }$
+
+           // Lighting
+           vec3 shadeNormal = nHit;
+           ${ GENERATE_LIT_COLOR }$
+
+           // Set alpha
+           float alphaOut = 1.0;
+           ${ GENERATE_ALPHA }$
+
+           // Write output
+           outputF = vec4(litColor, alphaOut);
+        }
+)"
+};
+
+// One-pixel lines along the indexed edges of a polyline strip, for networks too dense to draw as tubes. They are lit
+// as if they faced the camera.
+const ShaderStageSpecification FLEX_LINE_STRIP_GEOM_SHADER = {
+    
+    ShaderStageType::Geometry,
+    
+    // uniforms
+    {
+        {"u_projMatrix", DataType::Matrix44Float},
+    }, 
+
+    // attributes
+    {
+    },
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        layout(lines) in;
+        layout(line_strip, max_vertices=2) out;
+        uniform mat4 u_projMatrix;
+        flat out vec3 tipView;
+        flat out vec3 tailView;
+
+        ${ GEOM_DECLARATIONS }$
+
+        void main() {
+            vec3 tailViewVal = gl_in[0].gl_Position.xyz / gl_in[0].gl_Position.w;
+            vec3 tipViewVal = gl_in[1].gl_Position.xyz / gl_in[1].gl_Position.w;
+
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = u_projMatrix * gl_in[0].gl_Position; EmitVertex(); 
+            ${ GEOM_PER_EMIT }$ tailView = tailViewVal; tipView = tipViewVal; gl_Position = u_projMatrix * gl_in[1].gl_Position; EmitVertex(); 
+    
+            EndPrimitive();
+        }
+
+)"
+};
+
+const ShaderStageSpecification FLEX_LINE_STRIP_FRAG_SHADER = {
+    
+    ShaderStageType::Fragment,
+    
+    // uniforms
+    {
+    }, 
+
+    { }, // attributes
+    
+    // textures 
+    {
+    },
+ 
+    // source
+R"(
+        ${ GLSL_VERSION }$
+        flat in vec3 tailView;
+        flat in vec3 tipView;
+        layout(location = 0) out vec4 outputF;
+
+        ${ FRAG_DECLARATIONS }$
+
+        void main()
+        {
+           float depth = gl_FragCoord.z;
+
+           ${ GLOBAL_FRAGMENT_FILTER_PREP }$
+           ${ GLOBAL_FRAGMENT_FILTER }$
+          
+           // Shading
+           ${ GENERATE_SHADE_VALUE }$
+           ${ GENERATE_SHADE_COLOR }$
+
+           // Lighting
+           vec3 shadeNormal = vec3(0., 0., 1.);
+           ${ GENERATE_LIT_COLOR }$
+
+           // Set alpha
+           float alphaOut = 1.0;
+           ${ GENERATE_ALPHA }$
+
+           // Write output
+           outputF = vec4(litColor, alphaOut);
+        }
+)"
+};
+
 // == Rules
 
 const ShaderReplacementRule CYLINDER_PROPAGATE_VALUE (
@@ -422,6 +714,69 @@ const ShaderReplacementRule CYLINDER_PROPAGATE_PICK (
 );
 
 
+// the same, with the pick colors computed from the edge index and the node indices of its ends
+const ShaderReplacementRule CYLINDER_PROPAGATE_PICK_ID (
+    /* rule name */ "CYLINDER_PROPAGATE_PICK_ID",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          uniform vec3 u_pickStart;
+          uniform vec3 u_edgePickStart;
+          in uint a_tailInd;
+          in uint a_tipInd;
+          out vec3 a_colorTailToGeom;
+          out vec3 a_colorTipToGeom;
+          out vec3 a_colorEdgeToGeom;
+          vec3 pickIndexColor(vec3 start, uint offset);
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_colorTailToGeom = pickIndexColor(u_pickStart, a_tailInd);
+          a_colorTipToGeom = pickIndexColor(u_pickStart, a_tipInd);
+          a_colorEdgeToGeom = pickIndexColor(u_edgePickStart, uint(gl_VertexID));
+        )"},
+      {"GEOM_DECLARATIONS", R"(
+          in vec3 a_colorTailToGeom[];
+          in vec3 a_colorTipToGeom[];
+          in vec3 a_colorEdgeToGeom[];
+          flat out vec3 a_colorTailToFrag;
+          flat out vec3 a_colorTipToFrag;
+          flat out vec3 a_colorEdgeToFrag;
+        )"},
+      {"GEOM_PER_EMIT", R"(
+          a_colorTailToFrag = a_colorTailToGeom[0]; 
+          a_colorTipToFrag = a_colorTipToGeom[0]; 
+          a_colorEdgeToFrag = a_colorEdgeToGeom[0]; 
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          flat in vec3 a_colorTailToFrag;
+          flat in vec3 a_colorTipToFrag;
+          flat in vec3 a_colorEdgeToFrag;
+          float length2(vec3 x);
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float tEdge = dot(pHit - tailView, tipView - tailView) / length2(tipView - tailView);
+          float endWidth = 0.2;
+          vec3 shadeColor;
+          if(tEdge < endWidth) {
+            shadeColor = a_colorTailToFrag;
+          } else if (tEdge < (1.0f - endWidth)) {
+            shadeColor = a_colorEdgeToFrag;
+          } else {
+            shadeColor = a_colorTipToFrag;
+          }
+        )"},
+    },
+    /* uniforms */ {
+      {"u_pickStart", DataType::Vector3Float},
+      {"u_edgePickStart", DataType::Vector3Float},
+    },
+    /* attributes */ {
+      {"a_tailInd", DataType::UInt},
+      {"a_tipInd", DataType::UInt},
+    },
+    /* textures */ {}
+);
+
+
 // clang-format on
 
 } // namespace backend_openGL3_glfw
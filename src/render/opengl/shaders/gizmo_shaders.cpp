@@ -276,6 +276,63 @@ R"(
 };
 
 
+const ShaderStageSpecification OCCLUSION_BOX_VERT_SHADER = {
+  // A world-space box, from the corners of a unit cube, for occlusion queries (see Engine::testBoxVisibility())
+
+    ShaderStageType::Vertex,
+
+    // uniforms
+    {
+        {"u_viewMatrix", DataType::Matrix44Float},
+        {"u_projMatrix", DataType::Matrix44Float},
+        {"u_boxMin", DataType::Vector3Float},
+        {"u_boxMax", DataType::Vector3Float},
+    },
+
+    // attributes
+    {
+        {"a_position", DataType::Vector3Float},
+    },
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        uniform mat4 u_viewMatrix;
+        uniform mat4 u_projMatrix;
+        uniform vec3 u_boxMin;
+        uniform vec3 u_boxMax;
+        in vec3 a_position;
+
+        void main()
+        {
+            gl_Position = u_projMatrix * u_viewMatrix * vec4(mix(u_boxMin, u_boxMax, a_position), 1.);
+        }
+)"
+};
+
+const ShaderStageSpecification OCCLUSION_BOX_FRAG_SHADER = {
+
+    ShaderStageType::Fragment,
+
+    {}, // uniforms
+    {}, // attributes
+    {}, // textures
+
+    // source (the color is masked off, only the samples which pass the depth test matter)
+R"(
+        ${ GLSL_VERSION }$
+        layout(location = 0) out vec4 outputF;
+
+        void main()
+        {
+            outputF = vec4(0., 0., 0., 0.);
+        }
+)"
+};
+
 // clang-format on
 
 } // namespace backend_openGL3_glfw
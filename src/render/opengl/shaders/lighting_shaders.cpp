@@ -52,6 +52,12 @@ R"(
           return sampleVal;
       }
 
+      // approximate perceptual luminance, for finding edges
+      float sampleLuma(vec2 tCoord) {
+          vec3 color = clamp(sampleSingle(tCoord).rgb * u_exposure, 0., 1.);
+          return sqrt(dot(color, vec3(0.299, 0.587, 0.114)));
+      }
+
       vec4 imageSample() {
   
         // This function is written like this to hopefully make it as easy as possible to unroll
@@ -159,6 +165,68 @@ const ShaderReplacementRule DOWNSAMPLE_RESOLVE_4 (
 );
 
 
+const ShaderReplacementRule DOWNSAMPLE_RESOLVE_SCALED (
+    // Any ratio of scene to display pixels, from dynamic resolution: average a grid of bilinear taps over the footprint
+    // of the display pixel, which is u_sampleRatio scene pixels across (less than one when magnifying)
+    /* rule name */ "DOWNSAMPLE_RESOLVE_SCALED",
+    { /* replacement sources */
+      {"DOWNSAMPLE_RESOLVE", R"(
+          int downsampleFactor = int(clamp(ceil(max(u_sampleRatio.x, u_sampleRatio.y)), 1., 4.));
+          vec2 footprint = u_sampleRatio * u_texelSize;
+          for(int i = 0; i < downsampleFactor; i++) {
+            for(int j = 0; j < downsampleFactor; j++) {
+              vec2 tapCoord = tCoord + ((vec2(i, j) + 0.5) / float(downsampleFactor) - 0.5) * footprint;
+              vec2 texelPos = tapCoord / u_texelSize - 0.5;
+              vec2 w = fract(texelPos);
+              vec2 coord00 = (floor(texelPos) + 0.5) * u_texelSize;
+              vec4 row0 = mix(sampleSingle(coord00), sampleSingle(coord00 + vec2(u_texelSize.x, 0.)), w.x);
+              vec4 row1 = mix(sampleSingle(coord00 + vec2(0., u_texelSize.y)), sampleSingle(coord00 + u_texelSize), w.x);
+              result += mix(row0, row1, w.y);
+            }
+          }
+        )"},
+    },
+    /* uniforms */ {
+      {"u_sampleRatio", DataType::Vector2Float},
+    },
+    /* attributes */ {},
+    /* textures */ {}
+);
+
+const ShaderReplacementRule DOWNSAMPLE_RESOLVE_FXAA (
+    // No downsampling, but blend across edges along their direction, estimated from the luminance of the corners
+    // (after the FXAA 'console' variant by T. Lottes)
+    /* rule name */ "DOWNSAMPLE_RESOLVE_FXAA",
+    { /* replacement sources */
+      {"DOWNSAMPLE_RESOLVE", R"(
+          float lumaNW = sampleLuma(tCoord + vec2(-1., -1.) * u_texelSize);
+          float lumaNE = sampleLuma(tCoord + vec2(1., -1.) * u_texelSize);
+          float lumaSW = sampleLuma(tCoord + vec2(-1., 1.) * u_texelSize);
+          float lumaSE = sampleLuma(tCoord + vec2(1., 1.) * u_texelSize);
+          float lumaM = sampleLuma(tCoord);
+          float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+          float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+          vec2 edgeDir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+          float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 / 8.), 1. / 128.);
+          float dirScale = 1. / (min(abs(edgeDir.x), abs(edgeDir.y)) + dirReduce);
+          edgeDir = clamp(edgeDir * dirScale, vec2(-8., -8.), vec2(8., 8.)) * u_texelSize;
+
+          vec4 resultA = 0.5 * (sampleSingle(tCoord + edgeDir * (1. / 3. - 0.5)) +
+                                sampleSingle(tCoord + edgeDir * (2. / 3. - 0.5)));
+          vec4 resultB = 0.5 * resultA + 0.25 * (sampleSingle(tCoord - 0.5 * edgeDir) +
+                                                 sampleSingle(tCoord + 0.5 * edgeDir));
+          float lumaB = sqrt(dot(clamp(resultB.rgb * u_exposure, 0., 1.), vec3(0.299, 0.587, 0.114)));
+          result = (lumaB < lumaMin || lumaB > lumaMax) ? resultA : resultB;
+          int downsampleFactor = 1;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {}
+);
+
+
 const ShaderReplacementRule TRANSPARENCY_RESOLVE_SIMPLE (
     /* rule name */ "TRANSPARENCY_RESOLVE_SIMPLE ",
     { /* replacement sources */
@@ -190,6 +258,33 @@ const ShaderReplacementRule TRANSPARENCY_STRUCTURE (
     /* textures */ {}
 );
 
+const ShaderReplacementRule TRANSPARENCY_WEIGHTED_STRUCTURE (
+    /* rule name */ "TRANSPARENCY_WEIGHTED_STRUCTURE",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform float u_transparency;
+          layout(location = 1) out vec4 outputRevealage;
+        )"},
+      {"GENERATE_ALPHA", R"(
+          // assumption: "float depth" must be already set 
+          // (use float depth = gl_FragCoord.z; if not doing anything special)
+          alphaOut = u_transparency;
+
+          // log-space revealage, so the purely additive blend still accumulates a product of (1 - alpha)
+          outputRevealage = vec4(-log(max(1. - alphaOut, 1e-4)), 0., 0., 1.);
+
+          // depth-based weight, nearer fragments dominate the normalized color (McGuire & Bavoil 2013, eq. 9)
+          float oitWeight = clamp(3e3 * pow(1. - depth, 3.), 1e-2, 3e3);
+          alphaOut = alphaOut * oitWeight;
+        )"},
+    },
+    /* uniforms */ {
+        {"u_transparency", DataType::Float},
+    },
+    /* attributes */ {},
+    /* textures */ {}
+);
+
 const ShaderReplacementRule TRANSPARENCY_PEEL_STRUCTURE (
     /* rule name */ "TRANSPARENCY_PEEL_STRUCTURE",
     { /* replacement sources */
@@ -244,6 +339,44 @@ const ShaderReplacementRule TRANSPARENCY_PEEL_GROUND (
     }
 );
 
+// Two-pass drawing of the expensive ray-cast impostors (see options::impostorDepthPrepass). With u_depthPrepass = 1 the
+// program only writes depth, skipping shading and lighting. With u_depthPrepass = 2, fragments behind the depth written
+// by the first pass (copied to t_prepassDepth) are discarded before they are shaded. 0 draws as usual.
+const ShaderReplacementRule IMPOSTOR_DEPTH_PREPASS (
+    /* rule name */ "IMPOSTOR_DEPTH_PREPASS",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform int u_depthPrepass;
+          uniform sampler2D t_prepassDepth;
+          uniform vec2 u_prepassViewportDim;
+        )"},
+      {"GLOBAL_FRAGMENT_FILTER", R"(
+          // assumption: "float depth" must be already set 
+          if(u_depthPrepass == 2) {
+            float prepassDepth = texture(t_prepassDepth, gl_FragCoord.xy / u_prepassViewportDim).x;
+            if(depth > prepassDepth+1e-6) {
+              discard;
+            }
+          }
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          // (after all fragment filters, and after gl_FragDepth is set)
+          if(u_depthPrepass == 1) {
+            outputF = vec4(0.);
+            return;
+          }
+        )"},
+    },
+    /* uniforms */ {
+        {"u_depthPrepass", DataType::Int},
+        {"u_prepassViewportDim", DataType::Vector2Float},
+    },
+    /* attributes */ {},
+    /* textures */ {
+        {"t_prepassDepth", 2},
+    }
+);
+
 // clang-format on
 
 } // namespace backend_openGL3_glfw
@@ -12,12 +12,15 @@ const ShaderStageSpecification RIBBON_VERT_SHADER = {
 
     ShaderStageType::Vertex,
 
-    { }, // uniforms
+    // uniforms
+    {
+        {"u_normalOffset", DataType::Float},
+    },
 
     // attributes
     {
         {"a_position", DataType::Vector3Float},
-        {"a_color", DataType::Vector3Float},
+        {"a_colorval", DataType::Float},
         {"a_normal", DataType::Vector3Float},
     },
     
@@ -28,15 +31,16 @@ R"(
        ${ GLSL_VERSION }$
 
         in vec3 a_position;
-        in vec3 a_color;
+        in float a_colorval;
         in vec3 a_normal;
-        out vec3 Color;
+        uniform float u_normalOffset;
+        out float Colorval;
         out vec3 Normal;
         void main()
         {
-            Color = a_color;
+            Colorval = a_colorval;
             Normal = a_normal;
-            gl_Position = vec4(a_position,1.0);
+            gl_Position = vec4(a_position + u_normalOffset * a_normal, 1.0);
         }
 )"
 };
@@ -66,13 +70,13 @@ R"(
 
         layout(lines_adjacency) in;
         layout(triangle_strip, max_vertices=20) out;
-        in vec3 Color[];
+        in float Colorval[];
         in vec3 Normal[];
         uniform mat4 u_modelView;
         uniform mat4 u_projMatrix;
         uniform float u_ribbonWidth;
         uniform float u_depthOffset;
-        out vec3 colorToFrag;
+        out float colorvalToFrag;
         out vec3 cameraNormalToFrag;
         out float intensityToFrag;
         void main()   {
@@ -101,21 +105,21 @@ R"(
             gl_Position = PV * pStartRight;
             gl_Position.z -= u_depthOffset;
             cameraNormalToFrag = mat3(u_modelView) * Normal[1];
-            colorToFrag = Color[1];
+            colorvalToFrag = Colorval[1];
             intensityToFrag = 0.0;
             EmitVertex();
             
             gl_Position = PV * pEndRight;
             gl_Position.z -= u_depthOffset;
             cameraNormalToFrag = mat3(u_modelView) * Normal[2];
-            colorToFrag = Color[2];
+            colorvalToFrag = Colorval[2];
             intensityToFrag = 0.0;
             EmitVertex();
             
             gl_Position = PV * pStartMid;
             gl_Position.z -= u_depthOffset;
             cameraNormalToFrag = mat3(u_modelView) * Normal[1];
-            colorToFrag = Color[1];
+            colorvalToFrag = Colorval[1];
             intensityToFrag = 1.0;
             EmitVertex();
 
@@ -123,7 +127,7 @@ R"(
             gl_Position = PV * pEndMid;
             gl_Position.z -= u_depthOffset;
             cameraNormalToFrag = mat3(u_modelView) * Normal[2];
-            colorToFrag = Color[2];
+            colorvalToFrag = Colorval[2];
             intensityToFrag = 1.0;
             EmitVertex();
 
@@ -131,7 +135,7 @@ R"(
             gl_Position = PV * pStartLeft;
             gl_Position.z -= u_depthOffset;
             cameraNormalToFrag = mat3(u_modelView) * Normal[1];
-            colorToFrag = Color[1];
+            colorvalToFrag = Colorval[1];
             intensityToFrag = 0.0;
             EmitVertex();
 
@@ -139,7 +143,7 @@ R"(
             gl_Position = PV * pEndLeft;
             gl_Position.z -= u_depthOffset;
             cameraNormalToFrag = mat3(u_modelView) * Normal[2];
-            colorToFrag = Color[2];
+            colorvalToFrag = Colorval[2];
             intensityToFrag = 0.0;
             EmitVertex();
 
@@ -157,13 +161,18 @@ const ShaderStageSpecification RIBBON_FRAG_SHADER = {
     
     {}, // uniforms
     {}, // attributes
-    {}, // textures 
+
+    // textures 
+    {
+        {"t_colormap", 1},
+    },
  
     // source
 R"(
         ${ GLSL_VERSION }$
 
-        in vec3 colorToFrag;
+        uniform sampler1D t_colormap;
+        in float colorvalToFrag;
         in vec3 cameraNormalToFrag;
         in float intensityToFrag;
         layout(location = 0) out vec4 outputF;
@@ -183,7 +192,7 @@ R"(
            float thresh = min(dF * screenFadeLen, 0.2);
            float fadeFactor = smoothstep(0, thresh, intensityToFrag);
 
-           vec3 albedoColor = colorToFrag;
+           vec3 albedoColor = texture(t_colormap, colorvalToFrag).rgb;
            vec3 shadeNormal = cameraNormalToFrag;
            
            // Lighting
@@ -52,6 +52,48 @@ const ShaderReplacementRule LIGHT_MATCAP (
     }
 );
 
+// light using a matcap texture as LIGHT_MATCAP, or with u_deferredShading = 1 write the unlit color and a G-buffer of
+// (octahedral normal, material index + 1) to be lit later by DEFERRED_LIGHTING (see Engine::resolveDeferredShading())
+// input: vec3 albedoColor;
+// output: vec3 litColor after lighting
+const ShaderReplacementRule LIGHT_DEFERRED (
+    /* rule name */ "LIGHT_DEFERRED",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform sampler2D t_mat_r;
+          uniform sampler2D t_mat_g;
+          uniform sampler2D t_mat_b;
+          uniform sampler2D t_mat_k;
+          uniform int u_deferredShading;
+          uniform float u_materialIndex;
+          layout(location = 1) out vec4 outputGBuffer;
+          vec3 lightSurfaceMat(vec3 normal, vec3 color, sampler2D t_mat_r, sampler2D t_mat_g, sampler2D t_mat_b, sampler2D t_mat_k);
+          vec2 octahedralEncode(vec3 n);
+        )"},
+      {"GENERATE_LIT_COLOR", R"(
+          vec3 litColor;
+          if(u_deferredShading == 1) {
+            litColor = clamp(albedoColor, vec3(0.), vec3(1.));
+            outputGBuffer = vec4(octahedralEncode(normalize(shadeNormal)), u_materialIndex + 1., 1.);
+          } else {
+            litColor = lightSurfaceMat(shadeNormal, albedoColor, t_mat_r, t_mat_g, t_mat_b, t_mat_k);
+            outputGBuffer = vec4(0.);
+          }
+      )"}
+    },
+    /* uniforms */ {
+      {"u_deferredShading", DataType::Int},
+      {"u_materialIndex", DataType::Float},
+    },
+    /* attributes */ {},
+    /* textures */ {
+      {"t_mat_r", 2},
+      {"t_mat_g", 2},
+      {"t_mat_b", 2},
+      {"t_mat_k", 2},
+    }
+);
+
 // "light" by just copying the value 
 // input: vec3 albedoColor;
 // output: vec3 litColor after lighting
@@ -242,6 +284,27 @@ const ShaderReplacementRule ISOLINE_STRIPE_VALUECOLOR (
     /* textures */ {}
 );
 
+// For sparse values (see SparseElementSet), after the rules which color the values: the propagate rule also defines
+// shadePresence, 1 on elements with a value and 0 on the others, and the others take u_absentColor
+const ShaderReplacementRule SHADE_SPARSE_ABSENT_COLOR (
+    /* rule name */ "SHADE_SPARSE_ABSENT_COLOR",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform vec3 u_absentColor;
+        )"},
+      {"GENERATE_SHADE_COLOR", R"(
+        if(!(shadePresence >= 0.5)) {
+          albedoColor = u_absentColor;
+        }
+      )"}
+    },
+    /* uniforms */ {
+        {"u_absentColor", DataType::Vector3Float},
+    },
+    /* attributes */ {},
+    /* textures */ {}
+);
+
 const ShaderReplacementRule CHECKER_VALUE2COLOR (
     /* rule name */ "CHECKER_VALUE2COLOR",
     { /* replacement sources */
@@ -309,23 +372,35 @@ const ShaderReplacementRule CULL_POS_FROM_VIEW (
 );
 
 
-ShaderReplacementRule generateSlicePlaneRule(std::string uniquePostfix) {
+ShaderReplacementRule generateSlicePlaneRule() {
 
-  std::string centerUniformName = "u_slicePlaneCenter_" + uniquePostfix;
-  std::string normalUniformName = "u_slicePlaneNormal_" + uniquePostfix;
+  // One rule handles every slice plane in the scene. Each plane is a view-space (normal, dot(center, normal)) entry in
+  // a uniform array, so adding, moving, or ignoring planes only changes uniforms. Array entries are registered as
+  // individual uniforms, since that is what the program interface knows how to set.
+  std::vector<ShaderSpecUniform> uniforms = {
+    {"u_slicePlaneCount", DataType::Int},
+    {"u_slicePlaneIgnoreMask", DataType::UInt},
+  };
+  for (int i = 0; i < MAX_SLICE_PLANES; i++) {
+    uniforms.push_back({"u_slicePlanes[" + std::to_string(i) + "]", DataType::Vector4Float});
+  }
 
-  // This takes what is otherwise a simple rule, and substitues uniquely named uniforms so that we can have multiple slice planes
   ShaderReplacementRule slicePlaneRule (
-      /* rule name */ "SLICE_PLANE_CULL_" + uniquePostfix,
+      /* rule name */ "SLICE_PLANE_CULL",
       { /* replacement sources */
-        {"FRAG_DECLARATIONS", "uniform vec3 " + centerUniformName + "; uniform vec3 " + normalUniformName + ";"},
-        {"GLOBAL_FRAGMENT_FILTER", 
-         "if(dot(cullPos, " + normalUniformName + ") < dot( " + centerUniformName + " , " + normalUniformName + ")) { discard; }"}
-      },
-      /* uniforms */ {
-        {centerUniformName, DataType::Vector3Float},
-        {normalUniformName, DataType::Vector3Float},
+        {"FRAG_DECLARATIONS", R"(
+          uniform int u_slicePlaneCount;
+          uniform uint u_slicePlaneIgnoreMask;
+          uniform vec4 u_slicePlanes[)" + std::to_string(MAX_SLICE_PLANES) + R"(];
+        )"},
+        {"GLOBAL_FRAGMENT_FILTER", R"(
+          for(int iPlane = 0; iPlane < u_slicePlaneCount; iPlane++) {
+            if((u_slicePlaneIgnoreMask & (1u << uint(iPlane))) != 0u) continue;
+            if(dot(cullPos, u_slicePlanes[iPlane].xyz) < u_slicePlanes[iPlane].w) { discard; }
+          }
+        )"}
       },
+      /* uniforms */ uniforms,
       /* attributes */ {},
       /* textures */ {}
   );
@@ -34,7 +34,9 @@ R"(
         
         void main()
         {
-            gl_Position = u_modelView * vec4(a_position, 1.0);
+            vec3 pointPosition = a_position;
+            ${ SPHERE_SET_POSITION_VERT }$
+            gl_Position = u_modelView * vec4(pointPosition, 1.0);
 
             ${ VERT_ASSIGNMENTS }$
         }
@@ -219,7 +221,9 @@ R"(
         
         void main()
         {
-            gl_Position = u_modelView * vec4(a_position, 1.0);
+            vec3 pointPosition = a_position;
+            ${ SPHERE_SET_POSITION_VERT }$
+            gl_Position = u_modelView * vec4(pointPosition, 1.0);
 
             ${ VERT_ASSIGNMENTS }$
         }
@@ -349,17 +353,635 @@ R"(
 };
 
 
+//  These INSTANCED variants replace the geometry shaders above with a 4-vertex triangle strip drawn once per point
+//  (DrawMode::InstancedQuads). The point's attributes are per-instance, and the vertex shader expands the strip
+//  into the same camera-facing billboard the geometry shader would have emitted. They are used with the *_INSTANCED
+//  rules below, which pass values straight from the vertex to the fragment stage.
+
+const ShaderStageSpecification FLEX_SPHERE_INSTANCED_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    // uniforms
+    {
+        {"u_modelView", DataType::Matrix44Float},
+        {"u_projMatrix", DataType::Matrix44Float},
+        {"u_pointRadius", DataType::Float},
+    }, 
+
+    // attributes
+    {
+        {"a_position", DataType::Vector3Float},
+    },
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        in vec3 a_position;
+        uniform mat4 u_modelView;
+        uniform mat4 u_projMatrix;
+        uniform float u_pointRadius;
+        out vec3 sphereCenterView;
+        
+        ${ VERT_DECLARATIONS }$
+
+        void buildTangentBasis(vec3 unitNormal, out vec3 basisX, out vec3 basisY);
+        
+        void main()
+        {
+            vec3 pointPosition = a_position;
+            ${ SPHERE_SET_POSITION_VERT }$
+            vec4 centerView = u_modelView * vec4(pointPosition, 1.0);
+
+            float pointRadius = u_pointRadius;
+            ${ SPHERE_SET_POINT_RADIUS_VERT }$
+
+            // Corner of the billboard quad for this vertex of the strip, in {-1,1}^2
+            vec2 corner = 2. * vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) - 1.;
+            
+            // Quad is shifted pointRadius toward the camera, otherwise it doesn't actually necessarily
+            // cover the full sphere due to perspective.
+            vec3 dirToCam = normalize(-centerView.xyz);
+            vec3 basisX;
+            vec3 basisY;
+            buildTangentBasis(dirToCam, basisX, basisY);
+            vec3 offset = dirToCam + corner.x * basisX + corner.y * basisY;
+            gl_Position = u_projMatrix * (centerView + vec4(offset, 0.) * pointRadius);
+            sphereCenterView = centerView.xyz / centerView.w;
+
+            uint pointIndex = uint(gl_InstanceID);
+            ${ VERT_ASSIGNMENTS }$
+        }
+)"
+};
+
+const ShaderStageSpecification FLEX_POINTQUAD_INSTANCED_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    // uniforms
+    {
+        {"u_modelView", DataType::Matrix44Float},
+        {"u_projMatrix", DataType::Matrix44Float},
+        {"u_pointRadius", DataType::Float},
+    }, 
+
+    // attributes
+    {
+        {"a_position", DataType::Vector3Float},
+    },
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        in vec3 a_position;
+        uniform mat4 u_modelView;
+        uniform mat4 u_projMatrix;
+        uniform float u_pointRadius;
+        
+        ${ VERT_DECLARATIONS }$
+
+        void buildTangentBasis(vec3 unitNormal, out vec3 basisX, out vec3 basisY);
+        
+        void main()
+        {
+            vec3 pointPosition = a_position;
+            ${ SPHERE_SET_POSITION_VERT }$
+            vec4 centerView = u_modelView * vec4(pointPosition, 1.0);
+
+            float pointRadius = u_pointRadius;
+            ${ SPHERE_SET_POINT_RADIUS_VERT }$
+
+            // Corner of the billboard quad for this vertex of the strip, in {-1,1}^2
+            vec2 corner = 2. * vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) - 1.;
+            
+            vec3 dirToCam = normalize(-centerView.xyz);
+            vec3 basisX;
+            vec3 basisY;
+            buildTangentBasis(dirToCam, basisX, basisY);
+            vec3 offset = corner.x * basisX + corner.y * basisY;
+            gl_Position = u_projMatrix * (centerView + vec4(offset, 0.) * pointRadius);
+
+            uint pointIndex = uint(gl_InstanceID);
+            ${ VERT_ASSIGNMENTS }$
+        }
+)"
+};
+
+//  The POINTSPLAT shader draws each point as a single GL_POINTS vertex, rasterized as a square of a fixed size in
+//  pixels (u_pointSplatSize, scaled by any variable radius). There is no geometry stage and no per-fragment
+//  intersection, so it is the cheapest way to draw very large clouds; it shares the *_INSTANCED rules and the
+//  POINTQUAD fragment shader, and is usually paired with the eye-dome lighting pass to recover shape cues.
+
+const ShaderStageSpecification FLEX_POINTSPLAT_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    // uniforms
+    {
+        {"u_modelView", DataType::Matrix44Float},
+        {"u_projMatrix", DataType::Matrix44Float},
+        {"u_pointSplatSize", DataType::Float},
+    }, 
+
+    // attributes
+    {
+        {"a_position", DataType::Vector3Float},
+    },
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        in vec3 a_position;
+        uniform mat4 u_modelView;
+        uniform mat4 u_projMatrix;
+        uniform float u_pointSplatSize;
+        
+        ${ VERT_DECLARATIONS }$
+        
+        void main()
+        {
+            vec3 pointPosition = a_position;
+            ${ SPHERE_SET_POSITION_VERT }$
+            vec4 centerView = u_modelView * vec4(pointPosition, 1.0);
+            gl_Position = u_projMatrix * centerView;
+
+            float pointRadius = 1.;
+            ${ SPHERE_SET_POINT_RADIUS_VERT }$
+            gl_PointSize = max(u_pointSplatSize * pointRadius, 1.);
+
+            uint pointIndex = uint(gl_VertexID);
+            ${ VERT_ASSIGNMENTS }$
+        }
+)"
+};
+
+
+//  These draw every point in to the same single pixel, to reduce a per-point value computed by the *_INSTANCED rules
+//  (GENERATE_SHADE_VALUE) over the whole cloud: with BlendMode::Max, the pixel ends up holding (max, -min) of the
+//  finite values. See Engine::reduceMinMax().
+
+const ShaderStageSpecification POINT_REDUCE_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    { }, // uniforms
+
+    { }, // attributes
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        ${ VERT_DECLARATIONS }$
+        
+        void main()
+        {
+            gl_Position = vec4(0., 0., 0., 1.);
+            gl_PointSize = 1.;
+
+            uint pointIndex = uint(gl_VertexID);
+            ${ VERT_ASSIGNMENTS }$
+        }
+)"
+};
+
+const ShaderStageSpecification REDUCE_MINMAX_FRAG_SHADER = {
+    
+    ShaderStageType::Fragment,
+    
+    { }, // uniforms
+
+    { }, // attributes
+    
+    { }, // textures
+ 
+    // source
+R"(
+        ${ GLSL_VERSION }$
+        layout(location = 0) out vec4 outputF;
+
+        ${ FRAG_DECLARATIONS }$
+
+        void main()
+        {
+           ${ GENERATE_SHADE_VALUE }$
+           if(isnan(shadeValue) || isinf(shadeValue)) discard;
+           outputF = vec4(shadeValue, -shadeValue, 0., 1.);
+        }
+)"
+};
+
+// Draws each point in to the first of two pixels with u_reduceSign = 1, and in to the second negated with
+// u_reduceSign = -1, see Engine::reduceBoundsAsync(). The REDUCE_* rules compute the value.
+const ShaderStageSpecification POINT_REDUCE_BOUNDS_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    { // uniforms
+        {"u_reduceSign", DataType::Float},
+    },
+
+    { }, // attributes
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        uniform float u_reduceSign;
+        flat out vec3 a_reduceValueToFrag;
+        ${ VERT_DECLARATIONS }$
+
+        void main()
+        {
+            gl_Position = vec4(u_reduceSign > 0. ? -0.5 : 0.5, 0., 0., 1.);
+            gl_PointSize = 1.;
+
+            vec3 reduceValue = vec3(0., 0., 0.);
+            ${ VERT_ASSIGNMENTS }$
+            a_reduceValueToFrag = u_reduceSign * reduceValue;
+        }
+)"
+};
+
+const ShaderStageSpecification REDUCE_BOUNDS_FRAG_SHADER = {
+
+    ShaderStageType::Fragment,
+
+    { }, // uniforms
+
+    { }, // attributes
+
+    { }, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+        layout(location = 0) out vec4 outputF;
+
+        flat in vec3 a_reduceValueToFrag;
+
+        void main()
+        {
+           if(any(isnan(a_reduceValueToFrag)) || any(isinf(a_reduceValueToFrag))) discard;
+           outputF = vec4(a_reduceValueToFrag, 1.);
+        }
+)"
+};
+
 // == Rules
 
-const ShaderReplacementRule SPHERE_PROPAGATE_VALUE (
-    /* rule name */ "SPHERE_PROPAGATE_VALUE",
+const ShaderReplacementRule REDUCE_POSITION (
+    /* rule name */ "REDUCE_POSITION",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec3 a_position;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          reduceValue = a_position;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_position", DataType::Vector3Float},
+    },
+    /* textures */ {}
+);
+
+// (the largest distance is in the x component of the upper bound)
+const ShaderReplacementRule REDUCE_POSITION_DISTANCE (
+    /* rule name */ "REDUCE_POSITION_DISTANCE",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec3 a_position;
+          uniform vec3 u_reduceCenter;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          reduceValue = vec3(length(a_position - u_reduceCenter));
+        )"},
+    },
+    /* uniforms */ {
+      {"u_reduceCenter", DataType::Vector3Float},
+    },
+    /* attributes */ {
+      {"a_position", DataType::Vector3Float},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule REDUCE_SCALAR_VALUE (
+    /* rule name */ "REDUCE_SCALAR_VALUE",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_value;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          reduceValue = vec3(a_value);
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_value", DataType::Float},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_PROPAGATE_VALUE (
+    /* rule name */ "SPHERE_PROPAGATE_VALUE",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_value;
+          out float a_valueToGeom;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_valueToGeom = a_value;
+        )"},
+      {"GEOM_DECLARATIONS", R"(
+          in float a_valueToGeom[];
+          out float a_valueToFrag;
+        )"},
+      {"GEOM_PER_EMIT", R"(
+          a_valueToFrag = a_valueToGeom[0]; 
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float shadeValue = a_valueToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_value", DataType::Float},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_PROPAGATE_VALUE2 (
+    /* rule name */ "SPHERE_PROPAGATE_VALUE2",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec2 a_value2;
+          out vec2 a_value2ToGeom;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_value2ToGeom = a_value2;
+        )"},
+      {"GEOM_DECLARATIONS", R"(
+          in vec2 a_value2ToGeom[];
+          out vec2 a_value2ToFrag;
+        )"},
+      {"GEOM_PER_EMIT", R"(
+          a_value2ToFrag = a_value2ToGeom[0]; 
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in vec2 a_value2ToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          vec2 shadeValue2 = a_value2ToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_value2", DataType::Vector2Float},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_PROPAGATE_COLOR (
+    /* rule name */ "SPHERE_PROPAGATE_COLOR",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec3 a_color;
+          out vec3 a_colorToGeom;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_colorToGeom = a_color;
+        )"},
+      {"GEOM_DECLARATIONS", R"(
+          in vec3 a_colorToGeom[];
+          flat out vec3 a_colorToFrag;
+        )"},
+      {"GEOM_PER_EMIT", R"(
+          a_colorToFrag = a_colorToGeom[0]; 
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          flat in vec3 a_colorToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          vec3 shadeColor = a_colorToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_color", DataType::Vector3Float},
+    },
+    /* textures */ {}
+);
+
+// Pick colors computed from the index of each point, so the pick program needs no buffer of its own
+const ShaderReplacementRule SPHERE_PROPAGATE_PICK_ID (
+    /* rule name */ "SPHERE_PROPAGATE_PICK_ID",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          uniform vec3 u_pickStart;
+          out vec3 a_colorToGeom;
+          vec3 pickIndexColor(vec3 start, uint offset);
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_colorToGeom = pickIndexColor(u_pickStart, uint(gl_VertexID));
+        )"},
+      {"GEOM_DECLARATIONS", R"(
+          in vec3 a_colorToGeom[];
+          flat out vec3 a_colorToFrag;
+        )"},
+      {"GEOM_PER_EMIT", R"(
+          a_colorToFrag = a_colorToGeom[0]; 
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          flat in vec3 a_colorToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          vec3 shadeColor = a_colorToFrag;
+        )"},
+    },
+    /* uniforms */ {
+      {"u_pickStart", DataType::Vector3Float},
+    },
+    /* attributes */ {},
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_PICK_ID_FROM_INDEX (
+    // (after SPHERE_PROPAGATE_PICK_ID, for buffers which hold a subset of the points)
+    /* rule name */ "SPHERE_PICK_ID_FROM_INDEX",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in uint a_pickInd;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_colorToGeom = pickIndexColor(u_pickStart, a_pickInd);
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_pickInd", DataType::UInt},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_CULLPOS_FROM_CENTER(
+    /* rule name */ "SPHERE_CULLPOS_FROM_CENTER",
+    { /* replacement sources */
+      {"GLOBAL_FRAGMENT_FILTER_PREP", R"(
+          vec3 cullPos = sphereCenterView;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {}
+);
+
+// use a separate version for the quads because they don't already pass the center, and we 
+// don't want to always pass it
+const ShaderReplacementRule SPHERE_CULLPOS_FROM_CENTER_QUAD(
+    /* rule name */ "SPHERE_CULLPOS_FROM_CENTER_QUAD",
+    { /* replacement sources */
+      {"GEOM_DECLARATIONS", R"(
+          out vec3 sphereCenterView;
+        )"},
+      {"GEOM_COMPUTE_BEFORE_EMIT", R"(
+          vec3 sphereCenterViewVal = gl_in[0].gl_Position.xyz / gl_in[0].gl_Position.w;
+        )"},
+      {"GEOM_PER_EMIT", R"(
+          sphereCenterView = sphereCenterViewVal;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in vec3 sphereCenterView;
+        )"},
+      {"GLOBAL_FRAGMENT_FILTER_PREP", R"(
+          vec3 cullPos = sphereCenterView;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_VARIABLE_SIZE (
+    /* rule name */ "SPHERE_VARIABLE_SIZE",
     { /* replacement sources */
       {"VERT_DECLARATIONS", R"(
-          in float a_value;
+          in float a_pointRadius;
+          uniform float u_pointRadiusValueScale;
+          out float a_pointRadiusToGeom;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_pointRadiusToGeom = max(a_pointRadius, 0.) * u_pointRadiusValueScale;
+        )"},
+      {"GEOM_DECLARATIONS", R"(
+          in float a_pointRadiusToGeom[];
+          out float a_pointRadiusToFrag;
+        )"},
+      {"GEOM_PER_EMIT", R"(
+          a_pointRadiusToFrag = a_pointRadiusToGeom[0]; 
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_pointRadiusToFrag;
+        )"},
+      {"SPHERE_SET_POINT_RADIUS_GEOM", R"(
+          pointRadius *= a_pointRadiusToGeom[0];
+        )"},
+      {"SPHERE_SET_POINT_RADIUS_FRAG", R"(
+          pointRadius *= a_pointRadiusToFrag;
+        )"},
+    },
+    /* uniforms */ {
+      {"u_pointRadiusValueScale", DataType::Float},
+    },
+    /* attributes */ {
+      {"a_pointRadius", DataType::Float},
+    },
+    /* textures */ {}
+);
+
+// Blend between two frames of an animation (see TimeFrameBuffers)
+const ShaderReplacementRule SPHERE_POSITION_LERP (
+    /* rule name */ "SPHERE_POSITION_LERP",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec3 a_positionNext;
+          uniform float u_positionBlend;
+        )"},
+      {"SPHERE_SET_POSITION_VERT", R"(
+          pointPosition = mix(a_position, a_positionNext, u_positionBlend);
+        )"},
+    },
+    /* uniforms */ {
+      {"u_positionBlend", DataType::Float},
+    },
+    /* attributes */ {
+      {"a_positionNext", DataType::Vector3Float},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_VALUE_LERP (
+    // (after SPHERE_PROPAGATE_VALUE)
+    /* rule name */ "SPHERE_VALUE_LERP",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_valueNext;
+          uniform float u_valueBlend;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_valueToGeom = mix(a_value, a_valueNext, u_valueBlend);
+        )"},
+    },
+    /* uniforms */ {
+      {"u_valueBlend", DataType::Float},
+    },
+    /* attributes */ {
+      {"a_valueNext", DataType::Float},
+    },
+    /* textures */ {}
+);
+
+// Values read from a texture holding several channels of values per point (see PointCloudChannelsQuantity): the rows
+// of each channel start at a multiple of the same row count, and a_pointInd holds the point of each instance. The value
+// drawn is a weighted sum of two channels, so switching between channels only sets uniforms.
+const ShaderReplacementRule SPHERE_PROPAGATE_CHANNEL_VALUE (
+    /* rule name */ "SPHERE_PROPAGATE_CHANNEL_VALUE",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_pointInd;
+          uniform sampler2D t_channelValues;
+          uniform int u_channelRowA;
+          uniform int u_channelRowB;
+          uniform float u_channelWeightA;
+          uniform float u_channelWeightB;
           out float a_valueToGeom;
         )"},
       {"VERT_ASSIGNMENTS", R"(
-          a_valueToGeom = a_value;
+          int iPoint = int(a_pointInd);
+          int channelRowWidth = textureSize(t_channelValues, 0).x;
+          ivec2 pointTexel = ivec2(iPoint % channelRowWidth, iPoint / channelRowWidth);
+          float channelValueA = texelFetch(t_channelValues, pointTexel + ivec2(0, u_channelRowA), 0).r;
+          float channelValueB = texelFetch(t_channelValues, pointTexel + ivec2(0, u_channelRowB), 0).r;
+          a_valueToGeom = u_channelWeightA * channelValueA + u_channelWeightB * channelValueB;
         )"},
       {"GEOM_DECLARATIONS", R"(
           in float a_valueToGeom[];
@@ -375,29 +997,100 @@ const ShaderReplacementRule SPHERE_PROPAGATE_VALUE (
           float shadeValue = a_valueToFrag;
         )"},
     },
-    /* uniforms */ {},
+    /* uniforms */ {
+      {"u_channelRowA", DataType::Int},
+      {"u_channelRowB", DataType::Int},
+      {"u_channelWeightA", DataType::Float},
+      {"u_channelWeightB", DataType::Float},
+    },
     /* attributes */ {
-      {"a_value", DataType::Float},
+      {"a_pointInd", DataType::Float},
     },
-    /* textures */ {}
+    /* textures */ {
+      {"t_channelValues", 2},
+    }
 );
 
-const ShaderReplacementRule SPHERE_PROPAGATE_VALUE2 (
-    /* rule name */ "SPHERE_PROPAGATE_VALUE2",
+// Sparse values (see SparseElementSet), looked up per point: a_pointInd holds the point of each instance. Also defines
+// shadePresence for SHADE_SPARSE_ABSENT_COLOR.
+const ShaderReplacementRule SPHERE_PROPAGATE_SPARSE_VALUE (
+    /* rule name */ "SPHERE_PROPAGATE_SPARSE_VALUE",
     { /* replacement sources */
       {"VERT_DECLARATIONS", R"(
-          in vec2 a_value2;
-          out vec2 a_value2ToGeom;
+          in float a_pointInd;
+          uniform sampler2D t_sparsePresence;
+          uniform sampler2D t_sparseValues;
+          out float a_valueToGeom;
+          out float a_presenceToGeom;
+          bool sparseLookup(sampler2D presence, sampler2D values, int iElement, out float value);
         )"},
       {"VERT_ASSIGNMENTS", R"(
-          a_value2ToGeom = a_value2;
+          a_presenceToGeom = sparseLookup(t_sparsePresence, t_sparseValues, int(a_pointInd), a_valueToGeom) ? 1. : 0.;
         )"},
       {"GEOM_DECLARATIONS", R"(
-          in vec2 a_value2ToGeom[];
-          out vec2 a_value2ToFrag;
+          in float a_valueToGeom[];
+          in float a_presenceToGeom[];
+          out float a_valueToFrag;
+          out float a_presenceToFrag;
         )"},
       {"GEOM_PER_EMIT", R"(
-          a_value2ToFrag = a_value2ToGeom[0]; 
+          a_valueToFrag = a_valueToGeom[0];
+          a_presenceToFrag = a_presenceToGeom[0];
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+          in float a_presenceToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float shadeValue = a_valueToFrag;
+          float shadePresence = a_presenceToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_pointInd", DataType::Float},
+    },
+    /* textures */ {
+      {"t_sparsePresence", 2},
+      {"t_sparseValues", 2},
+    }
+);
+
+// Instanced versions of the rules above, for the *_INSTANCED programs which have no geometry stage
+
+const ShaderReplacementRule SPHERE_PROPAGATE_VALUE_INSTANCED (
+    /* rule name */ "SPHERE_PROPAGATE_VALUE_INSTANCED",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_value;
+          out float a_valueToFrag;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_valueToFrag = a_value;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float shadeValue = a_valueToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_value", DataType::Float},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_PROPAGATE_VALUE2_INSTANCED (
+    /* rule name */ "SPHERE_PROPAGATE_VALUE2_INSTANCED",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec2 a_value2;
+          out vec2 a_value2ToFrag;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_value2ToFrag = a_value2;
         )"},
       {"FRAG_DECLARATIONS", R"(
           in vec2 a_value2ToFrag;
@@ -413,22 +1106,15 @@ const ShaderReplacementRule SPHERE_PROPAGATE_VALUE2 (
     /* textures */ {}
 );
 
-const ShaderReplacementRule SPHERE_PROPAGATE_COLOR (
-    /* rule name */ "SPHERE_PROPAGATE_COLOR",
+const ShaderReplacementRule SPHERE_PROPAGATE_COLOR_INSTANCED (
+    /* rule name */ "SPHERE_PROPAGATE_COLOR_INSTANCED",
     { /* replacement sources */
       {"VERT_DECLARATIONS", R"(
           in vec3 a_color;
-          out vec3 a_colorToGeom;
-        )"},
-      {"VERT_ASSIGNMENTS", R"(
-          a_colorToGeom = a_color;
-        )"},
-      {"GEOM_DECLARATIONS", R"(
-          in vec3 a_colorToGeom[];
           flat out vec3 a_colorToFrag;
         )"},
-      {"GEOM_PER_EMIT", R"(
-          a_colorToFrag = a_colorToGeom[0]; 
+      {"VERT_ASSIGNMENTS", R"(
+          a_colorToFrag = a_color;
         )"},
       {"FRAG_DECLARATIONS", R"(
           flat in vec3 a_colorToFrag;
@@ -444,31 +1130,56 @@ const ShaderReplacementRule SPHERE_PROPAGATE_COLOR (
     /* textures */ {}
 );
 
-const ShaderReplacementRule SPHERE_CULLPOS_FROM_CENTER(
-    /* rule name */ "SPHERE_CULLPOS_FROM_CENTER",
+const ShaderReplacementRule SPHERE_PROPAGATE_PICK_ID_INSTANCED (
+    /* rule name */ "SPHERE_PROPAGATE_PICK_ID_INSTANCED",
     { /* replacement sources */
-      {"GLOBAL_FRAGMENT_FILTER_PREP", R"(
-          vec3 cullPos = sphereCenterView;
+      {"VERT_DECLARATIONS", R"(
+          uniform vec3 u_pickStart;
+          flat out vec3 a_colorToFrag;
+          vec3 pickIndexColor(vec3 start, uint offset);
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_colorToFrag = pickIndexColor(u_pickStart, pointIndex);
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          flat in vec3 a_colorToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          vec3 shadeColor = a_colorToFrag;
         )"},
     },
-    /* uniforms */ {},
+    /* uniforms */ {
+      {"u_pickStart", DataType::Vector3Float},
+    },
     /* attributes */ {},
     /* textures */ {}
 );
 
-// use a separate version for the quads because they don't already pass the center, and we 
-// don't want to always pass it
-const ShaderReplacementRule SPHERE_CULLPOS_FROM_CENTER_QUAD(
-    /* rule name */ "SPHERE_CULLPOS_FROM_CENTER_QUAD",
+const ShaderReplacementRule SPHERE_PICK_ID_FROM_INDEX_INSTANCED (
+    /* rule name */ "SPHERE_PICK_ID_FROM_INDEX_INSTANCED",
     { /* replacement sources */
-      {"GEOM_DECLARATIONS", R"(
-          out vec3 sphereCenterView;
+      {"VERT_DECLARATIONS", R"(
+          in uint a_pickInd;
         )"},
-      {"GEOM_COMPUTE_BEFORE_EMIT", R"(
-          vec3 sphereCenterViewVal = gl_in[0].gl_Position.xyz / gl_in[0].gl_Position.w;
+      {"VERT_ASSIGNMENTS", R"(
+          a_colorToFrag = pickIndexColor(u_pickStart, a_pickInd);
         )"},
-      {"GEOM_PER_EMIT", R"(
-          sphereCenterView = sphereCenterViewVal;
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_pickInd", DataType::UInt},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_CULLPOS_FROM_CENTER_QUAD_INSTANCED(
+    /* rule name */ "SPHERE_CULLPOS_FROM_CENTER_QUAD_INSTANCED",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          out vec3 sphereCenterView;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          sphereCenterView = centerView.xyz / centerView.w;
         )"},
       {"FRAG_DECLARATIONS", R"(
           in vec3 sphereCenterView;
@@ -482,40 +1193,151 @@ const ShaderReplacementRule SPHERE_CULLPOS_FROM_CENTER_QUAD(
     /* textures */ {}
 );
 
-const ShaderReplacementRule SPHERE_VARIABLE_SIZE (
-    /* rule name */ "SPHERE_VARIABLE_SIZE",
+const ShaderReplacementRule SPHERE_VARIABLE_SIZE_INSTANCED (
+    /* rule name */ "SPHERE_VARIABLE_SIZE_INSTANCED",
     { /* replacement sources */
       {"VERT_DECLARATIONS", R"(
           in float a_pointRadius;
-          out float a_pointRadiusToGeom;
-        )"},
-      {"VERT_ASSIGNMENTS", R"(
-          a_pointRadiusToGeom = a_pointRadius;
-        )"},
-      {"GEOM_DECLARATIONS", R"(
-          in float a_pointRadiusToGeom[];
+          uniform float u_pointRadiusValueScale;
           out float a_pointRadiusToFrag;
         )"},
-      {"GEOM_PER_EMIT", R"(
-          a_pointRadiusToFrag = a_pointRadiusToGeom[0]; 
+      {"VERT_ASSIGNMENTS", R"(
+          a_pointRadiusToFrag = max(a_pointRadius, 0.) * u_pointRadiusValueScale;
         )"},
       {"FRAG_DECLARATIONS", R"(
           in float a_pointRadiusToFrag;
         )"},
-      {"SPHERE_SET_POINT_RADIUS_GEOM", R"(
-          pointRadius *= a_pointRadiusToGeom[0];
+      {"SPHERE_SET_POINT_RADIUS_VERT", R"(
+          pointRadius *= max(a_pointRadius, 0.) * u_pointRadiusValueScale;
         )"},
       {"SPHERE_SET_POINT_RADIUS_FRAG", R"(
           pointRadius *= a_pointRadiusToFrag;
         )"},
     },
-    /* uniforms */ {},
+    /* uniforms */ {
+      {"u_pointRadiusValueScale", DataType::Float},
+    },
     /* attributes */ {
       {"a_pointRadius", DataType::Float},
     },
     /* textures */ {}
 );
 
+const ShaderReplacementRule SPHERE_POSITION_LERP_INSTANCED (
+    /* rule name */ "SPHERE_POSITION_LERP_INSTANCED",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec3 a_positionNext;
+          uniform float u_positionBlend;
+        )"},
+      {"SPHERE_SET_POSITION_VERT", R"(
+          pointPosition = mix(a_position, a_positionNext, u_positionBlend);
+        )"},
+    },
+    /* uniforms */ {
+      {"u_positionBlend", DataType::Float},
+    },
+    /* attributes */ {
+      {"a_positionNext", DataType::Vector3Float},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_VALUE_LERP_INSTANCED (
+    // (after SPHERE_PROPAGATE_VALUE_INSTANCED)
+    /* rule name */ "SPHERE_VALUE_LERP_INSTANCED",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_valueNext;
+          uniform float u_valueBlend;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_valueToFrag = mix(a_value, a_valueNext, u_valueBlend);
+        )"},
+    },
+    /* uniforms */ {
+      {"u_valueBlend", DataType::Float},
+    },
+    /* attributes */ {
+      {"a_valueNext", DataType::Float},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule SPHERE_PROPAGATE_CHANNEL_VALUE_INSTANCED (
+    /* rule name */ "SPHERE_PROPAGATE_CHANNEL_VALUE_INSTANCED",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_pointInd;
+          uniform sampler2D t_channelValues;
+          uniform int u_channelRowA;
+          uniform int u_channelRowB;
+          uniform float u_channelWeightA;
+          uniform float u_channelWeightB;
+          out float a_valueToFrag;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          int iPoint = int(a_pointInd);
+          int channelRowWidth = textureSize(t_channelValues, 0).x;
+          ivec2 pointTexel = ivec2(iPoint % channelRowWidth, iPoint / channelRowWidth);
+          float channelValueA = texelFetch(t_channelValues, pointTexel + ivec2(0, u_channelRowA), 0).r;
+          float channelValueB = texelFetch(t_channelValues, pointTexel + ivec2(0, u_channelRowB), 0).r;
+          a_valueToFrag = u_channelWeightA * channelValueA + u_channelWeightB * channelValueB;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float shadeValue = a_valueToFrag;
+        )"},
+    },
+    /* uniforms */ {
+      {"u_channelRowA", DataType::Int},
+      {"u_channelRowB", DataType::Int},
+      {"u_channelWeightA", DataType::Float},
+      {"u_channelWeightB", DataType::Float},
+    },
+    /* attributes */ {
+      {"a_pointInd", DataType::Float},
+    },
+    /* textures */ {
+      {"t_channelValues", 2},
+    }
+);
+
+const ShaderReplacementRule SPHERE_PROPAGATE_SPARSE_VALUE_INSTANCED (
+    /* rule name */ "SPHERE_PROPAGATE_SPARSE_VALUE_INSTANCED",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_pointInd;
+          uniform sampler2D t_sparsePresence;
+          uniform sampler2D t_sparseValues;
+          out float a_valueToFrag;
+          out float a_presenceToFrag;
+          bool sparseLookup(sampler2D presence, sampler2D values, int iElement, out float value);
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_presenceToFrag = sparseLookup(t_sparsePresence, t_sparseValues, int(a_pointInd), a_valueToFrag) ? 1. : 0.;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+          in float a_presenceToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float shadeValue = a_valueToFrag;
+          float shadePresence = a_presenceToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_pointInd", DataType::Float},
+    },
+    /* textures */ {
+      {"t_sparsePresence", 2},
+      {"t_sparseValues", 2},
+    }
+);
+
 // clang-format on
 
 } // namespace backend_openGL3_glfw
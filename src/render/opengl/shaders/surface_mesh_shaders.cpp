@@ -22,7 +22,6 @@ const ShaderStageSpecification FLEX_MESH_VERT_SHADER = {
     {
         {"a_position", DataType::Vector3Float},
         {"a_normal", DataType::Vector3Float},
-        {"a_barycoord", DataType::Vector3Float},
     },
 
     {}, // textures
@@ -35,7 +34,6 @@ R"(
         uniform mat4 u_projMatrix;
         in vec3 a_position;
         in vec3 a_normal;
-        in vec3 a_barycoord;
         out vec3 a_barycoordToFrag;
         out vec3 a_normalToFrag;
         
@@ -45,13 +43,66 @@ R"(
         {
             gl_Position = u_projMatrix * u_modelView * vec4(a_position,1.);
             a_normalToFrag = mat3(u_modelView) * a_normal;
-            a_barycoordToFrag = a_barycoord;
+            a_barycoordToFrag = vec3(0., 0., 0.);
+            a_barycoordToFrag[gl_VertexID % 3] = 1.; // (triangles are drawn as three consecutive corners)
 
             ${ VERT_ASSIGNMENTS }$
         }
 )"
 };
 
+// Like FLEX_MESH_VERT_SHADER, drawn once per instance with that instance's transform, which the rules see as part of
+// u_modelView
+const ShaderStageSpecification FLEX_MESH_INSTANCED_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    // uniforms
+    {
+        {"u_modelView", DataType::Matrix44Float},
+        {"u_projMatrix", DataType::Matrix44Float},
+    }, 
+
+    // attributes
+    {
+        {"a_position", DataType::Vector3Float},
+        {"a_normal", DataType::Vector3Float},
+        {"a_instanceTransform", DataType::Vector4Float, 4},
+    },
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        uniform mat4 u_modelView;
+        uniform mat4 u_projMatrix;
+        in vec3 a_position;
+        in vec3 a_normal;
+        in vec4 a_instanceTransform[4];
+        out vec3 a_barycoordToFrag;
+        out vec3 a_normalToFrag;
+        
+        ${ VERT_DECLARATIONS }$
+        
+        void main()
+        {
+            mat4 instanceModelView = u_modelView * mat4(a_instanceTransform[0], a_instanceTransform[1], 
+                                                        a_instanceTransform[2], a_instanceTransform[3]);
+            gl_Position = u_projMatrix * instanceModelView * vec4(a_position,1.);
+            a_normalToFrag = mat3(instanceModelView) * a_normal;
+            a_barycoordToFrag = vec3(0., 0., 0.);
+            a_barycoordToFrag[gl_VertexID % 3] = 1.; // (triangles are drawn as three consecutive corners)
+
+            {
+              mat4 u_modelView = instanceModelView;
+              ${ VERT_ASSIGNMENTS }$
+            }
+        }
+)"
+};
+
 const ShaderStageSpecification FLEX_MESH_FRAG_SHADER = {
     
     ShaderStageType::Fragment,
@@ -167,6 +218,160 @@ const ShaderReplacementRule MESH_PROPAGATE_VALUE (
     /* textures */ {}
 );
 
+// Face values read per fragment: t_triangleFace holds the face of each triangle, in draw order, and t_faceValues the
+// value of each face. Both are filled row by row.
+const ShaderReplacementRule MESH_PROPAGATE_FACE_VALUE_TEXTURE (
+    /* rule name */ "MESH_PROPAGATE_FACE_VALUE_TEXTURE",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform sampler2D t_triangleFace;
+          uniform sampler2D t_faceValues;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          int triangleRowWidth = textureSize(t_triangleFace, 0).x;
+          ivec2 triangleTexel = ivec2(gl_PrimitiveID % triangleRowWidth, gl_PrimitiveID / triangleRowWidth);
+          int iFace = int(texelFetch(t_triangleFace, triangleTexel, 0).r);
+          int faceRowWidth = textureSize(t_faceValues, 0).x;
+          float shadeValue = texelFetch(t_faceValues, ivec2(iFace % faceRowWidth, iFace / faceRowWidth), 0).r;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {
+      {"t_triangleFace", 2},
+      {"t_faceValues", 2},
+    }
+);
+
+// Vertex values read per vertex: a_vertexInd holds the vertex of each corner, and t_vertexValues the value of each
+// vertex, filled row by row (so the values can change without refilling any per-corner buffer).
+const ShaderReplacementRule MESH_PROPAGATE_VERTEX_VALUE_TEXTURE (
+    /* rule name */ "MESH_PROPAGATE_VERTEX_VALUE_TEXTURE",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_vertexInd;
+          uniform sampler2D t_vertexValues;
+          out float a_valueToFrag;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          int iVertex = int(a_vertexInd);
+          int vertexRowWidth = textureSize(t_vertexValues, 0).x;
+          a_valueToFrag = texelFetch(t_vertexValues, ivec2(iVertex % vertexRowWidth, iVertex / vertexRowWidth), 0).r;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float shadeValue = a_valueToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_vertexInd", DataType::Float},
+    },
+    /* textures */ {
+      {"t_vertexValues", 2},
+    }
+);
+
+// Sparse values (see SparseElementSet), which also define shadePresence for SHADE_SPARSE_ABSENT_COLOR. Within a
+// triangle, values are interpolated weighted by presence, so that a triangle with only some of its vertices in the set
+// takes their values.
+
+// From per-corner attributes: a_value, and a_valuePresence, 1 on corners with a value and 0 on the others
+const ShaderReplacementRule MESH_PROPAGATE_SPARSE_VALUE (
+    /* rule name */ "MESH_PROPAGATE_SPARSE_VALUE",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_value;
+          in float a_valuePresence;
+          out float a_valueToFrag;
+          out float a_presenceToFrag;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_valueToFrag = a_valuePresence * a_value;
+          a_presenceToFrag = a_valuePresence;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+          in float a_presenceToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float shadePresence = a_presenceToFrag;
+          float shadeValue = a_valueToFrag / max(a_presenceToFrag, 1e-6);
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_value", DataType::Float},
+      {"a_valuePresence", DataType::Float},
+    },
+    /* textures */ {}
+);
+
+// Vertex values looked up per vertex: a_vertexInd holds the vertex of each corner
+const ShaderReplacementRule MESH_PROPAGATE_SPARSE_VERTEX_VALUE (
+    /* rule name */ "MESH_PROPAGATE_SPARSE_VERTEX_VALUE",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_vertexInd;
+          uniform sampler2D t_sparsePresence;
+          uniform sampler2D t_sparseValues;
+          out float a_valueToFrag;
+          out float a_presenceToFrag;
+          bool sparseLookup(sampler2D presence, sampler2D values, int iElement, out float value);
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          float sparseValue;
+          a_presenceToFrag = sparseLookup(t_sparsePresence, t_sparseValues, int(a_vertexInd), sparseValue) ? 1. : 0.;
+          a_valueToFrag = sparseValue;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+          in float a_presenceToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float shadePresence = a_presenceToFrag;
+          float shadeValue = a_valueToFrag / max(a_presenceToFrag, 1e-6);
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_vertexInd", DataType::Float},
+    },
+    /* textures */ {
+      {"t_sparsePresence", 2},
+      {"t_sparseValues", 2},
+    }
+);
+
+// Face values looked up per fragment, through t_triangleFace as for MESH_PROPAGATE_FACE_VALUE_TEXTURE
+const ShaderReplacementRule MESH_PROPAGATE_SPARSE_FACE_VALUE (
+    /* rule name */ "MESH_PROPAGATE_SPARSE_FACE_VALUE",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform sampler2D t_triangleFace;
+          uniform sampler2D t_sparsePresence;
+          uniform sampler2D t_sparseValues;
+          bool sparseLookup(sampler2D presence, sampler2D values, int iElement, out float value);
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          int triangleRowWidth = textureSize(t_triangleFace, 0).x;
+          ivec2 triangleTexel = ivec2(gl_PrimitiveID % triangleRowWidth, gl_PrimitiveID / triangleRowWidth);
+          int iFace = int(texelFetch(t_triangleFace, triangleTexel, 0).r);
+          float shadeValue;
+          float shadePresence = sparseLookup(t_sparsePresence, t_sparseValues, iFace, shadeValue) ? 1. : 0.;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {
+      {"t_triangleFace", 2},
+      {"t_sparsePresence", 2},
+      {"t_sparseValues", 2},
+    }
+);
+
 const ShaderReplacementRule MESH_PROPAGATE_HALFEDGE_VALUE (
     /* rule name */ "MESH_PROPAGATE_HALFEDGE_VALUE",
     { /* replacement sources */
@@ -221,6 +426,77 @@ const ShaderReplacementRule MESH_PROPAGATE_COLOR (
     /* textures */ {}
 );
 
+const ShaderReplacementRule MESH_PROPAGATE_FACE_COLOR_TEXTURE (
+    /* rule name */ "MESH_PROPAGATE_FACE_COLOR_TEXTURE",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform sampler2D t_triangleFace;
+          uniform sampler2D t_faceColors;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          int triangleRowWidth = textureSize(t_triangleFace, 0).x;
+          ivec2 triangleTexel = ivec2(gl_PrimitiveID % triangleRowWidth, gl_PrimitiveID / triangleRowWidth);
+          int iFace = int(texelFetch(t_triangleFace, triangleTexel, 0).r);
+          int faceRowWidth = textureSize(t_faceColors, 0).x;
+          vec3 shadeColor = texelFetch(t_faceColors, ivec2(iFace % faceRowWidth, iFace / faceRowWidth), 0).rgb;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {
+      {"t_triangleFace", 2},
+      {"t_faceColors", 2},
+    }
+);
+
+// Volume mesh cell values read per fragment, as for faces above: t_triangleCell holds the cell of each triangle, in
+// draw order, and t_cellValues the value of each cell.
+const ShaderReplacementRule MESH_PROPAGATE_CELL_VALUE_TEXTURE (
+    /* rule name */ "MESH_PROPAGATE_CELL_VALUE_TEXTURE",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform sampler2D t_triangleCell;
+          uniform sampler2D t_cellValues;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          int triangleRowWidth = textureSize(t_triangleCell, 0).x;
+          ivec2 triangleTexel = ivec2(gl_PrimitiveID % triangleRowWidth, gl_PrimitiveID / triangleRowWidth);
+          int iCell = int(texelFetch(t_triangleCell, triangleTexel, 0).r);
+          int cellRowWidth = textureSize(t_cellValues, 0).x;
+          float shadeValue = texelFetch(t_cellValues, ivec2(iCell % cellRowWidth, iCell / cellRowWidth), 0).r;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {
+      {"t_triangleCell", 2},
+      {"t_cellValues", 2},
+    }
+);
+
+const ShaderReplacementRule MESH_PROPAGATE_CELL_COLOR_TEXTURE (
+    /* rule name */ "MESH_PROPAGATE_CELL_COLOR_TEXTURE",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform sampler2D t_triangleCell;
+          uniform sampler2D t_cellColors;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          int triangleRowWidth = textureSize(t_triangleCell, 0).x;
+          ivec2 triangleTexel = ivec2(gl_PrimitiveID % triangleRowWidth, gl_PrimitiveID / triangleRowWidth);
+          int iCell = int(texelFetch(t_triangleCell, triangleTexel, 0).r);
+          int cellRowWidth = textureSize(t_cellColors, 0).x;
+          vec3 shadeColor = texelFetch(t_cellColors, ivec2(iCell % cellRowWidth, iCell / cellRowWidth), 0).rgb;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {
+      {"t_triangleCell", 2},
+      {"t_cellColors", 2},
+    }
+);
+
 const ShaderReplacementRule MESH_PROPAGATE_VALUE2 (
     /* rule name */ "MESH_PROPAGATE_VALUE2",
     { /* replacement sources */
@@ -364,6 +640,32 @@ const ShaderReplacementRule MESH_BACKFACE_DIFFERENT (
     /* textures */ {}
 );
 
+// Shade with the normal of the triangle under each fragment, from the derivatives of its view-space position, rather
+// than with a_normal. Oriented like the geometric normal (away from the viewer on back faces), so that it goes before
+// MESH_BACKFACE_NORMAL_FLIP.
+const ShaderReplacementRule MESH_COMPUTE_NORMAL_FROM_POSITION (
+    /* rule name */ "MESH_COMPUTE_NORMAL_FROM_POSITION",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          out vec3 a_viewPositionToFrag;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_viewPositionToFrag = vec3(u_modelView * vec4(a_position, 1.));
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in vec3 a_viewPositionToFrag;
+        )"},
+      {"PERTURB_SHADE_NORMAL", R"(
+          shadeNormal = normalize(cross(dFdx(a_viewPositionToFrag), dFdy(a_viewPositionToFrag)));
+          if(!gl_FrontFacing) {
+            shadeNormal *= -1.;
+          }
+        )"}
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {}
+);
 
 // data for picking
 const ShaderReplacementRule MESH_PROPAGATE_PICK (
@@ -437,6 +739,164 @@ const ShaderReplacementRule MESH_PROPAGATE_PICK (
 );
 
 
+// The same picking, with the pick colors computed from element indices: each triangle reads its face, the vertices at
+// its corners and the edges/halfedges along its sides (-1 for the diagonals of a triangulated face) from textures.
+const ShaderReplacementRule MESH_PROPAGATE_PICK_TEXTURE (
+    /* rule name */ "MESH_PROPAGATE_PICK_TEXTURE",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform sampler2D t_triangleFace;
+          uniform sampler2D t_triangleVertices;
+          uniform sampler2D t_triangleEdges;
+          uniform sampler2D t_triangleHalfedges;
+          uniform vec3 u_pickStart;
+          uniform vec3 u_facePickStart;
+          uniform vec3 u_edgePickStart;
+          uniform vec3 u_halfedgePickStart;
+          vec3 pickIndexColor(vec3 start, uint offset);
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          // Parameters defining the pick shape (in barycentric 0-1 units)
+          float vertRadius = 0.2;
+          float edgeRadius = 0.1;
+          float halfedgeRadius = 0.2;
+
+          // (all of the textures are per-triangle, so they share a layout)
+          int triangleRowWidth = textureSize(t_triangleFace, 0).x;
+          ivec2 triangleTexel = ivec2(gl_PrimitiveID % triangleRowWidth, gl_PrimitiveID / triangleRowWidth);
+          vec3 faceColor = pickIndexColor(u_facePickStart, uint(texelFetch(t_triangleFace, triangleTexel, 0).r));
+          
+          vec3 shadeColor = faceColor;
+          bool colorSet = false;
+
+          // Test vertices
+          vec3 triangleVertices = texelFetch(t_triangleVertices, triangleTexel, 0).rgb;
+          for(int i = 0; i < 3; i++) {
+              if(a_barycoordToFrag[i] > 1.0-vertRadius) {
+                shadeColor = pickIndexColor(u_pickStart, uint(triangleVertices[i]));
+                colorSet = true;
+              }
+          }
+
+          // Test edges and halfedges
+          vec3 triangleEdges = texelFetch(t_triangleEdges, triangleTexel, 0).rgb;
+          vec3 triangleHalfedges = texelFetch(t_triangleHalfedges, triangleTexel, 0).rgb;
+          for(int i = 0; i < 3; i++) {
+              if(colorSet) continue;
+              if(triangleEdges[i] < 0.) continue; // a diagonal, which picks the face
+              float eDist = a_barycoordToFrag[(i+2)%3];
+              if(eDist < edgeRadius) {
+                shadeColor = pickIndexColor(u_edgePickStart, uint(triangleEdges[i]));
+                colorSet = true;
+                continue;
+              }
+              if(eDist < halfedgeRadius) {
+                shadeColor = pickIndexColor(u_halfedgePickStart, uint(triangleHalfedges[i]));
+                colorSet = true;
+              }
+          }
+        )"},
+    },
+    /* uniforms */ {
+      {"u_pickStart", DataType::Vector3Float},
+      {"u_facePickStart", DataType::Vector3Float},
+      {"u_edgePickStart", DataType::Vector3Float},
+      {"u_halfedgePickStart", DataType::Vector3Float},
+    },
+    /* attributes */ {},
+    /* textures */ {
+      {"t_triangleFace", 2},
+      {"t_triangleVertices", 2},
+      {"t_triangleEdges", 2},
+      {"t_triangleHalfedges", 2},
+    }
+);
+
+
+// per-instance values for MESH_INSTANCED programs
+const ShaderReplacementRule MESH_INSTANCE_PROPAGATE_VALUE (
+    /* rule name */ "MESH_INSTANCE_PROPAGATE_VALUE",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in float a_instanceValue;
+          out float a_valueToFrag;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_valueToFrag = a_instanceValue;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          float shadeValue = a_valueToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_instanceValue", DataType::Float},
+    },
+    /* textures */ {}
+);
+
+const ShaderReplacementRule MESH_INSTANCE_PROPAGATE_COLOR (
+    /* rule name */ "MESH_INSTANCE_PROPAGATE_COLOR",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec3 a_instanceColor;
+          out vec3 a_colorToFrag;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_colorToFrag = a_instanceColor;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in vec3 a_colorToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          vec3 shadeColor = a_colorToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_instanceColor", DataType::Vector3Float},
+    },
+    /* textures */ {}
+);
+
+// data for picking faces of instances: the pick index is the instance's first index plus the face index, added up with
+// a carry between the 22 bit channels of the pick color (see pick::indToVec())
+const ShaderReplacementRule MESH_INSTANCE_PROPAGATE_PICK (
+    /* rule name */ "MESH_INSTANCE_PROPAGATE_PICK",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec3 a_instancePickStart;
+          in float a_faceIndex;
+          flat out vec3 faceColor;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          uvec3 pickParts = uvec3(a_instancePickStart * 4194304. + 0.5);
+          pickParts.x += uint(a_faceIndex + 0.5);
+          pickParts.y += pickParts.x >> 22;
+          pickParts.x &= 4194303u;
+          pickParts.z += pickParts.y >> 22;
+          pickParts.y &= 4194303u;
+          faceColor = vec3(pickParts) / 4194304.;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          flat in vec3 faceColor;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          vec3 shadeColor = faceColor;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_instancePickStart", DataType::Vector3Float},
+      {"a_faceIndex", DataType::Float},
+    },
+    /* textures */ {}
+);
+
+
 // clang-format on
 
 } // namespace backend_openGL3_glfw
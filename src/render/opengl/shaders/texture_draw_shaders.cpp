@@ -38,6 +38,42 @@ R"(
 )"
 };
 
+// Draws the full-screen quad into a rectangle of the target, for drawing a tile of a larger image
+const ShaderStageSpecification  TEXTURE_TILE_DRAW_VERT_SHADER =  {
+
+    // stage
+    ShaderStageType::Vertex,
+    
+    // uniforms
+    { 
+       {"u_tileLower", DataType::Vector2Float},
+       {"u_tileUpper", DataType::Vector2Float},
+    },
+
+    // attributes
+    {
+        {"a_position", DataType::Vector3Float},
+    },
+
+    // textures
+    {},
+    
+    // source
+R"(
+      ${ GLSL_VERSION }$
+      in vec3 a_position;
+      uniform vec2 u_tileLower;
+      uniform vec2 u_tileUpper;
+      out vec2 tCoord;
+
+      void main()
+      {
+          tCoord = (a_position.xy+vec2(1.0,1.0))/2.0;
+          gl_Position = vec4(mix(u_tileLower, u_tileUpper, tCoord), 0., 1.);
+      }
+)"
+};
+
 const ShaderStageSpecification  SPHEREBG_DRAW_VERT_SHADER =  {
 
     // stage
@@ -211,6 +247,43 @@ R"(
 )"
 };
 
+const ShaderStageSpecification TEMPORAL_ACCUMULATE = {
+  // Fold a new frame in to a running average, which weighs it by u_weight (1/n for the n'th frame)
+    
+    // stage
+    ShaderStageType::Fragment,
+    
+    // uniforms
+    { 
+      {"u_weight", DataType::Float},
+    }, 
+
+    // attributes
+    { },
+    
+    // textures 
+    { 
+      {"t_image", 2},
+      {"t_history", 2},
+    },
+    
+    // source 
+R"(
+      ${ GLSL_VERSION }$
+
+      in vec2 tCoord;
+      uniform sampler2D t_image;
+      uniform sampler2D t_history;
+      uniform float u_weight;
+      layout(location = 0) out vec4 outputF;
+
+      void main()
+      {
+        outputF = mix(texture(t_history, tCoord), texture(t_image, tCoord), u_weight);
+      }
+)"
+};
+
 
 const ShaderStageSpecification COMPOSITE_PEEL = {
     
@@ -243,6 +316,98 @@ R"(
 )"
 };
 
+const ShaderStageSpecification COMPOSITE_WEIGHTED = {
+    
+    // stage
+    ShaderStageType::Fragment,
+    
+    // uniforms
+    { }, 
+
+    // attributes
+    { },
+    
+    // textures 
+    { 
+      {"t_image", 2},
+      {"t_revealage", 2},
+    },
+    
+    // source 
+R"(
+      ${ GLSL_VERSION }$
+
+      in vec2 tCoord;
+      uniform sampler2D t_image;
+      uniform sampler2D t_revealage;
+      layout(location = 0) out vec4 outputF;
+
+      void main()
+      {
+        // revealage was accumulated as a sum of -log(1 - alpha), so this is the product of (1 - alpha)
+        float revealage = exp(-texture(t_revealage, tCoord).r);
+        float coverage = clamp(1. - revealage, 0., 1.);
+        if(coverage <= 0.) discard;
+
+        vec4 accum = texture(t_image, tCoord);
+        outputF = vec4(accum.rgb / max(accum.a, 1e-5), coverage);
+      }
+)"
+};
+
+const ShaderStageSpecification DEFERRED_LIGHTING = {
+    
+    // stage
+    ShaderStageType::Fragment,
+    
+    // uniforms
+    { 
+      {"u_materialIndex", DataType::Float},
+    }, 
+
+    // attributes
+    { },
+    
+    // textures 
+    { 
+      {"t_albedo", 2},
+      {"t_gbuffer", 2},
+      {"t_mat_r", 2},
+      {"t_mat_g", 2},
+      {"t_mat_b", 2},
+      {"t_mat_k", 2},
+    },
+    
+    // source 
+R"(
+      ${ GLSL_VERSION }$
+
+      in vec2 tCoord;
+      uniform float u_materialIndex;
+      uniform sampler2D t_albedo;
+      uniform sampler2D t_gbuffer;
+      uniform sampler2D t_mat_r;
+      uniform sampler2D t_mat_g;
+      uniform sampler2D t_mat_b;
+      uniform sampler2D t_mat_k;
+      layout(location = 0) out vec4 outputF;
+
+      vec3 lightSurfaceMat(vec3 normal, vec3 color, sampler2D t_mat_r, sampler2D t_mat_g, sampler2D t_mat_b, sampler2D t_mat_k);
+      vec3 octahedralDecode(vec2 e);
+
+      void main()
+      {
+        // only the pixels drawn with this pass's material (the background has index 0)
+        vec4 gbuffer = texture(t_gbuffer, tCoord);
+        if(abs(gbuffer.z - (u_materialIndex + 1.)) > 0.25) discard;
+
+        vec4 albedo = texture(t_albedo, tCoord);
+        vec3 normal = octahedralDecode(gbuffer.xy);
+        outputF = vec4(lightSurfaceMat(normal, albedo.rgb, t_mat_r, t_mat_g, t_mat_b, t_mat_k), albedo.a);
+      }
+)"
+};
+
 const ShaderStageSpecification DEPTH_COPY = {
     
     // stage
@@ -274,6 +439,74 @@ R"(
 )"
 };
 
+const ShaderStageSpecification EYE_DOME_LIGHTING = {
+    
+    // stage
+    ShaderStageType::Fragment,
+    
+    // uniforms
+    { 
+      {"u_invProjMatrix", DataType::Matrix44Float},
+      {"u_strength", DataType::Float},
+      {"u_radius", DataType::Float},
+    }, 
+
+    // attributes
+    { },
+    
+    // textures 
+    { 
+      {"t_image", 2},
+      {"t_depth", 2},
+    },
+    
+    // source 
+R"(
+      ${ GLSL_VERSION }$
+
+      in vec2 tCoord;
+      uniform mat4 u_invProjMatrix;
+      uniform float u_strength;
+      uniform float u_radius;
+      uniform sampler2D t_image;
+      uniform sampler2D t_depth;
+      layout(location = 0) out vec4 outputF;
+
+      // log2 of the distance to the camera plane (background pixels have depth 1)
+      float logViewDepth(vec2 coord, out bool isBackground) {
+        float depth = texture(t_depth, coord).r;
+        isBackground = depth >= 1.;
+        vec4 viewPos = u_invProjMatrix * vec4(2. * vec3(coord, depth) - 1., 1.);
+        return log2(max(-viewPos.z / viewPos.w, 1e-12));
+      }
+
+      void main()
+      {
+        vec4 color = texture(t_image, tCoord);
+        bool centerBackground;
+        float centerDepth = logViewDepth(tCoord, centerBackground);
+        if(centerBackground) {
+          outputF = color;
+          return;
+        }
+
+        // darken by how far the neighbors lie in front of this pixel
+        vec2 texelSize = u_radius / vec2(textureSize(t_depth, 0));
+        vec2 offsets[8] = vec2[](vec2(1., 0.), vec2(-1., 0.), vec2(0., 1.), vec2(0., -1.), 
+                                 vec2(0.7071, 0.7071), vec2(-0.7071, 0.7071), vec2(0.7071, -0.7071), vec2(-0.7071, -0.7071));
+        float response = 0.;
+        for(int i = 0; i < 8; i++) {
+          bool neighborBackground;
+          float neighborDepth = logViewDepth(tCoord + offsets[i] * texelSize, neighborBackground);
+          if(!neighborBackground) response += max(0., centerDepth - neighborDepth);
+        }
+        float shade = exp(-300. * u_strength * response / 8.);
+
+        outputF = vec4(color.rgb * shade, color.a);
+      }
+)"
+};
+
 const ShaderStageSpecification DEPTH_TO_MASK = {
   // writes 0./1. mask to red channel
     
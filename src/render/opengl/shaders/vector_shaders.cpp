@@ -227,6 +227,75 @@ R"(
 };
 
 
+//  This INSTANCED variant replaces the geometry shader above with a 14-vertex triangle strip drawn once per vector
+//  (DrawMode::InstancedBoxes), expanded in the vertex shader into the same bounding box of the arrow.
+
+const ShaderStageSpecification FLEX_VECTOR_INSTANCED_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    // uniforms
+    {
+        {"u_modelView", DataType::Matrix44Float},
+        {"u_projMatrix", DataType::Matrix44Float},
+        {"u_lengthMult", DataType::Float},
+        {"u_radius", DataType::Float},
+    }, 
+
+    // attributes
+    {
+        {"a_position", DataType::Vector3Float},
+        {"a_vector", DataType::Vector3Float},
+    },
+
+    {}, // textures
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        in vec3 a_position;
+        in vec3 a_vector;
+        uniform mat4 u_modelView;
+        uniform mat4 u_projMatrix;
+        uniform float u_lengthMult;
+        uniform float u_radius;
+        out vec3 tipView;
+        out vec3 tailView;
+        
+        ${ VERT_DECLARATIONS }$
+
+        void buildTangentBasis(vec3 unitNormal, out vec3 basisX, out vec3 basisY);
+
+        // Box corner emitted by each vertex of the strip. Bit 0 is +x, bit 1 is +y, bit 2 is the tip end.
+        const int STRIP_CORNERS[14] = int[14](6, 7, 4, 5, 1, 7, 3, 6, 2, 4, 0, 1, 2, 3);
+
+        void main()
+        {
+            // Build an orthogonal basis
+            vec4 tailPos = u_modelView * vec4(a_position, 1.0);
+            vec3 tailViewVal = tailPos.xyz / tailPos.w;
+            vec3 vecViewVal = (u_modelView * vec4(a_vector, 0.0)).xyz;
+            vec3 tipViewVal = tailViewVal + vecViewVal * u_lengthMult;
+            vec3 vecDir = normalize(vecViewVal);
+            vec3 basisX; vec3 basisY; buildTangentBasis(vecDir, basisX, basisY);
+
+            // Corner of the box for this vertex
+            int c = STRIP_CORNERS[gl_VertexID];
+            vec3 end = ((c & 4) != 0) ? tipViewVal : tailViewVal;
+            float sx = ((c & 1) != 0) ? 1. : -1.;
+            float sy = ((c & 2) != 0) ? 1. : -1.;
+            gl_Position = u_projMatrix * vec4(end + (sx * basisX + sy * basisY) * u_radius, 1.0);
+
+            tailView = tailViewVal;
+            tipView = tipViewVal;
+            
+            ${ VERT_ASSIGNMENTS }$
+        }
+)"
+};
+
+
 // == Rules
 
 const ShaderReplacementRule VECTOR_PROPAGATE_COLOR (
@@ -260,6 +329,30 @@ const ShaderReplacementRule VECTOR_PROPAGATE_COLOR (
     /* textures */ {}
 );
 
+const ShaderReplacementRule VECTOR_PROPAGATE_COLOR_INSTANCED (
+    /* rule name */ "VECTOR_PROPAGATE_COLOR_INSTANCED",
+    { /* replacement sources */
+      {"VERT_DECLARATIONS", R"(
+          in vec3 a_color;
+          out vec3 a_colorToFrag;
+        )"},
+      {"VERT_ASSIGNMENTS", R"(
+          a_colorToFrag = a_color;
+        )"},
+      {"FRAG_DECLARATIONS", R"(
+          in vec3 a_colorToFrag;
+        )"},
+      {"GENERATE_SHADE_VALUE", R"(
+          vec3 shadeColor = a_colorToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {
+      {"a_color", DataType::Vector3Float},
+    },
+    /* textures */ {}
+);
+
 const ShaderReplacementRule VECTOR_CULLPOS_FROM_TAIL(
     /* rule name */ "VECTOR_CULLPOS_FROM_TAIL",
     { /* replacement sources */
@@ -0,0 +1,254 @@
+#include "polyscope/render/opengl/shaders/volume_grid_shaders.h"
+
+#include <string>
+
+namespace polyscope {
+namespace render {
+namespace backend_openGL3_glfw {
+
+// clang-format off
+
+// Draws the faces of the grid's bounding box, and marches a ray through the volume behind each fragment. Positions are
+// corners of the unit cube, which spans the grid's bounds.
+const ShaderStageSpecification VOLUME_GRID_RAYMARCH_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    // uniforms
+    {
+        {"u_modelView", DataType::Matrix44Float},
+        {"u_projMatrix", DataType::Matrix44Float},
+        {"u_boundMin", DataType::Vector3Float},
+        {"u_boundExtent", DataType::Vector3Float},
+    },
+
+    // attributes
+    {
+        {"a_position", DataType::Vector3Float},
+    },
+
+    {}, // textures
+
+    // source
+    R"(
+        ${ GLSL_VERSION }$
+
+        in vec3 a_position;
+        uniform mat4 u_modelView;
+        uniform mat4 u_projMatrix;
+        uniform vec3 u_boundMin;
+        uniform vec3 u_boundExtent;
+        out vec3 a_gridCoordToFrag;
+
+        ${ VERT_DECLARATIONS }$
+
+        void main()
+        {
+            a_gridCoordToFrag = a_position;
+            gl_Position = u_projMatrix * u_modelView * vec4(u_boundMin + a_position * u_boundExtent, 1.);
+
+            ${ VERT_ASSIGNMENTS }$
+        }
+)"
+};
+
+const ShaderStageSpecification VOLUME_GRID_RAYMARCH_FRAG_SHADER = {
+
+    ShaderStageType::Fragment,
+
+    // uniforms
+    {
+        {"u_modelView", DataType::Matrix44Float},
+        {"u_boundMin", DataType::Vector3Float},
+        {"u_boundExtent", DataType::Vector3Float},
+        {"u_cameraGridPos", DataType::Vector3Float},
+        {"u_gridNodeDim", DataType::Vector3Float},
+        {"u_drawFrontFaces", DataType::Int},
+        {"u_stepsPerCell", DataType::Float},
+        {"u_opacity", DataType::Float},
+        {"u_brickSize", DataType::Float},
+        {"u_rangeLow", DataType::Float},
+        {"u_rangeHigh", DataType::Float},
+    },
+
+    { }, // attributes
+
+    // textures
+    {
+        {"t_colormap", 1},
+        {"t_brickMax", 3},
+    },
+
+    // source
+R"(
+        ${ GLSL_VERSION }$
+
+        in vec3 a_gridCoordToFrag;
+        uniform mat4 u_modelView;
+        uniform vec3 u_boundMin;
+        uniform vec3 u_boundExtent;
+        uniform vec3 u_cameraGridPos;
+        uniform vec3 u_gridNodeDim;
+        uniform int u_drawFrontFaces;
+        uniform float u_stepsPerCell;
+        uniform float u_opacity;
+        uniform float u_brickSize;
+        uniform float u_rangeLow;
+        uniform float u_rangeHigh;
+        uniform sampler1D t_colormap;
+        uniform sampler3D t_brickMax;
+        layout(location = 0) out vec4 outputF;
+
+        // (rules define float sampleGrid(vec3 nodeCoord), with nodeCoord in units of grid nodes)
+        ${ FRAG_DECLARATIONS }$
+
+        void main()
+        {
+           // Only one side of the box is drawn: the front faces when the camera is outside of it, otherwise the back
+           if (gl_FrontFacing != (u_drawFrontFaces != 0)) discard;
+
+           // The ray from the camera through this fragment, in node coordinates. It is parameterized by s, which is 0
+           // at the camera and 1 at the fragment.
+           vec3 nodeScale = u_gridNodeDim - 1.;
+           vec3 rayOrigin = u_cameraGridPos * nodeScale;
+           vec3 rayDir = (a_gridCoordToFrag - u_cameraGridPos) * nodeScale;
+           vec3 sLo = (vec3(0.) - rayOrigin) / rayDir;
+           vec3 sHi = (nodeScale - rayOrigin) / rayDir;
+           vec3 sNear = min(sLo, sHi);
+           vec3 sFar = max(sLo, sHi);
+           float sEnter = max(max(max(sNear.x, sNear.y), sNear.z), 0.);
+           float sExit = min(min(sFar.x, sFar.y), sFar.z);
+
+           // Samples are taken every 1/u_stepsPerCell node spacings, each absorbing the matching fraction of the
+           // opacity a full cell would have
+           float ds = 1. / (u_stepsPerCell * length(rayDir));
+           float stepExponent = 1. / u_stepsPerCell;
+           vec3 brickCount = vec3(textureSize(t_brickMax, 0));
+
+           vec3 color = vec3(0.);
+           float alpha = 0.;
+           float s = sEnter + 0.5 * ds;
+           for (int iStep = 0; iStep < 16384; iStep++) {
+             if (s >= sExit || alpha > 0.99) break;
+             vec3 nodeCoord = rayOrigin + s * rayDir;
+             float sSample = s;
+             s += ds;
+
+             // Bricks whose largest value is below the colormap range are fully transparent, so jump to where the ray
+             // leaves them
+             vec3 brick = clamp(floor(nodeCoord / u_brickSize), vec3(0.), brickCount - 1.);
+             if (texelFetch(t_brickMax, ivec3(brick), 0).r <= u_rangeLow) {
+               vec3 brickExit = (brick + step(vec3(0.), rayDir)) * u_brickSize;
+               vec3 sBrick = (brickExit - rayOrigin) / rayDir;
+               s = max(s, min(min(sBrick.x, sBrick.y), sBrick.z) + 1e-4 * ds);
+               continue;
+             }
+
+             bool sampleCulled = false;
+             ${ SAMPLE_FILTER }$
+             if (sampleCulled) continue;
+
+             float t = (sampleGrid(nodeCoord) - u_rangeLow) / (u_rangeHigh - u_rangeLow);
+             if (!(t > 0.)) continue;
+             t = min(t, 1.);
+             float sampleAlpha = 1. - pow(1. - u_opacity * t, stepExponent);
+             color += (1. - alpha) * sampleAlpha * texture(t_colormap, t).rgb;
+             alpha += (1. - alpha) * sampleAlpha;
+           }
+
+           if (alpha <= 0.) discard;
+           outputF = vec4(color / alpha, alpha);
+        }
+)"
+};
+
+
+// == Rules
+
+// Trilinear samples of a texture with one texel per grid node
+const ShaderReplacementRule VOLUME_GRID_SAMPLE_DENSE (
+    /* rule name */ "VOLUME_GRID_SAMPLE_DENSE",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform sampler3D t_values;
+          float sampleGrid(vec3 nodeCoord) {
+            return texture(t_values, (nodeCoord + 0.5) / vec3(textureSize(t_values, 0))).r;
+          }
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {
+      {"t_values", 3},
+    }
+);
+
+// Samples of bricks packed in to an atlas, each holding its (brickSize+1)^3 nodes so that filtering never reads a
+// neighbor. The index holds the atlas texel of each brick's first node, or a negative x and the value of a brick whose
+// nodes are all equal and was left out.
+const ShaderReplacementRule VOLUME_GRID_SAMPLE_BRICKED (
+    /* rule name */ "VOLUME_GRID_SAMPLE_BRICKED",
+    { /* replacement sources */
+      {"FRAG_DECLARATIONS", R"(
+          uniform sampler3D t_brickAtlas;
+          uniform sampler3D t_brickIndex;
+          float sampleGrid(vec3 nodeCoord) {
+            vec3 brick = clamp(floor(nodeCoord / u_brickSize), vec3(0.), vec3(textureSize(t_brickIndex, 0)) - 1.);
+            vec4 entry = texelFetch(t_brickIndex, ivec3(brick), 0);
+            if (entry.x < 0.) return entry.w;
+            vec3 atlasCoord = entry.xyz + (nodeCoord - brick * u_brickSize) + 0.5;
+            return texture(t_brickAtlas, atlasCoord / vec3(textureSize(t_brickAtlas, 0))).r;
+          }
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {
+      {"t_brickAtlas", 3},
+      {"t_brickIndex", 3},
+    }
+);
+
+// clang-format on
+
+ShaderReplacementRule generateVolumeGridSlicePlaneRule() {
+
+  // Slice planes cull individual samples along the ray rather than whole fragments, so the volume is cut open. This
+  // reads the same uniforms as SLICE_PLANE_CULL, which the ray march program does not use.
+  std::vector<ShaderSpecUniform> uniforms = {
+      {"u_slicePlaneCount", DataType::Int},
+      {"u_slicePlaneIgnoreMask", DataType::UInt},
+  };
+  for (int i = 0; i < MAX_SLICE_PLANES; i++) {
+    uniforms.push_back({"u_slicePlanes[" + std::to_string(i) + "]", DataType::Vector4Float});
+  }
+
+  // clang-format off
+  ShaderReplacementRule slicePlaneRule (
+      /* rule name */ "VOLUME_GRID_SLICE_PLANE_CULL",
+      { /* replacement sources */
+        {"FRAG_DECLARATIONS", R"(
+          uniform int u_slicePlaneCount;
+          uniform uint u_slicePlaneIgnoreMask;
+          uniform vec4 u_slicePlanes[)" + std::to_string(MAX_SLICE_PLANES) + R"(];
+        )"},
+        {"SAMPLE_FILTER", R"(
+          vec3 sampleViewPos = (u_modelView * vec4(u_boundMin + nodeCoord / nodeScale * u_boundExtent, 1.)).xyz;
+          for(int iPlane = 0; iPlane < u_slicePlaneCount; iPlane++) {
+            if((u_slicePlaneIgnoreMask & (1u << uint(iPlane))) != 0u) continue;
+            if(dot(sampleViewPos, u_slicePlanes[iPlane].xyz) < u_slicePlanes[iPlane].w) sampleCulled = true;
+          }
+        )"}
+      },
+      /* uniforms */ uniforms,
+      /* attributes */ {},
+      /* textures */ {}
+  );
+  // clang-format on
+
+  return slicePlaneRule;
+}
+
+} // namespace backend_openGL3_glfw
+} // namespace render
+} // namespace polyscope
@@ -13,31 +13,35 @@ const ShaderStageSpecification SLICE_TETS_VERT_SHADER = {
 
     // attributes
     {
-        {"a_point_1", DataType::Vector3Float},
-        {"a_slice_1", DataType::Vector3Float},
-        {"a_point_2", DataType::Vector3Float},
-        {"a_slice_2", DataType::Vector3Float},
-        {"a_point_3", DataType::Vector3Float},
-        {"a_slice_3", DataType::Vector3Float},
-        {"a_point_4", DataType::Vector3Float},
-        {"a_slice_4", DataType::Vector3Float},
+        {"a_tetVertex_1", DataType::UInt},
+        {"a_tetVertex_2", DataType::UInt},
+        {"a_tetVertex_3", DataType::UInt},
+        {"a_tetVertex_4", DataType::UInt},
     },
 
-    {}, // textures
+    // textures
+    {
+        {"t_vertexPositions", 2},
+    },
 
     // source
     R"(
         ${ GLSL_VERSION }$
+
+        // Per-vertex data lives in textures, one texel per vertex filled row by row
+        vec4 fetchVertexTexel(sampler2D t, uint iV) {
+          int width = textureSize(t, 0).x;
+          int i = int(iV);
+          return texelFetch(t, ivec2(i % width, i / width), 0);
+        }
+
         ${ VERT_DECLARATIONS }$
 
-        in vec3 a_point_1;
-        in vec3 a_point_2;
-        in vec3 a_point_3;
-        in vec3 a_point_4;
-        in vec3 a_slice_1;
-        in vec3 a_slice_2;
-        in vec3 a_slice_3;
-        in vec3 a_slice_4;
+        in uint a_tetVertex_1;
+        in uint a_tetVertex_2;
+        in uint a_tetVertex_3;
+        in uint a_tetVertex_4;
+        uniform sampler2D t_vertexPositions;
         out vec3 point_1;
         out vec3 point_2;
         out vec3 point_3;
@@ -49,14 +53,16 @@ const ShaderStageSpecification SLICE_TETS_VERT_SHADER = {
 
         void main()
         {
-            point_1 = a_point_1;
-            point_2 = a_point_2;
-            point_3 = a_point_3;
-            point_4 = a_point_4;
-            slice_1 = a_slice_1;
-            slice_2 = a_slice_2;
-            slice_3 = a_slice_3;
-            slice_4 = a_slice_4;
+            point_1 = fetchVertexTexel(t_vertexPositions, a_tetVertex_1).xyz;
+            point_2 = fetchVertexTexel(t_vertexPositions, a_tetVertex_2).xyz;
+            point_3 = fetchVertexTexel(t_vertexPositions, a_tetVertex_3).xyz;
+            point_4 = fetchVertexTexel(t_vertexPositions, a_tetVertex_4).xyz;
+
+            // slice by position, unless a rule assigns something else below
+            slice_1 = point_1;
+            slice_2 = point_2;
+            slice_3 = point_3;
+            slice_4 = point_4;
             ${ VERT_ASSIGNMENTS }$
         }
 )"};
@@ -295,20 +301,17 @@ const ShaderReplacementRule SLICE_TETS_PROPAGATE_VECTOR(
     {
         /* replacement sources */
         {"VERT_DECLARATIONS", R"(
-          in vec3 a_value_1;
-          in vec3 a_value_2;
-          in vec3 a_value_3;
-          in vec3 a_value_4;
+          uniform sampler2D t_vertexVectors;
           out vec3 value_1;
           out vec3 value_2;
           out vec3 value_3;
           out vec3 value_4;
         )"},
         {"VERT_ASSIGNMENTS", R"(
-          value_1 = a_value_1;
-          value_2 = a_value_2;
-          value_3 = a_value_3;
-          value_4 = a_value_4;
+          value_1 = fetchVertexTexel(t_vertexVectors, a_tetVertex_1).xyz;
+          value_2 = fetchVertexTexel(t_vertexVectors, a_tetVertex_2).xyz;
+          value_3 = fetchVertexTexel(t_vertexVectors, a_tetVertex_3).xyz;
+          value_4 = fetchVertexTexel(t_vertexVectors, a_tetVertex_4).xyz;
         )"},
         {"GEOM_DECLARATIONS", R"(
           in vec3 value_1[];
@@ -335,14 +338,11 @@ const ShaderReplacementRule SLICE_TETS_PROPAGATE_VECTOR(
         )"},
     },
     /* uniforms */ {},
-    /* attributes */
+    /* attributes */ {},
+    /* textures */
     {
-        {"a_value_1", DataType::Vector3Float},
-        {"a_value_2", DataType::Vector3Float},
-        {"a_value_3", DataType::Vector3Float},
-        {"a_value_4", DataType::Vector3Float},
-    },
-    /* textures */ {});
+        {"t_vertexVectors", 2},
+    });
 
 const ShaderReplacementRule SLICE_TETS_VECTOR_COLOR(
     /* rule name */ "SLICE_TETS_VECTOR_COLOR",
@@ -360,20 +360,17 @@ const ShaderReplacementRule SLICE_TETS_PROPAGATE_VALUE(
     {
         /* replacement sources */
         {"VERT_DECLARATIONS", R"(
-          in float a_value_1;
-          in float a_value_2;
-          in float a_value_3;
-          in float a_value_4;
+          uniform sampler2D t_vertexValues;
           out float value_1;
           out float value_2;
           out float value_3;
           out float value_4;
         )"},
         {"VERT_ASSIGNMENTS", R"(
-          value_1 = a_value_1;
-          value_2 = a_value_2;
-          value_3 = a_value_3;
-          value_4 = a_value_4;
+          value_1 = fetchVertexTexel(t_vertexValues, a_tetVertex_1).r;
+          value_2 = fetchVertexTexel(t_vertexValues, a_tetVertex_2).r;
+          value_3 = fetchVertexTexel(t_vertexValues, a_tetVertex_3).r;
+          value_4 = fetchVertexTexel(t_vertexValues, a_tetVertex_4).r;
         )"},
         {"GEOM_DECLARATIONS", R"(
           in float value_1[];
@@ -400,12 +397,278 @@ const ShaderReplacementRule SLICE_TETS_PROPAGATE_VALUE(
         )"},
     },
     /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */
+    {
+        {"t_vertexValues", 2},
+    });
+
+// Cell values, the same for the whole slice of a tet: a_tetCell holds the cell each tet was cut from, and t_cellValues
+// the value of each cell, one texel per cell filled row by row (the texture the mesh program reads too)
+const ShaderReplacementRule SLICE_TETS_PROPAGATE_CELL_VALUE(
+    /* rule name */ "SLICE_TETS_PROPAGATE_CELL_VALUE",
+    {
+        /* replacement sources */
+        {"VERT_DECLARATIONS", R"(
+          in uint a_tetCell;
+          uniform sampler2D t_cellValues;
+          out float cellValue;
+        )"},
+        {"VERT_ASSIGNMENTS", R"(
+          cellValue = fetchVertexTexel(t_cellValues, a_tetCell).r;
+        )"},
+        {"GEOM_DECLARATIONS", R"(
+          in float cellValue[];
+          out float a_valueToFrag;
+      )"},
+        {"GEOM_ASSIGNMENTS", R"(
+          a_valueToFrag = cellValue[0];
+      )"},
+        {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+        )"},
+        {"GENERATE_SHADE_VALUE", R"(
+          float shadeValue = a_valueToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */
+    {
+        {"a_tetCell", DataType::UInt},
+    },
+    /* textures */
+    {
+        {"t_cellValues", 2},
+    });
+
+const ShaderReplacementRule SLICE_TETS_PROPAGATE_CELL_VECTOR(
+    /* rule name */ "SLICE_TETS_PROPAGATE_CELL_VECTOR",
+    {
+        /* replacement sources */
+        {"VERT_DECLARATIONS", R"(
+          in uint a_tetCell;
+          uniform sampler2D t_cellColors;
+          out vec3 cellValue;
+        )"},
+        {"VERT_ASSIGNMENTS", R"(
+          cellValue = fetchVertexTexel(t_cellColors, a_tetCell).xyz;
+        )"},
+        {"GEOM_DECLARATIONS", R"(
+          in vec3 cellValue[];
+          out vec3 a_valueToFrag;
+      )"},
+        {"GEOM_ASSIGNMENTS", R"(
+          a_valueToFrag = cellValue[0];
+      )"},
+        {"FRAG_DECLARATIONS", R"(
+          in vec3 a_valueToFrag;
+        )"},
+        {"GENERATE_SHADE_VALUE", R"(
+          vec3 shadeValue = a_valueToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */
+    {
+        {"a_tetCell", DataType::UInt},
+    },
+    /* textures */
+    {
+        {"t_cellColors", 2},
+    });
+
+// Slice through a scalar field instead of space: the slice coordinate is the vertex value along x, so a slice vector
+// of (1,0,0) with slice point c cuts the level set {value = c}
+const ShaderReplacementRule SLICE_TETS_SLICE_BY_VALUE(
+    /* rule name */ "SLICE_TETS_SLICE_BY_VALUE",
+    {
+        /* replacement sources */
+        {"VERT_DECLARATIONS", R"(
+          uniform sampler2D t_sliceValues;
+        )"},
+        {"VERT_ASSIGNMENTS", R"(
+          slice_1 = vec3(fetchVertexTexel(t_sliceValues, a_tetVertex_1).r, 0., 0.);
+          slice_2 = vec3(fetchVertexTexel(t_sliceValues, a_tetVertex_2).r, 0., 0.);
+          slice_3 = vec3(fetchVertexTexel(t_sliceValues, a_tetVertex_3).r, 0., 0.);
+          slice_4 = vec3(fetchVertexTexel(t_sliceValues, a_tetVertex_4).r, 0., 0.);
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */
+    {
+        {"t_sliceValues", 2},
+    });
+
+// Cached slices (see VolumeMeshSlice): the SLICE_TETS vertex and geometry stages cut the tets once per plane pose, and
+// ShaderProgram::capture() records the emitted triangles. Nothing is rasterized then, the fragment stage only completes
+// the program.
+const ShaderStageSpecification SLICE_TETS_CAPTURE_FRAG_SHADER = {
+
+    ShaderStageType::Fragment,
+
+    // uniforms
+    {},
+
+    {}, // attributes
+
+    // textures
+    {},
+
+    // source
+    R"(
+        ${ GLSL_VERSION }$
+        layout(location = 0) out vec4 outputF;
+
+        void main()
+        {
+           outputF = vec4(0.);
+        }
+)"};
+
+// The captured triangles, drawn with SLICE_TETS_FRAG_SHADER like an uncached slice. Every slice faces along the plane
+// normal, so it is not recorded; captured strips are split in to separate triangles, so the corners follow from the
+// vertex index.
+const ShaderStageSpecification SLICE_TETS_CACHED_VERT_SHADER = {
+
+    ShaderStageType::Vertex,
+
+    // uniforms
+    {
+        {"u_modelView", DataType::Matrix44Float},
+        {"u_projMatrix", DataType::Matrix44Float},
+        {"u_sliceVector", DataType::Vector3Float},
+    },
+
+    // attributes
+    {
+        {"a_slicePosition", DataType::Vector3Float},
+    },
+
+    {}, // textures
+
+    // source
+    R"(
+        ${ GLSL_VERSION }$
+
+        in vec3 a_slicePosition;
+        uniform mat4 u_modelView;
+        uniform mat4 u_projMatrix;
+        uniform vec3 u_sliceVector;
+        out vec3 a_barycoordToFrag;
+        out vec3 a_normalToFrag;
+        out vec3 a_edgeIsRealToFrag;
+        ${ VERT_DECLARATIONS }$
+
+        void main()
+        {
+            mat4 toScreen = u_projMatrix * u_modelView;
+            gl_Position = toScreen * vec4(a_slicePosition, 1.0);
+            a_normalToFrag = vec3(toScreen * vec4(u_sliceVector, 0.0));
+            a_barycoordToFrag = vec3(0, 0, 0);
+            a_barycoordToFrag[gl_VertexID % 3] = 1.0;
+            a_edgeIsRealToFrag = vec3(1, 1, 1);
+            ${ VERT_ASSIGNMENTS }$
+        }
+)"};
+
+// Records the position of each slice vertex, already offset as SLICE_TETS_GEOM_SHADER draws it
+const ShaderReplacementRule SLICE_TETS_CAPTURE_POSITION(
+    /* rule name */ "SLICE_TETS_CAPTURE_POSITION",
+    {
+        /* replacement sources */
+        {"GEOM_DECLARATIONS", R"(
+          out vec3 a_slicePosition;
+      )"},
+        {"GEOM_ASSIGNMENTS", R"(
+          a_slicePosition = q[ordering[i]] - offset;
+      )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {});
+
+// Also record a propagated value (SLICE_TETS_PROPAGATE_VALUE or SLICE_TETS_PROPAGATE_CELL_VALUE) along x
+const ShaderReplacementRule SLICE_TETS_CAPTURE_VALUE(
+    /* rule name */ "SLICE_TETS_CAPTURE_VALUE",
+    {
+        /* replacement sources */
+        {"GEOM_DECLARATIONS", R"(
+          out vec3 a_sliceValue;
+      )"},
+        {"GEOM_ASSIGNMENTS", R"(
+          a_sliceValue = vec3(a_valueToFrag, 0., 0.);
+      )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {});
+
+// Also record a propagated vector (SLICE_TETS_PROPAGATE_VECTOR or SLICE_TETS_PROPAGATE_CELL_VECTOR)
+const ShaderReplacementRule SLICE_TETS_CAPTURE_VECTOR(
+    /* rule name */ "SLICE_TETS_CAPTURE_VECTOR",
+    {
+        /* replacement sources */
+        {"GEOM_DECLARATIONS", R"(
+          out vec3 a_sliceValue;
+      )"},
+        {"GEOM_ASSIGNMENTS", R"(
+          a_sliceValue = a_valueToFrag;
+      )"},
+    },
+    /* uniforms */ {},
+    /* attributes */ {},
+    /* textures */ {});
+
+// Shade a cached slice with the value recorded by SLICE_TETS_CAPTURE_VALUE
+const ShaderReplacementRule SLICE_TETS_CACHED_VALUE(
+    /* rule name */ "SLICE_TETS_CACHED_VALUE",
+    {
+        /* replacement sources */
+        {"VERT_DECLARATIONS", R"(
+          in vec3 a_sliceValue;
+          out float a_valueToFrag;
+        )"},
+        {"VERT_ASSIGNMENTS", R"(
+          a_valueToFrag = a_sliceValue.x;
+        )"},
+        {"FRAG_DECLARATIONS", R"(
+          in float a_valueToFrag;
+        )"},
+        {"GENERATE_SHADE_VALUE", R"(
+          float shadeValue = a_valueToFrag;
+        )"},
+    },
+    /* uniforms */ {},
+    /* attributes */
+    {
+        {"a_sliceValue", DataType::Vector3Float},
+    },
+    /* textures */ {});
+
+// Shade a cached slice with the vector recorded by SLICE_TETS_CAPTURE_VECTOR
+const ShaderReplacementRule SLICE_TETS_CACHED_VECTOR(
+    /* rule name */ "SLICE_TETS_CACHED_VECTOR",
+    {
+        /* replacement sources */
+        {"VERT_DECLARATIONS", R"(
+          in vec3 a_sliceValue;
+          out vec3 a_valueToFrag;
+        )"},
+        {"VERT_ASSIGNMENTS", R"(
+          a_valueToFrag = a_sliceValue;
+        )"},
+        {"FRAG_DECLARATIONS", R"(
+          in vec3 a_valueToFrag;
+        )"},
+        {"GENERATE_SHADE_VALUE", R"(
+          vec3 shadeValue = a_valueToFrag;
+        )"},
+    },
+    /* uniforms */ {},
     /* attributes */
     {
-        {"a_value_1", DataType::Float},
-        {"a_value_2", DataType::Float},
-        {"a_value_3", DataType::Float},
-        {"a_value_4", DataType::Float},
+        {"a_sliceValue", DataType::Vector3Float},
     },
     /* textures */ {});
 
@@ -1,88 +1,132 @@
 #include "polyscope/render/shader_builder.h"
 
+#include <unordered_map>
+
 
 namespace polyscope {
 namespace render {
 
-std::vector<ShaderStageSpecification>
-applyShaderReplacements(const std::vector<ShaderStageSpecification>& stages,
-                        const std::vector<ShaderReplacementRule>& replacementRules) {
+namespace {
+const std::string startTagToken = "${ ";
+const std::string endTagToken = " }$";
+const std::string tagCommentStart = "\n// tag "; // each tag is left as a comment, ahead of its text
+} // namespace
 
-  bool debugPrint = false;
+ShaderSourceTemplate tokenizeShaderSource(const std::string& src) {
+  const auto npos = std::string::npos;
 
-  // accumulate the text to be inserted at each tag from all of the rules
-  std::map<std::string, std::string> replacements;
-  for (const ShaderReplacementRule& rule : replacementRules) {
-    if (debugPrint) std::cout << "Replacement rule: " << rule.ruleName << std::endl;
+  ShaderSourceTemplate result;
+  size_t pos = 0;
+  while (true) {
 
-    for (const std::pair<std::string, std::string>& r : rule.replacements) {
-      std::string key = r.first;
-      std::string value = r.second;
+    // Find the next tag in the program
+    auto tagStart = src.find(startTagToken, pos);
+    auto tagEnd = src.find(endTagToken, pos);
 
-      if (replacements.find(key) == replacements.end()) {
-        replacements[key] = "";
-      }
-      replacements[key] = replacements[key] + "// from rule: " + rule.ruleName + "\n" + value + "\n";
-    }
-  }
+    if (tagStart != npos && tagEnd == npos) throw std::runtime_error("ShaderBuilder: no end tag matching start tag");
+    if (tagStart == npos && tagEnd != npos) throw std::runtime_error("ShaderBuilder: no start tag matching end tag");
+    if (tagEnd < tagStart) throw std::runtime_error("ShaderBuilder: end tag before start tag");
 
-  const auto npos = std::string::npos;
-  const std::string startTagToken = "${ ";
-  const std::string endTagToken = " }$";
-
-  // == Apply the replacements to the shader source
-  std::vector<ShaderStageSpecification> replacedStages;
-  for (ShaderStageSpecification stage : stages) { // iterate by value to modify
-    std::string progText = stage.src;
-    std::string resultText = "";
+    // no more tags, the rest of the source is the last literal
+    if (tagStart == npos) {
+      result.literals.push_back(src.substr(pos));
+      break;
+    }
 
-    while (!progText.empty()) {
+    size_t nameStart = tagStart + startTagToken.size();
+    result.literals.push_back(src.substr(pos, tagStart - pos));
+    result.tags.push_back(src.substr(nameStart, tagEnd - nameStart));
+    pos = tagEnd + endTagToken.size();
+  }
 
-      if (debugPrint) std::cout << "searching " << progText << std::endl;
+  for (const std::string& l : result.literals) result.literalLength += l.size();
+  return result;
+}
 
-      // Find the next tag in the program
-      auto tagStart = progText.find(startTagToken);
-      auto tagEnd = progText.find(endTagToken);
+std::vector<ShaderSourceTemplate> tokenizeShaderSources(const std::vector<ShaderStageSpecification>& stages) {
+  std::vector<ShaderSourceTemplate> templates;
+  for (const ShaderStageSpecification& stage : stages) {
+    templates.push_back(tokenizeShaderSource(stage.src));
+  }
+  return templates;
+}
 
-      if (tagStart != npos && tagEnd == npos) throw std::runtime_error("ShaderBuilder: no end tag matching start tag");
-      if (tagStart == npos && tagEnd != npos) throw std::runtime_error("ShaderBuilder: no start tag matching end tag");
+std::vector<ShaderSourceTemplate> tokenizeShaderSources(const std::vector<const ShaderStageSpecification*>& stages) {
+  std::vector<ShaderSourceTemplate> templates;
+  for (const ShaderStageSpecification* stage : stages) {
+    templates.push_back(tokenizeShaderSource(stage->src));
+  }
+  return templates;
+}
 
-      // no more tags, concatenate in the rest of the source finish looping
-      if (tagStart == npos && tagEnd == npos) {
-        resultText += progText;
-        progText = "";
-      } else {
+std::vector<ShaderStageSpecification>
+applyShaderReplacements(const std::vector<ShaderStageSpecification>& stages,
+                        const std::vector<ShaderReplacementRule>& replacementRules) {
+  std::vector<const ShaderStageSpecification*> stagePtrs;
+  for (const ShaderStageSpecification& stage : stages) stagePtrs.push_back(&stage);
+  std::vector<const ShaderReplacementRule*> rulePtrs;
+  for (const ShaderReplacementRule& rule : replacementRules) rulePtrs.push_back(&rule);
+  return applyShaderReplacements(stagePtrs, tokenizeShaderSources(stages), rulePtrs);
+}
 
-        if (debugPrint) std::cout << "FOUND TAG: " << tagStart << " " << tagEnd << std::endl;
+std::vector<ShaderStageSpecification>
+applyShaderReplacements(const std::vector<const ShaderStageSpecification*>& stages,
+                        const std::vector<ShaderSourceTemplate>& templates,
+                        const std::vector<const ShaderReplacementRule*>& replacementRules) {
 
-        std::string srcBefore = progText.substr(0, tagStart);
-        std::string tag = progText.substr(tagStart + startTagToken.size(), tagEnd - (tagStart + startTagToken.size()));
-        std::string srcAfter = progText.substr(tagEnd + endTagToken.size(), npos);
+  if (templates.size() != stages.size()) {
+    throw std::runtime_error("ShaderBuilder: need one source template per shader stage");
+  }
 
-        if (debugPrint) std::cout << "  TAG NAME: [" << tag << "]\n";
+  // accumulate the text to be inserted at each tag from all of the rules
+  std::unordered_map<std::string, std::string> replacements;
+  for (const ShaderReplacementRule* rule : replacementRules) {
+    for (const std::pair<std::string, std::string>& r : rule->replacements) {
+      std::string& text = replacements[r.first];
+      text.append("// from rule: ").append(rule->ruleName).append("\n").append(r.second).append("\n");
+    }
+  }
 
-        resultText += srcBefore + "\n// tag ${ " + tag + " }$\n";
-        if (replacements.find(tag) != replacements.end()) {
-          resultText += replacements[tag];
-          // std::cout << "  ADDING REPLACEMENT: [" << replacements[tag] << "]\n";
-        }
-        // resultText += "// END ADDIITIONS FROM TAG ${ " + tag + " $}\n";
-        progText = srcAfter; // continue processing the remaining program text
+  // == Apply the replacements to the shader source
+  std::vector<ShaderStageSpecification> replacedStages;
+  replacedStages.reserve(stages.size());
+  for (size_t iStage = 0; iStage < stages.size(); iStage++) {
+    const ShaderStageSpecification& stage = *stages[iStage];
+    const ShaderSourceTemplate& tmpl = templates[iStage];
+
+    // Look up the text for each tag once, then concatenate everything in to a buffer of the final size
+    std::vector<const std::string*> tagText(tmpl.tags.size(), nullptr);
+    size_t resultLength = tmpl.literalLength;
+    for (size_t iT = 0; iT < tmpl.tags.size(); iT++) {
+      resultLength += tagCommentStart.size() + startTagToken.size() + tmpl.tags[iT].size() + endTagToken.size() + 1;
+      auto it = replacements.find(tmpl.tags[iT]);
+      if (it != replacements.end()) {
+        tagText[iT] = &it->second;
+        resultLength += it->second.size();
       }
     }
 
+    std::string resultText;
+    resultText.reserve(resultLength);
+    for (size_t iT = 0; iT < tmpl.tags.size(); iT++) {
+      resultText.append(tmpl.literals[iT]);
+      resultText.append(tagCommentStart).append(startTagToken).append(tmpl.tags[iT]).append(endTagToken).append("\n");
+      if (tagText[iT]) resultText.append(*tagText[iT]);
+    }
+    resultText.append(tmpl.literals.back());
+
     // For now, we put the uniform listings on the all stages, attributes on vertex shaders, and textures on fragment
     // shaders, since this is where they are mostly commonly used. These listings are only used internally by Polyscope
     // to check inputs, so this should be fine even if they happen to be used elsewhere.
 
     // == Union the uniforms
     std::vector<ShaderSpecUniform> replacedUniforms = stage.uniforms;
-    for (const ShaderReplacementRule& rule : replacementRules) {
-      for (ShaderSpecUniform newU : rule.uniforms) {
+    for (const ShaderReplacementRule* rule : replacementRules) {
+      for (const ShaderSpecUniform& newU : rule->uniforms) {
 
         // Look for a matching-named existing uniform
         bool existingFound = false;
-        for (ShaderSpecUniform existingU : replacedUniforms) {
+        for (const ShaderSpecUniform& existingU : replacedUniforms) {
           if (existingU.name == newU.name) {
             // check for conflics
             if (existingU.type != newU.type) {
@@ -104,12 +148,12 @@ applyShaderReplacements(const std::vector<ShaderStageSpecification>& stages,
     // == Union the attributes
     std::vector<ShaderSpecAttribute> replacedAttributes = stage.attributes;
     if (stage.stage == ShaderStageType::Vertex) {
-      for (const ShaderReplacementRule& rule : replacementRules) {
-        for (ShaderSpecAttribute newA : rule.attributes) {
+      for (const ShaderReplacementRule* rule : replacementRules) {
+        for (const ShaderSpecAttribute& newA : rule->attributes) {
 
           // Look for a matching-named existing attribute
           bool existingFound = false;
-          for (ShaderSpecAttribute existingA : replacedAttributes) {
+          for (const ShaderSpecAttribute& existingA : replacedAttributes) {
             if (existingA.name == newA.name) {
               // check for conflics
               if (existingA.type != newA.type) {
@@ -137,12 +181,12 @@ applyShaderReplacements(const std::vector<ShaderStageSpecification>& stages,
     // == Union the textures
     std::vector<ShaderSpecTexture> replacedTextures = stage.textures;
     if (stage.stage == ShaderStageType::Fragment) {
-      for (const ShaderReplacementRule& rule : replacementRules) {
-        for (ShaderSpecTexture newT : rule.textures) {
+      for (const ShaderReplacementRule* rule : replacementRules) {
+        for (const ShaderSpecTexture& newT : rule->textures) {
 
           // Look for a matching-named existing texture
           bool existingFound = false;
-          for (ShaderSpecTexture existingT : replacedTextures) {
+          for (const ShaderSpecTexture& existingT : replacedTextures) {
             if (existingT.name == newT.name) {
               // check for conflics
               if (existingT.dim != newT.dim) {
@@ -164,8 +208,8 @@ applyShaderReplacements(const std::vector<ShaderStageSpecification>& stages,
 
 
     // create a new specification, which is identical except for the replaced source text
-    ShaderStageSpecification newStage{stage.stage, replacedUniforms, replacedAttributes, replacedTextures, resultText};
-    replacedStages.push_back(newStage);
+    replacedStages.push_back(
+        ShaderStageSpecification{stage.stage, replacedUniforms, replacedAttributes, replacedTextures, resultText});
   }
 
   return replacedStages;
@@ -22,11 +22,20 @@ RibbonArtist::RibbonArtist(Structure& parentStructure_,
       material(parentStructure.uniquePrefix() + "#ribbon#" + uniqueName + "#enabled", "wax")
 
 {
-  createProgram();
+  for (size_t iLine = 0; iLine < ribbons.size(); iLine++) ribbonColorSamples.push_back(randomUnit());
+  if (!ribbons.empty()) createProgram();
 }
 
 void RibbonArtist::deleteProgram() { program.reset(); }
 
+void RibbonArtist::addRibbons(const std::vector<std::vector<std::array<glm::vec3, 2>>>& newRibbons) {
+  if (newRibbons.empty()) return;
+  ribbons.insert(ribbons.end(), newRibbons.begin(), newRibbons.end());
+  for (size_t iLine = 0; iLine < newRibbons.size(); iLine++) ribbonColorSamples.push_back(randomUnit());
+  deleteProgram();
+  requestRedraw();
+}
+
 void RibbonArtist::createProgram() {
 
   // Create the program
@@ -36,58 +45,55 @@ void RibbonArtist::createProgram() {
   unsigned int restartInd = -1;
   program->setPrimitiveRestartIndex(restartInd);
 
-  // Compute length scales and whatnot
-  float normalOffset = static_cast<float>(state::lengthScale * normalOffsetFraction);
-
   // == Fill buffers
 
-  // Trace a whole bunch of lines along the surface
+  // Only the points of the lines are stored: the geometry shader expands them into ribbons, offsetting them along the
+  // normals and sizing them by uniforms, and the color is looked up from the colormap texture. Changing any of these
+  // does not refill the buffers.
+  size_t nTotalPts = 0;
+  for (const std::vector<std::array<glm::vec3, 2>>& line : ribbons) {
+    if (line.size() > 1) nTotalPts += line.size() + 2;
+  }
   std::vector<glm::vec3> positions;
   std::vector<glm::vec3> normals;
-  std::vector<glm::vec3> colors;
+  std::vector<float> colorvals;
   std::vector<unsigned int> indices;
+  positions.reserve(nTotalPts);
+  normals.reserve(nTotalPts);
+  colorvals.reserve(nTotalPts);
+  indices.reserve(nTotalPts + ribbons.size());
   unsigned int nPts = 0;
-  const render::ValueColorMap& cmapValue = render::engine->getColorMap(cMap);
+  auto addPoint = [&](glm::vec3 pos, glm::vec3 normal, float colorval) {
+    positions.push_back(pos);
+    normals.push_back(normal);
+    colorvals.push_back(colorval);
+    indices.push_back(nPts++);
+  };
   for (size_t iLine = 0; iLine < ribbons.size(); iLine++) {
 
-    // Process each point from the list
-    std::vector<std::array<glm::vec3, 2>> line = ribbons[iLine];
-
-    // Offset points along normals
-    for (std::array<glm::vec3, 2>& x : line) {
-      x[0] += x[1] * normalOffset;
-    }
+    const std::vector<std::array<glm::vec3, 2>>& line = ribbons[iLine];
 
     // Fill the render buffer for this line
     if (line.size() <= 1) {
       continue;
     }
 
-    // Sample a color for this line
-    glm::vec3 lineColor = cmapValue.getValue(randomUnit());
+    // Where this line samples the colormap
+    float lineColorval = ribbonColorSamples[iLine];
 
     // Add a false point at the beginning (so it's not a special case for the geometry shader)
     float EPS = 0.01;
     glm::vec3 fakeFirst = line[0][0] + EPS * (line[0][0] - line[1][0]);
-    positions.push_back(fakeFirst);
-    normals.push_back(line.front()[1]);
-    colors.push_back(lineColor);
-    indices.push_back(nPts++);
+    addPoint(fakeFirst, line.front()[1], lineColorval);
 
     // Add all of the real points
-    for (auto& pn : line) {
-      positions.push_back(pn[0]);
-      normals.push_back(pn[1]);
-      colors.push_back(lineColor);
-      indices.push_back(nPts++);
+    for (const std::array<glm::vec3, 2>& pn : line) {
+      addPoint(pn[0], pn[1], lineColorval);
     }
 
     // Add a false point at the end too
     glm::vec3 fakeLast = line.back()[0] + EPS * (line.back()[0] - line[line.size() - 2][0]);
-    positions.push_back(fakeLast);
-    normals.push_back(line.back()[1]);
-    colors.push_back(lineColor);
-    indices.push_back(nPts++);
+    addPoint(fakeLast, line.back()[1], lineColorval);
 
     // Restart index allows us to draw multiple lines from a single buffer
     indices.push_back(restartInd);
@@ -96,8 +102,9 @@ void RibbonArtist::createProgram() {
   // Store the values in GL buffers
   program->setAttribute("a_position", positions);
   program->setAttribute("a_normal", normals);
-  program->setAttribute("a_color", colors);
+  program->setAttribute("a_colorval", colorvals);
   program->setIndex(indices);
+  program->setTextureFromColormap("t_colormap", cMap);
 
   render::engine->setMaterial(*program, material.get());
 }
@@ -105,7 +112,7 @@ void RibbonArtist::createProgram() {
 
 void RibbonArtist::draw() {
 
-  if (!enabled.get()) {
+  if (!enabled.get() || ribbons.empty()) {
     return;
   }
 
@@ -116,8 +123,7 @@ void RibbonArtist::draw() {
   // Set uniforms
   parentStructure.setStructureUniforms(*program);
 
-  glm::vec3 eyePos = view::getCameraWorldPosition();
-
+  program->setUniform("u_normalOffset", static_cast<float>(state::lengthScale * normalOffsetFraction));
   program->setUniform("u_ribbonWidth", getWidth());
   program->setUniform("u_depthOffset", 1e-4);
 
@@ -148,7 +154,8 @@ void RibbonArtist::buildParametersGUI() {
   }
 
   if (render::buildColormapSelector(cMap)) {
-    deleteProgram();
+    if (program) program->setTextureFromColormap("t_colormap", cMap, true);
+    requestRedraw();
   }
 
   ImGui::PushItemWidth(150);
@@ -0,0 +1,220 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/scalar_array.h"
+
+#include "polyscope/affine_remapper.h"
+#include "polyscope/histogram.h"
+#include "polyscope/render/engine.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace polyscope {
+
+ScalarArray::ScalarArray(const std::vector<double>& values, ScalarPrecision precision_) : precision(precision_) {
+  switch (precision) {
+  case ScalarPrecision::Double:
+    doubleValues = values;
+    break;
+  case ScalarPrecision::Float:
+    floatValues.assign(values.begin(), values.end());
+    break;
+  case ScalarPrecision::Quantized16:
+  case ScalarPrecision::Quantized8: {
+    // Steps across the finite range, leaving the largest value for non-finite ones
+    std::pair<double, double> range = polyscope::robustMinMax(values, 0.);
+    quantLow = range.first;
+    quantStep = (range.second - range.first) / (quantMax() - 1);
+    if (precision == ScalarPrecision::Quantized16) {
+      shortValues.resize(values.size());
+      for (size_t i = 0; i < values.size(); i++) shortValues[i] = static_cast<uint16_t>(quantize(values[i]));
+    } else {
+      byteValues.resize(values.size());
+      for (size_t i = 0; i < values.size(); i++) byteValues[i] = static_cast<uint8_t>(quantize(values[i]));
+    }
+  } break;
+  }
+}
+
+uint32_t ScalarArray::quantize(double val) const {
+  if (!std::isfinite(val)) return quantMax();
+  if (quantStep == 0.) return 0;
+  double q = std::round((val - quantLow) / quantStep);
+  return static_cast<uint32_t>(std::min(std::max(q, 0.), static_cast<double>(quantMax() - 1)));
+}
+
+size_t ScalarArray::size() const {
+  switch (precision) {
+  case ScalarPrecision::Double:
+    return doubleValues.size();
+  case ScalarPrecision::Float:
+    return floatValues.size();
+  case ScalarPrecision::Quantized16:
+    return shortValues.size();
+  case ScalarPrecision::Quantized8:
+    return byteValues.size();
+  }
+  return 0;
+}
+
+double ScalarArray::quantizationError() const { return isQuantized() ? 0.5 * quantStep : 0.; }
+
+void ScalarArray::resize(size_t n) {
+  switch (precision) {
+  case ScalarPrecision::Double:
+    doubleValues.resize(n, 0.);
+    break;
+  case ScalarPrecision::Float:
+    floatValues.resize(n, 0.f);
+    break;
+  case ScalarPrecision::Quantized16:
+    shortValues.resize(n, static_cast<uint16_t>(quantize(0.)));
+    break;
+  case ScalarPrecision::Quantized8:
+    byteValues.resize(n, static_cast<uint8_t>(quantize(0.)));
+    break;
+  }
+}
+
+void ScalarArray::set(size_t i, double val) {
+  switch (precision) {
+  case ScalarPrecision::Double:
+    doubleValues[i] = val;
+    break;
+  case ScalarPrecision::Float:
+    floatValues[i] = static_cast<float>(val);
+    break;
+  case ScalarPrecision::Quantized16:
+    shortValues[i] = static_cast<uint16_t>(quantize(val));
+    break;
+  case ScalarPrecision::Quantized8:
+    byteValues[i] = static_cast<uint8_t>(quantize(val));
+    break;
+  }
+}
+
+std::vector<double> ScalarArray::toDoubles() const {
+  if (precision == ScalarPrecision::Double) {
+    return doubleValues;
+  }
+  if (precision == ScalarPrecision::Float) {
+    return std::vector<double>(floatValues.begin(), floatValues.end());
+  }
+  std::vector<double> result(size());
+  for (size_t i = 0; i < result.size(); i++) result[i] = (*this)[i];
+  return result;
+}
+
+std::vector<float> ScalarArray::toFloats() const {
+  std::vector<float> result(size());
+  for (size_t i = 0; i < result.size(); i++) result[i] = static_cast<float>((*this)[i]);
+  return result;
+}
+
+double ScalarArray::maxPositive() const {
+  double result = 0.;
+  if (precision == ScalarPrecision::Float) {
+    for (float x : floatValues) {
+      if (x > result) result = x;
+    }
+  } else if (precision == ScalarPrecision::Double) {
+    for (double x : doubleValues) {
+      if (x > result) result = x;
+    }
+  } else {
+    for (size_t i = 0; i < size(); i++) {
+      double x = (*this)[i];
+      if (x > result) result = x;
+    }
+  }
+  return result;
+}
+
+std::pair<double, double> ScalarArray::robustMinMax(double rangeEPS) const {
+  if (precision == ScalarPrecision::Float) {
+    std::pair<float, float> range = polyscope::robustMinMax(floatValues, static_cast<float>(rangeEPS));
+    return std::make_pair<double, double>(range.first, range.second);
+  }
+  if (precision == ScalarPrecision::Double) {
+    return polyscope::robustMinMax(doubleValues, rangeEPS);
+  }
+  return polyscope::robustMinMax(toDoubles(), rangeEPS);
+}
+
+std::pair<double, double> ScalarArray::approximatePercentileRange(double lowPercentile, double highPercentile) const {
+  if (precision == ScalarPrecision::Float) {
+    return polyscope::approximatePercentileRange(floatValues, lowPercentile, highPercentile);
+  }
+  if (precision == ScalarPrecision::Double) {
+    return polyscope::approximatePercentileRange(doubleValues, lowPercentile, highPercentile);
+  }
+  return polyscope::approximatePercentileRange(toDoubles(), lowPercentile, highPercentile);
+}
+
+void ScalarArray::buildHistogram(Histogram& hist, const std::vector<double>& weights) const {
+  if (precision == ScalarPrecision::Float) {
+    hist.buildHistogram(floatValues, weights);
+  } else if (precision == ScalarPrecision::Double) {
+    hist.buildHistogram(doubleValues, weights);
+  } else {
+    hist.buildHistogram(toDoubles(), weights);
+  }
+}
+
+void ScalarArray::setAttribute(render::ShaderProgram& p, std::string name, bool update) const {
+  if (precision == ScalarPrecision::Float) {
+    p.setAttribute(name, floatValues, update);
+  } else if (precision == ScalarPrecision::Double) {
+    p.setAttribute(name, doubleValues, update);
+  } else {
+    p.setAttribute(name, toFloats(), update);
+  }
+}
+
+void ScalarArray::setAttribute(render::ShaderProgram& p, std::string name, const std::vector<uint32_t>& indices,
+                               bool update) const {
+  if (precision == ScalarPrecision::Double) {
+    std::vector<double> subset(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) subset[i] = doubleValues[indices[i]];
+    p.setAttribute(name, subset, update);
+  } else {
+    std::vector<float> subset(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) subset[i] = static_cast<float>((*this)[indices[i]]);
+    p.setAttribute(name, subset, update);
+  }
+}
+
+void ScalarArray::setPaddedAttribute(render::ShaderProgram& p, std::string name, size_t bufferSize,
+                                     bool update) const {
+  if (precision == ScalarPrecision::Double) {
+    std::vector<double> padded(doubleValues);
+    padded.resize(std::max(bufferSize, padded.size()), 0.);
+    p.setAttribute(name, padded, update);
+  } else {
+    std::vector<float> padded(precision == ScalarPrecision::Float ? floatValues : toFloats());
+    padded.resize(std::max(bufferSize, padded.size()), 0.f);
+    p.setAttribute(name, padded, update);
+  }
+}
+
+void ScalarArray::updateAttributeRanges(render::ShaderProgram& p, std::string name,
+                                        const std::vector<std::pair<size_t, size_t>>& ranges) const {
+  if (precision == ScalarPrecision::Float) {
+    p.updateAttributeRanges(name, floatValues, ranges);
+  } else if (precision == ScalarPrecision::Double) {
+    p.updateAttributeRanges(name, doubleValues, ranges);
+  } else {
+    p.updateAttributeRanges(name, toFloats(), ranges);
+  }
+}
+
+void ScalarArray::setBufferData(render::AttributeBuffer& buffer, bool update) const {
+  if (precision == ScalarPrecision::Float) {
+    buffer.setData(floatValues, update);
+  } else if (precision == ScalarPrecision::Double) {
+    buffer.setData(std::vector<float>(doubleValues.begin(), doubleValues.end()), update);
+  } else {
+    buffer.setData(toFloats(), update);
+  }
+}
+
+} // namespace polyscope
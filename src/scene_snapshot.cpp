@@ -0,0 +1,651 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/scene_snapshot.h"
+
+#include "polyscope/binary_file.h"
+#include "polyscope/curve_network.h"
+#include "polyscope/curve_network_color_quantity.h"
+#include "polyscope/curve_network_scalar_quantity.h"
+#include "polyscope/curve_network_vector_quantity.h"
+#include "polyscope/persistent_value.h"
+#include "polyscope/point_cloud.h"
+#include "polyscope/point_cloud_color_quantity.h"
+#include "polyscope/point_cloud_scalar_quantity.h"
+#include "polyscope/point_cloud_vector_quantity.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/surface_color_quantity.h"
+#include "polyscope/surface_mesh.h"
+#include "polyscope/surface_scalar_quantity.h"
+#include "polyscope/surface_vector_quantity.h"
+#include "polyscope/view.h"
+#include "polyscope/volume_mesh.h"
+#include "polyscope/volume_mesh_color_quantity.h"
+#include "polyscope/volume_mesh_scalar_quantity.h"
+#include "polyscope/volume_mesh_vector_quantity.h"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+
+namespace polyscope {
+
+const uint32_t sceneFileVersion = 3;
+
+// The layout of a scene file. Every value is written in the byte order of the machine, and every array is aligned to 8
+// bytes from the start of the file, so the arrays can be used in place. Strings and arrays are prefixed with their
+// length as a uint64.
+//
+//   header      "polyscn\0", uint32 version, uint32 byte order check, uint32 sizeof(size_t), uint32 zero
+//   settings    one table per type of persistent value: uint64 count, then (name, value) pairs
+//   camera      view::getCameraJson(), navigation style, up direction, move scale, background color
+//   structures  uint64 count, then for each: type name, name, transform, geometry (per type), quantities
+//   quantities  uint64 count, then for each: kind (e.g. "scalar:vertex"), name, data (per kind)
+
+namespace {
+
+const char sceneFileMagic[8] = {'p', 'o', 'l', 'y', 's', 'c', 'n', '\0'};
+const uint32_t sceneByteOrderCheck = 0x01020304;
+
+using SceneWriter = internal::BinaryWriter;
+using SceneReader = internal::BinaryReader;
+
+// === Persistent values
+
+template <typename T>
+void writeSetting(SceneWriter& w, const T& v) {
+  w.value(v);
+}
+void writeSetting(SceneWriter& w, const std::string& v) { w.string(v); }
+template <typename T>
+void writeSetting(SceneWriter& w, const ScaledValue<T>& v) {
+  ScaledValue<T> copy = v;
+  w.value(*copy.getValuePtr());
+  w.value<char>(copy.isRelative());
+}
+void writeSetting(SceneWriter& w, const std::vector<std::string>& v) {
+  w.value<uint64_t>(v.size());
+  for (const std::string& s : v) w.string(s);
+}
+
+template <typename T>
+void readSetting(SceneReader& r, T& v) {
+  v = r.value<T>();
+}
+void readSetting(SceneReader& r, std::string& v) { v = r.string(); }
+template <typename T>
+void readSetting(SceneReader& r, ScaledValue<T>& v) {
+  T value = r.value<T>();
+  bool isRelative = r.value<char>();
+  v = ScaledValue<T>(value, isRelative);
+}
+void readSetting(SceneReader& r, std::vector<std::string>& v) {
+  v.resize(r.value<uint64_t>());
+  for (std::string& s : v) s = r.string();
+}
+
+template <typename T>
+void writeCache(SceneWriter& w) {
+  const detail::PersistentCache<T>& cache = detail::getPersistentCacheRef<T>();
+  w.value<uint64_t>(cache.size());
+  cache.forEach([&](const std::string& name, const T& value) {
+    w.string(name);
+    writeSetting(w, value);
+  });
+}
+
+template <typename T>
+void readCache(SceneReader& r) {
+  detail::PersistentCache<T>& cache = detail::getPersistentCacheRef<T>();
+  size_t n = r.value<uint64_t>();
+  for (size_t i = 0; i < n; i++) {
+    std::string name = r.string();
+    T v;
+    readSetting(r, v);
+    cache.store(cache.intern(name), v);
+  }
+}
+
+// (in the order of the tables in the file)
+void writeSettings(SceneWriter& w) {
+  writeCache<double>(w);
+  writeCache<float>(w);
+  writeCache<bool>(w);
+  writeCache<std::string>(w);
+  writeCache<glm::vec3>(w);
+  writeCache<glm::mat4>(w);
+  writeCache<ScaledValue<double>>(w);
+  writeCache<ScaledValue<float>>(w);
+  writeCache<std::vector<std::string>>(w);
+  writeCache<ParamVizStyle>(w);
+  writeCache<BackFacePolicy>(w);
+}
+
+void readSettings(SceneReader& r) {
+  readCache<double>(r);
+  readCache<float>(r);
+  readCache<bool>(r);
+  readCache<std::string>(r);
+  readCache<glm::vec3>(r);
+  readCache<glm::mat4>(r);
+  readCache<ScaledValue<double>>(r);
+  readCache<ScaledValue<float>>(r);
+  readCache<std::vector<std::string>>(r);
+  readCache<ParamVizStyle>(r);
+  readCache<BackFacePolicy>(r);
+}
+
+// === Quantities
+
+// Collects a writer for each quantity of a structure which can be saved, so they can be counted before any is written
+struct QuantityWriters {
+  std::vector<std::function<void(SceneWriter&)>> writers;
+
+  void write(SceneWriter& w) {
+    w.value<uint64_t>(writers.size());
+    for (std::function<void(SceneWriter&)>& f : writers) f(w);
+  }
+};
+
+template <typename Q>
+void addScalarWriter(QuantityWriters& q, std::string kind, Q* s) {
+  q.writers.push_back([kind, s](SceneWriter& w) {
+    w.string(kind);
+    w.string(s->name);
+    w.value<int32_t>(static_cast<int32_t>(s->dataType));
+    std::pair<double, double> range = s->getMapRange();
+    w.value(range.first);
+    w.value(range.second);
+    w.array(s->values.toDoubles());
+  });
+}
+
+void addValuesWriter(QuantityWriters& q, std::string kind, std::string name, const std::vector<glm::vec3>* values) {
+  q.writers.push_back([kind, name, values](SceneWriter& w) {
+    w.string(kind);
+    w.string(name);
+    w.array(*values);
+  });
+}
+
+void addVectorWriter(QuantityWriters& q, std::string kind, std::string name, VectorType type,
+                     const std::vector<glm::vec3>* vectors) {
+  q.writers.push_back([kind, name, type, vectors](SceneWriter& w) {
+    w.string(kind);
+    w.string(name);
+    w.value<int32_t>(static_cast<int32_t>(type));
+    w.array(*vectors);
+  });
+}
+
+// Reads the quantity records of a structure, handing each to the function for its kind along with the element it is
+// defined on. Scalars carry their map range, which is not a persistent value.
+struct QuantityReaders {
+  std::function<void(const std::string&, const std::string&, const std::vector<double>&, DataType,
+                     std::pair<double, double>)>
+      scalar;
+  std::function<void(const std::string&, const std::string&, const std::vector<glm::vec3>&)> color;
+  std::function<void(const std::string&, const std::string&, const std::vector<glm::vec3>&, VectorType)> vector;
+
+  void read(SceneReader& r, const std::string& structureName) {
+    size_t n = r.value<uint64_t>();
+    for (size_t i = 0; i < n; i++) {
+      std::string kind = r.string();
+      std::string name = r.string();
+      std::string family = kind.substr(0, kind.find(':'));
+      std::string element = kind.find(':') == std::string::npos ? "" : kind.substr(kind.find(':') + 1);
+      if (family == "scalar") {
+        DataType type = static_cast<DataType>(r.value<int32_t>());
+        std::pair<double, double> range;
+        range.first = r.value<double>();
+        range.second = r.value<double>();
+        scalar(element, name, r.array<double>(), type, range);
+      } else if (family == "color") {
+        color(element, name, r.array<glm::vec3>());
+      } else if (family == "vector") {
+        VectorType type = static_cast<VectorType>(r.value<int32_t>());
+        vector(element, name, r.array<glm::vec3>(), type);
+      } else {
+        throw std::runtime_error("Scene file has quantity " + name + " on " + structureName + " of unknown kind " +
+                                 kind);
+      }
+    }
+  }
+};
+
+void unknownElement(const std::string& structureName, const std::string& element) {
+  throw std::runtime_error("Scene file has a quantity on " + structureName + " defined on unknown element " + element);
+}
+
+// === Structures
+
+void writePointCloud(SceneWriter& w, PointCloud& s, std::vector<std::string>& skipped) {
+  w.array(s.points);
+
+  QuantityWriters q;
+  for (auto& entry : s.quantities) {
+    PointCloudQuantity* base = entry.second.get();
+    if (PointCloudScalarQuantity* scalar = dynamic_cast<PointCloudScalarQuantity*>(base)) {
+      addScalarWriter(q, "scalar:point", scalar);
+    } else if (PointCloudColorQuantity* color = dynamic_cast<PointCloudColorQuantity*>(base)) {
+      addValuesWriter(q, "color:point", color->name, &color->values);
+    } else if (PointCloudVectorQuantity* vector = dynamic_cast<PointCloudVectorQuantity*>(base)) {
+      addVectorWriter(q, "vector:point", vector->name, vector->vectorType, &vector->vectors);
+    } else {
+      skipped.push_back(s.name + " / " + base->name);
+    }
+  }
+  q.write(w);
+}
+
+void readPointCloud(SceneReader& r, const std::string& name, glm::mat4 transform) {
+  PointCloud* s = new PointCloud(name, r.array<glm::vec3>());
+  registerStructure(s);
+
+  QuantityReaders q;
+  q.scalar = [&](const std::string& element, const std::string& qName, const std::vector<double>& values,
+                 DataType type, std::pair<double, double> range) {
+    if (element != "point") unknownElement(name, element);
+    s->addScalarQuantity(qName, values, type)->setMapRange(range);
+  };
+  q.color = [&](const std::string& element, const std::string& qName, const std::vector<glm::vec3>& values) {
+    if (element != "point") unknownElement(name, element);
+    s->addColorQuantity(qName, values);
+  };
+  q.vector = [&](const std::string& element, const std::string& qName, const std::vector<glm::vec3>& values,
+                 VectorType type) {
+    if (element != "point") unknownElement(name, element);
+    s->addVectorQuantity(qName, values, type);
+  };
+  q.read(r, name);
+
+  s->setTransform(transform);
+}
+
+void writeSurfaceMesh(SceneWriter& w, SurfaceMesh& s, std::vector<std::string>& skipped) {
+  w.array(s.vertices);
+  w.array(s.faceIndsEntries);
+  w.array(s.faceIndsStart);
+
+  s.ensureHaveGeometryData();
+  SurfaceMesh::DerivedData d = s.getDerivedData();
+  w.array(d.halfedgeEdgeIndices);
+  w.array(d.halfedgeDefinesEdge);
+  w.array(d.vertexFaceStart);
+  w.array(d.vertexFaces);
+  w.array(d.faceNormals);
+  w.array(d.vertexNormals);
+  w.array(d.faceAreas);
+  w.array(d.vertexAreas);
+  w.array(d.edgeLengths);
+
+  // Quantities are saved in the mesh's own element order, so they are read back with the identity permutation, and
+  // these are restored after
+  for (const std::vector<size_t>* perm : {&s.vertexPerm, &s.facePerm, &s.edgePerm, &s.halfedgePerm, &s.cornerPerm}) {
+    w.array(*perm);
+  }
+  for (size_t size : {s.vertexDataSize, s.faceDataSize, s.edgeDataSize, s.halfedgeDataSize, s.cornerDataSize}) {
+    w.value<uint64_t>(size);
+  }
+
+  QuantityWriters q;
+  for (auto& entry : s.quantities) {
+    SurfaceMeshQuantity* base = entry.second.get();
+    if (SurfaceVertexScalarQuantity* scalar = dynamic_cast<SurfaceVertexScalarQuantity*>(base)) {
+      addScalarWriter(q, "scalar:vertex", scalar);
+    } else if (SurfaceFaceScalarQuantity* scalar = dynamic_cast<SurfaceFaceScalarQuantity*>(base)) {
+      addScalarWriter(q, "scalar:face", scalar);
+    } else if (SurfaceEdgeScalarQuantity* scalar = dynamic_cast<SurfaceEdgeScalarQuantity*>(base)) {
+      addScalarWriter(q, "scalar:edge", scalar);
+    } else if (SurfaceHalfedgeScalarQuantity* scalar = dynamic_cast<SurfaceHalfedgeScalarQuantity*>(base)) {
+      addScalarWriter(q, "scalar:halfedge", scalar);
+    } else if (SurfaceVertexColorQuantity* color = dynamic_cast<SurfaceVertexColorQuantity*>(base)) {
+      addValuesWriter(q, "color:vertex", color->name, &color->values);
+    } else if (SurfaceFaceColorQuantity* color = dynamic_cast<SurfaceFaceColorQuantity*>(base)) {
+      addValuesWriter(q, "color:face", color->name, &color->values);
+    } else if (SurfaceVertexVectorQuantity* vector = dynamic_cast<SurfaceVertexVectorQuantity*>(base)) {
+      addVectorWriter(q, "vector:vertex", vector->name, vector->vectorType, &vector->vectors);
+    } else if (SurfaceFaceVectorQuantity* vector = dynamic_cast<SurfaceFaceVectorQuantity*>(base)) {
+      addVectorWriter(q, "vector:face", vector->name, vector->vectorType, &vector->vectors);
+    } else {
+      skipped.push_back(s.name + " / " + base->name);
+    }
+  }
+  q.write(w);
+}
+
+void readSurfaceMesh(SceneReader& r, const std::string& name, glm::mat4 transform) {
+  std::vector<glm::vec3> vertices = r.array<glm::vec3>();
+  std::vector<uint32_t> faceIndsEntries = r.array<uint32_t>();
+  std::vector<size_t> faceIndsStart = r.array<size_t>();
+  SurfaceMesh::DerivedData d;
+  d.halfedgeEdgeIndices = r.array<uint32_t>();
+  d.halfedgeDefinesEdge = r.array<char>();
+  d.vertexFaceStart = r.array<size_t>();
+  d.vertexFaces = r.array<uint32_t>();
+  d.faceNormals = r.array<glm::vec3>();
+  d.vertexNormals = r.array<glm::vec3>();
+  d.faceAreas = r.array<double>();
+  d.vertexAreas = r.array<double>();
+  d.edgeLengths = r.array<double>();
+
+  std::vector<std::vector<size_t>> perms;
+  for (int i = 0; i < 5; i++) perms.push_back(r.array<size_t>());
+  std::vector<size_t> dataSizes;
+  for (int i = 0; i < 5; i++) dataSizes.push_back(r.value<uint64_t>());
+
+  SurfaceMesh* s = new SurfaceMesh(name, vertices, std::move(faceIndsEntries), std::move(faceIndsStart), std::move(d));
+  registerStructure(s);
+
+  QuantityReaders q;
+  q.scalar = [&](const std::string& element, const std::string& qName, const std::vector<double>& values,
+                 DataType type, std::pair<double, double> range) {
+    if (element == "vertex") {
+      s->addVertexScalarQuantity(qName, values, type)->setMapRange(range);
+    } else if (element == "face") {
+      s->addFaceScalarQuantity(qName, values, type)->setMapRange(range);
+    } else if (element == "edge") {
+      s->addEdgeScalarQuantity(qName, values, type)->setMapRange(range);
+    } else if (element == "halfedge") {
+      s->addHalfedgeScalarQuantity(qName, values, type)->setMapRange(range);
+    } else {
+      unknownElement(name, element);
+    }
+  };
+  q.color = [&](const std::string& element, const std::string& qName, const std::vector<glm::vec3>& values) {
+    if (element == "vertex") {
+      s->addVertexColorQuantity(qName, values);
+    } else if (element == "face") {
+      s->addFaceColorQuantity(qName, values);
+    } else {
+      unknownElement(name, element);
+    }
+  };
+  q.vector = [&](const std::string& element, const std::string& qName, const std::vector<glm::vec3>& values,
+                 VectorType type) {
+    if (element == "vertex") {
+      s->addVertexVectorQuantity(qName, values, type);
+    } else if (element == "face") {
+      s->addFaceVectorQuantity(qName, values, type);
+    } else {
+      unknownElement(name, element);
+    }
+  };
+  q.read(r, name);
+
+  s->vertexPerm = std::move(perms[0]);
+  s->facePerm = std::move(perms[1]);
+  s->edgePerm = std::move(perms[2]);
+  s->halfedgePerm = std::move(perms[3]);
+  s->cornerPerm = std::move(perms[4]);
+  s->resetPermutationInverses();
+  s->vertexDataSize = dataSizes[0];
+  s->faceDataSize = dataSizes[1];
+  s->edgeDataSize = dataSizes[2];
+  s->halfedgeDataSize = dataSizes[3];
+  s->cornerDataSize = dataSizes[4];
+  s->setTransform(transform);
+}
+
+void writeCurveNetwork(SceneWriter& w, CurveNetwork& s, std::vector<std::string>& skipped) {
+  w.array(s.nodes);
+  w.array(s.edges);
+
+  QuantityWriters q;
+  for (auto& entry : s.quantities) {
+    CurveNetworkQuantity* base = entry.second.get();
+    if (CurveNetworkNodeScalarQuantity* scalar = dynamic_cast<CurveNetworkNodeScalarQuantity*>(base)) {
+      addScalarWriter(q, "scalar:node", scalar);
+    } else if (CurveNetworkEdgeScalarQuantity* scalar = dynamic_cast<CurveNetworkEdgeScalarQuantity*>(base)) {
+      addScalarWriter(q, "scalar:edge", scalar);
+    } else if (CurveNetworkNodeColorQuantity* color = dynamic_cast<CurveNetworkNodeColorQuantity*>(base)) {
+      addValuesWriter(q, "color:node", color->name, &color->values);
+    } else if (CurveNetworkEdgeColorQuantity* color = dynamic_cast<CurveNetworkEdgeColorQuantity*>(base)) {
+      addValuesWriter(q, "color:edge", color->name, &color->values);
+    } else if (CurveNetworkNodeVectorQuantity* vector = dynamic_cast<CurveNetworkNodeVectorQuantity*>(base)) {
+      addVectorWriter(q, "vector:node", vector->name, vector->vectorType, &vector->vectors);
+    } else if (CurveNetworkEdgeVectorQuantity* vector = dynamic_cast<CurveNetworkEdgeVectorQuantity*>(base)) {
+      addVectorWriter(q, "vector:edge", vector->name, vector->vectorType, &vector->vectors);
+    } else {
+      skipped.push_back(s.name + " / " + base->name);
+    }
+  }
+  q.write(w);
+}
+
+void readCurveNetwork(SceneReader& r, const std::string& name, glm::mat4 transform) {
+  std::vector<glm::vec3> nodes = r.array<glm::vec3>();
+  std::vector<std::array<size_t, 2>> edges = r.array<std::array<size_t, 2>>();
+  CurveNetwork* s = new CurveNetwork(name, std::move(nodes), std::move(edges));
+  registerStructure(s);
+
+  QuantityReaders q;
+  q.scalar = [&](const std::string& element, const std::string& qName, const std::vector<double>& values,
+                 DataType type, std::pair<double, double> range) {
+    if (element == "node") {
+      s->addNodeScalarQuantity(qName, values, type)->setMapRange(range);
+    } else if (element == "edge") {
+      s->addEdgeScalarQuantity(qName, values, type)->setMapRange(range);
+    } else {
+      unknownElement(name, element);
+    }
+  };
+  q.color = [&](const std::string& element, const std::string& qName, const std::vector<glm::vec3>& values) {
+    if (element == "node") {
+      s->addNodeColorQuantity(qName, values);
+    } else if (element == "edge") {
+      s->addEdgeColorQuantity(qName, values);
+    } else {
+      unknownElement(name, element);
+    }
+  };
+  q.vector = [&](const std::string& element, const std::string& qName, const std::vector<glm::vec3>& values,
+                 VectorType type) {
+    if (element == "node") {
+      s->addNodeVectorQuantity(qName, values, type);
+    } else if (element == "edge") {
+      s->addEdgeVectorQuantity(qName, values, type);
+    } else {
+      unknownElement(name, element);
+    }
+  };
+  q.read(r, name);
+
+  s->setTransform(transform);
+}
+
+void writeVolumeMesh(SceneWriter& w, VolumeMesh& s, std::vector<std::string>& skipped) {
+  w.array(s.vertices);
+  w.array(s.cellIndsEntries);
+  w.array(s.cellIndsStart);
+  w.value<uint64_t>(s.uniformCellDegree);
+  for (const std::vector<size_t>* perm : {&s.vertexPerm, &s.edgePerm, &s.facePerm, &s.cellPerm}) {
+    w.array(*perm);
+  }
+
+  QuantityWriters q;
+  for (auto& entry : s.quantities) {
+    VolumeMeshQuantity* base = entry.second.get();
+    if (VolumeMeshVertexScalarQuantity* scalar = dynamic_cast<VolumeMeshVertexScalarQuantity*>(base)) {
+      addScalarWriter(q, "scalar:vertex", scalar);
+    } else if (VolumeMeshCellScalarQuantity* scalar = dynamic_cast<VolumeMeshCellScalarQuantity*>(base)) {
+      addScalarWriter(q, "scalar:cell", scalar);
+    } else if (VolumeMeshVertexColorQuantity* color = dynamic_cast<VolumeMeshVertexColorQuantity*>(base)) {
+      addValuesWriter(q, "color:vertex", color->name, &color->values);
+    } else if (VolumeMeshCellColorQuantity* color = dynamic_cast<VolumeMeshCellColorQuantity*>(base)) {
+      addValuesWriter(q, "color:cell", color->name, &color->values);
+    } else if (VolumeMeshVertexVectorQuantity* vector = dynamic_cast<VolumeMeshVertexVectorQuantity*>(base)) {
+      addVectorWriter(q, "vector:vertex", vector->name, vector->vectorType, &vector->vectors);
+    } else if (VolumeMeshCellVectorQuantity* vector = dynamic_cast<VolumeMeshCellVectorQuantity*>(base)) {
+      addVectorWriter(q, "vector:cell", vector->name, vector->vectorType, &vector->vectors);
+    } else {
+      skipped.push_back(s.name + " / " + base->name);
+    }
+  }
+  q.write(w);
+}
+
+void readVolumeMesh(SceneReader& r, const std::string& name, glm::mat4 transform) {
+  std::vector<glm::vec3> vertices = r.array<glm::vec3>();
+  std::vector<uint32_t> cellIndsEntries = r.array<uint32_t>();
+  std::vector<uint32_t> cellIndsStart = r.array<uint32_t>();
+  size_t uniformCellDegree = r.value<uint64_t>();
+  std::vector<std::vector<size_t>> perms;
+  for (int i = 0; i < 4; i++) perms.push_back(r.array<size_t>());
+
+  VolumeMesh* s =
+      new VolumeMesh(name, vertices, std::move(cellIndsEntries), std::move(cellIndsStart), uniformCellDegree);
+  registerStructure(s);
+
+  QuantityReaders q;
+  q.scalar = [&](const std::string& element, const std::string& qName, const std::vector<double>& values,
+                 DataType type, std::pair<double, double> range) {
+    if (element == "vertex") {
+      s->addVertexScalarQuantity(qName, values, type)->setMapRange(range);
+    } else if (element == "cell") {
+      s->addCellScalarQuantity(qName, values, type)->setMapRange(range);
+    } else {
+      unknownElement(name, element);
+    }
+  };
+  q.color = [&](const std::string& element, const std::string& qName, const std::vector<glm::vec3>& values) {
+    if (element == "vertex") {
+      s->addVertexColorQuantity(qName, values);
+    } else if (element == "cell") {
+      s->addCellColorQuantity(qName, values);
+    } else {
+      unknownElement(name, element);
+    }
+  };
+  q.vector = [&](const std::string& element, const std::string& qName, const std::vector<glm::vec3>& values,
+                 VectorType type) {
+    if (element == "vertex") {
+      s->addVertexVectorQuantity(qName, values, type);
+    } else if (element == "cell") {
+      s->addCellVectorQuantity(qName, values, type);
+    } else {
+      unknownElement(name, element);
+    }
+  };
+  q.read(r, name);
+
+  s->vertexPerm = std::move(perms[0]);
+  s->edgePerm = std::move(perms[1]);
+  s->facePerm = std::move(perms[2]);
+  s->cellPerm = std::move(perms[3]);
+  s->resetPermutationInverses();
+  s->setTransform(transform);
+}
+
+} // namespace
+
+void saveScene(std::string filename) {
+  SceneWriter w(filename, "scene file", true);
+
+  w.value(sceneFileMagic);
+  w.value(sceneFileVersion);
+  w.value(sceneByteOrderCheck);
+  w.value<uint32_t>(sizeof(size_t));
+  w.value<uint32_t>(0);
+
+  writeSettings(w);
+
+  w.string(view::getCameraJson());
+  w.value(view::style);
+  w.value(view::upDir);
+  w.value(view::moveScale);
+  w.value(view::bgColor);
+
+  // The structures which can be saved
+  std::vector<Structure*> saved;
+  std::vector<std::string> skipped;
+  for (std::pair<const std::string, std::map<std::string, Structure*>>& typeMap : state::structures) {
+    for (std::pair<const std::string, Structure*>& entry : typeMap.second) {
+      Structure* s = entry.second;
+      if (dynamic_cast<PointCloud*>(s) || dynamic_cast<SurfaceMesh*>(s) || dynamic_cast<CurveNetwork*>(s) ||
+          dynamic_cast<VolumeMesh*>(s)) {
+        saved.push_back(s);
+      } else {
+        skipped.push_back(s->name);
+      }
+    }
+  }
+
+  w.value<uint64_t>(saved.size());
+  for (Structure* s : saved) {
+    w.string(s->typeName());
+    w.string(s->name);
+    w.value(s->getTransform());
+    if (PointCloud* pc = dynamic_cast<PointCloud*>(s)) {
+      writePointCloud(w, *pc, skipped);
+    } else if (SurfaceMesh* mesh = dynamic_cast<SurfaceMesh*>(s)) {
+      writeSurfaceMesh(w, *mesh, skipped);
+    } else if (CurveNetwork* curve = dynamic_cast<CurveNetwork*>(s)) {
+      writeCurveNetwork(w, *curve, skipped);
+    } else if (VolumeMesh* volume = dynamic_cast<VolumeMesh*>(s)) {
+      writeVolumeMesh(w, *volume, skipped);
+    }
+  }
+  w.finish();
+
+  if (!skipped.empty()) {
+    std::string list;
+    for (const std::string& name : skipped) list += (list.empty() ? "" : ", ") + name;
+    warning("saveScene() skipped structures or quantities it can not save", list);
+  }
+}
+
+void loadScene(std::string filename) {
+  SceneReader r(filename, "scene file", true);
+
+  char magic[8];
+  for (char& c : magic) c = r.value<char>();
+  if (std::memcmp(magic, sceneFileMagic, sizeof(magic)) != 0) {
+    throw std::runtime_error(filename + " is not a scene file");
+  }
+  uint32_t version = r.value<uint32_t>();
+  if (version != sceneFileVersion) {
+    throw std::runtime_error(filename + " is a scene file of version " + std::to_string(version) + ", but this is version " +
+                             std::to_string(sceneFileVersion));
+  }
+  if (r.value<uint32_t>() != sceneByteOrderCheck || r.value<uint32_t>() != sizeof(size_t)) {
+    throw std::runtime_error(filename + " was written on a machine with a different byte order or size_t");
+  }
+  r.value<uint32_t>();
+
+  // Settings go in first, so that the structures created below pick them up from the cache as they are constructed
+  readSettings(r);
+
+  std::string cameraJson = r.string();
+  NavigateStyle style = r.value<NavigateStyle>();
+  UpDir upDir = r.value<UpDir>();
+  double moveScale = r.value<double>();
+  std::array<float, 4> bgColor = r.value<std::array<float, 4>>();
+
+  size_t nStructures = r.value<uint64_t>();
+  for (size_t i = 0; i < nStructures; i++) {
+    std::string typeName = r.string();
+    std::string name = r.string();
+    glm::mat4 transform = r.value<glm::mat4>();
+    if (typeName == PointCloud::structureTypeName) {
+      readPointCloud(r, name, transform);
+    } else if (typeName == SurfaceMesh::structureTypeName) {
+      readSurfaceMesh(r, name, transform);
+    } else if (typeName == CurveNetwork::structureTypeName) {
+      readCurveNetwork(r, name, transform);
+    } else if (typeName == VolumeMesh::structureTypeName) {
+      readVolumeMesh(r, name, transform);
+    } else {
+      throw std::runtime_error("Scene file has structure " + name + " of unknown type " + typeName);
+    }
+  }
+
+  view::style = style;
+  view::upDir = upDir;
+  view::moveScale = moveScale;
+  view::bgColor = bgColor;
+  view::setCameraFromJson(cameraJson, false);
+  requestRedraw();
+}
+
+} // namespace polyscope
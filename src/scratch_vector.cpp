@@ -0,0 +1,69 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/scratch_vector.h"
+
+#include "polyscope/options.h"
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+
+namespace polyscope {
+
+namespace {
+std::mutex scratchMutex;
+long long int scratchCurrentBytes = 0;
+long long int scratchPeakBytes = 0;
+long long int scratchPooledBytes = 0;
+std::set<void (*)()> scratchPoolReleases;
+} // namespace
+
+namespace detail {
+
+void scratchGrew(long long int deltaBytes) {
+  if (deltaBytes == 0) return;
+  std::lock_guard<std::mutex> lock(scratchMutex);
+  scratchCurrentBytes += deltaBytes;
+  scratchPeakBytes = std::max(scratchPeakBytes, scratchCurrentBytes);
+}
+
+bool scratchTryPool(size_t bytes) {
+  std::lock_guard<std::mutex> lock(scratchMutex);
+  long long int newPooled = scratchPooledBytes + static_cast<long long int>(bytes);
+  if (options::scratchMemoryBudget >= 0 && newPooled > options::scratchMemoryBudget) return false;
+  scratchPooledBytes = newPooled;
+  return true;
+}
+
+void scratchUnpooled(size_t bytes) {
+  std::lock_guard<std::mutex> lock(scratchMutex);
+  scratchPooledBytes -= static_cast<long long int>(bytes);
+}
+
+void registerScratchPoolRelease(void (*release)()) {
+  std::lock_guard<std::mutex> lock(scratchMutex);
+  scratchPoolReleases.insert(release);
+}
+
+} // namespace detail
+
+ScratchMemoryStats getScratchMemoryStats() {
+  std::lock_guard<std::mutex> lock(scratchMutex);
+  ScratchMemoryStats stats;
+  stats.currentBytes = static_cast<size_t>(scratchCurrentBytes);
+  stats.peakBytes = static_cast<size_t>(scratchPeakBytes);
+  return stats;
+}
+
+void releaseScratchMemory() {
+  std::set<void (*)()> releases;
+  {
+    std::lock_guard<std::mutex> lock(scratchMutex);
+    releases = scratchPoolReleases;
+  }
+  // (this may create this thread's pool of some type, which registers itself again)
+  for (void (*release)() : releases) {
+    release();
+  }
+}
+
+} // namespace polyscope
@@ -1,13 +1,29 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/screenshot.h"
 
+#include "polyscope/parallel.h"
 #include "polyscope/polyscope.h"
 
 #include "stb_image_write.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
 #include <string>
 
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
 namespace polyscope {
 
 namespace state {
@@ -32,15 +48,42 @@ bool hasExtension(std::string str, std::string ext) {
   }
 }
 
-} // namespace
-
+// One argument of a command run by popen(), quoted so that the shell passes it through unchanged
+std::string shellArgument(const std::string& arg) {
+#ifdef _WIN32
+  // cmd has no escape for a quote inside quotes, but file names can not contain one anyway
+  if (arg.find('"') != std::string::npos) {
+    throw std::runtime_error("recording argument contains a double quote: " + arg);
+  }
+  return "\"" + arg + "\"";
+#else
+  // Inside single quotes nothing is special; a single quote itself ends the quotes, is escaped, and restarts them
+  std::string quoted = "'";
+  for (char c : arg) {
+    if (c == '\'') {
+      quoted += "'\\''";
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "'";
+#endif
+}
 
-void saveImage(std::string name, unsigned char* buffer, int w, int h, int channels) {
+// The stb writer settings are global; set them once from the main thread, before any writer thread reads them
+void configureImageWriter() {
+  static bool configured = false;
+  if (configured) return;
 
   // our buffers are from openGL, so they are flipped
   stbi_flip_vertically_on_write(1);
   stbi_write_png_compression_level = 0;
 
+  configured = true;
+}
+
+void writeImageFile(std::string name, unsigned char* buffer, int w, int h, int channels) {
+
   // Auto-detect filename
   if (hasExtension(name, ".png")) {
     stbi_write_png(name.c_str(), w, h, channels, buffer, channels * w);
@@ -62,7 +105,253 @@ void saveImage(std::string name, unsigned char* buffer, int w, int h, int channe
   }
 }
 
-void screenshot(std::string filename, bool transparentBG) {
+void setOpaqueAlpha(std::vector<unsigned char>& buff, int w, int h) {
+  for (int j = 0; j < h; j++) {
+    for (int i = 0; i < w; i++) {
+      int ind = i + j * w;
+      buff[4 * ind + 3] = std::numeric_limits<unsigned char>::max();
+    }
+  }
+}
+
+// The threads which encode and write queued screenshots
+JobQueue& getScreenshotWriterPool() {
+  static std::unique_ptr<JobQueue> pool(new JobQueue(options::screenshotWriterThreads));
+  return *pool;
+}
+
+// A screenshot which has been rendered, but not yet read back from the GPU
+struct QueuedScreenshot {
+  std::string filename;
+  bool transparentBG;
+  int w, h;
+  std::shared_ptr<render::PendingBufferRead> pendingRead;
+};
+std::deque<QueuedScreenshot> queuedScreenshots;
+
+// At most this many readbacks are in flight; more than that waits for the oldest, so render and readback overlap
+// without letting the queue grow without bound
+const size_t maxQueuedScreenshotReads = 2;
+
+void writeQueuedScreenshot(QueuedScreenshot& shot) {
+  std::vector<unsigned char> buff = shot.pendingRead->getValue();
+  shot.pendingRead.reset();
+
+  std::string filename = shot.filename;
+  bool transparentBG = shot.transparentBG;
+  int w = shot.w;
+  int h = shot.h;
+  std::shared_ptr<std::vector<unsigned char>> data = std::make_shared<std::vector<unsigned char>>(std::move(buff));
+  getScreenshotWriterPool().push([=]() {
+    if (!transparentBG) {
+      setOpaqueAlpha(*data, w, h);
+    }
+    writeImageFile(filename, &(data->front()), w, h, 4);
+  });
+}
+
+const size_t maxStoredBlock = 65535; // bytes in one uncompressed deflate block
+
+// Writes an RGBA8 png a band of rows at a time, so the whole image never has to be in memory. The pixels are stored
+// uncompressed like the other screenshots (stored deflate blocks), one IDAT chunk per band.
+class StreamedPNGWriter {
+public:
+  StreamedPNGWriter(std::string filename, int width, int height)
+      : out(filename, std::ios::binary), width(width), height(height) {
+    if (!out) {
+      throw std::runtime_error("could not open " + filename + " for writing");
+    }
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.write(reinterpret_cast<const char*>(signature), 8);
+
+    std::vector<unsigned char> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    header.insert(header.end(), {8, 6, 0, 0, 0}); // 8 bit RGBA, no interlacing
+    writeChunk("IHDR", header);
+  }
+
+  // Append rows, ordered top to bottom, of width RGBA8 pixels each
+  void writeRows(const unsigned char* rows, int nRows) {
+    size_t rowBytes = 4 * static_cast<size_t>(width);
+    std::vector<unsigned char> raw;
+    raw.reserve(nRows * (rowBytes + 1));
+    for (int j = 0; j < nRows; j++) {
+      raw.push_back(0); // filter: none
+      raw.insert(raw.end(), rows + j * rowBytes, rows + (j + 1) * rowBytes);
+    }
+    adler = adler32(adler, raw);
+
+    std::vector<unsigned char> data;
+    if (!startedStream) {
+      data = {0x78, 0x01}; // zlib header
+      startedStream = true;
+    }
+    for (size_t start = 0; start < raw.size(); start += maxStoredBlock) {
+      size_t len = std::min(maxStoredBlock, raw.size() - start);
+      appendStoredBlockHeader(data, len, false);
+      data.insert(data.end(), raw.begin() + start, raw.begin() + start + len);
+    }
+    writeChunk("IDAT", data);
+    rowsWritten += nRows;
+  }
+
+  // End the image; every row must have been written
+  void finish() {
+    if (rowsWritten != height) {
+      throw std::logic_error("png finished after " + std::to_string(rowsWritten) + " of " + std::to_string(height) +
+                             " rows");
+    }
+    std::vector<unsigned char> data;
+    if (!startedStream) data = {0x78, 0x01};
+    appendStoredBlockHeader(data, 0, true);
+    appendBigEndian(data, adler);
+    writeChunk("IDAT", data);
+    writeChunk("IEND", {});
+    out.close();
+  }
+
+private:
+  std::ofstream out;
+  const int width, height;
+  int rowsWritten = 0;
+  bool startedStream = false;
+  uint32_t adler = 1;
+
+  static void appendBigEndian(std::vector<unsigned char>& data, uint32_t val) {
+    for (int shift = 24; shift >= 0; shift -= 8) data.push_back(static_cast<unsigned char>(val >> shift));
+  }
+
+  static void appendStoredBlockHeader(std::vector<unsigned char>& data, size_t len, bool final) {
+    uint16_t len16 = static_cast<uint16_t>(len);
+    uint16_t nlen16 = static_cast<uint16_t>(~len16);
+    data.insert(data.end(), {static_cast<unsigned char>(final ? 1 : 0), static_cast<unsigned char>(len16 & 0xFF),
+                             static_cast<unsigned char>(len16 >> 8), static_cast<unsigned char>(nlen16 & 0xFF),
+                             static_cast<unsigned char>(nlen16 >> 8)});
+  }
+
+  static uint32_t adler32(uint32_t prev, const std::vector<unsigned char>& data) {
+    uint32_t a = prev & 0xFFFF;
+    uint32_t b = prev >> 16;
+    for (size_t start = 0; start < data.size(); start += 5552) { // the most bytes before the sums can overflow
+      size_t end = std::min(data.size(), start + 5552);
+      for (size_t i = start; i < end; i++) {
+        a += data[i];
+        b += a;
+      }
+      a %= 65521;
+      b %= 65521;
+    }
+    return (b << 16) | a;
+  }
+
+  static uint32_t crc32(const char* type, const std::vector<unsigned char>& data) {
+    static const std::array<uint32_t, 256> table = []() {
+      std::array<uint32_t, 256> t;
+      for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        t[n] = c;
+      }
+      return t;
+    }();
+    uint32_t c = 0xFFFFFFFFu;
+    for (int i = 0; i < 4; i++) c = table[(c ^ static_cast<unsigned char>(type[i])) & 0xFF] ^ (c >> 8);
+    for (unsigned char v : data) c = table[(c ^ v) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+  }
+
+  void writeChunk(const char* type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> lengthAndCRC;
+    appendBigEndian(lengthAndCRC, static_cast<uint32_t>(data.size()));
+    appendBigEndian(lengthAndCRC, crc32(type, data));
+    out.write(reinterpret_cast<const char*>(&lengthAndCRC[0]), 4);
+    out.write(type, 4);
+    if (!data.empty()) out.write(reinterpret_cast<const char*>(&data[0]), data.size());
+    out.write(reinterpret_cast<const char*>(&lengthAndCRC[4]), 4);
+    if (!out) {
+      throw std::runtime_error("failed writing png");
+    }
+  }
+};
+
+// The recording started by startRecording(), if any
+struct Recording {
+  std::string path;
+  bool imageSequence; // else piped to ffmpeg, or handed to sink
+  std::function<void(const std::vector<unsigned char>&, int, int)> sink;
+  int w, h;
+  FILE* pipe = nullptr;
+  std::unique_ptr<JobQueue> writers; // one thread for a pipe, so frames arrive in order
+  std::deque<std::shared_ptr<render::PendingBufferRead>> pendingReads;
+  size_t nFramesCaptured = 0;
+  size_t nFramesDropped = 0;
+  std::atomic<int> nQueuedWrites{0};
+  std::atomic<bool> writeFailed{false};
+};
+std::unique_ptr<Recording> recording;
+
+std::string recordingFrameFilename(const std::string& path, size_t iFrame) {
+  size_t dot = path.find_last_of('.');
+  char buff[20];
+  snprintf(buff, 20, "_%06zu", iFrame);
+  return path.substr(0, dot) + buff + path.substr(dot);
+}
+
+void writeRecordingFrame(Recording& rec) {
+  std::shared_ptr<std::vector<unsigned char>> data =
+      std::make_shared<std::vector<unsigned char>>(rec.pendingReads.front()->getValue());
+  rec.pendingReads.pop_front();
+
+  Recording* recPtr = &rec;
+  size_t iFrame = rec.nFramesCaptured - rec.pendingReads.size() - 1;
+  int w = rec.w;
+  int h = rec.h;
+  rec.nQueuedWrites++;
+  rec.writers->push([=]() {
+    if (recPtr->sink) {
+      recPtr->sink(*data, w, h);
+    } else if (recPtr->imageSequence) {
+      setOpaqueAlpha(*data, w, h);
+      writeImageFile(recordingFrameFilename(recPtr->path, iFrame), &(data->front()), w, h, 4);
+    } else if (!recPtr->writeFailed) {
+      if (std::fwrite(&(data->front()), 1, data->size(), recPtr->pipe) != data->size()) {
+        recPtr->writeFailed = true;
+      }
+    }
+    recPtr->nQueuedWrites--;
+  });
+}
+
+} // namespace
+
+
+void saveImage(std::string name, unsigned char* buffer, int w, int h, int channels) {
+  configureImageWriter();
+  writeImageFile(name, buffer, w, h, channels);
+}
+
+bool haveQueuedScreenshots() { return !queuedScreenshots.empty(); }
+
+void processQueuedScreenshots() {
+  while (!queuedScreenshots.empty() && queuedScreenshots.front().pendingRead->isReady()) {
+    writeQueuedScreenshot(queuedScreenshots.front());
+    queuedScreenshots.pop_front();
+  }
+}
+
+void flushScreenshots() {
+  while (!queuedScreenshots.empty()) {
+    writeQueuedScreenshot(queuedScreenshots.front());
+    queuedScreenshots.pop_front();
+  }
+  getScreenshotWriterPool().wait();
+}
+
+// Render a frame in to the alt display buffer, which is where screenshots are read from. When nothing changed since the
+// scene was last rendered, the rendered scene is reused, and only the lighting transform is applied again (with this
+// screenshot's background). Tiles of a larger image always render, since they change the projection.
+void renderScreenshotFrame(bool transparentBG) {
 
   render::engine->useAltDisplayBuffer = true;
   if (transparentBG) render::engine->lightCopy = true; // copy directly in to buffer without blending
@@ -72,34 +361,156 @@ void screenshot(std::string filename, bool transparentBG) {
 
   // save the redraw requested bit and restore it below
   bool requestedAlready = redrawRequested();
-  requestRedraw();
+  if (state::sceneRenderCount == 0 || view::projectionTile.active) {
+    requestRedraw();
+  }
 
+  internal::finishBackgroundFills = true; // the image shows every structure, even one still loading
   draw(false, false);
+  internal::finishBackgroundFills = false;
 
   if (requestedAlready) {
     requestRedraw();
   }
+}
+
+void finishScreenshotFrame(bool transparentBG) {
+  render::engine->useAltDisplayBuffer = false;
+  if (transparentBG) render::engine->lightCopy = false;
+}
+
+void screenshot(std::string filename, bool transparentBG) {
+
+  renderScreenshotFrame(transparentBG);
 
   // these _should_ always be accurate
+  int w = view::bufferWidth;
+  int h = view::bufferHeight;
+
+  if (options::asyncScreenshots) {
+    // Queue the readback, and leave the rest to processQueuedScreenshots()
+    configureImageWriter();
+    queuedScreenshots.push_back({filename, transparentBG, w, h, render::engine->displayBufferAlt->readBufferAsync()});
+    while (queuedScreenshots.size() > maxQueuedScreenshotReads) {
+      writeQueuedScreenshot(queuedScreenshots.front());
+      queuedScreenshots.pop_front();
+    }
+    processQueuedScreenshots();
+  } else {
+    std::vector<unsigned char> buff = render::engine->displayBufferAlt->readBuffer();
+
+    // Set alpha to 1
+    if (!transparentBG) {
+      setOpaqueAlpha(buff, w, h);
+    }
+
+    // Save to file
+    saveImage(filename, &(buff.front()), w, h, 4);
+  }
+
+  finishScreenshotFrame(transparentBG);
+}
+
+std::vector<unsigned char> renderToBuffer(bool transparentBG) {
+
+  renderScreenshotFrame(transparentBG);
+
   int w = view::bufferWidth;
   int h = view::bufferHeight;
   std::vector<unsigned char> buff = render::engine->displayBufferAlt->readBuffer();
+  finishScreenshotFrame(transparentBG);
 
-  // Set alpha to 1
   if (!transparentBG) {
-    for (int j = 0; j < h; j++) {
-      for (int i = 0; i < w; i++) {
-        int ind = i + j * w;
-        buff[4 * ind + 3] = std::numeric_limits<unsigned char>::max();
+    setOpaqueAlpha(buff, w, h);
+  }
+
+  // openGL rows are bottom-to-top, flip them to the usual image order
+  size_t rowSize = 4 * static_cast<size_t>(w);
+  for (int j = 0; j < h / 2; j++) {
+    std::swap_ranges(buff.begin() + j * rowSize, buff.begin() + (j + 1) * rowSize, buff.begin() + (h - 1 - j) * rowSize);
+  }
+
+  return buff;
+}
+
+void renderTiledScreenshot(std::string filename, int width, int height, bool transparentBG) {
+
+  if (width <= 0 || height <= 0) {
+    error("tiled screenshot size must be positive, got " + std::to_string(width) + " x " + std::to_string(height));
+    return;
+  }
+
+  bool streamPNG = hasExtension(filename, ".png");
+  if (!streamPNG) transparentBG = false;
+
+  // Each tile is rendered at the size of the framebuffer
+  int tileW = view::bufferWidth;
+  int tileH = view::bufferHeight;
+  int nTilesX = (width + tileW - 1) / tileW;
+  int nTilesY = (height + tileH - 1) / tileH;
+  size_t rowBytes = 4 * static_cast<size_t>(width);
+
+  std::unique_ptr<StreamedPNGWriter> pngWriter;
+  std::vector<unsigned char> image; // other formats are assembled in memory, with rows bottom to top like openGL
+  if (streamPNG) {
+    pngWriter.reset(new StreamedPNGWriter(filename, width, height));
+  } else {
+    image.resize(rowBytes * height);
+  }
+
+  view::projectionTile.active = true;
+  view::projectionTile.imageWidth = width;
+  view::projectionTile.imageHeight = height;
+
+  std::vector<unsigned char> band; // one row of tiles, rows ordered top to bottom
+  try {
+    for (int tileY = 0; tileY < nTilesY; tileY++) {
+      int y = tileY * tileH;
+      int bandH = std::min(tileH, height - y);
+      band.assign(rowBytes * bandH, 0);
+
+      for (int tileX = 0; tileX < nTilesX; tileX++) {
+        int x = tileX * tileW;
+        int copyW = std::min(tileW, width - x);
+        view::projectionTile.x = x;
+        view::projectionTile.y = y;
+
+        renderScreenshotFrame(transparentBG);
+        std::vector<unsigned char> tile = render::engine->displayBufferAlt->readBuffer();
+        finishScreenshotFrame(transparentBG);
+
+        // the tile rows are bottom to top; those past the bottom or right of the image are cropped
+        for (int j = 0; j < bandH; j++) {
+          const unsigned char* src = &tile[4 * static_cast<size_t>(tileW) * (tileH - 1 - j)];
+          std::memcpy(&band[j * rowBytes + 4 * static_cast<size_t>(x)], src, 4 * static_cast<size_t>(copyW));
+        }
+      }
+
+      if (!transparentBG) {
+        setOpaqueAlpha(band, width, bandH);
+      }
+
+      if (streamPNG) {
+        pngWriter->writeRows(&band[0], bandH);
+      } else {
+        for (int j = 0; j < bandH; j++) {
+          std::memcpy(&image[(height - 1 - y - j) * rowBytes], &band[j * rowBytes], rowBytes);
+        }
       }
     }
+  } catch (...) {
+    view::projectionTile = view::ProjectionTile();
+    requestRedraw();
+    throw;
   }
+  view::projectionTile = view::ProjectionTile();
+  requestRedraw(); // (the rendered scene is the last tile)
 
-  // Save to file
-  saveImage(filename, &(buff.front()), w, h, 4);
-
-  render::engine->useAltDisplayBuffer = false;
-  if (transparentBG) render::engine->lightCopy = false;
+  if (streamPNG) {
+    pngWriter->finish();
+  } else {
+    saveImage(filename, &image[0], width, height, 4);
+  }
 }
 
 void screenshot(bool transparentBG) {
@@ -120,4 +531,124 @@ void screenshot(bool transparentBG) {
 
 void resetScreenshotIndex() { state::screenshotInd = 0; }
 
+void startRecording(std::string path, double fps, std::string codec) {
+  if (recording) {
+    error("already recording to " + recording->path + ", call stopRecording() first");
+    return;
+  }
+
+  std::unique_ptr<Recording> rec(new Recording());
+  rec->path = path;
+  rec->imageSequence = hasExtension(path, ".png") || hasExtension(path, ".jpg") || hasExtension(path, ".jpeg");
+  rec->w = render::engine->displayBuffer->getSizeX();
+  rec->h = render::engine->displayBuffer->getSizeY();
+
+  if (rec->imageSequence) {
+    configureImageWriter();
+    rec->writers.reset(new JobQueue(options::screenshotWriterThreads));
+  } else {
+    // openGL rows are bottom to top, so ffmpeg flips them. yuv420p needs even dimensions, so odd ones are padded.
+    std::string command = shellArgument(options::ffmpegPath) + " -y -loglevel error -f rawvideo -pix_fmt rgba -s " +
+                          std::to_string(rec->w) + "x" + std::to_string(rec->h) + " -framerate " + std::to_string(fps) +
+                          " -i - -vf " + shellArgument("vflip,pad=ceil(iw/2)*2:ceil(ih/2)*2") + " -c:v " +
+                          shellArgument(codec) + " -pix_fmt yuv420p " + shellArgument(path);
+#ifdef _WIN32
+    // (cmd strips the outermost pair of quotes from a command which starts with one)
+    command = "\"" + command + "\"";
+    rec->pipe = popen(command.c_str(), "wb");
+#else
+    rec->pipe = popen(command.c_str(), "w");
+#endif
+    if (!rec->pipe) {
+      throw std::runtime_error("could not start " + options::ffmpegPath + " to record " + path);
+    }
+    rec->writers.reset(new JobQueue(1));
+  }
+
+  recording = std::move(rec);
+}
+
+void startRecording(std::function<void(const std::vector<unsigned char>& rgba, int w, int h)> sink) {
+  if (recording) {
+    error("already recording to " + recording->path + ", call stopRecording() first");
+    return;
+  }
+
+  std::unique_ptr<Recording> rec(new Recording());
+  rec->path = "(frame sink)";
+  rec->imageSequence = false;
+  rec->sink = std::move(sink);
+  rec->w = render::engine->displayBuffer->getSizeX();
+  rec->h = render::engine->displayBuffer->getSizeY();
+  rec->writers.reset(new JobQueue(1));
+  recording = std::move(rec);
+  requestRedraw(); // (so that the sink gets the current view)
+}
+
+void stopRecording() {
+  if (!recording) return;
+
+  while (!recording->pendingReads.empty()) {
+    writeRecordingFrame(*recording);
+  }
+  recording->writers->wait();
+
+  bool failed = recording->writeFailed;
+  if (recording->pipe && pclose(recording->pipe) != 0) {
+    failed = true;
+  }
+  if (failed) {
+    warning("recording to " + recording->path + " failed", "the encoder " + options::ffmpegPath +
+                                                               " exited early or returned an error");
+  }
+  if (recording->nFramesDropped > 0 && !recording->sink) { // (a sink is expected to fall behind on a slow link)
+    warning("recording dropped " + std::to_string(recording->nFramesDropped) + " of " +
+                std::to_string(recording->nFramesCaptured + recording->nFramesDropped) + " frames",
+            "the writers fell behind, or the window was resized");
+  }
+
+  recording.reset();
+}
+
+bool isRecording() { return recording != nullptr; }
+
+void captureRecordingFrame(bool sceneWasRendered) {
+  if (!recording) return;
+  Recording& rec = *recording;
+
+  // A sink only gets frames which changed, and follows the size of the window
+  if (rec.sink) {
+    if (!sceneWasRendered) return;
+    render::FrameBuffer& frame = *render::engine->displayBuffer;
+    if (static_cast<int>(frame.getSizeX()) != rec.w || static_cast<int>(frame.getSizeY()) != rec.h) {
+      while (!rec.pendingReads.empty()) {
+        writeRecordingFrame(rec);
+      }
+      rec.w = frame.getSizeX();
+      rec.h = frame.getSizeY();
+    }
+  }
+
+  // Drop frames rather than stall when the writers fall behind, or when the frame no longer matches the video size
+  render::FrameBuffer& frame = *render::engine->displayBuffer;
+  if (static_cast<int>(frame.getSizeX()) != rec.w || static_cast<int>(frame.getSizeY()) != rec.h ||
+      rec.nQueuedWrites + static_cast<int>(rec.pendingReads.size()) >= options::recordingMaxQueuedFrames) {
+    rec.nFramesDropped++;
+    return;
+  }
+
+  rec.pendingReads.push_back(frame.readBufferAsync());
+  rec.nFramesCaptured++;
+  while (rec.pendingReads.size() > maxQueuedScreenshotReads) {
+    writeRecordingFrame(rec);
+  }
+}
+
+void processRecordingFrames() {
+  if (!recording) return;
+  while (!recording->pendingReads.empty() && recording->pendingReads.front()->isReady()) {
+    writeRecordingFrame(*recording);
+  }
+}
+
 } // namespace polyscope
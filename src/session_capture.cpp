@@ -0,0 +1,801 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/session_capture.h"
+
+#include "polyscope/binary_file.h"
+#include "polyscope/curve_network.h"
+#include "polyscope/curve_network_color_quantity.h"
+#include "polyscope/curve_network_scalar_quantity.h"
+#include "polyscope/curve_network_vector_quantity.h"
+#include "polyscope/point_cloud.h"
+#include "polyscope/point_cloud_color_quantity.h"
+#include "polyscope/point_cloud_scalar_quantity.h"
+#include "polyscope/point_cloud_vector_quantity.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/surface_color_quantity.h"
+#include "polyscope/surface_mesh.h"
+#include "polyscope/surface_scalar_quantity.h"
+#include "polyscope/surface_vector_quantity.h"
+#include "polyscope/view.h"
+#include "polyscope/volume_mesh.h"
+#include "polyscope/volume_mesh_color_quantity.h"
+#include "polyscope/volume_mesh_scalar_quantity.h"
+#include "polyscope/volume_mesh_vector_quantity.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace polyscope {
+
+const uint32_t sessionFileVersion = 3;
+
+// The layout of a session file. Every value is written in the byte order of the machine. Strings and arrays are
+// prefixed with their length as a uint64. Unlike scene files, arrays are not aligned, since records are appended as the
+// session runs.
+//
+//   header   "pssessn\0", uint32 version, uint32 byte order check, uint32 sizeof(size_t), uint32 zero
+//   records  until the end of the file, each a uint32 kind (SessionRecord), a double of seconds since the capture
+//            started, then the payload of its kind (see the capture functions below)
+
+namespace detail {
+bool sessionCaptureActive = false;
+}
+
+namespace {
+
+const char sessionFileMagic[8] = {'p', 's', 's', 'e', 's', 's', 'n', '\0'};
+const uint32_t sessionByteOrderCheck = 0x01020304;
+
+enum class SessionRecord : uint32_t {
+  Frame = 0,
+  RegisterStructure,
+  RemoveStructure,
+  AddQuantity,
+  RemoveQuantity,
+  MovePositions,
+  Camera,
+  SceneState,
+  Options
+};
+
+using SessionWriter = internal::BinaryWriter;
+using SessionReader = internal::BinaryReader;
+
+// === Capture
+
+struct SessionCapture {
+  std::ofstream out;
+  std::chrono::steady_clock::time_point startTime;
+  SessionWriter records; // not yet written to the file
+
+  // What the last frame saw, so that only changes are logged
+  glm::mat4 viewMat;
+  double fov = -1.;
+  size_t optionsChangeCount = 0;
+  std::vector<char> sceneState;
+
+  std::set<std::string> skipped;
+};
+std::unique_ptr<SessionCapture> capture;
+
+// (records are written out at each frame, or sooner if they pile up)
+const size_t maxBufferedRecordBytes = 1 << 24;
+
+SessionWriter& beginRecord(SessionRecord kind) {
+  SessionWriter& w = capture->records;
+  w.value(kind);
+  w.value(std::chrono::duration<double>(std::chrono::steady_clock::now() - capture->startTime).count());
+  return w;
+}
+
+void writeOutRecords() {
+  std::vector<char>& data = capture->records.data;
+  capture->out.write(data.data(), data.size());
+  data.clear();
+}
+
+void endRecord() {
+  if (capture->records.data.size() > maxBufferedRecordBytes) writeOutRecords();
+}
+
+bool isCapturedType(const std::string& typeName) {
+  return typeName == PointCloud::structureTypeName || typeName == SurfaceMesh::structureTypeName ||
+         typeName == CurveNetwork::structureTypeName || typeName == VolumeMesh::structureTypeName;
+}
+
+template <typename Q>
+void writeScalar(SessionWriter& w, std::string kind, Q* s) {
+  w.string(kind);
+  w.string(s->name);
+  w.value<int32_t>(static_cast<int32_t>(s->dataType));
+  std::pair<double, double> range = s->getMapRange();
+  w.value(range.first);
+  w.value(range.second);
+  w.array(s->values.toDoubles());
+}
+
+void writeValues(SessionWriter& w, std::string kind, std::string name, const std::vector<glm::vec3>& values) {
+  w.string(kind);
+  w.string(name);
+  w.array(values);
+}
+
+void writeVector(SessionWriter& w, std::string kind, std::string name, VectorType type,
+                 const std::vector<glm::vec3>& vectors) {
+  w.string(kind);
+  w.string(name);
+  w.value<int32_t>(static_cast<int32_t>(type));
+  w.array(vectors);
+}
+
+// Writes the kind, name and data of a quantity, or returns false if it can not be captured. The kinds are those of scene
+// files.
+bool writeQuantity(SessionWriter& w, Structure& structure, const std::string& name) {
+  if (PointCloud* s = dynamic_cast<PointCloud*>(&structure)) {
+    PointCloudQuantity* base = s->getQuantity(name);
+    if (PointCloudScalarQuantity* scalar = dynamic_cast<PointCloudScalarQuantity*>(base)) {
+      writeScalar(w, "scalar:point", scalar);
+    } else if (PointCloudColorQuantity* color = dynamic_cast<PointCloudColorQuantity*>(base)) {
+      writeValues(w, "color:point", name, color->values);
+    } else if (PointCloudVectorQuantity* vector = dynamic_cast<PointCloudVectorQuantity*>(base)) {
+      writeVector(w, "vector:point", name, vector->vectorType, vector->vectors);
+    } else {
+      return false;
+    }
+  } else if (SurfaceMesh* s = dynamic_cast<SurfaceMesh*>(&structure)) {
+    SurfaceMeshQuantity* base = s->getQuantity(name);
+    if (SurfaceVertexScalarQuantity* scalar = dynamic_cast<SurfaceVertexScalarQuantity*>(base)) {
+      writeScalar(w, "scalar:vertex", scalar);
+    } else if (SurfaceFaceScalarQuantity* scalar = dynamic_cast<SurfaceFaceScalarQuantity*>(base)) {
+      writeScalar(w, "scalar:face", scalar);
+    } else if (SurfaceEdgeScalarQuantity* scalar = dynamic_cast<SurfaceEdgeScalarQuantity*>(base)) {
+      writeScalar(w, "scalar:edge", scalar);
+    } else if (SurfaceHalfedgeScalarQuantity* scalar = dynamic_cast<SurfaceHalfedgeScalarQuantity*>(base)) {
+      writeScalar(w, "scalar:halfedge", scalar);
+    } else if (SurfaceVertexColorQuantity* color = dynamic_cast<SurfaceVertexColorQuantity*>(base)) {
+      writeValues(w, "color:vertex", name, color->values);
+    } else if (SurfaceFaceColorQuantity* color = dynamic_cast<SurfaceFaceColorQuantity*>(base)) {
+      writeValues(w, "color:face", name, color->values);
+    } else if (SurfaceVertexVectorQuantity* vector = dynamic_cast<SurfaceVertexVectorQuantity*>(base)) {
+      writeVector(w, "vector:vertex", name, vector->vectorType, vector->vectors);
+    } else if (SurfaceFaceVectorQuantity* vector = dynamic_cast<SurfaceFaceVectorQuantity*>(base)) {
+      writeVector(w, "vector:face", name, vector->vectorType, vector->vectors);
+    } else {
+      return false;
+    }
+  } else if (CurveNetwork* s = dynamic_cast<CurveNetwork*>(&structure)) {
+    CurveNetworkQuantity* base = s->getQuantity(name);
+    if (CurveNetworkNodeScalarQuantity* scalar = dynamic_cast<CurveNetworkNodeScalarQuantity*>(base)) {
+      writeScalar(w, "scalar:node", scalar);
+    } else if (CurveNetworkEdgeScalarQuantity* scalar = dynamic_cast<CurveNetworkEdgeScalarQuantity*>(base)) {
+      writeScalar(w, "scalar:edge", scalar);
+    } else if (CurveNetworkNodeColorQuantity* color = dynamic_cast<CurveNetworkNodeColorQuantity*>(base)) {
+      writeValues(w, "color:node", name, color->values);
+    } else if (CurveNetworkEdgeColorQuantity* color = dynamic_cast<CurveNetworkEdgeColorQuantity*>(base)) {
+      writeValues(w, "color:edge", name, color->values);
+    } else if (CurveNetworkNodeVectorQuantity* vector = dynamic_cast<CurveNetworkNodeVectorQuantity*>(base)) {
+      writeVector(w, "vector:node", name, vector->vectorType, vector->vectors);
+    } else if (CurveNetworkEdgeVectorQuantity* vector = dynamic_cast<CurveNetworkEdgeVectorQuantity*>(base)) {
+      writeVector(w, "vector:edge", name, vector->vectorType, vector->vectors);
+    } else {
+      return false;
+    }
+  } else if (VolumeMesh* s = dynamic_cast<VolumeMesh*>(&structure)) {
+    VolumeMeshQuantity* base = s->getQuantity(name);
+    if (VolumeMeshVertexScalarQuantity* scalar = dynamic_cast<VolumeMeshVertexScalarQuantity*>(base)) {
+      writeScalar(w, "scalar:vertex", scalar);
+    } else if (VolumeMeshCellScalarQuantity* scalar = dynamic_cast<VolumeMeshCellScalarQuantity*>(base)) {
+      writeScalar(w, "scalar:cell", scalar);
+    } else if (VolumeMeshVertexColorQuantity* color = dynamic_cast<VolumeMeshVertexColorQuantity*>(base)) {
+      writeValues(w, "color:vertex", name, color->values);
+    } else if (VolumeMeshCellColorQuantity* color = dynamic_cast<VolumeMeshCellColorQuantity*>(base)) {
+      writeValues(w, "color:cell", name, color->values);
+    } else if (VolumeMeshVertexVectorQuantity* vector = dynamic_cast<VolumeMeshVertexVectorQuantity*>(base)) {
+      writeVector(w, "vector:vertex", name, vector->vectorType, vector->vectors);
+    } else if (VolumeMeshCellVectorQuantity* vector = dynamic_cast<VolumeMeshCellVectorQuantity*>(base)) {
+      writeVector(w, "vector:cell", name, vector->vectorType, vector->vectors);
+    } else {
+      return false;
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const std::vector<glm::vec3>* structurePositions(Structure& structure) {
+  if (PointCloud* s = dynamic_cast<PointCloud*>(&structure)) return &s->points;
+  if (SurfaceMesh* s = dynamic_cast<SurfaceMesh*>(&structure)) return &s->vertices;
+  if (CurveNetwork* s = dynamic_cast<CurveNetwork*>(&structure)) return &s->nodes;
+  if (VolumeMesh* s = dynamic_cast<VolumeMesh*>(&structure)) return &s->vertices;
+  return nullptr;
+}
+
+template <typename S>
+void writeQuantityStates(SessionWriter& w, S& s) {
+  w.value<uint64_t>(s.quantities.size());
+  for (auto& entry : s.quantities) {
+    w.string(entry.first);
+    w.value<char>(entry.second->isEnabled());
+  }
+}
+
+// The enabled flags and transforms of the captured structures, and the enabled flags of their quantities
+std::vector<char> sceneState() {
+  SessionWriter w;
+  for (std::pair<const std::string, std::map<std::string, Structure*>>& typeMap : state::structures) {
+    if (!isCapturedType(typeMap.first)) continue;
+    for (std::pair<const std::string, Structure*>& entry : typeMap.second) {
+      Structure* s = entry.second;
+      w.string(typeMap.first);
+      w.string(s->name);
+      w.value<char>(s->isEnabled());
+      w.value(s->getTransform());
+      if (PointCloud* pc = dynamic_cast<PointCloud*>(s)) {
+        writeQuantityStates(w, *pc);
+      } else if (SurfaceMesh* mesh = dynamic_cast<SurfaceMesh*>(s)) {
+        writeQuantityStates(w, *mesh);
+      } else if (CurveNetwork* curve = dynamic_cast<CurveNetwork*>(s)) {
+        writeQuantityStates(w, *curve);
+      } else if (VolumeMesh* volume = dynamic_cast<VolumeMesh*>(s)) {
+        writeQuantityStates(w, *volume);
+      }
+    }
+  }
+  return w.data;
+}
+
+template <typename S>
+std::vector<std::string> quantityNames(S& s) {
+  std::vector<std::string> names;
+  for (auto& entry : s.quantities) names.push_back(entry.first);
+  return names;
+}
+
+} // namespace
+
+namespace detail {
+
+void captureRegisteredStructure(Structure& structure) {
+  SessionWriter geometry;
+  if (PointCloud* s = dynamic_cast<PointCloud*>(&structure)) {
+    geometry.array(s->points);
+  } else if (SurfaceMesh* s = dynamic_cast<SurfaceMesh*>(&structure)) {
+    geometry.array(s->vertices);
+    geometry.array(s->faceIndsEntries);
+    geometry.array(s->faceIndsStart);
+  } else if (CurveNetwork* s = dynamic_cast<CurveNetwork*>(&structure)) {
+    geometry.array(s->nodes);
+    geometry.array(s->edges);
+  } else if (VolumeMesh* s = dynamic_cast<VolumeMesh*>(&structure)) {
+    geometry.array(s->vertices);
+    geometry.array(s->cellIndsEntries);
+    geometry.array(s->cellIndsStart);
+    geometry.value<uint64_t>(s->uniformCellDegree);
+  } else {
+    capture->skipped.insert(structure.name);
+    return;
+  }
+
+  SessionWriter& w = beginRecord(SessionRecord::RegisterStructure);
+  w.string(structure.typeName());
+  w.string(structure.name);
+  w.value(structure.getTransform());
+  w.append(geometry);
+  endRecord();
+}
+
+void captureRemovedStructure(const std::string& typeName, const std::string& name) {
+  if (!isCapturedType(typeName)) return;
+  SessionWriter& w = beginRecord(SessionRecord::RemoveStructure);
+  w.string(typeName);
+  w.string(name);
+  endRecord();
+}
+
+void captureAddedQuantity(Structure& s, const std::string& quantityName) {
+  if (!isCapturedType(s.typeName())) return; // (the structure was skipped)
+  SessionWriter quantity;
+  if (!writeQuantity(quantity, s, quantityName)) {
+    capture->skipped.insert(s.name + " / " + quantityName);
+    return;
+  }
+
+  SessionWriter& w = beginRecord(SessionRecord::AddQuantity);
+  w.string(s.typeName());
+  w.string(s.name);
+  w.append(quantity);
+  endRecord();
+}
+
+void captureRemovedQuantity(Structure& s, const std::string& quantityName) {
+  if (!isCapturedType(s.typeName())) return;
+  SessionWriter& w = beginRecord(SessionRecord::RemoveQuantity);
+  w.string(s.typeName());
+  w.string(s.name);
+  w.string(quantityName);
+  endRecord();
+}
+
+void captureMovedPositions(Structure& s, const std::vector<size_t>* movedIndices) {
+  const std::vector<glm::vec3>* positions = structurePositions(s);
+  if (positions == nullptr) return;
+
+  SessionWriter& w = beginRecord(SessionRecord::MovePositions);
+  w.string(s.typeName());
+  w.string(s.name);
+  if (movedIndices == nullptr) {
+    w.value<char>(false);
+    w.array(*positions);
+  } else {
+    std::vector<glm::vec3> moved(movedIndices->size());
+    for (size_t i = 0; i < movedIndices->size(); i++) moved[i] = (*positions)[(*movedIndices)[i]];
+    w.value<char>(true);
+    w.array(*movedIndices);
+    w.array(moved);
+  }
+  endRecord();
+}
+
+void captureFrame() {
+  SessionCapture& c = *capture;
+
+  if (view::viewMat != c.viewMat || view::fov != c.fov) {
+    SessionWriter& w = beginRecord(SessionRecord::Camera);
+    w.value(view::viewMat);
+    w.value(view::fov);
+    c.viewMat = view::viewMat;
+    c.fov = view::fov;
+  }
+
+  if (options::changeCount != c.optionsChangeCount) {
+    SessionWriter& w = beginRecord(SessionRecord::Options);
+    w.value(options::groundPlaneMode.get());
+    w.value(options::shadowBlurIters.get());
+    w.value(options::shadowDarkness.get());
+    w.value(options::ssaaFactor.get());
+    w.value(options::msaaSamples.get());
+    w.value(options::temporalAntiAliasingFrames.get());
+    w.value(options::transparencyMode.get());
+    w.value(options::transparencyRenderPasses.get());
+    c.optionsChangeCount = options::changeCount;
+  }
+
+  std::vector<char> state = sceneState();
+  if (state != c.sceneState) {
+    SessionWriter& w = beginRecord(SessionRecord::SceneState);
+    w.array(state);
+    c.sceneState = std::move(state);
+  }
+
+  beginRecord(SessionRecord::Frame);
+  writeOutRecords();
+}
+
+} // namespace detail
+
+void startSessionCapture(std::string filename) {
+  stopSessionCapture();
+
+  capture.reset(new SessionCapture());
+  capture->out.open(filename, std::ios::binary);
+  if (!capture->out) {
+    capture.reset();
+    error("Could not open session file " + filename + " for writing");
+    return;
+  }
+  capture->startTime = std::chrono::steady_clock::now();
+
+  SessionWriter& w = capture->records;
+  w.value(sessionFileMagic);
+  w.value(sessionFileVersion);
+  w.value(sessionByteOrderCheck);
+  w.value<uint32_t>(sizeof(size_t));
+  w.value<uint32_t>(0);
+
+  // The scene so far, as if it were registered now
+  for (std::pair<const std::string, std::map<std::string, Structure*>>& typeMap : state::structures) {
+    for (std::pair<const std::string, Structure*>& entry : typeMap.second) {
+      Structure* s = entry.second;
+      detail::captureRegisteredStructure(*s);
+      std::vector<std::string> names;
+      if (PointCloud* pc = dynamic_cast<PointCloud*>(s)) {
+        names = quantityNames(*pc);
+      } else if (SurfaceMesh* mesh = dynamic_cast<SurfaceMesh*>(s)) {
+        names = quantityNames(*mesh);
+      } else if (CurveNetwork* curve = dynamic_cast<CurveNetwork*>(s)) {
+        names = quantityNames(*curve);
+      } else if (VolumeMesh* volume = dynamic_cast<VolumeMesh*>(s)) {
+        names = quantityNames(*volume);
+      }
+      for (const std::string& name : names) detail::captureAddedQuantity(*s, name);
+    }
+  }
+  writeOutRecords();
+
+  detail::sessionCaptureActive = true;
+}
+
+void stopSessionCapture() {
+  if (!capture) return;
+  detail::sessionCaptureActive = false;
+
+  writeOutRecords();
+  capture->out.close();
+  bool failed = !capture->out;
+  std::set<std::string> skipped = std::move(capture->skipped);
+  capture.reset();
+
+  if (failed) {
+    error("Could not write session file");
+  }
+  if (!skipped.empty()) {
+    std::string list;
+    for (const std::string& name : skipped) list += (list.empty() ? "" : ", ") + name;
+    warning("session capture skipped structures or quantities it can not capture", list);
+  }
+}
+
+bool isCapturingSession() { return capture != nullptr; }
+
+// === Replay
+
+namespace {
+
+Structure* replayTarget(SessionReader& r) {
+  std::string typeName = r.string();
+  std::string name = r.string();
+  Structure* s = getStructure(typeName, name);
+  if (s == nullptr) {
+    throw std::runtime_error("Session file refers to " + typeName + " " + name + ", which is not registered");
+  }
+  return s;
+}
+
+void unknownElement(Structure* s, const std::string& element) {
+  throw std::runtime_error("Session file has a quantity on " + s->name + " defined on unknown element " + element);
+}
+
+void replayRegisterStructure(SessionReader& r) {
+  std::string typeName = r.string();
+  std::string name = r.string();
+  glm::mat4 transform = r.value<glm::mat4>();
+
+  Structure* s;
+  if (typeName == PointCloud::structureTypeName) {
+    s = new PointCloud(name, r.array<glm::vec3>());
+  } else if (typeName == SurfaceMesh::structureTypeName) {
+    std::vector<glm::vec3> vertices = r.array<glm::vec3>();
+    std::vector<uint32_t> faceIndsEntries = r.array<uint32_t>();
+    std::vector<size_t> faceIndsStart = r.array<size_t>();
+    s = new SurfaceMesh(name, vertices, std::move(faceIndsEntries), std::move(faceIndsStart));
+  } else if (typeName == CurveNetwork::structureTypeName) {
+    std::vector<glm::vec3> nodes = r.array<glm::vec3>();
+    std::vector<std::array<size_t, 2>> edges = r.array<std::array<size_t, 2>>();
+    s = new CurveNetwork(name, std::move(nodes), std::move(edges));
+  } else if (typeName == VolumeMesh::structureTypeName) {
+    std::vector<glm::vec3> vertices = r.array<glm::vec3>();
+    std::vector<uint32_t> cellIndsEntries = r.array<uint32_t>();
+    std::vector<uint32_t> cellIndsStart = r.array<uint32_t>();
+    size_t uniformCellDegree = r.value<uint64_t>();
+    s = new VolumeMesh(name, vertices, std::move(cellIndsEntries), std::move(cellIndsStart), uniformCellDegree);
+  } else {
+    throw std::runtime_error("Session file has structure " + name + " of unknown type " + typeName);
+  }
+  registerStructure(s);
+  s->setTransform(transform);
+}
+
+void replayAddScalar(Structure* structure, const std::string& element, const std::string& name,
+                     const std::vector<double>& values, DataType type, std::pair<double, double> range) {
+  if (PointCloud* s = dynamic_cast<PointCloud*>(structure)) {
+    if (element != "point") unknownElement(structure, element);
+    s->addScalarQuantity(name, values, type)->setMapRange(range);
+  } else if (SurfaceMesh* s = dynamic_cast<SurfaceMesh*>(structure)) {
+    if (element == "vertex") {
+      s->addVertexScalarQuantity(name, values, type)->setMapRange(range);
+    } else if (element == "face") {
+      s->addFaceScalarQuantity(name, values, type)->setMapRange(range);
+    } else if (element == "edge") {
+      s->addEdgeScalarQuantity(name, values, type)->setMapRange(range);
+    } else if (element == "halfedge") {
+      s->addHalfedgeScalarQuantity(name, values, type)->setMapRange(range);
+    } else {
+      unknownElement(structure, element);
+    }
+  } else if (CurveNetwork* s = dynamic_cast<CurveNetwork*>(structure)) {
+    if (element == "node") {
+      s->addNodeScalarQuantity(name, values, type)->setMapRange(range);
+    } else if (element == "edge") {
+      s->addEdgeScalarQuantity(name, values, type)->setMapRange(range);
+    } else {
+      unknownElement(structure, element);
+    }
+  } else if (VolumeMesh* s = dynamic_cast<VolumeMesh*>(structure)) {
+    if (element == "vertex") {
+      s->addVertexScalarQuantity(name, values, type)->setMapRange(range);
+    } else if (element == "cell") {
+      s->addCellScalarQuantity(name, values, type)->setMapRange(range);
+    } else {
+      unknownElement(structure, element);
+    }
+  }
+}
+
+void replayAddColor(Structure* structure, const std::string& element, const std::string& name,
+                    const std::vector<glm::vec3>& values) {
+  if (PointCloud* s = dynamic_cast<PointCloud*>(structure)) {
+    if (element != "point") unknownElement(structure, element);
+    s->addColorQuantity(name, values);
+  } else if (SurfaceMesh* s = dynamic_cast<SurfaceMesh*>(structure)) {
+    if (element == "vertex") {
+      s->addVertexColorQuantity(name, values);
+    } else if (element == "face") {
+      s->addFaceColorQuantity(name, values);
+    } else {
+      unknownElement(structure, element);
+    }
+  } else if (CurveNetwork* s = dynamic_cast<CurveNetwork*>(structure)) {
+    if (element == "node") {
+      s->addNodeColorQuantity(name, values);
+    } else if (element == "edge") {
+      s->addEdgeColorQuantity(name, values);
+    } else {
+      unknownElement(structure, element);
+    }
+  } else if (VolumeMesh* s = dynamic_cast<VolumeMesh*>(structure)) {
+    if (element == "vertex") {
+      s->addVertexColorQuantity(name, values);
+    } else if (element == "cell") {
+      s->addCellColorQuantity(name, values);
+    } else {
+      unknownElement(structure, element);
+    }
+  }
+}
+
+void replayAddVector(Structure* structure, const std::string& element, const std::string& name,
+                     const std::vector<glm::vec3>& vectors, VectorType type) {
+  if (PointCloud* s = dynamic_cast<PointCloud*>(structure)) {
+    if (element != "point") unknownElement(structure, element);
+    s->addVectorQuantity(name, vectors, type);
+  } else if (SurfaceMesh* s = dynamic_cast<SurfaceMesh*>(structure)) {
+    if (element == "vertex") {
+      s->addVertexVectorQuantity(name, vectors, type);
+    } else if (element == "face") {
+      s->addFaceVectorQuantity(name, vectors, type);
+    } else {
+      unknownElement(structure, element);
+    }
+  } else if (CurveNetwork* s = dynamic_cast<CurveNetwork*>(structure)) {
+    if (element == "node") {
+      s->addNodeVectorQuantity(name, vectors, type);
+    } else if (element == "edge") {
+      s->addEdgeVectorQuantity(name, vectors, type);
+    } else {
+      unknownElement(structure, element);
+    }
+  } else if (VolumeMesh* s = dynamic_cast<VolumeMesh*>(structure)) {
+    if (element == "vertex") {
+      s->addVertexVectorQuantity(name, vectors, type);
+    } else if (element == "cell") {
+      s->addCellVectorQuantity(name, vectors, type);
+    } else {
+      unknownElement(structure, element);
+    }
+  }
+}
+
+void replayAddQuantity(SessionReader& r) {
+  Structure* s = replayTarget(r);
+  std::string kind = r.string();
+  std::string name = r.string();
+  std::string family = kind.substr(0, kind.find(':'));
+  std::string element = kind.find(':') == std::string::npos ? "" : kind.substr(kind.find(':') + 1);
+  if (family == "scalar") {
+    DataType type = static_cast<DataType>(r.value<int32_t>());
+    std::pair<double, double> range;
+    range.first = r.value<double>();
+    range.second = r.value<double>();
+    replayAddScalar(s, element, name, r.array<double>(), type, range);
+  } else if (family == "color") {
+    replayAddColor(s, element, name, r.array<glm::vec3>());
+  } else if (family == "vector") {
+    VectorType type = static_cast<VectorType>(r.value<int32_t>());
+    replayAddVector(s, element, name, r.array<glm::vec3>(), type);
+  } else {
+    throw std::runtime_error("Session file has quantity " + name + " on " + s->name + " of unknown kind " + kind);
+  }
+}
+
+void replayRemoveQuantity(SessionReader& r) {
+  Structure* s = replayTarget(r);
+  std::string name = r.string();
+  if (PointCloud* pc = dynamic_cast<PointCloud*>(s)) {
+    pc->removeQuantity(name);
+  } else if (SurfaceMesh* mesh = dynamic_cast<SurfaceMesh*>(s)) {
+    mesh->removeQuantity(name);
+  } else if (CurveNetwork* curve = dynamic_cast<CurveNetwork*>(s)) {
+    curve->removeQuantity(name);
+  } else if (VolumeMesh* volume = dynamic_cast<VolumeMesh*>(s)) {
+    volume->removeQuantity(name);
+  }
+}
+
+void replayMovePositions(SessionReader& r) {
+  Structure* structure = replayTarget(r);
+  bool subset = r.value<char>();
+  std::vector<size_t> indices;
+  if (subset) indices = r.array<size_t>();
+  std::vector<glm::vec3> positions = r.array<glm::vec3>();
+
+  if (PointCloud* s = dynamic_cast<PointCloud*>(structure)) {
+    if (subset) {
+      s->updatePointPositions(indices, positions);
+    } else {
+      s->updatePointPositions(positions);
+    }
+  } else if (SurfaceMesh* s = dynamic_cast<SurfaceMesh*>(structure)) {
+    if (subset) {
+      s->updateVertexPositions(indices, positions);
+    } else {
+      s->updateVertexPositions(positions);
+    }
+  } else if (CurveNetwork* s = dynamic_cast<CurveNetwork*>(structure)) {
+    if (subset) {
+      s->updateNodePositions(indices, positions);
+    } else {
+      s->updateNodePositions(positions);
+    }
+  } else if (VolumeMesh* s = dynamic_cast<VolumeMesh*>(structure)) {
+    if (subset) {
+      s->updateVertexPositions(indices, positions);
+    } else {
+      s->updateVertexPositions(positions);
+    }
+  }
+}
+
+template <typename S>
+void setQuantityEnabled(S& s, const std::string& name, bool enabled) {
+  typename S::QuantityType* q = s.getQuantity(name);
+  if (q != nullptr && q->isEnabled() != enabled) q->setEnabled(enabled);
+}
+
+void replaySceneState(SessionReader& r) {
+  std::vector<char> data = r.array<char>();
+  SessionReader state(std::move(data), "session file");
+  while (!state.atEnd()) {
+    Structure* s = replayTarget(state);
+    bool enabled = state.value<char>();
+    glm::mat4 transform = state.value<glm::mat4>();
+    if (s->isEnabled() != enabled) s->setEnabled(enabled);
+    if (s->getTransform() != transform) s->setTransform(transform);
+
+    size_t nQuantities = state.value<uint64_t>();
+    for (size_t i = 0; i < nQuantities; i++) {
+      std::string name = state.string();
+      bool quantityEnabled = state.value<char>();
+      if (PointCloud* pc = dynamic_cast<PointCloud*>(s)) {
+        setQuantityEnabled(*pc, name, quantityEnabled);
+      } else if (SurfaceMesh* mesh = dynamic_cast<SurfaceMesh*>(s)) {
+        setQuantityEnabled(*mesh, name, quantityEnabled);
+      } else if (CurveNetwork* curve = dynamic_cast<CurveNetwork*>(s)) {
+        setQuantityEnabled(*curve, name, quantityEnabled);
+      } else if (VolumeMesh* volume = dynamic_cast<VolumeMesh*>(s)) {
+        setQuantityEnabled(*volume, name, quantityEnabled);
+      }
+    }
+  }
+}
+
+void replayOptions(SessionReader& r) {
+  options::groundPlaneMode = r.value<GroundPlaneMode>();
+  options::shadowBlurIters = r.value<int>();
+  options::shadowDarkness = r.value<float>();
+  options::ssaaFactor = r.value<int>();
+  options::msaaSamples = r.value<int>();
+  options::temporalAntiAliasingFrames = r.value<int>();
+  options::transparencyMode = r.value<TransparencyMode>();
+  options::transparencyRenderPasses = r.value<int>();
+}
+
+void replayCamera(SessionReader& r) {
+  CameraParameters camera;
+  camera.E = r.value<glm::mat4>();
+  camera.fov = static_cast<float>(r.value<double>());
+  view::setViewToCamera(camera);
+}
+
+} // namespace
+
+SessionReplayStats replaySession(std::string filename, bool realTime) {
+  checkInitialized();
+  SessionReader r(filename, "session file");
+
+  char magic[8];
+  for (char& c : magic) c = r.value<char>();
+  if (std::memcmp(magic, sessionFileMagic, sizeof(magic)) != 0) {
+    throw std::runtime_error(filename + " is not a session file");
+  }
+  uint32_t version = r.value<uint32_t>();
+  if (version != sessionFileVersion) {
+    throw std::runtime_error(filename + " is a session file of version " + std::to_string(version) +
+                             ", but this is version " + std::to_string(sessionFileVersion));
+  }
+  if (r.value<uint32_t>() != sessionByteOrderCheck || r.value<uint32_t>() != sizeof(size_t)) {
+    throw std::runtime_error(filename + " was written on a machine with a different byte order or size_t");
+  }
+  r.value<uint32_t>();
+
+  SessionReplayStats stats;
+  resetFrameStats();
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  while (!r.atEnd()) {
+    SessionRecord kind = r.value<SessionRecord>();
+    double time = r.value<double>();
+    stats.capturedSeconds = time;
+    if (realTime) {
+      std::this_thread::sleep_until(startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                    std::chrono::duration<double>(time)));
+    }
+
+    std::chrono::steady_clock::time_point recordStart = std::chrono::steady_clock::now();
+    switch (kind) {
+    case SessionRecord::Frame:
+      requestRedraw();
+      show(1);
+      break;
+    case SessionRecord::RegisterStructure:
+      replayRegisterStructure(r);
+      break;
+    case SessionRecord::RemoveStructure: {
+      std::string typeName = r.string();
+      std::string name = r.string();
+      removeStructure(typeName, name, false);
+      break;
+    }
+    case SessionRecord::AddQuantity:
+      replayAddQuantity(r);
+      break;
+    case SessionRecord::RemoveQuantity:
+      replayRemoveQuantity(r);
+      break;
+    case SessionRecord::MovePositions:
+      replayMovePositions(r);
+      break;
+    case SessionRecord::Camera:
+      replayCamera(r);
+      break;
+    case SessionRecord::SceneState:
+      replaySceneState(r);
+      break;
+    case SessionRecord::Options:
+      replayOptions(r);
+      break;
+    default:
+      throw std::runtime_error(filename + " has a record of unknown kind " +
+                               std::to_string(static_cast<uint32_t>(kind)));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - recordStart).count();
+
+    if (kind == SessionRecord::Frame) {
+      stats.nFrames++;
+      stats.frameSeconds += seconds;
+    } else {
+      stats.nCalls++;
+      stats.callSeconds += seconds;
+    }
+  }
+
+  stats.frameStats = getFrameStats();
+  return stats;
+}
+
+} // namespace polyscope
@@ -0,0 +1,70 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/shared_vertex_positions.h"
+
+#include "polyscope/dirty_ranges.h"
+#include "polyscope/messages.h"
+#include "polyscope/polyscope.h"
+
+#include <algorithm>
+
+namespace polyscope {
+
+SharedVertexPositions::SharedVertexPositions(std::vector<glm::vec3> positions_) : positions(std::move(positions_)) {}
+
+std::shared_ptr<render::AttributeBuffer> SharedVertexPositions::getRenderBuffer() {
+  if (!renderBuffer) {
+    renderBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    renderBuffer->setData(positions);
+  }
+  return renderBuffer;
+}
+
+void SharedVertexPositions::addUser(const void* user, MovedCallback callback) {
+  users.emplace_back(user, std::move(callback));
+}
+
+void SharedVertexPositions::removeUser(const void* user) {
+  users.erase(std::remove_if(users.begin(), users.end(),
+                             [&](const std::pair<const void*, MovedCallback>& u) { return u.first == user; }),
+              users.end());
+}
+
+void SharedVertexPositions::updateVertexPositionsImpl(std::vector<glm::vec3> newPositions) {
+  positions = std::move(newPositions);
+  if (renderBuffer) {
+    renderBuffer->setData(positions, true);
+  }
+  for (std::pair<const void*, MovedCallback>& u : users) {
+    u.second(nullptr);
+  }
+  requestRedraw();
+}
+
+void SharedVertexPositions::updateVertexPositionsImpl(const std::vector<size_t>& indices,
+                                                      const std::vector<glm::vec3>& newPositions) {
+  for (size_t iV : indices) {
+    if (iV >= size()) {
+      error("updateVertexPositions() on shared vertex positions was passed vertex index " + std::to_string(iV) +
+            ", but there are only " + std::to_string(size()) + " vertices");
+      return;
+    }
+  }
+
+  DirtyRanges moved;
+  for (size_t i = 0; i < indices.size(); i++) {
+    positions[indices[i]] = newPositions[i];
+    moved.mark(indices[i]);
+  }
+  if (renderBuffer) {
+    for (const std::pair<size_t, size_t>& r : moved.coalesced()) {
+      std::vector<glm::vec3> rangeData(positions.begin() + r.first, positions.begin() + r.second);
+      renderBuffer->setData(rangeData, true, static_cast<int>(r.first), static_cast<int>(r.second - r.first));
+    }
+  }
+  for (std::pair<const void*, MovedCallback>& u : users) {
+    u.second(&indices);
+  }
+  requestRedraw();
+}
+
+} // namespace polyscope
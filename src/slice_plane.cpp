@@ -2,12 +2,10 @@
 
 #include "polyscope/polyscope.h"
 #include "polyscope/volume_mesh.h"
+#include "polyscope/volume_mesh_slice.h"
 
 namespace polyscope {
 
-// NOTE: Unfortunately, the logic here and in the engine depends on the names constructed from the postfix being
-// identical.
-
 namespace {
 // storage for slice planes "owned" by the scene itself
 // note: it would be nice for these to be unique_ptr<>, but unfortunately we fall in to a bad design trap---since
@@ -22,6 +20,11 @@ std::vector<SlicePlane*> sceneSlicePlanes;
 bool openSlicePlaneMenu = false;
 
 SlicePlane* addSceneSlicePlane(bool initiallyVisible) {
+  if (state::slicePlanes.size() >= render::MAX_SLICE_PLANES) {
+    error("cannot add slice plane, at most " + std::to_string(render::MAX_SLICE_PLANES) +
+          " slice planes can exist at once");
+    return nullptr;
+  }
   size_t nPlanes = sceneSlicePlanes.size();
   std::string newName = "Scene Slice Plane " + std::to_string(nPlanes);
   sceneSlicePlanes.emplace_back(new SlicePlane(newName));
@@ -82,8 +85,8 @@ SlicePlane::SlicePlane(std::string name_)
       gridLineColor("SlicePlane#" + name + "#gridLineColor", glm::vec3{.97, .97, .97}),
       transparency("SlicePlane#" + name + "#transparency", 0.5), shouldInspectMesh(false), inspectedMeshName(""),
       transformGizmo("SlicePlane#" + name + "#transformGizmo", objectTransform.get(), &objectTransform) {
+  render::engine->addSlicePlane(); // first, since it throws if there are already too many planes
   state::slicePlanes.push_back(this);
-  render::engine->addSlicePlane(postfix);
   transformGizmo.enabled = true;
   prepare();
 }
@@ -91,7 +94,7 @@ SlicePlane::SlicePlane(std::string name_)
 SlicePlane::~SlicePlane() {
   ensureVolumeInspectValid();
   setVolumeMeshToInspect(""); // disable any slicing
-  render::engine->removeSlicePlane(postfix);
+  render::engine->removeSlicePlane();
   auto pos = std::find(state::slicePlanes.begin(), state::slicePlanes.end(), this);
   if (pos == state::slicePlanes.end()) return;
   state::slicePlanes.erase(pos);
@@ -131,7 +134,7 @@ void SlicePlane::setVolumeMeshToInspect(std::string meshname) {
   if (meshToInspect == nullptr) {
     inspectedMeshName = "";
     shouldInspectMesh = false;
-    volumeInspectProgram.reset();
+    volumeInspectSlice.reset();
     return;
   }
   drawPlane = false;
@@ -139,7 +142,7 @@ void SlicePlane::setVolumeMeshToInspect(std::string meshname) {
   meshToInspect->setCullWholeElements(false);
   meshToInspect->ensureHaveTets(); // do this as early as possible because it is expensive
   shouldInspectMesh = true;
-  volumeInspectProgram.reset();
+  volumeInspectSlice.reset();
 }
 
 std::string SlicePlane::getVolumeMeshToInspect() { return inspectedMeshName; }
@@ -153,45 +156,17 @@ void SlicePlane::ensureVolumeInspectValid() {
   if (!hasVolumeMesh(inspectedMeshName)) {
     inspectedMeshName = "";
     shouldInspectMesh = false;
-    volumeInspectProgram = nullptr;
+    volumeInspectSlice.reset();
   }
 }
 
-void SlicePlane::createVolumeSliceProgram() {
+void SlicePlane::createVolumeSlice() {
   VolumeMesh* meshToInspect = polyscope::getVolumeMesh(inspectedMeshName);
-  volumeInspectProgram = render::engine->requestShader(
-      "SLICE_TETS", meshToInspect->addVolumeMeshRules({"SLICE_TETS_BASECOLOR_SHADE"}, true, true));
-  meshToInspect->fillSliceGeometryBuffers(*volumeInspectProgram);
-  render::engine->setMaterial(*volumeInspectProgram, meshToInspect->getMaterial());
+  volumeInspectSlice.reset(
+      new VolumeMeshSlice(*meshToInspect, {}, {"SLICE_TETS_BASECOLOR_SHADE"}, meshToInspect->gpuMemory));
 }
 
-void SlicePlane::resetVolumeSliceProgram() { volumeInspectProgram.reset(); }
-
-void SlicePlane::setSliceAttributes(render::ShaderProgram& p) {
-  VolumeMesh* meshToInspect = polyscope::getVolumeMesh(inspectedMeshName);
-  std::vector<glm::vec3> point1;
-  std::vector<glm::vec3> point2;
-  std::vector<glm::vec3> point3;
-  std::vector<glm::vec3> point4;
-  size_t cellCount = meshToInspect->nCells();
-  point1.resize(cellCount);
-  point2.resize(cellCount);
-  point3.resize(cellCount);
-  point4.resize(cellCount);
-  for (size_t iC = 0; iC < cellCount; iC++) {
-    const std::array<int64_t, 8>& cell = meshToInspect->cells[iC];
-    point1[iC] = meshToInspect->vertices[cell[0]];
-    point2[iC] = meshToInspect->vertices[cell[1]];
-    point3[iC] = meshToInspect->vertices[cell[2]];
-    point4[iC] = meshToInspect->vertices[cell[3]];
-  }
-  glm::vec3 normal = glm::vec3(-1, 0, 0);
-
-  p.setAttribute("a_slice_1", point1);
-  p.setAttribute("a_slice_2", point2);
-  p.setAttribute("a_slice_3", point3);
-  p.setAttribute("a_slice_4", point4);
-}
+void SlicePlane::resetVolumeSliceProgram() { volumeInspectSlice.reset(); }
 
 void SlicePlane::drawGeometry() {
   if (!active.get()) return;
@@ -209,18 +184,18 @@ void SlicePlane::drawGeometry() {
 
     if (vMesh->wantsCullPosition()) return;
 
-    if (volumeInspectProgram == nullptr) {
-      createVolumeSliceProgram();
+    if (volumeInspectSlice == nullptr) {
+      createVolumeSlice();
     }
 
 
     if (vMesh->dominantQuantity == nullptr) {
-      vMesh->setStructureUniforms(*volumeInspectProgram);
-      setSceneObjectUniforms(*volumeInspectProgram, true);
-      setSliceGeomUniforms(*volumeInspectProgram);
-      vMesh->setVolumeMeshUniforms(*volumeInspectProgram);
-      volumeInspectProgram->setUniform("u_baseColor1", vMesh->getColor());
-      volumeInspectProgram->draw();
+      render::ShaderProgram& p = volumeInspectSlice->getDrawProgram();
+      vMesh->setStructureUniforms(p);
+      setSceneObjectUniforms(p, true);
+      vMesh->setVolumeMeshUniforms(p);
+      p.setUniform("u_baseColor1", vMesh->getColor());
+      volumeInspectSlice->draw(this);
     }
 
     for (auto it = vMesh->quantities.begin(); it != vMesh->quantities.end(); it++) {
@@ -323,24 +298,64 @@ void SlicePlane::buildGUI() {
   ImGui::PopID();
 }
 
+namespace {
+
+// The slice plane uniforms of a program, looked up once for each program (see ShaderProgram::userData()). Those a
+// program does not have are invalid.
+struct SlicePlaneUniformHandles {
+  SlicePlaneUniformHandles(render::ShaderProgram& p)
+      : count(p.getUniformHandle("u_slicePlaneCount")), ignoreMask(p.getUniformHandle("u_slicePlaneIgnoreMask")) {
+    if (count.isValid()) {
+      for (int i = 0; i < render::MAX_SLICE_PLANES; i++) {
+        planes[i] = p.getUniformHandle("u_slicePlanes[" + std::to_string(i) + "]");
+      }
+    }
+  }
+
+  render::ShaderUniformHandle count, ignoreMask;
+  std::array<render::ShaderUniformHandle, render::MAX_SLICE_PLANES> planes; // the entries of u_slicePlanes
+};
+
+} // namespace
+
 void SlicePlane::setSceneObjectUniforms(render::ShaderProgram& p, bool alwaysPass) {
-  if (!p.hasUniform("u_slicePlaneNormal_" + postfix)) {
+  auto pos = std::find(state::slicePlanes.begin(), state::slicePlanes.end(), this);
+  if (pos == state::slicePlanes.end()) return;
+  const SlicePlaneUniformHandles& h = p.userData<SlicePlaneUniformHandles>();
+  render::ShaderUniformHandle planeHandle = h.planes[pos - state::slicePlanes.begin()];
+  if (!planeHandle.isValid()) {
     return;
   }
+  p.setUniform(planeHandle, viewSpacePlane(alwaysPass));
+}
 
-  glm::vec3 normal, center;
-
+glm::vec4 SlicePlane::viewSpacePlane(bool alwaysPass) {
   if (alwaysPass) {
-    normal = glm::vec3{-1., 0., 0.};
-    center = glm::vec3{std::numeric_limits<float>::infinity(), 0., 0.};
-  } else {
-    glm::mat4 viewMat = view::getCameraViewMatrix();
-    normal = glm::vec3(viewMat * glm::vec4(getNormal(), 0.));
-    center = glm::vec3(viewMat * glm::vec4(getCenter(), 1.));
+    return glm::vec4{-1., 0., 0., -std::numeric_limits<float>::infinity()};
   }
+  glm::mat4 viewMat = view::getCameraViewMatrix();
+  glm::vec3 normal = glm::vec3(viewMat * glm::vec4(getNormal(), 0.));
+  glm::vec3 center = glm::vec3(viewMat * glm::vec4(getCenter(), 1.));
+  return glm::vec4(normal, glm::dot(center, normal));
+}
 
-  p.setUniform("u_slicePlaneNormal_" + postfix, normal);
-  p.setUniform("u_slicePlaneCenter_" + postfix, center);
+void setSlicePlaneUniforms(render::ShaderProgram& p, uint32_t ignoreMask) {
+  const SlicePlaneUniformHandles& h = p.userData<SlicePlaneUniformHandles>();
+  if (!h.count.isValid()) {
+    return;
+  }
+
+  p.setUniform(h.count, static_cast<int>(state::slicePlanes.size()));
+  p.setUniform(h.ignoreMask, static_cast<unsigned int>(ignoreMask));
+
+  for (size_t i = 0; i < state::slicePlanes.size(); i++) {
+    if (h.planes[i].isValid()) p.setUniform(h.planes[i], state::slicePlanes[i]->viewSpacePlane());
+  }
+
+  // unused entries are never read, but every uniform must be set before drawing
+  for (size_t i = state::slicePlanes.size(); i < render::MAX_SLICE_PLANES; i++) {
+    if (h.planes[i].isValid()) p.setUniform(h.planes[i], glm::vec4{0., 0., 0., 0.});
+  }
 }
 
 glm::vec3 SlicePlane::getCenter() {
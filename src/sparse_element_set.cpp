@@ -0,0 +1,75 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/sparse_element_set.h"
+
+#include "polyscope/render/engine.h"
+#include "polyscope/utilities.h"
+
+#include <algorithm>
+
+namespace polyscope {
+
+SparseElementSet::SparseElementSet(size_t nElements_, std::vector<uint32_t> indices_)
+    : nElementsTotal(nElements_), indices(std::move(indices_)) {}
+
+SparseElementSet SparseElementSet::fromEntries(size_t nElements, std::vector<std::pair<size_t, double>> entries,
+                                               std::vector<double>& values, const std::vector<size_t>* permInverse) {
+  size_t nKept = 0;
+  for (const std::pair<size_t, double>& e : entries) {
+    size_t iElement = e.first;
+    if (permInverse != nullptr) {
+      iElement = e.first < permInverse->size() ? (*permInverse)[e.first] : INVALID_IND;
+    }
+    if (iElement < nElements) {
+      entries[nKept++] = std::make_pair(iElement, e.second);
+    }
+  }
+  entries.resize(nKept);
+
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const std::pair<size_t, double>& a, const std::pair<size_t, double>& b) {
+                     return a.first < b.first;
+                   });
+
+  std::vector<uint32_t> indices;
+  indices.reserve(entries.size());
+  values.clear();
+  values.reserve(entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (i + 1 < entries.size() && entries[i + 1].first == entries[i].first) continue;
+    indices.push_back(static_cast<uint32_t>(entries[i].first));
+    values.push_back(entries[i].second);
+  }
+  return SparseElementSet(nElements, std::move(indices));
+}
+
+size_t SparseElementSet::find(size_t iElement) const {
+  std::vector<uint32_t>::const_iterator it = std::lower_bound(indices.begin(), indices.end(), iElement);
+  if (it == indices.end() || *it != iElement) return INVALID_IND;
+  return it - indices.begin();
+}
+
+bool SparseElementSet::contains(size_t iElement) const { return find(iElement) != INVALID_IND; }
+
+bool SparseElementSet::fitsTextures() const {
+  const size_t maxExactIndex = static_cast<size_t>(1) << 24;
+  return nElementsTotal <= maxExactIndex;
+}
+
+std::shared_ptr<render::TextureBuffer> SparseElementSet::generatePresenceTexture() const {
+  size_t nBlocks = (nElementsTotal + 31) / 32;
+  std::vector<glm::vec3> blocks(nBlocks, glm::vec3{0.f});
+  for (uint32_t iElement : indices) {
+    uint32_t bit = iElement % 32;
+    blocks[iElement / 32][bit / 16] += static_cast<float>(1u << (bit % 16));
+  }
+  size_t nBefore = 0;
+  for (size_t iBlock = 0; iBlock < nBlocks; iBlock++) {
+    blocks[iBlock].z = static_cast<float>(nBefore);
+    while (nBefore < indices.size() && indices[nBefore] / 32 == iBlock) nBefore++;
+  }
+  return render::engine->generateElementTexture(blocks);
+}
+
+size_t SparseElementSet::allocatedBytes() const { return polyscope::allocatedBytes(indices); }
+
+} // namespace polyscope
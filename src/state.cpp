@@ -12,7 +12,10 @@ std::tuple<glm::vec3, glm::vec3> boundingBox =
     std::tuple<glm::vec3, glm::vec3>{glm::vec3{-1., -1., -1.}, glm::vec3{1., 1., 1.}};
 std::map<std::string, std::map<std::string, Structure*>> structures;
 std::function<void()> userCallback = nullptr;
+std::function<void()> backgroundCallback = nullptr;
 bool doDefaultMouseInteraction = true;
+size_t sceneRenderCount = 0;
+size_t redrawRequestCount = 0;
 
 // Lists of things
 std::set<Widget*> widgets;
@@ -1,26 +1,42 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/structure.h"
 
+#include "polyscope/pick.h"
 #include "polyscope/polyscope.h"
 
 #include "imgui.h"
 
+#include <cmath>
+#include <limits>
+
 namespace polyscope {
 
 Structure::Structure(std::string name_, std::string subtypeName)
-    : name(name_), enabled(subtypeName + "#" + name + "#enabled", true),
+    : name(name_), handleID(internal::acquireHandle(this)), gpuMemory(std::make_shared<render::GPUMemoryAccount>()),
+      enabled(subtypeName + "#" + name + "#enabled", true),
       objectTransform(subtypeName + "#" + name + "#object_transform", glm::mat4(1.0)),
       transparency(subtypeName + "#" + name + "#transparency", 1.0),
       transformGizmo(subtypeName + "#" + name + "#transform_gizmo", objectTransform.get(), &objectTransform),
       cullWholeElements(subtypeName + "#" + name + "#cullWholeElements", false),
       ignoredSlicePlaneNames(subtypeName + "#" + name + "#ignored_slice_planes", {}),
+      staticHint(subtypeName + "#" + name + "#static_hint", false),
       objectSpaceBoundingBox(
           std::tuple<glm::vec3, glm::vec3>{glm::vec3{-777, -777, -777}, glm::vec3{-777, -777, -777}}),
       objectSpaceLengthScale(-777) {
   validateName(name);
+  transformGizmo.onUpdate = [this]() {
+    boundsChanged();
+    requestStructureExtentsUpdate();
+  };
 }
 
-Structure::~Structure(){};
+Structure::~Structure() {
+  internal::releaseHandle(handleID);
+  if (parentGroup != nullptr) {
+    parentGroup->removeChildStructure(*this);
+  }
+  pick::releasePickBufferRanges(this);
+}
 
 Structure* Structure::setEnabled(bool newEnabled) {
   if (newEnabled == isEnabled()) return this;
@@ -48,7 +64,8 @@ void Structure::buildUI() {
                                // identically-named labels
 
 
-  if (ImGui::TreeNode(name.c_str())) {
+  uiTreeOpen = ImGui::TreeNode(name.c_str());
+  if (uiTreeOpen) {
 
     bool currEnabled = isEnabled();
     ImGui::Checkbox("Enabled", &currEnabled);
@@ -155,6 +172,30 @@ void Structure::refresh() {
   requestRedraw();
 }
 
+void Structure::requestRedraw() {
+  invalidateStaticLayer();
+  polyscope::requestRedraw();
+}
+
+void Structure::invalidateStaticLayer() {
+  if (getStaticHint()) {
+    render::engine->invalidateStaticLayer();
+  }
+}
+
+size_t Structure::getGPUMemoryUsage() { return gpuMemory->bytes; }
+
+MemoryUsage Structure::memoryUsage() {
+  MemoryUsage usage;
+  usage.hostBytes = hostMemoryUsage();
+  usage.deviceBytes = gpuMemory->bytes;
+  return usage;
+}
+
+size_t Structure::hostMemoryUsage() { return 0; }
+
+void Structure::collectIdleQuantities(double now, std::vector<IdleQuantity>& idle) {}
+
 std::tuple<glm::vec3, glm::vec3> Structure::boundingBox() {
   const glm::mat4x4& T = objectTransform.get();
   glm::vec4 lh = T * glm::vec4(std::get<0>(objectSpaceBoundingBox), 1.);
@@ -164,6 +205,112 @@ std::tuple<glm::vec3, glm::vec3> Structure::boundingBox() {
   return std::tuple<glm::vec3, glm::vec3>{l, u};
 }
 
+std::string Structure::drawBatchKey() { return ""; }
+
+std::tuple<glm::vec3, glm::vec3> Structure::cullingBoundingBox() {
+  // World-space box from all eight corners, since the transform may rotate the object
+  const glm::mat4x4& T = objectTransform.get();
+  glm::vec3 bboxMin, bboxMax;
+  std::tie(bboxMin, bboxMax) = objectSpaceBoundingBox;
+  glm::vec3 worldMin{std::numeric_limits<float>::infinity()};
+  glm::vec3 worldMax{-std::numeric_limits<float>::infinity()};
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 c{(i & 1) ? bboxMax.x : bboxMin.x, (i & 2) ? bboxMax.y : bboxMin.y, (i & 4) ? bboxMax.z : bboxMin.z};
+    glm::vec4 ch = T * glm::vec4(c, 1.);
+    worldMin = glm::min(worldMin, glm::vec3(ch) / ch.w);
+    worldMax = glm::max(worldMax, glm::vec3(ch) / ch.w);
+  }
+  glm::vec3 margin{0.1f * state::lengthScale};
+  worldMin -= margin;
+  worldMax += margin;
+  return std::tuple<glm::vec3, glm::vec3>{worldMin, worldMax};
+}
+
+bool Structure::isInViewFrustum(const glm::mat4& clipRegion) {
+  if (!options::enableFrustumCulling || objectSpaceLengthScale < 0.) return true; // bounds are not known
+
+  glm::vec3 worldMin, worldMax;
+  std::tie(worldMin, worldMax) = cullingBoundingBox();
+
+  // (the current view matrix, rather than the camera's, so that reflection and shadow passes cull correctly)
+  return view::boxMayBeInView(worldMin, worldMax, clipRegion * view::getCameraPerspectiveMatrix() * view::viewMat);
+}
+
+bool Structure::isOccluded() { return options::enableOcclusionCulling && occluded; }
+
+void Structure::testOcclusion() {
+  if (!isEnabled() || getStaticHint() || objectSpaceLengthScale < 0. || !isInViewFrustum()) {
+    resetOcclusion();
+    return;
+  }
+
+  if (!occlusionQuery) {
+    occlusionQuery = render::engine->generateOcclusionQuery();
+  }
+
+  // Collect the previous test. Until it is done, keep the last answer rather than stalling on it.
+  collectOcclusionTest();
+  if (occlusionTestPending) return;
+
+  glm::vec3 worldMin, worldMax;
+  std::tie(worldMin, worldMax) = cullingBoundingBox();
+  occlusionTestPending = render::engine->testBoxVisibility(worldMin, worldMax, *occlusionQuery);
+  if (!occlusionTestPending) {
+    occluded = false; // (the box reaches the camera)
+  }
+}
+
+void Structure::collectOcclusionTest() {
+  if (!occlusionTestPending || !occlusionQuery->isReady()) return;
+  bool wasOccluded = occluded;
+  occluded = !occlusionQuery->anySamplesPassed();
+  occlusionTestPending = false;
+  if (wasOccluded && !occluded) {
+    polyscope::requestRedraw(); // it came in to view, draw it without waiting for the next change
+  }
+}
+
+bool Structure::hasOutstandingOcclusionTest() { return isOccluded() && occlusionTestPending; }
+
+void Structure::resetOcclusion() {
+  occluded = false;
+  occlusionTestPending = false;
+}
+
+bool Structure::isVisibleInGroups() { return parentGroup == nullptr || parentGroup->isVisible(); }
+
+void Structure::boundsChanged() {
+  if (parentGroup != nullptr) {
+    parentGroup->boundsChanged();
+  }
+}
+
+bool Structure::rayCastElement(glm::vec3 rayStart, glm::vec3 rayDir, float& tHit, size_t& localPickInd) {
+  // t is unchanged by the affine map to object space, when the direction is mapped along with the start
+  glm::mat4 invT = glm::inverse(objectTransform.get());
+  glm::vec4 startObj = invT * glm::vec4(rayStart, 1.);
+  glm::vec3 dirObj = glm::mat3(invT) * rayDir;
+  float objectScale = std::cbrt(std::abs(glm::determinant(glm::mat3(objectTransform.get()))));
+  return rayCastElementObjectSpace(glm::vec3(startObj) / startObj.w, dirObj, objectScale, tHit, localPickInd);
+}
+
+bool Structure::closestElement(glm::vec3 point, float& dist, size_t& localPickInd) {
+  glm::vec4 pointObj = glm::inverse(objectTransform.get()) * glm::vec4(point, 1.);
+  float objectScale = std::cbrt(std::abs(glm::determinant(glm::mat3(objectTransform.get()))));
+  if (!closestElementObjectSpace(glm::vec3(pointObj) / pointObj.w, objectScale, dist, localPickInd)) return false;
+  dist *= objectScale;
+  return true;
+}
+
+bool Structure::rayCastElementObjectSpace(glm::vec3 rayStart, glm::vec3 rayDir, float objectScale, float& tHit,
+                                          size_t& localPickInd) {
+  return false;
+}
+
+bool Structure::closestElementObjectSpace(glm::vec3 point, float objectScale, float& dist, size_t& localPickInd) {
+  return false;
+}
+
 float Structure::lengthScale() {
   // compute the scaling caused by the object transform
   const glm::mat4x4& T = objectTransform.get();
@@ -173,19 +320,22 @@ float Structure::lengthScale() {
 
 void Structure::setTransform(glm::mat4x4 transform) {
   objectTransform = transform;
-  updateStructureExtents();
+  boundsChanged();
+  requestStructureExtentsUpdate();
 }
 
 void Structure::setPosition(glm::vec3 vec) {
   objectTransform.get()[3][0] = vec.x;
   objectTransform.get()[3][1] = vec.y;
   objectTransform.get()[3][2] = vec.z;
-  updateStructureExtents();
+  boundsChanged();
+  requestStructureExtentsUpdate();
 }
 
 void Structure::translate(glm::vec3 vec) {
   objectTransform = glm::translate(objectTransform.get(), vec);
-  updateStructureExtents();
+  boundsChanged();
+  requestStructureExtentsUpdate();
 }
 
 glm::mat4x4 Structure::getTransform() { return objectTransform.get(); }
@@ -196,7 +346,8 @@ glm::vec3 Structure::getPosition() {
 
 void Structure::resetTransform() {
   objectTransform = glm::mat4(1.0);
-  updateStructureExtents();
+  boundsChanged();
+  requestStructureExtentsUpdate();
 }
 
 void Structure::centerBoundingBox() {
@@ -204,7 +355,8 @@ void Structure::centerBoundingBox() {
   glm::vec3 center = (std::get<1>(bbox) + std::get<0>(bbox)) / 2.0f;
   glm::mat4x4 newTrans = glm::translate(glm::mat4x4(1.0), -glm::vec3(center.x, center.y, center.z));
   objectTransform = newTrans * objectTransform.get();
-  updateStructureExtents();
+  boundsChanged();
+  requestStructureExtentsUpdate();
 }
 
 void Structure::rescaleToUnit() {
@@ -212,7 +364,8 @@ void Structure::rescaleToUnit() {
   float s = static_cast<float>(1.0 / currScale);
   glm::mat4x4 newTrans = glm::scale(glm::mat4x4(1.0), glm::vec3{s, s, s});
   objectTransform = newTrans * objectTransform.get();
-  updateStructureExtents();
+  boundsChanged();
+  requestStructureExtentsUpdate();
 }
 
 glm::mat4 Structure::getModelView() { return view::getCameraViewMatrix() * objectTransform.get(); }
@@ -228,24 +381,48 @@ std::vector<std::string> Structure::addStructureRules(std::vector<std::string> i
   return initRules;
 }
 
+bool Structure::drawsInDepthPrepass() { return false; }
+
+namespace {
+
+// The uniforms setStructureUniforms() sets every frame, looked up once for each program (see
+// ShaderProgram::userData()). Those a program does not have are invalid.
+struct StructureUniformHandles {
+  StructureUniformHandles(render::ShaderProgram& p)
+      : modelView(p.getUniformHandle("u_modelView")), projMatrix(p.getUniformHandle("u_projMatrix")),
+        transparency(p.getUniformHandle("u_transparency")), viewportDim(p.getUniformHandle("u_viewportDim")),
+        depthPrepass(p.getUniformHandle("u_depthPrepass")),
+        prepassViewportDim(p.getUniformHandle("u_prepassViewportDim")),
+        deferredShading(p.getUniformHandle("u_deferredShading")),
+        viewportViewPos(p.getUniformHandle("u_viewport_viewPos")),
+        invProjMatrixViewPos(p.getUniformHandle("u_invProjMatrix_viewPos")) {}
+
+  render::ShaderUniformHandle modelView, projMatrix, transparency, viewportDim, depthPrepass, prepassViewportDim,
+      deferredShading, viewportViewPos, invProjMatrixViewPos;
+};
+
+} // namespace
+
 void Structure::setStructureUniforms(render::ShaderProgram& p) {
+  const StructureUniformHandles& h = p.userData<StructureUniformHandles>();
+
   glm::mat4 viewMat = getModelView();
-  p.setUniform("u_modelView", glm::value_ptr(viewMat));
+  p.setUniform(h.modelView, glm::value_ptr(viewMat));
 
-  if (p.hasUniform("u_projMatrix")) {
+  if (h.projMatrix.isValid()) {
     glm::mat4 projMat = view::getCameraPerspectiveMatrix();
-    p.setUniform("u_projMatrix", glm::value_ptr(projMat));
+    p.setUniform(h.projMatrix, glm::value_ptr(projMat));
   }
 
   if (render::engine->transparencyEnabled()) {
-    if (p.hasUniform("u_transparency")) {
-      p.setUniform("u_transparency", transparency.get());
+    if (h.transparency.isValid()) {
+      p.setUniform(h.transparency, transparency.get());
     }
 
-    if (p.hasUniform("u_viewportDim")) {
+    if (h.viewportDim.isValid()) {
       glm::vec4 viewport = render::engine->getCurrentViewport();
       glm::vec2 viewportDim{viewport[2], viewport[3]};
-      p.setUniform("u_viewportDim", viewportDim);
+      p.setUniform(h.viewportDim, viewportDim);
     }
 
     // Attach the min depth texture, if needed
@@ -256,22 +433,41 @@ void Structure::setStructureUniforms(render::ShaderProgram& p) {
     }
   }
 
+  // Depth prepass stage, and the depth it wrote (which is copied to the texture transparency uses for peeling; the
+  // prepass only runs without transparency)
+  if (h.depthPrepass.isValid()) {
+    p.setUniform(h.depthPrepass, static_cast<int>(render::engine->depthPrepassStage));
+    glm::vec4 viewport = render::engine->getCurrentViewport();
+    p.setUniform(h.prepassViewportDim, glm::vec2{viewport[2], viewport[3]});
+    if (!p.textureIsSet("t_prepassDepth")) {
+      p.setTextureFromBuffer("t_prepassDepth", render::engine->sceneDepthMin.get());
+    }
+  }
+
+  // Whether to light the fragments, or write them to the G-buffer for deferred shading
+  if (h.deferredShading.isValid()) {
+    p.setUniform(h.deferredShading, render::engine->deferredShadingPass ? 1 : 0);
+  }
+
   // Respect any slice planes
-  for (SlicePlane* s : state::slicePlanes) {
-    bool ignoreThisPlane = getIgnoreSlicePlane(s->name);
-    s->setSceneObjectUniforms(p, ignoreThisPlane);
+  if (render::engine->slicePlanesEnabled()) {
+    uint32_t ignoreMask = 0;
+    for (size_t i = 0; i < state::slicePlanes.size(); i++) {
+      if (getIgnoreSlicePlane(state::slicePlanes[i]->name)) ignoreMask |= (1u << i);
+    }
+    setSlicePlaneUniforms(p, ignoreMask);
   }
 
   // TODO this chain if "if"s is not great. Set up some system in the render engine to conditionally set these? Maybe
   // a list of lambdas? Ugh.
-  if (p.hasUniform("u_viewport_viewPos")) {
+  if (h.viewportViewPos.isValid()) {
     glm::vec4 viewport = render::engine->getCurrentViewport();
-    p.setUniform("u_viewport_viewPos", viewport);
+    p.setUniform(h.viewportViewPos, viewport);
   }
-  if (p.hasUniform("u_invProjMatrix_viewPos")) {
+  if (h.invProjMatrixViewPos.isValid()) {
     glm::mat4 P = view::getCameraPerspectiveMatrix();
     glm::mat4 Pinv = glm::inverse(P);
-    p.setUniform("u_invProjMatrix_viewPos", glm::value_ptr(Pinv));
+    p.setUniform(h.invProjMatrixViewPos, glm::value_ptr(Pinv));
   }
 }
 
@@ -279,6 +475,11 @@ bool Structure::wantsCullPosition() { return render::engine->slicePlanesEnabled(
 
 std::string Structure::uniquePrefix() { return typeName() + "#" + name + "#"; }
 
+const std::string& Structure::profilingName() {
+  if (profilingNameCache.empty()) profilingNameCache = typeName() + " " + name;
+  return profilingNameCache;
+}
+
 void Structure::remove() { removeStructure(typeName(), name); }
 
 
@@ -307,7 +508,6 @@ Structure* Structure::setIgnoreSlicePlane(std::string name, bool newValue) {
   if (getIgnoreSlicePlane(name) == newValue) {
     // no change
     ignoredSlicePlaneNames.manuallyChanged();
-    refresh();
     requestRedraw();
     return this;
   }
@@ -320,8 +520,8 @@ Structure* Structure::setIgnoreSlicePlane(std::string name, bool newValue) {
     // new value is false; remove it from the list
     names.erase(std::remove(names.begin(), names.end(), name), names.end());
   }
+  // the ignored planes are passed as a uniform bitmask, so there is no need to regenerate programs
   ignoredSlicePlaneNames.manuallyChanged();
-  refresh();
   requestRedraw();
   return this;
 }
@@ -332,4 +532,12 @@ bool Structure::getIgnoreSlicePlane(std::string name) {
   return ignoreThisPlane;
 }
 
+Structure* Structure::setStaticHint(bool newVal) {
+  staticHint = newVal;
+  render::engine->invalidateStaticLayer();
+  polyscope::requestRedraw();
+  return this;
+}
+bool Structure::getStaticHint() { return staticHint.get(); }
+
 } // namespace polyscope
@@ -44,12 +44,17 @@ void SurfaceVertexColorQuantity::createProgram() {
   render::engine->setMaterial(*program, parent.getMaterial());
 }
 
+bool SurfaceVertexColorQuantity::topologyChanged() {
+  values.resize(parent.nVertices(), glm::vec3{0., 0., 0.});
+  releaseRenderData();
+  return true;
+}
+
 void SurfaceVertexColorQuantity::fillColorBuffers(render::ShaderProgram& p) {
   std::vector<glm::vec3> colorval;
   colorval.reserve(3 * parent.nFacesTriangulation());
 
-  for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-    auto& face = parent.faces[iF];
+  parent.forEachDrawnFace([&](size_t, SurfaceMesh::IndexView face) {
     size_t D = face.size();
 
     // implicitly triangulate from root
@@ -62,7 +67,7 @@ void SurfaceVertexColorQuantity::fillColorBuffers(render::ShaderProgram& p) {
       colorval.push_back(values[vB]);
       colorval.push_back(values[vC]);
     }
-  }
+  });
 
   // Store data in buffers
   p.setAttribute("a_color", colorval);
@@ -87,6 +92,16 @@ void SurfaceColorQuantity::refresh() {
   Quantity::refresh();
 }
 
+void SurfaceColorQuantity::dataUpdated() {
+  if (program) {
+    fillColorBuffers(*program);
+  }
+}
+
+void SurfaceColorQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  requestRedraw();
+}
+
 // ========================================================
 // ==========            Face Color              ==========
 // ========================================================
@@ -98,7 +113,8 @@ SurfaceFaceColorQuantity::SurfaceFaceColorQuantity(std::string name, std::vector
 
 void SurfaceFaceColorQuantity::createProgram() {
   // Create the program to draw this quantity
-  program = render::engine->requestShader("MESH", parent.addSurfaceMeshRules({"MESH_PROPAGATE_COLOR", "SHADE_COLOR"}));
+  std::string propagateRule = parent.canUseFaceTextures() ? "MESH_PROPAGATE_FACE_COLOR_TEXTURE" : "MESH_PROPAGATE_COLOR";
+  program = render::engine->requestShader("MESH", parent.addSurfaceMeshRules({propagateRule, "SHADE_COLOR"}));
 
   // Fill color buffers
   parent.fillGeometryBuffers(*program);
@@ -106,18 +122,42 @@ void SurfaceFaceColorQuantity::createProgram() {
   render::engine->setMaterial(*program, parent.getMaterial());
 }
 
+void SurfaceFaceColorQuantity::releaseRenderData() {
+  faceColorTexture.reset();
+  SurfaceColorQuantity::releaseRenderData();
+}
+
+void SurfaceFaceColorQuantity::dataUpdated() {
+  faceColorTexture.reset(); // (made again from the new colors by fillColorBuffers())
+  SurfaceColorQuantity::dataUpdated();
+}
+
+bool SurfaceFaceColorQuantity::topologyChanged() {
+  values.resize(parent.nFaces(), glm::vec3{0., 0., 0.});
+  releaseRenderData();
+  return true;
+}
+
 void SurfaceFaceColorQuantity::fillColorBuffers(render::ShaderProgram& p) {
+  if (p.hasTexture("t_faceColors")) {
+    if (!faceColorTexture) {
+      faceColorTexture = parent.generateFaceTexture(values);
+    }
+    parent.setFaceTextureUniforms(p);
+    p.setTextureFromBuffer("t_faceColors", faceColorTexture.get());
+    return;
+  }
+
   std::vector<glm::vec3> colorval;
   colorval.reserve(3 * parent.nFacesTriangulation());
 
-  for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-    auto& face = parent.faces[iF];
+  parent.forEachDrawnFace([&](size_t iF, SurfaceMesh::IndexView face) {
     size_t D = face.size();
     size_t triDegree = std::max(0, static_cast<int>(D) - 2);
     for (size_t j = 0; j < 3 * triDegree; j++) {
       colorval.push_back(values[iF]);
     }
-  }
+  });
 
 
   // Store data in buffers
@@ -137,4 +177,8 @@ void SurfaceFaceColorQuantity::buildFaceInfoGUI(size_t fInd) {
   ImGui::NextColumn();
 }
 
+size_t SurfaceVertexColorQuantity::hostMemoryUsage() { return allocatedBytes(values); }
+
+size_t SurfaceFaceColorQuantity::hostMemoryUsage() { return allocatedBytes(values); }
+
 } // namespace polyscope
@@ -7,11 +7,55 @@
 
 #include "imgui.h"
 
+#include <algorithm>
+
 using std::cout;
 using std::endl;
 
 namespace polyscope {
 
+namespace {
+
+// Map sparse (data index, value) pairs to (element index, value) pairs, through the inverse of the data permutation
+// (see SurfaceMesh::getVertexPermInverse()). Pairs whose data index no element takes are dropped.
+template <typename T>
+std::vector<std::pair<size_t, T>> permuteSparseEntries(const std::vector<std::pair<size_t, T>>& values,
+                                                       const std::vector<size_t>& permInverse) {
+  std::vector<std::pair<size_t, T>> result;
+  result.reserve(values.size());
+  for (const std::pair<size_t, T>& t : values) {
+    if (t.first < permInverse.size() && permInverse[t.first] != INVALID_IND) {
+      result.emplace_back(permInverse[t.first], t.second);
+    }
+  }
+  return result;
+}
+
+// Sort sparse pairs by index, keeping the last value given for each index
+template <typename T>
+std::vector<std::pair<size_t, T>> sortedUniqueEntries(std::vector<std::pair<size_t, T>> values) {
+  std::stable_sort(values.begin(), values.end(),
+                   [](const std::pair<size_t, T>& a, const std::pair<size_t, T>& b) { return a.first < b.first; });
+  size_t nUnique = 0;
+  for (size_t i = 0; i < values.size(); i++) {
+    if (i + 1 < values.size() && values[i + 1].first == values[i].first) continue;
+    values[nUnique++] = values[i];
+  }
+  values.resize(nUnique);
+  return values;
+}
+
+// Look up an index in sorted sparse pairs, nullptr if there is no value for it
+template <typename T>
+const T* findSortedEntry(const std::vector<std::pair<size_t, T>>& values, size_t ind) {
+  auto it = std::lower_bound(values.begin(), values.end(), ind,
+                             [](const std::pair<size_t, T>& a, size_t b) { return a.first < b; });
+  if (it == values.end() || it->first != ind) return nullptr;
+  return &it->second;
+}
+
+} // namespace
+
 SurfaceCountQuantity::SurfaceCountQuantity(std::string name, SurfaceMesh& mesh_, std::string descriptiveType_)
     : SurfaceMeshQuantity(name, mesh_), descriptiveType(descriptiveType_),
       pointRadius(uniquePrefix() + "#pointRadius", relativeValue(0.005)),
@@ -123,7 +167,7 @@ std::string SurfaceCountQuantity::getColorMap() { return colorMap.get(); }
 
 SurfaceCountQuantity* SurfaceCountQuantity::setPointRadius(double newVal, bool isRelative) {
   pointRadius = ScaledValue<float>(newVal, isRelative);
-  polyscope::requestRedraw();
+  requestRedraw();
   return this;
 }
 double SurfaceCountQuantity::getPointRadius() { return pointRadius.get().asAbsolute(); }
@@ -141,29 +185,14 @@ SurfaceVertexCountQuantity::SurfaceVertexCountQuantity(std::string name, std::ve
 
   // Apply permutation if needed
   if (parent.vertexPerm.size() > 0) {
-
-    // Build a temporary map to invert
-    std::map<size_t, int> m;
-    for (auto& t : values_) {
-      m[t.first] = t.second;
-    }
-
-    // Invert
-    std::vector<std::pair<size_t, int>> newValues;
-    for (size_t iP = 0; iP < parent.nVertices(); iP++) {
-      if (m.find(parent.vertexPerm[iP]) != m.end()) {
-        newValues.emplace_back(iP, m[parent.vertexPerm[iP]]);
-      }
-    }
-
-    values_ = newValues;
+    values_ = sortedUniqueEntries(permuteSparseEntries(values_, parent.getVertexPermInverse()));
   }
 
 
   for (auto& t : values_) {
-    values[t.first] = t.second;
     entries.push_back(std::make_pair(parent.vertices[t.first], t.second));
   }
+  values = sortedUniqueEntries(values_);
 
   initializeLimits();
 }
@@ -171,10 +200,11 @@ SurfaceVertexCountQuantity::SurfaceVertexCountQuantity(std::string name, std::ve
 void SurfaceVertexCountQuantity::buildVertexInfoGUI(size_t vInd) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
-  if (values.find(vInd) == values.end()) {
+  const int* value = findSortedEntry(values, vInd);
+  if (value == nullptr) {
     ImGui::TextUnformatted("-");
   } else {
-    ImGui::Text("%+d", values[vInd]);
+    ImGui::Text("%+d", *value);
   }
   ImGui::NextColumn();
 }
@@ -192,28 +222,13 @@ SurfaceVertexIsolatedScalarQuantity::SurfaceVertexIsolatedScalarQuantity(std::st
 
   // Apply permutation if needed
   if (parent.vertexPerm.size() > 0) {
-
-    // Build a temporary map to invert
-    std::map<size_t, double> m;
-    for (auto& t : values_) {
-      m[t.first] = t.second;
-    }
-
-    // Invert
-    std::vector<std::pair<size_t, double>> newValues;
-    for (size_t iP = 0; iP < parent.nVertices(); iP++) {
-      if (m.find(parent.vertexPerm[iP]) != m.end()) {
-        newValues.emplace_back(iP, m[parent.vertexPerm[iP]]);
-      }
-    }
-
-    values_ = newValues;
+    values_ = sortedUniqueEntries(permuteSparseEntries(values_, parent.getVertexPermInverse()));
   }
 
   for (auto& t : values_) {
-    values[t.first] = t.second;
     entries.push_back(std::make_pair(parent.vertices[t.first], t.second));
   }
+  values = sortedUniqueEntries(values_);
 
   initializeLimits();
 }
@@ -221,10 +236,11 @@ SurfaceVertexIsolatedScalarQuantity::SurfaceVertexIsolatedScalarQuantity(std::st
 void SurfaceVertexIsolatedScalarQuantity::buildVertexInfoGUI(size_t vInd) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
-  if (values.find(vInd) == values.end()) {
+  const double* value = findSortedEntry(values, vInd);
+  if (value == nullptr) {
     ImGui::TextUnformatted("-");
   } else {
-    ImGui::Text("%g", values[vInd]);
+    ImGui::Text("%g", *value);
   }
   ImGui::NextColumn();
 }
@@ -239,29 +255,12 @@ SurfaceFaceCountQuantity::SurfaceFaceCountQuantity(std::string name, std::vector
 
   // Apply permutation if needed
   if (parent.facePerm.size() > 0) {
-
-    // Build a temporary map to invert
-    std::map<size_t, int> m;
-    for (auto& t : values_) {
-      m[t.first] = t.second;
-    }
-
-    // Invert
-    std::vector<std::pair<size_t, int>> newValues;
-    for (size_t iP = 0; iP < parent.nFaces(); iP++) {
-      if (m.find(parent.facePerm[iP]) != m.end()) {
-        newValues.emplace_back(iP, m[parent.facePerm[iP]]);
-      }
-    }
-
-    values_ = newValues;
+    values_ = sortedUniqueEntries(permuteSparseEntries(values_, parent.getFacePermInverse()));
   }
 
   for (auto& t : values_) {
-    values[t.first] = t.second;
-
     size_t iF = t.first;
-    auto& face = parent.faces[iF];
+    auto face = parent.face(iF);
     size_t D = face.size();
     glm::vec3 faceCenter = glm::vec3{0., 0., 0.};
     for (size_t j = 0; j < D; j++) {
@@ -271,6 +270,7 @@ SurfaceFaceCountQuantity::SurfaceFaceCountQuantity(std::string name, std::vector
 
     entries.push_back(std::make_pair(faceCenter, t.second));
   }
+  values = sortedUniqueEntries(values_);
 
   initializeLimits();
 }
@@ -278,12 +278,15 @@ SurfaceFaceCountQuantity::SurfaceFaceCountQuantity(std::string name, std::vector
 void SurfaceFaceCountQuantity::buildFaceInfoGUI(size_t fInd) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
-  if (values.find(fInd) == values.end()) {
+  const int* value = findSortedEntry(values, fInd);
+  if (value == nullptr) {
     ImGui::TextUnformatted("-");
   } else {
-    ImGui::Text("%+d", values[fInd]);
+    ImGui::Text("%+d", *value);
   }
   ImGui::NextColumn();
 }
 
+size_t SurfaceCountQuantity::hostMemoryUsage() { return allocatedBytes(entries); }
+
 } // namespace polyscope
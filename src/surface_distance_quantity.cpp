@@ -23,7 +23,10 @@ SurfaceDistanceQuantity::SurfaceDistanceQuantity(std::string name, std::vector<d
 
   // Build the histogram
   hist.updateColormap(cMap.get());
-  hist.buildHistogram(distances, parent.vertexAreas);
+  hist.buildHistogramLazily([this]() {
+    parent.ensureHaveGeometryData();
+    hist.buildHistogram(distances, parent.vertexAreas);
+  });
 
   dataRange = robustMinMax(distances, 1e-5);
   resetMapRange();
@@ -125,8 +128,7 @@ void SurfaceDistanceQuantity::fillColorBuffers(render::ShaderProgram& p) {
   std::vector<double> colorval;
   colorval.reserve(3 * parent.nFacesTriangulation());
 
-  for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-    auto& face = parent.faces[iF];
+  parent.forEachDrawnFace([&](size_t, SurfaceMesh::IndexView face) {
     size_t D = face.size();
 
     // implicitly triangulate from root
@@ -139,7 +141,7 @@ void SurfaceDistanceQuantity::fillColorBuffers(render::ShaderProgram& p) {
       colorval.push_back(distances[vB]);
       colorval.push_back(distances[vC]);
     }
-  }
+  });
 
 
   // Store data in buffers
@@ -187,4 +189,10 @@ void SurfaceDistanceQuantity::refresh() {
   Quantity::refresh();
 }
 
+void SurfaceDistanceQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  requestRedraw();
+}
+
+size_t SurfaceDistanceQuantity::hostMemoryUsage() { return allocatedBytes(distances); }
+
 } // namespace polyscope
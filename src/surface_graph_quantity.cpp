@@ -7,6 +7,8 @@
 
 #include "imgui.h"
 
+#include <algorithm>
+
 using std::cout;
 using std::endl;
 
@@ -17,14 +19,15 @@ SurfaceGraphQuantity::SurfaceGraphQuantity(std::string name, std::vector<glm::ve
     : SurfaceMeshQuantity(name, mesh_), nodes(std::move(nodes_)), edges(std::move(edges_)),
       radius(uniquePrefix() + "#radius", 0.002), color(uniquePrefix() + "#color", getNextUniqueColor()) {
   // Validate that indices are in bounds
+  const std::string indexWarning = "surface graph [" + name + "] has out of bounds edge index";
   for (auto& p : edges) {
-    if (p[0] >= nodes.size()) {
-      warning("surface graph [" + name + "] has out of bounds edge index",
-              "index = " + std::to_string(p[0]) + " but nNodes = " + std::to_string(nodes.size()));
-    }
-    if (p[1] >= nodes.size()) {
-      warning("surface graph [" + name + "] has out of bounds edge index",
-              "index = " + std::to_string(p[1]) + " but nNodes = " + std::to_string(nodes.size()));
+    for (size_t iN : {p[0], p[1]}) {
+      if (iN < nodes.size()) continue;
+      if (warningPending(indexWarning)) {
+        warning(indexWarning);
+      } else {
+        warning(indexWarning, "index = " + std::to_string(iN) + " but nNodes = " + std::to_string(nodes.size()));
+      }
     }
   }
 }
@@ -32,45 +35,50 @@ SurfaceGraphQuantity::SurfaceGraphQuantity(std::string name, std::vector<glm::ve
 void SurfaceGraphQuantity::draw() {
   if (!isEnabled()) return;
 
-  if (pointProgram == nullptr || lineProgram == nullptr) {
+  if (lineProgram == nullptr) {
     createPrograms();
   }
 
   setUniforms();
 
-  pointProgram->draw();
+  if (pointProgram) pointProgram->draw();
   lineProgram->draw();
 }
 
 void SurfaceGraphQuantity::setUniforms() {
   glm::mat4 P = view::getCameraPerspectiveMatrix();
   glm::mat4 Pinv = glm::inverse(P);
-  pointProgram->setUniform("u_invProjMatrix", glm::value_ptr(Pinv));
   lineProgram->setUniform("u_invProjMatrix", glm::value_ptr(Pinv));
-  pointProgram->setUniform("u_viewport", render::engine->getCurrentViewport());
   lineProgram->setUniform("u_viewport", render::engine->getCurrentViewport());
-
-  // Radii and colors
-  pointProgram->setUniform("u_pointRadius", getRadius());
   lineProgram->setUniform("u_radius", getRadius());
-  pointProgram->setUniform("u_baseColor", getColor());
   lineProgram->setUniform("u_baseColor", getColor());
-
-  parent.setStructureUniforms(*pointProgram);
   parent.setStructureUniforms(*lineProgram);
+
+  if (pointProgram) {
+    pointProgram->setUniform("u_invProjMatrix", glm::value_ptr(Pinv));
+    pointProgram->setUniform("u_viewport", render::engine->getCurrentViewport());
+    pointProgram->setUniform("u_pointRadius", getRadius());
+    pointProgram->setUniform("u_baseColor", getColor());
+    parent.setStructureUniforms(*pointProgram);
+  }
 }
 
 
 void SurfaceGraphQuantity::createPrograms() {
 
-  { // Point program
-    std::vector<std::string> rules = parent.addStructureRules({"SHADE_BASECOLOR"});
-    if (parent.wantsCullPosition()) {
-      rules.push_back("SPHERE_CULLPOS_FROM_CENTER");
-    }
-    pointProgram = render::engine->requestShader("RAYCAST_SPHERE", rules);
-    pointProgram->setAttribute("a_position", nodes);
-    render::engine->setMaterial(*pointProgram, parent.getMaterial());
+  nodeBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+  nodeBuffer->setData(nodes);
+
+  // Edges as index pairs, skipping the out of bounds ones warned about on construction
+  std::vector<unsigned int> edgeInds;
+  edgeInds.reserve(2 * edges.size());
+  std::vector<char> onEdge(nodes.size(), false);
+  for (auto& p : edges) {
+    if (p[0] >= nodes.size() || p[1] >= nodes.size()) continue;
+    edgeInds.push_back(static_cast<unsigned int>(p[0]));
+    edgeInds.push_back(static_cast<unsigned int>(p[1]));
+    onEdge[p[0]] = true;
+    onEdge[p[1]] = true;
   }
 
   { // Line program
@@ -78,23 +86,22 @@ void SurfaceGraphQuantity::createPrograms() {
     if (parent.wantsCullPosition()) {
       rules.push_back("CYLINDER_CULLPOS_FROM_MID");
     }
-    lineProgram = render::engine->requestShader("RAYCAST_CYLINDER", rules);
-
-    // Build buffers
-    std::vector<glm::vec3> edgeStarts, edgeEnds;
-    edgeStarts.reserve(edges.size());
-    edgeEnds.reserve(edges.size());
-    for (auto& p : edges) {
-      edgeStarts.push_back(nodes[p[0]]);
-      edgeEnds.push_back(nodes[p[1]]);
-    }
-
-    // Store data in buffers
-    lineProgram->setAttribute("a_position_tail", edgeStarts);
-    lineProgram->setAttribute("a_position_tip", edgeEnds);
-
+    lineProgram = render::engine->requestShader("RAYCAST_CAPSULE", rules);
+    lineProgram->setAttribute("a_position", nodeBuffer);
+    lineProgram->setIndex(edgeInds);
     render::engine->setMaterial(*lineProgram, parent.getMaterial());
   }
+
+  // Point program, only needed to show nodes which no capsule covers
+  if (std::find(onEdge.begin(), onEdge.end(), false) != onEdge.end()) {
+    std::vector<std::string> rules = parent.addStructureRules({"SHADE_BASECOLOR"});
+    if (parent.wantsCullPosition()) {
+      rules.push_back("SPHERE_CULLPOS_FROM_CENTER");
+    }
+    pointProgram = render::engine->requestShader("RAYCAST_SPHERE", rules);
+    pointProgram->setAttribute("a_position", nodeBuffer);
+    render::engine->setMaterial(*pointProgram, parent.getMaterial());
+  }
 }
 
 void SurfaceGraphQuantity::buildCustomUI() {
@@ -113,9 +120,14 @@ std::string SurfaceGraphQuantity::niceName() { return name + " (surface graph)";
 void SurfaceGraphQuantity::refresh() {
   pointProgram.reset();
   lineProgram.reset();
+  nodeBuffer.reset();
   Quantity::refresh();
 }
 
+void SurfaceGraphQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  // the graph has its own node positions, which do not move with the mesh
+}
+
 SurfaceGraphQuantity* SurfaceGraphQuantity::setRadius(double newVal, bool isRelative) {
   radius = ScaledValue<float>(newVal, isRelative);
   requestRedraw();
@@ -131,4 +143,6 @@ SurfaceGraphQuantity* SurfaceGraphQuantity::setColor(glm::vec3 newColor) {
 }
 glm::vec3 SurfaceGraphQuantity::getColor() { return color.get(); }
 
+size_t SurfaceGraphQuantity::hostMemoryUsage() { return allocatedBytes(nodes) + allocatedBytes(edges); }
+
 } // namespace polyscope
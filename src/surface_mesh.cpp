@@ -1,14 +1,19 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/surface_mesh.h"
 
-#include "polyscope/combining_hash_functions.h"
+#include "polyscope/internal.h"
+#include "polyscope/parallel.h"
 #include "polyscope/pick.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/render/engine.h"
+#include "polyscope/scratch_vector.h"
+#include "polyscope/surface_sparse_scalar_quantity.h"
 
 #include "imgui.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <utility>
 
 namespace polyscope {
@@ -16,75 +21,274 @@ namespace polyscope {
 // Initialize statics
 const std::string SurfaceMesh::structureTypeName = "Surface Mesh";
 
+namespace {
+
+// Vertex, face and edge indices are stored in 32 bits (see SurfaceMesh::faceIndsEntries), on purpose: a mesh with 2^32
+// of any element would need hundreds of GB of GPU memory to draw, while halving the index storage matters for every
+// mesh which can be drawn. So there is no wider fallback, and larger meshes are turned away when they are set.
+void checkElementCount(const std::string& name, size_t count, const std::string& elements) {
+  if (count > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error(name + " has " + std::to_string(count) + " " + elements +
+                             ", surface meshes index them with 32 bits so there must be fewer than 2^32");
+  }
+}
+
+} // namespace
 
 SurfaceMesh::SurfaceMesh(std::string name, const std::vector<glm::vec3>& vertexPositions,
-                         const std::vector<std::vector<size_t>>& faceIndices)
-    : QuantityStructure<SurfaceMesh>(name, typeName()), vertices(vertexPositions), faces(faceIndices),
+                         std::vector<uint32_t> faceIndsEntries_, std::vector<size_t> faceIndsStart_)
+    : SurfaceMesh(name, vertexPositions, std::move(faceIndsEntries_), std::move(faceIndsStart_), true) {}
+
+SurfaceMesh::SurfaceMesh(std::string name, const std::vector<glm::vec3>& vertexPositions,
+                         std::vector<uint32_t> faceIndsEntries_, std::vector<size_t> faceIndsStart_,
+                         DerivedData derived)
+    : SurfaceMesh(name, vertexPositions, std::move(faceIndsEntries_), std::move(faceIndsStart_), false) {
+
+  nCornersCount = faceIndsEntries.size();
+  nFacesTriangulationCount = nCornersCount - 2 * nFaces();
+  nEdgesCount = derived.edgeLengths.size();
+  if (derived.halfedgeEdgeIndices.size() != nCorners() || derived.halfedgeDefinesEdge.size() != nCorners() ||
+      derived.vertexFaceStart.size() != nVertices() + 1 || derived.vertexFaces.size() != nCorners() ||
+      derived.faceNormals.size() != nFaces() || derived.faceAreas.size() != nFaces() ||
+      derived.vertexNormals.size() != nVertices() || derived.vertexAreas.size() != nVertices()) {
+    throw std::invalid_argument(name + ": derived data does not match the mesh");
+  }
+
+  // Restored data is indexed without further checks when drawing, so make sure every index is in range, as
+  // computeCounts() would for fresh data
+  for (uint32_t v : faceIndsEntries) {
+    if (v >= nVertices()) throw std::invalid_argument(name + ": face refers to vertex out of range");
+  }
+  size_t nDefinedEdges = 0;
+  for (size_t iHe = 0; iHe < nCorners(); iHe++) {
+    if (derived.halfedgeEdgeIndices[iHe] >= nEdgesCount) {
+      throw std::invalid_argument(name + ": halfedge refers to edge out of range");
+    }
+    if (derived.halfedgeDefinesEdge[iHe]) nDefinedEdges++;
+  }
+  if (nDefinedEdges != nEdgesCount) {
+    throw std::invalid_argument(name + ": derived edges do not match the mesh");
+  }
+  if (derived.vertexFaceStart.front() != 0 || derived.vertexFaceStart.back() != derived.vertexFaces.size()) {
+    throw std::invalid_argument(name + ": vertex face lists do not match the mesh");
+  }
+  for (size_t iV = 0; iV < nVertices(); iV++) {
+    if (derived.vertexFaceStart[iV] > derived.vertexFaceStart[iV + 1]) {
+      throw std::invalid_argument(name + ": vertex face lists do not match the mesh");
+    }
+  }
+  for (uint32_t f : derived.vertexFaces) {
+    if (f >= nFaces()) throw std::invalid_argument(name + ": vertex refers to face out of range");
+  }
+
+  halfedgeEdgeIndices = std::move(derived.halfedgeEdgeIndices);
+  halfedgeDefinesEdge = std::move(derived.halfedgeDefinesEdge);
+  vertexFaceStart = std::move(derived.vertexFaceStart);
+  vertexFaces = std::move(derived.vertexFaces);
+  faceNormals = std::move(derived.faceNormals);
+  vertexNormals = std::move(derived.vertexNormals);
+  faceAreas = std::move(derived.faceAreas);
+  vertexAreas = std::move(derived.vertexAreas);
+  edgeLengths = std::move(derived.edgeLengths);
+
+  vertexDataSize = nVertices();
+  faceDataSize = nFaces();
+  edgeDataSize = nEdges();
+  halfedgeDataSize = nHalfedges();
+  cornerDataSize = nCorners();
+  computeFaceDrawOrder();
+}
+
+SurfaceMesh::SurfaceMesh(std::string name, const std::vector<glm::vec3>& vertexPositions,
+                         std::vector<uint32_t> faceIndsEntries_, std::vector<size_t> faceIndsStart_,
+                         bool computeDerived)
+    : QuantityStructure<SurfaceMesh>(name, typeName()), vertices(vertexPositions),
+      faceIndsEntries(std::move(faceIndsEntries_)), faceIndsStart(std::move(faceIndsStart_)),
       shadeSmooth(uniquePrefix() + "shadeSmooth", false),
       surfaceColor(uniquePrefix() + "surfaceColor", getNextUniqueColor()),
       edgeColor(uniquePrefix() + "edgeColor", glm::vec3{0., 0., 0.}), material(uniquePrefix() + "material", "clay"),
       edgeWidth(uniquePrefix() + "edgeWidth", 0.),
       backFacePolicy(uniquePrefix() + "backFacePolicy", BackFacePolicy::Different),
       backFaceColor(uniquePrefix() + "backFaceColor",
-                    glm::vec3(1.f - surfaceColor.get().r, 1.f - surfaceColor.get().g, 1.f - surfaceColor.get().b)) {
+                    glm::vec3(1.f - surfaceColor.get().r, 1.f - surfaceColor.get().g, 1.f - surfaceColor.get().b)),
+      lodEnabled(uniquePrefix() + "lodEnabled", false), gpuNormals(uniquePrefix() + "gpuNormals", false) {
+
+  checkElementCount(name, nVertices(), "vertices");
+  if (faceIndsStart.empty()) {
+    if (faceIndsEntries.size() % 3 != 0) {
+      throw std::invalid_argument(name + ": without face starts, the faces must all be triangles");
+    }
+    nFacesCount = faceIndsEntries.size() / 3;
+    checkElementCount(name, nFacesCount, "faces");
+  } else {
+    if (faceIndsStart.front() != 0 || faceIndsStart.back() != faceIndsEntries.size()) {
+      throw std::invalid_argument(name + ": face starts should run from 0 to the number of face entries");
+    }
+    nFacesCount = faceIndsStart.size() - 1;
+    checkElementCount(name, nFacesCount, "faces");
+    bool allTriangles = true;
+    for (size_t iF = 0; iF < nFacesCount; iF++) {
+      if (faceIndsStart[iF + 1] < faceIndsStart[iF] + 3) {
+        throw std::invalid_argument(name + " has face with degree < 3!");
+      }
+      allTriangles = allTriangles && faceIndsStart[iF + 1] == faceIndsStart[iF] + 3;
+    }
+    if (allTriangles) faceIndsStart.clear();
+  }
+
   updateObjectSpaceBounds();
-  computeCounts();
-  computeGeometryData();
+  if (computeDerived) {
+    computeCounts();
+    computeGeometryData();
+  }
+}
+
+SurfaceMesh::DerivedData SurfaceMesh::getDerivedData() const {
+  return DerivedData{halfedgeEdgeIndices, halfedgeDefinesEdge, vertexFaceStart, vertexFaces, faceNormals,
+                     vertexNormals,       faceAreas,           vertexAreas,     edgeLengths};
 }
 
+namespace {
 
-void SurfaceMesh::computeCounts() {
+// Flatten nested face lists, replacing faces of degree < 3 (which cannot be represented) with a degenerate triangle
+void flattenFaces(const std::string& name, const std::vector<std::vector<size_t>>& faceIndices,
+                  std::vector<uint32_t>& entries, std::vector<size_t>& starts) {
+  bool allTriangles = true;
+  size_t nEntries = 0;
+  for (const std::vector<size_t>& face : faceIndices) {
+    allTriangles = allTriangles && face.size() == 3;
+    nEntries += std::max<size_t>(face.size(), 3);
+  }
+  checkElementCount(name, faceIndices.size(), "faces");
 
-  nFacesTriangulationCount = 0;
-  nCornersCount = 0;
-  nEdgesCount = 0;
-  edgeIndices.resize(nFaces());
-  halfedgeIndices.resize(nFaces());
-  std::unordered_map<std::pair<size_t, size_t>, size_t, polyscope::hash_combine::hash<std::pair<size_t, size_t>>>
-      edgeInds;
-  size_t iF = 0;
-  for (auto& face : faces) {
+  entries.reserve(nEntries);
+  if (!allTriangles) {
+    starts.reserve(faceIndices.size() + 1);
+    starts.push_back(0);
+  }
+  const std::string degreeWarning = name + " has face with degree < 3!";
+  for (const std::vector<size_t>& face : faceIndices) {
     if (face.size() < 3) {
-      warning(name + " has face with degree < 3!");
-      face = {0, 0, 0}; // (just to do _something_ so we don't crash in subsequent code)
+      warning(degreeWarning);
+      entries.insert(entries.end(), {0, 0, 0}); // (just to do _something_ so we don't crash in subsequent code)
+    } else {
+      for (size_t iV : face) {
+        // (out of range indices are caught in computeCounts(), but clamp so they stay out of range as 32 bits)
+        entries.push_back(static_cast<uint32_t>(std::min<size_t>(iV, std::numeric_limits<uint32_t>::max())));
+      }
     }
-    nFacesTriangulationCount += std::max(static_cast<int>(face.size()) - 2, 0);
-    edgeIndices[iF].resize(face.size());
-    halfedgeIndices[iF].resize(face.size());
+    if (!allTriangles) starts.push_back(entries.size());
+  }
+}
 
-    for (size_t i = 0; i < face.size(); i++) {
-      size_t vA = face[i];
-      size_t vB = face[(i + 1) % face.size()];
+} // namespace
+
+SurfaceMesh::SurfaceMesh(std::string name, const std::vector<glm::vec3>& vertexPositions,
+                         const std::vector<std::vector<size_t>>& faceIndices)
+    : SurfaceMesh(name, vertexPositions, {}, {}, false) {
+  flattenFaces(name, faceIndices, faceIndsEntries, faceIndsStart);
+  nFacesCount = faceIndices.size();
+  computeCounts();
+  computeGeometryData();
+}
+
+SurfaceMesh::SurfaceMesh(std::string name, std::shared_ptr<SharedVertexPositions> sharedPositions_,
+                         const std::vector<std::vector<size_t>>& faceIndices)
+    : SurfaceMesh(name, sharedPositions_->getPositions(), faceIndices) {
+  sharedPositions = std::move(sharedPositions_);
+  sharedPositions->addUser(this,
+                           [this](const std::vector<size_t>* movedIndices) { sharedPositionsMoved(movedIndices); });
+}
 
-      if (vA >= vertices.size()) {
-        warning(name + " has face with vertex index out of vertices range",
-                "face " + std::to_string(iF) + " has vertex index " + std::to_string(vA));
+SurfaceMesh::~SurfaceMesh() {
+  cornerFillTask.reset(); // (waits for it)
+  if (sharedPositions) {
+    sharedPositions->removeUser(this);
+  }
+}
+
+void SurfaceMesh::computeCounts() {
+
+  // Sanitize faces first, so everything after can assume valid indices
+  const std::string rangeWarning = name + " has face with vertex index out of vertices range";
+  nFacesTriangulationCount = 0;
+  for (size_t iF = 0; iF < nFaces(); iF++) {
+    size_t iStart = faceStart(iF);
+    size_t D = faceDegree(iF);
+    for (size_t j = 0; j < D; j++) {
+      size_t iV = faceIndsEntries[iStart + j];
+      if (iV >= vertices.size()) {
+        if (warningPending(rangeWarning)) {
+          warning(rangeWarning); // (only counted, skip formatting the details)
+        } else {
+          warning(rangeWarning, "face " + std::to_string(iF) + " has vertex index " + std::to_string(iV));
+        }
 
         // zero out the face index
         // (just to do _something_ so we don't crash in subsequent code)
-        for (size_t j = 0; j < face.size(); j++) {
-          face[j] = 0;
-        }
-        vA = face[i];
-        vB = face[(i + 1) % face.size()];
+        std::fill(faceIndsEntries.begin() + iStart, faceIndsEntries.begin() + iStart + D, 0);
+        break;
       }
+    }
+    nFacesTriangulationCount += D - 2;
+  }
+  nCornersCount = faceIndsEntries.size();
+
+  // Find edges by sorting halfedges on their (packed) sorted vertex pair. Edges are numbered in order of the first
+  // halfedge on each of them, as if they were discovered by walking the faces in order.
+  unsigned int vertexBits = 1;
+  while ((static_cast<uint64_t>(1) << vertexBits) < nVertices()) vertexBits++;
+  std::vector<uint64_t> halfedgeKeys(nCornersCount);
+  std::vector<size_t> sortedHalfedges(nCornersCount);
+  parallelFor(0, nFaces(), [&](size_t iF) {
+    IndexView face = this->face(iF);
+    for (size_t i = 0; i < face.size(); i++) {
+      uint64_t vA = face[i];
+      uint64_t vB = face[(i + 1) % face.size()];
+      size_t iHe = halfedgeIndex(iF, i);
+      halfedgeKeys[iHe] = (std::min(vA, vB) << vertexBits) | std::max(vA, vB);
+      sortedHalfedges[iHe] = iHe;
+    }
+  });
+  parallelSortByKey(halfedgeKeys, sortedHalfedges, 2 * vertexBits);
+
+  // The sort is stable, so the first halfedge of each run of equal keys is the one which defines the edge
+  halfedgeDefinesEdge.assign(nCornersCount, false);
+  parallelFor(0, nCornersCount, [&](size_t i) {
+    if (i == 0 || halfedgeKeys[i] != halfedgeKeys[i - 1]) {
+      halfedgeDefinesEdge[sortedHalfedges[i]] = true;
+    }
+  });
 
-      std::pair<size_t, size_t> edgeKey(std::min(vA, vB), std::max(vA, vB));
-      auto it = edgeInds.find(edgeKey);
-      size_t edgeInd = 0;
-      if (it == edgeInds.end()) {
-        edgeInd = nEdgesCount;
-        edgeInds.insert(it, {edgeKey, edgeInd});
-        nEdgesCount++;
-      } else {
-        edgeInd = it->second;
+  // Number the defining halfedges, then copy their numbers to the other halfedges on the same edge
+  halfedgeEdgeIndices.resize(nCornersCount);
+  nEdgesCount = 0;
+  for (size_t iHe = 0; iHe < nCornersCount; iHe++) {
+    if (halfedgeDefinesEdge[iHe]) halfedgeEdgeIndices[iHe] = static_cast<uint32_t>(nEdgesCount++);
+  }
+  checkElementCount(name, nEdgesCount, "edges");
+  parallelFor(0, nCornersCount, [&](size_t i) {
+    size_t iFirst = i;
+    while (iFirst > 0 && halfedgeKeys[iFirst - 1] == halfedgeKeys[i]) iFirst--;
+    if (iFirst != i) halfedgeEdgeIndices[sortedHalfedges[i]] = halfedgeEdgeIndices[sortedHalfedges[iFirst]];
+  });
+
+  // Vertex-face adjacency (counting sort by vertex)
+  vertexFaceStart.assign(nVertices() + 1, 0);
+  for (uint32_t iV : faceIndsEntries) {
+    vertexFaceStart[iV + 1]++;
+  }
+  for (size_t iV = 0; iV < nVertices(); iV++) {
+    vertexFaceStart[iV + 1] += vertexFaceStart[iV];
+  }
+  vertexFaces.resize(nCornersCount);
+  {
+    std::vector<size_t> fillPos(vertexFaceStart.begin(), vertexFaceStart.end() - 1);
+    for (size_t iF = 0; iF < nFaces(); iF++) {
+      for (uint32_t iV : face(iF)) {
+        vertexFaces[fillPos[iV]++] = static_cast<uint32_t>(iF);
       }
-
-      edgeIndices[iF][i] = edgeInd;
-      halfedgeIndices[iF][i] = nCornersCount++;
     }
-
-    iF++;
   }
 
   // Default data sizes
@@ -93,154 +297,187 @@ void SurfaceMesh::computeCounts() {
   edgeDataSize = nEdges();
   halfedgeDataSize = nHalfedges();
   cornerDataSize = nCorners();
+
+  computeFaceDrawOrder();
 }
 
-void SurfaceMesh::computeGeometryData() {
-  const glm::vec3 zero{0., 0., 0.};
+void SurfaceMesh::computeFaceDrawOrder() {
+  invalidateTriangleClusters();
+  faceDrawOrder.clear();
+  faceDrawPosition.clear();
+  drawnTriangleStart.clear();
+  if (!options::reorderForLocality || nFaces() < 2) return;
+
+  faceDrawOrder = mortonOrder(faceCenters(0, nFaces()));
+  faceDrawPosition.resize(nFaces());
+  drawnTriangleStart.resize(nFaces() + 1);
+  drawnTriangleStart[0] = 0;
+  for (size_t i = 0; i < nFaces(); i++) {
+    faceDrawPosition[faceDrawOrder[i]] = static_cast<uint32_t>(i);
+    drawnTriangleStart[i + 1] = static_cast<uint32_t>(drawnTriangleStart[i] + faceDegree(faceDrawOrder[i]) - 2);
+  }
+}
 
-  // Reset face-valued
+void SurfaceMesh::computeGeometryData() {
   faceNormals.resize(nFaces());
   faceAreas.resize(nFaces());
-
-  // Reset vertex-valued
   vertexNormals.resize(nVertices());
-  std::fill(vertexNormals.begin(), vertexNormals.end(), zero);
   vertexAreas.resize(nVertices());
-  std::fill(vertexAreas.begin(), vertexAreas.end(), 0);
-
-  // Reset edge-valued
   edgeLengths.resize(nEdges());
 
-  // Loop over faces to compute face-valued quantities
-  for (size_t iF = 0; iF < nFaces(); iF++) {
-    auto& face = faces[iF];
-    size_t D = face.size();
+  // Faces first, since vertex values are gathered from them. Edge lengths are written only by the halfedge which
+  // defines the edge, so each is written once.
+  parallelFor(0, nFaces(), [&](size_t iF) { computeFaceGeometry(iF); });
+  parallelFor(0, nVertices(), [&](size_t iV) { computeVertexGeometry(iV); });
+  geometryDataStale = false;
+  geometryDataReleased = false;
+}
 
-    glm::vec3 fN = zero;
-    double fA = 0;
-    if (face.size() == 3) {
-      glm::vec3 pA = vertices[face[0]];
-      glm::vec3 pB = vertices[face[1]];
-      glm::vec3 pC = vertices[face[2]];
+void SurfaceMesh::ensureHaveGeometryData() {
+  if (geometryDataStale || geometryDataReleased) {
+    computeGeometryData();
+  }
+}
 
-      fN = glm::cross(pB - pA, pC - pA);
-      fA = 0.5 * glm::length(fN);
-    } else if (face.size() > 3) {
+void SurfaceMesh::restoreGeometryData() {
+  if (geometryDataReleased) {
+    computeGeometryData();
+  }
+}
 
-      glm::vec3 pRoot = vertices[face[0]];
-      for (size_t j = 0; j < D; j++) {
-        glm::vec3 pA = vertices[face[j]];
-        glm::vec3 pB = vertices[face[(j + 1) % D]];
-        glm::vec3 pC = vertices[face[(j + 2) % D]];
+void SurfaceMesh::releaseHostData() {
+  pickBVH.reset();
+  resetPermutationInverses();
+  if (geometryDataReleased || cornerFillTask) return; // (a background fill reads the geometry)
+
+  std::vector<glm::vec3>().swap(faceNormals);
+  std::vector<glm::vec3>().swap(vertexNormals);
+  std::vector<double>().swap(faceAreas);
+  std::vector<double>().swap(vertexAreas);
+  std::vector<double>().swap(edgeLengths);
+  geometryDataReleased = true;
+}
 
-        fN += glm::cross(pC - pB, pA - pB);
+void SurfaceMesh::computeFaceGeometry(size_t iF) {
+  const glm::vec3 zero{0., 0., 0.};
+  IndexView face = this->face(iF);
+  size_t D = face.size();
 
-        // _some_ definition of area for a non-triangular face
-        if (j != 0 && j != (D - 1)) {
-          fA += 0.5 * glm::length(glm::cross(pA - pRoot, pB - pRoot));
-        }
-      }
-    }
+  glm::vec3 fN = zero;
+  double fA = 0;
+  if (face.size() == 3) {
+    glm::vec3 pA = vertices[face[0]];
+    glm::vec3 pB = vertices[face[1]];
+    glm::vec3 pC = vertices[face[2]];
 
-    // Set face values
-    fN = glm::normalize(fN);
-    faceNormals[iF] = fN;
-    faceAreas[iF] = fA;
+    fN = glm::cross(pB - pA, pC - pA);
+    fA = 0.5 * glm::length(fN);
+  } else if (face.size() > 3) {
 
-    // Update incident vertices
+    glm::vec3 pRoot = vertices[face[0]];
     for (size_t j = 0; j < D; j++) {
       glm::vec3 pA = vertices[face[j]];
       glm::vec3 pB = vertices[face[(j + 1) % D]];
       glm::vec3 pC = vertices[face[(j + 2) % D]];
 
-      vertexAreas[face[j]] += fA / D;
-
-      // Corner angle for weighting normals
-      double dot = glm::dot(glm::normalize(pB - pA), glm::normalize(pC - pA));
-      float angle = std::acos(glm::clamp(-1., 1., dot));
-      glm::vec3 normalContrib = angle * fN;
+      fN += glm::cross(pC - pB, pA - pB);
 
-      if (std::isfinite(normalContrib.x) && std::isfinite(normalContrib.y) && std::isfinite(normalContrib.z)) {
-        vertexNormals[face[(j + 1) % D]] += normalContrib;
+      // _some_ definition of area for a non-triangular face
+      if (j != 0 && j != (D - 1)) {
+        fA += 0.5 * glm::length(glm::cross(pA - pRoot, pB - pRoot));
       }
-
-      // Compute edge lengths while we're at it
-      edgeLengths[edgeIndices[iF][j]] = glm::length(pA - pB);
     }
   }
 
+  // Set face values
+  fN = glm::normalize(fN);
+  faceNormals[iF] = fN;
+  faceAreas[iF] = fA;
 
-  // Normalize vertex normals
-  for (auto& vec : vertexNormals) {
-    double L = glm::length(vec);
-    if (L > 0) {
-      vec /= L;
+  for (size_t j = 0; j < D; j++) {
+    if (halfedgeDefinesEdge[halfedgeIndex(iF, j)]) {
+      edgeLengths[faceEdges(iF)[j]] = glm::length(vertices[face[j]] - vertices[face[(j + 1) % D]]);
     }
   }
 }
 
-void SurfaceMesh::ensureHaveManifoldConnectivity() {
-  if (!faceForHalfedge.empty()) return; // already populated
-
-  faceForHalfedge.resize(nHalfedges());
-  twinHalfedge.resize(nHalfedges());
+void SurfaceMesh::computeVertexGeometry(size_t iV) {
+  glm::vec3 vN{0., 0., 0.};
+  double vA = 0.;
 
-  // Maps from edge (sorted) to all halfedges incident on that edge
-  std::unordered_map<std::pair<size_t, size_t>, std::vector<size_t>,
-                     polyscope::hash_combine::hash<std::pair<size_t, size_t>>>
-      edgeInds;
+  for (size_t iAdj = vertexFaceStart[iV]; iAdj < vertexFaceStart[iV + 1]; iAdj++) {
+    size_t iF = vertexFaces[iAdj];
+    if (iAdj > vertexFaceStart[iV] && vertexFaces[iAdj - 1] == iF) continue; // face has this vertex more than once
 
-  // Fill out faceForHalfedge and populate edge lookup map
-  for (size_t iF = 0; iF < nFaces(); iF++) {
-    auto& face = faces[iF];
+    IndexView face = this->face(iF);
     size_t D = face.size();
+    for (size_t k = 0; k < D; k++) {
+      if (face[k] != iV) continue;
 
+      vA += faceAreas[iF] / D;
 
-    for (size_t j = 0; j < D; j++) {
-      size_t iV = face[j];
-      size_t iVNext = face[(j + 1) % D];
-      size_t iHe = halfedgeIndices[iF][j];
-
-      faceForHalfedge[iHe] = iF;
-
-      std::pair<size_t, size_t> edgeKey(std::min(iV, iVNext), std::max(iV, iVNext));
+      // Weight the face normal by the angle of the preceding corner
+      size_t j = (k + D - 1) % D;
+      glm::vec3 pA = vertices[face[j]];
+      glm::vec3 pB = vertices[face[k]];
+      glm::vec3 pC = vertices[face[(j + 2) % D]];
+      double dot = glm::dot(glm::normalize(pB - pA), glm::normalize(pC - pA));
+      float angle = std::acos(glm::clamp(-1., 1., dot));
+      glm::vec3 normalContrib = angle * faceNormals[iF];
 
-      // Make sure the key is populated
-      auto it = edgeInds.find(edgeKey);
-      if (it == edgeInds.end()) {
-        it = edgeInds.insert(it, {edgeKey, std::vector<size_t>()});
+      if (std::isfinite(normalContrib.x) && std::isfinite(normalContrib.y) && std::isfinite(normalContrib.z)) {
+        vN += normalContrib;
       }
-
-      // Add this halfedge to the entry
-      it->second.push_back(iHe);
     }
   }
 
-  // Second walk through, setting twins
-  for (size_t iF = 0; iF < nFaces(); iF++) {
-    auto& face = faces[iF];
-    size_t D = face.size();
+  double L = glm::length(vN);
+  if (L > 0) {
+    vN /= L;
+  }
+  vertexNormals[iV] = vN;
+  vertexAreas[iV] = vA;
+}
 
-    for (size_t j = 0; j < D; j++) {
-      size_t iV = face[j];
-      size_t iVNext = face[(j + 1) % D];
-      size_t iHe = halfedgeIndices[iF][j];
-
-      std::pair<size_t, size_t> edgeKey(std::min(iV, iVNext), std::max(iV, iVNext));
-      std::vector<size_t>& edgeHalfedges = edgeInds.find(edgeKey)->second;
-
-      // Pick the first halfedge we find which is not this one
-      size_t myTwin = INVALID_IND;
-      for (size_t t : edgeHalfedges) {
-        if (t != iHe) {
-          myTwin = t;
-          break;
-        }
-      }
+void SurfaceMesh::ensureHaveManifoldConnectivity() {
+  if (!faceForHalfedge.empty()) return; // already populated
 
-      twinHalfedge[iHe] = myTwin;
+  faceForHalfedge.resize(nHalfedges());
+  twinHalfedge.resize(nHalfedges());
+
+  parallelFor(0, nFaces(), [&](size_t iF) {
+    for (size_t j = 0; j < faceDegree(iF); j++) {
+      faceForHalfedge[halfedgeIndex(iF, j)] = iF;
     }
-  }
+  });
+
+  // Group the halfedges of each edge by sorting them on their edge index (see computeCounts()). The sort is stable, so
+  // each group lists its halfedges in order, and groups come in order of edge index.
+  unsigned int edgeBits = 1;
+  while ((static_cast<uint64_t>(1) << edgeBits) < nEdges()) edgeBits++;
+  std::vector<uint64_t> edgeKeys(nHalfedges());
+  std::vector<size_t> sortedHalfedges(nHalfedges());
+  parallelFor(0, nHalfedges(), [&](size_t iHe) {
+    edgeKeys[iHe] = halfedgeEdgeIndices[iHe];
+    sortedHalfedges[iHe] = iHe;
+  });
+  parallelSortByKey(edgeKeys, sortedHalfedges, edgeBits);
+  std::vector<size_t> edgeGroupStart(nEdges());
+  parallelFor(0, nHalfedges(), [&](size_t i) {
+    if (i == 0 || edgeKeys[i] != edgeKeys[i - 1]) edgeGroupStart[edgeKeys[i]] = i;
+  });
+
+  // The twin of a halfedge is the first other one on its edge
+  parallelFor(0, nHalfedges(), [&](size_t i) {
+    size_t iStart = edgeGroupStart[edgeKeys[i]];
+    size_t myTwin = INVALID_IND;
+    if (iStart != i) {
+      myTwin = sortedHalfedges[iStart];
+    } else if (i + 1 < nHalfedges() && edgeKeys[i + 1] == edgeKeys[i]) {
+      myTwin = sortedHalfedges[i + 1];
+    }
+    twinHalfedge[sortedHalfedges[i]] = myTwin;
+  });
 }
 
 bool SurfaceMesh::hasFaceTangentSpaces() { return (faceTangentSpaces.size() > 0); }
@@ -259,12 +496,13 @@ void SurfaceMesh::ensureHaveVertexTangentSpaces() {
 }
 
 void SurfaceMesh::generateDefaultFaceTangentSpaces() {
+  restoreGeometryData();
   faceTangentSpaces.resize(nFaces());
 
-  for (size_t iF = 0; iF < nFaces(); iF++) {
-    auto& face = faces[iF];
+  parallelFor(0, nFaces(), [&](size_t iF) {
+    IndexView face = this->face(iF);
     size_t D = face.size();
-    if (D < 2) continue;
+    if (D < 2) return;
 
     glm::vec3 pA = vertices[face[0]];
     glm::vec3 pB = vertices[face[1]];
@@ -277,25 +515,24 @@ void SurfaceMesh::generateDefaultFaceTangentSpaces() {
 
     faceTangentSpaces[iF][0] = basisX;
     faceTangentSpaces[iF][1] = basisY;
-  }
+  });
 }
 
 void SurfaceMesh::generateDefaultVertexTangentSpaces() {
+  restoreGeometryData();
   vertexTangentSpaces.resize(nVertices());
-  std::vector<char> hasTangent(nVertices(), false);
-
-  for (size_t iF = 0; iF < nFaces(); iF++) {
-    auto& face = faces[iF];
-    size_t D = face.size();
-    if (D < 2) continue;
 
-    for (size_t j = 0; j < D; j++) {
+  // Each vertex takes its basis along the outgoing edge of its first corner, in face order
+  parallelFor(0, nVertices(), [&](size_t vA) {
+    for (size_t i = vertexFaceStart[vA]; i < vertexFaceStart[vA + 1]; i++) {
+      IndexView face = this->face(vertexFaces[i]);
+      size_t D = face.size();
+      if (D < 2) continue;
 
-      size_t vA = face[j];
+      size_t j = 0;
+      while (face[j] != vA) j++;
       size_t vB = face[(j + 1) % D];
 
-      if (hasTangent[vA]) continue;
-
       glm::vec3 pA = vertices[vA];
       glm::vec3 pB = vertices[vB];
       glm::vec3 N = vertexNormals[vA];
@@ -307,49 +544,69 @@ void SurfaceMesh::generateDefaultVertexTangentSpaces() {
 
       vertexTangentSpaces[vA][0] = basisX;
       vertexTangentSpaces[vA][1] = basisY;
-
-      hasTangent[vA] = true;
+      return;
     }
-  }
+  });
 }
 
 void SurfaceMesh::draw() {
   if (!isEnabled()) {
     return;
   }
+  if (cornerFillPending()) {
+    return;
+  }
 
   render::engine->setBackfaceCull(backFacePolicy.get() == BackFacePolicy::Cull);
 
+  flushGeometryUpdates();
+  updateLODSelection();
+
   // If no quantity is drawing the surface, we should draw it
   if (dominantQuantity == nullptr) {
 
     if (program == nullptr) {
       prepare();
 
-      // do this now to reduce lag when picking later, etc
-      preparePick();
+      // do this now to reduce lag when picking later, etc (but not for a simplified level, which may change often and
+      // picks on the full mesh)
+      if (lodLevel == 0) {
+        preparePick();
+      }
     }
 
     // Set uniforms
     setStructureUniforms(*program);
     setSurfaceMeshUniforms(*program);
-    program->setUniform("u_baseColor", getSurfaceColor());
+    program->setUniform(baseColorHandle, getSurfaceColor());
+    if (usingIndexedDrawing && wantsDepthSortedTriangles()) {
+      sortTrianglesByDepth(*program, programDepthSortCount, nullptr);
+    }
 
     program->draw();
   }
 
   // Draw the quantities
-  for (auto& x : quantities) {
-    x.second->draw();
+  for (QuantityType* q : getEnabledQuantities()) {
+    q->drawTracked();
   }
 
   render::engine->setBackfaceCull(); // return to default setting
+
+  if (!retainHostData) {
+    releaseHostData();
+  }
 }
 
 void SurfaceMesh::drawPick() {
   if (!isEnabled()) {
     return;
   }
+  if (cornerFillPending()) {
+    return;
+  }
+
+  flushGeometryUpdates();
 
   if (pickProgram == nullptr) {
     preparePick();
@@ -359,6 +616,12 @@ void SurfaceMesh::drawPick() {
 
   // Set uniforms
   setStructureUniforms(*pickProgram);
+  if (usesClusterCulling()) {
+    updateClusterSelection();
+    pickProgram->setDrawRanges(visibleClusterElements);
+  } else {
+    pickProgram->clearDrawRanges();
+  }
 
   pickProgram->draw();
 
@@ -366,18 +629,32 @@ void SurfaceMesh::drawPick() {
 }
 
 void SurfaceMesh::prepare() {
-  program = render::engine->requestShader("MESH", addSurfaceMeshRules({"SHADE_BASECOLOR"}));
+  ScopedCPUTimer timer(profilingName(), "prepare");
+  usingIndexedDrawing = canUseIndexedDrawing();
+  program = render::engine->requestShader(usingIndexedDrawing ? "MESH_INDEXED" : "MESH",
+                                          addSurfaceMeshRules({"SHADE_BASECOLOR"}));
+  baseColorHandle = program->getUniformHandle("u_baseColor");
 
   // Populate draw buffers
-  fillGeometryBuffers(*program);
+  depthSortValid = false;
+  programDepthSortCount = 0;
+  if (usingIndexedDrawing) {
+    fillGeometryBuffersIndexed(*program);
+  } else {
+    fillGeometryBuffers(*program);
+  }
   render::engine->setMaterial(*program, getMaterial());
 }
 
-void SurfaceMesh::preparePick() {
+bool SurfaceMesh::canUseIndexedDrawing() {
+  // Indexed drawing shares each vertex between all of its faces, so it can only be used when nothing needs values which
+  // vary per-corner (flat normals, wireframe barycentric coordinates, or per-face cull positions)
+  return isSmoothShade() && getEdgeWidth() == 0. && !wantsCullPosition() &&
+         nVertices() < static_cast<size_t>(std::numeric_limits<unsigned int>::max());
+}
 
-  // Create a new program
-  pickProgram = render::engine->requestShader("MESH", addSurfaceMeshRules({"MESH_PROPAGATE_PICK"}, true, false),
-                                              render::ShaderReplacementDefaults::Pick);
+void SurfaceMesh::preparePick() {
+  restoreGeometryData();
 
   // Get element indices
   size_t totalPickElements = nVertices() + nFaces() + nEdges() + nHalfedges();
@@ -388,70 +665,121 @@ void SurfaceMesh::preparePick() {
   halfedgePickIndStart = edgePickIndStart + nEdges();
 
   // In "global" indices, indexing all elements in the scene, used to fill buffers for drawing here
+  pick::releasePickBufferRanges(this); // (the range from the last time the pick program was built)
   size_t pickStart = pick::requestPickBufferRange(this, totalPickElements);
   size_t faceGlobalPickIndStart = pickStart + nVertices();
   size_t edgeGlobalPickIndStart = faceGlobalPickIndStart + nFaces();
   size_t halfedgeGlobalPickIndStart = edgeGlobalPickIndStart + nEdges();
 
+  // When the shared buffers hold the full mesh, the pick colors are computed per fragment from element indices read
+  // from per-triangle textures, so the pick program stores nothing per corner. (The indices are stored as floats, see
+  // canUseFaceTextures().)
+  const size_t maxExactIndex = static_cast<size_t>(1) << 24;
+  if (lodLevel == 0 && canUseFaceTextures() && nVertices() <= maxExactIndex && nEdges() <= maxExactIndex &&
+      nHalfedges() <= maxExactIndex) {
+    pickProgram =
+        render::engine->requestShader("MESH", addSurfaceMeshRules({"MESH_PROPAGATE_PICK_TEXTURE"}, true, false),
+                                      render::ShaderReplacementDefaults::Pick);
+
+    if (!pickTriangleVertices) {
+      ScratchVector<glm::vec3> scratch[3];
+      std::vector<glm::vec3>& triangleVertices = *scratch[0];
+      std::vector<glm::vec3>& triangleEdges = *scratch[1];
+      std::vector<glm::vec3>& triangleHalfedges = *scratch[2];
+      triangleVertices.reserve(nFacesTriangulation());
+      triangleEdges.reserve(nFacesTriangulation());
+      triangleHalfedges.reserve(nFacesTriangulation());
+      auto ind = [](size_t i) { return static_cast<float>(i); };
+      for (size_t iDrawn = 0; iDrawn < nFaces(); iDrawn++) {
+        size_t iF = faceInDrawOrder(iDrawn);
+        IndexView face = this->face(iF);
+        IndexView edges = faceEdges(iF);
+        size_t D = face.size();
+        for (size_t j = 1; (j + 1) < D; j++) {
+          triangleVertices.push_back(glm::vec3{ind(face[0]), ind(face[j]), ind(face[j + 1])});
+
+          // only the first and last triangles of a face have real edges on their outer sides
+          glm::vec3 e{-1., ind(edges[j]), -1.};
+          glm::vec3 he{-1., ind(halfedgeIndex(iF, j)), -1.};
+          if (j == 1) {
+            e.x = ind(edges[0]);
+            he.x = ind(halfedgeIndex(iF, 0));
+          }
+          if (j + 2 == D) {
+            e.z = ind(edges[D - 1]);
+            he.z = ind(halfedgeIndex(iF, D - 1));
+          }
+          triangleEdges.push_back(e);
+          triangleHalfedges.push_back(he);
+        }
+      }
+      render::ScopedGPUMemoryAccount account(gpuMemory);
+      pickTriangleVertices = render::engine->generateElementTexture(triangleVertices);
+      pickTriangleEdges = render::engine->generateElementTexture(triangleEdges);
+      pickTriangleHalfedges = render::engine->generateElementTexture(triangleHalfedges);
+    }
+
+    ensureCornerBuffers(false, true, false, wantsCullPosition());
+    pickProgram->setAttribute("a_position", cornerPositions);
+    pickProgram->setAttribute("a_normal", cornerFaceNormals);
+    if (wantsCullPosition()) {
+      pickProgram->setAttribute("a_cullPos", cornerCullPos);
+    }
+    setFaceTextureUniforms(*pickProgram);
+    pickProgram->setTextureFromBuffer("t_triangleVertices", pickTriangleVertices.get());
+    pickProgram->setTextureFromBuffer("t_triangleEdges", pickTriangleEdges.get());
+    pickProgram->setTextureFromBuffer("t_triangleHalfedges", pickTriangleHalfedges.get());
+    pickProgram->setUniform("u_pickStart", pick::indToVec(pickStart));
+    pickProgram->setUniform("u_facePickStart", pick::indToVec(faceGlobalPickIndStart));
+    pickProgram->setUniform("u_edgePickStart", pick::indToVec(edgeGlobalPickIndStart));
+    pickProgram->setUniform("u_halfedgePickStart", pick::indToVec(halfedgeGlobalPickIndStart));
+    return;
+  }
+
+  // Otherwise, build the pick colors of each corner
+  pickProgram = render::engine->requestShader("MESH", addSurfaceMeshRules({"MESH_PROPAGATE_PICK"}, true, false),
+                                              render::ShaderReplacementDefaults::Pick);
+
   // == Fill buffers
-  bool wantsBarycenters = wantsCullPosition();
+  // (the geometry is shared with the other programs, only the pick colors are particular to this one, unless the
+  // shared buffers hold a simplified level of detail)
+  bool fullGeometry = lodLevel != 0;
+  if (!fullGeometry) {
+    ensureCornerBuffers(false, true, false, wantsCullPosition());
+  }
 
-  std::vector<glm::vec3> positions;
-  std::vector<glm::vec3> normals;
-  std::vector<glm::vec3> bcoord;
-  std::vector<std::array<glm::vec3, 3>> vertexColors, edgeColors, halfedgeColors;
-  std::vector<glm::vec3> faceColor;
-  std::vector<glm::vec3> barycenters;
+  // (in scratch storage, reused by the next fill)
+  ScratchVector<std::array<glm::vec3, 3>> colorScratch[3];
+  ScratchVector<glm::vec3> scratch[4];
+  std::vector<std::array<glm::vec3, 3>>& vertexColors = *colorScratch[0];
+  std::vector<std::array<glm::vec3, 3>>& edgeColors = *colorScratch[1];
+  std::vector<std::array<glm::vec3, 3>>& halfedgeColors = *colorScratch[2];
+  std::vector<glm::vec3>& faceColor = *scratch[0];
+  std::vector<glm::vec3>& positions = *scratch[1];
+  std::vector<glm::vec3>& normals = *scratch[2];
+  std::vector<glm::vec3>& cullPos = *scratch[3];
 
   // Reserve space
-  positions.reserve(3 * nFacesTriangulation());
-  bcoord.reserve(3 * nFacesTriangulation());
   vertexColors.reserve(3 * nFacesTriangulation());
   edgeColors.reserve(3 * nFacesTriangulation());
   halfedgeColors.reserve(3 * nFacesTriangulation());
   faceColor.reserve(3 * nFacesTriangulation());
-  normals.reserve(3 * nFacesTriangulation());
-  if (wantsBarycenters) {
-    barycenters.reserve(3 * nFacesTriangulation());
-  }
 
   // Build all quantities in each face
-  for (size_t iF = 0; iF < nFaces(); iF++) {
-    auto& face = faces[iF];
+  for (size_t iDrawn = 0; iDrawn < nFaces(); iDrawn++) {
+    size_t iF = faceInDrawOrder(iDrawn);
+    IndexView face = this->face(iF);
     size_t D = face.size();
-    glm::vec3 faceN = faceNormals[iF];
-
-    glm::vec3 barycenter;
-    if (wantsBarycenters) {
-      barycenter = faceCenter(iF);
-    }
 
     // implicitly triangulate from root
     size_t vRoot = face[0];
-    glm::vec3 pRoot = vertices[vRoot];
     for (size_t j = 1; (j + 1) < D; j++) {
       size_t vB = face[j];
-      glm::vec3 pB = vertices[vB];
       size_t vC = face[(j + 1) % D];
-      glm::vec3 pC = vertices[vC];
 
       glm::vec3 fColor = pick::indToVec(iF + faceGlobalPickIndStart);
       std::array<size_t, 3> vertexInds = {vRoot, vB, vC};
 
-      positions.push_back(pRoot);
-      positions.push_back(pB);
-      positions.push_back(pC);
-
-      normals.push_back(faceN);
-      normals.push_back(faceN);
-      normals.push_back(faceN);
-
-      if (wantsBarycenters) {
-        barycenters.push_back(barycenter);
-        barycenters.push_back(barycenter);
-        barycenters.push_back(barycenter);
-      }
-
       // Build all quantities
       std::array<glm::vec3, 3> vColor;
 
@@ -461,21 +789,29 @@ void SurfaceMesh::preparePick() {
 
         // Vertex index color
         vColor[i] = pick::indToVec(vertexInds[i] + pickStart);
+
+        if (fullGeometry) {
+          positions.push_back(vertices[vertexInds[i]]);
+          normals.push_back(faceNormals[iF]);
+          if (wantsCullPosition()) {
+            cullPos.push_back(faceCenter(iF));
+          }
+        }
       }
 
-      std::array<glm::vec3, 3> eColor = {fColor, pick::indToVec(edgeIndices[iF][j] + edgeGlobalPickIndStart), fColor};
-      std::array<glm::vec3, 3> heColor = {fColor, pick::indToVec(halfedgeIndices[iF][j] + halfedgeGlobalPickIndStart),
+      std::array<glm::vec3, 3> eColor = {fColor, pick::indToVec(faceEdges(iF)[j] + edgeGlobalPickIndStart), fColor};
+      std::array<glm::vec3, 3> heColor = {fColor, pick::indToVec(halfedgeIndex(iF, j) + halfedgeGlobalPickIndStart),
                                           fColor};
 
       // First edge is a real edge
       if (j == 1) {
-        eColor[0] = pick::indToVec(edgeIndices[iF][0] + edgeGlobalPickIndStart);
-        heColor[0] = pick::indToVec(halfedgeIndices[iF][0] + halfedgeGlobalPickIndStart);
+        eColor[0] = pick::indToVec(faceEdges(iF)[0] + edgeGlobalPickIndStart);
+        heColor[0] = pick::indToVec(halfedgeIndex(iF, 0) + halfedgeGlobalPickIndStart);
       }
       // Last is a real edge
       if (j + 2 == D) {
-        eColor[2] = pick::indToVec(edgeIndices[iF].back() + edgeGlobalPickIndStart);
-        heColor[2] = pick::indToVec(halfedgeIndices[iF].back() + halfedgeGlobalPickIndStart);
+        eColor[2] = pick::indToVec(faceEdges(iF).back() + edgeGlobalPickIndStart);
+        heColor[2] = pick::indToVec(halfedgeIndex(iF, D - 1) + halfedgeGlobalPickIndStart);
       }
 
       // Push three copies of the values needed at each vertex
@@ -484,25 +820,27 @@ void SurfaceMesh::preparePick() {
         edgeColors.push_back(eColor);
         halfedgeColors.push_back(heColor);
       }
-
-      // Barycoords
-      bcoord.push_back(glm::vec3{1.0, 0.0, 0.0});
-      bcoord.push_back(glm::vec3{0.0, 1.0, 0.0});
-      bcoord.push_back(glm::vec3{0.0, 0.0, 1.0});
     }
   }
 
   // Store data in buffers
-  pickProgram->setAttribute("a_position", positions);
-  pickProgram->setAttribute("a_barycoord", bcoord);
-  pickProgram->setAttribute("a_normal", normals);
+  if (fullGeometry) {
+    pickProgram->setAttribute("a_position", positions);
+    pickProgram->setAttribute("a_normal", normals);
+    if (wantsCullPosition()) {
+      pickProgram->setAttribute("a_cullPos", cullPos);
+    }
+  } else {
+    pickProgram->setAttribute("a_position", cornerPositions);
+    pickProgram->setAttribute("a_normal", cornerFaceNormals);
+    if (wantsCullPosition()) {
+      pickProgram->setAttribute("a_cullPos", cornerCullPos);
+    }
+  }
   pickProgram->setAttribute<glm::vec3, 3>("a_vertexColors", vertexColors);
   pickProgram->setAttribute<glm::vec3, 3>("a_edgeColors", edgeColors);
   pickProgram->setAttribute<glm::vec3, 3>("a_halfedgeColors", halfedgeColors);
   pickProgram->setAttribute("a_faceColor", faceColor);
-  if (wantsCullPosition()) {
-    pickProgram->setAttribute("a_cullPos", barycenters);
-  }
 }
 
 std::vector<std::string> SurfaceMesh::addSurfaceMeshRules(std::vector<std::string> initRules, bool withMesh,
@@ -511,6 +849,10 @@ std::vector<std::string> SurfaceMesh::addSurfaceMeshRules(std::vector<std::strin
 
   if (withMesh) {
 
+    if (gpuNormals.get()) {
+      initRules.push_back("MESH_COMPUTE_NORMAL_FROM_POSITION"); // (before the back face flip)
+    }
+
     if (withSurfaceShade) {
       // rules that only get used when we're shading the surface of the mesh
       if (getEdgeWidth() > 0) {
@@ -543,85 +885,197 @@ std::vector<std::string> SurfaceMesh::addSurfaceMeshRules(std::vector<std::strin
   return initRules;
 }
 
+namespace {
+
+// The uniforms setSurfaceMeshUniforms() sets every frame, looked up once for each program (see
+// ShaderProgram::userData()). Those a program does not have are invalid.
+struct SurfaceMeshUniformHandles {
+  SurfaceMeshUniformHandles(render::ShaderProgram& p)
+      : edgeWidth(p.getUniformHandle("u_edgeWidth")), edgeColor(p.getUniformHandle("u_edgeColor")),
+        backfaceColor(p.getUniformHandle("u_backfaceColor")) {}
+
+  render::ShaderUniformHandle edgeWidth, edgeColor, backfaceColor;
+};
+
+} // namespace
+
 void SurfaceMesh::setSurfaceMeshUniforms(render::ShaderProgram& p) {
+  const SurfaceMeshUniformHandles& h = p.userData<SurfaceMeshUniformHandles>();
   if (getEdgeWidth() > 0) {
-    p.setUniform("u_edgeWidth", getEdgeWidth() * render::engine->getCurrentPixelScaling());
-    p.setUniform("u_edgeColor", getEdgeColor());
+    p.setUniform(h.edgeWidth, getEdgeWidth() * render::engine->getCurrentPixelScaling());
+    p.setUniform(h.edgeColor, getEdgeColor());
   }
   if (backFacePolicy.get() == BackFacePolicy::Custom) {
-    p.setUniform("u_backfaceColor", getBackFaceColor());
+    p.setUniform(h.backfaceColor, getBackFaceColor());
+  }
+  if (usesClusterCulling()) {
+    updateClusterSelection();
+    p.setDrawRanges(visibleClusterElements);
+  } else {
+    p.clearDrawRanges();
   }
 }
 
 void SurfaceMesh::fillGeometryBuffers(render::ShaderProgram& p) {
-  std::vector<glm::vec3> positions;
-  std::vector<glm::vec3> normals;
-  std::vector<glm::vec3> bcoord;
-  std::vector<glm::vec3> edgeReal;
-  std::vector<glm::vec3> barycenters;
-
-  bool wantsBary = p.hasAttribute("a_barycoord");
+  ScopedCPUTimer timer(profilingName(), "fillGeometryBuffers");
   bool wantsEdge = p.hasAttribute("a_edgeIsReal");
-  bool wantsBarycenters = wantsCullPosition();
+  ensureCornerBuffers(isSmoothShade(), !isSmoothShade(), wantsEdge, wantsCullPosition());
 
-  positions.reserve(3 * nFacesTriangulation());
-  normals.reserve(3 * nFacesTriangulation());
-  if (wantsBary) {
-    bcoord.reserve(3 * nFacesTriangulation());
-  }
+  p.setAttribute("a_position", cornerPositions);
+  p.setAttribute("a_normal", isSmoothShade() ? cornerVertexNormals : cornerFaceNormals);
   if (wantsEdge) {
-    edgeReal.reserve(3 * nFacesTriangulation());
+    p.setAttribute("a_edgeIsReal", cornerEdgeIsReal);
   }
-  if (wantsBarycenters) {
-    barycenters.reserve(3 * nFacesTriangulation());
+  if (wantsCullPosition()) {
+    p.setAttribute("a_cullPos", cornerCullPos);
   }
+}
 
-  for (size_t iF = 0; iF < nFaces(); iF++) {
-    auto& face = faces[iF];
+std::shared_ptr<render::AttributeBuffer> SurfaceMesh::getVertexPositionBuffer() {
+  if (sharedPositions) {
+    return sharedPositions->getRenderBuffer();
+  }
+  if (!vertexPositionBuffer) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    vertexPositionBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    vertexPositionBuffer->setData(vertices);
+  }
+  return vertexPositionBuffer;
+}
+
+std::shared_ptr<render::AttributeBuffer> SurfaceMesh::getFaceCenterBuffer() {
+  if (!faceCenterBuffer) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    faceCenterBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    faceCenterBuffer->setData(faceCenters(0, nFaces()));
+  }
+  return faceCenterBuffer;
+}
+
+std::vector<glm::vec3> SurfaceMesh::faceCenters(size_t faceStart, size_t faceEnd) {
+  std::vector<glm::vec3> centers(faceEnd - faceStart);
+  parallelFor(faceStart, faceEnd, [&](size_t iF) { centers[iF - faceStart] = faceCenter(iF); });
+  return centers;
+}
+
+bool SurfaceMesh::canUseFaceTextures() {
+  const size_t maxExactIndex = static_cast<size_t>(1) << 24;
+  return nFaces() <= maxExactIndex && nFacesTriangulationCount <= maxExactIndex;
+}
+
+void SurfaceMesh::setFaceTextureUniforms(render::ShaderProgram& p) {
+  if (!triangleFaceTexture) {
+    std::vector<float> triangleFace;
+    triangleFace.reserve(nFacesTriangulationCount);
+    forEachDrawnFace([&](size_t iF, IndexView face) {
+      for (size_t j = 2; j < face.size(); j++) {
+        triangleFace.push_back(static_cast<float>(iF));
+      }
+    });
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    triangleFaceTexture = render::engine->generateElementTexture(triangleFace);
+  }
+  p.setTextureFromBuffer("t_triangleFace", triangleFaceTexture.get());
+}
+
+std::shared_ptr<render::TextureBuffer> SurfaceMesh::generateFaceTexture(const std::vector<float>& faceData) {
+  return render::engine->generateElementTexture(faceData);
+}
+
+std::shared_ptr<render::TextureBuffer> SurfaceMesh::generateFaceTexture(const std::vector<glm::vec3>& faceData) {
+  return render::engine->generateElementTexture(faceData);
+}
+
+// The CPU side of the corner buffers, for those which are wanted
+struct SurfaceMesh::CornerData {
+  bool withPositions = false, withVertexNormals = false, withFaceNormals = false, withEdgeIsReal = false,
+       withCullPos = false;
+  ScratchVector<glm::vec3> positions, vNormals, fNormals, edgeReal, barycenters;
+};
+
+void SurfaceMesh::ensureCornerBuffers(bool withVertexNormals, bool withFaceNormals, bool withEdgeIsReal,
+                                      bool withCullPos) {
+  if (cornerFillTask) {
+    // use the background fill rather than repeating it
+    cornerFillTask->finish();
+    cornerFillTask.reset();
+    uploadCornerData(*cornerFillData);
+    cornerFillData.reset();
+  }
+
+  CornerData data;
+  data.withPositions = !cornerPositions;
+  data.withVertexNormals = withVertexNormals && !cornerVertexNormals;
+  data.withFaceNormals = withFaceNormals && !cornerFaceNormals;
+  data.withEdgeIsReal = withEdgeIsReal && !cornerEdgeIsReal;
+  data.withCullPos = withCullPos && !cornerCullPos;
+  if (!(data.withPositions || data.withVertexNormals || data.withFaceNormals || data.withEdgeIsReal ||
+        data.withCullPos)) {
+    return;
+  }
+
+  restoreGeometryData(); // (only once something must be filled, the buffers are kept when the host data is released)
+  fillCornerData(data);
+  uploadCornerData(data);
+}
+
+void SurfaceMesh::fillCornerData(CornerData& data) {
+  // (runs on a background thread for large meshes: only reads the geometry)
+  if (data.withPositions) {
+    data.positions->reserve(3 * nFacesTriangulation());
+  }
+  if (data.withVertexNormals) {
+    data.vNormals->reserve(3 * nFacesTriangulation());
+  }
+  if (data.withFaceNormals) {
+    data.fNormals->reserve(3 * nFacesTriangulation());
+  }
+  if (data.withEdgeIsReal) {
+    data.edgeReal->reserve(3 * nFacesTriangulation());
+  }
+  if (data.withCullPos) {
+    data.barycenters->reserve(3 * nFacesTriangulation());
+  }
+
+  forEachDrawnFace([&](size_t iF, IndexView face) {
     size_t D = face.size();
     glm::vec3 faceN = faceNormals[iF];
+    if (lodLevel != 0 && data.withFaceNormals) {
+      // a simplified face has moved corners, so it gets its own normal
+      glm::vec3 pRoot = vertices[face[0]];
+      glm::vec3 N{0., 0., 0.};
+      for (size_t j = 1; (j + 1) < D; j++) {
+        N += glm::cross(vertices[face[j]] - pRoot, vertices[face[j + 1]] - pRoot);
+      }
+      faceN = glm::normalize(N);
+    }
 
     glm::vec3 barycenter;
-    if (wantsBarycenters) {
+    if (data.withCullPos) {
       barycenter = faceCenter(iF);
     }
 
     // implicitly triangulate from root
     size_t vRoot = face[0];
-    glm::vec3 pRoot = vertices[vRoot];
     for (size_t j = 1; (j + 1) < D; j++) {
-      size_t vB = face[j];
-      glm::vec3 pB = vertices[vB];
-      size_t vC = face[(j + 1) % D];
-      glm::vec3 pC = vertices[vC];
-
-      positions.push_back(pRoot);
-      positions.push_back(pB);
-      positions.push_back(pC);
-
-      if (isSmoothShade()) {
-        normals.push_back(vertexNormals[vRoot]);
-        normals.push_back(vertexNormals[vB]);
-        normals.push_back(vertexNormals[vC]);
-      } else {
-        normals.push_back(faceN);
-        normals.push_back(faceN);
-        normals.push_back(faceN);
-      }
-
-      if (wantsBary) {
-        bcoord.push_back(glm::vec3{1., 0., 0.});
-        bcoord.push_back(glm::vec3{0., 1., 0.});
-        bcoord.push_back(glm::vec3{0., 0., 1.});
-      }
+      std::array<size_t, 3> vertexInds = {vRoot, face[j], face[(j + 1) % D]};
 
-      if (wantsBarycenters) {
-        barycenters.push_back(barycenter);
-        barycenters.push_back(barycenter);
-        barycenters.push_back(barycenter);
+      for (size_t k = 0; k < 3; k++) {
+        if (data.withPositions) {
+          data.positions->push_back(vertices[vertexInds[k]]);
+        }
+        if (data.withVertexNormals) {
+          data.vNormals->push_back(vertexNormals[vertexInds[k]]);
+        }
+        if (data.withFaceNormals) {
+          data.fNormals->push_back(faceN);
+        }
+        if (data.withCullPos) {
+          data.barycenters->push_back(barycenter);
+        }
       }
 
-      if (wantsEdge) {
+      if (data.withEdgeIsReal) {
         glm::vec3 edgeRealV{0., 1., 0.};
         if (j == 1) {
           edgeRealV.x = 1.;
@@ -629,25 +1083,332 @@ void SurfaceMesh::fillGeometryBuffers(render::ShaderProgram& p) {
         if (j + 2 == D) {
           edgeRealV.z = 1.;
         }
-        edgeReal.push_back(edgeRealV);
-        edgeReal.push_back(edgeRealV);
-        edgeReal.push_back(edgeRealV);
+        data.edgeReal->push_back(edgeRealV);
+        data.edgeReal->push_back(edgeRealV);
+        data.edgeReal->push_back(edgeRealV);
       }
     }
+  });
+}
+
+void SurfaceMesh::uploadCornerData(const CornerData& data) {
+  // these are shared by every program of the mesh, so charge them to the mesh even when a quantity asked for them
+  render::ScopedGPUMemoryAccount account(gpuMemory);
+
+  auto upload = [](std::shared_ptr<render::AttributeBuffer>& buffer, const std::vector<glm::vec3>& values) {
+    buffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    buffer->setData(values);
+  };
+  if (data.withPositions) upload(cornerPositions, *data.positions);
+  if (data.withVertexNormals) upload(cornerVertexNormals, *data.vNormals);
+  if (data.withFaceNormals) upload(cornerFaceNormals, *data.fNormals);
+  if (data.withEdgeIsReal) upload(cornerEdgeIsReal, *data.edgeReal);
+  if (data.withCullPos) upload(cornerCullPos, *data.barycenters);
+}
+
+bool SurfaceMesh::cornerFillPending() {
+  if (!cornerFillTask) {
+    if (cornerPositions || lodLevel != 0 || nFacesTriangulation() < options::backgroundPrepareMinTriangles) {
+      return false;
+    }
+
+    // Everything the mesh and its picking draw with
+    restoreGeometryData();
+    cornerFillData.reset(new CornerData());
+    CornerData* data = cornerFillData.get();
+    data->withPositions = true;
+    data->withVertexNormals = isSmoothShade();
+    data->withFaceNormals = true;
+    data->withEdgeIsReal = getEdgeWidth() > 0;
+    data->withCullPos = wantsCullPosition();
+    cornerFillTask.reset(
+        new BackgroundTask(internal::getBufferPreparationQueue(), [this, data]() { fillCornerData(*data); }));
   }
 
-  // Store data in buffers
+  if (!cornerFillTask->isDone() && !internal::finishBackgroundFills) {
+    requestRedraw(); // check again next frame
+    return true;
+  }
+
+  ScopedCPUTimer timer(profilingName(), "upload background fill");
+  cornerFillTask->finish();
+  cornerFillTask.reset();
+  uploadCornerData(*cornerFillData);
+  cornerFillData.reset();
+  return false;
+}
+
+void SurfaceMesh::cancelCornerFill() {
+  if (!cornerFillTask) return;
+  cornerFillTask->finish();
+  cornerFillTask.reset();
+  cornerFillData.reset();
+}
+
+void SurfaceMesh::releaseCornerBuffers() {
+  cancelCornerFill();
+  cornerPositions.reset();
+  cornerVertexNormals.reset();
+  cornerFaceNormals.reset();
+  cornerEdgeIsReal.reset();
+  cornerCullPos.reset();
+  triangleFaceTexture.reset();
+  pickTriangleVertices.reset();
+  pickTriangleEdges.reset();
+  pickTriangleHalfedges.reset();
+}
+
+void SurfaceMesh::updateCornerBuffers(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  if (!cornerPositions) return;
+
+  // Same corner layout as ensureCornerBuffers(), but written directly: in order, faces before iF hold faceStart(iF)
+  // corners, which triangulate to faceStart(iF) - 2 * iF triangles. The ranges are runs of draw positions.
+  auto firstCorner = [&](size_t pos) {
+    return 3 * (faceDrawOrder.empty() ? faceStart(pos) - 2 * pos : drawnTriangleStart[pos]);
+  };
+  restoreGeometryData();
+  bool wantsVertexNormals = cornerVertexNormals != nullptr && !gpuNormals.get();
+  bool wantsFaceNormals = cornerFaceNormals != nullptr && !gpuNormals.get();
+  bool wantsBarycenters = cornerCullPos != nullptr;
+
+  std::vector<std::pair<size_t, size_t>> drawnRanges = faceRanges;
+  if (!faceDrawOrder.empty()) {
+    // (the faces of a range are scattered along the curve)
+    DirtyRanges dirtyPositions;
+    for (const std::pair<size_t, size_t>& range : faceRanges) {
+      if (range.second - range.first == nFaces()) {
+        dirtyPositions.markAll(nFaces());
+        continue;
+      }
+      for (size_t iF = range.first; iF < range.second; iF++) {
+        dirtyPositions.mark(faceDrawPosition[iF]);
+      }
+    }
+    drawnRanges = dirtyPositions.coalesced();
+  }
+
+  for (const std::pair<size_t, size_t>& range : drawnRanges) {
+    size_t cornerStart = firstCorner(range.first);
+    size_t nCorners = firstCorner(range.second) - cornerStart;
+    ScratchVector<glm::vec3> scratch[4];
+    std::vector<glm::vec3>& positions = *scratch[0];
+    std::vector<glm::vec3>& vNormals = *scratch[1];
+    std::vector<glm::vec3>& fNormals = *scratch[2];
+    std::vector<glm::vec3>& barycenters = *scratch[3];
+    positions.resize(nCorners);
+    vNormals.resize(wantsVertexNormals ? nCorners : 0);
+    fNormals.resize(wantsFaceNormals ? nCorners : 0);
+    barycenters.resize(wantsBarycenters ? nCorners : 0);
+
+    parallelFor(range.first, range.second, [&](size_t pos) {
+      size_t iF = faceInDrawOrder(pos);
+      IndexView face = this->face(iF);
+      size_t D = face.size();
+      size_t iC = firstCorner(pos) - cornerStart;
+      glm::vec3 barycenter;
+      if (wantsBarycenters) {
+        barycenter = faceCenter(iF);
+      }
+
+      size_t vRoot = face[0];
+      for (size_t j = 1; (j + 1) < D; j++) {
+        std::array<size_t, 3> vertexInds = {vRoot, face[j], face[j + 1]};
+        for (size_t k = 0; k < 3; k++) {
+          positions[iC + k] = vertices[vertexInds[k]];
+          if (wantsVertexNormals) {
+            vNormals[iC + k] = vertexNormals[vertexInds[k]];
+          }
+          if (wantsFaceNormals) {
+            fNormals[iC + k] = faceNormals[iF];
+          }
+          if (wantsBarycenters) {
+            barycenters[iC + k] = barycenter;
+          }
+        }
+        iC += 3;
+      }
+    });
+
+    int offset = static_cast<int>(cornerStart);
+    int size = static_cast<int>(nCorners);
+    cornerPositions->setData(positions, true, offset, size);
+    if (wantsVertexNormals) {
+      cornerVertexNormals->setData(vNormals, true, offset, size);
+    }
+    if (wantsFaceNormals) {
+      cornerFaceNormals->setData(fNormals, true, offset, size);
+    }
+    if (wantsBarycenters) {
+      cornerCullPos->setData(barycenters, true, offset, size);
+    }
+  }
+}
+
+void SurfaceMesh::fillGeometryBuffersIndexed(render::ShaderProgram& p) {
+  ScopedCPUTimer timer(profilingName(), "fillGeometryBuffers");
+  restoreGeometryData();
+  ScratchVector<std::array<unsigned int, 3>> scratch;
+  std::vector<std::array<unsigned int, 3>>& triangles = *scratch;
+  drawnTriangles(triangles);
+
+  if (sharedPositions) {
+    p.setAttribute("a_position", sharedPositions->getRenderBuffer());
+  } else {
+    p.setAttribute("a_position", vertices);
+  }
+  p.setAttribute("a_normal", vertexNormals);
+  p.setIndex(triangles);
+}
+
+void SurfaceMesh::fillGeometryBuffersIndexed(render::ShaderProgram& p, const std::vector<uint32_t>& splitVertices,
+                                             std::vector<std::array<unsigned int, 3>>& triangles) {
+  ScopedCPUTimer timer(profilingName(), "fillGeometryBuffers");
+  restoreGeometryData();
+  std::vector<glm::vec3> positions(splitVertices.size());
+  std::vector<glm::vec3> normals(splitVertices.size());
+  parallelFor(0, splitVertices.size(), [&](size_t i) {
+    positions[i] = vertices[splitVertices[i]];
+    normals[i] = vertexNormals[splitVertices[i]];
+  });
   p.setAttribute("a_position", positions);
   p.setAttribute("a_normal", normals);
-  if (wantsBary) {
-    p.setAttribute("a_barycoord", bcoord);
+  p.setIndex(triangles);
+}
+
+void SurfaceMesh::drawnTriangles(std::vector<std::array<unsigned int, 3>>& triangles) {
+  // Triangulate each face as a fan around its first vertex, like fillGeometryBuffers()
+  triangles.clear();
+  triangles.reserve(nFacesTriangulation());
+  forEachDrawnFace([&](size_t, IndexView face) {
+    size_t D = face.size();
+    unsigned int vRoot = static_cast<unsigned int>(face[0]);
+    for (size_t j = 1; (j + 1) < D; j++) {
+      triangles.push_back({vRoot, static_cast<unsigned int>(face[j]), static_cast<unsigned int>(face[j + 1])});
+    }
+  });
+}
+
+bool SurfaceMesh::wantsDepthSortedTriangles() {
+  // (cluster culling draws ranges of the triangles in their original order, so they can't be reordered)
+  return options::transparencySortTriangles && getTransparency() < 1. &&
+         render::engine->getTransparencyMode() == TransparencyMode::Simple && !usesClusterCulling();
+}
+
+void SurfaceMesh::sortTrianglesByDepth(
+    render::ShaderProgram& p, size_t& programSortCount,
+    const std::function<void(std::vector<std::array<unsigned int, 3>>&)>& fillTriangles) {
+  glm::mat4 modelView = getModelView();
+  bool orderValid = depthSortValid && modelView == depthSortModelView;
+  if (orderValid && programSortCount == depthSortCount) return;
+  ScopedCPUTimer timer(profilingName(), "sortTrianglesByDepth");
+
+  // (only the vertices and faces are read, which are kept even without setRetainHostData())
+  ScratchVector<std::array<unsigned int, 3>> scratch;
+  std::vector<std::array<unsigned int, 3>>& triangles = *scratch;
+  bool haveMeshTriangles = false;
+
+  if (!orderValid) {
+    drawnTriangles(triangles);
+    haveMeshTriangles = true;
+
+    // Key each triangle by the view-space depth of its center, farthest (most negative) first
+    glm::vec4 depthRow{modelView[0][2], modelView[1][2], modelView[2][2], modelView[3][2]};
+    std::vector<uint64_t> keys(triangles.size());
+    depthSortOrder.resize(triangles.size());
+    parallelFor(0, triangles.size(), [&](size_t iT) {
+      glm::vec3 center = (vertices[triangles[iT][0]] + vertices[triangles[iT][1]] + vertices[triangles[iT][2]]) / 3.f;
+      keys[iT] = floatOrderKey(glm::dot(depthRow, glm::vec4(center, 1.f)));
+      depthSortOrder[iT] = iT;
+    });
+    parallelSortByKey(keys, depthSortOrder, 32);
+
+    depthSortModelView = modelView;
+    depthSortValid = true;
+    depthSortCount++;
   }
-  if (wantsEdge) {
-    p.setAttribute("a_edgeIsReal", edgeReal);
+
+  if (fillTriangles) {
+    fillTriangles(triangles);
+  } else if (!haveMeshTriangles) {
+    drawnTriangles(triangles);
   }
-  if (wantsCullPosition()) {
-    p.setAttribute("a_cullPos", barycenters);
+  if (triangles.size() != depthSortOrder.size()) {
+    throw std::logic_error("sortTrianglesByDepth() on [" + name + "] with triangles not listed like the mesh's");
+  }
+
+  ScratchVector<std::array<unsigned int, 3>> sortedScratch;
+  std::vector<std::array<unsigned int, 3>>& sorted = *sortedScratch;
+  sorted.resize(triangles.size());
+  parallelFor(0, triangles.size(), [&](size_t i) { sorted[i] = triangles[depthSortOrder[i]]; });
+  p.setIndex(sorted);
+  programSortCount = depthSortCount;
+}
+
+void SurfaceMesh::ensurePickBVH() {
+  if (pickBVH) return;
+
+  pickTriangles.clear();
+  for (size_t iF = 0; iF < nFaces(); iF++) {
+    IndexView f = face(iF);
+    for (size_t j = 1; j + 1 < f.size(); j++) {
+      pickTriangles.push_back({f.data[0], f.data[j], f.data[j + 1], static_cast<uint32_t>(iF)});
+    }
+  }
+
+  std::vector<glm::vec3> triMin(pickTriangles.size());
+  std::vector<glm::vec3> triMax(pickTriangles.size());
+  parallelFor(0, pickTriangles.size(), [&](size_t iT) {
+    const std::array<uint32_t, 4>& tri = pickTriangles[iT];
+    triMin[iT] = glm::min(glm::min(vertices[tri[0]], vertices[tri[1]]), vertices[tri[2]]);
+    triMax[iT] = glm::max(glm::max(vertices[tri[0]], vertices[tri[1]]), vertices[tri[2]]);
+  });
+  pickBVH.reset(new ElementBVH(triMin, triMax));
+}
+
+size_t SurfaceMesh::pickIndexAt(const std::array<uint32_t, 4>& tri, glm::vec3 bary) {
+  // (the shader's vertRadius; edges and halfedges are not picked on the CPU)
+  const float vertRadius = 0.2;
+  for (int i = 0; i < 3; i++) {
+    if (bary[i] > 1. - vertRadius) return tri[i];
   }
+  return nVertices() + tri[3]; // (faces follow the vertices, as in preparePick())
+}
+
+bool SurfaceMesh::rayCastElementObjectSpace(glm::vec3 rayStart, glm::vec3 rayDir, float objectScale, float& tHit,
+                                            size_t& localPickInd) {
+  ensurePickBVH();
+  auto hit = [&](uint32_t iT) {
+    const std::array<uint32_t, 4>& tri = pickTriangles[iT];
+    return rayTriangleHit(rayStart, rayDir, vertices[tri[0]], vertices[tri[1]], vertices[tri[2]]);
+  };
+  uint32_t iHit;
+  if (!pickBVH->rayCast(rayStart, rayDir, 0., hit, tHit, iHit)) return false;
+
+  // Barycentric coordinates of the hit point, which lies on the triangle
+  const std::array<uint32_t, 4>& tri = pickTriangles[iHit];
+  glm::vec3 p = rayStart + tHit * rayDir;
+  glm::vec3 bary;
+  closestPointOnTriangle(p, vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], bary);
+  localPickInd = pickIndexAt(tri, bary);
+  return true;
+}
+
+bool SurfaceMesh::closestElementObjectSpace(glm::vec3 point, float objectScale, float& dist, size_t& localPickInd) {
+  ensurePickBVH();
+  auto triDist = [&](uint32_t iT) {
+    const std::array<uint32_t, 4>& tri = pickTriangles[iT];
+    glm::vec3 bary;
+    glm::vec3 closest = closestPointOnTriangle(point, vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], bary);
+    return glm::length(point - closest);
+  };
+  uint32_t iClosest;
+  if (!pickBVH->closest(point, 0., triDist, dist, iClosest)) return false;
+
+  const std::array<uint32_t, 4>& tri = pickTriangles[iClosest];
+  glm::vec3 bary;
+  closestPointOnTriangle(point, vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], bary);
+  localPickInd = pickIndexAt(tri, bary);
+  return true;
 }
 
 void SurfaceMesh::buildPickUI(size_t localPickID) {
@@ -664,6 +1425,18 @@ void SurfaceMesh::buildPickUI(size_t localPickID) {
   }
 }
 
+std::pair<MeshElement, size_t> SurfaceMesh::pickIndexToElement(size_t localPickInd) {
+  if (localPickInd < facePickIndStart) {
+    return {MeshElement::VERTEX, localPickInd};
+  } else if (localPickInd < edgePickIndStart) {
+    return {MeshElement::FACE, localPickInd - facePickIndStart};
+  } else if (localPickInd < halfedgePickIndStart) {
+    return {MeshElement::EDGE, localPickInd - edgePickIndStart};
+  } else {
+    return {MeshElement::HALFEDGE, localPickInd - halfedgePickIndStart};
+  }
+}
+
 // void SurfaceMesh::getPickedElement(size_t localPickID, VertexPtr& vOut, FacePtr& fOut, EdgePtr& eOut,
 // HalfedgePtr& heOut) {
 
@@ -833,7 +1606,12 @@ void SurfaceMesh::buildCustomUI() {
   // Print stats
   long long int nVertsL = static_cast<long long int>(nVertices());
   long long int nFacesL = static_cast<long long int>(nFaces());
-  ImGui::Text("#verts: %lld  #faces: %lld", nVertsL, nFacesL);
+  if (lodLevel != 0) {
+    ImGui::Text("#verts: %lld  #faces: %lld (drawing %lld)", nVertsL, nFacesL,
+                static_cast<long long int>(nDrawnFaces()));
+  } else {
+    ImGui::Text("#verts: %lld  #faces: %lld", nVertsL, nFacesL);
+  }
 
   { // colors
     if (ImGui::ColorEdit3("Color", &surfaceColor.get()[0], ImGuiColorEditFlags_NoInputs))
@@ -906,51 +1684,290 @@ void SurfaceMesh::buildCustomOptionsUI() {
       setBackFacePolicy(BackFacePolicy::Cull);
     ImGui::EndMenu();
   }
+
+  if (ImGui::MenuItem("Level of Detail", nullptr, getLODEnabled())) setLODEnabled(!getLODEnabled());
+  if (ImGui::MenuItem("GPU Normals", nullptr, getGPUNormals())) setGPUNormals(!getGPUNormals());
 }
 
 
 void SurfaceMesh::refresh() {
+  cancelCornerFill();
   computeGeometryData();
+  invalidateTriangleClusters();
   program.reset();
   pickProgram.reset();
+  releaseCornerBuffers();
+  vertexPositionBuffer.reset();
+  faceCenterBuffer.reset();
+  dirtyFaces.clear();
+  dirtyVertices.clear();
   requestRedraw();
   QuantityStructure<SurfaceMesh>::refresh(); // call base class version, which refreshes quantities
 }
 
 void SurfaceMesh::geometryChanged() {
+  cancelCornerFill();
+  pickBVH.reset();
+  invalidateTriangleClusters();
+  if (gpuNormals.get()) {
+    geometryDataStale = true;
+  } else {
+    computeGeometryData();
+  }
+  dirtyFaces.markAll(nFaces());
+  dirtyVertices.markAll(nVertices());
+  requestRedraw();
+  if (detail::sessionCaptureActive) detail::captureMovedPositions(*this, nullptr);
+}
 
+void SurfaceMesh::updateVertexPositionsImpl(const std::vector<size_t>& indices,
+                                            const std::vector<glm::vec3>& newPositions) {
+  for (size_t iV : indices) {
+    if (iV >= nVertices()) {
+      error("updateVertexPositions() on [" + name + "] was passed vertex index " + std::to_string(iV) +
+            ", but there are only " + std::to_string(nVertices()) + " vertices");
+      return;
+    }
+  }
+  if (sharedPositions) {
+    sharedPositions->updateVertexPositions(indices, newPositions); // calls back to update this mesh too
+    return;
+  }
+  cancelCornerFill();
+  for (size_t i = 0; i < indices.size(); i++) {
+    vertices[indices[i]] = newPositions[i];
+  }
+  verticesMoved(indices);
+}
+
+void SurfaceMesh::updateTopologyImpl(const std::vector<glm::vec3>& newVertexPositions,
+                                     const std::vector<std::vector<size_t>>& newFaceIndices) {
+  if (sharedPositions) {
+    error("updateTopology() on [" + name + "], which shares its positions");
+    return;
+  }
+  checkElementCount(name, newVertexPositions.size(), "vertices");
+  std::vector<uint32_t> newEntries;
+  std::vector<size_t> newStarts;
+  flattenFaces(name, newFaceIndices, newEntries, newStarts); // (first, so that a mesh which is too large is unchanged)
+
+  cancelCornerFill();
+  vertices = newVertexPositions;
+  faceIndsEntries = std::move(newEntries);
+  faceIndsStart = std::move(newStarts);
+  nFacesCount = newFaceIndices.size();
+
+  // Everything derived from the old elements
+  vertexPerm.clear();
+  facePerm.clear();
+  edgePerm.clear();
+  halfedgePerm.clear();
+  cornerPerm.clear();
+  resetPermutationInverses();
+  faceTangentSpaces.clear();
+  vertexTangentSpaces.clear();
+  faceForHalfedge.clear();
+  twinHalfedge.clear();
+  lodHierarchy.reset();
+  lodLevel = 0;
+  lodSelectionValid = false;
+  pickBVH.reset();
+  depthSortValid = false;
+  computeCounts();
   computeGeometryData();
-  if (program) {
-    fillGeometryBuffers(*program);
+  updateObjectSpaceBounds();
+
+  // The programs and buffers are filled again on the next draw, like for a new level of detail. The pick program
+  // requests a range for the new element count when it is rebuilt.
+  program.reset();
+  pickProgram.reset();
+  releaseCornerBuffers();
+  vertexPositionBuffer.reset();
+  faceCenterBuffer.reset();
+  dirtyFaces.clear();
+  dirtyVertices.clear();
+
+  std::vector<std::string> dropped;
+  for (auto& q : quantities) {
+    if (!q.second->topologyChanged()) dropped.push_back(q.first);
   }
-  if (pickProgram) {
-    fillGeometryBuffers(*pickProgram);
+  for (const std::string& qName : dropped) {
+    warning("Surface mesh [" + name + "] quantity " + qName + " can not follow a change of topology, and was removed");
+    removeQuantity(qName);
   }
   requestRedraw();
-  QuantityStructure<SurfaceMesh>::refresh();
 }
 
-void SurfaceMesh::updateObjectSpaceBounds() {
-  // bounding box
-  glm::vec3 min = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
-  glm::vec3 max = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
-  for (const glm::vec3& p : vertices) {
-    min = componentwiseMin(min, p);
-    max = componentwiseMax(max, p);
+void SurfaceMesh::sharedPositionsMoved(const std::vector<size_t>* movedIndices) {
+  cancelCornerFill();
+  if (movedIndices == nullptr) {
+    vertices = sharedPositions->getPositions();
+    geometryChanged();
+    return;
   }
-  objectSpaceBoundingBox = std::make_tuple(min, max);
+  for (size_t iV : *movedIndices) {
+    vertices[iV] = sharedPositions->getPositions()[iV];
+  }
+  verticesMoved(*movedIndices);
+}
 
-  // length scale, as twice the radius from the center of the bounding box
-  glm::vec3 center = 0.5f * (min + max);
-  float lengthScale = 0.0;
-  for (const glm::vec3& p : vertices) {
-    lengthScale = std::max(lengthScale, glm::length2(p - center));
+void SurfaceMesh::verticesMoved(const std::vector<size_t>& indices) {
+  if (detail::sessionCaptureActive) detail::captureMovedPositions(*this, &indices);
+  pickBVH.reset();
+  invalidateTriangleClusters();
+  auto facesAround = [&](const std::vector<size_t>& verts) {
+    std::vector<size_t> faces;
+    for (size_t iV : verts) {
+      faces.insert(faces.end(), vertexFaces.begin() + vertexFaceStart[iV],
+                   vertexFaces.begin() + vertexFaceStart[iV + 1]);
+    }
+    std::sort(faces.begin(), faces.end());
+    faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+    return faces;
+  };
+
+  std::vector<size_t> movedFaces = facesAround(indices);
+
+  // With GPU normals only the positions need uploading, the geometry is recomputed if something reads it
+  if (gpuNormals.get()) {
+    geometryDataStale = true;
+    for (size_t iF : movedFaces) {
+      dirtyFaces.mark(iF);
+    }
+    for (size_t iV : indices) {
+      dirtyVertices.mark(iV);
+    }
+    requestRedraw();
+    return;
+  }
+
+  // Faces touching a moved vertex get new normals and areas, and so do all of the vertices of those faces
+  restoreGeometryData();
+  std::vector<size_t> changedVertices;
+  for (size_t iF : movedFaces) {
+    for (size_t iV : face(iF)) {
+      changedVertices.push_back(iV);
+    }
+  }
+  std::sort(changedVertices.begin(), changedVertices.end());
+  changedVertices.erase(std::unique(changedVertices.begin(), changedVertices.end()), changedVertices.end());
+
+  parallelFor(0, movedFaces.size(), [&](size_t i) { computeFaceGeometry(movedFaces[i]); });
+  parallelFor(0, changedVertices.size(), [&](size_t i) { computeVertexGeometry(changedVertices[i]); });
+
+  // With smooth shading every corner of a face shows its vertex normal, so one more ring of faces needs redrawing
+  std::vector<size_t> redrawFaces = isSmoothShade() ? facesAround(changedVertices) : movedFaces;
+  for (size_t iF : redrawFaces) {
+    dirtyFaces.mark(iF);
+  }
+  for (size_t iV : changedVertices) {
+    dirtyVertices.mark(iV);
   }
-  objectSpaceLengthScale = 2 * std::sqrt(lengthScale);
+  requestRedraw();
+}
+
+void SurfaceMesh::flushGeometryUpdates() {
+  if (dirtyFaces.empty()) {
+    return;
+  }
+
+  if (lodHierarchy) {
+    // the cascade was built from the old positions, so it is rebuilt by the next draw
+    lodHierarchy.reset();
+    if (lodLevel != 0) {
+      lodLevel = 0;
+      lodLevelChanged();
+      return;
+    }
+  }
+
+  std::vector<std::pair<size_t, size_t>> faceRanges = dirtyFaces.coalesced();
+  restoreGeometryData();
+  depthSortValid = false;
+  if (program) {
+    if (usingIndexedDrawing) {
+      std::vector<std::pair<size_t, size_t>> vertexRanges = dirtyVertices.coalesced();
+      if (!sharedPositions) { // (the shared buffer has already been updated)
+        program->updateAttributeRanges("a_position", vertices, vertexRanges);
+      }
+      if (!gpuNormals.get()) {
+        program->updateAttributeRanges("a_normal", vertexNormals, vertexRanges);
+      }
+    }
+  }
+  updateCornerBuffers(faceRanges);
+  if (vertexPositionBuffer) {
+    for (const std::pair<size_t, size_t>& r : dirtyVertices.coalesced()) {
+      std::vector<glm::vec3> rangeData(vertices.begin() + r.first, vertices.begin() + r.second);
+      vertexPositionBuffer->setData(rangeData, true, static_cast<int>(r.first), static_cast<int>(r.second - r.first));
+    }
+  }
+  if (faceCenterBuffer) {
+    for (const std::pair<size_t, size_t>& r : faceRanges) {
+      faceCenterBuffer->setData(faceCenters(r.first, r.second), true, static_cast<int>(r.first),
+                                static_cast<int>(r.second - r.first));
+    }
+  }
+  for (auto& q : quantities) {
+    q.second->geometryChanged(faceRanges);
+  }
+
+  dirtyFaces.clear();
+  dirtyVertices.clear();
+}
+
+void SurfaceMesh::updateObjectSpaceBounds() {
+  // bounding box, and length scale as twice the radius from the center of the bounding box
+  glm::vec3 min, max;
+  computePointSetExtents(vertices, min, max, objectSpaceLengthScale);
+  objectSpaceBoundingBox = std::make_tuple(min, max);
+  boundsChanged();
 }
 
 std::string SurfaceMesh::typeName() { return structureTypeName; }
 
+const std::vector<size_t>& SurfaceMesh::getVertexPermInverse() {
+  return cachedPermutationInverse(vertexPerm, vertexDataSize, vertexPermInverse);
+}
+const std::vector<size_t>& SurfaceMesh::getFacePermInverse() {
+  return cachedPermutationInverse(facePerm, faceDataSize, facePermInverse);
+}
+const std::vector<size_t>& SurfaceMesh::getEdgePermInverse() {
+  return cachedPermutationInverse(edgePerm, edgeDataSize, edgePermInverse);
+}
+const std::vector<size_t>& SurfaceMesh::getHalfedgePermInverse() {
+  return cachedPermutationInverse(halfedgePerm, halfedgeDataSize, halfedgePermInverse);
+}
+const std::vector<size_t>& SurfaceMesh::getCornerPermInverse() {
+  return cachedPermutationInverse(cornerPerm, cornerDataSize, cornerPermInverse);
+}
+
+void SurfaceMesh::resetPermutationInverses() {
+  for (std::vector<size_t>* inverse :
+       {&vertexPermInverse, &facePermInverse, &edgePermInverse, &halfedgePermInverse, &cornerPermInverse}) {
+    inverse->clear();
+    inverse->shrink_to_fit();
+  }
+}
+
+size_t SurfaceMesh::hostMemoryUsage() {
+  size_t bytes = 0;
+  bytes += allocatedBytes(vertices) + allocatedBytes(faceIndsEntries) + allocatedBytes(faceIndsStart);
+  bytes += allocatedBytes(halfedgeEdgeIndices) + allocatedBytes(halfedgeDefinesEdge);
+  bytes += allocatedBytes(vertexFaceStart) + allocatedBytes(vertexFaces);
+  bytes += allocatedBytes(faceNormals) + allocatedBytes(vertexNormals);
+  bytes += allocatedBytes(faceAreas) + allocatedBytes(vertexAreas) + allocatedBytes(edgeLengths);
+  bytes += allocatedBytes(faceTangentSpaces) + allocatedBytes(vertexTangentSpaces);
+  bytes += allocatedBytes(faceForHalfedge) + allocatedBytes(twinHalfedge);
+  bytes += allocatedBytes(faceDrawOrder) + allocatedBytes(faceDrawPosition) + allocatedBytes(drawnTriangleStart);
+  bytes += allocatedBytes(vertexPerm) + allocatedBytes(facePerm) + allocatedBytes(edgePerm);
+  bytes += allocatedBytes(halfedgePerm) + allocatedBytes(cornerPerm);
+  bytes += allocatedBytes(vertexPermInverse) + allocatedBytes(facePermInverse) + allocatedBytes(edgePermInverse);
+  bytes += allocatedBytes(halfedgePermInverse) + allocatedBytes(cornerPermInverse);
+  if (lodHierarchy) bytes += lodHierarchy->allocatedBytes();
+  return bytes;
+}
+
 long long int SurfaceMesh::selectVertex() {
 
   // Make sure we can see edges
@@ -1142,6 +2159,10 @@ SurfaceMesh* SurfaceMesh::setMaterial(std::string m) {
   return this;
 }
 std::string SurfaceMesh::getMaterial() { return material.get(); }
+std::string SurfaceMesh::drawBatchKey() {
+  // the back face policy first, since it decides the culling state each draw sets
+  return std::to_string(static_cast<int>(getBackFacePolicy())) + "|" + material.get();
+}
 
 SurfaceMesh* SurfaceMesh::setEdgeWidth(double newVal) {
   edgeWidth = newVal;
@@ -1159,6 +2180,226 @@ SurfaceMesh* SurfaceMesh::setBackFacePolicy(BackFacePolicy newPolicy) {
 }
 BackFacePolicy SurfaceMesh::getBackFacePolicy() { return backFacePolicy.get(); }
 
+// === Level of detail
+
+SurfaceMesh* SurfaceMesh::setLODEnabled(bool newVal) {
+  lodEnabled = newVal;
+  if (!newVal) {
+    lodHierarchy.reset();
+    if (lodLevel != 0) {
+      lodLevel = 0;
+      lodLevelChanged();
+    }
+  }
+  lodSelectionValid = false;
+  requestRedraw();
+  return this;
+}
+bool SurfaceMesh::getLODEnabled() { return lodEnabled.get(); }
+
+SurfaceMesh* SurfaceMesh::setGPUNormals(bool newVal) {
+  gpuNormals = newVal;
+  refresh(); // (recomputes the geometry, and the buffers pick up normals again when turning this off)
+  return this;
+}
+bool SurfaceMesh::getGPUNormals() { return gpuNormals.get(); }
+
+SurfaceMesh* SurfaceMesh::setRetainHostData(bool newVal) {
+  retainHostData = newVal;
+  if (retainHostData) {
+    restoreGeometryData();
+  }
+  return this;
+}
+bool SurfaceMesh::getRetainHostData() { return retainHostData; }
+
+SurfaceMesh* SurfaceMesh::setLODMaxPixelError(float newVal) {
+  lodMaxPixelError = newVal;
+  lodSelectionValid = false;
+  requestRedraw();
+  return this;
+}
+float SurfaceMesh::getLODMaxPixelError() { return lodMaxPixelError; }
+
+size_t SurfaceMesh::nDrawnFaces() { return lodLevel == 0 ? nFaces() : lodHierarchy->level(lodLevel).faces.size(); }
+
+void SurfaceMesh::updateLODSelection() {
+  if (!lodEnabled.get()) return;
+
+  if (!lodHierarchy) {
+    ScopedCPUTimer timer(profilingName(), "build LOD");
+    ensureHaveGeometryData();
+    lodHierarchy.reset(new SurfaceMeshLOD(*this));
+    lodSelectionValid = false;
+  }
+
+  // Reflections and shadows draw with other view matrices; the level follows the camera of the first pass of a frame
+  if (lodSelectionValid && lodSelectionSceneRender == state::sceneRenderCount) return;
+  lodSelectionSceneRender = state::sceneRenderCount;
+  lodSelectionValid = true;
+
+  size_t newLevel = lodHierarchy->selectLevel(getModelView(), view::getCameraPerspectiveMatrix(), view::bufferHeight,
+                                              lodMaxPixelError);
+  if (newLevel == lodLevel) return;
+  lodLevel = newLevel;
+  lodLevelChanged();
+}
+
+void SurfaceMesh::lodLevelChanged() {
+  program.reset();
+  pickProgram.reset();
+  releaseCornerBuffers();
+  dirtyFaces.clear();
+  dirtyVertices.clear();
+  QuantityStructure<SurfaceMesh>::refresh(); // the quantities fill their buffers through forEachDrawnFace()
+}
+
+bool SurfaceMesh::usesClusterCulling() {
+  return options::meshClusterCullingMinTriangles >= 0 && lodLevel == 0 &&
+         nFacesTriangulationCount >= static_cast<size_t>(options::meshClusterCullingMinTriangles);
+}
+
+void SurfaceMesh::buildTriangleClusters() {
+  ScopedCPUTimer timer(profilingName(), "build clusters");
+  const size_t clusterTriangles = 256;
+
+  // Cut the draw order in to runs of whole faces
+  triangleClusters.clear();
+  size_t triCount = 0;
+  for (size_t pos = 0; pos < nFaces(); pos++) {
+    bool full = !triangleClusters.empty() &&
+                triangleClusters.back().triEnd - triangleClusters.back().triStart >= clusterTriangles;
+    if (triangleClusters.empty() || full) {
+      TriangleCluster c;
+      c.posStart = c.posEnd = pos;
+      c.triStart = c.triEnd = triCount;
+      triangleClusters.push_back(c);
+    }
+    size_t nTri = faceDegree(faceInDrawOrder(pos)) - 2;
+    triangleClusters.back().posEnd = pos + 1;
+    triangleClusters.back().triEnd += nTri;
+    triCount += nTri;
+  }
+
+  parallelFor(0, triangleClusters.size(), [&](size_t iC) {
+    TriangleCluster& c = triangleClusters[iC];
+    c.boxMin = glm::vec3{std::numeric_limits<float>::infinity()};
+    c.boxMax = glm::vec3{-std::numeric_limits<float>::infinity()};
+    glm::vec3 normalSum{0., 0., 0.};
+    std::vector<glm::vec3> normals;
+    for (size_t pos = c.posStart; pos < c.posEnd; pos++) {
+      IndexView face = this->face(faceInDrawOrder(pos));
+      for (size_t j = 0; j < face.size(); j++) {
+        c.boxMin = glm::min(c.boxMin, vertices[face[j]]);
+        c.boxMax = glm::max(c.boxMax, vertices[face[j]]);
+      }
+      // (from the positions, since the face normals may be stale, see setGPUNormals())
+      glm::vec3 pRoot = vertices[face[0]];
+      for (size_t j = 1; (j + 1) < face.size(); j++) {
+        glm::vec3 N = glm::cross(vertices[face[j]] - pRoot, vertices[face[j + 1]] - pRoot);
+        float len = glm::length(N);
+        if (!(len > 0.)) continue;
+        normals.push_back(N / len);
+        normalSum += N / len;
+      }
+    }
+
+    c.coneAxis = glm::vec3{0., 0., 1.};
+    c.coneSin = 2.;
+    float sumLen = glm::length(normalSum);
+    if (normals.empty() || !(sumLen > 0.)) return;
+    c.coneAxis = normalSum / sumLen;
+    float minDot = 1.;
+    for (const glm::vec3& N : normals) {
+      minDot = std::min(minDot, glm::dot(N, c.coneAxis));
+    }
+    if (minDot > 0.) {
+      c.coneSin = std::sqrt(std::max(0.f, 1.f - minDot * minDot));
+    }
+  });
+  clusterSelectionValid = false;
+}
+
+void SurfaceMesh::updateClusterSelection() {
+  if (triangleClusters.empty()) {
+    buildTriangleClusters();
+  }
+
+  // Reflection and shadow passes draw with other view matrices, so this may change within a frame
+  glm::mat4 MV = getModelView();
+  glm::mat4 toClip = view::getCameraPerspectiveMatrix() * MV;
+  bool cullBack = backFacePolicy.get() == BackFacePolicy::Cull;
+  if (clusterSelectionValid && toClip == clusterSelectionMatrix && cullBack == clusterSelectionCullsBack) return;
+  clusterSelectionMatrix = toClip;
+  clusterSelectionCullsBack = cullBack;
+  clusterSelectionValid = true;
+
+  // Facing is only tested when the model-view transform preserves angles and orientation, so that the cones keep
+  // their shape and the front faces keep their winding
+  glm::mat3 M(MV);
+  float scale = glm::length(M[0]);
+  bool similarity = glm::determinant(M) > 0.;
+  for (int i = 0; i < 3 && similarity; i++) {
+    for (int j = 0; j < 3; j++) {
+      float expected = i == j ? scale * scale : 0.f;
+      similarity = similarity && std::abs(glm::dot(M[i], M[j]) - expected) <= 1e-3f * scale * scale;
+    }
+  }
+  bool testFacing = cullBack && similarity;
+  bool orthographic = view::projectionMode == ProjectionMode::Orthographic;
+  glm::mat4 invMV = glm::inverse(MV);
+  glm::vec3 eyeObj = glm::vec3(invMV * glm::vec4(0., 0., 0., 1.));
+  glm::vec3 lookObj = glm::normalize(glm::vec3(invMV * glm::vec4(0., 0., -1., 0.)));
+
+  std::vector<char> visible(triangleClusters.size());
+  parallelFor(0, triangleClusters.size(), [&](size_t iC) {
+    const TriangleCluster& c = triangleClusters[iC];
+    if (!view::boxMayBeInView(c.boxMin, c.boxMax, toClip)) {
+      visible[iC] = false;
+      return;
+    }
+    if (testFacing && c.coneSin <= 1.) {
+      // Facing away if every view ray to the cluster's bounding sphere is within 90 degrees of every normal
+      glm::vec3 center = 0.5f * (c.boxMin + c.boxMax);
+      float radius = 0.5f * glm::length(c.boxMax - c.boxMin);
+      bool facingAway;
+      if (orthographic) {
+        facingAway = glm::dot(lookObj, c.coneAxis) > c.coneSin;
+      } else {
+        glm::vec3 toCenter = center - eyeObj;
+        facingAway = glm::dot(toCenter, c.coneAxis) > c.coneSin * glm::length(toCenter) + radius;
+      }
+      if (facingAway) {
+        visible[iC] = false;
+        return;
+      }
+    }
+    visible[iC] = true;
+  });
+
+  // Merge runs of visible clusters, to draw each with a single range
+  visibleClusterElements.clear();
+  size_t nCulled = 0;
+  for (size_t iC = 0; iC < triangleClusters.size(); iC++) {
+    const TriangleCluster& c = triangleClusters[iC];
+    if (!visible[iC]) {
+      nCulled++;
+      continue;
+    }
+    if (!visibleClusterElements.empty() && visibleClusterElements.back().second == 3 * c.triStart) {
+      visibleClusterElements.back().second = 3 * c.triEnd;
+    } else {
+      visibleClusterElements.emplace_back(3 * c.triStart, 3 * c.triEnd);
+    }
+  }
+  render::engine->renderStats.clustersCulled += nCulled;
+}
+
+void SurfaceMesh::invalidateTriangleClusters() {
+  triangleClusters.clear();
+  clusterSelectionValid = false;
+}
+
 // === Quantity adders
 
 
@@ -1247,6 +2488,30 @@ SurfaceMesh::addVertexIsolatedScalarQuantityImpl(std::string name,
   return q;
 }
 
+SurfaceVertexSparseScalarQuantity*
+SurfaceMesh::addVertexSparseScalarQuantityImpl(std::string name, const std::vector<std::pair<size_t, double>>& values,
+                                               DataType type) {
+  std::vector<double> setValues;
+  SparseElementSet elements = SparseElementSet::fromEntries(nVertices(), values, setValues,
+                                                            vertexPerm.empty() ? nullptr : &getVertexPermInverse());
+  SurfaceVertexSparseScalarQuantity* q =
+      new SurfaceVertexSparseScalarQuantity(name, std::move(elements), setValues, *this, type);
+  addQuantity(q);
+  return q;
+}
+
+SurfaceFaceSparseScalarQuantity*
+SurfaceMesh::addFaceSparseScalarQuantityImpl(std::string name, const std::vector<std::pair<size_t, double>>& values,
+                                             DataType type) {
+  std::vector<double> setValues;
+  SparseElementSet elements =
+      SparseElementSet::fromEntries(nFaces(), values, setValues, facePerm.empty() ? nullptr : &getFacePermInverse());
+  SurfaceFaceSparseScalarQuantity* q =
+      new SurfaceFaceSparseScalarQuantity(name, std::move(elements), setValues, *this, type);
+  addQuantity(q);
+  return q;
+}
+
 SurfaceFaceCountQuantity* SurfaceMesh::addFaceCountQuantityImpl(std::string name,
                                                                 const std::vector<std::pair<size_t, int>>& values) {
   SurfaceFaceCountQuantity* q = new SurfaceFaceCountQuantity(name, values, *this);
@@ -1254,6 +2519,22 @@ SurfaceFaceCountQuantity* SurfaceMesh::addFaceCountQuantityImpl(std::string name
   return q;
 }
 
+SurfaceVertexSelectionQuantity*
+SurfaceMesh::addVertexSelectionQuantityImpl(std::string name, const std::vector<char>& initialMembership) {
+  SurfaceVertexSelectionQuantity* q =
+      new SurfaceVertexSelectionQuantity(name, applyPermutation(initialMembership, vertexPerm), *this);
+  addQuantity(q);
+  return q;
+}
+
+SurfaceFaceSelectionQuantity* SurfaceMesh::addFaceSelectionQuantityImpl(std::string name,
+                                                                        const std::vector<char>& initialMembership) {
+  SurfaceFaceSelectionQuantity* q =
+      new SurfaceFaceSelectionQuantity(name, applyPermutation(initialMembership, facePerm), *this);
+  addQuantity(q);
+  return q;
+}
+
 SurfaceGraphQuantity* SurfaceMesh::addSurfaceGraphQuantityImpl(std::string name, const std::vector<glm::vec3>& nodes,
                                                                const std::vector<std::array<size_t, 2>>& edges) {
   SurfaceGraphQuantity* q = new SurfaceGraphQuantity(name, nodes, edges, *this);
@@ -1345,6 +2626,7 @@ SurfaceMesh::addOneFormIntrinsicVectorQuantityImpl(std::string name, const std::
 
 
 void SurfaceMesh::setVertexTangentBasisXImpl(const std::vector<glm::vec3>& vectors) {
+  ensureHaveGeometryData();
 
   std::vector<glm::vec3> inputBasisX = applyPermutation(vectors, vertexPerm);
   vertexTangentSpaces.resize(nVertices());
@@ -1370,6 +2652,7 @@ void SurfaceMesh::setVertexTangentBasisXImpl(const std::vector<glm::vec3>& vecto
 }
 
 void SurfaceMesh::setFaceTangentBasisXImpl(const std::vector<glm::vec3>& vectors) {
+  ensureHaveGeometryData();
 
   std::vector<glm::vec3> inputBasisX = applyPermutation(vectors, facePerm);
   faceTangentSpaces.resize(nFaces());
@@ -1401,5 +2684,7 @@ void SurfaceMeshQuantity::buildVertexInfoGUI(size_t vInd) {}
 void SurfaceMeshQuantity::buildFaceInfoGUI(size_t fInd) {}
 void SurfaceMeshQuantity::buildEdgeInfoGUI(size_t eInd) {}
 void SurfaceMeshQuantity::buildHalfedgeInfoGUI(size_t heInd) {}
+void SurfaceMeshQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) { refresh(); }
+bool SurfaceMeshQuantity::topologyChanged() { return false; }
 
 } // namespace polyscope
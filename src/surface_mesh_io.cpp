@@ -1,105 +1,737 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/surface_mesh_io.h"
 
+#include "polyscope/command_queue.h"
 #include "polyscope/messages.h"
-
-#include "happly.h"
+#include "polyscope/options.h"
+#include "polyscope/parallel.h"
+#include "polyscope/surface_mesh.h"
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <clocale>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
 
 namespace polyscope {
 
 
+namespace {
+
+// The whole contents of a file, in one read
+std::vector<char> readWholeFile(const std::string& filename) {
+  std::ifstream in(filename, std::ios::binary | std::ios::ate);
+  if (!in) throw std::invalid_argument("Could not open mesh file " + filename);
+  std::vector<char> data(static_cast<size_t>(in.tellg()));
+  in.seekg(0);
+  in.read(data.data(), data.size());
+  if (!in) throw std::runtime_error("Could not read mesh file " + filename);
+  return data;
+}
+
+// The extension of a filename, in lowercase, or ""
+std::string fileExtension(const std::string& filename) {
+  std::string::size_type sepInd = filename.rfind('.');
+  if (sepInd == std::string::npos) return "";
+  std::string extension = filename.substr(sepInd + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extension;
+}
+
+} // namespace
+
 // Helpers for the OBJ reader
-// TODO factor this out in to something neat like happly
 namespace {
 
-class Index {
-public:
-  Index() {}
+// Whitespace within a line. A backslash at the end of a line continues it on the next one, so the pair counts as
+// whitespace too.
+bool isLineSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
 
-  Index(int v, int vt, int vn) : position(v), uv(vt), normal(vn) {}
+bool isContinuation(const char* p, const char* end) {
+  if (p == end || *p != '\\') return false;
+  p++;
+  if (p != end && *p == '\r') p++;
+  return p != end && *p == '\n';
+}
 
-  bool operator<(const Index& i) const {
-    if (position < i.position) return true;
-    if (position > i.position) return false;
-    if (uv < i.uv) return true;
-    if (uv > i.uv) return false;
-    if (normal < i.normal) return true;
-    if (normal > i.normal) return false;
+const char* skipLineSpace(const char* p, const char* end) {
+  while (p != end) {
+    if (isLineSpace(*p)) {
+      p++;
+    } else if (isContinuation(p, end)) {
+      p = static_cast<const char*>(std::memchr(p, '\n', end - p)) + 1;
+    } else {
+      break;
+    }
+  }
+  return p;
+}
 
-    return false;
+const char* skipToken(const char* p, const char* end) {
+  while (p != end && *p != '\n' && !isLineSpace(*p) && !isContinuation(p, end)) p++;
+  return p;
+}
+
+// Just past the end of the line containing p (or `end`)
+const char* nextLine(const char* p, const char* end, const char* fileBegin) {
+  while (p != end) {
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (newline == nullptr) return end;
+    const char* before = newline;
+    if (before != fileBegin && before[-1] == '\r') before--;
+    p = newline + 1;
+    if (before == fileBegin || before[-1] != '\\') break;
   }
+  return p;
+}
 
-  int position;
-  int uv;
-  int normal;
-};
+size_t lineNumber(const char* fileBegin, const char* p) { return std::count(fileBegin, p, '\n') + 1; }
+
+// The statement a line starts with, and where its arguments begin
+enum class OBJStatement { Vertex, Face, Other };
+OBJStatement parseStatement(const char*& p, const char* end) {
+  p = skipLineSpace(p, end);
+  if (p == end || (*p != 'v' && *p != 'f')) return OBJStatement::Other;
+  OBJStatement statement = *p == 'v' ? OBJStatement::Vertex : OBJStatement::Face;
+  p++;
+  if (p != end && !isLineSpace(*p) && !isContinuation(p, end)) return OBJStatement::Other; // vt, vn, ...
+  p = skipLineSpace(p, end);
+  return statement;
+}
 
-Index parseFaceIndex(const std::string& token) {
-  std::stringstream in(token);
-  std::string indexString;
-  int indices[3] = {1, 1, 1};
+// std::strtod in the "C" locale, so that the decimal point is '.' whatever locale the program has set
+double strtodClassic(const char* str, char** strEnd) {
+#ifdef _WIN32
+  static _locale_t cLocale = _create_locale(LC_NUMERIC, "C");
+  return _strtod_l(str, strEnd, cLocale);
+#else
+  static locale_t cLocale = newlocale(LC_NUMERIC_MASK, "C", static_cast<locale_t>(0));
+  return strtod_l(str, strEnd, cLocale);
+#endif
+}
+
+// Parses a decimal number, independent of the locale. Numbers with at most 15 significant digits and small exponents
+// (nearly all of them, in practice) are converted exactly with one multiply or divide; anything else goes to strtodClassic().
+bool parseDouble(const char*& p, const char* end, double& out) {
+  static const double powersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+  const char* tokenBegin = p;
+  const char* tokenEnd = skipToken(p, end);
+  const char* q = p;
+  bool negative = false;
+  if (q != tokenEnd && (*q == '-' || *q == '+')) {
+    negative = *q == '-';
+    q++;
+  }
 
-  int i = 0;
-  while (std::getline(in, indexString, '/')) {
-    if (indexString != "\\") {
-      std::stringstream ss(indexString);
-      ss >> indices[i++];
+  uint64_t mantissa = 0;
+  int nSignificant = 0;
+  int exponent = 0;
+  bool anyDigits = false;
+  while (q != tokenEnd && *q >= '0' && *q <= '9') {
+    anyDigits = true;
+    if (mantissa != 0 || *q != '0') nSignificant++;
+    if (nSignificant <= 19) {
+      mantissa = 10 * mantissa + (*q - '0');
+    } else {
+      exponent++;
+    }
+    q++;
+  }
+  if (q != tokenEnd && *q == '.') {
+    q++;
+    while (q != tokenEnd && *q >= '0' && *q <= '9') {
+      anyDigits = true;
+      if (mantissa != 0 || *q != '0') nSignificant++;
+      if (nSignificant <= 19) {
+        mantissa = 10 * mantissa + (*q - '0');
+        exponent--;
+      }
+      q++;
     }
   }
+  if (anyDigits && q != tokenEnd && (*q == 'e' || *q == 'E')) {
+    q++;
+    bool negativeExponent = false;
+    if (q != tokenEnd && (*q == '-' || *q == '+')) {
+      negativeExponent = *q == '-';
+      q++;
+    }
+    int e = 0;
+    while (q != tokenEnd && *q >= '0' && *q <= '9') {
+      e = std::min(10 * e + (*q - '0'), 100000);
+      q++;
+    }
+    exponent += negativeExponent ? -e : e;
+  }
+
+  if (anyDigits && q == tokenEnd && nSignificant <= 15 && exponent >= -22 && exponent <= 22) {
+    double value = static_cast<double>(mantissa);
+    value = exponent < 0 ? value / powersOf10[-exponent] : value * powersOf10[exponent];
+    out = negative ? -value : value;
+    p = tokenEnd;
+    return true;
+  }
 
-  // decrement since indices in OBJ files are 1-based
-  return Index(indices[0] - 1, indices[1] - 1, indices[2] - 1);
+  // The slow path, for long or unusual numbers (nan, inf, hex, ...)
+  std::string token(tokenBegin, tokenEnd);
+  char* parsedEnd;
+  out = strtodClassic(token.c_str(), &parsedEnd);
+  p = tokenEnd;
+  return !token.empty() && parsedEnd == token.c_str() + token.size();
 }
+
+// Parses the vertex index at the start of a face corner (`v`, `v/vt`, `v//vn` or `v/vt/vn`), as written in the file
+bool parseCornerIndex(const char*& p, const char* end, long long int& out) {
+  const char* tokenEnd = skipToken(p, end);
+  bool negative = false;
+  if (p != tokenEnd && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  long long int value = 0;
+  bool anyDigits = false;
+  while (p != tokenEnd && *p >= '0' && *p <= '9') {
+    value = std::min(10 * value + (*p - '0'), static_cast<long long int>(1) << 40);
+    anyDigits = true;
+    p++;
+  }
+  bool valid = anyDigits && (p == tokenEnd || *p == '/');
+  p = tokenEnd;
+  out = negative ? -value : value;
+  return valid;
+}
+
+// The part of the file one thread parses, which starts and ends at line boundaries
+struct OBJBlock {
+  const char* begin;
+  const char* end;
+  size_t nVertices = 0;
+  size_t nFaces = 0;
+  size_t nEntries = 0;
+  size_t vertexOffset = 0, faceOffset = 0, entryOffset = 0; // where its output goes, when writing
+};
+
+// Counts the vertices, faces and face corners of a block, or (once the counts of all blocks are known) parses them
+// straight in to their place in the output
+void parseOBJBlock(OBJBlock& block, const char* fileBegin, bool write, size_t nVerticesTotal,
+                   std::vector<std::array<double, 3>>& vertexPositionsOut, std::vector<uint32_t>& faceIndsEntriesOut,
+                   std::vector<size_t>& faceIndsStartOut) {
+  auto fail = [&](const char* p, std::string what) {
+    throw std::runtime_error("OBJ parse error on line " + std::to_string(lineNumber(fileBegin, p)) + ": " + what);
+  };
+
+  size_t iVertex = block.vertexOffset;
+  size_t iFace = block.faceOffset;
+  size_t iEntry = block.entryOffset;
+  const char* lineBegin = block.begin;
+  while (lineBegin != block.end) {
+    const char* lineEnd = nextLine(lineBegin, block.end, fileBegin);
+    const char* p = lineBegin;
+    switch (parseStatement(p, lineEnd)) {
+    case OBJStatement::Vertex: {
+      if (write) {
+        std::array<double, 3>& v = vertexPositionsOut[iVertex];
+        for (int j = 0; j < 3; j++) {
+          if (p == lineEnd || *p == '\n' || !parseDouble(p, lineEnd, v[j])) {
+            fail(lineBegin, "bad vertex position");
+          }
+          p = skipLineSpace(p, lineEnd);
+        }
+      }
+      iVertex++;
+      break;
+    }
+    case OBJStatement::Face: {
+      if (write) faceIndsStartOut[iFace] = iEntry;
+      while (p != lineEnd && *p != '\n') {
+        if (write) {
+          long long int index;
+          if (!parseCornerIndex(p, lineEnd, index)) fail(lineBegin, "bad face index");
+          // positive indices count from 1 at the start of the file, negative ones back from the latest vertex
+          long long int resolved = index > 0 ? index - 1 : static_cast<long long int>(iVertex) + index;
+          if (index == 0 || resolved < 0 || resolved >= static_cast<long long int>(nVerticesTotal)) {
+            fail(lineBegin, "face index " + std::to_string(index) + " is out of range");
+          }
+          faceIndsEntriesOut[iEntry] = static_cast<uint32_t>(resolved);
+        } else {
+          p = skipToken(p, lineEnd);
+        }
+        iEntry++;
+        p = skipLineSpace(p, lineEnd);
+      }
+      iFace++;
+      break;
+    }
+    case OBJStatement::Other:
+      break;
+    }
+    lineBegin = lineEnd;
+  }
+
+  if (!write) {
+    block.nVertices = iVertex;
+    block.nFaces = iFace;
+    block.nEntries = iEntry;
+  }
+}
+
 } // namespace
 
 
+void loadPolygonSoup_OBJ(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
+                         std::vector<uint32_t>& faceIndsEntriesOut, std::vector<size_t>& faceIndsStartOut) {
+
+  vertexPositionsOut.clear();
+  faceIndsEntriesOut.clear();
+  faceIndsStartOut.clear();
+
+  std::vector<char> data = readWholeFile(filename);
+  const char* fileBegin = data.data();
+  const char* fileEnd = fileBegin + data.size();
+
+  // Split it in to blocks of whole lines, a few per thread
+  const size_t minBlockBytes = 1 << 20;
+  size_t nBlocks = std::max<size_t>(1, std::min(data.size() / minBlockBytes, 4 * parallelThreadCount()));
+  std::vector<OBJBlock> blocks(nBlocks);
+  for (size_t i = 0; i < nBlocks; i++) {
+    blocks[i].begin = i == 0 ? fileBegin : blocks[i - 1].end;
+    const char* nominalEnd = fileBegin + data.size() * (i + 1) / nBlocks;
+    blocks[i].end = i + 1 == nBlocks ? fileEnd : nextLine(std::max(nominalEnd, blocks[i].begin), fileEnd, fileBegin);
+  }
+
+  // Count what each block holds, so that each can then write its output in place
+  parallelFor(
+      0, nBlocks,
+      [&](size_t i) {
+        parseOBJBlock(blocks[i], fileBegin, false, 0, vertexPositionsOut, faceIndsEntriesOut, faceIndsStartOut);
+      },
+      1);
+  size_t nVertices = 0, nFaces = 0, nEntries = 0;
+  for (OBJBlock& block : blocks) {
+    block.vertexOffset = nVertices;
+    block.faceOffset = nFaces;
+    block.entryOffset = nEntries;
+    nVertices += block.nVertices;
+    nFaces += block.nFaces;
+    nEntries += block.nEntries;
+  }
+  if (nVertices > std::numeric_limits<uint32_t>::max() || nFaces > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Mesh file " + filename + " is too large; there must be fewer than 2^32 vertices and faces");
+  }
+
+  vertexPositionsOut.resize(nVertices);
+  faceIndsEntriesOut.resize(nEntries);
+  faceIndsStartOut.resize(nFaces + 1);
+  faceIndsStartOut[nFaces] = nEntries;
+  parallelFor(
+      0, nBlocks,
+      [&](size_t i) {
+        parseOBJBlock(blocks[i], fileBegin, true, nVertices, vertexPositionsOut, faceIndsEntriesOut, faceIndsStartOut);
+      },
+      1);
+}
+
 void loadPolygonSoup_OBJ(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
                          std::vector<std::vector<size_t>>& faceIndicesOut) {
 
+  std::vector<uint32_t> faceIndsEntries;
+  std::vector<size_t> faceIndsStart;
+  loadPolygonSoup_OBJ(filename, vertexPositionsOut, faceIndsEntries, faceIndsStart);
 
-  faceIndicesOut.clear();
-  vertexPositionsOut.clear();
+  faceIndicesOut.resize(faceIndsStart.size() - 1);
+  parallelFor(0, faceIndicesOut.size(), [&](size_t iF) {
+    faceIndicesOut[iF].assign(faceIndsEntries.begin() + faceIndsStart[iF],
+                              faceIndsEntries.begin() + faceIndsStart[iF + 1]);
+  });
+}
 
-  // Open the file
-  std::ifstream in(filename);
-  if (!in) throw std::invalid_argument("Could not open mesh file " + filename);
+// Helpers for the PLY reader
+namespace {
+
+enum class PLYFormat { Ascii, BinaryLittleEndian, BinaryBigEndian };
+enum class PLYType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+PLYType parsePLYType(const std::string& name) {
+  if (name == "char" || name == "int8") return PLYType::Int8;
+  if (name == "uchar" || name == "uint8") return PLYType::UInt8;
+  if (name == "short" || name == "int16") return PLYType::Int16;
+  if (name == "ushort" || name == "uint16") return PLYType::UInt16;
+  if (name == "int" || name == "int32") return PLYType::Int32;
+  if (name == "uint" || name == "uint32") return PLYType::UInt32;
+  if (name == "float" || name == "float32") return PLYType::Float32;
+  if (name == "double" || name == "float64") return PLYType::Float64;
+  throw std::runtime_error("PLY header has unknown type " + name);
+}
+
+size_t plyTypeBytes(PLYType type) {
+  switch (type) {
+  case PLYType::Int8:
+  case PLYType::UInt8:
+    return 1;
+  case PLYType::Int16:
+  case PLYType::UInt16:
+    return 2;
+  case PLYType::Int32:
+  case PLYType::UInt32:
+  case PLYType::Float32:
+    return 4;
+  case PLYType::Float64:
+    return 8;
+  }
+  return 0;
+}
+
+struct PLYProperty {
+  std::string name;
+  PLYType type;
+  bool isList = false;
+  PLYType countType = PLYType::UInt8; // for lists; `type` is then the type of the items
+};
+
+struct PLYElement {
+  std::string name;
+  size_t count = 0;
+  std::vector<PLYProperty> properties;
+
+  bool hasLists() const {
+    for (const PLYProperty& p : properties) {
+      if (p.isList) return true;
+    }
+    return false;
+  }
+
+  // Bytes per record, for binary elements without lists
+  size_t recordBytes() const {
+    size_t bytes = 0;
+    for (const PLYProperty& p : properties) bytes += plyTypeBytes(p.type);
+    return bytes;
+  }
+};
+
+template <typename T>
+double readBinaryAs(const char* p, bool swapBytes) {
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, p, sizeof(T));
+  if (swapBytes) std::reverse(bytes, bytes + sizeof(T));
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return static_cast<double>(value);
+}
+
+double readBinary(const char* p, PLYType type, bool swapBytes) {
+  switch (type) {
+  case PLYType::Int8:
+    return readBinaryAs<int8_t>(p, swapBytes);
+  case PLYType::UInt8:
+    return readBinaryAs<uint8_t>(p, swapBytes);
+  case PLYType::Int16:
+    return readBinaryAs<int16_t>(p, swapBytes);
+  case PLYType::UInt16:
+    return readBinaryAs<uint16_t>(p, swapBytes);
+  case PLYType::Int32:
+    return readBinaryAs<int32_t>(p, swapBytes);
+  case PLYType::UInt32:
+    return readBinaryAs<uint32_t>(p, swapBytes);
+  case PLYType::Float32:
+    return readBinaryAs<float>(p, swapBytes);
+  case PLYType::Float64:
+    return readBinaryAs<double>(p, swapBytes);
+  }
+  return 0.;
+}
+
+// Reads values one after another, in either encoding
+class PLYReader {
+public:
+  PLYReader(const char* begin, const char* end, PLYFormat format)
+      : p(begin), end(end), format(format), swapBytes(format == PLYFormat::BinaryBigEndian) {
+    uint16_t one = 1;
+    char firstByte;
+    std::memcpy(&firstByte, &one, 1);
+    if (firstByte != 1) swapBytes = !swapBytes; // big-endian host
+  }
+
+  double read(PLYType type) {
+    double value;
+    if (format == PLYFormat::Ascii) {
+      while (p != end && std::isspace(static_cast<unsigned char>(*p))) p++;
+      if (p == end || !parseDouble(p, end, value)) fail();
+    } else {
+      size_t bytes = plyTypeBytes(type);
+      if (static_cast<size_t>(end - p) < bytes) fail();
+      value = readBinary(p, type, swapBytes);
+      p += bytes;
+    }
+    return value;
+  }
+
+  // Calls f(iProperty, value) for each value of one record, in order (so the count of a list comes before its items)
+  template <typename F>
+  void readRecord(const PLYElement& element, F&& f) {
+    for (size_t iP = 0; iP < element.properties.size(); iP++) {
+      const PLYProperty& property = element.properties[iP];
+      if (property.isList) {
+        double n = read(property.countType);
+        f(iP, n);
+        for (size_t k = 0; k < static_cast<size_t>(n); k++) f(iP, read(property.type));
+      } else {
+        f(iP, read(property.type));
+      }
+    }
+  }
 
-  // parse obj format
-  std::string line;
-  while (getline(in, line)) {
-    std::stringstream ss(line);
-    std::string token;
+  const char* p;
+  const char* end;
+  const PLYFormat format;
+  bool swapBytes;
 
-    ss >> token;
+private:
+  void fail() { throw std::runtime_error("PLY data is truncated or malformed"); }
+};
 
-    if (token == "v") {
-      double x, y, z;
-      ss >> x >> y >> z;
+// Parses the header, returning the start of the data
+const char* parsePLYHeader(const char* begin, const char* end, PLYFormat& format, std::vector<PLYElement>& elements) {
+  const char* p = begin;
+  bool first = true;
+  bool haveFormat = false;
+  while (true) {
+    if (p == end) throw std::runtime_error("PLY header has no end_header");
+    const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (lineEnd == nullptr) lineEnd = end;
+    std::istringstream line(std::string(p, lineEnd));
+    p = lineEnd == end ? end : lineEnd + 1;
+
+    std::string keyword;
+    line >> keyword;
+    if (first) {
+      if (keyword != "ply") throw std::runtime_error("not a PLY file");
+      first = false;
+    } else if (keyword == "format") {
+      std::string name;
+      line >> name;
+      if (name == "ascii") {
+        format = PLYFormat::Ascii;
+      } else if (name == "binary_little_endian") {
+        format = PLYFormat::BinaryLittleEndian;
+      } else if (name == "binary_big_endian") {
+        format = PLYFormat::BinaryBigEndian;
+      } else {
+        throw std::runtime_error("PLY header has unknown format " + name);
+      }
+      haveFormat = true;
+    } else if (keyword == "element") {
+      PLYElement element;
+      line >> element.name >> element.count;
+      if (!line) throw std::runtime_error("PLY header has a bad element line");
+      elements.push_back(element);
+    } else if (keyword == "property") {
+      if (elements.empty()) throw std::runtime_error("PLY header has a property outside of any element");
+      PLYProperty property;
+      std::string typeName;
+      line >> typeName;
+      if (typeName == "list") {
+        std::string countTypeName;
+        line >> countTypeName >> typeName;
+        property.isList = true;
+        property.countType = parsePLYType(countTypeName);
+      }
+      property.type = parsePLYType(typeName);
+      line >> property.name;
+      if (!line) throw std::runtime_error("PLY header has a bad property line");
+      elements.back().properties.push_back(property);
+    } else if (keyword == "end_header") {
+      break;
+    }
+    // (comment and obj_info lines, and anything unknown, are skipped)
+  }
+  if (!haveFormat) throw std::runtime_error("PLY header has no format");
+  return p;
+}
 
-      vertexPositionsOut.push_back({{x, y, z}});
+} // namespace
 
-    } else if (token == "vt") {
-      // Do nothing
+void loadPolygonSoup_PLY(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
+                         std::vector<uint32_t>& faceIndsEntriesOut, std::vector<size_t>& faceIndsStartOut,
+                         std::map<std::string, std::vector<double>>& vertexPropertiesOut) {
 
-    } else if (token == "vn") {
-      // Do nothing
+  vertexPositionsOut.clear();
+  faceIndsEntriesOut.clear();
+  faceIndsStartOut.clear();
+  vertexPropertiesOut.clear();
+
+  std::vector<char> data = readWholeFile(filename);
+  const char* fileEnd = data.data() + data.size();
+  PLYFormat format = PLYFormat::Ascii;
+  std::vector<PLYElement> elements;
+  const char* dataBegin = parsePLYHeader(data.data(), fileEnd, format, elements);
+  const bool binary = format != PLYFormat::Ascii;
+
+  PLYReader reader(dataBegin, fileEnd, format);
+  bool haveFaces = false;
+  for (const PLYElement& element : elements) {
+    const bool fixedRecords = binary && !element.hasLists();
+    const size_t recordBytes = element.recordBytes();
+    if (fixedRecords && static_cast<size_t>(fileEnd - reader.p) / std::max<size_t>(recordBytes, 1) < element.count) {
+      throw std::runtime_error("PLY data is truncated in element " + element.name);
+    }
 
-    } else if (token == "f") {
-      std::vector<size_t> face;
-      while (ss >> token) {
-        Index index = parseFaceIndex(token);
-        if (index.position < 0) {
-          getline(in, line);
-          size_t i = line.find_first_not_of("\t\n\v\f\r ");
-          index = parseFaceIndex(line.substr(i));
+    if (element.name == "vertex") {
+      // Every scalar property lands in an array; x, y and z are the positions
+      std::vector<std::vector<double>*> targets;
+      std::vector<size_t> offsets;
+      size_t offset = 0;
+      for (const PLYProperty& property : element.properties) {
+        targets.push_back(property.isList ? nullptr : &vertexPropertiesOut[property.name]);
+        offsets.push_back(offset);
+        offset += plyTypeBytes(property.type);
+      }
+      for (std::vector<double>* target : targets) {
+        if (target) target->resize(element.count);
+      }
+
+      if (fixedRecords) {
+        const char* records = reader.p;
+        parallelFor(0, element.count, [&](size_t i) {
+          const char* record = records + i * recordBytes;
+          for (size_t iP = 0; iP < targets.size(); iP++) {
+            (*targets[iP])[i] = readBinary(record + offsets[iP], element.properties[iP].type, reader.swapBytes);
+          }
+        });
+        reader.p += element.count * recordBytes;
+      } else {
+        for (size_t i = 0; i < element.count; i++) {
+          reader.readRecord(element, [&](size_t iP, double value) {
+            if (targets[iP]) (*targets[iP])[i] = value;
+          });
         }
+      }
 
-        face.push_back(index.position);
+      for (const char* axis : {"x", "y", "z"}) {
+        if (vertexPropertiesOut.find(axis) == vertexPropertiesOut.end()) {
+          throw std::runtime_error("PLY vertex element has no " + std::string(axis) + " property");
+        }
+      }
+      std::vector<double>& xs = vertexPropertiesOut["x"];
+      std::vector<double>& ys = vertexPropertiesOut["y"];
+      std::vector<double>& zs = vertexPropertiesOut["z"];
+      vertexPositionsOut.resize(element.count);
+      parallelFor(0, element.count, [&](size_t i) { vertexPositionsOut[i] = {{xs[i], ys[i], zs[i]}}; });
+      vertexPropertiesOut.erase("x");
+      vertexPropertiesOut.erase("y");
+      vertexPropertiesOut.erase("z");
+
+    } else if (element.name == "face" && !haveFaces) {
+      haveFaces = true;
+      size_t iIndices = element.properties.size();
+      for (size_t iP = 0; iP < element.properties.size(); iP++) {
+        const PLYProperty& property = element.properties[iP];
+        if (property.isList && (property.name == "vertex_indices" || property.name == "vertex_index")) iIndices = iP;
+      }
+      if (iIndices == element.properties.size()) {
+        throw std::runtime_error("PLY face element has no vertex_indices property");
       }
 
-      faceIndicesOut.push_back(face);
+      // Binary triangle meshes where the index list is the only list have records of a fixed size, which can be read
+      // in parallel. Check that every record really is a triangle first.
+      size_t triangleRecordBytes = 0;
+      size_t indicesOffset = 0;
+      bool triangles = false;
+      const PLYProperty& indices = element.properties[iIndices];
+      if (binary) {
+        triangles = true;
+        for (size_t iP = 0; iP < element.properties.size(); iP++) {
+          const PLYProperty& property = element.properties[iP];
+          if (iP == iIndices) {
+            indicesOffset = triangleRecordBytes;
+            triangleRecordBytes += plyTypeBytes(property.countType) + 3 * plyTypeBytes(property.type);
+          } else {
+            triangles = triangles && !property.isList;
+            triangleRecordBytes += plyTypeBytes(property.type);
+          }
+        }
+        triangles = triangles &&
+                    static_cast<size_t>(fileEnd - reader.p) / std::max<size_t>(triangleRecordBytes, 1) >= element.count;
+      }
+      if (triangles) {
+        const char* records = reader.p;
+        std::vector<char> isTriangle(element.count);
+        parallelFor(0, element.count, [&](size_t i) {
+          const char* count = records + i * triangleRecordBytes + indicesOffset;
+          isTriangle[i] = readBinary(count, indices.countType, reader.swapBytes) == 3.;
+        });
+        triangles = std::find(isTriangle.begin(), isTriangle.end(), false) == isTriangle.end();
+      }
+
+      if (triangles) {
+        const char* records = reader.p;
+        const size_t itemBytes = plyTypeBytes(indices.type);
+        faceIndsEntriesOut.resize(3 * element.count);
+        std::vector<char> inRange(element.count);
+        parallelFor(0, element.count, [&](size_t i) {
+          const char* items = records + i * triangleRecordBytes + indicesOffset + plyTypeBytes(indices.countType);
+          bool ok = true;
+          for (size_t j = 0; j < 3; j++) {
+            double index = readBinary(items + j * itemBytes, indices.type, reader.swapBytes);
+            ok = ok && index >= 0. && index < static_cast<double>(std::numeric_limits<uint32_t>::max());
+            faceIndsEntriesOut[3 * i + j] = ok ? static_cast<uint32_t>(index) : 0;
+          }
+          inRange[i] = ok;
+        });
+        if (std::find(inRange.begin(), inRange.end(), false) != inRange.end()) {
+          throw std::runtime_error("PLY face element has a negative or too large vertex index");
+        }
+        faceIndsStartOut.resize(element.count + 1);
+        for (size_t i = 0; i <= element.count; i++) faceIndsStartOut[i] = 3 * i;
+        reader.p += element.count * triangleRecordBytes;
+      } else {
+        faceIndsStartOut.reserve(element.count + 1);
+        for (size_t i = 0; i < element.count; i++) {
+          faceIndsStartOut.push_back(faceIndsEntriesOut.size());
+          bool isCount = true;
+          reader.readRecord(element, [&](size_t iP, double value) {
+            if (iP != iIndices) return;
+            if (isCount) {
+              isCount = false;
+              return;
+            }
+            if (!(value >= 0. && value < static_cast<double>(std::numeric_limits<uint32_t>::max()))) {
+              throw std::runtime_error("PLY face element has a negative or too large vertex index");
+            }
+            faceIndsEntriesOut.push_back(static_cast<uint32_t>(value));
+          });
+        }
+        faceIndsStartOut.push_back(faceIndsEntriesOut.size());
+      }
+
+    } else if (fixedRecords) {
+      reader.p += element.count * recordBytes;
+    } else {
+      for (size_t i = 0; i < element.count; i++) {
+        reader.readRecord(element, [](size_t, double) {});
+      }
+    }
+  }
+
+  if (faceIndsStartOut.empty()) faceIndsStartOut.push_back(0);
+  for (uint32_t iV : faceIndsEntriesOut) {
+    if (iV >= vertexPositionsOut.size()) {
+      throw std::runtime_error("PLY face element has vertex index " + std::to_string(iV) + ", but there are only " +
+                               std::to_string(vertexPositionsOut.size()) + " vertices");
     }
   }
 }
@@ -107,11 +739,16 @@ void loadPolygonSoup_OBJ(std::string filename, std::vector<std::array<double, 3>
 void loadPolygonSoup_PLY(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
                          std::vector<std::vector<size_t>>& faceIndicesOut) {
 
-  happly::PLYData plyIn(filename);
+  std::vector<uint32_t> faceIndsEntries;
+  std::vector<size_t> faceIndsStart;
+  std::map<std::string, std::vector<double>> vertexProperties;
+  loadPolygonSoup_PLY(filename, vertexPositionsOut, faceIndsEntries, faceIndsStart, vertexProperties);
 
-  // Get mesh-style data from the object
-  vertexPositionsOut = plyIn.getVertexPositions();
-  faceIndicesOut = plyIn.getFaceIndices<size_t>();
+  faceIndicesOut.resize(faceIndsStart.size() - 1);
+  parallelFor(0, faceIndicesOut.size(), [&](size_t iF) {
+    faceIndicesOut[iF].assign(faceIndsEntries.begin() + faceIndsStart[iF],
+                              faceIndsEntries.begin() + faceIndsStart[iF + 1]);
+  });
 }
 
 void loadPolygonSoup(std::string filename, std::vector<std::array<double, 3>>& vertexPositionsOut,
@@ -126,15 +763,7 @@ void loadPolygonSoup(std::string filename, std::vector<std::array<double, 3>>& v
   testStream.close();
 
   // Attempt to detect filename
-  std::string::size_type sepInd = filename.rfind('.');
-  std::string extension = "";
-  if (sepInd != std::string::npos) {
-    extension = filename.substr(sepInd + 1);
-
-    // Convert to all lowercase
-    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-  }
-
+  std::string extension = fileExtension(filename);
 
   if (extension == "obj") {
     loadPolygonSoup_OBJ(filename, vertexPositionsOut, faceIndicesOut);
@@ -144,4 +773,151 @@ void loadPolygonSoup(std::string filename, std::vector<std::array<double, 3>>& v
     error("Could not detect file type to load mesh from " + filename);
   }
 }
+
+// === Loading many files at once
+
+namespace {
+
+struct SoupLoader {
+  std::mutex mutex;
+  std::condition_variable changed; // bytes were handed over, or a file was queued for the main thread
+  size_t bytesInFlight = 0;        // of files read (or being read) but not yet passed on
+  size_t nLoading = 0;             // (main thread only)
+  bool stopping = false;
+
+  // Declared last, so that it is destroyed first; the destructor lets jobs waiting for the budget return
+  std::unique_ptr<JobQueue> reads;
+
+  ~SoupLoader() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    changed.notify_all();
+    reads.reset();
+  }
+};
+
+SoupLoader& soupLoader() {
+  static SoupLoader loader;
+  return loader;
+}
+
+void loadOneSoup(const std::string& filename, size_t memoryBudget,
+                 const std::function<void(LoadedPolygonSoup&)>& onLoaded) {
+  SoupLoader& loader = soupLoader();
+  size_t bytes = 0;
+  {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (in) bytes = static_cast<size_t>(in.tellg());
+  }
+
+#ifndef POLYSCOPE_NO_THREADS // (otherwise this runs on the main thread, which is what frees the budget)
+  {
+    std::unique_lock<std::mutex> lock(loader.mutex);
+    loader.changed.wait(lock, [&]() {
+      return loader.stopping || loader.bytesInFlight == 0 || loader.bytesInFlight + bytes <= memoryBudget;
+    });
+    if (loader.stopping) return;
+    loader.bytesInFlight += bytes;
+  }
+#endif
+
+  std::shared_ptr<LoadedPolygonSoup> soup = std::make_shared<LoadedPolygonSoup>();
+  soup->filename = filename;
+  try {
+    std::string extension = fileExtension(filename);
+    if (extension == "obj") {
+      loadPolygonSoup_OBJ(filename, soup->vertexPositions, soup->faceIndsEntries, soup->faceIndsStart);
+    } else if (extension == "ply") {
+      std::map<std::string, std::vector<double>> vertexProperties;
+      loadPolygonSoup_PLY(filename, soup->vertexPositions, soup->faceIndsEntries, soup->faceIndsStart,
+                          vertexProperties);
+    } else {
+      throw std::invalid_argument("Could not detect file type to load mesh from " + filename);
+    }
+  } catch (const std::exception& e) {
+    *soup = LoadedPolygonSoup();
+    soup->filename = filename;
+    soup->error = e.what();
+  }
+
+  queueCommand([soup, bytes, onLoaded]() {
+    SoupLoader& loader = soupLoader();
+    {
+      std::lock_guard<std::mutex> lock(loader.mutex);
+#ifndef POLYSCOPE_NO_THREADS
+      loader.bytesInFlight -= bytes;
+#endif
+      loader.nLoading--;
+    }
+    loader.changed.notify_all();
+    onLoaded(*soup);
+  });
+  loader.changed.notify_all();
+}
+
+} // namespace
+
+void loadPolygonSoups(const std::vector<std::string>& filenames, std::function<void(LoadedPolygonSoup&)> onLoaded) {
+  SoupLoader& loader = soupLoader();
+  if (!loader.reads) {
+    loader.reads.reset(new JobQueue(options::meshLoadThreads));
+  }
+  size_t memoryBudget = options::meshLoadMemoryBudget;
+  for (const std::string& filename : filenames) {
+    {
+      std::lock_guard<std::mutex> lock(loader.mutex);
+      loader.nLoading++;
+    }
+    loader.reads->push([filename, memoryBudget, onLoaded]() { loadOneSoup(filename, memoryBudget, onLoaded); });
+  }
+}
+
+void registerSurfaceMeshesFromFiles(const std::vector<std::string>& filenames,
+                                    std::function<void(SurfaceMesh*)> onRegistered) {
+  loadPolygonSoups(filenames, [onRegistered](LoadedPolygonSoup& soup) {
+    if (!soup.error.empty()) {
+      error("Could not load " + soup.filename + ": " + soup.error);
+      return;
+    }
+
+    std::string name = soup.filename;
+    std::string::size_type slashInd = name.find_last_of("/\\");
+    if (slashInd != std::string::npos) name = name.substr(slashInd + 1);
+    std::string::size_type dotInd = name.rfind('.');
+    if (dotInd != std::string::npos && dotInd > 0) name = name.substr(0, dotInd);
+
+    std::vector<glm::vec3> positions(soup.vertexPositions.size());
+    for (size_t iV = 0; iV < positions.size(); iV++) {
+      positions[iV] = glm::vec3{soup.vertexPositions[iV][0], soup.vertexPositions[iV][1], soup.vertexPositions[iV][2]};
+    }
+    soup.vertexPositions = std::vector<std::array<double, 3>>(); // (release it before the mesh allocates its own)
+
+    SurfaceMesh* s =
+        new SurfaceMesh(name, positions, std::move(soup.faceIndsEntries), std::move(soup.faceIndsStart));
+    if (!registerStructure(s)) {
+      safeDelete(s);
+      return;
+    }
+    if (onRegistered) onRegistered(s);
+  });
+}
+
+size_t nPolygonSoupsLoading() {
+  SoupLoader& loader = soupLoader();
+  std::lock_guard<std::mutex> lock(loader.mutex);
+  return loader.nLoading;
+}
+
+void finishLoadingPolygonSoups() {
+  SoupLoader& loader = soupLoader();
+  while (true) {
+    runQueuedCommands(); // (which passes on the files, and frees their budget)
+    std::unique_lock<std::mutex> lock(loader.mutex);
+    if (loader.nLoading == 0) return;
+    loader.changed.wait_for(lock, std::chrono::milliseconds(10));
+  }
+}
+
 } // namespace polyscope
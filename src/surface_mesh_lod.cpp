@@ -0,0 +1,184 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/surface_mesh_lod.h"
+
+#include "polyscope/parallel.h"
+#include "polyscope/surface_mesh.h"
+#include "polyscope/utilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace polyscope {
+
+const size_t SurfaceMeshLOD::minTriangles;
+const size_t SurfaceMeshLOD::maxLevels;
+
+namespace {
+const unsigned int cellBits = 21; // per axis, so a cell packs in to 63 bits
+}
+
+SurfaceMeshLOD::SurfaceMeshLOD(const SurfaceMesh& mesh) {
+  bboxMin = glm::vec3{std::numeric_limits<float>::infinity()};
+  bboxMax = glm::vec3{-std::numeric_limits<float>::infinity()};
+  for (const glm::vec3& p : mesh.vertices) {
+    bboxMin = glm::min(bboxMin, p);
+    bboxMax = glm::max(bboxMax, p);
+  }
+  if (mesh.nEdges() == 0) return;
+
+  // Start from cells about twice the mean edge length, which hold a few vertices each
+  double meanEdgeLength = 0.;
+  for (double l : mesh.edgeLengths) meanEdgeLength += l;
+  meanEdgeLength /= mesh.nEdges();
+  if (!(meanEdgeLength > 0.)) return;
+  float cellSize = 2. * meanEdgeLength;
+
+  glm::vec3 extent = bboxMax - bboxMin;
+  float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+  std::vector<uint32_t> rep(mesh.nVertices());
+  size_t prevTriangles = mesh.nFacesTriangulationCount;
+  while (levels.size() < maxLevels && prevTriangles >= minTriangles) {
+    if (maxExtent / cellSize < static_cast<float>(1u << cellBits)) {
+      Level next = buildLevel(mesh, levels.empty() ? nullptr : &levels.back(), cellSize, rep);
+      if (next.nTriangles == 0) break;
+      prevTriangles = next.nTriangles;
+      levels.push_back(std::move(next));
+    }
+    cellSize *= 2.;
+  }
+}
+
+SurfaceMeshLOD::Level SurfaceMeshLOD::buildLevel(const SurfaceMesh& mesh, const Level* prev, float cellSize,
+                                                 std::vector<uint32_t>& rep) const {
+  size_t nSourceFaces = prev ? prev->faces.size() : mesh.nFaces();
+  auto sourceCorners = [&](size_t i) {
+    if (prev) {
+      return SurfaceMesh::IndexView{prev->entries.data() + prev->entryStart[i],
+                                    prev->entryStart[i + 1] - prev->entryStart[i]};
+    }
+    return mesh.face(i);
+  };
+
+  // The vertices still in use at the previous level
+  std::vector<char> inUse(mesh.nVertices(), false);
+  std::vector<uint32_t> used;
+  for (size_t i = 0; i < nSourceFaces; i++) {
+    for (uint32_t iV : sourceCorners(i)) {
+      if (!inUse[iV]) {
+        inUse[iV] = true;
+        used.push_back(iV);
+      }
+    }
+  }
+
+  // Sort them by cell
+  std::vector<uint64_t> keys(used.size());
+  std::vector<size_t> sorted(used.size());
+  const float maxCell = static_cast<float>((1u << cellBits) - 1);
+  parallelFor(0, used.size(), [&](size_t i) {
+    glm::vec3 cell = glm::floor((mesh.vertices[used[i]] - bboxMin) / cellSize);
+    uint64_t key = 0;
+    for (int axis = 0; axis < 3; axis++) {
+      key = (key << cellBits) | static_cast<uint64_t>(glm::clamp(cell[axis], 0.f, maxCell));
+    }
+    keys[i] = key;
+    sorted[i] = i;
+  });
+  parallelSortByKey(keys, sorted, 3 * cellBits);
+
+  // Each cell is represented by its vertex nearest to the mean of its vertices
+  size_t runStart = 0;
+  while (runStart < used.size()) {
+    size_t runEnd = runStart + 1;
+    while (runEnd < used.size() && keys[runEnd] == keys[runStart]) runEnd++;
+
+    glm::dvec3 mean{0., 0., 0.};
+    for (size_t i = runStart; i < runEnd; i++) {
+      mean += glm::dvec3(mesh.vertices[used[sorted[i]]]);
+    }
+    glm::vec3 center = glm::vec3(mean / static_cast<double>(runEnd - runStart));
+    uint32_t best = used[sorted[runStart]];
+    float bestDist = std::numeric_limits<float>::infinity();
+    for (size_t i = runStart; i < runEnd; i++) {
+      uint32_t iV = used[sorted[i]];
+      float dist = glm::length(mesh.vertices[iV] - center);
+      if (dist < bestDist) {
+        bestDist = dist;
+        best = iV;
+      }
+    }
+    for (size_t i = runStart; i < runEnd; i++) {
+      rep[used[sorted[i]]] = best;
+    }
+
+    runStart = runEnd;
+  }
+
+  // Keep the faces whose corners all land in different cells
+  Level level;
+  level.cellSize = cellSize;
+  level.entryStart.push_back(0);
+  for (size_t i = 0; i < nSourceFaces; i++) {
+    SurfaceMesh::IndexView face = sourceCorners(i);
+    size_t D = face.size();
+    size_t start = level.entries.size();
+    for (uint32_t iV : face) {
+      level.entries.push_back(rep[iV]);
+    }
+    bool collapsed = false;
+    for (size_t j = 0; j < D && !collapsed; j++) {
+      for (size_t k = j + 1; k < D; k++) {
+        if (level.entries[start + j] == level.entries[start + k]) {
+          collapsed = true;
+          break;
+        }
+      }
+    }
+    if (collapsed || D < 3) {
+      level.entries.resize(start);
+      continue;
+    }
+    level.faces.push_back(prev ? prev->faces[i] : static_cast<uint32_t>(i));
+    level.entryStart.push_back(static_cast<uint32_t>(level.entries.size()));
+    level.nTriangles += D - 2;
+  }
+
+  return level;
+}
+
+size_t SurfaceMeshLOD::selectLevel(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight,
+                                   float maxPixelError) const {
+  if (levels.empty()) return 0;
+
+  glm::mat4 toClip = projection * modelView;
+  float viewScale = std::cbrt(std::abs(glm::determinant(glm::mat3(modelView)))); // object units to view units
+  float pixelsPerUnit = projection[1][1] * viewportHeight / 2.;
+
+  // Depth is linear over the box, so its nearest point to the camera is one of the corners
+  float wNear = std::numeric_limits<float>::infinity();
+  for (int c = 0; c < 8; c++) {
+    glm::vec3 corner{(c & 4) ? bboxMax.x : bboxMin.x, (c & 2) ? bboxMax.y : bboxMin.y, (c & 1) ? bboxMax.z : bboxMin.z};
+    wNear = std::min(wNear, (toClip * glm::vec4(corner, 1.)).w);
+  }
+  if (!(wNear > 0.)) return 0; // the camera is inside the box
+
+  size_t selected = 0;
+  for (size_t iLevel = 1; iLevel <= levels.size(); iLevel++) {
+    float vertexError = std::sqrt(3.f) * level(iLevel).cellSize; // the diagonal of a cell
+    if (viewScale * vertexError * pixelsPerUnit / wNear > maxPixelError) break;
+    selected = iLevel;
+  }
+  return selected;
+}
+
+size_t SurfaceMeshLOD::allocatedBytes() const {
+  size_t bytes = polyscope::allocatedBytes(levels);
+  for (const Level& l : levels) {
+    bytes += polyscope::allocatedBytes(l.faces) + polyscope::allocatedBytes(l.entryStart) +
+             polyscope::allocatedBytes(l.entries);
+  }
+  return bytes;
+}
+
+} // namespace polyscope
@@ -7,6 +7,8 @@
 
 #include "imgui.h"
 
+#include <limits>
+
 using std::cout;
 using std::endl;
 
@@ -38,31 +40,36 @@ void SurfaceParameterizationQuantity::draw() {
   setProgramUniforms(*program);
   parent.setStructureUniforms(*program);
   parent.setSurfaceMeshUniforms(*program);
+  if (usingIndexedDrawing && parent.wantsDepthSortedTriangles()) {
+    parent.sortTrianglesByDepth(*program, programDepthSortCount, indexedTriangleLister());
+  }
 
   program->draw();
 }
 
 void SurfaceParameterizationQuantity::createProgram() {
   // Create the program to draw this quantity
+  usingIndexedDrawing = parent.canUseIndexedDrawing();
+  std::string shaderName = usingIndexedDrawing ? "MESH_INDEXED" : "MESH";
 
   switch (getStyle()) {
   case ParamVizStyle::CHECKER:
     // program = render::engine->generateShaderProgram(
     //{render::PARAM_SURFACE_VERT_SHADER, render::PARAM_CHECKER_SURFACE_FRAG_SHADER}, DrawMode::Triangles);
     program = render::engine->requestShader(
-        "MESH", parent.addSurfaceMeshRules({"MESH_PROPAGATE_VALUE2", "SHADE_CHECKER_VALUE2"}));
+        shaderName, parent.addSurfaceMeshRules({"MESH_PROPAGATE_VALUE2", "SHADE_CHECKER_VALUE2"}));
     break;
   case ParamVizStyle::GRID:
     // program = render::engine->generateShaderProgram(
     //{render::PARAM_SURFACE_VERT_SHADER, render::PARAM_GRID_SURFACE_FRAG_SHADER}, DrawMode::Triangles);
-    program = render::engine->requestShader("MESH",
+    program = render::engine->requestShader(shaderName,
                                             parent.addSurfaceMeshRules({"MESH_PROPAGATE_VALUE2", "SHADE_GRID_VALUE2"}));
     break;
   case ParamVizStyle::LOCAL_CHECK:
     // program = render::engine->generateShaderProgram(
     //{render::PARAM_SURFACE_VERT_SHADER, render::PARAM_LOCAL_CHECKER_SURFACE_FRAG_SHADER}, DrawMode::Triangles);
     program = render::engine->requestShader(
-        "MESH",
+        shaderName,
         parent.addSurfaceMeshRules({"MESH_PROPAGATE_VALUE2", "SHADE_COLORMAP_ANGULAR2", "CHECKER_VALUE2COLOR"}));
     program->setTextureFromColormap("t_colormap", cMap.get());
     break;
@@ -70,15 +77,20 @@ void SurfaceParameterizationQuantity::createProgram() {
     // program = render::engine->generateShaderProgram(
     //{render::PARAM_SURFACE_VERT_SHADER, render::PARAM_LOCAL_RAD_SURFACE_FRAG_SHADER}, DrawMode::Triangles);
     program = render::engine->requestShader(
-        "MESH", parent.addSurfaceMeshRules({"MESH_PROPAGATE_VALUE2", "SHADE_COLORMAP_ANGULAR2", "SHADEVALUE_MAG_VALUE2",
+        shaderName, parent.addSurfaceMeshRules({"MESH_PROPAGATE_VALUE2", "SHADE_COLORMAP_ANGULAR2", "SHADEVALUE_MAG_VALUE2",
                                             "ISOLINE_STRIPE_VALUECOLOR"}));
     program->setTextureFromColormap("t_colormap", cMap.get());
     break;
   }
 
   // Fill color buffers
-  fillColorBuffers(*program);
-  parent.fillGeometryBuffers(*program);
+  programDepthSortCount = 0;
+  if (usingIndexedDrawing) {
+    fillIndexedBuffers(*program);
+  } else {
+    fillColorBuffers(*program);
+    parent.fillGeometryBuffers(*program);
+  }
 
   render::engine->setMaterial(*program, parent.getMaterial());
 }
@@ -262,6 +274,13 @@ void SurfaceParameterizationQuantity::refresh() {
   Quantity::refresh();
 }
 
+void SurfaceParameterizationQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  if (usingIndexedDrawing) {
+    program.reset(); // (the positions are the program's own, rather than the mesh's shared corner buffers)
+  }
+  requestRedraw();
+}
+
 // ==============================================================
 // ===============  Corner Parameterization  ====================
 // ==============================================================
@@ -280,10 +299,9 @@ void SurfaceCornerParameterizationQuantity::fillColorBuffers(render::ShaderProgr
   std::vector<glm::vec2> coordVal;
   coordVal.reserve(3 * parent.nFacesTriangulation());
 
-  size_t cornerCount = 0;
-  for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-    auto& face = parent.faces[iF];
+  parent.forEachDrawnFace([&](size_t iF, SurfaceMesh::IndexView face) {
     size_t D = face.size();
+    size_t cornerCount = parent.halfedgeIndex(iF, 0);
 
     // implicitly triangulate from root
     size_t cRoot = cornerCount;
@@ -295,14 +313,69 @@ void SurfaceCornerParameterizationQuantity::fillColorBuffers(render::ShaderProgr
       coordVal.push_back(coords[cB]);
       coordVal.push_back(coords[cC]);
     }
-
-    cornerCount += D;
-  }
+  });
 
   // Store data in buffers
   p.setAttribute("a_value2", coordVal);
 }
 
+void SurfaceCornerParameterizationQuantity::splitSeamVertices(std::vector<uint32_t>& splitVertices,
+                                                              std::vector<glm::vec2>& splitCoords,
+                                                              std::vector<std::array<unsigned int, 3>>& triangles) {
+  // One drawn vertex per distinct coordinate among the corners of each vertex, so only vertices on seams are split.
+  // The drawn vertices of a mesh vertex are chained through nextSplit; most have just one.
+  const uint32_t none = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> firstSplit(parent.nVertices(), none);
+  std::vector<uint32_t> nextSplit;
+  auto drawnVertex = [&](size_t iV, size_t iC) {
+    uint32_t* slot = &firstSplit[iV];
+    while (*slot != none) {
+      if (splitCoords[*slot] == coords[iC]) return static_cast<unsigned int>(*slot);
+      slot = &nextSplit[*slot];
+    }
+    uint32_t iSplit = static_cast<uint32_t>(splitVertices.size());
+    *slot = iSplit; // (before the push below, which may move nextSplit)
+    splitVertices.push_back(static_cast<uint32_t>(iV));
+    splitCoords.push_back(coords[iC]);
+    nextSplit.push_back(none);
+    return static_cast<unsigned int>(iSplit);
+  };
+
+  triangles.clear();
+  triangles.reserve(parent.nFacesTriangulation());
+  parent.forEachDrawnFace([&](size_t iF, SurfaceMesh::IndexView face) {
+    size_t D = face.size();
+    size_t cornerCount = parent.halfedgeIndex(iF, 0);
+
+    // implicitly triangulate from root, like fillColorBuffers()
+    unsigned int root = drawnVertex(face[0], cornerCount);
+    for (size_t j = 1; (j + 1) < D; j++) {
+      triangles.push_back({root, drawnVertex(face[j], cornerCount + j),
+                           drawnVertex(face[(j + 1) % D], cornerCount + ((j + 1) % D))});
+    }
+  });
+
+}
+
+void SurfaceCornerParameterizationQuantity::fillIndexedBuffers(render::ShaderProgram& p) {
+  std::vector<uint32_t> splitVertices;
+  std::vector<glm::vec2> splitCoords;
+  std::vector<std::array<unsigned int, 3>> triangles;
+  splitSeamVertices(splitVertices, splitCoords, triangles);
+  parent.fillGeometryBuffersIndexed(p, splitVertices, triangles);
+  p.setAttribute("a_value2", splitCoords);
+}
+
+std::function<void(std::vector<std::array<unsigned int, 3>>&)>
+SurfaceCornerParameterizationQuantity::indexedTriangleLister() {
+  // (the split is deterministic, so doing it again numbers the drawn vertices as the buffers did)
+  return [this](std::vector<std::array<unsigned int, 3>>& triangles) {
+    std::vector<uint32_t> splitVertices;
+    std::vector<glm::vec2> splitCoords;
+    splitSeamVertices(splitVertices, splitCoords, triangles);
+  };
+}
+
 void SurfaceCornerParameterizationQuantity::buildHalfedgeInfoGUI(size_t heInd) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
@@ -328,8 +401,7 @@ void SurfaceVertexParameterizationQuantity::fillColorBuffers(render::ShaderProgr
   std::vector<glm::vec2> coordVal;
   coordVal.reserve(3 * parent.nFacesTriangulation());
 
-  for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-    auto& face = parent.faces[iF];
+  parent.forEachDrawnFace([&](size_t, SurfaceMesh::IndexView face) {
     size_t D = face.size();
 
     // implicitly triangulate from root
@@ -342,12 +414,17 @@ void SurfaceVertexParameterizationQuantity::fillColorBuffers(render::ShaderProgr
       coordVal.push_back(coords[vB]);
       coordVal.push_back(coords[vC]);
     }
-  }
+  });
 
   // Store data in buffers
   p.setAttribute("a_value2", coordVal);
 }
 
+void SurfaceVertexParameterizationQuantity::fillIndexedBuffers(render::ShaderProgram& p) {
+  parent.fillGeometryBuffersIndexed(p); // (no seams to split)
+  p.setAttribute("a_value2", coords);
+}
+
 void SurfaceVertexParameterizationQuantity::buildVertexInfoGUI(size_t vInd) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
@@ -355,5 +432,8 @@ void SurfaceVertexParameterizationQuantity::buildVertexInfoGUI(size_t vInd) {
   ImGui::NextColumn();
 }
 
+size_t SurfaceCornerParameterizationQuantity::hostMemoryUsage() { return allocatedBytes(coords); }
+
+size_t SurfaceVertexParameterizationQuantity::hostMemoryUsage() { return allocatedBytes(coords); }
 
 } // namespace polyscope
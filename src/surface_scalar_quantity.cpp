@@ -2,11 +2,18 @@
 #include "polyscope/surface_scalar_quantity.h"
 
 #include "polyscope/file_helpers.h"
+#include "polyscope/parallel.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/render/engine.h"
 
 #include "imgui.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+
 using std::cout;
 using std::endl;
 
@@ -54,6 +61,16 @@ void SurfaceScalarQuantity::refresh() {
   Quantity::refresh();
 }
 
+void SurfaceScalarQuantity::dataUpdated() {
+  if (program) {
+    fillColorBuffers(*program);
+  }
+}
+
+void SurfaceScalarQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  requestRedraw();
+}
+
 std::string SurfaceScalarQuantity::niceName() { return name + " (" + definedOn + " scalar)"; }
 
 // ========================================================
@@ -62,10 +79,29 @@ std::string SurfaceScalarQuantity::niceName() { return name + " (" + definedOn +
 
 SurfaceVertexScalarQuantity::SurfaceVertexScalarQuantity(std::string name, const std::vector<double>& values_,
                                                          SurfaceMesh& mesh_, DataType dataType_)
-    : SurfaceScalarQuantity(name, mesh_, "vertex", values_, dataType_)
+    : SurfaceScalarQuantity(name, mesh_, "vertex", values_, dataType_),
+      contoursEnabled(uniquePrefix() + "#contoursEnabled", false),
+      contourColor(uniquePrefix() + "#contourColor", glm::vec3{0.05, 0.05, 0.05})
 
 {
-  hist.buildHistogram(values, parent.vertexAreas); // rebuild to incorporate weights
+  hist.buildHistogramLazily([this]() { // with weights
+    parent.ensureHaveGeometryData();
+    values.buildHistogram(hist, parent.vertexAreas);
+  });
+}
+
+void SurfaceVertexScalarQuantity::draw() {
+  SurfaceScalarQuantity::draw();
+  if (!isEnabled() || !getContoursEnabled()) return;
+
+  if (contourProgram == nullptr) {
+    createContourProgram();
+  }
+  if (contourProgram == nullptr) return; // no level crosses the mesh
+
+  parent.setStructureUniforms(*contourProgram);
+  contourProgram->setUniform("u_baseColor", getContourColor());
+  contourProgram->draw();
 }
 
 void SurfaceVertexScalarQuantity::createProgram() {
@@ -84,8 +120,7 @@ void SurfaceVertexScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
   std::vector<double> colorval;
   colorval.reserve(3 * parent.nFacesTriangulation());
 
-  for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-    auto& face = parent.faces[iF];
+  parent.forEachDrawnFace([&](size_t, SurfaceMesh::IndexView face) {
     size_t D = face.size();
 
     // implicitly triangulate from root
@@ -98,7 +133,7 @@ void SurfaceVertexScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
       colorval.push_back(values[vB]);
       colorval.push_back(values[vC]);
     }
-  }
+  });
 
   // Store data in buffers
   p.setAttribute("a_value", colorval);
@@ -112,6 +147,288 @@ void SurfaceVertexScalarQuantity::buildVertexInfoGUI(size_t vInd) {
   ImGui::NextColumn();
 }
 
+void SurfaceVertexScalarQuantity::buildCustomUI() {
+  SurfaceScalarQuantity::buildCustomUI();
+
+  if (ImGui::Checkbox("Contours", &contoursEnabled.get())) setContoursEnabled(getContoursEnabled());
+  if (getContoursEnabled()) {
+    ImGui::SameLine();
+    if (ImGui::ColorEdit3("Contour color", &contourColor.get()[0], ImGuiColorEditFlags_NoInputs)) {
+      setContourColor(getContourColor());
+    }
+    int nLevels = static_cast<int>(contourLevels.size());
+    ImGui::PushItemWidth(100);
+    if (ImGui::InputInt("Levels", &nLevels)) setContourLevelCount(static_cast<size_t>(std::max(nLevels, 0)));
+    ImGui::PopItemWidth();
+  }
+}
+
+void SurfaceVertexScalarQuantity::refresh() {
+  contourProgram.reset();
+  SurfaceScalarQuantity::refresh();
+}
+
+void SurfaceVertexScalarQuantity::releaseRenderData() {
+  contourProgram.reset();
+  SurfaceScalarQuantity::releaseRenderData();
+}
+
+bool SurfaceVertexScalarQuantity::topologyChanged() {
+  values.resize(parent.nVertices());
+  hist.buildHistogramLazily([this]() { values.buildHistogram(hist); });
+  for (ContourLevel& level : contourLevels) {
+    level.valid = false;
+  }
+  releaseRenderData();
+  return true;
+}
+
+void SurfaceVertexScalarQuantity::dataUpdated() {
+  for (ContourLevel& level : contourLevels) {
+    level.valid = false;
+  }
+  contourProgram.reset();
+  SurfaceScalarQuantity::dataUpdated();
+}
+
+void SurfaceVertexScalarQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  // The contours follow the vertices, so all of them are extracted again. (The changed faces alone could be
+  // re-extracted, but the segments of each level are stored contiguously, in face order.)
+  for (ContourLevel& level : contourLevels) {
+    level.valid = false;
+  }
+  contourProgram.reset();
+  SurfaceScalarQuantity::geometryChanged(faceRanges);
+}
+
+size_t SurfaceVertexScalarQuantity::hostMemoryUsage() {
+  size_t bytes = SurfaceScalarQuantity::hostMemoryUsage();
+  for (ContourLevel& level : contourLevels) {
+    bytes += allocatedBytes(level.segmentPoints) + allocatedBytes(level.segmentEdges);
+  }
+  return bytes;
+}
+
+SurfaceVertexScalarQuantity* SurfaceVertexScalarQuantity::setContourLevels(const std::vector<double>& levels) {
+
+  // Keep the extracted contours of levels which appear in the new list too
+  std::vector<ContourLevel> newLevels;
+  newLevels.reserve(levels.size());
+  for (double value : levels) {
+    auto it = std::find_if(contourLevels.begin(), contourLevels.end(),
+                           [&](const ContourLevel& l) { return l.valid && l.value == value; });
+    if (it != contourLevels.end()) {
+      newLevels.push_back(std::move(*it));
+      it->valid = false; // (moved from, a repeated value extracts it again)
+    } else {
+      newLevels.push_back(ContourLevel{value, false, {}, {}});
+    }
+  }
+  contourLevels = std::move(newLevels);
+
+  contourProgram.reset();
+  requestRedraw();
+  return this;
+}
+
+std::vector<double> SurfaceVertexScalarQuantity::getContourLevels() {
+  std::vector<double> levels;
+  levels.reserve(contourLevels.size());
+  for (const ContourLevel& level : contourLevels) {
+    levels.push_back(level.value);
+  }
+  return levels;
+}
+
+SurfaceVertexScalarQuantity* SurfaceVertexScalarQuantity::setContourLevelCount(size_t n) {
+  std::pair<double, double> range = getMapRange();
+  std::vector<double> levels(n);
+  for (size_t i = 0; i < n; i++) {
+    levels[i] = range.first + (range.second - range.first) * static_cast<double>(i + 1) / static_cast<double>(n + 1);
+  }
+  return setContourLevels(levels);
+}
+
+SurfaceVertexScalarQuantity* SurfaceVertexScalarQuantity::setContoursEnabled(bool newVal) {
+  contoursEnabled = newVal;
+  requestRedraw();
+  return this;
+}
+bool SurfaceVertexScalarQuantity::getContoursEnabled() { return contoursEnabled.get(); }
+
+SurfaceVertexScalarQuantity* SurfaceVertexScalarQuantity::setContourColor(glm::vec3 newVal) {
+  contourColor = newVal;
+  requestRedraw();
+  return this;
+}
+glm::vec3 SurfaceVertexScalarQuantity::getContourColor() { return contourColor.get(); }
+
+std::vector<glm::vec3> SurfaceVertexScalarQuantity::getContourSegments(size_t iLevel) {
+  if (iLevel >= contourLevels.size()) {
+    error("contour level " + std::to_string(iLevel) + " out of range for " + name);
+    return {};
+  }
+  ensureContoursExtracted();
+  return contourLevels[iLevel].segmentPoints;
+}
+
+std::vector<std::vector<glm::vec3>> SurfaceVertexScalarQuantity::getContourPolylines(size_t iLevel) {
+  if (iLevel >= contourLevels.size()) {
+    error("contour level " + std::to_string(iLevel) + " out of range for " + name);
+    return {};
+  }
+  ensureContoursExtracted();
+  const ContourLevel& level = contourLevels[iLevel];
+  size_t nSegments = level.segmentEdges.size();
+  const size_t NONE = std::numeric_limits<size_t>::max();
+
+  // Link segment ends which lie on the same edge. Ends are numbered 2 * segment + side.
+  std::vector<std::pair<uint32_t, size_t>> endsByEdge(2 * nSegments);
+  for (size_t iS = 0; iS < nSegments; iS++) {
+    endsByEdge[2 * iS + 0] = {level.segmentEdges[iS][0], 2 * iS + 0};
+    endsByEdge[2 * iS + 1] = {level.segmentEdges[iS][1], 2 * iS + 1};
+  }
+  std::sort(endsByEdge.begin(), endsByEdge.end());
+  std::vector<size_t> link(2 * nSegments, NONE);
+  for (size_t i = 0; i + 1 < endsByEdge.size(); i++) {
+    // (on a non-manifold edge, only the first two faces are joined)
+    if (endsByEdge[i].first != endsByEdge[i + 1].first) continue;
+    if (link[endsByEdge[i].second] != NONE) continue;
+    link[endsByEdge[i].second] = endsByEdge[i + 1].second;
+    link[endsByEdge[i + 1].second] = endsByEdge[i].second;
+  }
+
+  // Walk the chains, starting from open ends so those are not split, then around the remaining loops
+  std::vector<std::vector<glm::vec3>> polylines;
+  std::vector<char> visited(nSegments, false);
+  auto walkFrom = [&](size_t startEnd) {
+    std::vector<glm::vec3> line{level.segmentPoints[startEnd]};
+    size_t end = startEnd;
+    while (true) {
+      visited[end / 2] = true;
+      size_t otherEnd = end ^ 1;
+      line.push_back(level.segmentPoints[otherEnd]);
+      size_t next = link[otherEnd];
+      if (next == NONE) break;
+      if (next == startEnd) {
+        line.back() = line.front(); // close the loop exactly
+        break;
+      }
+      if (visited[next / 2]) break;
+      end = next;
+    }
+    polylines.push_back(std::move(line));
+  };
+  for (size_t iEnd = 0; iEnd < 2 * nSegments; iEnd++) {
+    if (link[iEnd] == NONE && !visited[iEnd / 2]) walkFrom(iEnd);
+  }
+  for (size_t iS = 0; iS < nSegments; iS++) {
+    if (!visited[iS]) walkFrom(2 * iS);
+  }
+
+  return polylines;
+}
+
+void SurfaceVertexScalarQuantity::ensureContoursExtracted() {
+
+  std::vector<size_t> pending;
+  for (size_t iL = 0; iL < contourLevels.size(); iL++) {
+    if (!contourLevels[iL].valid) pending.push_back(iL);
+  }
+  if (pending.empty()) return;
+
+  ScopedCPUTimer timer(parent.profilingName(), name, "contours");
+
+  // Each block of faces extracts the segments of every pending level. Blocks are then concatenated in face order, so
+  // the result does not depend on the number of threads.
+  struct BlockSegments {
+    std::vector<std::vector<glm::vec3>> points;
+    std::vector<std::vector<std::array<uint32_t, 2>>> edges;
+  };
+  std::map<size_t, BlockSegments> blocks;
+  std::mutex blocksMutex;
+
+  parallelForBlocks(0, parent.nFaces(), [&](size_t blockStart, size_t blockEnd) {
+    BlockSegments block;
+    block.points.resize(pending.size());
+    block.edges.resize(pending.size());
+
+    std::vector<glm::vec3> crossPoints;
+    std::vector<uint32_t> crossEdges;
+    for (size_t iF = blockStart; iF < blockEnd; iF++) {
+      SurfaceMesh::IndexView face = parent.face(iF);
+      SurfaceMesh::IndexView faceEdges = parent.faceEdges(iF);
+      size_t D = face.size();
+
+      for (size_t iP = 0; iP < pending.size(); iP++) {
+        double level = contourLevels[pending[iP]].value;
+
+        // Find where the level crosses the sides of the face. A vertex exactly at the level counts as above it, so
+        // each crossing is found once from either side of its edge.
+        crossPoints.clear();
+        crossEdges.clear();
+        for (size_t j = 0; j < D; j++) {
+          size_t vA = face[j];
+          size_t vB = face[(j + 1) % D];
+          double valA = values[vA];
+          double valB = values[vB];
+          if (std::isnan(valA) || std::isnan(valB)) continue;
+          if ((valA >= level) == (valB >= level)) continue;
+          float t = static_cast<float>((level - valA) / (valB - valA));
+          crossPoints.push_back((1.f - t) * parent.vertices[vA] + t * parent.vertices[vB]);
+          crossEdges.push_back(faceEdges[j]);
+        }
+
+        // Pair them up in order around the face (a triangle has at most two)
+        for (size_t k = 0; k + 1 < crossPoints.size(); k += 2) {
+          block.points[iP].push_back(crossPoints[k]);
+          block.points[iP].push_back(crossPoints[k + 1]);
+          block.edges[iP].push_back({crossEdges[k], crossEdges[k + 1]});
+        }
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    blocks[blockStart] = std::move(block);
+  });
+
+  for (size_t iP = 0; iP < pending.size(); iP++) {
+    ContourLevel& level = contourLevels[pending[iP]];
+    level.segmentPoints.clear();
+    level.segmentEdges.clear();
+    for (std::pair<const size_t, BlockSegments>& block : blocks) {
+      level.segmentPoints.insert(level.segmentPoints.end(), block.second.points[iP].begin(),
+                                 block.second.points[iP].end());
+      level.segmentEdges.insert(level.segmentEdges.end(), block.second.edges[iP].begin(), block.second.edges[iP].end());
+    }
+    level.valid = true;
+  }
+}
+
+void SurfaceVertexScalarQuantity::createContourProgram() {
+  ensureContoursExtracted();
+
+  // All levels go in to a single batch of lines
+  std::vector<glm::vec3> positions;
+  for (const ContourLevel& level : contourLevels) {
+    positions.insert(positions.end(), level.segmentPoints.begin(), level.segmentPoints.end());
+  }
+  if (positions.empty()) return;
+  std::vector<unsigned int> inds(positions.size());
+  for (size_t i = 0; i < inds.size(); i++) {
+    inds[i] = static_cast<unsigned int>(i);
+  }
+
+  std::vector<std::string> rules = parent.addStructureRules({"SHADE_BASECOLOR"});
+  if (parent.wantsCullPosition()) {
+    rules.push_back("CYLINDER_CULLPOS_FROM_MID");
+  }
+  contourProgram = render::engine->requestShader("CURVE_LINES", rules);
+  contourProgram->setAttribute("a_position", positions);
+  contourProgram->setIndex(inds);
+  render::engine->setMaterial(*contourProgram, parent.getMaterial());
+}
+
 // ========================================================
 // ==========            Face Scalar             ==========
 // ========================================================
@@ -121,36 +438,69 @@ SurfaceFaceScalarQuantity::SurfaceFaceScalarQuantity(std::string name, const std
     : SurfaceScalarQuantity(name, mesh_, "face", values_, dataType_)
 
 {
-  hist.buildHistogram(values, parent.faceAreas); // rebuild to incorporate weights
+  hist.buildHistogramLazily([this]() { // with weights
+    parent.ensureHaveGeometryData();
+    values.buildHistogram(hist, parent.faceAreas);
+  });
 }
 
 void SurfaceFaceScalarQuantity::createProgram() {
   // Create the program to draw this quantity
-  program =
-      render::engine->requestShader("MESH", parent.addSurfaceMeshRules(addScalarRules({"MESH_PROPAGATE_VALUE"})));
+  std::string propagateRule = parent.canUseFaceTextures() ? "MESH_PROPAGATE_FACE_VALUE_TEXTURE" : "MESH_PROPAGATE_VALUE";
+  program = render::engine->requestShader("MESH", parent.addSurfaceMeshRules(addScalarRules({propagateRule})));
 
-    // Fill color buffers
-    parent.fillGeometryBuffers(*program);
-    fillColorBuffers(*program);
-    render::engine->setMaterial(*program, parent.getMaterial());
+  // Fill color buffers
+  parent.fillGeometryBuffers(*program);
+  fillColorBuffers(*program);
+  render::engine->setMaterial(*program, parent.getMaterial());
+}
+
+void SurfaceFaceScalarQuantity::releaseRenderData() {
+  faceValueTexture.reset();
+  SurfaceScalarQuantity::releaseRenderData();
+}
+
+void SurfaceFaceScalarQuantity::dataUpdated() {
+  faceValueTexture.reset(); // (made again from the new values by fillColorBuffers())
+  SurfaceScalarQuantity::dataUpdated();
+}
+
+bool SurfaceFaceScalarQuantity::topologyChanged() {
+  values.resize(parent.nFaces());
+  hist.buildHistogramLazily([this]() { values.buildHistogram(hist); });
+  releaseRenderData();
+  return true;
 }
 
 void SurfaceFaceScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
-    std::vector<double> colorval;
-    colorval.reserve(3 * parent.nFacesTriangulation());
+  p.setTextureFromColormap("t_colormap", cMap.get());
 
-    for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-      auto& face = parent.faces[iF];
-      size_t D = face.size();
-      size_t triDegree = std::max(0, static_cast<int>(D) - 2);
-      for (size_t j = 0; j < 3 * triDegree; j++) {
-        colorval.push_back(values[iF]);
+  if (p.hasTexture("t_faceValues")) {
+    if (!faceValueTexture) {
+      std::vector<float> faceValues(parent.nFaces());
+      for (size_t iF = 0; iF < parent.nFaces(); iF++) {
+        faceValues[iF] = static_cast<float>(values[iF]);
       }
+      faceValueTexture = parent.generateFaceTexture(faceValues);
     }
+    parent.setFaceTextureUniforms(p);
+    p.setTextureFromBuffer("t_faceValues", faceValueTexture.get());
+    return;
+  }
 
-    // Store data in buffers
-    p.setAttribute("a_value", colorval);
-    p.setTextureFromColormap("t_colormap", cMap.get());
+  std::vector<double> colorval;
+  colorval.reserve(3 * parent.nFacesTriangulation());
+
+  parent.forEachDrawnFace([&](size_t iF, SurfaceMesh::IndexView face) {
+    size_t D = face.size();
+    size_t triDegree = std::max(0, static_cast<int>(D) - 2);
+    for (size_t j = 0; j < 3 * triDegree; j++) {
+      colorval.push_back(values[iF]);
+    }
+  });
+
+  // Store data in buffers
+  p.setAttribute("a_value", colorval);
 }
 
 void SurfaceFaceScalarQuantity::buildFaceInfoGUI(size_t fInd) {
@@ -170,7 +520,10 @@ SurfaceEdgeScalarQuantity::SurfaceEdgeScalarQuantity(std::string name, const std
     : SurfaceScalarQuantity(name, mesh_, "edge", values_, dataType_)
 
 {
-    hist.buildHistogram(values, parent.edgeLengths); // rebuild to incorporate weights
+    hist.buildHistogramLazily([this]() { // with weights
+      parent.ensureHaveGeometryData();
+      values.buildHistogram(hist, parent.edgeLengths);
+    });
 }
 
 void SurfaceEdgeScalarQuantity::createProgram() {
@@ -190,34 +543,33 @@ void SurfaceEdgeScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
 
     // Fill buffers as usual, but at edges introduced by triangulation substitute the average value.
     // TODO this still doesn't look too great on polygon meshes... perhaps compute an average value per edge?
-    for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-      auto& face = parent.faces[iF];
+    parent.forEachDrawnFace([&](size_t iF, SurfaceMesh::IndexView face) {
       size_t D = face.size();
 
       // First, compute an average value for the face
       double avgVal = 0.0;
       for (size_t j = 0; j < D; j++) {
-        avgVal += values[parent.edgeIndices[iF][j]];
+        avgVal += values[parent.faceEdges(iF)[j]];
       }
       avgVal /= D;
 
       // implicitly triangulate from root
       for (size_t j = 1; (j + 1) < D; j++) {
 
-        glm::vec3 combinedValues = {avgVal, values[parent.edgeIndices[iF][j]], avgVal};
+        glm::vec3 combinedValues = {avgVal, values[parent.faceEdges(iF)[j]], avgVal};
 
         if (j == 1) {
-          combinedValues.x = values[parent.edgeIndices[iF][0]];
+          combinedValues.x = values[parent.faceEdges(iF)[0]];
         }
         if (j + 2 == D) {
-          combinedValues.z = values[parent.edgeIndices[iF].back()];
+          combinedValues.z = values[parent.faceEdges(iF).back()];
         }
 
         for (size_t i = 0; i < 3; i++) {
           colorval.push_back(combinedValues);
         }
       }
-    }
+    });
 
     // Store data in buffers
     p.setAttribute("a_value3", colorval);
@@ -240,17 +592,20 @@ SurfaceHalfedgeScalarQuantity::SurfaceHalfedgeScalarQuantity(std::string name, c
     : SurfaceScalarQuantity(name, mesh_, "halfedge", values_, dataType_)
 
 {
+  hist.buildHistogramLazily([this]() { // with weights
+    parent.ensureHaveGeometryData();
     std::vector<double> weightsVec(parent.nHalfedges());
     size_t iHe = 0;
     for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-      auto& face = parent.faces[iF];
+      auto face = parent.face(iF);
       size_t D = face.size();
       for (size_t j = 0; j < D; j++) {
-        weightsVec[iHe] = parent.edgeLengths[parent.edgeIndices[iF][j]];
+        weightsVec[iHe] = parent.edgeLengths[parent.faceEdges(iF)[j]];
         iHe++;
       }
     }
-    hist.buildHistogram(values, weightsVec); // rebuild to incorporate weights
+    values.buildHistogram(hist, weightsVec);
+  });
 }
 
 void SurfaceHalfedgeScalarQuantity::createProgram() {
@@ -270,10 +625,9 @@ void SurfaceHalfedgeScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
 
     // Fill buffers as usual, but at edges introduced by triangulation substitute the average value.
     // TODO this still doesn't look too great on polygon meshes... perhaps compute an average value per edge?
-    size_t iHe = 0;
-    for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-      auto& face = parent.faces[iF];
+    parent.forEachDrawnFace([&](size_t iF, SurfaceMesh::IndexView face) {
       size_t D = face.size();
+      size_t iHe = parent.halfedgeIndex(iF, 0);
 
       // First, compute an average value for the face
       double avgVal = 0.0;
@@ -303,7 +657,7 @@ void SurfaceHalfedgeScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
           colorval.push_back(combinedValues);
         }
       }
-    }
+    });
 
 
     // Store data in buffers
@@ -318,4 +672,6 @@ void SurfaceHalfedgeScalarQuantity::buildHalfedgeInfoGUI(size_t heInd) {
     ImGui::NextColumn();
 }
 
+size_t SurfaceScalarQuantity::hostMemoryUsage() { return values.allocatedBytes(); }
+
 } // namespace polyscope
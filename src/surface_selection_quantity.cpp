@@ -1,519 +1,374 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/surface_selection_quantity.h"
 
-#include "polyscope/gl/shaders.h"
-#include "polyscope/gl/shaders/surface_shaders.h"
 #include "polyscope/pick.h"
 #include "polyscope/polyscope.h"
+#include "polyscope/render/engine.h"
 
 #include "imgui.h"
 
-namespace polyscope {
+#include <algorithm>
+#include <cmath>
 
-using std::cout;
-using std::endl;
+namespace polyscope {
 
-SurfaceSelectionQuantity::SurfaceSelectionQuantity(std::string name, SurfaceMesh* mesh_, std::string definedOn_)
-    : SurfaceQuantityThatDrawsFaces(name, mesh_), definedOn(definedOn_) {
-  iColorMap = gl::getColormapIndex_all("blues");
+SurfaceSelectionQuantity::SurfaceSelectionQuantity(std::string name, SurfaceMesh& mesh_, std::string definedOn_,
+                                                   const std::vector<char>& initialMembership)
+    : SurfaceMeshQuantity(name, mesh_, true), definedOn(definedOn_), membership(initialMembership),
+      brushRadius(uniquePrefix() + "#brushRadius", 20.), cMap(uniquePrefix() + "#cmap", "blues") {
+  clearChanged();
 }
 
-void SurfaceSelectionQuantity::draw() {}
+void SurfaceSelectionQuantity::draw() {
+  if (!isEnabled()) return;
+
+  if (program == nullptr) {
+    createProgram();
+  } else {
+    uploadChangedMembership();
+  }
+
+  // Set uniforms
+  parent.setStructureUniforms(*program);
+  parent.setSurfaceMeshUniforms(*program);
+  program->setUniform("u_rangeLow", 0.f);
+  program->setUniform("u_rangeHigh", 1.f);
 
+  program->draw();
+}
 
-void SurfaceSelectionQuantity::drawUI() {
-  bool enabledBefore = enabled;
-  if (ImGui::TreeNode((name + " (" + definedOn + " selection)").c_str())) {
-    ImGui::Checkbox("Enabled", &enabled);
+void SurfaceSelectionQuantity::buildCustomUI() {
+  ImGui::SameLine();
 
-    { // Set colormap
+  if (render::buildColormapSelector(cMap.get())) {
+    cMap.manuallyChanged();
+    setColorMap(cMap.get());
+  }
+
+  if (allowEditingFromDefaultUI) {
+    ImGui::Checkbox("Paint", &painting);
+    if (painting) {
       ImGui::SameLine();
       ImGui::PushItemWidth(100);
-      int iColormapBefore = iColorMap;
-      ImGui::Combo("##colormap", &iColorMap, gl::allColormapNames, IM_ARRAYSIZE(gl::allColormapNames));
+      ImGui::Combo("##action", &mouseMemberAction, "select\0deselect\0\0");
       ImGui::PopItemWidth();
-      if (iColorMap != iColormapBefore) {
-        parent->deleteProgram();
-      }
-    }
 
-    if (allowEditingFromDefaultUI) {
-      if (ImGui::Button("Edit")) {
-        userEdit();
+      ImGui::PushItemWidth(150);
+      if (ImGui::SliderFloat("Brush radius", &brushRadius.get(), 1., 200., "%.0f px")) {
+        brushRadius.manuallyChanged();
       }
-    }
+      ImGui::PopItemWidth();
+      ImGui::TextUnformatted("ctrl-drag over the mesh to paint");
 
-    ImGui::TreePop();
-  }
+      processBrushInput();
+    }
 
-  // Enforce exclusivity of enabled surface quantities
-  if (!enabledBefore && enabled) {
-    parent->setActiveSurfaceQuantity(this);
-  }
-  if (enabledBefore && !enabled) {
-    parent->clearActiveSurfaceQuantity();
+    if (ImGui::Button("Select all")) {
+      selectAll();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Select none")) {
+      selectNone();
+    }
   }
 }
 
-
-// ========================================================
-// ==========           Vertex Selection         ==========
-// ========================================================
-
-SurfaceSelectionVertexQuantity::SurfaceSelectionVertexQuantity(std::string name, std::vector<char>& initialMembership_,
-                                                               SurfaceMesh* mesh_)
-    : SurfaceSelectionQuantity(name, mesh_, "vertex"), membership(initialMembership_)
-
-{
-  membership.resize(parent->nVertices());
+void SurfaceSelectionQuantity::processBrushInput() {
+  // Paint if the ctrl key is held, the mouse is pressed, and the mouse isn't on an ImGui window
+  ImGuiIO& io = ImGui::GetIO();
+  if (io.KeyCtrl && !io.WantCaptureMouse && ImGui::IsMouseDown(0)) {
+    ImVec2 p = ImGui::GetMousePos();
+    applyBrush(glm::vec2{io.DisplayFramebufferScale.x * p.x, io.DisplayFramebufferScale.y * p.y},
+               mouseMemberAction == 0);
+  }
 }
 
-SurfaceSelectionVertexQuantity::SurfaceSelectionVertexQuantity(std::string name, SurfaceMesh* mesh_)
-    : SurfaceSelectionQuantity(name, mesh_, "vertex")
-
-{
-  membership = std::vector<char>(parent->nVertices(), false);
+void SurfaceSelectionQuantity::refresh() {
+  program.reset();
+  membershipTexture.reset();
+  Quantity::refresh();
 }
 
-gl::GLProgram* SurfaceSelectionVertexQuantity::createProgram() {
-  // Create the program to draw this quantity
-  gl::GLProgram* program =
-      new gl::GLProgram(&VERTBINARY_SURFACE_VERT_SHADER, &VERTBINARY_SURFACE_FRAG_SHADER, gl::DrawMode::Triangles);
+std::string SurfaceSelectionQuantity::niceName() { return name + " (" + definedOn + " selection)"; }
 
-  // Fill color buffers
-  fillColorBuffers(program);
+size_t SurfaceSelectionQuantity::hostMemoryUsage() { return allocatedBytes(membership); }
 
-  return program;
+void SurfaceSelectionQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  // membership does not depend on positions, and the geometry comes from the parent's shared buffers
+  requestRedraw();
 }
 
-
-void SurfaceSelectionVertexQuantity::fillColorBuffers(gl::GLProgram* p) {
-  std::vector<double> colorval;
-  colorval.reserve(3 * parent->nTriangulationFaces());
-
-  for (HalfedgeMesh::Face& face : parent->triMesh.faces) {
-
-    HalfedgeMesh::Halfedge* currHe = &face.halfedge();
-    for (size_t i = 0; i < 3; i++) {
-      size_t vInd = currHe->vertex().index();
-      if (membership[vInd]) {
-        colorval.push_back(1.0);
-      } else {
-        colorval.push_back(0.0);
-      }
-    }
-  }
-
-  membershipStale = false;
-
-  // Store data in buffers
-  p->setAttribute("a_colorval", colorval);
-  p->setTextureFromColormap("t_colormap", *gl::allColormaps[iColorMap]);
+void SurfaceSelectionQuantity::setSelected(size_t ind, bool selected) {
+  if (isSelected(ind) == selected) return;
+  membership[ind] = selected;
+  markChanged(ind, ind + 1);
+  requestRedraw();
 }
 
-void SurfaceSelectionVertexQuantity::setProgramValues(gl::GLProgram* program) {
-
-  // Update membership buffer, if needed
-  if (membershipStale) {
-
-    std::vector<double> colorval;
-    colorval.reserve(3 * parent->nTriangulationFaces());
-
-    for (HalfedgeMesh::Face& face : parent->triMesh.faces) {
-
-      HalfedgeMesh::Halfedge* currHe = &face.halfedge();
-      for (size_t i = 0; i < 3; i++) {
-        size_t vInd = currHe->vertex().index();
-        if (membership[vInd]) {
-          colorval.push_back(1.0);
-        } else {
-          colorval.push_back(0.0);
-        }
-      }
-    }
-
-    program->setAttribute("a_colorval", colorval, true); // update buffer
-
-    membershipStale = false;
+void SurfaceSelectionQuantity::setMembership(const std::vector<char>& newMembership) {
+  if (newMembership.size() != membership.size()) {
+    error("membership for " + niceName() + " has " + std::to_string(newMembership.size()) + " entries, expected " +
+          std::to_string(membership.size()));
+    return;
   }
+  membership = newMembership;
+  markChanged(0, membership.size());
+  requestRedraw();
 }
 
-void SurfaceSelectionVertexQuantity::userEdit() {
-
-  // Make sure we can see what we're editing
-  enabled = true;
-  parent->setActiveSurfaceQuantity(this);
-
-  // Create a new context
-  bool oldAlwaysPick = pick::alwaysEvaluatePick;
-  pick::alwaysEvaluatePick = true;
-
-  // Register the callback which creates the UI and does the hard work
-  auto focusedPopupUI = std::bind(&SurfaceSelectionVertexQuantity::userEditCallback, this);
-  pushContext(focusedPopupUI);
-
-  // Restore the old state
-  pick::alwaysEvaluatePick = oldAlwaysPick;
+void SurfaceSelectionQuantity::selectAll() {
+  std::fill(membership.begin(), membership.end(), 1);
+  markChanged(0, membership.size());
+  requestRedraw();
 }
 
-void SurfaceSelectionVertexQuantity::userEditCallback() {
-
-  static bool showWindow = true;
-  ImGui::Begin("Edit Vertex Selection", &showWindow);
-
-  // Toggle what mouse does
-  ImGui::Combo("with click", &mouseMemberAction, "add\0subtract\0\0");
+void SurfaceSelectionQuantity::selectNone() {
+  std::fill(membership.begin(), membership.end(), 0);
+  markChanged(0, membership.size());
+  requestRedraw();
+}
 
-  // Process mouse selection if the ctrl key is held, the mouse is pressed, and the mouse isn't on the ImGui window
-  ImGuiIO& io = ImGui::GetIO();
-  if (io.KeyCtrl && !io.WantCaptureMouse && ImGui::IsMouseDown(0)) {
-    // ImVec2 p = ImGui::GetMousePos();
-    // io.DisplayFramebufferScale.x * p.x, io.DisplayFramebufferScale.y * p.y);
-
-    // Check if the pick landed on a mesh element
-    size_t localInd;
-    Structure* pickedStruc = pick::getCurrentPickElement(localInd);
-    if (pickedStruc == parent) {
-
-      // TODO re-implement me
-
-      // Find the nearest vertex (in screen space) to the selected element
-      /*
-      std::vector<VertexPtr> candidateVertices;
-      VertexPtr vOut;
-      FacePtr fOut;
-      EdgePtr eOut;
-      HalfedgePtr heOut;
-      parent->getPickedElement(localInd, vOut, fOut, eOut, heOut);
-
-      if (vOut != VertexPtr()) {
-        candidateVertices.push_back(vOut);
-      }
-      if (fOut != FacePtr()) {
-        for (VertexPtr v : fOut.adjacentVertices()) {
-          candidateVertices.push_back(v);
-        }
-      }
-      if (eOut != EdgePtr()) {
-        candidateVertices.push_back(eOut.halfedge().vertex());
-        candidateVertices.push_back(eOut.halfedge().twin().vertex());
-      }
-      if (heOut != HalfedgePtr()) {
-        candidateVertices.push_back(heOut.vertex());
-        candidateVertices.push_back(heOut.twin().vertex());
-      }
+size_t SurfaceSelectionQuantity::applyBrush(glm::vec2 screenCoords, bool select) {
 
-      for (VertexPtr v : candidateVertices) {
-        membership[v] = mouseMemberAction == 0;
-        membershipStale = true;
-      }
-      */
-    }
+  // The brush, as a polygon for the region query
+  const size_t nSides = 24;
+  const float PI = 3.14159265358979323846f;
+  float radius = brushRadius.get();
+  std::vector<glm::vec2> brush(nSides);
+  for (size_t i = 0; i < nSides; i++) {
+    float angle = 2.f * PI * i / nSides;
+    brush[i] = screenCoords + radius * glm::vec2{std::cos(angle), std::sin(angle)};
   }
 
+  std::map<Structure*, std::vector<size_t>> hits = pick::queryRegion(brush);
+  auto it = hits.find(&parent);
+  if (it == hits.end()) return 0;
 
-  // Grow the selection
-  if (ImGui::Button("Grow selection")) {
-    std::vector<char> newMembership(parent->nVertices(), false);
-    for (HalfedgeMesh::Vertex& vert : parent->mesh.vertices) {
-      if (membership[vert.index()]) {
-        newMembership[vert.index()] = true;
+  std::vector<size_t> elements;
+  elementsFromPick(it->second, elements);
 
-        HalfedgeMesh::Halfedge* currHe = &vert.halfedge();
-        HalfedgeMesh::Halfedge* firstHe = &vert.halfedge();
-        do {
-          newMembership[currHe->twin().vertex().index()] = true;
-          currHe = &currHe->twin().next();
-        } while (currHe != firstHe);
-      }
+  size_t nChanged = 0;
+  for (size_t i : elements) {
+    if (isSelected(i) != select) {
+      membership[i] = select;
+      markChanged(i, i + 1);
+      nChanged++;
     }
-    membership = newMembership;
-    membershipStale = true;
   }
+  if (nChanged > 0) requestRedraw();
+  return nChanged;
+}
 
+std::vector<char> SurfaceSelectionQuantity::getMembershipData() {
+  const std::vector<size_t>& perm = definedOn == "vertex" ? parent.vertexPerm : parent.facePerm;
+  if (perm.empty()) return membership;
 
-  // Shrink the selection
-  if (ImGui::Button("Shrink selection")) {
-    std::vector<char> newMembership(parent->nVertices(), true);
-    for (HalfedgeMesh::Vertex& vert : parent->mesh.vertices) {
-      if (membership[vert.index()]) {
-        newMembership[vert.index()] = false;
+  size_t dataSize = definedOn == "vertex" ? parent.vertexDataSize : parent.faceDataSize;
+  std::vector<char> data(dataSize, 0);
+  for (size_t i = 0; i < perm.size(); i++) {
+    data[perm[i]] = membership[i];
+  }
+  return data;
+}
 
-        HalfedgeMesh::Halfedge* currHe = &vert.halfedge();
-        HalfedgeMesh::Halfedge* firstHe = &vert.halfedge();
-        do {
-          newMembership[currHe->twin().vertex().index()] = false;
-          currHe = &currHe->twin().next();
-        } while (currHe != firstHe);
-      }
+render::TextureBuffer& SurfaceSelectionQuantity::generateMembershipTexture() {
+  if (!membershipTexture) {
+    std::vector<float> values(membership.size());
+    for (size_t i = 0; i < membership.size(); i++) {
+      values[i] = membership[i] ? 1.f : 0.f;
     }
-    membership = newMembership;
-    membershipStale = true;
+    membershipTexture = render::engine->generateElementTexture(values);
   }
+  return *membershipTexture;
+}
 
-  // Select all
-  if (ImGui::Button("Select all")) {
-    std::fill(membership.begin(), membership.end(), true);
-    membershipStale = true;
-  }
+void SurfaceSelectionQuantity::uploadChangedMembership() {
+  if (changedBegin >= changedEnd) return;
 
-  // Select none
-  ImGui::SameLine();
-  if (ImGui::Button("Select none")) {
-    std::fill(membership.begin(), membership.end(), false);
-    membershipStale = true;
+  if (!membershipTexture) {
+    fillMembershipCornerValues(*program, true);
+    clearChanged();
+    return;
   }
 
-
-  // Stop editing
-  // (style makes yellow button)
-  ImGui::Spacing();
-  ImGui::Spacing();
-  ImGui::Spacing();
-  ImGui::PushStyleColor(ImGuiCol_Button, (ImVec4)ImColor::HSV(1. / 7.0f, 0.6f, 0.6f));
-  ImGui::PushStyleColor(ImGuiCol_ButtonHovered, (ImVec4)ImColor::HSV(1. / 7.0f, 0.7f, 0.7f));
-  ImGui::PushStyleColor(ImGuiCol_ButtonActive, (ImVec4)ImColor::HSV(1. / 7.0f, 0.8f, 0.8f));
-  if (ImGui::Button("Done")) {
-    popContext();
-    membershipStale = true;
+  // Rewrite just the texture rows holding the changed elements
+  size_t rowWidth = membershipTexture->getSizeX();
+  size_t rowStart = changedBegin / rowWidth;
+  size_t rowEnd = (changedEnd + rowWidth - 1) / rowWidth;
+  std::vector<float> rows((rowEnd - rowStart) * rowWidth, 0.f);
+  size_t iStart = rowStart * rowWidth;
+  size_t iEnd = std::min(rowEnd * rowWidth, membership.size());
+  for (size_t i = iStart; i < iEnd; i++) {
+    rows[i - iStart] = membership[i] ? 1.f : 0.f;
   }
-  ImGui::PopStyleColor(3);
-
-  ImGui::End();
-} // namespace polyscope
-
-void SurfaceSelectionVertexQuantity::buildVertexInfoGUI(size_t vInd) {
-  ImGui::TextUnformatted(name.c_str());
-  ImGui::NextColumn();
-  ImGui::Text("%s", membership[vInd] ? "true" : "false");
-  ImGui::NextColumn();
+  membershipTexture->setDataRows(static_cast<unsigned int>(rowStart), static_cast<unsigned int>(rowEnd - rowStart),
+                                 rows.data());
+  clearChanged();
 }
 
-
-/*
-// ========================================================
-// ==========            Face Selection          ==========
-// ========================================================
-
-SurfaceSelectionFaceQuantity::SurfaceSelectionFaceQuantity(std::string name, FaceData<double>& values_, SurfaceMesh*
-mesh_,
-                                                     DataType dataType_)
-    : SurfaceSelectionQuantity(name, mesh_, "face", dataType_)
-
-{
-  values = parent->transfer.transfer(values_);
-
-  std::vector<double> valsVec;
-  std::vector<double> weightsVec;
-  for (FacePtr f : parent->mesh->faces()) {
-    valsVec.push_back(values[f]);
-    weightsVec.push_back(parent->geometry->area(f));
-  }
-
-  hist.updateColormap(gl::allColormaps[iColorMap]);
-  hist.buildHistogram(valsVec, weightsVec);
-
-  std::tie(dataRangeLow, dataRangeHigh) = robustMinMax(valsVec, 1e-5);
-  resetVizRange();
+void SurfaceSelectionQuantity::markChanged(size_t begin, size_t end) {
+  changedBegin = std::min(changedBegin, begin);
+  changedEnd = std::max(changedEnd, end);
 }
 
-gl::GLProgram* SurfaceSelectionFaceQuantity::createProgram() {
-  // Create the program to draw this quantity
-  gl::GLProgram* program =
-      new gl::GLProgram(&VERTCOLOR_SURFACE_VERT_SHADER, &VERTCOLOR_SURFACE_FRAG_SHADER, gl::DrawMode::Triangles);
-
-  // Fill color buffers
-  fillColorBuffers(program);
-
-  return program;
+void SurfaceSelectionQuantity::clearChanged() {
+  changedBegin = INVALID_IND;
+  changedEnd = 0;
 }
 
-void SurfaceSelectionFaceQuantity::fillColorBuffers(gl::GLProgram* p) {
-  std::vector<double> colorval;
-  for (FacePtr f : parent->mesh->faces()) {
-    // Implicitly triangulate
-    double c0, c1;
-    size_t iP = 0;
-    for (VertexPtr v : f.adjacentVertices()) {
-      double c2 = values[f];
-      if (iP >= 2) {
-        colorval.push_back(c0);
-        colorval.push_back(c1);
-        colorval.push_back(c2);
-      }
-      c0 = c1;
-      c1 = c2;
-      iP++;
-    }
-  }
-
-  // Store data in buffers
-  p->setAttribute("a_colorval", colorval);
-  p->setTextureFromColormap("t_colormap", *gl::allColormaps[iColorMap]);
+SurfaceSelectionQuantity* SurfaceSelectionQuantity::setBrushRadius(float pixels) {
+  brushRadius = pixels;
+  return this;
 }
+float SurfaceSelectionQuantity::getBrushRadius() { return brushRadius.get(); }
 
-void SurfaceSelectionFaceQuantity::buildInfoGUI(FacePtr f) {
-  ImGui::TextUnformatted(name.c_str());
-  ImGui::NextColumn();
-  ImGui::Text("%g", values[f]);
-  ImGui::NextColumn();
+SurfaceSelectionQuantity* SurfaceSelectionQuantity::setColorMap(std::string val) {
+  cMap = val;
+  if (program) program->setTextureFromColormap("t_colormap", cMap.get(), true);
+  requestRedraw();
+  return this;
 }
+std::string SurfaceSelectionQuantity::getColorMap() { return cMap.get(); }
 
 
 // ========================================================
-// ==========            Edge Selection          ==========
+// ==========           Vertex Selection         ==========
 // ========================================================
 
-SurfaceSelectionEdgeQuantity::SurfaceSelectionEdgeQuantity(std::string name, EdgeData<double>& values_, SurfaceMesh*
-mesh_,
-                                                     DataType dataType_)
-    : SurfaceSelectionQuantity(name, mesh_, "edge", dataType_)
+SurfaceVertexSelectionQuantity::SurfaceVertexSelectionQuantity(std::string name,
+                                                               const std::vector<char>& initialMembership,
+                                                               SurfaceMesh& mesh_)
+    : SurfaceSelectionQuantity(name, mesh_, "vertex", initialMembership) {}
+
+void SurfaceVertexSelectionQuantity::createProgram() {
+  // Vertex indices are stored as floats in a_vertexInd, which is only exact up to 2^24
+  const size_t maxExactIndex = static_cast<size_t>(1) << 24;
+  std::string propagateRule =
+      parent.nVertices() <= maxExactIndex ? "MESH_PROPAGATE_VERTEX_VALUE_TEXTURE" : "MESH_PROPAGATE_VALUE";
+  program = render::engine->requestShader("MESH", parent.addSurfaceMeshRules({propagateRule, "SHADE_COLORMAP_VALUE"}));
+
+  // Fill buffers
+  parent.fillGeometryBuffers(*program);
+  fillMembershipBuffers(*program);
+  render::engine->setMaterial(*program, parent.getMaterial());
+}
 
-{
-  values = parent->transfer.transfer(values_);
+void SurfaceVertexSelectionQuantity::fillMembershipBuffers(render::ShaderProgram& p) {
+  p.setTextureFromColormap("t_colormap", getColorMap());
+  clearChanged();
 
-  std::vector<double> valsVec;
-  std::vector<double> weightsVec;
-  for (EdgePtr e : parent->mesh->edges()) {
-    valsVec.push_back(values[e]);
-    weightsVec.push_back(parent->geometry->length(e));
+  if (!p.hasTexture("t_vertexValues")) {
+    fillMembershipCornerValues(p, false);
+    return;
   }
 
-  hist.updateColormap(gl::allColormaps[iColorMap]);
-  hist.buildHistogram(valsVec, weightsVec);
-
-  std::tie(dataRangeLow, dataRangeHigh) = robustMinMax(valsVec, 1e-5);
-  resetVizRange();
+  std::vector<float> vertexInds;
+  vertexInds.reserve(3 * parent.nFacesTriangulation());
+  parent.forEachDrawnFace([&](size_t, SurfaceMesh::IndexView face) {
+    // implicitly triangulate from root
+    for (size_t j = 1; (j + 1) < face.size(); j++) {
+      vertexInds.push_back(static_cast<float>(face[0]));
+      vertexInds.push_back(static_cast<float>(face[j]));
+      vertexInds.push_back(static_cast<float>(face[j + 1]));
+    }
+  });
+  p.setAttribute("a_vertexInd", vertexInds);
+  p.setTextureFromBuffer("t_vertexValues", &generateMembershipTexture());
 }
 
-gl::GLProgram* SurfaceSelectionEdgeQuantity::createProgram() {
-  // Create the program to draw this quantity
-  gl::GLProgram* program = new gl::GLProgram(&HALFEDGECOLOR_SURFACE_VERT_SHADER, &HALFEDGECOLOR_SURFACE_FRAG_SHADER,
-                                             gl::DrawMode::Triangles);
-
-  // Fill color buffers
-  fillColorBuffers(program);
-
-  return program;
+void SurfaceVertexSelectionQuantity::fillMembershipCornerValues(render::ShaderProgram& p, bool update) {
+  std::vector<float> colorval;
+  colorval.reserve(3 * parent.nFacesTriangulation());
+  parent.forEachDrawnFace([&](size_t, SurfaceMesh::IndexView face) {
+    for (size_t j = 1; (j + 1) < face.size(); j++) {
+      for (size_t v : {face[0], face[j], face[j + 1]}) {
+        colorval.push_back(membership[v] ? 1.f : 0.f);
+      }
+    }
+  });
+  p.setAttribute("a_value", colorval, update);
 }
 
-void SurfaceSelectionEdgeQuantity::fillColorBuffers(gl::GLProgram* p) {
-  std::vector<Vector3> colorval;
-  for (FacePtr f : parent->mesh->faces()) {
-    // Implicitly triangulate
-    double c0, c1;
-    size_t iP = 0;
-    for (HalfedgePtr he : f.adjacentHalfedges()) {
-      VertexPtr v = he.vertex();
-      double c2 = values[he.next().edge()];
-      if (iP >= 2) {
-        colorval.push_back(Vector3{c0, c1, c2});
-        colorval.push_back(Vector3{c0, c1, c2});
-        colorval.push_back(Vector3{c0, c1, c2});
-      }
-      if (iP > 2) {
-        error("Edge quantities not correct for non-triangular meshes");
+void SurfaceVertexSelectionQuantity::elementsFromPick(const std::vector<size_t>& pickInds,
+                                                      std::vector<size_t>& elements) {
+  // vertices under the brush, and those of the faces under it
+  for (size_t pickInd : pickInds) {
+    std::pair<MeshElement, size_t> element = parent.pickIndexToElement(pickInd);
+    if (element.first == MeshElement::VERTEX) {
+      elements.push_back(element.second);
+    } else if (element.first == MeshElement::FACE) {
+      for (uint32_t v : parent.face(element.second)) {
+        elements.push_back(v);
       }
-      c0 = c1;
-      c1 = c2;
-      iP++;
     }
   }
-
-  // Store data in buffers
-  p->setAttribute("a_colorvals", colorval);
-  p->setTextureFromColormap("t_colormap", *gl::allColormaps[iColorMap]);
 }
 
-void SurfaceSelectionEdgeQuantity::buildInfoGUI(EdgePtr e) {
+void SurfaceVertexSelectionQuantity::buildVertexInfoGUI(size_t vInd) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
-  ImGui::Text("%g", values[e]);
+  ImGui::TextUnformatted(isSelected(vInd) ? "true" : "false");
   ImGui::NextColumn();
 }
 
+
 // ========================================================
-// ==========          Halfedge Selection        ==========
+// ==========            Face Selection          ==========
 // ========================================================
 
-SurfaceSelectionHalfedgeQuantity::SurfaceSelectionHalfedgeQuantity(std::string name, HalfedgeData<double>& values_,
-                                                             SurfaceMesh* mesh_, DataType dataType_)
-    : SurfaceSelectionQuantity(name, mesh_, "halfedge", dataType_)
+SurfaceFaceSelectionQuantity::SurfaceFaceSelectionQuantity(std::string name,
+                                                           const std::vector<char>& initialMembership,
+                                                           SurfaceMesh& mesh_)
+    : SurfaceSelectionQuantity(name, mesh_, "face", initialMembership) {}
 
-{
-  values = parent->transfer.transfer(values_);
-
-  std::vector<double> valsVec;
-  std::vector<double> weightsVec;
-  for (HalfedgePtr he : parent->mesh->halfedges()) {
-    valsVec.push_back(values[he]);
-    weightsVec.push_back(parent->geometry->length(he.edge()));
-  }
+void SurfaceFaceSelectionQuantity::createProgram() {
+  std::string propagateRule = parent.canUseFaceTextures() ? "MESH_PROPAGATE_FACE_VALUE_TEXTURE" : "MESH_PROPAGATE_VALUE";
+  program = render::engine->requestShader("MESH", parent.addSurfaceMeshRules({propagateRule, "SHADE_COLORMAP_VALUE"}));
 
-  hist.updateColormap(gl::allColormaps[iColorMap]);
-  hist.buildHistogram(valsVec, weightsVec);
-
-  std::tie(dataRangeLow, dataRangeHigh) = robustMinMax(valsVec, 1e-5);
-  resetVizRange();
+  // Fill buffers
+  parent.fillGeometryBuffers(*program);
+  fillMembershipBuffers(*program);
+  render::engine->setMaterial(*program, parent.getMaterial());
 }
 
-gl::GLProgram* SurfaceSelectionHalfedgeQuantity::createProgram() {
-  // Create the program to draw this quantity
-  gl::GLProgram* program = new gl::GLProgram(&HALFEDGECOLOR_SURFACE_VERT_SHADER, &HALFEDGECOLOR_SURFACE_FRAG_SHADER,
-                                             gl::DrawMode::Triangles);
-
-￼
-Prof. Ian H. Jermyn (Durham University, UK)
-
-￼
-Prof. Jonathan Manton (University of Melbourne, Australia)
+void SurfaceFaceSelectionQuantity::fillMembershipBuffers(render::ShaderProgram& p) {
+  p.setTextureFromColormap("t_colormap", getColorMap());
+  clearChanged();
 
-￼
-Prof. Stefano Soatto (UCLA)
-
-￼
+  if (!p.hasTexture("t_faceValues")) {
+    fillMembershipCornerValues(p, false);
+    return;
+  }
 
-  // Fill color buffers
-  fillColorBuffers(program);
+  parent.setFaceTextureUniforms(p);
+  p.setTextureFromBuffer("t_faceValues", &generateMembershipTexture());
+}
 
-  return program;
+void SurfaceFaceSelectionQuantity::fillMembershipCornerValues(render::ShaderProgram& p, bool update) {
+  std::vector<float> colorval;
+  colorval.reserve(3 * parent.nFacesTriangulation());
+  parent.forEachDrawnFace([&](size_t iF, SurfaceMesh::IndexView face) {
+    size_t triDegree = face.size() < 3 ? 0 : face.size() - 2;
+    colorval.insert(colorval.end(), 3 * triDegree, membership[iF] ? 1.f : 0.f);
+  });
+  p.setAttribute("a_value", colorval, update);
 }
 
-void SurfaceSelectionHalfedgeQuantity::fillColorBuffers(gl::GLProgram* p) {
-  std::vector<Vector3> colorval;
-  for (FacePtr f : parent->mesh->faces()) {
-    // Implicitly triangulate
-    double c0, c1;
-    size_t iP = 0;
-    for (HalfedgePtr he : f.adjacentHalfedges()) {
-      VertexPtr v = he.vertex();
-      double c2 = values[he.next()];
-      if (iP >= 2) {
-        colorval.push_back(Vector3{c0, c1, c2});
-        colorval.push_back(Vector3{c0, c1, c2});
-        colorval.push_back(Vector3{c0, c1, c2});
-      }
-      if (iP > 2) {
-        error("Edge quantities not correct for non-triangular meshes");
-      }
-      c0 = c1;
-      c1 = c2;
-      iP++;
+void SurfaceFaceSelectionQuantity::elementsFromPick(const std::vector<size_t>& pickInds,
+                                                    std::vector<size_t>& elements) {
+  for (size_t pickInd : pickInds) {
+    std::pair<MeshElement, size_t> element = parent.pickIndexToElement(pickInd);
+    if (element.first == MeshElement::FACE) {
+      elements.push_back(element.second);
     }
   }
-
-  // Store data in buffers
-  p->setAttribute("a_colorvals", colorval);
-  p->setTextureFromColormap("t_colormap", *gl::allColormaps[iColorMap]);
 }
 
-void SurfaceSelectionHalfedgeQuantity::buildInfoGUI(HalfedgePtr he) {
+void SurfaceFaceSelectionQuantity::buildFaceInfoGUI(size_t fInd) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
-  ImGui::Text("%g", values[he]);
+  ImGui::TextUnformatted(isSelected(fInd) ? "true" : "false");
   ImGui::NextColumn();
 }
 
-*/
-
 } // namespace polyscope
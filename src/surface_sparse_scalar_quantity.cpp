@@ -0,0 +1,192 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/surface_sparse_scalar_quantity.h"
+
+#include "polyscope/polyscope.h"
+#include "polyscope/render/engine.h"
+
+#include "imgui.h"
+
+#include <limits>
+
+namespace polyscope {
+
+SurfaceSparseScalarQuantity::SurfaceSparseScalarQuantity(std::string name, SurfaceMesh& mesh_, std::string definedOn_,
+                                                         SparseElementSet elements_,
+                                                         const std::vector<double>& values_, DataType dataType_)
+    : SurfaceScalarQuantity(name, mesh_, definedOn_, values_, dataType_), elements(std::move(elements_)) {}
+
+void SurfaceSparseScalarQuantity::draw() {
+  if (!isEnabled()) return;
+
+  if (program == nullptr) {
+    createProgram();
+  }
+
+  // Set uniforms
+  parent.setStructureUniforms(*program);
+  parent.setSurfaceMeshUniforms(*program);
+  setScalarUniforms(*program);
+  program->setUniform("u_absentColor", parent.getSurfaceColor());
+
+  program->draw();
+}
+
+size_t SurfaceSparseScalarQuantity::hostMemoryUsage() {
+  return SurfaceScalarQuantity::hostMemoryUsage() + elements.allocatedBytes();
+}
+
+std::string SurfaceSparseScalarQuantity::niceName() { return name + " (sparse " + definedOn + " scalar)"; }
+
+void SurfaceSparseScalarQuantity::releaseRenderData() {
+  presenceTexture.reset();
+  valueTexture.reset();
+  SurfaceScalarQuantity::releaseRenderData();
+}
+
+void SurfaceSparseScalarQuantity::dataUpdated() {
+  valueTexture.reset();
+  if (program && program->hasTexture("t_sparseValues")) {
+    setSparseTextures(*program); // (the elements are the same, so only the values are uploaded again)
+    return;
+  }
+  SurfaceScalarQuantity::dataUpdated();
+}
+
+double SurfaceSparseScalarQuantity::getValue(size_t ind) const {
+  size_t i = elements.find(ind);
+  if (i == INVALID_IND) return std::numeric_limits<double>::quiet_NaN();
+  return values[i];
+}
+
+void SurfaceSparseScalarQuantity::setSparseTextures(render::ShaderProgram& p) {
+  if (!presenceTexture) {
+    presenceTexture = elements.generatePresenceTexture();
+  }
+  if (!valueTexture) {
+    std::vector<float> setValues(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+      setValues[i] = static_cast<float>(values[i]);
+    }
+    valueTexture = render::engine->generateElementTexture(setValues);
+  }
+  p.setTextureFromBuffer("t_sparsePresence", presenceTexture.get());
+  p.setTextureFromBuffer("t_sparseValues", valueTexture.get());
+}
+
+void SurfaceSparseScalarQuantity::fillSparseCornerValues(render::ShaderProgram& p,
+                                                         const std::vector<size_t>& cornerElements) {
+  std::vector<float> cornerValues(cornerElements.size(), 0.f);
+  std::vector<float> cornerPresence(cornerElements.size(), 0.f);
+  for (size_t iC = 0; iC < cornerElements.size(); iC++) {
+    size_t i = elements.find(cornerElements[iC]);
+    if (i == INVALID_IND) continue;
+    cornerValues[iC] = static_cast<float>(values[i]);
+    cornerPresence[iC] = 1.f;
+  }
+  p.setAttribute("a_value", cornerValues);
+  p.setAttribute("a_valuePresence", cornerPresence);
+}
+
+void SurfaceSparseScalarQuantity::buildValueInfoGUI(size_t ind) {
+  ImGui::TextUnformatted(name.c_str());
+  ImGui::NextColumn();
+  size_t i = elements.find(ind);
+  if (i == INVALID_IND) {
+    ImGui::TextUnformatted("-");
+  } else {
+    ImGui::Text("%g", values[i]);
+  }
+  ImGui::NextColumn();
+}
+
+// ========================================================
+// ==========         Sparse Vertex Scalar       ==========
+// ========================================================
+
+SurfaceVertexSparseScalarQuantity::SurfaceVertexSparseScalarQuantity(std::string name, SparseElementSet elements_,
+                                                                     const std::vector<double>& values_,
+                                                                     SurfaceMesh& mesh_, DataType dataType_)
+    : SurfaceSparseScalarQuantity(name, mesh_, "vertex", std::move(elements_), values_, dataType_) {}
+
+void SurfaceVertexSparseScalarQuantity::createProgram() {
+  // Vertex indices are stored as floats in a_vertexInd, as for SurfaceVertexSelectionQuantity
+  std::string propagateRule =
+      elements.fitsTextures() ? "MESH_PROPAGATE_SPARSE_VERTEX_VALUE" : "MESH_PROPAGATE_SPARSE_VALUE";
+  std::vector<std::string> rules = addScalarRules({propagateRule});
+  rules.push_back("SHADE_SPARSE_ABSENT_COLOR");
+  program = render::engine->requestShader("MESH", parent.addSurfaceMeshRules(rules));
+
+  // Fill buffers
+  parent.fillGeometryBuffers(*program);
+  fillColorBuffers(*program);
+  render::engine->setMaterial(*program, parent.getMaterial());
+}
+
+void SurfaceVertexSparseScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
+  p.setTextureFromColormap("t_colormap", cMap.get());
+
+  std::vector<size_t> cornerVertices;
+  cornerVertices.reserve(3 * parent.nFacesTriangulation());
+  parent.forEachDrawnFace([&](size_t, SurfaceMesh::IndexView face) {
+    // implicitly triangulate from root
+    for (size_t j = 1; (j + 1) < face.size(); j++) {
+      cornerVertices.push_back(face[0]);
+      cornerVertices.push_back(face[j]);
+      cornerVertices.push_back(face[j + 1]);
+    }
+  });
+
+  if (!p.hasTexture("t_sparseValues")) {
+    fillSparseCornerValues(p, cornerVertices);
+    return;
+  }
+  p.setAttribute("a_vertexInd", std::vector<float>(cornerVertices.begin(), cornerVertices.end()));
+  setSparseTextures(p);
+}
+
+void SurfaceVertexSparseScalarQuantity::buildVertexInfoGUI(size_t vInd) { buildValueInfoGUI(vInd); }
+
+// ========================================================
+// ==========          Sparse Face Scalar        ==========
+// ========================================================
+
+SurfaceFaceSparseScalarQuantity::SurfaceFaceSparseScalarQuantity(std::string name, SparseElementSet elements_,
+                                                                 const std::vector<double>& values_,
+                                                                 SurfaceMesh& mesh_, DataType dataType_)
+    : SurfaceSparseScalarQuantity(name, mesh_, "face", std::move(elements_), values_, dataType_) {}
+
+void SurfaceFaceSparseScalarQuantity::createProgram() {
+  std::string propagateRule = parent.canUseFaceTextures() && elements.fitsTextures()
+                                  ? "MESH_PROPAGATE_SPARSE_FACE_VALUE"
+                                  : "MESH_PROPAGATE_SPARSE_VALUE";
+  std::vector<std::string> rules = addScalarRules({propagateRule});
+  rules.push_back("SHADE_SPARSE_ABSENT_COLOR");
+  program = render::engine->requestShader("MESH", parent.addSurfaceMeshRules(rules));
+
+  // Fill buffers
+  parent.fillGeometryBuffers(*program);
+  fillColorBuffers(*program);
+  render::engine->setMaterial(*program, parent.getMaterial());
+}
+
+void SurfaceFaceSparseScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
+  p.setTextureFromColormap("t_colormap", cMap.get());
+
+  if (p.hasTexture("t_sparseValues")) {
+    parent.setFaceTextureUniforms(p);
+    setSparseTextures(p);
+    return;
+  }
+
+  std::vector<size_t> cornerFaces;
+  cornerFaces.reserve(3 * parent.nFacesTriangulation());
+  parent.forEachDrawnFace([&](size_t iF, SurfaceMesh::IndexView face) {
+    size_t triDegree = face.size() < 3 ? 0 : face.size() - 2;
+    cornerFaces.insert(cornerFaces.end(), 3 * triDegree, iF);
+  });
+  fillSparseCornerValues(p, cornerFaces);
+}
+
+void SurfaceFaceSparseScalarQuantity::buildFaceInfoGUI(size_t fInd) { buildValueInfoGUI(fInd); }
+
+} // namespace polyscope
@@ -2,6 +2,7 @@
 #include "polyscope/surface_vector_quantity.h"
 
 #include "polyscope/file_helpers.h"
+#include "polyscope/internal.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/render/engine.h"
 #include "polyscope/trace_vector_field.h"
@@ -22,9 +23,48 @@ SurfaceVectorQuantity::SurfaceVectorQuantity(std::string name, SurfaceMesh& mesh
     : SurfaceMeshQuantity(name, mesh_), vectorType(vectorType_),
       ribbonEnabled(uniquePrefix() + "#ribbonEnabled", false) {}
 
+SurfaceVectorQuantity::~SurfaceVectorQuantity() {}
 
-void SurfaceVectorQuantity::prepareVectorArtist() {
-  vectorArtist.reset(new VectorArtist(parent, name + "#vectorartist", vectorRoots, vectors, vectorType));
+void SurfaceVectorQuantity::traceRibbons(const std::vector<glm::vec2>& field, int nSym) {
+  const size_t nLines = 2500;
+  if (options::backgroundFieldTracing) {
+    ribbonTraceTask.reset(new FieldTraceTask(parent, field, nSym, nLines));
+    ribbonArtist.reset(new RibbonArtist(parent, {}));
+  } else {
+    // Warning: expensive... Creates noticeable UI lag
+    ribbonArtist.reset(new RibbonArtist(parent, traceField(parent, field, nSym, nLines)));
+  }
+}
+
+void SurfaceVectorQuantity::drawRibbons() {
+  if (ribbonTraceTask) {
+    if (internal::finishBackgroundFills) ribbonTraceTask->finish();
+    bool done = ribbonTraceTask->isDone(); // (before taking the lines, so none are left behind)
+    ribbonArtist->addRibbons(ribbonTraceTask->takeCompletedLines());
+    if (done) {
+      ribbonTraceTask.reset();
+    } else {
+      requestRedraw(); // check again next frame
+    }
+  }
+
+  ribbonArtist->draw();
+}
+
+void SurfaceVectorQuantity::clearRibbons() {
+  ribbonTraceTask.reset();
+  ribbonArtist.reset();
+}
+
+
+void SurfaceVectorQuantity::prepareVectorArtist(std::shared_ptr<render::AttributeBuffer> rootBuffer,
+                                                const std::vector<glm::vec3>* hostRoots) {
+  if (rootBuffer) {
+    vectorRoots = std::vector<glm::vec3>();
+    vectorArtist.reset(new VectorArtist(parent, name + "#vectorartist", rootBuffer, vectors, vectorType, hostRoots));
+  } else {
+    vectorArtist.reset(new VectorArtist(parent, name + "#vectorartist", vectorRoots, vectors, vectorType));
+  }
 }
 
 void SurfaceVectorQuantity::draw() {
@@ -40,6 +80,8 @@ void SurfaceVectorQuantity::buildCustomUI() {
 
 void SurfaceVectorQuantity::drawSubUI() {}
 
+void SurfaceVectorQuantity::dataUpdated() { vectorArtist->vectorsChanged(); }
+
 SurfaceVectorQuantity* SurfaceVectorQuantity::setVectorLengthScale(double newLength, bool isRelative) {
   vectorArtist->setVectorLengthScale(newLength, isRelative);
   return this;
@@ -62,6 +104,18 @@ SurfaceVectorQuantity* SurfaceVectorQuantity::setMaterial(std::string m) {
 }
 std::string SurfaceVectorQuantity::getMaterial() { return vectorArtist->getMaterial(); }
 
+SurfaceVectorQuantity* SurfaceVectorQuantity::setDecimationEnabled(bool newVal) {
+  vectorArtist->setDecimationEnabled(newVal);
+  return this;
+}
+bool SurfaceVectorQuantity::getDecimationEnabled() { return vectorArtist->getDecimationEnabled(); }
+SurfaceVectorQuantity* SurfaceVectorQuantity::setDecimationSpacing(double pixels) {
+  vectorArtist->setDecimationSpacing(pixels);
+  return this;
+}
+double SurfaceVectorQuantity::getDecimationSpacing() { return vectorArtist->getDecimationSpacing(); }
+size_t SurfaceVectorQuantity::getNumVectorsDrawn() { return vectorArtist->getNumVectorsDrawn(); }
+
 SurfaceVectorQuantity* SurfaceVectorQuantity::setRibbonEnabled(bool val) {
   ribbonEnabled = val;
   requestRedraw();
@@ -107,9 +161,14 @@ SurfaceVertexVectorQuantity::SurfaceVertexVectorQuantity(std::string name, std::
   refresh();
 }
 
-void SurfaceVertexVectorQuantity::refresh() {
-  vectorRoots = parent.vertices;
-  prepareVectorArtist();
+void SurfaceVertexVectorQuantity::refresh() { prepareVectorArtist(parent.getVertexPositionBuffer(), &parent.vertices); }
+
+void SurfaceVertexVectorQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  if (vectorArtist->getDecimationEnabled()) {
+    refresh(); // the decimated order holds its own copy of the roots
+    return;
+  }
+  requestRedraw(); // the roots are the mesh's vertex buffer, which it has already updated
 }
 
 void SurfaceVertexVectorQuantity::buildVertexInfoGUI(size_t iV) {
@@ -139,12 +198,10 @@ SurfaceFaceVectorQuantity::SurfaceFaceVectorQuantity(std::string name, std::vect
   refresh();
 }
 
-void SurfaceFaceVectorQuantity::refresh() {
-  vectorRoots.resize(parent.nFaces());
-  for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-    vectorRoots[iF] = parent.faceCenter(iF);
-  }
-  prepareVectorArtist();
+void SurfaceFaceVectorQuantity::refresh() { prepareVectorArtist(parent.getFaceCenterBuffer()); }
+
+void SurfaceFaceVectorQuantity::geometryChanged(const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+  requestRedraw(); // the roots are the mesh's face center buffer, which it has already updated
 }
 
 void SurfaceFaceVectorQuantity::buildFaceInfoGUI(size_t iF) {
@@ -177,6 +234,7 @@ SurfaceFaceIntrinsicVectorQuantity::SurfaceFaceIntrinsicVectorQuantity(std::stri
 }
 
 void SurfaceFaceIntrinsicVectorQuantity::refresh() {
+  parent.ensureHaveGeometryData();
   parent.ensureHaveFaceTangentSpaces();
 
   double rotAngle = 2.0 * PI / nSym;
@@ -195,7 +253,7 @@ void SurfaceFaceIntrinsicVectorQuantity::refresh() {
     Complex angle = std::pow(Complex(vec.x, vec.y), 1.0 / nSym);
 
     // Face center
-    auto& face = parent.faces[iF];
+    auto face = parent.face(iF);
     size_t D = face.size();
     glm::vec3 faceCenter = parent.faceCenter(iF);
 
@@ -209,8 +267,8 @@ void SurfaceFaceIntrinsicVectorQuantity::refresh() {
     }
   }
 
-  prepareVectorArtist();
-  ribbonArtist.reset();
+  prepareVectorArtist(nSym == 1 ? parent.getFaceCenterBuffer() : nullptr);
+  clearRibbons();
 }
 
 void SurfaceFaceIntrinsicVectorQuantity::buildFaceInfoGUI(size_t iF) {
@@ -234,12 +292,11 @@ void SurfaceFaceIntrinsicVectorQuantity::draw() {
 
     // Make sure we have a ribbon artist
     if (ribbonArtist == nullptr) {
-      // Warning: expensive... Creates noticeable UI lag
-      ribbonArtist.reset(new RibbonArtist(parent, traceField(parent, vectorField, nSym, 2500)));
+      traceRibbons(vectorField, nSym);
     }
 
     // Update transform matrix from parent
-    ribbonArtist->draw();
+    drawRibbons();
   }
 }
 
@@ -268,6 +325,7 @@ SurfaceVertexIntrinsicVectorQuantity::SurfaceVertexIntrinsicVectorQuantity(std::
 }
 
 void SurfaceVertexIntrinsicVectorQuantity::refresh() {
+  parent.ensureHaveGeometryData();
   parent.ensureHaveVertexTangentSpaces();
 
   double rotAngle = 2.0 * PI / nSym;
@@ -295,8 +353,8 @@ void SurfaceVertexIntrinsicVectorQuantity::refresh() {
     }
   }
 
-  prepareVectorArtist();
-  ribbonArtist.reset();
+  prepareVectorArtist(nSym == 1 ? parent.getVertexPositionBuffer() : nullptr, &parent.vertices);
+  clearRibbons();
 }
 
 void SurfaceVertexIntrinsicVectorQuantity::buildVertexInfoGUI(size_t iV) {
@@ -334,7 +392,7 @@ void SurfaceVertexIntrinsicVectorQuantity::draw() {
       parent.ensureHaveVertexTangentSpaces();
       std::vector<glm::vec2> unitFaceVecs(parent.nFaces());
       for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-        std::vector<size_t>& face = parent.faces[iF];
+        auto face = parent.face(iF);
 
         glm::vec3 faceBasisX = parent.faceTangentSpaces[iF][0];
         glm::vec3 faceBasisY = parent.faceTangentSpaces[iF][1];
@@ -358,12 +416,11 @@ void SurfaceVertexIntrinsicVectorQuantity::draw() {
         unitFaceVecs[iF] = glm::normalize(sum);
       }
 
-      // Warning: expensive... Creates noticeable UI lag
-      ribbonArtist.reset(new RibbonArtist(parent, traceField(parent, unitFaceVecs, nSym, 2500)));
+      traceRibbons(unitFaceVecs, nSym);
     }
 
     // Update transform matrix from parent
-    ribbonArtist->draw();
+    drawRibbons();
   }
 }
 
@@ -393,6 +450,7 @@ SurfaceOneFormIntrinsicVectorQuantity::SurfaceOneFormIntrinsicVectorQuantity(std
 }
 
 void SurfaceOneFormIntrinsicVectorQuantity::refresh() {
+  parent.ensureHaveGeometryData();
 
   // If the parent doesn't have face tangent spaces, auto-generate them
   // (since the user shouldn't have to think about face tangent spaces to specify a 1-form)
@@ -401,13 +459,12 @@ void SurfaceOneFormIntrinsicVectorQuantity::refresh() {
   }
 
   parent.ensureHaveFaceTangentSpaces();
-  vectorRoots = std::vector<glm::vec3>(parent.nFaces(), glm::vec3{0., 0., 0.});
   vectors = std::vector<glm::vec3>(parent.nFaces(), glm::vec3{0., 0., 0.});
   mappedVectorField = std::vector<glm::vec2>(parent.nFaces(), glm::vec3{0., 0., 0.});
 
   // Remap to faces
   for (size_t iF = 0; iF < parent.nFaces(); iF++) {
-    auto& face = parent.faces[iF];
+    auto face = parent.face(iF);
     size_t D = face.size();
 
     // sorry, need triangles
@@ -416,16 +473,12 @@ void SurfaceOneFormIntrinsicVectorQuantity::refresh() {
       continue;
     }
 
-    // find the face center
-    glm::vec3 faceCenter = parent.faceCenter(iF);
-    vectorRoots[iF] = faceCenter;
-
     std::array<float, 3> formValues;
     std::array<glm::vec3, 3> vecValues;
     for (size_t j = 0; j < D; j++) {
       size_t vA = face[j];
       size_t vB = face[(j + 1) % D];
-      size_t iE = parent.edgeIndices[iF][j];
+      size_t iE = parent.faceEdges(iF)[j];
 
       bool isCanonicalOriented;
       if (parent.vertexPerm.size() > 0) {
@@ -457,8 +510,8 @@ void SurfaceOneFormIntrinsicVectorQuantity::refresh() {
     vectors[iF] = result;
   }
 
-  prepareVectorArtist();
-  ribbonArtist.reset();
+  prepareVectorArtist(parent.getFaceCenterBuffer());
+  clearRibbons();
 }
 
 void SurfaceOneFormIntrinsicVectorQuantity::buildEdgeInfoGUI(size_t iE) {
@@ -496,13 +549,12 @@ void SurfaceOneFormIntrinsicVectorQuantity::draw() {
       for (size_t iF = 0; iF < parent.nFaces(); iF++) {
         unitMappedField[iF] = glm::normalize(mappedVectorField[iF]);
       }
-      // Warning: expensive... Creates noticeable UI lag
-      ribbonArtist.reset(new RibbonArtist(parent, traceField(parent, unitMappedField, 1, 2500)));
+      traceRibbons(unitMappedField, 1);
     }
 
 
     // Update transform matrix from parent
-    ribbonArtist->draw();
+    drawRibbons();
   }
 }
 
@@ -517,4 +569,20 @@ void SurfaceOneFormIntrinsicVectorQuantity::drawSubUI() {
 
 std::string SurfaceOneFormIntrinsicVectorQuantity::niceName() { return name + " (1-form intrinsic vector)"; }
 
+size_t SurfaceVectorQuantity::hostMemoryUsage() { return allocatedBytes(vectors) + allocatedBytes(vectorRoots); }
+
+size_t SurfaceFaceIntrinsicVectorQuantity::hostMemoryUsage() {
+  return SurfaceVectorQuantity::hostMemoryUsage() + allocatedBytes(vectorField);
+}
+
+size_t SurfaceVertexIntrinsicVectorQuantity::hostMemoryUsage() {
+  return SurfaceVectorQuantity::hostMemoryUsage() + allocatedBytes(vectorField);
+}
+
+size_t SurfaceOneFormIntrinsicVectorQuantity::hostMemoryUsage() {
+  size_t bytes = SurfaceVectorQuantity::hostMemoryUsage();
+  bytes += allocatedBytes(oneForm) + allocatedBytes(mappedVectorField) + allocatedBytes(canonicalOrientation);
+  return bytes;
+}
+
 } // namespace polyscope
@@ -0,0 +1,311 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/time_frames.h"
+
+#include "polyscope/messages.h"
+#include "polyscope/options.h"
+#include "polyscope/parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace polyscope {
+
+TimeFrameLoader rawFileFrameLoader(std::vector<std::string> filenames) {
+  return [filenames](size_t iFrame, std::vector<float>& data) {
+    std::ifstream in(filenames.at(iFrame), std::ios::binary | std::ios::ate);
+    if (!in) {
+      data.clear();
+      return;
+    }
+    std::streamoff bytes = in.tellg();
+    in.seekg(0);
+    data.resize(static_cast<size_t>(bytes) / sizeof(float));
+    in.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float));
+    if (!in) data.clear();
+  };
+}
+
+// The reads ahead of the playhead. The part the read jobs touch is shared with them, so that jobs still queued when the
+// frames are destroyed find it, see that it is stopping, and return.
+struct TimeFrameBuffers::Stream {
+  struct Reads {
+    TimeFrameLoader loader;
+    size_t frameSize;
+    std::mutex mutex;
+    std::condition_variable frameRead;
+    std::set<size_t> reading;                   // frames queued or being read
+    std::map<size_t, std::vector<float>> ready; // frames read and waiting to be uploaded (empty if unreadable)
+    std::vector<std::vector<float>> spare;      // the storage of uploaded frames, reused by the next reads
+    bool stopping = false;
+  };
+
+  size_t nFrames;
+  std::shared_ptr<Reads> reads;
+  std::vector<std::shared_ptr<render::AttributeBuffer>> slots;
+  std::vector<size_t> slotFrame; // the frame in each slot, npos while empty
+  std::vector<glm::vec3> uploadScratch;
+  bool prepared = false;
+  double preparedTime = 0.;
+  int direction = 1; // of playback, +1 or -1
+
+  // Declared last, so that it is destroyed first, see ~Stream()
+  std::unique_ptr<JobQueue> jobs;
+
+  static const size_t npos = std::numeric_limits<size_t>::max();
+
+  ~Stream() {
+    {
+      std::lock_guard<std::mutex> lock(reads->mutex);
+      reads->stopping = true;
+    }
+    jobs.reset();
+  }
+
+  static void readFrame(const std::shared_ptr<Reads>& reads, size_t iFrame) {
+    std::vector<float> data;
+    {
+      std::lock_guard<std::mutex> lock(reads->mutex);
+      if (reads->stopping) {
+        reads->reading.erase(iFrame);
+        return;
+      }
+      if (!reads->spare.empty()) {
+        data = std::move(reads->spare.back());
+        reads->spare.pop_back();
+      }
+    }
+    try {
+      reads->loader(iFrame, data);
+    } catch (...) {
+      data.clear();
+    }
+    if (data.size() != reads->frameSize) data.clear();
+    {
+      std::lock_guard<std::mutex> lock(reads->mutex);
+      reads->reading.erase(iFrame);
+      reads->ready[iFrame] = std::move(data);
+    }
+    reads->frameRead.notify_all();
+  }
+
+  size_t slotOf(size_t iFrame) const {
+    for (size_t s = 0; s < slots.size(); s++) {
+      if (slotFrame[s] == iFrame) return s;
+    }
+    return npos;
+  }
+
+  // How soon playback reaches a frame from `base`; frames behind the playhead come last
+  size_t playbackDistance(size_t base, size_t iFrame) const {
+    long long d = (static_cast<long long>(iFrame) - static_cast<long long>(base)) * direction;
+    return d >= 0 ? static_cast<size_t>(d) : nFrames + static_cast<size_t>(-d);
+  }
+
+  // Upload a frame in to the slot holding the frame playback reaches last, other than the ones in `keep`
+  void upload(render::DataType type, size_t iFrame, size_t base, size_t keep0, size_t keep1) {
+    std::vector<float> data;
+    {
+      // Take the frame if it was read ahead, wait for it if it is being read, and otherwise read it here
+      std::unique_lock<std::mutex> lock(reads->mutex);
+      reads->frameRead.wait(lock, [&]() { return reads->reading.count(iFrame) == 0; });
+      std::map<size_t, std::vector<float>>::iterator it = reads->ready.find(iFrame);
+      if (it != reads->ready.end()) {
+        data = std::move(it->second);
+        reads->ready.erase(it);
+      } else {
+        lock.unlock();
+        try {
+          reads->loader(iFrame, data);
+        } catch (...) {
+          data.clear();
+        }
+      }
+    }
+    if (data.size() != reads->frameSize) {
+      warning("could not load time frame " + std::to_string(iFrame), "drawing zeros in its place");
+      data.assign(reads->frameSize, 0.f);
+    }
+
+    size_t target = npos;
+    size_t targetDist = 0;
+    for (size_t s = 0; s < slots.size(); s++) {
+      if (slotFrame[s] == npos) {
+        target = s;
+        break;
+      }
+      if (slotFrame[s] == keep0 || slotFrame[s] == keep1) continue;
+      size_t dist = playbackDistance(base, slotFrame[s]);
+      if (target == npos || dist > targetDist) {
+        target = s;
+        targetDist = dist;
+      }
+    }
+
+    if (!slots[target]) slots[target] = render::engine->generateAttributeBuffer(type);
+    if (type == render::DataType::Vector3Float) {
+      uploadScratch.resize(data.size() / 3);
+      std::memcpy(uploadScratch.data(), data.data(), uploadScratch.size() * sizeof(glm::vec3));
+      slots[target]->setData(uploadScratch, slotFrame[target] != npos);
+    } else {
+      slots[target]->setData(data, slotFrame[target] != npos);
+    }
+    slotFrame[target] = iFrame;
+
+    std::lock_guard<std::mutex> lock(reads->mutex);
+    if (reads->spare.size() < options::timeSeriesPrefetchFrames) reads->spare.push_back(std::move(data));
+  }
+
+  // Make the frames at `base` and after it resident, upload what was read ahead, and queue more reads
+  void prepare(render::DataType type, double t, size_t base, size_t next) {
+    if (prepared && t == preparedTime) return;
+    if (prepared && t != preparedTime) direction = t < preparedTime ? -1 : 1;
+    prepared = true;
+    preparedTime = t;
+
+    if (slotOf(base) == npos) upload(type, base, base, base, next);
+    if (slotOf(next) == npos) upload(type, next, base, base, next);
+
+    // Upload frames which were read ahead to the slots playback reaches last, a couple per call so that no one frame
+    // does all of them
+    size_t prefetch = options::timeSeriesPrefetchFrames;
+    size_t nUploaded = 0;
+    for (size_t k = 2; k < slots.size() && nUploaded < 2; k++) {
+      long long f = static_cast<long long>(base) + direction * static_cast<long long>(k);
+      if (f < 0 || f >= static_cast<long long>(nFrames)) break;
+      size_t iFrame = static_cast<size_t>(f);
+      if (slotOf(iFrame) != npos) continue;
+      bool isReady;
+      {
+        std::lock_guard<std::mutex> lock(reads->mutex);
+        isReady = reads->ready.count(iFrame) > 0;
+      }
+      if (!isReady) continue;
+      upload(type, iFrame, base, base, next);
+      nUploaded++;
+    }
+
+    // Drop what was read for frames playback has left behind, then read ahead up to the budget
+    std::vector<size_t> toRead;
+    {
+      std::lock_guard<std::mutex> lock(reads->mutex);
+      for (std::map<size_t, std::vector<float>>::iterator it = reads->ready.begin(); it != reads->ready.end();) {
+        if (playbackDistance(base, it->first) > prefetch) {
+          if (reads->spare.size() < prefetch) reads->spare.push_back(std::move(it->second));
+          it = reads->ready.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      for (size_t k = 1; k <= prefetch; k++) {
+        if (reads->ready.size() + reads->reading.size() >= prefetch) break;
+        long long f = static_cast<long long>(base) + direction * static_cast<long long>(k);
+        if (f < 0 || f >= static_cast<long long>(nFrames)) break;
+        size_t iFrame = static_cast<size_t>(f);
+        if (slotOf(iFrame) != npos || reads->ready.count(iFrame) || reads->reading.count(iFrame)) continue;
+        reads->reading.insert(iFrame);
+        toRead.push_back(iFrame);
+      }
+    }
+    std::shared_ptr<Reads> sharedReads = reads;
+    for (size_t iFrame : toRead) {
+      jobs->push([sharedReads, iFrame]() { readFrame(sharedReads, iFrame); });
+    }
+  }
+};
+
+TimeFrameBuffers::TimeFrameBuffers(render::DataType type_, size_t maxHeld_)
+    : type(type_), maxHeld(std::max<size_t>(maxHeld_, 1)) {}
+
+TimeFrameBuffers::TimeFrameBuffers(render::DataType type_, size_t nFrames, size_t frameSize, TimeFrameLoader loader)
+    : type(type_), maxHeld(0), stream(new Stream()) {
+  stream->nFrames = nFrames;
+  stream->reads = std::make_shared<Stream::Reads>();
+  stream->reads->loader = std::move(loader);
+  stream->reads->frameSize = frameSize;
+  size_t nSlots = std::max<size_t>(options::timeSeriesStreamedGPUFrames, 2);
+  stream->slots.resize(nSlots);
+  stream->slotFrame.assign(nSlots, Stream::npos);
+  stream->jobs.reset(new JobQueue(std::max(options::timeSeriesPrefetchThreads, 1)));
+}
+
+TimeFrameBuffers::~TimeFrameBuffers() {}
+
+size_t TimeFrameBuffers::nFrames() const { return stream ? stream->nFrames : nDropped + frames.size(); }
+
+size_t TimeFrameBuffers::nHeld() const {
+  if (!stream) return frames.size();
+  return std::count_if(stream->slotFrame.begin(), stream->slotFrame.end(),
+                       [](size_t f) { return f != Stream::npos; });
+}
+
+void TimeFrameBuffers::addFrame(const std::vector<glm::vec3>& data) {
+  if (stream) {
+    error("can not add frames to streamed time frames");
+    return;
+  }
+  std::shared_ptr<render::AttributeBuffer> buffer = render::engine->generateAttributeBuffer(type);
+  buffer->setData(data);
+  pushFrame(buffer);
+}
+
+void TimeFrameBuffers::addFrame(const std::vector<float>& data) {
+  if (stream) {
+    error("can not add frames to streamed time frames");
+    return;
+  }
+  std::shared_ptr<render::AttributeBuffer> buffer = render::engine->generateAttributeBuffer(type);
+  buffer->setData(data);
+  pushFrame(buffer);
+}
+
+void TimeFrameBuffers::pushFrame(std::shared_ptr<render::AttributeBuffer> buffer) {
+  frames.push_back(std::move(buffer));
+  while (frames.size() > maxHeld) {
+    frames.pop_front();
+    nDropped++;
+  }
+}
+
+void TimeFrameBuffers::locate(double t, size_t& frameInd, float& blend) const {
+  double held = t - static_cast<double>(nDropped);
+  double last = static_cast<double>((stream ? stream->nFrames : frames.size()) - 1);
+  if (!(held > 0.)) held = 0.; // (also catches NaN)
+  if (held > last) held = last;
+  double base = std::floor(held);
+  frameInd = static_cast<size_t>(base);
+  blend = static_cast<float>(held - base);
+}
+
+std::shared_ptr<render::AttributeBuffer> TimeFrameBuffers::frameBuffer(size_t frameInd) {
+  if (!stream) return frames[frameInd];
+  return stream->slots[stream->slotOf(frameInd)];
+}
+
+void TimeFrameBuffers::bind(render::ShaderProgram& p, const std::string& attributeName, double t) {
+  size_t iF;
+  float blend;
+  locate(t, iF, blend);
+  if (stream) stream->prepare(type, t, iF, std::min(iF + 1, stream->nFrames - 1));
+  p.setAttribute(attributeName, frameBuffer(iF));
+}
+
+void TimeFrameBuffers::bind(render::ShaderProgram& p, const std::string& attributeName,
+                            const std::string& nextAttributeName, const std::string& blendUniformName, double t) {
+  size_t iF;
+  float blend;
+  locate(t, iF, blend);
+  size_t iNext = std::min(iF + 1, nFrames() - nDropped - 1);
+  if (stream) stream->prepare(type, t, iF, iNext);
+  p.setAttribute(attributeName, frameBuffer(iF));
+  p.setAttribute(nextAttributeName, frameBuffer(iNext));
+  p.setUniform(blendUniformName, blend);
+}
+
+} // namespace polyscope
@@ -1,8 +1,14 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/trace_vector_field.h"
 
+#include "polyscope/internal.h"
+#include "polyscope/parallel.h"
+
 #include "glm/gtx/rotate_vector.hpp"
 
+#include <atomic>
+#include <mutex>
+
 namespace polyscope {
 
 // Helpers for tracing
@@ -64,6 +70,7 @@ public:
 
   // Cached geometric quantities
   std::vector<glm::vec2> vert1InFaceBasis, vert2InFaceBasis;
+  std::vector<glm::vec3> faceNormals; // (copied, as the mesh may free its own during background tracing)
   float totalArea;
 
   // Cached connectivity data
@@ -73,6 +80,8 @@ public:
 
     mesh.ensureHaveFaceTangentSpaces();
     mesh.ensureHaveManifoldConnectivity();
+    mesh.ensureHaveGeometryData();
+    faceNormals = mesh.faceNormals;
 
     // Prepare the field
     faceVectors.resize(mesh.nFaces());
@@ -87,7 +96,7 @@ public:
     vert2InFaceBasis.resize(mesh.nFaces());
     totalArea = 0;
     for (size_t iF = 0; iF < mesh.nFaces(); iF++) {
-      std::vector<size_t>& face = mesh.faces[iF];
+      auto face = mesh.face(iF);
 
       totalArea += mesh.faceAreas[iF];
 
@@ -116,9 +125,9 @@ public:
 
   glm::vec3 facePointInR3(FacePoint p) {
 
-    size_t v0 = mesh.faces[p.f][0];
-    size_t v1 = mesh.faces[p.f][1];
-    size_t v2 = mesh.faces[p.f][2];
+    size_t v0 = mesh.face(p.f)[0];
+    size_t v1 = mesh.face(p.f)[1];
+    size_t v2 = mesh.face(p.f)[2];
 
     return p.baryWeights[0] * mesh.vertices[v0] + p.baryWeights[1] * mesh.vertices[v1] +
            p.baryWeights[2] * mesh.vertices[v2];
@@ -138,7 +147,7 @@ public:
 
     // Add the initial point
     glm::vec3 initPoint = facePointInR3(startPoint);
-    points.push_back({{initPoint, mesh.faceNormals[startPoint.f]}});
+    points.push_back({{initPoint, faceNormals[startPoint.f]}});
 
     // Trace!
     FacePoint currPoint = startPoint;
@@ -192,19 +201,19 @@ public:
       float tCross, tRay;
       if (hit0.tRay <= hit1.tRay && hit0.tRay <= hit2.tRay) {
         exitHeLocalIndex = 0;
-        exitHe = mesh.halfedgeIndices[currFace][0];
+        exitHe = mesh.halfedgeIndex(currFace, 0);
         nextHe = mesh.twinHalfedge[exitHe];
         tCross = 1.0 - hit0.tLine;
         tRay = hit0.tRay;
       } else if (hit1.tRay <= hit0.tRay && hit1.tRay <= hit2.tRay) {
         exitHeLocalIndex = 1;
-        exitHe = mesh.halfedgeIndices[currFace][1];
+        exitHe = mesh.halfedgeIndex(currFace, 1);
         nextHe = mesh.twinHalfedge[exitHe];
         tCross = 1.0 - hit1.tLine;
         tRay = hit1.tRay;
       } else if (hit2.tRay <= hit0.tRay && hit2.tRay <= hit1.tRay) {
         exitHeLocalIndex = 2;
-        exitHe = mesh.halfedgeIndices[currFace][2];
+        exitHe = mesh.halfedgeIndex(currFace, 2);
         nextHe = mesh.twinHalfedge[exitHe];
         tCross = 1.0 - hit2.tLine;
         tRay = hit2.tRay;
@@ -218,22 +227,22 @@ public:
       if (tRay > lengthRemaining) {
         tRay = lengthRemaining;
         glm::vec2 endingPos = pointPos + tRay * traceDir;
-        glm::vec3 endingPosR3 = mesh.vertices[mesh.faces[currFace][0]] +
+        glm::vec3 endingPosR3 = mesh.vertices[mesh.face(currFace)[0]] +
                                 endingPos.x * mesh.faceTangentSpaces[currFace][0] +
                                 endingPos.y * mesh.faceTangentSpaces[currFace][1];
-        points.push_back({{endingPosR3, mesh.faceNormals[currFace]}});
+        points.push_back({{endingPosR3, faceNormals[currFace]}});
         break;
       }
 
       // Generate a point for this intersection
       glm::vec2 newPointLocal = pointPos + tRay * traceDir;
-      glm::vec3 newPointR3 = mesh.vertices[mesh.faces[currFace][0]] +
+      glm::vec3 newPointR3 = mesh.vertices[mesh.face(currFace)[0]] +
                              newPointLocal.x * mesh.faceTangentSpaces[currFace][0] +
                              newPointLocal.y * mesh.faceTangentSpaces[currFace][1];
-      glm::vec3 newNormal = mesh.faceNormals[currFace];
+      glm::vec3 newNormal = faceNormals[currFace];
       if (nextHe != INVALID_IND) {
         nextFace = mesh.faceForHalfedge[nextHe];
-        newNormal = glm::normalize(newNormal + mesh.faceNormals[nextFace]);
+        newNormal = glm::normalize(newNormal + faceNormals[nextFace]);
       }
       points.push_back({{newPointR3, newNormal}});
 
@@ -254,14 +263,14 @@ public:
 
       // Figure out which halfedge in the next face is nextHe
       unsigned int nextHeLocalIndex = 0;
-      while (mesh.halfedgeIndices[nextFace][nextHeLocalIndex] != nextHe) {
+      while (mesh.halfedgeIndex(nextFace, nextHeLocalIndex) != nextHe) {
         nextHeLocalIndex++;
       }
 
       // On a non-manifold / not oriented mesh, the halfedges we're transitioning between might actually point the same
       // way. If so, flip tCross.
-      size_t currTailVert = mesh.faces[currFace][exitHeLocalIndex];
-      size_t nextTailVert = mesh.faces[nextFace][nextHeLocalIndex];
+      size_t currTailVert = mesh.face(currFace)[exitHeLocalIndex];
+      size_t nextTailVert = mesh.face(nextFace)[nextHeLocalIndex];
       if (currTailVert == nextTailVert) {
         tCross = 1.0 - tCross;
       }
@@ -285,62 +294,25 @@ public:
   }
 };
 
+// Where a line starts, and which way it heads off
+struct LineStart {
+  FacePoint point;
+  glm::vec2 dir;
+  float traceSign;
+};
 
-}; // namespace
-
-// Rotate in to a new basis in R3. Vector is rotated in to new tangent plane, then a change of basis is performed to
-// the new basis. Basis vectors MUST be unit and orthogonal -- this function doesn't check.
-glm::vec2 rotateToTangentBasis(glm::vec2 v, const glm::vec3& oldBasisX, const glm::vec3& oldBasisY,
-                               const glm::vec3& newBasisX, const glm::vec3& newBasisY) {
-
-  glm::vec3 oldNormal = glm::cross(oldBasisX, oldBasisY);
-  glm::vec3 newNormal = glm::cross(newBasisX, newBasisY);
-
-  // If the vectors are nearly in plane, no rotation is needed
-  // (can't just go through the same code path as below because cross
-  // yields a degenerate direction)
-  float EPS = 0.0000001;
-  float dotVal = dot(oldNormal, newNormal);
-  glm::vec3 oldBasisInPlaneX, oldBasisInPlaneY;
-  if (dotVal > (1.0 - EPS)) {
-    // No rotation
-    oldBasisInPlaneX = oldBasisX;
-    oldBasisInPlaneY = oldBasisY;
-  } else if (dotVal < -(1.0 - EPS)) {
-    // 180 degree rotation
-    oldBasisInPlaneX = -oldBasisX;
-    oldBasisInPlaneY = -oldBasisY;
-  } else {
-    // general rotation
-    glm::vec3 edgeV = glm::normalize(cross(oldNormal, newNormal));
-    float angle = atan2(dot(edgeV, cross(oldNormal, newNormal)), dot(oldNormal, newNormal));
-    oldBasisInPlaneX = glm::rotate(oldBasisX, angle, edgeV);
-    oldBasisInPlaneY = glm::rotate(oldBasisY, angle, edgeV);
-    // oldBasisInPlaneX = oldBasisX.rotate_around(edgeV, angle);
-    // oldBasisInPlaneY = oldBasisY.rotate_around(edgeV, angle);
-  }
-
-  // Now it's just a goood old-fashioned change of basis
-  float xComp = v.x * glm::dot(oldBasisInPlaneX, newBasisX) + v.y * glm::dot(oldBasisInPlaneY, newBasisX);
-  float yComp = v.x * glm::dot(oldBasisInPlaneX, newBasisY) + v.y * glm::dot(oldBasisInPlaneY, newBasisY);
-  return glm::vec2{xComp, yComp};
+// A small counter-based generator, so that each line gets its own stream from (seed, line index), and the lines do not
+// depend on which thread traces them (or on the standard library's distributions)
+double unitRandFromStream(uint64_t& state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  z = z ^ (z >> 31);
+  return (z >> 11) * (1.0 / 9007199254740992.0);
 }
 
-std::vector<std::vector<std::array<glm::vec3, 2>>> traceField(SurfaceMesh& mesh, const std::vector<glm::vec2>& field,
-                                                              int nSym, size_t nLines) {
-
-  // Only works on triangle meshes
-  for (auto& face : mesh.faces) {
-    if (face.size() != 3) {
-      polyscope::warning("field tracing only supports triangular meshes");
-      return std::vector<std::vector<std::array<glm::vec3, 2>>>();
-    }
-  }
-
-  // Preliminaries
-
-  // Create a tracer
-  FieldTracer tracer(mesh, field, nSym);
+std::vector<LineStart> sampleLineStarts(FieldTracer& tracer, size_t nLines, uint64_t seed) {
+  SurfaceMesh& mesh = tracer.mesh;
 
   // Compute a reasonable number of lines if no count was specified
   if (nLines == 0) {
@@ -365,7 +337,7 @@ std::vector<std::vector<std::array<glm::vec3, 2>>> traceField(SurfaceMesh& mesh,
     }
 
     // Shuffle the list (if we're tracing fewer lines than the size of the list, we want them to be distributed evenly)
-    auto randomEngine = std::default_random_engine{};
+    auto randomEngine = std::default_random_engine(static_cast<std::default_random_engine::result_type>(seed));
     std::shuffle(faceQueue.begin(), faceQueue.end(), randomEngine);
 
     // Make sure the queue of faces to process is long enough by repeating it
@@ -375,18 +347,12 @@ std::vector<std::vector<std::array<glm::vec3, 2>>> traceField(SurfaceMesh& mesh,
     }
   }
 
-  // Unit random numbers
-  std::random_device device;
-  std::mt19937 mt(device());
-  std::uniform_real_distribution<double> unitDist(0.0, 1.0);
-  auto unitRand = [&]() { return unitDist(mt); };
-
-
-  // == Trace the lines
-  // cout << "Tracing lines through vector field... " << endl;
-  std::vector<std::vector<std::array<glm::vec3, 2>>> lineList;
+  std::vector<LineStart> starts(nLines);
   for (size_t i = 0; i < nLines; i++) {
 
+    // Unit random numbers, from the stream of this line
+    uint64_t stream = seed * 0x2545F4914F6CDD1Dull + i;
+    auto unitRand = [&]() { return unitRandFromStream(stream); };
 
     // Get the next starting face
     size_t startFace = faceQueue.back();
@@ -407,13 +373,143 @@ std::vector<std::vector<std::array<glm::vec3, 2>>> traceField(SurfaceMesh& mesh,
     // a random direction in symmetric fields)
     glm::vec2 randomDir = glm::normalize(glm::vec2{unitRand() - .5, unitRand() - .5});
 
-    // Trace
-    lineList.push_back(tracer.traceLine(FacePoint{startFace, randPoint}, randomDir, traceSign));
+    starts[i] = LineStart{FacePoint{startFace, randPoint}, randomDir, traceSign};
   }
-  // cout << "    ... done tracing field." << endl;
 
+  return starts;
+}
+
+// Lines are traced in parallel batches of (at least) this many
+const size_t traceLineBlockSize = 16;
+
+}; // namespace
+
+// Rotate in to a new basis in R3. Vector is rotated in to new tangent plane, then a change of basis is performed to
+// the new basis. Basis vectors MUST be unit and orthogonal -- this function doesn't check.
+glm::vec2 rotateToTangentBasis(glm::vec2 v, const glm::vec3& oldBasisX, const glm::vec3& oldBasisY,
+                               const glm::vec3& newBasisX, const glm::vec3& newBasisY) {
+
+  glm::vec3 oldNormal = glm::cross(oldBasisX, oldBasisY);
+  glm::vec3 newNormal = glm::cross(newBasisX, newBasisY);
+
+  // If the vectors are nearly in plane, no rotation is needed
+  // (can't just go through the same code path as below because cross
+  // yields a degenerate direction)
+  float EPS = 0.0000001;
+  float dotVal = dot(oldNormal, newNormal);
+  glm::vec3 oldBasisInPlaneX, oldBasisInPlaneY;
+  if (dotVal > (1.0 - EPS)) {
+    // No rotation
+    oldBasisInPlaneX = oldBasisX;
+    oldBasisInPlaneY = oldBasisY;
+  } else if (dotVal < -(1.0 - EPS)) {
+    // 180 degree rotation
+    oldBasisInPlaneX = -oldBasisX;
+    oldBasisInPlaneY = -oldBasisY;
+  } else {
+    // general rotation
+    glm::vec3 edgeV = glm::normalize(cross(oldNormal, newNormal));
+    float angle = atan2(dot(edgeV, cross(oldNormal, newNormal)), dot(oldNormal, newNormal));
+    oldBasisInPlaneX = glm::rotate(oldBasisX, angle, edgeV);
+    oldBasisInPlaneY = glm::rotate(oldBasisY, angle, edgeV);
+    // oldBasisInPlaneX = oldBasisX.rotate_around(edgeV, angle);
+    // oldBasisInPlaneY = oldBasisY.rotate_around(edgeV, angle);
+  }
+
+  // Now it's just a goood old-fashioned change of basis
+  float xComp = v.x * glm::dot(oldBasisInPlaneX, newBasisX) + v.y * glm::dot(oldBasisInPlaneY, newBasisX);
+  float yComp = v.x * glm::dot(oldBasisInPlaneX, newBasisY) + v.y * glm::dot(oldBasisInPlaneY, newBasisY);
+  return glm::vec2{xComp, yComp};
+}
+
+std::vector<std::vector<std::array<glm::vec3, 2>>> traceField(SurfaceMesh& mesh, const std::vector<glm::vec2>& field,
+                                                              int nSym, size_t nLines, uint64_t seed) {
+
+  // Only works on triangle meshes
+  if (!mesh.isTriangleMesh()) {
+    polyscope::warning("field tracing only supports triangular meshes");
+    return std::vector<std::vector<std::array<glm::vec3, 2>>>();
+  }
+
+  // Create a tracer, and choose where the lines start
+  FieldTracer tracer(mesh, field, nSym);
+  std::vector<LineStart> starts = sampleLineStarts(tracer, nLines, seed);
+
+  // == Trace the lines
+  std::vector<std::vector<std::array<glm::vec3, 2>>> lineList(starts.size());
+  parallelFor(
+      0, starts.size(),
+      [&](size_t i) { lineList[i] = tracer.traceLine(starts[i].point, starts[i].dir, starts[i].traceSign); },
+      traceLineBlockSize);
 
   return lineList;
 }
 
+// == Background tracing
+
+struct FieldTraceTask::Impl {
+  std::unique_ptr<FieldTracer> tracer; // null if the mesh can't be traced
+  std::vector<LineStart> starts;
+
+  std::mutex completedMutex;
+  std::vector<std::vector<std::array<glm::vec3, 2>>> completed;
+  std::atomic<bool> cancelled{false};
+
+  std::unique_ptr<BackgroundTask> task;
+};
+
+FieldTraceTask::FieldTraceTask(SurfaceMesh& mesh, const std::vector<glm::vec2>& field, int nSym, size_t nLines,
+                               uint64_t seed)
+    : impl(new Impl()) {
+
+  // Only works on triangle meshes
+  if (!mesh.isTriangleMesh()) {
+    polyscope::warning("field tracing only supports triangular meshes");
+    return;
+  }
+
+  // (the setup computes any missing geometry on the mesh, so it happens here rather than in the background)
+  impl->tracer.reset(new FieldTracer(mesh, field, nSym));
+  impl->starts = sampleLineStarts(*impl->tracer, nLines, seed);
+
+  Impl* state = impl.get();
+  impl->task.reset(new BackgroundTask(internal::getBufferPreparationQueue(), [state]() {
+    const size_t batchSize = 256; // lines handed over at a time
+    for (size_t batchStart = 0; batchStart < state->starts.size() && !state->cancelled; batchStart += batchSize) {
+      size_t batchEnd = std::min(batchStart + batchSize, state->starts.size());
+      std::vector<std::vector<std::array<glm::vec3, 2>>> batch(batchEnd - batchStart);
+      parallelFor(
+          batchStart, batchEnd,
+          [&](size_t i) {
+            const LineStart& start = state->starts[i];
+            batch[i - batchStart] = state->tracer->traceLine(start.point, start.dir, start.traceSign);
+          },
+          traceLineBlockSize);
+
+      std::lock_guard<std::mutex> lock(state->completedMutex);
+      for (std::vector<std::array<glm::vec3, 2>>& line : batch) {
+        state->completed.push_back(std::move(line));
+      }
+    }
+  }));
+}
+
+FieldTraceTask::~FieldTraceTask() {
+  impl->cancelled = true;
+  impl->task.reset(); // waits for the current batch
+}
+
+bool FieldTraceTask::isDone() const { return !impl->task || impl->task->isDone(); }
+
+void FieldTraceTask::finish() {
+  if (impl->task) impl->task->finish();
+}
+
+std::vector<std::vector<std::array<glm::vec3, 2>>> FieldTraceTask::takeCompletedLines() {
+  std::lock_guard<std::mutex> lock(impl->completedMutex);
+  std::vector<std::vector<std::array<glm::vec3, 2>>> lines;
+  lines.swap(impl->completed);
+  return lines;
+}
+
 } // namespace polyscope
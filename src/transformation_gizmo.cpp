@@ -18,6 +18,9 @@ void TransformationGizmo::markUpdated() {
   if (Tpers != nullptr) {
     Tpers->manuallyChanged();
   }
+  if (onUpdate) {
+    onUpdate();
+  }
 }
 
 void TransformationGizmo::prepare() {
@@ -1,8 +1,12 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/utilities.h"
 #include "polyscope/messages.h"
+#include "polyscope/parallel.h"
 
+#include <array>
 #include <cmath>
+#include <cstring>
+#include <limits>
 #include <vector>
 
 
@@ -47,6 +51,154 @@ std::tuple<std::string, std::string> splitExt(std::string f) {
   return std::tuple<std::string, std::string>{f.substr(0, p), f.substr(p, std::string::npos)};
 }
 
+std::vector<size_t> invertPermutation(const std::vector<size_t>& perm, size_t dataSize) {
+  for (size_t i : perm) {
+    dataSize = std::max(dataSize, i + 1);
+  }
+  std::vector<size_t> inverse(dataSize, INVALID_IND);
+  for (size_t i = 0; i < perm.size(); i++) {
+    if (inverse[perm[i]] == INVALID_IND) inverse[perm[i]] = i;
+  }
+  return inverse;
+}
+
+const std::vector<size_t>& cachedPermutationInverse(const std::vector<size_t>& perm, size_t dataSize,
+                                                     std::vector<size_t>& cache) {
+  if (cache.empty() && !perm.empty()) {
+    cache = invertPermutation(perm, dataSize);
+  }
+  return cache;
+}
+
+uint64_t spreadBits3(uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | (x << 32)) & 0x1f00000000ffffull;
+  x = (x | (x << 16)) & 0x1f0000ff0000ffull;
+  x = (x | (x << 8)) & 0x100f00f00f00f00full;
+  x = (x | (x << 4)) & 0x10c30c30c30c30c3ull;
+  x = (x | (x << 2)) & 0x1249249249249249ull;
+  return x;
+}
+
+uint32_t floatOrderKey(float x) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+float floatFromOrderKey(uint32_t key) {
+  uint32_t bits = (key & 0x80000000u) ? (key & 0x7FFFFFFFu) : ~key;
+  float x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+std::vector<uint32_t> mortonOrder(const std::vector<glm::vec3>& points) {
+  size_t n = points.size();
+  auto isFinite = [](glm::vec3 p) { return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z); };
+
+  glm::vec3 bboxMin{std::numeric_limits<float>::infinity()};
+  glm::vec3 bboxMax{-std::numeric_limits<float>::infinity()};
+  for (const glm::vec3& p : points) {
+    if (!isFinite(p)) continue;
+    bboxMin = glm::min(bboxMin, p);
+    bboxMax = glm::max(bboxMax, p);
+  }
+  glm::vec3 extent = glm::max(bboxMax - bboxMin, glm::vec3{std::numeric_limits<float>::min()});
+
+  std::vector<uint64_t> keys(n);
+  std::vector<size_t> sorted(n);
+  parallelFor(0, n, [&](size_t i) {
+    sorted[i] = i;
+    keys[i] = 0;
+    if (!isFinite(points[i])) return;
+    glm::vec3 cell = glm::clamp((points[i] - bboxMin) / extent, 0.f, 1.f) * 65535.f;
+    keys[i] = spreadBits3(static_cast<uint64_t>(cell.x)) << 2 | spreadBits3(static_cast<uint64_t>(cell.y)) << 1 |
+              spreadBits3(static_cast<uint64_t>(cell.z));
+  });
+  parallelSortByKey(keys, sorted, 48);
+  return std::vector<uint32_t>(sorted.begin(), sorted.end());
+}
+
+void computePointSetExtents(const std::vector<glm::vec3>& points, glm::vec3& bboxMin, glm::vec3& bboxMax,
+                            float& lengthScale, const std::vector<glm::vec3>& extraPoints) {
+
+  // Bound blocks of points, recording the points which attain the bounds along each axis
+  const size_t blockSize = 4096;
+  struct Block {
+    glm::vec3 bboxMin, bboxMax;
+    std::array<glm::vec3, 6> extremes;
+    float maxDist2;
+  };
+  std::vector<Block> blocks((points.size() + blockSize - 1) / blockSize);
+  parallelFor(
+      0, blocks.size(),
+      [&](size_t iBlock) {
+        Block& block = blocks[iBlock];
+        size_t start = iBlock * blockSize;
+        size_t end = std::min(start + blockSize, points.size());
+        block.bboxMin = block.bboxMax = points[start];
+        block.extremes.fill(points[start]);
+        for (size_t i = start + 1; i < end; i++) {
+          const glm::vec3& p = points[i];
+          for (int j = 0; j < 3; j++) {
+            if (p[j] < block.bboxMin[j]) {
+              block.bboxMin[j] = p[j];
+              block.extremes[2 * j] = p;
+            }
+            if (p[j] > block.bboxMax[j]) {
+              block.bboxMax[j] = p[j];
+              block.extremes[2 * j + 1] = p;
+            }
+          }
+        }
+      },
+      1);
+
+  bboxMin = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  bboxMax = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
+  for (const Block& block : blocks) {
+    bboxMin = componentwiseMin(bboxMin, block.bboxMin);
+    bboxMax = componentwiseMax(bboxMax, block.bboxMax);
+  }
+  for (const glm::vec3& p : extraPoints) {
+    bboxMin = componentwiseMin(bboxMin, p);
+    bboxMax = componentwiseMax(bboxMax, p);
+  }
+  glm::vec3 center = 0.5f * (bboxMin + bboxMax);
+
+  // The extreme points give a lower bound on the largest distance, only blocks whose box reaches past it need a scan
+  float maxDist2 = 0.;
+  for (const Block& block : blocks) {
+    for (const glm::vec3& p : block.extremes) {
+      maxDist2 = std::max(maxDist2, glm::dot(p - center, p - center));
+    }
+  }
+  for (const glm::vec3& p : extraPoints) {
+    maxDist2 = std::max(maxDist2, glm::dot(p - center, p - center));
+  }
+  parallelFor(
+      0, blocks.size(),
+      [&](size_t iBlock) {
+        Block& block = blocks[iBlock];
+        block.maxDist2 = 0.;
+        glm::vec3 farCorner = glm::max(glm::abs(block.bboxMin - center), glm::abs(block.bboxMax - center));
+        if (glm::dot(farCorner, farCorner) <= maxDist2) return;
+        size_t start = iBlock * blockSize;
+        size_t end = std::min(start + blockSize, points.size());
+        for (size_t i = start; i < end; i++) {
+          glm::vec3 d = points[i] - center;
+          block.maxDist2 = std::max(block.maxDist2, glm::dot(d, d));
+        }
+      },
+      1);
+  for (const Block& block : blocks) {
+    maxDist2 = std::max(maxDist2, block.maxDist2);
+  }
+
+  lengthScale = 2 * std::sqrt(maxDist2);
+}
+
 void splitTransform(const glm::mat4& trans, glm::mat3x4& R, glm::vec3& T) {
   for (int i = 0; i < 3; i++) {
     for (int j = 0; j < 4; j++) {
@@ -116,4 +268,22 @@ std::string prettyPrintCount(size_t count) {
   }
 }
 
+std::string prettyPrintBytes(size_t nBytes) {
+  const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+  size_t iUnit = 0;
+  double size = nBytes;
+  while (size >= 1024. && iUnit + 1 < sizeof(units) / sizeof(units[0])) {
+    size /= 1024.;
+    iUnit++;
+  }
+
+  char buf[50];
+  if (iUnit == 0) {
+    snprintf(buf, 50, "%zu %s", nBytes, units[0]);
+  } else {
+    snprintf(buf, 50, "%.1f %s", size, units[iUnit]);
+  }
+  return std::string(buf);
+}
+
 } // namespace polyscope
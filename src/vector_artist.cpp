@@ -1,76 +1,260 @@
 // Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
 #include "polyscope/vector_artist.h"
 
+#include "polyscope/parallel.h"
+#include "polyscope/utilities.h"
+
 #include "imgui.h"
 
+#include <cmath>
+#include <limits>
+#include <mutex>
+
 
 namespace polyscope {
 
+namespace {
+
+// Octree depth of the decimation priority order, with 21 bits per axis in its 63 bit Morton codes
+const int decimationDepth = 21;
+
+// A well-mixed 32 bit hash of an index, to shuffle the vectors within an octree level
+uint32_t hashIndex(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return static_cast<uint32_t>(x);
+}
+
+} // namespace
+
 VectorArtist::VectorArtist(Structure& parentStructure_, std::string uniqueName_, const std::vector<glm::vec3>& bases_,
                            const std::vector<glm::vec3>& vectors_, const VectorType& vectorType_)
+    : VectorArtist(parentStructure_, uniqueName_, &bases_, nullptr, vectors_, vectorType_) {}
+
+VectorArtist::VectorArtist(Structure& parentStructure_, std::string uniqueName_,
+                           std::shared_ptr<render::AttributeBuffer> baseBuffer_,
+                           const std::vector<glm::vec3>& vectors_, const VectorType& vectorType_,
+                           const std::vector<glm::vec3>* hostBases_)
+    : VectorArtist(parentStructure_, uniqueName_, hostBases_, baseBuffer_, vectors_, vectorType_) {}
+
+VectorArtist::VectorArtist(Structure& parentStructure_, std::string uniqueName_, const std::vector<glm::vec3>* bases_,
+                           std::shared_ptr<render::AttributeBuffer> baseBuffer_,
+                           const std::vector<glm::vec3>& vectors_, const VectorType& vectorType_)
     : parentStructure(parentStructure_), uniqueName(uniqueName_),
       uniquePrefix(parentStructure.uniquePrefix() + "#" + uniqueName), vectorType(vectorType_), bases(bases_),
-      vectors(vectors_), vectorLengthMult(uniquePrefix + "#vectorLengthMult",
+      baseBuffer(baseBuffer_), vectors(vectors_), vectorLengthMult(uniquePrefix + "#vectorLengthMult",
                                           vectorType == VectorType::AMBIENT ? absoluteValue(1.0) : relativeValue(0.02)),
       vectorRadius(uniquePrefix + "#vectorRadius", relativeValue(0.0025)),
-      vectorColor(uniquePrefix + "#vectorColor", getNextUniqueColor()), material(uniquePrefix + "#material", "clay") {
+      vectorColor(uniquePrefix + "#vectorColor", getNextUniqueColor()), material(uniquePrefix + "#material", "clay"),
+      decimationEnabled(uniquePrefix + "#decimationEnabled", false),
+      decimationSpacing(uniquePrefix + "#decimationSpacing", 8.) {
 
   updateMaxLength();
 }
 
-void VectorArtist::updateMaxLength() {
-  // compute the max length
-  maxLength = 0.;
-  for (const glm::vec3& vec : vectors) {
-    double l2 = glm::length2(vec);
-    if (!std::isfinite(l2)) continue;
-    maxLength = std::fmax(maxLength, l2);
-  }
+void VectorArtist::updateMaxLength() { maxLength = computeMaxLength(vectors); }
+
+double VectorArtist::computeMaxLength(const std::vector<glm::vec3>& vectors) {
+  double maxLength = 0.;
+  std::mutex resultMutex;
+  parallelForBlocks(
+      0, vectors.size(),
+      [&](size_t blockStart, size_t blockEnd) {
+        double blockMax = 0.;
+        for (size_t i = blockStart; i < blockEnd; i++) {
+          double l2 = glm::length2(vectors[i]);
+          if (!std::isfinite(l2)) continue;
+          blockMax = std::fmax(blockMax, l2);
+        }
+        std::lock_guard<std::mutex> lock(resultMutex);
+        maxLength = std::fmax(maxLength, blockMax);
+      },
+      1 << 16);
   maxLength = std::sqrt(maxLength);
   if (maxLength == 0.) maxLength = 1e-16;
+  return maxLength;
+}
+
+void VectorArtist::vectorsChanged() {
+  updateMaxLength();
+  if (program) {
+    program->setAttribute("a_vector", vectors, true);
+  }
+  if (decimatedProgram) {
+    std::vector<glm::vec3> orderedVectors(decimatedOrder.size());
+    parallelFor(0, decimatedOrder.size(), [&](size_t iS) { orderedVectors[iS] = vectors[decimatedOrder[iS]]; });
+    decimatedProgram->setAttribute("a_vector", orderedVectors, true);
+  }
+  requestRedraw();
+}
+
+void VectorArtist::setMaxLength(double newVal) {
+  maxLength = newVal;
+  requestRedraw();
 }
 
 void VectorArtist::draw() {
-  if (program == nullptr) {
+  bool decimate = getDecimationEnabled() && supportsDecimation();
+  if (decimate && decimatedProgram == nullptr) {
+    createDecimatedProgram();
+  }
+  if (!decimate && program == nullptr) {
     createProgram();
   }
+  render::ShaderProgram& p = decimate ? *decimatedProgram : *program;
 
   // Set uniforms
-  parentStructure.setStructureUniforms(*program);
+  parentStructure.setStructureUniforms(p);
 
-  program->setUniform("u_radius", vectorRadius.get().asAbsolute());
-  program->setUniform("u_baseColor", vectorColor.get());
+  p.setUniform("u_radius", vectorRadius.get().asAbsolute());
+  p.setUniform("u_baseColor", vectorColor.get());
 
   if (vectorType == VectorType::AMBIENT) {
-    program->setUniform("u_lengthMult", 1.0);
+    p.setUniform("u_lengthMult", 1.0);
   } else {
-    program->setUniform("u_lengthMult", vectorLengthMult.get().asAbsolute() / maxLength);
+    p.setUniform("u_lengthMult", vectorLengthMult.get().asAbsolute() / maxLength);
   }
 
   glm::mat4 P = view::getCameraPerspectiveMatrix();
   glm::mat4 Pinv = glm::inverse(P);
-  program->setUniform("u_invProjMatrix", glm::value_ptr(Pinv));
-  program->setUniform("u_viewport", render::engine->getCurrentViewport());
+  p.setUniform("u_invProjMatrix", glm::value_ptr(Pinv));
+  p.setUniform("u_viewport", render::engine->getCurrentViewport());
 
-  program->draw();
+  if (decimate) {
+    nDrawn = decimatedDrawCount();
+    p.setDrawLimit(nDrawn);
+  } else {
+    nDrawn = vectors.size();
+  }
+
+  p.draw();
 }
 
-void VectorArtist::createProgram() {
+std::shared_ptr<render::ShaderProgram> VectorArtist::requestProgram() {
 
   std::vector<std::string> rules = parentStructure.addStructureRules({"SHADE_BASECOLOR"});
   if (parentStructure.wantsCullPosition()) {
     rules.push_back("VECTOR_CULLPOS_FROM_TAIL");
   }
 
-  program = render::engine->requestShader("RAYCAST_VECTOR", rules);
+  if (render::engine->useInstancedDrawing(vectors.size())) {
+    return render::engine->requestShader("RAYCAST_VECTOR_INSTANCED", rules);
+  }
+  return render::engine->requestShader("RAYCAST_VECTOR", rules);
+}
+
+void VectorArtist::createProgram() {
+  program = requestProgram();
 
   // Fill buffers
   program->setAttribute("a_vector", vectors);
-  program->setAttribute("a_position", bases);
+  if (baseBuffer) {
+    program->setAttribute("a_position", baseBuffer);
+  } else {
+    program->setAttribute("a_position", *bases);
+  }
 
   render::engine->setMaterial(*program, material.get());
 }
 
+void VectorArtist::createDecimatedProgram() {
+  size_t n = vectors.size();
+
+  basesMin = glm::vec3{std::numeric_limits<float>::infinity()};
+  basesMax = glm::vec3{-std::numeric_limits<float>::infinity()};
+  for (const glm::vec3& b : *bases) {
+    basesMin = glm::min(basesMin, b);
+    basesMax = glm::max(basesMax, b);
+  }
+
+  // Sort the vectors along a Morton curve through their bases. Each vector is then the first in its octree cell at one
+  // more than the depth of the cell it shares with the previous vector, so it belongs to that level of the order.
+  glm::vec3 extent = glm::max(basesMax - basesMin, glm::vec3{std::numeric_limits<float>::min()});
+  const float cellMax = static_cast<float>((1 << decimationDepth) - 1);
+  std::vector<uint64_t> keys(n);
+  std::vector<size_t> order(n);
+  parallelFor(0, n, [&](size_t i) {
+    glm::vec3 cell = glm::clamp(((*bases)[i] - basesMin) / extent, 0.f, 1.f) * cellMax;
+    keys[i] = spreadBits3(static_cast<uint64_t>(cell.x)) << 2 | spreadBits3(static_cast<uint64_t>(cell.y)) << 1 |
+              spreadBits3(static_cast<uint64_t>(cell.z));
+    order[i] = i;
+  });
+  parallelSortByKey(keys, order, 3 * decimationDepth);
+
+  std::vector<uint64_t> levelKeys(n);
+  parallelFor(0, n, [&](size_t iS) {
+    uint64_t level = 0;
+    if (iS > 0) {
+      uint64_t diff = keys[iS] ^ keys[iS - 1];
+      if (diff == 0) {
+        level = decimationDepth + 1;
+      } else {
+        int highBit = 3 * decimationDepth - 1;
+        while (((diff >> highBit) & 1) == 0) highBit--;
+        level = (3 * decimationDepth - 1 - highBit) / 3 + 1;
+      }
+    }
+    levelKeys[iS] = level << 32 | hashIndex(order[iS]);
+  });
+  parallelSortByKey(levelKeys, order, 37);
+
+  levelEnd.assign(decimationDepth + 2, 0);
+  for (uint64_t k : levelKeys) {
+    levelEnd[k >> 32]++;
+  }
+  for (size_t l = 1; l < levelEnd.size(); l++) {
+    levelEnd[l] += levelEnd[l - 1];
+  }
+
+  std::vector<glm::vec3> orderedBases(n);
+  std::vector<glm::vec3> orderedVectors(n);
+  parallelFor(0, n, [&](size_t iS) {
+    orderedBases[iS] = (*bases)[order[iS]];
+    orderedVectors[iS] = vectors[order[iS]];
+  });
+
+  decimatedOrder = std::move(order);
+
+  decimatedProgram = requestProgram();
+  decimatedProgram->setAttribute("a_vector", orderedVectors);
+  decimatedProgram->setAttribute("a_position", orderedBases);
+  render::engine->setMaterial(*decimatedProgram, material.get());
+}
+
+size_t VectorArtist::decimatedDrawCount() {
+  size_t n = vectors.size();
+  if (n == 0) return 0;
+
+  // The extent of the bases' bounding box on the screen, in pixels
+  glm::mat4 viewProj = view::getCameraPerspectiveMatrix() * parentStructure.getModelView();
+  glm::vec2 pixelScale{0.5f * view::bufferWidth, 0.5f * view::bufferHeight};
+  glm::vec2 screenMin{std::numeric_limits<float>::infinity()};
+  glm::vec2 screenMax{-std::numeric_limits<float>::infinity()};
+  for (int iC = 0; iC < 8; iC++) {
+    glm::vec3 corner{(iC & 1) ? basesMax.x : basesMin.x, (iC & 2) ? basesMax.y : basesMin.y,
+                     (iC & 4) ? basesMax.z : basesMin.z};
+    glm::vec4 clip = viewProj * glm::vec4(corner, 1.f);
+    if (clip.w <= 0.f) return n; // the camera is among the vectors, nothing to gain
+    glm::vec2 screen = glm::vec2(clip.x, clip.y) / clip.w * pixelScale;
+    screenMin = glm::min(screenMin, screen);
+    screenMax = glm::max(screenMax, screen);
+  }
+  float screenExtent = std::fmax(screenMax.x - screenMin.x, screenMax.y - screenMin.y);
+
+  // Octree cells at depth l are about screenExtent / 2^l pixels across. Draw every level whose cells are wider than the
+  // spacing, and a matching share of the next, so that the count changes smoothly while zooming.
+  float level = std::log2(std::fmax(screenExtent / decimationSpacing.get(), 1.f));
+  if (!(level < decimationDepth)) return n;
+  size_t fullLevels = static_cast<size_t>(level);
+  float partial = level - static_cast<float>(fullLevels);
+  size_t count = levelEnd[fullLevels];
+  count += static_cast<size_t>(partial * static_cast<float>(levelEnd[fullLevels + 1] - levelEnd[fullLevels]));
+  return count;
+}
+
 void VectorArtist::buildParametersUI() {
 
   if (ImGui::ColorEdit3("Color", &vectorColor.get()[0], ImGuiColorEditFlags_NoInputs)) setVectorColor(getVectorColor());
@@ -85,6 +269,10 @@ void VectorArtist::buildParametersUI() {
       material.manuallyChanged();
       setMaterial(material.get()); // trigger the other updates that happen on set()
     }
+    if (supportsDecimation()) {
+      if (ImGui::MenuItem("Decimate to screen density", nullptr, getDecimationEnabled()))
+        setDecimationEnabled(!getDecimationEnabled());
+    }
     ImGui::EndPopup();
   }
 
@@ -103,6 +291,14 @@ void VectorArtist::buildParametersUI() {
     requestRedraw();
   }
 
+  if (getDecimationEnabled() && supportsDecimation()) {
+    if (ImGui::SliderFloat("Spacing (px)", &decimationSpacing.get(), 1., 64., "%.1f",
+                           ImGuiSliderFlags_Logarithmic)) {
+      decimationSpacing.manuallyChanged();
+      requestRedraw();
+    }
+  }
+
   //{ // Draw max and min magnitude
   // ImGui::TextUnformatted(mapper.printBounds().c_str());
   //}
@@ -129,9 +325,22 @@ glm::vec3 VectorArtist::getVectorColor() { return vectorColor.get(); }
 void VectorArtist::setMaterial(std::string m) {
   material = m;
   if (program) render::engine->setMaterial(*program, getMaterial());
+  if (decimatedProgram) render::engine->setMaterial(*decimatedProgram, getMaterial());
   requestRedraw();
 }
 std::string VectorArtist::getMaterial() { return material.get(); }
 
+void VectorArtist::setDecimationEnabled(bool newVal) {
+  decimationEnabled = newVal;
+  requestRedraw();
+}
+bool VectorArtist::getDecimationEnabled() { return decimationEnabled.get(); }
+
+void VectorArtist::setDecimationSpacing(double pixels) {
+  decimationSpacing = static_cast<float>(pixels);
+  requestRedraw();
+}
+double VectorArtist::getDecimationSpacing() { return decimationSpacing.get(); }
+
 
 } // namespace polyscope
@@ -31,6 +31,9 @@ double fov = defaultFov;
 double nearClipRatio = defaultNearClipRatio;
 double farClipRatio = defaultFarClipRatio;
 ProjectionMode projectionMode = ProjectionMode::Perspective;
+ProjectionTile projectionTile;
+ViewRegion viewRegion;
+glm::vec2 projectionJitter{0., 0.};
 std::array<float, 4> bgColor{{1.0, 1.0, 1.0, 0.0}};
 
 glm::mat4x4 viewMat;
@@ -377,26 +380,78 @@ void setViewToCamera(const CameraParameters& p) {
 
 glm::mat4 getCameraViewMatrix() { return viewMat; }
 
+namespace {
+
+// Scales and shifts the projection of the whole image so the projection tile (if any) fills clip space
+glm::mat4 projectionTileMatrix() {
+  glm::mat4 tileMat(1.0f);
+  if (projectionTile.active) {
+    double imageW = projectionTile.imageWidth;
+    double imageH = projectionTile.imageHeight;
+    double scaleX = imageW / bufferWidth;
+    double scaleY = imageH / bufferHeight;
+    double centerX = (2. * projectionTile.x + bufferWidth) / imageW - 1.;
+    double centerY = 1. - (2. * projectionTile.y + bufferHeight) / imageH;
+    tileMat[0][0] = scaleX;
+    tileMat[1][1] = scaleY;
+    tileMat[3][0] = -centerX * scaleX;
+    tileMat[3][1] = -centerY * scaleY;
+  }
+  return tileMat;
+}
+
+} // namespace
+
 glm::mat4 getCameraPerspectiveMatrix() {
   double farClip = farClipRatio * state::lengthScale;
   double nearClip = nearClipRatio * state::lengthScale;
   double fovRad = glm::radians(fov);
   double aspectRatio = (float)bufferWidth / bufferHeight;
+  if (projectionTile.active) {
+    aspectRatio = static_cast<double>(projectionTile.imageWidth) / projectionTile.imageHeight;
+  }
+
+  // When drawing in to a region, squeeze clip space in to its part of the image
+  glm::mat4 regionMat(1.0f);
+  if (viewRegion.active) {
+    glm::vec4 r = viewRegion.rect;
+    aspectRatio *= r[2] / r[3];
+    regionMat[0][0] = r[2];
+    regionMat[1][1] = r[3];
+    regionMat[3][0] = 2. * r[0] + r[2] - 1.;
+    regionMat[3][1] = 2. * r[1] + r[3] - 1.;
+  }
+
+  glm::mat4 tileMat = projectionTileMatrix();
+  tileMat[3][0] += 2. * projectionJitter.x / bufferWidth;
+  tileMat[3][1] += 2. * projectionJitter.y / bufferHeight;
+  tileMat = tileMat * regionMat;
+
   switch (projectionMode) {
   case ProjectionMode::Perspective: {
-    return glm::perspective(fovRad, aspectRatio, nearClip, farClip);
+    return tileMat * glm::mat4(glm::perspective(fovRad, aspectRatio, nearClip, farClip));
     break;
   }
   case ProjectionMode::Orthographic: {
     double vert = tan(fovRad / 2.) * state::lengthScale * 2.;
     double horiz = vert * aspectRatio;
-    return glm::ortho(-horiz, horiz, -vert, vert, nearClip, farClip);
+    return tileMat * glm::mat4(glm::ortho(-horiz, horiz, -vert, vert, nearClip, farClip));
     break;
   }
   }
   return glm::mat4(1.0f); // unreachable
 }
 
+glm::vec4 getViewRegionInBuffer() {
+  glm::vec4 r = viewRegion.active ? viewRegion.rect : glm::vec4{0., 0., 1., 1.};
+  glm::mat4 tileMat = projectionTileMatrix();
+  glm::vec4 lowNDC = tileMat * glm::vec4{2. * r[0] - 1., 2. * r[1] - 1., 0., 1.};
+  glm::vec4 highNDC = tileMat * glm::vec4{2. * (r[0] + r[2]) - 1., 2. * (r[1] + r[3]) - 1., 0., 1.};
+  glm::vec2 low = 0.5f * (glm::vec2(lowNDC) + 1.f);
+  glm::vec2 high = 0.5f * (glm::vec2(highNDC) + 1.f);
+  return glm::vec4{low, high - low};
+}
+
 
 glm::vec3 getCameraWorldPosition() {
   // This will work no matter how the view matrix is constructed...
@@ -431,6 +486,25 @@ glm::vec3 screenCoordsToWorldRay(glm::vec2 screenCoords) {
   return worldRayDir;
 }
 
+bool boxMayBeInView(glm::vec3 bboxMin, glm::vec3 bboxMax, const glm::mat4& toClip) {
+  // The box is outside if all of its corners are on the far side of the same clip plane
+  std::array<glm::vec4, 8> clip;
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 c{(i & 1) ? bboxMax.x : bboxMin.x, (i & 2) ? bboxMax.y : bboxMin.y, (i & 4) ? bboxMax.z : bboxMin.z};
+    clip[i] = toClip * glm::vec4(c, 1.);
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    bool allBelow = true;
+    bool allAbove = true;
+    for (const glm::vec4& c : clip) {
+      allBelow = allBelow && c[axis] < -c.w;
+      allAbove = allAbove && c[axis] > c.w;
+    }
+    if (allBelow || allAbove) return false;
+  }
+  return true;
+}
+
 void startFlightTo(const CameraParameters& p, float flightLengthInSeconds) {
   // startFlightTo(p.E, glm::degrees(2 * std::atan(1. / (2. * p.focalLengths.y))),
   //               flightLengthInSeconds);
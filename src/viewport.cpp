@@ -0,0 +1,180 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/viewport.h"
+
+#include "polyscope/messages.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/structure.h"
+#include "polyscope/view.h"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+
+namespace polyscope {
+
+namespace {
+
+std::vector<std::unique_ptr<Viewport>> viewports;
+Viewport* activeViewport = nullptr;
+
+bool isValidViewMatrix(const glm::mat4& m) {
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      if (!std::isfinite(m[i][j])) return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+Viewport::Viewport(std::string name_, glm::vec4 region_)
+    : name(name_), region(region_), viewMat(std::numeric_limits<float>::quiet_NaN()), fov(view::fov),
+      projectionMode(view::projectionMode) {}
+
+void Viewport::setRegion(glm::vec4 newRegion) {
+  region = newRegion;
+  requestRedraw();
+}
+glm::vec4 Viewport::getRegion() { return region; }
+
+void Viewport::setViewToCamera(const CameraParameters& p) {
+  viewMat = p.E;
+  fov = p.fov;
+  requestRedraw();
+}
+
+void Viewport::lookAt(glm::vec3 cameraLocation, glm::vec3 target) {
+  activate();
+  view::lookAt(cameraLocation, target);
+  deactivate();
+}
+
+glm::mat4 Viewport::getViewMatrix() { return viewMat; }
+
+void Viewport::setProjectionMode(ProjectionMode newMode) {
+  projectionMode = newMode;
+  requestRedraw();
+}
+ProjectionMode Viewport::getProjectionMode() { return projectionMode; }
+
+void Viewport::setStructureVisible(Structure* s, bool visible) {
+  std::pair<std::string, std::string> key{s->typeName(), s->name};
+  if (visible) {
+    hiddenStructures.erase(key);
+  } else {
+    hiddenStructures.insert(key);
+  }
+  requestRedraw();
+}
+
+bool Viewport::isStructureVisible(Structure* s) {
+  return hiddenStructures.find({s->typeName(), s->name}) == hiddenStructures.end();
+}
+
+void Viewport::activate() {
+  if (activeViewport != nullptr) {
+    throw std::runtime_error("viewport " + name + " activated while viewport " + activeViewport->name + " is active");
+  }
+
+  mainViewMat = view::viewMat;
+  mainFov = view::fov;
+  mainProjectionMode = view::projectionMode;
+
+  if (!isValidViewMatrix(viewMat)) {
+    viewMat = mainViewMat; // (which may not be valid yet either, in which case the main view's fallback applies)
+  }
+  view::viewMat = viewMat;
+  view::fov = fov;
+  view::projectionMode = projectionMode;
+  view::viewRegion.active = true;
+  view::viewRegion.rect = region;
+  activeViewport = this;
+}
+
+void Viewport::deactivate() {
+  if (activeViewport != this) return;
+
+  // keep any changes made to the camera while active, such as by navigation
+  viewMat = view::viewMat;
+  fov = view::fov;
+  projectionMode = view::projectionMode;
+
+  view::viewMat = mainViewMat;
+  view::fov = mainFov;
+  view::projectionMode = mainProjectionMode;
+  view::viewRegion.active = false;
+  if (render::engine) render::engine->disableScissor();
+  activeViewport = nullptr;
+}
+
+Viewport* addViewport(std::string name, glm::vec4 region) {
+  for (std::unique_ptr<Viewport>& v : viewports) {
+    if (v->name == name) {
+      v.reset(new Viewport(name, region));
+      requestRedraw();
+      return v.get();
+    }
+  }
+  viewports.emplace_back(new Viewport(name, region));
+  requestRedraw();
+  return viewports.back().get();
+}
+
+Viewport* getViewport(std::string name) {
+  for (std::unique_ptr<Viewport>& v : viewports) {
+    if (v->name == name) return v.get();
+  }
+  error("No viewport with name " + name);
+  return nullptr;
+}
+
+bool hasViewport(std::string name) {
+  for (std::unique_ptr<Viewport>& v : viewports) {
+    if (v->name == name) return true;
+  }
+  return false;
+}
+
+void removeViewport(std::string name) {
+  for (size_t i = 0; i < viewports.size(); i++) {
+    if (viewports[i]->name == name) {
+      viewports.erase(viewports.begin() + i);
+      requestRedraw();
+      return;
+    }
+  }
+  error("No viewport with name " + name);
+}
+
+void removeAllViewports() {
+  viewports.clear();
+  requestRedraw();
+}
+
+bool haveViewports() { return !viewports.empty(); }
+
+Viewport* getActiveViewport() { return activeViewport; }
+
+Viewport* getViewportAt(glm::vec2 screenCoords) {
+  glm::vec2 p{screenCoords.x, 1.f - screenCoords.y}; // (regions are from the bottom left)
+  for (std::unique_ptr<Viewport>& v : viewports) {
+    glm::vec4 r = v->getRegion();
+    if (p.x >= r[0] && p.x < r[0] + r[2] && p.y >= r[1] && p.y < r[1] + r[3]) return v.get();
+  }
+  return nullptr;
+}
+
+void forEachViewport(const std::function<void()>& f) {
+  if (viewports.empty() || activeViewport != nullptr) {
+    f();
+    return;
+  }
+  for (std::unique_ptr<Viewport>& v : viewports) {
+    v->activate();
+    f();
+    v->deactivate();
+  }
+}
+
+} // namespace polyscope
@@ -0,0 +1,144 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/volume_grid.h"
+
+#include "polyscope/polyscope.h"
+#include "polyscope/render/engine.h"
+
+#include "imgui.h"
+
+#include <array>
+#include <utility>
+
+namespace polyscope {
+
+// Initialize statics
+const std::string VolumeGrid::structureTypeName = "Volume Grid";
+
+// Constructor
+VolumeGrid::VolumeGrid(std::string name, glm::uvec3 gridNodeDim_, glm::vec3 boundMin_, glm::vec3 boundMax_)
+    : QuantityStructure<VolumeGrid>(name, typeName()), gridNodeDim(gridNodeDim_), boundMin(boundMin_),
+      boundMax(boundMax_), stepsPerCell(uniquePrefix() + "#stepsPerCell", 2.) {
+
+  if (gridNodeDim.x < 2 || gridNodeDim.y < 2 || gridNodeDim.z < 2) {
+    error("VolumeGrid [" + name + "] needs at least 2 nodes along each axis, but was given " +
+          std::to_string(gridNodeDim.x) + " x " + std::to_string(gridNodeDim.y) + " x " +
+          std::to_string(gridNodeDim.z));
+  }
+
+  updateObjectSpaceBounds();
+}
+
+void VolumeGrid::setVolumeGridUniforms(render::ShaderProgram& p) {
+  glm::vec3 extent = boundMax - boundMin;
+  p.setUniform("u_boundMin", boundMin);
+  p.setUniform("u_boundExtent", extent);
+  p.setUniform("u_gridNodeDim", glm::vec3(gridNodeDim));
+  p.setUniform("u_stepsPerCell", getStepsPerCell());
+
+  // Rays start at the camera, in the coordinates where the box is the unit cube. When the camera is inside of the box
+  // there are no front faces in view, so the back faces are drawn instead.
+  glm::vec4 cameraObject = glm::inverse(objectTransform.get()) * glm::vec4(view::getCameraWorldPosition(), 1.);
+  glm::vec3 cameraGrid = (glm::vec3(cameraObject) / cameraObject.w - boundMin) / extent;
+  bool cameraOutside = glm::any(glm::lessThan(cameraGrid, glm::vec3(0.))) ||
+                       glm::any(glm::greaterThan(cameraGrid, glm::vec3(1.)));
+  p.setUniform("u_cameraGridPos", cameraGrid);
+  p.setUniform("u_drawFrontFaces", cameraOutside ? 1 : 0);
+}
+
+void VolumeGrid::fillGeometryBuffers(render::ShaderProgram& p) {
+  // Two triangles for each face of the unit cube, wound counter-clockwise seen from outside
+  std::vector<glm::vec3> positions;
+  for (int axis = 0; axis < 3; axis++) {
+    for (int side = 0; side < 2; side++) {
+      std::array<glm::vec3, 4> corners;
+      for (int iC = 0; iC < 4; iC++) {
+        corners[iC][axis] = static_cast<float>(side);
+        corners[iC][(axis + 1) % 3] = (iC == 1 || iC == 2) ? 1. : 0.;
+        corners[iC][(axis + 2) % 3] = (iC >= 2) ? 1. : 0.;
+      }
+      if (side == 0) std::swap(corners[1], corners[3]);
+      for (int iC : {0, 1, 2, 0, 2, 3}) {
+        positions.push_back(corners[iC]);
+      }
+    }
+  }
+  p.setAttribute("a_position", positions);
+}
+
+std::vector<std::string> VolumeGrid::addVolumeGridRules(std::vector<std::string> initRules) {
+  // (not addStructureRules(): the ray march culls samples against slice planes, rather than whole fragments)
+  if (render::engine->slicePlanesEnabled()) {
+    initRules.push_back("VOLUME_GRID_SLICE_PLANE_CULL");
+  }
+  return initRules;
+}
+
+void VolumeGrid::draw() {
+  if (!isEnabled()) {
+    return;
+  }
+
+  // Draw the quantities
+  for (QuantityType* q : getEnabledQuantities()) {
+    q->drawTracked();
+  }
+}
+
+void VolumeGrid::drawPick() {}
+
+void VolumeGrid::buildPickUI(size_t localPickID) {}
+
+void VolumeGrid::buildCustomUI() {
+  ImGui::Text("nodes: %u x %u x %u", gridNodeDim.x, gridNodeDim.y, gridNodeDim.z);
+  ImGui::PushItemWidth(100);
+  if (ImGui::SliderFloat("Steps per cell", &stepsPerCell.get(), 0.25, 8., "%.2f", ImGuiSliderFlags_Logarithmic)) {
+    stepsPerCell.manuallyChanged();
+    requestRedraw();
+  }
+  ImGui::PopItemWidth();
+}
+
+void VolumeGrid::refresh() {
+  requestRedraw();
+  QuantityStructure<VolumeGrid>::refresh(); // call base class version, which refreshes quantities
+}
+
+void VolumeGrid::updateObjectSpaceBounds() {
+  objectSpaceBoundingBox = std::make_tuple(boundMin, boundMax);
+  objectSpaceLengthScale = glm::length(boundMax - boundMin);
+  boundsChanged();
+}
+
+std::string VolumeGrid::typeName() { return structureTypeName; }
+
+VolumeGrid* VolumeGrid::setStepsPerCell(float newVal) {
+  stepsPerCell = newVal;
+  requestRedraw();
+  return this;
+}
+float VolumeGrid::getStepsPerCell() { return stepsPerCell.get(); }
+
+// === Quantities
+
+VolumeGridQuantity::VolumeGridQuantity(std::string name_, VolumeGrid& grid_, bool dominates_)
+    : Quantity<VolumeGrid>(name_, grid_, dominates_) {}
+
+VolumeGridScalarQuantity* VolumeGrid::addScalarQuantityImpl(std::string name, const std::vector<double>& data,
+                                                            DataType type) {
+  VolumeGridScalarQuantity* q = new VolumeGridScalarQuantity(name, *this, data, type);
+  addQuantity(q);
+  return q;
+}
+
+VolumeGrid* registerVolumeGrid(std::string name, glm::uvec3 gridNodeDim, glm::vec3 boundMin, glm::vec3 boundMax) {
+  checkInitialized();
+
+  VolumeGrid* s = new VolumeGrid(name, gridNodeDim, boundMin, boundMax);
+  bool success = registerStructure(s);
+  if (!success) {
+    safeDelete(s);
+  }
+  return s;
+}
+
+} // namespace polyscope
@@ -0,0 +1,251 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/volume_grid_scalar_quantity.h"
+
+#include "polyscope/parallel.h"
+#include "polyscope/polyscope.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace polyscope {
+
+const unsigned int VolumeGridScalarQuantity::brickSize;
+
+VolumeGridScalarQuantity::VolumeGridScalarQuantity(std::string name, VolumeGrid& grid_,
+                                                   const std::vector<double>& values_, DataType dataType_)
+    : VolumeGridQuantity(name, grid_, true), ScalarQuantity(*this, values_, dataType_),
+      opacity(uniquePrefix() + "#opacity", 0.5), sparseBricks(uniquePrefix() + "#sparseBricks", false),
+      valueFormat(options::volumeGridHalfPrecision ? TextureFormat::R16F : TextureFormat::R32F) {}
+
+glm::uvec3 VolumeGridScalarQuantity::brickCount() const {
+  // brick b holds nodes [b * brickSize, (b + 1) * brickSize], so neighboring bricks share a layer of nodes
+  glm::uvec3 nodeDim = parent.getGridNodeDim();
+  glm::uvec3 count;
+  for (int i = 0; i < 3; i++) {
+    unsigned int nCells = nodeDim[i] > 0 ? nodeDim[i] - 1 : 0;
+    count[i] = std::max(1u, (nCells + brickSize - 1) / brickSize);
+  }
+  return count;
+}
+
+void VolumeGridScalarQuantity::draw() {
+  if (!isEnabled()) return;
+
+  if (program == nullptr) {
+    createProgram();
+  }
+
+  // Set uniforms
+  parent.setStructureUniforms(*program);
+  parent.setVolumeGridUniforms(*program);
+  setColorMapTexture(*program);
+  program->setUniform("u_rangeLow", vizRange.first);
+  program->setUniform("u_rangeHigh", vizRange.second);
+  program->setUniform("u_opacity", getOpacity());
+  program->setUniform("u_brickSize", static_cast<float>(brickSize));
+
+  // The volume is blended over whatever is behind it, and does not hide anything drawn later
+  render::engine->setDepthMode(DepthMode::LEqualReadOnly);
+  render::engine->setBlendMode(BlendMode::Over);
+
+  program->draw();
+
+  render::engine->setDepthMode();
+  render::engine->setBlendMode();
+}
+
+void VolumeGridScalarQuantity::createProgram() {
+  std::string sampleRule = getSparseBricks() ? "VOLUME_GRID_SAMPLE_BRICKED" : "VOLUME_GRID_SAMPLE_DENSE";
+  program = render::engine->requestShader("VOLUME_GRID_RAYMARCH", parent.addVolumeGridRules({sampleRule}),
+                                          render::ShaderReplacementDefaults::Process);
+  parent.fillGeometryBuffers(*program);
+  program->setTextureFromColormap("t_colormap", cMap.get());
+
+  // The values never change, so textures outlive programs (which are rebuilt by refresh())
+  if (brickMaxTexture == nullptr) {
+    if (getSparseBricks()) {
+      fillBrickedTextures();
+    } else {
+      fillDenseTextures();
+    }
+  }
+
+  program->setTextureFromBuffer("t_brickMax", brickMaxTexture.get());
+  if (getSparseBricks()) {
+    program->setTextureFromBuffer("t_brickAtlas", brickAtlasTexture.get());
+    program->setTextureFromBuffer("t_brickIndex", brickIndexTexture.get());
+  } else {
+    program->setTextureFromBuffer("t_values", valueTexture.get());
+  }
+}
+
+namespace {
+
+// Smallest and largest value in each brick, with the bricks in the same x-fastest order as the nodes
+void computeBrickRanges(const VolumeGrid& grid, const ScalarArray& values, glm::uvec3 brickCount,
+                        unsigned int brickSize, std::vector<float>& brickMin, std::vector<float>& brickMax) {
+  size_t nBricks = static_cast<size_t>(brickCount.x) * brickCount.y * brickCount.z;
+  glm::uvec3 nodeDim = grid.getGridNodeDim();
+  brickMin.resize(nBricks);
+  brickMax.resize(nBricks);
+  parallelFor(
+      0, nBricks,
+      [&](size_t iB) {
+        glm::uvec3 b(iB % brickCount.x, (iB / brickCount.x) % brickCount.y, iB / (brickCount.x * brickCount.y));
+        glm::uvec3 lo = b * brickSize;
+        glm::uvec3 hi = glm::min(lo + brickSize, nodeDim - 1u);
+        float minVal = std::numeric_limits<float>::infinity();
+        float maxVal = -std::numeric_limits<float>::infinity();
+        for (unsigned int k = lo.z; k <= hi.z; k++) {
+          for (unsigned int j = lo.y; j <= hi.y; j++) {
+            for (unsigned int i = lo.x; i <= hi.x; i++) {
+              float val = static_cast<float>(values[grid.flattenNodeIndex({i, j, k})]);
+              minVal = std::min(minVal, val);
+              maxVal = std::max(maxVal, val);
+            }
+          }
+        }
+        brickMin[iB] = minVal;
+        brickMax[iB] = maxVal;
+      },
+      16);
+}
+
+} // namespace
+
+void VolumeGridScalarQuantity::fillDenseTextures() {
+  glm::uvec3 nodeDim = parent.getGridNodeDim();
+  glm::uvec3 bricks = brickCount();
+
+  std::vector<float> brickMin, brickMax;
+  computeBrickRanges(parent, values, bricks, brickSize, brickMin, brickMax);
+  brickMaxTexture = render::engine->generateTextureBuffer(TextureFormat::R32F, bricks.x, bricks.y, bricks.z,
+                                                          &brickMax[0]);
+
+  std::vector<float> nodeValues(values.size());
+  parallelFor(0, nodeValues.size(), [&](size_t i) { nodeValues[i] = static_cast<float>(values[i]); });
+  valueTexture = render::engine->generateTextureBuffer(valueFormat, nodeDim.x, nodeDim.y, nodeDim.z, &nodeValues[0]);
+  valueTexture->setFilterMode(FilterMode::Linear);
+}
+
+void VolumeGridScalarQuantity::fillBrickedTextures() {
+  glm::uvec3 nodeDim = parent.getGridNodeDim();
+  glm::uvec3 bricks = brickCount();
+
+  std::vector<float> brickMin, brickMax;
+  computeBrickRanges(parent, values, bricks, brickSize, brickMin, brickMax);
+  brickMaxTexture = render::engine->generateTextureBuffer(TextureFormat::R32F, bricks.x, bricks.y, bricks.z,
+                                                          &brickMax[0]);
+
+  // Only bricks with more than one value are stored. The others are sampled as their value, from the index.
+  std::vector<size_t> stored;
+  for (size_t iB = 0; iB < brickMax.size(); iB++) {
+    if (!(brickMin[iB] == brickMax[iB])) stored.push_back(iB);
+  }
+
+  // Pack the stored bricks in to a roughly cubical block of slots
+  const unsigned int span = brickSize + 1;
+  double nStored = static_cast<double>(stored.size());
+  unsigned int slotsX = std::max(1u, static_cast<unsigned int>(std::ceil(std::cbrt(nStored))));
+  unsigned int slotsZ = std::max(1u, static_cast<unsigned int>(std::ceil(nStored / (slotsX * slotsX))));
+  glm::uvec3 slots{slotsX, slotsX, slotsZ};
+  glm::uvec3 atlasDim = slots * span;
+
+  std::vector<float> atlas(static_cast<size_t>(atlasDim.x) * atlasDim.y * atlasDim.z, 0.f);
+  std::vector<glm::vec4> index(brickMax.size());
+  for (size_t iB = 0; iB < index.size(); iB++) {
+    index[iB] = glm::vec4{-1., 0., 0., brickMin[iB]};
+  }
+  parallelFor(
+      0, stored.size(),
+      [&](size_t iS) {
+        size_t iB = stored[iS];
+        glm::uvec3 b(iB % bricks.x, (iB / bricks.x) % bricks.y, iB / (bricks.x * bricks.y));
+        glm::uvec3 slot(iS % slots.x, (iS / slots.x) % slots.y, iS / (slots.x * slots.y));
+        glm::uvec3 offset = slot * span;
+        index[iB] = glm::vec4{glm::vec3(offset), 0.};
+
+        // (nodes past the end of the grid repeat its last layer, they are never interpolated with)
+        for (unsigned int k = 0; k < span; k++) {
+          for (unsigned int j = 0; j < span; j++) {
+            for (unsigned int i = 0; i < span; i++) {
+              glm::uvec3 node = glm::min(b * brickSize + glm::uvec3{i, j, k}, nodeDim - 1u);
+              glm::uvec3 texel = offset + glm::uvec3{i, j, k};
+              size_t iTexel = texel.x + atlasDim.x * (texel.y + static_cast<size_t>(atlasDim.y) * texel.z);
+              atlas[iTexel] = static_cast<float>(values[parent.flattenNodeIndex(node)]);
+            }
+          }
+        }
+      },
+      16);
+
+  brickIndexTexture = render::engine->generateTextureBuffer(TextureFormat::RGBA32F, bricks.x, bricks.y, bricks.z,
+                                                            reinterpret_cast<float*>(&index[0]));
+  brickAtlasTexture =
+      render::engine->generateTextureBuffer(valueFormat, atlasDim.x, atlasDim.y, atlasDim.z, &atlas[0]);
+  brickAtlasTexture->setFilterMode(FilterMode::Linear);
+}
+
+void VolumeGridScalarQuantity::buildCustomUI() {
+  ImGui::SameLine();
+
+  // == Options popup
+  if (ImGui::Button("Options")) {
+    ImGui::OpenPopup("OptionsPopup");
+  }
+  if (ImGui::BeginPopup("OptionsPopup")) {
+    if (ImGui::MenuItem("Reset colormap range")) resetMapRange();
+    if (ImGui::MenuItem("Sparse bricks", NULL, sparseBricks.get())) setSparseBricks(!sparseBricks.get());
+    ImGui::EndPopup();
+  }
+
+  buildScalarUI();
+
+  ImGui::PushItemWidth(100);
+  if (ImGui::SliderFloat("Opacity", &opacity.get(), 0., 1., "%.3f")) {
+    opacity.manuallyChanged();
+    requestRedraw();
+  }
+  ImGui::PopItemWidth();
+}
+
+void VolumeGridScalarQuantity::refresh() {
+  program.reset();
+  Quantity::refresh();
+}
+
+void VolumeGridScalarQuantity::releaseRenderData() {
+  valueTexture.reset();
+  brickAtlasTexture.reset();
+  brickIndexTexture.reset();
+  brickMaxTexture.reset();
+  refresh();
+}
+
+void VolumeGridScalarQuantity::dataUpdated() {
+  releaseRenderData(); // (the textures, and the bricks stored in them, follow the values)
+}
+
+VolumeGridScalarQuantity* VolumeGridScalarQuantity::setOpacity(float newVal) {
+  opacity = newVal;
+  requestRedraw();
+  return this;
+}
+float VolumeGridScalarQuantity::getOpacity() { return opacity.get(); }
+
+VolumeGridScalarQuantity* VolumeGridScalarQuantity::setSparseBricks(bool newVal) {
+  sparseBricks = newVal;
+  releaseRenderData(); // the textures are laid out differently
+  requestRedraw();
+  return this;
+}
+bool VolumeGridScalarQuantity::getSparseBricks() { return sparseBricks.get(); }
+
+std::string VolumeGridScalarQuantity::niceName() { return name + " (node scalar)"; }
+
+size_t VolumeGridScalarQuantity::hostMemoryUsage() { return values.allocatedBytes(); }
+
+} // namespace polyscope
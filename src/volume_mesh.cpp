@@ -2,7 +2,8 @@
 #include "polyscope/volume_mesh.h"
 
 #include "polyscope/color_management.h"
-#include "polyscope/combining_hash_functions.h"
+#include "polyscope/internal.h"
+#include "polyscope/parallel.h"
 #include "polyscope/pick.h"
 #include "polyscope/polyscope.h"
 #include "polyscope/render/engine.h"
@@ -12,7 +13,6 @@
 
 #include <algorithm>
 #include <numeric>
-#include <unordered_map>
 #include <utility>
 
 namespace polyscope {
@@ -94,9 +94,11 @@ const std::vector<std::vector<std::array<size_t, 3>>> VolumeMesh::stencilHex =
 // clang-format on
 
 VolumeMesh::VolumeMesh(std::string name, const std::vector<glm::vec3>& vertexPositions,
-                       const std::vector<std::array<int64_t, 8>>& cellIndices)
-    : QuantityStructure<VolumeMesh>(name, typeName()), vertices(vertexPositions), cells(cellIndices),
-      color(uniquePrefix() + "color", getNextUniqueColor()),
+                       std::vector<uint32_t> cellIndsEntries_, std::vector<uint32_t> cellIndsStart_,
+                       size_t uniformCellDegree_, bool computeDerived)
+    : QuantityStructure<VolumeMesh>(name, typeName()), vertices(vertexPositions),
+      cellIndsEntries(std::move(cellIndsEntries_)), cellIndsStart(std::move(cellIndsStart_)),
+      uniformCellDegree(uniformCellDegree_), color(uniquePrefix() + "color", getNextUniqueColor()),
       interiorColor(uniquePrefix() + "interiorColor", color.get()),
       edgeColor(uniquePrefix() + "edgeColor", glm::vec3{0., 0., 0.}), material(uniquePrefix() + "material", "clay"),
       edgeWidth(uniquePrefix() + "edgeWidth", 0.), activeLevelSetQuantity(nullptr) {
@@ -108,123 +110,210 @@ VolumeMesh::VolumeMesh(std::string name, const std::vector<glm::vec3>& vertexPos
   interiorColor.setPassive(HSVtoRGB(desatColorHSV));
 
   updateObjectSpaceBounds();
+  if (computeDerived) {
+    validateCells();
+    computeCounts();
+    computeGeometryData();
+  }
+}
+
+VolumeMesh::VolumeMesh(std::string name, const std::vector<glm::vec3>& vertexPositions,
+                       std::vector<uint32_t> cellIndsEntries_, std::vector<uint32_t> cellIndsStart_,
+                       size_t uniformCellDegree_)
+    : VolumeMesh(name, vertexPositions, std::move(cellIndsEntries_), std::move(cellIndsStart_), uniformCellDegree_,
+                 true) {}
+
+namespace {
+
+// Vertex indices and cell entry positions are stored in 32 bits (see VolumeMesh::cellIndsEntries), on purpose, as for
+// surface meshes: a mesh past that would need far more GPU memory than can be had to draw, while the narrower indices
+// take a half to a quarter of the cell storage of every mesh which can be drawn. So there is no wider fallback, and
+// larger meshes are turned away when they are set.
+void checkElementCount(const std::string& name, size_t count, const std::string& elements) {
+  if (count > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error(name + " has " + std::to_string(count) + " " + elements +
+                             ", volume meshes index them with 32 bits so there must be fewer than 2^32");
+  }
+}
+
+// Flatten cells of 8 indices, where tets pad the last 4 with a negative value
+void flattenCells(const std::string& name, const std::vector<std::array<int64_t, 8>>& cellIndices,
+                  std::vector<uint32_t>& entries, std::vector<uint32_t>& starts, size_t& uniformDegree) {
+  size_t nTets = 0;
+  for (const std::array<int64_t, 8>& c : cellIndices) {
+    if (c[4] < 0) nTets++;
+  }
+  size_t nEntries = 4 * nTets + 8 * (cellIndices.size() - nTets);
+  checkElementCount(name, nEntries, "cell entries");
+
+  bool mixed = nTets != 0 && nTets != cellIndices.size();
+  uniformDegree = nTets == cellIndices.size() ? 4 : 8;
+  entries.reserve(nEntries);
+  if (mixed) {
+    starts.reserve(cellIndices.size() + 1);
+    starts.push_back(0);
+  }
+  for (const std::array<int64_t, 8>& c : cellIndices) {
+    size_t D = c[4] < 0 ? 4 : 8;
+    for (size_t j = 0; j < D; j++) {
+      // (a negative index in a used slot becomes an out of range one)
+      uint64_t iV = static_cast<uint64_t>(c[j]);
+      entries.push_back(static_cast<uint32_t>(std::min<uint64_t>(iV, std::numeric_limits<uint32_t>::max())));
+    }
+    if (mixed) starts.push_back(static_cast<uint32_t>(entries.size()));
+  }
+}
+
+} // namespace
+
+VolumeMesh::VolumeMesh(std::string name, const std::vector<glm::vec3>& vertexPositions,
+                       const std::vector<std::array<int64_t, 8>>& cellIndices)
+    : VolumeMesh(name, vertexPositions, {}, {}, 4, false) {
+  flattenCells(name, cellIndices, cellIndsEntries, cellIndsStart, uniformCellDegree);
+  validateCells();
   computeCounts();
   computeGeometryData();
 }
 
+void VolumeMesh::validateCells() {
+  checkElementCount(name, nVertices(), "vertices");
+  checkElementCount(name, cellIndsEntries.size(), "cell entries");
+  if (cellIndsStart.empty()) {
+    if ((uniformCellDegree != 4 && uniformCellDegree != 8) || cellIndsEntries.size() % uniformCellDegree != 0) {
+      throw std::invalid_argument(name + ": without cell starts, the cells must all be tets (4) or all hexes (8)");
+    }
+    nCellsCount = cellIndsEntries.size() / uniformCellDegree;
+  } else {
+    if (cellIndsStart.front() != 0 || cellIndsStart.back() != cellIndsEntries.size()) {
+      throw std::invalid_argument(name + ": cell starts should run from 0 to the number of cell entries");
+    }
+    nCellsCount = cellIndsStart.size() - 1;
+    bool uniform = true;
+    for (size_t iC = 0; iC < nCellsCount; iC++) {
+      size_t D = cellIndsStart[iC + 1] - cellIndsStart[iC];
+      if (D != 4 && D != 8) {
+        throw std::invalid_argument(name + " has cell with " + std::to_string(D) + " vertices, only tets and hexes");
+      }
+      uniform = uniform && D == cellDegree(0);
+    }
+    if (uniform) {
+      if (nCellsCount > 0) uniformCellDegree = cellDegree(0);
+      cellIndsStart.clear();
+    }
+  }
+
+  // Sanitize, so everything after can assume valid indices
+  const std::string rangeWarning = name + " has cell with vertex index out of vertices range";
+  for (size_t iC = 0; iC < nCellsCount; iC++) {
+    size_t iStart = cellStart(iC);
+    size_t D = cellDegree(iC);
+    for (size_t j = 0; j < D; j++) {
+      if (cellIndsEntries[iStart + j] >= nVertices()) {
+        warning(rangeWarning, "cell " + std::to_string(iC) + " has vertex index " +
+                                  std::to_string(cellIndsEntries[iStart + j]));
+        // (just to do _something_ so we don't crash in subsequent code)
+        std::fill(cellIndsEntries.begin() + iStart, cellIndsEntries.begin() + iStart + D, 0);
+        break;
+      }
+    }
+  }
+}
+
+VolumeMesh::~VolumeMesh() {
+  fillTask.reset(); // (waits for it)
+}
+
 void VolumeMesh::computeTets() {
   // Algorithm from
   // https://www.researchgate.net/profile/Julien-Dompierre/publication/221561839_How_to_Subdivide_Pyramids_Prisms_and_Hexahedra_into_Tetrahedra/links/0912f509c0b7294059000000/How-to-Subdivide-Pyramids-Prisms-and-Hexahedra-into-Tetrahedra.pdf?origin=publication_detail
   // It's a bit hard to look at but it works
   // Uses vertex numberings to ensure consistent diagonals between faces, and keeps tet counts to 5 or 6 per hex
-  size_t tetCount = 0;
-  // Get number of tets first
-  for (size_t iC = 0; iC < nCells(); iC++) {
+
+  // Rotates a hex so that its minimum vertex number comes first, and returns the number of diagonals not incident to
+  // that vertex (none makes 5 tets, otherwise 6)
+  auto orientHex = [this](size_t iC, std::array<size_t, 8>& rotatedNumbering) -> size_t {
+    IndexView c = cell(iC);
+    std::array<size_t, 8> sortedNumbering;
+    std::iota(sortedNumbering.begin(), sortedNumbering.end(), 0);
+    std::sort(sortedNumbering.begin(), sortedNumbering.end(),
+              [&c](size_t a, size_t b) -> bool { return c[a] < c[b]; });
+    std::copy(rotationMap[sortedNumbering[0]].begin(), rotationMap[sortedNumbering[0]].end(),
+              rotatedNumbering.begin());
+    size_t n = 0;
+    size_t diagCount = 0;
+    // Diagonal exists on the pair of vertices which contain the minimum vertex number
+    auto checkDiagonal = [&c, &rotatedNumbering](size_t a1, size_t a2, size_t b1, size_t b2) {
+      return (c[rotatedNumbering[a1]] < c[rotatedNumbering[b1]] && c[rotatedNumbering[a1]] < c[rotatedNumbering[b2]]) ||
+             (c[rotatedNumbering[a2]] < c[rotatedNumbering[b1]] && c[rotatedNumbering[a2]] < c[rotatedNumbering[b2]]);
+    };
+    // Minimum vertex will always have 3 diagonals, check other three faces
+    if (checkDiagonal(1, 7, 2, 5)) {
+      n += 4;
+      diagCount++;
+    }
+    if (checkDiagonal(3, 7, 2, 6)) {
+      n += 2;
+      diagCount++;
+    }
+    if (checkDiagonal(4, 7, 5, 6)) {
+      n += 1;
+      diagCount++;
+    }
+    // Rotate by 120 or 240 degrees depending on diagonal positions
+    if (n == 1 || n == 6) {
+      size_t temp = rotatedNumbering[1];
+      rotatedNumbering[1] = rotatedNumbering[4];
+      rotatedNumbering[4] = rotatedNumbering[3];
+      rotatedNumbering[3] = temp;
+      temp = rotatedNumbering[5];
+      rotatedNumbering[5] = rotatedNumbering[6];
+      rotatedNumbering[6] = rotatedNumbering[2];
+      rotatedNumbering[2] = temp;
+    } else if (n == 2 || n == 5) {
+      size_t temp = rotatedNumbering[1];
+      rotatedNumbering[1] = rotatedNumbering[3];
+      rotatedNumbering[3] = rotatedNumbering[4];
+      rotatedNumbering[4] = temp;
+      temp = rotatedNumbering[5];
+      rotatedNumbering[5] = rotatedNumbering[2];
+      rotatedNumbering[2] = rotatedNumbering[6];
+      rotatedNumbering[6] = temp;
+    }
+    return diagCount;
+  };
+
+  // Count the tets of each cell, then scan the counts for where each cell's tets start
+  std::vector<size_t> tetStart(nCells() + 1, 0);
+  parallelFor(0, nCells(), [&](size_t iC) {
     switch (cellType(iC)) {
     case VolumeCellType::HEX: {
-      std::array<size_t, 8> sortedNumbering;
-      std::iota(sortedNumbering.begin(), sortedNumbering.end(), 0);
-      std::sort(sortedNumbering.begin(), sortedNumbering.end(),
-                [this, iC](size_t a, size_t b) -> bool { return cells[iC][a] < cells[iC][b]; });
       std::array<size_t, 8> rotatedNumbering;
-      std::copy(rotationMap[sortedNumbering[0]].begin(), rotationMap[sortedNumbering[0]].end(),
-                rotatedNumbering.begin());
-      size_t n = 0;
-      size_t diagCount = 0;
-      auto checkDiagonal = [this, rotatedNumbering, iC](size_t a1, size_t a2, size_t b1, size_t b2) {
-        return (cells[iC][rotatedNumbering[a1]] < cells[iC][rotatedNumbering[b1]] &&
-                cells[iC][rotatedNumbering[a1]] < cells[iC][rotatedNumbering[b2]]) ||
-               (cells[iC][rotatedNumbering[a2]] < cells[iC][rotatedNumbering[b1]] &&
-                cells[iC][rotatedNumbering[a2]] < cells[iC][rotatedNumbering[b2]]);
-      };
-      if (checkDiagonal(1, 7, 2, 5)) {
-        n += 4;
-        diagCount++;
-      }
-      if (checkDiagonal(3, 7, 2, 6)) {
-        n += 2;
-        diagCount++;
-      }
-      if (checkDiagonal(4, 7, 5, 6)) {
-        n += 1;
-        diagCount++;
-      }
-      if (diagCount == 0) {
-        tetCount += 5;
-      } else {
-        tetCount += 6;
-      }
+      tetStart[iC + 1] = orientHex(iC, rotatedNumbering) == 0 ? 5 : 6;
       break;
     }
     case VolumeCellType::TET:
-      tetCount += 1;
+      tetStart[iC + 1] = 1;
       break;
     }
-  }
-  // Mark each edge as real or not (in the original mesh)
-  std::vector<std::array<bool, 6>> realEdges;
-  // Each hex can make up to 6 tets
-  tets.resize(tetCount);
-  realEdges.resize(tetCount);
-  size_t tetIdx = 0;
-  for (size_t iC = 0; iC < nCells(); iC++) {
+  });
+  std::partial_sum(tetStart.begin(), tetStart.end(), tetStart.begin());
+  cellTetStart.assign(tetStart.begin(), tetStart.end());
+
+  // Each cell writes its own tets
+  tets.resize(tetStart.back());
+  parallelFor(0, nCells(), [&](size_t iC) {
+    IndexView c = cell(iC);
+    size_t tetIdx = tetStart[iC];
     switch (cellType(iC)) {
     case VolumeCellType::HEX: {
-      std::array<size_t, 8> sortedNumbering;
-      std::iota(sortedNumbering.begin(), sortedNumbering.end(), 0);
-      std::sort(sortedNumbering.begin(), sortedNumbering.end(),
-                [this, iC](size_t a, size_t b) -> bool { return cells[iC][a] < cells[iC][b]; });
       std::array<size_t, 8> rotatedNumbering;
-      std::copy(rotationMap[sortedNumbering[0]].begin(), rotationMap[sortedNumbering[0]].end(),
-                rotatedNumbering.begin());
-      size_t n = 0;
-      size_t diagCount = 0;
-      // Diagonal exists on the pair of vertices which contain the minimum vertex number
-      auto checkDiagonal = [this, rotatedNumbering, iC](size_t a1, size_t a2, size_t b1, size_t b2) {
-        return (cells[iC][rotatedNumbering[a1]] < cells[iC][rotatedNumbering[b1]] &&
-                cells[iC][rotatedNumbering[a1]] < cells[iC][rotatedNumbering[b2]]) ||
-               (cells[iC][rotatedNumbering[a2]] < cells[iC][rotatedNumbering[b1]] &&
-                cells[iC][rotatedNumbering[a2]] < cells[iC][rotatedNumbering[b2]]);
-      };
-      // Minimum vertex will always have 3 diagonals, check other three faces
-      if (checkDiagonal(1, 7, 2, 5)) {
-        n += 4;
-        diagCount++;
-      }
-      if (checkDiagonal(3, 7, 2, 6)) {
-        n += 2;
-        diagCount++;
-      }
-      if (checkDiagonal(4, 7, 5, 6)) {
-        n += 1;
-        diagCount++;
-      }
-      // Rotate by 120 or 240 degrees depending on diagonal positions
-      if (n == 1 || n == 6) {
-        size_t temp = rotatedNumbering[1];
-        rotatedNumbering[1] = rotatedNumbering[4];
-        rotatedNumbering[4] = rotatedNumbering[3];
-        rotatedNumbering[3] = temp;
-        temp = rotatedNumbering[5];
-        rotatedNumbering[5] = rotatedNumbering[6];
-        rotatedNumbering[6] = rotatedNumbering[2];
-        rotatedNumbering[2] = temp;
-      } else if (n == 2 || n == 5) {
-        size_t temp = rotatedNumbering[1];
-        rotatedNumbering[1] = rotatedNumbering[3];
-        rotatedNumbering[3] = rotatedNumbering[4];
-        rotatedNumbering[4] = temp;
-        temp = rotatedNumbering[5];
-        rotatedNumbering[5] = rotatedNumbering[2];
-        rotatedNumbering[2] = rotatedNumbering[6];
-        rotatedNumbering[6] = temp;
-      }
+      size_t diagCount = orientHex(iC, rotatedNumbering);
 
       // Map final tets according to diagonalMap and the number of diagonals not incident to V_0
-      std::array<std::array<size_t, 4>, 6> tetMap = diagonalMap[diagCount];
+      const std::array<std::array<size_t, 4>, 6>& tetMap = diagonalMap[diagCount];
       for (size_t k = 0; k < (diagCount == 0 ? 5 : 6); k++) {
         for (size_t i = 0; i < 4; i++) {
-          tets[tetIdx][i] = cells[iC][rotatedNumbering[tetMap[k][i]]];
+          tets[tetIdx][i] = c[rotatedNumbering[tetMap[k][i]]];
         }
         tetIdx++;
       }
@@ -232,12 +321,11 @@ void VolumeMesh::computeTets() {
     }
     case VolumeCellType::TET:
       for (size_t i = 0; i < 4; i++) {
-        tets[tetIdx][i] = cells[iC][i];
+        tets[tetIdx][i] = c[i];
       }
-      tetIdx++;
       break;
     }
-  }
+  });
 }
 
 void VolumeMesh::ensureHaveTets() {
@@ -251,6 +339,10 @@ size_t VolumeMesh::nTets() {
   return tets.size();
 }
 
+size_t VolumeMesh::tetCell(size_t iT) const {
+  return std::upper_bound(cellTetStart.begin(), cellTetStart.end(), iT) - cellTetStart.begin() - 1;
+}
+
 void VolumeMesh::addSlicePlaneListener(polyscope::SlicePlane* sp) { volumeSlicePlaneListeners.push_back(sp); }
 
 void VolumeMesh::removeSlicePlaneListener(polyscope::SlicePlane* sp) {
@@ -260,36 +352,111 @@ void VolumeMesh::removeSlicePlaneListener(polyscope::SlicePlane* sp) {
       break;
     }
   }
+  sliceTetSelections.erase(sp);
+  for (auto& q : quantities) {
+    q.second->removeSlicePlane(sp);
+  }
 }
 
-void VolumeMesh::fillSliceGeometryBuffers(render::ShaderProgram& program) {
+void VolumeMesh::ensureSliceTetBuffers() {
 
   ensureHaveTets();
 
-  std::vector<glm::vec3> point1;
-  std::vector<glm::vec3> point2;
-  std::vector<glm::vec3> point3;
-  std::vector<glm::vec3> point4;
-  size_t tetCount = tets.size();
-  point1.resize(tetCount);
-  point2.resize(tetCount);
-  point3.resize(tetCount);
-  point4.resize(tetCount);
-  for (size_t tetIdx = 0; tetIdx < tets.size(); tetIdx++) {
-    point1[tetIdx] = vertices[tets[tetIdx][0]];
-    point2[tetIdx] = vertices[tets[tetIdx][1]];
-    point3[tetIdx] = vertices[tets[tetIdx][2]];
-    point4[tetIdx] = vertices[tets[tetIdx][3]];
+  // Each tet only carries the indices of its vertices, the shader looks positions and vertex values up from textures
+  render::ScopedGPUMemoryAccount account(gpuMemory);
+  if (!sliceTetVertexBuffers[0]) {
+    std::vector<uint32_t> tetVertex(tets.size());
+    for (size_t k = 0; k < 4; k++) {
+      for (size_t iT = 0; iT < tets.size(); iT++) {
+        tetVertex[iT] = static_cast<uint32_t>(tets[iT][k]);
+      }
+      sliceTetVertexBuffers[k] = render::engine->generateAttributeBuffer(render::DataType::UInt);
+      sliceTetVertexBuffers[k]->setData(tetVertex);
+    }
+  }
+  if (!sliceVertexPositionTexture) {
+    sliceVertexPositionTexture = render::engine->generateElementTexture(vertices);
+  }
+}
+
+void VolumeMesh::fillSliceGeometryBuffers(render::ShaderProgram& program) {
+  ensureSliceTetBuffers();
+  setTetVertexBuffers(program, sliceTetVertexBuffers);
+  program.setTextureFromBuffer("t_vertexPositions", sliceVertexPositionTexture.get());
+  if (program.hasAttribute("a_tetCell")) {
+    if (!sliceTetCellBuffer) {
+      std::vector<uint32_t> allTets(tets.size());
+      std::iota(allTets.begin(), allTets.end(), 0);
+      render::ScopedGPUMemoryAccount account(gpuMemory);
+      fillTetCellBuffer(sliceTetCellBuffer, allTets);
+    }
+    program.setAttribute("a_tetCell", sliceTetCellBuffer);
+  }
+}
+
+size_t VolumeMesh::setSliceTetBuffers(render::ShaderProgram& p, polyscope::SlicePlane* sp) {
+  ensureSliceTetBuffers();
+
+  // The slice shader compares the plane against vertex positions as stored, so the selection does the same
+  glm::vec3 normal = sp->getNormal();
+  float offset = glm::dot(sp->getCenter(), normal);
+
+  SliceTetSelection& selection = sliceTetSelections[sp];
+  if (!selection.tetVertexBuffers[0] || selection.normal != normal || selection.offset != offset) {
+    if (!sliceTetBVH) {
+      sliceTetBVH.reset(new VolumeMeshTetBVH(vertices, tets));
+    }
+    selection.tetInds = sliceTetBVH->tetsCrossingPlane(vertices, tets, normal, offset);
+    selection.normal = normal;
+    selection.offset = offset;
+    selection.tetCellsFilled = false;
+
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    fillTetVertexBuffers(selection.tetVertexBuffers, selection.tetInds);
+  }
+
+  setTetVertexBuffers(p, selection.tetVertexBuffers);
+
+  // Programs drawing cell data also need the cell of each tet
+  if (p.hasAttribute("a_tetCell")) {
+    if (!selection.tetCellsFilled) {
+      render::ScopedGPUMemoryAccount account(gpuMemory);
+      fillTetCellBuffer(selection.tetCellBuffer, selection.tetInds);
+      selection.tetCellsFilled = true;
+    }
+    p.setAttribute("a_tetCell", selection.tetCellBuffer);
+  }
+
+  return selection.tetInds.size();
+}
+
+void VolumeMesh::fillTetVertexBuffers(TetVertexBuffers& buffers, const std::vector<uint32_t>& tetInds) {
+  std::vector<uint32_t> tetVertex(tetInds.size());
+  for (size_t k = 0; k < 4; k++) {
+    for (size_t i = 0; i < tetInds.size(); i++) {
+      tetVertex[i] = static_cast<uint32_t>(tets[tetInds[i]][k]);
+    }
+    if (!buffers[k]) {
+      buffers[k] = render::engine->generateAttributeBuffer(render::DataType::UInt);
+    }
+    buffers[k]->setData(tetVertex);
   }
+}
 
-  program.setAttribute("a_point_1", point1);
-  program.setAttribute("a_point_2", point2);
-  program.setAttribute("a_point_3", point3);
-  program.setAttribute("a_point_4", point4);
-  program.setAttribute("a_slice_1", point1);
-  program.setAttribute("a_slice_2", point2);
-  program.setAttribute("a_slice_3", point3);
-  program.setAttribute("a_slice_4", point4);
+void VolumeMesh::fillTetCellBuffer(std::shared_ptr<render::AttributeBuffer>& buffer,
+                                   const std::vector<uint32_t>& tetInds) {
+  std::vector<uint32_t> cellInds(tetInds.size());
+  parallelFor(0, tetInds.size(), [&](size_t i) { cellInds[i] = static_cast<uint32_t>(tetCell(tetInds[i])); });
+  if (!buffer) {
+    buffer = render::engine->generateAttributeBuffer(render::DataType::UInt);
+  }
+  buffer->setData(cellInds);
+}
+
+void VolumeMesh::setTetVertexBuffers(render::ShaderProgram& p, const TetVertexBuffers& buffers) {
+  for (size_t k = 0; k < 4; k++) {
+    p.setAttribute("a_tetVertex_" + std::to_string(k + 1), buffers[k]);
+  }
 }
 
 void VolumeMesh::computeCounts() {
@@ -304,68 +471,130 @@ void VolumeMesh::computeCounts() {
   cellDataSize = nCells();
 
   // ==== Populate interior/exterior faces
+  std::vector<size_t> cellFaceStart(nCells() + 1, 0);
   for (size_t iC = 0; iC < nCells(); iC++) {
-    const std::array<int64_t, 8>& cell = cells[iC];
-    VolumeCellType cellT = cellType(iC);
     // Iterate over faces
-    for (const std::vector<std::array<size_t, 3>>& face : cellStencil(cellT)) {
+    for (const std::vector<std::array<size_t, 3>>& face : cellStencil(cellType(iC))) {
       nFacesCount++;
       nFacesTriangulationCount += face.size();
     }
+    cellFaceStart[iC + 1] = nFacesCount;
   }
 
-  // == Step 1: count occurences of each face
-  std::unordered_map<std::array<int64_t, 4>, int, polyscope::hash_combine::hash<std::array<int64_t, 4>>> faceCounts;
-
-  std::set<size_t> faceInds; // Scratch map
-
-  // Build a sorted list of the indices of this face
-
-  // Helper to build a sorted-index array for a face
-  auto generateSortedFace = [&](const std::array<int64_t, 8>& cell, const std::vector<std::array<size_t, 3>>& face) {
-    faceInds.clear();
-    for (const std::array<size_t, 3>& tri : face) {
-      for (int j = 0; j < 3; j++) {
-        faceInds.insert(cell[tri[j]]);
+  // == Step 1: build the sorted vertex list of each face, padded with nVertices()
+  const uint32_t pad = static_cast<uint32_t>(nVertices());
+  std::vector<std::array<uint32_t, 4>> sortedFaces(nFacesCount);
+  parallelFor(0, nCells(), [&](size_t iC) {
+    IndexView cell = this->cell(iC);
+    size_t iF = cellFaceStart[iC];
+    for (const std::vector<std::array<size_t, 3>>& face : cellStencil(cellType(iC))) {
+      std::array<uint32_t, 6> inds; // (faces are at most two triangles)
+      size_t nInds = 0;
+      for (const std::array<size_t, 3>& tri : face) {
+        for (int j = 0; j < 3; j++) {
+          inds[nInds++] = cell[tri[j]];
+        }
       }
+      std::sort(inds.begin(), inds.begin() + nInds);
+      nInds = std::unique(inds.begin(), inds.begin() + nInds) - inds.begin();
+      std::array<uint32_t, 4> sortedFace{pad, pad, pad, pad};
+      std::copy(inds.begin(), inds.begin() + std::min<size_t>(nInds, 4), sortedFace.begin());
+      sortedFaces[iF++] = sortedFace;
     }
-    std::array<int64_t, 4> sortedFace{-1, -1, -1, -1};
-    int j = 0;
-    for (size_t ind : faceInds) {
-      sortedFace[j] = ind;
-      j++;
+  });
+
+  // == Step 2: sort the faces on their two smallest vertices. Faces seen more than once are interior; they land in the
+  // same run of equal keys, which holds only the few faces around one edge, so the runs are compared in full.
+  unsigned int vertexBits = 1;
+  while ((static_cast<uint64_t>(1) << vertexBits) < nVertices() + 1) vertexBits++;
+  std::vector<uint64_t> faceKeys(nFacesCount);
+  std::vector<size_t> sortedFaceInds(nFacesCount);
+  parallelFor(0, nFacesCount, [&](size_t iF) {
+    uint64_t vA = sortedFaces[iF][0];
+    uint64_t vB = sortedFaces[iF][1];
+    faceKeys[iF] = (vA << vertexBits) | vB;
+    sortedFaceInds[iF] = iF;
+  });
+  parallelSortByKey(faceKeys, sortedFaceInds, 2 * vertexBits);
+
+  faceIsInterior.assign(nFacesCount, 0);
+  parallelFor(0, nFacesCount, [&](size_t i) {
+    if (i > 0 && faceKeys[i - 1] == faceKeys[i]) return; // handled from the start of its run
+    size_t runEnd = i + 1;
+    while (runEnd < nFacesCount && faceKeys[runEnd] == faceKeys[i]) runEnd++;
+    for (size_t a = i; a < runEnd; a++) {
+      for (size_t b = a + 1; b < runEnd; b++) {
+        if (sortedFaces[sortedFaceInds[a]] == sortedFaces[sortedFaceInds[b]]) {
+          faceIsInterior[sortedFaceInds[a]] = 1;
+          faceIsInterior[sortedFaceInds[b]] = 1;
+        }
+      }
     }
-    return sortedFace;
-  };
+  });
 
-  // Iterate over cells
+  nExteriorFacesTriangulationCount = 0;
+  size_t iF = 0;
   for (size_t iC = 0; iC < nCells(); iC++) {
-    const std::array<int64_t, 8>& cell = cells[iC];
-    VolumeCellType cellT = cellType(iC);
-
-    // Iterate over faces
-    for (const std::vector<std::array<size_t, 3>>& face : cellStencil(cellT)) {
-      std::array<int64_t, 4> sortedFace = generateSortedFace(cell, face);
-      // Add to the count
-      if (faceCounts.find(sortedFace) == faceCounts.end()) {
-        faceCounts[sortedFace] = 0;
-      }
-      faceCounts[sortedFace]++;
+    for (const std::vector<std::array<size_t, 3>>& face : cellStencil(cellType(iC))) {
+      if (!faceIsInterior[iF]) nExteriorFacesTriangulationCount += face.size();
+      iF++;
     }
   }
+}
 
-  // Iterate a second time; all faces which were seen more than once are inteior
-  faceIsInterior.clear();
-  for (size_t iC = 0; iC < nCells(); iC++) {
-    const std::array<int64_t, 8>& cell = cells[iC];
-    VolumeCellType cellT = cellType(iC);
+VolumeMesh::TriangleSlots::TriangleSlots(size_t nExteriorTriangles, size_t nInteriorTriangles, bool withInterior_)
+    : withInterior(withInterior_),
+      bufferSize(3 * (withInterior_ ? nExteriorTriangles + nInteriorTriangles : nExteriorTriangles)),
+      iBack(bufferSize) {}
 
-    // Iterate over faces
-    for (const std::vector<std::array<size_t, 3>>& face : cellStencil(cellT)) {
-      std::array<int64_t, 4> sortedFace = generateSortedFace(cell, face);
-      faceIsInterior.push_back(faceCounts[sortedFace] > 1);
+bool VolumeMesh::TriangleSlots::next(bool isInterior, size_t& iData) {
+  if (!isInterior) {
+    iData = iFront;
+    iFront += 3;
+    return true;
+  }
+  if (!withInterior) return false;
+  iBack -= 3;
+  iData = iBack;
+  return true;
+}
+
+VolumeMesh::TriangleSlots VolumeMesh::drawnTriangleSlots() {
+  return TriangleSlots(nExteriorFacesTriangulation(), nFacesTriangulation() - nExteriorFacesTriangulation(),
+                       interiorFacesDrawn);
+}
+
+bool VolumeMesh::canUseCellTextures() {
+  const size_t maxExactIndex = static_cast<size_t>(1) << 24;
+  return nCells() <= maxExactIndex && nFacesTriangulation() <= maxExactIndex;
+}
+
+void VolumeMesh::setCellTextureUniforms(render::ShaderProgram& p) {
+  if (!triangleCellTexture) {
+    TriangleSlots slots = drawnTriangleSlots();
+    std::vector<float> triangleCell(slots.size() / 3);
+    size_t iF = 0;
+    for (size_t iC = 0; iC < nCells(); iC++) {
+      for (const std::vector<std::array<size_t, 3>>& face : cellStencil(cellType(iC))) {
+        for (size_t j = 0; j < face.size(); j++) {
+          size_t iData;
+          if (!slots.next(faceIsInterior[iF], iData)) continue;
+          triangleCell[iData / 3] = static_cast<float>(iC);
+        }
+        iF++;
+      }
     }
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    triangleCellTexture = render::engine->generateElementTexture(triangleCell);
   }
+  p.setTextureFromBuffer("t_triangleCell", triangleCellTexture.get());
+}
+
+void VolumeMesh::updateInteriorFaceVisibility() {
+  bool visible = wantsCullPosition() || getTransparency() < 1.;
+  if (visible == interiorFacesDrawn) return;
+  interiorFacesDrawn = visible;
+  refresh();
 }
 
 void VolumeMesh::computeGeometryData() {}
@@ -384,12 +613,18 @@ void VolumeMesh::draw() {
   if (!isEnabled()) {
     return;
   }
+  updateInteriorFaceVisibility();
 
   render::engine->setBackfaceCull();
 
   // If no quantity is drawing the volume, we should draw it
   if (dominantQuantity == nullptr) {
 
+    if (program == nullptr && nFacesTriangulation() >= options::backgroundPrepareMinTriangles) {
+      if (geometryFillPending()) {
+        return;
+      }
+    }
     if (program == nullptr) {
       prepare();
 
@@ -402,22 +637,22 @@ void VolumeMesh::draw() {
     setVolumeMeshUniforms(*program);
     glm::mat4 viewMat = getModelView();
     glm::mat4 projMat = view::getCameraPerspectiveMatrix();
-    program->setUniform("u_baseColor1", getColor());
-    program->setUniform("u_baseColor2", getInteriorColor());
+    program->setUniform(baseColor1Handle, getColor());
+    program->setUniform(baseColor2Handle, getInteriorColor());
 
     program->draw();
   }
 
   if (activeLevelSetQuantity != nullptr && activeLevelSetQuantity->isEnabled()) {
     // Draw the quantities
-    activeLevelSetQuantity->draw();
+    activeLevelSetQuantity->drawTracked();
 
     return;
   }
 
   // Draw the quantities
-  for (auto& x : quantities) {
-    x.second->draw();
+  for (QuantityType* q : getEnabledQuantities()) {
+    q->drawTracked();
   }
 }
 
@@ -425,6 +660,7 @@ void VolumeMesh::drawPick() {
   if (!isEnabled()) {
     return;
   }
+  updateInteriorFaceVisibility();
 
   if (pickProgram == nullptr) {
     preparePick();
@@ -437,13 +673,68 @@ void VolumeMesh::drawPick() {
   pickProgram->draw();
 }
 
+// The CPU side of the buffers of a program drawing the mesh
+struct VolumeMesh::GeometryData {
+  GeometryData(render::ShaderProgram& p, VolumeMesh& mesh)
+      : wantsEdge(mesh.getEdgeWidth() > 0), wantsBarycenters(mesh.wantsCullPosition()),
+        wantsFaceType(p.hasAttribute("a_faceColorType")) {}
+
+  bool wantsEdge, wantsBarycenters, wantsFaceType;
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec3> edgeReal;
+  std::vector<double> faceTypes;
+  std::vector<glm::vec3> barycenters;
+};
+
 void VolumeMesh::prepare() {
-  program = render::engine->requestShader("MESH", addVolumeMeshRules({"MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE"}));
+  ScopedCPUTimer timer(profilingName(), "prepare");
+  program = requestProgram();
+  baseColor1Handle = program->getUniformHandle("u_baseColor1");
+  baseColor2Handle = program->getUniformHandle("u_baseColor2");
   // Populate draw buffers
   fillGeometryBuffers(*program);
   render::engine->setMaterial(*program, getMaterial());
 }
 
+std::shared_ptr<render::ShaderProgram> VolumeMesh::requestProgram() {
+  return render::engine->requestShader("MESH", addVolumeMeshRules({"MESH_PROPAGATE_TYPE_AND_BASECOLOR2_SHADE"}));
+}
+
+bool VolumeMesh::geometryFillPending() {
+  if (!fillTask) {
+    pendingProgram = requestProgram();
+    fillData.reset(new GeometryData(*pendingProgram, *this));
+    GeometryData* data = fillData.get();
+    fillTask.reset(
+        new BackgroundTask(internal::getBufferPreparationQueue(), [this, data]() { fillGeometryData(*data); }));
+  }
+
+  if (!fillTask->isDone() && !internal::finishBackgroundFills) {
+    requestRedraw(); // check again next frame
+    return true;
+  }
+
+  fillTask->finish();
+  fillTask.reset();
+  program = pendingProgram;
+  pendingProgram.reset();
+  baseColor1Handle = program->getUniformHandle("u_baseColor1");
+  baseColor2Handle = program->getUniformHandle("u_baseColor2");
+  setGeometryData(*program, *fillData);
+  fillData.reset();
+  render::engine->setMaterial(*program, getMaterial());
+  return false;
+}
+
+void VolumeMesh::cancelGeometryFill() {
+  if (!fillTask) return;
+  fillTask->finish();
+  fillTask.reset();
+  fillData.reset();
+  pendingProgram.reset();
+}
+
 void VolumeMesh::preparePick() {
 
   // Create a new program
@@ -461,6 +752,7 @@ void VolumeMesh::preparePick() {
   cellPickIndStart = nVertices();
 
   // In "global" indices, indexing all elements in the scene, used to fill buffers for drawing here
+  pick::releasePickBufferRanges(this); // (the range from the last time the pick program was built)
   size_t pickStart = pick::requestPickBufferRange(this, totalPickElements);
   size_t cellGlobalPickIndStart = pickStart + nVertices();
 
@@ -468,7 +760,6 @@ void VolumeMesh::preparePick() {
 
   std::vector<glm::vec3> positions;
   std::vector<glm::vec3> normals;
-  std::vector<glm::vec3> bcoord;
   std::vector<glm::vec3> edgeReal;
   std::vector<std::array<glm::vec3, 3>> vertexColors, edgeColors, halfedgeColors;
   std::vector<glm::vec3> faceColor;
@@ -478,26 +769,24 @@ void VolumeMesh::preparePick() {
   bool wantsBarycenters = wantsCullPosition();
 
   // Reserve space
-  positions.resize(3 * nFacesTriangulation());
-  bcoord.resize(3 * nFacesTriangulation());
-  vertexColors.resize(3 * nFacesTriangulation());
-  edgeColors.resize(3 * nFacesTriangulation());
-  halfedgeColors.resize(3 * nFacesTriangulation());
-  faceColor.resize(3 * nFacesTriangulation());
-  normals.resize(3 * nFacesTriangulation());
+  TriangleSlots slots = drawnTriangleSlots();
+  positions.resize(slots.size());
+  vertexColors.resize(slots.size());
+  edgeColors.resize(slots.size());
+  halfedgeColors.resize(slots.size());
+  faceColor.resize(slots.size());
+  normals.resize(slots.size());
   if (wantsBarycenters) {
-    barycenters.resize(3 * nFacesTriangulation());
+    barycenters.resize(slots.size());
   }
   if (wantsEdge) {
-    edgeReal.resize(3 * nFacesTriangulation());
+    edgeReal.resize(slots.size());
   }
 
 
-  size_t iFront = 0;
-  size_t iBack = 3 * nFacesTriangulation() - 3;
   size_t iF = 0;
   for (size_t iC = 0; iC < nCells(); iC++) {
-    const std::array<int64_t, 8>& cell = cells[iC];
+    IndexView cell = this->cell(iC);
     VolumeCellType cellT = cellType(iC);
 
     glm::vec3 cellColor = pick::indToVec(cellGlobalPickIndStart + iC);
@@ -535,13 +824,7 @@ void VolumeMesh::preparePick() {
         // Push exterior faces to the front of the draw buffer, and interior faces to the back.
         // (see note above)
         size_t iData;
-        if (faceIsInterior[iF]) {
-          iData = iBack;
-          iBack -= 3;
-        } else {
-          iData = iFront;
-          iFront += 3;
-        }
+        if (!slots.next(faceIsInterior[iF], iData)) continue;
 
         for (int k = 0; k < 3; k++) {
           positions[iData + k] = vPos[k];
@@ -554,10 +837,6 @@ void VolumeMesh::preparePick() {
           halfedgeColors[iData + k] = cellColorArr;
         }
 
-        bcoord[iData + 0] = glm::vec3{1., 0., 0.};
-        bcoord[iData + 1] = glm::vec3{0., 1., 0.};
-        bcoord[iData + 2] = glm::vec3{0., 0., 1.};
-
         if (wantsBarycenters) {
           for (int k = 0; k < 3; k++) {
             barycenters[iData + k] = barycenter;
@@ -584,7 +863,6 @@ void VolumeMesh::preparePick() {
 
   // Store data in buffers
   pickProgram->setAttribute("a_position", positions);
-  pickProgram->setAttribute("a_barycoord", bcoord);
   pickProgram->setAttribute("a_normal", normals);
   pickProgram->setAttribute<glm::vec3, 3>("a_vertexColors", vertexColors);
   pickProgram->setAttribute<glm::vec3, 3>("a_edgeColors", edgeColors);
@@ -618,14 +896,36 @@ std::vector<std::string> VolumeMesh::addVolumeMeshRules(std::vector<std::string>
   return initRules;
 }
 
+namespace {
+
+// The uniforms setVolumeMeshUniforms() sets every frame, looked up once for each program (see
+// ShaderProgram::userData()). Those a program does not have are invalid.
+struct VolumeMeshUniformHandles {
+  VolumeMeshUniformHandles(render::ShaderProgram& p)
+      : edgeWidth(p.getUniformHandle("u_edgeWidth")), edgeColor(p.getUniformHandle("u_edgeColor")) {}
+
+  render::ShaderUniformHandle edgeWidth, edgeColor;
+};
+
+} // namespace
+
 void VolumeMesh::setVolumeMeshUniforms(render::ShaderProgram& p) {
   if (getEdgeWidth() > 0) {
-    p.setUniform("u_edgeWidth", getEdgeWidth() * render::engine->getCurrentPixelScaling());
-    p.setUniform("u_edgeColor", getEdgeColor());
+    const VolumeMeshUniformHandles& h = p.userData<VolumeMeshUniformHandles>();
+    p.setUniform(h.edgeWidth, getEdgeWidth() * render::engine->getCurrentPixelScaling());
+    p.setUniform(h.edgeColor, getEdgeColor());
   }
 }
 
 void VolumeMesh::fillGeometryBuffers(render::ShaderProgram& p) {
+  ScopedCPUTimer timer(profilingName(), "fillGeometryBuffers");
+  GeometryData data(p, *this);
+  fillGeometryData(data);
+  setGeometryData(p, data);
+}
+
+void VolumeMesh::fillGeometryData(GeometryData& data) {
+  // (runs on a background thread for large meshes: only reads the geometry)
 
   // NOTE: If we were to fill buffers naively via a loop over cells, we get pretty bad z-fighting artifacts where
   // interior edges ever-so-slightly show through the exterior boundary (more generally, any place 3 faces meet at an
@@ -635,38 +935,31 @@ void VolumeMesh::fillGeometryBuffers(render::ShaderProgram& p) {
   // that exterior faces always win depth ties. This doesn't totally eliminate the problem, but greatly improves the
   // most egregious cases.
 
-  std::vector<glm::vec3> positions;
-  std::vector<glm::vec3> normals;
-  std::vector<glm::vec3> bcoord;
-  std::vector<glm::vec3> edgeReal;
-  std::vector<double> faceTypes;
-  std::vector<glm::vec3> barycenters;
-
-  bool wantsBary = p.hasAttribute("a_barycoord");
-  bool wantsEdge = (getEdgeWidth() > 0);
-  bool wantsBarycenters = wantsCullPosition();
-  bool wantsFaceType = p.hasAttribute("a_faceColorType");
-
-  positions.resize(3 * nFacesTriangulation());
-  normals.resize(3 * nFacesTriangulation());
-  if (wantsBary) {
-    bcoord.resize(3 * nFacesTriangulation());
-  }
+  std::vector<glm::vec3>& positions = data.positions;
+  std::vector<glm::vec3>& normals = data.normals;
+  std::vector<glm::vec3>& edgeReal = data.edgeReal;
+  std::vector<double>& faceTypes = data.faceTypes;
+  std::vector<glm::vec3>& barycenters = data.barycenters;
+  bool wantsEdge = data.wantsEdge;
+  bool wantsBarycenters = data.wantsBarycenters;
+  bool wantsFaceType = data.wantsFaceType;
+
+  TriangleSlots slots = drawnTriangleSlots();
+  positions.resize(slots.size());
+  normals.resize(slots.size());
   if (wantsEdge) {
-    edgeReal.resize(3 * nFacesTriangulation());
+    edgeReal.resize(slots.size());
   }
   if (wantsBarycenters) {
-    barycenters.resize(3 * nFacesTriangulation());
+    barycenters.resize(slots.size());
   }
   if (wantsFaceType) {
-    faceTypes.resize(3 * nFacesTriangulation());
+    faceTypes.resize(slots.size());
   }
 
   size_t iF = 0;
-  size_t iFront = 0;
-  size_t iBack = 3 * nFacesTriangulation() - 3;
   for (size_t iC = 0; iC < nCells(); iC++) {
-    const std::array<int64_t, 8>& cell = cells[iC];
+    IndexView cell = this->cell(iC);
     VolumeCellType cellT = cellType(iC);
 
     glm::vec3 barycenter;
@@ -693,13 +986,7 @@ void VolumeMesh::fillGeometryBuffers(render::ShaderProgram& p) {
         // Push exterior faces to the front of the draw buffer, and interior faces to the back.
         // (see note above)
         size_t iData;
-        if (faceIsInterior[iF]) {
-          iData = iBack;
-          iBack -= 3;
-        } else {
-          iData = iFront;
-          iFront += 3;
-        }
+        if (!slots.next(faceIsInterior[iF], iData)) continue;
 
         glm::vec3 pA = vertices[cell[tri[0]]];
         glm::vec3 pB = vertices[cell[tri[1]]];
@@ -720,12 +1007,6 @@ void VolumeMesh::fillGeometryBuffers(render::ShaderProgram& p) {
           }
         }
 
-        if (wantsBary) {
-          bcoord[iData + 0] = glm::vec3{1., 0., 0.};
-          bcoord[iData + 1] = glm::vec3{0., 1., 0.};
-          bcoord[iData + 2] = glm::vec3{0., 0., 1.};
-        }
-
         if (wantsBarycenters) {
           for (int k = 0; k < 3; k++) {
             barycenters[iData + k] = barycenter;
@@ -749,21 +1030,19 @@ void VolumeMesh::fillGeometryBuffers(render::ShaderProgram& p) {
       iF++;
     }
   }
+}
 
-  // Store data in buffers
-  p.setAttribute("a_position", positions);
-  p.setAttribute("a_normal", normals);
-  if (wantsBary) {
-    p.setAttribute("a_barycoord", bcoord);
-  }
-  if (wantsEdge) {
-    p.setAttribute("a_edgeIsReal", edgeReal);
+void VolumeMesh::setGeometryData(render::ShaderProgram& p, const GeometryData& data) {
+  p.setAttribute("a_position", data.positions);
+  p.setAttribute("a_normal", data.normals);
+  if (data.wantsEdge) {
+    p.setAttribute("a_edgeIsReal", data.edgeReal);
   }
-  if (wantsCullPosition()) {
-    p.setAttribute("a_cullPos", barycenters);
+  if (data.wantsBarycenters) {
+    p.setAttribute("a_cullPos", data.barycenters);
   }
-  if (wantsFaceType) {
-    p.setAttribute("a_faceColorType", faceTypes);
+  if (data.wantsFaceType) {
+    p.setAttribute("a_faceColorType", data.faceTypes);
   }
 }
 
@@ -783,15 +1062,11 @@ glm::vec3 VolumeMesh::cellCenter(size_t iC) {
 
   glm::vec3 center{0., 0., 0};
 
-  int count = 0;
-  const std::array<int64_t, 8>& cell = cells[iC];
-  for (int j = 0; j < 8; j++) {
-    if (cell[j] >= 0) {
-      center += vertices[cell[j]];
-      count++;
-    }
+  IndexView cell = this->cell(iC);
+  for (uint32_t iV : cell) {
+    center += vertices[iV];
   }
-  center /= count;
+  center /= static_cast<float>(cell.size());
 
   return center;
 }
@@ -922,15 +1197,20 @@ void VolumeMesh::refreshVolumeMeshListeners() {
 }
 
 void VolumeMesh::refresh() {
+  cancelGeometryFill();
   computeGeometryData();
   program.reset();
   pickProgram.reset();
+  vertexPositionBuffer.reset();
+  cellCenterBuffer.reset();
   refreshVolumeMeshListeners();
   requestRedraw();
   QuantityStructure<VolumeMesh>::refresh(); // call base class version, which refreshes quantities
+  triangleCellTexture.reset();              // (after the programs which sample it)
 }
 
 void VolumeMesh::geometryChanged() {
+  cancelGeometryFill();
   computeGeometryData();
   refreshVolumeMeshListeners();
   if (program) {
@@ -940,35 +1220,82 @@ void VolumeMesh::geometryChanged() {
     fillGeometryBuffers(*pickProgram);
   }
   requestRedraw();
+  vertexPositionBuffer.reset(); // (before the quantities take new ones)
+  cellCenterBuffer.reset();
   QuantityStructure<VolumeMesh>::refresh();
+  sliceVertexPositionTexture.reset(); // (after the slice programs which sample it)
+  sliceTetBVH.reset();
+  sliceTetSelections.clear();
+  if (detail::sessionCaptureActive) detail::captureMovedPositions(*this, nullptr);
+}
+
+std::shared_ptr<render::AttributeBuffer> VolumeMesh::getVertexPositionBuffer() {
+  if (!vertexPositionBuffer) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    vertexPositionBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    vertexPositionBuffer->setData(vertices);
+  }
+  return vertexPositionBuffer;
+}
+
+std::shared_ptr<render::AttributeBuffer> VolumeMesh::getCellCenterBuffer() {
+  if (!cellCenterBuffer) {
+    std::vector<glm::vec3> centers(nCells());
+    parallelFor(0, nCells(), [&](size_t iC) { centers[iC] = cellCenter(iC); });
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    cellCenterBuffer = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    cellCenterBuffer->setData(centers);
+  }
+  return cellCenterBuffer;
 }
 
 VolumeCellType VolumeMesh::cellType(size_t i) const {
-  bool isTet = cells[i][4] < 0;
-  if (isTet) return VolumeCellType::TET;
-  return VolumeCellType::HEX;
+  if (cellDegree(i) == 8) return VolumeCellType::HEX;
+  return VolumeCellType::TET;
 };
 
 void VolumeMesh::updateObjectSpaceBounds() {
-  // bounding box
-  glm::vec3 min = glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
-  glm::vec3 max = -glm::vec3{1, 1, 1} * std::numeric_limits<float>::infinity();
-  for (const glm::vec3& p : vertices) {
-    min = componentwiseMin(min, p);
-    max = componentwiseMax(max, p);
-  }
+  // bounding box, and length scale as twice the radius from the center of the bounding box
+  glm::vec3 min, max;
+  computePointSetExtents(vertices, min, max, objectSpaceLengthScale);
   objectSpaceBoundingBox = std::make_tuple(min, max);
+  boundsChanged();
+}
+
+std::string VolumeMesh::typeName() { return structureTypeName; }
 
-  // length scale, as twice the radius from the center of the bounding box
-  glm::vec3 center = 0.5f * (min + max);
-  float lengthScale = 0.0;
-  for (const glm::vec3& p : vertices) {
-    lengthScale = std::max(lengthScale, glm::length2(p - center));
+const std::vector<size_t>& VolumeMesh::getVertexPermInverse() {
+  return cachedPermutationInverse(vertexPerm, vertexDataSize, vertexPermInverse);
+}
+const std::vector<size_t>& VolumeMesh::getEdgePermInverse() {
+  return cachedPermutationInverse(edgePerm, edgeDataSize, edgePermInverse);
+}
+const std::vector<size_t>& VolumeMesh::getFacePermInverse() {
+  return cachedPermutationInverse(facePerm, faceDataSize, facePermInverse);
+}
+const std::vector<size_t>& VolumeMesh::getCellPermInverse() {
+  return cachedPermutationInverse(cellPerm, cellDataSize, cellPermInverse);
+}
+
+void VolumeMesh::resetPermutationInverses() {
+  for (std::vector<size_t>* inverse : {&vertexPermInverse, &edgePermInverse, &facePermInverse, &cellPermInverse}) {
+    inverse->clear();
+    inverse->shrink_to_fit();
   }
-  objectSpaceLengthScale = 2 * std::sqrt(lengthScale);
 }
 
-std::string VolumeMesh::typeName() { return structureTypeName; }
+size_t VolumeMesh::hostMemoryUsage() {
+  size_t bytes = 0;
+  bytes += allocatedBytes(vertices) + allocatedBytes(cellIndsEntries) + allocatedBytes(cellIndsStart);
+  bytes += allocatedBytes(tets) + allocatedBytes(cellTetStart);
+  bytes += allocatedBytes(cellAreas) + allocatedBytes(faceAreas) + allocatedBytes(vertexAreas);
+  bytes += allocatedBytes(faceIsInterior);
+  bytes += allocatedBytes(vertexPerm) + allocatedBytes(edgePerm) + allocatedBytes(facePerm) + allocatedBytes(cellPerm);
+  bytes += allocatedBytes(vertexPermInverse) + allocatedBytes(edgePermInverse) + allocatedBytes(facePermInverse);
+  bytes += allocatedBytes(cellPermInverse);
+  if (sliceTetBVH) bytes += sliceTetBVH->allocatedBytes();
+  return bytes;
+}
 
 
 // === Option getters and setters
@@ -1002,6 +1329,7 @@ VolumeMesh* VolumeMesh::setMaterial(std::string m) {
   return this;
 }
 std::string VolumeMesh::getMaterial() { return material.get(); }
+std::string VolumeMesh::drawBatchKey() { return material.get(); }
 
 VolumeMesh* VolumeMesh::setEdgeWidth(double newVal) {
   edgeWidth = newVal;
@@ -24,6 +24,24 @@ void VolumeMeshColorQuantity::draw() {
   program->draw();
 }
 
+void VolumeMeshColorQuantity::drawSlice(polyscope::SlicePlane* sp) {
+  if (!isEnabled()) return;
+
+  if (slice == nullptr) {
+    slice = createSlice();
+  }
+  render::ShaderProgram& p = slice->getDrawProgram();
+  parent.setStructureUniforms(p);
+  // Ignore current slice plane
+  sp->setSceneObjectUniforms(p, true);
+  parent.setVolumeMeshUniforms(p);
+  slice->draw(sp);
+}
+
+void VolumeMeshColorQuantity::removeSlicePlane(polyscope::SlicePlane* sp) {
+  if (slice) slice->removePlane(sp);
+}
+
 // ========================================================
 // ==========           Vertex Color            ==========
 // ========================================================
@@ -36,56 +54,31 @@ VolumeMeshVertexColorQuantity::VolumeMeshVertexColorQuantity(std::string name, s
   parent.refreshVolumeMeshListeners(); // just in case this quantity is being drawn
 }
 
-void VolumeMeshVertexColorQuantity::drawSlice(polyscope::SlicePlane* sp) {
-  if (!isEnabled()) return;
-
-  if (sliceProgram == nullptr) {
-    sliceProgram = createSliceProgram();
-  }
-  parent.setStructureUniforms(*sliceProgram);
-  // Ignore current slice plane
-  sp->setSceneObjectUniforms(*sliceProgram, true);
-  sp->setSliceGeomUniforms(*sliceProgram);
-  parent.setVolumeMeshUniforms(*sliceProgram);
-  sliceProgram->draw();
-}
-
-std::shared_ptr<render::ShaderProgram> VolumeMeshVertexColorQuantity::createSliceProgram() {
-  std::shared_ptr<render::ShaderProgram> p = render::engine->requestShader(
-      "SLICE_TETS", parent.addVolumeMeshRules({"SLICE_TETS_PROPAGATE_VECTOR", "SLICE_TETS_VECTOR_COLOR"}, true, true));
+std::unique_ptr<VolumeMeshSlice> VolumeMeshVertexColorQuantity::createSlice() {
+  std::unique_ptr<VolumeMeshSlice> s(new VolumeMeshSlice(parent,
+                                                         {"SLICE_TETS_PROPAGATE_VECTOR", "SLICE_TETS_CAPTURE_VECTOR"},
+                                                         {"SLICE_TETS_CACHED_VECTOR", "SLICE_TETS_VECTOR_COLOR"}, gpuMemory));
 
   // Fill color buffers
-  parent.fillSliceGeometryBuffers(*p);
-  fillSliceColorBuffers(*p);
-  render::engine->setMaterial(*p, parent.getMaterial());
-  return p;
+  fillSliceColorBuffers(s->getCaptureProgram());
+  return s;
 }
 
 void VolumeMeshVertexColorQuantity::fillSliceColorBuffers(render::ShaderProgram& p) {
-  size_t tetCount = parent.nTets();
-  std::vector<glm::vec3> colorval_1;
-  std::vector<glm::vec3> colorval_2;
-  std::vector<glm::vec3> colorval_3;
-  std::vector<glm::vec3> colorval_4;
-
-  colorval_1.resize(tetCount);
-  colorval_2.resize(tetCount);
-  colorval_3.resize(tetCount);
-  colorval_4.resize(tetCount);
-
-  auto vertices = parent.vertices;
-  for (size_t iT = 0; iT < parent.tets.size(); iT++) {
-    colorval_1[iT] = values[parent.tets[iT][0]];
-    colorval_2[iT] = values[parent.tets[iT][1]];
-    colorval_3[iT] = values[parent.tets[iT][2]];
-    colorval_4[iT] = values[parent.tets[iT][3]];
+  if (!vertexColorTexture) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    vertexColorTexture = render::engine->generateElementTexture(values);
   }
+  p.setTextureFromBuffer("t_vertexVectors", vertexColorTexture.get());
+}
 
-  // Store data in buffers
-  p.setAttribute("a_value_1", colorval_1);
-  p.setAttribute("a_value_2", colorval_2);
-  p.setAttribute("a_value_3", colorval_3);
-  p.setAttribute("a_value_4", colorval_4);
+void VolumeMeshVertexColorQuantity::releaseRenderData() {
+  vertexColorTexture.reset();
+  VolumeMeshColorQuantity::releaseRenderData();
+}
+
+void VolumeMeshVertexColorQuantity::dataUpdated() {
+  releaseRenderData(); // (the slice texture holds the colors too)
 }
 
 void VolumeMeshVertexColorQuantity::createProgram() {
@@ -100,13 +93,12 @@ void VolumeMeshVertexColorQuantity::createProgram() {
 
 void VolumeMeshVertexColorQuantity::fillColorBuffers(render::ShaderProgram& p) {
   std::vector<glm::vec3> colorval;
-  colorval.resize(3 * parent.nFacesTriangulation());
+  VolumeMesh::TriangleSlots slots = parent.drawnTriangleSlots();
+  colorval.resize(slots.size());
 
   size_t iF = 0;
-  size_t iFront = 0;
-  size_t iBack = 3 * parent.nFacesTriangulation() - 3;
   for (size_t iC = 0; iC < parent.nCells(); iC++) {
-    const std::array<int64_t, 8>& cell = parent.cells[iC];
+    VolumeMesh::IndexView cell = parent.cell(iC);
     VolumeCellType cellT = parent.cellType(iC);
     for (const std::vector<std::array<size_t, 3>>& face : parent.cellStencil(cellT)) {
       for (size_t j = 0; j < face.size(); j++) {
@@ -114,13 +106,7 @@ void VolumeMeshVertexColorQuantity::fillColorBuffers(render::ShaderProgram& p) {
 
         // (see note in VolumeMesh.cpp about sorting the buffer outside-first)
         size_t iData;
-        if (parent.faceIsInterior[iF]) {
-          iData = iBack;
-          iBack -= 3;
-        } else {
-          iData = iFront;
-          iFront += 3;
-        }
+        if (!slots.next(parent.faceIsInterior[iF], iData)) continue;
 
         for (int k = 0; k < 3; k++) {
           colorval[iData + k] = values[cell[tri[k]]];
@@ -151,9 +137,7 @@ std::string VolumeMeshColorQuantity::niceName() { return name + " (" + definedOn
 
 void VolumeMeshColorQuantity::refresh() {
   program.reset();
-  if (sliceProgram) {
-    sliceProgram.reset();
-  }
+  slice.reset();
   Quantity::refresh();
 }
 
@@ -169,7 +153,9 @@ VolumeMeshCellColorQuantity::VolumeMeshCellColorQuantity(std::string name, std::
 
 void VolumeMeshCellColorQuantity::createProgram() {
   // Create the program to draw this quantity
-  program = render::engine->requestShader("MESH", parent.addVolumeMeshRules({"MESH_PROPAGATE_COLOR", "SHADE_COLOR"}));
+  std::string propagateRule =
+      parent.canUseCellTextures() ? "MESH_PROPAGATE_CELL_COLOR_TEXTURE" : "MESH_PROPAGATE_COLOR";
+  program = render::engine->requestShader("MESH", parent.addVolumeMeshRules({propagateRule, "SHADE_COLOR"}));
 
   // Fill color buffers
   parent.fillGeometryBuffers(*program);
@@ -177,15 +163,46 @@ void VolumeMeshCellColorQuantity::createProgram() {
   render::engine->setMaterial(*program, parent.getMaterial());
 }
 
+std::unique_ptr<VolumeMeshSlice> VolumeMeshCellColorQuantity::createSlice() {
+  std::unique_ptr<VolumeMeshSlice> s(new VolumeMeshSlice(
+      parent, {"SLICE_TETS_PROPAGATE_CELL_VECTOR", "SLICE_TETS_CAPTURE_VECTOR"},
+      {"SLICE_TETS_CACHED_VECTOR", "SLICE_TETS_VECTOR_COLOR"}, gpuMemory));
+
+  // Fill color buffers
+  s->getCaptureProgram().setTextureFromBuffer("t_cellColors", getCellColorTexture().get());
+  return s;
+}
+
+std::shared_ptr<render::TextureBuffer> VolumeMeshCellColorQuantity::getCellColorTexture() {
+  if (!cellColorTexture) {
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    cellColorTexture = render::engine->generateElementTexture(values);
+  }
+  return cellColorTexture;
+}
+
+void VolumeMeshCellColorQuantity::releaseRenderData() {
+  cellColorTexture.reset();
+  VolumeMeshColorQuantity::releaseRenderData();
+}
+
+void VolumeMeshCellColorQuantity::dataUpdated() {
+  releaseRenderData(); // (the texture holds the colors)
+}
+
 void VolumeMeshCellColorQuantity::fillColorBuffers(render::ShaderProgram& p) {
+  if (p.hasTexture("t_cellColors")) {
+    parent.setCellTextureUniforms(p);
+    p.setTextureFromBuffer("t_cellColors", getCellColorTexture().get());
+    return;
+  }
+
   std::vector<glm::vec3> colorval;
-  colorval.resize(3 * parent.nFacesTriangulation());
+  VolumeMesh::TriangleSlots slots = parent.drawnTriangleSlots();
+  colorval.resize(slots.size());
 
   size_t iF = 0;
-  size_t iFront = 0;
-  size_t iBack = 3 * parent.nFacesTriangulation() - 3;
   for (size_t iC = 0; iC < parent.nCells(); iC++) {
-    const std::array<int64_t, 8>& cell = parent.cells[iC];
     VolumeCellType cellT = parent.cellType(iC);
     for (const std::vector<std::array<size_t, 3>>& face : parent.cellStencil(cellT)) {
       for (size_t j = 0; j < face.size(); j++) {
@@ -193,13 +210,7 @@ void VolumeMeshCellColorQuantity::fillColorBuffers(render::ShaderProgram& p) {
 
         // (see note in VolumeMesh.cpp about sorting the buffer outside-first)
         size_t iData;
-        if (parent.faceIsInterior[iF]) {
-          iData = iBack;
-          iBack -= 3;
-        } else {
-          iData = iFront;
-          iFront += 3;
-        }
+        if (!slots.next(parent.faceIsInterior[iF], iData)) continue;
 
         for (int k = 0; k < 3; k++) {
           colorval[iData + k] = values[iC];
@@ -227,4 +238,8 @@ void VolumeMeshCellColorQuantity::buildCellInfoGUI(size_t fInd) {
   ImGui::NextColumn();
 }
 
+size_t VolumeMeshVertexColorQuantity::hostMemoryUsage() { return allocatedBytes(values); }
+
+size_t VolumeMeshCellColorQuantity::hostMemoryUsage() { return allocatedBytes(values); }
+
 } // namespace polyscope
@@ -6,6 +6,8 @@
 
 #include "imgui.h"
 
+#include <algorithm>
+
 namespace polyscope {
 
 VolumeMeshScalarQuantity::VolumeMeshScalarQuantity(std::string name, VolumeMesh& mesh_, std::string definedOn_,
@@ -27,6 +29,25 @@ void VolumeMeshScalarQuantity::draw() {
   program->draw();
 }
 
+void VolumeMeshScalarQuantity::drawSlice(polyscope::SlicePlane* sp) {
+  if (!isEnabled()) return;
+
+  if (slice == nullptr) {
+    slice = createSlice();
+  }
+  render::ShaderProgram& p = slice->getDrawProgram();
+  parent.setStructureUniforms(p);
+  // Ignore current slice plane
+  sp->setSceneObjectUniforms(p, true);
+  parent.setVolumeMeshUniforms(p);
+  setScalarUniforms(p);
+  slice->draw(sp);
+}
+
+void VolumeMeshScalarQuantity::removeSlicePlane(polyscope::SlicePlane* sp) {
+  if (slice) slice->removePlane(sp);
+}
+
 
 void VolumeMeshScalarQuantity::buildCustomUI() {
   ImGui::SameLine();
@@ -47,7 +68,7 @@ void VolumeMeshScalarQuantity::buildCustomUI() {
 
 void VolumeMeshScalarQuantity::refresh() {
   program.reset();
-  sliceProgram.reset();
+  slice.reset();
   Quantity::refresh();
 }
 
@@ -63,46 +84,26 @@ VolumeMeshVertexScalarQuantity::VolumeMeshVertexScalarQuantity(std::string name,
       showQuantity(this)
 
 {
-  hist.buildHistogram(values, parent.vertexAreas); // rebuild to incorporate weights
+  hist.buildHistogramLazily([this]() { values.buildHistogram(hist, parent.vertexAreas); }); // with weights
   parent.refreshVolumeMeshListeners();             // just in case this quantity is being drawn
 }
 void VolumeMeshVertexScalarQuantity::fillLevelSetData(render::ShaderProgram& p) {
-  std::vector<glm::vec3> point1;
-  std::vector<glm::vec3> point2;
-  std::vector<glm::vec3> point3;
-  std::vector<glm::vec3> point4;
-  std::vector<glm::vec3> slice1;
-  std::vector<glm::vec3> slice2;
-  std::vector<glm::vec3> slice3;
-  std::vector<glm::vec3> slice4;
-  size_t tetCount = parent.nTets();
-  slice1.resize(tetCount);
-  slice2.resize(tetCount);
-  slice3.resize(tetCount);
-  slice4.resize(tetCount);
-  point1.resize(tetCount);
-  point2.resize(tetCount);
-  point3.resize(tetCount);
-  point4.resize(tetCount);
-  auto vertices = parent.vertices;
-  for (size_t i = 0; i < parent.nTets(); i++) {
-    point1[i] = vertices[parent.tets[i][0]];
-    point2[i] = vertices[parent.tets[i][1]];
-    point3[i] = vertices[parent.tets[i][2]];
-    point4[i] = vertices[parent.tets[i][3]];
-    slice1[i] = glm::vec3(values[parent.tets[i][0]], 0, 0);
-    slice2[i] = glm::vec3(values[parent.tets[i][1]], 0, 0);
-    slice3[i] = glm::vec3(values[parent.tets[i][2]], 0, 0);
-    slice4[i] = glm::vec3(values[parent.tets[i][3]], 0, 0);
-  }
-  p.setAttribute("a_point_1", point1);
-  p.setAttribute("a_point_2", point2);
-  p.setAttribute("a_point_3", point3);
-  p.setAttribute("a_point_4", point4);
-  p.setAttribute("a_slice_1", slice1);
-  p.setAttribute("a_slice_2", slice2);
-  p.setAttribute("a_slice_3", slice3);
-  p.setAttribute("a_slice_4", slice4);
+  p.setTextureFromBuffer("t_sliceValues", getVertexValueTexture().get());
+}
+
+std::shared_ptr<render::ShaderProgram>
+VolumeMeshVertexScalarQuantity::createLevelSetProgram(VolumeMeshVertexScalarQuantity& shown) {
+  std::shared_ptr<render::ShaderProgram> p = render::engine->requestShader(
+      "SLICE_TETS",
+      parent.addVolumeMeshRules(addScalarRules({"SLICE_TETS_PROPAGATE_VALUE", "SLICE_TETS_SLICE_BY_VALUE"}), true,
+                                true));
+
+  parent.fillSliceGeometryBuffers(*p);
+  shown.fillSliceColorBuffers(*p);
+  levelSetShownTexture = shown.getVertexValueTexture();
+  render::engine->setMaterial(*p, parent.getMaterial());
+  fillLevelSetData(*p);
+  return p;
 }
 
 void VolumeMeshVertexScalarQuantity::setLevelSetUniforms(render::ShaderProgram& p) {
@@ -116,10 +117,10 @@ void VolumeMeshVertexScalarQuantity::draw() {
   auto programToDraw = program;
   if (isDrawingLevelSet) {
     if (levelSetProgram == nullptr) {
-      levelSetProgram = createSliceProgram();
-      fillLevelSetData(*levelSetProgram);
+      levelSetProgram = createLevelSetProgram(*this);
     }
     setLevelSetUniforms(*levelSetProgram);
+    setLevelSetTetBuffers(*levelSetProgram);
     programToDraw = levelSetProgram;
   } else if (program == nullptr) {
     createProgram();
@@ -134,7 +135,43 @@ void VolumeMeshVertexScalarQuantity::draw() {
   programToDraw->draw();
 }
 
-void VolumeMeshVertexScalarQuantity::setLevelSetValue(float f) { levelSetValue = f; }
+void VolumeMeshVertexScalarQuantity::setLevelSetTetBuffers(render::ShaderProgram& p) {
+  for (size_t i = 0; i < levelSetSelections.size(); i++) {
+    if (levelSetSelections[i].value != levelSetValue) continue;
+    LevelSetSelection hit = levelSetSelections[i];
+    levelSetSelections.erase(levelSetSelections.begin() + i);
+    levelSetSelections.push_front(hit);
+    VolumeMesh::setTetVertexBuffers(p, hit.tetVertexBuffers);
+    return;
+  }
+
+  if (!levelSetBVH) {
+    parent.ensureHaveTets();
+    levelSetValuePoints.resize(parent.nVertices());
+    for (size_t iV = 0; iV < parent.nVertices(); iV++) {
+      levelSetValuePoints[iV] = glm::vec3{static_cast<float>(values[iV]), 0., 0.};
+    }
+    levelSetBVH.reset(new VolumeMeshTetBVH(levelSetValuePoints, parent.tets));
+  }
+  std::vector<uint32_t> crossing =
+      levelSetBVH->tetsCrossingPlane(levelSetValuePoints, parent.tets, glm::vec3{1., 0., 0.}, levelSetValue);
+
+  // Reuse the buffers of the least recently shown value once the cache is full
+  LevelSetSelection selection;
+  while (levelSetSelections.size() >= std::max<size_t>(options::levelSetSelectionCacheSize, 1)) {
+    selection = levelSetSelections.back();
+    levelSetSelections.pop_back();
+  }
+  selection.value = levelSetValue;
+  parent.fillTetVertexBuffers(selection.tetVertexBuffers, crossing);
+  levelSetSelections.push_front(selection);
+  VolumeMesh::setTetVertexBuffers(p, selection.tetVertexBuffers);
+}
+
+void VolumeMeshVertexScalarQuantity::setLevelSetValue(float f) {
+  levelSetValue = f;
+  requestRedraw();
+}
 
 void VolumeMeshVertexScalarQuantity::setEnabledLevelSet(bool v) {
   if (v) {
@@ -147,21 +184,6 @@ void VolumeMeshVertexScalarQuantity::setEnabledLevelSet(bool v) {
   }
 }
 
-void VolumeMeshVertexScalarQuantity::drawSlice(polyscope::SlicePlane* sp) {
-  if (!isEnabled()) return;
-
-  if (sliceProgram == nullptr) {
-    sliceProgram = createSliceProgram();
-  }
-  parent.setStructureUniforms(*sliceProgram);
-  // Ignore current slice plane
-  sp->setSceneObjectUniforms(*sliceProgram, true);
-  sp->setSliceGeomUniforms(*sliceProgram);
-  parent.setVolumeMeshUniforms(*sliceProgram);
-  setScalarUniforms(*sliceProgram);
-  sliceProgram->draw();
-}
-
 void VolumeMeshVertexScalarQuantity::setLevelSetVisibleQuantity(std::string name) {
   auto pair = parent.quantities.find(name);
   if (pair == parent.quantities.end()) {
@@ -172,14 +194,7 @@ void VolumeMeshVertexScalarQuantity::setLevelSetVisibleQuantity(std::string name
   if (q == nullptr) {
     return;
   }
-  levelSetProgram = render::engine->requestShader(
-      "SLICE_TETS", parent.addVolumeMeshRules(addScalarRules({"SLICE_TETS_PROPAGATE_VALUE"}), true, true));
-
-  // Fill color buffers
-  parent.fillSliceGeometryBuffers(*levelSetProgram);
-  q->fillSliceColorBuffers(*levelSetProgram);
-  render::engine->setMaterial(*levelSetProgram, parent.getMaterial());
-  fillLevelSetData(*levelSetProgram);
+  levelSetProgram = createLevelSetProgram(*q);
   setLevelSetUniforms(*levelSetProgram);
   showQuantity = q;
 }
@@ -209,6 +224,27 @@ void VolumeMeshVertexScalarQuantity::buildCustomUI() {
 void VolumeMeshVertexScalarQuantity::refresh() {
   VolumeMeshScalarQuantity::refresh();
   levelSetProgram.reset();
+  levelSetShownTexture.reset();
+}
+
+void VolumeMeshVertexScalarQuantity::releaseRenderData() {
+  // (level sets of other quantities showing these values hold on to the texture until they are refreshed)
+  vertexValueTexture.reset();
+  levelSetSelections.clear();
+  VolumeMeshScalarQuantity::releaseRenderData();
+}
+
+void VolumeMeshVertexScalarQuantity::dataUpdated() {
+  // The level set hierarchy is built over the values, and the selections found with it
+  levelSetBVH.reset();
+  levelSetValuePoints.clear();
+  releaseRenderData();
+}
+
+size_t VolumeMeshVertexScalarQuantity::hostMemoryUsage() {
+  size_t bytes = VolumeMeshScalarQuantity::hostMemoryUsage() + allocatedBytes(levelSetValuePoints);
+  if (levelSetBVH) bytes += levelSetBVH->allocatedBytes();
+  return bytes;
 }
 
 void VolumeMeshVertexScalarQuantity::createProgram() {
@@ -221,27 +257,25 @@ void VolumeMeshVertexScalarQuantity::createProgram() {
   render::engine->setMaterial(*program, parent.getMaterial());
 }
 
-std::shared_ptr<render::ShaderProgram> VolumeMeshVertexScalarQuantity::createSliceProgram() {
-  std::shared_ptr<render::ShaderProgram> p = render::engine->requestShader(
-      "SLICE_TETS", parent.addVolumeMeshRules(addScalarRules({"SLICE_TETS_PROPAGATE_VALUE"}), true, true));
+std::unique_ptr<VolumeMeshSlice> VolumeMeshVertexScalarQuantity::createSlice() {
+  std::unique_ptr<VolumeMeshSlice> s(new VolumeMeshSlice(parent, {"SLICE_TETS_PROPAGATE_VALUE", "SLICE_TETS_CAPTURE_VALUE"},
+                                                         addScalarRules({"SLICE_TETS_CACHED_VALUE"}), gpuMemory));
 
   // Fill color buffers
-  parent.fillSliceGeometryBuffers(*p);
-  fillSliceColorBuffers(*p);
-  render::engine->setMaterial(*p, parent.getMaterial());
-  return p;
+  s->getCaptureProgram().setTextureFromBuffer("t_vertexValues", getVertexValueTexture().get());
+  s->getDrawProgram().setTextureFromColormap("t_colormap", cMap.get());
+  return s;
 }
 
 
 void VolumeMeshVertexScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
   std::vector<double> colorval;
-  colorval.resize(3 * parent.nFacesTriangulation());
+  VolumeMesh::TriangleSlots slots = parent.drawnTriangleSlots();
+  colorval.resize(slots.size());
 
   size_t iF = 0;
-  size_t iFront = 0;
-  size_t iBack = 3 * parent.nFacesTriangulation() - 3;
   for (size_t iC = 0; iC < parent.nCells(); iC++) {
-    const std::array<int64_t, 8>& cell = parent.cells[iC];
+    VolumeMesh::IndexView cell = parent.cell(iC);
     VolumeCellType cellT = parent.cellType(iC);
     for (const std::vector<std::array<size_t, 3>>& face : parent.cellStencil(cellT)) {
 
@@ -250,13 +284,7 @@ void VolumeMeshVertexScalarQuantity::fillColorBuffers(render::ShaderProgram& p)
 
         // (see note in VolumeMesh.cpp about sorting the buffer outside-first)
         size_t iData;
-        if (parent.faceIsInterior[iF]) {
-          iData = iBack;
-          iBack -= 3;
-        } else {
-          iData = iFront;
-          iFront += 3;
-        }
+        if (!slots.next(parent.faceIsInterior[iF], iData)) continue;
 
         for (int k = 0; k < 3; k++) {
           colorval[iData + k] = values[cell[tri[k]]];
@@ -273,33 +301,22 @@ void VolumeMeshVertexScalarQuantity::fillColorBuffers(render::ShaderProgram& p)
 }
 
 void VolumeMeshVertexScalarQuantity::fillSliceColorBuffers(render::ShaderProgram& p) {
-  size_t tetCount = parent.nTets();
-  std::vector<double> colorval_1;
-  std::vector<double> colorval_2;
-  std::vector<double> colorval_3;
-  std::vector<double> colorval_4;
-
-  colorval_1.resize(tetCount);
-  colorval_2.resize(tetCount);
-  colorval_3.resize(tetCount);
-  colorval_4.resize(tetCount);
-
-  auto vertices = parent.vertices;
-  for (size_t iT = 0; iT < parent.tets.size(); iT++) {
-    colorval_1[iT] = values[parent.tets[iT][0]];
-    colorval_2[iT] = values[parent.tets[iT][1]];
-    colorval_3[iT] = values[parent.tets[iT][2]];
-    colorval_4[iT] = values[parent.tets[iT][3]];
-  }
-
-  // Store data in buffers
-  p.setAttribute("a_value_1", colorval_1);
-  p.setAttribute("a_value_2", colorval_2);
-  p.setAttribute("a_value_3", colorval_3);
-  p.setAttribute("a_value_4", colorval_4);
+  p.setTextureFromBuffer("t_vertexValues", getVertexValueTexture().get());
   p.setTextureFromColormap("t_colormap", cMap.get());
 }
 
+std::shared_ptr<render::TextureBuffer> VolumeMeshVertexScalarQuantity::getVertexValueTexture() {
+  if (!vertexValueTexture) {
+    std::vector<float> vertexValues(parent.nVertices());
+    for (size_t iV = 0; iV < parent.nVertices(); iV++) {
+      vertexValues[iV] = static_cast<float>(values[iV]);
+    }
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    vertexValueTexture = render::engine->generateElementTexture(vertexValues);
+  }
+  return vertexValueTexture;
+}
+
 void VolumeMeshVertexScalarQuantity::buildVertexInfoGUI(size_t vInd) {
   ImGui::TextUnformatted(name.c_str());
   ImGui::NextColumn();
@@ -317,12 +334,14 @@ VolumeMeshCellScalarQuantity::VolumeMeshCellScalarQuantity(std::string name, con
     : VolumeMeshScalarQuantity(name, mesh_, "cell", values_, dataType_)
 
 {
-  hist.buildHistogram(values, parent.faceAreas); // rebuild to incorporate weights
+  hist.buildHistogramLazily([this]() { values.buildHistogram(hist, parent.faceAreas); }); // with weights
 }
 
 void VolumeMeshCellScalarQuantity::createProgram() {
   // Create the program to draw this quantity
-  program = render::engine->requestShader("MESH", parent.addVolumeMeshRules(addScalarRules({"MESH_PROPAGATE_VALUE"})));
+  std::string propagateRule =
+      parent.canUseCellTextures() ? "MESH_PROPAGATE_CELL_VALUE_TEXTURE" : "MESH_PROPAGATE_VALUE";
+  program = render::engine->requestShader("MESH", parent.addVolumeMeshRules(addScalarRules({propagateRule})));
 
   // Fill color buffers
   parent.fillGeometryBuffers(*program);
@@ -330,15 +349,53 @@ void VolumeMeshCellScalarQuantity::createProgram() {
   render::engine->setMaterial(*program, parent.getMaterial());
 }
 
+std::unique_ptr<VolumeMeshSlice> VolumeMeshCellScalarQuantity::createSlice() {
+  std::unique_ptr<VolumeMeshSlice> s(
+      new VolumeMeshSlice(parent, {"SLICE_TETS_PROPAGATE_CELL_VALUE", "SLICE_TETS_CAPTURE_VALUE"},
+                          addScalarRules({"SLICE_TETS_CACHED_VALUE"}), gpuMemory));
+
+  // Fill color buffers
+  s->getCaptureProgram().setTextureFromBuffer("t_cellValues", getCellValueTexture().get());
+  s->getDrawProgram().setTextureFromColormap("t_colormap", cMap.get());
+  return s;
+}
+
+std::shared_ptr<render::TextureBuffer> VolumeMeshCellScalarQuantity::getCellValueTexture() {
+  if (!cellValueTexture) {
+    std::vector<float> cellValues(parent.nCells());
+    for (size_t iC = 0; iC < parent.nCells(); iC++) {
+      cellValues[iC] = static_cast<float>(values[iC]);
+    }
+    render::ScopedGPUMemoryAccount account(gpuMemory);
+    cellValueTexture = render::engine->generateElementTexture(cellValues);
+  }
+  return cellValueTexture;
+}
+
+void VolumeMeshCellScalarQuantity::releaseRenderData() {
+  cellValueTexture.reset();
+  VolumeMeshScalarQuantity::releaseRenderData();
+}
+
+void VolumeMeshCellScalarQuantity::dataUpdated() {
+  cellValueTexture.reset(); // (made again from the new values with the programs)
+  VolumeMeshScalarQuantity::dataUpdated();
+}
+
 void VolumeMeshCellScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
+  if (p.hasTexture("t_cellValues")) {
+    parent.setCellTextureUniforms(p);
+    p.setTextureFromBuffer("t_cellValues", getCellValueTexture().get());
+    p.setTextureFromColormap("t_colormap", cMap.get());
+    return;
+  }
+
   std::vector<double> colorval;
-  colorval.resize(3 * parent.nFacesTriangulation());
+  VolumeMesh::TriangleSlots slots = parent.drawnTriangleSlots();
+  colorval.resize(slots.size());
 
   size_t iF = 0;
-  size_t iFront = 0;
-  size_t iBack = 3 * parent.nFacesTriangulation() - 3;
   for (size_t iC = 0; iC < parent.nCells(); iC++) {
-    const std::array<int64_t, 8>& cell = parent.cells[iC];
     VolumeCellType cellT = parent.cellType(iC);
     for (const std::vector<std::array<size_t, 3>>& face : parent.cellStencil(cellT)) {
 
@@ -347,13 +404,7 @@ void VolumeMeshCellScalarQuantity::fillColorBuffers(render::ShaderProgram& p) {
 
         // (see note in VolumeMesh.cpp about sorting the buffer outside-first)
         size_t iData;
-        if (parent.faceIsInterior[iF]) {
-          iData = iBack;
-          iBack -= 3;
-        } else {
-          iData = iFront;
-          iFront += 3;
-        }
+        if (!slots.next(parent.faceIsInterior[iF], iData)) continue;
 
         for (int k = 0; k < 3; k++) {
           colorval[iData + k] = values[iC];
@@ -376,5 +427,6 @@ void VolumeMeshCellScalarQuantity::buildCellInfoGUI(size_t cInd) {
   ImGui::NextColumn();
 }
 
+size_t VolumeMeshScalarQuantity::hostMemoryUsage() { return values.allocatedBytes(); }
 
 } // namespace polyscope
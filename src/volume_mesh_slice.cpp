@@ -0,0 +1,111 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/volume_mesh_slice.h"
+
+#include "polyscope/polyscope.h"
+#include "polyscope/slice_plane.h"
+#include "polyscope/volume_mesh.h"
+
+#include <utility>
+
+namespace polyscope {
+
+VolumeMeshSlice::VolumeMeshSlice(VolumeMesh& mesh_, const std::vector<std::string>& captureRules,
+                                 const std::vector<std::string>& drawRules,
+                                 std::shared_ptr<render::GPUMemoryAccount> account_)
+    : mesh(mesh_), account(account_), capturesValue(!captureRules.empty()) {
+
+  std::vector<std::string> rules = {"SLICE_TETS_CAPTURE_POSITION"};
+  rules.insert(rules.end(), captureRules.begin(), captureRules.end());
+  captureProgram = render::engine->requestShader(capturesValue ? "SLICE_TETS_CAPTURE_WITH_VALUE" : "SLICE_TETS_CAPTURE",
+                                                 rules, render::ShaderReplacementDefaults::Process);
+  mesh.fillSliceGeometryBuffers(*captureProgram);
+
+  drawProgram = render::engine->requestShader("SLICE_TETS_CACHED", mesh.addVolumeMeshRules(drawRules, true, true));
+  render::engine->setMaterial(*drawProgram, mesh.getMaterial());
+}
+
+void VolumeMeshSlice::draw(SlicePlane* sp) {
+  auto it = captures.find(sp);
+  if (it == captures.end()) {
+    Capture newCapture;
+    newCapture.drawn = generateBuffers();
+    newCapture.cutting = generateBuffers();
+    it = captures.insert({sp, newCapture}).first;
+  }
+  Capture& capture = it->second;
+
+  // The same comparison as the tet selection of VolumeMesh::setSliceTetBuffers(). A plane which moves again while a
+  // cut is in flight is cut at its latest pose once that one lands.
+  glm::vec3 normal = sp->getNormal();
+  float offset = glm::dot(sp->getCenter(), normal);
+  if (!capture.pending && (capture.nVertices < 0 || capture.drawn.normal != normal || capture.drawn.offset != offset)) {
+    recapture(sp, capture);
+  }
+
+  // Swap in the cut once its count is ready. The first cut of a plane has nothing to show meanwhile, so it waits.
+  if (capture.pending) {
+    if (capture.nVertices < 0 || capture.pending->isReady()) {
+      capture.nVertices = static_cast<long int>(capture.pending->getVertexCount());
+      std::swap(capture.drawn, capture.cutting);
+      capture.pending.reset();
+    } else {
+      requestRedraw();
+    }
+  }
+
+  drawProgram->setAttribute("a_slicePosition", capture.drawn.positions);
+  if (capturesValue) {
+    drawProgram->setAttribute("a_sliceValue", capture.drawn.values);
+  }
+  drawProgram->setDrawLimit(capture.nVertices);
+  drawProgram->setUniform("u_sliceVector", capture.drawn.normal);
+  drawProgram->draw();
+}
+
+void VolumeMeshSlice::removePlane(const SlicePlane* sp) { captures.erase(sp); }
+
+void VolumeMeshSlice::recapture(SlicePlane* sp, Capture& capture) {
+  sp->setSliceGeomUniforms(*captureProgram);
+  size_t nTets = mesh.setSliceTetBuffers(*captureProgram, sp);
+
+  // Record positions as the mesh stores them, the draw program transforms them
+  glm::mat4 identity(1.0);
+  captureProgram->setUniform("u_modelView", glm::value_ptr(identity));
+  captureProgram->setUniform("u_projMatrix", glm::value_ptr(identity));
+
+  CaptureBuffers& buffers = capture.cutting;
+  std::vector<std::shared_ptr<render::AttributeBuffer>> outputs = {buffers.positions};
+  if (capturesValue) {
+    outputs.push_back(buffers.values);
+  }
+
+  // A plane cuts a tet in a triangle or a quad, so each tet emits at most 2 triangles. With room for that, every
+  // triangle fits and the count is only needed to draw.
+  long int maxVertices = static_cast<long int>(6 * nTets);
+  if (buffers.positions->getDataSize() < maxVertices) {
+    render::ScopedGPUMemoryAccount scopedAccount(account);
+    for (std::shared_ptr<render::AttributeBuffer>& buff : outputs) {
+      buff->allocate(maxVertices + maxVertices / 4); // (with some room for the next poses)
+    }
+  }
+
+  capture.pending = captureProgram->capture(outputs);
+  buffers.normal = sp->getNormal();
+  buffers.offset = glm::dot(sp->getCenter(), buffers.normal);
+  render::engine->renderStats.sliceCaptures++;
+}
+
+VolumeMeshSlice::CaptureBuffers VolumeMeshSlice::generateBuffers() {
+  // Start out with no storage, the first cut sizes them
+  CaptureBuffers buffers;
+  render::ScopedGPUMemoryAccount scopedAccount(account);
+  buffers.positions = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+  buffers.positions->allocate(0);
+  if (capturesValue) {
+    buffers.values = render::engine->generateAttributeBuffer(render::DataType::Vector3Float);
+    buffers.values->allocate(0);
+  }
+  return buffers;
+}
+
+} // namespace polyscope
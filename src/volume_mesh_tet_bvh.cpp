@@ -0,0 +1,68 @@
+// Copyright 2017-2019, Nicholas Sharp and the Polyscope contributors. http://polyscope.run.
+#include "polyscope/volume_mesh_tet_bvh.h"
+
+#include "polyscope/parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace polyscope {
+
+const size_t VolumeMeshTetBVH::tetsPerLeaf;
+
+VolumeMeshTetBVH::VolumeMeshTetBVH(const std::vector<glm::vec3>& vertices,
+                                   const std::vector<std::array<uint32_t, 4>>& tets)
+    : bvh(buildHierarchy(vertices, tets)) {
+  if (tets.empty()) return;
+
+  glm::vec3 bboxMin{std::numeric_limits<float>::infinity()};
+  glm::vec3 bboxMax{-std::numeric_limits<float>::infinity()};
+  for (const glm::vec3& p : vertices) {
+    bboxMin = glm::min(bboxMin, p);
+    bboxMax = glm::max(bboxMax, p);
+  }
+  slack = 1e-5f * (glm::length(bboxMax - bboxMin) + std::max(glm::length(bboxMin), glm::length(bboxMax)));
+}
+
+ElementBVH VolumeMeshTetBVH::buildHierarchy(const std::vector<glm::vec3>& vertices,
+                                            const std::vector<std::array<uint32_t, 4>>& tets) {
+  if (tets.size() >= std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("volume mesh tet hierarchy can hold at most 2^32 - 1 tets");
+  }
+
+  std::vector<glm::vec3> tetMin(tets.size());
+  std::vector<glm::vec3> tetMax(tets.size());
+  parallelFor(0, tets.size(), [&](size_t iT) {
+    tetMin[iT] = glm::vec3{std::numeric_limits<float>::infinity()};
+    tetMax[iT] = glm::vec3{-std::numeric_limits<float>::infinity()};
+    for (uint32_t iV : tets[iT]) {
+      tetMin[iT] = glm::min(tetMin[iT], vertices[iV]);
+      tetMax[iT] = glm::max(tetMax[iT], vertices[iV]);
+    }
+  });
+  return ElementBVH(tetMin, tetMax, tetsPerLeaf);
+}
+
+std::vector<uint32_t> VolumeMeshTetBVH::tetsCrossingPlane(const std::vector<glm::vec3>& vertices,
+                                                          const std::vector<std::array<uint32_t, 4>>& tets,
+                                                          glm::vec3 normal, float offset) const {
+
+  std::vector<uint32_t> crossing;
+  bvh.forEachNearPlane(normal, offset, slack, [&](uint32_t iT) {
+    float minDist = std::numeric_limits<float>::infinity();
+    float maxDist = -std::numeric_limits<float>::infinity();
+    for (uint32_t iV : tets[iT]) {
+      float d = glm::dot(normal, vertices[iV]) - offset;
+      minDist = std::min(minDist, d);
+      maxDist = std::max(maxDist, d);
+    }
+    if (minDist <= slack && maxDist >= -slack) {
+      crossing.push_back(iT);
+    }
+  });
+  return crossing;
+}
+
+} // namespace polyscope
@@ -16,8 +16,8 @@ VolumeMeshVectorQuantity::VolumeMeshVectorQuantity(std::string name, VolumeMesh&
     : VolumeMeshQuantity(name, mesh_), vectorType(vectorType_) {}
 
 
-void VolumeMeshVectorQuantity::prepareVectorArtist() {
-  vectorArtist.reset(new VectorArtist(parent, name + "#vectorartist", vectorRoots, vectors, vectorType));
+void VolumeMeshVectorQuantity::prepareVectorArtist(std::shared_ptr<render::AttributeBuffer> rootBuffer) {
+  vectorArtist.reset(new VectorArtist(parent, name + "#vectorartist", rootBuffer, vectors, vectorType));
 }
 
 void VolumeMeshVectorQuantity::draw() {
@@ -33,6 +33,8 @@ void VolumeMeshVectorQuantity::buildCustomUI() {
 
 void VolumeMeshVectorQuantity::drawSubUI() {}
 
+void VolumeMeshVectorQuantity::dataUpdated() { vectorArtist->vectorsChanged(); }
+
 VolumeMeshVectorQuantity* VolumeMeshVectorQuantity::setVectorLengthScale(double newLength, bool isRelative) {
   vectorArtist->setVectorLengthScale(newLength, isRelative);
   return this;
@@ -67,10 +69,7 @@ VolumeMeshVertexVectorQuantity::VolumeMeshVertexVectorQuantity(std::string name,
   refresh();
 }
 
-void VolumeMeshVertexVectorQuantity::refresh() {
-  vectorRoots = parent.vertices;
-  prepareVectorArtist();
-}
+void VolumeMeshVertexVectorQuantity::refresh() { prepareVectorArtist(parent.getVertexPositionBuffer()); }
 
 void VolumeMeshVertexVectorQuantity::buildVertexInfoGUI(size_t iV) {
   ImGui::TextUnformatted(name.c_str());
@@ -99,13 +98,7 @@ VolumeMeshCellVectorQuantity::VolumeMeshCellVectorQuantity(std::string name, std
   refresh();
 }
 
-void VolumeMeshCellVectorQuantity::refresh() {
-  vectorRoots.resize(parent.nCells());
-  for (size_t iC = 0; iC < parent.nCells(); iC++) {
-    vectorRoots[iC] = parent.cellCenter(iC);
-  }
-  prepareVectorArtist();
-}
+void VolumeMeshCellVectorQuantity::refresh() { prepareVectorArtist(parent.getCellCenterBuffer()); }
 
 void VolumeMeshCellVectorQuantity::buildCellInfoGUI(size_t iF) {
   ImGui::TextUnformatted(name.c_str());
@@ -123,4 +116,6 @@ void VolumeMeshCellVectorQuantity::buildCellInfoGUI(size_t iF) {
 
 std::string VolumeMeshCellVectorQuantity::niceName() { return name + " (cell vector)"; }
 
+size_t VolumeMeshVectorQuantity::hostMemoryUsage() { return allocatedBytes(vectors); }
+
 } // namespace polyscope
@@ -0,0 +1,329 @@
+// Benchmarks for the CPU-side work of preparing structures for rendering, run against the mock backend so that only
+// polyscope's own code is measured.
+//
+// Sizes are numbers of elements (faces, cells, edges, or array entries). The largest sizes need several GB of memory;
+// use --benchmark_filter to run a subset, e.g. --benchmark_filter='SurfaceMesh.*/100000'.
+
+#include "polyscope/affine_remapper.h"
+#include "polyscope/curve_network.h"
+#include "polyscope/element_bvh.h"
+#include "polyscope/histogram.h"
+#include "polyscope/polyscope.h"
+#include "polyscope/standardize_data_array.h"
+#include "polyscope/surface_mesh.h"
+#include "polyscope/volume_mesh.h"
+
+#include "benchmark/benchmark.h"
+
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+// === Synthetic data
+
+// A grid of triangles in the plane, with about nFaces faces
+std::tuple<std::vector<glm::vec3>, std::vector<std::array<size_t, 3>>> gridMesh(size_t nFaces) {
+  size_t n = std::max<size_t>(1, static_cast<size_t>(std::sqrt(nFaces / 2.)));
+  std::vector<glm::vec3> points;
+  std::vector<std::array<size_t, 3>> faces;
+  points.reserve((n + 1) * (n + 1));
+  faces.reserve(2 * n * n);
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= n; j++) {
+      points.push_back(glm::vec3{i, j, std::sin(0.1 * i) * std::cos(0.1 * j)});
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      size_t v = i * (n + 1) + j;
+      faces.push_back({v, v + n + 1, v + 1});
+      faces.push_back({v + 1, v + n + 1, v + n + 2});
+    }
+  }
+  return std::make_tuple(points, faces);
+}
+
+// A cube of hexahedra, with about nCells cells
+std::tuple<std::vector<glm::vec3>, std::vector<std::array<int64_t, 8>>> hexGrid(size_t nCells) {
+  size_t n = std::max<size_t>(1, static_cast<size_t>(std::cbrt(static_cast<double>(nCells))));
+  auto ind = [n](size_t i, size_t j, size_t k) { return static_cast<int64_t>((i * (n + 1) + j) * (n + 1) + k); };
+  std::vector<glm::vec3> points;
+  std::vector<std::array<int64_t, 8>> cells;
+  points.reserve((n + 1) * (n + 1) * (n + 1));
+  cells.reserve(n * n * n);
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= n; j++) {
+      for (size_t k = 0; k <= n; k++) {
+        points.push_back(glm::vec3{i, j, k});
+      }
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      for (size_t k = 0; k < n; k++) {
+        // (same vertex ordering as polyscope's hex convention: bottom face, then top face)
+        cells.push_back({ind(i, j, k), ind(i + 1, j, k), ind(i + 1, j + 1, k), ind(i, j + 1, k), ind(i, j, k + 1),
+                         ind(i + 1, j, k + 1), ind(i + 1, j + 1, k + 1), ind(i, j + 1, k + 1)});
+      }
+    }
+  }
+  return std::make_tuple(points, cells);
+}
+
+std::vector<double> randomValues(size_t n) {
+  std::mt19937 gen(17);
+  std::normal_distribution<double> dist(0., 1.);
+  std::vector<double> vals(n);
+  for (double& v : vals) v = dist(gen);
+  return vals;
+}
+
+polyscope::SurfaceMesh* registerGridMesh(size_t nFaces) {
+  std::vector<glm::vec3> points;
+  std::vector<std::array<size_t, 3>> faces;
+  std::tie(points, faces) = gridMesh(nFaces);
+  return polyscope::registerSurfaceMesh("bench mesh", points, faces);
+}
+
+polyscope::VolumeMesh* registerHexGrid(size_t nCells) {
+  std::vector<glm::vec3> points;
+  std::vector<std::array<int64_t, 8>> cells;
+  std::tie(points, cells) = hexGrid(nCells);
+  return polyscope::registerVolumeMesh("bench volume", points, cells);
+}
+
+// === Surface meshes
+
+void BM_SurfaceMeshComputeCounts(benchmark::State& state) {
+  polyscope::SurfaceMesh* mesh = registerGridMesh(state.range(0));
+  for (auto _ : state) {
+    mesh->computeCounts();
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->nFaces());
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_SurfaceMeshComputeCounts)->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMillisecond);
+
+void BM_SurfaceMeshComputeGeometryData(benchmark::State& state) {
+  polyscope::SurfaceMesh* mesh = registerGridMesh(state.range(0));
+  for (auto _ : state) {
+    mesh->computeGeometryData();
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->nFaces());
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_SurfaceMeshComputeGeometryData)
+    ->RangeMultiplier(10)
+    ->Range(10000, 10000000)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_SurfaceMeshFillGeometryBuffers(benchmark::State& state) {
+  polyscope::SurfaceMesh* mesh = registerGridMesh(state.range(0));
+  std::shared_ptr<polyscope::render::ShaderProgram> program =
+      polyscope::render::engine->requestShader("MESH", mesh->addSurfaceMeshRules({"SHADE_BASECOLOR"}));
+  for (auto _ : state) {
+    // the per-corner buffers are shared and only built once, so drop them each time
+    state.PauseTiming();
+    mesh->refresh();
+    state.ResumeTiming();
+    mesh->fillGeometryBuffers(*program);
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->nFaces());
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_SurfaceMeshFillGeometryBuffers)
+    ->RangeMultiplier(10)
+    ->Range(10000, 10000000)
+    ->Unit(benchmark::kMillisecond);
+
+// preparePick() is private, so this goes through the lazy path: a refresh drops the pick program, and the next pick
+// draw rebuilds and refills it.
+void BM_SurfaceMeshPreparePick(benchmark::State& state) {
+  polyscope::SurfaceMesh* mesh = registerGridMesh(state.range(0));
+  for (auto _ : state) {
+    mesh->refresh();
+    mesh->drawPick();
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->nFaces());
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_SurfaceMeshPreparePick)->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMillisecond);
+
+void BM_ElementBVHBuild(benchmark::State& state) {
+  std::vector<glm::vec3> points;
+  std::vector<std::array<size_t, 3>> faces;
+  std::tie(points, faces) = gridMesh(state.range(0));
+  std::vector<glm::vec3> faceMin(faces.size()), faceMax(faces.size());
+  for (size_t iF = 0; iF < faces.size(); iF++) {
+    faceMin[iF] = glm::min(glm::min(points[faces[iF][0]], points[faces[iF][1]]), points[faces[iF][2]]);
+    faceMax[iF] = glm::max(glm::max(points[faces[iF][0]], points[faces[iF][1]]), points[faces[iF][2]]);
+  }
+  for (auto _ : state) {
+    polyscope::ElementBVH bvh(faceMin, faceMax);
+    benchmark::DoNotOptimize(bvh.nNodes());
+  }
+  state.SetItemsProcessed(state.iterations() * faces.size());
+}
+BENCHMARK(BM_ElementBVHBuild)->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMillisecond);
+
+// (items are rays, cast straight down on to the grid from spread out points above it)
+void BM_SurfaceMeshCPUPickRayCast(benchmark::State& state) {
+  polyscope::SurfaceMesh* mesh = registerGridMesh(state.range(0));
+  float extent = mesh->vertices.back().x;
+  float tHit;
+  size_t localInd;
+  mesh->rayCastElement(glm::vec3{0., 0., 10.}, glm::vec3{0., 0., -1.}, tHit, localInd); // builds the hierarchy
+  size_t iRay = 0;
+  for (auto _ : state) {
+    glm::vec3 start{std::fmod(iRay * 0.618034f, 1.f) * extent, std::fmod(iRay * 0.414214f, 1.f) * extent, 10.};
+    benchmark::DoNotOptimize(mesh->rayCastElement(start, glm::vec3{0., 0., -1.}, tHit, localInd));
+    iRay++;
+  }
+  state.SetItemsProcessed(state.iterations());
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_SurfaceMeshCPUPickRayCast)->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMicrosecond);
+
+// === Volume meshes
+
+void BM_VolumeMeshComputeCounts(benchmark::State& state) {
+  polyscope::VolumeMesh* mesh = registerHexGrid(state.range(0));
+  for (auto _ : state) {
+    mesh->computeCounts();
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->nCells());
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_VolumeMeshComputeCounts)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+
+void BM_VolumeMeshComputeTets(benchmark::State& state) {
+  polyscope::VolumeMesh* mesh = registerHexGrid(state.range(0));
+  for (auto _ : state) {
+    mesh->computeTets();
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->nCells());
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_VolumeMeshComputeTets)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+
+void BM_VolumeMeshTetBVHBuild(benchmark::State& state) {
+  polyscope::VolumeMesh* mesh = registerHexGrid(state.range(0));
+  mesh->ensureHaveTets();
+  for (auto _ : state) {
+    polyscope::VolumeMeshTetBVH bvh(mesh->vertices, mesh->tets);
+    benchmark::DoNotOptimize(bvh.nNodes());
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->nTets());
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_VolumeMeshTetBVHBuild)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+
+// (items are all tets, so the rate shows how much cheaper slicing is than visiting the whole volume)
+void BM_VolumeMeshTetBVHSlice(benchmark::State& state) {
+  polyscope::VolumeMesh* mesh = registerHexGrid(state.range(0));
+  mesh->ensureHaveTets();
+  polyscope::VolumeMeshTetBVH bvh(mesh->vertices, mesh->tets);
+  glm::vec3 normal = glm::normalize(glm::vec3{1., 2., 3.});
+  float offset = glm::dot(normal, 0.5f * (mesh->vertices.front() + mesh->vertices.back()));
+  for (auto _ : state) {
+    std::vector<uint32_t> crossing = bvh.tetsCrossingPlane(mesh->vertices, mesh->tets, normal, offset);
+    benchmark::DoNotOptimize(crossing.data());
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->nTets());
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_VolumeMeshTetBVHSlice)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+
+// === Curve networks
+
+void BM_CurveNetworkFillEdgeGeometryBuffers(benchmark::State& state) {
+  size_t nEdges = state.range(0);
+  std::vector<glm::vec3> nodes(nEdges + 1);
+  for (size_t i = 0; i <= nEdges; i++) {
+    nodes[i] = glm::vec3{std::cos(1e-3 * i), std::sin(1e-3 * i), 1e-5 * i};
+  }
+  polyscope::CurveNetwork* curve = polyscope::registerCurveNetworkLine("bench curve", nodes);
+  std::shared_ptr<polyscope::render::ShaderProgram> program = polyscope::render::engine->requestShader(
+      "RAYCAST_CYLINDER", curve->addCurveNetworkEdgeRules({"SHADE_BASECOLOR"}));
+  for (auto _ : state) {
+    curve->fillEdgeGeometryBuffers(*program);
+  }
+  state.SetItemsProcessed(state.iterations() * nEdges);
+  polyscope::removeAllStructures();
+}
+BENCHMARK(BM_CurveNetworkFillEdgeGeometryBuffers)
+    ->RangeMultiplier(10)
+    ->Range(10000, 50000000)
+    ->Unit(benchmark::kMillisecond);
+
+// === Quantity data
+
+void BM_HistogramBuild(benchmark::State& state) {
+  std::vector<double> values = randomValues(state.range(0));
+  polyscope::Histogram hist;
+  for (auto _ : state) {
+    hist.buildHistogram(values);
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_HistogramBuild)->RangeMultiplier(10)->Range(10000, 50000000)->Unit(benchmark::kMillisecond);
+
+void BM_RobustMinMax(benchmark::State& state) {
+  std::vector<double> values = randomValues(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(polyscope::robustMinMax(values));
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_RobustMinMax)->RangeMultiplier(10)->Range(10000, 50000000)->Unit(benchmark::kMillisecond);
+
+void BM_ApproximatePercentileRange(benchmark::State& state) {
+  std::vector<double> values = randomValues(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(polyscope::approximatePercentileRange(values, 1., 99.));
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ApproximatePercentileRange)->RangeMultiplier(10)->Range(10000, 50000000)->Unit(benchmark::kMillisecond);
+
+void BM_StandardizeVectorArray(benchmark::State& state) {
+  std::vector<double> values = randomValues(3 * state.range(0));
+  std::vector<std::array<double, 3>> vectors(state.range(0));
+  for (size_t i = 0; i < vectors.size(); i++) {
+    vectors[i] = {values[3 * i + 0], values[3 * i + 1], values[3 * i + 2]};
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(polyscope::standardizeVectorArray<glm::vec3, 3>(vectors));
+  }
+  state.SetItemsProcessed(state.iterations() * vectors.size());
+}
+BENCHMARK(BM_StandardizeVectorArray)->RangeMultiplier(10)->Range(10000, 50000000)->Unit(benchmark::kMillisecond);
+
+void BM_PointSetExtents(benchmark::State& state) {
+  std::vector<glm::vec3> points = std::get<0>(gridMesh(2 * state.range(0)));
+  glm::vec3 bboxMin, bboxMax;
+  float lengthScale;
+  for (auto _ : state) {
+    polyscope::computePointSetExtents(points, bboxMin, bboxMax, lengthScale);
+    benchmark::DoNotOptimize(lengthScale);
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_PointSetExtents)->RangeMultiplier(10)->Range(10000, 50000000)->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+  polyscope::options::verbosity = 0;
+  polyscope::init("openGL_mock");
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
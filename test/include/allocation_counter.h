@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+// The test executable replaces the global operator new / delete (see allocation_counter.cpp), counting every
+// allocation made on any thread. A counter reports the allocations made during its lifetime, so that tests can hold
+// code to an allocation budget. With thisThreadOnly it counts only those of the thread which made it, so that work on
+// other threads (worker pools, background compiles) cannot change an exact count.
+class ScopedAllocationCounter {
+public:
+  ScopedAllocationCounter(bool thisThreadOnly = false);
+
+  size_t allocations() const; // number of allocations since construction
+  size_t bytes() const;       // total size of those allocations (frees are not subtracted)
+
+private:
+  bool thisThreadOnly;
+  size_t currentAllocations() const;
+  size_t currentBytes() const;
+  size_t startAllocations;
+  size_t startBytes;
+};
@@ -0,0 +1,45 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replacements for the global allocation functions, which count into the totals below. All other forms of operator
+// new / delete (arrays, nothrow) forward to these by default.
+
+namespace {
+std::atomic<size_t> totalAllocations(0);
+std::atomic<size_t> totalBytes(0);
+thread_local size_t threadAllocations = 0; // the same, for the calling thread alone
+thread_local size_t threadBytes = 0;
+} // namespace
+
+void* operator new(std::size_t size) {
+  totalAllocations.fetch_add(1, std::memory_order_relaxed);
+  totalBytes.fetch_add(size, std::memory_order_relaxed);
+  threadAllocations++;
+  threadBytes += size;
+  if (size == 0) size = 1;
+  while (true) {
+    void* ptr = std::malloc(size);
+    if (ptr) return ptr;
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+ScopedAllocationCounter::ScopedAllocationCounter(bool thisThreadOnly_)
+    : thisThreadOnly(thisThreadOnly_), startAllocations(currentAllocations()), startBytes(currentBytes()) {}
+
+size_t ScopedAllocationCounter::allocations() const { return currentAllocations() - startAllocations; }
+
+size_t ScopedAllocationCounter::bytes() const { return currentBytes() - startBytes; }
+
+size_t ScopedAllocationCounter::currentAllocations() const {
+  return thisThreadOnly ? threadAllocations : totalAllocations.load();
+}
+
+size_t ScopedAllocationCounter::currentBytes() const { return thisThreadOnly ? threadBytes : totalBytes.load(); }
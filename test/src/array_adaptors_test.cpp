@@ -4,6 +4,8 @@
 #include "glm/glm.hpp"
 
 #include <array>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <list>
 #include <string>
@@ -291,6 +293,15 @@ TEST(ArrayAdaptorTests, adaptor_array_vectors) {
       (polyscope::standardizeVectorArray<glm::vec3, 3>(std::vector<std::array<double, 3>>{{0.1, 0.2, 0.3}}))[0][0], 0.1,
       1e-5);
 
+  // contiguous, same layout as the output (block copy)
+  std::vector<std::array<float, 3>> arr_arrfloat{{0.1f, 0.2f, 0.3f}, {0.4f, 0.5f, 0.6f}};
+  std::vector<glm::vec3> arr_arrfloatOut = polyscope::standardizeVectorArray<glm::vec3, 3>(arr_arrfloat);
+  ASSERT_EQ(arr_arrfloatOut.size(), 2);
+  EXPECT_EQ(arr_arrfloatOut[1], glm::vec3(0.4f, 0.5f, 0.6f));
+  std::vector<glm::vec2> arr_vec2{glm::vec2(1.f, 2.f)};
+  EXPECT_EQ((polyscope::standardizeVectorArray<glm::vec2, 2>(arr_vec2))[0], glm::vec2(1.f, 2.f));
+  EXPECT_TRUE((polyscope::standardizeVectorArray<glm::vec3, 3>(std::vector<glm::vec3>())).empty());
+
   // double callable access
   EXPECT_NEAR((polyscope::standardizeVectorArray<glm::vec3, 3>(userArrayVector_doubleCallable))[0][0], 0.1, 1e-5);
 
@@ -334,6 +345,26 @@ TEST(ArrayAdaptorTests, adaptor_array_vectors) {
 }
 
 
+// Test that large arrays converted on parallel threads match the serial conversion
+TEST(ArrayAdaptorTests, adaptor_array_vectors_parallel) {
+  std::vector<std::array<double, 3>> arr(250000);
+  for (size_t i = 0; i < arr.size(); i++) {
+    arr[i] = {{0.5 * i, -1. * i, 1e-3 * i}};
+  }
+
+  long long int oldThreshold = polyscope::options::parallelConversionThreshold;
+  polyscope::options::parallelConversionThreshold = -1;
+  std::vector<glm::vec3> serial = polyscope::standardizeVectorArray<glm::vec3, 3>(arr);
+  polyscope::options::parallelConversionThreshold = 1000;
+  std::vector<glm::vec3> parallel = polyscope::standardizeVectorArray<glm::vec3, 3>(arr);
+  polyscope::options::parallelConversionThreshold = oldThreshold;
+
+  ASSERT_EQ(serial.size(), arr.size());
+  EXPECT_TRUE(serial == parallel);
+  EXPECT_EQ(parallel.back(), glm::vec3(0.5 * 249999, -249999., 1e-3 * 249999));
+}
+
+
 // Test that nested access works
 TEST(ArrayAdaptorTests, adaptor_nested_array) {
 
@@ -355,3 +386,45 @@ TEST(ArrayAdaptorTests, adaptor_nested_array) {
   // Test user-specified
   EXPECT_EQ(polyscope::standardizeNestedList<size_t>(userArray_nestedListCustom)[1][3], 7);
 }
+
+TEST(ArrayAdaptorTests, adaptor_mapped_array) {
+
+  // Write a small .npy file: 4 x 3 float32, C order
+  std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': (4, 3), }";
+  header += std::string(128 - 10 - header.size() - 1, ' ') + "\n"; // pad the whole preamble to 128 bytes
+  std::vector<float> vals{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+  {
+    std::ofstream out("mapped_array_test.npy", std::ios::binary);
+    out.write("\x93NUMPY\x01\x00", 8);
+    unsigned char len[2] = {static_cast<unsigned char>(header.size()), 0};
+    out.write(reinterpret_cast<const char*>(len), 2);
+    out << header;
+    out.write(reinterpret_cast<const char*>(&vals[0]), vals.size() * sizeof(float));
+  }
+
+  polyscope::MappedArray arr = polyscope::MappedArray::fromNpy("mapped_array_test.npy");
+  EXPECT_EQ(arr.rows(), 4);
+  EXPECT_EQ(arr.cols(), 3);
+  EXPECT_EQ(arr(2, 1), 7.);
+
+  std::vector<glm::vec3> vecs = polyscope::standardizeVectorArray<glm::vec3, 3>(arr);
+  EXPECT_EQ(vecs.size(), 4);
+  EXPECT_EQ(vecs[3].z, 11.f);
+  std::vector<std::array<double, 3>> arrs = polyscope::standardizeVectorArray<std::array<double, 3>, 3>(arr);
+  EXPECT_EQ(arrs[1][2], 5.);
+  EXPECT_EQ((polyscope::standardizeNestedList<size_t>(arr))[2][0], 6);
+
+  // The same bytes as a raw file, read as one column from an offset
+  polyscope::MappedArray raw =
+      polyscope::MappedArray::fromRawFile("mapped_array_test.npy", polyscope::MappedArrayDType::Float32, 12, 1, 128);
+  std::vector<double> scalars = polyscope::standardizeArray<double>(raw);
+  EXPECT_EQ(scalars.size(), 12);
+  EXPECT_EQ(scalars[10], 10.);
+
+  // Copies share the mapping, which outlives the original
+  polyscope::MappedArray copy = arr;
+  arr = polyscope::MappedArray();
+  EXPECT_EQ(copy(3, 0), 9.);
+
+  std::remove("mapped_array_test.npy");
+}
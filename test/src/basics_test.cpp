@@ -1,19 +1,47 @@
 
 #include "polyscope_test.h"
 
+#include "allocation_counter.h"
+
+#include "polyscope/batch_render.h"
 #include "polyscope/curve_network.h"
+#include "polyscope/distributed.h"
+#include "polyscope/image_scalar_artist.h"
+#include "polyscope/instanced_surface_mesh.h"
+#include "polyscope/parallel.h"
 #include "polyscope/pick.h"
 #include "polyscope/point_cloud.h"
+#include "polyscope/point_cloud_stream.h"
+#include "polyscope/scene_snapshot.h"
+#include "polyscope/session_capture.h"
 #include "polyscope/polyscope.h"
+#include "polyscope/render/mock_opengl/mock_gl_engine.h"
+#include "polyscope/render/shader_builder.h"
 #include "polyscope/surface_mesh.h"
+#include "polyscope/surface_mesh_io.h"
+#include "polyscope/surface_sparse_scalar_quantity.h"
+#include "polyscope/trace_vector_field.h"
+#include "polyscope/volume_grid.h"
 #include "polyscope/volume_mesh.h"
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <clocale>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <list>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 
@@ -53,6 +81,28 @@ protected:
 // Show the gui. Note that the pre-suite script calls Polyscope::init() before
 TEST_F(PolyscopeTest, InitializeAndShow) { polyscope::show(3); }
 
+TEST_F(PolyscopeTest, LazyMaterialsAndColorMaps) {
+  // Bundled materials and colormaps are listed by name, but only loaded once used
+  auto findMaterial = [](std::string name) -> polyscope::render::Material* {
+    for (auto& m : polyscope::render::engine->materials) {
+      if (m->name == name) return m.get();
+    }
+    return nullptr;
+  };
+  polyscope::render::Material* jade = findMaterial("jade");
+  ASSERT_NE(jade, nullptr);
+  EXPECT_FALSE(jade->supportsRGB);
+  EXPECT_FALSE(jade->loaded);
+  EXPECT_EQ(jade->textureBuffers[0], nullptr);
+  polyscope::render::engine->getMaterial("jade");
+  EXPECT_TRUE(jade->loaded);
+  EXPECT_NE(jade->textureBuffers[0], nullptr);
+  EXPECT_EQ(jade->textureBuffers[3], jade->textureBuffers[0]); // one image, decoded and uploaded once
+  EXPECT_EQ(jade->textureBuffers[0]->getFormat(), polyscope::TextureFormat::BC6H_RGB16F);
+
+  EXPECT_FALSE(polyscope::render::engine->getColorMap("jet").values.empty());
+}
+
 // We should be able to nest calls to show() via the callback. ImGUI causes headaches here
 TEST_F(PolyscopeTest, NestedShow) {
 
@@ -63,6 +113,289 @@ TEST_F(PolyscopeTest, NestedShow) {
   polyscope::state::userCallback = nullptr;
 }
 
+TEST_F(PolyscopeTest, GPUTimings) {
+  polyscope::options::enableGPUProfiling = true;
+  polyscope::requestRedraw();
+  polyscope::show(3);
+
+  // The mock backend reports the regions, but zero for their times
+  std::vector<polyscope::render::GPUTiming> timings = polyscope::render::engine->getGPUTimings();
+  EXPECT_FALSE(timings.empty());
+  for (const polyscope::render::GPUTiming& t : timings) {
+    EXPECT_EQ(t.durationMs, 0.);
+  }
+
+  polyscope::render::engine->writeGPUTimingTrace("gpu_trace.json");
+  EXPECT_TRUE(std::ifstream("gpu_trace.json").good());
+  std::remove("gpu_trace.json");
+
+  polyscope::options::enableGPUProfiling = false;
+}
+
+TEST_F(PolyscopeTest, ShaderWarmup) {
+  // Queued programs are compiled during idle frames; ones which cannot be built are skipped
+  polyscope::render::engine->queueShaderWarmup("RAYCAST_SPHERE", {"SHADE_BASECOLOR"});
+  polyscope::render::engine->queueShaderWarmup("RAYCAST_SPHERE", {"NOT_A_RULE"});
+  EXPECT_EQ(polyscope::render::engine->shaderWarmupPending(), 2);
+  polyscope::show(10);
+  EXPECT_EQ(polyscope::render::engine->shaderWarmupPending(), 0);
+
+  // A profile of the programs requested so far queues them again
+  ASSERT_TRUE(polyscope::render::engine->saveShaderWarmupProfile("shader_profile.json"));
+  ASSERT_TRUE(polyscope::render::engine->loadShaderWarmupProfile("shader_profile.json"));
+  EXPECT_GT(polyscope::render::engine->shaderWarmupPending(), 0);
+  std::remove("shader_profile.json");
+  while (polyscope::render::engine->processShaderWarmup()) {
+  }
+  EXPECT_EQ(polyscope::render::engine->shaderWarmupPending(), 0);
+}
+
+TEST_F(PolyscopeTest, AsyncScreenshot) {
+  polyscope::options::asyncScreenshots = true;
+  for (int i = 0; i < 4; i++) {
+    polyscope::screenshot("async_screenshot_" + std::to_string(i) + ".png", i % 2 == 0);
+  }
+  polyscope::flushScreenshots();
+  polyscope::options::asyncScreenshots = false;
+
+  for (int i = 0; i < 4; i++) {
+    std::string filename = "async_screenshot_" + std::to_string(i) + ".png";
+    EXPECT_TRUE(std::ifstream(filename).good());
+    std::remove(filename.c_str());
+  }
+}
+
+TEST_F(PolyscopeTest, RenderToBuffer) {
+  std::vector<unsigned char> buff = polyscope::renderToBuffer();
+  EXPECT_EQ(buff.size(), 4 * polyscope::view::bufferWidth * polyscope::view::bufferHeight);
+  buff = polyscope::renderToBuffer(false);
+  EXPECT_EQ(buff.size(), 4 * polyscope::view::bufferWidth * polyscope::view::bufferHeight);
+}
+
+TEST_F(PolyscopeTest, ScreenshotReusesRenderedScene) {
+  polyscope::show(3);
+  polyscope::renderToBuffer(); // (renders, if a redraw was pending)
+  polyscope::show(1);          // (which the display then catches up with)
+
+  // Nothing changed since the last render, so the scene is not rendered again, whatever the background
+  size_t renderCount = polyscope::state::sceneRenderCount;
+  std::vector<unsigned char> buffA = polyscope::renderToBuffer(true);
+  std::vector<unsigned char> buffB = polyscope::renderToBuffer(false);
+  EXPECT_EQ(polyscope::state::sceneRenderCount, renderCount);
+  EXPECT_EQ(buffA.size(), buffB.size());
+
+  // Changes render as usual
+  polyscope::requestRedraw();
+  polyscope::renderToBuffer();
+  EXPECT_EQ(polyscope::state::sceneRenderCount, renderCount + 1);
+}
+
+TEST_F(PolyscopeTest, ShaderReplacements) {
+  using namespace polyscope::render;
+  std::vector<ShaderStageSpecification> stages{
+      {ShaderStageType::Vertex, {}, {{"a_position", DataType::Vector3Float}}, {}, "a${ ONE }$b${ TWO }$c"}};
+  ShaderSourceTemplate tmpl = tokenizeShaderSource(stages[0].src);
+  EXPECT_EQ(tmpl.literals, (std::vector<std::string>{"a", "b", "c"}));
+  EXPECT_EQ(tmpl.tags, (std::vector<std::string>{"ONE", "TWO"}));
+
+  // Text from several rules at one tag is concatenated in order, and tags without any are left empty
+  ShaderReplacementRule ruleA("A", {{"ONE", "x"}}, {{"u_a", DataType::Float}}, {}, {});
+  ShaderReplacementRule ruleB("B", {{"ONE", "y"}});
+  std::vector<ShaderStageSpecification> result = applyShaderReplacements(stages, {ruleA, ruleB});
+  ASSERT_EQ(result.size(), 1u);
+  EXPECT_EQ(result[0].src, "a\n// tag ${ ONE }$\n// from rule: A\nx\n// from rule: B\ny\nb\n// tag ${ TWO }$\nc");
+  ASSERT_EQ(result[0].uniforms.size(), 1u);
+  EXPECT_EQ(result[0].uniforms[0].name, "u_a");
+}
+
+TEST_F(PolyscopeTest, UserShaderRules) {
+  using namespace polyscope::render;
+  // Rules registered at runtime are used alongside the built-in ones, and may be replaced
+  engine->registerShaderRule("TEST_USER_RULE", ShaderReplacementRule("TEST_USER_RULE", {{"FRAG_DECLARATIONS", ""}}));
+  engine->registerShaderRule("TEST_USER_RULE", ShaderReplacementRule("TEST_USER_RULE", {}));
+  std::shared_ptr<ShaderProgram> program =
+      engine->requestShader("RAYCAST_SPHERE", {"SHADE_BASECOLOR", "TEST_USER_RULE"});
+  EXPECT_NE(program, nullptr);
+  EXPECT_THROW(engine->requestShader("RAYCAST_SPHERE", {"NOT_A_RULE"}), std::runtime_error);
+
+  // and removed again
+  engine->unregisterShaderRule("TEST_USER_RULE");
+  EXPECT_THROW(engine->requestShader("RAYCAST_SPHERE", {"SHADE_BASECOLOR", "TEST_USER_RULE"}), std::runtime_error);
+}
+
+namespace {
+// Handles of a few uniforms, as a structure keeps them with its programs; counts how many times it is made
+int nTestHandlesMade = 0;
+struct TestUniformHandles {
+  TestUniformHandles(polyscope::render::ShaderProgram& p)
+      : modelView(p.getUniformHandle("u_modelView")), edgeColor(p.getUniformHandle("u_edgeColor")) {
+    nTestHandlesMade++;
+  }
+  polyscope::render::ShaderUniformHandle modelView, edgeColor;
+};
+} // namespace
+
+TEST_F(PolyscopeTest, ProgramUserData) {
+  using namespace polyscope::render;
+  // Data kept with a program is made once per program, from the program; handles of uniforms the program does not
+  // have are invalid
+  nTestHandlesMade = 0;
+  std::shared_ptr<ShaderProgram> program = engine->requestShader("RAYCAST_SPHERE", {"SHADE_BASECOLOR"});
+  const TestUniformHandles& h = program->userData<TestUniformHandles>();
+  EXPECT_TRUE(h.modelView.isValid());
+  EXPECT_EQ(h.modelView.index, program->getUniformHandle("u_modelView").index);
+  EXPECT_FALSE(h.edgeColor.isValid());
+  EXPECT_EQ(&program->userData<TestUniformHandles>(), &h);
+  EXPECT_EQ(nTestHandlesMade, 1);
+
+  std::shared_ptr<ShaderProgram> other = engine->requestShader("RAYCAST_SPHERE", {"SHADE_BASECOLOR"});
+  EXPECT_NE(&other->userData<TestUniformHandles>(), &h);
+  EXPECT_EQ(nTestHandlesMade, 2);
+}
+
+TEST_F(PolyscopeTest, TiledScreenshot) {
+  glm::mat4 projBefore = polyscope::view::getCameraPerspectiveMatrix();
+  int w = 5 * polyscope::view::bufferWidth / 2;
+  int h = 3 * polyscope::view::bufferHeight / 2;
+  polyscope::renderTiledScreenshot("tiled_screenshot.png", w, h, false);
+  EXPECT_FALSE(polyscope::view::projectionTile.active);
+  EXPECT_EQ(polyscope::view::getCameraPerspectiveMatrix(), projBefore);
+
+  // the size is in the IHDR chunk, after the signature
+  std::ifstream in("tiled_screenshot.png", std::ios::binary);
+  std::vector<unsigned char> header(24);
+  in.read(reinterpret_cast<char*>(header.data()), 24);
+  ASSERT_TRUE(in.good());
+  auto readBigEndian = [&](int offset) {
+    return (header[offset] << 24) | (header[offset + 1] << 16) | (header[offset + 2] << 8) | header[offset + 3];
+  };
+  EXPECT_EQ(readBigEndian(16), w);
+  EXPECT_EQ(readBigEndian(20), h);
+  in.close();
+  std::remove("tiled_screenshot.png");
+}
+
+TEST_F(PolyscopeTest, RecordImageSequence) {
+  polyscope::startRecording("recording.png");
+  EXPECT_TRUE(polyscope::isRecording());
+  polyscope::show(3);
+  polyscope::stopRecording();
+  EXPECT_FALSE(polyscope::isRecording());
+
+  for (int i = 0; i < 3; i++) {
+    std::string filename = "recording_00000" + std::to_string(i) + ".png";
+    EXPECT_TRUE(std::ifstream(filename).good());
+    std::remove(filename.c_str());
+  }
+}
+
+TEST_F(PolyscopeTest, RecordToSink) {
+  std::atomic<int> nFrames{0};
+  polyscope::startRecording([&](const std::vector<unsigned char>& rgba, int w, int h) {
+    EXPECT_EQ(rgba.size(), 4u * w * h);
+    nFrames++;
+  });
+  polyscope::show(3);
+  polyscope::stopRecording();
+  int nDrawn = nFrames;
+  EXPECT_GE(nDrawn, 1);
+
+  // Frames in which the scene was not redrawn are not passed on
+  polyscope::startRecording([&](const std::vector<unsigned char>& rgba, int w, int h) { nFrames++; });
+  polyscope::captureRecordingFrame(false);
+  polyscope::captureRecordingFrame(true);
+  polyscope::captureRecordingFrame(false);
+  polyscope::stopRecording();
+  EXPECT_EQ(nFrames, nDrawn + 1);
+}
+
+TEST_F(PolyscopeTest, QueuedInputEvents) {
+  polyscope::view::resetCameraToHomeView();
+  glm::mat4 viewBefore = polyscope::view::getCameraViewMatrix();
+
+  // A left drag across the window, right of the panels, rotates the view
+  auto mouseAt = [](float x, float y) {
+    polyscope::render::InputEvent e;
+    e.mousePos = glm::vec2{x, y} * glm::vec2{polyscope::view::windowWidth, polyscope::view::windowHeight};
+    return e;
+  };
+  polyscope::render::InputEvent press = mouseAt(0.6, 0.5);
+  press.button = 0;
+  press.pressed = true;
+  polyscope::render::InputEvent release = mouseAt(0.8, 0.5);
+  release.button = 0;
+  release.pressed = false;
+  polyscope::render::engine->queueInputEvent(mouseAt(0.6, 0.5));
+  polyscope::render::engine->queueInputEvent(press);
+  polyscope::render::engine->queueInputEvent(mouseAt(0.7, 0.5));
+  polyscope::render::engine->queueInputEvent(mouseAt(0.8, 0.5));
+  polyscope::render::engine->queueInputEvent(release);
+  EXPECT_TRUE(polyscope::render::engine->haveQueuedInput());
+  polyscope::show(6);
+  EXPECT_FALSE(polyscope::render::engine->haveQueuedInput());
+  EXPECT_NE(polyscope::view::getCameraViewMatrix(), viewBefore);
+
+  polyscope::view::resetCameraToHomeView();
+}
+
+TEST_F(PolyscopeTest, DistributedComposite) {
+  // Each rank draws one pixel of a 2x4 image, nearer the higher the rank; the rest is background
+  int nRanks = 3;
+  auto makeImage = [](int rank) {
+    polyscope::distributed::DepthImage image;
+    image.width = 2;
+    image.height = 4;
+    image.color.assign(4 * 8, 0);
+    image.depth.assign(8, 1.f);
+    image.owner.assign(8, -1);
+    for (int i : {rank, 7}) {
+      image.depth[i] = 0.5f - 0.1f * rank;
+      image.owner[i] = rank;
+      image.color[4 * i] = static_cast<unsigned char>(10 * (rank + 1));
+    }
+    return image;
+  };
+
+  // Ranks on threads, exchanging through mailboxes
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::map<std::pair<int, int>, std::list<std::vector<unsigned char>>> mailboxes;
+  std::vector<polyscope::distributed::DepthImage> results(nRanks);
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank < nRanks; rank++) {
+    threads.emplace_back([&, rank]() {
+      auto exchange = [&](int partner, const std::vector<unsigned char>& data) {
+        std::unique_lock<std::mutex> lock(mutex);
+        mailboxes[{rank, partner}].push_back(data);
+        cv.notify_all();
+        std::list<std::vector<unsigned char>>& inbox = mailboxes[{partner, rank}];
+        cv.wait(lock, [&]() { return !inbox.empty(); });
+        std::vector<unsigned char> received = inbox.front();
+        inbox.pop_front();
+        return received;
+      };
+      results[rank] = polyscope::distributed::binarySwapComposite(makeImage(rank), rank, nRanks, exchange);
+    });
+  }
+  for (std::thread& t : threads) t.join();
+
+  const polyscope::distributed::DepthImage& composite = results[0];
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(composite.owner[i], i);
+    EXPECT_EQ(composite.color[4 * i], 10 * (i + 1));
+  }
+  for (int i = 3; i < 7; i++) EXPECT_EQ(composite.owner[i], -1);
+  EXPECT_EQ(composite.ownerAt(1, 3), 2); // the nearest rank wins the shared pixel
+  EXPECT_FLOAT_EQ(composite.depth[7], 0.3f);
+
+  // Rendering this process's part of the view gives a matching color and depth
+  polyscope::registerPointCloud("distributed cloud", std::vector<glm::vec3>{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}});
+  polyscope::distributed::DepthImage image = polyscope::distributed::renderDepthImage(0);
+  EXPECT_EQ(image.color.size(), 4u * image.width * image.height);
+  EXPECT_EQ(image.depth.size(), static_cast<size_t>(image.width) * image.height);
+  EXPECT_EQ(image.owner.size(), image.depth.size());
+  polyscope::removeAllStructures();
+}
 
 // ============================================================
 // =============== Point cloud tests
@@ -100,6 +433,45 @@ TEST_F(PolyscopeTest, ShowPointCloud) {
   EXPECT_FALSE(polyscope::hasPointCloud("test1"));
 }
 
+TEST_F(PolyscopeTest, SceneExtents) {
+  // the blocked extents match a direct computation, for scattered points and in the presence of extra points
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<float> dist(-1., 1.);
+  std::vector<glm::vec3> points(20000);
+  for (glm::vec3& p : points) p = glm::vec3{dist(gen), 2.f * dist(gen), dist(gen)};
+  for (const std::vector<glm::vec3>& extra : {std::vector<glm::vec3>{}, std::vector<glm::vec3>{{5., 0., 0.}}}) {
+    glm::vec3 bboxMin, bboxMax;
+    float lengthScale;
+    polyscope::computePointSetExtents(points, bboxMin, bboxMax, lengthScale, extra);
+    glm::vec3 expectMin{std::numeric_limits<float>::infinity()}, expectMax{-std::numeric_limits<float>::infinity()};
+    std::vector<glm::vec3> all = points;
+    all.insert(all.end(), extra.begin(), extra.end());
+    for (const glm::vec3& p : all) {
+      expectMin = glm::min(expectMin, p);
+      expectMax = glm::max(expectMax, p);
+    }
+    float expectDist2 = 0.;
+    glm::vec3 center = 0.5f * (expectMin + expectMax);
+    for (const glm::vec3& p : all) expectDist2 = std::max(expectDist2, glm::dot(p - center, p - center));
+    EXPECT_EQ(bboxMin, expectMin);
+    EXPECT_EQ(bboxMax, expectMax);
+    EXPECT_EQ(lengthScale, 2 * std::sqrt(expectDist2));
+  }
+
+  // registering grows the scene extents, removing shrinks them again
+  polyscope::PointCloud* psA =
+      polyscope::registerPointCloud("extents a", std::vector<glm::vec3>{{0., 0., 0.}, {1., 1., 1.}});
+  EXPECT_EQ(std::get<1>(polyscope::state::boundingBox), glm::vec3(1., 1., 1.));
+  polyscope::registerPointCloud("extents b", std::vector<glm::vec3>{{0., 0., 0.}, {3., 1., 1.}});
+  EXPECT_EQ(std::get<1>(polyscope::state::boundingBox), glm::vec3(3., 1., 1.));
+  EXPECT_EQ(std::get<0>(polyscope::state::boundingBox), glm::vec3(0., 0., 0.));
+  polyscope::removeStructure("extents b");
+  EXPECT_EQ(std::get<1>(polyscope::state::boundingBox), glm::vec3(1., 1., 1.));
+  EXPECT_EQ(polyscope::state::lengthScale, psA->lengthScale());
+
+  polyscope::removeAllStructures();
+}
+
 TEST_F(PolyscopeTest, PointCloudAppearance) {
   auto psPoints = registerPointCloud();
 
@@ -131,6 +503,232 @@ TEST_F(PolyscopeTest, PointCloudPick) {
 }
 
 
+TEST_F(PolyscopeTest, PointCloudSplatEyeDome) {
+  auto psPoints = registerPointCloud();
+
+  psPoints->setPointRenderMode(polyscope::PointRenderMode::Splat);
+  EXPECT_EQ(psPoints->getPointRenderMode(), polyscope::PointRenderMode::Splat);
+  psPoints->setPointSplatSize(3.);
+  EXPECT_EQ(psPoints->getPointSplatSize(), 3.);
+  polyscope::show(3);
+
+  // with quantities, and picking
+  std::vector<double> vScalar(psPoints->nPoints(), 7.);
+  psPoints->addScalarQuantity("vScalar", vScalar)->setEnabled(true);
+  psPoints->setPointRadiusQuantity("vScalar");
+  polyscope::show(3);
+  polyscope::pick::evaluatePickQuery(77, 88);
+
+  polyscope::options::eyeDomeLighting = true;
+  polyscope::show(3);
+  polyscope::options::eyeDomeLighting = false;
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, PointCloudPickAsync) {
+  auto psPoints = registerPointCloud();
+
+  int nCallbacks = 0;
+  auto query = polyscope::pick::evaluatePickQueryAsync(
+      77, 88, [&](std::pair<polyscope::Structure*, size_t> result) { nCallbacks++; });
+  polyscope::pick::processAsyncPickQueries();
+  EXPECT_TRUE(query->isResolved);
+  EXPECT_EQ(nCallbacks, 1);
+
+  // Queries outside the buffer resolve immediately to nothing
+  auto outsideQuery = polyscope::pick::evaluatePickQueryAsync(-10, -10);
+  EXPECT_TRUE(outsideQuery->isResolved);
+  EXPECT_EQ(outsideQuery->result.first, nullptr);
+
+  // Queries in flight when the structure is removed do not return it
+  auto removedQuery = polyscope::pick::evaluatePickQueryAsync(77, 88);
+  polyscope::removeAllStructures();
+  polyscope::pick::processAsyncPickQueries();
+  EXPECT_TRUE(removedQuery->isResolved);
+  EXPECT_EQ(removedQuery->result.first, nullptr);
+}
+
+TEST_F(PolyscopeTest, PickRegionCulling) {
+  // Two clouds at either side of the view, with nothing between them
+  registerPointCloud("left");
+  registerPointCloud("right")->setPosition(glm::vec3{6., 0., 0.});
+  polyscope::show(1);
+  polyscope::view::lookAt(glm::vec3{3., 0., 15.}, glm::vec3{3., 0., 0.});
+  EXPECT_TRUE(polyscope::getPointCloud("left")->isInViewFrustum());
+  EXPECT_TRUE(polyscope::getPointCloud("right")->isInViewFrustum());
+
+  // Queries only draw the structures which could be under the cursor
+  polyscope::render::engine->resetRenderStats();
+  polyscope::pick::evaluatePickQuery(77, 88);
+  EXPECT_EQ(polyscope::render::engine->renderStats.structuresCulled, 2);
+
+  // (except when rendering the whole buffer)
+  polyscope::render::engine->resetRenderStats();
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  EXPECT_EQ(polyscope::render::engine->renderStats.structuresCulled, 0);
+
+  polyscope::removeAllStructures();
+  polyscope::view::resetCameraToHomeView();
+}
+
+TEST_F(PolyscopeTest, PickRegionQuery) {
+  auto psPoints = registerPointCloud();
+  auto psPoints2 = registerPointCloud("test2");
+  polyscope::show(1);
+
+  // Rectangle and lasso; the mock backend draws nothing, so just make sure these run
+  int w = polyscope::view::bufferWidth;
+  int h = polyscope::view::bufferHeight;
+  std::map<polyscope::Structure*, std::vector<size_t>> rectSelection =
+      polyscope::pick::queryRegion(glm::vec2{w / 4, h / 4}, glm::vec2{3 * w / 4, 3 * h / 4});
+  std::vector<glm::vec2> lasso = {{w / 2, 10}, {w - 10, h / 2}, {w / 2, h - 10}, {w / 2 + 1, h / 2}, {10, h / 2}};
+  std::map<polyscope::Structure*, std::vector<size_t>> lassoSelection = polyscope::pick::queryRegion(lasso);
+  for (auto& entry : lassoSelection) {
+    EXPECT_TRUE(entry.first == psPoints || entry.first == psPoints2);
+    EXPECT_TRUE(std::is_sorted(entry.second.begin(), entry.second.end()));
+  }
+
+  // Regions off the screen select nothing
+  EXPECT_TRUE(polyscope::pick::queryRegion(glm::vec2{-20, -20}, glm::vec2{-10, -10}).empty());
+  EXPECT_TRUE(polyscope::pick::queryRegion(std::vector<glm::vec2>{{0, 0}, {10, 10}}).empty());
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, PickBufferReuse) {
+  auto psPoints = registerPointCloud();
+  polyscope::show(1);
+
+  // Repeated queries on an unchanged frame only read the pick buffer again (here all of it, so nothing is culled)
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  polyscope::render::engine->resetRenderStats();
+  polyscope::pick::evaluatePickQuery(77, 88);
+  polyscope::pick::evaluatePickQuery(78, 87);
+  EXPECT_EQ(polyscope::render::engine->renderStats.drawCalls, 0);
+
+  // ... until something changes
+  polyscope::requestRedraw();
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  EXPECT_GT(polyscope::render::engine->renderStats.drawCalls, 0);
+
+  // Batched queries give the same results as single ones, and nothing for pixels off the buffer
+  std::vector<glm::ivec2> pixels = {{77, 88}, {10, 20}, {-5, 3}};
+  std::vector<std::pair<polyscope::Structure*, size_t>> results = polyscope::pick::evaluatePickQueries(pixels);
+  ASSERT_EQ(results.size(), 3);
+  EXPECT_EQ(results[0], polyscope::pick::evaluatePickQuery(77, 88));
+  EXPECT_EQ(results[1], polyscope::pick::evaluatePickQuery(10, 20));
+  EXPECT_EQ(results[2].first, nullptr);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, PickRangeRecycling) {
+  // (picks render the whole buffer, so the structure builds its pick buffer wherever it is on screen)
+  auto psPoints = registerPointCloud();
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  size_t start = polyscope::pick::localIndexToGlobal({psPoints, 0});
+  std::pair<polyscope::Structure*, size_t> local = polyscope::pick::globalIndexToLocal(start + 3);
+  EXPECT_EQ(local.first, psPoints);
+  EXPECT_EQ(local.second, 3);
+
+  // Rebuilding the pick buffer gives back the old range before taking a new one
+  psPoints->refresh();
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  EXPECT_EQ(polyscope::pick::localIndexToGlobal({psPoints, 0}), start);
+
+  // So does removing the structure
+  polyscope::removeAllStructures();
+  EXPECT_EQ(polyscope::pick::globalIndexToLocal(start + 3).first, nullptr);
+  psPoints = registerPointCloud("test2");
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  EXPECT_EQ(polyscope::pick::localIndexToGlobal({psPoints, 0}), start);
+
+  // But not while an asynchronous query which may have read it is in flight
+  auto query = polyscope::pick::evaluatePickQueryAsync(77, 88);
+  EXPECT_FALSE(query->isResolved);
+  polyscope::removeAllStructures();
+  psPoints = registerPointCloud("test3");
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  EXPECT_NE(polyscope::pick::localIndexToGlobal({psPoints, 0}), start);
+  polyscope::pick::processAsyncPickQueries();
+  EXPECT_TRUE(query->isResolved);
+  polyscope::removeAllStructures();
+  psPoints = registerPointCloud("test4");
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  EXPECT_EQ(polyscope::pick::localIndexToGlobal({psPoints, 0}), start);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CPUPicking) {
+  // A square in the z = 0 plane, a point above it, and an edge off to the side
+  std::vector<glm::vec3> squareVerts = {{-1, -1, 0}, {1, -1, 0}, {1, 1, 0}, {-1, 1, 0}};
+  std::vector<std::vector<size_t>> squareFaces = {{0, 1, 2, 3}};
+  auto psMesh = polyscope::registerSurfaceMesh("square", squareVerts, squareFaces);
+  auto psPoints = polyscope::registerPointCloud("point", std::vector<glm::vec3>{{0.5, 0.5, 2}});
+  psPoints->setPointRadius(0.1, false);
+  std::vector<glm::vec3> curveNodes = {{3, -1, 0}, {3, 1, 0}};
+  std::vector<std::array<size_t, 2>> curveEdges = {{0, 1}};
+  auto psCurve = polyscope::registerCurveNetwork("edge", curveNodes, curveEdges);
+  psCurve->setRadius(0.1, false);
+
+  // Straight down: the point first, then the face, or a vertex near its corners
+  float t;
+  std::pair<polyscope::Structure*, size_t> hit = polyscope::pick::rayCast({0.5, 0.5, 10}, {0, 0, -1}, &t);
+  EXPECT_EQ(hit.first, psPoints);
+  EXPECT_EQ(hit.second, 0);
+  EXPECT_NEAR(t, 7.9, 1e-4);
+  hit = polyscope::pick::rayCast({-0.5, 0.2, 10}, {0, 0, -2}, &t);
+  EXPECT_EQ(hit.first, psMesh);
+  EXPECT_EQ(hit.second, psMesh->nVertices() + 0);
+  EXPECT_NEAR(t, 5., 1e-4);
+  hit = polyscope::pick::rayCast({0.95, 0.95, 10}, {0, 0, -1});
+  EXPECT_EQ(hit.first, psMesh);
+  EXPECT_EQ(hit.second, 2);
+  hit = polyscope::pick::rayCast({3, 0, 10}, {0, 0, -1});
+  EXPECT_EQ(hit.first, psCurve);
+  EXPECT_EQ(hit.second, psCurve->nNodes() + 0);
+  EXPECT_EQ(polyscope::pick::rayCast({5, 5, 10}, {0, 0, -1}).first, nullptr);
+
+  // Moving a structure moves its elements
+  psPoints->translate({10, 0, 0});
+  EXPECT_EQ(polyscope::pick::rayCast({0.5, 0.5, 10}, {0, 0, -1}).first, psMesh);
+  EXPECT_EQ(polyscope::pick::rayCast({10.5, 0.5, 10}, {0, 0, -1}).first, psPoints);
+
+  // Closest elements, with distances in world units
+  float dist;
+  hit = polyscope::pick::closestElement({3.5, 0, 0}, &dist);
+  EXPECT_EQ(hit.first, psCurve);
+  EXPECT_NEAR(dist, 0.4, 1e-4);
+  hit = polyscope::pick::closestElement({-0.5, 0, 1}, &dist);
+  EXPECT_EQ(hit.first, psMesh);
+  EXPECT_NEAR(dist, 1., 1e-4);
+
+  // Pick queries are answered on the CPU when asked
+  polyscope::options::cpuPicking = true;
+  polyscope::view::lookAt({0, 0, 5}, {0, 0, 0});
+  hit = polyscope::pick::evaluatePickQuery(polyscope::view::bufferWidth / 2, polyscope::view::bufferHeight / 2);
+  EXPECT_EQ(hit.first, psMesh);
+  EXPECT_EQ(hit.second, psMesh->nVertices() + 0);
+  polyscope::options::cpuPicking = false;
+
+  polyscope::removeAllStructures();
+  polyscope::view::resetCameraToHomeView();
+}
+
+TEST_F(PolyscopeTest, ManyStructuresUI) {
+  // Long lists of structures and quantities have their UI rows clipped to those in view
+  for (int i = 0; i < 40; i++) {
+    auto psPoints = registerPointCloud("cloud " + std::to_string(i));
+    for (int j = 0; j < 10; j++) {
+      psPoints->addScalarQuantity("vals " + std::to_string(j), std::vector<double>(psPoints->nPoints(), j));
+    }
+  }
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
 TEST_F(PolyscopeTest, PointCloudColor) {
   auto psPoints = registerPointCloud();
   std::vector<glm::vec3> vColors(psPoints->nPoints(), glm::vec3{.2, .3, .4});
@@ -155,982 +753,4509 @@ TEST_F(PolyscopeTest, PointCloudScalar) {
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, PointCloudVector) {
+TEST_F(PolyscopeTest, PointCloudUpdateData) {
   auto psPoints = registerPointCloud();
-  std::vector<glm::vec3> vals(psPoints->nPoints(), {1., 2., 3.});
-  auto q1 = psPoints->addVectorQuantity("vals", vals);
+  size_t n = psPoints->nPoints();
+
+  // Scalar: the values change, the map range set by the user is kept
+  std::vector<double> vScalar(n);
+  for (size_t i = 0; i < n; i++) vScalar[i] = static_cast<double>(i);
+  auto q1 = psPoints->addScalarQuantity("vScalar", vScalar);
   q1->setEnabled(true);
+  q1->setMapRange(std::make_pair(1., 2.));
+  polyscope::show(3);
+  for (size_t i = 0; i < n; i++) vScalar[i] = -static_cast<double>(i);
+  q1->updateData(vScalar);
+  EXPECT_EQ(q1->values[1], -1.);
+  EXPECT_EQ(q1->getMapRange(), std::make_pair(1., 2.));
+  polyscope::show(3);
+  q1->resetMapRange();
+  EXPECT_EQ(q1->getMapRange(), std::make_pair(-double(n - 1), 0.));
+
+  // Color
+  auto q2 = psPoints->addColorQuantity("vColor", std::vector<glm::vec3>(n, glm::vec3{0.2, 0.3, 0.4}));
+  q2->setEnabled(true);
+  polyscope::show(3);
+  q2->updateData(std::vector<glm::vec3>(n, glm::vec3{0.5, 0.5, 0.5}));
+  EXPECT_EQ(q2->values[0], glm::vec3(0.5, 0.5, 0.5));
+  polyscope::show(3);
+
+  // Vector, also when decimated
+  auto q3 = psPoints->addVectorQuantity("vVector", std::vector<glm::vec3>(n, glm::vec3{1., 0., 0.}));
+  q3->setEnabled(true);
+  q3->setVectorColor(glm::vec3{1., 0., 0.});
+  polyscope::show(3);
+  q3->updateData(std::vector<glm::vec3>(n, glm::vec3{0., 2., 0.}));
+  EXPECT_EQ(q3->vectors[0], glm::vec3(0., 2., 0.));
+  EXPECT_EQ(q3->getVectorColor(), glm::vec3(1., 0., 0.));
+  polyscope::show(3);
+  q3->setDecimationEnabled(true);
   polyscope::show(3);
+  q3->updateData(std::vector<glm::vec3>(n, glm::vec3{0., 0., 3.}));
+  polyscope::show(3);
+
   polyscope::removeAllStructures();
 }
 
-
-TEST_F(PolyscopeTest, PointCloudParam) {
+TEST_F(PolyscopeTest, PointCloudChannels) {
   auto psPoints = registerPointCloud();
-  std::vector<glm::vec2> param(psPoints->nPoints(), glm::vec2{.2, .3});
+  size_t n = psPoints->nPoints();
+  std::vector<std::string> names{"a", "b", "c"};
+  std::vector<double> interleaved;
+  for (size_t i = 0; i < n; i++) {
+    interleaved.insert(interleaved.end(), {double(i), 2. * i, -1.});
+  }
+  auto q1 = psPoints->addInterleavedChannelsQuantity("channels", names, interleaved);
+  ASSERT_EQ(q1->nChannels(), 3);
+  EXPECT_EQ(q1->getChannelValue(1, 2), 4.f);
+  EXPECT_EQ(q1->getChannelRange(0), std::make_pair(0., double(n - 1)));
 
-  auto q1 = psPoints->addParameterizationQuantity("param", param);
+  // The displayed values, and the map range which follows them
   q1->setEnabled(true);
   polyscope::show(3);
-  
-  psPoints->setPointRenderMode(polyscope::PointRenderMode::Quad);
+  q1->setDisplayedChannel("b");
+  EXPECT_EQ(q1->displayedValue(3), 6.);
+  polyscope::show(3);
+  q1->setDisplayedCombination(1, 1., 0, -1.);
+  EXPECT_EQ(q1->displayedValue(3), 3.);
+  EXPECT_EQ(q1->getMapRange(), std::make_pair(-double(n - 1), 2. * (n - 1)));
   polyscope::show(3);
 
-  auto q2 = psPoints->addLocalParameterizationQuantity("local param", param);
-  psPoints->setPointRenderMode(polyscope::PointRenderMode::Sphere);
+  // Per-channel arrays give the same quantity
+  std::vector<std::vector<double>> channels(3);
+  for (size_t i = 0; i < n; i++) {
+    channels[0].push_back(i);
+    channels[1].push_back(2. * i);
+    channels[2].push_back(-1.);
+  }
+  auto q2 = psPoints->addChannelsQuantity("channels2", names, channels);
+  EXPECT_EQ(q2->getChannelValue(1, 2), 4.f);
   q2->setEnabled(true);
-  polyscope::show(3);
-  
   psPoints->setPointRenderMode(polyscope::PointRenderMode::Quad);
   polyscope::show(3);
-
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, PointCloudScalarRadius) {
+TEST_F(PolyscopeTest, PointCloudSparseScalar) {
   auto psPoints = registerPointCloud();
-  std::vector<double> vScalar(psPoints->nPoints(), 7.);
-  std::vector<double> vScalar2(psPoints->nPoints(), 7.);
-  auto q1 = psPoints->addScalarQuantity("vScalar", vScalar);
-  auto q2 = psPoints->addScalarQuantity("vScalar2", vScalar2);
+  size_t n = psPoints->nPoints();
+  std::vector<std::pair<size_t, double>> vals = {{n - 1, 3.}, {1, -1.}};
+  auto q1 = psPoints->addSparseScalarQuantity("vals", vals);
+  EXPECT_EQ(q1->getElements().getIndices(), std::vector<uint32_t>({1, uint32_t(n - 1)}));
+  EXPECT_EQ(q1->getValue(n - 1), 3.);
+  EXPECT_FALSE(q1->hasValue(0));
+  EXPECT_EQ(q1->getMapRange(), std::make_pair(-1., 3.));
   q1->setEnabled(true);
-
-  psPoints->setPointRadiusQuantity(q1);
   polyscope::show(3);
-  
   psPoints->setPointRenderMode(polyscope::PointRenderMode::Quad);
   polyscope::show(3);
+  polyscope::removeAllStructures();
+}
 
-  psPoints->setPointRadiusQuantity("vScalar2");
-  polyscope::show(3);
+TEST_F(PolyscopeTest, PointCloudExpression) {
+  auto psPoints = registerPointCloud();
+  size_t n = psPoints->nPoints();
+  std::vector<double> vScalar(n);
+  std::vector<glm::vec3> vVec(n);
+  for (size_t i = 0; i < n; i++) {
+    vScalar[i] = double(i);
+    vVec[i] = glm::vec3{3., 4., 0.};
+  }
+  psPoints->addScalarQuantity("vScalar", vScalar);
+  psPoints->addVectorQuantity("vec", vVec);
 
-  psPoints->setPointRadiusQuantity("vScalar2", false); // no autoscaling
+  auto q1 = psPoints->addExpressionQuantity("expr", "|vec| + 2 * {vScalar}");
+  ASSERT_NE(q1, nullptr);
+  EXPECT_EQ(q1->getExpression().getFieldNames().size(), 2);
+  EXPECT_NEAR(q1->getValue(3), 11., 1e-5);
+  q1->setEnabled(true);
   polyscope::show(3);
+  q1->resetMapRange();
+  q1->setColorMap("blues");
+  psPoints->setPointRenderMode(polyscope::PointRenderMode::Quad);
+  polyscope::show(3);
+  psPoints->setPointRenderMode(polyscope::PointRenderMode::Sphere);
 
-  psPoints->clearPointRadiusQuantity();
+  // Functions, components and precedence
+  auto q2 = psPoints->addExpressionQuantity("expr2", "max(vec.y, -vScalar ^ 2) - dot(normalize(vec), vec) / 5");
+  ASSERT_NE(q2, nullptr);
+  EXPECT_NEAR(q2->getValue(1), 3., 1e-5);
+
+  // Not scalars, unknown quantities, or not parsing
+  EXPECT_EQ(psPoints->addExpressionQuantity("bad1", "vec * 2"), nullptr);
+  EXPECT_EQ(psPoints->addExpressionQuantity("bad2", "|nope|"), nullptr);
+  EXPECT_EQ(psPoints->addExpressionQuantity("bad3", "vScalar +"), nullptr);
+  EXPECT_EQ(psPoints->addExpressionQuantity("bad4", "1 + 2"), nullptr);
   polyscope::show(3);
 
   polyscope::removeAllStructures();
 }
 
-// ============================================================
-// =============== Surface mesh tests
-// ============================================================
+TEST_F(PolyscopeTest, SharedColorMapTextures) {
+  std::vector<glm::vec3> ramp{{0., 0., 0.}, {1., 1., 1.}};
+  polyscope::updateColorMap("test_ramp", ramp);
 
-std::tuple<std::vector<glm::vec3>, std::vector<std::vector<size_t>>> getTriangleMesh() {
-  std::vector<glm::vec3> points;
-  std::vector<std::vector<size_t>> faces;
+  // Quantities drawing with one colormap share its texture
+  auto psPoints = registerPointCloud();
+  std::vector<double> vScalar(psPoints->nPoints(), 0.5);
+  auto q1 = psPoints->addScalarQuantity("vScalar1", vScalar);
+  auto q2 = psPoints->addScalarQuantity("vScalar2", vScalar);
+  q1->setColorMap("test_ramp");
+  q2->setColorMap("test_ramp");
+  q1->setEnabled(true);
+  polyscope::show(1);
+  q2->setEnabled(true);
+  polyscope::show(1);
+  std::shared_ptr<polyscope::render::TextureBuffer> tex = polyscope::render::engine->getColorMapTexture("test_ramp");
+  EXPECT_EQ(tex.use_count(), 4); // the colormap, each program, and us
+
+  // Editing the colormap updates the texture in place
+  polyscope::render::engine->resetRenderStats();
+  std::vector<glm::vec3> reversed{{1., 1., 1.}, {0.5, 0.5, 0.5}, {0., 0., 0.}};
+  polyscope::updateColorMap("test_ramp", reversed);
+  EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, 3 * 3 * sizeof(float));
+  EXPECT_EQ(polyscope::render::engine->getColorMapTexture("test_ramp"), tex);
+  EXPECT_EQ(tex->getSizeX(), 3u);
+  EXPECT_EQ(polyscope::render::engine->getColorMap("test_ramp").values.size(), 3u);
+  polyscope::show(1);
+  polyscope::removeAllStructures();
+}
 
-  // clang-format off
-  points = {
-    {1, 0, 0},
-    {0, 1, 0},
-    {0, 0, 1},
-    {0, 0, 0},
-  };
+TEST_F(PolyscopeTest, PointCloudRegisterMovedPoints) {
+  std::vector<glm::vec3> points = getPoints();
+  size_t nPoints = points.size();
+  const glm::vec3* pointData = points.data();
+  polyscope::PointCloud* psPoints = polyscope::registerPointCloud("moved points", std::move(points));
+  EXPECT_EQ(psPoints->nPoints(), nPoints);
+  EXPECT_EQ(psPoints->points.data(), pointData); // took the buffer, rather than copying it
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
 
-  faces = {
-    {1, 3, 2},
-    {3, 1, 0},
-    {2, 0, 1},
-    {0, 2, 3}
-   };
-  // clang-format on
+TEST_F(PolyscopeTest, PointCloudScalarSinglePrecision) {
+  polyscope::options::scalarPrecision = polyscope::ScalarPrecision::Float;
+  auto psPoints = registerPointCloud();
+  std::vector<double> vScalar{0.1, -2., 1e-3, 7.};
+  auto q1 = psPoints->addScalarQuantity("vScalar", vScalar);
+  polyscope::options::scalarPrecision = polyscope::ScalarPrecision::Double;
 
-  return std::tuple<std::vector<glm::vec3>, std::vector<std::vector<size_t>>>{points, faces};
-};
+  EXPECT_EQ(q1->values.getPrecision(), polyscope::ScalarPrecision::Float);
+  ASSERT_EQ(q1->values.size(), vScalar.size());
+  for (size_t i = 0; i < vScalar.size(); i++) {
+    EXPECT_EQ(q1->values[i], static_cast<float>(vScalar[i]));
+  }
+  EXPECT_EQ(q1->getMapRange(), std::make_pair(-2., static_cast<double>(7.f)));
 
-polyscope::SurfaceMesh* registerTriangleMesh(std::string name = "test1") {
-  std::vector<glm::vec3> points;
-  std::vector<std::vector<size_t>> faces;
-  std::tie(points, faces) = getTriangleMesh();
-  return polyscope::registerSurfaceMesh(name, points, faces);
+  // uploaded as-is, same size as the double precision path
+  q1->setEnabled(true);
+  polyscope::render::engine->resetRenderStats();
+  polyscope::show(3);
+  EXPECT_GE(polyscope::render::engine->renderStats.uploadBytes, vScalar.size() * sizeof(float));
+  psPoints->setPointRadiusQuantity(q1);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
 }
 
+TEST_F(PolyscopeTest, PointCloudScalarQuantized) {
+  auto psPoints = registerPointCloud();
+  std::vector<double> vScalar(psPoints->nPoints());
+  for (size_t i = 0; i < vScalar.size(); i++) vScalar[i] = std::sin(0.1 * i);
+  vScalar[0] = std::numeric_limits<double>::quiet_NaN();
+  auto q1 = psPoints->addScalarQuantity("vScalar", vScalar);
 
-TEST_F(PolyscopeTest, ShowSurfaceMesh) {
-  auto psMesh = registerTriangleMesh();
+  // Quantized values are within the error bound, and non-finite ones stay non-finite
+  for (polyscope::ScalarPrecision precision :
+       {polyscope::ScalarPrecision::Quantized16, polyscope::ScalarPrecision::Quantized8}) {
+    q1->setStoragePrecision(precision);
+    EXPECT_EQ(q1->getStoragePrecision(), precision);
+    double err = q1->values.quantizationError();
+    EXPECT_GT(err, 0.);
+    EXPECT_LT(err, 0.01);
+    EXPECT_TRUE(std::isnan(q1->values[0]));
+    for (size_t i = 1; i < vScalar.size(); i++) {
+      EXPECT_NEAR(q1->values[i], vScalar[i], err * 1.0001);
+    }
+    EXPECT_LE(q1->values.allocatedBytes(), vScalar.size() * 2);
+    q1->setEnabled(true);
+    polyscope::show(3);
+  }
 
-  // Make sure we actually added the mesh
+  q1->setStoragePrecision(polyscope::ScalarPrecision::Double);
+  EXPECT_EQ(q1->values.quantizationError(), 0.);
   polyscope::show(3);
-  EXPECT_TRUE(polyscope::hasSurfaceMesh("test1"));
-  EXPECT_FALSE(polyscope::hasSurfaceMesh("test2"));
   polyscope::removeAllStructures();
-  EXPECT_FALSE(polyscope::hasSurfaceMesh("test1"));
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshAppearance) {
-  auto psMesh = registerTriangleMesh();
-
-  // Both shading types
-  psMesh->setSmoothShade(true);
-  EXPECT_TRUE(psMesh->isSmoothShade());
+TEST_F(PolyscopeTest, PointCloudRadiusQuantityOnGPU) {
+  const size_t N = 10000;
+  auto psPoints = polyscope::registerPointCloud("radius points", std::vector<glm::vec3>(N, glm::vec3{0., 0., 0.}));
+  std::vector<double> vRadius1(N, 2.);
+  std::vector<double> vRadius2(N, -1.);
+  vRadius2[0] = 4.;
+  auto q1 = psPoints->addScalarQuantity("vRadius1", vRadius1);
+  auto q2 = psPoints->addScalarQuantity("vRadius2", vRadius2);
+  q1->setEnabled(true);
+  psPoints->setPointRadiusQuantity(q1);
   polyscope::show(3);
 
-  psMesh->setSmoothShade(false);
-  EXPECT_FALSE(psMesh->isSmoothShade());
+  // the radii are read from the buffer of the quantity, which is uploaded once
+  polyscope::render::engine->resetRenderStats();
+  psPoints->setPointRadiusQuantity(q2);
   polyscope::show(3);
+  EXPECT_LT(polyscope::render::engine->renderStats.uploadBytes, 2 * N * sizeof(float));
+  EXPECT_EQ(q2->getMaxPositiveValue(), 4.);
 
-  // Wireframe
-  psMesh->setEdgeWidth(1.);
-  EXPECT_EQ(psMesh->getEdgeWidth(), 1.);
+  polyscope::render::engine->resetRenderStats();
+  psPoints->setPointRadiusQuantity(q1, false);
   polyscope::show(3);
+  EXPECT_LT(polyscope::render::engine->renderStats.uploadBytes, N * sizeof(float));
 
-  // Material
-  psMesh->setMaterial("wax");
-  EXPECT_EQ(psMesh->getMaterial(), "wax");
+  // updated values are picked up by the radius
+  vRadius1[3] = 5.;
+  q1->updateData(vRadius1);
+  EXPECT_EQ(q1->getMaxPositiveValue(), 5.);
   polyscope::show(3);
+  polyscope::pick::evaluatePickQuery(-1, -1);
 
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshPick) {
-  auto psMesh = registerTriangleMesh();
-
-  // Don't bother trying to actually click on anything, but make sure this doesn't crash
-  polyscope::pick::evaluatePickQuery(77, 88);
-
-  // Do it again with edges enabled
-  psMesh->setEdgeWidth(1.0);
-  polyscope::pick::evaluatePickQuery(77, 88);
-
+TEST_F(PolyscopeTest, PointCloudScalarClippedRange) {
+  // A smooth field with a few wild outliers, plus values which should be ignored
+  auto psPoints = polyscope::registerPointCloud("field", std::vector<glm::vec3>(1000, glm::vec3{0., 0., 0.}));
+  std::vector<double> vScalar(psPoints->nPoints());
+  for (size_t i = 0; i < vScalar.size(); i++) vScalar[i] = static_cast<double>(i) / vScalar.size();
+  vScalar[0] = -1e6;
+  vScalar[1] = 1e9;
+  vScalar[2] = std::numeric_limits<double>::quiet_NaN();
+  vScalar[3] = std::numeric_limits<double>::infinity();
+  EXPECT_EQ(polyscope::robustMinMax(vScalar), std::make_pair(-1e6, 1e9));
+
+  polyscope::options::scalarRangeClipPercentile = 1.;
+  auto q1 = psPoints->addScalarQuantity("vScalar", vScalar);
+  polyscope::options::scalarRangeClipPercentile = 0.;
+  std::pair<double, double> range = q1->getMapRange();
+  EXPECT_NEAR(range.first, 0.01, 0.02);
+  EXPECT_NEAR(range.second, 0.99, 0.02);
+  polyscope::show(3);
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshBackface) {
-  auto psMesh = registerTriangleMesh();
+TEST_F(PolyscopeTest, PointCloudScalarBatch) {
+  auto psPoints = registerPointCloud();
+  std::vector<polyscope::PointCloudScalarQuantity*> quantities;
+  {
+    polyscope::BatchUpdate batch;
+    for (int iQ = 0; iQ < 20; iQ++) {
+      std::vector<double> vScalar(psPoints->nPoints(), static_cast<double>(iQ));
+      vScalar[0] = iQ + 1.;
+      quantities.push_back(psPoints->addScalarQuantity("vScalar" + std::to_string(iQ), vScalar));
+    }
+    EXPECT_TRUE(polyscope::isInBatch());
 
-  // Same appearance
-  psMesh->setBackFacePolicy(polyscope::BackFacePolicy::Identical);
-  EXPECT_EQ(psMesh->getBackFacePolicy(), polyscope::BackFacePolicy::Identical);
-  polyscope::show(3);
+    // asking for one result inside the batch runs that quantity's preprocessing
+    EXPECT_EQ(quantities[3]->getMapRange(), std::make_pair(3., 4.));
+  }
+  EXPECT_FALSE(polyscope::isInBatch());
+  for (size_t iQ = 0; iQ < quantities.size(); iQ++) {
+    EXPECT_EQ(quantities[iQ]->getMapRange(), std::make_pair(static_cast<double>(iQ), iQ + 1.));
+  }
 
-  // Different appearance
-  psMesh->setBackFacePolicy(polyscope::BackFacePolicy::Different);
-  EXPECT_EQ(psMesh->getBackFacePolicy(), polyscope::BackFacePolicy::Different);
-  psMesh->setBackFaceColor(glm::vec3(1.f, 0.f, 0.f));
-  EXPECT_EQ(psMesh->getBackFaceColor(), glm::vec3(1.f, 0.f, 0.f));
-  polyscope::show(3);
+  // quantities removed before the batch ends are dropped from it
+  polyscope::beginBatch();
+  psPoints->addScalarQuantity("vScalar0", std::vector<double>(psPoints->nPoints(), 1.));
+  psPoints->removeQuantity("vScalar0");
+  polyscope::endBatch();
 
-  // Cull backfacing
-  psMesh->setBackFacePolicy(polyscope::BackFacePolicy::Cull);
-  EXPECT_EQ(psMesh->getBackFacePolicy(), polyscope::BackFacePolicy::Cull);
   polyscope::show(3);
-
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshColorVertex) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> vColors(psMesh->nVertices(), glm::vec3{.2, .3, .4});
-  auto q1 = psMesh->addVertexColorQuantity("vcolor", vColors);
+TEST_F(PolyscopeTest, PointCloudVector) {
+  auto psPoints = registerPointCloud();
+  std::vector<glm::vec3> vals(psPoints->nPoints(), {1., 2., 3.});
+  auto q1 = psPoints->addVectorQuantity("vals", vals);
   q1->setEnabled(true);
   polyscope::show(3);
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshColorFace) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> fColors(psMesh->nFaces(), glm::vec3{.2, .3, .4});
-  auto q2 = psMesh->addFaceColorQuantity("fColor", fColors);
-  q2->setEnabled(true);
-  polyscope::show(3);
+TEST_F(PolyscopeTest, PointCloudVectorDecimation) {
+  // A dense sheet of points, with one vector each
+  std::vector<glm::vec3> points;
+  for (size_t i = 0; i < 300; i++) {
+    for (size_t j = 0; j < 300; j++) {
+      points.emplace_back(i / 300., j / 300., 0.);
+    }
+  }
+  polyscope::PointCloud* psPoints = polyscope::registerPointCloud("sheet", points);
+  std::vector<glm::vec3> vals(points.size(), {0., 0., 1.});
+  auto q1 = psPoints->addVectorQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(1);
+  EXPECT_EQ(q1->getNumVectorsDrawn(), points.size());
+
+  // Decimated, far fewer are drawn, and more with a finer spacing
+  q1->setDecimationEnabled(true);
+  polyscope::show(1);
+  size_t nCoarse = q1->getNumVectorsDrawn();
+  EXPECT_GT(nCoarse, 0u);
+  EXPECT_LT(nCoarse, points.size() / 4);
+  q1->setDecimationSpacing(q1->getDecimationSpacing() / 4.);
+  polyscope::show(1);
+  EXPECT_GT(q1->getNumVectorsDrawn(), nCoarse);
+
+  q1->setDecimationSpacing(8.);
+  q1->setDecimationEnabled(false);
+  polyscope::show(1);
+  EXPECT_EQ(q1->getNumVectorsDrawn(), points.size());
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshScalarVertex) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<double> vScalar(psMesh->nVertices(), 7.);
-  auto q1 = psMesh->addVertexScalarQuantity("vScalar", vScalar);
+TEST_F(PolyscopeTest, PointCloudParam) {
+  auto psPoints = registerPointCloud();
+  std::vector<glm::vec2> param(psPoints->nPoints(), glm::vec2{.2, .3});
+
+  auto q1 = psPoints->addParameterizationQuantity("param", param);
   q1->setEnabled(true);
   polyscope::show(3);
-  polyscope::removeAllStructures();
-}
+  
+  psPoints->setPointRenderMode(polyscope::PointRenderMode::Quad);
+  polyscope::show(3);
 
-TEST_F(PolyscopeTest, SurfaceMeshScalarFace) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<double> fScalar(psMesh->nFaces(), 8.);
-  auto q2 = psMesh->addFaceScalarQuantity("fScalar", fScalar);
+  auto q2 = psPoints->addLocalParameterizationQuantity("local param", param);
+  psPoints->setPointRenderMode(polyscope::PointRenderMode::Sphere);
   q2->setEnabled(true);
   polyscope::show(3);
-  polyscope::removeAllStructures();
-}
-
-TEST_F(PolyscopeTest, SurfaceMeshScalarEdge) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<double> eScalar(psMesh->nEdges(), 9.);
-  auto q3 = psMesh->addEdgeScalarQuantity("eScalar", eScalar);
-  q3->setEnabled(true);
+  
+  psPoints->setPointRenderMode(polyscope::PointRenderMode::Quad);
   polyscope::show(3);
-  polyscope::removeAllStructures();
-}
 
-TEST_F(PolyscopeTest, SurfaceMeshScalarHalfedge) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<double> heScalar(psMesh->nHalfedges(), 10.);
-  auto q4 = psMesh->addHalfedgeScalarQuantity("heScalar", heScalar);
-  q4->setEnabled(true);
-  polyscope::show(3);
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshDistance) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<double> vScalar(psMesh->nVertices(), 7.);
-  auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
+TEST_F(PolyscopeTest, PointCloudScalarRadius) {
+  auto psPoints = registerPointCloud();
+  std::vector<double> vScalar(psPoints->nPoints(), 7.);
+  std::vector<double> vScalar2(psPoints->nPoints(), 7.);
+  auto q1 = psPoints->addScalarQuantity("vScalar", vScalar);
+  auto q2 = psPoints->addScalarQuantity("vScalar2", vScalar2);
   q1->setEnabled(true);
-  polyscope::show(3);
-  polyscope::removeAllStructures();
-}
 
-TEST_F(PolyscopeTest, SurfaceMeshSignedDistance) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<double> vScalar(psMesh->nVertices(), 7.);
-  auto q1 = psMesh->addVertexSignedDistanceQuantity("distance", vScalar);
-  q1->setEnabled(true);
+  psPoints->setPointRadiusQuantity(q1);
   polyscope::show(3);
-  polyscope::removeAllStructures();
-}
-
-TEST_F(PolyscopeTest, SurfaceMeshCornerParam) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec2> vals(psMesh->nCorners(), {1., 2.});
-  auto q1 = psMesh->addParameterizationQuantity("param", vals);
-  q1->setEnabled(true);
+  
+  psPoints->setPointRenderMode(polyscope::PointRenderMode::Quad);
   polyscope::show(3);
 
-  // try the various render options
-  q1->setStyle(polyscope::ParamVizStyle::CHECKER);
-  polyscope::show(3);
-  q1->setStyle(polyscope::ParamVizStyle::GRID);
+  psPoints->setPointRadiusQuantity("vScalar2");
   polyscope::show(3);
-  q1->setStyle(polyscope::ParamVizStyle::LOCAL_CHECK);
+
+  psPoints->setPointRadiusQuantity("vScalar2", false); // no autoscaling
   polyscope::show(3);
-  q1->setStyle(polyscope::ParamVizStyle::LOCAL_RAD);
+
+  psPoints->clearPointRadiusQuantity();
   polyscope::show(3);
 
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshVertexParam) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec2> vals(psMesh->nVertices(), {1., 2.});
-  auto q1 = psMesh->addVertexParameterizationQuantity("param", vals);
-  q1->setEnabled(true);
+TEST_F(PolyscopeTest, PointCloudPartialUpdate) {
+  auto psPoints = registerPointCloud();
   polyscope::show(3);
 
-  // try the various render options
-  q1->setStyle(polyscope::ParamVizStyle::CHECKER);
-  polyscope::show(3);
-  q1->setStyle(polyscope::ParamVizStyle::GRID);
-  polyscope::show(3);
-  q1->setStyle(polyscope::ParamVizStyle::LOCAL_CHECK);
-  polyscope::show(3);
-  q1->setStyle(polyscope::ParamVizStyle::LOCAL_RAD);
+  // Neighboring points are uploaded together: 3 positions for the point cloud's program
+  polyscope::render::engine->resetRenderStats();
+  psPoints->updatePointPositions(std::vector<size_t>{0, 2}, std::vector<glm::vec3>{{0., 0., 1.}, {0., 1., 0.}});
+  psPoints->updatePointPositions(std::vector<size_t>{1}, std::vector<glm::vec3>{{1., 0., 0.}});
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, 3 * 3 * sizeof(float));
+  EXPECT_EQ(psPoints->points[1], glm::vec3(1., 0., 0.));
+
+  // Quantities drawing the points, and vectors based at them, bind the same position buffer, so it is uploaded once
+  psPoints->addScalarQuantity("vals", std::vector<double>(psPoints->nPoints(), 1.))->setEnabled(true);
+  psPoints->addVectorQuantity("vecs", std::vector<glm::vec3>(psPoints->nPoints(), glm::vec3{1., 0., 0.}))
+      ->setEnabled(true);
   polyscope::show(3);
+  polyscope::render::engine->resetRenderStats();
+  psPoints->updatePointPositions(std::vector<size_t>{3}, std::vector<glm::vec3>{{1., 1., 1.}});
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, 3 * sizeof(float));
 
+  polyscope::pick::evaluatePickQuery(77, 88);
   polyscope::removeAllStructures();
 }
 
+TEST_F(PolyscopeTest, PointCloudTimeFrames) {
+  auto psPoints = registerPointCloud();
+  std::vector<double> vals(psPoints->nPoints(), 1.);
+  vals[0] = 0.;
+  auto qScalar = psPoints->addScalarQuantity("vals", vals);
+  for (int iF = 1; iF < 5; iF++) {
+    std::vector<glm::vec3> positions = psPoints->points;
+    for (glm::vec3& p : positions) p.x += iF;
+    psPoints->addPositionFrame(positions);
+    vals[1] = 1. + iF;
+    qScalar->addValueFrame(vals);
+  }
+  EXPECT_EQ(psPoints->nTimeFrames(), 5);
+  EXPECT_EQ(qScalar->resetMapRange()->getMapRange(), std::make_pair(0., 5.));
+
+  // Playback only rebinds frames already on the GPU
+  for (bool interpolate : {false, true}) {
+    psPoints->setTimeInterpolation(interpolate);
+    for (bool scalarEnabled : {false, true}) {
+      qScalar->setEnabled(scalarEnabled);
+      psPoints->setTime(2.5);
+      polyscope::show(3);
+      polyscope::render::engine->resetRenderStats();
+      psPoints->setTime(3.);
+      polyscope::show(1);
+      EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, 0);
+      polyscope::pick::evaluatePickQuery(77, 88);
+    }
+  }
 
-TEST_F(PolyscopeTest, SurfaceMeshVertexLocalParam) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec2> vals(psMesh->nVertices(), {1., 2.});
-  auto q1 = psMesh->addLocalParameterizationQuantity("param", vals);
-  q1->setEnabled(true);
+  // Old frames are dropped beyond the limit, times are clamped to the ones held
+  polyscope::options::timeSeriesMaxFrames = 2;
+  auto psPoints2 = registerPointCloud("points2");
+  for (int iF = 0; iF < 4; iF++) psPoints2->addPositionFrame(psPoints2->points);
+  EXPECT_EQ(psPoints2->nTimeFrames(), 5);
+  psPoints2->setTime(0.);
   polyscope::show(3);
+  polyscope::options::timeSeriesMaxFrames = 256;
+
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshVertexVector) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> vals(psMesh->nVertices(), {1., 2., 3.});
-  auto q1 = psMesh->addVertexVectorQuantity("param", vals);
-  q1->setEnabled(true);
-  polyscope::show(3);
+TEST_F(PolyscopeTest, PointCloudStreamedTimeFrames) {
+  auto psPoints = registerPointCloud();
+  size_t nPoints = psPoints->nPoints();
+  std::vector<glm::vec3> basePoints = psPoints->points;
+  psPoints->setPositionFrameLoader(100, [basePoints](size_t iFrame, std::vector<float>& data) {
+    data.resize(3 * basePoints.size());
+    for (size_t i = 0; i < basePoints.size(); i++) {
+      data[3 * i + 0] = basePoints[i].x + iFrame;
+      data[3 * i + 1] = basePoints[i].y;
+      data[3 * i + 2] = basePoints[i].z;
+    }
+  });
+  EXPECT_EQ(psPoints->nTimeFrames(), 100);
+
+  // Values from a file per frame
+  std::vector<std::string> filenames;
+  for (int iF = 0; iF < 3; iF++) {
+    filenames.push_back("value_frame_" + std::to_string(iF) + ".raw");
+    std::vector<float> vals(nPoints, static_cast<float>(iF));
+    std::ofstream(filenames.back(), std::ios::binary)
+        .write(reinterpret_cast<const char*>(vals.data()), vals.size() * sizeof(float));
+  }
+  auto qScalar = psPoints->addScalarQuantity("vals", std::vector<double>(nPoints, 0.));
+  qScalar->setValueFrameLoader(filenames.size(), polyscope::rawFileFrameLoader(filenames));
+  qScalar->setEnabled(true);
+
+  for (bool interpolate : {false, true}) {
+    psPoints->setTimeInterpolation(interpolate);
+    for (double t : {0., 1., 50.5, 49., 99.}) {
+      psPoints->setTime(t);
+      polyscope::show(1);
+    }
+  }
+
+  // Stepping back on to frames still held uploads nothing
+  psPoints->setTime(0.);
+  polyscope::show(1);
+  psPoints->setTime(1.);
+  polyscope::show(1);
+  polyscope::render::engine->resetRenderStats();
+  psPoints->setTime(0.);
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, 0);
+
   polyscope::removeAllStructures();
+  for (const std::string& f : filenames) std::remove(f.c_str());
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshFaceVector) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> vals(psMesh->nFaces(), {1., 2., 3.});
-  auto q1 = psMesh->addFaceVectorQuantity("param", vals);
-  q1->setEnabled(true);
+TEST_F(PolyscopeTest, BackgroundCallback) {
+  auto psPoints = registerPointCloud();
+  size_t nPoints = psPoints->nPoints();
+  std::atomic<int> nSteps{0};
+  polyscope::state::backgroundCallback = [&]() {
+    // A slow step, which publishes its result for the main thread to apply
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    std::vector<glm::vec3> positions(nPoints, glm::vec3{static_cast<float>(nSteps.load()), 0., 0.});
+    nSteps++;
+    polyscope::queueUpdate(
+        std::move(positions),
+        [](std::vector<glm::vec3>& p) { polyscope::getPointCloud("test1")->updatePointPositions(p); }, "step");
+  };
   polyscope::show(3);
+  EXPECT_GE(nSteps.load(), 1); // (show() waited for the last run)
+
+  polyscope::state::backgroundCallback = nullptr;
+  polyscope::show(1); // applies the last step
+  EXPECT_EQ(psPoints->points[0].x, static_cast<float>(nSteps.load() - 1));
+
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshVertexIntrinsic) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> basisX(psMesh->nVertices(), {1., 2., 3.});
-  psMesh->setVertexTangentBasisX(basisX);
-  std::vector<glm::vec2> vals(psMesh->nVertices(), {1., 2.});
-  auto q1 = psMesh->addVertexIntrinsicVectorQuantity("param", vals);
-  q1->setEnabled(true);
-  polyscope::show(3);
+TEST_F(PolyscopeTest, PointCloudInstanced) {
+  // Force the instanced billboard programs, which are normally only used for large clouds
+  polyscope::options::instancedDrawingThreshold = 0;
+  auto psPoints = registerPointCloud();
+  std::vector<double> vScalar(psPoints->nPoints(), 7.);
+  std::vector<glm::vec3> vColors(psPoints->nPoints(), glm::vec3{.2, .3, .4});
+  std::vector<glm::vec2> param(psPoints->nPoints(), glm::vec2{.2, .3});
+  std::vector<glm::vec3> vals(psPoints->nPoints(), {1., 2., 3.});
+  auto qScalar = psPoints->addScalarQuantity("vScalar", vScalar);
+  auto qColor = psPoints->addColorQuantity("vcolor", vColors);
+  auto qParam = psPoints->addParameterizationQuantity("param", param);
+  psPoints->addVectorQuantity("vals", vals)->setEnabled(true);
+  psPoints->setPointRadiusQuantity(qScalar);
+  polyscope::addSceneSlicePlane();
+
+  for (polyscope::PointRenderMode mode : {polyscope::PointRenderMode::Sphere, polyscope::PointRenderMode::Quad}) {
+    psPoints->setPointRenderMode(mode);
+    polyscope::show(3);
+    qScalar->setEnabled(true);
+    polyscope::show(3);
+    qColor->setEnabled(true);
+    polyscope::show(3);
+    qParam->setEnabled(true);
+    polyscope::show(3);
+    polyscope::pick::evaluatePickQuery(77, 88);
+  }
+
+  polyscope::removeLastSceneSlicePlane();
   polyscope::removeAllStructures();
+  polyscope::options::instancedDrawingThreshold = 100000;
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshFaceIntrinsic) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> basisX(psMesh->nFaces(), {1., 2., 3.});
-  psMesh->setFaceTangentBasisX(basisX);
-  std::vector<glm::vec2> vals(psMesh->nFaces(), {1., 2.});
-  auto q1 = psMesh->addFaceIntrinsicVectorQuantity("param", vals);
-  q1->setEnabled(true);
-  polyscope::show(3);
-  polyscope::removeAllStructures();
+// ============================================================
+// =============== Surface mesh tests
+// ============================================================
+
+std::tuple<std::vector<glm::vec3>, std::vector<std::vector<size_t>>> getTriangleMesh() {
+  std::vector<glm::vec3> points;
+  std::vector<std::vector<size_t>> faces;
+
+  // clang-format off
+  points = {
+    {1, 0, 0},
+    {0, 1, 0},
+    {0, 0, 1},
+    {0, 0, 0},
+  };
+
+  faces = {
+    {1, 3, 2},
+    {3, 1, 0},
+    {2, 0, 1},
+    {0, 2, 3}
+   };
+  // clang-format on
+
+  return std::tuple<std::vector<glm::vec3>, std::vector<std::vector<size_t>>>{points, faces};
+};
+
+polyscope::SurfaceMesh* registerTriangleMesh(std::string name = "test1") {
+  std::vector<glm::vec3> points;
+  std::vector<std::vector<size_t>> faces;
+  std::tie(points, faces) = getTriangleMesh();
+  return polyscope::registerSurfaceMesh(name, points, faces);
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshOneForm) {
+
+TEST_F(PolyscopeTest, ShowSurfaceMesh) {
   auto psMesh = registerTriangleMesh();
-  // std::vector<glm::vec3> basisX(psMesh->nVertices(), {1., 2., 3.});
-  // psMesh->setVertexTangentBasisX(basisX);
-  std::vector<double> vals(psMesh->nEdges(), 3.);
-  std::vector<char> orients(psMesh->nEdges(), true);
-  auto q1 = psMesh->addOneFormIntrinsicVectorQuantity("one form vecs", vals, orients);
-  q1->setEnabled(true);
+
+  // Make sure we actually added the mesh
   polyscope::show(3);
+  EXPECT_TRUE(polyscope::hasSurfaceMesh("test1"));
+  EXPECT_FALSE(polyscope::hasSurfaceMesh("test2"));
   polyscope::removeAllStructures();
+  EXPECT_FALSE(polyscope::hasSurfaceMesh("test1"));
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshVertexIntrinsicRibbon) {
+TEST_F(PolyscopeTest, SurfaceMeshAppearance) {
   auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> basisX(psMesh->nVertices(), {1., 2., 3.});
-  psMesh->setVertexTangentBasisX(basisX);
-  std::vector<glm::vec3> basisXF(psMesh->nFaces(), {1., 2., 3.});
-  psMesh->setFaceTangentBasisX(basisXF);
-  std::vector<glm::vec2> vals(psMesh->nVertices(), {1., 2.});
-  auto q1 = psMesh->addVertexIntrinsicVectorQuantity("param", vals);
-  q1->setEnabled(true);
-  q1->setRibbonEnabled(true);
+
+  // Both shading types
+  psMesh->setSmoothShade(true);
+  EXPECT_TRUE(psMesh->isSmoothShade());
   polyscope::show(3);
-  polyscope::removeAllStructures();
-}
 
-TEST_F(PolyscopeTest, SurfaceMeshFaceIntrinsicRibbon) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> basisX(psMesh->nFaces(), {1., 2., 3.});
-  psMesh->setFaceTangentBasisX(basisX);
+  psMesh->setSmoothShade(false);
+  EXPECT_FALSE(psMesh->isSmoothShade());
+  polyscope::show(3);
+
+  // Wireframe
+  psMesh->setEdgeWidth(1.);
+  EXPECT_EQ(psMesh->getEdgeWidth(), 1.);
+  polyscope::show(3);
+
+  // Material
+  psMesh->setMaterial("wax");
+  EXPECT_EQ(psMesh->getMaterial(), "wax");
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshIndexedDraw) {
+  // Smooth shading without a wireframe draws shared vertices through an index buffer, including for polygons
+  std::vector<glm::vec3> points = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0.5, 0.5, 1}};
+  std::vector<std::vector<size_t>> faces = {{0, 1, 2, 3}, {0, 1, 4}, {1, 2, 4}, {2, 3, 4}, {3, 0, 4}};
+  auto psMesh = polyscope::registerSurfaceMesh("polygons", points, faces);
+  psMesh->setSmoothShade(true);
+  polyscope::show(3);
+
+  // Geometry updates refill the indexed buffers
+  points[4].z = 2.;
+  psMesh->updateVertexPositions(points);
+  polyscope::show(3);
+
+  // Falls back to per-corner data when a wireframe is needed
+  psMesh->setEdgeWidth(1.);
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshSortedTransparency) {
+  // Translucent indexed meshes re-sort their triangles as the view moves, and when the vertices do
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::Simple;
+  polyscope::options::transparencySortTriangles = true;
+  std::vector<glm::vec3> points = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0.5, 0.5, 1}};
+  std::vector<std::vector<size_t>> faces = {{0, 1, 2, 3}, {0, 1, 4}, {1, 2, 4}, {2, 3, 4}, {3, 0, 4}};
+  auto psMesh = polyscope::registerSurfaceMesh("sorted polygons", points, faces);
+  psMesh->setSmoothShade(true);
+  psMesh->setTransparency(0.5);
+
+  // The depths of the triangles of the last indexed draw of all 6 of them, in the order drawn, as seen from camera
+  // looking down at the mesh or up at it (the mock backend keeps the index buffers it draws)
+  auto* mockEngine = dynamic_cast<polyscope::render::backend_openGL_mock::MockGLEngine*>(polyscope::render::engine);
+  ASSERT_NE(mockEngine, nullptr);
+  auto drawnDepths = [&](glm::vec3 camera) {
+    glm::vec3 target{0.5, 0.5, 0.};
+    polyscope::view::lookAt(camera, target);
+    mockEngine->indexedDraws.clear();
+    mockEngine->recordIndexedDraws = true;
+    polyscope::show(1);
+    mockEngine->recordIndexedDraws = false;
+    std::vector<float> depths;
+    for (const std::vector<unsigned int>& inds : mockEngine->indexedDraws) {
+      if (inds.size() != 18) continue;
+      depths.clear();
+      for (size_t i = 0; i < inds.size(); i += 3) {
+        glm::vec3 center = (points[inds[i]] + points[inds[i + 1]] + points[inds[i + 2]]) / 3.f;
+        depths.push_back(glm::dot(center - camera, glm::normalize(target - camera)));
+      }
+    }
+    return depths;
+  };
+  auto expectFarthestFirst = [&](const std::vector<float>& depths) {
+    ASSERT_EQ(depths.size(), 6);
+    for (size_t i = 1; i < depths.size(); i++) {
+      EXPECT_GE(depths[i - 1], depths[i] - 1e-5); // (sides at the same depth may come in either order)
+    }
+  };
+
+  // From below the base is nearest, from above it is farthest
+  std::vector<float> depths = drawnDepths(glm::vec3{0.5, 0.5, -3.});
+  expectFarthestFirst(depths);
+  EXPECT_LT(depths.back(), depths.front());
+  expectFarthestFirst(drawnDepths(glm::vec3{0.5, 0.5, 3.}));
+
+  points[4].z = -2.;
+  psMesh->updateVertexPositions(points);
+  expectFarthestFirst(drawnDepths(glm::vec3{0.5, 0.5, 3.}));
+
+  // Indexed parameterizations draw in the same order, split along seams or not. Coordinates which agree at every
+  // corner of a vertex split nothing, so the drawn vertices keep the numbers of the mesh's.
+  std::vector<glm::vec2> vertexCoords;
+  for (const glm::vec3& p : points) vertexCoords.push_back({p.x, p.y});
+  std::vector<glm::vec2> cornerCoords;
+  for (const std::vector<size_t>& f : faces) {
+    for (size_t iV : f) cornerCoords.push_back(vertexCoords[iV]);
+  }
+  psMesh->addVertexParameterizationQuantity("vertex param", vertexCoords)->setEnabled(true);
+  expectFarthestFirst(drawnDepths(glm::vec3{0.5, 0.5, -3.}));
+  psMesh->addParameterizationQuantity("corner param", cornerCoords)->setEnabled(true);
+  expectFarthestFirst(drawnDepths(glm::vec3{0.5, 0.5, 3.}));
+
+  polyscope::options::transparencySortTriangles = false;
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None;
+  polyscope::view::resetCameraToHomeView();
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshRenderCost) {
+  // A grid of triangles, big enough that per-element costs dominate
+  const size_t n = 64;
+  std::vector<glm::vec3> points;
+  std::vector<std::vector<size_t>> faces;
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= n; j++) {
+      points.push_back(glm::vec3{i, j, 0.});
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      size_t v = i * (n + 1) + j;
+      faces.push_back({v, v + n + 1, v + 1});
+      faces.push_back({v + 1, v + n + 1, v + n + 2});
+    }
+  }
+  size_t nFaces = faces.size();
+  auto psMesh = polyscope::registerSurfaceMesh("grid", points, faces);
+  polyscope::show(3);
+
+  // Refreshing rebuilds and refills the programs
+  polyscope::render::engine->resetRenderStats();
+  psMesh->refresh();
+  polyscope::show(1);
+  polyscope::render::RenderStats stats = polyscope::render::engine->renderStats;
+  EXPECT_GT(stats.drawCalls, 0);
+  EXPECT_LE(stats.uploadBytes, 600 * nFaces);
+  EXPECT_LE(stats.shaderCompilations, 2);
+
+  // Frames of an unchanged scene do not upload or compile anything
+  polyscope::show(3);
+  stats = polyscope::render::engine->lastFrameRenderStats;
+  EXPECT_EQ(stats.uploadBytes, 0);
+  EXPECT_EQ(stats.shaderCompilations, 0);
+
+  // Adding the first slice plane rebuilds programs with the culling rule
+  polyscope::render::engine->resetRenderStats();
+  polyscope::addSceneSlicePlane();
+  polyscope::show(1);
+  stats = polyscope::render::engine->renderStats;
+  EXPECT_LE(stats.shaderCompilations, 4);
+  polyscope::removeLastSceneSlicePlane();
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshDrawBatches) {
+  // Structures of a type are drawn grouped by material
+  auto psMesh1 = registerTriangleMesh("mesh_a");
+  auto psMesh2 = registerTriangleMesh("mesh_b");
+  auto psMesh3 = registerTriangleMesh("mesh_c");
+  psMesh1->setMaterial("flat");
+  psMesh2->setMaterial("clay");
+  psMesh3->setMaterial("flat");
+  EXPECT_EQ(psMesh1->drawBatchKey(), psMesh3->drawBatchKey());
+  EXPECT_NE(psMesh1->drawBatchKey(), psMesh2->drawBatchKey());
+
+  polyscope::show(3);
+  polyscope::render::engine->resetRenderStats();
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  EXPECT_GE(polyscope::render::engine->renderStats.drawCalls, 3);
+
+  // Meshes which cull back faces are batched apart from those which do not
+  psMesh3->setBackFacePolicy(polyscope::BackFacePolicy::Cull);
+  EXPECT_NE(psMesh1->drawBatchKey(), psMesh3->drawBatchKey());
+
+  // Consecutive draws of meshes with the same state skip setting it again
+  polyscope::show(3);
+  polyscope::render::engine->resetRenderStats();
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  EXPECT_GT(polyscope::render::engine->renderStats.redundantChangesSkipped, 0);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, RedundantStateChangesSkipped) {
+  polyscope::render::engine->setBlendMode(polyscope::BlendMode::Under);
+  polyscope::render::engine->resetRenderStats();
+
+  polyscope::render::engine->setBlendMode(polyscope::BlendMode::Under);
+  EXPECT_EQ(polyscope::render::engine->renderStats.stateChanges, 0);
+  EXPECT_EQ(polyscope::render::engine->renderStats.redundantChangesSkipped, 1);
+
+  polyscope::render::engine->setBlendMode(polyscope::BlendMode::Over);
+  polyscope::render::engine->setColorMask({true, false, true, true});
+  polyscope::render::engine->setColorMask({true, false, true, true});
+  EXPECT_EQ(polyscope::render::engine->renderStats.stateChanges, 2);
+  EXPECT_EQ(polyscope::render::engine->renderStats.redundantChangesSkipped, 2);
+
+  polyscope::render::engine->setBlendMode();
+  polyscope::render::engine->setColorMask();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshUpdatePositionsCost) {
+  const size_t n = 64;
+  std::vector<glm::vec3> points;
+  std::vector<std::vector<size_t>> faces;
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= n; j++) {
+      points.push_back(glm::vec3{i, j, 0.});
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      size_t v = i * (n + 1) + j;
+      faces.push_back({v, v + n + 1, v + 1});
+      faces.push_back({v + 1, v + n + 1, v + n + 2});
+    }
+  }
+  size_t nFaces = faces.size();
+  auto psMesh = polyscope::registerSurfaceMesh("grid", points, faces);
+  polyscope::show(3);
+
+  // Moving vertices rewrites just positions and normals (3 floats each, at 3 corners per face), and compiles nothing
+  for (glm::vec3& p : points) p.z = std::sin(p.x) * std::cos(p.y);
+  polyscope::render::engine->resetRenderStats();
+  psMesh->updateVertexPositions(points);
+  polyscope::show(1);
+  polyscope::render::RenderStats stats = polyscope::render::engine->renderStats;
+  EXPECT_EQ(stats.uploadBytes, 2 * 9 * sizeof(float) * nFaces);
+  EXPECT_EQ(stats.shaderCompilations, 0);
+
+  // The pick program shares those buffers, so it has nothing left to upload
+  polyscope::render::engine->resetRenderStats();
+  polyscope::pick::evaluatePickQuery(77, 88);
+  stats = polyscope::render::engine->renderStats;
+  EXPECT_EQ(stats.uploadBytes, 0);
+  EXPECT_EQ(stats.shaderCompilations, 0);
+
+  // ...and so do quantities drawing the surface
+  std::vector<double> vals(points.size(), 1.);
+  psMesh->addVertexScalarQuantity("vals", vals)->setEnabled(true);
+  polyscope::show(3);
+  polyscope::render::engine->resetRenderStats();
+  psMesh->updateVertexPositions(points);
+  polyscope::show(1);
+  stats = polyscope::render::engine->renderStats;
+  EXPECT_EQ(stats.uploadBytes, 2 * 9 * sizeof(float) * nFaces);
+  EXPECT_EQ(stats.shaderCompilations, 0);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshSharedGeometryBuffers) {
+  const size_t n = 64;
+  std::vector<glm::vec3> points;
+  std::vector<std::vector<size_t>> faces;
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= n; j++) {
+      points.push_back(glm::vec3{i, j, std::sin(i) * std::cos(j)});
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      size_t v = i * (n + 1) + j;
+      faces.push_back({v, v + n + 1, v + 1});
+      faces.push_back({v + 1, v + n + 1, v + n + 2});
+    }
+  }
+  size_t nFaces = faces.size();
+  auto psMesh = polyscope::registerSurfaceMesh("grid", points, faces);
+  polyscope::show(3);
+
+  // Quantities drawing the surface bind the mesh's geometry rather than uploading their own copy; all that is left
+  // for a vertex scalar is its value at each corner
+  polyscope::render::engine->resetRenderStats();
+  std::vector<double> vals(points.size(), 1.);
+  psMesh->addVertexScalarQuantity("vals", vals)->setEnabled(true);
+  polyscope::show(1);
+  EXPECT_LT(polyscope::render::engine->renderStats.uploadBytes, 9 * sizeof(float) * nFaces);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshPartialUpdate) {
+  const size_t n = 64;
+  std::vector<glm::vec3> points;
+  std::vector<std::vector<size_t>> faces;
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= n; j++) {
+      points.push_back(glm::vec3{i, j, 0.});
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      size_t v = i * (n + 1) + j;
+      faces.push_back({v, v + n + 1, v + 1});
+      faces.push_back({v + 1, v + n + 1, v + n + 2});
+    }
+  }
+  auto psMesh = polyscope::registerSurfaceMesh("grid", points, faces);
+  auto psReference = polyscope::registerSurfaceMesh("reference", points, faces);
+  polyscope::show(3);
+
+  // Move a few vertices, in two separate calls within a frame
+  std::vector<size_t> moved = {100, 101, 2000};
+  std::vector<glm::vec3> movedPositions = {{1., 2., 0.5}, {1., 3., -0.5}, {30., 50., 2.}};
+  polyscope::render::engine->resetRenderStats();
+  psMesh->updateVertexPositions(std::vector<size_t>{moved[0], moved[1]},
+                                std::vector<glm::vec3>{movedPositions[0], movedPositions[1]});
+  psMesh->updateVertexPositions(std::vector<size_t>{moved[2]}, std::vector<glm::vec3>{movedPositions[2]});
+  polyscope::show(1);
+  polyscope::render::RenderStats stats = polyscope::render::engine->renderStats;
+  EXPECT_GT(stats.uploadBytes, 0);
+  EXPECT_LT(stats.uploadBytes, 2 * 9 * sizeof(float) * faces.size() / 10);
+  EXPECT_EQ(stats.shaderCompilations, 0);
+
+  // Geometry matches that of a whole-array update
+  for (size_t i = 0; i < moved.size(); i++) points[moved[i]] = movedPositions[i];
+  psReference->updateVertexPositions(points);
+  EXPECT_EQ(psMesh->vertices, psReference->vertices);
+  EXPECT_EQ(psMesh->faceNormals, psReference->faceNormals);
+  EXPECT_EQ(psMesh->faceAreas, psReference->faceAreas);
+  EXPECT_EQ(psMesh->vertexNormals, psReference->vertexNormals);
+  EXPECT_EQ(psMesh->vertexAreas, psReference->vertexAreas);
+  EXPECT_EQ(psMesh->edgeLengths, psReference->edgeLengths);
+
+  // Also with smooth shading (drawn indexed), a quantity on top, and a pick
+  psReference->setEnabled(false);
+  psMesh->setSmoothShade(true);
+  psMesh->addVertexScalarQuantity("vals", std::vector<double>(points.size(), 1.))->setEnabled(true);
+  polyscope::show(3);
+  polyscope::pick::evaluatePickQuery(77, 88);
+  polyscope::render::engine->resetRenderStats();
+  psMesh->updateVertexPositions(std::vector<size_t>{moved[2]}, std::vector<glm::vec3>{{30., 50., -2.}});
+  polyscope::show(1);
+  polyscope::pick::evaluatePickQuery(77, 88);
+  stats = polyscope::render::engine->renderStats;
+  EXPECT_LT(stats.uploadBytes, 2 * 9 * sizeof(float) * faces.size() / 10);
+  EXPECT_EQ(stats.shaderCompilations, 0);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshGPUNormals) {
+  auto data = getTriangleMesh();
+  std::vector<glm::vec3> points = std::get<0>(data);
+  std::vector<std::vector<size_t>> faces = std::get<1>(data);
+  auto psMesh = polyscope::registerSurfaceMesh("gpu normals", points, faces);
+  auto psReference = polyscope::registerSurfaceMesh("reference", points, faces);
+  psMesh->setGPUNormals(true);
+  polyscope::show(3);
+
+  // Moving the vertices uploads only the corner positions
+  for (glm::vec3& p : points) p = 2.f * p + glm::vec3{0., p.x * p.y, 0.};
+  polyscope::render::engine->resetRenderStats();
+  psMesh->updateVertexPositions(points);
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, 3 * 3 * sizeof(float) * faces.size());
+
+  // and the derived geometry is brought up to date when read
+  psReference->updateVertexPositions(points);
+  psMesh->ensureHaveGeometryData();
+  EXPECT_EQ(psMesh->faceNormals, psReference->faceNormals);
+  EXPECT_EQ(psMesh->vertexAreas, psReference->vertexAreas);
+
+  psMesh->addVertexScalarQuantity("vals", std::vector<double>(points.size(), 1.))->setEnabled(true);
+  psMesh->updateVertexPositions(std::vector<size_t>{0}, std::vector<glm::vec3>{{1., 2., 3.}});
+  polyscope::show(3);
+  polyscope::pick::evaluatePickQuery(77, 88);
+  psMesh->setGPUNormals(false);
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshParallelGeometry) {
+  // Enough vertices and faces to be split across threads
+  const size_t n = 100;
+  std::vector<glm::vec3> points;
+  std::vector<std::vector<size_t>> faces;
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= n; j++) {
+      points.push_back(glm::vec3{i, j, std::sin(0.3 * i) * std::cos(0.2 * j)});
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      size_t v = i * (n + 1) + j;
+      if ((i + j) % 7 == 0) {
+        faces.push_back({v, v + n + 1, v + n + 2, v + 1});
+      } else {
+        faces.push_back({v, v + n + 1, v + 1});
+        faces.push_back({v + 1, v + n + 1, v + n + 2});
+      }
+    }
+  }
+
+  polyscope::options::numThreads = 1;
+  auto psMesh = polyscope::registerSurfaceMesh("grid", points, faces);
+  std::vector<glm::vec3> vertexNormals = psMesh->vertexNormals;
+  std::vector<double> vertexAreas = psMesh->vertexAreas;
+  std::vector<double> edgeLengths = psMesh->edgeLengths;
+
+  polyscope::options::numThreads = 4;
+  psMesh->computeGeometryData();
+  EXPECT_EQ(psMesh->vertexNormals, vertexNormals);
+  EXPECT_EQ(psMesh->vertexAreas, vertexAreas);
+  EXPECT_EQ(psMesh->edgeLengths, edgeLengths);
+  EXPECT_EQ(psMesh->edgeLengths.size(), psMesh->nEdges());
+
+  polyscope::options::numThreads = 0;
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshEdgeIndexing) {
+  // Edges are numbered in the order they are first seen walking the faces, including across polygons
+  std::vector<glm::vec3> points = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0.5, 0.5, 1}, {2, 0, 0}};
+  std::vector<std::vector<size_t>> faces = {{0, 1, 2, 3}, {0, 1, 4}, {1, 2, 4}, {2, 3, 4}, {3, 0, 4}, {1, 5, 2}};
+  auto psMesh = polyscope::registerSurfaceMesh("polygons", points, faces);
+
+  std::map<std::pair<size_t, size_t>, size_t> expectedEdges;
+  size_t iHe = 0;
+  for (size_t iF = 0; iF < faces.size(); iF++) {
+    for (size_t i = 0; i < faces[iF].size(); i++) {
+      size_t vA = faces[iF][i];
+      size_t vB = faces[iF][(i + 1) % faces[iF].size()];
+      std::pair<size_t, size_t> key(std::min(vA, vB), std::max(vA, vB));
+      if (expectedEdges.find(key) == expectedEdges.end()) {
+        size_t newInd = expectedEdges.size();
+        expectedEdges[key] = newInd;
+      }
+      EXPECT_EQ(psMesh->faceEdges(iF)[i], expectedEdges[key]);
+      EXPECT_EQ(psMesh->halfedgeIndex(iF, i), iHe++);
+    }
+  }
+  EXPECT_EQ(psMesh->nEdges(), expectedEdges.size());
+  EXPECT_EQ(psMesh->nHalfedges(), iHe);
+  EXPECT_FALSE(psMesh->isTriangleMesh());
+  EXPECT_EQ(psMesh->face(0).size(), 4);
+  EXPECT_EQ(psMesh->face(5)[1], 5);
+
+  // Pure triangle meshes are stored without per-face offsets
+  auto psTriMesh = registerTriangleMesh();
+  EXPECT_TRUE(psTriMesh->isTriangleMesh());
+  EXPECT_TRUE(psTriMesh->faceIndsStart.empty());
+  EXPECT_EQ(psTriMesh->faceStart(2), 6);
+  EXPECT_EQ(psTriMesh->face(2)[0], 2);
+
+  // The old per-face lists are still readable
+  ASSERT_EQ(psMesh->faces.size(), psMesh->nFaces());
+  EXPECT_EQ(psMesh->faces[5][1], 5);
+  EXPECT_EQ(psMesh->edgeIndices[0].size(), 4u);
+  EXPECT_EQ(psMesh->edgeIndices[2][1], psMesh->faceEdges(2)[1]);
+  EXPECT_EQ(psMesh->halfedgeIndices[1][2], psMesh->halfedgeIndex(1, 2));
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshPick) {
+  auto psMesh = registerTriangleMesh();
+
+  // Don't bother trying to actually click on anything, but make sure this doesn't crash
+  polyscope::pick::evaluatePickQuery(77, 88);
+
+  // Do it again with edges enabled
+  psMesh->setEdgeWidth(1.0);
+  polyscope::pick::evaluatePickQuery(77, 88);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, InstancedSurfaceMesh) {
+  auto psMesh = registerTriangleMesh();
+  psMesh->setEnabled(false);
+
+  std::vector<glm::mat4> transforms;
+  for (int i = 0; i < 1000; i++) {
+    transforms.push_back(glm::translate(glm::mat4(1.), glm::vec3{i % 10, (i / 10) % 10, i / 100}));
+  }
+  auto psInstances = polyscope::registerInstancedSurfaceMesh("instances", psMesh, transforms);
+  EXPECT_EQ(psInstances->nInstances(), 1000);
+  polyscope::show(3);
+
+  // All the copies are a single draw call, so the number of draw calls doesn't depend on the number of instances
+  polyscope::render::engine->resetRenderStats();
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  size_t drawCallsMany = polyscope::render::engine->renderStats.drawCalls;
+  psInstances->updateInstanceTransforms(std::vector<glm::mat4>(transforms.begin(), transforms.begin() + 10));
+  polyscope::render::engine->resetRenderStats();
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  EXPECT_EQ(drawCallsMany, polyscope::render::engine->renderStats.drawCalls);
+  psInstances->updateInstanceTransforms(transforms);
+
+  std::vector<glm::vec3> colors(1000, glm::vec3{0.2, 0.4, 0.6});
+  std::vector<double> values(1000);
+  for (size_t i = 0; i < values.size(); i++) values[i] = i;
+  psInstances->addInstanceColorQuantity("colors", colors)->setEnabled(true);
+  polyscope::show(3);
+  psInstances->addInstanceScalarQuantity("values", values)->setEnabled(true);
+  polyscope::show(3);
+  polyscope::pick::evaluatePickQuery(77, 88);
+
+  // Moving the instances keeps the quantities, changing their number drops them
+  transforms[0] = glm::translate(glm::mat4(1.), glm::vec3{-5., 0., 0.});
+  psInstances->updateInstanceTransforms(transforms);
+  EXPECT_TRUE(psInstances->getQuantity("values") != nullptr);
+  EXPECT_LE(std::get<0>(psInstances->boundingBox()).x, -5.);
+  transforms.resize(10);
+  psInstances->updateInstanceTransforms(transforms);
+  EXPECT_TRUE(psInstances->getQuantity("values") == nullptr);
+  polyscope::show(3);
+
+  psMesh->setEnabled(true); // enabled state persists by name
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SharedVertexPositions) {
+  const size_t n = 32;
+  std::vector<glm::vec3> points;
+  std::vector<std::vector<size_t>> lowerFaces, upperFaces;
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= n; j++) {
+      points.push_back(glm::vec3{i, j, 0.});
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      size_t v = i * (n + 1) + j;
+      std::vector<std::vector<size_t>>& faces = i < n / 2 ? lowerFaces : upperFaces;
+      faces.push_back({v, v + n + 1, v + 1});
+      faces.push_back({v + 1, v + n + 1, v + n + 2});
+    }
+  }
+
+  // Two parts of a mesh and a cloud of all the vertices, on one array
+  std::shared_ptr<polyscope::SharedVertexPositions> shared = polyscope::createSharedVertexPositions(points);
+  auto psLower = polyscope::registerSurfaceMesh("lower", shared, lowerFaces);
+  auto psUpper = polyscope::registerSurfaceMesh("upper", shared, upperFaces);
+  auto psCloud = polyscope::registerPointCloud("cloud", shared);
+  EXPECT_EQ(shared->nUsers(), 3u);
+  psLower->setSmoothShade(true);
+  psUpper->setSmoothShade(true);
+  polyscope::show(3);
+
+  // The same scene with a copy of the positions in each structure
+  auto psLowerCopy = polyscope::registerSurfaceMesh("lower copy", points, lowerFaces);
+  auto psUpperCopy = polyscope::registerSurfaceMesh("upper copy", points, upperFaces);
+  auto psCloudCopy = polyscope::registerPointCloud("cloud copy", points);
+  psLowerCopy->setSmoothShade(true);
+  psUpperCopy->setSmoothShade(true);
+  polyscope::show(3);
+
+  // One update moves everything, and the positions are uploaded once rather than three times (each mesh still
+  // uploads its own normals)
+  for (glm::vec3& p : points) p.z = std::sin(p.x);
+  polyscope::render::engine->resetRenderStats();
+  psLowerCopy->updateVertexPositions(points);
+  psUpperCopy->updateVertexPositions(points);
+  psCloudCopy->updatePointPositions(points);
+  polyscope::show(1);
+  size_t copiesUploadBytes = polyscope::render::engine->renderStats.uploadBytes;
+  polyscope::render::engine->resetRenderStats();
+  shared->updateVertexPositions(points);
+  polyscope::show(1);
+  EXPECT_EQ(psLower->vertices, points);
+  EXPECT_EQ(psUpper->vertices, points);
+  EXPECT_EQ(psCloud->points, points);
+  EXPECT_LE(polyscope::render::engine->renderStats.uploadBytes + 2 * points.size() * sizeof(glm::vec3),
+            copiesUploadBytes);
+
+  // Moving some vertices through one of the structures moves them for the others
+  psUpper->updateVertexPositions(std::vector<size_t>{5}, std::vector<glm::vec3>{{1., 2., 3.}});
+  EXPECT_EQ(psCloud->points[5], glm::vec3(1., 2., 3.));
+  EXPECT_EQ(psLower->vertices[5], glm::vec3(1., 2., 3.));
+  polyscope::show(1);
+
+  psCloud->remove();
+  EXPECT_EQ(shared->nUsers(), 2u);
+  polyscope::removeAllStructures();
+  EXPECT_EQ(shared->nUsers(), 0u);
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshBackface) {
+  auto psMesh = registerTriangleMesh();
+
+  // Same appearance
+  psMesh->setBackFacePolicy(polyscope::BackFacePolicy::Identical);
+  EXPECT_EQ(psMesh->getBackFacePolicy(), polyscope::BackFacePolicy::Identical);
+  polyscope::show(3);
+
+  // Different appearance
+  psMesh->setBackFacePolicy(polyscope::BackFacePolicy::Different);
+  EXPECT_EQ(psMesh->getBackFacePolicy(), polyscope::BackFacePolicy::Different);
+  psMesh->setBackFaceColor(glm::vec3(1.f, 0.f, 0.f));
+  EXPECT_EQ(psMesh->getBackFaceColor(), glm::vec3(1.f, 0.f, 0.f));
+  polyscope::show(3);
+
+  // Cull backfacing
+  psMesh->setBackFacePolicy(polyscope::BackFacePolicy::Cull);
+  EXPECT_EQ(psMesh->getBackFacePolicy(), polyscope::BackFacePolicy::Cull);
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshColorVertex) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> vColors(psMesh->nVertices(), glm::vec3{.2, .3, .4});
+  auto q1 = psMesh->addVertexColorQuantity("vcolor", vColors);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshColorFace) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> fColors(psMesh->nFaces(), glm::vec3{.2, .3, .4});
+  auto q2 = psMesh->addFaceColorQuantity("fColor", fColors);
+  q2->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshUpdateData) {
+  auto psMesh = registerTriangleMesh();
+
+  auto q1 = psMesh->addVertexScalarQuantity("vScalar", std::vector<double>(psMesh->nVertices(), 1.));
+  q1->setEnabled(true);
+  q1->setContourLevels({0.5});
+  q1->setContoursEnabled(true);
+  polyscope::show(3);
+  EXPECT_TRUE(q1->getContourSegments(0).empty());
+  q1->updateData(std::vector<double>{1., 0., 0., 0.});
+  EXPECT_EQ(q1->getContourSegments(0).size(), 6);
+  polyscope::show(3);
+
+  auto q2 = psMesh->addFaceScalarQuantity("fScalar", std::vector<double>(psMesh->nFaces(), 1.));
+  q2->setEnabled(true);
+  polyscope::show(3);
+  q2->updateData(std::vector<double>(psMesh->nFaces(), 2.));
+  polyscope::show(3);
+
+  auto q3 = psMesh->addFaceColorQuantity("fColor", std::vector<glm::vec3>(psMesh->nFaces(), glm::vec3{.2, .3, .4}));
+  q3->setEnabled(true);
+  polyscope::show(3);
+  q3->updateData(std::vector<glm::vec3>(psMesh->nFaces(), glm::vec3{.4, .3, .2}));
+  polyscope::show(3);
+
+  auto q4 =
+      psMesh->addVertexVectorQuantity("vVector", std::vector<glm::vec3>(psMesh->nVertices(), glm::vec3{1., 0., 0.}));
+  q4->setEnabled(true);
+  polyscope::show(3);
+  q4->updateData(std::vector<glm::vec3>(psMesh->nVertices(), glm::vec3{0., 1., 0.}));
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshUpdateTopology) {
+  auto psMesh = registerTriangleMesh();
+  psMesh->setSurfaceColor(glm::vec3{.1, .2, .3});
+  auto q1 = psMesh->addVertexScalarQuantity("vScalar", std::vector<double>(psMesh->nVertices(), 1.));
+  auto q2 = psMesh->addFaceColorQuantity("fColor", std::vector<glm::vec3>(psMesh->nFaces(), glm::vec3{.2, .3, .4}));
+  psMesh->addVertexVectorQuantity("vVector", std::vector<glm::vec3>(psMesh->nVertices(), glm::vec3{1., 0., 0.}));
+  q1->setEnabled(true);
+  polyscope::show(3);
+
+  // A square pyramid: more vertices and faces, some of them quads
+  std::vector<glm::vec3> points{{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {.5, .5, 1}};
+  std::vector<std::vector<size_t>> faces{{3, 2, 1, 0}, {0, 1, 4}, {1, 2, 4}, {2, 3, 4}, {3, 0, 4}};
+  psMesh->updateTopology(points, faces);
+  EXPECT_EQ(psMesh->nVertices(), 5);
+  EXPECT_EQ(psMesh->nFaces(), 5);
+  EXPECT_EQ(psMesh->nEdges(), 8);
+  EXPECT_EQ(psMesh->getSurfaceColor(), glm::vec3(.1, .2, .3));
+
+  // Scalars and colors follow, other quantities are removed
+  EXPECT_EQ(psMesh->getQuantity("vScalar"), q1);
+  EXPECT_EQ(psMesh->getQuantity("fColor"), q2);
+  EXPECT_EQ(psMesh->getQuantity("vVector"), nullptr);
+  EXPECT_TRUE(q1->isEnabled());
+  polyscope::show(3);
+  q1->updateData(std::vector<double>{0., 1., 2., 3., 4.});
+  q2->updateData(std::vector<glm::vec3>(5, glm::vec3{.4, .3, .2}));
+  q2->setEnabled(true);
+  polyscope::show(3);
+
+  // Picking covers the new elements
+  psMesh->setEdgeWidth(1.);
+  polyscope::show(3);
+  polyscope::pick::evaluatePickQuery(77, 88);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshScalarVertex) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  auto q1 = psMesh->addVertexScalarQuantity("vScalar", vScalar);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshScalarVertexContours) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<double> vScalar{1., 0., 0., 0.}; // the x coordinate
+  auto q1 = psMesh->addVertexScalarQuantity("vScalar", vScalar);
+  q1->setContourLevels({0.5, 2.});
+
+  // The level 0.5 cuts the corner at vertex 0 off the tetrahedron, in one loop of three segments
+  std::vector<glm::vec3> segments = q1->getContourSegments(0);
+  EXPECT_EQ(segments.size(), 6);
+  for (glm::vec3 p : segments) {
+    EXPECT_NEAR(p.x, 0.5, 1e-6);
+  }
+  std::vector<std::vector<glm::vec3>> polylines = q1->getContourPolylines(0);
+  ASSERT_EQ(polylines.size(), 1);
+  EXPECT_EQ(polylines[0].size(), 4);
+  EXPECT_EQ(polylines[0].front(), polylines[0].back());
+  EXPECT_TRUE(q1->getContourPolylines(1).empty());
+
+  // Levels which are kept are not extracted again
+  q1->setContourLevelCount(3);
+  EXPECT_EQ(q1->getContourLevels(), (std::vector<double>{0.25, 0.5, 0.75}));
+  EXPECT_EQ(q1->getContourSegments(2).size(), 6);
+
+  q1->setEnabled(true);
+  q1->setContoursEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshScalarFace) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<double> fScalar(psMesh->nFaces(), 8.);
+  auto q2 = psMesh->addFaceScalarQuantity("fScalar", fScalar);
+  q2->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshFaceQuantityTextures) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  std::vector<double> fScalar{1., 2., 3., 4.};
+  std::vector<glm::vec3> fColors(psMesh->nFaces(), glm::vec3{.2, .3, .4});
+  auto qV = psMesh->addVertexScalarQuantity("vScalar", vScalar);
+  auto qF = psMesh->addFaceScalarQuantity("fScalar", fScalar);
+  auto qC = psMesh->addFaceColorQuantity("fColor", fColors);
+
+  // Face values are stored once per face, not copied to every corner like vertex values
+  qV->setEnabled(true);
+  polyscope::show(1);
+  qF->setEnabled(true);
+  polyscope::show(1);
+  EXPECT_LT(qF->getGPUMemoryUsage(), qV->getGPUMemoryUsage());
+
+  // Switching between face quantities, and picking through them
+  qC->setEnabled(true);
+  polyscope::show(1);
+  polyscope::pick::evaluatePickQuery(10, 10);
+  qF->setEnabled(true);
+  psMesh->setSmoothShade(true);
+  polyscope::show(1);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshScalarEdge) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<double> eScalar(psMesh->nEdges(), 9.);
+  auto q3 = psMesh->addEdgeScalarQuantity("eScalar", eScalar);
+  q3->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshScalarHalfedge) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<double> heScalar(psMesh->nHalfedges(), 10.);
+  auto q4 = psMesh->addHalfedgeScalarQuantity("heScalar", heScalar);
+  q4->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshDistance) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshSignedDistance) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  auto q1 = psMesh->addVertexSignedDistanceQuantity("distance", vScalar);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshCornerParam) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec2> vals(psMesh->nCorners(), {1., 2.});
+  auto q1 = psMesh->addParameterizationQuantity("param", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+
+  // try the various render options
+  q1->setStyle(polyscope::ParamVizStyle::CHECKER);
+  polyscope::show(3);
+  q1->setStyle(polyscope::ParamVizStyle::GRID);
+  polyscope::show(3);
+  q1->setStyle(polyscope::ParamVizStyle::LOCAL_CHECK);
+  polyscope::show(3);
+  q1->setStyle(polyscope::ParamVizStyle::LOCAL_RAD);
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshVertexParam) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec2> vals(psMesh->nVertices(), {1., 2.});
+  auto q1 = psMesh->addVertexParameterizationQuantity("param", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+
+  // try the various render options
+  q1->setStyle(polyscope::ParamVizStyle::CHECKER);
+  polyscope::show(3);
+  q1->setStyle(polyscope::ParamVizStyle::GRID);
+  polyscope::show(3);
+  q1->setStyle(polyscope::ParamVizStyle::LOCAL_CHECK);
+  polyscope::show(3);
+  q1->setStyle(polyscope::ParamVizStyle::LOCAL_RAD);
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshParamIndexed) {
+  // Smooth-shaded meshes draw parameterizations indexed, splitting vertices along seams of a corner parameterization
+  std::vector<glm::vec3> points = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0.5, 0.5, 1}};
+  std::vector<std::vector<size_t>> faces = {{0, 1, 2, 3}, {0, 1, 4}, {1, 2, 4}, {2, 3, 4}, {3, 0, 4}};
+  auto psMesh = polyscope::registerSurfaceMesh("polygons", points, faces);
+  psMesh->setSmoothShade(true);
+
+  std::vector<glm::vec2> cornerVals(psMesh->nCorners(), {1., 2.});
+  cornerVals[4] = {3., 4.}; // vertex 0 of the second face, so a seam there
+  auto qCorner = psMesh->addParameterizationQuantity("corner param", cornerVals);
+  qCorner->setEnabled(true);
+  polyscope::show(3);
+
+  // Geometry updates rebuild the indexed buffers
+  points[4].z = 2.;
+  psMesh->updateVertexPositions(points);
+  polyscope::show(3);
+
+  std::vector<glm::vec2> vertexVals(psMesh->nVertices(), {1., 2.});
+  auto qVertex = psMesh->addVertexParameterizationQuantity("vertex param", vertexVals);
+  qVertex->setEnabled(true);
+  qVertex->setStyle(polyscope::ParamVizStyle::LOCAL_RAD);
+  polyscope::show(3);
+
+  // Falls back to per-corner data when a wireframe is needed
+  psMesh->setEdgeWidth(1.);
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+
+TEST_F(PolyscopeTest, SurfaceMeshVertexLocalParam) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec2> vals(psMesh->nVertices(), {1., 2.});
+  auto q1 = psMesh->addLocalParameterizationQuantity("param", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshVertexVector) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> vals(psMesh->nVertices(), {1., 2., 3.});
+  auto q1 = psMesh->addVertexVectorQuantity("param", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshFaceVector) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> vals(psMesh->nFaces(), {1., 2., 3.});
+  auto q1 = psMesh->addFaceVectorQuantity("param", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshVertexIntrinsic) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> basisX(psMesh->nVertices(), {1., 2., 3.});
+  psMesh->setVertexTangentBasisX(basisX);
+  std::vector<glm::vec2> vals(psMesh->nVertices(), {1., 2.});
+  auto q1 = psMesh->addVertexIntrinsicVectorQuantity("param", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshFaceIntrinsic) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> basisX(psMesh->nFaces(), {1., 2., 3.});
+  psMesh->setFaceTangentBasisX(basisX);
+  std::vector<glm::vec2> vals(psMesh->nFaces(), {1., 2.});
+  auto q1 = psMesh->addFaceIntrinsicVectorQuantity("param", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshOneForm) {
+  auto psMesh = registerTriangleMesh();
+  // std::vector<glm::vec3> basisX(psMesh->nVertices(), {1., 2., 3.});
+  // psMesh->setVertexTangentBasisX(basisX);
+  std::vector<double> vals(psMesh->nEdges(), 3.);
+  std::vector<char> orients(psMesh->nEdges(), true);
+  auto q1 = psMesh->addOneFormIntrinsicVectorQuantity("one form vecs", vals, orients);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshManifoldConnectivity) {
+  auto psMesh = registerTriangleMesh();
+
+  // a closed tetrahedron: each halfedge has a twin on the same edge, in another face
+  psMesh->ensureHaveManifoldConnectivity();
+  ASSERT_EQ(psMesh->twinHalfedge.size(), psMesh->nHalfedges());
+  for (size_t iHe = 0; iHe < psMesh->nHalfedges(); iHe++) {
+    size_t iTwin = psMesh->twinHalfedge[iHe];
+    ASSERT_NE(iTwin, polyscope::INVALID_IND);
+    EXPECT_EQ(psMesh->twinHalfedge[iTwin], iHe);
+    EXPECT_NE(psMesh->faceForHalfedge[iTwin], psMesh->faceForHalfedge[iHe]);
+    EXPECT_EQ(psMesh->halfedgeEdgeIndices[iTwin], psMesh->halfedgeEdgeIndices[iHe]);
+  }
+
+  // default tangent spaces are tangent to the surface
+  psMesh->generateDefaultFaceTangentSpaces();
+  psMesh->generateDefaultVertexTangentSpaces();
+  for (size_t iF = 0; iF < psMesh->nFaces(); iF++) {
+    EXPECT_NEAR(glm::dot(psMesh->faceTangentSpaces[iF][0], psMesh->faceNormals[iF]), 0., 1e-5);
+    EXPECT_NEAR(glm::length(psMesh->faceTangentSpaces[iF][1]), 1., 1e-5);
+  }
+  for (size_t iV = 0; iV < psMesh->nVertices(); iV++) {
+    EXPECT_GT(glm::length(psMesh->vertexTangentSpaces[iV][0]), 0.);
+    EXPECT_NEAR(glm::dot(psMesh->vertexTangentSpaces[iV][0], psMesh->vertexNormals[iV]), 0., 1e-5);
+  }
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshVertexIntrinsicRibbon) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> basisX(psMesh->nVertices(), {1., 2., 3.});
+  psMesh->setVertexTangentBasisX(basisX);
+  std::vector<glm::vec3> basisXF(psMesh->nFaces(), {1., 2., 3.});
+  psMesh->setFaceTangentBasisX(basisXF);
+  std::vector<glm::vec2> vals(psMesh->nVertices(), {1., 2.});
+  auto q1 = psMesh->addVertexIntrinsicVectorQuantity("param", vals);
+  q1->setEnabled(true);
+  q1->setRibbonEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshFaceIntrinsicRibbon) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> basisX(psMesh->nFaces(), {1., 2., 3.});
+  psMesh->setFaceTangentBasisX(basisX);
+  std::vector<glm::vec2> vals(psMesh->nFaces(), {1., 2.});
+  auto q1 = psMesh->addFaceIntrinsicVectorQuantity("param", vals);
+  q1->setEnabled(true);
+  q1->setRibbonEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshTraceFieldSeeded) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> basisX(psMesh->nFaces(), {1., 2., 3.});
+  psMesh->setFaceTangentBasisX(basisX);
   std::vector<glm::vec2> vals(psMesh->nFaces(), {1., 2.});
+
+  // the same seed gives the same lines, whatever the number of threads
+  auto lines = polyscope::traceField(*psMesh, vals, 1, 200, 7);
+  EXPECT_FALSE(lines.empty());
+  polyscope::options::numThreads = 1;
+  EXPECT_EQ(polyscope::traceField(*psMesh, vals, 1, 200, 7), lines);
+  polyscope::options::numThreads = 0;
+
+  // tracing in the background gives them too, in order
+  polyscope::FieldTraceTask task(*psMesh, vals, 1, 200, 7);
+  task.finish();
+  EXPECT_TRUE(task.isDone());
+  EXPECT_EQ(task.takeCompletedLines(), lines);
+  EXPECT_TRUE(task.takeCompletedLines().empty());
+
+  // ribbons filled in by the background tracing
+  polyscope::options::backgroundFieldTracing = true;
   auto q1 = psMesh->addFaceIntrinsicVectorQuantity("param", vals);
   q1->setEnabled(true);
-  q1->setRibbonEnabled(true);
+  q1->setRibbonEnabled(true);
+  polyscope::show(3);
+  polyscope::screenshot();
+  polyscope::options::backgroundFieldTracing = false;
+
+  polyscope::removeAllStructures();
+}
+
+
+TEST_F(PolyscopeTest, SurfaceMeshVertexCount) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<std::pair<size_t, int>> vals = {{0, 1}, {2, -2}};
+  auto q1 = psMesh->addVertexCountQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshVertexCountPermuted) {
+  auto psMesh = registerTriangleMesh();
+  size_t nV = psMesh->nVertices();
+  std::vector<size_t> perm(nV);
+  for (size_t i = 0; i < nV; i++) perm[i] = nV - 1 - i;
+  psMesh->setVertexPermutation(perm);
+
+  // entries are mapped through the inverse permutation, sorted, and the last value of a repeated index is kept
+  std::vector<std::pair<size_t, int>> vals = {{0, 1}, {2, -2}, {0, 5}};
+  auto q1 = psMesh->addVertexCountQuantity("vals", vals);
+  std::vector<std::pair<size_t, int>> expected = {{nV - 3, -2}, {nV - 1, 5}};
+  EXPECT_EQ(q1->values, expected);
+  q1->setEnabled(true);
+  polyscope::show(3);
+
+  // dense data is gathered through the permutation, and the inverse is cached until the permutation is set again
+  std::vector<double> scalars(nV);
+  for (size_t i = 0; i < nV; i++) scalars[i] = i;
+  psMesh->addVertexScalarQuantity("scalars", scalars);
+  EXPECT_EQ(polyscope::applyPermutation(scalars, psMesh->vertexPerm)[0], nV - 1);
+  EXPECT_EQ(psMesh->getVertexPermInverse()[nV - 1], 0);
+  EXPECT_TRUE(psMesh->getFacePermInverse().empty());
+  std::vector<size_t> identity(nV);
+  for (size_t i = 0; i < nV; i++) identity[i] = i;
+  psMesh->setVertexPermutation(identity);
+  EXPECT_EQ(psMesh->getVertexPermInverse()[nV - 1], nV - 1);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshSelection) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<char> membership(psMesh->nVertices(), 0);
+  auto q1 = psMesh->addVertexSelectionQuantity("selected vertices", membership);
+  q1->setEnabled(true);
+  polyscope::show(3);
+
+  // edits are uploaded on the next draw
+  q1->setSelected(1, true);
+  EXPECT_TRUE(q1->isSelected(1));
+  EXPECT_FALSE(q1->isSelected(0));
+  q1->applyBrush(glm::vec2{polyscope::view::bufferWidth / 2., polyscope::view::bufferHeight / 2.});
+  polyscope::show(3);
+  q1->selectAll();
+  EXPECT_EQ(q1->getMembershipData(), std::vector<char>(psMesh->nVertices(), 1));
+  polyscope::show(3);
+
+  std::vector<char> faceMembership(psMesh->nFaces(), 1);
+  auto q2 = psMesh->addFaceSelectionQuantity("selected faces", faceMembership);
+  q2->setEnabled(true);
+  q2->setColorMap("reds");
+  polyscope::show(3);
+  q2->selectNone();
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshFaceCount) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<std::pair<size_t, int>> vals = {{0, 1}, {2, -2}};
+  auto q1 = psMesh->addFaceCountQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshVertexIsolated) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<std::pair<size_t, double>> vals = {{0, 1.1}, {2, -2.3}};
+  auto q1 = psMesh->addVertexIsolatedScalarQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshSparseScalar) {
+  auto psMesh = registerTriangleMesh();
+
+  // Entries are sorted by element, and the last value given for an element is kept
+  std::vector<std::pair<size_t, double>> vals = {{2, -2.3}, {0, 1.1}, {2, 4.}};
+  auto q1 = psMesh->addVertexSparseScalarQuantity("vals", vals);
+  EXPECT_EQ(q1->getElements().size(), 2);
+  EXPECT_EQ(q1->getElements().getIndices(), std::vector<uint32_t>({0, 2}));
+  EXPECT_EQ(q1->getValue(2), 4.);
+  EXPECT_FALSE(q1->hasValue(1));
+  EXPECT_TRUE(std::isnan(q1->getValue(1)));
+  EXPECT_EQ(q1->getMapRange(), std::make_pair(1.1, 4.));
+  q1->setEnabled(true);
+  polyscope::show(3);
+
+  // New values for the same vertices only upload the values again
+  q1->updateData(std::vector<double>{0., 1.});
+  EXPECT_EQ(q1->getValue(2), 1.);
+  q1->setIsolinesEnabled(true);
+  polyscope::show(3);
+
+  auto q2 = psMesh->addFaceSparseScalarQuantity("face vals", {{3, 0.5}});
+  EXPECT_EQ(q2->getValue(3), 0.5);
+  q2->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshSurfaceGraph) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> nodes = {
+      {1., 2., 3.},
+      {3., 4., 5.},
+      {5., 6., 7.},
+  };
+  std::vector<std::array<size_t, 2>> edges = {{0, 1}, {1, 2}, {2, 0}};
+  auto q1 = psMesh->addSurfaceGraphQuantity("vals", nodes, edges);
+  q1->setEnabled(true);
+  polyscope::show(3);
+
+  // a node on no edge is drawn as a sphere
+  nodes.push_back({7., 8., 9.});
+  auto q2 = psMesh->addSurfaceGraphQuantity("vals2", nodes, edges);
+  q2->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, SurfaceMeshSurfaceGraphPath) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> nodes = {
+      {1., 2., 3.},
+      {3., 4., 5.},
+      {5., 6., 7.},
+  };
+  auto q1 = psMesh->addSurfaceGraphQuantity("vals", std::vector<std::vector<glm::vec3>>({nodes, nodes}));
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+
+// ============================================================
+// =============== Curve network tests
+// ============================================================
+
+std::tuple<std::vector<glm::vec3>, std::vector<std::array<size_t, 2>>> getCurveNetwork() {
+  std::vector<glm::vec3> points;
+  std::vector<std::array<size_t, 2>> edges;
+
+  // clang-format off
+  points = {
+    {1, 0, 0},
+    {0, 1, 0},
+    {0, 0, 1},
+    {0, 0, 0},
+  };
+
+  edges = {
+    {1, 3},
+    {3, 0},
+    {1, 0},
+    {0, 2}
+   };
+  // clang-format on
+
+  return std::tuple<std::vector<glm::vec3>, std::vector<std::array<size_t, 2>>>{points, edges};
+};
+
+polyscope::CurveNetwork* registerCurveNetwork(std::string name = "test1") {
+  std::vector<glm::vec3> points;
+  std::vector<std::array<size_t, 2>> edges;
+  std::tie(points, edges) = getCurveNetwork();
+  return polyscope::registerCurveNetwork(name, points, edges);
+}
+
+
+TEST_F(PolyscopeTest, ShowCurveNetwork) {
+  auto psCurve = registerCurveNetwork();
+
+  // Make sure we actually added the mesh
+  polyscope::show(3);
+  EXPECT_TRUE(polyscope::hasCurveNetwork("test1"));
+  EXPECT_FALSE(polyscope::hasCurveNetwork("test2"));
+  polyscope::removeAllStructures();
+  EXPECT_FALSE(polyscope::hasCurveNetwork("test1"));
+}
+
+TEST_F(PolyscopeTest, CurveNetworkAppearance) {
+  auto psCurve = registerCurveNetwork();
+
+  // Material
+  psCurve->setMaterial("wax");
+  EXPECT_EQ(psCurve->getMaterial(), "wax");
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CurveNetworkPartialUpdate) {
+  std::vector<glm::vec3> nodes;
+  for (size_t i = 0; i < 100; i++) {
+    nodes.push_back(glm::vec3{i, 0., 0.});
+  }
+  auto psCurve = polyscope::registerCurveNetworkLine("line", nodes);
+  polyscope::show(3);
+
+  // An interior node of a line: its own position, and both ends of the two edges touching it
+  polyscope::render::engine->resetRenderStats();
+  psCurve->updateNodePositions(std::vector<size_t>{50}, std::vector<glm::vec3>{{50., 1., 0.}});
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, (1 + 2 * 2) * 3 * sizeof(float));
+
+  polyscope::pick::evaluatePickQuery(77, 88);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CurveNetworkQuantitiesShareGeometry) {
+  std::vector<glm::vec3> nodes;
+  for (size_t i = 0; i < 100; i++) {
+    nodes.push_back(glm::vec3{i, 0., 0.});
+  }
+  auto psCurve = polyscope::registerCurveNetworkLine("line", nodes);
+  std::vector<double> nScalar(psCurve->nNodes(), 2.);
+  std::vector<glm::vec3> eColor(psCurve->nEdges(), glm::vec3{0.1, 0.2, 0.3});
+  psCurve->addNodeScalarQuantity("nScalar", nScalar)->setEnabled(true);
+  polyscope::show(3);
+  psCurve->addEdgeColorQuantity("eColor", eColor)->setEnabled(true);
+  polyscope::show(3);
+
+  // Moving a node uploads the shared geometry once, however many quantities have programs
+  polyscope::render::engine->resetRenderStats();
+  psCurve->updateNodePositions(std::vector<size_t>{50}, std::vector<glm::vec3>{{50., 1., 0.}});
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, (1 + 2 * 2) * 3 * sizeof(float));
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CurveNetworkStripModes) {
+  std::vector<glm::vec3> nodes;
+  for (size_t i = 0; i < 100; i++) {
+    nodes.push_back(glm::vec3{i, 0., 0.});
+  }
+  auto psCurve = polyscope::registerCurveNetworkLine("line", nodes);
+  polyscope::show(3);
+
+  // Each node is uploaded once, and each edge as a pair of indices
+  psCurve->setCurveRenderMode(polyscope::CurveRenderMode::Tubes);
+  EXPECT_EQ(psCurve->getCurveRenderMode(), polyscope::CurveRenderMode::Tubes);
+  polyscope::render::engine->resetRenderStats();
+  polyscope::show(1);
+  size_t stripBytes = 100 * 3 * sizeof(float) + 99 * 2 * sizeof(unsigned int);
+  EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, stripBytes);
+
+  // Moving a node only rewrites that node
+  polyscope::render::engine->resetRenderStats();
+  psCurve->updateNodePositions(std::vector<size_t>{50}, std::vector<glm::vec3>{{50., 1., 0.}});
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->renderStats.uploadBytes, 3 * sizeof(float));
+
+  psCurve->setCurveRenderMode(polyscope::CurveRenderMode::Lines);
+  polyscope::show(3);
+
+  // With a slice plane
+  polyscope::addSceneSlicePlane();
+  polyscope::show(3);
+  psCurve->setCurveRenderMode(polyscope::CurveRenderMode::Tubes);
+  psCurve->setCullWholeElements(true);
+  polyscope::show(3);
+  polyscope::removeLastSceneSlicePlane();
+
+  // Quantities still draw cylinders
+  std::vector<double> vals(100, 0.5);
+  psCurve->addNodeScalarQuantity("vals", vals)->setEnabled(true);
+  polyscope::show(3);
+
+  polyscope::pick::evaluatePickQuery(77, 88);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CurveNetworkPick) {
+  auto psCurve = registerCurveNetwork();
+
+  // Don't bother trying to actually click on anything, but make sure this doesn't crash
+  polyscope::pick::evaluatePickQuery(77, 88);
+
+  polyscope::removeAllStructures();
+}
+
+
+TEST_F(PolyscopeTest, CurveNetworkColorNode) {
+  auto psCurve = registerCurveNetwork();
+  std::vector<glm::vec3> vColors(psCurve->nNodes(), glm::vec3{.2, .3, .4});
+  auto q1 = psCurve->addNodeColorQuantity("vcolor", vColors);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CurveNetworkColorFace) {
+  auto psCurve = registerCurveNetwork();
+  std::vector<glm::vec3> eColors(psCurve->nEdges(), glm::vec3{.2, .3, .4});
+  auto q2 = psCurve->addEdgeColorQuantity("eColor", eColors);
+  q2->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CurveNetworkScalarNode) {
+  auto psCurve = registerCurveNetwork();
+  std::vector<double> vScalar(psCurve->nNodes(), 7.);
+  auto q1 = psCurve->addNodeScalarQuantity("vScalar", vScalar);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CurveNetworkScalarEdge) {
+  auto psCurve = registerCurveNetwork();
+  std::vector<double> eScalar(psCurve->nEdges(), 9.);
+  auto q3 = psCurve->addEdgeScalarQuantity("eScalar", eScalar);
+  q3->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CurveNetworkVertexVector) {
+  auto psCurve = registerCurveNetwork();
+  std::vector<glm::vec3> vals(psCurve->nNodes(), {1., 2., 3.});
+  auto q1 = psCurve->addNodeVectorQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CurveNetworkFaceVector) {
+  auto psCurve = registerCurveNetwork();
+  std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
+  auto q1 = psCurve->addEdgeVectorQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+// ============================================================
+// =============== Volume mesh tests
+// ============================================================
+
+std::tuple<std::vector<glm::vec3>, std::vector<std::array<int, 8>>> getVolumeMeshData() {
+  // clang-format off
+  std::vector<glm::vec3> combined_verts = {
+    {0, 0, 0},
+    {1, 0, 0},
+    {1, 1, 0},
+    {0, 1, 0},
+    {0, 0, 1},
+    {1, 0, 1},
+    {1, 1, 1},
+    {0, 1, 1},
+    {1, 1, 1.5}
+  };
+
+  std::vector<std::array<int, 8>> combined_cells = {
+    {0, 1, 2, 3, 4, 5, 6, 7},
+    {7, 5, 6, 8, -1, -1, -1, -1},
+  };
+  // clang-format on
+
+  return std::make_tuple(combined_verts, combined_cells);
+};
+
+TEST_F(PolyscopeTest, ShowVolumeMesh) {
+  // clang-format off
+
+  // Tets only
+  std::vector<glm::vec3> tet_verts = {
+    {0, 0, 0},
+    {0, 0, 1},
+    {0, 1, 0},
+    {0, 1, 1},
+  };
+  std::vector<std::array<size_t, 4>> tet_cells = {
+    {0,1,2,4}
+  };
+  polyscope::registerTetMesh("tet", tet_verts, tet_cells);
+   
+
+  // Hexes only
+  std::vector<glm::vec3> hex_verts = {
+    {0, 0, 0},
+    {0, 0, 1},
+    {0, 1, 0},
+    {0, 1, 1},
+    {1, 0, 0},
+    {1, 0, 1},
+    {1, 1, 0},
+    {1, 1, 1},
+  };
+  std::vector<std::array<size_t, 8>> hex_cells = {
+    {0,1,2,3,4,5,6,7},
+  };
+  polyscope::registerHexMesh("hex", hex_verts, hex_cells);
+
+
+  // clang-format on
+
+  // Mixed elements, separate arrays
+  std::vector<glm::vec3> combined_verts;
+  combined_verts.insert(combined_verts.end(), tet_verts.begin(), tet_verts.end());
+  combined_verts.insert(combined_verts.end(), hex_verts.begin(), hex_verts.end());
+  for (auto& hex : hex_cells) {
+    for (size_t& i : hex) {
+      i += tet_verts.size();
+    }
+  }
+  polyscope::registerTetHexMesh("tet hex mix separate", combined_verts, tet_cells, hex_cells);
+
+
+  // Mixed elements, shared array
+  std::vector<std::array<int, 8>> combined_cells = {
+      {0, 1, 3, 4, -1, -1, -1, -1},
+      {4, 5, 6, 7, 8, 9, 10, 11},
+  };
+  polyscope::registerVolumeMesh("tet hex mix combined", combined_verts, combined_cells);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshFlatCells) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+
+  // Tets alone need no starts
+  std::vector<std::array<size_t, 4>> tets = {{0, 1, 2, 3}, {1, 2, 3, 4}};
+  polyscope::VolumeMesh* psTet = polyscope::registerTetMesh("tets", verts, tets);
+  EXPECT_TRUE(psTet->cellIndsStart.empty());
+  EXPECT_EQ(psTet->uniformCellDegree, 4);
+  EXPECT_EQ(psTet->nCells(), 2);
+  EXPECT_EQ(psTet->cell(1)[0], 1);
+  EXPECT_EQ(psTet->cell(1).size(), 4);
+
+  // A mix keeps the type of each cell
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+  EXPECT_EQ(psVol->nCells(), cells.size());
+  size_t nEntries = 0;
+  for (size_t iC = 0; iC < cells.size(); iC++) {
+    bool isTet = cells[iC][4] < 0;
+    EXPECT_EQ(psVol->cellType(iC), isTet ? polyscope::VolumeCellType::TET : polyscope::VolumeCellType::HEX);
+    EXPECT_EQ(psVol->cell(iC).size(), isTet ? 4 : 8);
+    EXPECT_EQ(static_cast<int>(psVol->cell(iC)[3]), cells[iC][3]);
+    nEntries += isTet ? 4 : 8;
+  }
+  EXPECT_EQ(psVol->cellIndsEntries.size(), nEntries);
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshBoundaryOnlyBuffers) {
+  // A 3x3x3 grid of hexes, most of whose faces are interior
+  const int64_t n = 3;
+  auto ind = [&](int64_t i, int64_t j, int64_t k) { return (i * (n + 1) + j) * (n + 1) + k; };
+  std::vector<glm::vec3> verts;
+  for (int64_t i = 0; i <= n; i++) {
+    for (int64_t j = 0; j <= n; j++) {
+      for (int64_t k = 0; k <= n; k++) {
+        verts.push_back(glm::vec3{i, j, k});
+      }
+    }
+  }
+  std::vector<std::array<int64_t, 8>> cells;
+  for (int64_t i = 0; i < n; i++) {
+    for (int64_t j = 0; j < n; j++) {
+      for (int64_t k = 0; k < n; k++) {
+        cells.push_back({ind(i, j, k), ind(i + 1, j, k), ind(i + 1, j + 1, k), ind(i, j + 1, k), ind(i, j, k + 1),
+                         ind(i + 1, j, k + 1), ind(i + 1, j + 1, k + 1), ind(i, j + 1, k + 1)});
+      }
+    }
+  }
+  auto psVol = polyscope::registerVolumeMesh("grid", verts, cells);
+  EXPECT_EQ(psVol->nExteriorFacesTriangulation(), 6 * n * n * 2);
+
+  // Only the shell is drawn...
+  polyscope::show(1);
+  EXPECT_FALSE(psVol->drawsInteriorFaces());
+  size_t shellBytes = psVol->getGPUMemoryUsage();
+
+  // ...until a slice plane can cut into the mesh
+  polyscope::addSceneSlicePlane();
+  polyscope::show(1);
+  EXPECT_TRUE(psVol->drawsInteriorFaces());
+  EXPECT_GT(psVol->getGPUMemoryUsage(), shellBytes);
+  polyscope::removeLastSceneSlicePlane();
+  polyscope::show(1);
+  EXPECT_FALSE(psVol->drawsInteriorFaces());
+
+  // Transparency shows the interior too
+  psVol->setTransparency(0.5);
+  polyscope::show(1);
+  EXPECT_TRUE(psVol->drawsInteriorFaces());
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshAppearance) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  // Material
+  psVol->setMaterial("wax");
+  EXPECT_EQ(psVol->getMaterial(), "wax");
+  polyscope::show(3);
+
+  // Color of the mesh
+  glm::vec3 color{0.5, 0.25, 0.25};
+  psVol->setColor(color);
+  EXPECT_EQ(color, psVol->getColor());
+
+  // Color of the mesh inteiror
+  glm::vec3 colorI{0.5, 0.25, 0.75};
+  psVol->setInteriorColor(colorI);
+  EXPECT_EQ(colorI, psVol->getInteriorColor());
+
+  // Color of the mesh edges
+  glm::vec3 colorE{0.5, 0.25, 0.5};
+  psVol->setEdgeColor(colorE);
+  EXPECT_EQ(colorE, psVol->getEdgeColor());
+  polyscope::show(3);
+
+  // Edge width
+  psVol->setEdgeWidth(0.25);
+  EXPECT_EQ(0.25, psVol->getEdgeWidth());
+
+  // Transparency
+  psVol->setTransparency(0.25);
+  EXPECT_EQ(0.25, psVol->getTransparency());
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshPick) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  // Don't bother trying to actually click on anything, but make sure this doesn't crash
+  polyscope::pick::evaluatePickQuery(77, 88);
+
+  polyscope::removeAllStructures();
+}
+
+
+TEST_F(PolyscopeTest, BackgroundBufferFill) {
+  // Fill even these small meshes in the background
+  polyscope::options::backgroundPrepareMinTriangles = 0;
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  // Moving the vertices while a fill may still be running drops it and starts over
+  polyscope::show(1);
+  psMesh->updateVertexPositions(psMesh->vertices);
+  psVol->updateVertexPositions(verts);
+  polyscope::show(1);
+
+  // Once uploaded, the meshes draw as usual
+  polyscope::internal::getBufferPreparationQueue().wait();
+  polyscope::show(2);
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->lastFrameRenderStats.uploadBytes, 0);
+  polyscope::pick::evaluatePickQuery(77, 88);
+
+  polyscope::options::backgroundPrepareMinTriangles = 1000000;
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, QueuedCommandsFromThreads) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<glm::vec3> origPositions = psMesh->vertices;
+
+  int nRun = 0;
+  int lastStep = -1;
+  int nStepsRun = 0;
+  std::vector<std::thread> producers;
+  for (int iT = 0; iT < 4; iT++) {
+    producers.emplace_back([&, iT]() {
+      for (int i = 0; i < 100; i++) {
+        polyscope::queueCommand([&]() { nRun++; });
+      }
+      if (iT == 0) {
+        for (int step = 0; step < 10; step++) {
+          polyscope::queueCommand(
+              [&lastStep, &nStepsRun, step]() {
+                lastStep = step;
+                nStepsRun++;
+              },
+              "step");
+        }
+        std::vector<glm::vec3> positions = origPositions;
+        positions[0] = glm::vec3{7., 8., 9.};
+        polyscope::queueUpdate(std::move(positions), [psMesh](std::vector<glm::vec3>& p) {
+          psMesh->updateVertexPositions(p);
+        });
+      }
+    });
+  }
+  for (std::thread& t : producers) t.join();
+  EXPECT_EQ(nRun, 0); // nothing runs until the main thread takes the queue
+
+  // Every plain command runs, and only the newest of the coalesced ones
+  polyscope::show(1);
+  EXPECT_EQ(nRun, 400);
+  EXPECT_EQ(lastStep, 9);
+  EXPECT_EQ(nStepsRun, 1);
+  EXPECT_EQ(psMesh->vertices[0], glm::vec3(7., 8., 9.));
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshColorVertex) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  std::vector<glm::vec3> vColors(verts.size(), glm::vec3{.2, .3, .4});
+  auto q1 = psVol->addVertexColorQuantity("vcolor", vColors);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshColorCell) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  std::vector<glm::vec3> cColors(cells.size(), glm::vec3{.2, .3, .4});
+  auto q1 = psVol->addCellColorQuantity("ccolor", cColors);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshScalarVertex) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  std::vector<float> vals(verts.size(), 0.44);
+  auto q1 = psVol->addVertexScalarQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshScalarCell) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  std::vector<float> vals(cells.size(), 0.44);
+  auto q1 = psVol->addCellScalarQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshVertexVector) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  std::vector<glm::vec3> vals(verts.size(), {1., 2., 3.});
+  auto q1 = psVol->addVertexVectorQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshCellVector) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  std::vector<glm::vec3> vals(cells.size(), {1., 2., 3.});
+  auto q1 = psVol->addCellVectorQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshInspect) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  // plain old inspecting
+  polyscope::SlicePlane* p = polyscope::addSceneSlicePlane();
+  p->setVolumeMeshToInspect("vol");
+  polyscope::show(3);
+
+  // with a scalar quantity
+  std::vector<float> vals(verts.size(), 0.44);
+  auto q1 = psVol->addVertexScalarQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+
+  polyscope::removeLastSceneSlicePlane();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshCellDataTextures) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+  EXPECT_TRUE(psVol->canUseCellTextures());
+
+  // Cell values are uploaded once, and the same texture is read on slice planes
+  std::vector<float> vals(cells.size(), 0.44);
+  auto q1 = psVol->addCellScalarQuantity("vals", vals);
+  q1->setEnabled(true);
+  polyscope::show(3);
+  polyscope::SlicePlane* p = polyscope::addSceneSlicePlane();
+  p->setVolumeMeshToInspect("vol");
+  polyscope::show(3);
+  std::vector<glm::vec3> colors(cells.size(), glm::vec3{0.2, 0.3, 0.4});
+  auto q2 = psVol->addCellColorQuantity("colors", colors);
+  q2->setEnabled(true);
+  polyscope::show(3);
+  q2->updateData(std::vector<glm::vec3>(cells.size(), glm::vec3{0.5, 0.5, 0.5}));
+  polyscope::show(3);
+
+  // The tets cut from each cell map back to it
+  for (size_t iC = 0; iC < psVol->nCells(); iC++) {
+    for (size_t iT = psVol->cellTetStart[iC]; iT < psVol->cellTetStart[iC + 1]; iT++) {
+      EXPECT_EQ(psVol->tetCell(iT), iC);
+    }
+  }
+
+  polyscope::removeAllStructures();
+  polyscope::removeLastSceneSlicePlane();
+}
+
+TEST_F(PolyscopeTest, VolumeMeshSliceSharedVertexData) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+  polyscope::show(3);
+  size_t bytesBefore = psVol->getGPUMemoryUsage();
+
+  // slicing uploads 4 vertex indices per tet, rather than copies of the vertex data
+  polyscope::SlicePlane* p = polyscope::addSceneSlicePlane();
+  p->setVolumeMeshToInspect("vol");
+  polyscope::show(3);
+  size_t sliceBytes = psVol->getGPUMemoryUsage() - bytesBefore;
+  EXPECT_GE(sliceBytes, 4 * sizeof(uint32_t) * psVol->nTets());
+  EXPECT_LT(sliceBytes, 8 * sizeof(glm::vec3) * psVol->nTets());
+
+  // quantities and level sets look values up the same way
+  std::vector<float> vals1(verts.size()), vals2(verts.size());
+  for (size_t iV = 0; iV < verts.size(); iV++) {
+    vals1[iV] = verts[iV].x;
+    vals2[iV] = verts[iV].y;
+  }
+  auto q1 = psVol->addVertexScalarQuantity("vals1", vals1);
+  psVol->addVertexScalarQuantity("vals2", vals2);
+  q1->setEnabled(true);
+  q1->setEnabledLevelSet(true);
+  q1->setLevelSetValue(0.5);
+  polyscope::show(3);
+  q1->setLevelSetVisibleQuantity("vals2");
+  polyscope::show(3);
+
+  std::vector<glm::vec3> colors(verts.size(), {0.2, 0.4, 0.6});
+  auto qc = psVol->addVertexColorQuantity("colors", colors);
+  qc->setEnabled(true);
+  polyscope::show(3);
+
+  // moving the vertices rebuilds the shared position texture
+  for (glm::vec3& v : verts) v *= 2.f;
+  psVol->updateVertexPositions(verts);
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+  polyscope::removeLastSceneSlicePlane();
+}
+TEST_F(PolyscopeTest, VolumeMeshSliceCapturedOncePerPose) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+  polyscope::SlicePlane* p = polyscope::addSceneSlicePlane();
+  p->setVolumeMeshToInspect("vol");
+  std::vector<float> vals(verts.size(), 0.44);
+  auto q1 = psVol->addVertexScalarQuantity("vals", vals);
+  q1->setEnabled(true);
+
+  // the slice is cut on the first frame, and drawn from the capture while only the camera moves
+  polyscope::render::engine->resetRenderStats();
+  polyscope::show(3);
+  EXPECT_EQ(polyscope::render::engine->renderStats.sliceCaptures, 1);
+  polyscope::view::lookAt(glm::vec3{1., 2., 3.}, glm::vec3{0., 0., 0.});
+  polyscope::show(3);
+  EXPECT_EQ(polyscope::render::engine->renderStats.sliceCaptures, 1);
+
+  // moving the plane cuts it again, once
+  p->setPose(glm::vec3{0.2, 0., 0.}, glm::vec3{1., 0., 0.});
+  polyscope::show(3);
+  EXPECT_EQ(polyscope::render::engine->renderStats.sliceCaptures, 2);
+
+  // so do new values
+  q1->updateData(std::vector<float>(verts.size(), 0.55));
+  polyscope::show(3);
+  EXPECT_EQ(polyscope::render::engine->renderStats.sliceCaptures, 3);
+
+  // and the base color slice has its own capture
+  q1->setEnabled(false);
+  polyscope::show(3);
+  EXPECT_EQ(polyscope::render::engine->renderStats.sliceCaptures, 4);
+
+  polyscope::removeAllStructures();
+  polyscope::removeLastSceneSlicePlane();
+}
+TEST_F(PolyscopeTest, VolumeMeshSliceSelectsCrossingTets) {
+  const int64_t n = 8;
+  auto ind = [&](int64_t i, int64_t j, int64_t k) { return (i * (n + 1) + j) * (n + 1) + k; };
+  std::vector<glm::vec3> verts;
+  for (int64_t i = 0; i <= n; i++) {
+    for (int64_t j = 0; j <= n; j++) {
+      for (int64_t k = 0; k <= n; k++) {
+        verts.push_back(glm::vec3{i, j, k} + 0.1f * glm::vec3{std::sin(i + 2 * j), std::cos(k - j), std::sin(3 * k)});
+      }
+    }
+  }
+  std::vector<std::array<int64_t, 8>> cells;
+  for (int64_t i = 0; i < n; i++) {
+    for (int64_t j = 0; j < n; j++) {
+      for (int64_t k = 0; k < n; k++) {
+        cells.push_back({ind(i, j, k), ind(i + 1, j, k), ind(i + 1, j + 1, k), ind(i, j + 1, k), ind(i, j, k + 1),
+                         ind(i + 1, j, k + 1), ind(i + 1, j + 1, k + 1), ind(i, j + 1, k + 1)});
+      }
+    }
+  }
+  auto psVol = polyscope::registerVolumeMesh("grid", verts, cells);
+  psVol->ensureHaveTets();
+  polyscope::VolumeMeshTetBVH bvh(psVol->vertices, psVol->tets);
+
+  // the selection holds every tet the plane passes through, and none which are clearly to one side
+  std::vector<std::pair<glm::vec3, float>> planes = {
+      {glm::vec3{1., 0., 0.}, 3.5}, {glm::normalize(glm::vec3{1., -2., 0.5}), -1.}, {glm::vec3{0., 0., 1.}, 20.}};
+  for (const std::pair<glm::vec3, float>& plane : planes) {
+    std::vector<uint32_t> crossing = bvh.tetsCrossingPlane(psVol->vertices, psVol->tets, plane.first, plane.second);
+    EXPECT_LT(crossing.size(), psVol->nTets() / 2);
+    std::vector<bool> selected(psVol->nTets(), false);
+    for (uint32_t iT : crossing) selected[iT] = true;
+    for (size_t iT = 0; iT < psVol->nTets(); iT++) {
+      float minDist = std::numeric_limits<float>::infinity();
+      float maxDist = -std::numeric_limits<float>::infinity();
+      for (int64_t iV : psVol->tets[iT]) {
+        float d = glm::dot(plane.first, psVol->vertices[iV]) - plane.second;
+        minDist = std::min(minDist, d);
+        maxDist = std::max(maxDist, d);
+      }
+      if (minDist < 0 && maxDist > 0) EXPECT_TRUE(selected[iT]);
+      if (minDist > 1e-3 || maxDist < -1e-3) EXPECT_FALSE(selected[iT]);
+    }
+  }
+
+  // drawing a slice uploads the selection for the plane's pose
+  polyscope::SlicePlane* p = polyscope::addSceneSlicePlane();
+  p->setVolumeMeshToInspect("grid");
+  p->setPose(glm::vec3{3.5, 3.5, 3.5}, glm::vec3{1., 1., 0.});
+  polyscope::show(3);
+  p->setPose(glm::vec3{100., 0., 0.}, glm::vec3{1., 0., 0.}); // crosses nothing
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+  polyscope::removeLastSceneSlicePlane();
+}
+TEST_F(PolyscopeTest, VolumeMeshLevelSetSelectionCache) {
+  std::vector<glm::vec3> verts;
+  std::vector<std::array<int, 8>> cells;
+  std::tie(verts, cells) = getVolumeMeshData();
+  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+  std::vector<float> vals(verts.size());
+  for (size_t iV = 0; iV < verts.size(); iV++) vals[iV] = verts[iV].x;
+  auto q = psVol->addVertexScalarQuantity("vals", vals);
+  q->setEnabled(true);
+  q->setEnabledLevelSet(true);
+
+  // each new isovalue uploads its selection, returning to a recent one does not
+  q->setLevelSetValue(0.3);
+  polyscope::show(3);
+  size_t firstBytes = q->getGPUMemoryUsage();
+  q->setLevelSetValue(0.6);
+  polyscope::show(3);
+  size_t secondBytes = q->getGPUMemoryUsage();
+  EXPECT_GT(secondBytes, firstBytes);
+  q->setLevelSetValue(0.3);
+  polyscope::show(3);
+  EXPECT_EQ(q->getGPUMemoryUsage(), secondBytes);
+
+  // with room for a single value, the buffers are reused
+  polyscope::options::levelSetSelectionCacheSize = 1;
+  q->setLevelSetValue(0.45);
+  polyscope::show(3);
+  EXPECT_LE(q->getGPUMemoryUsage(), secondBytes);
+  polyscope::options::levelSetSelectionCacheSize = 8;
+
+  polyscope::removeAllStructures();
+}
+
+// ============================================================
+// =============== Volume grid tests
+// ============================================================
+
+TEST_F(PolyscopeTest, VolumeGridScalar) {
+  // a field which is only nonzero inside of a small ball in one corner
+  glm::uvec3 dim{33, 33, 33};
+  polyscope::VolumeGrid* psGrid = polyscope::registerVolumeGrid("grid", dim, glm::vec3{-1., -1., -1.}, glm::vec3{1.});
+  std::vector<double> vals(psGrid->nNodes());
+  for (unsigned int k = 0; k < dim.z; k++) {
+    for (unsigned int j = 0; j < dim.y; j++) {
+      for (unsigned int i = 0; i < dim.x; i++) {
+        glm::vec3 p = glm::vec3{i, j, k} / 32.f;
+        vals[psGrid->flattenNodeIndex({i, j, k})] = std::max(0., 0.2 - glm::length(p - glm::vec3{0.2}));
+      }
+    }
+  }
+  auto q = psGrid->addScalarQuantity("vals", vals);
+  q->setEnabled(true);
+  polyscope::show(3);
+  size_t denseBytes = q->getGPUMemoryUsage();
+  EXPECT_GE(denseBytes, psGrid->nNodes() * sizeof(float));
+
+  // only the bricks around the ball are stored
+  q->setSparseBricks(true);
+  polyscope::show(3);
+  EXPECT_GT(q->getGPUMemoryUsage(), 0u);
+  EXPECT_LT(q->getGPUMemoryUsage(), denseBytes / 4);
+
+  // samples are culled by slice planes
+  polyscope::addSceneSlicePlane();
+  polyscope::show(3);
+  q->setSparseBricks(false);
+  polyscope::show(3);
+  polyscope::removeLastSceneSlicePlane();
+
+  q->setOpacity(0.1);
+  psGrid->setStepsPerCell(4.);
+  q->setColorMap("blues");
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+// ============================================================
+// =============== Ground plane tests
+// ============================================================
+
+TEST_F(PolyscopeTest, GroundPlaneTest) {
+
+  // Add a structure and cycle through the ground plane options
+  auto psMesh = registerTriangleMesh();
+
+  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::None;
+  polyscope::refresh();
+  polyscope::show(3);
+
+  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::Tile;
+  polyscope::refresh();
+  polyscope::show(3);
+
+  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::TileReflection;
+  polyscope::refresh();
+  polyscope::show(3);
+
+  // likewise for the mirrored scene
+  polyscope::options::temporalAntiAliasingFrames = 4;
+  polyscope::show(2);
+  size_t reflectionRenders = polyscope::render::engine->groundPlane.reflectionRenderCount;
+  polyscope::show(4);
+  EXPECT_EQ(polyscope::render::engine->groundPlane.reflectionRenderCount, reflectionRenders);
+  polyscope::view::resetCameraToHomeView();
+  polyscope::show(1);
+  EXPECT_GT(polyscope::render::engine->groundPlane.reflectionRenderCount, reflectionRenders);
+  polyscope::options::temporalAntiAliasingFrames = 1;
+
+  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::ShadowOnly;
+  polyscope::refresh();
+  polyscope::show(3);
+
+  // the shadow is reused by renders which follow no redraw request, like those of temporal anti-aliasing
+  polyscope::options::temporalAntiAliasingFrames = 4;
+  polyscope::show(2);
+  size_t shadowRenders = polyscope::render::engine->groundPlane.shadowRenderCount;
+  polyscope::show(4);
+  EXPECT_EQ(polyscope::render::engine->temporalSamples, 4);
+  EXPECT_EQ(polyscope::render::engine->groundPlane.shadowRenderCount, shadowRenders);
+  polyscope::options::temporalAntiAliasingFrames = 1;
+
+  polyscope::removeAllStructures();
+}
+
+
+// ============================================================
+// =============== Combo test
+// ============================================================
+
+// Register a handful of quantities / structures, then call refresh
+TEST_F(PolyscopeTest, RefreshMultiTest) {
+
+  { // Surface mesh
+    auto psMesh = registerTriangleMesh();
+    std::vector<double> vScalar(psMesh->nVertices(), 7.);
+    auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
+  }
+
+  { // Point cloud
+    auto psPoints = registerPointCloud();
+    std::vector<double> vScalar(psPoints->nPoints(), 7.);
+    auto q2 = psPoints->addScalarQuantity("vScalar", vScalar);
+    q2->setEnabled(true);
+  }
+
+  { // Curve network
+    auto psCurve = registerCurveNetwork();
+    std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
+    auto q3 = psCurve->addEdgeVectorQuantity("vals", vals);
+    q3->setEnabled(true);
+  }
+
+  polyscope::show(3);
+
+  polyscope::refresh();
+  polyscope::show(3);
+
+  polyscope::removeAllStructures();
+}
+
+// Cycle through the transparency optins
+TEST_F(PolyscopeTest, TransparencyTest) {
+
+  { // Surface mesh
+    auto psMesh = registerTriangleMesh();
+    std::vector<double> vScalar(psMesh->nVertices(), 7.);
+    auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
+  }
+
+  { // Point cloud
+    auto psPoints = registerPointCloud();
+    std::vector<double> vScalar(psPoints->nPoints(), 7.);
+    auto q2 = psPoints->addScalarQuantity("vScalar", vScalar);
+    q2->setEnabled(true);
+  }
+
+  { // Curve network
+    auto psCurve = registerCurveNetwork();
+    std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
+    auto q3 = psCurve->addEdgeVectorQuantity("vals", vals);
+    q3->setEnabled(true);
+  }
+
+  polyscope::show(3);
+
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::Simple;
+  polyscope::show(3);
+
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::WeightedBlended;
+  polyscope::show(3);
+
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::Pretty;
+  polyscope::show(3);
+  EXPECT_GE(polyscope::render::engine->transparencyPassesUsed, 1);
+  EXPECT_LE(polyscope::render::engine->transparencyPassesUsed, polyscope::options::transparencyRenderPasses);
+  // the passes were tested, and the tests read back without holding up a frame
+  EXPECT_FALSE(polyscope::render::engine->transparencyPassQueries.empty());
+  EXPECT_EQ(polyscope::render::engine->transparencyPassesTested, 0);
+
+  polyscope::options::transparencyAdaptivePasses = false;
   polyscope::show(3);
+  EXPECT_EQ(polyscope::render::engine->transparencyPassesUsed, polyscope::options::transparencyRenderPasses);
+  polyscope::options::transparencyAdaptivePasses = true;
+
   polyscope::removeAllStructures();
 }
 
+TEST_F(PolyscopeTest, ImpostorDepthPrepass) {
+  polyscope::options::impostorDepthPrepass = true;
+  registerPointCloud("prepass cloud");
+  registerCurveNetwork("prepass network");
+  registerTriangleMesh("prepass mesh");
+  polyscope::show(3);
 
-TEST_F(PolyscopeTest, SurfaceMeshVertexCount) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<std::pair<size_t, int>> vals = {{0, 1}, {2, -2}};
-  auto q1 = psMesh->addVertexCountQuantity("vals", vals);
-  q1->setEnabled(true);
+  // Quads are not impostors, and sit out the prepass
+  polyscope::getPointCloud("prepass cloud")->setPointRenderMode(polyscope::PointRenderMode::Quad);
+  polyscope::show(3);
+
+  // With transparency, the prepass is skipped
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::Pretty;
+  polyscope::show(3);
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None;
+
+  polyscope::options::impostorDepthPrepass = false;
   polyscope::show(3);
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshFaceCount) {
-  auto psMesh = registerTriangleMesh();
-  std::vector<std::pair<size_t, int>> vals = {{0, 1}, {2, -2}};
-  auto q1 = psMesh->addFaceCountQuantity("vals", vals);
-  q1->setEnabled(true);
+TEST_F(PolyscopeTest, ImGuiFontsPreparedForFirstFrame) {
+  polyscope::show(1);
+  EXPECT_NE(polyscope::render::engine->getImGuiGlobalFontAtlas(), nullptr);
+}
+
+TEST_F(PolyscopeTest, PresentMode) {
+  registerPointCloud();
+  for (polyscope::PresentMode mode : {polyscope::PresentMode::LowLatency, polyscope::PresentMode::Immediate,
+                                      polyscope::PresentMode::AdaptiveVSync, polyscope::PresentMode::VSync}) {
+    polyscope::options::presentMode = mode;
+    polyscope::show(3);
+  }
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CompactSceneBuffers) {
+  using polyscope::TextureFormat;
+  registerPointCloud();
   polyscope::show(3);
+  EXPECT_EQ(polyscope::render::engine->sceneColor->getFormat(), TextureFormat::SRGB8_ALPHA8);
+
+  // Simple transparency accumulates beyond 1, and needs float buffers
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::Simple;
+  polyscope::show(3);
+  EXPECT_EQ(polyscope::render::engine->sceneColor->getFormat(), TextureFormat::RGBA16F);
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None;
+
+  polyscope::options::compactSceneBuffers = false;
+  polyscope::show(3);
+  EXPECT_EQ(polyscope::render::engine->sceneColorFinal->getFormat(), TextureFormat::RGBA16F);
+  polyscope::options::compactSceneBuffers = true;
+
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshVertexIsolated) {
+TEST_F(PolyscopeTest, DebouncedScreenBufferResize) {
+  registerPointCloud();
+
+  // While the size is changing, frames draw with the old scene buffers
+  polyscope::render::engine->scheduleScreenBufferResize(false);
+  EXPECT_TRUE(polyscope::render::engine->screenBufferResizePending());
+  polyscope::show(3);
+
+  // A screenshot resizes them first
+  std::vector<unsigned char> buff = polyscope::renderToBuffer();
+  EXPECT_FALSE(polyscope::render::engine->screenBufferResizePending());
+  EXPECT_EQ(buff.size(), 4 * static_cast<size_t>(polyscope::view::bufferWidth) * polyscope::view::bufferHeight);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, DeferredShading) {
+  polyscope::options::deferredShading = true;
+  registerPointCloud("deferred cloud");
+  registerCurveNetwork("deferred network");
+  polyscope::SurfaceMesh* mesh = registerTriangleMesh("deferred mesh");
+  polyscope::show(3);
+
+  // Each material in use is lit in its own pass
+  mesh->setMaterial("wax");
+  polyscope::show(3);
+
+  // With transparency, structures are lit as they are drawn
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::Simple;
+  polyscope::show(3);
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None;
+
+  polyscope::options::deferredShading = false;
+  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, DepthPeelOpaqueDrawnOnce) {
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::Pretty;
+  polyscope::options::transparencyAdaptivePasses = false;
+  polyscope::PointCloud* shell = polyscope::registerPointCloud("peel shell", getPoints());
+  polyscope::PointCloud* interior = polyscope::registerPointCloud("peel interior", getPoints());
+  shell->setTransparency(0.5);
+
+  // With both transparent, each is drawn in every pass
+  interior->setTransparency(0.5);
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  size_t drawsAllTransparent = polyscope::render::engine->lastFrameRenderStats.drawCalls;
+
+  // An opaque one is drawn once, ahead of the passes
+  interior->setTransparency(1.);
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  size_t drawsOneOpaque = polyscope::render::engine->lastFrameRenderStats.drawCalls;
+  EXPECT_LT(drawsOneOpaque, drawsAllTransparent);
+  EXPECT_EQ(polyscope::render::engine->transparencyPassesUsed, polyscope::options::transparencyRenderPasses);
+
+  polyscope::options::transparencyAdaptivePasses = true;
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None;
+  polyscope::removeAllStructures();
+}
+
+// Do some slice plane stuff
+TEST_F(PolyscopeTest, SlicePlaneTest) {
+
+  // Surface mesh
   auto psMesh = registerTriangleMesh();
-  std::vector<std::pair<size_t, double>> vals = {{0, 1.1}, {2, -2.3}};
-  auto q1 = psMesh->addVertexIsolatedScalarQuantity("vals", vals);
-  q1->setEnabled(true);
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
+
+  // Point cloud
+  auto psPoints = registerPointCloud();
+  psPoints->setPointRenderMode(polyscope::PointRenderMode::Sphere);
+  psPoints->setCullWholeElements(true);
+  std::vector<double> vScalarP(psPoints->nPoints(), 7.);
+  auto q2 = psPoints->addScalarQuantity("vScalar", vScalarP);
+  q2->setEnabled(true);
+
+
+  { // Curve network
+    auto psCurve = registerCurveNetwork();
+    std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
+    auto q3 = psCurve->addEdgeVectorQuantity("vals", vals);
+    q3->setEnabled(true);
+  }
+
+  { // Volume mesh
+    std::vector<glm::vec3> verts;
+    std::vector<std::array<int, 8>> cells;
+    std::tie(verts, cells) = getVolumeMeshData();
+    polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+
+    polyscope::VolumeMesh* psVol2 = polyscope::registerVolumeMesh("vol cull whole", verts, cells);
+    psVol2->setCullWholeElements(true);
+  }
+
+  polyscope::show(3);
+
+  // render with one slice plane
+  polyscope::addSceneSlicePlane();
+  polyscope::show(3);
+
+  // try a few variations of point cloud settings
+  psPoints->setCullWholeElements(false);
+  polyscope::show(3);
+  psPoints->setCullWholeElements(true);
+  psPoints->setPointRenderMode(polyscope::PointRenderMode::Quad);
+  polyscope::show(3);
+  psPoints->setCullWholeElements(false);
+  polyscope::show(3);
+  
+  polyscope::show(3);
+
+  // add another and rotate it
+  polyscope::SlicePlane* p = polyscope::addSceneSlicePlane();
+  p->setTransform(glm::translate(p->getTransform(), glm::vec3{-1., 0., 0.}));
+  polyscope::show(3);
+
+  // test removal
+  polyscope::removeLastSceneSlicePlane();
+  polyscope::show(3);
+
+  // make one structure ignore the plane
+  psMesh->setIgnoreSlicePlane(polyscope::state::slicePlanes[0]->name, true);
+  polyscope::show(3);
+
+  // remove the last plane so we don't leave it around for future tests
+  polyscope::removeLastSceneSlicePlane();
+
+  // planes are passed as a fixed-size uniform array
+  for (int i = 0; i < polyscope::render::MAX_SLICE_PLANES; i++) {
+    polyscope::addSceneSlicePlane();
+  }
   polyscope::show(3);
+  // one more is an error
+  polyscope::options::errorsThrowExceptions = true;
+  EXPECT_THROW(polyscope::addSceneSlicePlane(), std::logic_error);
+  polyscope::options::errorsThrowExceptions = false;
+  EXPECT_EQ(polyscope::state::slicePlanes.size(), static_cast<size_t>(polyscope::render::MAX_SLICE_PLANES));
+  for (int i = 0; i < polyscope::render::MAX_SLICE_PLANES; i++) {
+    polyscope::removeLastSceneSlicePlane();
+  }
+
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshSurfaceGraph) {
+// Register a handful of quantities / structures, then call refresh
+TEST_F(PolyscopeTest, OrthoViewTest) {
+
+  // Add some stuff
+
+  { // Surface mesh
+    auto psMesh = registerTriangleMesh();
+    std::vector<double> vScalar(psMesh->nVertices(), 7.);
+    auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
+  }
+
+  { // Point cloud
+    auto psPoints = registerPointCloud();
+    std::vector<double> vScalar(psPoints->nPoints(), 7.);
+    auto q2 = psPoints->addScalarQuantity("vScalar", vScalar);
+    q2->setEnabled(true);
+  }
+
+  { // Curve network
+    auto psCurve = registerCurveNetwork();
+    std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
+    auto q3 = psCurve->addEdgeVectorQuantity("vals", vals);
+    q3->setEnabled(true);
+  }
+
+  // Enable the orthographic view
+  polyscope::view::projectionMode = polyscope::ProjectionMode::Orthographic;
+  polyscope::show(3);
+
+  // Go back to default perspective
+  polyscope::view::projectionMode = polyscope::ProjectionMode::Perspective;
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, QuantityGPUResidency) {
   auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> nodes = {
-      {1., 2., 3.},
-      {3., 4., 5.},
-      {5., 6., 7.},
-  };
-  std::vector<std::array<size_t, 2>> edges = {{0, 1}, {1, 2}, {2, 0}};
-  auto q1 = psMesh->addSurfaceGraphQuantity("vals", nodes, edges);
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  auto q1 = psMesh->addVertexScalarQuantity("vScalar", vScalar);
   q1->setEnabled(true);
-  polyscope::show(3);
+  polyscope::show(1);
+  size_t residentBytes = q1->getGPUMemoryUsage();
+  EXPECT_GT(residentBytes, 0u);
+  EXPECT_GE(psMesh->getGPUMemoryUsage(), residentBytes);
+
+  // Disabled quantities are released as soon as the scene is over budget
+  q1->setEnabled(false);
+  polyscope::options::gpuMemoryBudget = 0;
+  polyscope::show(1);
+  EXPECT_EQ(q1->getGPUMemoryUsage(), 0u);
+
+  // ...and rebuilt when they are needed again
+  polyscope::options::gpuMemoryBudget = -1;
+  q1->setEnabled(true);
+  polyscope::show(1);
+  EXPECT_EQ(q1->getGPUMemoryUsage(), residentBytes);
+
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, SurfaceMeshSurfaceGraphPath) {
+TEST_F(PolyscopeTest, StructureMemoryUsage) {
   auto psMesh = registerTriangleMesh();
-  std::vector<glm::vec3> nodes = {
-      {1., 2., 3.},
-      {3., 4., 5.},
-      {5., 6., 7.},
-  };
-  auto q1 = psMesh->addSurfaceGraphQuantity("vals", std::vector<std::vector<glm::vec3>>({nodes, nodes}));
+  polyscope::MemoryUsage meshOnly = psMesh->memoryUsage();
+  EXPECT_GE(meshOnly.hostBytes, psMesh->nVertices() * sizeof(glm::vec3));
+
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  auto q1 = psMesh->addVertexScalarQuantity("vScalar", vScalar);
   q1->setEnabled(true);
+  EXPECT_GE(q1->memoryUsage().hostBytes, psMesh->nVertices() * sizeof(float));
+  EXPECT_EQ(psMesh->memoryUsage().hostBytes, meshOnly.hostBytes + q1->memoryUsage().hostBytes);
+
+  polyscope::show(1);
+  EXPECT_GT(q1->memoryUsage().deviceBytes, 0u);
+  EXPECT_GT(psMesh->memoryUsage().deviceBytes, q1->memoryUsage().deviceBytes);
+  EXPECT_GE(polyscope::render::engine->gpuMemoryUsage, psMesh->memoryUsage().deviceBytes);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, CPUFrameStats) {
+  auto psMesh = registerTriangleMesh();
+  polyscope::options::enableCPUProfiling = true;
+  polyscope::resetFrameStats();
   polyscope::show(3);
+
+  polyscope::FrameStats stats = polyscope::getFrameStats();
+  EXPECT_GT(stats.frame.nFrames, 0u);
+  EXPECT_LE(stats.frame.p50Ms, stats.frame.p99Ms);
+  bool foundRenderScene = false;
+  for (const polyscope::TimingStats& s : stats.regions) {
+    if (s.name == "renderScene") foundRenderScene = true;
+  }
+  EXPECT_TRUE(foundRenderScene);
+
+  polyscope::options::enableCPUProfiling = false;
+  polyscope::resetFrameStats();
   polyscope::removeAllStructures();
 }
 
+TEST_F(PolyscopeTest, StartupStats) {
+  polyscope::show(1); // (startup ends with the first frame, which an earlier test may have drawn already)
+
+  polyscope::StartupStats stats = polyscope::getStartupStats();
+  EXPECT_TRUE(stats.complete);
+  double sum = 0.;
+  std::set<std::string> names;
+  for (const polyscope::StartupPhase& p : stats.phases) {
+    EXPECT_GE(p.ms, 0.);
+    sum += p.ms;
+    names.insert(p.name);
+  }
+  EXPECT_LE(sum, stats.totalMs * 1.001 + 1e-6); // (the phases exclude nested ones, so do not overlap)
+  for (std::string name : {"init", "window and context", "populateDefaultShadersAndRules",
+                           "allocateGlobalBuffersAndPrograms", "initializeImGui", "first frame"}) {
+    EXPECT_EQ(names.count(name), 1u) << name;
+  }
 
-// ============================================================
-// =============== Curve network tests
-// ============================================================
+  // Later frames leave it as it is
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::getStartupStats().phases.size(), stats.phases.size());
+}
 
-std::tuple<std::vector<glm::vec3>, std::vector<std::array<size_t, 2>>> getCurveNetwork() {
-  std::vector<glm::vec3> points;
-  std::vector<std::array<size_t, 2>> edges;
+TEST_F(PolyscopeTest, StaticLayer) {
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None; // the layer is only used when opaque
+  auto psMesh = registerTriangleMesh();
+  auto psPoints = registerPointCloud();
+  psMesh->setStaticHint(true);
+  EXPECT_TRUE(psMesh->getStaticHint());
+  EXPECT_FALSE(psPoints->getStaticHint());
 
-  // clang-format off
-  points = {
-    {1, 0, 0},
-    {0, 1, 0},
-    {0, 0, 1},
-    {0, 0, 0},
-  };
+  polyscope::show(3);
+  EXPECT_TRUE(polyscope::render::engine->staticLayerValid);
 
-  edges = {
-    {1, 3},
-    {3, 0},
-    {1, 0},
-    {0, 2}
-   };
-  // clang-format on
+  // changes to the static structure re-render the layer, changes to others do not
+  psPoints->setPointRadius(0.02);
+  EXPECT_TRUE(polyscope::render::engine->staticLayerValid);
+  psMesh->setSurfaceColor(glm::vec3{0.2, 0.3, 0.4});
+  EXPECT_FALSE(polyscope::render::engine->staticLayerValid);
+  polyscope::show(3);
+  EXPECT_TRUE(polyscope::render::engine->staticLayerValid);
 
-  return std::tuple<std::vector<glm::vec3>, std::vector<std::array<size_t, 2>>>{points, edges};
-};
+  psMesh->setStaticHint(false);
+  polyscope::show(3);
 
-polyscope::CurveNetwork* registerCurveNetwork(std::string name = "test1") {
-  std::vector<glm::vec3> points;
-  std::vector<std::array<size_t, 2>> edges;
-  std::tie(points, edges) = getCurveNetwork();
-  return polyscope::registerCurveNetwork(name, points, edges);
+  polyscope::removeAllStructures();
 }
 
+TEST_F(PolyscopeTest, PersistentValueCache) {
+  // values with the same name share the cached value, a value is only taken from the cache if it was set
+  {
+    polyscope::PersistentValue<std::string> a("test persistent string", "default");
+    EXPECT_EQ(a.get(), "default");
+    a = std::string("changed");
+  }
+  polyscope::PersistentValue<std::string> b("test persistent string", "other default");
+  EXPECT_EQ(b.get(), "changed");
+  b.setPassive("passive"); // taken from the cache, so not a default value
+  EXPECT_EQ(b.get(), "changed");
+
+  // clearing forgets the values, but live values store theirs again when set
+  polyscope::detail::getPersistentCacheRef<std::string>().clear();
+  polyscope::PersistentValue<std::string> c("test persistent string", "fresh");
+  EXPECT_EQ(c.get(), "fresh");
+  b.set("changed");
+  polyscope::PersistentValue<std::string> d("test persistent string", "fresh");
+  EXPECT_EQ(d.get(), "changed");
+}
 
-TEST_F(PolyscopeTest, ShowCurveNetwork) {
-  auto psCurve = registerCurveNetwork();
+TEST_F(PolyscopeTest, OptionChangeTracking) {
+  // assigning a new value to an option counts as a change, re-assigning the same value does not
+  size_t changeCount = polyscope::options::changeCount;
+  polyscope::options::shadowBlurIters = polyscope::options::shadowBlurIters.get();
+  EXPECT_EQ(polyscope::options::changeCount, changeCount);
+  polyscope::options::ssaaFactor = 2;
+  EXPECT_GT(polyscope::options::changeCount, changeCount);
+
+  // the engine picks up the change on the next frame
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->getSSAAFactor(), 2);
+  polyscope::options::ssaaFactor = 1;
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->getSSAAFactor(), 1);
+}
+
+TEST_F(PolyscopeTest, AntiAliasingModes) {
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None; // MSAA only applies when opaque
+  auto psMesh = registerTriangleMesh();
+  psMesh->setStaticHint(true);
+
+  polyscope::options::msaaSamples = 4;
+  polyscope::show(3);
+  EXPECT_TRUE(polyscope::render::engine->multisampleActive());
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::Simple;
+  polyscope::show(3);
+  EXPECT_FALSE(polyscope::render::engine->multisampleActive());
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None;
+  polyscope::options::msaaSamples = 1;
 
-  // Make sure we actually added the mesh
+  polyscope::options::enableFXAA = true;
   polyscope::show(3);
-  EXPECT_TRUE(polyscope::hasCurveNetwork("test1"));
-  EXPECT_FALSE(polyscope::hasCurveNetwork("test2"));
+  polyscope::options::enableFXAA = false;
+
+  // jittered frames are rendered while the scene is still, until there are enough
+  polyscope::options::temporalAntiAliasingFrames = 4;
+  polyscope::show(8);
+  EXPECT_EQ(polyscope::render::engine->temporalSamples, 4);
+  EXPECT_FALSE(polyscope::render::engine->temporalAccumulationPending());
+  EXPECT_EQ(polyscope::view::projectionJitter, glm::vec2(0., 0.));
+  psMesh->setSurfaceColor(glm::vec3{0.2, 0.3, 0.4});
+  polyscope::show(1);
+  EXPECT_LT(polyscope::render::engine->temporalSamples, 4);
+  polyscope::options::temporalAntiAliasingFrames = 1;
+
   polyscope::removeAllStructures();
-  EXPECT_FALSE(polyscope::hasCurveNetwork("test1"));
 }
 
-TEST_F(PolyscopeTest, CurveNetworkAppearance) {
-  auto psCurve = registerCurveNetwork();
+TEST_F(PolyscopeTest, ProgressiveRendering) {
+  auto psMesh = registerTriangleMesh();
+  polyscope::options::ssaaFactor = 2;
+  polyscope::options::progressiveRendering = true;
+  polyscope::options::progressiveRenderingDelay = 1e6;
 
-  // Material
-  psCurve->setMaterial("wax");
-  EXPECT_EQ(psCurve->getMaterial(), "wax");
+  // changes are drawn cheaply...
+  psMesh->setSurfaceColor(glm::vec3{0.2, 0.3, 0.4});
   polyscope::show(3);
+  EXPECT_TRUE(polyscope::render::engine->interactiveQuality);
+  EXPECT_EQ(polyscope::render::engine->getSSAAFactor(), 1);
 
+  // ...and redrawn with the full settings once the scene has been still long enough
+  polyscope::options::progressiveRenderingDelay = 0.;
+  size_t renderCount = polyscope::state::sceneRenderCount;
+  polyscope::show(3);
+  EXPECT_FALSE(polyscope::render::engine->interactiveQuality);
+  EXPECT_EQ(polyscope::render::engine->getSSAAFactor(), 2);
+  EXPECT_GT(polyscope::state::sceneRenderCount, renderCount);
+
+  polyscope::options::progressiveRendering = false;
+  polyscope::options::progressiveRenderingDelay = 0.25;
+  polyscope::options::ssaaFactor = 1;
+  polyscope::show(1);
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, CurveNetworkPick) {
-  auto psCurve = registerCurveNetwork();
-
-  // Don't bother trying to actually click on anything, but make sure this doesn't crash
-  polyscope::pick::evaluatePickQuery(77, 88);
+TEST_F(PolyscopeTest, FrustumCulling) {
+  auto psMesh = registerTriangleMesh();
+  polyscope::view::resetCameraToHomeView();
+  polyscope::show(1);
+  EXPECT_TRUE(psMesh->isInViewFrustum());
+
+  // far behind the camera
+  glm::vec3 lookDir, upDir, rightDir;
+  polyscope::view::getCameraFrame(lookDir, upDir, rightDir);
+  psMesh->setPosition(polyscope::view::getCameraWorldPosition() - 1000.f * psMesh->lengthScale() * lookDir);
+  EXPECT_FALSE(psMesh->isInViewFrustum());
+  polyscope::show(1);
+  EXPECT_GT(polyscope::render::engine->lastFrameRenderStats.structuresCulled, 0u);
+
+  polyscope::options::enableFrustumCulling = false;
+  EXPECT_TRUE(psMesh->isInViewFrustum());
+  polyscope::options::enableFrustumCulling = true;
 
   polyscope::removeAllStructures();
 }
 
+TEST_F(PolyscopeTest, PointCloudLOD) {
+  std::vector<glm::vec3> points;
+  for (int i = 0; i < 40; i++) {
+    for (int j = 0; j < 40; j++) {
+      for (int k = 0; k < 40; k++) {
+        points.push_back(glm::vec3{i, j, k});
+      }
+    }
+  }
+  polyscope::PointCloud* psPoints = polyscope::registerPointCloud("lod points", points);
+  std::vector<double> vScalar(points.size(), 7.);
+  std::vector<glm::vec3> vVec(points.size(), glm::vec3{0.1, 0.2, 0.3});
+  psPoints->addScalarQuantity("vScalar", vScalar)->setEnabled(true);
+  psPoints->addVectorQuantity("vVec", vVec)->setEnabled(true);
+
+  psPoints->setLODEnabled(true);
+  psPoints->setLODPointBudget(20000);
+  polyscope::view::resetCameraToHomeView();
+  polyscope::show(3);
+  EXPECT_TRUE(psPoints->drawsLODSubset());
+  EXPECT_GT(psPoints->nDrawnPoints(), 20000u / 4); // refined past the budget used while moving
+  EXPECT_LE(psPoints->nDrawnPoints(), 20000u);
 
-TEST_F(PolyscopeTest, CurveNetworkColorNode) {
-  auto psCurve = registerCurveNetwork();
-  std::vector<glm::vec3> vColors(psCurve->nNodes(), glm::vec3{.2, .3, .4});
-  auto q1 = psCurve->addNodeColorQuantity("vcolor", vColors);
-  q1->setEnabled(true);
+  // picking the subset identifies its points by their index in the full cloud
+  polyscope::pick::evaluatePickQuery(-1, -1);
+
+  // moving the points rebuilds the octree
+  psPoints->updatePointPositions(points);
   polyscope::show(3);
-  polyscope::removeAllStructures();
-}
+  EXPECT_LE(psPoints->nDrawnPoints(), 20000u);
 
-TEST_F(PolyscopeTest, CurveNetworkColorFace) {
-  auto psCurve = registerCurveNetwork();
-  std::vector<glm::vec3> eColors(psCurve->nEdges(), glm::vec3{.2, .3, .4});
-  auto q2 = psCurve->addEdgeColorQuantity("eColor", eColors);
-  q2->setEnabled(true);
+  psPoints->setLODEnabled(false);
   polyscope::show(3);
+  EXPECT_EQ(psPoints->nDrawnPoints(), points.size());
+
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, CurveNetworkScalarNode) {
-  auto psCurve = registerCurveNetwork();
-  std::vector<double> vScalar(psCurve->nNodes(), 7.);
-  auto q1 = psCurve->addNodeScalarQuantity("vScalar", vScalar);
-  q1->setEnabled(true);
+TEST_F(PolyscopeTest, SurfaceMeshLOD) {
+  const size_t N = 150;
+  std::vector<glm::vec3> vertices;
+  std::vector<std::vector<size_t>> faces;
+  for (size_t i = 0; i < N; i++) {
+    for (size_t j = 0; j < N; j++) {
+      vertices.push_back(glm::vec3{i / (N - 1.), j / (N - 1.), 0.});
+      if (i + 1 < N && j + 1 < N) {
+        faces.push_back({i * N + j, (i + 1) * N + j, (i + 1) * N + j + 1});
+        faces.push_back({i * N + j, (i + 1) * N + j + 1, i * N + j + 1});
+      }
+    }
+  }
+  polyscope::SurfaceMesh* psMesh = polyscope::registerSurfaceMesh("lod mesh", vertices, faces);
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  std::vector<double> heScalar(psMesh->nHalfedges(), 3.);
+  std::vector<glm::vec3> fColor(psMesh->nFaces(), glm::vec3{0.1, 0.2, 0.3});
+  std::vector<glm::vec2> cParam(psMesh->nCorners(), glm::vec2{0.1, 0.2});
+  psMesh->addVertexScalarQuantity("vScalar", vScalar)->setEnabled(true);
+  psMesh->addHalfedgeScalarQuantity("heScalar", heScalar)->setEnabled(true);
+  psMesh->addFaceColorQuantity("fColor", fColor)->setEnabled(true);
+  psMesh->addParameterizationQuantity("cParam", cParam)->setEnabled(true);
+
+  psMesh->setLODEnabled(true);
+  psMesh->setLODMaxPixelError(1e6);
+  polyscope::view::resetCameraToHomeView();
   polyscope::show(3);
-  polyscope::removeAllStructures();
-}
+  EXPECT_GT(psMesh->nDrawnFaces(), 0u);
+  EXPECT_LT(psMesh->nDrawnFaces(), psMesh->nFaces() / 4);
+  polyscope::pick::evaluatePickQuery(-1, -1); // (picks the full mesh, with buffers of its own)
 
-TEST_F(PolyscopeTest, CurveNetworkScalarEdge) {
-  auto psCurve = registerCurveNetwork();
-  std::vector<double> eScalar(psCurve->nEdges(), 9.);
-  auto q3 = psCurve->addEdgeScalarQuantity("eScalar", eScalar);
-  q3->setEnabled(true);
+  // the full mesh when no error is allowed
+  psMesh->setLODMaxPixelError(0.);
   polyscope::show(3);
-  polyscope::removeAllStructures();
-}
+  EXPECT_EQ(psMesh->nDrawnFaces(), psMesh->nFaces());
 
-TEST_F(PolyscopeTest, CurveNetworkVertexVector) {
-  auto psCurve = registerCurveNetwork();
-  std::vector<glm::vec3> vals(psCurve->nNodes(), {1., 2., 3.});
-  auto q1 = psCurve->addNodeVectorQuantity("vals", vals);
-  q1->setEnabled(true);
+  // moving vertices rebuilds the cascade
+  psMesh->setLODMaxPixelError(1e6);
   polyscope::show(3);
-  polyscope::removeAllStructures();
-}
+  psMesh->updateVertexPositions(std::vector<size_t>{0}, std::vector<glm::vec3>{glm::vec3{0., 0., 0.1}});
+  polyscope::show(3);
+  EXPECT_LT(psMesh->nDrawnFaces(), psMesh->nFaces() / 4);
 
-TEST_F(PolyscopeTest, CurveNetworkFaceVector) {
-  auto psCurve = registerCurveNetwork();
-  std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
-  auto q1 = psCurve->addEdgeVectorQuantity("vals", vals);
-  q1->setEnabled(true);
+  psMesh->setLODEnabled(false);
   polyscope::show(3);
+  EXPECT_EQ(psMesh->nDrawnFaces(), psMesh->nFaces());
+
   polyscope::removeAllStructures();
 }
 
-// ============================================================
-// =============== Volume mesh tests
-// ============================================================
+TEST_F(PolyscopeTest, CurveNetworkLOD) {
+  // A wiggly line, a closed loop, and a branch off of the line
+  std::vector<glm::vec3> nodes;
+  std::vector<std::array<size_t, 2>> edges;
+  const size_t N = 2000;
+  for (size_t i = 0; i < N; i++) {
+    nodes.push_back(glm::vec3{i / (N - 1.), 0.01 * std::sin(0.3 * i), 0.});
+    if (i > 0) edges.push_back({i - 1, i});
+  }
+  for (size_t i = 0; i < N; i++) {
+    double t = 2. * glm::pi<double>() * i / N;
+    nodes.push_back(glm::vec3{0.5 + 0.2 * std::cos(t), 0.5 + 0.2 * std::sin(t), 0.});
+    edges.push_back({N + i, N + (i + 1) % N});
+  }
+  nodes.push_back(glm::vec3{0.5, -0.5, 0.});
+  edges.push_back({N / 2, nodes.size() - 1});
+
+  polyscope::CurveNetwork* psCurve = polyscope::registerCurveNetwork("lod curve", nodes, edges);
+  std::vector<double> nScalar(psCurve->nNodes(), 7.);
+  std::vector<glm::vec3> eColor(psCurve->nEdges(), glm::vec3{0.1, 0.2, 0.3});
+  psCurve->addNodeScalarQuantity("nScalar", nScalar);
+  psCurve->addEdgeColorQuantity("eColor", eColor);
+
+  psCurve->setLODEnabled(true);
+  psCurve->setLODMaxPixelError(1e3);
+  polyscope::view::resetCameraToHomeView();
+  polyscope::show(3);
+  EXPECT_GT(psCurve->nDrawnEdges(), 0u);
+  EXPECT_LT(psCurve->nDrawnEdges(), psCurve->nEdges() / 10);
+  EXPECT_EQ(psCurve->nDrawnEdges(), psCurve->drawnEdgeIndices()->size());
+  polyscope::pick::evaluatePickQuery(-1, -1); // (picks the full network)
 
-std::tuple<std::vector<glm::vec3>, std::vector<std::array<int, 8>>> getVolumeMeshData() {
-  // clang-format off
-  std::vector<glm::vec3> combined_verts = {
-    {0, 0, 0},
-    {1, 0, 0},
-    {1, 1, 0},
-    {0, 1, 0},
-    {0, 0, 1},
-    {1, 0, 1},
-    {1, 1, 1},
-    {0, 1, 1},
-    {1, 1, 1.5}
-  };
+  // quantities and the other render modes are drawn on the simplification
+  psCurve->getQuantity("nScalar")->setEnabled(true);
+  polyscope::show(3);
+  psCurve->getQuantity("eColor")->setEnabled(true);
+  polyscope::show(3);
+  psCurve->getQuantity("eColor")->setEnabled(false);
+  psCurve->setCurveRenderMode(polyscope::CurveRenderMode::Lines);
+  polyscope::show(3);
+  psCurve->setCurveRenderMode(polyscope::CurveRenderMode::Cylinders);
 
-  std::vector<std::array<int, 8>> combined_cells = {
-    {0, 1, 2, 3, 4, 5, 6, 7},
-    {7, 5, 6, 8, -1, -1, -1, -1},
-  };
-  // clang-format on
+  // the full network when no error is allowed
+  psCurve->setLODMaxPixelError(0.);
+  polyscope::show(3);
+  EXPECT_EQ(psCurve->nDrawnEdges(), psCurve->nEdges());
+  EXPECT_EQ(psCurve->drawnEdgeIndices(), nullptr);
 
-  return std::make_tuple(combined_verts, combined_cells);
-};
+  // moving nodes recomputes the errors
+  psCurve->setLODMaxPixelError(1e3);
+  polyscope::show(3);
+  psCurve->updateNodePositions(std::vector<size_t>{5}, std::vector<glm::vec3>{glm::vec3{0., 0.2, 0.}});
+  polyscope::show(3);
+  EXPECT_LT(psCurve->nDrawnEdges(), psCurve->nEdges() / 10);
 
-TEST_F(PolyscopeTest, ShowVolumeMesh) {
-  // clang-format off
+  psCurve->setLODEnabled(false);
+  polyscope::show(3);
+  EXPECT_EQ(psCurve->nDrawnNodes(), psCurve->nNodes());
 
-  // Tets only
-  std::vector<glm::vec3> tet_verts = {
-    {0, 0, 0},
-    {0, 0, 1},
-    {0, 1, 0},
-    {0, 1, 1},
-  };
-  std::vector<std::array<size_t, 4>> tet_cells = {
-    {0,1,2,4}
-  };
-  polyscope::registerTetMesh("tet", tet_verts, tet_cells);
-   
+  polyscope::removeAllStructures();
+}
 
-  // Hexes only
-  std::vector<glm::vec3> hex_verts = {
-    {0, 0, 0},
-    {0, 0, 1},
-    {0, 1, 0},
-    {0, 1, 1},
-    {1, 0, 0},
-    {1, 0, 1},
-    {1, 1, 0},
-    {1, 1, 1},
-  };
-  std::vector<std::array<size_t, 8>> hex_cells = {
-    {0,1,2,3,4,5,6,7},
-  };
-  polyscope::registerHexMesh("hex", hex_verts, hex_cells);
+TEST_F(PolyscopeTest, ReorderForLocality) {
+  std::vector<glm::vec3> points;
+  for (int i = 0; i < 20; i++) {
+    for (int j = 0; j < 20; j++) {
+      points.push_back(glm::vec3{i, j, (i * j) % 3});
+    }
+  }
+  std::vector<uint32_t> order = polyscope::mortonOrder(points);
+  ASSERT_EQ(order.size(), points.size());
+  std::vector<uint32_t> sortedOrder = order;
+  std::sort(sortedOrder.begin(), sortedOrder.end());
+  for (size_t i = 0; i < sortedOrder.size(); i++) {
+    EXPECT_EQ(sortedOrder[i], i);
+  }
 
+  polyscope::options::reorderForLocality = true;
 
-  // clang-format on
+  // point cloud: picks and quantities still refer to the points in order
+  polyscope::PointCloud* psPoints = polyscope::registerPointCloud("reordered points", points);
+  std::vector<double> vScalar(points.size(), 7.);
+  psPoints->addScalarQuantity("vScalar", vScalar)->setEnabled(true);
+  polyscope::show(3);
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  psPoints->updatePointPositions(points);
+  psPoints->updatePointPositions(std::vector<size_t>{3}, std::vector<glm::vec3>{glm::vec3{0., 0., 1.}});
+  polyscope::show(3);
 
-  // Mixed elements, separate arrays
-  std::vector<glm::vec3> combined_verts;
-  combined_verts.insert(combined_verts.end(), tet_verts.begin(), tet_verts.end());
-  combined_verts.insert(combined_verts.end(), hex_verts.begin(), hex_verts.end());
-  for (auto& hex : hex_cells) {
-    for (size_t& i : hex) {
-      i += tet_verts.size();
+  // surface mesh: a grid of triangles and quads
+  const size_t N = 20;
+  std::vector<glm::vec3> vertices;
+  std::vector<std::vector<size_t>> faces;
+  for (size_t i = 0; i < N; i++) {
+    for (size_t j = 0; j < N; j++) {
+      vertices.push_back(glm::vec3{i, j, 0.});
+      if (i + 1 < N && j + 1 < N) {
+        if ((i + j) % 2 == 0) {
+          faces.push_back({i * N + j, (i + 1) * N + j, (i + 1) * N + j + 1, i * N + j + 1});
+        } else {
+          faces.push_back({i * N + j, (i + 1) * N + j, (i + 1) * N + j + 1});
+          faces.push_back({i * N + j, (i + 1) * N + j + 1, i * N + j + 1});
+        }
+      }
     }
   }
-  polyscope::registerTetHexMesh("tet hex mix separate", combined_verts, tet_cells, hex_cells);
+  polyscope::SurfaceMesh* psMesh = polyscope::registerSurfaceMesh("reordered mesh", vertices, faces);
+  std::vector<double> fScalar(psMesh->nFaces(), 3.);
+  psMesh->addFaceScalarQuantity("fScalar", fScalar)->setEnabled(true);
+  psMesh->setEdgeWidth(1.);
+  polyscope::show(3);
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  psMesh->updateVertexPositions(std::vector<size_t>{0, 21}, std::vector<glm::vec3>(2, glm::vec3{0., 0., 0.5}));
+  polyscope::show(3);
+  psMesh->updateVertexPositions(vertices);
+  polyscope::show(3);
 
+  polyscope::options::reorderForLocality = false;
+  polyscope::removeAllStructures();
+}
 
-  // Mixed elements, shared array
-  std::vector<std::array<int, 8>> combined_cells = {
-      {0, 1, 3, 4, -1, -1, -1, -1},
-      {4, 5, 6, 7, 8, 9, 10, 11},
+TEST_F(PolyscopeTest, PointCloudStream) {
+  // 16 chunks of 100 points, each a tile of a 4x4 grid
+  std::vector<glm::vec3> points;
+  std::vector<float> values;
+  for (size_t i = 0; i < 1600; i++) {
+    size_t c = i / 100;
+    points.push_back(glm::vec3{c % 4 + (i % 10) / 10., c / 4 + (i / 10 % 10) / 10., 0.});
+    values.push_back(i);
+  }
+  std::ofstream("stream_points.bin", std::ios::binary)
+      .write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(glm::vec3));
+  std::ofstream("stream_values.bin", std::ios::binary)
+      .write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+
+  polyscope::PointCloudStream* psStream = polyscope::registerPointCloudStream("stream", "stream_points.bin", 100);
+  EXPECT_EQ(psStream->nPoints(), 1600u);
+  EXPECT_EQ(psStream->nChunks(), 16u);
+  psStream->addScalarFile("values", "stream_values.bin");
+  psStream->setDisplayedAttribute("values");
+
+  auto settle = [&]() {
+    for (int i = 0; i < 20; i++) {
+      polyscope::show(1);
+      psStream->waitForReads();
+    }
   };
-  polyscope::registerVolumeMesh("tet hex mix combined", combined_verts, combined_cells);
+
+  polyscope::view::resetCameraToHomeView();
+  settle();
+  EXPECT_EQ(psStream->nResidentPoints(), 1600u);
+
+  // only the nearest chunks fit in the budget
+  psStream->setResidentPointBudget(450);
+  settle();
+  EXPECT_EQ(psStream->nResidentPoints(), 400u);
+
+  // adding an attribute rereads everything
+  psStream->addColorFile("colors", "stream_points.bin");
+  psStream->setDisplayedAttribute("colors");
+  settle();
+  EXPECT_EQ(psStream->nResidentPoints(), 400u);
 
   polyscope::removeAllStructures();
+  std::remove("stream_points.bin");
+  std::remove("stream_values.bin");
 }
 
-TEST_F(PolyscopeTest, VolumeMeshAppearance) {
-  std::vector<glm::vec3> verts;
-  std::vector<std::array<int, 8>> cells;
-  std::tie(verts, cells) = getVolumeMeshData();
-  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+TEST_F(PolyscopeTest, LoadOBJ) {
+  std::ofstream("load_test.obj", std::ios::binary) << "# a quad and a triangle\r\n"
+                                                      "mtllib none.mtl\n"
+                                                      "v 0 0 0\n"
+                                                      "v 1.5 0 -2e-1\n"
+                                                      "vt 0.5 0.5\n"
+                                                      "vn 0 0 1\n"
+                                                      "v\t1 1 0\r\n"
+                                                      "v 0 1 0.12345678901234567890\n"
+                                                      "f 1/1/1 2/1/1 3//1 \\\n"
+                                                      "  4/1\n"
+                                                      "v 2 2 2\n"
+                                                      "f -1 -3 -4\n";
+
+  std::vector<std::array<double, 3>> vertices;
+  std::vector<uint32_t> entries;
+  std::vector<size_t> starts;
+  polyscope::loadPolygonSoup_OBJ("load_test.obj", vertices, entries, starts);
+  ASSERT_EQ(vertices.size(), 5u);
+  EXPECT_EQ(vertices[1][0], 1.5);
+  EXPECT_EQ(vertices[1][2], -0.2);
+  EXPECT_EQ(vertices[3][2], 0.12345678901234567890);
+  EXPECT_EQ(entries, (std::vector<uint32_t>{0, 1, 2, 3, 4, 2, 1}));
+  EXPECT_EQ(starts, (std::vector<size_t>{0, 4, 7}));
 
-  // Material
-  psVol->setMaterial("wax");
-  EXPECT_EQ(psVol->getMaterial(), "wax");
-  polyscope::show(3);
+  std::vector<std::vector<size_t>> faces;
+  polyscope::loadPolygonSoup("load_test.obj", vertices, faces);
+  EXPECT_EQ(faces, (std::vector<std::vector<size_t>>{{0, 1, 2, 3}, {4, 2, 1}}));
 
-  // Color of the mesh
-  glm::vec3 color{0.5, 0.25, 0.25};
-  psVol->setColor(color);
-  EXPECT_EQ(color, psVol->getColor());
+  std::remove("load_test.obj");
+}
 
-  // Color of the mesh inteiror
-  glm::vec3 colorI{0.5, 0.25, 0.75};
-  psVol->setInteriorColor(colorI);
-  EXPECT_EQ(colorI, psVol->getInteriorColor());
+TEST_F(PolyscopeTest, LoadOBJCommaDecimalLocale) {
+  std::string oldLocale = std::setlocale(LC_NUMERIC, nullptr);
+  const char* commaLocales[] = {"de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "German"};
+  bool haveCommaLocale = false;
+  for (const char* l : commaLocales) {
+    if (std::setlocale(LC_NUMERIC, l) != nullptr) {
+      haveCommaLocale = true;
+      break;
+    }
+  }
+  if (!haveCommaLocale) {
+    GTEST_SKIP() << "no locale with a decimal comma is installed";
+  }
 
-  // Color of the mesh edges
-  glm::vec3 colorE{0.5, 0.25, 0.5};
-  psVol->setEdgeColor(colorE);
-  EXPECT_EQ(colorE, psVol->getEdgeColor());
-  polyscope::show(3);
+  // long numbers go to the slow path of the parser
+  std::ofstream("load_locale_test.obj") << "v 0.12345678901234567890 1.5 2\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+  std::vector<std::array<double, 3>> vertices;
+  std::vector<uint32_t> entries;
+  std::vector<size_t> starts;
+  polyscope::loadPolygonSoup_OBJ("load_locale_test.obj", vertices, entries, starts);
+  std::setlocale(LC_NUMERIC, oldLocale.c_str());
+
+  ASSERT_EQ(vertices.size(), 3u);
+  EXPECT_EQ(vertices[0][0], 0.12345678901234567890);
+  EXPECT_EQ(vertices[0][1], 1.5);
+  std::remove("load_locale_test.obj");
+}
 
-  // Edge width
-  psVol->setEdgeWidth(0.25);
-  EXPECT_EQ(0.25, psVol->getEdgeWidth());
+TEST_F(PolyscopeTest, LoadManyPolygonSoups) {
+  std::vector<std::string> filenames;
+  for (int i = 0; i < 6; i++) {
+    filenames.push_back("load_part_" + std::to_string(i) + ".obj");
+    std::ofstream(filenames.back()) << "v 0 0 " << i << "\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+  }
 
-  // Transparency
-  psVol->setTransparency(0.25);
-  EXPECT_EQ(0.25, psVol->getTransparency());
+  // a budget below one file still loads them, one at a time
+  size_t oldBudget = polyscope::options::meshLoadMemoryBudget;
+  polyscope::options::meshLoadMemoryBudget = 1;
+  std::vector<polyscope::SurfaceMesh*> registered;
+  polyscope::registerSurfaceMeshesFromFiles(filenames,
+                                            [&](polyscope::SurfaceMesh* m) { registered.push_back(m); });
+  polyscope::finishLoadingPolygonSoups();
+  polyscope::options::meshLoadMemoryBudget = oldBudget;
+  EXPECT_EQ(polyscope::nPolygonSoupsLoading(), 0u);
+  EXPECT_EQ(registered.size(), filenames.size());
+  ASSERT_TRUE(polyscope::hasSurfaceMesh("load_part_3"));
+  EXPECT_EQ(polyscope::getSurfaceMesh("load_part_3")->vertices[0].z, 3.f);
+  polyscope::show(3);
 
+  // failures are passed on too
+  std::string failure;
+  polyscope::loadPolygonSoups({"no_such_part.obj"},
+                              [&](polyscope::LoadedPolygonSoup& soup) { failure = soup.error; });
+  polyscope::finishLoadingPolygonSoups();
+  EXPECT_FALSE(failure.empty());
+
+  for (const std::string& f : filenames) std::remove(f.c_str());
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, VolumeMeshPick) {
-  std::vector<glm::vec3> verts;
-  std::vector<std::array<int, 8>> cells;
-  std::tie(verts, cells) = getVolumeMeshData();
-  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+TEST_F(PolyscopeTest, LoadPLY) {
+  // binary triangles, with a color per vertex
+  {
+    std::ofstream out("load_test.ply", std::ios::binary);
+    out << "ply\nformat binary_little_endian 1.0\ncomment test\nelement vertex 4\nproperty float x\nproperty float y\n"
+           "property float z\nproperty uchar red\nproperty double quality\nelement face 2\n"
+           "property list uchar int vertex_indices\nend_header\n";
+    for (int i = 0; i < 4; i++) {
+      float p[3] = {float(i), float(i % 2), 0.5f};
+      uint8_t red = 10 * i;
+      double quality = 0.25 * i;
+      out.write(reinterpret_cast<const char*>(p), sizeof(p));
+      out.write(reinterpret_cast<const char*>(&red), 1);
+      out.write(reinterpret_cast<const char*>(&quality), sizeof(quality));
+    }
+    int32_t faces[2][3] = {{0, 1, 2}, {2, 1, 3}};
+    for (int i = 0; i < 2; i++) {
+      uint8_t count = 3;
+      out.write(reinterpret_cast<const char*>(&count), 1);
+      out.write(reinterpret_cast<const char*>(faces[i]), sizeof(faces[i]));
+    }
+  }
+  std::vector<std::array<double, 3>> vertices;
+  std::vector<uint32_t> entries;
+  std::vector<size_t> starts;
+  std::map<std::string, std::vector<double>> properties;
+  polyscope::loadPolygonSoup_PLY("load_test.ply", vertices, entries, starts, properties);
+  ASSERT_EQ(vertices.size(), 4u);
+  EXPECT_EQ(vertices[3], (std::array<double, 3>{{3., 1., 0.5}}));
+  EXPECT_EQ(entries, (std::vector<uint32_t>{0, 1, 2, 2, 1, 3}));
+  EXPECT_EQ(starts, (std::vector<size_t>{0, 3, 6}));
+  EXPECT_EQ(properties.size(), 2u);
+  EXPECT_EQ(properties["red"], (std::vector<double>{0., 10., 20., 30.}));
+  EXPECT_EQ(properties["quality"][2], 0.5);
+
+  // ascii, with a quad
+  std::ofstream("load_test.ply") << "ply\nformat ascii 1.0\nelement vertex 4\nproperty double x\nproperty double y\n"
+                                    "property double z\nelement face 1\nproperty list uchar uint vertex_index\n"
+                                    "end_header\n0 0 0\n1 0 0\n1 1 0\n0 1 0\n4 0 1 2 3\n";
+  std::vector<std::vector<size_t>> faces;
+  polyscope::loadPolygonSoup("load_test.ply", vertices, faces);
+  EXPECT_EQ(vertices.size(), 4u);
+  EXPECT_EQ(faces, (std::vector<std::vector<size_t>>{{0, 1, 2, 3}}));
 
-  // Don't bother trying to actually click on anything, but make sure this doesn't crash
-  polyscope::pick::evaluatePickQuery(77, 88);
+  std::remove("load_test.ply");
+}
+
+TEST_F(PolyscopeTest, SaveLoadScene) {
+  polyscope::SurfaceMesh* psMesh = registerTriangleMesh("saved mesh");
+  std::vector<double> vScalar(psMesh->nVertices(), 3.);
+  vScalar[0] = 1.;
+  psMesh->addVertexScalarQuantity("vScalar", vScalar)->setMapRange({-1., 5.});
+  psMesh->getQuantity("vScalar")->setEnabled(true);
+  psMesh->setSurfaceColor(glm::vec3{0.1, 0.2, 0.3});
+  psMesh->setTransform(glm::translate(glm::mat4(1.), glm::vec3{1., 2., 3.}));
+  size_t nEdges = psMesh->nEdges();
+  std::vector<double> edgeLengths = psMesh->edgeLengths;
+
+  std::vector<glm::vec3> points(20, glm::vec3{0.5, 0.5, 0.5});
+  polyscope::PointCloud* psCloud = polyscope::registerPointCloud("saved cloud", points);
+  psCloud->addColorQuantity("colors", std::vector<glm::vec3>(points.size(), glm::vec3{1., 0., 0.}));
+  psCloud->addVectorQuantity("vectors", std::vector<glm::vec3>(points.size(), glm::vec3{0., 1., 0.}));
+
+  polyscope::saveScene("test_scene.bin");
+  polyscope::removeAllStructures();
+  polyscope::detail::getPersistentCacheRef<glm::vec3>().clear(); // so the colors must come from the file
+  polyscope::detail::getPersistentCacheRef<bool>().clear();
+  polyscope::loadScene("test_scene.bin");
+
+  psMesh = polyscope::getSurfaceMesh("saved mesh");
+  ASSERT_NE(psMesh, nullptr);
+  EXPECT_EQ(psMesh->nEdges(), nEdges);
+  EXPECT_EQ(psMesh->edgeLengths, edgeLengths);
+  EXPECT_EQ(psMesh->getSurfaceColor(), glm::vec3(0.1, 0.2, 0.3));
+  EXPECT_EQ(psMesh->getTransform()[3], glm::vec4(1., 2., 3., 1.));
+  polyscope::SurfaceVertexScalarQuantity* q =
+      dynamic_cast<polyscope::SurfaceVertexScalarQuantity*>(psMesh->getQuantity("vScalar"));
+  ASSERT_NE(q, nullptr);
+  EXPECT_TRUE(q->isEnabled());
+  EXPECT_EQ(q->values[0], 1.);
+  EXPECT_EQ(q->getMapRange(), std::make_pair(-1., 5.));
+
+  psCloud = polyscope::getPointCloud("saved cloud");
+  ASSERT_NE(psCloud, nullptr);
+  EXPECT_EQ(psCloud->nPoints(), points.size());
+  EXPECT_NE(psCloud->getQuantity("colors"), nullptr);
+  EXPECT_NE(psCloud->getQuantity("vectors"), nullptr);
+  polyscope::show(3);
 
   polyscope::removeAllStructures();
+  std::remove("test_scene.bin");
 }
 
+TEST_F(PolyscopeTest, SceneSnapshotRejectsBadIndices) {
+  polyscope::SurfaceMesh* psMesh = registerTriangleMesh("saved mesh");
+  std::vector<glm::vec3> vertices(psMesh->nVertices());
+  std::vector<uint32_t> entries = psMesh->faceIndsEntries;
+  std::vector<size_t> starts = psMesh->faceIndsStart;
+  polyscope::SurfaceMesh::DerivedData good = psMesh->getDerivedData();
 
-TEST_F(PolyscopeTest, VolumeMeshColorVertex) {
-  std::vector<glm::vec3> verts;
-  std::vector<std::array<int, 8>> cells;
-  std::tie(verts, cells) = getVolumeMeshData();
-  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+  polyscope::SurfaceMesh restored("restored", vertices, entries, starts, good);
+  EXPECT_EQ(restored.nEdges(), psMesh->nEdges());
+
+  std::vector<uint32_t> badEntries = entries;
+  badEntries[0] = static_cast<uint32_t>(vertices.size());
+  EXPECT_THROW(polyscope::SurfaceMesh("bad", vertices, badEntries, starts, good), std::invalid_argument);
+
+  polyscope::SurfaceMesh::DerivedData badEdges = good;
+  badEdges.halfedgeEdgeIndices[0] = static_cast<uint32_t>(good.edgeLengths.size());
+  EXPECT_THROW(polyscope::SurfaceMesh("bad", vertices, entries, starts, badEdges), std::invalid_argument);
+
+  polyscope::SurfaceMesh::DerivedData badFaces = good;
+  badFaces.vertexFaces[0] = static_cast<uint32_t>(psMesh->nFaces());
+  EXPECT_THROW(polyscope::SurfaceMesh("bad", vertices, entries, starts, badFaces), std::invalid_argument);
 
-  std::vector<glm::vec3> vColors(verts.size(), glm::vec3{.2, .3, .4});
-  auto q1 = psVol->addVertexColorQuantity("vcolor", vColors);
-  q1->setEnabled(true);
-  polyscope::show(3);
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, VolumeMeshColorCell) {
-  std::vector<glm::vec3> verts;
-  std::vector<std::array<int, 8>> cells;
-  std::tie(verts, cells) = getVolumeMeshData();
-  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+TEST_F(PolyscopeTest, BatchRenderJobs) {
+  polyscope::SurfaceMesh* psMesh = registerTriangleMesh("batch mesh");
+  psMesh->addVertexScalarQuantity("vScalar", std::vector<double>(psMesh->nVertices(), 1.));
+  polyscope::saveScene("batch_scene_a.bin");
+  registerPointCloud("batch cloud");
+  polyscope::saveScene("batch_scene_b.bin");
+  polyscope::removeAllStructures();
+
+  std::vector<polyscope::RenderJob> jobs;
+  for (int i = 0; i < 5; i++) {
+    polyscope::RenderJob job;
+    job.sceneFile = i % 2 == 0 ? "batch_scene_a.bin" : "batch_scene_b.bin";
+    job.setup = [i]() { polyscope::getSurfaceMesh("batch mesh")->getQuantity("vScalar")->setEnabled(i < 2); };
+    job.outputFile = "batch_job_" + std::to_string(i) + ".png";
+    jobs.push_back(job);
+  }
+  polyscope::RenderJob missing;
+  missing.sceneFile = "no_such_scene.bin";
+  missing.outputFile = "batch_job_missing.png";
+  jobs.push_back(missing);
+
+  // Every job goes to exactly one worker, and the jobs of a scene stay together where they fit
+  std::vector<size_t> all;
+  for (int w = 0; w < 3; w++) {
+    std::vector<size_t> mine = polyscope::assignRenderJobs(jobs, w, 3);
+    all.insert(all.end(), mine.begin(), mine.end());
+  }
+  std::sort(all.begin(), all.end());
+  EXPECT_EQ(all, std::vector<size_t>({0, 1, 2, 3, 4, 5}));
+  EXPECT_EQ(polyscope::assignRenderJobs(jobs, 0, 1), std::vector<size_t>({0, 2, 4, 1, 3, 5}));
+
+  std::vector<polyscope::RenderJobTiming> timings = polyscope::renderJobs(jobs);
+  ASSERT_EQ(timings.size(), jobs.size());
+  EXPECT_GT(timings[0].loadMs, 0.);
+  EXPECT_EQ(timings[1].loadMs, 0.); // (job 2, the same scene)
+  EXPECT_FALSE(timings[5].error.empty());
+  for (int i = 0; i < 5; i++) {
+    EXPECT_TRUE(std::ifstream(jobs[i].outputFile).good());
+    std::remove(jobs[i].outputFile.c_str());
+  }
 
-  std::vector<glm::vec3> cColors(cells.size(), glm::vec3{.2, .3, .4});
-  auto q1 = psVol->addCellColorQuantity("ccolor", cColors);
-  q1->setEnabled(true);
-  polyscope::show(3);
   polyscope::removeAllStructures();
+  std::remove("batch_scene_a.bin");
+  std::remove("batch_scene_b.bin");
 }
 
-TEST_F(PolyscopeTest, VolumeMeshScalarVertex) {
-  std::vector<glm::vec3> verts;
-  std::vector<std::array<int, 8>> cells;
-  std::tie(verts, cells) = getVolumeMeshData();
-  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+TEST_F(PolyscopeTest, ImageScalarArtistTiled) {
+  size_t dimX = 1000;
+  size_t dimY = 700;
+  auto readFullResolution = [](size_t x0, size_t y0, size_t w, size_t h, float* out) {
+    for (size_t j = 0; j < h; j++) {
+      for (size_t i = 0; i < w; i++) {
+        out[j * w + i] = static_cast<float>(x0 + i + y0 + j);
+      }
+    }
+  };
+  polyscope::ImageScalarArtist artist("tiled image",
+                                      polyscope::tileSourceFromFullResolution(readFullResolution, dimX, dimY), dimX,
+                                      dimY, polyscope::DataType::STANDARD, 64);
+
+  // the coarsest level is read up front, and gives the range
+  std::pair<double, double> range = artist.getMapRange();
+  EXPECT_LT(range.first, 20.);
+  EXPECT_GT(range.second, 1600.);
+
+  // zooming in reads the full-resolution tiles in view, and old tiles are dropped past the cache size
+  polyscope::internal::finishBackgroundFills = true;
+  artist.setTileCacheSize(2);
+  artist.setViewRegion(glm::vec2{0., 0.}, glm::vec2{100., 100.});
+  artist.draw();
+  EXPECT_EQ(artist.nResidentTiles(), 5);
+  artist.setViewRegion(glm::vec2{500., 500.}, glm::vec2{550., 550.});
+  artist.draw();
+  EXPECT_EQ(artist.nResidentTiles(), 5); // (the four new tiles in view, and the coarsest level)
+  artist.setMapRange({0., 100.});
+  artist.draw();
+  polyscope::internal::finishBackgroundFills = false;
+}
 
-  std::vector<float> vals(verts.size(), 0.44);
-  auto q1 = psVol->addVertexScalarQuantity("vals", vals);
-  q1->setEnabled(true);
+TEST_F(PolyscopeTest, Viewports) {
+  std::vector<glm::vec3> points = {{0., 0., 0.}};
+  polyscope::PointCloud* psPoints = polyscope::registerPointCloud("origin", points);
+  psPoints->setPointRadius(0.5, false);
+  auto psMesh = registerTriangleMesh("mesh");
+  psMesh->translate({3, 0, 0});
+  polyscope::view::lookAt({0, 0, 5}, {0, 0, 0});
+  glm::mat4 mainView = polyscope::view::viewMat;
+  polyscope::show(3);
+  polyscope::render::engine->resetRenderStats();
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  size_t drawCallsMainView = polyscope::render::engine->renderStats.drawCalls;
+
+  // Two views side by side, the right one without the point cloud
+  polyscope::Viewport* left = polyscope::addViewport("left", {0., 0., 0.5, 1.});
+  polyscope::Viewport* right = polyscope::addViewport("right", {0.5, 0., 0.5, 1.});
+  right->setStructureVisible(psPoints, false);
+  EXPECT_FALSE(right->isStructureVisible(psPoints));
+  EXPECT_TRUE(right->isStructureVisible(psMesh));
+  EXPECT_EQ(polyscope::getViewportAt({0.25, 0.5}), left);
+  EXPECT_EQ(polyscope::getViewportAt({0.75, 0.5}), right);
+
+  // A view's camera lands in the middle of its region
+  left->lookAt({0, 0, 5}, {0, 0, 0});
+  right->lookAt({0, 0, 5}, {0, 0, 0});
+  left->activate();
+  glm::vec4 center = polyscope::view::getCameraPerspectiveMatrix() * polyscope::view::viewMat * glm::vec4{0, 0, 0, 1};
+  EXPECT_NEAR(center.x / center.w, -0.5, 1e-5);
+  EXPECT_NEAR(center.y / center.w, 0., 1e-5);
+  left->deactivate();
+  EXPECT_EQ(polyscope::view::viewMat, mainView);
+
+  // Both views draw from the same structures
   polyscope::show(3);
+  polyscope::render::engine->resetRenderStats();
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  EXPECT_GT(polyscope::render::engine->renderStats.drawCalls, drawCallsMainView);
+
+  // Picks see the structures shown in the view under the pixel
+  polyscope::options::cpuPicking = true;
+  int x = polyscope::view::bufferWidth / 4;
+  int y = polyscope::view::bufferHeight / 2;
+  EXPECT_EQ(polyscope::pick::evaluatePickQuery(x, y).first, psPoints);
+  EXPECT_EQ(polyscope::pick::evaluatePickQuery(x + polyscope::view::bufferWidth / 2, y).first, nullptr);
+  polyscope::options::cpuPicking = false;
+
+  polyscope::removeAllViewports();
+  EXPECT_FALSE(polyscope::haveViewports());
   polyscope::removeAllStructures();
+  polyscope::view::resetCameraToHomeView();
 }
 
-TEST_F(PolyscopeTest, VolumeMeshScalarCell) {
-  std::vector<glm::vec3> verts;
-  std::vector<std::array<int, 8>> cells;
-  std::tie(verts, cells) = getVolumeMeshData();
-  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+TEST_F(PolyscopeTest, CameraPathPlayback) {
+  polyscope::CameraPath path;
+  std::vector<glm::vec3> locations = {{0, 0, 5}, {5, 0, 0}, {0, 5, 1}};
+  for (size_t i = 0; i < locations.size(); i++) {
+    polyscope::view::lookAt(locations[i], {0, 0, 0});
+    path.addCurrentViewAsKeyframe(0.5 * i);
+  }
+  EXPECT_EQ(path.getDuration(), 1.);
 
-  std::vector<float> vals(cells.size(), 0.44);
-  auto q1 = psVol->addCellScalarQuantity("vals", vals);
-  q1->setEnabled(true);
-  polyscope::show(3);
-  polyscope::removeAllStructures();
+  // The path passes through its keyframes
+  for (size_t i = 0; i < locations.size(); i++) {
+    glm::vec3 p = path.evaluate(0.5 * i).getPosition();
+    EXPECT_LT(glm::length(p - locations[i]), 1e-4);
+  }
+  glm::vec3 mid = path.evaluate(0.25).getPosition();
+  EXPECT_GT(glm::length(mid), 3.);
+
+  // Fixed steps draw exactly one frame per step, ending at the last keyframe
+  polyscope::playCameraPath(path, polyscope::CameraPathPlayback::FixedStep, 10.);
+  polyscope::show(11);
+  EXPECT_TRUE(polyscope::isPlayingCameraPath());
+  EXPECT_EQ(polyscope::getCameraPathFrame(), 11);
+  EXPECT_NEAR(polyscope::getCameraPathTime(), 1., 1e-9);
+  EXPECT_LT(glm::length(polyscope::view::getCameraWorldPosition() - locations.back()), 1e-4);
+  polyscope::show(1);
+  EXPECT_FALSE(polyscope::isPlayingCameraPath());
+
+  polyscope::view::resetCameraToHomeView();
 }
 
-TEST_F(PolyscopeTest, VolumeMeshVertexVector) {
-  std::vector<glm::vec3> verts;
-  std::vector<std::array<int, 8>> cells;
-  std::tie(verts, cells) = getVolumeMeshData();
-  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+TEST_F(PolyscopeTest, SessionCaptureReplay) {
+  polyscope::SurfaceMesh* psMesh = registerTriangleMesh("captured mesh");
+  psMesh->addVertexScalarQuantity("vScalar", std::vector<double>(psMesh->nVertices(), 2.));
+
+  polyscope::startSessionCapture("test_session.bin");
+  EXPECT_TRUE(polyscope::isCapturingSession());
+  std::vector<glm::vec3> points(20, glm::vec3{0.5, 0.5, 0.5});
+  polyscope::PointCloud* psCloud = polyscope::registerPointCloud("captured cloud", points);
+  psCloud->addColorQuantity("colors", std::vector<glm::vec3>(points.size(), glm::vec3{1., 0., 0.}));
+  psCloud->getQuantity("colors")->setEnabled(true);
+  polyscope::show(2);
+  points[3] = glm::vec3{1., 2., 3.};
+  psCloud->updatePointPositions(points);
+  psMesh->setEnabled(false);
+  polyscope::show(1);
+  polyscope::stopSessionCapture();
+  EXPECT_FALSE(polyscope::isCapturingSession());
 
-  std::vector<glm::vec3> vals(verts.size(), {1., 2., 3.});
-  auto q1 = psVol->addVertexVectorQuantity("vals", vals);
-  q1->setEnabled(true);
-  polyscope::show(3);
   polyscope::removeAllStructures();
-}
+  polyscope::SessionReplayStats stats = polyscope::replaySession("test_session.bin");
+  EXPECT_EQ(stats.nFrames, 3u);
+
+  psMesh = polyscope::getSurfaceMesh("captured mesh");
+  ASSERT_NE(psMesh, nullptr);
+  EXPECT_NE(psMesh->getQuantity("vScalar"), nullptr);
+  EXPECT_FALSE(psMesh->isEnabled());
+  psCloud = polyscope::getPointCloud("captured cloud");
+  ASSERT_NE(psCloud, nullptr);
+  EXPECT_EQ(psCloud->points[3], glm::vec3(1., 2., 3.));
+  ASSERT_NE(psCloud->getQuantity("colors"), nullptr);
+  EXPECT_TRUE(psCloud->getQuantity("colors")->isEnabled());
 
-TEST_F(PolyscopeTest, VolumeMeshCellVector) {
-  std::vector<glm::vec3> verts;
-  std::vector<std::array<int, 8>> cells;
-  std::tie(verts, cells) = getVolumeMeshData();
-  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+  polyscope::removeAllStructures();
+  std::remove("test_session.bin");
+}
 
-  std::vector<glm::vec3> vals(cells.size(), {1., 2., 3.});
-  auto q1 = psVol->addCellVectorQuantity("vals", vals);
+TEST_F(PolyscopeTest, AppendPointsAndEdges) {
+  // point cloud, growing past the room allocated by the first append
+  polyscope::PointCloud* psCloud = polyscope::registerPointCloud("appended cloud", getPoints());
+  size_t n0 = psCloud->nPoints();
+  auto q1 = psCloud->addScalarQuantity("vScalar", std::vector<double>(n0, 1.));
+  auto q2 = psCloud->addColorQuantity("vColor", std::vector<glm::vec3>(n0, glm::vec3{0.5, 0.5, 0.5}));
+  auto q3 = psCloud->addVectorQuantity("vVector", std::vector<glm::vec3>(n0, glm::vec3{0., 0., 0.1}));
   q1->setEnabled(true);
+  q3->setEnabled(true);
   polyscope::show(3);
+  for (size_t iChunk = 0; iChunk < 3; iChunk++) {
+    std::vector<glm::vec3> chunk(600, glm::vec3{iChunk, 1., 2.});
+    psCloud->appendPoints(chunk);
+    q1->appendValues(std::vector<double>(chunk.size(), 2.));
+    q2->appendValues(std::vector<glm::vec3>(chunk.size(), glm::vec3{1., 0., 0.}));
+    q3->appendValues(std::vector<glm::vec3>(chunk.size(), glm::vec3{0.1, 0., 0.}));
+    polyscope::show(3);
+  }
+  EXPECT_EQ(psCloud->nPoints(), n0 + 1800);
+  EXPECT_EQ(psCloud->nPointsAdded(), n0 + 1800);
+  psCloud->setEnabled(true);
+  polyscope::pick::evaluatePickQuery(-1, -1);
+
+  // ring mode: the oldest points are replaced
+  polyscope::PointCloud* psRing = polyscope::registerPointCloud("ring cloud", getPoints());
+  psRing->setMaxPoints(100);
+  auto qRing = psRing->addScalarQuantity("vScalar", std::vector<double>(psRing->nPoints(), 0.));
+  qRing->setEnabled(true);
+  for (size_t iChunk = 0; iChunk < 5; iChunk++) {
+    psRing->appendPoints(std::vector<glm::vec3>(30, glm::vec3{iChunk, 0., 0.}));
+    qRing->appendValues(std::vector<double>(30, static_cast<double>(iChunk)));
+    polyscope::show(3);
+  }
+  EXPECT_EQ(psRing->nPoints(), 100u);
+  EXPECT_EQ(psRing->nPointsAdded(), 154u);
+  EXPECT_EQ(psRing->points[psRing->pointSlot(153)], glm::vec3(4., 0., 0.));
+  polyscope::pick::evaluatePickQuery(-1, -1);
+
+  // curve network, in each render mode
+  polyscope::CurveNetwork* psCurve = polyscope::registerCurveNetworkLine("appended curve", getPoints());
+  psCurve->addNodeScalarQuantity("nScalar", std::vector<double>(psCurve->nNodes(), 1.));
+  for (polyscope::CurveRenderMode mode :
+       {polyscope::CurveRenderMode::Cylinders, polyscope::CurveRenderMode::Tubes, polyscope::CurveRenderMode::Lines}) {
+    psCurve->setCurveRenderMode(mode);
+    polyscope::show(3);
+    for (size_t i = 0; i < 700; i++) {
+      size_t iLast = psCurve->nNodes() - 1;
+      psCurve->appendNodes(std::vector<glm::vec3>{glm::vec3{i, 0., 1.}});
+      psCurve->appendEdges(std::vector<std::array<size_t, 2>>{{iLast, iLast + 1}});
+      if (i % 100 == 0) polyscope::show(1);
+    }
+    polyscope::show(3);
+  }
+  EXPECT_EQ(psCurve->nNodes(), psCurve->nEdges() + 1);
+  EXPECT_EQ(psCurve->getQuantity("nScalar"), nullptr);
+  polyscope::pick::evaluatePickQuery(-1, -1);
+
   polyscope::removeAllStructures();
 }
 
-TEST_F(PolyscopeTest, VolumeMeshInspect) {
-  std::vector<glm::vec3> verts;
-  std::vector<std::array<int, 8>> cells;
-  std::tie(verts, cells) = getVolumeMeshData();
-  polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+TEST_F(PolyscopeTest, PointCloudDeviceWrites) {
+  polyscope::PointCloud* psCloud = polyscope::registerPointCloud("device cloud", getPoints());
+  auto q1 = psCloud->addScalarQuantity("vScalar", std::vector<double>(psCloud->nPoints(), 1.));
+  q1->setEnabled(true);
+  polyscope::show(3);
 
-  // plain old inspecting
-  polyscope::SlicePlane* p = polyscope::addSceneSlicePlane();
-  p->setVolumeMeshToInspect("vol");
+  // the buffers a compute API would write, through their native handles
+  std::shared_ptr<polyscope::render::AttributeBuffer> positions = psCloud->getPositionRenderBuffer();
+  std::shared_ptr<polyscope::render::AttributeBuffer> values = q1->getValueRenderBuffer();
+  ASSERT_NE(positions, nullptr);
+  ASSERT_NE(values, nullptr);
+  positions->getNativeHandle();
+  values->getNativeHandle();
+  psCloud->devicePositionsWritten();
+  q1->deviceValuesWritten();
   polyscope::show(3);
 
-  // with a scalar quantity
-  std::vector<float> vals(verts.size(), 0.44);
-  auto q1 = psVol->addVertexScalarQuantity("vals", vals);
-  q1->setEnabled(true);
+  // the bounds and range are reduced from the buffers (the mock backend reads back (1, 2, 3) from every pixel, so the
+  // lows are the negated highs)
+  EXPECT_EQ(std::get<0>(psCloud->boundingBox()), glm::vec3(-1., -2., -3.));
+  EXPECT_EQ(std::get<1>(psCloud->boundingBox()), glm::vec3(1., 2., 3.));
+  EXPECT_FLOAT_EQ(psCloud->lengthScale(), 2.);
+  EXPECT_EQ(q1->getMapRange(), std::make_pair(-1., 1.));
+
+  // not drawn from the buffers while animated
+  q1->addValueFrame(std::vector<double>(psCloud->nPoints(), 2.));
+  q1->deviceValuesWritten();
   polyscope::show(3);
-  polyscope::removeAllStructures();
 
-  polyscope::removeLastSceneSlicePlane();
+  polyscope::removeAllStructures();
 }
 
+TEST_F(PolyscopeTest, StreamingAttributeBuffers) {
+  polyscope::PointCloud* psCloud = polyscope::registerPointCloud("animated cloud", getPoints());
+  std::vector<glm::vec3> points = getPoints();
+  polyscope::show(3);
+  std::shared_ptr<polyscope::render::AttributeBuffer> positions = psCloud->getPositionRenderBuffer();
+  ASSERT_NE(positions, nullptr);
+  EXPECT_FALSE(positions->isStreaming());
+
+  // updated every frame
+  for (int i = 0; i < 5; i++) {
+    for (glm::vec3& p : points) p.x += 0.1;
+    psCloud->updatePointPositions(points);
+    polyscope::show(1);
+  }
+  EXPECT_TRUE(positions->isStreaming());
 
-// ============================================================
-// =============== Ground plane tests
-// ============================================================
+  // a single update after a few frames without any
+  for (int i = 0; i < 5; i++) {
+    polyscope::requestRedraw();
+    polyscope::show(1);
+  }
+  psCloud->updatePointPositions(points);
+  polyscope::show(1);
+  EXPECT_FALSE(positions->isStreaming());
 
-TEST_F(PolyscopeTest, GroundPlaneTest) {
+  polyscope::removeAllStructures();
+}
 
-  // Add a structure and cycle through the ground plane options
+TEST_F(PolyscopeTest, DynamicRenderScale) {
   auto psMesh = registerTriangleMesh();
+  psMesh->setEnabled(true);
+
+  // the mock backend times every frame at zero, so the scale climbs to the largest allowed
+  polyscope::options::targetFrameTimeMs = 10.;
+  polyscope::options::renderScaleMax = 2.;
+  for (int i = 0; i < 60; i++) {
+    polyscope::requestRedraw();
+    polyscope::show(1);
+  }
+  EXPECT_FLOAT_EQ(polyscope::render::engine->getRenderScale(), 2.f);
 
-  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::None;
-  polyscope::refresh();
-  polyscope::show(3);
-
-  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::Tile;
-  polyscope::refresh();
+  // fractional scales resample the scene
+  polyscope::render::engine->setRenderScale(0.7);
+  EXPECT_EQ(polyscope::render::engine->sceneBufferSize(100), 70u);
+  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::ShadowOnly;
   polyscope::show(3);
-
   polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::TileReflection;
-  polyscope::refresh();
-  polyscope::show(3);
 
-  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::ShadowOnly;
-  polyscope::refresh();
+  // off again
+  polyscope::options::targetFrameTimeMs = -1.;
+  polyscope::options::renderScaleMax = 1.;
   polyscope::show(3);
+  EXPECT_FLOAT_EQ(polyscope::render::engine->getRenderScale(), 1.f);
 
   polyscope::removeAllStructures();
 }
 
-
-// ============================================================
-// =============== Combo test
-// ============================================================
-
-// Register a handful of quantities / structures, then call refresh
-TEST_F(PolyscopeTest, RefreshMultiTest) {
-
-  { // Surface mesh
-    auto psMesh = registerTriangleMesh();
-    std::vector<double> vScalar(psMesh->nVertices(), 7.);
-    auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
-  }
-
-  { // Point cloud
-    auto psPoints = registerPointCloud();
-    std::vector<double> vScalar(psPoints->nPoints(), 7.);
-    auto q2 = psPoints->addScalarQuantity("vScalar", vScalar);
-    q2->setEnabled(true);
+TEST_F(PolyscopeTest, OcclusionCulling) {
+  polyscope::options::enableOcclusionCulling = true;
+  auto psMesh1 = registerTriangleMesh("mesh1");
+  auto psMesh2 = registerTriangleMesh("mesh2");
+  psMesh2->translate(glm::vec3{0., 0., -1.});
+  polyscope::view::resetCameraToHomeView();
+  for (int i = 0; i < 3; i++) {
+    polyscope::requestRedraw();
+    polyscope::show(1);
   }
 
-  { // Curve network
-    auto psCurve = registerCurveNetwork();
-    std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
-    auto q3 = psCurve->addEdgeVectorQuantity("vals", vals);
-    q3->setEnabled(true);
-  }
+  // the mock backend passes every query, so nothing is culled
+  EXPECT_FALSE(psMesh1->isOccluded());
+  EXPECT_FALSE(psMesh2->isOccluded());
+  EXPECT_FALSE(psMesh2->hasOutstandingOcclusionTest());
+  polyscope::pick::evaluatePickQuery(77, 88);
 
+  // not in transparency modes
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::Simple;
   polyscope::show(3);
+  EXPECT_FALSE(psMesh2->isOccluded());
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None;
 
-  polyscope::refresh();
+  polyscope::options::enableOcclusionCulling = false;
   polyscope::show(3);
-
   polyscope::removeAllStructures();
 }
 
-// Cycle through the transparency optins
-TEST_F(PolyscopeTest, TransparencyTest) {
-
-  { // Surface mesh
-    auto psMesh = registerTriangleMesh();
-    std::vector<double> vScalar(psMesh->nVertices(), 7.);
-    auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
+TEST_F(PolyscopeTest, MeshClusterCulling) {
+  // a grid in the xy plane, facing +z
+  std::vector<glm::vec3> points;
+  std::vector<std::array<size_t, 3>> faces;
+  const size_t n = 64;
+  for (size_t i = 0; i <= n; i++) {
+    for (size_t j = 0; j <= n; j++) {
+      points.push_back(glm::vec3{i, j, 0.});
+    }
   }
-
-  { // Point cloud
-    auto psPoints = registerPointCloud();
-    std::vector<double> vScalar(psPoints->nPoints(), 7.);
-    auto q2 = psPoints->addScalarQuantity("vScalar", vScalar);
-    q2->setEnabled(true);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      size_t v = i * (n + 1) + j;
+      faces.push_back({v, v + n + 1, v + n + 2});
+      faces.push_back({v, v + n + 2, v + 1});
+    }
   }
+  polyscope::options::meshClusterCullingMinTriangles = 0;
+  polyscope::options::reorderForLocality = true;
+  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::None;
+  auto psMesh = polyscope::registerSurfaceMesh("grid", points, faces);
+  psMesh->addVertexScalarQuantity("vScalar", std::vector<double>(points.size(), 1.))->setEnabled(true);
+
+  // zoomed in on a corner, most clusters are outside the view
+  polyscope::view::lookAt(glm::vec3{1., 1., 2.}, glm::vec3{1., 1., 0.});
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  EXPECT_GT(polyscope::render::engine->lastFrameRenderStats.clustersCulled, 0u);
+
+  // from far behind, everything is in view but facing away
+  polyscope::view::lookAt(glm::vec3{32., 32., -500.}, glm::vec3{32., 32., 0.});
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  EXPECT_EQ(polyscope::render::engine->lastFrameRenderStats.clustersCulled, 0u);
+  psMesh->setBackFacePolicy(polyscope::BackFacePolicy::Cull);
+  polyscope::show(1);
+  EXPECT_GT(polyscope::render::engine->lastFrameRenderStats.clustersCulled, 0u);
+  polyscope::pick::evaluatePickQuery(77, 88);
 
-  { // Curve network
-    auto psCurve = registerCurveNetwork();
-    std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
-    auto q3 = psCurve->addEdgeVectorQuantity("vals", vals);
-    q3->setEnabled(true);
-  }
+  polyscope::options::meshClusterCullingMinTriangles = 1000000;
+  polyscope::options::reorderForLocality = false;
+  polyscope::options::groundPlaneMode = polyscope::GroundPlaneMode::TileReflection;
+  polyscope::removeAllStructures();
+}
 
+TEST_F(PolyscopeTest, SurfaceMeshReleaseHostData) {
+  auto psMesh = registerTriangleMesh();
+  size_t retainedBytes = psMesh->hostMemoryUsage();
+
+  psMesh->setRetainHostData(false);
   polyscope::show(3);
+  EXPECT_TRUE(psMesh->faceNormals.empty());
+  EXPECT_LT(psMesh->hostMemoryUsage(), retainedBytes);
 
-  polyscope::options::transparencyMode = polyscope::TransparencyMode::Simple;
+  // readers get the geometry back
+  psMesh->addVertexVectorQuantity("vVector", std::vector<glm::vec3>(psMesh->nVertices(), glm::vec3{1., 0., 0.}))
+      ->setEnabled(true);
+  psMesh->setSmoothShade(true);
+  psMesh->updateVertexPositions(std::vector<size_t>{0}, std::vector<glm::vec3>{glm::vec3{0.1, 0.2, 0.3}});
   polyscope::show(3);
+  psMesh->ensureHaveGeometryData();
+  EXPECT_EQ(psMesh->faceNormals.size(), psMesh->nFaces());
+  polyscope::pick::evaluatePickQuery(77, 88);
 
-  polyscope::options::transparencyMode = polyscope::TransparencyMode::Pretty;
+  psMesh->setRetainHostData(true);
   polyscope::show(3);
+  EXPECT_EQ(psMesh->vertexNormals.size(), psMesh->nVertices());
 
   polyscope::removeAllStructures();
 }
 
-// Do some slice plane stuff
-TEST_F(PolyscopeTest, SlicePlaneTest) {
+TEST_F(PolyscopeTest, ScratchVectorReuse) {
+  polyscope::releaseScratchMemory();
 
-  // Surface mesh
+  // storage goes back to the pool, and is handed to the next scratch vector of the type
+  const glm::vec3* storage;
+  {
+    polyscope::ScratchVector<glm::vec3> a;
+    a->resize(1000);
+    storage = a->data();
+  }
+  {
+    polyscope::ScratchVector<glm::vec3> b;
+    EXPECT_TRUE(b->empty());
+    EXPECT_GE(b->capacity(), 1000u);
+    EXPECT_EQ(b->data(), storage);
+  }
+  polyscope::ScratchMemoryStats stats = polyscope::getScratchMemoryStats();
+  EXPECT_GE(stats.currentBytes, 1000 * sizeof(glm::vec3));
+  EXPECT_GE(stats.peakBytes, stats.currentBytes);
+
+  // buffer fills use it
   auto psMesh = registerTriangleMesh();
-  std::vector<double> vScalar(psMesh->nVertices(), 7.);
-  auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
+  psMesh->setEdgeWidth(1.);
+  polyscope::show(3);
+  psMesh->refresh();
+  polyscope::show(3);
+  polyscope::pick::evaluatePickQuery(77, 88);
 
-  // Point cloud
-  auto psPoints = registerPointCloud();
-  psPoints->setPointRenderMode(polyscope::PointRenderMode::Sphere);
-  psPoints->setCullWholeElements(true);
-  std::vector<double> vScalarP(psPoints->nPoints(), 7.);
-  auto q2 = psPoints->addScalarQuantity("vScalar", vScalarP);
-  q2->setEnabled(true);
+  // nothing is kept over the budget
+  polyscope::releaseScratchMemory();
+  size_t releasedBytes = polyscope::getScratchMemoryStats().currentBytes;
+  polyscope::options::scratchMemoryBudget = 0;
+  {
+    polyscope::ScratchVector<glm::vec3> c;
+    c->resize(1000);
+  }
+  EXPECT_EQ(polyscope::getScratchMemoryStats().currentBytes, releasedBytes);
+  polyscope::options::scratchMemoryBudget = 1073741824;
 
+  polyscope::removeAllStructures();
+}
 
-  { // Curve network
-    auto psCurve = registerCurveNetwork();
-    std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
-    auto q3 = psCurve->addEdgeVectorQuantity("vals", vals);
-    q3->setEnabled(true);
+// A strip of n-2 triangles over n vertices, for meshes of any size
+polyscope::SurfaceMesh* registerTriangleStrip(std::string name, size_t n) {
+  std::vector<glm::vec3> vertices(n);
+  std::vector<std::array<size_t, 3>> faces(n - 2);
+  for (size_t i = 0; i < n; i++) {
+    vertices[i] = glm::vec3{static_cast<float>(i / 2), static_cast<float>(i % 2), 0.};
+  }
+  for (size_t i = 0; i + 2 < n; i++) {
+    faces[i] = {i, i + 1, i + 2};
   }
+  return polyscope::registerSurfaceMesh(name, vertices, faces);
+}
 
-  { // Volume mesh
-    std::vector<glm::vec3> verts;
-    std::vector<std::array<int, 8>> cells;
-    std::tie(verts, cells) = getVolumeMeshData();
-    polyscope::VolumeMesh* psVol = polyscope::registerVolumeMesh("vol", verts, cells);
+TEST_F(PolyscopeTest, AllocationBudgetDraw) {
+  auto psSmall = registerTriangleStrip("small", 100);
+  auto psLarge = registerTriangleStrip("large", 100000);
+  polyscope::requestRedraw();
+  polyscope::show(3);
 
-    polyscope::VolumeMesh* psVol2 = polyscope::registerVolumeMesh("vol cull whole", verts, cells);
-    psVol2->setCullWholeElements(true);
+  // Once the draw buffers are filled, drawing allocates the same, whatever the size of the mesh (uniforms set by name
+  // may still allocate their name strings). Only this thread is counted, since others may allocate meanwhile.
+  size_t allocs[4];
+  for (int i = 0; i < 2; i++) {
+    ScopedAllocationCounter counter(true);
+    psSmall->draw();
+    allocs[i] = counter.allocations();
+  }
+  for (int i = 2; i < 4; i++) {
+    ScopedAllocationCounter counter(true);
+    psLarge->draw();
+    allocs[i] = counter.allocations();
   }
+  EXPECT_EQ(allocs[0], allocs[1]);
+  EXPECT_EQ(allocs[2], allocs[3]);
+  EXPECT_EQ(allocs[1], allocs[3]);
 
-  polyscope::show(3);
+  polyscope::removeAllStructures();
+}
 
-  // render with one slice plane
-  polyscope::addSceneSlicePlane();
-  polyscope::show(3);
+TEST_F(PolyscopeTest, AllocationBudgetAddScalar) {
+  // The number of allocations made adding a quantity does not grow with the number of elements (up to the blocks of
+  // parallel loops), and their size is a few copies of the data.
+  size_t allocs[2];
+  size_t nVerts[2] = {1000, 100000};
+  for (int i = 0; i < 2; i++) {
+    size_t n = nVerts[i];
+    auto psMesh = registerTriangleStrip("strip", n);
+    std::vector<double> vScalar(n, 7.);
+    ScopedAllocationCounter counter;
+    psMesh->addVertexScalarQuantity("vScalar", vScalar);
+    allocs[i] = counter.allocations();
+    EXPECT_LE(counter.bytes(), 8 * n * sizeof(double) + (1 << 20));
+    polyscope::removeAllStructures();
+  }
+  EXPECT_LE(allocs[1], allocs[0] + 64);
+}
 
-  // try a few variations of point cloud settings
-  psPoints->setCullWholeElements(false);
-  polyscope::show(3);
-  psPoints->setCullWholeElements(true);
-  psPoints->setPointRenderMode(polyscope::PointRenderMode::Quad);
+TEST_F(PolyscopeTest, ScalarColorMapWithoutRebuild) {
+  auto psMesh = registerTriangleStrip("strip", 100000);
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  auto q = psMesh->addVertexScalarQuantity("vScalar", vScalar);
+  q->setEnabled(true);
+  polyscope::requestRedraw();
   polyscope::show(3);
-  psPoints->setCullWholeElements(false);
+
+  // Changing the colormap or the range uploads at most the colormap itself, never the buffers of the mesh
+  size_t uploadBefore = polyscope::render::engine->renderStats.uploadBytes;
+  q->setColorMap("blues");
+  q->setMapRange(std::make_pair(-1., 1.));
+  polyscope::requestRedraw();
   polyscope::show(3);
-  
+  EXPECT_EQ(q->getColorMap(), "blues");
+  EXPECT_LT(polyscope::render::engine->renderStats.uploadBytes - uploadBefore, psMesh->nVertices() * sizeof(float));
+
+  // The isoline variant of the shader is still built when they are turned on
+  q->setIsolinesEnabled(true);
+  q->setIsolineDarkness(0.5);
+  q->setColorMap("viridis");
+  polyscope::requestRedraw();
   polyscope::show(3);
+  EXPECT_TRUE(q->getIsolinesEnabled());
 
-  // add another and rotate it
-  polyscope::SlicePlane* p = polyscope::addSceneSlicePlane();
-  p->setTransform(glm::translate(p->getTransform(), glm::vec3{-1., 0., 0.}));
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, ParallelReduceAndExecutor) {
+  std::vector<double> values(1000003);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = 0.1 * i;
+  }
+  auto sumBlock = [&](size_t blockStart, size_t blockEnd) {
+    double sum = 0.;
+    for (size_t i = blockStart; i < blockEnd; i++) sum += values[i];
+    return sum;
+  };
+  auto add = [](double a, double b) { return a + b; };
+
+  polyscope::options::numThreads = 4;
+  double sum = polyscope::parallelReduce(0, values.size(), 0., sumBlock, add);
+  EXPECT_EQ(sum, polyscope::parallelReduce(0, values.size(), 0., sumBlock, add)); // same order every time
+  EXPECT_NEAR(sum, 0.1 * 1000002. * 1000003. / 2., 1e-6 * sum);
+
+  // An application executor, which runs the tasks backwards; the result is the same
+  size_t nExecutorCalls = 0;
+  polyscope::setParallelExecutor([&](size_t nTasks, const std::function<void(size_t)>& task) {
+    nExecutorCalls++;
+    for (size_t i = nTasks; i > 0; i--) task(i - 1);
+  });
+  EXPECT_EQ(sum, polyscope::parallelReduce(0, values.size(), 0., sumBlock, add));
+  EXPECT_EQ(nExecutorCalls, 1u);
+  polyscope::registerPointCloud("cloud", std::vector<glm::vec3>(100000, glm::vec3{1., 2., 3.}))
+      ->addScalarQuantity("scalar", std::vector<double>(values.begin(), values.begin() + 100000));
   polyscope::show(3);
+  polyscope::setParallelExecutor(polyscope::ParallelExecutor());
 
-  // test removal
-  polyscope::removeLastSceneSlicePlane();
+  EXPECT_EQ(sum, polyscope::parallelReduce(0, values.size(), 0., sumBlock, add));
+  polyscope::options::numThreads = 0;
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, EnabledQuantityList) {
+  auto psMesh = registerTriangleMesh();
+  std::vector<double> vScalar(psMesh->nVertices(), 7.);
+  psMesh->addVertexScalarQuantity("list_c", vScalar);
+  psMesh->addVertexScalarQuantity("list_a", vScalar);
+  psMesh->addVertexVectorQuantity("list_b", std::vector<glm::vec3>(psMesh->nVertices(), glm::vec3{1., 0., 0.}));
+  EXPECT_TRUE(psMesh->getEnabledQuantities().empty());
+
+  // in the order of the names, as they are drawn
+  psMesh->getQuantity("list_b")->setEnabled(true);
+  psMesh->getQuantity("list_a")->setEnabled(true);
+  ASSERT_EQ(psMesh->getEnabledQuantities().size(), 2u);
+  EXPECT_EQ(psMesh->getEnabledQuantities()[0]->name, "list_a");
+  EXPECT_EQ(psMesh->getEnabledQuantities()[1]->name, "list_b");
+
+  // enabling another dominant quantity disables the first
+  psMesh->getQuantity("list_c")->setEnabled(true);
+  ASSERT_EQ(psMesh->getEnabledQuantities().size(), 2u);
+  EXPECT_EQ(psMesh->getEnabledQuantities()[0]->name, "list_b");
+  EXPECT_EQ(psMesh->getEnabledQuantities()[1]->name, "list_c");
   polyscope::show(3);
 
-  // make one structure ignore the plane
-  psMesh->setIgnoreSlicePlane(polyscope::state::slicePlanes[0]->name, true);
+  // replaced quantities stay enabled, removed ones are gone
+  psMesh->addVertexScalarQuantity("list_c", vScalar);
+  psMesh->removeQuantity("list_b");
+  ASSERT_EQ(psMesh->getEnabledQuantities().size(), 1u);
+  EXPECT_EQ(psMesh->getEnabledQuantities()[0], psMesh->getQuantity("list_c"));
   polyscope::show(3);
 
-  // remove the last plane so we don't leave it around for future tests
-  polyscope::removeLastSceneSlicePlane();
+  psMesh->setAllQuantitiesEnabled(false);
+  EXPECT_TRUE(psMesh->getEnabledQuantities().empty());
 
   polyscope::removeAllStructures();
 }
 
-// Register a handful of quantities / structures, then call refresh
-TEST_F(PolyscopeTest, OrthoViewTest) {
-
-  // Add some stuff
+TEST_F(PolyscopeTest, TransformDefersSceneExtents) {
+  auto psPoints = registerPointCloud();
+  polyscope::show(1);
+  float bboxMaxX = std::get<1>(polyscope::state::boundingBox).x;
 
-  { // Surface mesh
-    auto psMesh = registerTriangleMesh();
-    std::vector<double> vScalar(psMesh->nVertices(), 7.);
-    auto q1 = psMesh->addVertexDistanceQuantity("distance", vScalar);
+  // Moving a structure (as a gizmo drag does, many times per frame) leaves the extents for the next frame
+  for (int i = 1; i <= 10; i++) {
+    psPoints->setPosition(glm::vec3{10. * i, 0., 0.});
   }
+  EXPECT_EQ(std::get<1>(polyscope::state::boundingBox).x, bboxMaxX);
+  polyscope::show(1);
+  EXPECT_NEAR(std::get<1>(polyscope::state::boundingBox).x, bboxMaxX + 100., 1e-3);
 
-  { // Point cloud
-    auto psPoints = registerPointCloud();
-    std::vector<double> vScalar(psPoints->nPoints(), 7.);
-    auto q2 = psPoints->addScalarQuantity("vScalar", vScalar);
-    q2->setEnabled(true);
-  }
+  psPoints->resetTransform();
+  polyscope::show(1);
+  EXPECT_NEAR(std::get<1>(polyscope::state::boundingBox).x, bboxMaxX, 1e-3);
 
-  { // Curve network
-    auto psCurve = registerCurveNetwork();
-    std::vector<glm::vec3> vals(psCurve->nEdges(), {1., 2., 3.});
-    auto q3 = psCurve->addEdgeVectorQuantity("vals", vals);
-    q3->setEnabled(true);
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, StructureGroups) {
+  auto cloudA = registerPointCloud("group_a");
+  auto cloudB = registerPointCloud("group_b");
+  cloudB->setPosition(glm::vec3{50., 0., 0.});
+  auto cloudC = registerPointCloud("group_c");
+
+  polyscope::Group* outer = polyscope::createGroup("outer");
+  polyscope::Group* inner = polyscope::createGroup("inner");
+  outer->addChildGroup(*inner)->addChildStructure(*cloudA);
+  inner->addChildStructure(*cloudB);
+  EXPECT_EQ(inner->getParentGroup(), outer);
+  EXPECT_EQ(cloudB->getParentGroup(), inner);
+  EXPECT_EQ(outer->nDescendantStructures(), 2u);
+  EXPECT_EQ(polyscope::getRootGroups(), std::vector<polyscope::Group*>{outer});
+  EXPECT_THROW(inner->addChildGroup(*outer), std::runtime_error); // (a cycle)
+
+  // The bounds cover all members, and follow their transforms
+  glm::vec3 bboxMin, bboxMax;
+  ASSERT_TRUE(outer->getCullingBoundingBox(bboxMin, bboxMax));
+  EXPECT_GT(bboxMax.x, 50.);
+  cloudB->setPosition(glm::vec3{80., 0., 0.});
+  ASSERT_TRUE(outer->getCullingBoundingBox(bboxMin, bboxMax));
+  EXPECT_GT(bboxMax.x, 80.);
+
+  // Disabling a group hides everything inside it, without changing the structures
+  outer->setEnabled(false);
+  EXPECT_FALSE(inner->isVisible());
+  EXPECT_TRUE(cloudB->isEnabled());
+  EXPECT_FALSE(cloudB->isVisibleInGroups());
+  EXPECT_TRUE(cloudC->isVisibleInGroups());
+  polyscope::requestRedraw();
+  polyscope::show(2);
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  outer->setEnabled(true);
+  EXPECT_TRUE(cloudB->isVisibleInGroups());
+
+  // Groups out of view are culled as a whole
+  polyscope::view::lookAt(glm::vec3{0., 0., 10.}, glm::vec3{0., 0., 0.});
+  polyscope::Group* far = polyscope::createGroup("far");
+  far->addChildGroup(*polyscope::createGroup("far_inner"));
+  polyscope::getGroup("far_inner")->addChildStructure(*cloudC);
+  cloudC->setPosition(glm::vec3{0., 0., 1000.}); // behind the camera
+  EXPECT_FALSE(far->isInViewFrustum());
+  polyscope::render::engine->resetRenderStats();
+  polyscope::requestRedraw();
+  polyscope::show(1);
+  EXPECT_GT(polyscope::render::engine->lastFrameRenderStats.structuresCulled, 0u);
+
+  outer->setTransparency(0.5);
+  EXPECT_EQ(cloudB->getTransparency(), 0.5);
+  EXPECT_EQ(cloudC->getTransparency(), 1.);
+  polyscope::options::transparencyMode = polyscope::TransparencyMode::None;
+
+  // Removing members and groups leaves the rest alone
+  polyscope::removeStructure(cloudA);
+  EXPECT_EQ(outer->nDescendantStructures(), 1u);
+  polyscope::removeGroup("inner");
+  EXPECT_EQ(outer->nDescendantStructures(), 0u);
+  EXPECT_EQ(cloudB->getParentGroup(), nullptr);
+  polyscope::removeAllGroups();
+  EXPECT_FALSE(polyscope::hasGroup("outer"));
+  EXPECT_EQ(cloudC->getParentGroup(), nullptr);
+  polyscope::show(1);
+
+  polyscope::removeAllStructures();
+  polyscope::view::resetCameraToHomeView();
+}
+
+TEST_F(PolyscopeTest, BulkRegisterAndRemove) {
+  std::vector<polyscope::Structure*> clouds;
+  for (int i = 0; i < 20; i++) {
+    polyscope::PointCloud* cloud = new polyscope::PointCloud("bulk_" + std::to_string(i), getPoints());
+    cloud->setPosition(glm::vec3{10. * i, 0., 0.});
+    clouds.push_back(cloud);
+  }
+  EXPECT_TRUE(polyscope::registerStructures(clouds));
+  EXPECT_TRUE(polyscope::hasPointCloud("bulk_19"));
+  EXPECT_GT(std::get<1>(polyscope::state::boundingBox).x, 190.);
+
+  // In a batch, the extents are updated when it ends
+  {
+    polyscope::BatchUpdate batch;
+    registerPointCloud("bulk_far")->setPosition(glm::vec3{1000., 0., 0.});
+    EXPECT_LT(std::get<1>(polyscope::state::boundingBox).x, 1000.);
   }
+  EXPECT_GT(std::get<1>(polyscope::state::boundingBox).x, 1000.);
+  polyscope::show(1);
+
+  // Removal frees the pick ranges; the others keep theirs
+  polyscope::pick::evaluatePickQuery(-1, -1);
+  size_t lastInd = polyscope::pick::localIndexToGlobal({clouds.back(), 0});
+  polyscope::removeStructures(std::vector<polyscope::Structure*>(clouds.begin(), clouds.end() - 1));
+  polyscope::removeStructure("bulk_far");
+  EXPECT_FALSE(polyscope::hasPointCloud("bulk_0"));
+  EXPECT_EQ(polyscope::pick::localIndexToGlobal({clouds.back(), 0}), lastInd);
+  EXPECT_LT(std::get<1>(polyscope::state::boundingBox).x, 1000.);
+  EXPECT_GT(std::get<0>(polyscope::state::boundingBox).x, 100.);
+  polyscope::show(1);
 
-  // Enable the orthographic view
-  polyscope::view::projectionMode = polyscope::ProjectionMode::Orthographic;
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, StructureAndQuantityHandles) {
+  polyscope::Handle<polyscope::PointCloud> cloud = registerPointCloud("handle cloud");
+  std::vector<double> values(getPoints().size(), 1.);
+  polyscope::Handle<polyscope::PointCloudScalarQuantity> q = cloud->addScalarQuantity("vals", values);
+  EXPECT_EQ(cloud.get(), polyscope::getPointCloud("handle cloud"));
+  ASSERT_TRUE(static_cast<bool>(q));
+  q->setEnabled(true);
+  polyscope::show(1);
+
+  // Replacing the quantity invalidates handles to the old one
+  cloud->addScalarQuantity("vals", values);
+  EXPECT_FALSE(static_cast<bool>(q));
+  EXPECT_THROW(q->updateData(values), std::runtime_error);
+
+  // As does removing the structure, even once a new one of the same name is registered
+  polyscope::removeStructure("handle cloud");
+  EXPECT_EQ(cloud.get(), nullptr);
+  registerPointCloud("handle cloud");
+  EXPECT_EQ(cloud.get(), nullptr);
+  EXPECT_NE(polyscope::Handle<polyscope::PointCloud>(polyscope::getPointCloud("handle cloud")), cloud);
+
+  polyscope::removeAllStructures();
+}
+
+TEST_F(PolyscopeTest, PipelineStatistics) {
+  registerPointCloud("stats cloud");
+  polyscope::options::enablePipelineStatistics = true;
   polyscope::show(3);
+  polyscope::options::enablePipelineStatistics = false;
 
-  // Go back to default perspective
-  polyscope::view::projectionMode = polyscope::ProjectionMode::Perspective;
+  // One entry per structure, summed over the passes which drew it
+  size_t nCloud = 0;
+  for (const polyscope::render::GPUPipelineStatistics& s : polyscope::render::engine->getPipelineStatistics()) {
+    if (s.name == "Point Cloud stats cloud") nCloud++;
+  }
+  EXPECT_EQ(nCloud, 1u);
 
   polyscope::removeAllStructures();
 }